@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <pthread.h>
 #ifdef HAVE_LINUX_BLKZONED_H
 #include <linux/blkzoned.h>
 #endif
@@ -29,6 +30,11 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "sysfs.h"
+#include "xalloc.h"
+#include "jsonwrt.h"
+
+/* max number of threads used for --report and --parallel */
+#define BLOCKDEV_MAX_THREADS	16
 
 struct bdc {
 	long		ioc;		/* ioctl code */
@@ -204,14 +210,56 @@ static const struct bdc bdcms[] =
 	}
 };
 
+/* command from the command line */
+struct bdcmd {
+	const struct bdc	*bdc;		/* NULL for --getsz */
+	int			iarg;		/* ARG_INT argument */
+	unsigned int		verbose :1;
+};
+
+struct bdcmds {
+	struct bdcmd	*cmds;
+	size_t		ncmds;
+};
+
+/* device processed by --report or by --parallel commands */
+struct bdev {
+	const char	*name;
+
+	int		err;		/* errno of the failed operation */
+	const char	*errop;		/* failed ioctl name or NULL for open() */
+
+	char		*out;		/* buffered output of the commands */
+	size_t		outsz;
+
+	/* --report */
+	int		ro, ssz, bsz;
+	long		ra;
+	uint64_t	start;
+	unsigned long long bytes;
+
+	unsigned int	nostart :1,	/* partition start not available */
+			failed :1;
+};
+
+struct bdev_queue {
+	struct bdev	*devs;
+	size_t		ndevs;
+	size_t		next;
+
+	void		(*fn)(struct bdev *, void *);
+	void		*data;
+	pthread_mutex_t	lock;
+};
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	size_t i;
 
 	fputs(USAGE_HEADER, stdout);
 	fprintf(stdout, _(
-	         " %1$s [-v|-q] commands devices\n"
-	         " %1$s --report [devices]\n"
+	         " %1$s [-v|-q] [--parallel] commands devices\n"
+	         " %1$s --report [--json] [devices]\n"
 	         " %1$s -h|-V\n"
 		), program_invocation_short_name);
 
@@ -222,6 +270,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(  _(" -q             quiet mode"), stdout);
 	fputsln(  _(" -v             verbose mode"), stdout);
 	fputsln(  _("     --report   print report for specified (or all) devices"), stdout);
+	fputsln(  _(" -J, --json     use JSON --report output format"), stdout);
+	fputsln(  _("     --parallel process the devices in parallel"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(16));
 
@@ -252,14 +302,24 @@ static int find_cmd(char *s)
 	return -1;
 }
 
-static void do_commands(int fd, char **argv, int d);
+static void parse_commands(struct bdcmds *cmds, char **argv, int d, int *parallel);
+static int do_commands(int fd, struct bdcmds *cmds, FILE *out, size_t *failed);
+static void __attribute__((__noreturn__)) command_failed(struct bdcmd *cmd, int errsv);
+static void commands_device(struct bdev *dev, void *data);
+static void report_errors(struct bdev *devs, size_t ndevs);
+static void process_devices(struct bdev *devs, size_t ndevs,
+			    void (*fn)(struct bdev *, void *), void *data);
 static void report_header(void);
-static void report_device(char *device, int quiet);
-static void report_all_devices(void);
+static void report_device(struct bdev *dev, void *data);
+static void report_print(struct bdev *devs, size_t ndevs, int quiet, int json);
+static struct bdev *get_all_devices(size_t *ndevs);
 
 int main(int argc, char **argv)
 {
-	int fd, d, j, k;
+	struct bdcmds cmds;
+	struct bdev *devs;
+	size_t ndevs, i;
+	int fd, d, j, k, parallel = 0;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -277,15 +337,31 @@ int main(int argc, char **argv)
 	if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))
 		usage();
 
+	ul_path_init_debug();
+	ul_sysfs_init_debug();
+
 	/* --report not together with other commands */
 	if (!strcmp(argv[1], "--report")) {
-		report_header();
-		if (argc > 2) {
-			for (d = 2; d < argc; d++)
-				report_device(argv[d], 0);
+		int json = 0, quiet = 0;
+
+		d = 2;
+		if (d < argc && (!strcmp(argv[d], "-J") ||
+				 !strcmp(argv[d], "--json"))) {
+			json = 1;
+			d++;
+		}
+		if (d < argc) {
+			ndevs = argc - d;
+			devs = xcalloc(ndevs, sizeof(*devs));
+			for (i = 0; i < ndevs; i++)
+				devs[i].name = argv[d + i];
 		} else {
-			report_all_devices();
+			devs = get_all_devices(&ndevs);
+			quiet = 1;
 		}
+
+		process_devices(devs, ndevs, report_device, NULL);
+		report_print(devs, ndevs, quiet, json);
 		return EXIT_SUCCESS;
 	}
 
@@ -313,29 +389,55 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	parse_commands(&cmds, argv, d, &parallel);
+
+	if (parallel && argc - d > 1) {
+		ndevs = argc - d;
+		devs = xcalloc(ndevs, sizeof(*devs));
+		for (i = 0; i < ndevs; i++)
+			devs[i].name = argv[d + i];
+
+		process_devices(devs, ndevs, commands_device, &cmds);
+
+		for (i = 0; i < ndevs; i++) {
+			if (devs[i].out)
+				fwrite(devs[i].out, 1, devs[i].outsz, stdout);
+		}
+		fflush(stdout);
+		report_errors(devs, ndevs);
+
+		for (i = 0; i < ndevs; i++) {
+			if (devs[i].failed)
+				return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
 	for (k = d; k < argc; k++) {
 		fd = open(argv[k], O_RDONLY, 0);
 		if (fd < 0)
 			err(EXIT_FAILURE, _("cannot open %s"), argv[k]);
-		do_commands(fd, argv, d);
+		if (do_commands(fd, &cmds, stdout, &i) != 0)
+			command_failed(&cmds.cmds[i], errno);
 		close(fd);
 	}
 	return EXIT_SUCCESS;
 }
 
-static void do_commands(int fd, char **argv, int d)
+/*
+ * Converts the commands (all arguments before the first device) to the
+ * list of commands, the -v and -q options are per-command.
+ */
+static void parse_commands(struct bdcmds *cmds, char **argv, int d, int *parallel)
 {
-	int res, i, j;
-	int iarg = 0;
-	unsigned int uarg = 0;
-	unsigned short huarg = 0;
-	long larg = 0;
-	long long llarg = 0;
-	unsigned long lu = 0;
-	unsigned long long llu = 0;
-	int verbose = 0;
+	int i, j, verbose = 0;
+	size_t n = 0;
+
+	cmds->cmds = xcalloc(d, sizeof(struct bdcmd));
 
 	for (i = 1; i < d; i++) {
+		struct bdcmd *cmd;
+
 		if (!strcmp(argv[i], "-v")) {
 			verbose = 1;
 			continue;
@@ -344,158 +446,350 @@ static void do_commands(int fd, char **argv, int d)
 			verbose = 0;
 			continue;
 		}
-
-		if (!strcmp(argv[i], "--getsz")) {
-			res = blkdev_get_sectors(fd, &llu);
-			if (res == 0) {
-				if (verbose)
-					printf(_("get size in 512-byte sectors: "));
-				printf("%lld\n", llu);
-			}
-			else
-				errx(EXIT_FAILURE,
-				     _("could not get device size"));
+		if (!strcmp(argv[i], "--parallel")) {
+			*parallel = 1;
 			continue;
 		}
+		if (!strcmp(argv[i], "--") && i == d - 1)
+			break;
+
+		cmd = &cmds->cmds[n++];
+		cmd->verbose = verbose;
+
+		if (!strcmp(argv[i], "--getsz"))
+			continue;
 
 		j = find_cmd(argv[i]);
 		if (j == -1) {
 			warnx(_("Unknown command: %s"), argv[i]);
 			errtryhelp(EXIT_FAILURE);
 		}
+		cmd->bdc = &bdcms[j];
+
+		if (cmd->bdc->argtype == ARG_INT && cmd->bdc->argname) {
+			if (i == d - 1) {
+				warnx(_("%s requires an argument"),
+				      cmd->bdc->name);
+				errtryhelp(EXIT_FAILURE);
+			}
+			cmd->iarg = strtos32_or_err(argv[++i], _("failed to parse command argument"));
+		} else
+			cmd->iarg = cmd->bdc->argval;
+	}
+
+	cmds->ncmds = n;
+}
+
+/*
+ * Calls the commands for @fd and prints results to @out. Returns 0 on
+ * success, or -1 and errno; @failed is the index of the failed command.
+ */
+static int do_commands(int fd, struct bdcmds *cmds, FILE *out, size_t *failed)
+{
+	int res;
+	size_t i;
+	int iarg = 0;
+	unsigned int uarg = 0;
+	unsigned short huarg = 0;
+	long larg = 0;
+	long long llarg = 0;
+	unsigned long lu = 0;
+	unsigned long long llu = 0;
+
+	for (i = 0; i < cmds->ncmds; i++) {
+		const struct bdc *bdc = cmds->cmds[i].bdc;
+		int verbose = cmds->cmds[i].verbose;
+
+		if (!bdc) {
+			/* --getsz */
+			res = blkdev_get_sectors(fd, &llu);
+			if (res != 0) {
+				*failed = i;
+				return -1;
+			}
+			if (verbose)
+				fprintf(out, _("get size in 512-byte sectors: "));
+			fprintf(out, "%lld\n", llu);
+			continue;
+		}
 
-		switch (bdcms[j].argtype) {
+		switch (bdc->argtype) {
 		default:
 		case ARG_NONE:
-			res = ioctl(fd, bdcms[j].ioc, 0);
+			res = ioctl(fd, bdc->ioc, 0);
 			break;
 		case ARG_USHRT:
-			huarg = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &huarg);
+			huarg = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &huarg);
 			break;
 		case ARG_INT:
-			if (bdcms[j].argname) {
-				if (i == d - 1) {
-					warnx(_("%s requires an argument"),
-					      bdcms[j].name);
-					errtryhelp(EXIT_FAILURE);
-				}
-				iarg = strtos32_or_err(argv[++i], _("failed to parse command argument"));
-			} else
-				iarg = bdcms[j].argval;
-
-			res = bdcms[j].flags & FL_NOPTR ?
-			    ioctl(fd, bdcms[j].ioc, iarg) :
-			    ioctl(fd, bdcms[j].ioc, &iarg);
+			iarg = cmds->cmds[i].iarg;
+			res = bdc->flags & FL_NOPTR ?
+			    ioctl(fd, bdc->ioc, iarg) :
+			    ioctl(fd, bdc->ioc, &iarg);
 			break;
 		case ARG_UINT:
-			uarg = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &uarg);
+			uarg = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &uarg);
 			break;
 		case ARG_LONG:
-			larg = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &larg);
+			larg = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &larg);
 			break;
 		case ARG_LLONG:
-			llarg = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &llarg);
+			llarg = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &llarg);
 			break;
 		case ARG_ULONG:
-			lu = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &lu);
+			lu = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &lu);
 			break;
 		case ARG_ULLONG:
-			llu = bdcms[j].argval;
-			res = ioctl(fd, bdcms[j].ioc, &llu);
+			llu = bdc->argval;
+			res = ioctl(fd, bdc->ioc, &llu);
 			break;
 		}
 
 		if (res == -1) {
-			warn(_("ioctl error on %s"), bdcms[j].iocname);
-			if (verbose)
-				printf(_("%s failed.\n"), _(bdcms[j].help));
-			exit(EXIT_FAILURE);
+			*failed = i;
+			return -1;
 		}
 
-		if (bdcms[j].argtype == ARG_NONE ||
-		    (bdcms[j].flags & FL_NORESULT)) {
+		if (bdc->argtype == ARG_NONE ||
+		    (bdc->flags & FL_NORESULT)) {
 			if (verbose)
-				printf(_("%s succeeded.\n"), _(bdcms[j].help));
+				fprintf(out, _("%s succeeded.\n"), _(bdc->help));
 			continue;
 		}
 
 		if (verbose)
-			printf("%s: ", _(bdcms[j].help));
+			fprintf(out, "%s: ", _(bdc->help));
 
-		switch (bdcms[j].argtype) {
+		switch (bdc->argtype) {
 		case ARG_USHRT:
-			printf("%hu\n", huarg);
+			fprintf(out, "%hu\n", huarg);
 			break;
 		case ARG_INT:
-			printf("%d\n", iarg);
+			fprintf(out, "%d\n", iarg);
 			break;
 		case ARG_UINT:
-			printf("%u\n", uarg);
+			fprintf(out, "%u\n", uarg);
 			break;
 		case ARG_LONG:
-			printf("%ld\n", larg);
+			fprintf(out, "%ld\n", larg);
 			break;
 		case ARG_LLONG:
-			printf("%lld\n", llarg);
+			fprintf(out, "%lld\n", llarg);
 			break;
 		case ARG_ULONG:
-			printf("%lu\n", lu);
+			fprintf(out, "%lu\n", lu);
 			break;
 		case ARG_ULLONG:
-			printf("%llu\n", llu);
+			fprintf(out, "%llu\n", llu);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void __attribute__((__noreturn__)) command_failed(struct bdcmd *cmd, int errsv)
+{
+	if (!cmd->bdc)
+		errx(EXIT_FAILURE, _("could not get device size"));
+
+	errno = errsv;
+	warn(_("ioctl error on %s"), cmd->bdc->iocname);
+	if (cmd->verbose)
+		printf(_("%s failed.\n"), _(cmd->bdc->help));
+	exit(EXIT_FAILURE);
+}
+
+/* --parallel worker function, the output is buffered in @dev */
+static void commands_device(struct bdev *dev, void *data)
+{
+	struct bdcmds *cmds = data;
+	struct bdcmd *cmd;
+	size_t i;
+	FILE *out;
+	int fd, rc;
+
+	fd = open(dev->name, O_RDONLY, 0);
+	if (fd < 0) {
+		dev->failed = 1;
+		dev->err = errno;
+		return;
+	}
+
+	out = open_memstream(&dev->out, &dev->outsz);
+	if (!out)
+		err(EXIT_FAILURE, _("cannot allocate output buffer"));
+
+	rc = do_commands(fd, cmds, out, &i);
+	if (rc) {
+		cmd = &cmds->cmds[i];
+		dev->failed = 1;
+		dev->err = errno;
+		dev->errop = cmd->bdc ? cmd->bdc->iocname : "--getsz";
+		if (cmd->verbose && cmd->bdc)
+			fprintf(out, _("%s failed.\n"), _(cmd->bdc->help));
+	}
+	fclose(out);
+	close(fd);
+}
+
+static int cmp_failure(const struct bdev *x, const struct bdev *y)
+{
+	int rc = strcmp(x->errop ? x->errop : "", y->errop ? y->errop : "");
+
+	return rc ? rc : x->err - y->err;
+}
+
+/* sort by failure, keep the command line order within the same failure */
+static int cmp_failed(const void *a, const void *b)
+{
+	const struct bdev *x = *(const struct bdev * const *) a,
+			  *y = *(const struct bdev * const *) b;
+	int rc = cmp_failure(x, y);
+
+	return rc ? rc : x < y ? -1 : x > y;
+}
+
+/*
+ * Prints one message for all the devices which failed in the same way
+ * rather than a message for each device.
+ */
+static void report_errors(struct bdev *devs, size_t ndevs)
+{
+	struct bdev **failed = xcalloc(ndevs, sizeof(struct bdev *));
+	size_t i, n = 0;
+
+	for (i = 0; i < ndevs; i++) {
+		if (devs[i].failed)
+			failed[n++] = &devs[i];
+	}
+	qsort(failed, n, sizeof(struct bdev *), cmp_failed);
+
+	for (i = 0; i < n; i++) {
+		struct bdev *dev = failed[i];
+
+		if (i == 0 || cmp_failure(failed[i - 1], dev) != 0) {
+			if (i)
+				fputc('\n', stderr);
+			fprintf(stderr, "%s: ", program_invocation_short_name);
+			if (!dev->errop)
+				fprintf(stderr, _("cannot open"));
+			else if (strcmp(dev->errop, "--getsz") == 0)
+				fprintf(stderr, _("could not get device size"));
+			else
+				fprintf(stderr, _("ioctl error on %s"), dev->errop);
+			fprintf(stderr, ": %s:", strerror(dev->err));
+		}
+		fprintf(stderr, " %s", dev->name);
+	}
+	if (n)
+		fputc('\n', stderr);
+	free(failed);
+}
+
+static void *device_worker(void *data)
+{
+	struct bdev_queue *q = data;
+
+	for (;;) {
+		struct bdev *dev = NULL;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->next < q->ndevs)
+			dev = &q->devs[q->next++];
+		pthread_mutex_unlock(&q->lock);
+
+		if (!dev)
 			break;
+		q->fn(dev, q->data);
+	}
+	return NULL;
+}
+
+/*
+ * Calls @fn for all the devices. The ioctls (and open() on some devices,
+ * e.g. multipath) may sleep, so the devices are processed by more threads
+ * in parallel; the main thread works too.
+ */
+static void process_devices(struct bdev *devs, size_t ndevs,
+			    void (*fn)(struct bdev *, void *), void *data)
+{
+	struct bdev_queue q = {
+		.devs = devs,
+		.ndevs = ndevs,
+		.fn = fn,
+		.data = data
+	};
+	pthread_t threads[BLOCKDEV_MAX_THREADS];
+	size_t i, nthreads = min(ndevs, (size_t) BLOCKDEV_MAX_THREADS);
+
+	pthread_mutex_init(&q.lock, NULL);
+	for (i = 1; i < nthreads; i++) {
+		int rc = pthread_create(&threads[i], NULL, device_worker, &q);
+		if (rc) {
+			errno = rc;
+			err(EXIT_FAILURE, _("failed to create thread"));
 		}
 	}
+	device_worker(&q);
+
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&q.lock);
 }
 
-static void report_all_devices(void)
+static struct bdev *get_all_devices(size_t *ndevs)
 {
 	FILE *procpt;
 	char line[200];
 	char ptname[200 + 1];
-	char device[210];
 	int ma, mi, sz;
+	struct bdev *devs = NULL;
+	size_t n = 0, alloc = 0;
 
 	procpt = fopen(_PATH_PROC_PARTITIONS, "r");
 	if (!procpt)
 		err(EXIT_FAILURE, _("cannot open %s"), _PATH_PROC_PARTITIONS);
 
 	while (fgets(line, sizeof(line), procpt)) {
+		char *device;
+
 		if (sscanf(line, " %d %d %d %200[^\n ]",
 			   &ma, &mi, &sz, ptname) != 4)
 			continue;
 
-		snprintf(device, sizeof(device), "/dev/%s", ptname);
-		report_device(device, 1);
+		if (n == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			devs = xreallocarray(devs, alloc, sizeof(*devs));
+		}
+		xasprintf(&device, "/dev/%s", ptname);
+		memset(&devs[n], 0, sizeof(*devs));
+		devs[n++].name = device;
 	}
 
 	fclose(procpt);
+	*ndevs = n;
+	return devs;
 }
 
-static void report_device(char *device, int quiet)
+/* --report worker function */
+static void report_device(struct bdev *dev, void *data __attribute__((__unused__)))
 {
 	int fd;
-	int ro, ssz, bsz;
-	long ra;
-	unsigned long long bytes;
-	uint64_t start = 0;
-	char start_str[16] = { "\0" };
 	struct stat st;
 
-	fd = open(device, O_RDONLY | O_NONBLOCK);
+	fd = open(dev->name, O_RDONLY | O_NONBLOCK);
 	if (fd < 0) {
-		if (!quiet)
-			warn(_("cannot open %s"), device);
+		dev->failed = 1;
+		dev->err = errno;
 		return;
 	}
 
-	ro = ssz = bsz = 0;
-	ra = 0;
 	if (fstat(fd, &st) == 0) {
 		dev_t disk;
 		struct path_cxt *pc;
@@ -505,30 +799,84 @@ static void report_device(char *device, int quiet)
 		    sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0 &&
 		    disk != st.st_rdev) {
 
-			if (ul_path_read_u64(pc, &start, "start") != 0)
-				/* TRANSLATORS: Start sector not available. Max. 15 letters. */
-				snprintf(start_str, sizeof(start_str), "%15s", _("N/A"));
+			if (ul_path_read_u64(pc, &dev->start, "start") != 0)
+				dev->nostart = 1;
 		}
 		ul_unref_path(pc);
 	}
-	if (!*start_str)
-		snprintf(start_str, sizeof(start_str), "%15ju", start);
-
-	if (ioctl(fd, BLKROGET, &ro) == 0 &&
-	    ioctl(fd, BLKRAGET, &ra) == 0 &&
-	    ioctl(fd, BLKSSZGET, &ssz) == 0 &&
-	    ioctl(fd, BLKBSZGET, &bsz) == 0 &&
-	    blkdev_get_size(fd, &bytes) == 0) {
-		printf("%s %5ld %5d %5d %s %15lld   %s\n",
-			ro ? "ro" : "rw", ra, ssz, bsz, start_str, bytes, device);
-	} else {
-		if (!quiet)
-			warnx(_("ioctl error on %s"), device);
+
+	if (ioctl(fd, BLKROGET, &dev->ro) != 0 ||
+	    ioctl(fd, BLKRAGET, &dev->ra) != 0 ||
+	    ioctl(fd, BLKSSZGET, &dev->ssz) != 0 ||
+	    ioctl(fd, BLKBSZGET, &dev->bsz) != 0 ||
+	    blkdev_get_size(fd, &dev->bytes) != 0) {
+		dev->failed = 1;
+		dev->errop = "ioctl";
 	}
 
 	close(fd);
 }
 
+static void report_print(struct bdev *devs, size_t ndevs, int quiet, int json)
+{
+	struct ul_jsonwrt fmt;
+	size_t i;
+
+	if (json) {
+		ul_jsonwrt_init(&fmt, stdout, 0);
+		ul_jsonwrt_root_open(&fmt);
+		ul_jsonwrt_array_open(&fmt, "blockdevices");
+	} else
+		report_header();
+
+	for (i = 0; i < ndevs; i++) {
+		struct bdev *dev = &devs[i];
+
+		if (dev->failed) {
+			if (quiet)
+				continue;
+			if (!dev->errop) {
+				errno = dev->err;
+				warn(_("cannot open %s"), dev->name);
+			} else
+				warnx(_("ioctl error on %s"), dev->name);
+			continue;
+		}
+
+		if (json) {
+			ul_jsonwrt_object_open(&fmt, NULL);
+			ul_jsonwrt_value_s(&fmt, "device", dev->name);
+			ul_jsonwrt_value_boolean(&fmt, "ro", dev->ro);
+			ul_jsonwrt_value_u64(&fmt, "ra", dev->ra);
+			ul_jsonwrt_value_u64(&fmt, "ssz", dev->ssz);
+			ul_jsonwrt_value_u64(&fmt, "bsz", dev->bsz);
+			if (dev->nostart)
+				ul_jsonwrt_value_null(&fmt, "startsec");
+			else
+				ul_jsonwrt_value_u64(&fmt, "startsec", dev->start);
+			ul_jsonwrt_value_u64(&fmt, "size", dev->bytes);
+			ul_jsonwrt_object_close(&fmt);
+		} else {
+			char start_str[16];
+
+			if (dev->nostart)
+				/* TRANSLATORS: Start sector not available. Max. 15 letters. */
+				snprintf(start_str, sizeof(start_str), "%15s", _("N/A"));
+			else
+				snprintf(start_str, sizeof(start_str), "%15ju", dev->start);
+
+			printf("%s %5ld %5d %5d %s %15lld   %s\n",
+				dev->ro ? "ro" : "rw", dev->ra, dev->ssz,
+				dev->bsz, start_str, dev->bytes, dev->name);
+		}
+	}
+
+	if (json) {
+		ul_jsonwrt_array_close(&fmt);
+		ul_jsonwrt_root_close(&fmt);
+	}
+}
+
 static void report_header(void)
 {
 	printf(_("RO    RA   SSZ   BSZ        StartSec            Size   Device\n"));
@@ -99,11 +99,17 @@ struct fsck_fs_data
 {
 	const char	*device;
 	dev_t		disk;
-	unsigned int	stacked:1,
-			done:1,
-			eval_device:1;
+	dev_t		*pdisks;	/* physical disks below the device */
+	size_t		npdisks;
+	uint64_t	size;		/* device size in bytes */
+	unsigned int	done:1,
+			eval_device:1,
+			eval_size:1;
 };
 
+/* max number of stacked device layers (e.g. dm-crypt on LVM on MD) */
+#define FSCK_MAX_STACK_DEPTH	8
+
 /*
  * Structure to allow exit codes to be stored
  */
@@ -166,7 +172,7 @@ static char *fsck_path;
 static struct libmnt_table *fstab, *mtab;
 static struct libmnt_cache *mntcache;
 
-static int count_slaves(dev_t disk);
+static void add_physical_disks(struct fsck_fs_data *data, dev_t devno, int depth);
 
 static int string_to_int(const char *s)
 {
@@ -283,17 +289,51 @@ static dev_t fs_get_disk(struct libmnt_fs *fs, int check)
 	if (!stat(device, &st) &&
 	    !blkid_devno_to_wholedisk(st.st_rdev, NULL, 0, &data->disk)) {
 
-		if (data->disk)
-			data->stacked = count_slaves(data->disk) > 0 ? 1 : 0;
+		if (data->disk && !data->npdisks)
+			add_physical_disks(data, data->disk, 0);
 		return data->disk;
 	}
 	return 0;
 }
 
-static int fs_is_stacked(struct libmnt_fs *fs)
+/* Returns the size of the filesystem device in bytes or 0. */
+static uint64_t fs_get_size(struct libmnt_fs *fs)
 {
-	struct fsck_fs_data *data = mnt_fs_get_userdata(fs);
-	return data ? data->stacked : 0;
+	struct fsck_fs_data *data;
+	const char *device;
+	struct stat st;
+
+	data = mnt_fs_get_userdata(fs);
+	if (data && data->eval_size)
+		return data->size;
+
+	data = fs_create_data(fs);
+	data->eval_size = 1;
+
+	if (mnt_fs_is_netfs(fs) || mnt_fs_is_pseudofs(fs))
+		return 0;
+
+	device = fs_get_device(fs);
+	if (!device || stat(device, &st) != 0)
+		return 0;
+
+	if (S_ISBLK(st.st_mode)) {
+		char path[PATH_MAX];
+		unsigned long long sectors;
+		FILE *f;
+
+		snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/size",
+				major(st.st_rdev), minor(st.st_rdev));
+		f = fopen(path, "r" UL_CLOEXECSTR);
+		if (f) {
+			if (fscanf(f, "%llu", &sectors) == 1)
+				data->size = sectors << 9;
+			fclose(f);
+		}
+	} else if (S_ISREG(st.st_mode))
+		data->size = st.st_size;
+
+	return data->size;
 }
 
 static int fs_is_done(struct libmnt_fs *fs)
@@ -1184,40 +1224,86 @@ static int ignore(struct libmnt_fs *fs)
 	return 0;
 }
 
-static int count_slaves(dev_t disk)
+/*
+ * Adds the physical disks below @devno to @data. Stacked devices (MD, DM,
+ * ...) are resolved by /sys/dev/block/<maj:min>/slaves/, so for example two
+ * logical volumes share a disk if their volume group uses the same disk.
+ */
+static void add_physical_disks(struct fsck_fs_data *data, dev_t devno, int depth)
 {
 	DIR *dir;
 	struct dirent *dp;
-	char dirname[PATH_MAX];
-	int count = 0;
+	char dirname[64];
+	dev_t disk = 0;
+	int nslaves = 0;
+	size_t i;
+
+	if (blkid_devno_to_wholedisk(devno, NULL, 0, &disk) || !disk)
+		disk = devno;
 
 	snprintf(dirname, sizeof(dirname),
 			"/sys/dev/block/%u:%u/slaves/",
 			major(disk), minor(disk));
 
-	if (!(dir = opendir(dirname)))
-		return -1;
-
-	while ((dp = readdir(dir)) != NULL) {
+	if (depth < FSCK_MAX_STACK_DEPTH && (dir = opendir(dirname))) {
+		while ((dp = readdir(dir)) != NULL) {
+			char path[PATH_MAX];
+			unsigned int maj, min;
+			FILE *f;
 #ifdef _DIRENT_HAVE_D_TYPE
-		if (dp->d_type != DT_UNKNOWN && dp->d_type != DT_LNK)
-			continue;
+			if (dp->d_type != DT_UNKNOWN && dp->d_type != DT_LNK)
+				continue;
 #endif
-		if (dp->d_name[0] == '.' &&
-		    ((dp->d_name[1] == 0) ||
-		     ((dp->d_name[1] == '.') && (dp->d_name[2] == 0))))
-			continue;
+			if (dp->d_name[0] == '.' &&
+			    ((dp->d_name[1] == 0) ||
+			     ((dp->d_name[1] == '.') && (dp->d_name[2] == 0))))
+				continue;
 
-		count++;
+			snprintf(path, sizeof(path), "%s%s/dev", dirname, dp->d_name);
+			f = fopen(path, "r" UL_CLOEXECSTR);
+			if (!f)
+				continue;
+			if (fscanf(f, "%u:%u", &maj, &min) == 2) {
+				add_physical_disks(data, makedev(maj, min), depth + 1);
+				nslaves++;
+			}
+			fclose(f);
+		}
+		closedir(dir);
 	}
 
-	closedir(dir);
-	return count;
+	if (nslaves)
+		return;
+
+	for (i = 0; i < data->npdisks; i++) {
+		if (data->pdisks[i] == disk)
+			return;
+	}
+	data->pdisks = xreallocarray(data->pdisks, data->npdisks + 1, sizeof(dev_t));
+	data->pdisks[data->npdisks++] = disk;
+}
+
+static int fs_share_disk(struct libmnt_fs *a, struct libmnt_fs *b)
+{
+	struct fsck_fs_data *da = mnt_fs_get_userdata(a);
+	struct fsck_fs_data *db = mnt_fs_get_userdata(b);
+	size_t i, j;
+
+	if (!da || !db)
+		return 1;
+
+	for (i = 0; i < da->npdisks; i++) {
+		for (j = 0; j < db->npdisks; j++) {
+			if (da->pdisks[i] == db->pdisks[j])
+				return 1;
+		}
+	}
+	return 0;
 }
 
 /*
- * Returns TRUE if a partition on the same disk is already being
- * checked.
+ * Returns TRUE if a filesystem on the same physical disk is already being
+ * checked. The stacked devices are compared by the disks below them.
  */
 static int disk_already_active(struct libmnt_fs *fs)
 {
@@ -1227,31 +1313,41 @@ static int disk_already_active(struct libmnt_fs *fs)
 	if (force_all_parallel)
 		return 0;
 
-	if (instance_list && fs_is_stacked(instance_list->fs))
-		/* any instance for a stacked device is already running */
-		return 1;
-
 	disk = fs_get_disk(fs, 1);
 
 	/*
 	 * If we don't know the base device, assume that the device is
 	 * already active if there are any fsck instances running.
-	 *
-	 * Don't check a stacked device with any other disk too.
 	 */
-	if (!disk || fs_is_stacked(fs))
+	if (!disk)
 		return (instance_list != NULL);
 
 	for (inst = instance_list; inst; inst = inst->next) {
 		dev_t idisk = fs_get_disk(inst->fs, 0);
 
-		if (!idisk || disk == idisk)
+		if (!idisk || disk == idisk || fs_share_disk(fs, inst->fs))
 			return 1;
 	}
 
 	return 0;
 }
 
+struct fsck_sched {
+	struct libmnt_fs	*fs;
+	uint64_t		size;
+	size_t			idx;	/* fstab order */
+};
+
+/* the largest filesystems first, otherwise keep the fstab order */
+static int cmp_sched(const void *a, const void *b)
+{
+	const struct fsck_sched *sa = a, *sb = b;
+
+	if (sa->size != sb->size)
+		return sa->size > sb->size ? -1 : 1;
+	return sa->idx < sb->idx ? -1 : 1;
+}
+
 /* Check all file systems, using the /etc/fstab table. */
 static int check_all(void)
 {
@@ -1262,6 +1358,8 @@ static int check_all(void)
 
 	struct libmnt_fs *fs;
 	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct fsck_sched *sched = NULL;
+	size_t i, nsched = 0;
 
 	if (!itr)
 		err(FSCK_EX_ERROR, _("failed to allocate iterator"));
@@ -1316,13 +1414,28 @@ static int check_all(void)
 		}
 	}
 
+	/*
+	 * The long checks have to start first, otherwise the last pass
+	 * waits for a large filesystem started after the small ones. The
+	 * serialized (interactive) checks follow fstab.
+	 */
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		sched = xreallocarray(sched, nsched + 1, sizeof(*sched));
+		sched[nsched].fs = fs;
+		sched[nsched].idx = nsched;
+		sched[nsched].size = serialize || fs_is_done(fs) ? 0 : fs_get_size(fs);
+		nsched++;
+	}
+	if (nsched > 1 && !serialize)
+		qsort(sched, nsched, sizeof(*sched), cmp_sched);
+
 	while (not_done_yet) {
 		not_done_yet = 0;
 		pass_done = 1;
 
-		mnt_reset_iter(itr, MNT_ITER_FORWARD);
-
-		while(mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		for (i = 0; i < nsched; i++) {
+			fs = sched[i].fs;
 
 			if (cancel_requested)
 				break;
@@ -1389,6 +1502,7 @@ static int check_all(void)
 
 	status |= wait_many(FLAG_WAIT_ATLEAST_ONE);
 	mnt_free_iter(itr);
+	free(sched);
 	return status;
 }
 
@@ -45,6 +45,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
@@ -65,6 +66,7 @@
 #include "exitcodes.h"
 #include "strutils.h"
 #include "closestream.h"
+#include "all-io.h"
 
 #define XALLOC_EXIT_CODE FSCK_EX_ERROR
 #include "xalloc.h"
@@ -76,6 +78,7 @@ static int cramfs_is_big_endian = 0;	/* source is big endian */
 static int opt_verbose = 0;	/* 1 = verbose (-v), 2+ = very verbose (-vv) */
 static int opt_extract = 0;	/* extract cramfs (-x) */
 static char *extract_dir = "";		/* optional extraction directory (-x) */
+static unsigned int opt_jobs = 1;	/* number of threads (-j) */
 
 #define PAD_SIZE 512
 
@@ -101,10 +104,14 @@ static size_t rombufmask = CRAMFS_ROMBUFFERMASK;
 static char *read_buffer;
 static unsigned long read_buffer_block = ~0UL;
 
+/* read and checksum size for test_crc() */
+#define CRAMFS_CRC_CHUNKSZ	(1024 * 1024)
+
 static z_stream stream;
 
 /* Prototypes */
 static void expand_fs(char *, struct cramfs_inode *);
+static void change_file_status(char *path, struct cramfs_inode *i);
 
 static char *outbuffer;
 
@@ -127,6 +134,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -y                       for compatibility only, ignored\n"), out);
 	fputs(_(" -b, --blocksize <size>   use this blocksize, defaults to page size\n"), out);
 	fputs(_("     --extract[=<dir>]    test uncompression, optionally extract into <dir>\n"), out);
+	fputs(_(" -j, --jobs <num>         number of threads for checksum and uncompression\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(26));
 
@@ -217,6 +225,58 @@ static void test_super(int *start)
 		warnx(_("old cramfs format"));
 }
 
+struct crc_chunk {
+	const unsigned char	*buf;
+	size_t			len;
+	uLong			crc;
+};
+
+static void *crc_worker(void *data)
+{
+	struct crc_chunk *ch = data;
+
+	ch->crc = crc32(crc32(0L, NULL, 0), ch->buf, ch->len);
+	return NULL;
+}
+
+/* Returns crc32 of @buf, the chunks are checksummed by opt_jobs threads. */
+static uLong crc32_buffer(const unsigned char *buf, size_t len)
+{
+	struct crc_chunk *chunks;
+	pthread_t *threads;
+	size_t chunksz, i, n = opt_jobs;
+	uLong crc;
+
+	if (n <= 1 || len < n * CRAMFS_CRC_CHUNKSZ)
+		return crc32(crc32(0L, NULL, 0), buf, len);
+
+	chunks = xcalloc(n, sizeof(struct crc_chunk));
+	threads = xcalloc(n, sizeof(pthread_t));
+	chunksz = len / n;
+
+	for (i = 0; i < n; i++) {
+		chunks[i].buf = buf + i * chunksz;
+		chunks[i].len = i + 1 < n ? chunksz : len - i * chunksz;
+	}
+	for (i = 1; i < n; i++) {
+		int rc = pthread_create(&threads[i], NULL, crc_worker, &chunks[i]);
+		if (rc) {
+			errno = rc;
+			err(FSCK_EX_ERROR, _("failed to create thread"));
+		}
+	}
+	crc_worker(&chunks[0]);
+
+	crc = chunks[0].crc;
+	for (i = 1; i < n; i++) {
+		pthread_join(threads[i], NULL);
+		crc = crc32_combine(crc, chunks[i].crc, chunks[i].len);
+	}
+	free(threads);
+	free(chunks);
+	return crc;
+}
+
 static void test_crc(int start)
 {
 	void *buf;
@@ -250,17 +310,17 @@ static void test_crc(int start)
 	if (buf != MAP_FAILED) {
 		((struct cramfs_super *)((unsigned char *) buf + start))->fsid.crc =
 		    crc32(0L, NULL, 0);
-		crc = crc32(crc, (unsigned char *) buf + start, super.size - start);
+		crc = crc32_buffer((unsigned char *) buf + start, super.size - start);
 		munmap(buf, super.size);
 	} else {
 		int retval;
 		size_t length = 0;
 
-		buf = xmalloc(4096);
+		buf = xmalloc(CRAMFS_CRC_CHUNKSZ);
 		if (lseek(fd, start, SEEK_SET) == (off_t) -1)
 			err(FSCK_EX_ERROR, _("seek on %s failed"), filename);
 		for (;;) {
-			retval = read(fd, buf, 4096);
+			retval = read_all(fd, buf, CRAMFS_CRC_CHUNKSZ);
 			if (retval < 0)
 				err(FSCK_EX_ERROR, _("cannot read %s"), filename);
 			else if (retval == 0)
@@ -426,6 +486,297 @@ static void do_uncompress(char *path, int outfd, unsigned long offset,
 		curr = next;
 	} while (size);
 }
+
+/*
+ * Parallel uncompression (-j). The directory tree is still walked by the main
+ * thread, which reads the block pointers and the compressed data of a file and
+ * queues the file. The blocks are inflated by the worker threads. The files
+ * are finished (checked, written and closed) in the original order, so the
+ * output and the error messages do not depend on the threads.
+ */
+struct uncompress_block {
+	unsigned long	src;		/* offset in job->src */
+	unsigned long	len;		/* compressed length, 0 for a hole */
+	unsigned long	out;		/* uncompressed length */
+	int		zerr;		/* zlib error */
+};
+
+struct uncompress_job {
+	char		*path;
+	int		outfd;
+	struct cramfs_inode inode;
+
+	size_t		nblocks;
+	size_t		pending;	/* blocks not inflated yet */
+	struct uncompress_block *blocks;
+
+	unsigned char	*src;		/* compressed data */
+	unsigned char	*out;		/* uncompressed data, inode.size bytes */
+
+	struct uncompress_job *next;
+};
+
+struct uncompress_queue {
+	struct uncompress_job *head;	/* the oldest not finished file */
+	struct uncompress_job *tail;
+	struct uncompress_job *cur;	/* file with blocks to inflate */
+	size_t		curblk;
+	size_t		njobs;		/* number of not finished files */
+	size_t		window;		/* max number of not finished files */
+	int		quit;
+
+	pthread_t	*threads;
+	size_t		nthreads;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;		/* new file queued */
+	pthread_cond_t	done;		/* all blocks of a file inflated */
+};
+
+static struct uncompress_queue *uqueue;
+
+static void inflate_block(z_stream *zs, unsigned char *scratch,
+			  struct uncompress_job *job, size_t n)
+{
+	struct uncompress_block *blk = &job->blocks[n];
+	unsigned long expected = min((unsigned long) blksize,
+				     (unsigned long) job->inode.size - n * blksize);
+	unsigned char *out = job->out + n * blksize;
+	int rc;
+
+	if (blk->len == 0) {
+		memset(out, 0, expected);
+		blk->out = expected;
+		return;
+	}
+
+	zs->next_in = job->src + blk->src;
+	zs->avail_in = blk->len;
+	zs->next_out = scratch;
+	zs->avail_out = blksize * 2;
+
+	inflateReset(zs);
+
+	rc = inflate(zs, Z_FINISH);
+	if (rc != Z_STREAM_END) {
+		blk->zerr = rc;
+		return;
+	}
+	blk->out = zs->total_out;
+	memcpy(out, scratch, min(blk->out, expected));
+}
+
+static void *uncompress_worker(void *data)
+{
+	struct uncompress_queue *q = data;
+	unsigned char *scratch = xmalloc(blksize * 2);
+	z_stream zs = { .next_in = NULL };
+
+	if (inflateInit(&zs) != Z_OK)
+		errx(FSCK_EX_ERROR, _("failed to initialize zlib"));
+
+	pthread_mutex_lock(&q->lock);
+	for (;;) {
+		struct uncompress_job *job;
+		size_t n;
+
+		while (!q->cur && !q->quit)
+			pthread_cond_wait(&q->work, &q->lock);
+		if (!q->cur)
+			break;
+
+		job = q->cur;
+		n = q->curblk++;
+		if (q->curblk == job->nblocks) {
+			q->cur = job->next;
+			q->curblk = 0;
+		}
+		pthread_mutex_unlock(&q->lock);
+
+		inflate_block(&zs, scratch, job, n);
+
+		pthread_mutex_lock(&q->lock);
+		if (--job->pending == 0)
+			pthread_cond_broadcast(&q->done);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	inflateEnd(&zs);
+	free(scratch);
+	return NULL;
+}
+
+static void finish_file(struct uncompress_job *job)
+{
+	unsigned long size = job->inode.size;
+	size_t n;
+
+	for (n = 0; n < job->nblocks; n++) {
+		struct uncompress_block *blk = &job->blocks[n];
+
+		if (blk->zerr)
+			errx(FSCK_EX_UNCORRECTED, _("decompression error: %s"),
+			     zError(blk->zerr));
+		if (size >= blksize) {
+			if (blk->out != blksize)
+				errx(FSCK_EX_UNCORRECTED,
+				     _("non-block (%ld) bytes"), blk->out);
+		} else {
+			if (blk->out != size)
+				errx(FSCK_EX_UNCORRECTED,
+				     _("non-size (%ld vs %ld) bytes"), blk->out,
+				     size);
+		}
+		size -= blk->out;
+	}
+
+	if (*extract_dir != '\0') {
+		if (write_all(job->outfd, job->out, job->inode.size) != 0)
+			err(FSCK_EX_ERROR, _("write failed: %s"), job->path);
+		if (close_fd(job->outfd) != 0)
+			err(FSCK_EX_ERROR, _("write failed: %s"), job->path);
+		change_file_status(job->path, &job->inode);
+	}
+
+	free(job->path);
+	free(job->blocks);
+	free(job->src);
+	free(job->out);
+	free(job);
+}
+
+/* waits for the oldest queued file and finishes it */
+static void finish_oldest_file(struct uncompress_queue *q)
+{
+	struct uncompress_job *job;
+
+	pthread_mutex_lock(&q->lock);
+	job = q->head;
+	while (job->pending)
+		pthread_cond_wait(&q->done, &q->lock);
+	q->head = job->next;
+	if (!q->head)
+		q->tail = NULL;
+	q->njobs--;
+	pthread_mutex_unlock(&q->lock);
+
+	finish_file(job);
+}
+
+static void queue_uncompress(char *path, int outfd, struct cramfs_inode *i)
+{
+	struct uncompress_queue *q = uqueue;
+	struct uncompress_job *job;
+	unsigned long offset = i->offset << 2;
+	unsigned long curr, first;
+	ssize_t x;
+	size_t n;
+
+	job = xcalloc(1, sizeof(*job));
+	job->path = xstrdup(path);
+	job->outfd = outfd;
+	job->inode = *i;
+	job->nblocks = (i->size + blksize - 1) / blksize;
+	job->pending = job->nblocks;
+	job->blocks = xcalloc(job->nblocks, sizeof(struct uncompress_block));
+
+	first = curr = offset + 4 * job->nblocks;
+
+	for (n = 0; n < job->nblocks; n++) {
+		unsigned long next = u32_toggle_endianness(cramfs_is_big_endian,
+							   *(uint32_t *)
+							   romfs_read(offset));
+		if (next > end_data)
+			end_data = next;
+
+		offset += 4;
+		if (curr == next) {
+			if (opt_verbose > 1)
+				printf(_("  hole at %lu (%zu)\n"), curr,
+				       blksize);
+		} else {
+			if (opt_verbose > 1)
+				printf(_("  uncompressing block at %lu to %lu (%lu)\n"),
+				       curr, next, next - curr);
+			if (next - curr > blksize * 2)
+				errx(FSCK_EX_UNCORRECTED, _("data block too large"));
+			job->blocks[n].src = curr - first;
+			job->blocks[n].len = next - curr;
+		}
+		curr = next;
+	}
+
+	/* all compressed blocks of the file in one read */
+	job->src = xcalloc(1, curr - first + 1);
+	x = pread(fd, job->src, curr - first, first);
+	if (x < 0)
+		warn(_("read romfs failed"));
+	job->out = xmalloc(i->size);
+
+	pthread_mutex_lock(&q->lock);
+	if (q->tail)
+		q->tail->next = job;
+	else
+		q->head = job;
+	q->tail = job;
+	if (!q->cur) {
+		q->cur = job;
+		q->curblk = 0;
+	}
+	q->njobs++;
+	pthread_cond_broadcast(&q->work);
+	pthread_mutex_unlock(&q->lock);
+
+	while (q->njobs > q->window)
+		finish_oldest_file(q);
+}
+
+static void start_uncompress_threads(void)
+{
+	struct uncompress_queue *q = xcalloc(1, sizeof(*q));
+	size_t i;
+
+	q->window = opt_jobs * 4;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->work, NULL);
+	pthread_cond_init(&q->done, NULL);
+
+	q->threads = xcalloc(opt_jobs, sizeof(pthread_t));
+	for (i = 0; i < opt_jobs; i++) {
+		int rc = pthread_create(&q->threads[i], NULL, uncompress_worker, q);
+		if (rc) {
+			errno = rc;
+			err(FSCK_EX_ERROR, _("failed to create thread"));
+		}
+		q->nthreads++;
+	}
+	uqueue = q;
+}
+
+static void stop_uncompress_threads(void)
+{
+	struct uncompress_queue *q = uqueue;
+	size_t i;
+
+	while (q->head)
+		finish_oldest_file(q);
+
+	pthread_mutex_lock(&q->lock);
+	q->quit = 1;
+	pthread_cond_broadcast(&q->work);
+	pthread_mutex_unlock(&q->lock);
+
+	for (i = 0; i < q->nthreads; i++)
+		pthread_join(q->threads[i], NULL);
+
+	pthread_cond_destroy(&q->done);
+	pthread_cond_destroy(&q->work);
+	pthread_mutex_destroy(&q->lock);
+	free(q->threads);
+	free(q);
+	uqueue = NULL;
+}
+
 static void change_file_status(char *path, struct cramfs_inode *i)
 {
 	const struct timeval epoch[] = { {0,0}, {0,0} };
@@ -543,6 +894,11 @@ static void do_file(char *path, struct cramfs_inode *i)
 		if (outfd < 0)
 			err(FSCK_EX_ERROR, _("cannot open %s"), path);
 	}
+	if (i->size && uqueue) {
+		/* closed by finish_file() */
+		queue_uncompress(path, outfd, i);
+		return;
+	}
 	if (i->size)
 		do_uncompress(path, outfd, offset, i->size);
 	if ( *extract_dir != '\0') {
@@ -655,7 +1011,11 @@ static void test_fs(int start)
 	stream.next_in = NULL;
 	stream.avail_in = 0;
 	inflateInit(&stream);
+	if (opt_jobs > 1)
+		start_uncompress_threads();
 	expand_fs(extract_dir, root);
+	if (uqueue)
+		stop_uncompress_threads();
 	inflateEnd(&stream);
 	if (start_data != ~0UL) {
 		if (start_data < (sizeof(struct cramfs_super) + start))
@@ -684,6 +1044,7 @@ int main(int argc, char **argv)
 		{"help",      no_argument,       NULL, 'h'},
 		{"blocksize", required_argument, NULL, 'b'},
 		{"extract",   optional_argument, NULL, 'x'},
+		{"jobs",      required_argument, NULL, 'j'},
 		{NULL, 0, NULL, 0},
 	};
 
@@ -696,7 +1057,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(FSCK_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt_long(argc, argv, "ayvVhb:", longopts, NULL)) != EOF)
+	while ((c = getopt_long(argc, argv, "ayvVhb:j:", longopts, NULL)) != EOF)
 		switch (c) {
 		case 'a':		/* ignore */
 		case 'y':
@@ -717,6 +1078,11 @@ int main(int argc, char **argv)
 		case 'b':
 			blksize = strtou32_or_err(optarg, _("invalid blocksize argument"));
 			break;
+		case 'j':
+			opt_jobs = strtou32_or_err(optarg, _("invalid number of jobs"));
+			if (!opt_jobs)
+				errx(FSCK_EX_USAGE, _("invalid number of jobs"));
+			break;
 		default:
 			errtryhelp(FSCK_EX_USAGE);
 		}
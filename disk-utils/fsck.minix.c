@@ -1141,11 +1141,68 @@ bad_zone(int i) {
 	return (MINIX_BLOCK_SIZE != read(device_fd, buffer, MINIX_BLOCK_SIZE));
 }
 
+/*
+ * Returns 1 if all MINIX_BITMAP_WORD_BITS counters are equal to @val (0 or 1).
+ */
+static int
+counts_equal(const unsigned char *counts, int val) {
+	const uint64_t pattern = val ? 0x0101010101010101ULL : 0;
+	size_t i;
+
+	for (i = 0; i < MINIX_BITMAP_WORD_BITS; i += sizeof(uint64_t)) {
+		uint64_t w;
+
+		memcpy(&w, counts + i, sizeof(w));
+		if (w != pattern)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Returns 1 if the word of the inode bitmap starting at @ino (aligned) and the
+ * counters are all zero, so there is nothing to check for the inodes.
+ */
+static int
+inodes_unused(unsigned long ino) {
+	if (warn_mode || ino % MINIX_BITMAP_WORD_BITS
+	    || ino + MINIX_BITMAP_WORD_BITS > get_ninodes() + 1)
+		return 0;
+
+	return minix_bitmap_word(inode_map, ino) == 0
+	       && counts_equal(inode_count + ino, 0);
+}
+
+/*
+ * Returns 1 if the word of the zone bitmap starting at @zone (the bit has to
+ * be aligned) matches the counters.
+ */
+static int
+zones_match(unsigned long zone) {
+	unsigned long bit = zone - get_first_zone() + 1;
+	uint64_t w;
+
+	if (bit % MINIX_BITMAP_WORD_BITS
+	    || zone + MINIX_BITMAP_WORD_BITS > get_nzones())
+		return 0;
+
+	w = minix_bitmap_word(zone_map, bit);
+	if (w == 0)
+		return counts_equal(zone_count + zone, 0);
+	if (w == UINT64_MAX)
+		return counts_equal(zone_count + zone, 1);
+	return 0;
+}
+
 static void
 check_counts(void) {
 	unsigned long i;
 
 	for (i = 1; i <= get_ninodes(); i++) {
+		if (inodes_unused(i)) {
+			i += MINIX_BITMAP_WORD_BITS - 1;
+			continue;
+		}
 		if (!inode_in_use(i) && Inode[i].i_mode && warn_mode) {
 			printf(_("Inode %lu mode not cleared."), i);
 			if (ask(_("Clear"), 1)) {
@@ -1177,6 +1234,10 @@ check_counts(void) {
 		}
 	}
 	for (i = get_first_zone(); i < get_nzones(); i++) {
+		if (zones_match(i)) {
+			i += MINIX_BITMAP_WORD_BITS - 1;
+			continue;
+		}
 		if (zone_in_use(i) == zone_count[i])
 			continue;
 		if (!zone_count[i]) {
@@ -1202,6 +1263,10 @@ check_counts2(void) {
 	unsigned long i;
 
 	for (i = 1; i <= get_ninodes(); i++) {
+		if (inodes_unused(i)) {
+			i += MINIX_BITMAP_WORD_BITS - 1;
+			continue;
+		}
 		if (!inode_in_use(i) && Inode2[i].i_mode && warn_mode) {
 			printf(_("Inode %lu mode not cleared."), i);
 			if (ask(_("Clear"), 1)) {
@@ -1233,6 +1298,10 @@ check_counts2(void) {
 		}
 	}
 	for (i = get_first_zone(); i < get_nzones(); i++) {
+		if (zones_match(i)) {
+			i += MINIX_BITMAP_WORD_BITS - 1;
+			continue;
+		}
 		if (zone_in_use(i) == zone_count[i])
 			continue;
 		if (!zone_count[i]) {
@@ -1393,17 +1462,16 @@ main(int argc, char **argv) {
 		check();
 	}
 	if (verbose) {
-		unsigned long inode, free;
+		unsigned long free;
 
-		for (inode = 1, free = 0; inode <= get_ninodes(); inode++)
-			if (!inode_in_use(inode))
-				free++;
+		free = get_ninodes()
+			- minix_bitmap_count(inode_map, 1, get_ninodes() + 1);
 		printf(_("\n%6ld inodes used (%ld%%)\n"),
 		       (get_ninodes() - free),
 		       100 * (get_ninodes() - free) / get_ninodes());
-		for (inode = get_first_zone(), free = 0; inode < get_nzones(); inode++)
-			if (!zone_in_use(inode))
-				free++;
+		free = get_nzones() - get_first_zone()
+			- minix_bitmap_count(zone_map, 1,
+					get_nzones() - get_first_zone() + 1);
 		printf(_("%6ld zones used (%ld%%)\n"), (get_nzones() - free),
 		       100 * (get_nzones() - free) / get_nzones());
 		printf(_("\n%6d regular files\n"
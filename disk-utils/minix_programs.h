@@ -11,7 +11,11 @@
 #ifndef UTIL_LINUX_MINIX_PROGRAMS_H
 #define UTIL_LINUX_MINIX_PROGRAMS_H
 
+#include <stdint.h>
+#include <string.h>
+
 #include "minix.h"
+#include "bitops.h"
 
 /*
  * Global variables.
@@ -125,4 +129,68 @@ static inline size_t get_inode_buffer_size(void)
 	return inode_blocks() * MINIX_BLOCK_SIZE;
 }
 
+/*
+ * Bitmap helpers, the bitmaps are processed by 64-bit words where possible.
+ * The words are only compared with zero or all-ones or counted, so the byte
+ * order does not matter.
+ */
+#define MINIX_BITMAP_WORD_BITS	64
+
+static inline uint64_t minix_bitmap_word(const char *map, unsigned long bit)
+{
+	uint64_t w;
+
+	memcpy(&w, map + bit / NBBY, sizeof(w));
+	return w;
+}
+
+static inline unsigned int minix_popcount64(uint64_t w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(w);
+#else
+	unsigned int n;
+
+	for (n = 0; w; n++)
+		w &= w - 1;
+	return n;
+#endif
+}
+
+/* returns number of set bits in range <@start, @end) */
+static inline unsigned long minix_bitmap_count(const char *map,
+					       unsigned long start,
+					       unsigned long end)
+{
+	unsigned long n = 0;
+
+	for (; start < end && start % MINIX_BITMAP_WORD_BITS; start++)
+		n += isset(map, start) ? 1 : 0;
+	for (; start + MINIX_BITMAP_WORD_BITS <= end; start += MINIX_BITMAP_WORD_BITS)
+		n += minix_popcount64(minix_bitmap_word(map, start));
+	for (; start < end; start++)
+		n += isset(map, start) ? 1 : 0;
+	return n;
+}
+
+/* sets (or clears) bits in range <@start, @end) */
+static inline void minix_bitmap_fill(char *map, unsigned long start,
+				     unsigned long end, int set)
+{
+	for (; start < end && start % NBBY; start++) {
+		if (set)
+			setbit(map, start);
+		else
+			clrbit(map, start);
+	}
+	for (; end > start && end % NBBY; end--) {
+		if (set)
+			setbit(map, end - 1);
+		else
+			clrbit(map, end - 1);
+	}
+	if (start < end)
+		memset(map + start / NBBY, set ? 0xff : 0, (end - start) / NBBY);
+}
+
 #endif				/* UTIL_LINUX_MINIX_PROGRAMS_H */
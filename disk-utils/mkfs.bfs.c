@@ -29,6 +29,7 @@
 #include "nls.h"
 #include "strutils.h"
 #include "xalloc.h"
+#include "all-io.h"
 #include "bitops.h"
 #include "exitcodes.h"
 
@@ -112,11 +113,11 @@ int main(int argc, char **argv)
 	int fd;
 	uint32_t first_block;
 	struct bfssb sb;
-	struct bfsi ri;
-	struct bfsde de;
+	struct bfsi *ri;
+	struct bfsde de[2];
 	struct stat statbuf;
 	time_t now;
-	int c, i, len;
+	int c, len;
 
 	enum {
 	    VERSION_OPTION = CHAR_MAX + 1,
@@ -282,45 +283,39 @@ int main(int argc, char **argv)
 	if (write(fd, &sb, sizeof(sb)) != sizeof(sb))
 		err(EXIT_FAILURE, _("error writing superblock"));
 
-	memset(&ri, 0, sizeof(ri));
-	ri.i_ino = cpu_to_le16(BFS_ROOT_INO);
+	/* the whole inode table is written at once, unused inodes are zeroed */
+	ri = xcalloc(inodes, sizeof(struct bfsi));
+	ri->i_ino = cpu_to_le16(BFS_ROOT_INO);
 	first_block = 1 + ino_blocks;
-	ri.i_first_block = cpu_to_le32(first_block);
-	ri.i_last_block = cpu_to_le32(first_block +
-	    (inodes * sizeof(de) - 1) / BFS_BLOCKSIZE);
-	ri.i_bytes_to_end = cpu_to_le32(first_block * BFS_BLOCKSIZE
+	ri->i_first_block = cpu_to_le32(first_block);
+	ri->i_last_block = cpu_to_le32(first_block +
+	    (inodes * sizeof(struct bfsde) - 1) / BFS_BLOCKSIZE);
+	ri->i_bytes_to_end = cpu_to_le32(first_block * BFS_BLOCKSIZE
 	    + 2 * sizeof(struct bfsde) - 1);
-	ri.i_type = cpu_to_le32(BFS_DIR_TYPE);
-	ri.i_mode = cpu_to_le32(S_IFDIR | 0755);	/* or just 0755 */
-	ri.i_uid = cpu_to_le32(0);
-	ri.i_gid = cpu_to_le32(1);			/* random */
-	ri.i_nlinks = 2;
+	ri->i_type = cpu_to_le32(BFS_DIR_TYPE);
+	ri->i_mode = cpu_to_le32(S_IFDIR | 0755);	/* or just 0755 */
+	ri->i_uid = cpu_to_le32(0);
+	ri->i_gid = cpu_to_le32(1);			/* random */
+	ri->i_nlinks = 2;
 	time(&now);
-	ri.i_atime = cpu_to_le32(now);
-	ri.i_mtime = cpu_to_le32(now);
-	ri.i_ctime = cpu_to_le32(now);
+	ri->i_atime = cpu_to_le32(now);
+	ri->i_mtime = cpu_to_le32(now);
+	ri->i_ctime = cpu_to_le32(now);
 
-	if (write(fd, &ri, sizeof(ri)) != sizeof(ri))
-		err(EXIT_FAILURE, _("error writing root inode"));
-
-	memset(&ri, 0, sizeof(ri));
-	for (i = 1; i < inodes; i++)
-		if (write(fd, &ri, sizeof(ri)) != sizeof(ri))
-			err(EXIT_FAILURE, _("error writing inode"));
+	if (write_all(fd, ri, inodes * sizeof(struct bfsi)))
+		err(EXIT_FAILURE, _("error writing inode"));
+	free(ri);
 
 	if (lseek(fd, (1 + ino_blocks) * BFS_BLOCKSIZE, SEEK_SET) == -1)
 		err(EXIT_FAILURE, _("seek error"));
 
-	memset(&de, 0, sizeof(de));
-	de.d_ino = cpu_to_le16(BFS_ROOT_INO);
-	memcpy(de.d_name, ".", 1);
-	if (write(fd, &de, sizeof(de)) != sizeof(de))
+	memset(de, 0, sizeof(de));
+	de[0].d_ino = de[1].d_ino = cpu_to_le16(BFS_ROOT_INO);
+	memcpy(de[0].d_name, ".", 1);
+	memcpy(de[1].d_name, "..", 2);
+	if (write_all(fd, de, sizeof(de)))
 		err(EXIT_FAILURE, _("error writing . entry"));
 
-	memcpy(de.d_name, "..", 2);
-	if (write(fd, &de, sizeof(de)) != sizeof(de))
-		err(EXIT_FAILURE, _("error writing .. entry"));
-
 	if (close_fd(fd) != 0)
 		err(EXIT_FAILURE, _("error closing %s"), device);
 
@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <string.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <zconf.h>
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
@@ -68,6 +69,7 @@ static int verbose = 0;
 static unsigned int blksize = 0; /* settable via -b option, default page size */
 static long total_blocks = 0, total_nodes = 1; /* pre-count the root node */
 static int image_length = 0;
+static unsigned int opt_jobs = 1;
 static int cramfs_is_big_endian = 0; /* target is big endian */
 
 /*
@@ -95,6 +97,7 @@ static int warn_uid = 0;
 /* entry.flags */
 #define CRAMFS_EFLAG_MD5	1
 #define CRAMFS_EFLAG_INVALID	2
+#define CRAMFS_EFLAG_COMPRESSED	4
 
 /* In-core version of inode / directory entry. */
 struct entry {
@@ -110,6 +113,8 @@ struct entry {
 	struct entry *same;	    /* points to other identical file */
 	unsigned int offset;        /* pointer to compressed data in archive */
 	unsigned int dir_offset;    /* offset of directory entry in archive */
+	char *cdata;		    /* compressed data, see compress_entry() */
+	unsigned int csize;	    /* size of cdata */
 
 	/* organization */
 	struct entry *child;	    /* NULL for non-directory and empty dir */
@@ -128,7 +133,7 @@ struct entry {
 static void __attribute__((__noreturn__)) usage(void)
 {
 	fputs(USAGE_HEADER, stdout);
-	fprintf(stdout, _(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-n name] dirname outfile\n"),
+	fprintf(stdout, _(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-j jobs] [-n name] dirname outfile\n"),
 		program_invocation_short_name);
 	fputs(USAGE_SEPARATOR, stdout);
 	fputsln(_("Make compressed ROM file system."), stdout);
@@ -139,6 +144,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_(  " -e edition     set edition number (part of fsid)"), stdout);
 	fprintf(stdout, _(" -N endian      set cramfs endianness (%s|%s|%s), default %s\n"), "big", "little", "host", "host");
 	fputsln(_(  " -i file        insert a file image into the filesystem"), stdout);
+	fputsln(_(  " -j jobs        number of compression threads"), stdout);
 	fputsln(_(  " -n name        set name of cramfs filesystem"), stdout);
 	fprintf(stdout, _(" -p             pad by %d bytes for boot code\n"), PAD_SIZE);
 	fputsln(_(  " -s             sort directory entries (old option, ignored)"), stdout);
@@ -248,38 +254,102 @@ identical_file(struct entry *e1, struct entry *e2){
  */
 #define MAX_INPUT_NAMELEN 255
 
-static int find_identical_file(struct entry *orig, struct entry *new, loff_t *fslen_ub)
+static void collect_files(struct entry *e, struct entry ***files, size_t *nfiles)
 {
-	if (orig == new)
-		return 1;
-	if (!orig)
-		return 0;
-	if (orig->size == new->size && orig->path) {
-		if (!orig->flags)
-			mdfile(orig);
-		if (!new->flags)
-			mdfile(new);
-
-		if ((orig->flags & CRAMFS_EFLAG_MD5) &&
-		    (new->flags & CRAMFS_EFLAG_MD5) &&
-		    !memcmp(orig->md5sum, new->md5sum, UL_MD5LENGTH) &&
-		    identical_file(orig, new)) {
-			new->same = orig;
-			*fslen_ub -= new->size;
-			return 1;
+	for (; e; e = e->next) {
+		if (e->path && e->size) {
+			*files = xreallocarray(*files, *nfiles + 1, sizeof(struct entry *));
+			(*files)[(*nfiles)++] = e;
 		}
+		if (e->child)
+			collect_files(e->child, files, nfiles);
 	}
-	return find_identical_file(orig->child, new, fslen_ub) ||
-		   find_identical_file(orig->next, new, fslen_ub);
 }
 
-static void eliminate_doubles(struct entry *root, struct entry *orig, loff_t *fslen_ub) {
-	if (orig) {
-		if (orig->size && orig->path)
-			find_identical_file(root,orig, fslen_ub);
-		eliminate_doubles(root,orig->child, fslen_ub);
-		eliminate_doubles(root,orig->next, fslen_ub);
+/* sort by size and keep the tree order for files of the same size */
+static int cmp_entry_size(const void *a, const void *b)
+{
+	const struct entry *e1 = *(struct entry * const *) a;
+	const struct entry *e2 = *(struct entry * const *) b;
+
+	if (e1->size != e2->size)
+		return e1->size < e2->size ? -1 : 1;
+	return e1->dir_offset < e2->dir_offset ? -1 :
+	       e1->dir_offset > e2->dir_offset ? 1 : 0;
+}
+
+static int cmp_entry_md5(const void *a, const void *b)
+{
+	const struct entry *e1 = *(struct entry * const *) a;
+	const struct entry *e2 = *(struct entry * const *) b;
+	int rc = memcmp(e1->md5sum, e2->md5sum, UL_MD5LENGTH);
+
+	if (rc)
+		return rc;
+	return e1->dir_offset < e2->dir_offset ? -1 :
+	       e1->dir_offset > e2->dir_offset ? 1 : 0;
+}
+
+/*
+ * Links every file to the first identical file in the tree. Only files of the
+ * same size are checksummed, and only files with the same checksum are
+ * compared.
+ */
+static void eliminate_doubles(struct entry *root, loff_t *fslen_ub)
+{
+	struct entry **files = NULL;
+	size_t nfiles = 0, i, j, k, g;
+
+	collect_files(root, &files, &nfiles);
+
+	/* dir_offset is not used yet, borrow it for the tree order */
+	for (i = 0; i < nfiles; i++)
+		files[i]->dir_offset = i;
+
+	qsort(files, nfiles, sizeof(struct entry *), cmp_entry_size);
+
+	for (i = 0; i < nfiles; i = j) {
+		size_t n = 0;
+
+		for (j = i + 1; j < nfiles && files[j]->size == files[i]->size; j++);
+		if (j - i < 2)
+			continue;
+
+		/* move files with a checksum to the begin of the bucket */
+		for (k = i; k < j; k++) {
+			mdfile(files[k]);
+			if (files[k]->flags & CRAMFS_EFLAG_MD5) {
+				struct entry *tmp = files[i + n];
+
+				files[i + n++] = files[k];
+				files[k] = tmp;
+			}
+		}
+		qsort(files + i, n, sizeof(struct entry *), cmp_entry_md5);
+
+		for (g = i, k = i + 1; k < i + n; k++) {
+			struct entry *new = files[k];
+			size_t o;
+
+			if (memcmp(files[g]->md5sum, new->md5sum, UL_MD5LENGTH)) {
+				g = k;		/* next group of checksums */
+				continue;
+			}
+			for (o = g; o < k; o++) {
+				struct entry *orig = files[o];
+
+				if (!orig->same && identical_file(orig, new)) {
+					new->same = orig;
+					*fslen_ub -= new->size;
+					break;
+				}
+			}
+		}
 	}
+
+	for (i = 0; i < nfiles; i++)
+		files[i]->dir_offset = 0;
+	free(files);
 }
 
 /*
@@ -565,32 +635,31 @@ static int is_zero(unsigned char const *begin, unsigned len)
  * so the i'th pointer points to the end of the i'th block
  * (i.e. the start of the (i+1)'th block or past EOF).
  *
+ * The data are compressed to a private buffer (entry->cdata) with block
+ * pointers relative to the begin of the buffer and in host byte order;
+ * write_compressed() relocates them when it copies the data to the image.
+ * This allows to compress more files in parallel.
+ *
  * Note that size > 0, as a zero-sized file wouldn't ever
  * have gotten here in the first place.
  */
-static unsigned int
-do_compress(char *base, unsigned int offset, unsigned char const *name,
-	    char *path, unsigned int size, unsigned int mode)
+static void compress_entry(struct entry *e)
 {
-	unsigned long original_size, original_offset, new_size, blocks, curr;
-	long change;
-	char *start;
+	unsigned long size = e->size, blocks, curr, i;
+	char *start, *base;
 	Bytef *p;
 
 	/* get uncompressed data */
-	start = do_mmap(path, size, mode);
+	start = do_mmap(e->path, e->size, e->mode);
 	if (start == NULL)
-		return offset;
+		return;
 	p = (Bytef *) start;
 
-	original_size = size;
-	original_offset = offset;
 	blocks = (size - 1) / blksize + 1;
-	curr = offset + 4 * blocks;
-
-	total_blocks += blocks;
+	base = xmalloc(4 * blocks + blocks * 2 * blksize + 3);
+	curr = 4 * blocks;
 
-	do {
+	for (i = 0; i < blocks; i++) {
 		uLongf len = 2 * blksize;
 		uLongf input = size;
 		if (input > blksize)
@@ -610,25 +679,107 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
 			exit(MKFS_EX_ERROR);
 		}
 
-		*(uint32_t *) (base + offset) = u32_toggle_endianness(cramfs_is_big_endian, curr);
-		offset += 4;
-	} while (size);
+		((uint32_t *) base)[i] = curr;
+	}
+
+	do_munmap(start, e->size, e->mode);
+
+	while (curr & 3)
+		base[curr++] = '\0';
+
+	e->cdata = xrealloc(base, curr);
+	e->csize = curr;
+}
+
+static unsigned int
+write_compressed(struct entry *e, char *base, unsigned int offset)
+{
+	unsigned long blocks, i;
+	long change;
+
+	if (!e->cdata)
+		return offset;		/* unreadable file */
+
+	blocks = (e->size - 1) / blksize + 1;
+	total_blocks += blocks;
+
+	memcpy(base + offset, e->cdata, e->csize);
+	for (i = 0; i < blocks; i++) {
+		uint32_t *ptr = (uint32_t *) (base + offset) + i;
 
-	do_munmap(start, original_size, mode);
+		*ptr = u32_toggle_endianness(cramfs_is_big_endian, *ptr + offset);
+	}
 
-	curr = (curr + 3) & ~3;
-	new_size = curr - original_offset;
 	/* TODO: Arguably, original_size in these 2 lines should be
 	   st_blocks * 512.  But if you say that, then perhaps
 	   administrative data should also be included in both. */
-	change = new_size - original_size;
+	change = (long) e->csize - (long) e->size;
 	if (verbose)
 		printf(_("%6.2f%% (%+ld bytes)\t%s\n"),
-		       (change * 100) / (double) original_size, change, name);
+		       (change * 100) / (double) e->size, change, e->name);
 
-	return curr;
+	offset += e->csize;
+	free(e->cdata);
+	e->cdata = NULL;
+	return offset;
 }
 
+/*
+ * Files are compressed by opt_jobs threads in the order they are written to
+ * the image. The number of compressed, but not yet written files is limited
+ * to keep the memory usage low.
+ */
+struct compress_queue {
+	struct entry	**files;
+	size_t		nfiles;
+	size_t		next;		/* next file to compress */
+	size_t		written;	/* number of files written to the image */
+	size_t		window;		/* max files ahead of "written" */
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	compressed;	/* a file has been compressed */
+	pthread_cond_t	consumed;	/* a file has been written */
+};
+
+static void *compress_worker(void *data)
+{
+	struct compress_queue *q = data;
+
+	pthread_mutex_lock(&q->lock);
+	for (;;) {
+		struct entry *e;
+
+		while (q->next < q->nfiles && q->next >= q->written + q->window)
+			pthread_cond_wait(&q->consumed, &q->lock);
+		if (q->next >= q->nfiles)
+			break;
+
+		e = q->files[q->next++];
+		pthread_mutex_unlock(&q->lock);
+
+		compress_entry(e);
+
+		pthread_mutex_lock(&q->lock);
+		e->flags |= CRAMFS_EFLAG_COMPRESSED;
+		pthread_cond_broadcast(&q->compressed);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return NULL;
+}
+
+static void collect_data(struct entry *e, struct entry ***files, size_t *nfiles)
+{
+	for (; e; e = e->next) {
+		if (e->path) {
+			if (!e->same && e->size) {
+				*files = xreallocarray(*files, *nfiles + 1,
+						       sizeof(struct entry *));
+				(*files)[(*nfiles)++] = e;
+			}
+		} else if (e->child)
+			collect_data(e->child, files, nfiles);
+	}
+}
 
 /*
  * Traverse the entry tree, writing data for every item that has
@@ -636,7 +787,9 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
  * regfile).
  */
 static unsigned int
-write_data(struct entry *entry, char *base, unsigned int offset) {
+write_data(struct entry *entry, char *base, unsigned int offset,
+	   struct compress_queue *q)
+{
 	struct entry *e;
 
 	for (e = entry; e; e = e->next) {
@@ -647,15 +800,70 @@ write_data(struct entry *entry, char *base, unsigned int offset) {
 			} else if (e->size) {
 				set_data_offset(e, base, offset);
 				e->offset = offset;
-				offset = do_compress(base, offset, e->name,
-						     e->path, e->size,e->mode);
+
+				if (!q) {
+					compress_entry(e);
+					offset = write_compressed(e, base, offset);
+					continue;
+				}
+				pthread_mutex_lock(&q->lock);
+				while (!(e->flags & CRAMFS_EFLAG_COMPRESSED))
+					pthread_cond_wait(&q->compressed, &q->lock);
+				pthread_mutex_unlock(&q->lock);
+
+				offset = write_compressed(e, base, offset);
+
+				pthread_mutex_lock(&q->lock);
+				q->written++;
+				pthread_cond_broadcast(&q->consumed);
+				pthread_mutex_unlock(&q->lock);
 			}
 		} else if (e->child)
-			offset = write_data(e->child, base, offset);
+			offset = write_data(e->child, base, offset, q);
 	}
 	return offset;
 }
 
+static unsigned int
+write_all_data(struct entry *root, char *base, unsigned int offset)
+{
+	struct compress_queue q = { .window = 0 };
+	pthread_t *threads;
+	unsigned int i, nthreads = 0;
+	int rc;
+
+	if (opt_jobs <= 1)
+		return write_data(root, base, offset, NULL);
+
+	collect_data(root, &q.files, &q.nfiles);
+	q.window = opt_jobs * 4;
+	pthread_mutex_init(&q.lock, NULL);
+	pthread_cond_init(&q.compressed, NULL);
+	pthread_cond_init(&q.consumed, NULL);
+
+	threads = xcalloc(opt_jobs, sizeof(pthread_t));
+	for (i = 0; i < opt_jobs; i++) {
+		rc = pthread_create(&threads[i], NULL, compress_worker, &q);
+		if (rc) {
+			errno = rc;
+			err(MKFS_EX_ERROR, _("failed to create thread"));
+		}
+		nthreads++;
+	}
+
+	offset = write_data(root, base, offset, &q);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_cond_destroy(&q.consumed);
+	pthread_cond_destroy(&q.compressed);
+	pthread_mutex_destroy(&q.lock);
+	free(threads);
+	free(q.files);
+	return offset;
+}
+
 static unsigned int write_file(char *file, char *base, unsigned int offset)
 {
 	int fd;
@@ -735,7 +943,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(MKFS_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt(argc, argv, "hb:Ee:i:n:N:l::psVvz")) != EOF) {
+	while ((c = getopt(argc, argv, "hb:Ee:i:j:n:N:l::psVvz")) != EOF) {
 		switch (c) {
 		case 'h':
 			usage();
@@ -766,6 +974,11 @@ int main(int argc, char **argv)
 			image_length = st.st_size; /* may be padded later */
 			fslen_ub += (image_length + 3); /* 3 is for padding */
 			break;
+		case 'j':
+			opt_jobs = strtou32_or_err(optarg, _("invalid number of jobs"));
+			if (!opt_jobs)
+				errx(MKFS_EX_USAGE, _("invalid number of jobs"));
+			break;
 		case 'l':
                         lockmode = "1";
 			if (optarg) {
@@ -824,7 +1037,7 @@ int main(int argc, char **argv)
 	root_entry->size = parse_directory(root_entry, dirname, &root_entry->child, &fslen_ub);
 
 	/* find duplicate files */
-	eliminate_doubles(root_entry,root_entry, &fslen_ub);
+	eliminate_doubles(root_entry, &fslen_ub);
 
 	/* always allocate a multiple of blksize bytes because that's
 	   what we're going to write later on */
@@ -876,7 +1089,7 @@ int main(int argc, char **argv)
 	if (verbose)
 		printf(_("Directory data: %zd bytes\n"), offset);
 
-	offset = write_data(root_entry, rom_image, offset);
+	offset = write_all_data(root_entry, rom_image, offset);
 
 	/* We always write a multiple of blksize bytes, so that
 	   losetup works. */
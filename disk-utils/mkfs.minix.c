@@ -501,7 +501,7 @@ static void super_set_magic(const struct fs_control *ctl)
 }
 
 static void setup_tables(const struct fs_control *ctl) {
-	unsigned long inodes, zmaps, imaps, zones, i;
+	unsigned long inodes, zmaps, imaps, zones;
 
 	super_block_buffer = xcalloc(1, MINIX_BLOCK_SIZE);
 
@@ -562,10 +562,9 @@ static void setup_tables(const struct fs_control *ctl) {
 	memset(inode_map,0xff,imaps * MINIX_BLOCK_SIZE);
 	memset(zone_map,0xff,zmaps * MINIX_BLOCK_SIZE);
 
-	for (i = get_first_zone() ; i<zones ; i++)
-		unmark_zone(i);
-	for (i = MINIX_ROOT_INO ; i<=inodes; i++)
-		unmark_inode(i);
+	/* the same as unmark_zone() and unmark_inode() for all items */
+	minix_bitmap_fill(zone_map, 1, zones - get_first_zone() + 1, 0);
+	minix_bitmap_fill(inode_map, MINIX_ROOT_INO, inodes + 1, 0);
 
 	inode_buffer = xmalloc(get_inode_buffer_size());
 	memset(inode_buffer,0, get_inode_buffer_size());
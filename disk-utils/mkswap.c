@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <assert.h>
+#include <pthread.h>
 #ifdef HAVE_LIBSELINUX
 # include <selinux/selinux.h>
 # include <selinux/context.h>
@@ -50,6 +51,8 @@
 #include "ismounted.h"
 #include "optutils.h"
 #include "bitops.h"
+#include "monotonic.h"
+#include "statfs_magic.h"
 
 #ifdef HAVE_LIBUUID
 # include <uuid.h>
@@ -94,10 +97,14 @@ struct mkswap_control {
 
 	enum ENDIANNESS         endianness;
 
+	size_t			jobs;		/* --jobs, parallel reads for --check */
+
 	unsigned int		check:1,	/* --check */
 				verbose:1,      /* --verbose */
 				quiet:1,        /* --quiet */
 				force:1,	/* --force */
+				progress:1,	/* --progress */
+				extents_checked:1, /* FIEMAP already verified */
 				file:1;		/* --file */
 };
 
@@ -196,6 +203,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -c, --check               check bad blocks before creating the swap area\n"), out);
+	fputs(_("     --jobs <num>          number of parallel reads for --check\n"), out);
+	fputs(_("     --progress            print progress and speed of --check\n"), out);
 	fputs(_(" -f, --force               allow swap size area be larger than device\n"), out);
 	fputs(_(" -q, --quiet               suppress output and warning messages\n"), out);
 	fputs(_(" -p, --pagesize SIZE       specify page size in bytes\n"), out);
@@ -231,39 +240,185 @@ static void page_bad(struct mkswap_control *ctl, unsigned int page)
 	ctl->nbadpages++;
 }
 
+/* size of the read request for --check */
+#define CHECK_CHUNKSZ	(4 * 1024 * 1024)
+
+struct check_queue {
+	struct mkswap_control	*ctl;
+	int			fd;
+	unsigned long long	next;		/* next page to read */
+	unsigned long long	done;		/* number of checked pages */
+	size_t			chunk;		/* pages per read */
+
+	unsigned int		*bad;		/* bad pages, unsorted */
+	size_t			nbad;
+	size_t			badsz;
+
+	struct timeval		start;		/* for --progress */
+	struct timeval		last;
+
+	pthread_mutex_t		lock;
+};
+
+static void check_progress(struct check_queue *q, int final)
+{
+	struct timeval now, delta;
+	uint64_t bytes = (uint64_t) q->done * q->ctl->pagesize;
+	double secs;
+	char *sz;
+
+	gettime_monotonic(&now);
+	timersub(&now, &q->last, &delta);
+	if (!final && delta.tv_sec < 1)
+		return;
+	q->last = now;
+
+	timersub(&now, &q->start, &delta);
+	secs = delta.tv_sec + delta.tv_usec / 1000000.0;
+	sz = size_to_human_string(SIZE_SUFFIX_1LETTER,
+			secs > 0 ? (uint64_t) (bytes / secs) : bytes);
+
+	fprintf(stderr, _("\rchecking bad pages: %3d%% (%s/s)"),
+		(int) (q->done * 100 / q->ctl->npages), sz);
+	if (final)
+		fputc('\n', stderr);
+	free(sz);
+}
+
+/*
+ * Reads @npages from @page. A range which cannot be read completely is
+ * bisected, so the pages are re-read one by one only in the failed area.
+ */
+static void check_range(struct check_queue *q, char *buf,
+			unsigned long long page, size_t npages)
+{
+	size_t len = npages * q->ctl->pagesize;
+
+	if (pread(q->fd, buf, len, (off_t) page * q->ctl->pagesize) == (ssize_t) len)
+		return;
+
+	if (npages > 1) {
+		size_t half = npages / 2;
+
+		check_range(q, buf, page, half);
+		check_range(q, buf, page + half, npages - half);
+		return;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	if (q->nbad == q->badsz) {
+		q->badsz = q->badsz ? q->badsz * 2 : 64;
+		q->bad = xreallocarray(q->bad, q->badsz, sizeof(unsigned int));
+	}
+	q->bad[q->nbad++] = (unsigned int) page;
+	pthread_mutex_unlock(&q->lock);
+}
+
+static void *check_worker(void *data)
+{
+	struct check_queue *q = data;
+	size_t bufsz = q->chunk * q->ctl->pagesize;
+	void *buf = NULL;
+
+	/* O_DIRECT requires aligned buffer */
+	errno = posix_memalign(&buf, max((long) q->ctl->pagesize, sysconf(_SC_PAGESIZE)), bufsz);
+	if (errno)
+		err(EXIT_FAILURE, _("cannot allocate %zu bytes"), bufsz);
+
+	for (;;) {
+		unsigned long long page;
+		size_t n;
+
+		pthread_mutex_lock(&q->lock);
+		page = q->next;
+		n = min((unsigned long long) q->chunk, q->ctl->npages - page);
+		q->next += n;
+		pthread_mutex_unlock(&q->lock);
+		if (!n)
+			break;
+
+		check_range(q, buf, page, n);
+
+		pthread_mutex_lock(&q->lock);
+		q->done += n;
+		if (q->ctl->progress)
+			check_progress(q, 0);
+		pthread_mutex_unlock(&q->lock);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static int cmp_pages(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Reads all pages in large requests, by O_DIRECT if possible, and in
+ * --jobs threads. The result is the same as by reading page by page.
+ */
 static void check_blocks(struct mkswap_control *ctl)
 {
-	unsigned int current_page = 0;
-	int do_seek = 1;
-	char *buffer;
+	struct check_queue q = { .ctl = ctl, .fd = -1 };
+	pthread_t *threads = NULL;
+	size_t i, nthreads = 0;
 
 	assert(ctl);
 	assert(ctl->fd > -1);
 
-	buffer = xmalloc(ctl->pagesize);
-	while (current_page < ctl->npages) {
-		ssize_t rc;
-		off_t offset = (off_t) current_page * ctl->pagesize;
+#ifdef O_DIRECT
+	q.fd = open(ctl->devname, O_RDONLY | O_DIRECT | O_CLOEXEC);
+#endif
+	if (q.fd < 0)
+		q.fd = ctl->fd;
+	q.chunk = max(CHECK_CHUNKSZ / ctl->pagesize, 1);
 
-		if (do_seek && lseek(ctl->fd, offset, SEEK_SET) != offset)
-			errx(EXIT_FAILURE, _("seek failed in check_blocks"));
+	pthread_mutex_init(&q.lock, NULL);
+	gettime_monotonic(&q.start);
+	q.last = q.start;
 
-		rc = read(ctl->fd, buffer, ctl->pagesize);
-		do_seek = (rc < 0 || rc != ctl->pagesize);
-		if (do_seek)
-			page_bad(ctl, current_page);
-		current_page++;
+	if (ctl->jobs > 1) {
+		nthreads = ctl->jobs - 1;
+		threads = xcalloc(nthreads, sizeof(pthread_t));
 	}
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, check_worker, &q) != 0)
+			break;
+	}
+	nthreads = i;
+
+	check_worker(&q);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	if (ctl->progress)
+		check_progress(&q, 1);
+
+	pthread_mutex_destroy(&q.lock);
+	if (q.fd != ctl->fd)
+		close(q.fd);
+
+	qsort(q.bad, q.nbad, sizeof(unsigned int), cmp_pages);
+	for (i = 0; i < q.nbad; i++)
+		page_bad(ctl, q.bad[i]);
+	free(q.bad);
 
 	if (!ctl->quiet)
 		printf(P_("%lu bad page\n", "%lu bad pages\n", ctl->nbadpages), ctl->nbadpages);
-	free(buffer);
 }
 
 
 #ifdef HAVE_LINUX_FIEMAP_H
 static void warn_extent(struct mkswap_control *ctl, const char *msg, uint64_t off)
 {
+	if (ctl->quiet)
+		goto done;
 	if (ctl->nbad_extents == 0) {
 		fputc('\n', stderr);
 		fprintf(stderr, _(
@@ -284,6 +439,7 @@ static void warn_extent(struct mkswap_control *ctl, const char *msg, uint64_t of
 		fprintf(stderr, msg, off);
 		fputc('\n', stderr);
 	}
+done:
 	ctl->nbad_extents++;
 }
 
@@ -345,11 +501,100 @@ static void check_extents(struct mkswap_control *ctl)
 		warn_extent(ctl, _("hole detected at offset %ju"),
 				(uintmax_t) last_logical);
 done:
-	if (ctl->nbad_extents)
+	if (ctl->nbad_extents && !ctl->quiet)
 		fputc('\n', stderr);
 }
+
+/*
+ * Btrfs refuses to activate swap files with copy-on-write or compressed
+ * extents. The NOCOW attribute has to be set while the file is still empty.
+ */
+static void set_nocow(struct mkswap_control *ctl)
+{
+#if defined(HAVE_SYS_STATFS_H) && defined(FS_NOCOW_FL)
+	struct statfs vfs;
+	int attr;
+
+	if (fstatfs(ctl->fd, &vfs) != 0
+	    || (unsigned long) vfs.f_type != STATFS_BTRFS_MAGIC)
+		return;
+	if (ioctl(ctl->fd, FS_IOC_GETFLAGS, &attr) != 0)
+		return;
+	if ((attr & FS_NOCOW_FL) && !(attr & FS_COMPR_FL))
+		return;
+
+	attr |= FS_NOCOW_FL;
+	attr &= ~FS_COMPR_FL;
+
+	if (ioctl(ctl->fd, FS_IOC_SETFLAGS, &attr) != 0 && !ctl->quiet)
+		warn(_("%s: cannot disable copy-on-write"), ctl->devname);
+#endif
+}
+
+static int is_compressed(struct mkswap_control *ctl)
+{
+#ifdef FS_COMPR_FL
+	int attr;
+
+	if (ioctl(ctl->fd, FS_IOC_GETFLAGS, &attr) == 0 && (attr & FS_COMPR_FL))
+		return 1;
+#endif
+	return 0;
+}
 #endif /* HAVE_LINUX_FIEMAP_H */
 
+/*
+ * Allocates blocks for a new swap file (--file --size). The kernel only
+ * needs the blocks to be allocated, unwritten extents are fine, so the file
+ * is not zeroed when the filesystem supports fallocate().
+ */
+static void allocate_file(struct mkswap_control *ctl)
+{
+	struct stat st;
+
+	if (fstat(ctl->fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), ctl->devname);
+
+#ifdef HAVE_LINUX_FIEMAP_H
+	if (st.st_size == 0)
+		set_nocow(ctl);
+#endif
+	if ((unsigned long long) st.st_size > ctl->filesz
+	    && ftruncate(ctl->fd, ctl->filesz) < 0)
+		err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
+
+#ifdef HAVE_FALLOCATE
+	if (fallocate(ctl->fd, 0, 0, ctl->filesz) == 0)
+		goto done;
+	if (errno != EOPNOTSUPP && errno != ENOSYS)
+		err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
+#endif
+#ifdef HAVE_POSIX_FALLOCATE
+	/* writes zeros if the filesystem does not support fallocate() */
+	errno = posix_fallocate(ctl->fd, 0, ctl->filesz);
+	if (errno)
+		err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
+#else
+	if (ftruncate(ctl->fd, ctl->filesz) < 0)
+		err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
+#endif
+#ifdef HAVE_FALLOCATE
+done:
+#endif
+	if (fstat(ctl->fd, &ctl->devstat) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), ctl->devname);
+
+#ifdef HAVE_LINUX_FIEMAP_H
+	if (is_compressed(ctl))
+		errx(EXIT_FAILURE, _("swap file %s is compressed"), ctl->devname);
+
+	check_extents(ctl);
+	if (ctl->nbad_extents)
+		errx(EXIT_FAILURE, _("swap file %s is not usable by kernel"), ctl->devname);
+	ctl->extents_checked = 1;
+#endif
+}
+
 /* return size in pages */
 static unsigned long long get_size(const struct mkswap_control *ctl)
 {
@@ -393,7 +638,7 @@ static void open_device(struct mkswap_control *ctl)
 		if (stat(ctl->devname, &ctl->devstat) == 0) {
 			if (!S_ISREG(ctl->devstat.st_mode))
 				err(EXIT_FAILURE, _("cannot create swap file %s: node isn't regular file"), ctl->devname);
-			if (chmod(ctl->devname, 0600) < 9)
+			if (chmod(ctl->devname, 0600) < 0)
 				err(EXIT_FAILURE, _("cannot set permissions on swap file %s"), ctl->devname);
 		}
 		ctl->fd = open(ctl->devname, O_RDWR | O_CREAT, 0600);
@@ -404,18 +649,8 @@ static void open_device(struct mkswap_control *ctl)
 	}
 	if (ctl->fd < 0)
 		err(EXIT_FAILURE, _("cannot open %s"), ctl->devname);
-	if (ctl->file && ctl->filesz) {
-		if (ftruncate(ctl->fd, ctl->filesz) < 0)
-			err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
-#ifdef HAVE_POSIX_FALLOCATE
-		errno = posix_fallocate(ctl->fd, 0, ctl->filesz);
-		if (errno)
-			err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
-#elif defined(HAVE_FALLOCATE)
-		if (fallocate(ctl->fd, 0, 0, ctl->filesz) < 0)
-			err(EXIT_FAILURE, _("couldn't allocate swap file %s"), ctl->devname);
-#endif
-	}
+	if (ctl->file && ctl->filesz)
+		allocate_file(ctl);
 
 	if (blkdev_lock(ctl->fd, ctl->devname, ctl->lockmode) != 0)
 		exit(EXIT_FAILURE);
@@ -526,7 +761,7 @@ static void write_header_to_device(struct mkswap_control *ctl)
 
 int main(int argc, char **argv)
 {
-	struct mkswap_control ctl = { .fd = -1, .endianness = ENDIANNESS_NATIVE };
+	struct mkswap_control ctl = { .fd = -1, .endianness = ENDIANNESS_NATIVE, .jobs = 1 };
 	int c, permMask;
 	uint64_t sz;
 	int version = SWAP_VERSION;
@@ -537,7 +772,9 @@ int main(int argc, char **argv)
 #endif
 	enum {
 		OPT_LOCK = CHAR_MAX + 1,
-		OPT_VERBOSE
+		OPT_VERBOSE,
+		OPT_JOBS,
+		OPT_PROGRESS
 	};
 	static const struct option longopts[] = {
 		{ "check",       no_argument,       NULL, 'c' },
@@ -555,6 +792,8 @@ int main(int argc, char **argv)
 		{ "help",        no_argument,       NULL, 'h' },
 		{ "lock",        optional_argument, NULL, OPT_LOCK },
 		{ "verbose",    no_argument,        NULL, OPT_VERBOSE },
+		{ "jobs",        required_argument, NULL, OPT_JOBS },
+		{ "progress",    no_argument,       NULL, OPT_PROGRESS },
 		{ NULL,          0, NULL, 0 }
 	};
 
@@ -639,6 +878,14 @@ int main(int argc, char **argv)
 		case OPT_VERBOSE:
 			ctl.verbose = 1;
 			break;
+		case OPT_JOBS:
+			ctl.jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!ctl.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
+		case OPT_PROGRESS:
+			ctl.progress = 1;
+			break;
 		case 'h':
 			usage();
 		default:
@@ -724,7 +971,7 @@ int main(int argc, char **argv)
 	if (ctl.check)
 		check_blocks(&ctl);
 #ifdef HAVE_LINUX_FIEMAP_H
-	if (!ctl.quiet && S_ISREG(ctl.devstat.st_mode))
+	if (!ctl.quiet && !ctl.extents_checked && S_ISREG(ctl.devstat.st_mode))
 		check_extents(&ctl);
 #endif
 
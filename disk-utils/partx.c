@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <dirent.h>
+#include <pthread.h>
 
 #include <blkid.h>
 #include <libsmartcols.h>
@@ -41,10 +42,14 @@
 #include "loopdev.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 /* this is the default upper limit, could be modified by --nr */
 #define SLICES_MAX	256
 
+/* max number of threads for --disks */
+#define PARTX_MAX_THREADS	16
+
 /* basic table settings */
 enum {
 	PARTX_RAW =		(1 << 0),
@@ -108,36 +113,61 @@ static const struct colinfo infos[] = {
 static int columns[NCOLS];
 static size_t ncolumns;
 
+/* one whole-disk device, --disks uses more of them */
+struct partx_disk {
+	char		*name;		/* whole-disk device name */
+	dev_t		devno;
+	int		fd;
+	int		lower;		/* --nr range */
+	int		upper;
+	int		rc;
+
+	struct loopdev_cxt lc;
+	unsigned int	loopdev:1;	/* associated with a file by partx */
+};
+
+/* shared by all disks */
+struct partx_control {
+	int		what;		/* ACT_* */
+	char		*type;		/* --type */
+	unsigned int	sector_size;	/* --sector-size */
+	int		scols_flags;
+
+	struct partx_disk *disks;
+	size_t		ndisks;
+	size_t		next;		/* next disk for a thread */
+	pthread_mutex_t	lock;
+};
+
 static int verbose;
 static int partx_flags;
-static struct loopdev_cxt lc;
-static int loopdev;
 
-static void assoc_loopdev(const char *fname)
+static void assoc_loopdev(struct partx_disk *d, const char *fname)
 {
+	struct loopdev_cxt *lc = &d->lc;
 	int rc;
 
-	if (loopcxt_init(&lc, 0))
+	if (loopcxt_init(lc, 0))
 		err(EXIT_FAILURE, _("failed to initialize loopcxt"));
 
-	rc = loopcxt_find_unused(&lc);
+	rc = loopcxt_find_unused(lc);
 	if (rc)
 		err(EXIT_FAILURE, _("%s: failed to find unused loop device"),
 		    fname);
 
 	if (verbose)
 		printf(_("Trying to use '%s' for the loop device\n"),
-		       loopcxt_get_device(&lc));
+		       loopcxt_get_device(lc));
 
-	if (loopcxt_set_backing_file(&lc, fname))
+	if (loopcxt_set_backing_file(lc, fname))
 		err(EXIT_FAILURE, _("%s: failed to set backing file"), fname);
 
-	rc = loopcxt_setup_device(&lc);
+	rc = loopcxt_setup_device(lc);
 
 	if (rc == -EBUSY)
 		err(EXIT_FAILURE, _("%s: failed to set up loop device"), fname);
 
-	loopdev = 1;
+	d->loopdev = 1;
 }
 
 static inline int get_column_id(int num)
@@ -374,7 +404,7 @@ static void add_parts_warnx(const char *device, int first, int last)
 				device, first, last);
 }
 
-static int add_parts(int fd, const char *device,
+static int add_parts(int fd, const char *device, struct loopdev_cxt *lc,
 		     blkid_partlist ls, int lower, int upper)
 {
 	int i, nparts, rc, errfirst = 0, errlast = 0;
@@ -435,7 +465,7 @@ static int add_parts(int fd, const char *device,
 	 * partitions, so we should delete any extra, unwanted ones, when the -n
 	 * option is passed.
 	 */
-	if (loopdev && loopcxt_is_partscan(&lc) && (lower || upper)) {
+	if (lc && loopcxt_is_partscan(lc) && (lower || upper)) {
 		for (i = 0; i < nparts; i++) {
 			blkid_partition par = blkid_partlist_get_partition(ls, i);
 			int n = blkid_partition_get_partno(par);
@@ -752,6 +782,171 @@ static blkid_partlist get_partlist(blkid_probe pr,
 	return ls;
 }
 
+static void open_disk(struct partx_control *ctl, struct partx_disk *d)
+{
+	if (ctl->what == ACT_ADD || ctl->what == ACT_DELETE) {
+		struct stat x;
+
+		if (stat(d->name, &x))
+			errx(EXIT_FAILURE, "%s", d->name);
+
+		if  (S_ISREG(x.st_mode)) {
+			/* not a blkdev, try to associate it to a loop device */
+			if (ctl->what == ACT_DELETE)
+				errx(EXIT_FAILURE, _("%s: cannot delete partitions"),
+				     d->name);
+			if (!loopmod_supports_partscan())
+				errx(EXIT_FAILURE, _("%s: partitioned loop devices unsupported"),
+				     d->name);
+			assoc_loopdev(d, d->name);
+			free(d->name);
+			d->name = xstrdup(d->lc.device);
+		} else if (!S_ISBLK(x.st_mode))
+			errx(EXIT_FAILURE, _("%s: not a block device"), d->name);
+	}
+	if ((d->fd = open(d->name, O_RDONLY)) == -1)
+		err(EXIT_FAILURE, _("cannot open %s"), d->name);
+}
+
+static int process_disk(struct partx_control *ctl, struct partx_disk *d)
+{
+	blkid_probe pr;
+	blkid_partlist ls = NULL;
+	int rc = 0;
+
+	if (ctl->what == ACT_DELETE)
+		return del_parts(d->fd, d->name, d->devno, d->lower, d->upper);
+
+	pr = blkid_new_probe();
+	if (!pr || blkid_probe_set_device(pr, d->fd, 0, 0))
+		warnx(_("%s: failed to initialize blkid prober"),
+				d->name);
+	else {
+		if (ctl->sector_size)
+			blkid_probe_set_sectorsize(pr, ctl->sector_size);
+
+		ls = get_partlist(pr, d->name, ctl->type);
+	}
+
+	if (ls) {
+		switch (ctl->what) {
+		case ACT_SHOW:
+			rc = show_parts(ls, ctl->scols_flags, d->lower, d->upper);
+			break;
+		case ACT_LIST:
+			rc = list_parts(ls, d->lower, d->upper);
+			break;
+		case ACT_ADD:
+			rc = add_parts(d->fd, d->name, d->loopdev ? &d->lc : NULL,
+				       ls, d->lower, d->upper);
+			break;
+		case ACT_UPD:
+			rc = upd_parts(d->fd, d->name, d->devno, ls, d->lower, d->upper);
+			break;
+		case ACT_NONE:
+			break;
+		default:
+			abort();
+		}
+	} else
+		rc = 1;
+
+	blkid_free_probe(pr);
+	return rc;
+}
+
+static void *disk_worker(void *data)
+{
+	struct partx_control *ctl = data;
+
+	for (;;) {
+		struct partx_disk *d = NULL;
+
+		pthread_mutex_lock(&ctl->lock);
+		if (ctl->next < ctl->ndisks)
+			d = &ctl->disks[ctl->next++];
+		pthread_mutex_unlock(&ctl->lock);
+
+		if (!d)
+			break;
+		d->rc = process_disk(ctl, d);
+	}
+	return NULL;
+}
+
+/*
+ * The disks are independent, every thread probes a disk and calls BLKPG
+ * ioctls for it. The main thread works too.
+ */
+static void process_disks(struct partx_control *ctl)
+{
+	pthread_t threads[PARTX_MAX_THREADS];
+	size_t i, nthreads = min(ctl->ndisks, (size_t) PARTX_MAX_THREADS);
+
+	if (nthreads <= 1) {
+		disk_worker(ctl);
+		return;
+	}
+
+	pthread_mutex_init(&ctl->lock, NULL);
+	for (i = 1; i < nthreads; i++) {
+		int rc = pthread_create(&threads[i], NULL, disk_worker, ctl);
+		if (rc) {
+			errno = rc;
+			err(EXIT_FAILURE, _("failed to create thread"));
+		}
+	}
+	disk_worker(ctl);
+
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&ctl->lock);
+}
+
+/*
+ * Waits until udev processed all partitions of the disk, udev writes
+ * its database entry when the device is ready.
+ */
+static int wait_udev(struct partx_disk *d, const struct timeval *end)
+{
+	struct path_cxt *pc;
+	struct stat st;
+	int n, max, rc = 0;
+
+	if (fstat(d->fd, &st) != 0 || !S_ISBLK(st.st_mode))
+		return 0;
+	pc = ul_new_sysfs_path(st.st_rdev, NULL, NULL);
+	if (!pc)
+		return 0;
+
+	max = get_max_partno(d->name, st.st_rdev);
+
+	for (n = 1; rc == 0 && n <= max; n++) {
+		char path[PATH_MAX];
+		dev_t devno = sysfs_blkdev_partno_to_devno(pc, n);
+
+		if (!devno)
+			continue;
+		snprintf(path, sizeof(path), _PATH_UDEV_DATA "/b%u:%u",
+				major(devno), minor(devno));
+
+		while (access(path, F_OK) != 0) {
+			struct timeval now;
+
+			gettime_monotonic(&now);
+			if (timercmp(&now, end, >)) {
+				warnx(_("%s: timed out waiting for udev"), d->name);
+				rc = -1;
+				break;
+			}
+			xusleep(10000);
+		}
+	}
+
+	ul_unref_path(pc);
+	return rc;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -761,6 +956,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %s [-a|-d|-s|-u] [--nr <n:m> | <partition>] <disk>\n"),
 		program_invocation_short_name);
+	fprintf(out,
+	      _(" %s [-a|-d|-u] [--nr <n:m>] --disks <disk>...\n"),
+		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Tell the kernel about the presence and numbering of partitions.\n"), out);
@@ -771,6 +969,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -u, --update         update specified partitions or all of them\n"), out);
 	fputs(_(" -s, --show           list partitions\n\n"), out);
 	fputs(_(" -b, --bytes          print SIZE in bytes rather than in human readable format\n"), out);
+	fputs(_("     --disks          all arguments are whole disks, process them in parallel\n"), out);
 	fputs(_(" -g, --noheadings     don't print headings for --show\n"), out);
 	fputs(_(" -n, --nr <n:m>       specify the range of partitions (e.g. --nr 2:4)\n"), out);
 	fputs(_(" -o, --output <list>  define which output columns to use\n"), out);
@@ -781,6 +980,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -t, --type <type>    specify the partition type\n"), out);
 	fputs(_("     --list-types     list supported partition types and exit\n"), out);
 	fputs(_(" -v, --verbose        verbose mode\n"), out);
+	fputs(_("     --wait-udev[=<sec>]  wait until udev processes the partitions\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(22));
@@ -796,18 +996,23 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char **argv)
 {
-	int fd, c, what = ACT_NONE, lower = 0, upper = 0, rc = 0;
-	int scols_flags = 0;
+	int c, what = ACT_NONE, lower = 0, upper = 0, rc = 0;
+	int scols_flags = 0, multi = 0, wait = 0;
 	char *type = NULL;
 	char *device = NULL; /* pointer to argv[], ie: /dev/sda1 */
 	char *wholedisk = NULL; /* allocated, ie: /dev/sda */
 	char *outarg = NULL;
 	dev_t disk_devno = 0, part_devno = 0;
 	unsigned int sector_size = 0;
+	uint32_t wait_timeout = 30;
+	struct partx_control ctl = { .what = ACT_NONE };
+	size_t i;
 
 	enum {
 		OPT_LIST_TYPES = CHAR_MAX + 1,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_DISKS,
+		OPT_WAIT_UDEV
 	};
 	static const struct option long_opts[] = {
 		{ "bytes",	no_argument,       NULL, 'b' },
@@ -828,6 +1033,8 @@ int main(int argc, char **argv)
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "version",    no_argument,       NULL, 'V' },
 		{ "verbose",	no_argument,       NULL, 'v' },
+		{ "disks",	no_argument,       NULL, OPT_DISKS },
+		{ "wait-udev",	optional_argument, NULL, OPT_WAIT_UDEV },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -897,6 +1104,15 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose = 1;
 			break;
+		case OPT_DISKS:
+			multi = 1;
+			break;
+		case OPT_WAIT_UDEV:
+			wait = 1;
+			if (optarg)
+				wait_timeout = strtou32_or_err(optarg,
+						_("invalid timeout argument"));
+			break;
 		case OPT_LIST_TYPES:
 		{
 			size_t idx = 0;
@@ -934,6 +1150,26 @@ int main(int argc, char **argv)
 				   &ncolumns, column_name_to_id) < 0)
 		return EXIT_FAILURE;
 
+	if (multi) {
+		if (what != ACT_ADD && what != ACT_DELETE && what != ACT_UPD)
+			errx(EXIT_FAILURE, _("--disks is supported only with --add, --delete or --update"));
+		if (optind >= argc) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+		ctl.ndisks = argc - optind;
+		ctl.disks = xcalloc(ctl.ndisks, sizeof(struct partx_disk));
+
+		for (i = 0; i < ctl.ndisks; i++) {
+			struct partx_disk *d = &ctl.disks[i];
+
+			d->name = xstrdup(argv[optind + i]);
+			d->lower = lower;
+			d->upper = upper;
+		}
+		goto run;
+	}
+
 	/*
 	 * Note that 'partx /dev/sda1' == 'partx /dev/sda1 /dev/sda'
 	 * so assume that the device and/or disk are always the last
@@ -1005,77 +1241,51 @@ int main(int argc, char **argv)
 		printf(_("partition: %s, disk: %s, lower: %d, upper: %d\n"),
 		       device ? device : "none", wholedisk, lower, upper);
 
-	if (what == ACT_ADD || what == ACT_DELETE) {
-		struct stat x;
-
-		if (stat(wholedisk, &x))
-			errx(EXIT_FAILURE, "%s", wholedisk);
-
-		if  (S_ISREG(x.st_mode)) {
-			/* not a blkdev, try to associate it to a loop device */
-			if (what == ACT_DELETE)
-				errx(EXIT_FAILURE, _("%s: cannot delete partitions"),
-				     wholedisk);
-			if (!loopmod_supports_partscan())
-				errx(EXIT_FAILURE, _("%s: partitioned loop devices unsupported"),
-				     wholedisk);
-			assoc_loopdev(wholedisk);
-			free(wholedisk);
-			wholedisk = xstrdup(lc.device);
-		} else if (!S_ISBLK(x.st_mode))
-			errx(EXIT_FAILURE, _("%s: not a block device"), wholedisk);
+	ctl.ndisks = 1;
+	ctl.disks = xcalloc(1, sizeof(struct partx_disk));
+	ctl.disks[0].name = wholedisk;
+	ctl.disks[0].devno = disk_devno;
+	ctl.disks[0].lower = lower;
+	ctl.disks[0].upper = upper;
+run:
+	ctl.what = what;
+	ctl.type = type;
+	ctl.sector_size = sector_size;
+	ctl.scols_flags = scols_flags;
+
+	/* setup loop devices, libblkid debug, etc. before threads */
+	blkid_init_debug(0);
+	for (i = 0; i < ctl.ndisks; i++)
+		open_disk(&ctl, &ctl.disks[i]);
+
+	process_disks(&ctl);
+
+	if (wait && (what == ACT_ADD || what == ACT_UPD)
+	    && access("/run/udev/control", F_OK) == 0) {
+		struct timeval end, tmo = { .tv_sec = wait_timeout };
+
+		gettime_monotonic(&end);
+		timeradd(&end, &tmo, &end);
+
+		for (i = 0; i < ctl.ndisks; i++) {
+			if (!ctl.disks[i].rc)
+				ctl.disks[i].rc = wait_udev(&ctl.disks[i], &end);
+		}
 	}
-	if ((fd = open(wholedisk, O_RDONLY)) == -1)
-		err(EXIT_FAILURE, _("cannot open %s"), wholedisk);
-
-	if (what == ACT_DELETE)
-		rc = del_parts(fd, wholedisk, disk_devno, lower, upper);
-	else {
-		blkid_probe pr = blkid_new_probe();
-		blkid_partlist ls = NULL;
 
-		if (!pr || blkid_probe_set_device(pr, fd, 0, 0))
-			warnx(_("%s: failed to initialize blkid prober"),
-					wholedisk);
-		else {
-			if (sector_size)
-				blkid_probe_set_sectorsize(pr, sector_size);
-
-			ls = get_partlist(pr, wholedisk, type);
-		}
+	for (i = 0; i < ctl.ndisks; i++) {
+		struct partx_disk *d = &ctl.disks[i];
 
-		if (ls) {
-			switch (what) {
-			case ACT_SHOW:
-				rc = show_parts(ls, scols_flags, lower, upper);
-				break;
-			case ACT_LIST:
-				rc = list_parts(ls, lower, upper);
-				break;
-			case ACT_ADD:
-				rc = add_parts(fd, wholedisk, ls, lower, upper);
-				break;
-			case ACT_UPD:
-				rc = upd_parts(fd, wholedisk, disk_devno, ls, lower, upper);
-				break;
-			case ACT_NONE:
-				break;
-			default:
-				abort();
-			}
-		} else
+		if (d->rc)
 			rc = 1;
-
-		blkid_free_probe(pr);
+		if (d->loopdev)
+			loopcxt_deinit(&d->lc);
+		if (close_fd(d->fd) != 0)
+			err(EXIT_FAILURE, _("write failed"));
+		free(d->name);
 	}
-
-	free(wholedisk);
-
-	if (loopdev)
-		loopcxt_deinit(&lc);
-
-	if (close_fd(fd) != 0)
-		err(EXIT_FAILURE, _("write failed"));
+	free(ctl.disks);
 
 	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
 }
+
@@ -38,6 +38,8 @@
 #endif
 #include <libgen.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <stdarg.h>
 
 #include "c.h"
 #include "xalloc.h"
@@ -54,6 +56,7 @@
 
 #include "libfdisk.h"
 #include "fdisk-list.h"
+#include "jsonwrt.h"
 
 /*
  * sfdisk debug stuff (see fdisk.h and include/debug.h)
@@ -90,6 +93,7 @@ enum {
 	ACT_DISKID,
 	ACT_DELETE,
 	ACT_BACKUP_SECTORS,
+	ACT_BATCH,
 };
 
 struct sfdisk {
@@ -97,6 +101,7 @@ struct sfdisk {
 	int		partno;		/* -N <partno>, default -1 */
 	int		wipemode;	/* remove foreign signatures from disk */
 	int		pwipemode;	/* remove foreign signatures from partitions */
+	int		wipemethod;	/* FDISK_WIPEMETHOD_* */
 	const char	*lockmode;	/* as specified by --lock */
 	const char	*label;		/* --label <label> */
 	const char	*label_nested;	/* --label-nested <label> */
@@ -234,6 +239,7 @@ static void sfdisk_init(struct sfdisk *sf)
 
 	if (sf->wipemode != WIPEMODE_ALWAYS)
 		fdisk_enable_bootbits_protection(sf->cxt, 1);
+	fdisk_set_wipe_method(sf->cxt, sf->wipemethod);
 
 	if (sf->label_nested) {
 		struct fdisk_context *x = fdisk_new_nested_context(sf->cxt,
@@ -2031,6 +2037,441 @@ static int command_fdisk(struct sfdisk *sf, int argc, char **argv)
 	return rc;
 }
 
+/*
+ * sfdisk --batch[=<file>] [<device> ...]
+ *
+ * Applies scripts to many devices. All devices are verified (script is applied
+ * in-memory to read-only device) before the first write, then the changes
+ * are written by up to --jobs parallel workers.
+ */
+struct batch_job {
+	const char	*devname;
+	const char	*script;	/* script path or NULL for stdin template */
+	const char	*stage;		/* "verify" or "write" */
+	const char	*result;	/* "ok", "failed" or "skipped" */
+	char		errmsg[256];	/* the last warning */
+
+	pid_t		pid;		/* worker */
+	int		fd;		/* read end of pipe from worker */
+
+	dev_t		devno;		/* to detect duplicates */
+	ino_t		ino;
+};
+
+static int batch_ask_callback(struct fdisk_context *cxt __attribute__((__unused__)),
+			      struct fdisk_ask *ask,
+			      void *data)
+{
+	struct batch_job *job = (struct batch_job *) data;
+	const char *mesg;
+
+	switch (fdisk_ask_get_type(ask)) {
+	case FDISK_ASKTYPE_WARNX:
+	case FDISK_ASKTYPE_WARN:
+		mesg = fdisk_ask_print_get_mesg(ask);
+		if (!mesg)
+			break;
+		if (fdisk_ask_get_type(ask) == FDISK_ASKTYPE_WARN) {
+			errno = fdisk_ask_print_get_errno(ask);
+			snprintf(job->errmsg, sizeof(job->errmsg), "%s: %m", mesg);
+		} else
+			xstrncpy(job->errmsg, mesg, sizeof(job->errmsg));
+		fprintf(stderr, "%s: %s\n", job->devname, job->errmsg);
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static int __attribute__ ((__format__ (__printf__, 2, 3)))
+	batch_error(struct batch_job *job, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(job->errmsg, sizeof(job->errmsg), fmt, ap);
+	va_end(ap);
+
+	fprintf(stderr, "%s: %s\n", job->devname, job->errmsg);
+	return -EINVAL;
+}
+
+/*
+ * Assigns device and applies script to the in-memory partition table.
+ */
+static int batch_apply_script(struct sfdisk *sf, struct batch_job *job,
+			      const char *tpl, size_t tplsz, int rdonly,
+			      struct fdisk_context **res)
+{
+	struct fdisk_context *cxt;
+	struct fdisk_script *dp = NULL;
+	FILE *f = NULL;
+	int rc;
+
+	cxt = fdisk_new_context();
+	if (!cxt)
+		err(EXIT_FAILURE, _("failed to allocate libfdisk context"));
+	fdisk_set_ask(cxt, batch_ask_callback, (void *) job);
+	if (sf->wipemode != WIPEMODE_ALWAYS)
+		fdisk_enable_bootbits_protection(cxt, 1);
+
+	rc = fdisk_assign_device(cxt, job->devname, rdonly);
+	if (rc) {
+		errno = -rc;
+		rc = batch_error(job, _("cannot open: %m"));
+		goto done;
+	}
+	if (!rdonly && blkdev_lock(fdisk_get_devfd(cxt), job->devname, sf->lockmode) != 0) {
+		rc = batch_error(job, _("cannot lock device"));
+		goto done;
+	}
+	if (rdonly && !sf->noact && !sf->noreread && !sf->force
+	    && fdisk_device_is_used(cxt)) {
+		rc = batch_error(job, _("device is in use"));
+		goto done;
+	}
+
+	dp = fdisk_new_script(cxt);
+	if (!dp)
+		err(EXIT_FAILURE, _("failed to allocate script handler"));
+
+	f = job->script ? fopen(job->script, "r") : fmemopen((void *) tpl, tplsz, "r");
+	if (!f) {
+		rc = batch_error(job, _("cannot open script %s: %m"),
+				job->script ? job->script : "<stdin>");
+		goto done;
+	}
+	rc = fdisk_script_read_file(dp, f);
+	if (rc) {
+		errno = -rc;
+		rc = batch_error(job, _("failed to parse script: %m"));
+		goto done;
+	}
+
+	if (!fdisk_script_get_header(dp, "label")) {
+		const char *label;
+
+		if (sf->label)
+			label = sf->label;
+		else if (fdisk_has_label(cxt))
+			label = fdisk_label_get_name(fdisk_get_label(cxt, NULL));
+		else
+			label = "dos";
+		if (fdisk_script_set_header(dp, "label", label) != 0)
+			errx(EXIT_FAILURE, _("failed to set script header"));
+	}
+
+	rc = fdisk_apply_script(cxt, dp);
+	if (rc) {
+		if (!*job->errmsg) {
+			errno = -rc;
+			batch_error(job, _("failed to apply script: %m"));
+		}
+		goto done;
+	}
+
+	if (fdisk_get_collision(cxt))
+		fdisk_enable_wipe(cxt, sf->wipemode == WIPEMODE_ALWAYS
+				  || (fdisk_is_ptcollision(cxt)
+				      && sf->wipemode != WIPEMODE_NEVER));
+
+	if (sf->pwipemode == WIPEMODE_ALWAYS) {
+		size_t i, n = fdisk_get_npartitions(cxt);
+
+		for (i = 0; rc == 0 && i < n; i++) {
+			if (fdisk_is_partition_used(cxt, i))
+				rc = fdisk_wipe_partition(cxt, i, TRUE);
+		}
+	}
+done:
+	if (f)
+		fclose(f);
+	fdisk_unref_script(dp);
+	if (rc == 0 && res)
+		*res = cxt;
+	else
+		fdisk_unref_context(cxt);
+	return rc;
+}
+
+/* worker, writes the last error message to @fd */
+static void __attribute__((__noreturn__))
+	batch_worker(struct sfdisk *sf, struct batch_job *job,
+		     const char *tpl, size_t tplsz, int fd)
+{
+	struct fdisk_context *cxt = NULL;
+	int rc;
+
+	job->stage = "write";
+	*job->errmsg = '\0';
+
+	rc = batch_apply_script(sf, job, tpl, tplsz, 0, &cxt);
+	if (!rc) {
+		rc = fdisk_write_disklabel(cxt);
+		if (rc) {
+			errno = -rc;
+			batch_error(job, _("failed to write disklabel: %m"));
+		} else if (!sf->notell) {
+			xusleep(250000);
+			fdisk_reread_partition_table(cxt);
+		}
+	}
+	if (cxt) {
+		if (fdisk_deassign_device(cxt, sf->notell) != 0 && !rc)
+			rc = batch_error(job, _("failed to close device: %m"));
+		fdisk_unref_context(cxt);
+	}
+
+	if (*job->errmsg)
+		ignore_result( write_all(fd, job->errmsg, strlen(job->errmsg)) );
+	close(fd);
+	fflush(stderr);
+	_exit(rc ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void batch_start_worker(struct sfdisk *sf, struct batch_job *job,
+			       const char *tpl, size_t tplsz)
+{
+	int fds[2];
+
+	if (pipe(fds) != 0)
+		err(EXIT_FAILURE, _("cannot create pipe"));
+
+	fflush(stdout);
+	fflush(stderr);
+
+	job->pid = fork();
+	switch (job->pid) {
+	case -1:
+		err(EXIT_FAILURE, _("fork failed"));
+	case 0:
+		close(fds[0]);
+		batch_worker(sf, job, tpl, tplsz, fds[1]);
+	default:
+		break;
+	}
+
+	DBG(MISC, ul_debug("batch: %s: started worker %d", job->devname, (int) job->pid));
+	close(fds[1]);
+	job->fd = fds[0];
+}
+
+static int batch_finish_worker(struct batch_job *jobs, size_t njobs)
+{
+	struct batch_job *job = NULL;
+	int status = 0;
+	ssize_t sz;
+	size_t i;
+	pid_t pid;
+
+	do {
+		pid = waitpid(-1, &status, 0);
+	} while (pid < 0 && errno == EINTR);
+	if (pid < 0)
+		err(EXIT_FAILURE, _("waitpid failed"));
+
+	for (i = 0; i < njobs; i++) {
+		if (jobs[i].pid == pid) {
+			job = &jobs[i];
+			break;
+		}
+	}
+	if (!job)
+		return 0;
+
+	sz = read_all(job->fd, job->errmsg, sizeof(job->errmsg) - 1);
+	job->errmsg[sz > 0 ? sz : 0] = '\0';
+	close(job->fd);
+	job->fd = -1;
+	job->pid = 0;
+	job->stage = "write";
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+		job->result = "ok";
+	else {
+		job->result = "failed";
+		if (!*job->errmsg)
+			xstrncpy(job->errmsg, _("worker failed"), sizeof(job->errmsg));
+	}
+	DBG(MISC, ul_debug("batch: %s: worker %d done: %s",
+				job->devname, (int) pid, job->result));
+	return 1;
+}
+
+static void batch_report(struct batch_job *jobs, size_t njobs)
+{
+	struct ul_jsonwrt json;
+	size_t i;
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "batch");
+
+	for (i = 0; i < njobs; i++) {
+		struct batch_job *job = &jobs[i];
+
+		ul_jsonwrt_object_open(&json, NULL);
+		ul_jsonwrt_value_s(&json, "device", job->devname);
+		if (job->script)
+			ul_jsonwrt_value_s(&json, "script", job->script);
+		else
+			ul_jsonwrt_value_null(&json, "script");
+		ul_jsonwrt_value_s(&json, "stage", job->stage);
+		ul_jsonwrt_value_s(&json, "result", job->result);
+		if (strcmp(job->result, "failed") == 0 && *job->errmsg)
+			ul_jsonwrt_value_s(&json, "error", job->errmsg);
+		else
+			ul_jsonwrt_value_null(&json, "error");
+		ul_jsonwrt_object_close(&json);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+}
+
+static void batch_read_list(const char *filename, struct batch_job **jobs, size_t *njobs)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t sz = 0, lineno = 0;
+
+	f = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), filename);
+
+	while (getline(&line, &sz, f) != -1) {
+		char *dev, *script, *end = NULL;
+		struct batch_job *job;
+
+		lineno++;
+		dev = strtok_r(line, " \t\n", &end);
+		if (!dev || *dev == '#')
+			continue;
+		script = strtok_r(NULL, " \t\n", &end);
+		if (strtok_r(NULL, " \t\n", &end))
+			errx(EXIT_FAILURE, _("%s:%zu: unexpected data after script name"),
+					filename, lineno);
+
+		*jobs = xreallocarray(*jobs, *njobs + 1, sizeof(struct batch_job));
+		job = &(*jobs)[(*njobs)++];
+		memset(job, 0, sizeof(*job));
+		job->devname = xstrdup(dev);
+		job->script = script ? xstrdup(script) : NULL;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+}
+
+static int command_batch(struct sfdisk *sf, const char *listfile,
+			 size_t maxjobs, int argc, char **argv)
+{
+	struct batch_job *jobs = NULL;
+	size_t njobs = 0, nlisted = 0, i, nstarted = 0, nrunning = 0;
+	char *tpl = NULL;
+	size_t tplsz = 0;
+	int failed = 0, use_tpl = 0;
+
+	if (listfile)
+		batch_read_list(listfile, &jobs, &njobs);
+	nlisted = njobs;
+
+	for (i = 0; i < (size_t) argc; i++) {
+		jobs = xreallocarray(jobs, njobs + 1, sizeof(struct batch_job));
+		memset(&jobs[njobs], 0, sizeof(struct batch_job));
+		jobs[njobs++].devname = argv[i];
+	}
+	if (!njobs)
+		errx(EXIT_FAILURE, _("no disk device specified"));
+
+	for (i = 0; i < njobs; i++) {
+		jobs[i].stage = "verify";
+		jobs[i].result = "skipped";
+		jobs[i].fd = -1;
+		if (!jobs[i].script)
+			use_tpl = 1;
+	}
+
+	/* read the template only once, it is used for all devices without
+	 * own script */
+	if (use_tpl) {
+		ssize_t sz;
+
+		if (listfile && strcmp(listfile, "-") == 0)
+			errx(EXIT_FAILURE, _("cannot read both device list and script from stdin"));
+		sz = read_all_alloc(STDIN_FILENO, &tpl);
+		if (sz < 0)
+			err(EXIT_FAILURE, _("failed to read script from stdin"));
+		if (sz == 0)
+			errx(EXIT_FAILURE, _("no script on stdin"));
+		tplsz = sz;
+	}
+
+	/* verify all before the first write */
+	for (i = 0; i < njobs; i++) {
+		struct batch_job *job = &jobs[i];
+		struct stat st;
+		size_t x;
+
+		if (stat(job->devname, &st) == 0) {
+			if (S_ISBLK(st.st_mode))
+				job->devno = st.st_rdev;
+			else {
+				job->devno = st.st_dev;
+				job->ino = st.st_ino;
+			}
+			for (x = 0; x < i; x++) {
+				if (jobs[x].devno == job->devno && jobs[x].ino == job->ino)
+					break;
+			}
+			if (x < i) {
+				batch_error(job, _("device already specified as %s"),
+						jobs[x].devname);
+				job->result = "failed";
+				failed++;
+				continue;
+			}
+		}
+		if (batch_apply_script(sf, job, tpl, tplsz, 1, NULL) != 0) {
+			job->result = "failed";
+			failed++;
+		}
+	}
+	if (!failed && sf->noact) {
+		for (i = 0; i < njobs; i++)
+			jobs[i].result = "ok";
+		goto done;
+	}
+	if (failed)
+		goto done;
+
+	/* write */
+	while (nstarted < njobs || nrunning) {
+		while (nrunning < maxjobs && nstarted < njobs) {
+			batch_start_worker(sf, &jobs[nstarted++], tpl, tplsz);
+			nrunning++;
+		}
+		if (batch_finish_worker(jobs, njobs))
+			nrunning--;
+	}
+	for (i = 0; i < njobs; i++) {
+		if (strcmp(jobs[i].result, "ok") != 0)
+			failed++;
+	}
+done:
+	batch_report(jobs, njobs);
+
+	for (i = 0; i < nlisted; i++) {
+		free((char *) jobs[i].devname);
+		free((char *) jobs[i].script);
+	}
+	free(jobs);
+	free(tpl);
+	return failed ? -EINVAL : 0;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -2056,6 +2497,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -T, --list-types                  print the recognized types (see -X)\n"), out);
 	fputs(_(" -V, --verify [<dev> ...]          test whether partitions seem correct\n"), out);
 	fputs(_("     --delete <dev> [<part> ...]   delete all or specified partitions\n"), out);
+	fputs(_("     --batch[=<file>] [<dev> ...]  apply scripts to many devices (see --jobs)\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" --part-label <dev> <part> [<str>] print or change partition label\n"), out);
@@ -2079,6 +2521,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --move-data[=<typescript>] move partition data after relocation (requires -N)\n"), out);
 	fputs(_("     --move-use-fsync      use fsync after each write when move data\n"), out);
 	fputs(_(" -f, --force               disable all consistency checking\n"), out);
+	fputs(_("     --jobs <num>          maximal number of parallel writes for --batch\n"), out);
 
 	fprintf(out,
 	      _("     --color[=<when>]      colorize output (%s, %s or %s)\n"), "auto", "always", "never");
@@ -2097,6 +2540,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	      _(" -w, --wipe <mode>         wipe signatures (%s, %s or %s)\n"), "auto", "always", "never");
 	fprintf(out,
 	      _(" -W, --wipe-partitions <mode>  wipe signatures from new partitions (%s, %s or %s)\n"), "auto", "always", "never");
+	fprintf(out,
+	      _("     --wipe-method <method>    how to wipe (%s, %s or %s)\n"), "signatures", "zeroout", "discard");
 	fputs(_(" -X, --label <name>        specify label type (dos, gpt, ...)\n"), out);
 	fputs(_(" -Y, --label-nested <name> specify nested label type (dos, bsd)\n"), out);
 	fputs(USAGE_SEPARATOR, out);
@@ -2117,8 +2562,9 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char *argv[])
 {
-	const char *outarg = NULL;
+	const char *outarg = NULL, *batchfile = NULL;
 	int rc = -EINVAL, c, longidx = -1, bytes = 0;
+	size_t maxjobs = 0;
 	int colormode = UL_COLORMODE_UNDEF;
 	struct sfdisk _sf = {
 		.partno = -1,
@@ -2145,6 +2591,9 @@ int main(int argc, char *argv[])
 		OPT_NOTELL,
 		OPT_RELOCATE,
 		OPT_LOCK,
+		OPT_BATCH,
+		OPT_JOBS,
+		OPT_WIPEMETHOD,
 	};
 
 	static const struct option longopts[] = {
@@ -2153,6 +2602,7 @@ int main(int argc, char *argv[])
 		{ "backup-pt-sectors", no_argument,   NULL, 'B' },
 		{ "backup",  no_argument,       NULL, 'b' },
 		{ "backup-file", required_argument, NULL, 'O' },
+		{ "batch",   optional_argument, NULL, OPT_BATCH },
 		{ "bytes",   no_argument,	NULL, OPT_BYTES },
 		{ "color",   optional_argument, NULL, OPT_COLOR },
 		{ "lock",    optional_argument, NULL, OPT_LOCK },
@@ -2160,6 +2610,7 @@ int main(int argc, char *argv[])
 		{ "dump",    no_argument,	NULL, 'd' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "force",   no_argument,       NULL, 'f' },
+		{ "jobs",    required_argument, NULL, OPT_JOBS },
 		{ "json",    no_argument,	NULL, 'J' },
 		{ "label",   required_argument, NULL, 'X' },
 		{ "label-nested", required_argument, NULL, 'Y' },
@@ -2180,6 +2631,7 @@ int main(int argc, char *argv[])
 		{ "version", no_argument,       NULL, 'v' },
 		{ "wipe",    required_argument, NULL, 'w' },
 		{ "wipe-partitions",    required_argument, NULL, 'W' },
+		{ "wipe-method", required_argument, NULL, OPT_WIPEMETHOD },
 
 		{ "relocate", no_argument,	NULL, OPT_RELOCATE },
 
@@ -2365,6 +2817,25 @@ int main(int argc, char *argv[])
 		case OPT_RELOCATE:
 			sf->act = ACT_RELOCATE;
 			break;
+		case OPT_BATCH:
+			sf->act = ACT_BATCH;
+			batchfile = optarg;
+			break;
+		case OPT_WIPEMETHOD:
+			if (strcmp(optarg, "signatures") == 0)
+				sf->wipemethod = FDISK_WIPEMETHOD_SIGNATURES;
+			else if (strcmp(optarg, "zeroout") == 0)
+				sf->wipemethod = FDISK_WIPEMETHOD_ZEROOUT;
+			else if (strcmp(optarg, "discard") == 0)
+				sf->wipemethod = FDISK_WIPEMETHOD_DISCARD;
+			else
+				errx(EXIT_FAILURE, _("unsupported wipe method: %s"), optarg);
+			break;
+		case OPT_JOBS:
+			maxjobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			if (!maxjobs)
+				errx(EXIT_FAILURE, _("invalid jobs argument"));
+			break;
 		case OPT_LOCK:
 			sf->lockmode = "1";
 			if (optarg) {
@@ -2467,6 +2938,14 @@ int main(int argc, char *argv[])
 	case ACT_RELOCATE:
 		rc = command_relocate(sf, argc - optind, argv + optind);
 		break;
+
+	case ACT_BATCH:
+		if (!maxjobs) {
+			long n = sysconf(_SC_NPROCESSORS_ONLN);
+			maxjobs = n > 0 ? (size_t) n : 1;
+		}
+		rc = command_batch(sf, batchfile, maxjobs, argc - optind, argv + optind);
+		break;
 	}
 
 	sfdisk_deinit(sf);
@@ -64,6 +64,14 @@
 #  define BLKDISCARDZEROES _IO(0x12,124)
 # endif
 
+/* discard and zero-out, introduced in 2.6.28 (commit d30a2605) and 3.7 (commit 66ba32dc) */
+# ifndef BLKDISCARD
+#  define BLKDISCARD _IO(0x12,119)
+# endif
+# ifndef BLKZEROOUT
+#  define BLKZEROOUT _IO(0x12,127)
+# endif
+
 /* disk sequence number, introduced in 5.15 (commit 7957d93b) */
 # ifndef BLKGETDISKSEQ
 #  define BLKGETDISKSEQ _IOR(0x12, 128, uint64_t)
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 extern uint32_t ul_crc32(uint32_t seed, const unsigned char *buf, size_t len);
+extern uint32_t ul_crc32_generic(uint32_t seed, const unsigned char *buf, size_t len);
 extern uint32_t ul_crc32_exclude_offset(uint32_t seed, const unsigned char *buf, size_t len,
 		                              size_t exclude_off, size_t exclude_len);
 
@@ -56,6 +56,16 @@ extern void ul_fileeq_data_set_file(struct ul_fileeq_data *data,
 extern size_t ul_fileeq_set_size(struct ul_fileeq *eq, uint64_t filesiz,
                                  size_t readsiz, size_t memsiz);
 
+extern size_t ul_fileeq_get_digsiz(struct ul_fileeq *eq);
+extern size_t ul_fileeq_data_get_cached(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				unsigned char **digests, bool *eof);
+extern int ul_fileeq_data_set_cached(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char *intro,
+				const unsigned char *digests,
+				size_t nblocks, bool eof);
+
 extern int ul_fileeq(struct ul_fileeq *eq,
               struct ul_fileeq_data *a, struct ul_fileeq_data *b);
 
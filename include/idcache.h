@@ -19,12 +19,18 @@ struct identry {
 struct idcache {
 	struct identry	*ent;	/* first entry */
 	int		width;	/* name width */
+
+	struct identry	**hash;	/* open addressing index of the entries */
+	size_t		hashsz;	/* size of the index (power of 2) */
+	size_t		nents;	/* number of entries */
 };
 
 
 extern struct idcache *new_idcache(void);
 extern void add_gid(struct idcache *cache, unsigned long int id);
 extern void add_uid(struct idcache *cache, unsigned long int id);
+extern struct identry *add_id_entry(struct idcache *ic, unsigned long int id,
+				    const char *name);
 
 extern void free_idcache(struct idcache *ic);
 extern struct identry *get_id(struct idcache *ic, unsigned long int id);
@@ -86,6 +86,8 @@ struct loop_config {
 #define LOOPDEV_MAJOR		7	/* loop major number */
 #define LOOPDEV_DEFAULT_NNODES	8	/* default number of loop devices */
 
+struct loopdev_index;
+
 struct loopdev_iter {
 	FILE		*proc;		/* /proc/partitions */
 	DIR		*sysblock;	/* /sys/block */
@@ -126,6 +128,7 @@ struct loopdev_cxt {
 	struct path_cxt		*sysfs; /* pointer to /sys/dev/block/<maj:min>/ */
 	struct loop_config	config;	/* for GET/SET ioctl */
 	struct loopdev_iter	iter;	/* scans /sys or /dev for used/free devices */
+	struct loopdev_index	*index;	/* used devices by backing file */
 };
 
 #define UL_LOOPDEVCXT_EMPTY { .fd = -1  }
@@ -159,6 +162,9 @@ extern int loopdev_is_used(const char *device, const char *filename,
 extern char *loopdev_find_by_backing_file(const char *filename,
 				uint64_t offset, uint64_t sizelimit, int flags);
 extern int loopcxt_find_unused(struct loopdev_cxt *lc);
+extern int loopcxt_reserve_unused(struct loopdev_cxt *lc, int *nums, size_t count);
+extern int loopcxt_set_reserved_device(struct loopdev_cxt *lc, int nr);
+extern uint64_t loopdev_get_backing_blocksize(const char *filename);
 extern int loopdev_delete(const char *device);
 extern int loopdev_count_by_backing_file(const char *filename, char **loopdev);
 
@@ -184,6 +190,9 @@ extern int loopcxt_init_iterator(struct loopdev_cxt *lc, int flags);
 extern int loopcxt_deinit_iterator(struct loopdev_cxt *lc);
 extern int loopcxt_next(struct loopdev_cxt *lc);
 
+extern int loopcxt_build_index(struct loopdev_cxt *lc);
+extern void loopcxt_reset_index(struct loopdev_cxt *lc);
+
 extern int loopcxt_setup_device(struct loopdev_cxt *lc);
 extern int loopcxt_delete_device(struct loopdev_cxt *lc);
 
@@ -13,6 +13,7 @@
 #ifndef UTIL_LINUX_MBSALIGN_H
 # define UTIL_LINUX_MBSALIGN_H
 # include <stddef.h>
+# include <stdbool.h>
 
 typedef enum { MBS_ALIGN_LEFT, MBS_ALIGN_RIGHT, MBS_ALIGN_CENTER } mbs_align_t;
 
@@ -49,6 +50,7 @@ extern size_t mbsalign_with_padding (const char *src, char *dest, size_t dest_si
 extern size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz);
 extern size_t mbs_safe_width(const char *s);
 
+extern bool mbs_is_safe_ascii(const char *s, size_t bytes);
 extern size_t mbs_nwidth(const char *buf, size_t bufsz);
 extern size_t mbs_width(const char *s);
 
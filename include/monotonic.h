@@ -21,4 +21,6 @@ extern usec_t get_suspended_time(void);
 
 extern int gettime_monotonic(struct timeval *tv);
 
+extern nsec_t gettime_monotonic_nsec(void);
+
 #endif /* UTIL_LINUX_MONOTONIC_H */
@@ -204,5 +204,135 @@ static inline int fspick(int dfd, const char *pathname, unsigned int flags)
 #endif
 
 #endif /* HAVE_MOUNTFD_API && HAVE_LINUX_MOUNT_H */
+
+/*
+ * statmount() and listmount(), since Linux 6.8. The structs are private
+ * copies to be independent on kernel headers.
+ */
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#ifndef SYS_statmount
+# if defined(__NR_statmount)
+#  define SYS_statmount __NR_statmount
+# elif defined(__alpha__)
+#  define SYS_statmount 567
+# elif !defined(__mips__)
+#  define SYS_statmount 457
+# endif
+#endif
+
+#if !defined(SYS_listmount) && defined(SYS_statmount)
+# define SYS_listmount (SYS_statmount + 1)
+#endif
+
+struct ul_mnt_id_req {
+	uint32_t size;
+	uint32_t spare;
+	uint64_t mnt_id;
+	uint64_t param;
+};
+
+#define UL_MNT_ID_REQ_SIZE_VER0	24
+
+struct ul_statmount {
+	uint32_t size;			/* total size, including strings */
+	uint32_t mnt_opts;		/* [str] fs specific mount options */
+	uint64_t mask;			/* what results were written */
+	uint32_t sb_dev_major;		/* device ID */
+	uint32_t sb_dev_minor;
+	uint64_t sb_magic;		/* ..._SUPER_MAGIC */
+	uint32_t sb_flags;		/* SB_{RDONLY,SYNCHRONOUS,DIRSYNC,LAZYTIME} */
+	uint32_t fs_type;		/* [str] filesystem type */
+	uint64_t mnt_id;		/* unique ID of mount */
+	uint64_t mnt_parent_id;		/* unique ID of parent (for root == mnt_id) */
+	uint32_t mnt_id_old;		/* reused IDs used in proc/.../mountinfo */
+	uint32_t mnt_parent_id_old;
+	uint64_t mnt_attr;		/* MOUNT_ATTR_... */
+	uint64_t mnt_propagation;	/* MS_{SHARED,SLAVE,PRIVATE,UNBINDABLE} */
+	uint64_t mnt_peer_group;	/* ID of shared peer group */
+	uint64_t mnt_master;		/* mount receives propagation from this ID */
+	uint64_t propagate_from;	/* propagation from in current namespace */
+	uint32_t mnt_root;		/* [str] root of mount relative to root of fs */
+	uint32_t mnt_point;		/* [str] mountpoint relative to current root */
+	uint64_t mnt_ns_id;		/* ID of the mount namespace */
+	uint32_t fs_subtype;		/* [str] subtype of fs_type (if any) */
+	uint32_t sb_source;		/* [str] source string of the mount */
+	uint32_t opt_num;		/* number of fs options */
+	uint32_t opt_array;		/* [str] array of nul terminated fs options */
+	uint32_t opt_sec_num;		/* number of security options */
+	uint32_t opt_sec_array;		/* [str] array of nul terminated security options */
+	uint64_t __spare2[46];
+	char str[];			/* variable size part containing strings */
+};
+
+#ifndef STATMOUNT_SB_BASIC
+# define STATMOUNT_SB_BASIC		0x00000001U	/* want/got sb_... */
+#endif
+#ifndef STATMOUNT_MNT_BASIC
+# define STATMOUNT_MNT_BASIC		0x00000002U	/* want/got mnt_... */
+#endif
+#ifndef STATMOUNT_PROPAGATE_FROM
+# define STATMOUNT_PROPAGATE_FROM	0x00000004U	/* want/got propagate_from */
+#endif
+#ifndef STATMOUNT_MNT_ROOT
+# define STATMOUNT_MNT_ROOT		0x00000008U	/* want/got mnt_root  */
+#endif
+#ifndef STATMOUNT_MNT_POINT
+# define STATMOUNT_MNT_POINT		0x00000010U	/* want/got mnt_point */
+#endif
+#ifndef STATMOUNT_FS_TYPE
+# define STATMOUNT_FS_TYPE		0x00000020U	/* want/got fs_type */
+#endif
+#ifndef STATMOUNT_MNT_OPTS
+# define STATMOUNT_MNT_OPTS		0x00000080U	/* want/got mnt_opts */
+#endif
+#ifndef STATMOUNT_FS_SUBTYPE
+# define STATMOUNT_FS_SUBTYPE		0x00000100U	/* want/got fs_subtype */
+#endif
+#ifndef STATMOUNT_SB_SOURCE
+# define STATMOUNT_SB_SOURCE		0x00000200U	/* want/got sb_source */
+#endif
+
+#ifndef LSMT_ROOT
+# define LSMT_ROOT		0xffffffffffffffff	/* root mount */
+#endif
+
+static inline int ul_statmount(uint64_t mnt_id, uint64_t mask,
+			       struct ul_statmount *buf, size_t bufsize)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = mask
+	};
+
+#ifdef SYS_statmount
+	return syscall(SYS_statmount, &req, buf, bufsize, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static inline ssize_t ul_listmount(uint64_t mnt_id, uint64_t last_id,
+				   uint64_t list[], size_t num)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = last_id
+	};
+
+#ifdef SYS_listmount
+	return syscall(SYS_listmount, &req, list, num, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 #endif /* UTIL_LINUX_MOUNT_API_UTILS */
 
@@ -53,4 +53,31 @@ static inline int setns(int fd, int nstype)
 }
 # endif
 
+# ifdef HAVE_SYS_SYSCALL_H
+#  include <sys/syscall.h>
+# endif
+# ifdef SYS_clone3
+#  include <errno.h>
+#  include <signal.h>
+#  include <stdint.h>
+#  include <unistd.h>
+#  define UL_HAVE_CLONE3 1
+/* like fork(), but the child is created in the new namespaces from @flags */
+static inline pid_t ul_clone3_fork(uint64_t flags)
+{
+	struct {
+		uint64_t flags, pidfd, child_tid, parent_tid,
+			 exit_signal, stack, stack_size, tls;
+	} args = { .flags = flags, .exit_signal = SIGCHLD };
+
+	return syscall(SYS_clone3, &args, sizeof(args));
+}
+
+/* clone3() returns EINVAL for the too small arguments when supported */
+static inline int ul_have_clone3(void)
+{
+	return syscall(SYS_clone3, NULL, 0) < 0 && errno == EINVAL;
+}
+# endif
+
 #endif	/* UTIL_LINUX_NAMESPACE_H */
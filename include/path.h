@@ -13,12 +13,23 @@
 
 #include "c.h"
 
+/* cached attribute, see ul_path_enable_cache() */
+struct path_attr {
+	char	*name;
+	char	*data;		/* file content, or NULL if the file does not exist */
+	size_t	datasz;
+};
+
 struct path_cxt {
 	int	dir_fd;
 	char	*dir_path;
 
 	int	refcount;
 
+	struct path_attr *attrs;	/* cached files */
+	size_t	nattrs;
+	unsigned int cache_attrs : 1;	/* ul_path_read() uses cache */
+
 	char *prefix;
 	char path_buffer[PATH_MAX];
 
@@ -43,6 +54,8 @@ const char *ul_path_get_dir(struct path_cxt *pc);
 int ul_path_set_dialect(struct path_cxt *pc, void *data, void free_data(struct path_cxt *));
 void *ul_path_get_dialect(struct path_cxt *pc);
 
+void ul_path_enable_cache(struct path_cxt *pc, int enable);
+
 int ul_path_set_enoent_redirect(struct path_cxt *pc, int (*func)(struct path_cxt *, const char *, int *));
 int ul_path_get_dirfd(struct path_cxt *pc);
 void ul_path_close_dirfd(struct path_cxt *pc);
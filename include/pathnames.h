@@ -163,6 +163,7 @@
 #define _PATH_DEV_BYPATH	"/dev/disk/by-path"
 #define _PATH_DEV_BYPARTLABEL	"/dev/disk/by-partlabel"
 #define _PATH_DEV_BYPARTUUID	"/dev/disk/by-partuuid"
+#define _PATH_UDEV_DATA		"/run/udev/data"
 
 /* hwclock paths */
 #ifdef CONFIG_ADJTIME_PATH
@@ -184,6 +185,7 @@
 #define _PATH_RAWDEVCTL_OLD	"/dev/rawctl"
 
 #define _PATH_PROC_KERNEL	"/proc/sys/kernel"
+#define _PATH_PROC_BOOT_ID	_PATH_PROC_KERNEL "/random/boot_id"
 
 /* ipc paths */
 #define _PATH_PROC_SYSV_MSG	"/proc/sysvipc/msg"
@@ -208,6 +210,7 @@
 /* irqtop paths */
 #define _PATH_PROC_INTERRUPTS	"/proc/interrupts"
 #define _PATH_PROC_SOFTIRQS	"/proc/softirqs"
+#define _PATH_PROC_IRQ		"/proc/irq"
 #define _PATH_PROC_UPTIME	"/proc/uptime"
 
 /* kernel command line */
@@ -61,6 +61,33 @@ extern int procfs_dirent_match_uid(DIR *procfs, struct dirent *d, uid_t uid);
 extern int procfs_dirent_get_name(DIR *procfs, struct dirent *d, char *buf, size_t bufsz);
 extern int procfs_dirent_match_name(DIR *procfs, struct dirent *d, const char *name);
 
+extern int procfs_get_descendants(pid_t pid, pid_t **ary, size_t *n);
+extern int procfs_get_tasks(int (*filter)(pid_t tid, const char *comm,
+					  unsigned int flags, void *data),
+			    void *data, pid_t **ary, size_t *n);
+extern int ul_cgroup_get_tasks(const char *path, int threads, pid_t **ary, size_t *n);
+
+/*
+ * Per-worker state of procfs_walk_processes(); @pc points to /proc/<pid>
+ * and @buf is a read buffer owned by the worker.
+ */
+struct procfs_walker {
+	struct path_cxt	*pc;
+	pid_t		pid;
+	size_t		idx;		/* index of @pid in the walked PIDs */
+	size_t		worker;		/* 0 .. nworkers - 1 */
+
+	char		*buf;
+	size_t		bufsz;
+
+	void		*data;
+};
+
+extern int procfs_walk_processes(const char *prefix, const pid_t *pids, size_t npids,
+				 size_t nworkers,
+				 int (*fn)(struct procfs_walker *w), void *data);
+extern ssize_t procfs_walker_read(struct procfs_walker *w, const char *fname);
+
 extern int fd_is_procfs(int fd);
 extern char *pid_get_cmdname(pid_t pid);
 extern char *pid_get_cmdline(pid_t pid);
@@ -89,8 +89,13 @@ struct ul_pty {
 		unsigned int final_input:1;	/* drain child before writing */
 	} *child_buffer_head, *child_buffer_tail, *free_buffers;
 
+	char		*master_buf;	/* master --> stdout buffer */
+	size_t		master_bufsz;	/* grows on bulk output */
+	int		splice_pipe[2];	/* master --> pipe --> stdout */
+
 	unsigned int isterm:1,		/* is stdin terminal? */
-		     slave_echo:1;	/* keep ECHO on pty slave */
+		     slave_echo:1,	/* keep ECHO on pty slave */
+		     nosplice:1;	/* splice() unsupported */
 };
 
 void ul_pty_init_debug(int mask);
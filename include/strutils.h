@@ -212,6 +212,14 @@ enum
 
 extern char *size_to_human_string(int options, uint64_t bytes);
 
+/* buffer sizes for size_to_human_buf() and ul_u64_to_buf() */
+#define UL_HUMAN_BUFSIZ	32
+#define UL_U64_BUFSIZ	sizeof("18446744073709551615")
+
+extern char *size_to_human_buf(int options, uint64_t bytes, char *buf, size_t bufsz);
+extern char *ul_u64_to_buf(uint64_t num, char *buf, size_t bufsz);
+extern char *u64_to_string(uint64_t num);
+
 extern int string_to_idarray(const char *list, int ary[], size_t arysz,
 			   int (name2id)(const char *, size_t));
 extern int string_add_to_idarray(const char *list, int ary[],
@@ -74,10 +74,32 @@ enum {
 #define CTIME_BUFSIZ	26
 #define ISO_BUFSIZ	42
 
+/*
+ * Cache for localtime_r()/gmtime_r() of the last converted time, useful for
+ * long lists of timestamps from the same second or day. Zero-initialize.
+ */
+struct ul_tmcache {
+	time_t		sec;		/* the last converted time */
+	time_t		day;		/* begin of the day of @sec */
+	struct tm	tm;		/* broken-down @sec */
+	unsigned int	valid : 1,
+			gmt : 1,	/* @tm is UTC */
+			wholeday : 1;	/* the same UTC offset all the @day */
+};
+
+struct tm *ul_tmcache_convert(struct ul_tmcache *tc, time_t t, int gmt, struct tm *tm);
+
 int strtimeval_iso(const struct timeval *tv, int flags, char *buf, size_t bufsz);
 int strtm_iso(const struct tm *tm, int flags, char *buf, size_t bufsz);
 int strtime_iso(const time_t *t, int flags, char *buf, size_t bufsz);
 int strtimespec_iso(const struct timespec *t, int flags, char *buf, size_t bufsz);
+
+int strtimeval_iso_cached(struct ul_tmcache *tc, const struct timeval *tv,
+			  int flags, char *buf, size_t bufsz);
+int strtime_iso_cached(struct ul_tmcache *tc, const time_t *t,
+		       int flags, char *buf, size_t bufsz);
+int strtimespec_iso_cached(struct ul_tmcache *tc, const struct timespec *t,
+			   int flags, char *buf, size_t bufsz);
 int strtimespec_relative(const struct timespec *ts, char *buf, size_t bufsz);
 
 #define UL_SHORTTIME_THISYEAR_HHMM (1 << 1)
@@ -98,6 +120,11 @@ static inline usec_t timespec_to_usec(const struct timespec *t)
 	return t->tv_sec * USEC_PER_SEC + t->tv_nsec / NSEC_PER_USEC;
 }
 
+static inline nsec_t timespec_to_nsec(const struct timespec *t)
+{
+	return (nsec_t) t->tv_sec * NSEC_PER_SEC + t->tv_nsec;
+}
+
 static inline struct timeval usec_to_timeval(usec_t t)
 {
 	struct timeval r = {
@@ -8,10 +8,15 @@
 #include "mbsalign.h"
 #include "strutils.h"
 
+/*
+ * Resets the buffer, but keeps the allocated space for the next data. The
+ * area after buf->end is always zeroized, so it's enough to zeroize the
+ * used part of the buffer only.
+ */
 void ul_buffer_reset_data(struct ul_buffer *buf)
 {
-	if (buf->begin)
-		memset(buf->begin, 0, buf->sz);
+	if (buf->begin && buf->end > buf->begin)
+		memset(buf->begin, 0, buf->end - buf->begin);
 	buf->end = buf->begin;
 
 	if (buf->ptrs && buf->nptrs)
@@ -140,7 +145,13 @@ int ul_buffer_append_data(struct ul_buffer *buf, const char *data, size_t sz)
 	if (buf->begin && buf->end)
 		maxsz = buf->sz - (buf->end - buf->begin);
 	if (maxsz <= sz + 1) {
-		int rc = ul_buffer_alloc_data(buf, buf->sz + sz + 1);
+		/* grow exponentially to avoid realloc() for every append */
+		size_t need = buf->sz + sz + 1;
+		int rc;
+
+		if (buf->sz && need < buf->sz * 2)
+			need = buf->sz * 2;
+		rc = ul_buffer_alloc_data(buf, need);
 		if (rc)
 			return rc;
 	}
@@ -204,6 +215,18 @@ char *ul_buffer_get_safe_data(struct ul_buffer *buf, size_t *sz, size_t *width,
 	if (!data)
 		goto nothing;
 
+	/* printable ASCII does not need encoding */
+	wsz = strlen(data);
+	if (mbs_is_safe_ascii(data, wsz)) {
+		if (!wsz)
+			goto nothing;
+		if (width)
+			*width = wsz;
+		if (sz)
+			*sz = wsz;
+		return data;
+	}
+
 	encsz = mbs_safe_encode_size(buf->sz) + 1;
 	if (encsz > buf->encoded_sz) {
 		char *tmp = realloc(buf->encoded, encsz);
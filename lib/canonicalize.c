@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 
 #include "canonicalize.h"
 #include "pathnames.h"
@@ -29,9 +30,9 @@
  */
 char *__canonicalize_dm_name(const char *prefix, const char *ptname)
 {
-	FILE	*f;
-	size_t	sz;
-	char	path[256], name[sizeof(path) - sizeof(_PATH_DEV_MAPPER)], *res = NULL;
+	int	fd;
+	ssize_t	sz;
+	char	path[256], name[sizeof(path) - sizeof(_PATH_DEV_MAPPER)], *p;
 
 	if (!ptname || !*ptname)
 		return NULL;
@@ -40,19 +41,28 @@ char *__canonicalize_dm_name(const char *prefix, const char *ptname)
 		prefix = "";
 
 	snprintf(path, sizeof(path), "%s/sys/block/%s/dm/name", prefix, ptname);
-	if (!(f = fopen(path, "r" UL_CLOEXECSTR)))
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 		return NULL;
 
-	/* read "<name>\n" from sysfs */
-	if (fgets(name, sizeof(name), f) && (sz = strlen(name)) > 1) {
-		name[sz - 1] = '\0';
-		snprintf(path, sizeof(path), _PATH_DEV_MAPPER "/%s", name);
+	/* read "<name>\n" from sysfs, it's a one read() for sysfs attribute */
+	sz = read_all(fd, name, sizeof(name) - 1);
+	close(fd);
+	if (sz <= 0)
+		return NULL;
 
-		if ((prefix && *prefix) || access(path, F_OK) == 0)
-			res = strdup(path);
-	}
-	fclose(f);
-	return res;
+	name[sz] = '\0';
+	p = strchr(name, '\n');
+	if (p)
+		*p = '\0';
+	if (!*name)
+		return NULL;
+
+	snprintf(path, sizeof(path), _PATH_DEV_MAPPER "/%s", name);
+
+	if (*prefix || access(path, F_OK) == 0)
+		return strdup(path);
+	return NULL;
 }
 
 char *canonicalize_dm_name(const char *ptname)
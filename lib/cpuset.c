@@ -50,6 +50,60 @@ static inline int char_to_val(int c)
 	return -1;
 }
 
+/*
+ * The functions below access the set by words rather than by CPU_*_S() for
+ * each bit, the sets are usually sparse and may have thousands of bits.
+ */
+#define CPUSET_WORDBITS		(8 * sizeof(__cpu_mask))
+
+static inline size_t cpuset_nwords(size_t setsize)
+{
+	return setsize / sizeof(__cpu_mask);
+}
+
+/*
+ * Returns the index of the first bit with value @val at position @from or
+ * above, or the number of bits in the set if there is no such bit.
+ */
+static size_t cpuset_find_next(const cpu_set_t *set, size_t setsize,
+			       size_t from, int val)
+{
+	const __cpu_mask *bits = set->__bits;
+	size_t w = from / CPUSET_WORDBITS, nwords = cpuset_nwords(setsize);
+	__cpu_mask word;
+
+	if (w >= nwords)
+		return nwords * CPUSET_WORDBITS;
+
+	word = val ? bits[w] : ~bits[w];
+	word &= ~(__cpu_mask) 0 << (from % CPUSET_WORDBITS);
+
+	while (!word) {
+		if (++w >= nwords)
+			return nwords * CPUSET_WORDBITS;
+		word = val ? bits[w] : ~bits[w];
+	}
+	return w * CPUSET_WORDBITS + __builtin_ctzl(word);
+}
+
+/* sets bits @a..@b (inclusive), the range has to fit into the set */
+static void cpuset_set_range(cpu_set_t *set, size_t a, size_t b)
+{
+	__cpu_mask *bits = set->__bits;
+	size_t wa = a / CPUSET_WORDBITS, wb = b / CPUSET_WORDBITS;
+	__cpu_mask ma = ~(__cpu_mask) 0 << (a % CPUSET_WORDBITS);
+	__cpu_mask mb = ~(__cpu_mask) 0 >> (CPUSET_WORDBITS - 1 - b % CPUSET_WORDBITS);
+
+	if (wa == wb) {
+		bits[wa] |= ma & mb;
+		return;
+	}
+	bits[wa++] |= ma;
+	while (wa < wb)
+		bits[wa++] = ~(__cpu_mask) 0;
+	bits[wb] |= mb;
+}
+
 static const char *nexttoken(const char *q,  int sep)
 {
 	if (q)
@@ -154,36 +208,29 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 char *cpulist_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
-	size_t i;
 	char *ptr = str;
 	int entry_made = 0;
-	size_t max = cpuset_nbits(setsize);
-
-	for (i = 0; i < max; i++) {
-		if (CPU_ISSET_S(i, setsize, set)) {
-			int rlen;
-			size_t j, run = 0;
-			entry_made = 1;
-			for (j = i + 1; j < max; j++) {
-				if (CPU_ISSET_S(j, setsize, set))
-					run++;
-				else
-					break;
-			}
-			if (!run)
-				rlen = snprintf(ptr, len, "%zu,", i);
-			else if (run == 1) {
-				rlen = snprintf(ptr, len, "%zu,%zu,", i, i + 1);
-				i++;
-			} else {
-				rlen = snprintf(ptr, len, "%zu-%zu,", i, i + run);
-				i += run;
-			}
-			if (rlen < 0 || (size_t) rlen >= len)
-				return NULL;
-			ptr += rlen;
-			len -= rlen;
+	size_t i, max = cpuset_nbits(setsize);
+
+	for (i = cpuset_find_next(set, setsize, 0, 1); i < max;
+	     i = cpuset_find_next(set, setsize, i + 1, 1)) {
+		int rlen;
+		size_t run = cpuset_find_next(set, setsize, i, 0) - i - 1;
+
+		entry_made = 1;
+		if (!run)
+			rlen = snprintf(ptr, len, "%zu,", i);
+		else if (run == 1) {
+			rlen = snprintf(ptr, len, "%zu,%zu,", i, i + 1);
+			i++;
+		} else {
+			rlen = snprintf(ptr, len, "%zu-%zu,", i, i + run);
+			i += run;
 		}
+		if (rlen < 0 || (size_t) rlen >= len)
+			return NULL;
+		ptr += rlen;
+		len -= rlen;
 	}
 	ptr -= entry_made;
 	*ptr = '\0';
@@ -197,25 +244,28 @@ char *cpulist_create(char *str, size_t len,
 char *cpumask_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
+	const __cpu_mask *bits = set->__bits;
 	char *ptr = str;
 	char *ret = NULL;
 	int cpu;
 
 	for (cpu = cpuset_nbits(setsize) - 4; cpu >= 0; cpu -= 4) {
-		char val = 0;
+		__cpu_mask word = bits[cpu / CPUSET_WORDBITS];
+		char val;
 
 		if (len == (size_t) (ptr - str))
 			break;
 
-		if (CPU_ISSET_S(cpu, setsize, set))
-			val |= 1;
-		if (CPU_ISSET_S(cpu + 1, setsize, set))
-			val |= 2;
-		if (CPU_ISSET_S(cpu + 2, setsize, set))
-			val |= 4;
-		if (CPU_ISSET_S(cpu + 3, setsize, set))
-			val |= 8;
+		/* empty word, all its digits are zero */
+		if (!word && (size_t) cpu % CPUSET_WORDBITS == CPUSET_WORDBITS - 4
+		    && len - (ptr - str) > CPUSET_WORDBITS / 4) {
+			memset(ptr, '0', CPUSET_WORDBITS / 4);
+			ptr += CPUSET_WORDBITS / 4;
+			cpu -= CPUSET_WORDBITS - 4;
+			continue;
+		}
 
+		val = (word >> (cpu % CPUSET_WORDBITS)) & 0xf;
 		if (!ret && val)
 			ret = ptr;
 		*ptr++ = val_to_char(val);
@@ -229,9 +279,12 @@ char *cpumask_create(char *str, size_t len,
  */
 int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 {
+	__cpu_mask *bits = set->__bits;
 	int len = strlen(str);
 	const char *ptr = str + len - 1;
-	int cpu = 0;
+	size_t w = 0, nwords = cpuset_nwords(setsize);
+	unsigned int shift = 0;
+	__cpu_mask word = 0;
 
 	/* skip 0x, it's all hex anyway */
 	if (len > 1 && !memcmp(str, "0x", 2L))
@@ -239,6 +292,7 @@ int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 
 	CPU_ZERO_S(setsize, set);
 
+	/* the digits are collected to words, bits above setsize are ignored */
 	while (ptr >= str) {
 		char val;
 
@@ -249,17 +303,18 @@ int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 		val = char_to_val(*ptr);
 		if (val == (char) -1)
 			return -1;
-		if (val & 1)
-			CPU_SET_S(cpu, setsize, set);
-		if (val & 2)
-			CPU_SET_S(cpu + 1, setsize, set);
-		if (val & 4)
-			CPU_SET_S(cpu + 2, setsize, set);
-		if (val & 8)
-			CPU_SET_S(cpu + 3, setsize, set);
+		word |= (__cpu_mask) val << shift;
+		shift += 4;
+		if (shift == CPUSET_WORDBITS) {
+			if (w < nwords)
+				bits[w++] = word;
+			word = 0;
+			shift = 0;
+		}
 		ptr--;
-		cpu += 4;
 	}
+	if (word && w < nwords)
+		bits[w] = word;
 
 	return 0;
 }
@@ -325,6 +380,18 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 
 		if (!(a <= b))
 			return 1;
+		if (s == 1) {
+			/* simple range, set it by words */
+			if (b >= max) {
+				if (fail)
+					return 2;
+				if (a >= max)
+					continue;
+				b = max - 1;
+			}
+			cpuset_set_range(set, a, b);
+			continue;
+		}
 		while (a <= b) {
 			if (a >= max) {
 				if (fail)
@@ -2,7 +2,8 @@
  * This code is from freebsd/sys/libkern/crc32.c
  *
  * Simplest table-based crc32c.  Performance is not important
- * for checking crcs on superblocks
+ * for checking crcs on superblocks, but on x86_64 the SSE4.2 crc32
+ * instruction is used if available, it's for free.
  */
 
 /*-
@@ -11,8 +12,14 @@
  */
 
 #include <assert.h>
+#include <string.h>
+
 #include "crc32c.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+# define UL_CRC32C_SSE42	1
+#endif
+
 static const uint32_t crc32Table[256] = {
 	0x00000000L, 0xF26B8303L, 0xE13B70F7L, 0x1350F3F4L,
 	0xC79A971FL, 0x35F1141CL, 0x26A1E7E8L, 0xD4CA64EBL,
@@ -80,6 +87,52 @@ static const uint32_t crc32Table[256] = {
 	0xBE2DA0A5L, 0x4C4623A6L, 0x5F16D052L, 0xAD7D5351L
 };
 
+static uint32_t crc32c_table(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size--)
+		crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#ifdef UL_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	uint64_t crc64;
+
+	while (size && ((uintptr_t) p & 7)) {
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+		size--;
+	}
+
+	crc64 = crc;
+	while (size >= 8) {
+		uint64_t x;
+
+		memcpy(&x, p, sizeof(x));
+		crc64 = __builtin_ia32_crc32di(crc64, x);
+		p += 8;
+		size -= 8;
+	}
+	crc = (uint32_t) crc64;
+
+	while (size--)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+
+	return crc;
+}
+
+static int has_sse42(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+}
+#endif /* UL_CRC32C_SSE42 */
+
 /*
  *This was singletable_crc32c() in bsd
  *
@@ -94,28 +147,95 @@ static const uint32_t crc32Table[256] = {
 uint32_t
 crc32c(uint32_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p = buf;
-
-	while (size--)
-		crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
-
-	return crc;
+#ifdef UL_CRC32C_SSE42
+	if (has_sse42())
+		return crc32c_sse42(crc, buf, size);
+#endif
+	return crc32c_table(crc, buf, size);
 }
 
 uint32_t
 ul_crc32c_exclude_offset(uint32_t crc, const unsigned char *buf, size_t size,
 			 size_t exclude_off, size_t exclude_len)
 {
+	static const uint8_t zeros[64];
 	size_t i;
 
 	assert((exclude_off + exclude_len) <= size);
 
 	crc = crc32c(crc, buf, exclude_off);
-	for (i = 0; i < exclude_len; i++) {
-		uint8_t zero = 0;
-		crc = crc32c(crc, &zero, 1);
+	for (i = 0; i < exclude_len; i += sizeof(zeros)) {
+		size_t n = exclude_len - i;
+
+		crc = crc32c(crc, zeros, n < sizeof(zeros) ? n : sizeof(zeros));
 	}
 	crc = crc32c(crc, &buf[exclude_off + exclude_len],
 		     size - (exclude_off + exclude_len));
 	return crc;
 }
+
+#ifdef TEST_PROGRAM_CRC32C
+# include <stdio.h>
+# include <stdlib.h>
+# include <time.h>
+
+static double bench(uint32_t (*fn)(uint32_t, const void *, size_t),
+		    const unsigned char *buf, size_t size, size_t loops)
+{
+	struct timespec a, b;
+	volatile uint32_t crc = 0;
+	double sec;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (i = 0; i < loops; i++)
+		crc ^= fn(~0U, buf, size);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+
+	sec = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+	return sec > 0 ? (double) size * loops / sec / (1024 * 1024) : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static unsigned char buf[8192 + 8];
+	size_t i, off, sz;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (unsigned char) random();
+
+	/* check value from RFC 3720 */
+	if ((crc32c(~0U, "123456789", 9) ^ ~0U) != 0xE3069283) {
+		fprintf(stderr, "crc32c: wrong check value\n");
+		return EXIT_FAILURE;
+	}
+
+	for (off = 0; off < 8; off++) {
+		for (sz = 0; sz <= 8192; sz += (sz < 64 ? 1 : 61)) {
+			uint32_t a = crc32c(~0U, buf + off, sz),
+				 b = crc32c_table(~0U, buf + off, sz);
+			if (a != b) {
+				fprintf(stderr, "crc32c: mismatch "
+					"[off=%zu, size=%zu]: %08x != %08x\n",
+					off, sz, a, b);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		sz = argc > 2 ? strtoul(argv[2], NULL, 10) : 4096;
+		if (!sz || sz > 8192)
+			sz = 4096;
+
+		printf("%-8s %10.1f MiB/s\n", "table",
+				bench(crc32c_table, buf, sz, 100000));
+#ifdef UL_CRC32C_SSE42
+		if (has_sse42())
+			printf("%-8s %10.1f MiB/s\n", "sse4.2",
+				bench(crc32c_sse42, buf, sz, 100000));
+#endif
+	}
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_CRC32C */
@@ -284,6 +284,73 @@ size_t ul_fileeq_set_size(struct ul_fileeq *eq, uint64_t filesiz,
 	return eq->blocksmax;
 }
 
+/*
+ * Returns size of one block digest, or 0 for methods without digests
+ * (memcmp).
+ */
+size_t ul_fileeq_get_digsiz(struct ul_fileeq *eq)
+{
+	assert(eq);
+	return eq->method->digsiz;
+}
+
+/*
+ * Returns number of already known blocks of the file (the intro is the first
+ * block), @digests is set to the array of the block digests. The intro and the
+ * digests are valid for the current eq->readsiz only. The @eof is set when all
+ * the file has been digested.
+ */
+size_t ul_fileeq_data_get_cached(struct ul_fileeq *eq, struct ul_fileeq_data *data,
+				 unsigned char **digests, bool *eof)
+{
+	assert(eq);
+	assert(data);
+
+	if (eq->method->id == UL_FILEEQ_MEMCMP || data->nblocks == 0)
+		return 0;
+	if (digests)
+		*digests = data->blocks;
+	if (eof)
+		*eof = data->is_eof;
+	return data->nblocks;
+}
+
+/*
+ * Initialize @data from a previous ul_fileeq_data_get_cached(). The file is
+ * not opened at all if @eof is true, otherwise it continues reading after the
+ * last cached block. The ul_fileeq_set_size() has to be already called with
+ * the same sizes as for the original data.
+ */
+int ul_fileeq_data_set_cached(struct ul_fileeq *eq, struct ul_fileeq_data *data,
+			      const unsigned char *intro, const unsigned char *digests,
+			      size_t nblocks, bool eof)
+{
+	size_t sz;
+
+	assert(eq);
+	assert(data);
+	assert(data->nblocks == 0);
+
+	if (eq->method->id == UL_FILEEQ_MEMCMP || nblocks == 0
+	    || nblocks - 1 > eq->blocksmax)
+		return -EINVAL;
+
+	sz = eq->method->digsiz;
+
+	if (nblocks > 1) {
+		data->blocks = malloc(eq->blocksmax * sz);
+		if (!data->blocks)
+			return -ENOMEM;
+		memcpy(data->blocks, digests, (nblocks - 1) * sz);
+	}
+	memcpy(data->intro, intro, sizeof(data->intro));
+	data->nblocks = nblocks;
+	data->is_eof = eof;
+
+	DBG(DATA, ul_debugobj(data, "set %zu cached blocks%s", nblocks, eof ? " [eof]" : ""));
+	return 0;
+}
+
 static unsigned char *get_buffer(struct ul_fileeq *eq)
 {
 	if (!eq->buf_a)
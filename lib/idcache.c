@@ -12,6 +12,47 @@
 #include "c.h"
 #include "idcache.h"
 
+#define IDCACHE_HASH_MINSZ	64
+
+static inline size_t id_hash(unsigned long int id, size_t sz)
+{
+	return (size_t) (((uint64_t) id * 0x9E3779B97F4A7C15ULL) >> 32) & (sz - 1);
+}
+
+static void hash_insert(struct identry **hash, size_t sz, struct identry *ent)
+{
+	size_t i = id_hash(ent->id, sz);
+
+	while (hash[i])
+		i = (i + 1) & (sz - 1);
+	hash[i] = ent;
+}
+
+/* the index is kept at most half full; on ENOMEM fallback to the list only */
+static void hash_add(struct idcache *ic, struct identry *ent)
+{
+	if ((ic->nents + 1) * 2 > ic->hashsz) {
+		size_t sz = ic->hashsz ? ic->hashsz * 2 : IDCACHE_HASH_MINSZ;
+		struct identry **hash, *x;
+
+		if (!ic->hash && ic->nents)
+			return;		/* already in list-only mode */
+
+		hash = calloc(sz, sizeof(struct identry *));
+		free(ic->hash);
+		ic->hash = hash;
+		ic->hashsz = hash ? sz : 0;
+		if (!hash)
+			return;
+
+		/* @ent is already in the list */
+		for (x = ic->ent; x; x = x->next)
+			hash_insert(hash, sz, x);
+		return;
+	}
+	hash_insert(ic->hash, ic->hashsz, ent);
+}
+
 struct identry *get_id(struct idcache *ic, unsigned long int id)
 {
 	struct identry *ent;
@@ -19,6 +60,17 @@ struct identry *get_id(struct idcache *ic, unsigned long int id)
 	if (!ic)
 		return NULL;
 
+	if (ic->hash) {
+		size_t i = id_hash(id, ic->hashsz);
+
+		for (ent = ic->hash[i]; ent; ent = ic->hash[i]) {
+			if (ent->id == id)
+				return ent;
+			i = (i + 1) & (ic->hashsz - 1);
+		}
+		return NULL;
+	}
+
 	for (ent = ic->ent; ent; ent = ent->next) {
 		if (ent->id == id)
 			return ent;
@@ -27,6 +79,41 @@ struct identry *get_id(struct idcache *ic, unsigned long int id)
 	return NULL;
 }
 
+static void link_id(struct idcache *ic, struct identry *ent)
+{
+	ent->next = ic->ent;
+	ic->ent = ent;
+	hash_add(ic, ent);
+	ic->nents++;
+}
+
+/*
+ * Adds @id with @name to the cache as is, the name width is not updated.
+ */
+struct identry *add_id_entry(struct idcache *ic, unsigned long int id,
+			     const char *name)
+{
+	struct identry *ent;
+
+	if (!ic)
+		return NULL;
+
+	ent = calloc(1, sizeof(struct identry));
+	if (!ent)
+		return NULL;
+	ent->id = id;
+	if (name) {
+		ent->name = strdup(name);
+		if (!ent->name) {
+			free(ent);
+			return NULL;
+		}
+	}
+
+	link_id(ic, ent);
+	return ent;
+}
+
 struct idcache *new_idcache(void)
 {
 	return calloc(1, sizeof(struct idcache));
@@ -48,12 +135,13 @@ void free_idcache(struct idcache *ic)
 		ent = next;
 	}
 
+	free(ic->hash);
 	free(ic);
 }
 
 static void add_id(struct idcache *ic, char *name, unsigned long int id)
 {
-	struct identry *ent, *x;
+	struct identry *ent;
 	int w = 0;
 
 	if (!ic)
@@ -91,12 +179,7 @@ static void add_id(struct idcache *ic, char *name, unsigned long int id)
 		}
 	}
 
-	for (x = ic->ent; x && x->next; x = x->next);
-
-	if (x)
-		x->next = ent;
-	else
-		ic->ent = ent;
+	link_id(ic, ent);
 
 	if (w <= 0)
 		w = ent->name ? strlen(ent->name) : 0;
@@ -38,6 +38,142 @@
 
 
 
+/*
+ * Sets MF_ISROOT and also MF_READONLY if the root filesystem is read-only.
+ */
+static void check_root_readonly(int *mount_flags)
+{
+#define TEST_FILE "/.ismount-test-file"
+	int fd;
+
+	*mount_flags |= MF_ISROOT;
+	fd = open(TEST_FILE, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		if (errno == EROFS)
+			*mount_flags |= MF_READONLY;
+	} else
+		close(fd);
+	(void) unlink(TEST_FILE);
+}
+
+#ifdef __linux__
+/*
+ * Filesystems and swap areas keep their block device opened with O_EXCL.
+ * Returns 0 if @file is an unused block device, -EBUSY if it is used, and 1
+ * if it's not a block device or the test is impossible.
+ */
+static int check_blkdev_excl(const char *file, dev_t *devno)
+{
+	struct stat st_buf;
+	int fd;
+
+	if (stat(file, &st_buf) != 0 || !S_ISBLK(st_buf.st_mode))
+		return 1;
+	if (devno)
+		*devno = st_buf.st_rdev;
+
+	fd = open(file, O_RDONLY|O_EXCL|O_CLOEXEC|O_NONBLOCK);
+	if (fd >= 0) {
+		close(fd);
+		return 0;
+	}
+	return errno == EBUSY ? -EBUSY : 1;
+}
+
+/* returns 1 if the comma separated list @opts contains "ro" */
+static int has_ro_option(const char *opts)
+{
+	size_t len;
+
+	while (opts && *opts) {
+		len = strcspn(opts, ",");
+		if (len == 2 && strncmp(opts, "ro", 2) == 0)
+			return 1;
+		opts += len;
+		if (*opts == ',')
+			opts++;
+	}
+	return 0;
+}
+
+/* decodes \ooo escapes in mountinfo paths */
+static void unmangle_path(char *s)
+{
+	char *p = s;
+
+	while (*s) {
+		if (*s == '\\' && isdigit(s[1]) && isdigit(s[2]) && isdigit(s[3])) {
+			*p++ = ((s[1] - '0') << 6) | ((s[2] - '0') << 3) | (s[3] - '0');
+			s += 4;
+		} else
+			*p++ = *s++;
+	}
+	*p = '\0';
+}
+
+/*
+ * Looks for the block device @devno in /proc/self/mountinfo. The kernel
+ * provides the device number for each entry, so (unlike the /proc/mounts
+ * scan) it's not necessary to stat() all the mount sources and mountpoints.
+ */
+static int check_mountinfo(dev_t devno, int *mount_flags, char *mtpt, int mtlen)
+{
+	char *line = NULL, *dir = NULL;
+	size_t sz = 0;
+	FILE *f;
+
+	*mount_flags = 0;
+	if (!(f = fopen(_PATH_PROC_MOUNTINFO, "r" UL_CLOEXECSTR)))
+		return errno;
+
+	while (getline(&line, &sz, f) > 0) {
+		unsigned int maj, min;
+		char *opts, *sep;
+		int end = 0;
+
+		/* ID PARENT MAJ:MIN ROOT TARGET OPTIONS ... - TYPE SOURCE SUPEROPTS */
+		if (sscanf(line, "%*u %*u %u:%u %*s %n", &maj, &min, &end) != 2
+		    || !end || makedev(maj, min) != devno)
+			continue;
+
+		dir = line + end;
+		opts = strchr(dir, ' ');
+		if (!opts)
+			continue;
+		*opts++ = '\0';
+		unmangle_path(dir);
+
+		*mount_flags = MF_MOUNTED;
+		sep = strstr(opts, " - ");
+		opts[strcspn(opts, " ")] = '\0';
+		if (has_ro_option(opts))
+			*mount_flags |= MF_READONLY;
+		if (sep) {
+			/* TYPE SOURCE SUPEROPTS */
+			char *sb = strchr(sep + 3, ' ');
+
+			sb = sb ? strchr(sb + 1, ' ') : NULL;
+			if (sb) {
+				sb[strcspn(sb, "\n")] = '\0';
+				if (has_ro_option(sb + 1))
+					*mount_flags |= MF_READONLY;
+			}
+		}
+		break;
+	}
+	fclose(f);
+
+	if (*mount_flags & MF_MOUNTED) {
+		if (mtpt)
+			xstrncpy(mtpt, dir, mtlen);
+		if (strcmp(dir, "/") == 0)
+			check_root_readonly(mount_flags);
+	}
+	free(line);
+	return 0;
+}
+#endif /* __linux__ */
+
 #ifdef HAVE_MNTENT_H
 /*
  * Helper function which checks a file in /etc/mtab format to see if a
@@ -53,7 +189,6 @@ static int check_mntent_file(const char *mtab_file, const char *file,
 	dev_t		file_dev=0, file_rdev=0;
 	ino_t		file_ino=0;
 	FILE		*f;
-	int		fd;
 
 	*mount_flags = 0;
 	if ((f = setmntent (mtab_file, "r")) == NULL)
@@ -160,15 +295,7 @@ static int check_mntent_file(const char *mtab_file, const char *file,
 	 */
 	if (!strcmp(mnt->mnt_dir, "/")) {
 is_root:
-#define TEST_FILE "/.ismount-test-file"
-		*mount_flags |= MF_ISROOT;
-		fd = open(TEST_FILE, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
-		if (fd < 0) {
-			if (errno == EROFS)
-				*mount_flags |= MF_READONLY;
-		} else
-			close(fd);
-		(void) unlink(TEST_FILE);
+		check_root_readonly(mount_flags);
 	}
 	retval = 0;
 errout:
@@ -318,12 +445,31 @@ int check_mount_point(const char *device, int *mount_flags,
 				  char *mtpt, int mtlen)
 {
 	int	retval = 0;
+#ifdef __linux__
+	dev_t	devno = 0;
+	int	busy = 0;
+
+	/* the usual case for mkfs-like tools, no need to read /proc */
+	switch (check_blkdev_excl(device, &devno)) {
+	case 0:
+		*mount_flags = 0;
+		return 0;
+	case -EBUSY:
+		busy = 1;
+		break;
+	}
+#endif
 
 	if (is_swap_device(device)) {
 		*mount_flags = MF_MOUNTED | MF_SWAP;
 		if (mtpt && mtlen)
 			xstrncpy(mtpt, "[SWAP]", mtlen);
 	} else {
+#ifdef __linux__
+		if (devno)
+			retval = check_mountinfo(devno, mount_flags, mtpt, mtlen);
+		if (!devno || retval)
+#endif
 #ifdef HAVE_MNTENT_H
 		retval = check_mntent(device, mount_flags, mtpt, mtlen);
 #else
@@ -341,19 +487,8 @@ int check_mount_point(const char *device, int *mount_flags,
 		return retval;
 
 #ifdef __linux__ /* This only works on Linux 2.6+ systems */
-	{
-		struct stat st_buf;
-		int fd;
-		if ((stat(device, &st_buf) != 0) ||
-		    !S_ISBLK(st_buf.st_mode))
-			return 0;
-		fd = open(device, O_RDONLY|O_EXCL|O_CLOEXEC|O_NONBLOCK);
-		if (fd < 0) {
-			if (errno == EBUSY)
-				*mount_flags |= MF_BUSY;
-		} else
-			close(fd);
-	}
+	if (busy)
+		*mount_flags |= MF_BUSY;
 #endif
 
 	return 0;
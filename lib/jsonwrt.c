@@ -7,6 +7,9 @@
  * Written by Karel Zak <kzak@redhat.com>
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <cctype.h>
@@ -25,32 +28,49 @@
  *		charsToEscape.push(i);
  *	}
  * }
+ *
+ * Escapes for chars which have to be escaped in JSON strings, the other chars
+ * are 0. The 'u' means \u00XX notation.
+ *
+ * The double-quote and backslashes would break out a string or init an escape
+ * sequence if not escaped. Note that single-quotes and forward slashes, while
+ * they're in the JSON spec, don't break double-quoted strings.
+ *
+ * In addition, all chars under ' ' break Node's/V8/Chrome's, and Firefox's
+ * JSON.parse function. The short-hand cases reduce output size.
  */
+static const char json_escapes[256] = {
+	/* 0x00 - 0x0f */
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	/* 0x10 - 0x1f */
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	['"'] = '"',
+	['\\'] = '\\'
+};
+
 static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t size)
 {
-	const char *p;
+	const char *p = data, *end = size ? data + size : NULL;
 
 	fputc('"', out);
-	for (p = data; p && *p && (!size || p < data + size); p++) {
-
+	while (p && *p && (!end || p < end)) {
 		const unsigned int c = (unsigned int) *p;
+		const char esc = json_escapes[(unsigned char) *p];
 
-		/* From http://www.json.org
-		 *
-		 * The double-quote and backslashes would break out a string or
-		 * init an escape sequence if not escaped.
-		 *
-		 * Note that single-quotes and forward slashes, while they're
-		 * in the JSON spec, don't break double-quoted strings.
-		 */
-		if (c == '"' || c == '\\') {
-			fputc('\\', out);
-			fputc(c, out);
+		/* copy unescaped chars in bulk if no case swap required */
+		if (!dir && !esc) {
+			const char *run = p;
+
+			while (*p && (!end || p < end)
+			       && !json_escapes[(unsigned char) *p])
+				p++;
+			fwrite(run, 1, p - run, out);
 			continue;
 		}
+		p++;
 
-		/* All non-control characters OK; do the case swap as required. */
-		if (c >= 0x20) {
+		switch (esc) {
+		case 0:
 			/*
 			 * Don't use locale sensitive ctype.h functions for regular
 			 * ASCII chars, because for example with Turkish locale
@@ -58,41 +78,19 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t
 			 */
 			if (c <= 127)
 				fputc(dir ==  1 ? c_toupper(c) :
-				      dir == -1 ? c_tolower(c) : *p, out);
+				      dir == -1 ? c_tolower(c) : (int) c, out);
 			else
 				fputc(dir ==  1 ? toupper(c) :
-				      dir == -1 ? tolower(c) : *p, out);
-			continue;
-		}
-
-		/* In addition, all chars under ' ' break Node's/V8/Chrome's, and
-		 * Firefox's JSON.parse function
-		 */
-		switch (c) {
-			/* Handle short-hand cases to reduce output size.  C
-			 * has most of the same stuff here, so if there's an
-			 * "Escape for C" function somewhere in the STL, we
-			 * should probably be using it.
-			 */
-			case '\b':
-				fputs("\\b", out);
-				break;
-			case '\t':
-				fputs("\\t", out);
-				break;
-			case '\n':
-				fputs("\\n", out);
-				break;
-			case '\f':
-				fputs("\\f", out);
-				break;
-			case '\r':
-				fputs("\\r", out);
-				break;
-			default:
-				/* Other assorted control characters */
-				fprintf(out, "\\u00%02x", c);
-				break;
+				      dir == -1 ? tolower(c) : (int) c, out);
+			break;
+		case 'u':
+			/* Other assorted control characters */
+			fprintf(out, "\\u00%02x", c);
+			break;
+		default:
+			fputc('\\', out);
+			fputc(esc, out);
+			break;
 		}
 	}
 	fputc('"', out);
@@ -102,11 +100,127 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t
 #define fputs_quoted_json_upper(_d, _o) fputs_quoted_case_json(_d, _o, 1, 0)
 #define fputs_quoted_json_lower(_d, _o) fputs_quoted_case_json(_d, _o, -1, 0)
 
+/*
+ * CBOR (RFC 8949) encoding. The objects and arrays are encoded as indefinite
+ * length items, so it's possible to use the same API as for JSON.
+ */
+enum {
+	CBOR_UINT	= 0,
+	CBOR_NINT	= 1,
+	CBOR_TEXT	= 3,
+	CBOR_ARRAY	= 4,
+	CBOR_MAP	= 5,
+	CBOR_SIMPLE	= 7
+};
+
+#define CBOR_FALSE	0xf4
+#define CBOR_TRUE	0xf5
+#define CBOR_NULL	0xf6
+#define CBOR_FLOAT64	0xfb
+#define CBOR_BREAK	0xff
+#define CBOR_INDEF(_t)	(((_t) << 5) | 31)
+
+static void cbor_put_head(FILE *out, int type, uint64_t val)
+{
+	unsigned char buf[9];
+	size_t i, sz;
+
+	if (val < 24) {
+		buf[0] = (type << 5) | val;
+		sz = 0;
+	} else if (val <= UINT8_MAX) {
+		buf[0] = (type << 5) | 24;
+		sz = 1;
+	} else if (val <= UINT16_MAX) {
+		buf[0] = (type << 5) | 25;
+		sz = 2;
+	} else if (val <= UINT32_MAX) {
+		buf[0] = (type << 5) | 26;
+		sz = 4;
+	} else {
+		buf[0] = (type << 5) | 27;
+		sz = 8;
+	}
+
+	/* big-endian */
+	for (i = 0; i < sz; i++)
+		buf[sz - i] = (val >> (i * 8)) & 0xff;
+
+	fwrite(buf, 1, sz + 1, out);
+}
+
+static void cbor_put_text(FILE *out, const char *data, size_t size, int lower)
+{
+	cbor_put_head(out, CBOR_TEXT, size);
+
+	if (!lower)
+		fwrite(data, 1, size, out);
+	else {
+		size_t i;
+
+		for (i = 0; i < size; i++)
+			fputc(c_tolower((unsigned char) data[i]), out);
+	}
+}
+
+static void cbor_put_double(FILE *out, double num)
+{
+	unsigned char buf[9];
+	uint64_t val;
+	size_t i;
+
+	memcpy(&val, &num, sizeof(val));
+	buf[0] = CBOR_FLOAT64;
+	for (i = 0; i < 8; i++)
+		buf[8 - i] = (val >> (i * 8)) & 0xff;
+	fwrite(buf, 1, sizeof(buf), out);
+}
+
+/* the number is in string, use text if not a number */
+static void cbor_put_number(FILE *out, const char *data)
+{
+	const char *p = *data == '-' ? data + 1 : data;
+	char *end = NULL;
+	double fnum;
+
+	if (isdigit((unsigned char) *p)) {
+		uint64_t num;
+
+		errno = 0;
+		num = strtoumax(p, &end, 10);
+		if (!errno && end && !*end) {
+			if (p == data)
+				cbor_put_head(out, CBOR_UINT, num);
+			else if (num)
+				cbor_put_head(out, CBOR_NINT, num - 1);
+			else
+				cbor_put_head(out, CBOR_UINT, 0);	/* -0 */
+			return;
+		}
+	}
+
+	errno = 0;
+	end = NULL;
+	fnum = strtod(data, &end);
+	if (!errno && end && end > data && !*end) {
+		cbor_put_double(out, fnum);
+		return;
+	}
+	cbor_put_text(out, data, strlen(data), 0);
+}
+
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent)
 {
 	fmt->out = out;
 	fmt->indent = indent;
 	fmt->after_close = 0;
+	fmt->cbor = 0;
+}
+
+/* use CBOR (binary) output rather than JSON */
+void ul_jsonwrt_enable_cbor(struct ul_jsonwrt *fmt, int enable)
+{
+	fmt->cbor = enable ? 1 : 0;
 }
 
 int ul_jsonwrt_is_ready(struct ul_jsonwrt *fmt)
@@ -124,6 +238,20 @@ void ul_jsonwrt_indent(struct ul_jsonwrt *fmt)
 
 void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 {
+	if (fmt->cbor) {
+		/* names are map keys */
+		if (name)
+			cbor_put_text(fmt->out, name, strlen(name), 1);
+		if (type == UL_JSON_OBJECT)
+			fputc(CBOR_INDEF(CBOR_MAP), fmt->out);
+		else if (type == UL_JSON_ARRAY)
+			fputc(CBOR_INDEF(CBOR_ARRAY), fmt->out);
+		if (type != UL_JSON_VALUE)
+			fmt->indent++;
+		fmt->after_close = 0;
+		return;
+	}
+
 	if (name) {
 		if (fmt->after_close)
 			fputs(",\n", fmt->out);
@@ -156,6 +284,15 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 {
 	assert(fmt->indent > 0);
 
+	if (fmt->cbor) {
+		if (type != UL_JSON_VALUE) {
+			fputc(CBOR_BREAK, fmt->out);
+			fmt->indent--;
+		}
+		fmt->after_close = 1;
+		return;
+	}
+
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fmt->indent--;
@@ -182,7 +319,11 @@ void ul_jsonwrt_value_raw(struct ul_jsonwrt *fmt,
 			const char *name, const char *data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	if (data && *data)
+	if (fmt->cbor && data && *data)
+		cbor_put_number(fmt->out, data);
+	else if (fmt->cbor)
+		fputc(CBOR_NULL, fmt->out);
+	else if (data && *data)
 		fputs(data, fmt->out);
 	else
 		fputs("null", fmt->out);
@@ -193,7 +334,11 @@ void ul_jsonwrt_value_s(struct ul_jsonwrt *fmt,
 			const char *name, const char *data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	if (data && *data)
+	if (fmt->cbor && data && *data)
+		cbor_put_text(fmt->out, data, strlen(data), 0);
+	else if (fmt->cbor)
+		fputc(CBOR_NULL, fmt->out);
+	else if (data && *data)
 		fputs_quoted_json(data, fmt->out);
 	else
 		fputs("null", fmt->out);
@@ -204,7 +349,11 @@ void ul_jsonwrt_value_s_sized(struct ul_jsonwrt *fmt,
 			      const char *name, const char *data, size_t size)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	if (data && *data)
+	if (fmt->cbor && data && *data)
+		cbor_put_text(fmt->out, data, size ? strnlen(data, size) : strlen(data), 0);
+	else if (fmt->cbor)
+		fputc(CBOR_NULL, fmt->out);
+	else if (data && *data)
 		fputs_quoted_case_json(data, fmt->out, 0, size);
 	else
 		fputs("null", fmt->out);
@@ -215,7 +364,10 @@ void ul_jsonwrt_value_u64(struct ul_jsonwrt *fmt,
 			const char *name, uint64_t data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fprintf(fmt->out, "%"PRIu64, data);
+	if (fmt->cbor)
+		cbor_put_head(fmt->out, CBOR_UINT, data);
+	else
+		fprintf(fmt->out, "%"PRIu64, data);
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -223,7 +375,10 @@ void ul_jsonwrt_value_double(struct ul_jsonwrt *fmt,
 			const char *name, long double data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fprintf(fmt->out, "%Lg", data);
+	if (fmt->cbor)
+		cbor_put_double(fmt->out, data);
+	else
+		fprintf(fmt->out, "%Lg", data);
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -231,7 +386,10 @@ void ul_jsonwrt_value_boolean(struct ul_jsonwrt *fmt,
 			const char *name, int data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fputs(data ? "true" : "false", fmt->out);
+	if (fmt->cbor)
+		fputc(data ? CBOR_TRUE : CBOR_FALSE, fmt->out);
+	else
+		fputs(data ? "true" : "false", fmt->out);
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -239,6 +397,9 @@ void ul_jsonwrt_value_null(struct ul_jsonwrt *fmt,
 			const char *name)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fputs("null", fmt->out);
+	if (fmt->cbor)
+		fputc(CBOR_NULL, fmt->out);
+	else
+		fputs("null", fmt->out);
 	ul_jsonwrt_value_close(fmt);
 }
@@ -252,6 +252,7 @@ void loopcxt_deinit(struct loopdev_cxt *lc)
 
 	ignore_result( loopcxt_set_device(lc, NULL) );
 	loopcxt_deinit_iterator(lc);
+	loopcxt_reset_index(lc);
 
 	errno = errsv;
 }
@@ -1507,6 +1508,7 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 	memset(&lc->config, 0, sizeof(lc->config));
 	lc->has_info = 0;
 	lc->info_failed = 0;
+	loopcxt_reset_index(lc);
 
 	DBG(SETUP, ul_debugobj(lc, "success [rc=0]"));
 	return 0;
@@ -1635,6 +1637,7 @@ int loopcxt_delete_device(struct loopdev_cxt *lc)
 		return rc;
 	}
 
+	loopcxt_reset_index(lc);
 	DBG(CXT, ul_debugobj(lc, "device removed"));
 	return 0;
 }
@@ -1723,6 +1726,113 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 
 
 
+/*
+ * Batch setup helper: collects numbers of @count loop devices for the caller.
+ * The currently unused devices are returned first, the rest is created by
+ * LOOP_CTL_ADD. Note that the devices are not locked in any way, so another
+ * process may use the device before the caller; loopcxt_setup_device() then
+ * fails with EBUSY and the caller is expected to fall back to
+ * loopcxt_find_unused().
+ *
+ * Returns: number of devices in @nums or <0 on error.
+ */
+int loopcxt_reserve_unused(struct loopdev_cxt *lc, int *nums, size_t count)
+{
+	size_t n = 0;
+	int rc, nr, maxnr = -1;
+
+	if (!lc || !nums)
+		return -EINVAL;
+
+	DBG(CXT, ul_debugobj(lc, "reserve %zu devices requested", count));
+
+	rc = loopcxt_init_iterator(lc, 0);
+	if (rc)
+		return rc;
+
+	while (loopcxt_next(lc) == 0) {
+		const char *p = strrchr(lc->device, '/');
+
+		if (!p || (sscanf(p, "/loop%d", &nr) != 1
+			   && sscanf(p, "/%d", &nr) != 1))
+			continue;
+		if (access(lc->device, F_OK) != 0)
+			continue;	/* default loop<0..7> may not exist */
+		maxnr = max(maxnr, nr);
+		if (n < count && loopcxt_get_offset(lc, NULL) != 0)
+			nums[n++] = nr;		/* not associated with a file */
+	}
+	loopcxt_deinit_iterator(lc);
+	ignore_result( loopcxt_set_device(lc, NULL) );
+
+	if (n < count && (lc->flags & LOOPDEV_FL_CONTROL)) {
+		int ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+
+		if (ctl < 0)
+			goto done;
+		/* EEXIST means the device already exists (e.g. without node) */
+		for (nr = maxnr + 1; n < count && nr < (1 << 20); nr++) {
+			rc = ioctl(ctl, LOOP_CTL_ADD, nr);
+			if (rc >= 0) {
+				DBG(CXT, ul_debugobj(lc, "added loop%d", nr));
+				nums[n++] = nr;
+			} else if (errno != EEXIST)
+				break;
+		}
+		close(ctl);
+	}
+done:
+	DBG(CXT, ul_debugobj(lc, "reserved %zu devices", n));
+	return n;
+}
+
+/*
+ * Sets device number @nr returned by loopcxt_reserve_unused(). The device
+ * node is expected to be created by udevd in a moment.
+ *
+ * Returns: <0 on error, 0 on success
+ */
+int loopcxt_set_reserved_device(struct loopdev_cxt *lc, int nr)
+{
+	char name[16];
+	int rc;
+
+	snprintf(name, sizeof(name), "loop%d", nr);
+	rc = loopcxt_set_device(lc, name);
+	if (!rc)
+		lc->control_ok = (lc->flags & LOOPDEV_FL_CONTROL) ? 1 : 0;
+	return rc;
+}
+
+/*
+ * Returns logical sector size of the block device where is @filename stored
+ * (or of the @filename if it is a block device), 0 if unknown.
+ */
+uint64_t loopdev_get_backing_blocksize(const char *filename)
+{
+	struct path_cxt *pc;
+	struct stat st;
+	dev_t devno, disk = 0;
+	uint64_t sz = 0;
+
+	if (stat(filename, &st) != 0)
+		return 0;
+	devno = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+
+	/* the queue/ directory is available for whole disks only */
+	pc = ul_new_sysfs_path(devno, NULL, NULL);
+	if (pc && sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0
+	    && disk != devno) {
+		ul_unref_path(pc);
+		pc = ul_new_sysfs_path(disk, NULL, NULL);
+	}
+	if (pc && ul_path_read_u64(pc, &sz, "queue/logical_block_size") != 0)
+		sz = 0;
+	ul_unref_path(pc);
+	return sz;
+}
+
+
 /*
  * Return: TRUE/FALSE
  */
@@ -1820,33 +1930,225 @@ int loopdev_delete(const char *device)
 	return rc;
 }
 
+/*
+ * Index of the used loop devices. All the information is read by one
+ * LOOP_GET_STATUS64 ioctl per device, and the index is sorted by backing file
+ * device and inode, so the lookups do not need to scan all devices again.
+ *
+ * The entries without inode (ioctl failed, e.g. non-root user) are kept at the
+ * begin of the array and matched by backing file name.
+ */
+struct loopdev_idxent {
+	char		*device;	/* /dev/loop<N> */
+	char		*filename;	/* backing file, only if inode unknown */
+	dev_t		devno;		/* backing file device */
+	ino_t		ino;		/* backing file inode */
+	uint64_t	offset;
+	uint64_t	sizelimit;
+	unsigned int	has_inode : 1;
+};
+
+struct loopdev_index {
+	struct loopdev_idxent	*ents;
+	size_t			nents;
+	size_t			nnames;	/* entries without inode */
+};
+
+static int cmp_idxent(const void *a, const void *b)
+{
+	const struct loopdev_idxent *x = a, *y = b;
+
+	if (x->has_inode != y->has_inode)
+		return x->has_inode ? 1 : -1;
+	if (x->devno != y->devno)
+		return x->devno < y->devno ? -1 : 1;
+	if (x->ino != y->ino)
+		return x->ino < y->ino ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Removes the index, it's rebuilt on the next lookup. This is necessary
+ * if the caller expects that devices have been set up or detached.
+ */
+void loopcxt_reset_index(struct loopdev_cxt *lc)
+{
+	size_t i;
+
+	if (!lc || !lc->index)
+		return;
+
+	for (i = 0; i < lc->index->nents; i++) {
+		free(lc->index->ents[i].device);
+		free(lc->index->ents[i].filename);
+	}
+	free(lc->index->ents);
+	free(lc->index);
+	lc->index = NULL;
+
+	DBG(CXT, ul_debugobj(lc, "index removed"));
+}
+
+/*
+ * Builds index of all used loop devices; the index is kept in the context
+ * and used by loopcxt_find_by_backing_file() and loopcxt_find_overlap().
+ *
+ * Returns: <0 on error, 0 on success
+ */
+int loopcxt_build_index(struct loopdev_cxt *lc)
+{
+	struct loopdev_index *idx;
+	int rc;
+
+	if (!lc)
+		return -EINVAL;
+
+	loopcxt_reset_index(lc);
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return -ENOMEM;
+
+	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
+	if (rc) {
+		free(idx);
+		return rc;
+	}
+	lc->index = idx;
+
+	while (loopcxt_next(lc) == 0) {
+		struct loop_info64 *lo = loopcxt_get_info(lc);
+		struct loopdev_idxent ent = { .has_inode = 0 }, *ents;
+
+		if (lo) {
+			ent.devno = lo->lo_device;
+			ent.ino = lo->lo_inode;
+			ent.offset = lo->lo_offset;
+			ent.sizelimit = lo->lo_sizelimit;
+			ent.has_inode = 1;
+		} else {
+			/* poor man's solution, see loopcxt_is_used() */
+			if (loopcxt_get_offset(lc, &ent.offset)
+			    || loopcxt_get_sizelimit(lc, &ent.sizelimit))
+				continue;	/* probably detached meanwhile */
+			ent.filename = loopcxt_get_backing_file(lc);
+			idx->nnames++;
+		}
+
+		ent.device = loopcxt_strdup_device(lc);
+		ents = reallocarray(idx->ents, idx->nents + 1, sizeof(ent));
+		if (!ent.device || !ents) {
+			free(ent.device);
+			free(ent.filename);
+			if (ents)
+				idx->ents = ents;
+			rc = -ENOMEM;
+			break;
+		}
+		idx->ents = ents;
+		idx->ents[idx->nents++] = ent;
+	}
+	loopcxt_deinit_iterator(lc);
+	ignore_result( loopcxt_set_device(lc, NULL) );
+
+	if (rc) {
+		loopcxt_reset_index(lc);
+		return rc;
+	}
+
+	qsort(idx->ents, idx->nents, sizeof(*idx->ents), cmp_idxent);
+
+	DBG(CXT, ul_debugobj(lc, "index built: %zu devices", idx->nents));
+	return 0;
+}
+
+/*
+ * Returns the next index entry which matches @st or @filename; @pos has to be
+ * zero for the first call.
+ */
+static struct loopdev_idxent *loopcxt_index_next(struct loopdev_cxt *lc,
+						 struct stat *st,
+						 const char *filename,
+						 size_t *pos)
+{
+	struct loopdev_index *idx = lc->index;
+	struct loopdev_idxent *ent;
+
+	/* nothing to compare inode with, check names of all devices */
+	if (!st) {
+		while (filename && *pos < idx->nents) {
+			ent = &idx->ents[(*pos)++];
+			if (!ent->filename)
+				ent->filename = loopdev_get_backing_file(ent->device);
+			if (ent->filename && strcmp(ent->filename, filename) == 0)
+				return ent;
+		}
+		return NULL;
+	}
+
+	/* entries without inode, compare file names */
+	while (*pos < idx->nnames) {
+		ent = &idx->ents[(*pos)++];
+		if (filename && ent->filename && strcmp(ent->filename, filename) == 0)
+			return ent;
+	}
+
+	/* first lookup in the sorted part of the index */
+	if (*pos == idx->nnames) {
+		size_t lo = idx->nnames, hi = idx->nents;
+
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			ent = &idx->ents[mid];
+
+			if (ent->devno < st->st_dev
+			    || (ent->devno == st->st_dev && ent->ino < st->st_ino))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		*pos = lo;
+	}
+
+	if (*pos < idx->nents) {
+		ent = &idx->ents[*pos];
+		if (ent->devno == st->st_dev && ent->ino == st->st_ino) {
+			(*pos)++;
+			return ent;
+		}
+	}
+	*pos = idx->nents;
+	return NULL;
+}
+
 /*
  * Returns: 0 = success, < 0 error, 1 not found
  */
 int loopcxt_find_by_backing_file(struct loopdev_cxt *lc, const char *filename,
 				 uint64_t offset, uint64_t sizelimit, int flags)
 {
-	int rc, hasst;
+	struct loopdev_idxent *ent;
 	struct stat st;
+	size_t pos = 0;
+	int rc, hasst;
 
 	if (!filename)
 		return -EINVAL;
 
 	hasst = !stat(filename, &st);
 
-	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
-	if (rc)
+	if (!lc->index && (rc = loopcxt_build_index(lc)))
 		return rc;
 
-	while ((rc = loopcxt_next(lc)) == 0) {
-
-		if (loopcxt_is_used(lc, hasst ? &st : NULL,
-				    filename, offset, sizelimit, flags))
-			break;
+	while ((ent = loopcxt_index_next(lc, hasst ? &st : NULL, filename, &pos))) {
+		if ((flags & LOOPDEV_FL_OFFSET) && ent->offset != offset)
+			continue;
+		if ((flags & LOOPDEV_FL_OFFSET) && (flags & LOOPDEV_FL_SIZELIMIT)
+		    && ent->sizelimit != sizelimit)
+			continue;
+		return loopcxt_set_device(lc, ent->device);
 	}
-
-	loopcxt_deinit_iterator(lc);
-	return rc;
+	return 1;
 }
 
 /*
@@ -1855,8 +2157,10 @@ int loopcxt_find_by_backing_file(struct loopdev_cxt *lc, const char *filename,
 int loopcxt_find_overlap(struct loopdev_cxt *lc, const char *filename,
 			   uint64_t offset, uint64_t sizelimit)
 {
-	int rc, hasst;
+	struct loopdev_idxent *ent;
 	struct stat st;
+	size_t pos = 0;
+	int rc = 0, hasst;
 
 	if (!filename)
 		return -EINVAL;
@@ -1864,63 +2168,35 @@ int loopcxt_find_overlap(struct loopdev_cxt *lc, const char *filename,
 	DBG(CXT, ul_debugobj(lc, "find_overlap requested"));
 	hasst = !stat(filename, &st);
 
-	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
-	if (rc)
+	if (!lc->index && (rc = loopcxt_build_index(lc)))
 		return rc;
 
-	while ((rc = loopcxt_next(lc)) == 0) {
-		uint64_t lc_sizelimit, lc_offset;
-
-		rc = loopcxt_is_used(lc, hasst ? &st : NULL,
-				     filename, offset, sizelimit, 0);
-		/*
-		 * Either the loopdev is unused or we've got an error which can
-		 * happen when we are racing with device autoclear. Just ignore
-		 * this loopdev...
-		 */
-		if (rc <= 0)
-			continue;
-
+	while ((ent = loopcxt_index_next(lc, hasst ? &st : NULL, filename, &pos))) {
 		DBG(CXT, ul_debugobj(lc, "found %s backed by %s",
-			loopcxt_get_device(lc), filename));
-
-		rc = loopcxt_get_offset(lc, &lc_offset);
-		if (rc) {
-			DBG(CXT, ul_debugobj(lc, "failed to get offset for device %s",
-				loopcxt_get_device(lc)));
-			continue;
-		}
-		rc = loopcxt_get_sizelimit(lc, &lc_sizelimit);
-		if (rc) {
-			DBG(CXT, ul_debugobj(lc, "failed to get sizelimit for device %s",
-				loopcxt_get_device(lc)));
-			continue;
-		}
+			ent->device, filename));
 
 		/* full match */
-		if (lc_sizelimit == sizelimit && lc_offset == offset) {
+		if (ent->sizelimit == sizelimit && ent->offset == offset) {
 			DBG(CXT, ul_debugobj(lc, "overlapping loop device %s (full match)",
-						loopcxt_get_device(lc)));
+						ent->device));
 			rc = 2;
-			goto found;
+			break;
 		}
 
 		/* overlap */
-		if (lc_sizelimit != 0 && offset >= lc_offset + lc_sizelimit)
+		if (ent->sizelimit != 0 && offset >= ent->offset + ent->sizelimit)
 			continue;
-		if (sizelimit != 0 && offset + sizelimit <= lc_offset)
+		if (sizelimit != 0 && offset + sizelimit <= ent->offset)
 			continue;
 
-		DBG(CXT, ul_debugobj(lc, "overlapping loop device %s",
-			loopcxt_get_device(lc)));
-			rc = 1;
-			goto found;
+		DBG(CXT, ul_debugobj(lc, "overlapping loop device %s", ent->device));
+		rc = 1;
+		break;
 	}
 
-	if (rc == 1)
-		rc = 0;	/* not found */
-found:
-	loopcxt_deinit_iterator(lc);
+	if (rc > 0 && loopcxt_set_device(lc, ent->device))
+		rc = -EINVAL;
+
 	DBG(CXT, ul_debugobj(lc, "find_overlap done [rc=%d]", rc));
 	return rc;
 }
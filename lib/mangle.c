@@ -97,9 +97,7 @@ size_t unhexmangle_to_buffer(const char *s, char *buf, size_t len)
 
 static inline const char *skip_nonspaces(const char *s)
 {
-	while (s && *s && !(*s == ' ' || *s == '\t'))
-		s++;
-	return s;
+	return s ? s + strcspn(s, " \t") : NULL;
 }
 
 /*
@@ -126,7 +124,12 @@ char *unmangle(const char *s, const char **end)
 	if (!buf)
 		return NULL;
 
-	unmangle_to_buffer(s, buf, sz);
+	/* usually there is nothing to unmangle */
+	if (!memchr(s, '\\', sz - 1)) {
+		memcpy(buf, s, sz - 1);
+		buf[sz - 1] = '\0';
+	} else
+		unmangle_to_buffer(s, buf, sz);
 	return buf;
 }
 
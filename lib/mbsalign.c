@@ -15,6 +15,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <limits.h>
 #include <ctype.h>
 
@@ -23,6 +24,48 @@
 #include "strutils.h"
 #include "widechar.h"
 
+#define ASCII_ONES	((uint64_t) 0x0101010101010101ULL)
+#define ASCII_HIGHS	((uint64_t) 0x8080808080808080ULL)
+
+/*
+ * Returns number of leading printable ASCII chars (0x20..0x7e) other than
+ * backslash in @s. Such chars have the same width as number of bytes and
+ * they are not modified by mbs_safe_encode(). The string is checked by words.
+ */
+static size_t safe_ascii_len(const char *s, size_t bytes)
+{
+	const unsigned char *p = (const unsigned char *) s;
+	const unsigned char *end = p + bytes;
+
+	for (; (size_t) (end - p) >= sizeof(uint64_t); p += sizeof(uint64_t)) {
+		uint64_t w, bs;
+
+		memcpy(&w, p, sizeof(w));
+		bs = w ^ (ASCII_ONES * '\\');
+
+		if (((w - ASCII_ONES * 0x20) & ~w & ASCII_HIGHS)	/* byte < 0x20 */
+		    || (((w + ASCII_ONES) | w) & ASCII_HIGHS)	/* byte >= 0x7f */
+		    || ((bs - ASCII_ONES) & ~bs & ASCII_HIGHS))	/* backslash */
+			break;
+	}
+
+	for (; p < end; p++) {
+		if (*p < 0x20 || *p >= 0x7f || *p == '\\')
+			break;
+	}
+	return p - (const unsigned char *) s;
+}
+
+/*
+ * Returns true if @s contains only printable ASCII chars (0x20..0x7e) and no
+ * backslash. Such string has the same width as number of bytes and it's not
+ * modified by mbs_safe_encode().
+ */
+bool mbs_is_safe_ascii(const char *s, size_t bytes)
+{
+	return safe_ascii_len(s, bytes) == bytes;
+}
+
 /*
  * Counts number of cells in multibyte string. All control and
  * non-printable chars are ignored.
@@ -42,6 +85,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = safe_ascii_len(p, last - p + 1);
+
+		if (n) {
+			width += n;
+			p += n;
+			continue;
+		}
 		if (iscntrl((unsigned char) *p)) {
 			p++;
 
@@ -80,9 +130,14 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 
 size_t mbs_width(const char *s)
 {
+	size_t len;
+
 	if (!s || !*s)
 		return 0;
-	return mbs_nwidth(s, strlen(s));
+	len = strlen(s);
+	if (mbs_is_safe_ascii(s, len))
+		return len;
+	return mbs_nwidth(s, len);
 }
 
 /*
@@ -105,6 +160,13 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = safe_ascii_len(p, last - p + 1);
+
+		if (n) {
+			width += n, bytes += n;
+			p += n;
+			continue;
+		}
 		if ((p < last && *p == '\\' && *(p + 1) == 'x')
 		    || iscntrl((unsigned char) *p)) {
 			width += 4, bytes += 4;		/* *p encoded to \x?? */
@@ -152,9 +214,14 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 
 size_t mbs_safe_width(const char *s)
 {
+	size_t len;
+
 	if (!s || !*s)
 		return 0;
-	return mbs_safe_nwidth(s, strlen(s), NULL);
+	len = strlen(s);
+	if (mbs_is_safe_ascii(s, len))
+		return len;
+	return mbs_safe_nwidth(s, len, NULL);
 }
 
 /*
@@ -182,6 +249,15 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const c
 	*width = 0;
 
 	while (p && *p) {
+		size_t n = safe_ascii_len(p, sz - (p - s));
+
+		if (n) {
+			/* printable ASCII is never encoded */
+			r = mempcpy(r, p, n);
+			*width += n;
+			p += n;
+			continue;
+		}
 		if (safechars && strchr(safechars, *p)) {
 			*r++ = *p++;
 			continue;
@@ -78,4 +78,22 @@ int gettime_monotonic(struct timeval *tv)
 #endif
 }
 
+/*
+ * Returns monotonic time in nanoseconds, or 0 on error.
+ */
+nsec_t gettime_monotonic_nsec(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
 
+	if (clock_gettime(UL_CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return timespec_to_nsec(&ts);
+#else
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL) != 0)
+		return 0;
+	return timeval_to_usec(&tv) * NSEC_PER_USEC;
+#endif
+}
@@ -97,12 +97,77 @@ void ul_unref_path(struct path_cxt *pc)
 		if (pc->dialect)
 			pc->free_dialect(pc);
 		ul_path_close_dirfd(pc);
+		ul_path_enable_cache(pc, 0);
 		free(pc->dir_path);
 		free(pc->prefix);
 		free(pc);
 	}
 }
 
+static void path_cache_reset(struct path_cxt *pc)
+{
+	size_t i;
+
+	if (!pc->nattrs)
+		return;
+
+	DBG(CXT, ul_debugobj(pc, "reset cache [%zu files]", pc->nattrs));
+	for (i = 0; i < pc->nattrs; i++)
+		free(pc->attrs[i].name);	/* data share the allocation */
+	free(pc->attrs);
+	pc->attrs = NULL;
+	pc->nattrs = 0;
+}
+
+/*
+ * Cache the content of the files read by ul_path_read() and the other
+ * ul_path_read_*() functions. The next read of the same file is served from
+ * memory. This is useful for sysfs attributes which do not change during the
+ * program run (e.g. lsblk). The cache is dropped on any write by the context
+ * or when the directory is changed.
+ */
+void ul_path_enable_cache(struct path_cxt *pc, int enable)
+{
+	if (!enable)
+		path_cache_reset(pc);
+	pc->cache_attrs = enable ? 1 : 0;
+}
+
+static struct path_attr *path_cache_get(struct path_cxt *pc, const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < pc->nattrs; i++) {
+		if (strcmp(pc->attrs[i].name, path) == 0)
+			return &pc->attrs[i];
+	}
+	return NULL;
+}
+
+/* @data is NULL if the file does not exist */
+static void path_cache_add(struct path_cxt *pc, const char *path,
+			   const char *data, size_t datasz)
+{
+	struct path_attr *attrs, *a;
+	size_t namesz = strlen(path) + 1;
+	char *buf;
+
+	buf = malloc(namesz + datasz);
+	if (!buf)
+		return;
+	attrs = realloc(pc->attrs, (pc->nattrs + 1) * sizeof(*attrs));
+	if (!attrs) {
+		free(buf);
+		return;
+	}
+	pc->attrs = attrs;
+
+	a = &pc->attrs[pc->nattrs++];
+	a->name = memcpy(buf, path, namesz);
+	a->data = data ? memcpy(buf + namesz, data, datasz) : NULL;
+	a->datasz = datasz;
+}
+
 int ul_path_set_prefix(struct path_cxt *pc, const char *prefix)
 {
 	char *p = NULL;
@@ -117,6 +182,7 @@ int ul_path_set_prefix(struct path_cxt *pc, const char *prefix)
 
 	free(pc->prefix);
 	pc->prefix = p;
+	path_cache_reset(pc);
 	DBG(CXT, ul_debugobj(pc, "new prefix: '%s'", p));
 	return 0;
 }
@@ -143,6 +209,7 @@ int ul_path_set_dir(struct path_cxt *pc, const char *dir)
 
 	free(pc->dir_path);
 	pc->dir_path = p;
+	path_cache_reset(pc);
 	DBG(CXT, ul_debugobj(pc, "new dir: '%s'", p));
 	return 0;
 }
@@ -592,15 +659,37 @@ int ul_path_read(struct path_cxt *pc, char *buf, size_t len, const char *path)
 	int rc, errsv;
 	int fd;
 
+	if (pc && pc->cache_attrs && path) {
+		const struct path_attr *a = path_cache_get(pc, path);
+
+		if (a) {
+			if (!a->data) {
+				errno = ENOENT;
+				return -ENOENT;
+			}
+			rc = min(a->datasz, len);
+			memcpy(buf, a->data, rc);
+			return rc;
+		}
+	}
+
 	fd = ul_path_open(pc, O_RDONLY|O_CLOEXEC, path);
-	if (fd < 0)
+	if (fd < 0) {
+		if (errno == ENOENT && pc && pc->cache_attrs && path)
+			path_cache_add(pc, path, NULL, 0);
 		return -errno;
+	}
 
 	DBG(CXT, ul_debug(" reading '%s'", path));
 	rc = read_all(fd, buf, len);
 
 	errsv = errno;
 	close(fd);
+
+	/* cache complete content only */
+	if (rc >= 0 && (size_t) rc < len && pc && pc->cache_attrs)
+		path_cache_add(pc, path, buf, rc);
+
 	errno = errsv;
 	return rc;
 }
@@ -739,13 +828,35 @@ int ul_path_scanff(struct path_cxt *pc, const char *path, va_list ap, const char
 }
 
 
+/*
+ * Reads the number at the beginning of the file. The file is read by
+ * ul_path_read(), so the cache is used if enabled.
+ */
+static int path_read_num(struct path_cxt *pc, const char *path,
+			 int is_signed, int64_t *sres, uint64_t *ures)
+{
+	char buf[64], *end = NULL;
+	int rc;
+
+	rc = ul_path_read_buffer(pc, buf, sizeof(buf), path);
+	if (rc <= 0)
+		return -1;
+
+	errno = 0;
+	if (is_signed)
+		*sres = strtoimax(buf, &end, 10);
+	else
+		*ures = strtoumax(buf, &end, 10);
+	if (errno || !end || end == buf)
+		return -1;
+	return 0;
+}
+
 int ul_path_read_s64(struct path_cxt *pc, int64_t *res, const char *path)
 {
 	int64_t x = 0;
-	int rc;
 
-	rc = ul_path_scanf(pc, path, "%"SCNd64, &x);
-	if (rc != 1)
+	if (path_read_num(pc, path, 1, &x, NULL) != 0)
 		return -1;
 	if (res)
 		*res = x;
@@ -767,10 +878,8 @@ int ul_path_readf_s64(struct path_cxt *pc, int64_t *res, const char *path, ...)
 int ul_path_read_u64(struct path_cxt *pc, uint64_t *res, const char *path)
 {
 	uint64_t x = 0;
-	int rc;
 
-	rc = ul_path_scanf(pc, path, "%"SCNu64, &x);
-	if (rc != 1)
+	if (path_read_num(pc, path, 0, NULL, &x) != 0)
 		return -1;
 	if (res)
 		*res = x;
@@ -791,10 +900,9 @@ int ul_path_readf_u64(struct path_cxt *pc, uint64_t *res, const char *path, ...)
 
 int ul_path_read_s32(struct path_cxt *pc, int *res, const char *path)
 {
-	int rc, x = 0;
+	int64_t x = 0;
 
-	rc = ul_path_scanf(pc, path, "%d", &x);
-	if (rc != 1)
+	if (path_read_num(pc, path, 1, &x, NULL) != 0 || x < INT_MIN || x > INT_MAX)
 		return -1;
 	if (res)
 		*res = x;
@@ -815,11 +923,9 @@ int ul_path_readf_s32(struct path_cxt *pc, int *res, const char *path, ...)
 
 int ul_path_read_u32(struct path_cxt *pc, unsigned int *res, const char *path)
 {
-	int rc;
-	unsigned int x = 0;
+	uint64_t x = 0;
 
-	rc = ul_path_scanf(pc, path, "%u", &x);
-	if (rc != 1)
+	if (path_read_num(pc, path, 0, NULL, &x) != 0 || x > UINT_MAX)
 		return -1;
 	if (res)
 		*res = x;
@@ -867,6 +973,8 @@ int ul_path_write_string(struct path_cxt *pc, const char *str, const char *path)
 	int rc, errsv;
 	int fd;
 
+	if (pc)
+		path_cache_reset(pc);
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -897,6 +1005,8 @@ int ul_path_write_s64(struct path_cxt *pc, int64_t num, const char *path)
 	int rc, errsv;
 	int fd, len;
 
+	if (pc)
+		path_cache_reset(pc);
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -919,6 +1029,8 @@ int ul_path_write_u64(struct path_cxt *pc, uint64_t num, const char *path)
 	int rc, errsv;
 	int fd, len;
 
+	if (pc)
+		path_cache_reset(pc);
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -1092,6 +1204,7 @@ int ul_path_readf_cpulist(struct path_cxt *pc, cpu_set_t **set, int maxcpus, con
 static void __attribute__((__noreturn__)) usage(void)
 {
 	fprintf(stdout, " %s [options] <dir> <command>\n\n", program_invocation_short_name);
+	fputs(" -c, --cache             cache the read files\n", stdout);
 	fputs(" -p, --prefix <dir>      redirect hardcoded paths to <dir>\n", stdout);
 
 	fputs(" Commands:\n", stdout);
@@ -1110,18 +1223,22 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char *argv[])
 {
-	int c;
+	int c, cache = 0;
 	const char *prefix = NULL, *dir, *file, *command;
 	struct path_cxt *pc = NULL;
 
 	static const struct option longopts[] = {
+		{ "cache",	0, NULL, 'c' },
 		{ "prefix",	1, NULL, 'p' },
 		{ "help",       0, NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
 	};
 
-	while((c = getopt_long(argc, argv, "p:h", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "cp:h", longopts, NULL)) != -1) {
 		switch(c) {
+		case 'c':
+			cache = 1;
+			break;
 		case 'p':
 			prefix = optarg;
 			break;
@@ -1144,6 +1261,8 @@ int main(int argc, char *argv[])
 		err(EXIT_FAILURE, "failed to initialize path context");
 	if (prefix)
 		ul_path_set_prefix(pc, prefix);
+	if (cache)
+		ul_path_enable_cache(pc, 1);
 
 	if (optind == argc)
 		errx(EXIT_FAILURE, "<command> not defined");
@@ -7,6 +7,7 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 
 #ifdef HAVE_SYS_VFS_H
 # include <sys/vfs.h>
@@ -449,6 +450,494 @@ char *pid_get_cmdline(pid_t pid)
 	return strdup_procfs_file(pid, "cmdline");
 }
 
+struct procfs_ppid {
+	pid_t pid;
+	pid_t ppid;
+};
+
+static int cmp_ppid(const void *a, const void *b)
+{
+	const struct procfs_ppid *x = a, *y = b;
+
+	return x->ppid < y->ppid ? -1 : x->ppid > y->ppid;
+}
+
+static int append_pid(pid_t **ary, size_t *n, size_t *sz, pid_t pid)
+{
+	if (*n == *sz) {
+		size_t nsz = *sz ? *sz * 2 : 64;
+		pid_t *tmp = realloc(*ary, nsz * sizeof(pid_t));
+
+		if (!tmp)
+			return -ENOMEM;
+		*ary = tmp;
+		*sz = nsz;
+	}
+	(*ary)[(*n)++] = pid;
+	return 0;
+}
+
+/* returns the parent PID from /proc/<pid>/stat */
+static int procfs_dirent_get_ppid(DIR *procfs, struct dirent *d, pid_t *ppid)
+{
+	char buf[BUFSIZ], name[sizeof(d->d_name) + 5];
+	char *p;
+	ssize_t sz;
+	int fd, num;
+
+	snprintf(name, sizeof(name), "%s/stat", d->d_name);
+	fd = openat(dirfd(procfs), name, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	sz = read_procfs_file(fd, buf, sizeof(buf));
+	close(fd);
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* the command name may contain anything, the state follows the last ')' */
+	p = strrchr(buf, ')');
+	if (!p || sscanf(p + 1, " %*c %d", &num) != 1)
+		return -EINVAL;
+
+	*ppid = num;
+	return 0;
+}
+
+/*
+ * Returns @pid and the PIDs of all its descendants in @ary; the array is
+ * allocated and the caller is responsible to free it. The process tree is
+ * read by one pass over /proc.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int procfs_get_descendants(pid_t pid, pid_t **ary, size_t *n)
+{
+	struct procfs_ppid *procs = NULL;
+	size_t nprocs = 0, procsz = 0, i, sz = 0;
+	struct dirent *d;
+	DIR *dir;
+	int rc = 0;
+
+	*ary = NULL;
+	*n = 0;
+
+	dir = opendir(_PATH_PROC);
+	if (!dir)
+		return -errno;
+
+	while ((d = xreaddir(dir))) {
+		struct procfs_ppid x;
+
+		if (procfs_dirent_get_pid(d, &x.pid) != 0 ||
+		    procfs_dirent_get_ppid(dir, d, &x.ppid) != 0)
+			continue;
+		if (nprocs == procsz) {
+			size_t nsz = procsz ? procsz * 2 : 256;
+			struct procfs_ppid *tmp = realloc(procs, nsz * sizeof(*procs));
+
+			if (!tmp) {
+				rc = -ENOMEM;
+				goto done;
+			}
+			procs = tmp;
+			procsz = nsz;
+		}
+		procs[nprocs++] = x;
+	}
+
+	qsort(procs, nprocs, sizeof(*procs), cmp_ppid);
+
+	/* breadth-first walk, the result array is also the queue */
+	rc = append_pid(ary, n, &sz, pid);
+	for (i = 0; rc == 0 && i < *n; i++) {
+		struct procfs_ppid key = { .ppid = (*ary)[i] }, *x;
+
+		x = bsearch(&key, procs, nprocs, sizeof(*procs), cmp_ppid);
+		if (!x)
+			continue;
+		while (x > procs && (x - 1)->ppid == key.ppid)
+			x--;
+		for (; rc == 0 && x < procs + nprocs && x->ppid == key.ppid; x++) {
+			if (x->pid != key.ppid)		/* PID 0 is its own parent */
+				rc = append_pid(ary, n, &sz, x->pid);
+		}
+	}
+done:
+	closedir(dir);
+	free(procs);
+	if (rc) {
+		free(*ary);
+		*ary = NULL;
+		*n = 0;
+	}
+	return rc;
+}
+
+/*
+ * Returns the IDs of all tasks (threads) on the system accepted by @filter.
+ * The callback gets the task name (comm) and the PF_* flags as read from
+ * /proc/<pid>/task/<tid>/stat; the tasks are read by one pass over /proc.
+ * The array is allocated and the caller is responsible to free it.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int procfs_get_tasks(int (*filter)(pid_t tid, const char *comm,
+				   unsigned int flags, void *data),
+		     void *data, pid_t **ary, size_t *n)
+{
+	struct dirent *d;
+	size_t sz = 0;
+	DIR *dir;
+	int rc = 0;
+
+	*ary = NULL;
+	*n = 0;
+
+	dir = opendir(_PATH_PROC);
+	if (!dir)
+		return -errno;
+
+	while (rc == 0 && (d = xreaddir(dir))) {
+		char name[sizeof(d->d_name) + 5];
+		struct dirent *t;
+		pid_t pid;
+		DIR *sub;
+		int fd;
+
+		if (procfs_dirent_get_pid(d, &pid) != 0)
+			continue;
+		snprintf(name, sizeof(name), "%s/task", d->d_name);
+		fd = openat(dirfd(dir), name, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		sub = fdopendir(fd);
+		if (!sub) {
+			close(fd);
+			continue;
+		}
+
+		while (rc == 0 && (t = xreaddir(sub))) {
+			char buf[BUFSIZ], *comm, *p;
+			unsigned int flags;
+			pid_t tid;
+			ssize_t len;
+			int sfd;
+
+			if (procfs_dirent_get_pid(t, &tid) != 0)
+				continue;
+			snprintf(name, sizeof(name), "%s/stat", t->d_name);
+			sfd = openat(dirfd(sub), name, O_RDONLY|O_CLOEXEC);
+			if (sfd < 0)
+				continue;
+			len = read_procfs_file(sfd, buf, sizeof(buf));
+			close(sfd);
+			if (len <= 0)
+				continue;
+
+			/* "tid (comm) state ppid pgrp session tty tpgid flags ..." */
+			comm = strchr(buf, '(');
+			p = strrchr(buf, ')');
+			if (!comm || !p || p < comm
+			    || sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %u", &flags) != 1)
+				continue;
+			*p = '\0';
+
+			if (filter(tid, comm + 1, flags, data))
+				rc = append_pid(ary, n, &sz, tid);
+		}
+		closedir(sub);
+	}
+
+	closedir(dir);
+	if (rc) {
+		free(*ary);
+		*ary = NULL;
+		*n = 0;
+	}
+	return rc;
+}
+
+/*
+ * Parallel walk over processes.
+ *
+ * The PIDs are handed out to the workers one by one from a shared index. The
+ * first worker runs in the caller; if a thread cannot be created, the work is
+ * done by the workers which are already running.
+ */
+struct procfs_walk_cxt {
+	const pid_t	*pids;
+	size_t		npids;
+	size_t		next;		/* next PID to visit */
+	int		rc;		/* the first error, stops the walk */
+
+	int		(*fn)(struct procfs_walker *w);
+	pthread_mutex_t	lock;
+};
+
+struct procfs_walk_thread {
+	struct procfs_walk_cxt	*cxt;
+	struct procfs_walker	w;
+	pthread_t		thread;
+	unsigned int		started : 1;
+};
+
+static void *walk_worker(void *arg)
+{
+	struct procfs_walk_thread *th = arg;
+	struct procfs_walk_cxt *cxt = th->cxt;
+	struct procfs_walker *w = &th->w;
+
+	for (;;) {
+		size_t i;
+		int rc;
+
+		pthread_mutex_lock(&cxt->lock);
+		i = cxt->rc ? cxt->npids : cxt->next++;
+		pthread_mutex_unlock(&cxt->lock);
+		if (i >= cxt->npids)
+			break;
+
+		/* the process is gone */
+		if (procfs_process_init_path(w->pc, cxt->pids[i]) != 0)
+			continue;
+
+		w->pid = cxt->pids[i];
+		w->idx = i;
+		rc = cxt->fn(w);
+
+		/* don't keep the directory open, there may be many workers */
+		ul_path_close_dirfd(w->pc);
+
+		if (rc < 0) {
+			pthread_mutex_lock(&cxt->lock);
+			if (!cxt->rc)
+				cxt->rc = rc;
+			pthread_mutex_unlock(&cxt->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int get_all_pids(const char *prefix, pid_t **ary, size_t *n)
+{
+	char path[PATH_MAX];
+	struct dirent *d;
+	size_t sz = 0;
+	DIR *dir;
+	int rc = 0;
+
+	*ary = NULL;
+	*n = 0;
+
+	snprintf(path, sizeof(path), "%s" _PATH_PROC, prefix ? prefix : "");
+	dir = opendir(path);
+	if (!dir)
+		return -errno;
+
+	while (rc == 0 && (d = xreaddir(dir))) {
+		pid_t pid;
+
+		if (procfs_dirent_get_pid(d, &pid) == 0)
+			rc = append_pid(ary, n, &sz, pid);
+	}
+	closedir(dir);
+	return rc;
+}
+
+/*
+ * Calls @fn for every process in @pids, or for every process in /proc if
+ * @pids is NULL, from @nworkers threads. Every worker has its own path
+ * context and read buffer (see procfs_walker_read()); everything else the
+ * callback shares with other workers has to be protected by the caller.
+ * The processes are visited in parallel and in no particular order; use
+ * @w->idx to keep the results in the order of @pids (or of /proc).
+ *
+ * The callback returns 0 to continue or <0 to stop the walk. Processes which
+ * disappear before they are visited are skipped.
+ *
+ * Returns: 0 on success, <0 on error or the error returned by @fn.
+ */
+int procfs_walk_processes(const char *prefix, const pid_t *pids, size_t npids,
+			  size_t nworkers,
+			  int (*fn)(struct procfs_walker *w), void *data)
+{
+	struct procfs_walk_cxt cxt = { .fn = fn };
+	struct procfs_walk_thread *ths = NULL;
+	pid_t *all = NULL;
+	size_t i;
+	int rc;
+
+	if (!fn)
+		return -EINVAL;
+	if (!pids) {
+		rc = get_all_pids(prefix, &all, &npids);
+		if (rc)
+			return rc;
+		pids = all;
+	}
+	if (!npids)
+		goto done;
+
+	cxt.pids = pids;
+	cxt.npids = npids;
+	nworkers = max(min(nworkers, npids), (size_t) 1);
+
+	DBG(CXT, ul_debug("walk: %zu processes, %zu workers", npids, nworkers));
+
+	ths = calloc(nworkers, sizeof(*ths));
+	if (!ths) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	for (i = 0; i < nworkers; i++) {
+		ths[i].cxt = &cxt;
+		ths[i].w.worker = i;
+		ths[i].w.data = data;
+		ths[i].w.pc = ul_new_path(NULL);
+		if (!ths[i].w.pc) {
+			rc = -ENOMEM;
+			goto done;
+		}
+		if (prefix && ul_path_set_prefix(ths[i].w.pc, prefix) != 0) {
+			rc = -ENOMEM;
+			goto done;
+		}
+	}
+
+	pthread_mutex_init(&cxt.lock, NULL);
+	for (i = 1; i < nworkers; i++) {
+		if (pthread_create(&ths[i].thread, NULL, walk_worker, &ths[i]) != 0) {
+			DBG(CXT, ul_debug("walk: cannot create worker %zu", i));
+			break;
+		}
+		ths[i].started = 1;
+	}
+	walk_worker(&ths[0]);
+
+	for (i = 1; i < nworkers; i++) {
+		if (ths[i].started)
+			pthread_join(ths[i].thread, NULL);
+	}
+	pthread_mutex_destroy(&cxt.lock);
+	rc = cxt.rc;
+done:
+	for (i = 0; ths && i < nworkers; i++) {
+		ul_unref_path(ths[i].w.pc);
+		free(ths[i].w.buf);
+	}
+	free(ths);
+	free(all);
+	return rc;
+}
+
+/*
+ * Reads the whole file @fname of the current process to the worker buffer;
+ * the buffer grows as needed and the data are terminated by '\0'.
+ *
+ * Returns: the size of the data or <0 on error.
+ */
+ssize_t procfs_walker_read(struct procfs_walker *w, const char *fname)
+{
+	size_t len = 0;
+	int fd;
+
+	fd = ul_path_open(w->pc, O_RDONLY|O_CLOEXEC, fname);
+	if (fd < 0)
+		return -errno;
+
+	for (;;) {
+		ssize_t sz;
+		size_t avail;
+
+		if (w->bufsz - len < 2) {
+			size_t nsz = w->bufsz ? w->bufsz * 2 : BUFSIZ;
+			char *tmp = realloc(w->buf, nsz);
+
+			if (!tmp) {
+				close(fd);
+				return -ENOMEM;
+			}
+			w->buf = tmp;
+			w->bufsz = nsz;
+		}
+
+		avail = w->bufsz - len - 1;
+		sz = read_all(fd, w->buf + len, avail);
+		if (sz < 0) {
+			int rc = -errno;
+
+			close(fd);
+			return rc;
+		}
+		len += sz;
+		if ((size_t) sz < avail)
+			break;		/* EOF */
+	}
+
+	close(fd);
+	w->buf[len] = '\0';
+	return len;
+}
+
+static FILE *cgroup_fopen(const char *path, const char *file)
+{
+	char *fn;
+	FILE *f;
+	int rc;
+
+	if (strncmp(path, _PATH_SYS_CGROUP "/", sizeof(_PATH_SYS_CGROUP)) == 0)
+		rc = asprintf(&fn, "%s/%s", path, file);
+	else {
+		while (*path == '/')
+			path++;
+		rc = asprintf(&fn, _PATH_SYS_CGROUP "/%s%s%s",
+				path, *path ? "/" : "", file);
+	}
+	if (rc < 0)
+		return NULL;
+
+	f = fopen(fn, "r" UL_CLOEXECSTR);
+	free(fn);
+	return f;
+}
+
+/*
+ * Returns the PIDs (or thread IDs if @threads is true) of all tasks in the
+ * cgroup @path. The path is either absolute, or relative to the cgroup
+ * filesystem mountpoint (as in /proc/<pid>/cgroup). The array is allocated
+ * and the caller is responsible to free it.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int ul_cgroup_get_tasks(const char *path, int threads, pid_t **ary, size_t *n)
+{
+	size_t sz = 0;
+	FILE *f;
+	int rc = 0, num;
+
+	*ary = NULL;
+	*n = 0;
+
+	errno = 0;
+	f = cgroup_fopen(path, threads ? "cgroup.threads" : "cgroup.procs");
+	if (!f && threads && errno == ENOENT)
+		f = cgroup_fopen(path, "tasks");		/* cgroup v1 */
+	if (!f)
+		return errno ? -errno : -ENOMEM;
+
+	while (rc == 0 && fscanf(f, "%d", &num) == 1)
+		rc = append_pid(ary, n, &sz, num);
+
+	fclose(f);
+	if (rc) {
+		free(*ary);
+		*ary = NULL;
+		*n = 0;
+	}
+	return rc;
+}
+
 #ifdef TEST_PROGRAM_PROCFS
 
 static int test_tasks(int argc, char *argv[], const char *prefix)
@@ -606,6 +1095,99 @@ static int test_process_stat_nth(int argc, char *argv[], const char *prefix)
 	return EXIT_SUCCESS;
 }
 
+static int test_pids(int argc, char *argv[])
+{
+	pid_t *pids = NULL;
+	size_t i, n = 0;
+	int rc;
+
+	if (argc != 2)
+		return EXIT_FAILURE;
+	if (strcmp(argv[0], "--descendants") == 0)
+		rc = procfs_get_descendants(strtol(argv[1], (char **) NULL, 10), &pids, &n);
+	else
+		rc = ul_cgroup_get_tasks(argv[1], strcmp(argv[0], "--cgroup-threads") == 0, &pids, &n);
+	if (rc)
+		errx(EXIT_FAILURE, "cannot read PIDs: %s", strerror(-rc));
+
+	for (i = 0; i < n; i++)
+		printf(" %d", (int) pids[i]);
+	fputc('\n', stdout);
+	free(pids);
+	return EXIT_SUCCESS;
+}
+
+struct test_walk {
+	pid_t	pid;
+	char	*comm;
+};
+
+static int test_walk_cb(struct procfs_walker *w)
+{
+	struct test_walk *res = w->data;
+	ssize_t sz;
+
+	sz = procfs_walker_read(w, "comm");
+	if (sz <= 0)
+		return 0;
+	if (w->buf[sz - 1] == '\n')
+		w->buf[sz - 1] = '\0';
+	res[w->idx].pid = w->pid;
+	res[w->idx].comm = strdup(w->buf);
+	return res[w->idx].comm ? 0 : -ENOMEM;
+}
+
+static int cmp_test_walk(const void *a, const void *b)
+{
+	const struct test_walk *x = a, *y = b;
+
+	return x->pid < y->pid ? -1 : x->pid > y->pid;
+}
+
+static int test_walk(int argc, char *argv[], const char *prefix)
+{
+	struct test_walk *res;
+	pid_t *pids = NULL;
+	size_t i, n = 0, nworkers;
+	int rc;
+
+	if (argc < 2)
+		return EXIT_FAILURE;
+	nworkers = strtoul(argv[1], (char **) NULL, 10);
+
+	if (argc > 2) {
+		n = argc - 2;
+		pids = calloc(n, sizeof(pid_t));
+		if (!pids)
+			err(EXIT_FAILURE, "cannot allocate PIDs");
+		for (i = 0; i < n; i++)
+			pids[i] = strtol(argv[i + 2], (char **) NULL, 10);
+	} else {
+		/* big enough for any /proc in tests */
+		n = 1 << 20;
+	}
+
+	res = calloc(n, sizeof(*res));
+	if (!res)
+		err(EXIT_FAILURE, "cannot allocate results");
+
+	rc = procfs_walk_processes(prefix, pids, pids ? n : 0, nworkers,
+				   test_walk_cb, res);
+	if (rc)
+		errx(EXIT_FAILURE, "walk failed: %s", strerror(-rc));
+
+	qsort(res, n, sizeof(*res), cmp_test_walk);
+	for (i = 0; i < n; i++) {
+		if (!res[i].comm)
+			continue;
+		printf("%d: '%s'\n", (int) res[i].pid, res[i].comm);
+		free(res[i].comm);
+	}
+	free(res);
+	free(pids);
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[])
 {
 	const char *prefix = NULL;
@@ -622,7 +1204,10 @@ int main(int argc, char *argv[])
 				"       %1$s --is-procfs [<dir>]\n"
 				"       %1$s --processes [--name <name>] [--uid <uid>]\n"
 				"       %1$s [--prefix <prefix>] --one <pid>\n"
-				"       %1$s [--prefix <prefix>] --stat-nth <pid> <n>\n",
+				"       %1$s [--prefix <prefix>] --stat-nth <pid> <n>\n"
+				"       %1$s --descendants <pid>\n"
+				"       %1$s --cgroup[-threads] <path>\n"
+				"       %1$s [--prefix <prefix>] --walk <nworkers> [<pid> ...]\n",
 				program_invocation_short_name);
 		return EXIT_FAILURE;
 	}
@@ -639,6 +1224,11 @@ int main(int argc, char *argv[])
 		return test_one_process(argc - 1, argv + 1, prefix);
 	if (strcmp(argv[1], "--stat-nth") == 0)
 		return test_process_stat_nth(argc - 1, argv + 1, prefix);
+	if (strcmp(argv[1], "--descendants") == 0 ||
+	    strncmp(argv[1], "--cgroup", 8) == 0)
+		return test_pids(argc - 1, argv + 1);
+	if (strcmp(argv[1], "--walk") == 0)
+		return test_walk(argc - 1, argv + 1, prefix);
 
 	return EXIT_FAILURE;
 }
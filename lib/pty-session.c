@@ -12,6 +12,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
 #include <pty.h>
 #include <poll.h>
 #include <sys/signalfd.h>
@@ -43,6 +44,18 @@ UL_DEBUG_DEFINE_MASKNAMES(ulpty) = UL_DEBUG_EMPTY_MASKNAMES;
 #define UL_DEBUG_CURRENT_MASK   UL_DEBUG_MASK(ulpty)
 #include "debugobj.h"
 
+/*
+ * The master --> stdout buffer starts small (interactive use) and grows up
+ * to PTY_MASTER_BUFSZ_MAX when the child produces bulk output. All data
+ * already available on master is read before it's written to stdout and
+ * logged, but we never wait for more data.
+ */
+#define PTY_MASTER_BUFSZ_MIN	BUFSIZ
+#define PTY_MASTER_BUFSZ_MAX	(128 * 1024)
+
+/* max size of one splice() master --> pipe --> stdout */
+#define PTY_SPLICE_MAX		(64 * 1024)
+
 void ul_pty_init_debug(int mask)
 {
 	if (ulpty_debug_mask)
@@ -63,6 +76,7 @@ struct ul_pty *ul_new_pty(int is_stdin_tty)
 	pty->slave = -1;
 	pty->sigfd = -1;
 	pty->child = (pid_t) -1;
+	pty->splice_pipe[0] = pty->splice_pipe[1] = -1;
 
 	return pty;
 }
@@ -80,6 +94,13 @@ void ul_free_pty(struct ul_pty *pty)
 		pty->free_buffers = hd->next;
 		free(hd);
 	}
+
+	if (pty->splice_pipe[0] >= 0)
+		close(pty->splice_pipe[0]);
+	if (pty->splice_pipe[1] >= 0)
+		close(pty->splice_pipe[1]);
+
+	free(pty->master_buf);
 	free(pty);
 }
 
@@ -445,9 +466,117 @@ static int mainloop_callback(struct ul_pty *pty)
 	return rc;
 }
 
+/* returns 1 if data are ready to read on @fd, never waits */
+static int is_readable(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+/*
+ * Reads all data already available on master to the master buffer. The
+ * buffer is enlarged if the child writes faster than we read.
+ */
+static ssize_t read_master(struct ul_pty *pty)
+{
+	size_t done = 0;
+
+	if (!pty->master_buf) {
+		pty->master_bufsz = PTY_MASTER_BUFSZ_MIN;
+		pty->master_buf = malloc(pty->master_bufsz);
+		if (!pty->master_buf)
+			return -1;
+	}
+
+	do {
+		ssize_t bytes = read(pty->master, pty->master_buf + done,
+				     pty->master_bufsz - done);
+		if (bytes <= 0) {
+			if (done)
+				break;		/* report error on next read */
+			return bytes;
+		}
+		done += bytes;
+	} while (done < pty->master_bufsz && is_readable(pty->master));
+
+	if (done == pty->master_bufsz && pty->master_bufsz < PTY_MASTER_BUFSZ_MAX) {
+		char *p = realloc(pty->master_buf, pty->master_bufsz * 2);
+
+		if (p) {
+			pty->master_buf = p;
+			pty->master_bufsz *= 2;
+			DBG(IO, ul_debugobj(pty, " master buffer enlarged to %zu",
+						pty->master_bufsz));
+		}
+	}
+	return done;
+}
+
+/*
+ * Moves data from master to stdout by splice() through a pipe. This is
+ * possible only if the data are not required by callbacks.
+ *
+ * Returns: number of bytes, 0 on EOF, <0 on error, 1 and @unsupported
+ * when splice() is not possible (nothing read).
+ */
+static ssize_t splice_master(struct ul_pty *pty, int *unsupported)
+{
+	ssize_t bytes, done = 0;
+
+	*unsupported = 0;
+
+	if (pty->splice_pipe[0] < 0 && pipe2(pty->splice_pipe, O_CLOEXEC) != 0)
+		goto unsupported;
+
+	bytes = splice(pty->master, NULL, pty->splice_pipe[1], NULL,
+		       PTY_SPLICE_MAX, 0);
+	if (bytes < 0 && errno == EINVAL)
+		goto unsupported;
+	if (bytes <= 0)
+		return bytes;
+
+	while (done < bytes) {
+		ssize_t ret = splice(pty->splice_pipe[0], NULL, STDOUT_FILENO, NULL,
+				     bytes - done, 0);
+		if (ret > 0) {
+			done += ret;
+			continue;
+		}
+		if (ret < 0 && (errno == EINTR || errno == EAGAIN)) {
+			struct pollfd pfd = { .fd = STDOUT_FILENO, .events = POLLOUT };
+
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
+		/* stdout does not support splice() (e.g. O_APPEND file); copy
+		 * the rest of the data from the pipe and don't use it again */
+		DBG(IO, ul_debugobj(pty, " splice() to stdout failed, use write()"));
+		pty->nosplice = 1;
+		while (done < bytes) {
+			char buf[BUFSIZ];
+
+			ret = read(pty->splice_pipe[0], buf,
+				   min((size_t) (bytes - done), sizeof(buf)));
+			if (ret <= 0)
+				return -errno;
+			write_output(buf, ret);
+			done += ret;
+		}
+	}
+	return bytes;
+
+unsupported:
+	DBG(IO, ul_debugobj(pty, " splice() unsupported"));
+	pty->nosplice = 1;
+	*unsupported = 1;
+	return 1;
+}
+
 static int handle_io(struct ul_pty *pty, int fd, int *eof)
 {
-	char buf[BUFSIZ];
+	char stdin_buf[BUFSIZ], *buf = stdin_buf;
 	ssize_t bytes;
 	int rc = 0;
 	sigset_t set;
@@ -455,11 +584,31 @@ static int handle_io(struct ul_pty *pty, int fd, int *eof)
 	DBG(IO, ul_debugobj(pty, " handle I/O on fd=%d", fd));
 	*eof = 0;
 
+	/* from command (master) to stdout without callback */
+	if (fd == pty->master && !pty->callbacks.log_stream_activity
+	    && !pty->nosplice) {
+		int unsupported;
+
+		bytes = splice_master(pty, &unsupported);
+		if (!unsupported) {
+			DBG(IO, ul_debugobj(pty, " master --> stdout %zd bytes spliced", bytes));
+			if (bytes < 0)
+				return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+			if (bytes == 0)
+				*eof = 1;
+			return 0;
+		}
+	}
+
 	sigemptyset(&set);
 	sigaddset(&set, SIGTTIN);
 	sigprocmask(SIG_UNBLOCK, &set, NULL);
 	/* read from active FD */
-	bytes = read(fd, buf, sizeof(buf));
+	if (fd == pty->master) {
+		bytes = read_master(pty);
+		buf = pty->master_buf;
+	} else
+		bytes = read(fd, stdin_buf, sizeof(stdin_buf));
 	sigprocmask(SIG_BLOCK, &set, NULL);
 	if (bytes == -1) {
 		if (errno == EAGAIN || errno == EINTR)
@@ -581,14 +581,73 @@ static int get_exp(uint64_t n)
 	return shft - 10;
 }
 
-char *size_to_human_string(int options, uint64_t bytes)
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/*
+ * Writes decimal @num to @buf (see UL_U64_BUFSIZ), without snprintf().
+ *
+ * Returns: @buf or NULL if the buffer is too small.
+ */
+char *ul_u64_to_buf(uint64_t num, char *buf, size_t bufsz)
+{
+	char tmp[UL_U64_BUFSIZ], *p = tmp + sizeof(tmp);
+	size_t len;
+
+	*--p = '\0';
+	while (num >= 100) {
+		unsigned int i = (num % 100) * 2;
+
+		num /= 100;
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	}
+	if (num >= 10) {
+		unsigned int i = num * 2;
+
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	} else
+		*--p = '0' + num;
+
+	len = tmp + sizeof(tmp) - p;
+	if (len > bufsz)
+		return NULL;
+	memcpy(buf, p, len);
+	return buf;
+}
+
+/* Returns allocated decimal string or NULL */
+char *u64_to_string(uint64_t num)
+{
+	char buf[UL_U64_BUFSIZ];
+
+	return strdup(ul_u64_to_buf(num, buf, sizeof(buf)));
+}
+
+/*
+ * Same as size_to_human_string(), but writes the result to @buf (see
+ * UL_HUMAN_BUFSIZ).
+ *
+ * Returns: @buf or NULL if the buffer is too small.
+ */
+char *size_to_human_buf(int options, uint64_t bytes, char *buf, size_t bufsz)
 {
-	char buf[32];
-	int dec, exp;
-	uint64_t frac;
+	int exp;
+	uint64_t dec, frac;
 	const char *letters = "BKMGTPE";
 	char suffix[sizeof(" KiB")], *psuf = suffix;
-	char c;
+	char c, *p;
+	size_t len;
 
 	if (options & SIZE_SUFFIX_SPACE)
 		*psuf++ = ' ';
@@ -635,26 +694,43 @@ char *size_to_human_string(int options, uint64_t bytes)
 		}
 	}
 
+	if (!ul_u64_to_buf(dec, buf, bufsz))
+		return NULL;
+	len = strlen(buf);
+	p = buf + len;
+
 	if (frac) {
 		struct lconv const *l = localeconv();
 		char *dp = l ? l->decimal_point : NULL;
-		int len;
+		size_t dplen;
 
 		if (!dp || !*dp)
 			dp = ".";
+		dplen = strlen(dp);
+		if (len + dplen + 2 >= bufsz)
+			return NULL;
+
+		p = mempcpy(p, dp, dplen);
+		*p++ = digit_pairs[frac * 2];
+		/* remove potential extraneous zero */
+		if (digit_pairs[frac * 2 + 1] != '0')
+			*p++ = digit_pairs[frac * 2 + 1];
+		len = p - buf;
+	}
 
-		len = snprintf(buf, sizeof(buf), "%d%s%02" PRIu64, dec, dp, frac);
-		if (len > 0 && (size_t) len < sizeof(buf)) {
-			/* remove potential extraneous zero */
-			if (buf[len - 1] == '0')
-				buf[len--] = '\0';
-			/* append suffix */
-			xstrncpy(buf+len, suffix, sizeof(buf) - len);
-		} else
-			*buf = '\0';	/* snprintf error */
-	} else
-		snprintf(buf, sizeof(buf), "%d%s", dec, suffix);
+	/* append suffix */
+	if (len + strlen(suffix) >= bufsz)
+		return NULL;
+	strcpy(p, suffix);
+	return buf;
+}
 
+char *size_to_human_string(int options, uint64_t bytes)
+{
+	char buf[UL_HUMAN_BUFSIZ];
+
+	if (!size_to_human_buf(options, bytes, buf, sizeof(buf)))
+		return NULL;
 	return strdup(buf);
 }
 
@@ -541,33 +541,120 @@ static int format_iso_time(const struct tm *tm, uint32_t nsec, int flags, char *
 	return -1;
 }
 
-/* timespec to ISO 8601 */
-int strtimespec_iso(const struct timespec *ts, int flags, char *buf, size_t bufsz)
+static void tmcache_set_day(struct ul_tmcache *tc)
+{
+	struct tm x;
+	time_t end;
+
+	tc->day = tc->sec - (tc->tm.tm_hour * 3600 + tc->tm.tm_min * 60 + tc->tm.tm_sec);
+	tc->wholeday = 0;
+
+	if (tc->gmt) {
+		tc->wholeday = 1;
+		return;
+	}
+#ifdef HAVE_TM_GMTOFF
+	/* the fix-ups are usable only if the UTC offset is the same for the
+	 * whole day (no DST transition) */
+	if (!localtime_r(&tc->day, &x)
+	    || x.tm_gmtoff != tc->tm.tm_gmtoff || x.tm_yday != tc->tm.tm_yday
+	    || x.tm_hour != 0 || x.tm_min != 0 || x.tm_sec != 0)
+		return;
+
+	end = tc->day + 86399;
+	if (!localtime_r(&end, &x)
+	    || x.tm_gmtoff != tc->tm.tm_gmtoff || x.tm_yday != tc->tm.tm_yday
+	    || x.tm_hour != 23 || x.tm_min != 59 || x.tm_sec != 59)
+		return;
+
+	tc->wholeday = 1;
+#else
+	(void) x;
+	(void) end;
+#endif
+}
+
+/*
+ * Converts @t to broken-down local time (or UTC if @gmt is true). The same
+ * second is returned from the cache, and other times of the same day are
+ * calculated from the cached day without localtime_r().
+ *
+ * The cache has to be reset (zeroized) if TZ is changed.
+ */
+struct tm *ul_tmcache_convert(struct ul_tmcache *tc, time_t t, int gmt, struct tm *tm)
 {
-	struct tm tm;
 	struct tm *rc;
 
-	if (flags & ISO_GMTIME)
-		rc = gmtime_r(&ts->tv_sec, &tm);
-	else
-		rc = localtime_r(&ts->tv_sec, &tm);
+	if (!tc)
+		return gmt ? gmtime_r(&t, tm) : localtime_r(&t, tm);
+
+	if (tc->valid && !tc->gmt == !gmt) {
+		if (t == tc->sec) {
+			*tm = tc->tm;
+			return tm;
+		}
+		if (tc->wholeday && t >= tc->day && t - tc->day < 86400) {
+			time_t sec = t - tc->day;
+
+			tc->tm.tm_hour = sec / 3600;
+			tc->tm.tm_min = (sec / 60) % 60;
+			tc->tm.tm_sec = sec % 60;
+			tc->sec = t;
+			*tm = tc->tm;
+			return tm;
+		}
+	}
+
+	rc = gmt ? gmtime_r(&t, &tc->tm) : localtime_r(&t, &tc->tm);
+	if (!rc) {
+		tc->valid = 0;
+		return NULL;
+	}
+
+	tc->sec = t;
+	tc->gmt = gmt ? 1 : 0;
+	tc->valid = 1;
+	tmcache_set_day(tc);
+
+	*tm = tc->tm;
+	return tm;
+}
+
+/* timespec to ISO 8601, @tc is optional */
+int strtimespec_iso_cached(struct ul_tmcache *tc, const struct timespec *ts,
+			   int flags, char *buf, size_t bufsz)
+{
+	struct tm tm;
 
-	if (rc)
+	if (ul_tmcache_convert(tc, ts->tv_sec, flags & ISO_GMTIME, &tm))
 		return format_iso_time(&tm, ts->tv_nsec, flags, buf, bufsz);
 
 	warnx(_("time %"PRId64" is out of range."), (int64_t)(ts->tv_sec));
 	return -1;
 }
 
-/* timeval to ISO 8601 */
-int strtimeval_iso(const struct timeval *tv, int flags, char *buf, size_t bufsz)
+/* timespec to ISO 8601 */
+int strtimespec_iso(const struct timespec *ts, int flags, char *buf, size_t bufsz)
+{
+	return strtimespec_iso_cached(NULL, ts, flags, buf, bufsz);
+}
+
+/* timeval to ISO 8601, @tc is optional */
+int strtimeval_iso_cached(struct ul_tmcache *tc, const struct timeval *tv,
+			  int flags, char *buf, size_t bufsz)
 {
 	struct timespec ts = {
 		.tv_sec = tv->tv_sec,
 		.tv_nsec = tv->tv_usec * NSEC_PER_USEC,
 	};
 
-	return strtimespec_iso(&ts, flags, buf, bufsz);
+	return strtimespec_iso_cached(tc, &ts, flags, buf, bufsz);
+}
+
+/* timeval to ISO 8601 */
+int strtimeval_iso(const struct timeval *tv, int flags, char *buf, size_t bufsz)
+{
+	return strtimeval_iso_cached(NULL, tv, flags, buf, bufsz);
 }
 
 /* struct tm to ISO 8601 */
@@ -576,24 +663,25 @@ int strtm_iso(const struct tm *tm, int flags, char *buf, size_t bufsz)
 	return format_iso_time(tm, 0, flags, buf, bufsz);
 }
 
-/* time_t to ISO 8601 */
-int strtime_iso(const time_t *t, int flags, char *buf, size_t bufsz)
+/* time_t to ISO 8601, @tc is optional */
+int strtime_iso_cached(struct ul_tmcache *tc, const time_t *t,
+		       int flags, char *buf, size_t bufsz)
 {
 	struct tm tm;
-	struct tm *rc;
-
-	if (flags & ISO_GMTIME)
-		rc = gmtime_r(t, &tm);
-	else
-		rc = localtime_r(t, &tm);
 
-	if (rc)
+	if (ul_tmcache_convert(tc, *t, flags & ISO_GMTIME, &tm))
 		return format_iso_time(&tm, 0, flags, buf, bufsz);
 
 	warnx(_("time %"PRId64" is out of range."), (int64_t)*t);
 	return -1;
 }
 
+/* time_t to ISO 8601 */
+int strtime_iso(const time_t *t, int flags, char *buf, size_t bufsz)
+{
+	return strtime_iso_cached(NULL, t, flags, buf, bufsz);
+}
+
 /* relative time functions */
 static inline int time_is_thisyear(struct tm const *const tm,
 				   struct tm const *const tmnow)
@@ -851,6 +939,39 @@ static int run_unittest_format_relative(void)
 	return rc;
 }
 
+/* compare cached and uncached conversions around DST transitions */
+static int run_unittest_tmcache(void)
+{
+	static const char *const zones[] = {
+		"GMT", "CET-1CEST,M3.5.0,M10.5.0/3", "<+0545>-5:45"
+	};
+	int rc = EXIT_SUCCESS;
+
+	for (size_t z = 0; z < ARRAY_SIZE(zones); z++) {
+		struct ul_tmcache tc = { 0 };
+		time_t t;
+
+		setenv("TZ", zones[z], 1);
+		tzset();
+
+		/* 2023-03-24 .. 2023-04-01 by 7 minutes and 13 seconds */
+		for (t = 1679616000; t < 1680307200; t += 433) {
+			char a[ISO_BUFSIZ], b[ISO_BUFSIZ];
+			int gmt = (t / 433) % 5 == 0 ? ISO_GMTIME : 0;
+
+			if (strtime_iso(&t, ISO_TIMESTAMP_T | gmt, a, sizeof(a))
+			    || strtime_iso_cached(&tc, &t, ISO_TIMESTAMP_T | gmt, b, sizeof(b))
+			    || strcmp(a, b) != 0) {
+				fprintf(stderr, "%s: %"PRId64": %s != %s\n",
+					zones[z], (int64_t) t, a, b);
+				rc = EXIT_FAILURE;
+			}
+		}
+	}
+
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct timespec ts = { 0 };
@@ -868,6 +989,8 @@ int main(int argc, char *argv[])
 		return run_unittest_format();
 	else if (strcmp(argv[1], "--unittest-format-relative") == 0)
 		return run_unittest_format_relative();
+	else if (strcmp(argv[1], "--unittest-tmcache") == 0)
+		return run_unittest_tmcache();
 
 	if (strcmp(argv[1], "--timestamp") == 0) {
 		usec_t usec = 0;
@@ -74,6 +74,7 @@ struct blkid_struct_tag
 {
 	struct list_head	bit_tags;	/* All tags for this device */
 	struct list_head	bit_names;	/* All tags with given NAME */
+	struct list_head	bit_hash;	/* Tags with the same NAME=value hash */
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
@@ -99,9 +100,23 @@ struct blkid_chain {
 	int		binary;		/* boolean */
 	int		idx;		/* index of the current prober (or -1) */
 	unsigned long	*fltr;		/* filter or NULL */
+	unsigned long	*nomagic;	/* probers without magic on the device or NULL */
+	struct blkid_prober_stat *stats; /* per-prober stats (+ chain total) or NULL */
 	void		*data;		/* private chain data or NULL */
 };
 
+/*
+ * Probing statistics, see blkid_probe_enable_stats()
+ */
+struct blkid_prober_stat {
+	uint64_t	ncalls;		/* number of prober calls */
+	uint64_t	usec;		/* wall time in microseconds */
+	uint64_t	nreads;		/* number of read() calls */
+	uint64_t	nbytes;		/* bytes read from the device */
+	uint64_t	nhits;		/* requests satisfied by cached buffers */
+	uint64_t	npruned;	/* removed prunable buffers */
+};
+
 /*
  * Chain driver
  */
@@ -187,6 +202,8 @@ struct blkid_bufinfo {
 	uint64_t		off;
 	uint64_t		len;
 	struct list_head	bufs;	/* list of buffers */
+
+	unsigned int		is_mmap : 1;	/* private mapping, otherwise arena */
 };
 
 /*
@@ -201,9 +218,20 @@ struct blkid_hint {
 /*
  * Low-level probing control struct
  */
+/*
+ * Pending (batched) wipe, see blkid_probe_set_wipe_flags()
+ */
+struct blkid_wipe_range {
+	uint64_t	off;		/* offset from the begin of the device */
+	uint64_t	len;
+};
+
 struct blkid_struct_probe
 {
 	int			fd;		/* device file descriptor */
+	const unsigned char	*mem;		/* caller's memory rather than fd */
+	unsigned char		*mem_copy;	/* private copy for hidden ranges */
+	uint64_t		mem_size;	/* size of the memory */
 	uint64_t		off;		/* begin of data on the device */
 	uint64_t		size;		/* end of data on the device */
 	uint64_t		io_size;	/* optimal size of IO */
@@ -221,13 +249,25 @@ struct blkid_struct_probe
 	uint64_t		wipe_size;	/* size of the wiped area */
 	struct blkid_chain	*wipe_chain;	/* superblock, partition, ... */
 
+	int			wipe_flags;	/* BLKID_WIPE_* */
+	struct blkid_wipe_range	*wipe_ranges;	/* batched blkid_do_wipe() requests */
+	size_t			nwipe_ranges;
+
 	struct list_head	buffers;	/* list of buffers */
 	struct list_head	prunable_buffers;	/* list of prunable buffers */
+	struct blkid_arena	*arena;		/* memory for small buffers */
 	struct list_head	hints;
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
 	struct blkid_chain	*cur_chain;		/* current chain */
 
+	struct blkid_prober_stat *stats;	/* total stats or NULL */
+	struct blkid_prober_stat *cur_stat;	/* current prober stats or NULL */
+	uint64_t		stat_start;	/* begin of the current prober (usec) */
+
+	uint64_t		timeout;	/* probing time budget (usec) or 0 */
+	uint64_t		deadline;	/* monotonic end of the budget or 0 */
+
 	struct list_head	values;		/* results */
 
 	struct blkid_struct_probe *parent;	/* for clones */
@@ -241,9 +281,11 @@ struct blkid_struct_probe
 #define BLKID_FL_NOSCAN_DEV	(1 << 4)	/* do not scan this device */
 #define BLKID_FL_MODIF_BUFF	(1 << 5)	/* cached buffers has been modified */
 #define BLKID_FL_OPAL_LOCKED	(1 << 6)	/* OPAL device is locked (I/O errors) */
+#define BLKID_FL_SHARED_BUFF	(1 << 7)	/* buffers from shared cache */
 
 /* private per-probing flags */
 #define BLKID_PROBE_FL_IGNORE_PT (1 << 1)	/* ignore partition table */
+#define BLKID_PROBE_FL_TIMEDOUT	(1 << 2)	/* time budget exhausted */
 
 extern blkid_probe blkid_clone_probe(blkid_probe parent);
 extern blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr);
@@ -266,6 +308,8 @@ struct blkid_config {
 	int nevals;			/* number of elems in eval array */
 	int uevent;			/* SEND_UEVENT=<yes|not> option */
 	char *cachefile;		/* CACHE_FILE=<path> option */
+	int binfmt;			/* CACHE_FORMAT=<text|binary> option */
+	int incremental;		/* VERIFY=<full|incremental> option */
 };
 
 extern struct blkid_config *blkid_read_config(const char *filename)
@@ -301,10 +345,54 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct list_head	*bic_hash;	/* NAME=value hash table or NULL */
+	size_t			bic_nhash;	/* number of hash table buckets */
+	size_t			bic_nhashed;	/* number of tags in hash table */
 };
 
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_BINARY	0x0008	/* Write the cache file in binary format */
+#define BLKID_BIC_FL_INCREMENTAL 0x0010	/* Verify only the cached type */
+
+/*
+ * Binary cache file format (CACHE_FORMAT=binary in blkid.conf). All numbers
+ * are little-endian. The file is:
+ *
+ *	header
+ *	device records [ndevs]
+ *	tag records [ntags], ordered by devices
+ *	string table [strtab_size], NUL-terminated strings
+ *
+ * The names and values are offsets to the string table.
+ */
+#define BLKID_BINCACHE_MAGIC	"BLKIDTAB"
+#define BLKID_BINCACHE_MAGICSZ	(sizeof(BLKID_BINCACHE_MAGIC) - 1)
+#define BLKID_BINCACHE_VERSION	1
+
+struct blkid_bincache_header {
+	char		magic[BLKID_BINCACHE_MAGICSZ];
+	uint32_t	version;
+	uint32_t	ndevs;
+	uint32_t	ntags;
+	uint32_t	strtab_size;
+} __attribute__((packed));
+
+struct blkid_bincache_dev {
+	uint32_t	name;		/* device name */
+	uint32_t	ntags;		/* number of the device tags */
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	reserved;
+} __attribute__((packed));
+
+struct blkid_bincache_tag {
+	uint32_t	name;
+	uint32_t	value;
+} __attribute__((packed));
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -389,6 +477,9 @@ extern char *blkid_get_cache_filename(struct blkid_config *conf)
  * Functions to create and find a specific tag type: tag.c
  */
 extern void blkid_free_tag(blkid_tag tag);
+extern void blkid_free_tag_hash(blkid_cache cache);
+extern blkid_dev blkid__find_dev_with_tag(blkid_cache cache, const char *type,
+				const char *value, int probe);
 extern blkid_tag blkid_find_tag_dev(blkid_dev dev, const char *type)
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
@@ -404,6 +495,12 @@ extern blkid_dev blkid_new_dev(void)
 			__attribute__((warn_unused_result));
 extern void blkid_free_dev(blkid_dev dev);
 
+/* sharedcache.c */
+extern int blkid_probe_load_shared_buffers(blkid_probe pr)
+			__attribute__((nonnull));
+extern int blkid_probe_save_shared_buffers(blkid_probe pr)
+			__attribute__((nonnull));
+
 /* probe.c */
 extern int blkid_probe_is_tiny(blkid_probe pr)
 			__attribute__((nonnull))
@@ -437,6 +534,15 @@ extern int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 			__attribute__((nonnull(1)));
 
 extern void blkid_probe_prune_buffers(blkid_probe pr);
+extern int blkid_probe_import_buffer(blkid_probe pr, uint64_t real_off, uint64_t len,
+				     const unsigned char *data)
+			__attribute__((nonnull));
+extern void blkid_probe_start_stats(blkid_probe pr, struct blkid_chain *chn, size_t idx);
+extern void blkid_probe_end_stats(blkid_probe pr);
+extern void blkid_probe_preread_chain(blkid_probe pr, struct blkid_chain *chn)
+			__attribute__((nonnull));
+extern void blkid_probe_index_chain(blkid_probe pr, struct blkid_chain *chn)
+			__attribute__((nonnull));
 
 /* returns superblock according to 'struct blkid_idmag' */
 extern const unsigned char *blkid_probe_get_sb_buffer(blkid_probe pr, const struct blkid_idmag *mag, size_t size);
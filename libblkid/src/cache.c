@@ -93,6 +93,7 @@ char *blkid_get_cache_filename(struct blkid_config *conf)
 int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 {
 	blkid_cache cache;
+	struct blkid_config *conf;
 
 	if (!ret_cache)
 		return -BLKID_ERR_PARAM;
@@ -104,13 +105,23 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	INIT_LIST_HEAD(&cache->bic_devs);
 	INIT_LIST_HEAD(&cache->bic_tags);
 
+	conf = blkid_read_config(NULL);
+	if (conf && conf->binfmt)
+		cache->bic_flags |= BLKID_BIC_FL_BINARY;
+	if (conf && conf->incremental)
+		cache->bic_flags |= BLKID_BIC_FL_INCREMENTAL;
+
 	if (filename && !*filename)
 		filename = NULL;
 	if (filename)
 		cache->bic_filename = strdup(filename);
+	else if (conf)
+		cache->bic_filename = blkid_get_cache_filename(conf);
 	else
 		cache->bic_filename = blkid_get_cache_filename(NULL);
 
+	blkid_free_config(conf);
+
 	blkid_read_cache(cache);
 	*ret_cache = cache;
 	return 0;
@@ -159,6 +170,7 @@ void blkid_put_cache(blkid_cache cache)
 	}
 
 	blkid_free_probe(cache->probe);
+	blkid_free_tag_hash(cache);
 
 	free(cache->bic_filename);
 	free(cache);
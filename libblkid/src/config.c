@@ -58,6 +58,34 @@ err:
 	return -1;
 }
 
+static int parse_verify(struct blkid_config *conf, const char *s)
+{
+	if (strcmp(s, "full") == 0)
+		conf->incremental = FALSE;
+	else if (strcmp(s, "incremental") == 0)
+		conf->incremental = TRUE;
+	else {
+		DBG(CONFIG, ul_debug(
+			"config file: unknown verify mode '%s'.", s));
+		return -1;
+	}
+	return 0;
+}
+
+static int parse_cache_format(struct blkid_config *conf, const char *s)
+{
+	if (strcmp(s, "text") == 0)
+		conf->binfmt = FALSE;
+	else if (strcmp(s, "binary") == 0)
+		conf->binfmt = TRUE;
+	else {
+		DBG(CONFIG, ul_debug(
+			"config file: unknown cache format '%s'.", s));
+		return -1;
+	}
+	return 0;
+}
+
 #ifndef HAVE_LIBECONF
 static int parse_next(FILE *fd, struct blkid_config *conf)
 {
@@ -104,6 +132,14 @@ static int parse_next(FILE *fd, struct blkid_config *conf)
 			conf->cachefile = strdup(s);
 		else
 			conf->cachefile = NULL;
+	} else if (!strncmp(s, "CACHE_FORMAT=", 13)) {
+		s += 13;
+		if (*s && parse_cache_format(conf, s) == -1)
+			return -1;
+	} else if (!strncmp(s, "VERIFY=", 7)) {
+		s += 7;
+		if (*s && parse_verify(conf, s) == -1)
+			return -1;
 	} else if (!strncmp(s, "EVALUATE=", 9)) {
 		s += 9;
 		if (*s && parse_evaluate(conf, s) == -1)
@@ -210,6 +246,34 @@ struct blkid_config *blkid_read_config(const char *filename)
 	}
 
 	char *line = NULL;
+	if ((error = econf_getStringValue(file, NULL, "CACHE_FORMAT", &line))) {
+		if (error != ECONF_NOKEY) {
+			DBG(CONFIG, ul_debug("couldn't fetch CACHE_FORMAT correctly: %s", econf_errString(error)));
+			goto err;
+		} else {
+			DBG(CONFIG, ul_debug("key CACHE_FORMAT not found, using built-in default "));
+		}
+	} else {
+		if (*line && parse_cache_format(conf, line) == -1)
+			goto err;
+		free(line);
+		line = NULL;
+	}
+
+	if ((error = econf_getStringValue(file, NULL, "VERIFY", &line))) {
+		if (error != ECONF_NOKEY) {
+			DBG(CONFIG, ul_debug("couldn't fetch VERIFY correctly: %s", econf_errString(error)));
+			goto err;
+		} else {
+			DBG(CONFIG, ul_debug("key VERIFY not found, using built-in default "));
+		}
+	} else {
+		if (*line && parse_verify(conf, line) == -1)
+			goto err;
+		free(line);
+		line = NULL;
+	}
+
 	if ((error = econf_getStringValue(file, NULL, "EVALUATE", &line))) {
 		conf->nevals = 0;
 		if (error != ECONF_NOKEY) {
@@ -288,6 +352,8 @@ int main(int argc, char *argv[])
 
 	printf("SEND UEVENT: %s\n", conf->uevent ? "TRUE" : "FALSE");
 	printf("CACHE_FILE:  %s\n", conf->cachefile);
+	printf("CACHE_FORMAT: %s\n", conf->binfmt ? "binary" : "text");
+	printf("VERIFY:      %s\n", conf->incremental ? "incremental" : "full");
 
 	blkid_free_config(conf);
 	return EXIT_SUCCESS;
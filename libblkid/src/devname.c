@@ -403,6 +403,66 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * The devices are probed one by one, but it's possible to ask kernel to read
+ * the begin of the next devices in background, so the I/O for more devices is
+ * in flight at the same time. The device has to be open until it's probed,
+ * otherwise kernel drops the cached data on the last close.
+ */
+#define SYSFS_READAHEAD_DEVS	32		/* max number of devices in flight */
+#define SYSFS_READAHEAD_SIZE	(128 * 1024)	/* bytes from begin of the device */
+
+struct sysfs_probe_item {
+	char	*name;		/* partition or whole-disk name */
+	dev_t	devno;
+	int	fd;		/* readahead file descriptor or -1 */
+	unsigned int drop : 1;	/* remove partitioned whole-disk from cache */
+};
+
+static int add_probe_item(struct sysfs_probe_item **items, size_t *nitems,
+			  const char *name, dev_t devno, int drop)
+{
+	struct sysfs_probe_item *tmp, *it;
+
+	tmp = reallocarray(*items, *nitems + 1, sizeof(struct sysfs_probe_item));
+	if (!tmp)
+		return -ENOMEM;
+	*items = tmp;
+
+	it = &tmp[*nitems];
+	it->name = drop ? NULL : strdup(name);
+	if (!drop && !it->name)
+		return -ENOMEM;
+	it->devno = devno;
+	it->drop = drop ? 1 : 0;
+	it->fd = -1;
+	(*nitems)++;
+	return 0;
+}
+
+static void readahead_probe_item(struct sysfs_probe_item *it)
+{
+	char device[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	if (it->drop)
+		return;
+
+	snprintf(device, sizeof(device), "/dev/%s", it->name);
+	fd = open(device, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode) || st.st_rdev != it->devno) {
+		close(fd);
+		return;
+	}
+
+	DBG(DEVNAME, ul_debug(" readahead %s", device));
+	ignore_result( posix_fadvise(fd, 0, SYSFS_READAHEAD_SIZE, POSIX_FADV_WILLNEED) );
+	it->fd = fd;
+}
+
 /*
  * This function uses /sys to read all block devices in way compatible with
  * /proc/partitions (like the original libblkid implementation)
@@ -412,6 +472,9 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 {
 	DIR *sysfs;
 	struct dirent *dev;
+	struct sysfs_probe_item *items = NULL;
+	size_t i, nitems = 0, ra_next = 0;
+	int rc = 0;
 
 	sysfs = opendir(_PATH_SYS_BLOCK);
 	if (!sysfs)
@@ -420,7 +483,7 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 	DBG(DEVNAME, ul_debug(" probe /sys/block"));
 
 	/* scan /sys/block */
-	while ((dev = xreaddir(sysfs))) {
+	while ((dev = xreaddir(sysfs)) && rc == 0) {
 		DIR *dir = NULL;
 		dev_t devno;
 		size_t nparts = 0;
@@ -483,25 +546,47 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			if (!partno)
 				continue;
 
-			DBG(DEVNAME, ul_debug(" Probe partition dev %s, devno 0x%04X",
-                                   part->d_name, (unsigned int) partno));
 			nparts++;
-			probe_one(cache, part->d_name, partno, 0, only_if_new, 0);
+			rc = add_probe_item(&items, &nitems, part->d_name, partno, 0);
+			if (rc)
+				break;
 		}
 
-		if (!nparts) {
-			/* add non-partitioned whole disk to cache */
-			DBG(DEVNAME, ul_debug(" Probe whole dev %s, devno 0x%04X",
-				   dev->d_name, (unsigned int) devno));
-			probe_one(cache, dev->d_name, devno, 0, only_if_new, 0);
+		/* add non-partitioned whole disk to cache, or
+		 * remove partitioned whole-disk from cache */
+		if (rc == 0)
+			rc = add_probe_item(&items, &nitems, dev->d_name, devno,
+					    nparts ? 1 : 0);
+	next:
+		if (dir)
+			closedir(dir);
+		if (pc)
+			ul_unref_path(pc);
+	}
+
+	closedir(sysfs);
+
+	for (i = 0; rc == 0 && i < nitems; i++) {
+		struct sysfs_probe_item *it = &items[i];
+
+		/* keep the next devices in flight */
+		if (!only_if_new && !only_removable) {
+			for ( ; ra_next < nitems
+				&& ra_next < i + SYSFS_READAHEAD_DEVS; ra_next++)
+				readahead_probe_item(&items[ra_next]);
+		}
+
+		if (!it->drop) {
+			DBG(DEVNAME, ul_debug(" Probe dev %s, devno 0x%04X",
+				it->name, (unsigned int) it->devno));
+			probe_one(cache, it->name, it->devno, 0, only_if_new, 0);
 		} else {
-			/* remove partitioned whole-disk from cache */
 			struct list_head *p, *pnext;
 
 			list_for_each_safe(p, pnext, &cache->bic_devs) {
 				blkid_dev tmp = list_entry(p, struct blkid_struct_dev,
 							bid_devs);
-				if (tmp->bid_devno == devno) {
+				if (tmp->bid_devno == it->devno) {
 					DBG(DEVNAME, ul_debug(" freeing %s", tmp->bid_name));
 					blkid_free_dev(tmp);
 					cache->bic_flags |= BLKID_BIC_FL_CHANGED;
@@ -509,15 +594,20 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 				}
 			}
 		}
-	next:
-		if (dir)
-			closedir(dir);
-		if (pc)
-			ul_unref_path(pc);
+		if (it->fd >= 0) {
+			close(it->fd);
+			it->fd = -1;
+		}
 	}
 
-	closedir(sysfs);
-	return 0;
+	for (i = 0; i < nitems; i++) {
+		if (items[i].fd >= 0)
+			close(items[i].fd);
+		free(items[i].name);
+	}
+	free(items);
+
+	return rc == 0 ? 0 : -BLKID_ERR_MEM;
 }
 
 /*
@@ -31,6 +31,7 @@
 #endif
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "blkidP.h"
 #include "pathnames.h"
@@ -85,22 +86,44 @@ static void add_to_dirlist(const char *dir, const char *subdir,
 }
 
 /*
- * This function frees a directory list
+ * Map of all block device nodes found by one scan of the device directories,
+ * sorted by devno. It's shared by all threads and rebuilt on a miss, the paths
+ * are verified by stat() before use.
  */
-static void free_dirlist(struct dir_list **list)
+struct devno_map_entry {
+	dev_t	devno;
+	size_t	seq;		/* scan order, the first found wins */
+	char	*name;
+};
+
+static struct devno_map_entry *devno_map;
+static size_t devno_map_nents, devno_map_alloc;
+static pthread_mutex_t devno_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void devno_map_add(dev_t devno, const char *dirname, const char *name)
 {
-	struct dir_list *dp, *next;
+	struct devno_map_entry *e;
 
-	for (dp = *list; dp; dp = next) {
-		next = dp->next;
-		free(dp->name);
-		free(dp);
+	if (devno_map_nents == devno_map_alloc) {
+		size_t sz = devno_map_alloc ? devno_map_alloc * 2 : 256;
+
+		e = realloc(devno_map, sz * sizeof(*e));
+		if (!e)
+			return;
+		devno_map = e;
+		devno_map_alloc = sz;
 	}
-	*list = NULL;
+
+	e = &devno_map[devno_map_nents];
+	e->name = blkid_strconcat(dirname, "/", name);
+	if (!e->name)
+		return;
+	e->devno = devno;
+	e->seq = devno_map_nents++;
 }
 
-void blkid__scan_dir(char *dirname, dev_t devno, struct dir_list **list,
-		     char **devname)
+static void scan_dir(const char *dirname, dev_t devno, struct dir_list **list,
+		     char **devname, int map)
 {
 	DIR	*dir;
 	struct dirent *dp;
@@ -123,7 +146,10 @@ void blkid__scan_dir(char *dirname, dev_t devno, struct dir_list **list,
 		if (fstatat(dirfd(dir), dp->d_name, &st, 0))
 			continue;
 
-		if (S_ISBLK(st.st_mode) && st.st_rdev == devno) {
+		if (map && S_ISBLK(st.st_mode))
+			devno_map_add(st.st_rdev, dirname, dp->d_name);
+
+		else if (S_ISBLK(st.st_mode) && st.st_rdev == devno) {
 			*devname = blkid_strconcat(dirname, "/", dp->d_name);
 			DBG(DEVNO, ul_debug("found 0x%llx at %s", (long long)devno,
 				   *devname));
@@ -158,6 +184,12 @@ void blkid__scan_dir(char *dirname, dev_t devno, struct dir_list **list,
 	closedir(dir);
 }
 
+void blkid__scan_dir(char *dirname, dev_t devno, struct dir_list **list,
+		     char **devname)
+{
+	scan_dir(dirname, devno, list, devname, 0);
+}
+
 /* Directories where we will try to search for device numbers */
 static const char *devdirs[] = { "/devices", "/devfs", "/dev", NULL };
 
@@ -169,11 +201,44 @@ static const char *devdirs[] = { "/devices", "/devfs", "/dev", NULL };
 
 
 
-static char *scandev_devno_to_devpath(dev_t devno)
+static int cmp_devno_map_entries(const void *a, const void *b)
+{
+	const struct devno_map_entry *x = a, *y = b;
+
+	if (x->devno != y->devno)
+		return x->devno < y->devno ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int cmp_devno_map_devno(const void *a, const void *b)
+{
+	const struct devno_map_entry *x = a, *y = b;
+
+	return x->devno < y->devno ? -1 : x->devno > y->devno;
+}
+
+static void free_devno_map(void)
+{
+	size_t i;
+
+	for (i = 0; i < devno_map_nents; i++)
+		free(devno_map[i].name);
+	free(devno_map);
+	devno_map = NULL;
+	devno_map_nents = devno_map_alloc = 0;
+}
+
+/*
+ * Scans all the device directories (breadth-first) and keeps the first found
+ * path for each devno.
+ */
+static void build_devno_map(void)
 {
 	struct dir_list *list = NULL, *new_list = NULL;
-	char *devname = NULL;
 	const char **dir;
+	size_t i, n;
+
+	free_devno_map();
 
 	/*
 	 * Add the starting directories to search in reverse order of
@@ -187,26 +252,109 @@ static char *scandev_devno_to_devpath(dev_t devno)
 
 		list = list->next;
 		DBG(DEVNO, ul_debug("directory %s", current->name));
-		blkid__scan_dir(current->name, devno, &new_list, &devname);
+		scan_dir(current->name, 0, &new_list, NULL, 1);
 		free(current->name);
 		free(current);
-		if (devname)
-			break;
-		/*
-		 * If we're done checking at this level, descend to
-		 * the next level of subdirectories. (breadth-first)
-		 */
 		if (list == NULL) {
 			list = new_list;
 			new_list = NULL;
 		}
 	}
-	free_dirlist(&list);
-	free_dirlist(&new_list);
 
+	if (!devno_map_nents)
+		return;
+
+	qsort(devno_map, devno_map_nents, sizeof(*devno_map),
+			cmp_devno_map_entries);
+
+	/* remove duplicate devnos, keep the first found */
+	for (i = 1, n = 1; i < devno_map_nents; i++) {
+		if (devno_map[i].devno == devno_map[n - 1].devno)
+			free(devno_map[i].name);
+		else
+			devno_map[n++] = devno_map[i];
+	}
+	devno_map_nents = n;
+
+	DBG(DEVNO, ul_debug("devno map: %zu devices", n));
+}
+
+static char *devno_map_lookup(dev_t devno)
+{
+	struct devno_map_entry key = { .devno = devno }, *e;
+	struct stat st;
+
+	e = bsearch(&key, devno_map, devno_map_nents, sizeof(*devno_map),
+			cmp_devno_map_devno);
+	if (!e)
+		return NULL;
+	if (stat(e->name, &st) != 0 || !S_ISBLK(st.st_mode) || st.st_rdev != devno)
+		return NULL;	/* removed or replaced */
+	return strdup(e->name);
+}
+
+/*
+ * Returns the first device node with @devno in the device directories. The
+ * directories are scanned only if the devno is not in the map (or the path
+ * is obsolete), the scan refreshes the map for all devices.
+ */
+static char *scandev_devno_to_devpath(dev_t devno)
+{
+	char *devname;
+
+	pthread_mutex_lock(&devno_map_lock);
+
+	devname = devno_map_lookup(devno);
+	if (!devname) {
+		build_devno_map();
+		devname = devno_map_lookup(devno);
+	}
+
+	pthread_mutex_unlock(&devno_map_lock);
+
+	if (devname)
+		DBG(DEVNO, ul_debug("found 0x%llx at %s", (long long)devno,
+				   devname));
 	return devname;
 }
 
+/*
+ * The kernel node name (uevent DEVNAME) may differ from the sysfs name, for
+ * example for devices in /dev subdirectories.
+ */
+static char *uevent_devno_to_devpath(dev_t devno)
+{
+	struct path_cxt *pc = ul_new_sysfs_path(devno, NULL, NULL);
+	char buf[PATH_MAX], *res = NULL;
+	FILE *f;
+
+	if (!pc)
+		return NULL;
+
+	f = ul_path_fopen(pc, "r" UL_CLOEXECSTR, "uevent");
+	while (f && fgets(buf, sizeof(buf), f)) {
+		const char *name = startswith(buf, "DEVNAME=");
+		struct stat st;
+
+		if (!name)
+			continue;
+		rtrim_whitespace((unsigned char *) buf);
+
+		res = blkid_strconcat("/dev/", name, NULL);
+		if (res && (stat(res, &st) != 0 || !S_ISBLK(st.st_mode)
+			    || st.st_rdev != devno)) {
+			free(res);
+			res = NULL;
+		}
+		break;
+	}
+
+	if (f)
+		fclose(f);
+	ul_unref_path(pc);
+	return res;
+}
+
 /**
  * blkid_devno_to_devname:
  * @devno: device number
@@ -225,6 +373,8 @@ char *blkid_devno_to_devname(dev_t devno)
 	path = sysfs_devno_to_devpath(devno, buf, sizeof(buf));
 	if (path)
 		path = strdup(path);
+	if (!path)
+		path = uevent_devno_to_devpath(devno);
 	if (!path)
 		path = scandev_devno_to_devpath(devno);
 
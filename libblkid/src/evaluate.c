@@ -271,6 +271,158 @@ out:
 	return ret;
 }
 
+/**
+ * blkid_evaluate_tags:
+ * @tokens: array of token names (e.g "LABEL" or "UUID") or unparsed tags (e.g. "LABEL=foo")
+ * @values: array of token data (e.g. "foo"), or NULL if all @tokens are unparsed tags
+ * @res: array to return allocated device names (the items are NULL if not evaluated)
+ * @ntags: number of items in the arrays
+ * @cache: pointer to cache (or NULL when you don't want to re-use the cache)
+ *
+ * This function is the same as blkid_evaluate_tag() called for all the tags,
+ * but the "scan" evaluation method verifies the cache for all tags at first
+ * and scans the block devices only once for all tags not found in the cache.
+ *
+ * Returns: number of evaluated tags or negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_evaluate_tags(const char **tokens, const char **values,
+			char **res, size_t ntags, blkid_cache *cache)
+{
+	struct blkid_config *conf = NULL;
+	char **t = NULL, **v = NULL;
+	size_t i, nres = 0;
+	int m, rc = 0;
+
+	if (!tokens || !res)
+		return -EINVAL;
+	if (!ntags)
+		return 0;
+
+	DBG(EVALUATE, ul_debug("evaluating %zu tags", ntags));
+
+	t = calloc(ntags, sizeof(char *));
+	v = calloc(ntags, sizeof(char *));
+	if (!t || !v) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < ntags; i++) {
+		const char *value = values ? values[i] : NULL;
+
+		res[i] = NULL;
+		if (!tokens[i])
+			continue;
+
+		if (!value && !strchr(tokens[i], '=')) {
+			res[i] = strdup(tokens[i]);
+			if (res[i])
+				nres++;
+			continue;
+		}
+		if (!value) {
+			if (blkid_parse_tag_string(tokens[i], &t[i], &v[i]) != 0
+			    || !t[i] || !v[i]) {
+				free(t[i]);
+				free(v[i]);
+				t[i] = v[i] = NULL;
+			}
+		} else {
+			t[i] = strdup(tokens[i]);
+			v[i] = strdup(value);
+			if (!t[i] || !v[i]) {
+				rc = -ENOMEM;
+				goto out;
+			}
+		}
+	}
+
+	conf = blkid_read_config(NULL);
+	if (!conf) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (m = 0; m < conf->nevals && nres < ntags; m++) {
+		blkid_cache c = cache ? *cache : NULL;
+		int step;
+
+		if (conf->eval[m] == BLKID_EVAL_UDEV) {
+			for (i = 0; i < ntags; i++) {
+				if (res[i] || !t[i])
+					continue;
+				res[i] = evaluate_by_udev(t[i], v[i], conf->uevent);
+				if (res[i])
+					nres++;
+			}
+			continue;
+		}
+		if (conf->eval[m] != BLKID_EVAL_SCAN)
+			continue;
+
+		if (!c) {
+			char *cachefile = blkid_get_cache_filename(conf);
+			int xrc = blkid_get_cache(&c, cachefile);
+
+			free(cachefile);
+			if (xrc < 0 || !c)
+				continue;
+		}
+
+		/* 0: cache only, 1: new devices, 2: all devices */
+		for (step = 0; step < 3 && nres < ntags; step++) {
+			if (step == 1 && blkid_probe_all_new(c) < 0)
+				break;
+			if (step == 2) {
+				if (c->bic_flags & BLKID_BIC_FL_PROBED)
+					break;
+				if (blkid_probe_all(c) < 0)
+					break;
+			}
+			for (i = 0; i < ntags; i++) {
+				blkid_dev dev;
+
+				if (res[i] || !t[i])
+					continue;
+
+				DBG(EVALUATE, ul_debug("evaluating by blkid scan %s=%s [step %d]",
+							t[i], v[i], step));
+				dev = blkid__find_dev_with_tag(c, t[i], v[i], 0);
+				if (dev && dev->bid_name) {
+					res[i] = strdup(dev->bid_name);
+					if (res[i])
+						nres++;
+				}
+			}
+		}
+
+		if (cache)
+			*cache = c;
+		else
+			blkid_put_cache(c);
+	}
+
+	DBG(EVALUATE, ul_debug("%zu tags from %zu evaluated", nres, ntags));
+	rc = (int) nres;
+out:
+	blkid_free_config(conf);
+	for (i = 0; t && i < ntags; i++)
+		free(t[i]);
+	for (i = 0; v && i < ntags; i++)
+		free(v[i]);
+	free(t);
+	free(v);
+	if (rc < 0) {
+		for (i = 0; i < ntags; i++) {
+			free(res[i]);
+			res[i] = NULL;
+		}
+	}
+	return rc;
+}
+
 /**
  * blkid_evaluate_spec:
  * @spec: unparsed tag (e.g. "LABEL=foo") or path (e.g. /dev/dm-0)
@@ -310,10 +462,28 @@ int main(int argc, char *argv[])
 	char *res;
 
 	if (argc < 2) {
-		fprintf(stderr, "usage: %s <tag> | <spec>\n", argv[0]);
+		fprintf(stderr, "usage: %s <tag> | <spec> [<tag> ...]\n", argv[0]);
 		return EXIT_FAILURE;
 	}
 
+	if (argc > 2) {
+		size_t i, n = argc - 1;
+		char **ress = calloc(n, sizeof(char *));
+		int rc;
+
+		if (!ress)
+			return EXIT_FAILURE;
+		rc = blkid_evaluate_tags((const char **) argv + 1, NULL, ress, n, &cache);
+		for (i = 0; i < n; i++) {
+			printf("%s: %s\n", argv[i + 1], ress[i] ? ress[i] : "<not found>");
+			free(ress[i]);
+		}
+		free(ress);
+		if (cache)
+			blkid_put_cache(cache);
+		return rc == (int) n ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	res = blkid_evaluate_spec(argv[1], &cache);
 	if (res)
 		printf("%s\n", res);
@@ -311,7 +311,7 @@ static int probe_gpt_pt(blkid_probe pr,
 	blkid_parttable tab = NULL;
 	blkid_partlist ls;
 	uint64_t fu, lu;
-	uint32_t ssf, i;
+	uint32_t ssf, i, nents, nused;
 	efi_guid_t guid;
 	int ret;
 
@@ -367,8 +367,17 @@ static int probe_gpt_pt(blkid_probe pr,
 
 	fu = le64_to_cpu(h->first_usable_lba);
 	lu = le64_to_cpu(h->last_usable_lba);
+	nents = le32_to_cpu(h->num_partition_entries);
 
-	for (i = 0; i < le32_to_cpu(h->num_partition_entries); i++, e++) {
+	/* Allocate all used entries at once, the table may be huge */
+	for (i = 0, nused = 0; i < nents; i++) {
+		if (guidcmp(e[i].partition_type_guid, GPT_UNUSED_ENTRY_GUID))
+			nused++;
+	}
+	if (blkid_partlist_reserve_partitions(ls, (int) nused))
+		goto err;
+
+	for (i = 0; i < nents; i++, e++) {
 
 		blkid_partition par;
 		uint64_t start = le64_to_cpu(e->starting_lba);
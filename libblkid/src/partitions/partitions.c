@@ -428,6 +428,29 @@ blkid_parttable blkid_partlist_new_parttable(blkid_partlist ls,
 	return tab;
 }
 
+/*
+ * Makes sure there is space for @n more partitions in the list. It's
+ * optional; the partition table probers which know the number of entries
+ * in advance (e.g. GPT) use it to avoid repeated reallocations.
+ */
+int blkid_partlist_reserve_partitions(blkid_partlist ls, int n)
+{
+	void *tmp;
+
+	if (n <= 0 || ls->nparts + n <= ls->nparts_max)
+		return 0;
+
+	tmp = reallocarray(ls->parts, ls->nparts + n,
+			   sizeof(struct blkid_struct_partition));
+	if (!tmp)
+		return -ENOMEM;
+	ls->parts = tmp;
+	ls->nparts_max = ls->nparts + n;
+
+	DBG(LOWPROBE, ul_debug("parts: reserved space for %d partitions", n));
+	return 0;
+}
+
 static blkid_partition new_partition(blkid_partlist ls, blkid_parttable tab)
 {
 	blkid_partition par;
@@ -604,6 +627,9 @@ static int partitions_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [PARTS idx=%d]",
 		chn->idx));
 
+	if (chn->idx < 0)
+		blkid_probe_preread_chain(pr, chn);
+
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
@@ -616,7 +642,9 @@ static int partitions_probe(blkid_probe pr, struct blkid_chain *chn)
 			continue;
 
 		/* apply checks from idinfo */
+		blkid_probe_start_stats(pr, chn, i);
 		rc = idinfo_probe(pr, idinfos[i], chn);
+		blkid_probe_end_stats(pr);
 		if (rc < 0)
 			break;
 		if (rc != BLKID_PROBE_OK)
@@ -729,6 +757,24 @@ int blkid_partitions_do_subprobe(blkid_probe pr, blkid_partition parent,
 	return rc;
 }
 
+/*
+ * The shared cache (see sharedcache.c) verifies only the begin of the disk,
+ * the EBR chain and nested tables may be modified by writes to partitions.
+ */
+static int partlist_is_shareable(blkid_partlist ls)
+{
+	int i;
+
+	if (list_empty(&ls->l_tabs) || ls->l_tabs.next != ls->l_tabs.prev)
+		return 0;	/* no or more tables */
+
+	for (i = 0; i < ls->nparts; i++) {
+		if (blkid_partition_is_extended(&ls->parts[i]))
+			return 0;
+	}
+	return 1;
+}
+
 static int blkid_partitions_probe_partition(blkid_probe pr)
 {
 	blkid_probe disk_pr = NULL;
@@ -754,6 +800,9 @@ static int blkid_partitions_probe_partition(blkid_probe pr)
 	if (!ls)
 		goto nothing;
 
+	if (partlist_is_shareable(ls))
+		blkid_probe_save_shared_buffers(disk_pr);
+
 	par = blkid_partlist_devno_to_partition(ls, devno);
 	if (!par)
 		goto nothing;
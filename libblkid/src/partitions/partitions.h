@@ -16,6 +16,8 @@ extern blkid_partition blkid_partlist_add_partition(blkid_partlist ls,
 				blkid_parttable tab,
 				uint64_t start, uint64_t size);
 
+extern int blkid_partlist_reserve_partitions(blkid_partlist ls, int n);
+
 extern int blkid_partlist_set_partno(blkid_partlist ls, int partno);
 extern int blkid_partlist_increment_partno(blkid_partlist ls);
 
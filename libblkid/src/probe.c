@@ -111,6 +111,8 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <time.h>
+#include <pthread.h>
 #ifdef HAVE_OPAL_GET_STATUS
 #include <linux/sed-opal.h>
 #endif
@@ -132,6 +134,11 @@ static const struct blkid_chaindrv *chains_drvs[] = {
 };
 
 static void blkid_probe_reset_values(blkid_probe pr);
+static void reset_arena(blkid_probe pr, int keep);
+static int probe_chain(blkid_probe pr, struct blkid_chain *chn, int safe);
+static void probe_stats_add(blkid_probe pr, uint64_t nreads, uint64_t nbytes,
+			    uint64_t nhits, uint64_t npruned);
+static uint64_t stats_now(void);
 
 /**
  * blkid_new_probe:
@@ -182,6 +189,8 @@ blkid_probe blkid_clone_probe(blkid_probe parent)
 		return NULL;
 
 	pr->fd = parent->fd;
+	pr->mem = parent->mem;
+	pr->mem_size = parent->mem_size;
 	pr->off = parent->off;
 	pr->size = parent->size;
 	pr->io_size = parent->io_size;
@@ -190,6 +199,7 @@ blkid_probe blkid_clone_probe(blkid_probe parent)
 	pr->blkssz = parent->blkssz;
 	pr->flags = parent->flags;
 	pr->zone_size = parent->zone_size;
+	pr->deadline = parent->deadline;
 	pr->parent = parent;
 
 	pr->flags &= ~BLKID_FL_PRIVATE_FD;
@@ -257,14 +267,21 @@ void blkid_free_probe(blkid_probe pr)
 			ch->driver->free_data(pr, ch->data);
 		free(ch->fltr);
 		ch->fltr = NULL;
+		free(ch->nomagic);
+		ch->nomagic = NULL;
+		free(ch->stats);
+		ch->stats = NULL;
 	}
+	free(pr->stats);
 
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
 	blkid_probe_reset_buffers(pr);
+	reset_arena(pr, 0);
 	blkid_probe_reset_values(pr);
 	blkid_probe_reset_hints(pr);
 	blkid_free_probe(pr->disk_probe);
+	free(pr->wipe_ranges);
 
 	DBG(LOWPROBE, ul_debug("free probe"));
 	free(pr);
@@ -388,7 +405,7 @@ void *blkid_probe_get_binary_data(blkid_probe pr, struct blkid_chain *chn)
 	chn->binary = TRUE;
 	blkid_probe_chain_reset_position(chn);
 
-	rc = chn->driver->probe(pr, chn);
+	rc = probe_chain(pr, chn, 0);
 
 	chn->binary = FALSE;
 	blkid_probe_chain_reset_position(chn);
@@ -546,25 +563,126 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
-static void remove_buffer(struct blkid_bufinfo *bf)
+/*
+ * Small buffers are allocated from chunks of memory (arena) owned by the
+ * probe. The arena is deallocated in bulk by blkid_probe_reset_buffers(), so
+ * we do not need mmap() and munmap() for each read. Large buffers have
+ * private anonymous mappings.
+ *
+ * The "buffer" debug mode (LIBBLKID_DEBUG=buffer) disables the arena and all
+ * buffers are mmap()-ed and protected by mprotect(), so the probing functions
+ * crash if they try to modify the buffers.
+ */
+#define BLKID_ARENA_CHUNKSZ	(64 * 1024)
+#define BLKID_ARENA_MAXBUF	(16 * 1024)
+#define BLKID_ARENA_ALIGN	512
+
+struct blkid_arena {
+	struct blkid_arena	*next;
+	size_t			used;
+	unsigned char		*data;	/* BLKID_ARENA_CHUNKSZ bytes */
+};
+
+static unsigned char *arena_alloc(blkid_probe pr, uint64_t len)
+{
+	struct blkid_arena *a = pr->arena;
+	size_t sz = (len + BLKID_ARENA_ALIGN - 1) & ~((size_t) BLKID_ARENA_ALIGN - 1);
+
+	if (!a || a->used + sz > BLKID_ARENA_CHUNKSZ) {
+		a = calloc(1, sizeof(*a));
+		if (!a)
+			return NULL;
+		if (posix_memalign((void **) &a->data, BLKID_ARENA_ALIGN,
+				   BLKID_ARENA_CHUNKSZ) != 0) {
+			free(a);
+			return NULL;
+		}
+		DBG(BUFFER, ul_debug(" new arena chunk"));
+		a->next = pr->arena;
+		pr->arena = a;
+	}
+
+	a->used += sz;
+	return a->data + a->used - sz;
+}
+
+/* reclaim the memory if @bf is the last allocation from the arena */
+static void arena_free(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	struct blkid_arena *a = pr->arena;
+	size_t sz = (bf->len + BLKID_ARENA_ALIGN - 1) & ~((size_t) BLKID_ARENA_ALIGN - 1);
+
+	if (a && a->used >= sz && a->data + a->used - sz == bf->data)
+		a->used -= sz;
+}
+
+/* deallocate arena chunks, the last allocated chunk is kept for reuse if @keep */
+static void reset_arena(blkid_probe pr, int keep)
+{
+	struct blkid_arena *a = pr->arena, *next;
+
+	if (a && keep) {
+		a->used = 0;
+		a = a->next;
+		pr->arena->next = NULL;
+	} else
+		pr->arena = NULL;
+
+	for (; a; a = next) {
+		next = a->next;
+		free(a->data);
+		free(a);
+	}
+}
+
+static void remove_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
 {
 	list_del(&bf->bufs);
 
 	DBG(BUFFER, ul_debug(" remove buffer: [off=%"PRIu64", len=%"PRIu64"]",
 				bf->off, bf->len));
-	munmap(bf->data, bf->len);
+	if (bf->is_mmap)
+		munmap(bf->data, bf->len);
+	else
+		arena_free(pr, bf);
 	free(bf);
 }
 
-static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+/*
+ * Zeroize intersection of the buffer and the area @real_off .. @real_off + @len.
+ */
+static void zeroize_buffer_range(struct blkid_bufinfo *bf,
+				 uint64_t real_off, uint64_t len)
 {
-	ssize_t ret;
-	struct blkid_bufinfo *bf = NULL;
+	uint64_t start = max(bf->off, real_off);
+	uint64_t end = min(bf->off + bf->len, real_off + len);
 
-	if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
-		errno = 0;
-		return NULL;
-	}
+	if (start >= end)
+		return;
+
+	if (bf->is_mmap)
+		mprotect(bf->data, bf->len, PROT_READ | PROT_WRITE);
+	memset(bf->data + (start - bf->off), 0, end - start);
+	if (bf->is_mmap)
+		mprotect(bf->data, bf->len, PROT_READ);
+}
+
+/*
+ * The batched wipes are not on the device yet, but the probing functions have
+ * to see the data as already wiped.
+ */
+static void apply_pending_wipes(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	size_t i;
+
+	for (i = 0; i < pr->nwipe_ranges; i++)
+		zeroize_buffer_range(bf, pr->wipe_ranges[i].off,
+					 pr->wipe_ranges[i].len);
+}
+
+static struct blkid_bufinfo *new_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	struct blkid_bufinfo *bf;
 
 	/* someone trying to overflow some buffers? */
 	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
@@ -572,16 +690,23 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 		return NULL;
 	}
 
-	/* allocate info and space for data by one malloc call */
 	bf = calloc(1, sizeof(struct blkid_bufinfo));
 	if (!bf) {
 		errno = ENOMEM;
 		return NULL;
 	}
 
-	bf->data = mmap(NULL, len, PROT_READ | PROT_WRITE,
-			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (bf->data == MAP_FAILED) {
+	if (len <= BLKID_ARENA_MAXBUF && !(libblkid_debug_mask & BLKID_DEBUG_BUFFER))
+		bf->data = arena_alloc(pr, len);
+	else {
+		bf->data = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (bf->data == MAP_FAILED)
+			bf->data = NULL;
+		else
+			bf->is_mmap = 1;
+	}
+	if (!bf->data) {
 		free(bf);
 		errno = ENOMEM;
 		return NULL;
@@ -591,13 +716,39 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 	bf->off = real_off;
 	INIT_LIST_HEAD(&bf->bufs);
 
+	return bf;
+}
+
+static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	ssize_t ret;
+	struct blkid_bufinfo *bf = NULL;
+
+	if (real_off > (uint64_t) INT64_MAX) {
+		errno = 0;
+		return NULL;
+	}
+
+	if (pr->deadline && stats_now() >= pr->deadline) {
+		DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64" "
+					"time budget exhausted", real_off, len));
+		pr->prob_flags |= BLKID_PROBE_FL_TIMEDOUT;
+		errno = ETIMEDOUT;
+		return NULL;
+	}
+
+	bf = new_buffer(pr, real_off, len);
+	if (!bf)
+		return NULL;
+
 	DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64"",
 	                       real_off, len));
 
-	ret = read(pr->fd, bf->data, len);
+	ret = pread(pr->fd, bf->data, len, (off_t) real_off);
+	probe_stats_add(pr, 1, ret > 0 ? (uint64_t) ret : 0, 0, 0);
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
-		remove_buffer(bf);
+		remove_buffer(pr, bf);
 
 		/* I/O errors on CDROMs are non-fatal to work with hybrid
 		 * audio+data disks */
@@ -621,7 +772,10 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 		return NULL;
 	}
 
-	if (mprotect(bf->data, len, PROT_READ))
+	if (pr->nwipe_ranges)
+		apply_pending_wipes(pr, bf);
+
+	if (bf->is_mmap && mprotect(bf->data, len, PROT_READ))
 		DBG(LOWPROBE, ul_debug("\tmprotect failed: %m"));
 
 	return bf;
@@ -666,21 +820,339 @@ static void mark_prunable_buffers(blkid_probe pr, const struct blkid_bufinfo *bf
 	}
 }
 
+/*
+ * Add already read data (e.g. from shared cache) to the probe buffers.
+ * The @real_off is offset from the begin of the device.
+ */
+int blkid_probe_import_buffer(blkid_probe pr, uint64_t real_off, uint64_t len,
+			      const unsigned char *data)
+{
+	struct blkid_bufinfo *bf;
+
+	if (!len || real_off < pr->off || real_off > (uint64_t) INT64_MAX)
+		return -EINVAL;
+	if (get_cached_buffer(pr, real_off - pr->off, len))
+		return 0;
+
+	bf = new_buffer(pr, real_off, len);
+	if (!bf)
+		return -ENOMEM;
+
+	memcpy(bf->data, data, len);
+	if (pr->nwipe_ranges)
+		apply_pending_wipes(pr, bf);
+	if (bf->is_mmap && mprotect(bf->data, len, PROT_READ))
+		DBG(LOWPROBE, ul_debug("\tmprotect failed: %m"));
+
+	DBG(BUFFER, ul_debug("\timport: off=%"PRIu64" len=%"PRIu64, real_off, len));
+
+	mark_prunable_buffers(pr, bf);
+	list_add_tail(&bf->bufs, &pr->buffers);
+	return 0;
+}
+
 /*
  * Remove buffers that are marked as prunable
  */
 void blkid_probe_prune_buffers(blkid_probe pr)
 {
 	struct list_head *p, *next;
+	uint64_t ct = 0;
 
 	list_for_each_safe(p, next, &pr->prunable_buffers) {
 		struct blkid_bufinfo *x =
 				list_entry(p, struct blkid_bufinfo, bufs);
 
-		remove_buffer(x);
+		remove_buffer(pr, x);
+		ct++;
+	}
+	if (ct)
+		probe_stats_add(pr, 0, 0, 0, ct);
+}
+
+static uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct blkid_prober_stat *chain_total_stats(struct blkid_chain *chn)
+{
+	return chn && chn->stats ? &chn->stats[chn->driver->nidinfos] : NULL;
+}
+
+static void probe_stats_add(blkid_probe pr, uint64_t nreads, uint64_t nbytes,
+			    uint64_t nhits, uint64_t npruned)
+{
+	struct blkid_prober_stat *st[3];
+	size_t i;
+
+	if (!pr->stats)
+		return;
+
+	st[0] = pr->stats;
+	st[1] = chain_total_stats(pr->cur_chain);
+	st[2] = pr->cur_stat;
+
+	for (i = 0; i < ARRAY_SIZE(st); i++) {
+		if (!st[i])
+			continue;
+		st[i]->nreads += nreads;
+		st[i]->nbytes += nbytes;
+		st[i]->nhits += nhits;
+		st[i]->npruned += npruned;
 	}
 }
 
+/*
+ * Account I/O and time to the prober @idx from the chain @chn; the
+ * probing functions call it before the first read for the prober and
+ * blkid_probe_end_stats() when the prober is done.
+ */
+void blkid_probe_start_stats(blkid_probe pr, struct blkid_chain *chn, size_t idx)
+{
+	if (!pr->stats || !chn->stats || idx >= chn->driver->nidinfos)
+		return;
+
+	pr->cur_stat = &chn->stats[idx];
+	pr->cur_stat->ncalls++;
+	pr->stat_start = stats_now();
+}
+
+void blkid_probe_end_stats(blkid_probe pr)
+{
+	if (!pr->cur_stat)
+		return;
+
+	pr->cur_stat->usec += stats_now() - pr->stat_start;
+	pr->cur_stat = NULL;
+}
+
+/*
+ * Call the chain driver probe (or safeprobe) function, update the chain
+ * stats if enabled.
+ */
+static int probe_chain(blkid_probe pr, struct blkid_chain *chn, int safe)
+{
+	struct blkid_prober_stat *st = chain_total_stats(chn);
+	struct blkid_prober_stat *org_stat = pr->cur_stat;
+	uint64_t org_start = pr->stat_start, start = 0;
+	int rc;
+
+	if (st) {
+		start = stats_now();
+		st->ncalls++;
+		pr->cur_stat = NULL;
+	}
+
+	rc = safe ? chn->driver->safeprobe(pr, chn) : chn->driver->probe(pr, chn);
+
+	if (st) {
+		uint64_t usec = stats_now() - start;
+
+		st->usec += usec;
+		if (!org_stat)
+			pr->stats->usec += usec;
+
+		/* restore after nested call (e.g. blkid_probe_get_binary_data()) */
+		pr->cur_stat = org_stat;
+		pr->stat_start = org_start;
+	}
+	return rc;
+}
+
+/**
+ * blkid_probe_enable_stats:
+ * @pr: probe
+ * @enable: TRUE/FALSE
+ *
+ * Enables or disables probing statistics. The statistics contain wall time,
+ * number of read() calls, number of read bytes, number of requests satisfied
+ * by already cached buffers and number of pruned buffers for all the probing
+ * process, for each chain and for each prober.
+ *
+ * The statistics are accumulated over all blkid_do_*probe() calls. The
+ * repeated call with @enable=TRUE resets the statistics.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_enable_stats(blkid_probe pr, int enable)
+{
+	size_t i;
+
+	if (!pr)
+		return -1;
+
+	if (!enable) {
+		for (i = 0; i < BLKID_NCHAINS; i++) {
+			free(pr->chains[i].stats);
+			pr->chains[i].stats = NULL;
+		}
+		free(pr->stats);
+		pr->stats = NULL;
+		pr->cur_stat = NULL;
+		return 0;
+	}
+
+	if (pr->stats) {
+		memset(pr->stats, 0, sizeof(struct blkid_prober_stat));
+		for (i = 0; i < BLKID_NCHAINS; i++) {
+			struct blkid_chain *chn = &pr->chains[i];
+
+			memset(chn->stats, 0, (chn->driver->nidinfos + 1)
+					* sizeof(struct blkid_prober_stat));
+		}
+		pr->cur_stat = NULL;
+		return 0;
+	}
+
+	pr->stats = calloc(1, sizeof(struct blkid_prober_stat));
+	if (!pr->stats)
+		return -1;
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		struct blkid_chain *chn = &pr->chains[i];
+
+		/* the last item is total for the chain */
+		chn->stats = calloc(chn->driver->nidinfos + 1,
+				    sizeof(struct blkid_prober_stat));
+		if (!chn->stats) {
+			blkid_probe_enable_stats(pr, 0);
+			return -1;
+		}
+	}
+
+	DBG(LOWPROBE, ul_debug("stats enabled"));
+	return 0;
+}
+
+/**
+ * blkid_probe_set_timeout:
+ * @pr: probe
+ * @usec: time budget in microseconds or 0 to disable
+ *
+ * Limits the time spent by blkid_do_safeprobe() and blkid_do_fullprobe(),
+ * or by the blkid_do_probe() loop from the first call until the end of the
+ * probing. When the budget is exhausted, libblkid does not read from the
+ * device anymore and the probing functions return BLKID_PROBE_ERROR with
+ * errno set to ETIMEDOUT. The partial results must not be used in this case.
+ *
+ * The budget is checked before each read() call; a single read() which is
+ * already blocked in the kernel is not interrupted. The time limit is not
+ * used for data already cached in memory.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_set_timeout(blkid_probe pr, uint64_t usec)
+{
+	if (!pr)
+		return -1;
+
+	DBG(LOWPROBE, ul_debug("time budget %"PRIu64" usec", usec));
+	pr->timeout = usec;
+	return 0;
+}
+
+/**
+ * blkid_probe_get_stats:
+ * @pr: probe
+ * @idx: index of the entry
+ * @chain: returns chain name or NULL for the total entry
+ * @name: returns prober name or NULL for the chain or total entry
+ * @usec: returns wall time in microseconds (or NULL)
+ * @nreads: returns number of read() calls (or NULL)
+ * @nbytes: returns number of bytes read from the device (or NULL)
+ * @nhits: returns number of requests satisfied by cached buffers (or NULL)
+ * @npruned: returns number of pruned buffers (or NULL)
+ *
+ * Returns probing statistics, see blkid_probe_enable_stats(). The first entry
+ * (@idx=0) is total for the probe, followed by the total for the first chain,
+ * the probers called by the first chain, the total for the next chain and so on.
+ * The probers which have never been called are not returned.
+ *
+ * <informalexample>
+ *  <programlisting>
+ *	size_t i = 0;
+ *	const char *chain, *name;
+ *	uint64_t usec;
+ *
+ *	while (blkid_probe_get_stats(pr, i++, &chain, &name, &usec,
+ *				NULL, NULL, NULL, NULL) == 0)
+ *		printf("%s %s %ju\n", chain ? chain : "total",
+ *				name ? name : "", usec);
+ *  </programlisting>
+ * </informalexample>
+ *
+ * Returns: 0 on success, 1 at the end of the statistics, or negative number
+ *          in case of error (e.g. statistics not enabled).
+ *
+ * Since: 2.41
+ */
+int blkid_probe_get_stats(blkid_probe pr, size_t idx,
+			const char **chain, const char **name,
+			uint64_t *usec, uint64_t *nreads, uint64_t *nbytes,
+			uint64_t *nhits, uint64_t *npruned)
+{
+	const struct blkid_prober_stat *st = NULL;
+	size_t i, n = 0;
+
+	if (!pr || !pr->stats)
+		return -EINVAL;
+
+	if (idx == 0) {
+		st = pr->stats;
+		if (chain)
+			*chain = NULL;
+		if (name)
+			*name = NULL;
+		goto done;
+	}
+
+	for (i = 0; !st && i < BLKID_NCHAINS; i++) {
+		const struct blkid_chain *chn = &pr->chains[i];
+		size_t x;
+
+		if (++n == idx) {
+			st = chain_total_stats((struct blkid_chain *) chn);
+			if (name)
+				*name = NULL;
+		}
+		for (x = 0; !st && x < chn->driver->nidinfos; x++) {
+			if (!chn->stats[x].ncalls)
+				continue;
+			if (++n == idx) {
+				st = &chn->stats[x];
+				if (name)
+					*name = chn->driver->idinfos[x]->name;
+			}
+		}
+		if (st && chain)
+			*chain = chn->driver->name;
+	}
+
+	if (!st)
+		return 1;
+done:
+	if (usec)
+		*usec = st->usec;
+	if (nreads)
+		*nreads = st->nreads;
+	if (nbytes)
+		*nbytes = st->nbytes;
+	if (nhits)
+		*nhits = st->nhits;
+	if (npruned)
+		*npruned = st->npruned;
+	return 0;
+}
+
 /*
  * Zeroize in-memory data in already read buffer. The next blkid_probe_get_buffer()
  * will return modified buffer. This is usable when you want to call the same probing
@@ -699,6 +1171,22 @@ static int hide_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 		return -EINVAL;
 	}
 
+	/* the caller's memory is read-only, use a private copy */
+	if (pr->mem) {
+		if (real_off + len > pr->mem_size)
+			return -EINVAL;
+		if (!pr->mem_copy) {
+			pr->mem_copy = malloc(pr->mem_size);
+			if (!pr->mem_copy)
+				return -ENOMEM;
+			memcpy(pr->mem_copy, pr->mem, pr->mem_size);
+		}
+		DBG(BUFFER, ul_debug("\thiding: off=%"PRIu64" len=%"PRIu64" (memory)",
+					off, len));
+		memset(pr->mem_copy + real_off, 0, len);
+		ct++;
+	}
+
 	list_for_each(p, &pr->buffers) {
 		struct blkid_bufinfo *x =
 			list_entry(p, struct blkid_bufinfo, bufs);
@@ -713,9 +1201,11 @@ static int hide_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 
 			DBG(BUFFER, ul_debug("\thiding: off=%"PRIu64" len=%"PRIu64,
 						off, len));
-			mprotect(x->data, x->len, PROT_READ | PROT_WRITE);
+			if (x->is_mmap)
+				mprotect(x->data, x->len, PROT_READ | PROT_WRITE);
 			memset(data, 0, len);
-			mprotect(x->data, x->len, PROT_READ);
+			if (x->is_mmap)
+				mprotect(x->data, x->len, PROT_READ);
 			ct++;
 		}
 	}
@@ -789,7 +1279,14 @@ const unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64
 
 	/* try buffers we already have in memory or read from device */
 	bf = get_cached_buffer(pr, off, len);
-	if (!bf) {
+	if (bf)
+		probe_stats_add(pr, 0, 0, 1, 0);
+	else if (pr->mem) {
+		/* blkid_probe_set_buffer(), the area is already checked */
+		probe_stats_add(pr, 0, 0, 1, 0);
+		errno = 0;
+		return (pr->mem_copy ? pr->mem_copy : pr->mem) + real_off + bias;
+	} else {
 		bf = read_buffer(pr, real_off, len);
 		if (!bf)
 			return NULL;
@@ -805,6 +1302,190 @@ const unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64
 	return real_off ? bf->data + (real_off - bf->off + bias) : bf->data + bias;
 }
 
+/*
+ * Pre-read planning: collect magic string locations of all enabled probers in
+ * the chain and read the nearby locations by one read() call. The probing
+ * functions will get the data from the already cached buffers.
+ *
+ * The ranges are merged only if the gap between them is small, so we do not
+ * read large unused areas (for example between the begin and end of the
+ * device).
+ */
+#define PREREAD_MAX_GAP		(32 * 1024)
+#define PREREAD_MAX_LEN		(256 * 1024)
+
+struct preread_range {
+	uint64_t	off;
+	uint64_t	end;
+};
+
+static int cmp_preread_ranges(const void *a, const void *b)
+{
+	const struct preread_range *ra = a, *rb = b;
+
+	if (ra->off == rb->off)
+		return ra->end < rb->end ? -1 : ra->end > rb->end;
+	return ra->off < rb->off ? -1 : 1;
+}
+
+void blkid_probe_preread_chain(blkid_probe pr, struct blkid_chain *chn)
+{
+	const struct blkid_chaindrv *drv = chn->driver;
+	struct preread_range *rgs = NULL;
+	size_t i, n = 0, nalloc = 0, nreads = 0;
+
+	if (!drv->idinfos || (pr->flags & BLKID_FL_MODIF_BUFF))
+		return;
+	if (pr->size == 0 || pr->io_size == 0 || pr->mem)
+		return;
+
+	for (i = 0; i < drv->nidinfos; i++) {
+		const struct blkid_idinfo *id = drv->idinfos[i];
+		const struct blkid_idmag *mag;
+
+		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
+			continue;
+		if (id->minsz && (unsigned) id->minsz > pr->size)
+			continue;
+
+		for (mag = &id->magics[0]; mag->magic; mag++) {
+			uint64_t off;
+
+			/* the location depends on runtime information */
+			if (mag->hoff || mag->is_zoned)
+				continue;
+
+			if (mag->kboff >= 0)
+				off = ((uint64_t) mag->kboff << 10) + mag->sboff;
+			else {
+				uint64_t neg = (uint64_t) -mag->kboff << 10;
+
+				if (neg > pr->size)
+					continue;
+				off = pr->size - neg + mag->sboff;
+			}
+			if (off + mag->len > pr->size)
+				continue;
+
+			if (n == nalloc) {
+				struct preread_range *tmp;
+
+				nalloc += 64;
+				tmp = reallocarray(rgs, nalloc, sizeof(*rgs));
+				if (!tmp)
+					goto done;
+				rgs = tmp;
+			}
+			rgs[n].off = off - (off % pr->io_size);
+			rgs[n].end = off + mag->len;
+			n++;
+		}
+	}
+
+	if (!n)
+		goto done;
+
+	qsort(rgs, n, sizeof(*rgs), cmp_preread_ranges);
+
+	for (i = 0; i < n; ) {
+		uint64_t off = rgs[i].off, end = rgs[i].end;
+
+		for (i++; i < n; i++) {
+			if (rgs[i].off > end + PREREAD_MAX_GAP)
+				break;
+			if (max(end, rgs[i].end) - off > PREREAD_MAX_LEN)
+				break;
+			end = max(end, rgs[i].end);
+		}
+
+		if (get_cached_buffer(pr, off, end - off))
+			continue;
+
+		DBG(BUFFER, ul_debug("	pre-read: off=%"PRIu64" len=%"PRIu64,
+					off, end - off));
+		/* errors are not fatal here, the probing functions will
+		 * try to read the data again */
+		if (!blkid_probe_get_buffer(pr, off, end - off))
+			DBG(BUFFER, ul_debug("\t  pre-read failed (ignore)"));
+		nreads++;
+	}
+
+	DBG(LOWPROBE, ul_debug("%s: pre-read %zu locations by %zu read() calls",
+				drv->name, n, nreads));
+done:
+	free(rgs);
+	errno = 0;
+}
+
+/*
+ * Magic strings index: check magic strings of all enabled probers (usually
+ * already in the pre-read buffers) and mark probers where no magic string
+ * matches. The chain probing loop skips the marked probers.
+ *
+ * The probers without magic strings, or with magic strings where location
+ * depends on runtime information (hints, zones), are never marked.
+ */
+void blkid_probe_index_chain(blkid_probe pr, struct blkid_chain *chn)
+{
+	const struct blkid_chaindrv *drv = chn->driver;
+	size_t i, nhits = 0, nmiss = 0;
+
+	if (!drv->idinfos)
+		return;
+	if (!chn->nomagic) {
+		chn->nomagic = calloc(1, blkid_bmp_nbytes(drv->nidinfos));
+		if (!chn->nomagic)
+			return;
+	} else
+		memset(chn->nomagic, 0, blkid_bmp_nbytes(drv->nidinfos));
+
+	if (pr->size == 0 || pr->io_size == 0)
+		return;
+
+	for (i = 0; i < drv->nidinfos; i++) {
+		const struct blkid_idinfo *id = drv->idinfos[i];
+		const struct blkid_idmag *mag;
+		int miss = 1;
+
+		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
+			continue;
+		if (!id->magics[0].magic)
+			continue;
+
+		for (mag = &id->magics[0]; mag->magic; mag++) {
+			const unsigned char *buf;
+			uint64_t off;
+
+			if (mag->hoff || mag->is_zoned)
+				break;
+			if (mag->kboff < 0 && ((uint64_t) -mag->kboff << 10) > pr->size)
+				continue;
+
+			off = blkid_probe_get_idmag_off(pr, mag) + mag->sboff;
+			buf = blkid_probe_get_buffer(pr, off, mag->len);
+			if (!buf && errno)
+				break;		/* let the prober report the error */
+			if (buf && !memcmp(mag->magic, buf, mag->len))
+				break;
+		}
+		if (mag->magic)
+			miss = 0;
+
+		if (miss) {
+			blkid_bmp_set_item(chn->nomagic, i);
+			nmiss++;
+		} else
+			nhits++;
+
+		DBG(LOWPROBE, ul_debug("[%zu] %s: magic index %s", i, id->name,
+					miss ? "miss" : "hit"));
+	}
+
+	DBG(LOWPROBE, ul_debug("%s: magic index: %zu hits, %zu misses",
+				drv->name, nhits, nmiss));
+	errno = 0;
+}
+
 /**
  * blkid_probe_reset_buffers:
  * @pr: prober
@@ -824,10 +1505,15 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 
 	pr->flags &= ~BLKID_FL_MODIF_BUFF;
 
+	free(pr->mem_copy);
+	pr->mem_copy = NULL;
+
 	blkid_probe_prune_buffers(pr);
 
-	if (list_empty(&pr->buffers))
+	if (list_empty(&pr->buffers)) {
+		reset_arena(pr, 1);
 		return 0;
+	}
 
 	DBG(BUFFER, ul_debug("Resetting probing buffers"));
 
@@ -837,8 +1523,9 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 		ct++;
 		len += bf->len;
 
-		remove_buffer(bf);
+		remove_buffer(pr, bf);
 	}
+	reset_arena(pr, 1);
 
 	DBG(LOWPROBE, ul_debug(" buffers summary: %"PRIu64" bytes by %"PRIu64" read() calls",
 			len, ct));
@@ -1026,6 +1713,8 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	pr->flags &= ~BLKID_FL_CDROM_DEV;
 	pr->prob_flags = 0;
 	pr->fd = fd;
+	pr->mem = NULL;
+	pr->mem_size = 0;
 	pr->off = (uint64_t) off;
 	pr->size = 0;
 	pr->io_size = DEFAULT_SECTOR_SIZE;
@@ -1038,6 +1727,10 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	pr->wipe_chain = NULL;
 	pr->zone_size = 0;
 
+	free(pr->wipe_ranges);
+	pr->wipe_ranges = NULL;
+	pr->nwipe_ranges = 0;
+
 	if (fd < 0)
 		return 1;
 
@@ -1210,6 +1903,48 @@ err:
 
 }
 
+/**
+ * blkid_probe_set_buffer:
+ * @pr: probe
+ * @data: image data
+ * @size: size of @data in bytes
+ *
+ * Assigns memory with an image (for example the first megabytes of a disk
+ * image downloaded from network) to the probe. The data are used as a regular
+ * file, blkid_probe_get_buffer() returns pointers to @data without copying,
+ * and the probing does not call any read() or ioctl().
+ *
+ * The memory is owned by the caller and it has to be available (and
+ * unmodified) until the probe is freed or another device or buffer is
+ * assigned. Libblkid never writes to @data; blkid_probe_hide_range() copies
+ * the data to a private buffer, and blkid_do_wipe() is not supported.
+ *
+ * The probing functions cannot see anything after @size bytes, so the
+ * filesystems and partition tables with metadata at the end of the device
+ * are not detected if @data is only a part of the image.
+ *
+ * Returns: 0 on success, or -EINVAL.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_set_buffer(blkid_probe pr, const void *data, uint64_t size)
+{
+	if (!data || !size || size > (uint64_t) INT64_MAX)
+		return -EINVAL;
+
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	pr->mem = data;
+	pr->mem_size = pr->size = size;
+	pr->mode = S_IFREG;
+
+	if (pr->size <= 1440 * 1024)
+		pr->flags |= BLKID_FL_TINY_DEV;
+
+	DBG(LOWPROBE, ul_debug("ready for low-probing from memory, size=%"PRIu64, size));
+	return 0;
+}
+
 int blkid_probe_get_dimension(blkid_probe pr, uint64_t *off, uint64_t *size)
 {
 	*off = pr->off;
@@ -1329,14 +2064,30 @@ static inline void blkid_probe_start(blkid_probe pr)
 	DBG(LOWPROBE, ul_debug("start probe"));
 	pr->cur_chain = NULL;
 	pr->prob_flags = 0;
+	pr->deadline = pr->timeout ? stats_now() + pr->timeout : 0;
 	blkid_probe_set_wiper(pr, 0, 0);
 }
 
+/*
+ * The results are incomplete when the time budget has been exhausted, see
+ * blkid_probe_set_timeout(). Sets errno for the caller.
+ */
+static int probe_timedout(blkid_probe pr)
+{
+	if (!(pr->prob_flags & BLKID_PROBE_FL_TIMEDOUT))
+		return 0;
+
+	DBG(LOWPROBE, ul_debug("probing timed out"));
+	errno = ETIMEDOUT;
+	return 1;
+}
+
 static inline void blkid_probe_end(blkid_probe pr)
 {
 	DBG(LOWPROBE, ul_debug("end probe"));
 	pr->cur_chain = NULL;
 	pr->prob_flags = 0;
+	pr->deadline = 0;
 	blkid_probe_set_wiper(pr, 0, 0);
 }
 
@@ -1408,8 +2159,10 @@ int blkid_do_probe(blkid_probe pr)
 			if (idx < BLKID_NCHAINS)
 				chn = pr->cur_chain = &pr->chains[idx];
 			else {
+				rc = probe_timedout(pr) ?
+					BLKID_PROBE_ERROR : BLKID_PROBE_NONE;
 				blkid_probe_end(pr);
-				return BLKID_PROBE_NONE;	/* all chains already probed */
+				return rc;		/* all chains already probed */
 			}
 		}
 
@@ -1424,11 +2177,11 @@ int blkid_do_probe(blkid_probe pr)
 			continue;
 
 		/* rc: -1 = error, 0 = success, 1 = no result */
-		rc = chn->driver->probe(pr, chn);
+		rc = probe_chain(pr, chn, 0);
 
 	} while (rc == BLKID_PROBE_NONE);
 
-	if (rc < 0)
+	if (rc < 0 || probe_timedout(pr))
 	       return BLKID_PROBE_ERROR;
 
 	return rc;
@@ -1467,6 +2220,228 @@ static inline int is_conventional(blkid_probe pr __attribute__((__unused__)),
 }
 #endif
 
+/*
+ * Don't use ioctls for small areas, it's usually slower than write().
+ */
+#define BLKID_WIPE_IOCTL_MINSZ	(64 * 1024)
+
+static int add_pending_wipe(blkid_probe pr, uint64_t off, uint64_t len)
+{
+	struct blkid_wipe_range *r;
+	struct list_head *p;
+
+	r = reallocarray(pr->wipe_ranges, pr->nwipe_ranges + 1,
+			 sizeof(struct blkid_wipe_range));
+	if (!r)
+		return -ENOMEM;
+
+	pr->wipe_ranges = r;
+	r = &pr->wipe_ranges[pr->nwipe_ranges++];
+	r->off = off;
+	r->len = len;
+
+	DBG(LOWPROBE, ul_debug("do_wipe: postpone [offset=0x%"PRIx64", len=%"PRIu64"]",
+				off, len));
+
+	/* the same area may be already read to more buffers */
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *x = list_entry(p, struct blkid_bufinfo, bufs);
+		zeroize_buffer_range(x, off, len);
+	}
+	list_for_each(p, &pr->prunable_buffers) {
+		struct blkid_bufinfo *x = list_entry(p, struct blkid_bufinfo, bufs);
+		zeroize_buffer_range(x, off, len);
+	}
+
+	/* don't reset the buffers in blkid_probe_step_back() */
+	pr->flags |= BLKID_FL_MODIF_BUFF;
+	return 0;
+}
+
+static int cmp_wipe_ranges(const void *a, const void *b)
+{
+	const struct blkid_wipe_range *ra = a, *rb = b;
+
+	if (ra->off == rb->off)
+		return 0;
+	return ra->off < rb->off ? -1 : 1;
+}
+
+static int write_zeros(int fd, uint64_t off, uint64_t len)
+{
+	char buf[BUFSIZ];
+
+	if (lseek(fd, off, SEEK_SET) == (off_t) -1)
+		return -1;
+
+	memset(buf, 0, sizeof(buf));
+	while (len) {
+		size_t sz = min(len, (uint64_t) sizeof(buf));
+
+		if (write_all(fd, buf, sz))
+			return -1;
+		len -= sz;
+	}
+	return 0;
+}
+
+/*
+ * Use BLKDISCARD (only if it returns zeros) or BLKZEROOUT for large areas.
+ * Returns 0 on success, 1 if the caller has to write zeros.
+ */
+static int wipe_range_ioctl(blkid_probe pr, int fd, uint64_t off, uint64_t len)
+{
+	uint64_t range[2] = { off, len };
+	unsigned int ssz = blkid_probe_get_sectorsize(pr);
+
+	if (!(pr->wipe_flags & (BLKID_WIPE_DISCARD | BLKID_WIPE_ZEROOUT))
+	    || !S_ISBLK(pr->mode)
+	    || len < BLKID_WIPE_IOCTL_MINSZ
+	    || off % ssz || len % ssz)
+		return 1;
+
+	if (pr->wipe_flags & BLKID_WIPE_DISCARD) {
+		unsigned int zeroes = 0;
+
+		if (ioctl(fd, BLKDISCARDZEROES, &zeroes) == 0 && zeroes
+		    && ioctl(fd, BLKDISCARD, &range) == 0) {
+			DBG(LOWPROBE, ul_debug("do_wipe: discarded"));
+			return 0;
+		}
+	}
+	if ((pr->wipe_flags & BLKID_WIPE_ZEROOUT)
+	    && ioctl(fd, BLKZEROOUT, &range) == 0) {
+		DBG(LOWPROBE, ul_debug("do_wipe: zeroed out"));
+		return 0;
+	}
+
+	DBG(LOWPROBE, ul_debug("do_wipe: ioctl failed, fallback to write()"));
+	return 1;
+}
+
+static int wipe_range(blkid_probe pr, int fd, uint64_t off, uint64_t len,
+		      uint64_t *last_zone)
+{
+	int rc = is_conventional(pr, off);
+
+	if (rc < 0)
+		return -1;
+
+	DBG(LOWPROBE, ul_debug("do_wipe: [offset=0x%"PRIx64" (%"PRIu64"), len=%"PRIu64"]",
+				off, off, len));
+	if (rc == 0) {
+#ifdef HAVE_LINUX_BLKZONED_H
+		uint64_t zone_mask = ~(pr->zone_size - 1);
+		struct blk_zone_range range = {
+			.sector = (off & zone_mask) >> 9,
+			.nr_sectors = pr->zone_size >> 9,
+		};
+
+		/* more signatures in the same zone */
+		if (*last_zone == range.sector + 1)
+			return 0;
+		if (ioctl(fd, BLKRESETZONE, &range) < 0)
+			return -1;
+		*last_zone = range.sector + 1;
+		return 0;
+#else
+		/* Should not reach here */
+		assert(0);
+#endif
+	}
+
+	if (wipe_range_ioctl(pr, fd, off, len) == 0)
+		return 0;
+
+	return write_zeros(fd, off, len);
+}
+
+/**
+ * blkid_probe_set_wipe_flags:
+ * @pr: prober
+ * @flags: BLKID_WIPE_* flags
+ *
+ * Sets how blkid_do_wipe() modifies the device. The default is to write
+ * zeros to the device immediately.
+ *
+ * BLKID_WIPE_BATCH postpones all writes to blkid_probe_flush_wipes(), so the
+ * device is probed only once (the wiped areas are zeroized in memory) and
+ * all the writes are sorted and merged. BLKID_WIPE_ZEROOUT and
+ * BLKID_WIPE_DISCARD allow to use BLKZEROOUT and BLKDISCARD ioctls for large
+ * areas of the block devices; the discard is used only if the device returns
+ * zeros for discarded blocks. The library falls back to write() if the ioctls
+ * are unsupported.
+ *
+ * Since: 2.41
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int blkid_probe_set_wipe_flags(blkid_probe pr, int flags)
+{
+	pr->wipe_flags = flags;
+	return 0;
+}
+
+/**
+ * blkid_probe_flush_wipes:
+ * @pr: prober
+ *
+ * Writes all areas postponed by blkid_do_wipe() in BLKID_WIPE_BATCH mode to
+ * the device and calls fsync(). The overlapping and adjacent areas are merged
+ * and written in order of the offsets. The pending areas are forgotten also
+ * on error and all in-memory cached data from the device are reset.
+ *
+ * Since: 2.41
+ *
+ * Returns: 0 on success, and -1 in case of error.
+ */
+int blkid_probe_flush_wipes(blkid_probe pr)
+{
+	uint64_t last_zone = 0;
+	size_t i, n = 0;
+	int fd, rc = 0;
+
+	if (!pr->nwipe_ranges)
+		return 0;
+
+	fd = blkid_probe_get_fd(pr);
+	if (fd < 0) {
+		rc = -1;
+		goto done;
+	}
+
+	qsort(pr->wipe_ranges, pr->nwipe_ranges,
+	      sizeof(struct blkid_wipe_range), cmp_wipe_ranges);
+
+	for (i = 0; i < pr->nwipe_ranges; i++) {
+		struct blkid_wipe_range *r = &pr->wipe_ranges[i];
+		struct blkid_wipe_range *last = n ? &pr->wipe_ranges[n - 1] : NULL;
+
+		if (last && r->off <= last->off + last->len)
+			last->len = max(last->off + last->len,
+					r->off + r->len) - last->off;
+		else
+			pr->wipe_ranges[n++] = *r;
+	}
+
+	DBG(LOWPROBE, ul_debug("do_wipe: flushing %zu areas (%zu requested)",
+				n, pr->nwipe_ranges));
+
+	for (i = 0; rc == 0 && i < n; i++)
+		rc = wipe_range(pr, fd, pr->wipe_ranges[i].off,
+				pr->wipe_ranges[i].len, &last_zone);
+
+	if (rc == 0 && fsync(fd) != 0)
+		rc = -1;
+done:
+	free(pr->wipe_ranges);
+	pr->wipe_ranges = NULL;
+	pr->nwipe_ranges = 0;
+
+	blkid_probe_reset_buffers(pr);
+	return rc;
+}
+
 /**
  * blkid_do_wipe:
  * @pr: prober
@@ -1501,6 +2476,10 @@ static inline int is_conventional(blkid_probe pr __attribute__((__unused__)),
  *
  * See also blkid_wipe_all() which works the same as the example above.
  *
+ * If BLKID_WIPE_BATCH is enabled by blkid_probe_set_wipe_flags(), then the
+ * device is not modified by this function, the area is only zeroized in
+ * memory and the real write is postponed to blkid_probe_flush_wipes().
+ *
  * Returns: 0 on success, and -1 in case of error.
  */
 int blkid_do_wipe(blkid_probe pr, int dryrun)
@@ -1557,6 +2536,13 @@ int blkid_do_wipe(blkid_probe pr, int dryrun)
 	    "do_wipe [offset=0x%"PRIx64" (%"PRIu64"), len=%zu, chain=%s, idx=%d, dryrun=%s]\n",
 	    offset, offset, len, chn->driver->name, chn->idx, dryrun ? "yes" : "not"));
 
+	if (!dryrun && len && (pr->wipe_flags & BLKID_WIPE_BATCH)) {
+		/* write it later by blkid_probe_flush_wipes() */
+		if (add_pending_wipe(pr, offset, len))
+			return BLKID_PROBE_ERROR;
+		return blkid_probe_step_back(pr);
+	}
+
 	if (lseek(fd, offset, SEEK_SET) == (off_t) -1)
 		return BLKID_PROBE_ERROR;
 
@@ -1609,6 +2595,9 @@ int blkid_do_wipe(blkid_probe pr, int dryrun)
  * The @pr has to be open in O_RDWR mode. All other necessary configurations
  * will be enabled automatically.
  *
+ * The device is probed in BLKID_WIPE_BATCH mode, it means all signatures are
+ * detected first and then written by one blkid_probe_flush_wipes() call.
+ *
  *  <example>
  *  <title>wipe all filesystems or raids from the device</title>
  *   <programlisting>
@@ -1623,6 +2612,8 @@ int blkid_do_wipe(blkid_probe pr, int dryrun)
  */
 int blkid_wipe_all(blkid_probe pr)
 {
+	int flags;
+
 	DBG(LOWPROBE, ul_debug("wiping all signatures"));
 
 	blkid_probe_enable_superblocks(pr, 1);
@@ -1633,11 +2624,19 @@ int blkid_wipe_all(blkid_probe pr)
 	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC |
 			BLKID_PARTS_FORCE_GPT);
 
+	flags = pr->wipe_flags;
+	blkid_probe_set_wipe_flags(pr, flags | BLKID_WIPE_BATCH);
+
 	while (blkid_do_probe(pr) == 0) {
 		DBG(LOWPROBE, ul_debug("wiping one signature"));
 		blkid_do_wipe(pr, 0);
 	}
 
+	/* errors are ignored like for the blkid_do_wipe() calls above */
+	if (blkid_probe_flush_wipes(pr) != 0)
+		DBG(LOWPROBE, ul_debug("wiping failed"));
+	blkid_probe_set_wipe_flags(pr, flags);
+
 	return BLKID_PROBE_OK;
 }
 
@@ -1730,6 +2729,99 @@ int blkid_probe_step_back(blkid_probe pr)
 	return 0;
 }
 
+/*
+ * Topology in a separate thread, see BLKID_TOPOLOGY_PARALLEL. The thread
+ * uses a private clone of the probe (with its own list of values). The
+ * topology chain does not read from the device, so the clone never touches
+ * parent's buffers.
+ */
+struct topology_job {
+	blkid_probe	tp;
+	pthread_t	thread;
+	int		rc;
+};
+
+static void *topology_worker(void *data)
+{
+	struct topology_job *job = (struct topology_job *) data;
+
+	job->rc = blkid_do_fullprobe(job->tp);
+	return NULL;
+}
+
+static int start_topology_job(blkid_probe pr, struct topology_job *job)
+{
+	struct blkid_chain *chn = &pr->chains[BLKID_CHAIN_TOPLGY];
+	blkid_probe tp;
+	int rc;
+
+	if (!chn->enabled || !(chn->flags & BLKID_TOPOLOGY_PARALLEL) || pr->parent)
+		return 1;
+
+	tp = blkid_clone_probe(pr);
+	if (!tp)
+		return -ENOMEM;
+
+	tp->mode = pr->mode;
+
+	blkid_probe_enable_superblocks(tp, FALSE);
+	blkid_probe_enable_partitions(tp, FALSE);
+	blkid_probe_enable_topology(tp, TRUE);
+
+	job->tp = tp;
+	rc = pthread_create(&job->thread, NULL, topology_worker, job);
+	if (rc != 0) {
+		DBG(LOWPROBE, ul_debug("failed to create topology thread"));
+		blkid_free_probe(tp);
+		job->tp = NULL;
+		return -rc;
+	}
+
+	DBG(LOWPROBE, ul_debug("topology thread started"));
+	return 0;
+}
+
+/*
+ * Wait for the thread and move its values to @pr. The @rc and @count are
+ * updated the same way as when the chain is probed by blkid_do_*probe().
+ */
+static void finish_topology_job(blkid_probe pr, struct topology_job *job,
+				int *rc, int *count)
+{
+	struct blkid_chain *chn = &pr->chains[BLKID_CHAIN_TOPLGY];
+	struct list_head *p, *next, *where = &pr->values;
+
+	pthread_join(job->thread, NULL);
+
+	DBG(LOWPROBE, ul_debug("topology thread finished [rc=%d]", job->rc));
+
+	if (*rc >= 0 && job->rc < 0)
+		*rc = job->rc;
+
+	else if (*rc >= 0 && job->rc == BLKID_PROBE_OK) {
+		/* keep the usual order of the values (by chains) */
+		list_for_each(p, &pr->values) {
+			struct blkid_prval *v = list_entry(p, struct blkid_prval, prvals);
+
+			if (v->chain && v->chain->driver->id > BLKID_CHAIN_TOPLGY) {
+				where = p;
+				break;
+			}
+		}
+		list_for_each_safe(p, next, &job->tp->values) {
+			struct blkid_prval *v = list_entry(p, struct blkid_prval, prvals);
+
+			list_del(&v->prvals);
+			v->chain = chn;
+			list_add_tail(&v->prvals, where);
+		}
+		(*count)++;
+	}
+
+	blkid_free_probe(job->tp);
+	job->tp = NULL;
+}
+
 /**
  * blkid_do_safeprobe:
  * @pr: prober
@@ -1745,11 +2837,15 @@ int blkid_probe_step_back(blkid_probe pr)
  * checks for collision between partition table and RAID signature -- it's
  * recommended to enable partitions chain together with superblocks chain.
  *
+ * The topology chain is gathered in a separate thread if enabled by
+ * BLKID_TOPOLOGY_PARALLEL flag, see blkid_probe_set_topology_flags().
+ *
  * Returns: 0 on success, 1 if nothing is detected, -2 if ambivalent result is
  * detected and -1 on case of error.
  */
 int blkid_do_safeprobe(blkid_probe pr)
 {
+	struct topology_job job = { .tp = NULL };
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1757,9 +2853,14 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 	blkid_probe_start(pr);
 
+	start_topology_job(pr, &job);
+
 	for (i = 0; i < BLKID_NCHAINS; i++) {
 		struct blkid_chain *chn;
 
+		if (i == BLKID_CHAIN_TOPLGY && job.tp)
+			continue;	/* see topology_worker() */
+
 		chn = pr->cur_chain = &pr->chains[i];
 		chn->binary = FALSE;		/* for sure... */
 
@@ -1772,7 +2873,7 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 		blkid_probe_chain_reset_position(chn);
 
-		rc = chn->driver->safeprobe(pr, chn);
+		rc = probe_chain(pr, chn, 1);
 
 		blkid_probe_chain_reset_position(chn);
 
@@ -1784,6 +2885,12 @@ int blkid_do_safeprobe(blkid_probe pr)
 	}
 
 done:
+	if (job.tp)
+		finish_topology_job(pr, &job, &rc, &count);
+
+	if (probe_timedout(pr))
+		rc = -ETIMEDOUT;
+
 	blkid_probe_end(pr);
 	if (rc < 0)
 		return BLKID_PROBE_ERROR;
@@ -1801,10 +2908,14 @@ done:
  *
  * This is string-based NAME=value interface only.
  *
+ * The topology chain is gathered in a separate thread if enabled by
+ * BLKID_TOPOLOGY_PARALLEL flag, see blkid_probe_set_topology_flags().
+ *
  * Returns: 0 on success, 1 if nothing is detected or -1 on case of error.
  */
 int blkid_do_fullprobe(blkid_probe pr)
 {
+	struct topology_job job = { .tp = NULL };
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1812,9 +2923,14 @@ int blkid_do_fullprobe(blkid_probe pr)
 
 	blkid_probe_start(pr);
 
+	start_topology_job(pr, &job);
+
 	for (i = 0; i < BLKID_NCHAINS; i++) {
 		struct blkid_chain *chn;
 
+		if (i == BLKID_CHAIN_TOPLGY && job.tp)
+			continue;	/* see topology_worker() */
+
 		chn = pr->cur_chain = &pr->chains[i];
 		chn->binary = FALSE;		/* for sure... */
 
@@ -1827,7 +2943,7 @@ int blkid_do_fullprobe(blkid_probe pr)
 
 		blkid_probe_chain_reset_position(chn);
 
-		rc = chn->driver->probe(pr, chn);
+		rc = probe_chain(pr, chn, 0);
 
 		blkid_probe_chain_reset_position(chn);
 
@@ -1839,6 +2955,12 @@ int blkid_do_fullprobe(blkid_probe pr)
 	}
 
 done:
+	if (job.tp)
+		finish_topology_job(pr, &job, &rc, &count);
+
+	if (probe_timedout(pr))
+		rc = -ETIMEDOUT;
+
 	blkid_probe_end(pr);
 	if (rc < 0)
 		return BLKID_PROBE_ERROR;
@@ -2105,6 +3227,9 @@ blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr)
 		if (flags & BLKID_PARTS_FORCE_GPT)
 			blkid_probe_set_partitions_flags(pr->disk_probe,
 							 BLKID_PARTS_FORCE_GPT);
+
+		/* buffers read by another process (see sharedcache.c) */
+		blkid_probe_load_shared_buffers(pr->disk_probe);
 	}
 
 	return pr->disk_probe;
@@ -24,6 +24,7 @@
 #endif
 
 #include "blkidP.h"
+#include "all-io.h"
 
 #ifdef HAVE_STDLIB_H
 # ifndef _XOPEN_SOURCE
@@ -364,6 +365,128 @@ done:
 	return ret;
 }
 
+static const char *bincache_string(const char *strtab, uint32_t strtab_size,
+				   uint32_t off)
+{
+	/* the last byte of the string table is always zero, see below */
+	return off < strtab_size ? strtab + off : NULL;
+}
+
+/*
+ * Read the binary cache file (see struct blkid_bincache_header). The file is
+ * read by one read() and the devices are created directly from the records.
+ * It's not mapped, the cache file may be truncated and rewritten in place if
+ * blkid_flush_cache() is unable to create a temporary file.
+ */
+static int read_bincache(blkid_cache cache, int fd, size_t size)
+{
+	const struct blkid_bincache_header *hdr;
+	const struct blkid_bincache_dev *devs;
+	const struct blkid_bincache_tag *tags;
+	const char *strtab;
+	uint32_t ndevs, ntags, strtab_size, i, t = 0;
+	uint64_t sz;
+	void *data;
+	int rc = 0;
+
+	if (size < sizeof(*hdr))
+		return -BLKID_ERR_CACHE;
+
+	data = malloc(size);
+	if (!data)
+		return -BLKID_ERR_MEM;
+	if (lseek(fd, 0, SEEK_SET) == (off_t) -1
+	    || read_all(fd, data, size) != (ssize_t) size) {
+		rc = -BLKID_ERR_CACHE;
+		goto done;
+	}
+
+	hdr = data;
+	ndevs = le32_to_cpu(hdr->ndevs);
+	ntags = le32_to_cpu(hdr->ntags);
+	strtab_size = le32_to_cpu(hdr->strtab_size);
+
+	sz = sizeof(*hdr) + (uint64_t) ndevs * sizeof(*devs)
+			  + (uint64_t) ntags * sizeof(*tags)
+			  + strtab_size;
+
+	if (le32_to_cpu(hdr->version) != BLKID_BINCACHE_VERSION) {
+		DBG(READ, ul_debug("unsupported binary cache version %u",
+					le32_to_cpu(hdr->version)));
+		rc = -BLKID_ERR_CACHE;
+		goto done;
+	}
+	if (sz != size || !strtab_size) {
+		DBG(READ, ul_debug("binary cache size mismatch"));
+		rc = -BLKID_ERR_CACHE;
+		goto done;
+	}
+
+	devs = (const struct blkid_bincache_dev *) (hdr + 1);
+	tags = (const struct blkid_bincache_tag *) (devs + ndevs);
+	strtab = (const char *) (tags + ntags);
+
+	if (strtab[strtab_size - 1] != '\0') {
+		DBG(READ, ul_debug("binary cache: unterminated string table"));
+		rc = -BLKID_ERR_CACHE;
+		goto done;
+	}
+
+	for (i = 0; i < ndevs; i++) {
+		const struct blkid_bincache_dev *bd = &devs[i];
+		uint32_t n = le32_to_cpu(bd->ntags), end;
+		const char *name;
+		blkid_dev dev;
+
+		if (n > ntags - t) {
+			rc = -BLKID_ERR_CACHE;
+			break;
+		}
+		end = t + n;
+
+		name = bincache_string(strtab, strtab_size, le32_to_cpu(bd->name));
+		if (!name || !*name) {
+			DBG(READ, ul_debug("binary cache: empty device name"));
+			t = end;
+			continue;
+		}
+
+		DBG(READ, ul_debug("found dev %s", name));
+
+		dev = blkid_get_dev(cache, name, BLKID_DEV_CREATE);
+		if (!dev) {
+			t = end;
+			continue;
+		}
+		dev->bid_devno = le64_to_cpu(bd->devno);
+		dev->bid_time = (time_t) le64_to_cpu(bd->time);
+		dev->bid_utime = (suseconds_t) le64_to_cpu(bd->utime);
+		dev->bid_pri = (int) le32_to_cpu(bd->pri);
+
+		for (; t < end; t++) {
+			const char *tn, *tv;
+
+			tn = bincache_string(strtab, strtab_size, le32_to_cpu(tags[t].name));
+			tv = bincache_string(strtab, strtab_size, le32_to_cpu(tags[t].value));
+			if (!tn || !tv)
+				continue;
+
+			DBG(READ, ul_debug("tag: %s=\"%s\"", tn, tv));
+			if (blkid_set_tag(dev, tn, tv, strlen(tv)) < 0)
+				break;
+		}
+		t = end;
+
+		if (dev->bid_type == NULL) {
+			DBG(READ, ul_debug("blkid: device %s has no TYPE", dev->bid_name));
+			blkid_free_dev(dev);
+		}
+	}
+done:
+	free(data);
+	return rc;
+}
+
 /*
  * Parse the specified filename, and return the data in the supplied or
  * a newly allocated cache struct.  If the file doesn't exist, return a
@@ -373,6 +496,7 @@ void blkid_read_cache(blkid_cache cache)
 {
 	FILE *file;
 	char buf[4096];
+	char magic[BLKID_BINCACHE_MAGICSZ];
 	int fd, lineno = 0;
 	struct stat st;
 
@@ -394,6 +518,19 @@ void blkid_read_cache(blkid_cache cache)
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
+	if (S_ISREG(st.st_mode)
+	    && read(fd, magic, sizeof(magic)) == sizeof(magic)
+	    && memcmp(magic, BLKID_BINCACHE_MAGIC, sizeof(magic)) == 0) {
+
+		DBG(CACHE, ul_debug("binary cache format"));
+		if (read_bincache(cache, fd, st.st_size) < 0)
+			DBG(READ, ul_debug("blkid: bad binary cache file format"));
+		close(fd);
+		goto done;
+	}
+	if (lseek(fd, 0, SEEK_SET) == (off_t) -1 && errno != ESPIPE)
+		goto errout;
+
 	file = fdopen(fd, "r" UL_CLOEXECSTR);
 	if (!file)
 		goto errout;
@@ -419,7 +556,7 @@ void blkid_read_cache(blkid_cache cache)
 		}
 	}
 	fclose(file);
-
+done:
 	/*
 	 * Initially we do not need to write out the cache file.
 	 */
@@ -24,6 +24,7 @@
 
 #include "closestream.h"
 #include "fileutils.h"
+#include "all-io.h"
 
 #include "blkidP.h"
 
@@ -73,6 +74,153 @@ static int save_dev(blkid_dev dev, FILE *file)
 	return 0;
 }
 
+/* the same filter for the text and binary formats */
+static int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_name[0] == '/' && dev->bid_type
+	       && !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+struct bincache_strtab {
+	char	*data;
+	size_t	size;
+	size_t	alloc;
+};
+
+/* returns offset of the string in the table, or negative number on error */
+static int64_t bincache_add_string(struct bincache_strtab *tb, const char *str,
+				   int dedup)
+{
+	size_t len = strlen(str) + 1;
+	int64_t off;
+
+	/* tag names are usually the same for all devices */
+	if (dedup) {
+		size_t i;
+
+		for (i = 0; i + len <= tb->size; i += strlen(tb->data + i) + 1) {
+			if (memcmp(tb->data + i, str, len) == 0)
+				return i;
+		}
+	}
+
+	if (tb->size + len > UINT32_MAX)
+		return -BLKID_ERR_BIG;
+	if (tb->size + len > tb->alloc) {
+		size_t sz = max(tb->alloc * 2, tb->size + len + 4096);
+		char *tmp = realloc(tb->data, sz);
+
+		if (!tmp)
+			return -BLKID_ERR_MEM;
+		tb->data = tmp;
+		tb->alloc = sz;
+	}
+	memcpy(tb->data + tb->size, str, len);
+	off = tb->size;
+	tb->size += len;
+	return off;
+}
+
+static int save_bincache(blkid_cache cache, FILE *file)
+{
+	struct blkid_bincache_header hdr = { .version = 0 };
+	struct blkid_bincache_dev *devs = NULL;
+	struct blkid_bincache_tag *tags = NULL;
+	struct bincache_strtab tb = { .data = NULL };
+	size_t ndevs = 0, ntags = 0, d = 0, t = 0;
+	struct list_head *p;
+	int64_t off = 0;
+	int rc = 0;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct list_head *x;
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		list_for_each(x, &dev->bid_tags)
+			ntags++;
+	}
+
+	if (ndevs) {
+		devs = calloc(ndevs, sizeof(*devs));
+		if (!devs)
+			goto nomem;
+	}
+	if (ntags) {
+		tags = calloc(ntags, sizeof(*tags));
+		if (!tags)
+			goto nomem;
+	}
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct blkid_bincache_dev *bd;
+		struct list_head *x;
+		size_t first = t;
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		DBG(SAVE, ul_debug("device %s, type %s", dev->bid_name, dev->bid_type));
+
+		bd = &devs[d++];
+		off = bincache_add_string(&tb, dev->bid_name, 0);
+		if (off < 0)
+			goto fail;
+		bd->name = cpu_to_le32((uint32_t) off);
+		bd->devno = cpu_to_le64((uint64_t) dev->bid_devno);
+		bd->time = cpu_to_le64((uint64_t) dev->bid_time);
+		bd->utime = cpu_to_le64((uint64_t) dev->bid_utime);
+		bd->pri = cpu_to_le32((uint32_t) dev->bid_pri);
+
+		list_for_each(x, &dev->bid_tags) {
+			blkid_tag tag = list_entry(x, struct blkid_struct_tag, bit_tags);
+
+			off = bincache_add_string(&tb, tag->bit_name, 1);
+			if (off < 0)
+				goto fail;
+			tags[t].name = cpu_to_le32((uint32_t) off);
+
+			off = bincache_add_string(&tb, tag->bit_val ? : "", 0);
+			if (off < 0)
+				goto fail;
+			tags[t].value = cpu_to_le32((uint32_t) off);
+			t++;
+		}
+		bd->ntags = cpu_to_le32((uint32_t) (t - first));
+	}
+	assert(d == ndevs);
+	assert(t == ntags);
+
+	if (!tb.size && bincache_add_string(&tb, "", 0) < 0)
+		goto nomem;
+
+	memcpy(hdr.magic, BLKID_BINCACHE_MAGIC, BLKID_BINCACHE_MAGICSZ);
+	hdr.version = cpu_to_le32(BLKID_BINCACHE_VERSION);
+	hdr.ndevs = cpu_to_le32((uint32_t) ndevs);
+	hdr.ntags = cpu_to_le32((uint32_t) ntags);
+	hdr.strtab_size = cpu_to_le32((uint32_t) tb.size);
+
+	if (fwrite_all(&hdr, sizeof(hdr), 1, file)
+	    || (ndevs && fwrite_all(devs, sizeof(*devs), ndevs, file))
+	    || (ntags && fwrite_all(tags, sizeof(*tags), ntags, file))
+	    || fwrite_all(tb.data, 1, tb.size, file))
+		rc = -errno;
+	goto done;
+fail:
+	rc = (int) off;
+	goto done;
+nomem:
+	rc = -BLKID_ERR_MEM;
+done:
+	free(devs);
+	free(tags);
+	free(tb.data);
+	return rc;
+}
+
 /*
  * Write out the cache struct to the cache file on disk.
  */
@@ -157,12 +305,16 @@ int blkid_flush_cache(blkid_cache cache)
 		goto errout;
 	}
 
-	list_for_each(p, &cache->bic_devs) {
-		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
-		if (!dev->bid_type || (dev->bid_flags & BLKID_BID_FL_REMOVABLE))
-			continue;
-		if ((ret = save_dev(dev, file)) < 0)
-			break;
+	if (cache->bic_flags & BLKID_BIC_FL_BINARY)
+		ret = save_bincache(cache, file);
+	else {
+		list_for_each(p, &cache->bic_devs) {
+			blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+			if (!is_saved_dev(dev))
+				continue;
+			if ((ret = save_dev(dev, file)) < 0)
+				break;
+		}
 	}
 
 	if (ret >= 0) {
@@ -0,0 +1,309 @@
+/*
+ * sharedcache.c - share whole-disk probing buffers between processes
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The partitions of the same disk are often probed at the same time by many
+ * processes (e.g. udev workers on coldplug). All of them have to parse the
+ * partition table on the whole-disk device to get PART_ENTRY_* values.
+ *
+ * If the BLKID_SHARED_CACHE=<directory> environment variable is set, the
+ * buffers read by the whole-disk prober are saved to <directory>/disk-M:m and
+ * reused by the other processes. The file is accepted only for a short time,
+ * if it's owned by the current user, if the device number, size, disk
+ * sequence number and modification time of the device node match, and if
+ * the begin of the disk (MBR, GPT header) is still the same as in the file.
+ *
+ * Only the begin of the disk is verified, so partition tables with data
+ * elsewhere (DOS extended partitions, nested tables) are not shared; these
+ * may be modified by writes to the partition devices.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+
+#include "blkidP.h"
+#include "blkdev.h"
+#include "env.h"
+#include "fileutils.h"
+#include "all-io.h"
+
+#define BLKID_SHARED_MAGIC	"BLKIDSHR"
+#define BLKID_SHARED_VERSION	2
+#define BLKID_SHARED_TIMEOUT	5			/* seconds */
+#define BLKID_SHARED_MAXSZ	(1024 * 1024)		/* all buffers */
+#define BLKID_SHARED_MAXBUFS	256
+
+struct shared_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	nbufs;
+	uint64_t	devno;
+	uint64_t	size;
+	uint64_t	diskseq;
+	int64_t		time;
+	int64_t		mtime;		/* device node st_mtim */
+	int64_t		mtime_nsec;
+};
+
+struct shared_buffer {
+	uint64_t	off;
+	uint64_t	len;
+	/* followed by data */
+};
+
+static char *shared_filename(blkid_probe pr)
+{
+	const char *dir = safe_getenv("BLKID_SHARED_CACHE");
+	char *name = NULL;
+
+	if (!dir || !*dir || !S_ISBLK(pr->mode))
+		return NULL;
+	if (asprintf(&name, "%s/disk-%u:%u", dir,
+			major(pr->devno), minor(pr->devno)) < 0)
+		return NULL;
+	return name;
+}
+
+static void get_mtime(blkid_probe pr, int64_t *sec, int64_t *nsec)
+{
+	struct stat st;
+
+	if (fstat(pr->fd, &st) != 0) {
+		*sec = *nsec = -1;
+		return;
+	}
+	*sec = st.st_mtim.tv_sec;
+	*nsec = st.st_mtim.tv_nsec;
+}
+
+static uint64_t get_diskseq(blkid_probe pr)
+{
+	uint64_t seq = 0;
+
+	if (ioctl(pr->fd, BLKGETDISKSEQ, &seq) != 0)
+		seq = 0;
+	return seq;
+}
+
+/* iterate over buffers in the file, returns NULL at the end or on error */
+static const struct shared_buffer *next_buffer(const unsigned char *map,
+				size_t mapsz, size_t *pos)
+{
+	const struct shared_buffer *sb;
+
+	if (*pos + sizeof(*sb) > mapsz)
+		return NULL;
+	sb = (const struct shared_buffer *) (map + *pos);
+	if (!sb->len || sb->len > mapsz - *pos - sizeof(*sb)
+	    || sb->off > UINT64_MAX - sb->len)
+		return NULL;
+	*pos += sizeof(*sb) + sb->len;
+	return sb;
+}
+
+/*
+ * Read buffers from the shared file to the whole-disk prober.
+ *
+ * Returns: 0 on success, 1 if not available, <0 on error.
+ */
+int blkid_probe_load_shared_buffers(blkid_probe pr)
+{
+	const struct shared_header *hdr;
+	const struct shared_buffer *sb;
+	const unsigned char *begin;
+	unsigned char *map = MAP_FAILED;
+	uint64_t beginsz;
+	int64_t mtime, mtime_nsec;
+	size_t mapsz = 0, pos;
+	struct stat st;
+	uint32_t i;
+	char *name;
+	time_t now;
+	int fd, rc = 1;
+
+	name = shared_filename(pr);
+	if (!name)
+		return 1;
+
+	fd = open(name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+	if (fd < 0)
+		goto done;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+	    || st.st_uid != geteuid()
+	    || (size_t) st.st_size < sizeof(*hdr))
+		goto done;
+
+	mapsz = st.st_size;
+	map = mmap(NULL, mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto done;
+
+	hdr = (const struct shared_header *) map;
+	now = time(NULL);
+
+	if (memcmp(hdr->magic, BLKID_SHARED_MAGIC, sizeof(hdr->magic)) != 0
+	    || hdr->version != BLKID_SHARED_VERSION
+	    || hdr->devno != (uint64_t) pr->devno
+	    || hdr->size != pr->size
+	    || !hdr->nbufs || hdr->nbufs > BLKID_SHARED_MAXBUFS
+	    || hdr->time > now || now - hdr->time > BLKID_SHARED_TIMEOUT) {
+		DBG(LOWPROBE, ul_debug("shared cache %s: outdated", name));
+		goto done;
+	}
+	if (hdr->diskseq != get_diskseq(pr)) {
+		DBG(LOWPROBE, ul_debug("shared cache %s: diskseq mismatch", name));
+		goto done;
+	}
+	get_mtime(pr, &mtime, &mtime_nsec);
+	if (mtime < 0 || hdr->mtime != mtime || hdr->mtime_nsec != mtime_nsec) {
+		DBG(LOWPROBE, ul_debug("shared cache %s: device modified", name));
+		goto done;
+	}
+
+	/* compare the begin of the disk with the cached data */
+	beginsz = 2 * (uint64_t) blkid_probe_get_sectorsize(pr);
+	if (beginsz > pr->size)
+		beginsz = pr->size;
+	begin = blkid_probe_get_buffer(pr, 0, beginsz);
+	if (!begin) {
+		rc = errno ? -errno : 1;
+		goto done;
+	}
+
+	for (i = 0, pos = sizeof(*hdr); i < hdr->nbufs; i++) {
+		sb = next_buffer(map, mapsz, &pos);
+		if (!sb)
+			goto done;
+		if (sb->off < beginsz) {
+			uint64_t end = min(sb->off + sb->len, beginsz);
+
+			if (memcmp(begin + sb->off, (const unsigned char *) (sb + 1),
+				   end - sb->off) != 0) {
+				DBG(LOWPROBE, ul_debug("shared cache %s: modified", name));
+				goto done;
+			}
+		}
+	}
+
+	/* import */
+	for (i = 0, pos = sizeof(*hdr); i < hdr->nbufs; i++) {
+		sb = next_buffer(map, mapsz, &pos);
+		if (!sb)
+			break;
+		if (sb->off + sb->len <= beginsz)
+			continue;
+		rc = blkid_probe_import_buffer(pr, sb->off, sb->len,
+				(const unsigned char *) (sb + 1));
+		if (rc < 0) {
+			blkid_probe_reset_buffers(pr);
+			goto done;
+		}
+	}
+
+	DBG(LOWPROBE, ul_debug("shared cache %s: %u buffers imported", name, hdr->nbufs));
+	pr->flags |= BLKID_FL_SHARED_BUFF;
+	rc = 0;
+done:
+	if (map != MAP_FAILED)
+		munmap(map, mapsz);
+	if (fd >= 0)
+		close(fd);
+	free(name);
+	return rc;
+}
+
+/*
+ * Write whole-disk prober buffers to the shared file. The caller is expected
+ * to check that the partition table is completely described by the begin of
+ * the disk (see blkid_partitions_probe_partition()).
+ */
+int blkid_probe_save_shared_buffers(blkid_probe pr)
+{
+	struct shared_header hdr = { .version = BLKID_SHARED_VERSION };
+	struct list_head *p;
+	uint64_t total = 0;
+	char *name, *tmp = NULL;
+	int fd = -1, rc = -1;
+
+	/* don't share hidden ranges nor re-write what we have from the file */
+	if (pr->flags & (BLKID_FL_MODIF_BUFF | BLKID_FL_SHARED_BUFF))
+		return 0;
+
+	name = shared_filename(pr);
+	if (!name)
+		return 0;
+
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *bf = list_entry(p, struct blkid_bufinfo, bufs);
+
+		hdr.nbufs++;
+		total += bf->len;
+	}
+	if (!hdr.nbufs || hdr.nbufs > BLKID_SHARED_MAXBUFS
+	    || total > BLKID_SHARED_MAXSZ) {
+		rc = 0;
+		goto done;
+	}
+
+	memcpy(hdr.magic, BLKID_SHARED_MAGIC, sizeof(hdr.magic));
+	hdr.devno = pr->devno;
+	hdr.size = pr->size;
+	hdr.diskseq = get_diskseq(pr);
+	hdr.time = time(NULL);
+	get_mtime(pr, &hdr.mtime, &hdr.mtime_nsec);
+	if (hdr.mtime < 0) {
+		rc = 0;
+		goto done;
+	}
+
+	if (asprintf(&tmp, "%s-XXXXXX", name) < 0) {
+		tmp = NULL;
+		goto done;
+	}
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0)
+		goto done;
+
+	if (write_all(fd, &hdr, sizeof(hdr)) != 0)
+		goto done;
+
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *bf = list_entry(p, struct blkid_bufinfo, bufs);
+		struct shared_buffer sb = { .off = bf->off, .len = bf->len };
+
+		if (write_all(fd, &sb, sizeof(sb)) != 0 ||
+		    write_all(fd, bf->data, bf->len) != 0)
+			goto done;
+	}
+
+	if (close(fd) != 0) {
+		fd = -1;
+		goto done;
+	}
+	fd = -1;
+
+	if (rename(tmp, name) != 0)
+		goto done;
+
+	DBG(LOWPROBE, ul_debug("shared cache %s: %u buffers saved", name, hdr.nbufs));
+	rc = 0;
+done:
+	if (fd >= 0)
+		close(fd);
+	if (rc != 0 && tmp) {
+		DBG(LOWPROBE, ul_debug("shared cache %s: save failed", name));
+		unlink(tmp);
+	}
+	free(tmp);
+	free(name);
+	return rc;
+}
@@ -373,6 +373,11 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [SUBLKS idx=%d]",
 		chn->idx));
 
+	if (chn->idx < 0) {
+		blkid_probe_preread_chain(pr, chn);
+		blkid_probe_index_chain(pr, chn);
+	}
+
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
@@ -394,6 +399,12 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			continue;	/* the device is too small */
 		}
 
+		if (chn->nomagic && blkid_bmp_get_item(chn->nomagic, i)) {
+			DBG(LOWPROBE, ul_debug("[%zd] %s: no magic (skip)", i, id->name));
+			rc = BLKID_PROBE_NONE;
+			continue;
+		}
+
 		/* don't probe for RAIDs, swap or journal on CD/DVDs */
 		if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
 		    blkid_probe_is_cdrom(pr)) {
@@ -409,7 +420,11 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 
 		DBG(LOWPROBE, ul_debug("[%zd] %s:", i, id->name));
 
+		blkid_probe_start_stats(pr, chn, i);
+
 		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
+		if (rc != BLKID_PROBE_OK)
+			blkid_probe_end_stats(pr);
 		if (rc < 0)
 			break;
 		if (rc != BLKID_PROBE_OK)
@@ -421,6 +436,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			errno = 0;
 			rc = id->probefunc(pr, mag);
 			blkid_probe_prune_buffers(pr);
+			blkid_probe_end_stats(pr);
 			if (rc != BLKID_PROBE_OK) {
 				blkid_probe_chain_reset_values(pr, chn);
 				if (rc < 0)
@@ -428,6 +444,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 				continue;
 			}
 		}
+		blkid_probe_end_stats(pr);	/* no probefunc() */
 
 		/* all checks passed */
 		if (chn->flags & BLKID_SUBLKS_TYPE)
@@ -27,10 +27,99 @@ static blkid_tag blkid_new_tag(void)
 	DBG(TAG, ul_debugobj(tag, "alloc"));
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hash);
 
 	return tag;
 }
 
+/*
+ * The cache tags are also hashed by NAME=value, so blkid_find_dev_with_tag()
+ * does not need to scan all tags of the given NAME. The table is allocated
+ * on demand and resized when the number of the tags grows.
+ */
+#define TAG_HASH_MINSZ		64
+
+static size_t tag_hash(const char *name, const char *value)
+{
+	const unsigned char *p;
+	size_t h = 2166136261U;		/* FNV-1a */
+
+	for (p = (const unsigned char *) name; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	h = (h ^ '=') * 16777619U;
+	for (p = (const unsigned char *) value; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	return h;
+}
+
+static int resize_tag_hash(blkid_cache cache, size_t nhash)
+{
+	struct list_head *hash, *p, *x;
+	size_t i, n = 0;
+
+	hash = malloc(nhash * sizeof(struct list_head));
+	if (!hash)
+		return -BLKID_ERR_MEM;
+	for (i = 0; i < nhash; i++)
+		INIT_LIST_HEAD(&hash[i]);
+
+	DBG(TAG, ul_debug("resize tags hash %zu -> %zu", cache->bic_nhash, nhash));
+
+	/* (re)hash all cache tags in the original order */
+	list_for_each(p, &cache->bic_tags) {
+		blkid_tag head = list_entry(p, struct blkid_struct_tag, bit_tags);
+
+		list_for_each(x, &head->bit_names) {
+			blkid_tag t = list_entry(x, struct blkid_struct_tag, bit_names);
+
+			list_del(&t->bit_hash);
+			list_add_tail(&t->bit_hash,
+				&hash[tag_hash(t->bit_name, t->bit_val) % nhash]);
+			n++;
+		}
+	}
+
+	free(cache->bic_hash);
+	cache->bic_hash = hash;
+	cache->bic_nhash = nhash;
+	cache->bic_nhashed = n;
+	return 0;
+}
+
+/* the tag has to be already linked to the cache tag head */
+static void hash_tag(blkid_cache cache, blkid_tag t)
+{
+	if (!cache->bic_hash || cache->bic_nhashed >= cache->bic_nhash * 2) {
+		size_t sz = max((size_t) TAG_HASH_MINSZ, cache->bic_nhash * 4);
+
+		if (resize_tag_hash(cache, sz) == 0)
+			return;		/* all tags rehashed, including @t */
+		if (!cache->bic_hash)
+			return;		/* the lists are still usable */
+	}
+
+	list_add_tail(&t->bit_hash,
+		&cache->bic_hash[tag_hash(t->bit_name, t->bit_val) % cache->bic_nhash]);
+	cache->bic_nhashed++;
+}
+
+static void unhash_tag(blkid_tag t)
+{
+	if (list_empty(&t->bit_hash))
+		return;
+
+	list_del_init(&t->bit_hash);
+	if (t->bit_dev && t->bit_dev->bid_cache)
+		t->bit_dev->bid_cache->bic_nhashed--;
+}
+
+void blkid_free_tag_hash(blkid_cache cache)
+{
+	free(cache->bic_hash);
+	cache->bic_hash = NULL;
+	cache->bic_nhash = cache->bic_nhashed = 0;
+}
+
 void blkid_free_tag(blkid_tag tag)
 {
 	if (!tag)
@@ -40,6 +129,7 @@ void blkid_free_tag(blkid_tag tag)
 
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
+	unhash_tag(tag);		/* list of tags with the same hash */
 
 	free(tag->bit_name);
 	free(tag->bit_val);
@@ -139,8 +229,11 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 			return 0;
 		}
 		DBG(TAG, ul_debugobj(t, "update (%s) '%s' -> '%s'", t->bit_name, t->bit_val, val));
+		unhash_tag(t);
 		free(t->bit_val);
 		t->bit_val = val;
+		if (dev->bid_cache)
+			hash_tag(dev->bid_cache, t);
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -168,6 +261,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			hash_tag(dev->bid_cache, t);
 		}
 	}
 
@@ -321,6 +415,18 @@ void blkid_tag_iterate_end(blkid_tag_iterate iter)
 blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 					 const char *type,
 					 const char *value)
+{
+	return blkid__find_dev_with_tag(cache, type, value, 1);
+}
+
+/*
+ * The same as blkid_find_dev_with_tag(), but if @probe is zero then only
+ * devices already in the cache are searched (and verified).
+ */
+blkid_dev blkid__find_dev_with_tag(blkid_cache cache,
+				   const char *type,
+				   const char *value,
+				   int probe)
 {
 	blkid_tag	head;
 	blkid_dev	dev;
@@ -340,7 +446,23 @@ try_again:
 	dev = NULL;
 	head = blkid_find_head_cache(cache, type);
 
-	if (head) {
+	if (head && cache->bic_hash) {
+		struct list_head *bucket = &cache->bic_hash[
+				tag_hash(type, value) % cache->bic_nhash];
+
+		list_for_each(p, bucket) {
+			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
+						   bit_hash);
+
+			if (!strcmp(tmp->bit_name, type) &&
+			    !strcmp(tmp->bit_val, value) &&
+			    (tmp->bit_dev->bid_pri > pri) &&
+			    !access(tmp->bit_dev->bid_name, F_OK)) {
+				dev = tmp->bit_dev;
+				pri = dev->bid_pri;
+			}
+		}
+	} else if (head) {
 		list_for_each(p, &head->bit_names) {
 			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
 						   bit_names);
@@ -359,6 +481,9 @@ try_again:
 			goto try_again;
 	}
 
+	if (!dev && !probe)
+		return NULL;
+
 	if (!dev && !probe_new) {
 		if (blkid_probe_all_new(cache) < 0)
 			return NULL;
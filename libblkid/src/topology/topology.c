@@ -117,6 +117,34 @@ int blkid_probe_enable_topology(blkid_probe pr, int enable)
 	return 0;
 }
 
+/**
+ * blkid_probe_set_topology_flags:
+ * @pr: prober
+ * @flags: BLKID_TOPOLOGY_* flags
+ *
+ * Sets probing flags to the topology prober. This function is optional.
+ *
+ * <informalexample>
+ *  <programlisting>
+ * BLKID_TOPOLOGY_PARALLEL  - blkid_do_fullprobe() gathers topology in a
+ *                            separate thread while the other chains read
+ *                            the device
+ *  </programlisting>
+ * </informalexample>
+ *
+ * The topology is mostly read from sysfs and by ioctls, it does not depend
+ * on the data on the device. The result is the same as without the flag.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_set_topology_flags(blkid_probe pr, int flags)
+{
+	pr->chains[BLKID_CHAIN_TOPLGY].flags = flags;
+	return 0;
+}
+
 /**
  * blkid_probe_get_topology:
  * @pr: probe
@@ -184,8 +212,10 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 		if (id->probefunc) {
 			DBG(LOWPROBE, ul_debug("%s: call probefunc()", id->name));
 			errno = 0;
+			blkid_probe_start_stats(pr, chn, i);
 			rc = id->probefunc(pr, NULL);
 			blkid_probe_prune_buffers(pr);
+			blkid_probe_end_stats(pr);
 			if (rc != 0)
 				continue;
 		}
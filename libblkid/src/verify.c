@@ -49,6 +49,69 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+/*
+ * Probe only for the cached type and compare the result with the cached
+ * superblock tags. It's usually a few reads rather than full probing.
+ *
+ * Returns: 0 if the device is unchanged, 1 if full probing is necessary.
+ */
+static int verify_incremental(blkid_probe pr, blkid_dev dev)
+{
+	char *types[] = { dev->bid_type, NULL };
+	struct list_head *p;
+	int nvals, n, nmatch = 0, ntags = 0, rc = 1;
+
+	if (!dev->bid_type)
+		return 1;
+
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+	blkid_probe_enable_partitions(pr, FALSE);
+
+	if (blkid_probe_filter_superblocks_type(pr, BLKID_FLTR_ONLYIN, types))
+		goto done;
+	if (blkid_do_safeprobe(pr))
+		goto done;
+
+	nvals = blkid_probe_numof_values(pr);
+
+	for (n = 0; n < nvals; n++) {
+		const char *name, *data;
+		blkid_tag tag;
+
+		if (blkid_probe_get_value(pr, n, &name, &data, NULL) != 0)
+			continue;
+		if (strncmp(name, "PART_ENTRY_", 11) == 0 || strstr(name, "_ID"))
+			continue;
+		tag = blkid_find_tag_dev(dev, name);
+		if (!tag || strcmp(tag->bit_val, data) != 0) {
+			DBG(PROBE, ul_debug("%s: %s changed", dev->bid_name, name));
+			goto done;
+		}
+		nmatch++;
+	}
+
+	/* cached superblock tags (the partition tags are not probed) */
+	list_for_each(p, &dev->bid_tags) {
+		blkid_tag tag = list_entry(p, struct blkid_struct_tag, bit_tags);
+
+		if (strcmp(tag->bit_name, "PARTUUID") != 0 &&
+		    strcmp(tag->bit_name, "PARTLABEL") != 0)
+			ntags++;
+	}
+	if (nmatch == ntags)
+		rc = 0;
+done:
+	blkid_probe_reset_superblocks_filter(pr);
+	blkid_probe_enable_partitions(pr, TRUE);
+
+	DBG(PROBE, ul_debug("%s: incremental verify: %s", dev->bid_name,
+				rc == 0 ? "unchanged" : "full probing necessary"));
+	return rc;
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -64,7 +127,7 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 	const char *type, *value;
 	struct stat st;
 	time_t diff, now;
-	int fd;
+	int fd, unchanged = 0;
 
 	if (!dev || !cache)
 		return NULL;
@@ -141,27 +204,33 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		return NULL;
 	}
 
-	/* remove old cache info */
-	iter = blkid_tag_iterate_begin(dev);
-	while (blkid_tag_next(iter, &type, &value) == 0)
-		blkid_set_tag(dev, type, NULL, 0);
-	blkid_tag_iterate_end(iter);
+	if ((cache->bic_flags & BLKID_BIC_FL_INCREMENTAL) &&
+	    dev->bid_devno == st.st_rdev &&
+	    verify_incremental(cache->probe, dev) == 0)
+		unchanged = 1;
+	else {
+		/* remove old cache info */
+		iter = blkid_tag_iterate_begin(dev);
+		while (blkid_tag_next(iter, &type, &value) == 0)
+			blkid_set_tag(dev, type, NULL, 0);
+		blkid_tag_iterate_end(iter);
 
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+		/* enable superblocks probing */
+		blkid_probe_enable_superblocks(cache->probe, TRUE);
+		blkid_probe_set_superblocks_flags(cache->probe,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+			BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
 
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
+		/* enable partitions probing */
+		blkid_probe_enable_partitions(cache->probe, TRUE);
+		blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
 
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
-		/* found nothing or error */
-		blkid_free_dev(dev);
-		dev = NULL;
+		/* probe */
+		if (blkid_do_safeprobe(cache->probe)) {
+			/* found nothing or error */
+			blkid_free_dev(dev);
+			dev = NULL;
+		}
 	}
 
 	if (dev) {
@@ -178,7 +247,8 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
 		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 
-		blkid_probe_to_tags(cache->probe, dev);
+		if (!unchanged)
+			blkid_probe_to_tags(cache->probe, dev);
 
 		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
 			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
@@ -7,6 +7,7 @@
 # include "partx.h"
 #endif
 #include "loopdev.h"
+#include "fileutils.h"
 #include "fdiskP.h"
 
 #include "strutils.h"
@@ -117,6 +118,7 @@ static int init_nested_from_parent(struct fdisk_context *cxt, int isnew)
 		cxt->display_details =	parent->display_details;
 		cxt->display_in_cyl_units = parent->display_in_cyl_units;
 		cxt->protect_bootbits = parent->protect_bootbits;
+		cxt->wipe_method = parent->wipe_method;
 	}
 
 	free(cxt->dev_model);
@@ -420,6 +422,60 @@ int fdisk_has_wipe(struct fdisk_context *cxt)
 	return fdisk_has_wipe_area(cxt, 0, cxt->total_sectors);
 }
 
+/**
+ * fdisk_set_wipe_method
+ * @cxt: fdisk context
+ * @method: FDISK_WIPEMETHOD_*
+ *
+ * By default the library erases only the PT/filesystem/RAID signatures found
+ * by libblkid in the wipe areas (see fdisk_enable_wipe() and
+ * fdisk_wipe_partition()). FDISK_WIPEMETHOD_ZEROOUT and
+ * FDISK_WIPEMETHOD_DISCARD clean the whole areas by BLKZEROOUT or BLKDISCARD
+ * ioctls instead; all data in the areas are lost. The library falls back to
+ * erasing the signatures if the ioctls are not supported.
+ *
+ * Returns: 0 on success, < 0 on error.
+ *
+ * Since: 2.41
+ */
+int fdisk_set_wipe_method(struct fdisk_context *cxt, int method)
+{
+	if (!cxt)
+		return -EINVAL;
+
+	switch (method) {
+	case FDISK_WIPEMETHOD_SIGNATURES:
+	case FDISK_WIPEMETHOD_ZEROOUT:
+	case FDISK_WIPEMETHOD_DISCARD:
+		cxt->wipe_method = method;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/**
+ * fdisk_enable_partial_reread
+ * @cxt: fdisk context
+ * @enable: 1 or 0
+ *
+ * By default fdisk_reread_partition_table() informs kernel only about the
+ * modified partitions (by BLKPG ioctls) if it's cheaper than to force kernel
+ * to re-read whole partition table. Use this function to disable this
+ * behavior.
+ *
+ * Returns: 0 on success, < 0 on error.
+ *
+ * Since: 2.41
+ */
+int fdisk_enable_partial_reread(struct fdisk_context *cxt, int enable)
+{
+	if (!cxt)
+		return -EINVAL;
+	cxt->no_partial_reread = enable ? 0 : 1;
+	return 0;
+}
+
 
 /**
  * fdisk_get_collision
@@ -518,6 +574,50 @@ struct fdisk_context *fdisk_get_parent(struct fdisk_context *cxt)
 	return cxt->parent;
 }
 
+static void drop_ondisk_layout(struct fdisk_context *cxt)
+{
+	fdisk_unref_table(cxt->ondisk);
+	cxt->ondisk = NULL;
+	free(cxt->ondisk_id);
+	cxt->ondisk_id = NULL;
+}
+
+/* returns "<label>:<id>" string */
+static char *get_ondisk_id(struct fdisk_context *cxt)
+{
+	char *id = NULL, *res = NULL;
+
+	if (!fdisk_has_label(cxt))
+		return NULL;
+
+	fdisk_get_disklabel_id(cxt, &id);
+	if (asprintf(&res, "%s:%s", cxt->label->name, id ? id : "") < 0)
+		res = NULL;
+	free(id);
+	return res;
+}
+
+/*
+ * Remember the current partitions as the partitions known by kernel; used
+ * by fdisk_reread_partition_table() to inform kernel about changes only.
+ */
+static void remember_ondisk_layout(struct fdisk_context *cxt)
+{
+	drop_ondisk_layout(cxt);
+
+	if (cxt->parent || cxt->readonly || !S_ISBLK(cxt->dev_st.st_mode)
+	    || !fdisk_has_label(cxt))
+		return;
+
+	if (fdisk_get_partitions(cxt, &cxt->ondisk) != 0) {
+		drop_ondisk_layout(cxt);
+		return;
+	}
+	cxt->ondisk_id = get_ondisk_id(cxt);
+	DBG(CXT, ul_debugobj(cxt, "remembered on-disk layout [%s, %zu partitions]",
+			cxt->ondisk_id, fdisk_table_get_nents(cxt->ondisk)));
+}
+
 static void reset_context(struct fdisk_context *cxt)
 {
 	size_t i;
@@ -568,6 +668,7 @@ static void reset_context(struct fdisk_context *cxt)
 	cxt->label = NULL;
 
 	fdisk_free_wipe_areas(cxt);
+	drop_ondisk_layout(cxt);
 }
 
 /* fdisk_assign_device() body */
@@ -627,6 +728,7 @@ static int fdisk_assign_fd(struct fdisk_context *cxt, int fd,
 
 	fdisk_probe_labels(cxt);
 	fdisk_apply_label_device_properties(cxt);
+	remember_ondisk_layout(cxt);
 
 	/* Don't report collision if there is already a valid partition table.
 	 * The bootbits are wiped when we create a *new* partition table only. */
@@ -831,12 +933,21 @@ int fdisk_reassign_device(struct fdisk_context *cxt)
 	return rc;
 }
 
+#ifdef __linux__
+static int reread_modified_partitions(struct fdisk_context *cxt);
+#endif
+
 /**
  * fdisk_reread_partition_table:
  * @cxt: context
  *
  * Force *kernel* to re-read partition table on block devices.
  *
+ * If only a few partitions have been modified since the device has been
+ * assigned (or since the last re-read), then the kernel is informed about the
+ * modified partitions by BLKPG ioctls only, and the unmodified partitions
+ * are not removed and added again. See fdisk_enable_partial_reread().
+ *
  * Returns: 0 on success, < 0 in case of error.
  */
 int fdisk_reread_partition_table(struct fdisk_context *cxt)
@@ -849,8 +960,15 @@ int fdisk_reread_partition_table(struct fdisk_context *cxt)
 	if (!S_ISBLK(cxt->dev_st.st_mode))
 		return 0;
 
-	DBG(CXT, ul_debugobj(cxt, "calling re-read ioctl"));
 	sync();
+#ifdef __linux__
+	if (!cxt->no_partial_reread && cxt->ondisk
+	    && reread_modified_partitions(cxt) == 0) {
+		remember_ondisk_layout(cxt);
+		return 0;
+	}
+#endif
+	DBG(CXT, ul_debugobj(cxt, "calling re-read ioctl"));
 #ifdef BLKRRPART
 	fdisk_info(cxt, _("Calling ioctl() to re-read partition table."));
 	i = ioctl(cxt->dev_fd, BLKRRPART);
@@ -860,14 +978,18 @@ int fdisk_reread_partition_table(struct fdisk_context *cxt)
 #endif
 
 	if (i) {
+		int rc = -errno;
+
+		drop_ondisk_layout(cxt);
 		fdisk_warn(cxt, _("Re-reading the partition table failed."));
 		fdisk_info(cxt,	_(
 			"The kernel still uses the old table. The "
 			"new table will be used at the next reboot "
 			"or after you run partprobe(8) or partx(8)."));
-		return -errno;
+		return rc;
 	}
 
+	remember_ondisk_layout(cxt);
 	return 0;
 }
 
@@ -886,89 +1008,121 @@ static inline int add_to_partitions_array(
 	(*n)++;
 	return 0;
 }
-#endif
 
-/**
- * fdisk_reread_changes:
- * @cxt: context
- * @org: original layout (on disk)
- *
- * Like fdisk_reread_partition_table() but don't forces kernel re-read all
- * partition table. The BLKPG_* ioctls are used for individual partitions. The
- * advantage is that unmodified partitions maybe mounted.
- *
- * The function behaves like fdisk_reread_partition_table() on systems where
- * are no available BLKPG_* ioctls.
- *
- * Returns: <0 on error, or 0.
+struct reread_changes {
+	struct fdisk_partition **rem, **add, **upd;
+	size_t nrems, nadds, nupds;
+};
+
+static void free_changes(struct reread_changes *ch)
+{
+	free(ch->rem);
+	free(ch->add);
+	free(ch->upd);
+}
+
+static inline int strdiff(const char *a, const char *b)
+{
+	return (a && b) ? strcmp(a, b) : a != b;
+}
+
+/* returns 1 if the user visible partition properties differ */
+static int partition_props_differ(struct fdisk_partition *a, struct fdisk_partition *b)
+{
+	struct fdisk_parttype *ta = a->type, *tb = b->type;
+
+	if (strdiff(a->name, b->name) || strdiff(a->uuid, b->uuid))
+		return 1;
+	if (!ta || !tb)
+		return ta != tb;
+	return ta->code != tb->code || strdiff(ta->typestr, tb->typestr);
+}
+
+/*
+ * Compares @org and @tb, the modified partitions are added to @ch. If
+ * @props is true, then partitions with modified type, UUID or name are
+ * removed and added again (udev has to re-read the properties).
  */
-#ifdef __linux__
-int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
+static int diff_changes(struct fdisk_table *org, struct fdisk_table *tb,
+			struct reread_changes *ch, int props)
 {
-	struct fdisk_table *tb = NULL;
 	struct fdisk_iter itr;
 	struct fdisk_partition *pa;
-	struct fdisk_partition **rem = NULL, **add = NULL, **upd = NULL;
-	int change, rc = 0, err = 0;
-	size_t nparts, i, nadds = 0, nupds = 0, nrems = 0;
-	unsigned int ssf;
-
-	DBG(CXT, ul_debugobj(cxt, "rereading changes"));
+	size_t nparts;
+	int change, rc = 0;
 
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
 
-	/* the current layout */
-	fdisk_get_partitions(cxt, &tb);
 	/* maximal number of partitions */
 	nparts = max(fdisk_table_get_nents(tb), fdisk_table_get_nents(org));
 
 	while (fdisk_diff_tables(org, tb, &itr, &pa, &change) == 0) {
-		if (change == FDISK_DIFF_UNCHANGED)
-			continue;
+		if (change == FDISK_DIFF_UNCHANGED) {
+			struct fdisk_partition *o;
+
+			if (!props)
+				continue;
+			o = fdisk_table_get_partition_by_partno(org, pa->partno);
+			if (!o || !partition_props_differ(o, pa))
+				continue;
+			change = FDISK_DIFF_MOVED;
+		}
 		switch (change) {
 		case FDISK_DIFF_REMOVED:
-			rc = add_to_partitions_array(&rem, pa, &nrems, nparts);
+			rc = add_to_partitions_array(&ch->rem, pa, &ch->nrems, nparts);
 			break;
 		case FDISK_DIFF_ADDED:
-			rc = add_to_partitions_array(&add, pa, &nadds, nparts);
+			rc = add_to_partitions_array(&ch->add, pa, &ch->nadds, nparts);
 			break;
 		case FDISK_DIFF_RESIZED:
-			rc = add_to_partitions_array(&upd, pa, &nupds, nparts);
+			rc = add_to_partitions_array(&ch->upd, pa, &ch->nupds, nparts);
 			break;
 		case FDISK_DIFF_MOVED:
-			rc = add_to_partitions_array(&rem, pa, &nrems, nparts);
+			rc = add_to_partitions_array(&ch->rem, pa, &ch->nrems, nparts);
 			if (!rc)
-				rc = add_to_partitions_array(&add, pa, &nadds, nparts);
+				rc = add_to_partitions_array(&ch->add, pa, &ch->nadds, nparts);
 			break;
 		}
 		if (rc != 0)
-			goto done;
+			break;
 	}
+	return rc;
+}
+
+/* calls BLKPG ioctls, returns number of failed ioctls */
+static size_t apply_changes(struct fdisk_context *cxt, struct reread_changes *ch,
+			    int quiet)
+{
+	struct fdisk_partition *pa;
+	size_t i, err = 0;
+	unsigned int ssf;
 
 	/* sector size factor -- used to recount from real to 512-byte sectors */
 	ssf = cxt->sector_size / 512;
 
-	for (i = 0; i < nrems; i++) {
-		pa = rem[i];
+	for (i = 0; i < ch->nrems; i++) {
+		pa = ch->rem[i];
 		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_DEL_PARTITION", pa->partno));
 		if (partx_del_partition(cxt->dev_fd, pa->partno + 1) != 0) {
-			fdisk_warn(cxt, _("Failed to remove partition %zu from system"), pa->partno + 1);
+			if (!quiet)
+				fdisk_warn(cxt, _("Failed to remove partition %zu from system"), pa->partno + 1);
 			err++;
 		}
 	}
-	for (i = 0; i < nupds; i++) {
-		pa = upd[i];
+	for (i = 0; i < ch->nupds; i++) {
+		pa = ch->upd[i];
 		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_RESIZE_PARTITION", pa->partno));
 		if (partx_resize_partition(cxt->dev_fd, pa->partno + 1,
 					   pa->start * ssf, pa->size * ssf) != 0) {
-			fdisk_warn(cxt, _("Failed to update system information about partition %zu"), pa->partno + 1);
+			if (!quiet)
+				fdisk_warn(cxt, _("Failed to update system information about partition %zu"), pa->partno + 1);
 			err++;
 		}
 	}
-	for (i = 0; i < nadds; i++) {
+	for (i = 0; i < ch->nadds; i++) {
 		uint64_t sz;
 
-		pa = add[i];
+		pa = ch->add[i];
 		sz = pa->size * ssf;
 
 		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_ADD_PARTITION", pa->partno));
@@ -981,18 +1135,151 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 
 		if (partx_add_partition(cxt->dev_fd, pa->partno + 1,
 					pa->start * ssf, sz) != 0) {
-			fdisk_warn(cxt, _("Failed to add partition %zu to system"), pa->partno + 1);
+			if (!quiet)
+				fdisk_warn(cxt, _("Failed to add partition %zu to system"), pa->partno + 1);
 			err++;
 		}
 	}
-	if (err)
-		fdisk_info(cxt,	_(
-			"The kernel still uses the old partitions. The new "
-			"table will be used at the next reboot. "));
+	return err;
+}
+
+/*
+ * Returns 1 if kernel partitions (as exported to sysfs) match @tb.
+ */
+static int kernel_layout_matches(struct fdisk_context *cxt, struct fdisk_table *tb)
+{
+	struct path_cxt *pc;
+	struct dirent *d;
+	DIR *dir;
+	size_t n = 0;
+	unsigned int ssf = cxt->sector_size / 512;
+	int ok = 0;
+
+	pc = ul_new_sysfs_path(fdisk_get_devno(cxt), NULL, NULL);
+	if (!pc)
+		return 0;
+	dir = ul_path_opendir(pc, NULL);
+	if (!dir)
+		goto done;
+
+	ok = 1;
+	while (ok && (d = xreaddir(dir))) {
+		struct fdisk_partition *pa;
+		uint64_t start = 0, size = 0;
+		int partno = 0;
+
+		if (!sysfs_blkdev_is_partition_dirent(dir, d, NULL))
+			continue;
+		if (ul_path_readf_s32(pc, &partno, "%s/partition", d->d_name) != 0
+		    || ul_path_readf_u64(pc, &start, "%s/start", d->d_name) != 0
+		    || ul_path_readf_u64(pc, &size, "%s/size", d->d_name) != 0
+		    || partno < 1) {
+			ok = 0;
+			break;
+		}
+
+		pa = fdisk_table_get_partition_by_partno(tb, partno - 1);
+		if (!pa || pa->start * ssf != start)
+			ok = 0;
+		/* kernel reduces DOS extended partition to 1 or 2 sectors */
+		else if (!fdisk_partition_is_container(pa) && pa->size * ssf != size)
+			ok = 0;
+		n++;
+	}
+	closedir(dir);
+
+	if (ok && n != fdisk_table_get_nents(tb))
+		ok = 0;
 done:
-	free(rem);
-	free(add);
-	free(upd);
+	ul_unref_path(pc);
+	DBG(CXT, ul_debugobj(cxt, "kernel partitions %s on-disk layout",
+				ok ? "match" : "do not match"));
+	return ok;
+}
+
+/*
+ * Informs kernel about modified partitions only. Returns 0 on success, 1 if
+ * BLKRRPART is necessary.
+ */
+static int reread_modified_partitions(struct fdisk_context *cxt)
+{
+	struct fdisk_table *tb = NULL;
+	struct reread_changes ch = { NULL };
+	size_t nops, nfull;
+	char *id;
+	int rc = 1;
+
+	/* new disklabel; udev has to see the change of the whole disk */
+	id = get_ondisk_id(cxt);
+	if (!id || !cxt->ondisk_id || strcmp(id, cxt->ondisk_id) != 0)
+		goto done;
+
+	if (!kernel_layout_matches(cxt, cxt->ondisk))
+		goto done;
+
+	if (fdisk_get_partitions(cxt, &tb) != 0
+	    || diff_changes(cxt->ondisk, tb, &ch, 1) != 0)
+		goto done;
+
+	/* BLKRRPART removes and adds all partitions */
+	nops = ch.nrems + ch.nadds + ch.nupds;
+	nfull = fdisk_table_get_nents(cxt->ondisk) + fdisk_table_get_nents(tb);
+
+	DBG(CXT, ul_debugobj(cxt, "modified partitions: %zu ioctls (%zu for re-read)",
+				nops, nfull));
+	if (nops >= nfull)
+		goto done;
+
+	if (nops) {
+		fdisk_info(cxt, _("Calling ioctl() to update modified partitions."));
+		if (apply_changes(cxt, &ch, 1) != 0)
+			goto done;
+	}
+	rc = 0;
+done:
+	free(id);
+	free_changes(&ch);
+	fdisk_unref_table(tb);
+	return rc;
+}
+#endif /* __linux__ */
+
+/**
+ * fdisk_reread_changes:
+ * @cxt: context
+ * @org: original layout (on disk)
+ *
+ * Like fdisk_reread_partition_table() but don't forces kernel re-read all
+ * partition table. The BLKPG_* ioctls are used for individual partitions. The
+ * advantage is that unmodified partitions maybe mounted.
+ *
+ * The function behaves like fdisk_reread_partition_table() on systems where
+ * are no available BLKPG_* ioctls.
+ *
+ * Returns: <0 on error, or 0.
+ */
+#ifdef __linux__
+int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
+{
+	struct fdisk_table *tb = NULL;
+	struct reread_changes ch = { NULL };
+	int rc;
+
+	DBG(CXT, ul_debugobj(cxt, "rereading changes"));
+
+	/* the current layout */
+	fdisk_get_partitions(cxt, &tb);
+
+	rc = diff_changes(org, tb, &ch, 0);
+	if (rc == 0) {
+		if (apply_changes(cxt, &ch, 0))
+			fdisk_info(cxt,	_(
+				"The kernel still uses the old partitions. The new "
+				"table will be used at the next reboot. "));
+		remember_ondisk_layout(cxt);
+	}
+
+	free_changes(&ch);
 	fdisk_unref_table(tb);
 	return rc;
 }
@@ -201,6 +201,10 @@ struct fdisk_table {
 	struct list_head	parts;		/* partitions */
 	int			refcount;
 	size_t			nents;		/* number of partitions */
+
+	struct fdisk_partition	**byend;	/* index sorted by end, see table_index_*() */
+	size_t			nbyend;		/* number of entries in the index */
+	size_t			byend_max;	/* allocated size of the index */
 };
 
 /*
@@ -406,10 +410,12 @@ struct fdisk_context {
 		     dev_model_probed : 1,	/* tried to read from sys */
 		     is_priv : 1,		/* open by libfdisk */
 		     is_excl : 1,		/* open with O_EXCL */
-		     listonly : 1;		/* list partition, nothing else */
+		     listonly : 1,		/* list partition, nothing else */
+		     no_partial_reread : 1;	/* always use BLKRRPART */
 
 	char *collision;			/* name of already existing FS/PT */
 	struct list_head wipes;			/* list of areas to wipe before write */
+	int wipe_method;			/* FDISK_WIPEMETHOD_* */
 
 	int sizeunit;				/* SIZE fields, FDISK_SIZEUNIT_* */
 
@@ -439,6 +445,9 @@ struct fdisk_context {
 
 	struct fdisk_context	*parent;	/* for nested PT */
 	struct fdisk_script	*script;	/* what we want to follow */
+
+	struct fdisk_table	*ondisk;	/* partitions known by kernel */
+	char			*ondisk_id;	/* label type and disk ID of @ondisk */
 };
 
 /* table */
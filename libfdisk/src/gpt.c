@@ -186,6 +186,12 @@ struct fdisk_gpt_label {
 
 	unsigned char *ents;			/* entries (partitions) */
 
+	/* copy of the entries as stored on disk, used to write changes only */
+	unsigned char *disk_ents;
+	size_t disk_entsz;			/* size of disk_ents */
+	uint64_t disk_pents_lba;		/* primary array LBA or 0 if unknown */
+	uint64_t disk_bents_lba;		/* backup array LBA or 0 if unknown */
+
 	unsigned int no_relocate :1,		/* do not fix backup location */
 		     minimize :1;
 };
@@ -1228,6 +1234,44 @@ invalid:
 }
 
 
+/*
+ * Remember entries as stored on disk at LBAs specified by the headers; NULL
+ * header means that the array on disk is unknown (corrupted, not written yet).
+ */
+static void gpt_remember_disk_entries(struct fdisk_gpt_label *gpt,
+				      struct gpt_header *pri,
+				      struct gpt_header *bkp)
+{
+	size_t esz = 0;
+
+	gpt->disk_pents_lba = 0;
+	gpt->disk_bents_lba = 0;
+
+	if ((!pri && !bkp)
+	    || gpt_sizeof_entries(gpt->pheader, &esz) != 0 || !esz)
+		goto forget;
+
+	if (gpt->disk_entsz != esz) {
+		unsigned char *p = realloc(gpt->disk_ents, esz);
+
+		if (!p)
+			goto forget;
+		gpt->disk_ents = p;
+		gpt->disk_entsz = esz;
+	}
+	memcpy(gpt->disk_ents, gpt->ents, esz);
+
+	if (pri)
+		gpt->disk_pents_lba = le64_to_cpu(pri->partition_entry_lba);
+	if (bkp)
+		gpt->disk_bents_lba = le64_to_cpu(bkp->partition_entry_lba);
+	return;
+forget:
+	free(gpt->disk_ents);
+	gpt->disk_ents = NULL;
+	gpt->disk_entsz = 0;
+}
+
 static int gpt_locate_disklabel(struct fdisk_context *cxt, int n,
 		const char **name, uint64_t *offset, size_t *size)
 {
@@ -1635,7 +1679,7 @@ done:
 
 static int gpt_probe_label(struct fdisk_context *cxt)
 {
-	int mbr_type;
+	int mbr_type, has_pri, has_bkp;
 	struct fdisk_gpt_label *gpt;
 
 	assert(cxt);
@@ -1666,6 +1710,14 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 	if (!gpt->pheader && !gpt->bheader)
 		goto failed;
 
+	/* both on-disk arrays are the same if their CRCs match */
+	has_pri = gpt->pheader != NULL;
+	has_bkp = gpt->bheader != NULL;
+	if (has_pri && has_bkp &&
+	    gpt->pheader->partition_entry_array_crc32 !=
+	    gpt->bheader->partition_entry_array_crc32)
+		has_bkp = 0;
+
 	/* primary OK, backup corrupted -- recovery */
 	if (gpt->pheader && !gpt->bheader) {
 		fdisk_warnx(cxt, _("The backup GPT table is corrupt, but the "
@@ -1711,6 +1763,9 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 	if (gpt->minimize && gpt_possible_minimize(cxt, gpt))
 		fdisk_label_set_changed(cxt->label, 1);
 
+	gpt_remember_disk_entries(gpt, has_pri ? gpt->pheader : NULL,
+				       has_bkp ? gpt->bheader : NULL);
+
 	cxt->label->nparts_max = gpt_get_nentries(gpt);
 	cxt->label->nparts_cur = partitions_in_use(gpt);
 	return 1;
@@ -2041,31 +2096,62 @@ static int gpt_write(struct fdisk_context *cxt, off_t offset, void *buf, size_t
 	if (write_all(cxt->dev_fd, buf, count))
 		return -errno;
 
-	if (fsync(cxt->dev_fd) != 0)
-		return -errno;
-
 	DBG(GPT, ul_debug("  write OK [offset=%zu, size=%zu]",
 				(size_t) offset, count));
 	return 0;
 }
 
+static int gpt_sync(struct fdisk_context *cxt)
+{
+	if (fsync(cxt->dev_fd) != 0)
+		return -errno;
+	return 0;
+}
+
 /*
- * Write partitions.
+ * Write partitions. If the array on disk is known, then only the range
+ * of the modified sectors is written.
+ *
  * Returns 0 on success, or corresponding error otherwise.
  */
 static int gpt_write_partitions(struct fdisk_context *cxt,
-				struct gpt_header *header, unsigned char *ents)
+				struct gpt_header *header, unsigned char *ents,
+				uint64_t disk_lba)
 {
-	size_t esz = 0;
+	struct fdisk_gpt_label *gpt = self_label(cxt);
+	uint64_t lba = le64_to_cpu(header->partition_entry_lba);
+	size_t esz = 0, first = 0, end;
 	int rc;
 
 	rc = gpt_sizeof_entries(header, &esz);
 	if (rc)
 		return rc;
+	end = esz;
+
+	if (disk_lba && disk_lba == lba && gpt->disk_ents
+	    && gpt->disk_entsz == esz) {
+		size_t ssz = cxt->sector_size, off;
+
+		end = 0;
+		for (off = 0; off < esz; off += ssz) {
+			size_t sz = min(ssz, esz - off);
+
+			if (memcmp(ents + off, gpt->disk_ents + off, sz) == 0)
+				continue;
+			if (!end)
+				first = off;
+			end = off + sz;
+		}
+		if (!end) {
+			DBG(GPT, ul_debug("entries on LBA %"PRIu64" unchanged", lba));
+			return 0;
+		}
+		DBG(GPT, ul_debug("entries on LBA %"PRIu64": modified %zu-%zu bytes",
+					lba, first, end));
+	}
 
-	return gpt_write(cxt,
-			(off_t) le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
-			ents, esz);
+	return gpt_write(cxt, (off_t) lba * cxt->sector_size + first,
+			ents + first, end - first);
 }
 
 /*
@@ -2139,8 +2225,11 @@ static int gpt_write_pmbr(struct fdisk_context *cxt)
 
  do_write:
 	/* pMBR covers the first sector (LBA) of the disk */
-	return gpt_write(cxt, GPT_PMBR_LBA * cxt->sector_size,
+	rc = gpt_write(cxt, GPT_PMBR_LBA * cxt->sector_size,
 			 pmbr, cxt->sector_size);
+	if (!rc)
+		rc = gpt_sync(cxt);
+	return rc;
 }
 
 /*
@@ -2151,7 +2240,7 @@ static int gpt_write_pmbr(struct fdisk_context *cxt)
 static int gpt_write_disklabel(struct fdisk_context *cxt)
 {
 	struct fdisk_gpt_label *gpt;
-	int mbr_type;
+	int mbr_type, rc;
 
 	assert(cxt);
 	assert(cxt->label);
@@ -2188,17 +2277,26 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	 *   4) primary GPT header
 	 *   5) protective MBR
 	 *
-	 * If any write fails, we abort the rest.
+	 * If any write fails, we abort the rest. The unmodified parts of the
+	 * partition arrays are not written, the device is synced after each
+	 * GPT copy.
 	 */
-	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents) != 0)
+	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents, gpt->disk_bents_lba) != 0)
 		goto err1;
 	if (gpt_write_header(cxt, gpt->bheader,
 			     le64_to_cpu(gpt->pheader->alternative_lba)) != 0)
 		goto err1;
-	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents) != 0)
+	if (gpt_sync(cxt) != 0)
+		goto err1;
+
+	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents, gpt->disk_pents_lba) != 0)
 		goto err1;
 	if (gpt_write_header(cxt, gpt->pheader, GPT_PRIMARY_PARTITION_TABLE_LBA) != 0)
 		goto err1;
+	if (gpt_sync(cxt) != 0)
+		goto err1;
+
+	gpt_remember_disk_entries(gpt, gpt->pheader, gpt->bheader);
 
 	if (mbr_type == GPT_MBR_HYBRID)
 		fdisk_warnx(cxt, _("The device contains hybrid MBR -- writing GPT only."));
@@ -2212,8 +2310,11 @@ err0:
 	errno = EINVAL;
 	return -EINVAL;
 err1:
+	rc = -errno;
 	DBG(GPT, ul_debug("...write failed: %m"));
-	return -errno;
+	/* the arrays on disk are in unknown state now */
+	gpt_remember_disk_entries(gpt, NULL, NULL);
+	return rc;
 }
 
 /*
@@ -3208,10 +3309,15 @@ static void gpt_deinit(struct fdisk_label *lb)
 	free(gpt->ents);
 	free(gpt->pheader);
 	free(gpt->bheader);
+	free(gpt->disk_ents);
 
 	gpt->ents = NULL;
 	gpt->pheader = NULL;
 	gpt->bheader = NULL;
+	gpt->disk_ents = NULL;
+	gpt->disk_entsz = 0;
+	gpt->disk_pents_lba = 0;
+	gpt->disk_bents_lba = 0;
 }
 
 static const struct fdisk_label_operations gpt_operations =
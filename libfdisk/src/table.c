@@ -61,6 +61,158 @@ int fdisk_reset_table(struct fdisk_table *tb)
 	return 0;
 }
 
+/*
+ * The index is an array of partitions (with defined end) sorted by the last
+ * sector. It's used to quickly find the place for a new freespace entry in
+ * tables with many partitions. The index is not persistent -- partitions
+ * may be modified by library users -- it's created and removed by
+ * fdisk_get_freespaces() and updated when the table is modified.
+ */
+static void table_index_free(struct fdisk_table *tb)
+{
+	free(tb->byend);
+	tb->byend = NULL;
+	tb->nbyend = tb->byend_max = 0;
+}
+
+/* returns number of partitions in the index with end < @sector */
+static size_t table_index_count_before(struct fdisk_table *tb, fdisk_sector_t sector)
+{
+	size_t lo = 0, hi = tb->nbyend;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (fdisk_partition_get_end(tb->byend[mid]) < sector)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int table_index_add(struct fdisk_table *tb, struct fdisk_partition *pa)
+{
+	size_t i;
+
+	if (!tb->byend || !fdisk_partition_has_end(pa))
+		return 0;
+
+	if (tb->nbyend == tb->byend_max) {
+		size_t sz = tb->byend_max * 2;
+		struct fdisk_partition **x = reallocarray(tb->byend, sz, sizeof(*x));
+
+		if (!x) {
+			table_index_free(tb);
+			return -ENOMEM;
+		}
+		tb->byend = x;
+		tb->byend_max = sz;
+	}
+
+	i = table_index_count_before(tb, fdisk_partition_get_end(pa) + 1);
+	memmove(&tb->byend[i + 1], &tb->byend[i],
+			(tb->nbyend - i) * sizeof(*tb->byend));
+	tb->byend[i] = pa;
+	tb->nbyend++;
+	return 0;
+}
+
+static void table_index_remove(struct fdisk_table *tb, struct fdisk_partition *pa)
+{
+	size_t i = 0;
+
+	if (!tb->byend)
+		return;
+
+	if (fdisk_partition_has_end(pa))
+		i = table_index_count_before(tb, fdisk_partition_get_end(pa));
+
+	/* the partition may be modified, fallback to the begin of the index */
+	for (; i < tb->nbyend && tb->byend[i] != pa; i++);
+	if (i == tb->nbyend)
+		for (i = 0; i < tb->nbyend && tb->byend[i] != pa; i++);
+	if (i == tb->nbyend)
+		return;
+
+	memmove(&tb->byend[i], &tb->byend[i + 1],
+			(tb->nbyend - i - 1) * sizeof(*tb->byend));
+	tb->nbyend--;
+}
+
+static int cmp_index_ends(const void *a, const void *b)
+{
+	fdisk_sector_t x = fdisk_partition_get_end(*(struct fdisk_partition **) a),
+		       y = fdisk_partition_get_end(*(struct fdisk_partition **) b);
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int table_index_create(struct fdisk_table *tb)
+{
+	struct fdisk_partition *pa;
+	struct fdisk_iter itr;
+
+	table_index_free(tb);
+
+	tb->byend_max = max(tb->nents, (size_t) 32);
+	tb->byend = malloc(tb->byend_max * sizeof(*tb->byend));
+	if (!tb->byend) {
+		tb->byend_max = 0;
+		return -ENOMEM;
+	}
+
+	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
+	while (fdisk_table_next_partition(tb, &itr, &pa) == 0) {
+		if (fdisk_partition_has_end(pa))
+			tb->byend[tb->nbyend++] = pa;
+	}
+	qsort(tb->byend, tb->nbyend, sizeof(*tb->byend), cmp_index_ends);
+
+	DBG(TAB, ul_debugobj(tb, "index created [%zu entries]", tb->nbyend));
+	return 0;
+}
+
+/*
+ * Returns the first partition (in table order) with the highest end before
+ * @sector, or NULL.
+ */
+static struct fdisk_partition *table_index_find_before(
+			struct fdisk_table *tb, fdisk_sector_t sector)
+{
+	struct fdisk_partition *pa;
+	struct fdisk_iter itr;
+	fdisk_sector_t end;
+	size_t i, first;
+
+	i = table_index_count_before(tb, sector);
+	if (!i)
+		return NULL;
+
+	end = fdisk_partition_get_end(tb->byend[i - 1]);
+	for (first = i - 1; first > 0; first--) {
+		if (fdisk_partition_get_end(tb->byend[first - 1]) != end)
+			break;
+	}
+	if (first == i - 1)
+		return tb->byend[first];
+
+	/* more partitions with the same end (e.g. container and the last
+	 * logical partition), use the first in the table */
+	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
+	while (fdisk_table_next_partition(tb, &itr, &pa) == 0) {
+		size_t x;
+
+		if (!fdisk_partition_has_end(pa) || fdisk_partition_get_end(pa) != end)
+			continue;
+		for (x = first; x < i; x++) {
+			if (tb->byend[x] == pa)
+				return pa;
+		}
+	}
+	return NULL;
+}
+
 /**
  * fdisk_ref_table:
  * @tb: table pointer
@@ -88,6 +240,7 @@ void fdisk_unref_table(struct fdisk_table *tb)
 	tb->refcount--;
 	if (tb->refcount <= 0) {
 		fdisk_reset_table(tb);
+		table_index_free(tb);
 
 		DBG(TAB, ul_debugobj(tb, "free"));
 		free(tb);
@@ -231,6 +384,7 @@ int fdisk_table_add_partition(struct fdisk_table *tb, struct fdisk_partition *pa
 	fdisk_ref_partition(pa);
 	list_add_tail(&pa->parts, &tb->parts);
 	tb->nents++;
+	table_index_add(tb, pa);
 
 	DBG(TAB, ul_debugobj(tb, "add entry %p [start=%ju, end=%ju, size=%ju, %s %s %s]",
 			pa,
@@ -258,6 +412,7 @@ static int table_insert_partition(
 	else
 		list_add(&pa->parts, &tb->parts);
 	tb->nents++;
+	table_index_add(tb, pa);
 
 	DBG(TAB, ul_debugobj(tb, "insert entry %p pre=%p [start=%ju, end=%ju, size=%ju, %s %s %s]",
 			pa, poz ? poz : NULL,
@@ -290,6 +445,7 @@ int fdisk_table_remove_partition(struct fdisk_table *tb, struct fdisk_partition
 	DBG(TAB, ul_debugobj(tb, "remove entry %p", pa));
 	list_del(&pa->parts);
 	INIT_LIST_HEAD(&pa->parts);
+	table_index_remove(tb, pa);
 
 	fdisk_unref_partition(pa);
 	tb->nents--;
@@ -481,7 +637,11 @@ static int table_add_freespace(
 		}
 	}
 
-	while (fdisk_table_next_partition(tb, &itr, &x) == 0) {
+	/* the index does not care about parent, use it for primary freespace only */
+	if (tb->byend && !parent)
+		best = table_index_find_before(tb, pa->start);
+
+	else while (fdisk_table_next_partition(tb, &itr, &x) == 0) {
 		fdisk_sector_t the_end, best_end = 0;
 
 		if (!fdisk_partition_has_end(x))
@@ -601,6 +761,9 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 	if (rc)
 		goto done;
 
+	/* optional, fallback to table walking on ENOMEM */
+	table_index_create(*tb);
+
 	fdisk_table_sort_partitions(parts, fdisk_partition_cmp_start);
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
 	last = cxt->first_lba;
@@ -660,6 +823,8 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 	}
 
 done:
+	if (*tb)
+		table_index_free(*tb);
 	fdisk_unref_table(parts);
 
 	DBG(CXT, ul_debugobj(cxt, "get freespace DONE [rc=%d]", rc));
@@ -1,9 +1,17 @@
+#include <sys/ioctl.h>
+#include <inttypes.h>
+
 #include "c.h"
 #include "strutils.h"
+#include "blkdev.h"
+#include "all-io.h"
 
 #ifdef HAVE_LIBBLKID
 # include <blkid.h>
 #endif
+#ifdef HAVE_LINUX_BLKZONED_H
+# include <linux/blkzoned.h>
+#endif
 
 #include "fdiskP.h"
 
@@ -104,11 +112,211 @@ int fdisk_do_wipe(struct fdisk_context *cxt __attribute__((__unused__)))
 	return 0;
 }
 #else
+/* byte range on the device */
+struct wipe_range {
+	uint64_t	off;
+	uint64_t	len;
+};
+
+struct wipe_ranges {
+	struct wipe_range	*items;
+	size_t			nitems;
+};
+
+static int add_wipe_range(struct wipe_ranges *rs, uint64_t off, uint64_t len)
+{
+	struct wipe_range *r;
+
+	r = reallocarray(rs->items, rs->nitems + 1, sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	rs->items = r;
+	r = &rs->items[rs->nitems++];
+	r->off = off;
+	r->len = len;
+	return 0;
+}
+
+static int cmp_wipe_ranges(const void *a, const void *b)
+{
+	const struct wipe_range *ra = a, *rb = b;
+
+	if (ra->off != rb->off)
+		return ra->off < rb->off ? -1 : 1;
+	if (ra->len != rb->len)
+		return ra->len > rb->len ? -1 : 1;	/* larger first */
+	return 0;
+}
+
+/* sort and merge overlapping and adjacent ranges */
+static void merge_wipe_ranges(struct wipe_ranges *rs)
+{
+	size_t i, n = 0;
+
+	if (!rs->nitems)
+		return;
+
+	qsort(rs->items, rs->nitems, sizeof(struct wipe_range), cmp_wipe_ranges);
+
+	for (i = 0; i < rs->nitems; i++) {
+		struct wipe_range *r = &rs->items[i];
+		struct wipe_range *last = n ? &rs->items[n - 1] : NULL;
+
+		if (last && r->off <= last->off + last->len) {
+			if (r->off + r->len > last->off + last->len)
+				last->len = r->off + r->len - last->off;
+			continue;
+		}
+		rs->items[n++] = *r;
+	}
+	rs->nitems = n;
+}
+
+static int is_in_wipe_ranges(struct wipe_ranges *rs, uint64_t off, uint64_t len)
+{
+	size_t i;
+
+	for (i = 0; i < rs->nitems; i++) {
+		if (off >= rs->items[i].off
+		    && off + len <= rs->items[i].off + rs->items[i].len)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Clean the whole range by BLKDISCARD (only if the device returns zeros for
+ * the discarded blocks) or BLKZEROOUT.
+ *
+ * Returns: 0 on success, 1 if not possible.
+ */
+static int wipe_whole_range(struct fdisk_context *cxt, uint64_t off, uint64_t len)
+{
+	uint64_t range[2] = { off, len };
+
+	if (cxt->wipe_method == FDISK_WIPEMETHOD_SIGNATURES
+	    || !S_ISBLK(cxt->dev_st.st_mode) || !len)
+		return 1;
+
+	if (cxt->wipe_method == FDISK_WIPEMETHOD_DISCARD) {
+		unsigned int zeroes = 0;
+
+		if (ioctl(cxt->dev_fd, BLKDISCARDZEROES, &zeroes) == 0 && zeroes
+		    && ioctl(cxt->dev_fd, BLKDISCARD, &range) == 0) {
+			DBG(WIPE, ul_debug("discarded [offset=%ju, size=%ju]",
+					(uintmax_t) off, (uintmax_t) len));
+			return 0;
+		}
+	}
+	if (ioctl(cxt->dev_fd, BLKZEROOUT, &range) == 0) {
+		DBG(WIPE, ul_debug("zeroed out [offset=%ju, size=%ju]",
+					(uintmax_t) off, (uintmax_t) len));
+		return 0;
+	}
+
+	DBG(WIPE, ul_debug("cannot clean whole range, fallback to signatures"));
+	return 1;
+}
+
+static int write_wipe_ranges(struct fdisk_context *cxt, struct wipe_ranges *rs)
+{
+	char buf[BUFSIZ] = { 0 };
+	size_t i;
+
+	for (i = 0; i < rs->nitems; i++) {
+		uint64_t off = rs->items[i].off, len = rs->items[i].len;
+
+		DBG(WIPE, ul_debug("zeroize [offset=%ju, size=%ju]",
+					(uintmax_t) off, (uintmax_t) len));
+
+		if (lseek(cxt->dev_fd, off, SEEK_SET) == (off_t) -1)
+			return -errno;
+		while (len) {
+			size_t sz = min(len, (uint64_t) sizeof(buf));
+
+			if (write_all(cxt->dev_fd, buf, sz))
+				return -errno;
+			len -= sz;
+		}
+	}
+
+	if (rs->nitems && fsync(cxt->dev_fd) != 0)
+		return -errno;
+	return 0;
+}
+
+static int is_zoned(struct fdisk_context *cxt __attribute__((__unused__)))
+{
+#ifdef HAVE_LINUX_BLKZONED_H
+	uint32_t zone_size = 0;
+
+	if (S_ISBLK(cxt->dev_st.st_mode)
+	    && ioctl(cxt->dev_fd, BLKGETZONESZ, &zone_size) == 0 && zone_size)
+		return 1;
+#endif
+	return 0;
+}
+
+/*
+ * Probe the area and add the found signatures (PT/filesystem/RAID magic
+ * strings) to @rs. The signatures are hidden in the libblkid buffers only, so
+ * the area is read once, and the device is modified later by one set of
+ * merged writes for all the areas.
+ */
+static int collect_signatures(struct fdisk_context *cxt, blkid_probe pr,
+			      struct wipe_range *area, struct wipe_ranges *rs)
+{
+	int rc;
+
+	rc = blkid_probe_set_device(pr, cxt->dev_fd, area->off, area->len);
+	if (rc) {
+		DBG(WIPE, ul_debug("blkid_probe_set_device() failed [rc=%d]", rc));
+		return rc;
+	}
+
+	blkid_probe_enable_superblocks(pr, 1);
+	blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_MAGIC |
+			BLKID_SUBLKS_BADCSUM);
+	blkid_probe_enable_partitions(pr, 1);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC |
+			BLKID_PARTS_FORCE_GPT);
+
+	while (blkid_do_probe(pr) == 0) {
+		const char *off = NULL;
+		size_t len = 0;
+		uint64_t magoff;
+
+		if (blkid_probe_lookup_value(pr, "SBMAGIC_OFFSET", &off, NULL) == 0)
+			blkid_probe_lookup_value(pr, "SBMAGIC", NULL, &len);
+		else if (blkid_probe_lookup_value(pr, "PTMAGIC_OFFSET", &off, NULL) == 0)
+			blkid_probe_lookup_value(pr, "PTMAGIC", NULL, &len);
+
+		if (off && len) {
+			errno = 0;
+			magoff = strtoumax(off, NULL, 10);
+			if (!errno) {
+				DBG(WIPE, ul_debug(" signature [offset=%ju, size=%zu]",
+					(uintmax_t) (area->off + magoff), len));
+				rc = add_wipe_range(rs, area->off + magoff, len);
+				if (rc)
+					return rc;
+			}
+		}
+
+		/* wipe in memory only and probe again */
+		if (blkid_do_wipe(pr, 1) != 0)
+			break;
+	}
+	return 0;
+}
+
 int fdisk_do_wipe(struct fdisk_context *cxt)
 {
+	struct wipe_ranges areas = { 0 }, cleaned = { 0 }, sigs = { 0 };
 	struct list_head *p;
 	blkid_probe pr;
-	int rc;
+	size_t i;
+	int rc = 0, zoned;
 
 	assert(cxt);
 	assert(cxt->dev_fd >= 0);
@@ -122,28 +330,60 @@ int fdisk_do_wipe(struct fdisk_context *cxt)
 
 	list_for_each(p, &cxt->wipes) {
 		struct fdisk_wipe *wp = list_entry(p, struct fdisk_wipe, wipes);
-		blkid_loff_t start = (blkid_loff_t) wp->start * cxt->sector_size,
-			     size = (blkid_loff_t) wp->size * cxt->sector_size;
 
-		DBG(WIPE, ul_debugobj(wp, "initialize libblkid prober [start=%ju, size=%ju]",
-                                            (uintmax_t) start, (uintmax_t) size));
+		rc = add_wipe_range(&areas, wp->start * cxt->sector_size,
+					    wp->size * cxt->sector_size);
+		if (rc)
+			goto done;
+	}
+
+	/* larger areas first for the same offset, the nested areas are skipped
+	 * if already cleaned */
+	qsort(areas.items, areas.nitems, sizeof(struct wipe_range), cmp_wipe_ranges);
+	zoned = is_zoned(cxt);
+
+	for (i = 0; i < areas.nitems; i++) {
+		struct wipe_range *area = &areas.items[i];
+
+		if (is_in_wipe_ranges(&cleaned, area->off, area->len))
+			continue;
+
+		/* the zones are reset by libblkid */
+		if (zoned) {
+			DBG(WIPE, ul_debug("wiping zoned [start=%ju, size=%ju]",
+				(uintmax_t) area->off, (uintmax_t) area->len));
+			rc = blkid_probe_set_device(pr, cxt->dev_fd, area->off, area->len);
+			if (rc)
+				goto done;
+			blkid_wipe_all(pr);
+			continue;
+		}
 
-		rc = blkid_probe_set_device(pr, cxt->dev_fd, start, size);
-		if (rc) {
-			DBG(WIPE, ul_debugobj(wp, "blkid_probe_set_device() failed [rc=%d]", rc));
-			return rc;
+		if (wipe_whole_range(cxt, area->off, area->len) == 0) {
+			rc = add_wipe_range(&cleaned, area->off, area->len);
+			if (rc)
+				goto done;
+			continue;
 		}
 
-		DBG(WIPE, ul_debugobj(wp, " wiping..."));
-		blkid_wipe_all(pr);
+		DBG(WIPE, ul_debug("probing [start=%ju, size=%ju]",
+			(uintmax_t) area->off, (uintmax_t) area->len));
+		rc = collect_signatures(cxt, pr, area, &sigs);
+		if (rc)
+			goto done;
 	}
 
+	merge_wipe_ranges(&sigs);
+	rc = write_wipe_ranges(cxt, &sigs);
+done:
+	free(areas.items);
+	free(cleaned.items);
+	free(sigs.items);
 	blkid_free_probe(pr);
-	return 0;
+	return rc;
 }
 #endif
 
-
 /*
  * Please don't call this function if there is already a PT.
  *
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sqlite3.h>
 #include <lastlog.h>
@@ -39,11 +40,14 @@
 #include "lastlog2P.h"
 #include "strutils.h"
 
+/* How long to wait for a lock held by another process (in milliseconds) */
+#define LL2_BUSY_TIMEOUT	5000
+
 /* Set the ll2 context/environment */
 /* Returns the context or NULL if an error has happened. */
 extern struct ll2_context * ll2_new_context(const char *db_path)
 {
-	struct ll2_context *context = (struct ll2_context *)malloc(sizeof(struct ll2_context));
+	struct ll2_context *context = (struct ll2_context *)calloc(1, sizeof(struct ll2_context));
 
 	if (context) {
 		if (db_path) {
@@ -61,11 +65,30 @@ extern struct ll2_context * ll2_new_context(const char *db_path)
 	return context;
 }
 
+/* Close the cached database connection and its statements */
+static void close_context_db(struct ll2_context *context)
+{
+	size_t i;
+
+	for (i = 0; i < LL2_NSTMTS; i++) {
+		if (context->stmts[i])
+			sqlite3_finalize(context->stmts[i]);
+		context->stmts[i] = NULL;
+	}
+	if (context->db)
+		sqlite3_close(context->db);
+	context->db = NULL;
+	context->db_rw = 0;
+	context->has_table = 0;
+}
+
 /* Release ll2 context/environment */
 extern void ll2_unref_context(struct ll2_context *context)
 {
-	if (context)
+	if (context) {
+		close_context_db(context);
 		free(context->lastlog2_path);
+	}
 	free(context);
 }
 
@@ -115,10 +138,98 @@ open_database_rw(struct ll2_context *context,  sqlite3 **db, char **error)
 	return ret;
 }
 
+/* Opens the database, or returns the connection cached in the context.
+   The connection is kept in the context until ll2_unref_context().
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+static int
+open_database(struct ll2_context *context, int rw, sqlite3 **db, char **error)
+{
+	struct stat st;
+	int ret;
+
+	if (context && context->db) {
+		/* the file has been removed or replaced */
+		if (stat(context->lastlog2_path, &st) != 0
+		    || st.st_dev != context->db_dev || st.st_ino != context->db_ino)
+			close_context_db(context);
+		else if (context->db_rw || !rw) {
+			*db = context->db;
+			return 0;
+		} else
+			close_context_db(context);	/* reopen read-write */
+	}
+
+	if (rw)
+		ret = open_database_rw(context, db, error);
+	else
+		ret = open_database_ro(context, db, error);
+	if (ret != 0)
+		return ret;
+
+	/* wait for concurrent sessions rather than fail with SQLITE_BUSY */
+	sqlite3_busy_timeout(*db, LL2_BUSY_TIMEOUT);
+
+	if (context && context->lastlog2_path
+	    && stat(context->lastlog2_path, &st) == 0) {
+		context->db = *db;
+		context->db_dev = st.st_dev;
+		context->db_ino = st.st_ino;
+		context->db_rw = rw ? 1 : 0;
+	}
+	return 0;
+}
+
+/* Closes the database if it is not cached in the context. */
+static void
+close_database(struct ll2_context *context, sqlite3 *db)
+{
+	if (!context || context->db != db)
+		sqlite3_close(db);
+}
+
+/* Returns the prepared statement @id, from the context cache if possible. */
+static int
+prepare_stmt(struct ll2_context *context, sqlite3 *db, int id,
+	     const char *sql, sqlite3_stmt **res)
+{
+	int cached = context && context->db == db;
+	int rc;
+
+	if (cached && context->stmts[id]) {
+		*res = context->stmts[id];
+		return SQLITE_OK;
+	}
+
+	rc = sqlite3_prepare_v2(db, sql, -1, res, 0);
+	if (rc == SQLITE_OK && cached)
+		context->stmts[id] = *res;
+	return rc;
+}
+
+/* Resets the cached statement for the next use, or finalizes the statement. */
+static void
+release_stmt(struct ll2_context *context, sqlite3_stmt *res)
+{
+	size_t i;
+
+	if (!res)
+		return;
+	if (context) {
+		for (i = 0; i < LL2_NSTMTS; i++) {
+			if (context->stmts[i] == res) {
+				sqlite3_reset(res);
+				sqlite3_clear_bindings(res);
+				return;
+			}
+		}
+	}
+	sqlite3_finalize(res);
+}
+
 /* Reads one entry from database and returns that.
    Returns 0 on success, -ENOMEM or -1 on other failure. */
 static int
-read_entry(sqlite3 *db, const char *user,
+read_entry(struct ll2_context *context, sqlite3 *db, const char *user,
 	   int64_t *ll_time, char **tty, char **rhost,
 	   char **pam_service, char **error)
 {
@@ -126,7 +237,7 @@ read_entry(sqlite3 *db, const char *user,
 	sqlite3_stmt *res = NULL;
 	static const char *sql = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 WHERE Name = ?";
 
-	if (sqlite3_prepare_v2(db, sql, -1, &res, 0) != SQLITE_OK) {
+	if (prepare_stmt(context, db, LL2_STMT_READ, sql, &res) != SQLITE_OK) {
 		retval = -1;
 		if (error)
 			if (asprintf(error, "Failed to execute statement: %s",
@@ -200,8 +311,7 @@ read_entry(sqlite3 *db, const char *user,
 	}
 
 out_read_entry:
-	if (res)
-		sqlite3_finalize(res);
+	release_stmt(context, res);
 
 	return retval;
 }
@@ -215,39 +325,44 @@ ll2_read_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_ro(context, &db, error)) != 0)
+	if ((retval = open_database(context, 0, &db, error)) != 0)
 		return retval;
 
-	retval = read_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = read_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	close_database(context, db);
 
 	return retval;
 }
 
 /* Write a new entry. Returns 0 on success, -ENOMEM or -1 on other failure. */
 static int
-write_entry(sqlite3 *db, const char *user,
+write_entry(struct ll2_context *context, sqlite3 *db, const char *user,
 	    int64_t ll_time, const char *tty, const char *rhost,
 	    const char *pam_service, char **error)
 {
 	int retval = 0;
 	char *err_msg = NULL;
 	sqlite3_stmt *res = NULL;
-	static const char *sql_table = "CREATE TABLE IF NOT EXISTS Lastlog2(Name TEXT PRIMARY KEY, Time INTEGER, TTY TEXT, RemoteHost TEXT, Service TEXT);";
+	static const char *sql_table = "CREATE TABLE IF NOT EXISTS Lastlog2(Name TEXT PRIMARY KEY, Time INTEGER, TTY TEXT, RemoteHost TEXT, Service TEXT);"
+				       "CREATE INDEX IF NOT EXISTS Lastlog2_Time ON Lastlog2(Time);";
 	static const char *sql_replace = "REPLACE INTO Lastlog2 VALUES(?,?,?,?,?);";
 
-	if (sqlite3_exec(db, sql_table, 0, 0, &err_msg) != SQLITE_OK) {
-		retval = -1;
-		if (error)
-			if (asprintf(error, "SQL error: %s", err_msg) < 0)
-				retval = -ENOMEM;
+	if (!(context && context->db == db && context->has_table)) {
+		if (sqlite3_exec(db, sql_table, 0, 0, &err_msg) != SQLITE_OK) {
+			retval = -1;
+			if (error)
+				if (asprintf(error, "SQL error: %s", err_msg) < 0)
+					retval = -ENOMEM;
 
-		sqlite3_free(err_msg);
-		goto out_ll2_read_entry;
+			sqlite3_free(err_msg);
+			goto out_ll2_read_entry;
+		}
+		if (context && context->db == db)
+			context->has_table = 1;
 	}
 
-	if (sqlite3_prepare_v2(db, sql_replace, -1, &res, 0) != SQLITE_OK) {
+	if (prepare_stmt(context, db, LL2_STMT_WRITE, sql_replace, &res) != SQLITE_OK) {
 		retval = -1;
 		if (error)
 			if (asprintf(error, "Failed to execute statement: %s",
@@ -318,8 +433,7 @@ write_entry(sqlite3 *db, const char *user,
 		}
 	}
 out_ll2_read_entry:
-	if (res)
-		sqlite3_finalize(res);
+	release_stmt(context, res);
 
 	return retval;
 }
@@ -333,12 +447,12 @@ ll2_write_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = open_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	retval = write_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = write_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	close_database(context, db);
 
 	return retval;
 }
@@ -355,17 +469,17 @@ ll2_update_login_time(struct ll2_context *context, const char *user,
 	char *rhost;
 	char *pam_service;
 
-	if ((retval = open_database_rw(context , &db, error)) != 0)
+	if ((retval = open_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	if ((retval = read_entry(db, user, 0, &tty, &rhost, &pam_service, error)) != 0) {
-		sqlite3_close(db);
+	if ((retval = read_entry(context, db, user, 0, &tty, &rhost, &pam_service, error)) != 0) {
+		close_database(context, db);
 		return retval;
 	}
 
-	retval = write_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = write_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	close_database(context, db);
 
 	free(tty);
 	free(rhost);
@@ -412,7 +526,7 @@ ll2_read_all(struct ll2_context *context,
 	char *err_msg = 0;
 	int retval = 0;
 
-	if ((retval = open_database_ro(context, &db, error)) != 0)
+	if ((retval = open_database(context, 0, &db, error)) != 0)
 		return retval;
 
 	static const char *sql = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 ORDER BY Name ASC";
@@ -426,7 +540,72 @@ ll2_read_all(struct ll2_context *context,
 		sqlite3_free(err_msg);
 	}
 
-	sqlite3_close(db);
+	close_database(context, db);
+
+	return retval;
+}
+
+/* Reads entries with login time in the range @from..@to and calls the
+   callback function for each entry. Returns 0 on success, -ENOMEM or -1
+   on other failure. */
+int
+ll2_read_range(struct ll2_context *context, int64_t from, int64_t to,
+	       int (*cb_func)(const char *user, int64_t ll_time,
+			      const char *tty, const char *rhost,
+			      const char *pam_service, const char *cb_error),
+	       char **error)
+{
+	sqlite3 *db;
+	sqlite3_stmt *res = NULL;
+	int retval = 0, step;
+	static const char *sql = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 WHERE Time BETWEEN ? AND ? ORDER BY Name ASC";
+
+	if ((retval = open_database(context, 0, &db, error)) != 0)
+		return retval;
+
+	if (sqlite3_prepare_v2(db, sql, -1, &res, 0) != SQLITE_OK) {
+		retval = -1;
+		if (error)
+			if (asprintf(error, "Failed to execute statement: %s",
+				     sqlite3_errmsg(db)) < 0)
+				retval = -ENOMEM;
+		goto out_read_range;
+	}
+
+	if (sqlite3_bind_int64(res, 1, from) != SQLITE_OK ||
+	    sqlite3_bind_int64(res, 2, to) != SQLITE_OK) {
+		retval = -1;
+		if (error)
+			if (asprintf(error, "Failed to create search query: %s",
+				     sqlite3_errmsg(db)) < 0)
+				retval = -ENOMEM;
+		goto out_read_range;
+	}
+
+	while ((step = sqlite3_step(res)) == SQLITE_ROW) {
+		char *argv[5];
+		int i;
+
+		for (i = 0; i < 5; i++)
+			argv[i] = (char *) sqlite3_column_text(res, i);
+
+		if (callback(cb_func, 5, argv, NULL) != 0) {
+			retval = -ENOMEM;
+			goto out_read_range;
+		}
+	}
+
+	if (step != SQLITE_DONE) {
+		retval = -1;
+		if (error)
+			if (asprintf (error, "Error stepping through database: %s", sqlite3_errmsg (db)) < 0)
+				retval = -ENOMEM;
+	}
+
+out_read_range:
+	if (res)
+		sqlite3_finalize(res);
+	close_database(context, db);
 
 	return retval;
 }
@@ -488,12 +667,12 @@ ll2_remove_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = open_database(context, 1, &db, error)) != 0)
 		return retval;
 
 	retval = remove_entry(db, user, error);
 
-	sqlite3_close(db);
+	close_database(context, db);
 
 	return retval;
 }
@@ -510,16 +689,16 @@ ll2_rename_user(struct ll2_context *context, const char *user,
 	char *pam_service;
 	int retval;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = open_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	if ((retval = read_entry(db, user, &ll_time, &tty, &rhost, &pam_service, error) != 0)) {
-		sqlite3_close(db);
+	if ((retval = read_entry(context, db, user, &ll_time, &tty, &rhost, &pam_service, error) != 0)) {
+		close_database(context, db);
 		return retval;
 	}
 
-	if ((retval = write_entry(db, newname, ll_time, tty, rhost, pam_service, error) != 0)) {
-		sqlite3_close(db);
+	if ((retval = write_entry(context, db, newname, ll_time, tty, rhost, pam_service, error) != 0)) {
+		close_database(context, db);
 		free(tty);
 		free(rhost);
 		return retval;
@@ -527,7 +706,7 @@ ll2_rename_user(struct ll2_context *context, const char *user,
 
 	retval = remove_entry(db, user, error);
 
-	sqlite3_close(db);
+	close_database(context, db);
 
 	free(tty);
 	free(rhost);
@@ -536,7 +715,99 @@ ll2_rename_user(struct ll2_context *context, const char *user,
 	return retval;
 }
 
-/* Import old lastlog file.
+/* Number of imported entries committed by one transaction */
+#define LL2_IMPORT_CHUNK	1024
+
+/* Data ranges of the sparse lastlog file */
+struct ll2_extent {
+	off_t start;
+	off_t end;
+};
+
+/* Returns the number of data ranges in @fd, or -ENOMEM. If the file system
+   does not support SEEK_DATA/SEEK_HOLE, the whole file is one range. */
+static ssize_t
+get_data_extents(int fd, off_t size, struct ll2_extent **extents)
+{
+	struct ll2_extent *ext = NULL;
+	size_t n = 0, alloc = 0;
+	off_t pos = 0;
+
+	while (pos < size) {
+		off_t start = pos, end = size;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+		off_t data = lseek(fd, pos, SEEK_DATA);
+
+		if (data < 0 && errno == ENXIO)
+			break;			/* no more data */
+		if (data >= 0) {
+			start = data;
+			end = lseek(fd, data, SEEK_HOLE);
+			if (end < 0 || end > size)
+				end = size;
+		}
+		/* else unsupported, the rest of the file is one range */
+#endif
+		if (n == alloc) {
+			struct ll2_extent *tmp;
+
+			alloc = alloc ? alloc * 2 : 16;
+			tmp = realloc(ext, alloc * sizeof(*ext));
+			if (!tmp) {
+				free(ext);
+				return -ENOMEM;
+			}
+			ext = tmp;
+		}
+		ext[n].start = start;
+		ext[n].end = end;
+		n++;
+		pos = end;
+	}
+
+	*extents = ext;
+	return n;
+}
+
+/* Returns 1 if the range @offset..@offset+@len overlaps data in the file. */
+static int
+has_data(const struct ll2_extent *ext, size_t n, off_t offset, off_t len)
+{
+	size_t lo = 0, hi = n;
+
+	while (lo < hi) {
+		size_t i = (lo + hi) / 2;
+
+		if (offset + len <= ext[i].start)
+			hi = i;
+		else if (offset >= ext[i].end)
+			lo = i + 1;
+		else
+			return 1;
+	}
+	return 0;
+}
+
+/* Executes transaction control statement @sql.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+static int
+exec_transaction(sqlite3 *db, const char *sql, char **error)
+{
+	char *err_msg = NULL;
+	int retval = 0;
+
+	if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
+		retval = -1;
+		if (error)
+			if (asprintf(error, "SQL error: %s", err_msg) < 0)
+				retval = -ENOMEM;
+		sqlite3_free(err_msg);
+	}
+	return retval;
+}
+
+/* Import old lastlog file. The entries are written in transactions of
+   LL2_IMPORT_CHUNK entries, so the database is not synced for every entry.
    Returns 0 on success, -ENOMEM or -1 on other failure. */
 int
 ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
@@ -544,20 +815,29 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 {
 	const struct passwd *pw;
 	struct stat statll;
+	struct ll2_context tmp_context = { .lastlog2_path = (char *) LL2_DEFAULT_DATABASE };
+	struct ll2_extent *extents = NULL;
+	ssize_t nextents;
+	size_t count = 0;
 	sqlite3 *db;
 	FILE *ll_fp;
-	int retval = 0;
+	int retval = 0, rc;
+
+	/* keep the prepared statements for the whole import */
+	if (!context)
+		context = &tmp_context;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = open_database(context, 1, &db, error)) != 0)
 		return retval;
 
 	ll_fp = fopen(lastlog_file, "r");
 	if (ll_fp == NULL) {
 		if (error && asprintf(error, "Failed to open '%s': %s",
 				     lastlog_file, strerror(errno)) < 0)
-			return -ENOMEM;
-
-		return -1;
+			retval = -ENOMEM;
+		else
+			retval = -1;
+		goto out_close;
 	}
 
 
@@ -570,6 +850,15 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 		goto done;
 	}
 
+	nextents = get_data_extents(fileno(ll_fp), statll.st_size, &extents);
+	if (nextents < 0) {
+		retval = nextents;
+		goto done;
+	}
+
+	if ((retval = exec_transaction(db, "BEGIN", error)) != 0)
+		goto done;
+
 	setpwent();
 	while ((pw = getpwent()) != NULL ) {
 		off_t offset;
@@ -578,6 +867,9 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 		offset = (off_t) pw->pw_uid * sizeof (ll);
 
 		if ((offset + (off_t)sizeof(ll)) <= statll.st_size) {
+			if (!has_data(extents, nextents, offset, sizeof(ll)))
+				continue; /* hole, never logged in */
+
 			if (fseeko(ll_fp, offset, SEEK_SET) == -1)
 				continue; /* Ignore seek error */
 
@@ -599,17 +891,31 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 				mem2strcpy(tty, ll.ll_line, sizeof(ll.ll_line), sizeof(tty));
 				mem2strcpy(rhost, ll.ll_host, sizeof(ll.ll_host), sizeof(rhost));
 
-				if ((retval = write_entry(db, pw->pw_name, ll_time, tty,
+				if ((retval = write_entry(context, db, pw->pw_name, ll_time, tty,
 							  rhost, NULL, error)) != 0)
 					goto out_import_lastlog;
+
+				if (++count % LL2_IMPORT_CHUNK == 0) {
+					if ((retval = exec_transaction(db, "COMMIT", error)) != 0 ||
+					    (retval = exec_transaction(db, "BEGIN", error)) != 0)
+						goto out_import_lastlog;
+				}
 			}
 		}
 	}
 out_import_lastlog:
 	endpwent();
-	sqlite3_close(db);
+	/* keep the already imported entries, as without transactions */
+	rc = exec_transaction(db, "COMMIT", retval == 0 ? error : NULL);
+	if (retval == 0)
+		retval = rc;
 done:
 	fclose(ll_fp);
+	free(extents);
+out_close:
+	close_database(context, db);
+	if (context == &tmp_context)
+		close_context_db(context);
 
 	return retval;
 }
@@ -58,6 +58,15 @@ extern int ll2_read_all (struct ll2_context *context,
 					 const char *pam_service, const char *cb_error),
 			 char **error);
 
+/* Calling a defined function for each entry with login time in the range
+   from..to. Returns 0 on success, -ENOMEM or -1 on other failure. */
+extern int ll2_read_range (struct ll2_context *context,
+			   int64_t from, int64_t to,
+			   int (*callback)(const char *user, int64_t ll_time,
+					   const char *tty, const char *rhost,
+					   const char *pam_service, const char *cb_error),
+			   char **error);
+
 /* Reads one entry from database and returns that.
    Returns 0 on success, -ENOMEM or -1 on other failure. */
 extern int ll2_read_entry (struct ll2_context *context, const char *user,
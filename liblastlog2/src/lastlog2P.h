@@ -28,10 +28,30 @@
 #ifndef _LIBLASTLOG2_P_H
 #define _LIBLASTLOG2_P_H
 
+#include <sys/types.h>
+
 #include "lastlog2.h"
 
+struct sqlite3;
+struct sqlite3_stmt;
+
+/* prepared statements cached in the context */
+enum {
+	LL2_STMT_READ = 0,
+	LL2_STMT_WRITE,
+
+	LL2_NSTMTS
+};
+
 struct ll2_context {
     char *lastlog2_path;
+
+    struct sqlite3 *db;			/* cached database connection */
+    struct sqlite3_stmt *stmts[LL2_NSTMTS];	/* cached statements for @db */
+    dev_t db_dev;			/* @db file identity */
+    ino_t db_ino;
+    unsigned int db_rw : 1,		/* @db opened read-write */
+		 has_table : 1;		/* Lastlog2 table exists in @db */
 };
 
 #endif /* _LIBLASTLOG2_P_H */
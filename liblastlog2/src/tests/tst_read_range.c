@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-2-Clause
+
+  Copyright (c) 2024, Thorsten Kukuk <kukuk@suse.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Test case:
+   Create entries with different login times, read a time range via
+   ll2_read_range and make sure only the entries in the range are
+   returned.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lastlog2.h"
+
+static const struct {
+	const char *user;
+	int64_t ll_time;
+} entries[] = {
+	{ "never", 0 },
+	{ "old", 1000 },
+	{ "middle", 2000 },
+	{ "new", 3000 },
+};
+
+static int found;
+
+static int
+check_range (const char *res_user, int64_t ll_time,
+	     const char *res_tty __attribute__((unused)),
+	     const char *res_rhost __attribute__((unused)),
+	     const char *res_service __attribute__((unused)),
+	     const char *error)
+{
+	size_t i;
+
+	if (error != NULL) {
+		fprintf (stderr, "got error: %s\n", error);
+		exit (1);
+	}
+
+	for (i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+		if (strcmp (entries[i].user, res_user) == 0)
+			break;
+	}
+	if (i == sizeof(entries) / sizeof(entries[0]) ||
+	    entries[i].ll_time != ll_time) {
+		fprintf (stderr, "unexpected entry: %s %lld\n",
+			 res_user, (long long int)ll_time);
+		exit (1);
+	}
+
+	found |= 1 << i;
+	return 0;
+}
+
+static int
+test_range (struct ll2_context *context, int64_t from, int64_t to, int expected)
+{
+	char *error = NULL;
+
+	found = 0;
+	if (ll2_read_range (context, from, to, check_range, &error) != 0) {
+		if (error) {
+			fprintf (stderr, "%s\n", error);
+			free (error);
+		} else
+			fprintf (stderr, "ll2_read_range failed\n");
+		return 1;
+	}
+
+	if (found != expected) {
+		fprintf (stderr, "range %lld..%lld: got entries 0x%x, expected 0x%x\n",
+			 (long long int)from, (long long int)to, found, expected);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	struct ll2_context *context = ll2_new_context("tst-read-range.db");
+	char *error = NULL;
+	size_t i;
+
+	remove ("tst-read-range.db");
+
+	for (i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+		if (ll2_write_entry (context, entries[i].user, entries[i].ll_time,
+				     "test-tty", "localhost", "sshd", &error) != 0) {
+			if (error) {
+				fprintf (stderr, "%s\n", error);
+				free (error);
+			} else
+				fprintf (stderr, "ll2_write_entry failed\n");
+			ll2_unref_context(context);
+			return 1;
+		}
+	}
+
+	if (test_range (context, INT64_MIN, INT64_MAX, 0xf) ||
+	    test_range (context, INT64_MIN, 1500, 0x3) ||	/* -b */
+	    test_range (context, 2000, INT64_MAX, 0xc) ||	/* -t */
+	    test_range (context, 1000, 2000, 0x6) ||
+	    test_range (context, 0, 0, 0x1) ||
+	    test_range (context, 4000, INT64_MAX, 0)) {
+		ll2_unref_context(context);
+		return 1;
+	}
+
+	ll2_unref_context(context);
+	return 0;
+}
@@ -43,12 +43,24 @@
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
 #define MNT_CACHE_TAGREAD	(1 << 3) /* tag read by mnt_cache_read_tags() */
+#define MNT_CACHE_EVICT		(1 << 4) /* to be removed by cache_evict() */
+
+/*
+ * The entries are hashed by key (paths and TAG=value) and the tags also by
+ * value (device name). The hash tables contain index + 1 of the first entry
+ * in the bucket, the next entries are linked by next_key and next_dev.
+ */
+#define MNT_CACHE_HASH_MINSZ	64
 
 /* path cache entry */
 struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+
+	size_t			next_key;	/* next in hash_keys bucket */
+	size_t			next_dev;	/* next in hash_devs bucket */
+	uint64_t		atime;		/* last use, see mnt_cache_set_limit() */
 };
 
 struct libmnt_cache {
@@ -58,6 +70,13 @@ struct libmnt_cache {
 	int			refcount;
 	int			probe_sb_extra;	/* extra BLKID_SUBLKS_* flags */
 
+	size_t			*hash_keys;
+	size_t			*hash_devs;
+	size_t			nhash;
+
+	size_t			limit;		/* max number of entries or zero */
+	uint64_t		ticks;		/* LRU clock */
+
 	/* blkid_evaluate_tag() works in two ways:
 	 *
 	 * 1/ all tags are evaluated by udev /dev/disk/by-* symlinks,
@@ -110,6 +129,8 @@ void mnt_free_cache(struct libmnt_cache *cache)
 		free(e->key);
 	}
 	free(cache->ents);
+	free(cache->hash_keys);
+	free(cache->hash_devs);
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
 	free(cache);
@@ -189,16 +210,211 @@ int mnt_cache_set_sbprobe(struct libmnt_cache *cache, int flags)
 	return 0;
 }
 
+/**
+ * mnt_cache_set_limit:
+ * @cache: cache pointer
+ * @limit: maximal number of entries or zero
+ *
+ * Limits number of the cached paths and tags. The least recently used
+ * entries are removed when the cache is full. The default is no limit; it's
+ * useful for long-lived processes where the cache grows all the time.
+ *
+ * Note that the strings returned by mnt_resolve_path(), mnt_resolve_spec(),
+ * etc. are owned by the cache. If the limit is set, then these strings are
+ * valid only until the next cache update (the next mnt_resolve_* function
+ * call). Don't use the limit for caches used by libmnt_table or
+ * libmnt_context.
+ *
+ * Returns: negative number in case of error, or 0 o success.
+ *
+ * Since: 2.41
+ */
+int mnt_cache_set_limit(struct libmnt_cache *cache, size_t limit)
+{
+	if (!cache)
+		return -EINVAL;
+
+	cache->limit = limit;
+	return 0;
+}
+
+static size_t hash_string(const char *str)
+{
+	size_t h = FNV_INIT;
+
+	for (; *str; str++)
+		h = fnv_add(h, *str);
+	return h;
+}
+
+static size_t hash_tag(const char *token, const char *value)
+{
+	size_t h = FNV_INIT;
+
+	for (; *token; token++)
+		h = fnv_add(h, *token);
+	h = fnv_add(h, '=');
+	for (; *value; value++)
+		h = fnv_add(h, *value);
+	return h;
+}
+
+static void cache_hash_entry(struct libmnt_cache *cache, size_t idx)
+{
+	struct mnt_cache_entry *e = &cache->ents[idx];
+	size_t h;
+
+	if (e->flag & MNT_CACHE_ISPATH)
+		h = mnt_hash_path(e->key);
+	else
+		h = hash_tag(e->key, e->key + strlen(e->key) + 1);
+
+	h %= cache->nhash;
+	e->next_key = cache->hash_keys[h];
+	cache->hash_keys[h] = idx + 1;
+
+	if (e->flag & MNT_CACHE_ISTAG) {
+		h = hash_string(e->value) % cache->nhash;
+		e->next_dev = cache->hash_devs[h];
+		cache->hash_devs[h] = idx + 1;
+	} else
+		e->next_dev = 0;
+}
+
+/* rebuilds the hash tables for the current entries, the size is not changed */
+static void cache_reindex(struct libmnt_cache *cache)
+{
+	size_t i;
+
+	memset(cache->hash_keys, 0, cache->nhash * sizeof(size_t));
+	memset(cache->hash_devs, 0, cache->nhash * sizeof(size_t));
+
+	/* in reverse order, the last added entries are at the end of the buckets */
+	for (i = cache->nents; i > 0; i--)
+		cache_hash_entry(cache, i - 1);
+}
+
+static int cache_rehash(struct libmnt_cache *cache, size_t nhash)
+{
+	size_t *keys, *devs;
+
+	keys = calloc(nhash, sizeof(size_t));
+	devs = calloc(nhash, sizeof(size_t));
+	if (!keys || !devs) {
+		free(keys);
+		free(devs);
+		return -ENOMEM;
+	}
+
+	DBG(CACHE, ul_debugobj(cache, "rehash %zu -> %zu", cache->nhash, nhash));
+
+	free(cache->hash_keys);
+	free(cache->hash_devs);
+	cache->hash_keys = keys;
+	cache->hash_devs = devs;
+	cache->nhash = nhash;
+
+	cache_reindex(cache);
+	return 0;
+}
+
+static inline void cache_touch_entry(struct libmnt_cache *cache,
+				     struct mnt_cache_entry *e)
+{
+	e->atime = ++cache->ticks;
+}
+
+static int cmp_atimes(const void *a, const void *b)
+{
+	uint64_t x = *((const uint64_t *) a), y = *((const uint64_t *) b);
+
+	return x == y ? 0 : x < y ? -1 : 1;
+}
+
+/*
+ * Removes the least recently used half of the entries. The tags read by
+ * mnt_cache_read_tags() are removed for whole device, because the function
+ * does not read the device again if any of the tags is cached.
+ *
+ * The hash tables are rebuilt in place, so nothing can fail after the first
+ * entry is freed and the tables never point to the removed entries.
+ */
+static int cache_evict(struct libmnt_cache *cache)
+{
+	uint64_t *atimes, threshold;
+	size_t i, n;
+
+	atimes = malloc(cache->nents * sizeof(uint64_t));
+	if (!atimes)
+		return -ENOMEM;
+	for (i = 0; i < cache->nents; i++)
+		atimes[i] = cache->ents[i].atime;
+	qsort(atimes, cache->nents, sizeof(uint64_t), cmp_atimes);
+	n = max(cache->nents / 2, (size_t) 1);
+	threshold = atimes[n - 1];
+	free(atimes);
+
+	for (i = 0; i < cache->nents; i++) {
+		struct mnt_cache_entry *e = &cache->ents[i];
+
+		if (e->atime <= threshold)
+			e->flag |= MNT_CACHE_EVICT;
+	}
+
+	for (i = 0; i < cache->nents; i++) {
+		struct mnt_cache_entry *e = &cache->ents[i];
+		size_t x;
+
+		if ((e->flag & (MNT_CACHE_EVICT | MNT_CACHE_TAGREAD))
+				!= (MNT_CACHE_EVICT | MNT_CACHE_TAGREAD))
+			continue;
+
+		x = cache->hash_devs[hash_string(e->value) % cache->nhash];
+		for (; x; x = cache->ents[x - 1].next_dev) {
+			struct mnt_cache_entry *t = &cache->ents[x - 1];
+
+			if ((t->flag & MNT_CACHE_TAGREAD) &&
+			    strcmp(t->value, e->value) == 0)
+				t->flag |= MNT_CACHE_EVICT;
+		}
+	}
+
+	for (i = 0, n = 0; i < cache->nents; i++) {
+		struct mnt_cache_entry *e = &cache->ents[i];
+
+		if (e->flag & MNT_CACHE_EVICT) {
+			if (e->value != e->key)
+				free(e->value);
+			free(e->key);
+			continue;
+		}
+		if (n != i)
+			cache->ents[n] = *e;
+		n++;
+	}
+
+	DBG(CACHE, ul_debugobj(cache, "evicted %zu entries", cache->nents - n));
+	cache->nents = n;
+
+	cache_reindex(cache);
+	return 0;
+}
+
 /* note that the @key could be the same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
 {
 	struct mnt_cache_entry *e;
+	int rehashed = 0;
 
 	assert(cache);
 	assert(value);
 	assert(key);
 
+	if (cache->limit && cache->nents >= cache->limit
+	    && cache_evict(cache))
+		return -ENOMEM;
+
 	if (cache->nents == cache->nallocs) {
 		size_t sz = cache->nallocs + MNT_CACHE_CHUNKSZ;
 
@@ -213,8 +429,22 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	cache_touch_entry(cache, e);
 	cache->nents++;
 
+	if (!cache->hash_keys || cache->nents > cache->nhash * 2) {
+		size_t sz = max((size_t) MNT_CACHE_HASH_MINSZ, cache->nhash * 4);
+
+		if (cache_rehash(cache, sz) == 0)
+			rehashed = 1;		/* including the new entry */
+		else if (!cache->hash_keys) {
+			cache->nents--;
+			return -ENOMEM;
+		}
+	}
+	if (!rehashed)
+		cache_hash_entry(cache, cache->nents - 1);
+
 	DBG(CACHE, ul_debugobj(cache, "add entry [%2zd] (%s): %s: %s",
 			cache->nents,
 			(flag & MNT_CACHE_ISPATH) ? "path" : "tag",
@@ -265,15 +495,18 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 {
 	size_t i;
 
-	if (!cache || !path)
+	if (!cache || !path || !cache->nents)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = cache->hash_keys[mnt_hash_path(path) % cache->nhash];
+	for (; i; i = cache->ents[i - 1].next_key) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISPATH))
 			continue;
-		if (streq_paths(path, e->key))
+		if (streq_paths(path, e->key)) {
+			cache_touch_entry(cache, e);
 			return e->value;
+		}
 	}
 	return NULL;
 }
@@ -287,18 +520,21 @@ static const char *cache_find_tag(struct libmnt_cache *cache,
 	size_t i;
 	size_t tksz;
 
-	if (!cache || !token || !value)
+	if (!cache || !token || !value || !cache->nents)
 		return NULL;
 
 	tksz = strlen(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = cache->hash_keys[hash_tag(token, value) % cache->nhash];
+	for (; i; i = cache->ents[i - 1].next_key) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(token, e->key) == 0 &&
-		    strcmp(value, e->key + tksz + 1) == 0)
+		    strcmp(value, e->key + tksz + 1) == 0) {
+			cache_touch_entry(cache, e);
 			return e->value;
+		}
 	}
 	return NULL;
 }
@@ -312,13 +548,19 @@ static char *cache_find_tag_value(struct libmnt_cache *cache,
 	assert(devname);
 	assert(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	if (!cache->nents)
+		return NULL;
+
+	i = cache->hash_devs[hash_string(devname) % cache->nhash];
+	for (; i; i = cache->ents[i - 1].next_dev) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(e->value, devname) == 0 &&	/* dev name */
-		    strcmp(token, e->key) == 0)	/* tag name */
+		    strcmp(token, e->key) == 0) {	/* tag name */
+			cache_touch_entry(cache, e);
 			return e->key + strlen(token) + 1;	/* tag value */
+		}
 	}
 
 	return NULL;
@@ -348,8 +590,9 @@ int mnt_cache_read_tags(struct libmnt_cache *cache, const char *devname)
 	DBG(CACHE, ul_debugobj(cache, "tags for %s requested", devname));
 
 	/* check if device is already cached */
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = cache->nents ? cache->hash_devs[hash_string(devname) % cache->nhash] : 0;
+	for (; i; i = cache->ents[i - 1].next_dev) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_TAGREAD))
 			continue;
 		if (strcmp(e->value, devname) == 0)
@@ -40,8 +40,10 @@
 #include "strutils.h"
 #include "namespace.h"
 #include "match.h"
+#include "pathnames.h"
 
 #include <sys/wait.h>
+#include <poll.h>
 
 /**
  * mnt_new_context:
@@ -64,6 +66,7 @@ struct libmnt_context *mnt_new_context(void)
 
 	cxt->ns_orig.fd = -1;
 	cxt->ns_tgt.fd = -1;
+	cxt->mountinfo_fd = -1;
 	cxt->ns_cur = &cxt->ns_orig;
 
 	cxt->map_linux = mnt_get_builtin_optmap(MNT_LINUX_MAP);
@@ -71,6 +74,7 @@ struct libmnt_context *mnt_new_context(void)
 
 	INIT_LIST_HEAD(&cxt->hooksets_hooks);
 	INIT_LIST_HEAD(&cxt->hooksets_datas);
+	INIT_LIST_HEAD(&cxt->userns_cache);
 
 	/* if we're really root and aren't running setuid */
 	cxt->restricted = (uid_t) 0 == ruid && ruid == euid ? 0 : 1;
@@ -111,13 +115,58 @@ void mnt_free_context(struct libmnt_context *cxt)
 	mnt_free_update(cxt->update);
 
 	mnt_context_set_target_ns(cxt, NULL);
+	mnt_context_free_userns_cache(cxt);
 
-	free(cxt->children);
+	if (cxt->mountinfo_fd >= 0)
+		close(cxt->mountinfo_fd);
+
+	if (cxt->children) {
+		int i;
+
+		for (i = 0; i < cxt->nchildren; i++)
+			free(cxt->children[i].target);
+		free(cxt->children);
+	}
 
 	DBG(CXT, ul_debugobj(cxt, "free"));
 	free(cxt);
 }
 
+static void context_drop_mountinfo(struct libmnt_context *cxt)
+{
+	mnt_unref_table(cxt->mountinfo);
+	cxt->mountinfo = NULL;
+	cxt->mountinfo_check = 0;
+	cxt->mountinfo_partial = 0;
+
+	if (cxt->mountinfo_fd >= 0) {
+		close(cxt->mountinfo_fd);
+		cxt->mountinfo_fd = -1;
+	}
+}
+
+/*
+ * Updates @saved by the current @path status. Returns 1 if the file has been
+ * modified (or created or removed) since the last call, otherwise returns 0.
+ */
+static int update_file_stat(const char *path, struct stat *saved)
+{
+	struct stat st;
+	int changed;
+
+	if (!path || stat(path, &st) != 0)
+		memset(&st, 0, sizeof(st));
+
+	changed = st.st_dev != saved->st_dev
+		|| st.st_ino != saved->st_ino
+		|| st.st_size != saved->st_size
+		|| st.st_mtim.tv_sec != saved->st_mtim.tv_sec
+		|| st.st_mtim.tv_nsec != saved->st_mtim.tv_nsec;
+
+	*saved = st;
+	return changed;
+}
+
 /**
  * mnt_reset_context:
  * @cxt: mount context
@@ -126,7 +175,8 @@ void mnt_free_context(struct libmnt_context *cxt)
  * the latest mount (spec, source, target, mount options, ...).
  *
  * The match patterns, target namespace, prefix, cached fstab, cached canonicalized
- * paths and tags and [e]uid are not reset. You have to use
+ * paths and tags and [e]uid are not reset. The mountinfo is not reset too if
+ * tables cache is enabled, see mnt_context_enable_tables_cache(). You have to use
  *
  *	mnt_context_set_fstab(cxt, NULL);
  *	mnt_context_set_cache(cxt, NULL);
@@ -151,14 +201,20 @@ int mnt_reset_context(struct libmnt_context *cxt)
 	fl = cxt->flags;
 
 	mnt_unref_fs(cxt->fs);
-	mnt_unref_table(cxt->mountinfo);
 	mnt_unref_table(cxt->utab);
 	mnt_unref_optlist(cxt->optlist);
 
 	free(cxt->helper);
 
+	/* keep complete mountinfo, it's verified on the first use */
+	if (cxt->tables_cache && cxt->mountinfo && !cxt->mountinfo_partial)
+		cxt->mountinfo_check = 1;
+	else
+		context_drop_mountinfo(cxt);
+
+	cxt->fstab_check = cxt->tables_cache && cxt->fstab_parsed;
+
 	cxt->fs = NULL;
-	cxt->mountinfo = NULL;
 	cxt->optlist = NULL;
 	cxt->utab = NULL;
 	cxt->helper = NULL;
@@ -565,7 +621,7 @@ int mnt_context_is_onlyonce(struct libmnt_context *cxt)
  * @enable: TRUE or FALSE
  *
  * Enable/disable fork(2) call in mnt_context_next_mount() (see mount(8) man
- * page, option -F).
+ * page, option -F). See also mnt_context_set_max_children().
  *
  * Returns: 0 on success, negative number in case of error.
  */
@@ -1274,6 +1330,8 @@ int mnt_context_set_fstab(struct libmnt_context *cxt, struct libmnt_table *tb)
 	mnt_unref_table(cxt->fstab);	/* old */
 
 	cxt->fstab = tb;
+	cxt->fstab_parsed = 0;
+	cxt->fstab_check = 0;
 	return 0;
 }
 
@@ -1292,6 +1350,28 @@ int mnt_context_get_fstab(struct libmnt_context *cxt, struct libmnt_table **tb)
 
 	if (!cxt)
 		return -EINVAL;
+
+	/* cached fstab from previous operation */
+	if (cxt->fstab && cxt->fstab_check) {
+		int changed;
+
+		cxt->fstab_check = 0;
+
+		ns_old = mnt_context_switch_target_ns(cxt);
+		if (!ns_old)
+			return -MNT_ERR_NAMESPACE;
+
+		changed = update_file_stat(mnt_get_fstab_path(), &cxt->fstab_st);
+
+		if (!mnt_context_switch_ns(cxt, ns_old))
+			return -MNT_ERR_NAMESPACE;
+		if (changed) {
+			DBG(CXT, ul_debugobj(cxt, "fstab modified, dropping cache"));
+			mnt_unref_table(cxt->fstab);
+			cxt->fstab = NULL;
+		}
+	}
+
 	if (!cxt->fstab) {
 		int rc;
 
@@ -1301,10 +1381,15 @@ int mnt_context_get_fstab(struct libmnt_context *cxt, struct libmnt_table **tb)
 		if (cxt->table_errcb)
 			mnt_table_set_parser_errcb(cxt->fstab, cxt->table_errcb);
 
+		cxt->fstab_parsed = 1;
+
 		ns_old = mnt_context_switch_target_ns(cxt);
 		if (!ns_old)
 			return -MNT_ERR_NAMESPACE;
 
+		if (cxt->tables_cache)
+			update_file_stat(mnt_get_fstab_path(), &cxt->fstab_st);
+
 		mnt_table_set_cache(cxt->fstab, mnt_context_get_cache(cxt));
 		rc = mnt_table_parse_fstab(cxt->fstab, NULL);
 
@@ -1320,6 +1405,27 @@ int mnt_context_get_fstab(struct libmnt_context *cxt, struct libmnt_table **tb)
 	return 0;
 }
 
+/*
+ * Returns 1 if cached mountinfo is not up to date.
+ */
+static int is_mountinfo_modified(struct libmnt_context *cxt)
+{
+	struct pollfd fds = {
+		.fd = cxt->mountinfo_fd,
+		.events = POLLPRI
+	};
+
+	if (cxt->mountinfo_fd < 0)
+		return 1;
+
+	/* the kernel reports POLLPRI (and POLLERR) if mount table modified */
+	if (poll(&fds, 1, 0) < 0 || (fds.revents & (POLLPRI | POLLERR | POLLNVAL)))
+		return 1;
+
+	/* userspace mount options */
+	return update_file_stat(cxt->utab_path, &cxt->utab_st);
+}
+
 int mnt_context_get_mountinfo(struct libmnt_context *cxt, struct libmnt_table **tb)
 {
 	int rc = 0;
@@ -1327,6 +1433,18 @@ int mnt_context_get_mountinfo(struct libmnt_context *cxt, struct libmnt_table **
 
 	if (!cxt)
 		return -EINVAL;
+
+	/* cached mountinfo from previous operation */
+	if (cxt->mountinfo && cxt->mountinfo_check) {
+		cxt->mountinfo_check = 0;
+
+		if (cxt->noautofs || cxt->table_fltrcb
+		    || is_mountinfo_modified(cxt)) {
+			DBG(CXT, ul_debugobj(cxt, "mountinfo modified, dropping cache"));
+			context_drop_mountinfo(cxt);
+		}
+	}
+
 	if (!cxt->mountinfo) {
 		ns_old = mnt_context_switch_target_ns(cxt);
 		if (!ns_old)
@@ -1361,6 +1479,17 @@ int mnt_context_get_mountinfo(struct libmnt_context *cxt, struct libmnt_table **
 				return -MNT_ERR_NAMESPACE;
 		}
 
+		if (cxt->tables_cache) {
+			/* open before parsing, the later changes are reported
+			 * by poll(2) and mountinfo is read again */
+			if (cxt->mountinfo_fd >= 0)
+				close(cxt->mountinfo_fd);
+			cxt->mountinfo_fd = open(_PATH_PROC_MOUNTINFO,
+						 O_RDONLY | O_CLOEXEC);
+			update_file_stat(cxt->utab_path, &cxt->utab_st);
+		}
+		cxt->mountinfo_partial = cxt->noautofs || cxt->table_fltrcb;
+
 		rc = __mnt_table_parse_mountinfo(cxt->mountinfo, NULL, cxt->utab);
 		if (rc)
 			goto end;
@@ -1400,6 +1529,51 @@ int mnt_context_get_mtab(struct libmnt_context *cxt, struct libmnt_table **tb)
 	return mnt_context_get_mountinfo(cxt, tb);
 }
 
+/**
+ * mnt_context_enable_tables_cache:
+ * @cxt: mount context
+ * @enable: TRUE or FALSE
+ *
+ * Enable/disable tables cache. The parsed fstab is kept by mnt_reset_context()
+ * by default, but it is never checked for modifications; mountinfo is always
+ * dropped. If the cache is enabled, the both tables are kept between
+ * operations, and on the first use after mnt_reset_context() they are read
+ * again only if modified in the meantime. The mountinfo modifications are
+ * detected by poll(2) (and by stat(2) for utab), fstab by stat(2). The table
+ * set by mnt_context_set_fstab() is never re-read.
+ *
+ * This is useful for long-running processes that reuse one context for many
+ * operations. Note that umount(8) usually reads only mountinfo entries
+ * relevant for the target; the complete mountinfo is always read if the
+ * cache is enabled.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_context_enable_tables_cache(struct libmnt_context *cxt, int enable)
+{
+	if (!cxt)
+		return -EINVAL;
+
+	DBG(CXT, ul_debugobj(cxt, "tables cache %s", enable ? "ENABLED" : "disabled"));
+	cxt->tables_cache = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_context_is_tables_cache:
+ * @cxt: mount context
+ *
+ * Returns: 1 if tables cache is enabled, see mnt_context_enable_tables_cache().
+ *
+ * Since: 2.41
+ */
+int mnt_context_is_tables_cache(struct libmnt_context *cxt)
+{
+	return cxt->tables_cache ? 1 : 0;
+}
+
 /*
  * Called by mountinfo parser to filter out entries, non-zero means that
  * an entry has to be filtered out.
@@ -1429,6 +1603,10 @@ int mnt_context_get_mountinfo_for_target(struct libmnt_context *cxt,
 	int rc;
 	struct libmnt_ns *ns_old;
 
+	/* cached tables are complete */
+	if (cxt->tables_cache)
+		return mnt_context_get_mountinfo(cxt, mountinfo);
+
 	ns_old = mnt_context_switch_target_ns(cxt);
 	if (!ns_old)
 		return -MNT_ERR_NAMESPACE;
@@ -2158,7 +2336,7 @@ int mnt_context_prepare_update(struct libmnt_context *cxt)
 	}
 
 	if (!cxt->update) {
-		if (cxt->action == MNT_ACT_UMOUNT && is_file_empty(name)) {
+		if (cxt->action == MNT_ACT_UMOUNT && mnt_is_utab_empty(name)) {
 			DBG(CXT, ul_debugobj(cxt, "skip update: umount, no table"));
 			return 0;
 		}
@@ -2859,25 +3037,162 @@ int mnt_context_is_fs_mounted(struct libmnt_context *cxt,
 	return rc;
 }
 
-static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid)
+static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid,
+				 const char *target)
 {
-	pid_t *pids;
+	struct libmnt_child *ch;
 
 	if (!cxt)
 		return -EINVAL;
 
-	pids = reallocarray(cxt->children, cxt->nchildren + 1, sizeof(pid_t));
-	if (!pids)
+	ch = reallocarray(cxt->children, cxt->nchildren + 1, sizeof(*ch));
+	if (!ch)
 		return -ENOMEM;
 
-	DBG(CXT, ul_debugobj(cxt, "add new child %d", pid));
-	cxt->children = pids;
-	cxt->children[cxt->nchildren++] = pid;
+	DBG(CXT, ul_debugobj(cxt, "add new child %d [%s]", pid, target));
+	cxt->children = ch;
+
+	ch = &cxt->children[cxt->nchildren++];
+	memset(ch, 0, sizeof(*ch));
+	ch->pid = pid;
+	if (target)
+		ch->target = strdup(target);
+	cxt->nrunning++;
+
+	return 0;
+}
+
+/* returns 1 if path @a is the same as @b or @a is an ancestor of @b */
+static int is_path_ancestor(const char *a, const char *b)
+{
+	size_t sz;
+
+	if (!a || !b)
+		return 0;
+
+	sz = strlen(a);
+	while (sz > 1 && a[sz - 1] == '/')
+		sz--;
+	if (strncmp(a, b, sz) != 0)
+		return 0;
+	if (sz == 1 && *a == '/')
+		return 1;
+	return b[sz] == '\0' || b[sz] == '/';
+}
+
+static int reap_child(struct libmnt_context *cxt, struct libmnt_child *ch)
+{
+	int rc, ret = 0;
+
+	if (ch->done)
+		return 0;
+	do {
+		DBG(CXT, ul_debugobj(cxt, "waiting for child %d [%s]",
+					ch->pid, ch->target));
+		errno = 0;
+		rc = waitpid(ch->pid, &ret, 0);
+
+	} while (rc == -1 && errno == EINTR);
 
+	ch->done = 1;
+	if (rc == -1)
+		ch->failed = 0;		/* not our child, follow old behavior */
+	else
+		ch->failed = WIFEXITED(ret) ? WEXITSTATUS(ret) != 0 : 1;
+
+	cxt->nrunning--;
 	return 0;
 }
 
-int mnt_fork_context(struct libmnt_context *cxt)
+/* wait for an arbitrary running child */
+static int reap_any_child(struct libmnt_context *cxt)
+{
+	struct libmnt_child *first = NULL;
+	int i;
+#ifdef WNOWAIT
+	siginfo_t info = { .si_pid = 0 };
+
+	/* peek at the first finished child, but don't reap children
+	 * unknown to the context */
+	if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) == 0) {
+		for (i = 0; i < cxt->nchildren; i++) {
+			struct libmnt_child *ch = &cxt->children[i];
+
+			if (!ch->done && ch->pid == info.si_pid)
+				return reap_child(cxt, ch);
+		}
+	}
+#endif
+	for (i = 0; i < cxt->nchildren; i++) {
+		if (!cxt->children[i].done) {
+			first = &cxt->children[i];
+			break;
+		}
+	}
+	return first ? reap_child(cxt, first) : 0;
+}
+
+/*
+ * The filesystem has to wait for running children which mount its
+ * mountpoint ancestor (or below the mountpoint, to keep fstab order), the
+ * source path (bind mounts, loop devices) or the paths specified by
+ * x-systemd.requires-mounts-for=.
+ */
+static int child_is_dependency(struct libmnt_child *ch, struct libmnt_fs *fs)
+{
+	const char *tgt, *src, *opts;
+	char *val;
+	size_t valsz;
+
+	if (!ch->target)
+		return 1;
+
+	tgt = mnt_fs_get_target(fs);
+	if (is_path_ancestor(ch->target, tgt) || is_path_ancestor(tgt, ch->target))
+		return 1;
+
+	src = mnt_fs_get_srcpath(fs);
+	if (src && *src == '/' && is_path_ancestor(ch->target, src))
+		return 1;
+
+	opts = mnt_fs_get_user_options(fs);
+	while (opts && mnt_optstr_get_option(opts, "x-systemd.requires-mounts-for",
+					     &val, &valsz) == 0) {
+		char *path = val ? strndup(val, valsz) : NULL;
+		int rc = path && is_path_ancestor(ch->target, path);
+
+		free(path);
+		if (rc)
+			return 1;
+		opts = val ? val + valsz : NULL;
+	}
+	return 0;
+}
+
+static int wait_for_dependencies(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	int i;
+
+	for (i = 0; fs && i < cxt->nchildren; i++) {
+		struct libmnt_child *ch = &cxt->children[i];
+
+		if (!ch->done && child_is_dependency(ch, fs))
+			reap_child(cxt, ch);
+	}
+
+	while (cxt->maxchildren && cxt->nrunning >= cxt->maxchildren)
+		reap_any_child(cxt);
+
+	return 0;
+}
+
+/*
+ * Forks the context, @fs is the filesystem mounted by the child. The fork
+ * is delayed until all running children @fs depends on are finished and
+ * until the number of running children is below the limit (see
+ * mnt_context_set_max_children()).
+ */
+int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs)
 {
 	int rc = 0;
 	pid_t pid;
@@ -2886,6 +3201,8 @@ int mnt_fork_context(struct libmnt_context *cxt)
 	if (!mnt_context_is_parent(cxt))
 		return -EINVAL;
 
+	wait_for_dependencies(cxt, fs);
+
 	DBG(CXT, ul_debugobj(cxt, "forking context"));
 
 	DBG_FLUSH;
@@ -2904,7 +3221,7 @@ int mnt_fork_context(struct libmnt_context *cxt)
 		break;
 
 	default:
-		rc = mnt_context_add_child(cxt, pid);
+		rc = mnt_context_add_child(cxt, pid, fs ? mnt_fs_get_target(fs) : NULL);
 		break;
 	}
 
@@ -2922,38 +3239,60 @@ int mnt_context_wait_for_children(struct libmnt_context *cxt,
 	assert(mnt_context_is_parent(cxt));
 
 	for (i = 0; i < cxt->nchildren; i++) {
-		pid_t pid = cxt->children[i];
-		int rc = 0, ret = 0;
-
-		if (!pid)
-			continue;
-		do {
-			DBG(CXT, ul_debugobj(cxt,
-					"waiting for child (%d/%d): %d",
-					i + 1, cxt->nchildren, pid));
-			errno = 0;
-			rc = waitpid(pid, &ret, 0);
+		struct libmnt_child *ch = &cxt->children[i];
 
-		} while (rc == -1 && errno == EINTR);
+		reap_child(cxt, ch);
 
 		if (nchildren)
 			(*nchildren)++;
-
-		if (rc != -1 && nerrs) {
-			if (WIFEXITED(ret))
-				(*nerrs) += WEXITSTATUS(ret) == 0 ? 0 : 1;
-			else
-				(*nerrs)++;
-		}
-		cxt->children[i] = 0;
+		if (nerrs && ch->failed)
+			(*nerrs)++;
+		free(ch->target);
 	}
 
 	cxt->nchildren = 0;
+	cxt->nrunning = 0;
 	free(cxt->children);
 	cxt->children = NULL;
 	return 0;
 }
 
+/**
+ * mnt_context_set_max_children:
+ * @cxt: mount context
+ * @max: maximal number of running children or zero for unlimited
+ *
+ * Sets the maximal number of concurrently running children for fork mode
+ * (see mnt_context_enable_fork()). The children are also serialized by
+ * their mountpoints, sources and x-systemd.requires-mounts-for= options,
+ * so the filesystem is never mounted before the filesystems it depends on.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_context_set_max_children(struct libmnt_context *cxt, int max)
+{
+	if (!cxt || max < 0)
+		return -EINVAL;
+	cxt->maxchildren = max;
+	return 0;
+}
+
+/**
+ * mnt_context_get_max_children:
+ * @cxt: mount context
+ *
+ * Returns: maximal number of running children for fork mode, zero means
+ * unlimited.
+ *
+ * Since: 2.41
+ */
+int mnt_context_get_max_children(struct libmnt_context *cxt)
+{
+	return cxt ? cxt->maxchildren : 0;
+}
+
 static void close_ns(struct libmnt_ns *ns)
 {
 	if (ns->fd == -1)
@@ -3028,6 +3367,15 @@ int mnt_context_set_target_ns(struct libmnt_context *cxt, const char *path)
 	cxt->ns_tgt.fd = tmp;
 	cxt->ns_tgt.cache = NULL;
 
+	/* cached tables are from another namespace */
+	if (cxt->tables_cache) {
+		context_drop_mountinfo(cxt);
+		if (cxt->fstab_parsed) {
+			mnt_unref_table(cxt->fstab);
+			cxt->fstab = NULL;
+		}
+	}
+
 	return 0;
 err:
 	close(tmp);
@@ -3268,6 +3616,39 @@ static int test_mount(struct libmnt_test *ts __attribute__((unused)),
 	return rc;
 }
 
+static int test_mount_targets(struct libmnt_test *ts __attribute__((unused)),
+			      int argc, char *argv[])
+{
+	int idx = 1, rc;
+	size_t n = 0;
+	struct libmnt_context *cxt;
+
+	if (argc < 3)
+		return -EINVAL;
+
+	cxt = mnt_new_context();
+	if (!cxt)
+		return -ENOMEM;
+
+	if (!strcmp(argv[idx], "-o")) {
+		mnt_context_set_options(cxt, argv[idx + 1]);
+		idx += 2;
+	}
+	if (argc < idx + 2) {
+		mnt_free_context(cxt);
+		return -EINVAL;
+	}
+	mnt_context_set_source(cxt, argv[idx++]);
+
+	rc = mnt_context_mount_targets(cxt, &argv[idx], argc - idx, &n);
+	if (rc)
+		warn("failed to mount %s", n < (size_t) (argc - idx) ? argv[idx + n] : "");
+	printf("mounted %zu targets\n", n);
+
+	mnt_free_context(cxt);
+	return rc;
+}
+
 static int test_umount(struct libmnt_test *ts __attribute__((unused)),
 		       int argc, char *argv[])
 {
@@ -3460,6 +3841,7 @@ int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 	{ "--mount",  test_mount,  "[-o <opts>] [-t <type>] <spec>|<src> <target>" },
+	{ "--mount-targets", test_mount_targets, "[-o <opts>] <src> <target> [<target> ...]" },
 	{ "--umount", test_umount, "[-t <type>] [-f][-l][-r] <src>|<target>" },
 	{ "--mount-all", test_mountall,  "[-O <pattern>] [-t <pattern] mount all filesystems from fstab" },
 	{ "--flags", test_flags,   "[-o <opts>] <spec>" },
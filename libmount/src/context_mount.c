@@ -1063,6 +1063,171 @@ again:
 	return rc;
 }
 
+/* mounts @target by mnt_context_mount() with the same settings as the
+ * previous target */
+static int mount_next_target(struct libmnt_context *cxt, const char *src,
+			     const char *opts, const char *target)
+{
+	int rc;
+
+	mnt_reset_context(cxt);
+
+	rc = mnt_context_set_target(cxt, target);
+	if (!rc && src)
+		rc = mnt_context_set_source(cxt, src);
+	if (!rc && opts)
+		rc = mnt_context_set_options(cxt, opts);
+	if (!rc)
+		rc = mnt_context_mount(cxt);
+	return rc;
+}
+
+/* the next targets may be clones of the first mount */
+static int can_clone_mount(struct libmnt_context *cxt)
+{
+	unsigned long mflags = 0;
+
+	if (mnt_context_get_mflags(cxt, &mflags) != 0
+	    || !(mflags & MS_BIND)
+	    || (mflags & (MS_REMOUNT | MS_MOVE)))
+		return 0;
+
+	/* suid mount(8) has to evaluate permissions for each target; explicit
+	 * propagation flags would give the clones the same peer group */
+	return !mnt_context_is_restricted(cxt)
+		&& !mnt_context_is_fake(cxt)
+		&& !mnt_context_helper_executed(cxt)
+		&& !mnt_optlist_get_propagation(cxt->optlist);
+}
+
+/**
+ * mnt_context_mount_targets:
+ * @cxt: mount context
+ * @targets: mountpoints
+ * @ntargets: number of @targets
+ * @nmounted: returns number of mounted targets or NULL
+ *
+ * Mounts the source (see mnt_context_set_source()) with the same options to
+ * all @targets. The context target is ignored.
+ *
+ * The first target is mounted by mnt_context_mount(). For bind operations
+ * the other targets get clones of the first mount by open_tree() and
+ * move_mount(), so the source lookup, fstab, mount_setattr() and hooks are
+ * not repeated and utab is updated only once for all the clones. Otherwise
+ * (or if the new mount API is not available) the context is reset and all
+ * the targets are mounted by mnt_context_mount().
+ *
+ * After an error, @nmounted is the index of the failed target and the context
+ * describes the failed operation, so mnt_context_get_excode() may be used.
+ * Check mnt_context_get_status() as after mnt_context_mount().
+ *
+ * Returns: 0 on success, or the return code from mnt_context_mount() or
+ *          other error for the failed target.
+ *
+ * Since: 2.41
+ */
+int mnt_context_mount_targets(struct libmnt_context *cxt,
+			      char *const *targets, size_t ntargets,
+			      size_t *nmounted)
+{
+	char *src = NULL, *opts = NULL, **tgts = NULL;
+	size_t i = 0, nclones = 0;
+	int rc;
+
+	if (!cxt || !targets || !ntargets)
+		return -EINVAL;
+	if (nmounted)
+		*nmounted = 0;
+
+	DBG(CXT, ul_debugobj(cxt, "mount %zu targets", ntargets));
+
+	/* settings for the next targets */
+	if (mnt_context_get_source(cxt)) {
+		src = strdup(mnt_context_get_source(cxt));
+		if (!src)
+			return -ENOMEM;
+	}
+	if (mnt_context_get_options(cxt)) {
+		opts = strdup(mnt_context_get_options(cxt));
+		if (!opts) {
+			rc = -ENOMEM;
+			goto done;
+		}
+	}
+
+	rc = mnt_context_set_target(cxt, targets[0]);
+	if (!rc)
+		rc = mnt_context_mount(cxt);
+	if (rc || mnt_context_get_status(cxt) != 1)
+		goto done;
+	i = 1;
+
+	if (ntargets > 1 && can_clone_mount(cxt)) {
+		struct libmnt_cache *cache = mnt_context_get_cache(cxt);
+		struct libmnt_ns *ns_old;
+
+		tgts = calloc(ntargets - 1, sizeof(char *));
+		if (!tgts) {
+			rc = -ENOMEM;
+			goto done;
+		}
+		/* canonicalized as the target of the first mount */
+		for (i = 1; i < ntargets; i++) {
+			char *p = cache ? mnt_resolve_path(targets[i], cache) : NULL;
+			tgts[i - 1] = p ? p : targets[i];
+		}
+
+		ns_old = mnt_context_switch_target_ns(cxt);
+		if (!ns_old) {
+			rc = -MNT_ERR_NAMESPACE;
+			i = 1;
+			goto done;
+		}
+		rc = mnt_context_clone_mount(cxt, mnt_context_get_target(cxt),
+				tgts, ntargets - 1,
+				mnt_optlist_is_rbind(cxt->optlist), &nclones);
+		i = 1 + nclones;
+
+		if (nclones
+		    && !mnt_context_is_nomtab(cxt)
+		    && cxt->update && mnt_update_is_ready(cxt->update)
+		    && mnt_update_get_fs(cxt->update)) {
+			int xrc = mnt_update_add_targets(cxt->update, cxt->lock,
+						tgts, nclones);
+			if (xrc == 0)
+				mnt_update_emit_event(cxt->update);
+			else if (!rc)
+				rc = xrc;
+		}
+
+		if (!mnt_context_switch_ns(cxt, ns_old) && !rc)
+			rc = -MNT_ERR_NAMESPACE;
+
+		/* no clone created, try the classic way */
+		if (!nclones && (rc == -ENOSYS || rc == -EINVAL)) {
+			DBG(CXT, ul_debugobj(cxt, "cannot clone mount [rc=%d]", rc));
+			mnt_context_reset_status(cxt);
+			rc = 0;
+		}
+		if (rc)
+			goto done;
+	}
+
+	for (; i < ntargets; i++) {
+		rc = mount_next_target(cxt, src, opts, targets[i]);
+		if (rc || mnt_context_get_status(cxt) != 1)
+			break;
+	}
+done:
+	if (nmounted)
+		*nmounted = i;
+	free(tgts);
+	free(src);
+	free(opts);
+	DBG(CXT, ul_debugobj(cxt, "mount targets done [rc=%d, mounted=%zu]", rc, i));
+	return rc;
+}
+
 /**
  * mnt_context_next_mount:
  * @cxt: context
@@ -1183,14 +1348,15 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 		mnt_context_save_template(cxt);
 	}
 
-	/* reset context, but protect mountinfo */
+	/* reset context, but protect mountinfo and fstab (iterated) */
 	mountinfo = cxt->mountinfo;
 	cxt->mountinfo = NULL;
 	mnt_reset_context(cxt);
 	cxt->mountinfo = mountinfo;
+	cxt->fstab_check = 0;
 
 	if (mnt_context_is_fork(cxt)) {
-		rc = mnt_fork_context(cxt);
+		rc = mnt_fork_context(cxt, *fs);
 		if (rc)
 			return rc;		/* fork error */
 
@@ -22,6 +22,7 @@
 #include "pathnames.h"
 #include "loopdev.h"
 #include "strutils.h"
+#include "fileutils.h"	/* statx() fallback */
 #include "mountP.h"
 
 /*
@@ -216,15 +217,10 @@ static int has_utab_entry(struct libmnt_context *cxt, const char *target)
 	assert(cxt);
 
 	if (!cxt->utab) {
-		const char *path = mnt_get_utab_path();
-
-		if (!path || is_file_empty(path))
-			return 0;
 		cxt->utab = mnt_new_table();
 		if (!cxt->utab)
 			return 0;
-		cxt->utab->fmt = MNT_FMT_UTAB;
-		if (mnt_table_parse_file(cxt->utab, path))
+		if (__mnt_table_parse_utab(cxt->utab, NULL))
 			return 0;
 	}
 
@@ -246,6 +242,49 @@ static int has_utab_entry(struct libmnt_context *cxt, const char *target)
 }
 
 /* returns: 1 not found; <0 on error; 1 success */
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX) && defined(HAVE_STRUCT_STATX_STX_MNT_ID)
+# ifndef STATX_MNT_ID_UNIQUE
+#  define STATX_MNT_ID_UNIQUE	0x00004000U
+# endif
+# ifndef STATX_ATTR_MOUNT_ROOT
+#  define STATX_ATTR_MOUNT_ROOT	0x00002000
+# endif
+/*
+ * Fills type, source and options for the mountpoint @fd by statmount(). It's
+ * more accurate than fstatfs() (e.g. FUSE subtypes), and still without
+ * mountinfo. Returns 0 on success, 1 if @fd is not a mountpoint, and <0 if
+ * statx() or statmount() are not supported.
+ */
+static int lookup_umount_fs_by_statmount(struct libmnt_context *cxt, int fd)
+{
+	struct statx st = { 0 };
+	int rc;
+
+	DBG(CXT, ul_debugobj(cxt, "  trying statmount()"));
+
+	if (statx(fd, "", AT_EMPTY_PATH | AT_STATX_DONT_SYNC,
+		  STATX_MNT_ID_UNIQUE, &st) != 0)
+		return -errno;
+	if (!(st.stx_mask & STATX_MNT_ID_UNIQUE))
+		return -ENOSYS;		/* kernel < 6.8 */
+
+	if ((st.stx_attributes_mask & STATX_ATTR_MOUNT_ROOT)
+	    && !(st.stx_attributes & STATX_ATTR_MOUNT_ROOT)) {
+		DBG(CXT, ul_debugobj(cxt, "  not a mountpoint"));
+		return 1;
+	}
+
+	cxt->fs->uniq_id = st.stx_mnt_id;
+	rc = __mnt_fs_fetch_statmount(cxt->fs, STATMOUNT_FS_TYPE
+					| STATMOUNT_SB_SOURCE | MNT_STMNT_OPTS);
+	if (rc == 0 && !mnt_fs_get_fstype(cxt->fs))
+		rc = -EINVAL;
+	if (rc)
+		cxt->fs->uniq_id = 0;
+	return rc;
+}
+#endif
+
 static int lookup_umount_fs_by_statfs(struct libmnt_context *cxt, const char *tgt)
 {
 	struct stat st;
@@ -282,20 +321,28 @@ static int lookup_umount_fs_by_statfs(struct libmnt_context *cxt, const char *tg
 	type = mnt_fs_get_fstype(cxt->fs);
 	if (!type) {
 		struct statfs vfs;
-		int fd;
-
-		DBG(CXT, ul_debugobj(cxt, "  trying fstatfs()"));
+		int fd, rc = 0;
 
 		/* O_PATH avoids triggering automount points. */
-		fd = open(tgt, O_PATH);
+		fd = open(tgt, O_PATH | O_CLOEXEC);
 		if (fd >= 0) {
-			if (fstatfs(fd, &vfs) == 0)
-				type = mnt_statfs_get_fstype(&vfs);
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX) && defined(HAVE_STRUCT_STATX_STX_MNT_ID)
+			rc = lookup_umount_fs_by_statmount(cxt, fd);
+			if (rc == 0)
+				type = mnt_fs_get_fstype(cxt->fs);
+			else if (rc == 1 || rc == -ENOMEM) {
+				close(fd);
+				return rc;
+			}
+#endif
+			if (!type) {
+				DBG(CXT, ul_debugobj(cxt, "  trying fstatfs()"));
+				if (fstatfs(fd, &vfs) == 0)
+					type = mnt_statfs_get_fstype(&vfs);
+				rc = type ? mnt_fs_set_fstype(cxt->fs, type) : 0;
+			}
 			close(fd);
-		}
-		if (type) {
-			int rc = mnt_fs_set_fstype(cxt->fs, type);
-			if (rc)
+			if (rc < 0)
 				return rc;
 		}
 	}
@@ -367,6 +414,12 @@ static int lookup_umount_fs(struct libmnt_context *cxt)
 		return -EINVAL;
 	}
 
+	/* already complete FS from mountinfo, see mnt_context_umount_recursive() */
+	if (mnt_context_tab_applied(cxt)) {
+		DBG(CXT, ul_debugobj(cxt, " already applied"));
+		goto done;
+	}
+
 	/* try get fs type by statfs() */
 	rc = lookup_umount_fs_by_statfs(cxt, tgt);
 	if (rc <= 0)
@@ -1228,6 +1281,208 @@ int mnt_context_next_umount(struct libmnt_context *cxt,
 }
 
 
+/*
+ * Adds @fs and all its submounts to @order, children first. Overmounts are
+ * unmounted before the filesystems they cover.
+ */
+static int add_umount_tree(struct libmnt_table *tb, struct libmnt_fs *fs,
+			   struct libmnt_fs **order, size_t *norder, size_t max)
+{
+	struct libmnt_fs *child, *over = NULL;
+	struct libmnt_iter itr;
+	int rc;
+
+	if (*norder >= max)
+		return -EINVAL;		/* broken tree */
+
+	if (mnt_table_over_fs(tb, fs, &over) == 0 && over) {
+		rc = add_umount_tree(tb, over, order, norder, max);
+		if (rc)
+			return rc;
+	}
+
+	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
+	while ((rc = mnt_table_next_child_fs(tb, &itr, fs, &child)) == 0) {
+		if (over && child == over)
+			continue;
+		rc = add_umount_tree(tb, child, order, norder, max);
+		if (rc)
+			return rc;
+	}
+	if (rc < 0)
+		return rc;
+
+	if (*norder >= max)
+		return -EINVAL;
+	order[(*norder)++] = fs;
+	return 0;
+}
+
+/* returns 1 if @fs from the old mount table is no more mounted */
+static int is_umounted_fs(struct libmnt_fs *fs)
+{
+	struct libmnt_table *tb = mnt_new_table_from_file(_PATH_PROC_MOUNTINFO);
+	struct libmnt_fs *x;
+	int rc = 0;
+
+	if (!tb)
+		return 0;
+	x = __mnt_table_find_id(tb, mnt_fs_get_id(fs));
+	if (!x || !mnt_fs_streq_target(x, mnt_fs_get_target(fs)))
+		rc = 1;
+	mnt_unref_table(tb);
+	return rc;
+}
+
+/**
+ * mnt_context_umount_recursive:
+ * @cxt: mount context
+ * @callback: function called after each umount or NULL
+ * @data: callback data
+ *
+ * Unmounts the target (see mnt_context_set_target()) and all filesystems
+ * mounted below it. The mount table is read only once, all submounts are
+ * unmounted before their parents and overmounts before the filesystems they
+ * cover. The utab file is updated only once at the end.
+ *
+ * The @callback is called with the context after each umount; @rc is the
+ * return code from mnt_context_umount(). The context is reset after the
+ * callback. Non-zero return code from the callback stops the operation.
+ *
+ * Filesystems which have been unmounted in meantime (for example by mount
+ * propagation) are silently ignored. The target is always a mountpoint, this
+ * function does not search for mountpoints by devices or loop backing files.
+ *
+ * Returns: 0 on success, 1 if the target is not mounted, <0 on error, or
+ *          the non-zero return code from @callback.
+ *
+ * Since: 2.41
+ */
+int mnt_context_umount_recursive(struct libmnt_context *cxt,
+		int (*callback)(struct libmnt_context *, struct libmnt_fs *, int, void *),
+		void *data)
+{
+	struct libmnt_table *mountinfo = NULL;
+	struct libmnt_fs **order = NULL, *root;
+	struct libmnt_ns *ns_old;
+	char **umounted = NULL, *target;
+	size_t i, norder = 0, numounted = 0, nents;
+	int rc, nomtab;
+
+	if (!cxt || !mnt_context_get_target(cxt))
+		return -EINVAL;
+
+	target = strdup(mnt_context_get_target(cxt));
+	if (!target)
+		return -ENOMEM;
+
+	DBG(CXT, ul_debugobj(cxt, "umount recursive: %s", target));
+
+	ns_old = mnt_context_switch_target_ns(cxt);
+	if (!ns_old) {
+		free(target);
+		return -MNT_ERR_NAMESPACE;
+	}
+
+	rc = mnt_context_get_mountinfo(cxt, &mountinfo);
+	if (rc)
+		goto done;
+	mnt_ref_table(mountinfo);
+
+	root = mnt_table_find_target(mountinfo, target, MNT_ITER_FORWARD);
+	if (!root) {
+		rc = 1;
+		goto done;
+	}
+
+	nents = mnt_table_get_nents(mountinfo);
+	order = calloc(nents, sizeof(struct libmnt_fs *));
+	umounted = calloc(nents, sizeof(char *));
+	if (!order || !umounted) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	rc = add_umount_tree(mountinfo, root, order, &norder, nents);
+	if (rc)
+		goto done;
+
+	DBG(CXT, ul_debugobj(cxt, " %zu filesystems to umount", norder));
+
+	/* utab is updated for all filesystems at the end */
+	nomtab = mnt_context_is_nomtab(cxt);
+	mnt_context_disable_mtab(cxt, TRUE);
+
+	for (i = 0; rc == 0 && i < norder; i++) {
+		struct libmnt_fs *fs = order[i];
+		int mntrc;
+
+		/* keep mountinfo, the entries are complete */
+		cxt->mountinfo = NULL;
+		mnt_reset_context(cxt);
+		cxt->mountinfo = mountinfo;
+		mnt_ref_table(mountinfo);
+
+		rc = mnt_context_set_fs(cxt, fs);
+		if (rc)
+			break;
+		cxt->flags |= MNT_FL_TAB_APPLIED;
+
+		mntrc = mnt_context_umount(cxt);
+
+		/* EINVAL means "not a mountpoint" */
+		if (mnt_context_get_syscall_errno(cxt) == EINVAL
+		    && is_umounted_fs(fs)) {
+			DBG(CXT, ul_debugobj(cxt, " %s already unmounted",
+					mnt_fs_get_target(fs)));
+			continue;
+		}
+
+		if (mntrc == 0 && mnt_context_get_status(cxt) == 1) {
+			umounted[numounted] = strdup(mnt_fs_get_target(fs));
+			if (umounted[numounted])
+				numounted++;
+		}
+		if (callback)
+			rc = callback(cxt, fs, mntrc, data);
+	}
+
+	cxt->mountinfo = NULL;
+	mnt_reset_context(cxt);
+	mnt_context_disable_mtab(cxt, nomtab);
+
+	if (numounted && !nomtab && mnt_context_utab_writable(cxt)) {
+		const char *name = mnt_context_get_writable_tabpath(cxt);
+
+		if (!mnt_is_utab_empty(name)) {
+			struct libmnt_update *upd = mnt_new_update();
+			int xrc = -ENOMEM;
+
+			if (upd) {
+				mnt_update_set_filename(upd, name);
+				xrc = mnt_update_remove_targets(upd, cxt->lock,
+							umounted, numounted);
+				if (xrc == 0)
+					mnt_update_emit_event(upd);
+				mnt_free_update(upd);
+			}
+			if (xrc && !rc)
+				rc = xrc;
+		}
+	}
+done:
+	DBG(CXT, ul_debugobj(cxt, "umount recursive: done [rc=%d]", rc));
+	for (i = 0; i < numounted; i++)
+		free(umounted[i]);
+	free(umounted);
+	free(order);
+	free(target);
+	mnt_unref_table(mountinfo);
+
+	if (!mnt_context_switch_ns(cxt, ns_old))
+		return -MNT_ERR_NAMESPACE;
+	return rc;
+}
+
 int mnt_context_get_umount_excode(
 			struct libmnt_context *cxt,
 			int rc,
@@ -96,6 +96,7 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 	free(fs->opt_fields);
 	free(fs->comment);
 
+	mnt_unref_lzline(fs->lzline);
 	mnt_unref_optlist(fs->optlist);
 	fs->optlist = NULL;
 
@@ -271,6 +272,19 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 	dest->parent     = src->parent;
 	dest->devno      = src->devno;
 	dest->tid        = src->tid;
+	dest->uniq_id    = src->uniq_id;
+	dest->uniq_parent = src->uniq_parent;
+	dest->stmnt_todo = src->stmnt_todo;
+
+	/* share not yet decoded mountinfo line */
+	if (dest->lzline != src->lzline) {
+		mnt_unref_lzline(dest->lzline);
+		dest->lzline = src->lzline;
+		if (dest->lzline)
+			dest->lzline->refcount++;
+	}
+	memcpy(dest->lzoff, src->lzoff, sizeof(dest->lzoff));
+	dest->lazy_todo = src->lazy_todo;
 
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, source)))
 		goto err;
@@ -327,6 +341,7 @@ struct libmnt_fs *mnt_copy_mtab_fs(struct libmnt_fs *fs)
 	assert(fs);
 	if (!n)
 		return NULL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_ALL);
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -419,6 +434,8 @@ const char *mnt_fs_get_srcpath(struct libmnt_fs *fs)
 	if (!fs)
 		return NULL;
 
+	mnt_fs_fetch_fields(fs, STATMOUNT_SB_SOURCE);
+
 	/* fstab-like fs */
 	if (fs->tagname)
 		return NULL;	/* the source contains a "NAME=value" */
@@ -434,6 +451,7 @@ const char *mnt_fs_get_srcpath(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_source(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_SB_SOURCE);
 	return fs ? fs->source : NULL;
 }
 
@@ -593,6 +611,7 @@ int mnt_fs_streq_target(struct libmnt_fs *fs, const char *path)
  */
 int mnt_fs_get_tag(struct libmnt_fs *fs, const char **name, const char **value)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_SB_SOURCE);
 	if (fs == NULL || !fs->tagname)
 		return -EINVAL;
 	if (name)
@@ -610,6 +629,7 @@ int mnt_fs_get_tag(struct libmnt_fs *fs, const char **name, const char **value)
  */
 const char *mnt_fs_get_target(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_MNT_POINT);
 	return fs ? fs->target : NULL;
 }
 
@@ -624,6 +644,8 @@ const char *mnt_fs_get_target(struct libmnt_fs *fs)
  */
 int mnt_fs_set_target(struct libmnt_fs *fs, const char *tgt)
 {
+	if (fs && fs->tab)
+		__mnt_table_reset_index(fs->tab, MNT_TABIDX_TARGET);
 	return strdup_to_struct_member(fs, target, tgt);
 }
 
@@ -631,6 +653,8 @@ int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 {
 	assert(fs);
 
+	if (fs->tab)
+		__mnt_table_reset_index(fs->tab, MNT_TABIDX_TARGET);
 	free(fs->target);
 	fs->target = tgt;
 	return 0;
@@ -659,6 +683,7 @@ int mnt_fs_get_propagation(struct libmnt_fs *fs, unsigned long *flags)
 
 	*flags = 0;
 
+	mnt_fs_fetch_fields(fs, STATMOUNT_PROPAGATE_FROM);
 	if (!fs->opt_fields)
 		return 0;
 
@@ -695,6 +720,7 @@ int mnt_fs_is_kernel(struct libmnt_fs *fs)
  */
 int mnt_fs_is_swaparea(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_FS_TYPE);
 	return mnt_fs_get_flags(fs) & MNT_FS_SWAP ? 1 : 0;
 }
 
@@ -706,6 +732,7 @@ int mnt_fs_is_swaparea(struct libmnt_fs *fs)
  */
 int mnt_fs_is_pseudofs(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_FS_TYPE);
 	return mnt_fs_get_flags(fs) & MNT_FS_PSEUDO ? 1 : 0;
 }
 
@@ -717,6 +744,7 @@ int mnt_fs_is_pseudofs(struct libmnt_fs *fs)
  */
 int mnt_fs_is_netfs(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_FS_TYPE);
 	return mnt_fs_get_flags(fs) & MNT_FS_NET ? 1 : 0;
 }
 
@@ -743,6 +771,7 @@ int mnt_fs_is_regularfs(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_fstype(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_FS_TYPE);
 	return fs ? fs->fstype : NULL;
 }
 
@@ -863,6 +892,7 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
 
 	if (!fs)
 		return NULL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -889,6 +919,7 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_options(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (fs && fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -904,6 +935,7 @@ const char *mnt_fs_get_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_optional_fields(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_PROPAGATE_FROM);
 	return fs ? fs->opt_fields : NULL;
 }
 
@@ -923,6 +955,7 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 
 	if (!fs)
 		return -EINVAL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 
 	if (fs->optlist) {
 		fs->opts_age = 0;
@@ -955,6 +988,39 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 	return 0;
 }
 
+/* Like mnt_fs_set_options(), but @optstr is not duplicated */
+int __mnt_fs_set_options_ptr(struct libmnt_fs *fs, char *optstr)
+{
+	char *v = NULL, *f = NULL, *u = NULL;
+
+	assert(fs);
+
+	if (fs->optlist || fs->lazy_todo || fs->stmnt_todo) {
+		int rc = mnt_fs_set_options(fs, optstr);
+		if (!rc)
+			free(optstr);
+		return rc;
+	}
+
+	if (optstr) {
+		int rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
+		if (rc)
+			return rc;
+	}
+
+	free(fs->fs_optstr);
+	free(fs->vfs_optstr);
+	free(fs->user_optstr);
+	free(fs->optstr);
+
+	fs->fs_optstr = f;
+	fs->vfs_optstr = v;
+	fs->user_optstr = u;
+	fs->optstr = optstr;
+
+	return 0;
+}
+
 /**
  * mnt_fs_append_options:
  * @fs: fstab/mtab/mountinfo entry
@@ -974,6 +1040,7 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 
 	if (!fs)
 		return -EINVAL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (!optstr)
 		return 0;
 	if (fs->optlist) {
@@ -1020,6 +1087,7 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 
 	if (!fs)
 		return -EINVAL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (!optstr)
 		return 0;
 
@@ -1059,6 +1127,7 @@ const char *mnt_fs_get_fs_options(struct libmnt_fs *fs)
 {
 	if (!fs)
 		return NULL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -1075,6 +1144,7 @@ const char *mnt_fs_get_vfs_options(struct libmnt_fs *fs)
 {
 	if (!fs)
 		return NULL;
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -1257,6 +1327,7 @@ int mnt_fs_set_passno(struct libmnt_fs *fs, int passno)
  */
 const char *mnt_fs_get_root(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_MNT_ROOT);
 	return fs ? fs->root : NULL;
 }
 
@@ -1364,6 +1435,7 @@ int mnt_fs_set_bindsrc(struct libmnt_fs *fs, const char *src)
  */
 int mnt_fs_get_id(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_MNT_BASIC);
 	return fs ? fs->id : -EINVAL;
 }
 
@@ -1375,6 +1447,7 @@ int mnt_fs_get_id(struct libmnt_fs *fs)
  */
 int mnt_fs_get_parent_id(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_MNT_BASIC);
 	return fs ? fs->parent : -EINVAL;
 }
 
@@ -1386,6 +1459,7 @@ int mnt_fs_get_parent_id(struct libmnt_fs *fs)
  */
 dev_t mnt_fs_get_devno(struct libmnt_fs *fs)
 {
+	mnt_fs_fetch_fields(fs, STATMOUNT_SB_BASIC);
 	return fs ? fs->devno : 0;
 }
 
@@ -1417,6 +1491,7 @@ int mnt_fs_get_option(struct libmnt_fs *fs, const char *name,
 	if (!fs)
 		return -EINVAL;
 
+	mnt_fs_fetch_fields(fs, MNT_STMNT_OPTS);
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
 
@@ -1523,7 +1598,7 @@ int mnt_fs_match_target(struct libmnt_fs *fs, const char *target,
 {
 	int rc = 0;
 
-	if (!fs || !target || !fs->target)
+	if (!fs || !target || !mnt_fs_get_target(fs))
 		return 0;
 
 	/* 1) native paths */
@@ -1640,7 +1715,7 @@ int mnt_fs_match_source(struct libmnt_fs *fs, const char *source,
  */
 int mnt_fs_match_fstype(struct libmnt_fs *fs, const char *types)
 {
-	return mnt_match_fstype(fs->fstype, types);
+	return mnt_match_fstype(mnt_fs_get_fstype(fs), types);
 }
 
 /**
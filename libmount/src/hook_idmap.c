@@ -88,6 +88,130 @@ static inline void free_hook_data(struct hook_data *hd)
 	free(hd);
 }
 
+/*
+ * The user namespaces created for X-mount.idmap= are cached in the context,
+ * mounting more filesystems with the same mapping (e.g. container layers)
+ * does not need to fork and write the maps again.
+ */
+struct userns_entry {
+	char *key;		/* normalized mapping */
+	int fd;			/* user namespace */
+	struct list_head entries;
+};
+
+static int cmp_idmap_key(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*
+ * Returns mapping as sorted "u:<ns>:<host>:<range>" and "g:..." items
+ * separated by ' ', so "b:0:1000:1" and "g:0:1000:1 u:0:1000:1" are
+ * the same key.
+ */
+static char *idmap_to_key(struct list_head *idmap)
+{
+	struct list_head *p;
+	char **items = NULL, *key = NULL, *k;
+	size_t i, n = 0, len = 0;
+
+	list_for_each(p, idmap) {
+		struct id_map *m = list_entry(p, struct id_map, map_head);
+		n += m->map_type == ID_TYPE_UIDGID ? 2 : 1;
+	}
+	if (!n)
+		return NULL;
+
+	items = calloc(n, sizeof(char *));
+	if (!items)
+		return NULL;
+
+	i = 0;
+	list_for_each(p, idmap) {
+		struct id_map *m = list_entry(p, struct id_map, map_head);
+
+		if (m->map_type != ID_TYPE_GID) {
+			if (asprintf(&items[i], "u:%" PRIu32 ":%" PRIu32 ":%" PRIu32,
+				     m->nsid, m->hostid, m->range) < 0)
+				goto done;
+			i++;
+		}
+		if (m->map_type != ID_TYPE_UID) {
+			if (asprintf(&items[i], "g:%" PRIu32 ":%" PRIu32 ":%" PRIu32,
+				     m->nsid, m->hostid, m->range) < 0)
+				goto done;
+			i++;
+		}
+	}
+
+	qsort(items, n, sizeof(char *), cmp_idmap_key);
+
+	for (i = 0; i < n; i++)
+		len += strlen(items[i]) + 1;
+	key = k = malloc(len);
+	if (!key)
+		goto done;
+	for (i = 0; i < n; i++) {
+		if (i)
+			*k++ = ' ';
+		k = stpcpy(k, items[i]);
+	}
+done:
+	while (i > 0)
+		free(items[--i]);
+	free(items);
+	return key;
+}
+
+/* returns a new file descriptor for the cached namespace or -1 */
+static int userns_cache_get(struct libmnt_context *cxt, const char *key)
+{
+	struct list_head *p;
+
+	list_for_each(p, &cxt->userns_cache) {
+		struct userns_entry *ent = list_entry(p, struct userns_entry, entries);
+
+		if (strcmp(ent->key, key) == 0) {
+			DBG(HOOK, ul_debugobj(cxt, " reuse user namespace [%s]", key));
+			return fcntl(ent->fd, F_DUPFD_CLOEXEC, 0);
+		}
+	}
+	return -1;
+}
+
+/* the cache keeps its own copy of @fd, @key is not used after the call */
+static void userns_cache_add(struct libmnt_context *cxt, const char *key, int fd)
+{
+	struct userns_entry *ent = calloc(1, sizeof(*ent));
+
+	if (!ent)
+		return;
+	ent->key = strdup(key);
+	ent->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (!ent->key || ent->fd < 0) {
+		free(ent->key);
+		free(ent);
+		return;
+	}
+	DBG(HOOK, ul_debugobj(cxt, " cache user namespace [%s]", key));
+	INIT_LIST_HEAD(&ent->entries);
+	list_add_tail(&ent->entries, &cxt->userns_cache);
+}
+
+void mnt_context_free_userns_cache(struct libmnt_context *cxt)
+{
+	struct list_head *p, *pnext;
+
+	list_for_each_safe(p, pnext, &cxt->userns_cache) {
+		struct userns_entry *ent = list_entry(p, struct userns_entry, entries);
+
+		list_del(&ent->entries);
+		close(ent->fd);
+		free(ent->key);
+		free(ent);
+	}
+}
+
 static int write_id_mapping(idmap_type_t map_type, pid_t pid, const char *buf,
 			    size_t buf_size)
 {
@@ -378,7 +502,7 @@ static int hook_prepare_options(
 	struct libmnt_opt *opt;
 	int rc;
 	const char *value = NULL;
-	char *saveptr = NULL, *tok, *buf = NULL;
+	char *saveptr = NULL, *tok, *buf = NULL, *key = NULL;
 
 	ol = mnt_context_get_optlist(cxt);
 	if (!ol)
@@ -466,9 +590,16 @@ static int hook_prepare_options(
 		list_add_tail(&idmap->map_head, &hd->id_map);
 	}
 
-	hd->userns_fd = get_userns_fd_from_idmap(&hd->id_map);
-	if (hd->userns_fd < 0)
-		goto err;
+	key = idmap_to_key(&hd->id_map);
+	if (key)
+		hd->userns_fd = userns_cache_get(cxt, key);
+	if (hd->userns_fd < 0) {
+		hd->userns_fd = get_userns_fd_from_idmap(&hd->id_map);
+		if (hd->userns_fd < 0)
+			goto err;
+		if (key)
+			userns_cache_add(cxt, key, hd->userns_fd);
+	}
 
 done:
 	/* define post-mount hook to enter the namespace */
@@ -481,12 +612,14 @@ done:
 		goto err;
 
 	free(buf);
+	free(key);
 	return 0;
 
 err:
 	DBG(HOOK, ul_debugobj(hs, " failed to setup idmap"));
 	free_hook_data(hd);
 	free(buf);
+	free(key);
 	return -MNT_ERR_MOUNTOPT;
 }
 
@@ -518,4 +651,11 @@ const struct libmnt_hookset hookset_idmap =
 	.deinit = hookset_deinit
 };
 
+#else /* !(HAVE_MOUNTFD_API && HAVE_LINUX_MOUNT_H) */
+
+void mnt_context_free_userns_cache(
+		struct libmnt_context *cxt __attribute__((__unused__)))
+{
+}
+
 #endif /* HAVE_MOUNTFD_API && HAVE_LINUX_MOUNT_H */
@@ -567,6 +567,72 @@ static int hook_attach_target(struct libmnt_context *cxt,
 	return rc == 0 ? 0 : -errno;
 }
 
+/*
+ * Attaches clones of the mount @from to @targets, the clones inherit VFS flags
+ * and ID-mapping from @from. All clones are created before the first
+ * move_mount(), so a target below @from is not part of the other clones.
+ *
+ * Returns: 0 on success, <0 on error; @nattached is the number of attached
+ *          targets.
+ */
+int mnt_context_clone_mount(struct libmnt_context *cxt, const char *from,
+			    char *const *targets, size_t ntargets,
+			    int recursive, size_t *nattached)
+{
+	unsigned int oflg = OPEN_TREE_CLOEXEC | OPEN_TREE_CLONE | AT_EMPTY_PATH;
+	int *fds, fd_from, rc = 0;
+	size_t i, nfds = 0;
+
+	assert(cxt);
+	assert(nattached);
+
+	*nattached = 0;
+	if (recursive)
+		oflg |= AT_RECURSIVE;
+
+	fds = malloc(ntargets * sizeof(int));
+	if (!fds)
+		return -ENOMEM;
+
+	DBG(HOOK, ul_debugobj(cxt, "clone %s to %zu targets%s", from, ntargets,
+				recursive ? " (recursive)" : ""));
+
+	fd_from = open_tree(AT_FDCWD, from, OPEN_TREE_CLOEXEC);
+	set_syscall_status(cxt, "open_tree", fd_from >= 0);
+	if (fd_from < 0) {
+		rc = -errno;
+		goto done;
+	}
+
+	for (nfds = 0; nfds < ntargets; nfds++) {
+		fds[nfds] = open_tree(fd_from, "", oflg);
+		if (fds[nfds] < 0) {
+			set_syscall_status(cxt, "open_tree", 0);
+			rc = -errno;
+			goto done;
+		}
+	}
+
+	for (i = 0; i < ntargets; i++) {
+		DBG(HOOK, ul_debugobj(cxt, " move_mount(to=%s)", targets[i]));
+		rc = move_mount(fds[i], "", AT_FDCWD, targets[i],
+				MOVE_MOUNT_F_EMPTY_PATH);
+		set_syscall_status(cxt, "move_mount", rc == 0);
+		if (rc) {
+			rc = -errno;
+			break;
+		}
+		(*nattached)++;
+	}
+done:
+	for (i = 0; i < nfds; i++)
+		close(fds[i]);
+	if (fd_from >= 0)
+		close(fd_from);
+	free(fds);
+	return rc;
+}
+
 static inline int fsopen_is_supported(void)
 {
 	int dummy, rc = 1;
@@ -822,4 +888,19 @@ const struct libmnt_hookset hookset_mount =
 
 	.deinit = hookset_deinit
 };
+
+#else /* !USE_LIBMOUNT_MOUNTFD_SUPPORT */
+
+int mnt_context_clone_mount(
+		struct libmnt_context *cxt __attribute__((__unused__)),
+		const char *from __attribute__((__unused__)),
+		char *const *targets __attribute__((__unused__)),
+		size_t ntargets __attribute__((__unused__)),
+		int recursive __attribute__((__unused__)),
+		size_t *nattached)
+{
+	*nattached = 0;
+	return -ENOSYS;
+}
+
 #endif /* USE_LIBMOUNT_MOUNTFD_SUPPORT */
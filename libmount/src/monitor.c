@@ -867,6 +867,308 @@ int mnt_monitor_event_cleanup(struct libmnt_monitor *mn)
 	return rc < 0 ? rc : 0;
 }
 
+/*
+ * mnt_monitor_update_table() private stuff
+ */
+struct monitor_idx {
+	uint64_t		id;
+	struct libmnt_fs	*fs;
+};
+
+static int cmp_monitor_idx(const void *a, const void *b)
+{
+	const struct monitor_idx *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id ? 1 : 0;
+}
+
+static inline int nullstr_differ(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a != b;
+	return strcmp(a, b) != 0;
+}
+
+/*
+ * Compares old and new version of the same mount node. The STATMOUNT_*
+ * @mask specifies the fields to compare.
+ *
+ * Returns: MNT_TABDIFF_* or 0 if not modified.
+ */
+static int monitor_fs_changed(struct libmnt_fs *o, struct libmnt_fs *n, uint64_t mask)
+{
+	if ((mask & STATMOUNT_MNT_POINT)
+	    && nullstr_differ(mnt_fs_get_target(o), mnt_fs_get_target(n)))
+		return MNT_TABDIFF_MOVE;
+
+	if ((mask & STATMOUNT_MNT_OPTS)
+	    && (nullstr_differ(mnt_fs_get_vfs_options(o), mnt_fs_get_vfs_options(n))
+		|| nullstr_differ(mnt_fs_get_fs_options(o), mnt_fs_get_fs_options(n))))
+		return MNT_TABDIFF_REMOUNT;
+
+	if ((mask & STATMOUNT_PROPAGATE_FROM)
+	    && nullstr_differ(mnt_fs_get_optional_fields(o), mnt_fs_get_optional_fields(n)))
+		return MNT_TABDIFF_PROPAGATION;
+	return 0;
+}
+
+/* the old mountinfo IDs are reused by kernel, check it's still the same node */
+static int monitor_fs_is_same(struct libmnt_fs *o, struct libmnt_fs *n)
+{
+	return mnt_fs_get_devno(o) == mnt_fs_get_devno(n)
+		&& !nullstr_differ(mnt_fs_get_root(o), mnt_fs_get_root(n))
+		&& !nullstr_differ(mnt_fs_get_source(o), mnt_fs_get_source(n));
+}
+
+static struct monitor_idx *monitor_table_index(struct libmnt_table *tb,
+					       int uniq, size_t *nents)
+{
+	struct monitor_idx *idx;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t n = 0;
+
+	idx = malloc((mnt_table_get_nents(tb) + 1) * sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		idx[n].id = uniq ? mnt_fs_get_uniq_id(fs) : (uint64_t) mnt_fs_get_id(fs);
+		idx[n].fs = fs;
+		n++;
+	}
+	qsort(idx, n, sizeof(*idx), cmp_monitor_idx);
+	*nents = n;
+	return idx;
+}
+
+static int monitor_apply_change(struct libmnt_table *tb,
+				struct libmnt_fs *old, struct libmnt_fs *new,
+				int change,
+				int (*cb)(struct libmnt_table *, struct libmnt_fs *,
+					  struct libmnt_fs *, int, void *),
+				void *data)
+{
+	int rc = 0;
+
+	DBG(MONITOR, ul_debug("table update: %s %s [change=%d]",
+				mnt_fs_get_source(new ? new : old),
+				mnt_fs_get_target(new ? new : old), change));
+
+	/* keep the old filesystem for the callback */
+	mnt_ref_fs(old);
+
+	if (new && new->tab)
+		rc = mnt_table_move_fs(new->tab, tb, 0, old, new);
+	else if (new) {
+		rc = mnt_table_insert_fs(tb, 0, old, new);
+		mnt_unref_fs(new);
+	}
+	if (!rc && old)
+		rc = mnt_table_remove_fs(tb, old);
+	if (!rc && cb)
+		rc = cb(tb, old, new, change, data);
+
+	mnt_unref_fs(old);
+	return rc;
+}
+
+/* listmount() based update, @tb is from mnt_table_fetch_listmount() */
+static int monitor_update_listmount(struct libmnt_table *tb,
+				    uint64_t *ids, size_t nids,
+				    int (*cb)(struct libmnt_table *, struct libmnt_fs *,
+					      struct libmnt_fs *, int, void *),
+				    void *data)
+{
+	struct monitor_idx *idx;
+	size_t i = 0, o = 0, nold = 0;
+	int rc = 0, nchanges = 0;
+
+	idx = monitor_table_index(tb, 1, &nold);
+	if (!idx)
+		return -ENOMEM;
+
+	while (rc >= 0 && (i < nids || o < nold)) {
+		struct libmnt_fs *old = NULL, *new = NULL;
+		int change = 0;
+
+		if (o < nold && (i == nids || idx[o].id < ids[i])) {
+			old = idx[o++].fs;
+			change = MNT_TABDIFF_UMOUNT;
+
+		} else if (i < nids && (o == nold || ids[i] < idx[o].id)) {
+			rc = __mnt_table_new_listmount_fs(tb, ids[i++], &new);
+			if (rc)
+				continue;	/* filtered out or error */
+			change = MNT_TABDIFF_MOUNT;
+		} else {
+			/* The items not fetched yet will be fetched later and
+			 * up to date. Compare only the already fetched items. */
+			uint64_t mask;
+
+			old = idx[o++].fs;
+			i++;
+			mask = ~old->stmnt_todo & MNT_STMNT_ALL;
+			if (!(mask & (STATMOUNT_MNT_POINT | STATMOUNT_MNT_OPTS |
+				      STATMOUNT_PROPAGATE_FROM)))
+				continue;
+
+			rc = __mnt_table_new_listmount_fs(tb, old->uniq_id, &new);
+			if (rc == 1) {
+				rc = 0;
+				change = MNT_TABDIFF_UMOUNT;
+			} else if (rc == 0)
+				change = monitor_fs_changed(old, new, mask);
+			if (!change) {
+				mnt_unref_fs(new);
+				continue;
+			}
+		}
+		if (rc >= 0)
+			rc = monitor_apply_change(tb, old, new, change, cb, data);
+		if (rc >= 0)
+			nchanges++;
+	}
+
+	free(idx);
+	return rc < 0 ? rc : nchanges;
+}
+
+/* mountinfo based update, the filesystems are compared by mount IDs */
+static int monitor_update_mountinfo(struct libmnt_table *tb,
+				    int (*cb)(struct libmnt_table *, struct libmnt_fs *,
+					      struct libmnt_fs *, int, void *),
+				    void *data)
+{
+	struct libmnt_table *nt;
+	struct monitor_idx *idx = NULL, *nidx = NULL;
+	size_t i = 0, o = 0, nold = 0, nnew = 0;
+	int rc, nchanges = 0;
+
+	nt = mnt_new_table();
+	if (!nt)
+		return -ENOMEM;
+
+	mnt_table_enable_lazy_parsing(nt, 1);
+	mnt_table_enable_noautofs(nt, tb->noautofs);
+	mnt_table_set_parser_fltrcb(nt, tb->fltrcb, tb->fltrcb_data);
+	mnt_table_set_cache(nt, mnt_table_get_cache(tb));
+
+	rc = mnt_table_parse_mtab(nt, NULL);
+	if (rc)
+		goto done;
+
+	rc = -ENOMEM;
+	idx = monitor_table_index(tb, 0, &nold);
+	nidx = monitor_table_index(nt, 0, &nnew);
+	if (!idx || !nidx)
+		goto done;
+	rc = 0;
+
+	while (rc >= 0 && (i < nnew || o < nold)) {
+		struct libmnt_fs *old = NULL, *new = NULL;
+		int change;
+
+		if (o < nold && (i == nnew || idx[o].id < nidx[i].id)) {
+			old = idx[o++].fs;
+			change = MNT_TABDIFF_UMOUNT;
+
+		} else if (i < nnew && (o == nold || nidx[i].id < idx[o].id)) {
+			new = nidx[i++].fs;
+			change = MNT_TABDIFF_MOUNT;
+
+		} else {
+			old = idx[o++].fs;
+			new = nidx[i++].fs;
+
+			if (!monitor_fs_is_same(old, new)) {
+				/* reused ID, report as umount and mount */
+				rc = monitor_apply_change(tb, old, NULL,
+						MNT_TABDIFF_UMOUNT, cb, data);
+				if (rc < 0)
+					break;
+				nchanges++;
+				old = NULL;
+				change = MNT_TABDIFF_MOUNT;
+			} else {
+				change = monitor_fs_changed(old, new, MNT_STMNT_ALL);
+				if (!change)
+					continue;
+			}
+		}
+		rc = monitor_apply_change(tb, old, new, change, cb, data);
+		if (rc >= 0)
+			nchanges++;
+	}
+done:
+	free(idx);
+	free(nidx);
+	mnt_unref_table(nt);
+	return rc < 0 ? rc : nchanges;
+}
+
+/**
+ * mnt_monitor_update_table:
+ * @mn: monitor
+ * @tb: kernel mount table
+ * @cb: callback or NULL
+ * @data: callback data
+ *
+ * Updates @tb in place to be consistent with the current kernel mount table
+ * and calls @cb for each mount node change. The callback gets the old and new
+ * filesystem (the old one is NULL for MNT_TABDIFF_MOUNT and the new one is NULL
+ * for MNT_TABDIFF_UMOUNT) and the MNT_TABDIFF_* change type. The old filesystem
+ * is already removed from @tb when @cb is called. The negative return code from
+ * @cb stops the update.
+ *
+ * The table @tb has to be read by mnt_table_parse_mtab() or
+ * mnt_table_parse_mountinfo() (maybe empty).
+ *
+ * If @tb is based on listmount() (see mnt_table_enable_listmount()) then only
+ * the list of the mount IDs is read from kernel, the added filesystems are read
+ * on demand and the already used filesystems are re-read by statmount()
+ * to detect changes. Otherwise the mount table is parsed from mountinfo and
+ * compared with @tb by mount IDs.
+ *
+ * The function is designed to be called after a kernel event from
+ * mnt_monitor_next_change().
+ *
+ * Returns: number of changes or negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_monitor_update_table(struct libmnt_monitor *mn, struct libmnt_table *tb,
+			int (*cb)(struct libmnt_table *tb, struct libmnt_fs *old,
+				  struct libmnt_fs *new, int change, void *data),
+			void *data)
+{
+	int rc;
+
+	if (!mn || !tb)
+		return -EINVAL;
+
+	DBG(MONITOR, ul_debugobj(mn, "updating table %p", tb));
+
+	if (tb->lsmnt) {
+		uint64_t *ids = NULL;
+		ssize_t n = __mnt_listmount_ids(&ids);
+
+		if (n >= 0) {
+			rc = monitor_update_listmount(tb, ids, n, cb, data);
+			free(ids);
+			goto done;
+		}
+		if (n != -ENOSYS)
+			return (int) n;
+	}
+
+	rc = monitor_update_mountinfo(tb, cb, data);
+done:
+	DBG(MONITOR, ul_debugobj(mn, "table updated [rc=%d]", rc));
+	return rc;
+}
+
 #ifdef TEST_PROGRAM
 
 static struct libmnt_monitor *create_test_monitor(int argc, char *argv[])
@@ -1012,12 +1314,78 @@ static int test_wait(struct libmnt_test *ts __attribute__((unused)),
 	return 0;
 }
 
+static int test_update_cb(struct libmnt_table *tb __attribute__((unused)),
+			  struct libmnt_fs *old, struct libmnt_fs *new,
+			  int change, void *data __attribute__((unused)))
+{
+	static const char *const names[] = {
+		[MNT_TABDIFF_MOUNT]	  = "mount",
+		[MNT_TABDIFF_UMOUNT]	  = "umount",
+		[MNT_TABDIFF_MOVE]	  = "move",
+		[MNT_TABDIFF_REMOUNT]	  = "remount",
+		[MNT_TABDIFF_PROPAGATION] = "propagation"
+	};
+	struct libmnt_fs *fs = new ? new : old;
+
+	printf(" %-11s %s on %s (%s)\n", names[change],
+			mnt_fs_get_source(fs), mnt_fs_get_target(fs),
+			mnt_fs_get_options(fs));
+	return 0;
+}
+
+/*
+ * keep mount table up to date
+ */
+static int test_update(struct libmnt_test *ts __attribute__((unused)),
+		       int argc, char *argv[])
+{
+	struct libmnt_monitor *mn = NULL;
+	struct libmnt_table *tb = NULL;
+	int rc = -1;
+
+	mn = mnt_new_monitor();
+	tb = mnt_new_table();
+	if (!mn || !tb)
+		goto done;
+	if (argc > 1 && strcmp(argv[1], "listmount") == 0)
+		mnt_table_enable_listmount(tb, 1);
+	else
+		mnt_table_enable_lazy_parsing(tb, 1);
+
+	if (mnt_monitor_enable_kernel(mn, TRUE) ||
+	    mnt_table_parse_mtab(tb, NULL)) {
+		warn("failed to initialize monitor or table");
+		goto done;
+	}
+
+	printf("%d filesystems, waiting for changes...\n", mnt_table_get_nents(tb));
+	while (mnt_monitor_wait(mn, -1) > 0) {
+		int type = 0;
+
+		while (mnt_monitor_next_change(mn, NULL, &type) == 0) {
+			if (type != MNT_MONITOR_TYPE_KERNEL)
+				continue;
+			rc = mnt_monitor_update_table(mn, tb, test_update_cb, NULL);
+			if (rc < 0)
+				goto done;
+			printf("%d changes, %d filesystems\n", rc,
+					mnt_table_get_nents(tb));
+		}
+	}
+	rc = 0;
+done:
+	mnt_unref_table(tb);
+	mnt_unref_monitor(mn);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--epoll", test_epoll, "<userspace kernel veil ...>  monitor in epoll" },
 		{ "--epoll-clean", test_epoll_cleanup, "<userspace kernel veil ...>  monitor in epoll and clean events" },
 		{ "--wait",  test_wait,  "<userspace kernel veil ...>  monitor wait function" },
+		{ "--update", test_update, "[listmount]  keep kernel mount table up to date" },
 		{ NULL }
 	};
 
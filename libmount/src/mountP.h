@@ -29,6 +29,7 @@
 #include "debug.h"
 #include "buffer.h"
 #include "libmount.h"
+#include "mount-api-utils.h"
 
 /*
  * Debug
@@ -99,6 +100,10 @@ extern int mnt_run_test(struct libmnt_test *tests, int argc, char *argv[]);
 /* utils.c */
 extern int mnt_valid_tagname(const char *tagname);
 
+#define FNV_INIT	2166136261U
+#define fnv_add(h, c)	(((h) ^ (unsigned char) (c)) * 16777619U)
+extern size_t mnt_hash_path(const char *path);
+
 extern const char *mnt_statfs_get_fstype(struct statfs *vfs);
 extern int is_file_empty(const char *name);
 
@@ -121,6 +126,9 @@ extern int mnt_open_uniq_filename(const char *filename, char **name);
 
 extern int mnt_has_regular_utab(const char **utab, int *writable);
 extern const char *mnt_get_utab_path(void);
+extern char *mnt_get_utab_dir(const char *utab);
+extern int mnt_is_utab_fragment(const char *name);
+extern int mnt_is_utab_empty(const char *utab);
 
 extern int mnt_get_filesystems(char ***filesystems, const char *pattern);
 extern void mnt_free_filesystems(char **filesystems);
@@ -185,6 +193,45 @@ struct libmnt_iter {
 	} while(0)
 
 
+/*
+ * libmnt_table lookup indexes, built on demand (see tab.c)
+ */
+enum {
+	MNT_TABIDX_ID = 0,
+	MNT_TABIDX_PARENT,
+	MNT_TABIDX_TARGET,
+	MNT_TABIDX_DEVNO,
+
+	MNT_TABIDX_NR
+};
+
+/*
+ * Lazy mountinfo parsing (see mnt_table_enable_lazy_parsing()); the line is
+ * split to fields in place and shared by all copies of the filesystem.
+ */
+enum {
+	MNT_LZ_ROOT = 0,
+	MNT_LZ_TARGET,
+	MNT_LZ_VFSOPTS,
+	MNT_LZ_OPTFIELDS,
+	MNT_LZ_FSTYPE,
+	MNT_LZ_SOURCE,
+	MNT_LZ_FSOPTS,
+
+	MNT_LZ_NFIELDS
+};
+
+struct libmnt_lzline {
+	int	refcount;
+	char	data[];
+};
+
+static inline void mnt_unref_lzline(struct libmnt_lzline *ln)
+{
+	if (ln && --ln->refcount <= 0)
+		free(ln);
+}
+
 /*
  * This struct represents one entry in a fstab/mountinfo file.
  * (note that fstab[1] means the first column from fstab, and so on...)
@@ -202,6 +249,16 @@ struct libmnt_fs {
 	int		parent;		/* mountinfo[2]: parent */
 	dev_t		devno;		/* mountinfo[3]: st_dev */
 
+	uint64_t	uniq_id;	/* statmount(): unique 64-bit mount ID */
+	uint64_t	uniq_parent;	/* statmount(): unique 64-bit parent ID */
+	uint64_t	stmnt_todo;	/* STATMOUNT_* not fetched yet */
+
+	struct libmnt_fs *idxnext[MNT_TABIDX_NR];	/* tab.c: index hash chains */
+
+	struct libmnt_lzline *lzline;	/* lazy parsing: mountinfo line copy */
+	unsigned int	lzoff[MNT_LZ_NFIELDS];	/* lazy parsing: fields offsets */
+	uint64_t	lazy_todo;	/* STATMOUNT_* not decoded yet */
+
 	char		*bindsrc;	/* utab, full path from fstab[1] for bind mounts */
 
 	char		*source;	/* fstab[1], mountinfo[10], swaps[1]:
@@ -246,6 +303,14 @@ struct libmnt_fs {
 #define MNT_FS_KERNEL	(1 << 4) /* data from /proc/{mounts,self/mountinfo} */
 #define MNT_FS_MERGED	(1 << 5) /* already merged data from /run/mount/utab */
 
+/*
+ * btrfs default subvolume ID cached in the table, per source device
+ */
+struct btrfs_default_id {
+	char		*source;
+	uint64_t	id;
+};
+
 /*
  * fstab/mountinfo file
  */
@@ -266,12 +331,55 @@ struct libmnt_table {
 	void		*fltrcb_data;
 
 	int		noautofs;	/* ignore autofs mounts */
+	int		lsmnt;		/* use listmount() rather than mountinfo */
+	int		lazy;		/* decode mountinfo fields on demand */
+
+	struct libmnt_fs **idx[MNT_TABIDX_NR];	/* lookup hash tables or NULL */
+	size_t		idxsz[MNT_TABIDX_NR];	/* number of buckets (power of 2) */
+
+	struct btrfs_default_id *btrfs_ids;	/* see get_btrfs_default_id() */
+	size_t		nbtrfs_ids;
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt, int empty_for_enoent);
+extern int __mnt_table_parse_utab(struct libmnt_table *tb, const char *utab);
+extern void __mnt_table_reset_index(struct libmnt_table *tb, int type);
+extern struct libmnt_fs *__mnt_table_find_id(struct libmnt_table *tb, int id);
+
+/* tab_listmount.c */
+#define MNT_STMNT_ALL	(STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC | \
+			 STATMOUNT_PROPAGATE_FROM | STATMOUNT_MNT_ROOT | \
+			 STATMOUNT_MNT_POINT | STATMOUNT_FS_TYPE | \
+			 STATMOUNT_MNT_OPTS | STATMOUNT_SB_SOURCE)
+/* mask for mnt_fs_get_options() and mnt_fs_get_{vfs,fs}_options() */
+#define MNT_STMNT_OPTS	(STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC | \
+			 STATMOUNT_MNT_OPTS)
+
+extern int __mnt_fs_fetch_statmount(struct libmnt_fs *fs, uint64_t mask);
+extern ssize_t __mnt_listmount_ids(uint64_t **ids);
+extern int __mnt_table_new_listmount_fs(struct libmnt_table *tb, uint64_t id,
+					struct libmnt_fs **res);
+
+/* tab_parse.c */
+extern int __mnt_fs_decode_mountinfo(struct libmnt_fs *fs, uint64_t mask);
+
+/*
+ * The filesystems from mnt_table_fetch_listmount() or from lazy mountinfo
+ * parser are filled on demand, the libmnt_fs getters call this before the
+ * struct member is used. The STATMOUNT_* masks address the fields.
+ */
+static inline void mnt_fs_fetch_fields(struct libmnt_fs *fs, uint64_t mask)
+{
+	if (!fs)
+		return;
+	if (fs->lazy_todo & mask)
+		__mnt_fs_decode_mountinfo(fs, fs->lazy_todo & mask);
+	if (fs->stmnt_todo & mask)
+		__mnt_fs_fetch_statmount(fs, fs->stmnt_todo & mask);
+}
 
 /*
  * Tab file format
@@ -329,6 +437,10 @@ extern const struct libmnt_hookset hookset_selinux;
 #endif
 
 extern int mnt_context_deinit_hooksets(struct libmnt_context *cxt);
+extern void mnt_context_free_userns_cache(struct libmnt_context *cxt);
+extern int mnt_context_clone_mount(struct libmnt_context *cxt, const char *from,
+			char *const *targets, size_t ntargets,
+			int recursive, size_t *nattached);
 extern const struct libmnt_hookset *mnt_context_get_hookset(struct libmnt_context *cxt, const char *name);
 
 extern int mnt_context_set_hookset_data(struct libmnt_context *cxt,
@@ -373,6 +485,17 @@ struct libmnt_ns {
 	struct libmnt_cache *cache;	/* paths cache associated with NS */
 };
 
+/*
+ * "mount -a --fork" child
+ */
+struct libmnt_child {
+	pid_t	pid;
+	char	*target;	/* mountpoint mounted by the child */
+
+	unsigned int	done : 1,	/* already reaped */
+			failed : 1;	/* non-zero exit status */
+};
+
 /*
  * Mount context -- high-level API
  */
@@ -426,8 +549,10 @@ struct libmnt_context
 	int	helper_status;	/* helper wait(2) status */
 	int	helper_exec_status; /* 1: not called yet, 0: success, <0: -errno */
 
-	pid_t	*children;	/* "mount -a --fork" PIDs */
+	struct libmnt_child *children;	/* "mount -a --fork" children */
 	int	nchildren;	/* number of children */
+	int	nrunning;	/* number of not yet reaped children */
+	int	maxchildren;	/* max running children, 0 = unlimited */
 	pid_t	pid;		/* 0=parent; PID=child */
 
 	int	syscall_status;	/* 1: not called yet, 0: success, <0: -errno */
@@ -437,13 +562,24 @@ struct libmnt_context
 	struct libmnt_ns	ns_tgt;		/* target namespace */
 	struct libmnt_ns	*ns_cur;	/* pointer to current namespace */
 
+	int		mountinfo_fd;	/* POLLPRI on changes, for tables cache */
+	struct stat	utab_st;	/* utab status when mountinfo parsed */
+	struct stat	fstab_st;	/* fstab status when parsed */
+
 	unsigned int	enabled_textdomain : 1;	/* bindtextdomain() called */
 	unsigned int	noautofs : 1;		/* ignore autofs mounts */
 	unsigned int	has_selinux_opt : 1;	/* temporary for broken fsconfig() syscall */
 	unsigned int    force_clone : 1;	/* OPEN_TREE_CLONE */
+	unsigned int	tables_cache : 1;	/* keep tables between operations */
+	unsigned int	mountinfo_partial : 1;	/* filtered mountinfo, don't cache */
+	unsigned int	mountinfo_check : 1;	/* verify cached mountinfo */
+	unsigned int	fstab_parsed : 1;	/* fstab read by context */
+	unsigned int	fstab_check : 1;	/* verify cached fstab */
 
 	struct list_head	hooksets_datas;	/* global hooksets data */
 	struct list_head	hooksets_hooks;	/* global hooksets data */
+
+	struct list_head	userns_cache;	/* X-mount.idmap= namespaces */
 };
 
 /* flags */
@@ -614,6 +750,8 @@ extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 			__attribute__((nonnull(1)));
+extern int __mnt_fs_set_options_ptr(struct libmnt_fs *fs, char *optstr)
+			__attribute__((nonnull(1)));
 
 /* context.c */
 extern struct libmnt_context *mnt_copy_context(struct libmnt_context *o);
@@ -643,7 +781,7 @@ extern int mnt_context_propagation_only(struct libmnt_context *cxt)
 
 extern int mnt_context_delete_loopdev(struct libmnt_context *cxt);
 
-extern int mnt_fork_context(struct libmnt_context *cxt);
+extern int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs);
 
 extern int mnt_context_set_tabfilter(struct libmnt_context *cxt,
 				     int (*fltr)(struct libmnt_fs *, void *),
@@ -666,6 +804,10 @@ extern struct libmnt_optlist *mnt_context_get_optlist(struct libmnt_context *cxt
 extern int mnt_update_emit_event(struct libmnt_update *upd);
 extern int mnt_update_set_filename(struct libmnt_update *upd, const char *filename);
 extern int mnt_update_already_done(struct libmnt_update *upd);
+extern int mnt_update_remove_targets(struct libmnt_update *upd, struct libmnt_lock *lc,
+				     char *const *targets, size_t ntargets);
+extern int mnt_update_add_targets(struct libmnt_update *upd, struct libmnt_lock *lc,
+				  char *const *targets, size_t ntargets);
 extern int mnt_update_start(struct libmnt_update *upd);
 extern int mnt_update_end(struct libmnt_update *upd);
 
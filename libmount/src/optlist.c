@@ -96,6 +96,18 @@ void mnt_ref_optlist(struct libmnt_optlist *ls)
 		ls->refcount++;
 }
 
+static void copy_cache(struct optlist_cache *to, const struct optlist_cache *from)
+{
+	to->flags = from->flags;
+	to->flags_ready = from->flags_ready;
+
+	if (from->optstr_ready) {
+		/* the cache is optional, ignore ENOMEM */
+		to->optstr = from->optstr ? strdup(from->optstr) : NULL;
+		to->optstr_ready = to->optstr || !from->optstr;
+	}
+}
+
 static void reset_cache(struct optlist_cache *cache)
 {
 	if (!cache || (cache->flags_ready == 0 && cache->optstr_ready == 0))
@@ -1047,6 +1059,13 @@ struct libmnt_optlist *mnt_copy_optlist(struct libmnt_optlist *ls)
 	}
 
 	n->merged = ls->merged;
+
+	/* the options are the same, keep already generated flags and strings */
+	for (i = 0; i < ARRAY_SIZE(ls->cache_mapped); i++)
+		copy_cache(&n->cache_mapped[i], &ls->cache_mapped[i]);
+	for (i = 0; i < __MNT_OL_FLTR_COUNT; i++)
+		copy_cache(&n->cache_all[i], &ls->cache_all[i]);
+
 	return n;
 }
 
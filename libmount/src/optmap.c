@@ -199,6 +199,121 @@ static const struct libmnt_optmap userspace_opts_map[] =
    { NULL, 0, 0 }
 };
 
+/*
+ * Hash indexes for the built-in maps. The maps are static, but depend on
+ * #ifdefs, so the indexes are initialized when the library is loaded.
+ */
+#define OPTMAP_IDXSZ	256	/* power of 2, greater than number of entries */
+#define OPTMAP_MAXPREFIXES 4
+
+struct optmap_index {
+	const struct libmnt_optmap	*map;
+	const struct libmnt_optmap	*slots[OPTMAP_IDXSZ];
+	const struct libmnt_optmap	*prefixes[OPTMAP_MAXPREFIXES + 1];
+	unsigned int			ready : 1;
+};
+
+static struct optmap_index builtin_indexes[] = {
+	{ .map = linux_flags_map },
+	{ .map = userspace_opts_map }
+};
+
+/* option name without "=" or "[=]" */
+static inline size_t optmap_entry_namesz(const struct libmnt_optmap *ent)
+{
+	return strcspn(ent->name, "=[");
+}
+
+static size_t optmap_hash(const char *name, size_t namesz)
+{
+	size_t i, h = FNV_INIT;
+
+	for (i = 0; i < namesz; i++)
+		h = fnv_add(h, name[i]);
+	return h & (OPTMAP_IDXSZ - 1);
+}
+
+static int init_optmap_index(struct optmap_index *idx)
+{
+	const struct libmnt_optmap *ent;
+	size_t nprefixes = 0, nents = 0;
+
+	for (ent = idx->map; ent->name; ent++) {
+		size_t sz, h;
+
+		if (ent->mask & MNT_PREFIX) {
+			if (nprefixes == OPTMAP_MAXPREFIXES)
+				return -1;
+			idx->prefixes[nprefixes++] = ent;
+			continue;
+		}
+		if (++nents == OPTMAP_IDXSZ)
+			return -1;
+
+		sz = optmap_entry_namesz(ent);
+		h = optmap_hash(ent->name, sz);
+
+		while (idx->slots[h]) {
+			const struct libmnt_optmap *x = idx->slots[h];
+
+			/* the first entry wins, like for the linear search */
+			if (optmap_entry_namesz(x) == sz
+			    && strncmp(x->name, ent->name, sz) == 0)
+				break;
+			h = (h + 1) & (OPTMAP_IDXSZ - 1);
+		}
+		if (!idx->slots[h])
+			idx->slots[h] = ent;
+	}
+	return 0;
+}
+
+static void __attribute__ ((constructor)) init_builtin_optmap_indexes(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(builtin_indexes); i++) {
+		if (init_optmap_index(&builtin_indexes[i]) == 0)
+			builtin_indexes[i].ready = 1;
+	}
+}
+
+static const struct optmap_index *get_optmap_index(const struct libmnt_optmap *map)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(builtin_indexes); i++) {
+		if (builtin_indexes[i].map == map)
+			return builtin_indexes[i].ready ? &builtin_indexes[i] : NULL;
+	}
+	return NULL;
+}
+
+static const struct libmnt_optmap *optmap_index_lookup(
+				const struct optmap_index *idx,
+				const char *name, size_t namelen)
+{
+	const struct libmnt_optmap *ent;
+	const struct libmnt_optmap * const *pfx;
+	size_t h = optmap_hash(name, namelen);
+
+	while ((ent = idx->slots[h])) {
+		if (optmap_entry_namesz(ent) == namelen
+		    && strncmp(ent->name, name, namelen) == 0)
+			break;
+		h = (h + 1) & (OPTMAP_IDXSZ - 1);
+	}
+
+	/* prefix entries are used if defined before the matching entry */
+	for (pfx = idx->prefixes; *pfx; pfx++) {
+		if (ent && *pfx > ent)
+			break;
+		if (startswith(name, (*pfx)->name))
+			return *pfx;
+	}
+	return ent;
+}
+
 /**
  * mnt_get_builtin_map:
  * @id: map id -- MNT_LINUX_MAP or MNT_USERSPACE_MAP
@@ -246,8 +361,19 @@ const struct libmnt_optmap *mnt_optmap_get_entry(
 	for (i = 0; i < nmaps; i++) {
 		const struct libmnt_optmap *map = maps[i];
 		const struct libmnt_optmap *ent;
+		const struct optmap_index *idx = get_optmap_index(map);
 		const char *p;
 
+		if (idx) {
+			ent = optmap_index_lookup(idx, name, namelen);
+			if (ent) {
+				if (mapent)
+					*mapent = ent;
+				return map;
+			}
+			continue;
+		}
+
 		for (ent = map; ent && ent->name; ent++) {
 			if (ent->mask & MNT_PREFIX) {
 				if (startswith(name, ent->name)) {
@@ -69,6 +69,126 @@ int is_mountinfo(struct libmnt_table *tb)
 	return 0;
 }
 
+/*
+ * Lookup indexes. The hash tables are built on the first lookup for tables
+ * with more than MNT_TABIDX_MINENTS entries and dropped when the table is
+ * modified. The hash chains keep the order of the table entries.
+ */
+#define MNT_TABIDX_MINENTS	32
+
+static inline size_t tabidx_hash_num(uint64_t num)
+{
+	return (size_t) (num * 0x9E3779B97F4A7C15ULL >> 16);
+}
+
+static size_t tabidx_hash_fs(struct libmnt_fs *fs, int type)
+{
+	const char *p;
+
+	switch (type) {
+	case MNT_TABIDX_ID:
+		return tabidx_hash_num(mnt_fs_get_id(fs));
+	case MNT_TABIDX_PARENT:
+		return tabidx_hash_num(mnt_fs_get_parent_id(fs));
+	case MNT_TABIDX_TARGET:
+		p = mnt_fs_get_target(fs);
+		return p ? mnt_hash_path(p) : 0;
+	case MNT_TABIDX_DEVNO:
+		return tabidx_hash_num(mnt_fs_get_devno(fs));
+	}
+	return 0;
+}
+
+void __mnt_table_reset_index(struct libmnt_table *tb, int type)
+{
+	int i;
+
+	for (i = 0; i < MNT_TABIDX_NR; i++) {
+		if (type >= 0 && i != type)
+			continue;
+		free(tb->idx[i]);
+		tb->idx[i] = NULL;
+		tb->idxsz[i] = 0;
+	}
+}
+
+/*
+ * Returns the first entry in the hash chain for @hash or NULL; @used is set
+ * to 0 if the index is not available (the table has to be searched).
+ */
+static struct libmnt_fs *tabidx_lookup(struct libmnt_table *tb, int type,
+				       size_t hash, int *used)
+{
+	*used = 0;
+
+	if (!tb->idx[type]) {
+		struct libmnt_iter itr;
+		struct libmnt_fs *fs;
+		size_t sz = 64;
+
+		if ((size_t) tb->nents < MNT_TABIDX_MINENTS)
+			return NULL;
+		while (sz < (size_t) tb->nents)
+			sz <<= 1;
+
+		tb->idx[type] = calloc(sz, sizeof(struct libmnt_fs *));
+		if (!tb->idx[type])
+			return NULL;
+		tb->idxsz[type] = sz;
+
+		DBG(TAB, ul_debugobj(tb, "building index %d [%zu buckets]", type, sz));
+
+		/* backward + insert to head = chains in the table order */
+		mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
+		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			size_t h = tabidx_hash_fs(fs, type) & (sz - 1);
+
+			fs->idxnext[type] = tb->idx[type][h];
+			tb->idx[type][h] = fs;
+		}
+	}
+
+	*used = 1;
+	return tb->idx[type][hash & (tb->idxsz[type] - 1)];
+}
+
+/* find by number (ID, parent ID or devno) in the index */
+static struct libmnt_fs *tabidx_find_num(struct libmnt_table *tb, int type,
+					 uint64_t num, int direction, int *used)
+{
+	struct libmnt_fs *fs, *res = NULL;
+
+	for (fs = tabidx_lookup(tb, type, tabidx_hash_num(num), used);
+	     fs; fs = fs->idxnext[type]) {
+		uint64_t x = type == MNT_TABIDX_ID ? (uint64_t) mnt_fs_get_id(fs) :
+			     type == MNT_TABIDX_PARENT ? (uint64_t) mnt_fs_get_parent_id(fs) :
+			     (uint64_t) mnt_fs_get_devno(fs);
+		if (x != num)
+			continue;
+		res = fs;
+		if (direction == MNT_ITER_FORWARD)
+			break;
+	}
+	return res;
+}
+
+/* find by target in the index */
+static struct libmnt_fs *tabidx_find_target(struct libmnt_table *tb, const char *path,
+					    int direction, int *used)
+{
+	struct libmnt_fs *fs, *res = NULL;
+
+	for (fs = tabidx_lookup(tb, MNT_TABIDX_TARGET, mnt_hash_path(path), used);
+	     fs; fs = fs->idxnext[MNT_TABIDX_TARGET]) {
+		if (!mnt_fs_streq_target(fs, path))
+			continue;
+		res = fs;
+		if (direction == MNT_ITER_FORWARD)
+			break;
+	}
+	return res;
+}
+
 /**
  * mnt_new_table:
  *
@@ -115,6 +235,11 @@ int mnt_reset_table(struct libmnt_table *tb)
 		mnt_table_remove_fs(tb, fs);
 	}
 
+	while (tb->nbtrfs_ids > 0)
+		free(tb->btrfs_ids[--tb->nbtrfs_ids].source);
+	free(tb->btrfs_ids);
+	tb->btrfs_ids = NULL;
+
 	tb->nents = 0;
 	return 0;
 }
@@ -169,6 +294,7 @@ void mnt_free_table(struct libmnt_table *tb)
 	mnt_reset_table(tb);
 	DBG(TAB, ul_debugobj(tb, "free [refcount=%d]", tb->refcount));
 
+	__mnt_table_reset_index(tb, -1);
 	mnt_unref_cache(tb->cache);
 	free(tb->comm_intro);
 	free(tb->comm_tail);
@@ -452,6 +578,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_add_tail(&fs->ents, &tb->ents);
 	fs->tab = tb;
 	tb->nents++;
+	__mnt_table_reset_index(tb, -1);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -471,6 +598,7 @@ static int __table_insert_fs(
 
 	fs->tab = tb;
 	tb->nents++;
+	__mnt_table_reset_index(tb, -1);
 
 	DBG(TAB, ul_debugobj(tb, "insert entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -542,6 +670,7 @@ int mnt_table_move_fs(struct libmnt_table *src, struct libmnt_table *dst,
 	/* remove from source */
 	list_del_init(&fs->ents);
 	src->nents--;
+	__mnt_table_reset_index(src, -1);
 
 	/* insert to the destination */
 	return __table_insert_fs(dst, before, pos, fs);
@@ -569,24 +698,35 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	mnt_unref_fs(fs);
 	tb->nents--;
+	__mnt_table_reset_index(tb, -1);
 	return 0;
 }
 
-static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
+/* returns the first entry with mount @id */
+struct libmnt_fs *__mnt_table_find_id(struct libmnt_table *tb, int id)
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *x;
-	int parent_id = mnt_fs_get_parent_id(fs);
+	int used;
+
+	x = tabidx_find_num(tb, MNT_TABIDX_ID, id, MNT_ITER_FORWARD, &used);
+	if (used)
+		return x;
 
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while (mnt_table_next_fs(tb, &itr, &x) == 0) {
-		if (mnt_fs_get_id(x) == parent_id)
+		if (mnt_fs_get_id(x) == id)
 			return x;
 	}
 
 	return NULL;
 }
 
+static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	return __mnt_table_find_id(tb, mnt_fs_get_parent_id(fs));
+}
+
 /**
  * mnt_table_get_root_fs:
  * @tb: mountinfo file (/proc/self/mountinfo)
@@ -660,7 +800,7 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 {
 	struct libmnt_fs *fs, *chfs = NULL;
 	int parent_id, lastchld_id = 0, chld_id = 0;
-	int direction;
+	int direction, used;
 
 	if (!tb || !itr || !parent || !is_mountinfo(tb))
 		return -EINVAL;
@@ -678,18 +818,23 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 	}
 
 	mnt_reset_iter(itr, direction);
-	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+
+	fs = tabidx_lookup(tb, MNT_TABIDX_PARENT, tabidx_hash_num(parent_id), &used);
+	if (!used && mnt_table_next_fs(tb, itr, &fs) != 0)
+		fs = NULL;
+
+	while (fs) {
 		int id;
 
 		if (mnt_fs_get_parent_id(fs) != parent_id)
-			continue;
+			goto next;
 
 		id = mnt_fs_get_id(fs);
 
 		/* avoid an infinite loop. This only happens in rare cases
 		 * such as in early userspace when the rootfs is its own parent */
 		if (id == parent_id)
-			continue;
+			goto next;
 
 		if (direction == MNT_ITER_FORWARD) {
 			/* return in the order of mounting */
@@ -706,6 +851,11 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 				chld_id = id;
 			}
 		}
+next:
+		if (used)
+			fs = fs->idxnext[MNT_TABIDX_PARENT];
+		else if (mnt_table_next_fs(tb, itr, &fs) != 0)
+			fs = NULL;
 	}
 
 	if (chld)
@@ -749,7 +899,7 @@ int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
-	int id;
+	int id, used;
 	const char *tgt;
 
 	if (!tb || !parent || !is_mountinfo(tb))
@@ -762,6 +912,19 @@ int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 	id = mnt_fs_get_id(parent);
 	tgt = mnt_fs_get_target(parent);
 
+	fs = tabidx_lookup(tb, MNT_TABIDX_PARENT, tabidx_hash_num(id), &used);
+	if (used) {
+		for (; fs; fs = fs->idxnext[MNT_TABIDX_PARENT]) {
+			if (mnt_fs_get_parent_id(fs) == id &&
+			    mnt_fs_streq_target(fs, tgt) == 1) {
+				if (child)
+					*child = fs;
+				return 0;
+			}
+		}
+		return 1;
+	}
+
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
 		if (mnt_fs_get_parent_id(fs) == id &&
 		    mnt_fs_streq_target(fs, tgt) == 1) {
@@ -909,9 +1072,10 @@ static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (fs->parent == oldid)
+		if (mnt_fs_get_parent_id(fs) == oldid)
 			fs->parent = newid;
 	}
+	__mnt_table_reset_index(tb, MNT_TABIDX_PARENT);
 	return 0;
 }
 
@@ -1076,6 +1240,7 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
 	char *cn;
+	int used;
 
 	if (!tb || !path || !*path)
 		return NULL;
@@ -1085,23 +1250,32 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
-			return fs;
+	fs = tabidx_find_target(tb, path, direction, &used);
+	if (fs)
+		return fs;
+	if (!used) {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
 	}
 
 	/* try absolute path */
 	if (is_relative_path(path) && (cn = absolute_path(path))) {
 		DBG(TAB, ul_debugobj(tb, "lookup absolute TARGET: '%s'", cn));
-		mnt_reset_iter(&itr, direction);
-		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_target(fs, cn)) {
-				free(cn);
-				return fs;
+		fs = tabidx_find_target(tb, cn, direction, &used);
+		if (!fs && !used) {
+			mnt_reset_iter(&itr, direction);
+			while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+				if (mnt_fs_streq_target(fs, cn))
+					break;
+				fs = NULL;
 			}
 		}
 		free(cn);
+		if (fs)
+			return fs;
 	}
 
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1138,6 +1312,46 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	return NULL;
 }
 
+#ifdef HAVE_BTRFS_SUPPORT
+/*
+ * Returns the default subvolume ID of btrfs mounted on @path. All subvolumes
+ * of the filesystem share the default, so the ID is cached in @tb per @source
+ * device and the ioctl is called only once for the filesystem.
+ */
+static uint64_t get_btrfs_default_id(struct libmnt_table *tb,
+				     const char *source, const char *path)
+{
+	struct btrfs_default_id *ids;
+	uint64_t id;
+	size_t i;
+
+	if (!source)
+		return btrfs_get_default_subvol_id(path);
+
+	for (i = 0; i < tb->nbtrfs_ids; i++) {
+		if (strcmp(tb->btrfs_ids[i].source, source) == 0) {
+			DBG(BTRFS, ul_debugobj(tb, "%s: cached default subvolid %ju",
+					source, (uintmax_t) tb->btrfs_ids[i].id));
+			return tb->btrfs_ids[i].id;
+		}
+	}
+
+	id = btrfs_get_default_subvol_id(path);
+	if (id == UINT64_MAX)
+		return id;	/* error, don't cache */
+
+	ids = reallocarray(tb->btrfs_ids, tb->nbtrfs_ids + 1, sizeof(*ids));
+	if (ids) {
+		tb->btrfs_ids = ids;
+		ids[tb->nbtrfs_ids].source = strdup(source);
+		ids[tb->nbtrfs_ids].id = id;
+		if (ids[tb->nbtrfs_ids].source)
+			tb->nbtrfs_ids++;
+	}
+	return id;
+}
+#endif /* HAVE_BTRFS_SUPPORT */
+
 /**
  * mnt_table_find_srcpath:
  * @tb: tab pointer
@@ -1180,8 +1394,11 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 
 		if (mnt_fs_streq_srcpath(fs, path)) {
 #ifdef HAVE_BTRFS_SUPPORT
-			if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
-				uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
+			const char *type = mnt_fs_get_fstype(fs);
+
+			if (type && !strcmp(type, "btrfs")) {
+				uint64_t default_id = get_btrfs_default_id(tb,
+							path, mnt_fs_get_target(fs));
 				char *val;
 				size_t len;
 
@@ -1306,9 +1523,11 @@ struct libmnt_fs *mnt_table_find_tag(struct libmnt_table *tb, const char *tag,
 	/* look up by TAG */
 	mnt_reset_iter(&itr, direction);
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (fs->tagname && fs->tagval &&
-		    strcmp(fs->tagname, tag) == 0 &&
-		    strcmp(fs->tagval, val) == 0)
+		const char *t = NULL, *v = NULL;
+
+		if (mnt_fs_get_tag(fs, &t, &v) == 0 &&
+		    strcmp(t, tag) == 0 &&
+		    strcmp(v, val) == 0)
 			return fs;
 	}
 
@@ -1454,6 +1673,7 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 {
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
+	int used;
 
 	if (!tb)
 		return NULL;
@@ -1462,6 +1682,10 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	fs = tabidx_find_num(tb, MNT_TABIDX_DEVNO, devno, direction, &used);
+	if (used)
+		return fs;
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1537,9 +1761,20 @@ static int get_btrfs_fs_root(struct libmnt_table *tb, struct libmnt_fs *fs, char
 
 		DBG(BTRFS, ul_debug(" subvolid/subvol not found, checking default"));
 
-		default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-		if (default_id == UINT64_MAX)
+		target = mnt_resolve_target(mnt_fs_get_target(fs), tb->cache);
+		if (!target)
+			goto err;
+
+		/* the device mounted on the target is the cache key */
+		f = mnt_table_find_target(tb, target, MNT_ITER_BACKWARD);
+		default_id = get_btrfs_default_id(tb,
+					f ? mnt_fs_get_srcpath(f) : NULL,
+					mnt_fs_get_target(fs));
+		if (default_id == UINT64_MAX) {
+			if (!tb->cache)
+				free(target);
 			goto not_found;
+		}
 
 		/* Volume has default subvolume. Check if it matches to
 		 * the one in mountinfo.
@@ -1548,9 +1783,6 @@ static int get_btrfs_fs_root(struct libmnt_table *tb, struct libmnt_fs *fs, char
 		 * kernels, there is no reasonable way to detect which
 		 * subvolume was mounted.
 		 */
-		target = mnt_resolve_target(mnt_fs_get_target(fs), tb->cache);
-		if (!target)
-			goto err;
 
 		snprintf(default_id_str, sizeof(default_id_str), "%llu",
 				(unsigned long long int) default_id);
@@ -187,29 +187,212 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 	return 0;
 }
 
+/*
+ * The tables may be huge (thousands of container mounts), so we don't want to
+ * search in the whole table for each entry. The index is array of the entries
+ * sorted by target (slashes are ignored to be tolerant to "//" and trailing
+ * slashes), candidates from the index are verified by mnt_fs_match_*().
+ *
+ * The index is used only for tables without cache; with cache the paths are
+ * canonicalized by the match functions and the target is not usable as a key.
+ */
+struct tabdiff_idxent {
+	const char		*target;
+	struct libmnt_fs	*fs;
+	size_t			pos;
+};
+
+struct tabdiff_index {
+	struct tabdiff_idxent	*ents;
+	size_t			nents;
+};
+
+static int cmp_noslash(const char *a, const char *b)
+{
+	while (1) {
+		while (*a == '/')
+			a++;
+		while (*b == '/')
+			b++;
+		if (*a != *b || !*a)
+			return (unsigned char) *a - (unsigned char) *b;
+		a++, b++;
+	}
+}
+
+static int cmp_idxents(const void *a, const void *b)
+{
+	const struct tabdiff_idxent *x = a, *y = b;
+	int rc = cmp_noslash(x->target, y->target);
+
+	if (rc)
+		return rc;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static int tabdiff_index_table(struct tabdiff_index *idx, struct libmnt_table *tb)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t n = 0;
+
+	memset(idx, 0, sizeof(*idx));
+	if (tb->cache || tb->nents <= 0)
+		return 0;
+
+	idx->ents = calloc(tb->nents, sizeof(struct tabdiff_idxent));
+	if (!idx->ents)
+		return -ENOMEM;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0 && n < (size_t) tb->nents) {
+		const char *tgt = mnt_fs_get_target(fs);
+
+		if (!tgt)
+			continue;
+		idx->ents[n].target = tgt;
+		idx->ents[n].fs = fs;
+		idx->ents[n].pos = n;
+		n++;
+	}
+	idx->nents = n;
+
+	qsort(idx->ents, idx->nents, sizeof(struct tabdiff_idxent), cmp_idxents);
+	return 0;
+}
+
+/* the same as mnt_table_find_pair(tb, source, target, MNT_ITER_FORWARD) */
+static struct libmnt_fs *tabdiff_find_pair(struct tabdiff_index *idx,
+					   struct libmnt_table *tb,
+					   const char *source, const char *target)
+{
+	struct tabdiff_idxent *e, *res = NULL;
+	size_t lo = 0, hi;
+
+	if (!idx->ents)
+		return mnt_table_find_pair(tb, source, target, MNT_ITER_FORWARD);
+	if (!target || !*target || !source || !*source)
+		return NULL;
+
+	hi = idx->nents;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (cmp_noslash(idx->ents[mid].target, target) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (e = idx->ents + lo;
+	     e < idx->ents + idx->nents && cmp_noslash(e->target, target) == 0;
+	     e++) {
+		if (res && res->pos < e->pos)
+			continue;
+		if (mnt_fs_match_target(e->fs, target, NULL) &&
+		    mnt_fs_match_source(e->fs, source, NULL))
+			res = e;
+	}
+	return res ? res->fs : NULL;
+}
+
+/* newly mounted entries sorted by mount ID to detect moved filesystems */
+struct tabdiff_mntent {
+	int			id;
+	size_t			pos;
+	struct tabdiff_entry	*de;
+};
+
+static int cmp_mntents(const void *a, const void *b)
+{
+	const struct tabdiff_mntent *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static struct tabdiff_mntent *tabdiff_index_mounts(struct libmnt_tabdiff *df, size_t *nents)
+{
+	struct tabdiff_mntent *ents;
+	struct list_head *p;
+	size_t n = 0;
+
+	*nents = 0;
+	if (!df->nchanges)
+		return NULL;
+
+	ents = calloc(df->nchanges, sizeof(*ents));
+	if (!ents)
+		return NULL;
+
+	list_for_each(p, &df->changes) {
+		struct tabdiff_entry *de = list_entry(p, struct tabdiff_entry, changes);
+
+		if (de->oper != MNT_TABDIFF_MOUNT || !de->new_fs)
+			continue;
+		ents[n].id = mnt_fs_get_id(de->new_fs);
+		ents[n].pos = n;
+		ents[n].de = de;
+		n++;
+	}
+
+	qsort(ents, n, sizeof(*ents), cmp_mntents);
+	*nents = n;
+	return ents;
+}
+
 static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
+					       struct tabdiff_mntent *ents,
+					       size_t nents,
 					       const char *src,
 					       int id)
 {
 	struct list_head *p;
+	size_t lo = 0, hi = nents;
 
 	assert(df);
 
-	list_for_each(p, &df->changes) {
-		struct tabdiff_entry *de;
+	if (!ents) {
+		list_for_each(p, &df->changes) {
+			struct tabdiff_entry *de;
 
-		de = list_entry(p, struct tabdiff_entry, changes);
+			de = list_entry(p, struct tabdiff_entry, changes);
 
-		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
-		    mnt_fs_get_id(de->new_fs) == id) {
+			if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
+			    mnt_fs_get_id(de->new_fs) == id) {
 
-			const char *s = mnt_fs_get_source(de->new_fs);
+				const char *s = mnt_fs_get_source(de->new_fs);
 
-			if (s == NULL && src == NULL)
-				return de;
-			if (s && src && strcmp(s, src) == 0)
-				return de;
+				if (s == NULL && src == NULL)
+					return de;
+				if (s && src && strcmp(s, src) == 0)
+					return de;
+			}
 		}
+		return NULL;
+	}
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ents[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < nents && ents[lo].id == id; lo++) {
+		struct tabdiff_entry *de = ents[lo].de;
+		const char *s;
+
+		if (de->oper != MNT_TABDIFF_MOUNT)
+			continue;	/* already used for MOVE */
+
+		s = mnt_fs_get_source(de->new_fs);
+		if (s == NULL && src == NULL)
+			return de;
+		if (s && src && strcmp(s, src) == 0)
+			return de;
 	}
 	return NULL;
 }
@@ -230,7 +413,10 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 {
 	struct libmnt_fs *fs;
 	struct libmnt_iter itr;
-	int no, nn;
+	struct tabdiff_index old_idx = { .ents = NULL }, new_idx = { .ents = NULL };
+	struct tabdiff_mntent *mounts = NULL;
+	size_t nmounts = 0;
+	int no, nn, rc = 0;
 
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
@@ -261,13 +447,19 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		goto done;
 	}
 
+	rc = tabdiff_index_table(&old_idx, old_tab);
+	if (!rc)
+		rc = tabdiff_index_table(&new_idx, new_tab);
+	if (rc)
+		goto done;
+
 	/* search newly mounted or modified */
 	while(mnt_table_next_fs(new_tab, &itr, &fs) == 0) {
 		struct libmnt_fs *o_fs;
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
+		o_fs = tabdiff_find_pair(&old_idx, old_tab, src, tgt);
 		if (!o_fs)
 			/* 'fs' is not in the old table -- so newly mounted */
 			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
@@ -284,15 +476,19 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	}
 
 	/* search umounted or moved */
+	if (new_idx.ents)
+		mounts = tabdiff_index_mounts(df, &nmounts);
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(old_tab, &itr, &fs) == 0) {
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		if (!mnt_table_find_pair(new_tab, src, tgt, MNT_ITER_FORWARD)) {
+		if (!tabdiff_find_pair(&new_idx, new_tab, src, tgt)) {
 			struct tabdiff_entry *de;
 
-			de = tabdiff_get_mount(df, src,	mnt_fs_get_id(fs));
+			de = tabdiff_get_mount(df, mounts, nmounts,
+					       src, mnt_fs_get_id(fs));
 			if (de) {
 				mnt_ref_fs(fs);
 				mnt_unref_fs(de->old_fs);
@@ -303,6 +499,12 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		}
 	}
 done:
+	free(old_idx.ents);
+	free(new_idx.ents);
+	free(mounts);
+	if (rc)
+		return rc;
+
 	DBG(DIFF, ul_debugobj(df, "%d changes detected", df->nchanges));
 	return df->nchanges;
 }
@@ -0,0 +1,473 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ *
+ * listmount() and statmount() based mount table. The table is filled by
+ * unique mount IDs only, and the other libmnt_fs members are fetched by
+ * statmount() when requested by the libmnt_fs getters. It's cheaper than
+ * parsing of the whole /proc/self/mountinfo if the caller needs only
+ * a few mount nodes or a few fields.
+ */
+#include <sys/sysmacros.h>
+
+#include "mountP.h"
+#include "strutils.h"
+
+#define LISTMOUNT_BATCH		512
+
+#define STATMOUNT_BUFSZ		4096
+#define STATMOUNT_MAXBUFSZ	(1024 * 1024)
+
+/* superblock flags as returned in statmount.sb_flags */
+#define ST_SB_RDONLY		(1 << 0)
+#define ST_SB_SYNCHRONOUS	(1 << 4)
+#define ST_SB_DIRSYNC		(1 << 7)
+#define ST_SB_LAZYTIME		(1 << 25)
+
+/* MOUNT_ATTR_* as returned in statmount.mnt_attr */
+#define ST_ATTR_RDONLY		0x00000001
+#define ST_ATTR_NOSUID		0x00000002
+#define ST_ATTR_NODEV		0x00000004
+#define ST_ATTR_NOEXEC		0x00000008
+#define ST_ATTR__ATIME		0x00000070
+#define ST_ATTR_RELATIME	0x00000000
+#define ST_ATTR_NOATIME		0x00000010
+#define ST_ATTR_NODIRATIME	0x00000080
+#define ST_ATTR_IDMAP		0x00100000
+#define ST_ATTR_NOSYMFOLLOW	0x00200000
+
+/* compose VFS options in the same order as mountinfo */
+static char *attr_to_vfs_optstr(uint64_t attr)
+{
+	char *str = NULL;
+	int rc;
+
+	rc = mnt_optstr_append_option(&str, attr & ST_ATTR_RDONLY ? "ro" : "rw", NULL);
+	if (!rc && (attr & ST_ATTR_NOSUID))
+		rc = mnt_optstr_append_option(&str, "nosuid", NULL);
+	if (!rc && (attr & ST_ATTR_NODEV))
+		rc = mnt_optstr_append_option(&str, "nodev", NULL);
+	if (!rc && (attr & ST_ATTR_NOEXEC))
+		rc = mnt_optstr_append_option(&str, "noexec", NULL);
+	if (!rc && (attr & ST_ATTR__ATIME) == ST_ATTR_NOATIME)
+		rc = mnt_optstr_append_option(&str, "noatime", NULL);
+	if (!rc && (attr & ST_ATTR_NODIRATIME))
+		rc = mnt_optstr_append_option(&str, "nodiratime", NULL);
+	if (!rc && (attr & ST_ATTR__ATIME) == ST_ATTR_RELATIME)
+		rc = mnt_optstr_append_option(&str, "relatime", NULL);
+	if (!rc && (attr & ST_ATTR_NOSYMFOLLOW))
+		rc = mnt_optstr_append_option(&str, "nosymfollow", NULL);
+	if (!rc && (attr & ST_ATTR_IDMAP))
+		rc = mnt_optstr_append_option(&str, "idmapped", NULL);
+	if (rc) {
+		free(str);
+		return NULL;
+	}
+	return str;
+}
+
+/* compose FS options (superblock flags and FS specific options) */
+static char *sb_to_fs_optstr(const struct ul_statmount *sm)
+{
+	char *str = NULL;
+	int rc;
+
+	rc = mnt_optstr_append_option(&str, sm->sb_flags & ST_SB_RDONLY ? "ro" : "rw", NULL);
+	if (!rc && (sm->sb_flags & ST_SB_SYNCHRONOUS))
+		rc = mnt_optstr_append_option(&str, "sync", NULL);
+	if (!rc && (sm->sb_flags & ST_SB_DIRSYNC))
+		rc = mnt_optstr_append_option(&str, "dirsync", NULL);
+	if (!rc && (sm->sb_flags & ST_SB_LAZYTIME))
+		rc = mnt_optstr_append_option(&str, "lazytime", NULL);
+	if (!rc && (sm->mask & STATMOUNT_MNT_OPTS) && *(sm->str + sm->mnt_opts))
+		rc = mnt_optstr_append_option(&str, sm->str + sm->mnt_opts, NULL);
+	if (rc) {
+		free(str);
+		return NULL;
+	}
+	return str;
+}
+
+/* propagation flags in the format of mountinfo optional fields */
+static char *propagation_to_optfields(const struct ul_statmount *sm)
+{
+	char buf[128], *p = buf;
+	size_t sz = sizeof(buf);
+	int len;
+
+	*buf = '\0';
+
+	if (sm->mnt_propagation & MS_SHARED) {
+		len = snprintf(p, sz, " shared:%" PRIu64, sm->mnt_peer_group);
+		p += len, sz -= len;
+	}
+	if (sm->mnt_propagation & MS_SLAVE) {
+		len = snprintf(p, sz, " master:%" PRIu64, sm->mnt_master);
+		p += len, sz -= len;
+
+		if ((sm->mask & STATMOUNT_PROPAGATE_FROM)
+		    && sm->propagate_from
+		    && sm->propagate_from != sm->mnt_master) {
+			len = snprintf(p, sz, " propagate_from:%" PRIu64,
+					sm->propagate_from);
+			p += len, sz -= len;
+		}
+	}
+	if (sm->mnt_propagation & MS_UNBINDABLE)
+		snprintf(p, sz, " unbindable");
+
+	return *buf ? strdup(buf + 1) : NULL;
+}
+
+static int set_str(char **dest, const char *src)
+{
+	if (*dest)
+		return 0;	/* already set by application */
+	*dest = strdup(src);
+	return *dest ? 0 : -ENOMEM;
+}
+
+static int apply_statmount(struct libmnt_fs *fs, const struct ul_statmount *sm,
+			   uint64_t mask)
+{
+	char *p;
+	int rc = 0;
+
+	if (sm->mask & STATMOUNT_MNT_BASIC) {
+		fs->id = (int) sm->mnt_id_old;
+		fs->parent = (int) sm->mnt_parent_id_old;
+		fs->uniq_parent = sm->mnt_parent_id;
+
+		if (!fs->vfs_optstr && (mask & STATMOUNT_MNT_OPTS)) {
+			fs->vfs_optstr = attr_to_vfs_optstr(sm->mnt_attr);
+			if (!fs->vfs_optstr)
+				return -ENOMEM;
+		}
+		if (!fs->opt_fields && (mask & STATMOUNT_PROPAGATE_FROM))
+			fs->opt_fields = propagation_to_optfields(sm);
+	}
+
+	if (sm->mask & STATMOUNT_SB_BASIC) {
+		fs->devno = makedev(sm->sb_dev_major, sm->sb_dev_minor);
+
+		if (!fs->fs_optstr && (mask & STATMOUNT_MNT_OPTS)) {
+			fs->fs_optstr = sb_to_fs_optstr(sm);
+			if (!fs->fs_optstr)
+				return -ENOMEM;
+		}
+	}
+
+	if (!rc && (sm->mask & STATMOUNT_MNT_ROOT))
+		rc = set_str(&fs->root, sm->str + sm->mnt_root);
+	if (!rc && (sm->mask & STATMOUNT_MNT_POINT))
+		rc = set_str(&fs->target, sm->str + sm->mnt_point);
+
+	if (!rc && (sm->mask & STATMOUNT_FS_TYPE) && !fs->fstype) {
+		if ((sm->mask & STATMOUNT_FS_SUBTYPE) && *(sm->str + sm->fs_subtype))
+			p = strfconcat(sm->str + sm->fs_type, ".%s",
+					sm->str + sm->fs_subtype);
+		else
+			p = strdup(sm->str + sm->fs_type);
+		if (!p || (rc = __mnt_fs_set_fstype_ptr(fs, p))) {
+			free(p);
+			rc = rc ? rc : -ENOMEM;
+		}
+	}
+
+	if (!rc && (sm->mask & STATMOUNT_SB_SOURCE) && !fs->source) {
+		p = strdup(sm->str + sm->sb_source);
+		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
+			free(p);
+			rc = rc ? rc : -ENOMEM;
+		}
+	}
+
+	if (!rc && !fs->optstr && fs->vfs_optstr && fs->fs_optstr) {
+		fs->optstr = mnt_fs_strdup_options(fs);
+		if (!fs->optstr)
+			rc = -ENOMEM;
+	}
+	return rc;
+}
+
+/*
+ * Fetches @mask fields for @fs (only for filesystems from
+ * mnt_table_fetch_listmount()). The fields are fetched only once, also
+ * on error (e.g. the filesystem has been already umounted).
+ */
+int __mnt_fs_fetch_statmount(struct libmnt_fs *fs, uint64_t mask)
+{
+	struct ul_statmount *sm = NULL;
+	size_t bufsz = STATMOUNT_BUFSZ;
+	int rc;
+
+	if (!fs || !fs->uniq_id)
+		return -EINVAL;
+
+	/* the basic fields are cheap, fetch all at once; the options and
+	 * propagation are composed from the basic fields */
+	if (mask & (STATMOUNT_MNT_OPTS | STATMOUNT_PROPAGATE_FROM))
+		mask |= STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC;
+	else
+		mask |= fs->stmnt_todo & (STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC);
+
+	/* the kernel does not care about subtype with type */
+	if (mask & STATMOUNT_FS_TYPE)
+		mask |= STATMOUNT_FS_SUBTYPE;
+
+	fs->stmnt_todo &= ~mask;
+
+	DBG(FS, ul_debugobj(fs, "statmount [id=%" PRIu64 " mask=0x%" PRIx64 "]",
+				fs->uniq_id, mask));
+	do {
+		struct ul_statmount *tmp = realloc(sm, bufsz);
+
+		if (!tmp) {
+			rc = -ENOMEM;
+			goto done;
+		}
+		sm = tmp;
+		errno = 0;
+		rc = ul_statmount(fs->uniq_id, mask, sm, bufsz);
+		if (rc == 0 || errno != EOVERFLOW)
+			break;
+		bufsz *= 2;
+	} while (bufsz <= STATMOUNT_MAXBUFSZ);
+
+	if (rc) {
+		rc = errno ? -errno : -EINVAL;
+		DBG(FS, ul_debugobj(fs, "statmount failed [rc=%d]", rc));
+		goto done;
+	}
+
+	rc = apply_statmount(fs, sm, mask);
+done:
+	free(sm);
+	return rc;
+}
+
+/**
+ * mnt_fs_get_uniq_id:
+ * @fs: filesystem instance
+ *
+ * This unique 64-bit mount ID is never reused by kernel (unlike
+ * mnt_fs_get_id()). It's available only for filesystems from
+ * mnt_table_fetch_listmount().
+ *
+ * Returns: unique mount ID or zero.
+ *
+ * Since: 2.41
+ */
+uint64_t mnt_fs_get_uniq_id(struct libmnt_fs *fs)
+{
+	return fs ? fs->uniq_id : 0;
+}
+
+/**
+ * mnt_fs_get_parent_uniq_id:
+ * @fs: filesystem instance
+ *
+ * See also mnt_fs_get_uniq_id().
+ *
+ * Returns: unique mount ID of the parent or zero.
+ *
+ * Since: 2.41
+ */
+uint64_t mnt_fs_get_parent_uniq_id(struct libmnt_fs *fs)
+{
+	mnt_fs_fetch_fields(fs, STATMOUNT_MNT_BASIC);
+	return fs ? fs->uniq_parent : 0;
+}
+
+/**
+ * mnt_table_enable_listmount:
+ * @tb: table
+ * @enable: 0 or 1
+ *
+ * Enables listmount() and statmount() kernel interface for
+ * mnt_table_parse_mtab() and mnt_table_parse_mountinfo() if the mount
+ * table filename is not explicitly specified. The kernel mount table is
+ * parsed from /proc/self/mountinfo if the interface is not supported by
+ * the kernel.
+ *
+ * See also mnt_table_fetch_listmount().
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_enable_listmount(struct libmnt_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->lsmnt = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_table_fetch_listmount:
+ * @tb: table
+ *
+ * Reads mount IDs of the current mount namespace by listmount() to @tb. The
+ * other libmnt_fs fields (target, source, options, ...) are read by
+ * statmount() later when requested by libmnt_fs getters. Unlike
+ * mountinfo parsing, the fields are unescaped and the /run/mount/utab user
+ * specific mount options are not merged into the filesystems.
+ *
+ * Note that the table is a snapshot of the mount IDs, but the fields are
+ * read later, so it does not have to be consistent if the mount table is
+ * modified in the meantime.
+ *
+ * Returns: 0 on success, -ENOSYS if not supported by kernel, or negative
+ * number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_fetch_listmount(struct libmnt_table *tb)
+{
+	uint64_t *ids = NULL;
+	ssize_t i, n;
+	int rc = 0;
+
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "listmount: fetching IDs"));
+
+	n = __mnt_listmount_ids(&ids);
+	if (n < 0) {
+		DBG(TAB, ul_debugobj(tb, "listmount failed [rc=%zd]", n));
+		return (int) n;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct libmnt_fs *fs = NULL;
+
+		rc = __mnt_table_new_listmount_fs(tb, ids[i], &fs);
+		if (rc == 1)
+			continue;	/* filtered out */
+		if (!rc)
+			rc = mnt_table_add_fs(tb, fs);
+		mnt_unref_fs(fs);
+		if (rc)
+			goto err;
+	}
+
+	free(ids);
+	tb->fmt = MNT_FMT_MOUNTINFO;
+	DBG(TAB, ul_debugobj(tb, "listmount: %d filesystems", mnt_table_get_nents(tb)));
+	return 0;
+err:
+	free(ids);
+	mnt_reset_table(tb);
+	return rc;
+}
+
+/*
+ * Reads all unique mount IDs (in ascending order) from the current mount
+ * namespace. Returns number of IDs or negative number in case of error.
+ */
+ssize_t __mnt_listmount_ids(uint64_t **ids)
+{
+	uint64_t *list = NULL, last = 0;
+	size_t total = 0;
+	ssize_t n;
+
+	assert(ids);
+
+	do {
+		uint64_t *tmp = realloc(list, (total + LISTMOUNT_BATCH) * sizeof(uint64_t));
+
+		if (!tmp) {
+			free(list);
+			return -ENOMEM;
+		}
+		list = tmp;
+
+		n = ul_listmount(LSMT_ROOT, last, list + total, LISTMOUNT_BATCH);
+		if (n < 0) {
+			n = -errno;
+			free(list);
+			return n;
+		}
+		total += n;
+		if (n > 0)
+			last = list[total - 1];
+	} while (n == LISTMOUNT_BATCH);
+
+	*ids = list;
+	return total;
+}
+
+/*
+ * Allocates a new filesystem for unique mount @id, the other fields are
+ * fetched later by statmount(). Returns 1 if the filesystem is filtered out by
+ * @tb settings, 0 on success and negative number in case of error.
+ */
+int __mnt_table_new_listmount_fs(struct libmnt_table *tb, uint64_t id,
+				 struct libmnt_fs **res)
+{
+	struct libmnt_fs *fs;
+
+	assert(tb);
+	assert(res);
+
+	*res = NULL;
+	fs = mnt_new_fs();
+	if (!fs)
+		return -ENOMEM;
+
+	fs->uniq_id = id;
+	fs->stmnt_todo = MNT_STMNT_ALL;
+	fs->flags |= MNT_FS_KERNEL;
+
+	if (tb->noautofs) {
+		const char *type = mnt_fs_get_fstype(fs);
+
+		if (type && strcmp(type, "autofs") == 0 &&
+		    mnt_fs_get_option(fs, "ignore", NULL, NULL) == 0)
+			goto filtered;	/* skip "ignore" autofs entry */
+	}
+	if (tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+		goto filtered;
+
+	*res = fs;
+	return 0;
+filtered:
+	mnt_unref_fs(fs);
+	return 1;
+}
+
+/**
+ * mnt_table_find_uniq_id:
+ * @tb: mount table
+ * @id: unique mount ID
+ *
+ * See mnt_fs_get_uniq_id().
+ *
+ * Returns: a tab entry or NULL.
+ *
+ * Since: 2.41
+ */
+struct libmnt_fs *mnt_table_find_uniq_id(struct libmnt_table *tb, uint64_t id)
+{
+	struct libmnt_fs *fs;
+	struct libmnt_iter itr;
+
+	if (!tb || !id)
+		return NULL;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (fs->uniq_id == id)
+			return fs;
+	}
+	return NULL;
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "all-io.h"
 #include "fileutils.h"
 #include "mangle.h"
 #include "mountP.h"
@@ -32,22 +33,123 @@
 struct libmnt_parser {
 	FILE	*f;		/* fstab, swaps or mountinfo ... */
 	const char *filename;	/* file name or NULL */
-	char	*buf;		/* buffer (the current line content) */
+	char	*buf;		/* buffer for getline() */
 	size_t	bufsiz;		/* size of the buffer */
+	char	*data;		/* the current line content */
+	size_t	datasz;		/* size of the line (including '\n') */
 	size_t	line;		/* current line */
 	int     sysroot_rc;	/* rc from mnt_guess_system_root() */
 	char	*sysroot;	/* guess from mmnt_guess_system_root() */
+
+	char	*fbuf;		/* content of regular file, terminated */
+	size_t	fbufsz;		/* size of the content */
+	size_t	fbufoff;	/* offset of the next line */
+	char	*fbufsaved;	/* temporary terminated line */
+	char	fbufsavedch;	/* original char at @fbufsaved */
+	unsigned int eof : 1;	/* end of @fbuf */
 };
 
 static void parser_cleanup(struct libmnt_parser *pa)
 {
 	if (!pa)
 		return;
+	free(pa->fbuf);
 	free(pa->buf);
 	free(pa->sysroot);
 	memset(pa, 0, sizeof(*pa));
 }
 
+/*
+ * Regular files are read into one buffer and the lines are terminated and
+ * parsed in place, so the file is not copied by stdio and getline(). The file
+ * is not mapped; the mapping process would be killed by SIGBUS if another
+ * process truncates the file. The /proc files have no size and they are
+ * always read by getline().
+ */
+static void parser_read_file(struct libmnt_parser *pa)
+{
+	struct stat st;
+	int fd = fileno(pa->f);
+	ssize_t sz;
+	char *buf;
+
+	if (fd < 0 || ftello(pa->f) != 0 || fstat(fd, &st) != 0
+	    || !S_ISREG(st.st_mode) || st.st_size <= 0
+	    || (uintmax_t) st.st_size >= SIZE_MAX)
+		return;
+
+	buf = malloc(st.st_size + 1);
+	if (!buf)
+		return;
+
+	/* the file may be modified in the meantime, use what has been read */
+	sz = read_all(fd, buf, st.st_size);
+	if (sz <= 0) {
+		free(buf);
+		if (sz < 0)	/* fallback to getline() */
+			lseek(fd, 0, SEEK_SET);
+		return;
+	}
+	buf[sz] = '\0';
+
+	DBG(TAB, ul_debug("%s: read [%zd bytes]", pa->filename, sz));
+	pa->fbuf = buf;
+	pa->fbufsz = sz;
+}
+
+static int parser_is_eof(struct libmnt_parser *pa)
+{
+	return pa->fbuf ? pa->eof : feof(pa->f);
+}
+
+/*
+ * Reads the next line to pa->data, the line is terminated by '\0' and (if
+ * present in the file) contains the final '\n'. Returns -1 on end of file or
+ * error.
+ */
+static ssize_t parser_getline(struct libmnt_parser *pa)
+{
+	char *p, *e;
+	size_t rest;
+	ssize_t sz;
+
+	if (!pa->fbuf) {
+		sz = getline(&pa->buf, &pa->bufsiz, pa->f);
+		pa->data = pa->buf;
+		pa->datasz = pa->bufsiz;
+		return sz;
+	}
+
+	if (pa->fbufsaved) {
+		*pa->fbufsaved = pa->fbufsavedch;
+		pa->fbufsaved = NULL;
+	}
+	if (pa->fbufoff >= pa->fbufsz) {
+		pa->eof = 1;
+		return -1;
+	}
+
+	p = pa->fbuf + pa->fbufoff;
+	rest = pa->fbufsz - pa->fbufoff;
+	e = memchr(p, '\n', rest);
+
+	if (e) {
+		/* terminate in place; keep the next char for the next call */
+		sz = e - p + 1;
+		pa->fbufsaved = e + 1;
+		pa->fbufsavedch = *pa->fbufsaved;
+		*pa->fbufsaved = '\0';
+	} else {
+		/* the last line, terminated at the end of the buffer */
+		sz = rest;
+		pa->eof = 1;	/* like getline() without final newline */
+	}
+	pa->data = p;
+	pa->fbufoff += sz;
+	pa->datasz = sz + 1;
+	return sz;
+}
+
 static const char *next_s32(const char *s, int *num, int *rc)
 {
 	char *end = NULL;
@@ -137,14 +239,13 @@ static int mnt_parse_table_line(struct libmnt_fs *fs, const char *s)
 
 	/* (4) options (optional) */
 	p = unmangle(s, &s);
-	if (p && (rc = mnt_fs_set_options(fs, p))) {
+	if (!p)
+		goto done;
+	if ((rc = __mnt_fs_set_options_ptr(fs, p))) {
 		DBG(TAB, ul_debug("tab parse error: [options]"));
 		free(p);
 		goto fail;
 	}
-	if (!p)
-		goto done;
-	free(p);
 
 	s = skip_separator(s);
 	if (!s || !*s)
@@ -178,10 +279,172 @@ fail:
 }
 
 
+/*
+ * Lazy variant of the mountinfo parser; @s points to the mountroot field. The
+ * rest of the line is copied and split to fields in place, the fields are
+ * unmangled and allocated later by __mnt_fs_decode_mountinfo().
+ */
+static int parse_mountinfo_fields_lazy(struct libmnt_fs *fs, const char *s)
+{
+	struct libmnt_lzline *ln;
+	size_t len = strlen(s);
+	char *data, *p, *e, *sep;
+	int i;
+
+	ln = malloc(sizeof(*ln) + len + 1);
+	if (!ln)
+		return -ENOMEM;
+	ln->refcount = 1;
+	data = memcpy(ln->data, s, len + 1);
+
+	mnt_unref_lzline(fs->lzline);
+	fs->lzline = ln;
+	fs->lazy_todo = 0;
+
+	/* (4) mountroot, (5) target, (6) vfs options */
+	p = data;
+	for (i = MNT_LZ_ROOT; i <= MNT_LZ_VFSOPTS; i++) {
+		e = (char *) skip_nonspearator(p);
+		if (e == p || !*e) {
+			DBG(TAB, ul_debug("tab parse error: [lazy field %d]", i));
+			return -EINVAL;
+		}
+		fs->lzoff[i] = p - data;
+		if (i == MNT_LZ_VFSOPTS)
+			break;
+		*e = '\0';
+		p = (char *) skip_separator(e + 1);
+	}
+
+	/* (7) optional fields, terminated by " - " */
+	sep = strstr(e, " - ");
+	if (!sep) {
+		DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
+		return -EINVAL;
+	}
+	if (sep > e + 1) {
+		fs->lzoff[MNT_LZ_OPTFIELDS] = e + 1 - data;
+		fs->lazy_todo |= STATMOUNT_PROPAGATE_FROM;
+	}
+	*e = '\0';
+	*sep = '\0';
+
+	/* (8) FS type */
+	p = (char *) skip_separator(sep + 3);
+	e = (char *) skip_nonspearator(p);
+	if (e == p || !*e) {
+		DBG(TAB, ul_debug("tab parse error: [fstype]"));
+		return -EINVAL;
+	}
+	fs->lzoff[MNT_LZ_FSTYPE] = p - data;
+
+	/* (9) source -- maybe empty string */
+	if (*(e + 1) == ' ') {
+		*e = '\0';
+		fs->lzoff[MNT_LZ_SOURCE] = e - data;
+		p = (char *) skip_separator(e + 1);
+	} else {
+		*e = '\0';
+		p = (char *) skip_separator(e + 1);
+		e = (char *) skip_nonspearator(p);
+		if (e == p) {
+			DBG(TAB, ul_debug("tab parse error: [regular source]"));
+			return -EINVAL;
+		}
+		fs->lzoff[MNT_LZ_SOURCE] = p - data;
+		if (*e)
+			*e++ = '\0';
+		p = (char *) skip_separator(e);
+	}
+
+	/* (10) fs options (fs specific) */
+	e = (char *) skip_nonspearator(p);
+	if (e == p) {
+		DBG(TAB, ul_debug("tab parse error: [FS options]"));
+		return -EINVAL;
+	}
+	fs->lzoff[MNT_LZ_FSOPTS] = p - data;
+	*e = '\0';
+
+	fs->lazy_todo |= STATMOUNT_MNT_ROOT | STATMOUNT_MNT_POINT |
+			 STATMOUNT_MNT_OPTS | STATMOUNT_FS_TYPE |
+			 STATMOUNT_SB_SOURCE;
+	return 0;
+}
+
+static char *lazy_field(struct libmnt_fs *fs, int idx)
+{
+	return fs->lzline->data + fs->lzoff[idx];
+}
+
+/*
+ * Unmangles and allocates @mask fields for @fs from lazy mountinfo parser. The
+ * fields already set by application are not modified.
+ */
+int __mnt_fs_decode_mountinfo(struct libmnt_fs *fs, uint64_t mask)
+{
+	char *p;
+	int rc = 0;
+
+	if (!fs || !fs->lzline)
+		return -EINVAL;
+
+	fs->lazy_todo &= ~mask;
+
+	if (!rc && (mask & STATMOUNT_MNT_ROOT) && !fs->root) {
+		fs->root = unmangle(lazy_field(fs, MNT_LZ_ROOT), NULL);
+		if (!fs->root)
+			rc = -ENOMEM;
+	}
+	if (!rc && (mask & STATMOUNT_MNT_POINT) && !fs->target) {
+		fs->target = unmangle(lazy_field(fs, MNT_LZ_TARGET), NULL);
+		if (!fs->target)
+			rc = -ENOMEM;
+	}
+	if (!rc && (mask & STATMOUNT_PROPAGATE_FROM) && !fs->opt_fields) {
+		fs->opt_fields = strdup(lazy_field(fs, MNT_LZ_OPTFIELDS));
+		if (!fs->opt_fields)
+			rc = -ENOMEM;
+	}
+	if (!rc && (mask & STATMOUNT_FS_TYPE) && !fs->fstype) {
+		p = unmangle(lazy_field(fs, MNT_LZ_FSTYPE), NULL);
+		if (!p || (rc = __mnt_fs_set_fstype_ptr(fs, p))) {
+			free(p);
+			rc = rc ? rc : -ENOMEM;
+		}
+	}
+	if (!rc && (mask & STATMOUNT_SB_SOURCE) && !fs->source) {
+		p = lazy_field(fs, MNT_LZ_SOURCE);
+		p = *p ? unmangle(p, NULL) : strdup("");
+		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
+			free(p);
+			rc = rc ? rc : -ENOMEM;
+		}
+	}
+	if (!rc && (mask & STATMOUNT_MNT_OPTS) && !fs->optstr) {
+		if (!fs->vfs_optstr)
+			fs->vfs_optstr = unmangle(lazy_field(fs, MNT_LZ_VFSOPTS), NULL);
+		if (!fs->fs_optstr)
+			fs->fs_optstr = unmangle(lazy_field(fs, MNT_LZ_FSOPTS), NULL);
+		if (fs->vfs_optstr && fs->fs_optstr)
+			fs->optstr = mnt_fs_strdup_options(fs);
+		if (!fs->optstr)
+			rc = -ENOMEM;
+	}
+
+	if (!fs->lazy_todo) {
+		mnt_unref_lzline(fs->lzline);
+		fs->lzline = NULL;
+	}
+	if (rc)
+		DBG(TAB, ul_debugobj(fs, "lazy decode failed [rc=%d]", rc));
+	return rc;
+}
+
 /*
  * Parses one line from a mountinfo file
  */
-static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
+static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s, int lazy)
 {
 	int rc = 0;
 	unsigned int maj, min;
@@ -216,6 +479,9 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 	s = skip_nonspearator(s);
 	s = skip_separator(s);
 
+	if (lazy)
+		return parse_mountinfo_fields_lazy(fs, s);
+
 	/* (4) mountroot */
 	fs->root = unmangle(s, &s);
 	if (!fs->root) {
@@ -504,13 +770,13 @@ static int is_terminated_by_blank(const char *str)
  */
 static int next_comment_line(struct libmnt_parser *pa, char **last)
 {
-	if (getline(&pa->buf, &pa->bufsiz, pa->f) < 0)
-		return feof(pa->f) ? 1 : -errno;
+	if (parser_getline(pa) < 0)
+		return parser_is_eof(pa) ? 1 : -errno;
 
 	pa->line++;
-	*last = strchr(pa->buf, '\n');
+	*last = strchr(pa->data, '\n');
 
-	return is_comment_line(pa->buf) ? 0 : 1;
+	return is_comment_line(pa->data) ? 0 : 1;
 }
 
 static int append_comment(struct libmnt_table *tb,
@@ -557,30 +823,30 @@ static int mnt_table_parse_next(struct libmnt_parser *pa,
 	/* read the next non-blank non-comment line */
 next_line:
 	do {
-		if (getline(&pa->buf, &pa->bufsiz, pa->f) < 0)
+		if (parser_getline(pa) < 0)
 			return -EINVAL;
 		pa->line++;
-		s = strchr(pa->buf, '\n');
+		s = strchr(pa->data, '\n');
 		if (!s) {
 			DBG(TAB, ul_debugobj(tb, "%s:%zu: no final newline",
 						pa->filename, pa->line));
 
 			/* Missing final newline?  Otherwise an extremely */
 			/* long line - assume file was corrupted */
-			if (feof(pa->f))
-				s = memchr(pa->buf, '\0', pa->bufsiz);
+			if (parser_is_eof(pa))
+				s = memchr(pa->data, '\0', pa->datasz);
 
 		/* comments parser */
 		} else if (tb->comms
 		    && (tb->fmt == MNT_FMT_GUESS || tb->fmt == MNT_FMT_FSTAB)
-		    && is_comment_line(pa->buf)) {
+		    && is_comment_line(pa->data)) {
 			do {
-				rc = append_comment(tb, fs, pa->buf, feof(pa->f));
+				rc = append_comment(tb, fs, pa->data, parser_is_eof(pa));
 				if (!rc)
 					rc = next_comment_line(pa, &s);
 			} while (rc == 0);
 
-			if (rc == 1 && feof(pa->f))
+			if (rc == 1 && parser_is_eof(pa))
 				rc = append_comment(tb, fs, NULL, 1);
 			if (rc < 0)
 				return rc;
@@ -590,9 +856,9 @@ next_line:
 		if (!s)
 			goto err;
 		*s = '\0';
-		if (s > pa->buf && *(s - 1)  == '\r')
+		if (s > pa->data && *(s - 1)  == '\r')
 			*(--s) = '\0';
-		s = (char *) skip_blank(pa->buf);
+		s = (char *) skip_blank(pa->data);
 	} while (*s == '\0' || *s == '#');
 
 	if (tb->fmt == MNT_FMT_GUESS) {
@@ -606,7 +872,7 @@ next_line:
 		rc = mnt_parse_table_line(fs, s);
 		break;
 	case MNT_FMT_MOUNTINFO:
-		rc = mnt_parse_mountinfo_line(fs, s);
+		rc = mnt_parse_mountinfo_line(fs, s, tb->lazy);
 		break;
 	case MNT_FMT_UTAB:
 		rc = mnt_parse_utab_line(fs, s);
@@ -669,7 +935,13 @@ static int kernel_fs_postparse(struct libmnt_parser *pa,
 			       struct libmnt_fs *fs, pid_t *tid)
 {
 	int rc = 0;
-	const char *src = mnt_fs_get_srcpath(fs);
+	const char *src;
+
+	/* don't decode source in lazy mode, "/dev/root" is never mangled */
+	if (fs->lazy_todo & STATMOUNT_SB_SOURCE)
+		src = lazy_field(fs, MNT_LZ_SOURCE);
+	else
+		src = mnt_fs_get_srcpath(fs);
 
 	/* This is a filesystem description from /proc, so we're in some process
 	 * namespace. Let's remember the process PID.
@@ -743,6 +1015,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 
 	pa.filename = filename;
 	pa.f = f;
+	parser_read_file(&pa);
 
 	/* necessary for /proc/mounts only, the /proc/self/mountinfo
 	 * parser sets the flag properly
@@ -755,7 +1028,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	do {
 		struct libmnt_fs *fs;
 
-		if (feof(f)) {
+		if (parser_is_eof(&pa)) {
 			DBG(TAB, ul_debugobj(tb, "end-of-file"));
 			break;
 		}
@@ -799,7 +1072,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 		}
 
 		/* fatal errors */
-		if (rc < 0 && !feof(f)) {
+		if (rc < 0 && !parser_is_eof(&pa)) {
 			DBG(TAB, ul_debugobj(tb, "fatal error"));
 			goto err;
 		}
@@ -1088,6 +1361,31 @@ int mnt_table_enable_noautofs(struct libmnt_table *tb, int ignore)
 	return 0;
 }
 
+/**
+ * mnt_table_enable_lazy_parsing:
+ * @tb: table
+ * @enable: 0 or 1
+ *
+ * Enables lazy parsing of mountinfo files. The parser keeps a copy of the
+ * line and the fields (target, source, options, ...) are unmangled and
+ * allocated when requested by libmnt_fs getters for the first time. It makes
+ * parsing cheaper if only a few fields are used.
+ *
+ * Note that the filesystem type dependent flags (see mnt_fs_is_pseudofs(),
+ * etc.) are also evaluated on demand.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_enable_lazy_parsing(struct libmnt_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->lazy = enable ? 1 : 0;
+	return 0;
+}
+
 /*
  * mnt_table_is_noautofs:
  * @tb: table
@@ -1224,6 +1522,59 @@ static struct libmnt_fs *mnt_table_merge_user_fs(struct libmnt_table *tb, struct
 	return fs;
 }
 
+/*
+ * Parses the utab file and the utab fragments from the <utab>.d directory.
+ *
+ * Returns: 0 on success, 1 if there is nothing to parse, <0 on error.
+ */
+int __mnt_table_parse_utab(struct libmnt_table *tb, const char *utab)
+{
+	char *dirname;
+	int rc = 1;
+
+	assert(tb);
+
+	if (!utab)
+		utab = mnt_get_utab_path();
+
+	tb->fmt = MNT_FMT_UTAB;
+
+	if (!is_file_empty(utab)) {
+		rc = mnt_table_parse_file(tb, utab);
+		if (rc)
+			return rc;
+	}
+
+	dirname = mnt_get_utab_dir(utab);
+	if (dirname) {
+		DIR *dir = opendir(dirname);
+		struct dirent *d;
+
+		while (dir && (d = readdir(dir))) {
+			FILE *f;
+
+			if (!mnt_is_utab_fragment(d->d_name))
+				continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+			if (d->d_type != DT_UNKNOWN && d->d_type != DT_REG)
+				continue;
+#endif
+			f = fopen_at(dirfd(dir), d->d_name,
+					O_RDONLY|O_CLOEXEC, "r" UL_CLOEXECSTR);
+			if (f) {
+				mnt_table_parse_stream(tb, f, d->d_name);
+				fclose(f);
+				rc = 0;
+			}
+		}
+		if (dir)
+			closedir(dir);
+		free(dirname);
+	}
+
+	return rc;
+}
+
 /* default filename is /proc/self/mountinfo
  */
 int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
@@ -1237,6 +1588,13 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
 	if (filename)
 		DBG(TAB, ul_debugobj(tb, "%s requested as mount table", filename));
 
+	if (!explicit_file && tb->lsmnt) {
+		DBG(TAB, ul_debugobj(tb, "mountinfo parse: #1 use listmount()"));
+		if (mnt_table_fetch_listmount(tb) == 0)
+			goto utab;
+		DBG(TAB, ul_debugobj(tb, "listmount() unsupported, fallback to mountinfo"));
+	}
+
 	if (!filename || strcmp(filename, _PATH_PROC_MOUNTINFO) == 0) {
 		filename = _PATH_PROC_MOUNTINFO;
 		tb->fmt = MNT_FMT_MOUNTINFO;
@@ -1256,6 +1614,7 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
 
 	if (!is_mountinfo(tb))
 		return 0;
+utab:
 	DBG(TAB, ul_debugobj(tb, "mountinfo parse: #2 read utab"));
 
 	if (mnt_table_get_nents(tb) == 0)
@@ -1264,19 +1623,13 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
 	 * try to read the user specific information from /run/mount/utabs
 	 */
 	if (!u_tb) {
-		const char *utab = mnt_get_utab_path();
-
-		if (!utab || is_file_empty(utab))
-			return 0;
-
 		u_tb = mnt_new_table();
 		if (!u_tb)
 			return -ENOMEM;
 
-		u_tb->fmt = MNT_FMT_UTAB;
 		mnt_table_set_parser_fltrcb(u_tb, tb->fltrcb, tb->fltrcb_data);
 
-		rc = mnt_table_parse_file(u_tb, utab);
+		rc = __mnt_table_parse_utab(u_tb, NULL);
 		priv_utab = 1;
 	}
 
@@ -24,6 +24,8 @@
 #include <sys/file.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <dirent.h>
+#include <time.h>
 
 #include "mountP.h"
 #include "mangle.h"
@@ -499,18 +501,19 @@ static int fprintf_utab_fs(FILE *f, struct libmnt_fs *fs)
 	return rc;
 }
 
-static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
+static int write_utab_file(struct libmnt_update *upd, struct libmnt_table *tb,
+			   const char *filename)
 {
 	FILE *f;
 	int rc, fd;
 	char *uq = NULL;
 
-	if (!tb || !upd->filename)
+	if (!tb || !filename)
 		return -EINVAL;
 
-	DBG(UPDATE, ul_debugobj(upd, "%s: updating", upd->filename));
+	DBG(UPDATE, ul_debugobj(upd, "%s: updating", filename));
 
-	fd = mnt_open_uniq_filename(upd->filename, &uq);
+	fd = mnt_open_uniq_filename(filename, &uq);
 	if (fd < 0)
 		return fd;	/* error */
 
@@ -544,7 +547,7 @@ static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
 
 		rc = fchmod(fd, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH) ? -errno : 0;
 
-		if (!rc && stat(upd->filename, &st) == 0)
+		if (!rc && stat(filename, &st) == 0)
 			/* Copy uid/gid from the present file before renaming. */
 			rc = fchown(fd, st.st_uid, st.st_gid) ? -errno : 0;
 
@@ -552,7 +555,7 @@ static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
 		f = NULL;
 
 		if (!rc)
-			rc = rename(uq, upd->filename) ? -errno : 0;
+			rc = rename(uq, filename) ? -errno : 0;
 	} else {
 		rc = -errno;
 		close(fd);
@@ -564,10 +567,15 @@ leave:
 
 	unlink(uq);	/* be paranoid */
 	free(uq);
-	DBG(UPDATE, ul_debugobj(upd, "%s: done [rc=%d]", upd->filename, rc));
+	DBG(UPDATE, ul_debugobj(upd, "%s: done [rc=%d]", filename, rc));
 	return rc;
 }
 
+static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
+{
+	return write_utab_file(upd, tb, upd->filename);
+}
+
 /**
  * mnt_table_write_file
  * @tb: parsed file (e.g. fstab)
@@ -882,6 +890,377 @@ static int update_add_options(struct libmnt_update *upd)
 
 }
 
+/*
+ * utab fragments
+ *
+ * If the <utab>.d directory (e.g. /run/mount/utab.d) exists, the new entries
+ * are not added to the utab file, but every mount has its own file in the
+ * directory. The file is named by mount ID and always replaced by rename(2),
+ * so the global utab lock is not necessary. The entries for the filesystems
+ * which are no more mounted are removed on umount. The readers merge the
+ * utab file and all fragments (see __mnt_table_parse_utab()).
+ *
+ * The utab file is still updated (with lock) for old entries not found in
+ * the fragments.
+ */
+struct utab_fragment {
+	char		*name;
+	struct libmnt_fs *fs;
+};
+
+static void free_utab_fragments(struct utab_fragment *frs, size_t nfrs)
+{
+	size_t i;
+
+	for (i = 0; i < nfrs; i++) {
+		free(frs[i].name);
+		mnt_unref_fs(frs[i].fs);
+	}
+	free(frs);
+}
+
+static int read_utab_fragments(const char *dirname,
+			       struct utab_fragment **frs, size_t *nfrs)
+{
+	DIR *dir;
+	struct dirent *d;
+	int rc = 0;
+
+	*frs = NULL;
+	*nfrs = 0;
+
+	dir = opendir(dirname);
+	if (!dir)
+		return -errno;
+
+	while (rc == 0 && (d = readdir(dir))) {
+		struct libmnt_table *tb;
+		struct utab_fragment *x;
+		struct libmnt_fs *fs = NULL;
+		char *path;
+
+		if (!mnt_is_utab_fragment(d->d_name))
+			continue;
+		if (asprintf(&path, "%s/%s", dirname, d->d_name) <= 0) {
+			rc = -ENOMEM;
+			break;
+		}
+		tb = __mnt_new_table_from_file(path, MNT_FMT_UTAB, 0);
+		free(path);
+		if (!tb || mnt_table_first_fs(tb, &fs) != 0) {
+			mnt_unref_table(tb);
+			continue;	/* removed or broken */
+		}
+
+		x = reallocarray(*frs, *nfrs + 1, sizeof(*x));
+		if (!x)
+			rc = -ENOMEM;
+		else {
+			*frs = x;
+			x = &x[(*nfrs)++];
+			x->fs = fs;
+			mnt_ref_fs(fs);
+			x->name = strdup(d->d_name);
+			if (!x->name)
+				rc = -ENOMEM;
+		}
+		mnt_unref_table(tb);
+	}
+
+	closedir(dir);
+	return rc;
+}
+
+static int write_utab_fragment(struct libmnt_update *upd, const char *dirname,
+			       const char *name, struct libmnt_fs *fs)
+{
+	struct libmnt_table *tb;
+	struct libmnt_fs *x;
+	char *path = NULL;
+	int rc;
+
+	if (name)
+		rc = asprintf(&path, "%s/%s", dirname, name);
+	else if (mnt_fs_get_id(fs) > 0)
+		rc = asprintf(&path, "%s/%d", dirname, mnt_fs_get_id(fs));
+	else {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		rc = asprintf(&path, "%s/anon-%d-%jd%09ld", dirname, (int) getpid(),
+				(intmax_t) ts.tv_sec, (long) ts.tv_nsec);
+	}
+	if (rc <= 0)
+		return -ENOMEM;
+
+	tb = mnt_new_table();
+	x = mnt_copy_fs(NULL, fs);
+	if (tb && x)
+		rc = mnt_table_add_fs(tb, x);
+	else
+		rc = -ENOMEM;
+	if (!rc)
+		rc = write_utab_file(upd, tb, path);
+
+	mnt_unref_fs(x);
+	mnt_unref_table(tb);
+	free(path);
+	return rc;
+}
+
+static int unlink_utab_fragment(const char *dirname, const char *name)
+{
+	char *path;
+	int rc;
+
+	if (asprintf(&path, "%s/%s", dirname, name) <= 0)
+		return -ENOMEM;
+
+	DBG(UPDATE, ul_debug("removing utab fragment %s", path));
+	rc = unlink(path) == 0 || errno == ENOENT ? 0 : -errno;
+	free(path);
+	return rc;
+}
+
+/* returns the fragment for @fs (by ID or by the last matching target) */
+static struct utab_fragment *find_utab_fragment(struct utab_fragment *frs,
+						size_t nfrs, struct libmnt_fs *fs)
+{
+	struct utab_fragment *res = NULL;
+	const char *tgt = mnt_fs_get_target(fs);
+	int id = mnt_fs_get_id(fs);
+	size_t i;
+
+	for (i = 0; i < nfrs; i++) {
+		int x = mnt_fs_get_id(frs[i].fs);
+
+		if (id > 0 && x > 0) {
+			if (x == id)
+				return &frs[i];
+		} else if (mnt_fs_streq_target(frs[i].fs, tgt))
+			res = &frs[i];
+	}
+	return res;
+}
+
+static int utab_has_target(struct libmnt_update *upd, const char *target)
+{
+	struct libmnt_table *tb;
+	int rc = 0;
+
+	if (is_file_empty(upd->filename))
+		return 0;
+
+	tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+	if (tb && mnt_table_find_target(tb, target, MNT_ITER_BACKWARD))
+		rc = 1;
+	mnt_unref_table(tb);
+	return rc;
+}
+
+/*
+ * Removes the fragment for the umounted target and all fragments for
+ * filesystems which are no more mounted. The mount table is read after the
+ * fragments, so fragments written by concurrent mounts are never removed.
+ */
+static int fragments_remove_entry(struct libmnt_update *upd, const char *dirname)
+{
+	struct utab_fragment *frs = NULL, *anon = NULL;
+	struct libmnt_table *mi = NULL;
+	size_t i, nfrs = 0;
+	int rc, found = 0;
+
+	rc = read_utab_fragments(dirname, &frs, &nfrs);
+	if (rc || !nfrs)
+		goto done;
+
+	mi = mnt_new_table_from_file(_PATH_PROC_MOUNTINFO);
+
+	for (i = 0; i < nfrs; i++) {
+		struct libmnt_fs *fs = frs[i].fs;
+		int id = mnt_fs_get_id(fs);
+
+		if (id > 0 && mi) {
+			struct libmnt_fs *x = __mnt_table_find_id(mi, id);
+
+			if (x && mnt_fs_streq_target(x, mnt_fs_get_target(fs)))
+				continue;	/* still mounted */
+			if (mnt_fs_streq_target(fs, upd->target))
+				found = 1;
+			unlink_utab_fragment(dirname, frs[i].name);
+
+		} else if (id <= 0 && mnt_fs_streq_target(fs, upd->target))
+			anon = &frs[i];
+	}
+
+	if (!found && anon) {
+		unlink_utab_fragment(dirname, anon->name);
+		found = 1;
+	}
+done:
+	mnt_unref_table(mi);
+	free_utab_fragments(frs, nfrs);
+	if (rc)
+		return rc;
+
+	/* old entry in the utab file */
+	return !found && utab_has_target(upd, upd->target) ? 1 : 0;
+}
+
+/*
+ * The same as fragments_remove_entry() but for more targets. The fragments
+ * and mount table are read only once.
+ */
+static int fragments_remove_targets(const char *dirname,
+				    char *const *targets, size_t ntargets)
+{
+	struct utab_fragment *frs = NULL;
+	struct libmnt_table *mi = NULL;
+	size_t i, j, nfrs = 0;
+	int rc;
+
+	rc = read_utab_fragments(dirname, &frs, &nfrs);
+	if (rc || !nfrs)
+		goto done;
+
+	mi = mnt_new_table_from_file(_PATH_PROC_MOUNTINFO);
+
+	for (i = 0; i < nfrs; i++) {
+		struct libmnt_fs *fs = frs[i].fs;
+		int id = mnt_fs_get_id(fs);
+
+		if (id > 0 && mi) {
+			struct libmnt_fs *x = __mnt_table_find_id(mi, id);
+
+			if (x && mnt_fs_streq_target(x, mnt_fs_get_target(fs)))
+				continue;	/* still mounted */
+			unlink_utab_fragment(dirname, frs[i].name);
+			continue;
+		}
+		for (j = 0; j < ntargets; j++) {
+			if (mnt_fs_streq_target(fs, targets[j])) {
+				unlink_utab_fragment(dirname, frs[i].name);
+				break;
+			}
+		}
+	}
+done:
+	mnt_unref_table(mi);
+	free_utab_fragments(frs, nfrs);
+	return rc;
+}
+
+static int fragments_modify_target(struct libmnt_update *upd, const char *dirname)
+{
+	struct utab_fragment *frs = NULL;
+	const char *upd_source = mnt_fs_get_srcpath(upd->fs);
+	const char *upd_target = mnt_fs_get_target(upd->fs);
+	char *cn_target = NULL;
+	size_t i, nfrs = 0;
+	int rc;
+
+	rc = read_utab_fragments(dirname, &frs, &nfrs);
+	if (rc || !nfrs)
+		goto done;
+
+	cn_target = mnt_resolve_path(upd_target, NULL);
+	if (!cn_target) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	for (i = 0; rc == 0 && i < nfrs; i++) {
+		struct libmnt_fs *fs = frs[i].fs;
+		const char *e;
+		char *p;
+
+		e = startswith(mnt_fs_get_target(fs), upd_source);
+		if (!e || (*e && *e != '/'))
+			continue;
+		if (*e == '/')
+			e++;		/* remove extra '/' */
+
+		if (!*e)
+			rc = mnt_fs_set_target(fs, cn_target);
+		else if (asprintf(&p, "%s/%s", cn_target, e) > 0) {
+			rc = mnt_fs_set_target(fs, p);
+			free(p);
+		} else
+			rc = -ENOMEM;
+		if (!rc)
+			rc = write_utab_fragment(upd, dirname, frs[i].name, fs);
+	}
+done:
+	free(cn_target);
+	free_utab_fragments(frs, nfrs);
+	if (rc)
+		return rc;
+
+	/* move also old entries in the utab file */
+	return is_file_empty(upd->filename) ? 0 : 1;
+}
+
+/* remount and mount by external helper */
+static int fragments_modify_options(struct libmnt_update *upd, const char *dirname,
+				    int add)
+{
+	struct utab_fragment *frs = NULL, *cur;
+	size_t nfrs = 0;
+	int rc;
+
+	rc = read_utab_fragments(dirname, &frs, &nfrs);
+	if (rc)
+		goto done;
+
+	cur = find_utab_fragment(frs, nfrs, upd->fs);
+	if (cur && add) {
+		char *u = NULL;
+
+		rc = mnt_optstr_get_missing(cur->fs->user_optstr, upd->fs->user_optstr, &u);
+		if (!rc && u) {
+			DBG(UPDATE, ul_debugobj(upd, " add missing: %s", u));
+			rc = mnt_optstr_append_option(&cur->fs->user_optstr, u, NULL);
+			if (!rc)
+				rc = write_utab_fragment(upd, dirname, cur->name, cur->fs);
+		}
+		if (rc == 1)	/* nothing is missing */
+			rc = 0;
+	} else if (cur) {
+		rc = mnt_fs_set_attributes(cur->fs, mnt_fs_get_attributes(upd->fs));
+		if (!rc)
+			rc = mnt_fs_set_options(cur->fs, mnt_fs_get_options(upd->fs));
+		if (!rc)
+			rc = write_utab_fragment(upd, dirname, cur->name, cur->fs);
+
+	} else if (utab_has_target(upd, mnt_fs_get_target(upd->fs)))
+		rc = 1;		/* old entry in the utab file */
+	else
+		rc = write_utab_fragment(upd, dirname, NULL, upd->fs);
+done:
+	free_utab_fragments(frs, nfrs);
+	return rc;
+}
+
+/*
+ * Returns: 0 on success, 1 if the utab file has to be updated, <0 on error.
+ */
+static int update_fragments(struct libmnt_update *upd, const char *dirname)
+{
+	DBG(UPDATE, ul_debugobj(upd, "%s: update fragments", dirname));
+
+	if (!upd->fs && upd->target)
+		return fragments_remove_entry(upd, dirname);		/* umount */
+	if (upd->mountflags & MS_MOVE)
+		return fragments_modify_target(upd, dirname);		/* move */
+	if (upd->mountflags & MS_REMOUNT)
+		return fragments_modify_options(upd, dirname, 0);	/* remount */
+	if (upd->fs && upd->missing_options)
+		return fragments_modify_options(upd, dirname, 1);	/* mount by externel helper */
+	if (upd->fs)
+		return write_utab_fragment(upd, dirname, NULL, upd->fs); /* mount */
+	return 0;
+}
+
 static int update_init_lock(struct libmnt_update *upd, struct libmnt_lock *lc)
 {
 	assert(upd);
@@ -910,12 +1289,16 @@ static int update_init_lock(struct libmnt_update *upd, struct libmnt_lock *lc)
  * The @lc lock is optional and will be created if necessary. Note that
  * an automatically created lock blocks all signals.
  *
+ * If the /run/mount/utab.d directory exists, the entries are stored in
+ * per-mount files in the directory and the lock is not used (since 2.41).
+ *
  * See also mnt_lock_block_signals() and mnt_context_get_lock().
  *
  * Returns: 0 on success, negative number on error.
  */
 int mnt_update_table(struct libmnt_update *upd, struct libmnt_lock *lc)
 {
+	char *dirname;
 	int rc = -EINVAL;
 
 	if (!upd || !upd->filename)
@@ -928,6 +1311,14 @@ int mnt_update_table(struct libmnt_update *upd, struct libmnt_lock *lc)
 		DBG(UPDATE, mnt_fs_print_debug(upd->fs, stderr));
 	}
 
+	dirname = mnt_get_utab_dir(upd->filename);
+	if (dirname) {
+		rc = update_fragments(upd, dirname);
+		free(dirname);
+		if (rc != 1)
+			goto done;
+	}
+
 	rc = update_init_lock(upd, lc);
 	if (rc)
 		goto done;
@@ -950,6 +1341,143 @@ done:
 	return rc;
 }
 
+/*
+ * Removes entries for all @targets from utab, the file is locked, read and
+ * written only once. This is used after recursive umount rather than
+ * mnt_update_table() for each unmounted filesystem.
+ *
+ * Returns: 0 on success, negative number on error.
+ */
+int mnt_update_remove_targets(struct libmnt_update *upd, struct libmnt_lock *lc,
+			      char *const *targets, size_t ntargets)
+{
+	struct libmnt_table *tb;
+	char *dirname;
+	size_t i;
+	int rc, changed = 0;
+
+	if (!upd || !upd->filename)
+		return -EINVAL;
+	if (!ntargets)
+		return 0;
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: remove %zu entries", upd->filename, ntargets));
+
+	dirname = mnt_get_utab_dir(upd->filename);
+	if (dirname) {
+		rc = fragments_remove_targets(dirname, targets, ntargets);
+		free(dirname);
+		if (rc)
+			return rc;
+	}
+
+	/* old entries in the utab file */
+	if (is_file_empty(upd->filename))
+		return 0;
+
+	rc = update_init_lock(upd, lc);
+	if (rc)
+		return rc;
+	rc = mnt_lock_file(upd->lock);
+	if (rc)
+		return -MNT_ERR_LOCK;
+
+	tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+	if (tb) {
+		for (i = 0; i < ntargets; i++) {
+			struct libmnt_fs *rem = mnt_table_find_target(tb,
+						targets[i], MNT_ITER_BACKWARD);
+			if (rem) {
+				mnt_table_remove_fs(tb, rem);
+				changed = 1;
+			}
+		}
+		if (changed)
+			rc = update_table(upd, tb);
+	}
+
+	mnt_unlock_file(upd->lock);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+/*
+ * Adds entries for all @targets to utab, the entries are copies of the
+ * prepared @upd entry (see mnt_update_set_fs()) with a different target. The
+ * file is locked, read and written only once. This is used for more clones
+ * of the same bind mount.
+ *
+ * Returns: 0 on success, negative number on error.
+ */
+int mnt_update_add_targets(struct libmnt_update *upd, struct libmnt_lock *lc,
+			   char *const *targets, size_t ntargets)
+{
+	struct libmnt_table *tb = NULL;
+	char *dirname;
+	size_t i;
+	int rc = 0;
+
+	if (!upd || !upd->filename)
+		return -EINVAL;
+	if (!upd->fs || !ntargets)
+		return 0;
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: add %zu entries", upd->filename, ntargets));
+
+	dirname = mnt_get_utab_dir(upd->filename);
+	if (dirname) {
+		struct timespec ts;
+
+		/* the copies have no mount ID, use the index to make the
+		 * anonymous names unique */
+		clock_gettime(CLOCK_REALTIME, &ts);
+
+		for (i = 0; rc == 0 && i < ntargets; i++) {
+			struct libmnt_fs *fs = mnt_copy_fs(NULL, upd->fs);
+			char name[64];
+
+			snprintf(name, sizeof(name), "anon-%d-%jd%09ld-%zu",
+					(int) getpid(), (intmax_t) ts.tv_sec,
+					(long) ts.tv_nsec, i);
+
+			rc = fs ? mnt_fs_set_target(fs, targets[i]) : -ENOMEM;
+			if (!rc) {
+				fs->id = 0;	/* ID of the template mount */
+				rc = write_utab_fragment(upd, dirname, name, fs);
+			}
+			mnt_unref_fs(fs);
+		}
+		free(dirname);
+		return rc;
+	}
+
+	rc = update_init_lock(upd, lc);
+	if (rc)
+		return rc;
+	rc = mnt_lock_file(upd->lock);
+	if (rc)
+		return -MNT_ERR_LOCK;
+
+	tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+	if (!tb)
+		rc = -ENOMEM;
+
+	for (i = 0; rc == 0 && i < ntargets; i++) {
+		struct libmnt_fs *fs = mnt_copy_fs(NULL, upd->fs);
+
+		rc = fs ? mnt_fs_set_target(fs, targets[i]) : -ENOMEM;
+		if (!rc)
+			rc = mnt_table_add_fs(tb, fs);
+		mnt_unref_fs(fs);
+	}
+	if (!rc)
+		rc = update_table(upd, tb);
+
+	mnt_unlock_file(upd->lock);
+	mnt_unref_table(tb);
+	return rc;
+}
+
 int mnt_update_already_done(struct libmnt_update *upd)
 {
 	struct libmnt_table *tb = NULL;
@@ -960,9 +1488,14 @@ int mnt_update_already_done(struct libmnt_update *upd)
 
 	DBG(UPDATE, ul_debugobj(upd, "%s: checking for previous update", upd->filename));
 
-	tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+	tb = mnt_new_table();
 	if (!tb)
 		goto done;
+	if (__mnt_table_parse_utab(tb, upd->filename) < 0) {
+		mnt_unref_table(tb);
+		tb = NULL;
+		goto done;
+	}
 
 	if (upd->fs) {
 		/* mount */
@@ -57,6 +57,22 @@ int mnt_valid_tagname(const char *tagname)
 	return 0;
 }
 
+/*
+ * The hash has to be the same for all paths equal by streq_paths(), so
+ * multiple slashes and the tailing slash are ignored.
+ */
+size_t mnt_hash_path(const char *path)
+{
+	size_t h = FNV_INIT;
+
+	for (; *path; path++) {
+		if (*path == '/' && (*(path + 1) == '/' || !*(path + 1)))
+			continue;
+		h = fnv_add(h, *path);
+	}
+	return h;
+}
+
 /**
  * mnt_tag_is_valid:
  * @tag: NAME=value string
@@ -1017,6 +1033,61 @@ const char *mnt_get_utab_path(void)
 	return p ? : MNT_PATH_UTAB;
 }
 
+/*
+ * Returns path to the directory with utab fragments (e.g. /run/mount/utab.d)
+ * or NULL if the directory does not exist. The fragments are used instead of
+ * the utab file only if the directory has been created by system admin.
+ */
+char *mnt_get_utab_dir(const char *utab)
+{
+	struct stat st;
+	char *dir = NULL;
+
+	if (!utab)
+		utab = mnt_get_utab_path();
+	if (asprintf(&dir, "%s.d", utab) <= 0)
+		return NULL;
+
+	if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		free(dir);
+		return NULL;
+	}
+	return dir;
+}
+
+/*
+ * The utab fragment names are mount IDs or "anon-<unique>". The names with
+ * dots are temporary files (see mnt_open_uniq_filename()).
+ */
+int mnt_is_utab_fragment(const char *name)
+{
+	return name && *name && *name != '.' && !strchr(name, '.');
+}
+
+/* returns 1 if there is no utab entry in the utab file and fragments */
+int mnt_is_utab_empty(const char *utab)
+{
+	char *dirname;
+	int empty = 1;
+
+	if (!utab)
+		utab = mnt_get_utab_path();
+	if (!is_file_empty(utab))
+		return 0;
+
+	dirname = mnt_get_utab_dir(utab);
+	if (dirname) {
+		DIR *dir = opendir(dirname);
+		struct dirent *d;
+
+		while (dir && empty && (d = readdir(dir)))
+			empty = !mnt_is_utab_fragment(d->d_name);
+		if (dir)
+			closedir(dir);
+		free(dirname);
+	}
+	return empty;
+}
 
 /* returns file descriptor or -errno, @name returns a unique filename
  */
@@ -0,0 +1,512 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * Benchmark of the table building and printing. The table shape (number
+ * of rows and columns, cell width, multibyte cells, tree depth, groups)
+ * is configurable, and the same table is printed in all selected output
+ * modes. The results are printed in JSON, the table output is written
+ * to /dev/null (or --output).
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "jsonwrt.h"
+#include "monotonic.h"
+
+#include "libsmartcols.h"
+
+#define BENCH_DEFAULT_ROWS	100000
+#define BENCH_DEFAULT_COLUMNS	8
+#define BENCH_DEFAULT_WIDTH	16
+#define BENCH_DEFAULT_DEPTH	8
+#define BENCH_DEFAULT_MODES	"human,raw,json,export,tree"
+
+enum { COL_NAME, COL_NUM, COL_DATA };
+
+enum {
+	MODE_HUMAN,
+	MODE_RAW,
+	MODE_JSON,
+	MODE_EXPORT,
+	MODE_TREE
+};
+
+static const char *const mode_names[] = {
+	[MODE_HUMAN]	= "human",
+	[MODE_RAW]	= "raw",
+	[MODE_JSON]	= "json",
+	[MODE_EXPORT]	= "export",
+	[MODE_TREE]	= "tree"
+};
+
+struct bench_ctl {
+	size_t		nrows;
+	size_t		ncols;		/* including NAME and NUM */
+	size_t		width;		/* DATA cells width (in chars) */
+	size_t		depth;		/* tree depth (tree mode only) */
+	size_t		group;		/* lines per group (tree mode only) */
+
+	const char	*filter;	/* filter expression */
+	const char	*sort;		/* sort column name */
+	char		**data;		/* DATA cells content, per column */
+
+	FILE		*out;		/* table output */
+
+	unsigned int	multibyte : 1,
+			arena : 1,
+			streaming : 1;
+};
+
+struct bench_result {
+	uint64_t	build_ns;	/* new table, columns, lines and data */
+	uint64_t	filter_ns;
+	uint64_t	sort_ns;
+	uint64_t	print_ns;
+	uint64_t	free_ns;	/* scols_unref_table() */
+
+	size_t		nlines;		/* printed lines */
+	long		peak_rss;	/* in KiB, or -1 */
+};
+
+/* resets the peak RSS (VmHWM) of the process, supported since Linux 4.0 */
+static int reset_peak_rss(void)
+{
+	int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+	int rc;
+
+	if (fd < 0)
+		return -errno;
+	rc = write(fd, "5", 1) == 1 ? 0 : -errno;
+	close(fd);
+	return rc;
+}
+
+static long get_peak_rss(void)
+{
+	char buf[BUFSIZ], *p;
+	long rss = -1;
+	ssize_t sz;
+	int fd;
+
+	fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	sz = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (sz <= 0)
+		return -1;
+	buf[sz] = '\0';
+
+	p = strstr(buf, "VmHWM:");
+	if (p)
+		rss = strtol(p + 6, NULL, 10);
+	return rss;
+}
+
+/* DATA cells content, @width ASCII or multibyte (2 or 3 bytes) chars */
+static char *gen_data(size_t col, size_t width, int multibyte)
+{
+	static const char *const mb[] = { "ž", "ř", "ů", "日", "本", "ö" };
+	char *str, *p;
+	size_t i;
+
+	p = str = xmalloc(width * 3 + 1);
+	for (i = 0; i < width; i++) {
+		if (multibyte && i % 2) {
+			const char *c = mb[(col + i) % ARRAY_SIZE(mb)];
+			size_t len = strlen(c);
+
+			memcpy(p, c, len);
+			p += len;
+		} else
+			*p++ = 'a' + (col + i) % 26;
+	}
+	*p = '\0';
+	return str;
+}
+
+static void setup_columns(struct bench_ctl *ctl, struct libscols_table *tb, int mode)
+{
+	struct libscols_column *cl;
+	size_t i;
+
+	cl = scols_table_new_column(tb, "NAME", 0, mode == MODE_TREE ? SCOLS_FL_TREE : 0);
+	if (!cl)
+		goto fail;
+
+	cl = scols_table_new_column(tb, "NUM", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_data_type(cl, SCOLS_DATA_U64);
+	scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+
+	for (i = COL_DATA; i < ctl->ncols; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "DATA%zu", i - COL_DATA);
+		if (!scols_table_new_column(tb, name, 0, SCOLS_FL_TRUNC))
+			goto fail;
+	}
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static struct libscols_table *build_table(struct bench_ctl *ctl, int mode)
+{
+	struct libscols_table *tb;
+	struct libscols_line *parent = NULL, *group = NULL;
+	size_t i, j;
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	scols_table_set_stream(tb, ctl->out);
+	scols_table_set_name(tb, "bench");
+	if (ctl->arena)
+		scols_table_enable_arena(tb, 1);
+	if (ctl->streaming)
+		scols_table_enable_streaming(tb, 1);
+
+	switch (mode) {
+	case MODE_RAW:
+		scols_table_enable_raw(tb, 1);
+		break;
+	case MODE_JSON:
+		scols_table_enable_json(tb, 1);
+		break;
+	case MODE_EXPORT:
+		scols_table_enable_export(tb, 1);
+		break;
+	}
+
+	setup_columns(ctl, tb, mode);
+
+	for (i = 0; i < ctl->nrows; i++) {
+		struct libscols_line *ln;
+		char buf[32];
+
+		/* tree of chains, every chain is @depth lines deep */
+		if (mode == MODE_TREE && i % ctl->depth == 0)
+			parent = NULL;
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			err(EXIT_FAILURE, "failed to create output line");
+
+		snprintf(buf, sizeof(buf), "line-%zu", i);
+		if (scols_line_set_data(ln, COL_NAME, buf))
+			goto fail;
+		snprintf(buf, sizeof(buf), "%zu", i);
+		if (scols_line_set_data(ln, COL_NUM, buf))
+			goto fail;
+		for (j = COL_DATA; j < ctl->ncols; j++) {
+			if (scols_line_set_data(ln, j, ctl->data[j]))
+				goto fail;
+		}
+
+		if (mode == MODE_TREE) {
+			if (ctl->group) {
+				if (i % ctl->group == 0)
+					group = ln;
+				else if (scols_table_group_lines(tb, ln, group, 0))
+					goto fail;
+			}
+			parent = ln;
+		}
+	}
+	return tb;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to set output data");
+}
+
+static void filter_table(struct bench_ctl *ctl, struct libscols_table *tb)
+{
+	struct libscols_filter *fltr;
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
+	const char *name = NULL;
+
+	fltr = scols_new_filter(ctl->filter);
+	if (!fltr)
+		err(EXIT_FAILURE, "failed to allocate filter");
+	if (scols_filter_get_errmsg(fltr))
+		errx(EXIT_FAILURE, "failed to parse filter: %s",
+				scols_filter_get_errmsg(fltr));
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, "failed to allocate iterator");
+
+	while (scols_filter_next_holder(fltr, itr, &name, 0) == 0) {
+		struct libscols_column *cl = scols_table_get_column_by_name(tb, name);
+
+		if (!cl)
+			errx(EXIT_FAILURE, "%s: unknown column in filter", name);
+		scols_filter_assign_column(fltr, itr, name, cl);
+	}
+
+	/* the iterator already points to the next line, so the current
+	 * line may be removed */
+	scols_reset_iter(itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(tb, itr, &ln) == 0) {
+		struct libscols_line *parent;
+		int status = 0;
+
+		/* keep the tree consistent, only leaves are filtered */
+		if (scols_line_has_children(ln))
+			continue;
+		if (scols_line_apply_filter(ln, fltr, &status))
+			err(EXIT_FAILURE, "failed to apply filter");
+		if (status)
+			continue;
+
+		parent = scols_line_get_parent(ln);
+		if (parent)
+			scols_line_remove_child(parent, ln);
+		scols_table_remove_line(tb, ln);
+	}
+
+	scols_free_iter(itr);
+	scols_unref_filter(fltr);
+}
+
+static void run_mode(struct bench_ctl *ctl, int mode, struct bench_result *res)
+{
+	struct libscols_table *tb;
+	uint64_t t0;
+
+	memset(res, 0, sizeof(*res));
+	if (reset_peak_rss() != 0)
+		res->peak_rss = -1;
+
+	t0 = gettime_monotonic_nsec();
+	tb = build_table(ctl, mode);
+	res->build_ns = gettime_monotonic_nsec() - t0;
+
+	if (ctl->filter) {
+		t0 = gettime_monotonic_nsec();
+		filter_table(ctl, tb);
+		res->filter_ns = gettime_monotonic_nsec() - t0;
+	}
+	if (ctl->sort) {
+		struct libscols_column *cl = scols_table_get_column_by_name(tb, ctl->sort);
+
+		if (!cl)
+			errx(EXIT_FAILURE, "%s: unknown sort column", ctl->sort);
+		t0 = gettime_monotonic_nsec();
+		scols_sort_table(tb, cl);
+		res->sort_ns = gettime_monotonic_nsec() - t0;
+	}
+	res->nlines = scols_table_get_nlines(tb);
+
+	t0 = gettime_monotonic_nsec();
+	scols_print_table(tb);
+	fflush(ctl->out);
+	res->print_ns = gettime_monotonic_nsec() - t0;
+
+	if (res->peak_rss == 0)
+		res->peak_rss = get_peak_rss();
+
+	t0 = gettime_monotonic_nsec();
+	scols_unref_table(tb);
+	res->free_ns = gettime_monotonic_nsec() - t0;
+}
+
+static void print_result(struct ul_jsonwrt *json, struct bench_ctl *ctl,
+			 int mode, struct bench_result *res)
+{
+	/* in streaming mode the lines are printed and removed during build */
+	size_t ncells = (ctl->streaming ? ctl->nrows : res->nlines) * ctl->ncols;
+
+	ul_jsonwrt_object_open(json, NULL);
+	ul_jsonwrt_value_s(json, "mode", mode_names[mode]);
+	ul_jsonwrt_value_u64(json, "rows", ctl->nrows);
+	ul_jsonwrt_value_u64(json, "columns", ctl->ncols);
+	ul_jsonwrt_value_u64(json, "cells", ncells);
+	ul_jsonwrt_value_u64(json, "build_ns", res->build_ns);
+	ul_jsonwrt_value_u64(json, "filter_ns", res->filter_ns);
+	ul_jsonwrt_value_u64(json, "sort_ns", res->sort_ns);
+	ul_jsonwrt_value_u64(json, "print_ns", res->print_ns);
+	ul_jsonwrt_value_u64(json, "free_ns", res->free_ns);
+	ul_jsonwrt_value_double(json, "print_ns_per_cell",
+			ncells ? (double) res->print_ns / ncells : 0);
+	ul_jsonwrt_value_double(json, "total_ns_per_cell",
+			ncells ? (double) (res->build_ns + res->filter_ns + res->sort_ns
+					   + res->print_ns + res->free_ns) / ncells : 0);
+	if (res->peak_rss >= 0)
+		ul_jsonwrt_value_u64(json, "peak_rss_kb", res->peak_rss);
+	else
+		ul_jsonwrt_value_null(json, "peak_rss_kb");
+	ul_jsonwrt_object_close(json);
+}
+
+static int name_to_mode(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(mode_names); i++) {
+		if (strlen(mode_names[i]) == namesz
+		    && strncmp(name, mode_names[i], namesz) == 0)
+			return i;
+	}
+	warnx("unknown mode: %s", name);
+	return -1;
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+
+	fprintf(out, "Usage: %s [options]\n", program_invocation_short_name);
+	fputs("\nOptions:\n", out);
+	fputs(" -r, --rows <num>        number of rows\n", out);
+	fputs(" -c, --columns <num>     number of columns (min 3)\n", out);
+	fputs(" -w, --width <num>       width of the DATA cells\n", out);
+	fputs(" -M, --multibyte         use multibyte chars in the DATA cells\n", out);
+	fputs(" -d, --depth <num>       depth of the tree (tree mode)\n", out);
+	fputs(" -g, --group <num>       lines per group (tree mode)\n", out);
+	fputs(" -f, --filter <expr>     filter lines, e.g. 'NUM > 1000'\n", out);
+	fputs(" -s, --sort <column>     sort by column, e.g. DATA0\n", out);
+	fputs(" -m, --modes <list>      output modes, default " BENCH_DEFAULT_MODES "\n", out);
+	fputs(" -a, --arena             enable arena allocation\n", out);
+	fputs(" -S, --streaming         enable streaming mode\n", out);
+	fputs(" -o, --output <file>     write the table to the file (default /dev/null)\n", out);
+	fputs(" -h, --help              display this help\n", out);
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_ctl ctl = {
+		.nrows = BENCH_DEFAULT_ROWS,
+		.ncols = BENCH_DEFAULT_COLUMNS,
+		.width = BENCH_DEFAULT_WIDTH,
+		.depth = BENCH_DEFAULT_DEPTH
+	};
+	struct ul_jsonwrt json;
+	const char *outfile = "/dev/null";
+	int modes[ARRAY_SIZE(mode_names)];
+	int nmodes = 0, c, i;
+	size_t j;
+
+	static const struct option longopts[] = {
+		{ "rows",      required_argument, NULL, 'r' },
+		{ "columns",   required_argument, NULL, 'c' },
+		{ "width",     required_argument, NULL, 'w' },
+		{ "multibyte", no_argument,       NULL, 'M' },
+		{ "depth",     required_argument, NULL, 'd' },
+		{ "group",     required_argument, NULL, 'g' },
+		{ "filter",    required_argument, NULL, 'f' },
+		{ "sort",      required_argument, NULL, 's' },
+		{ "modes",     required_argument, NULL, 'm' },
+		{ "arena",     no_argument,       NULL, 'a' },
+		{ "streaming", no_argument,       NULL, 'S' },
+		{ "output",    required_argument, NULL, 'o' },
+		{ "help",      no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");	/* for multibyte chars */
+
+	while ((c = getopt_long(argc, argv, "r:c:w:Md:g:f:s:m:aSo:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'r':
+			ctl.nrows = strtou32_or_err(optarg, "failed to parse number of rows");
+			break;
+		case 'c':
+			ctl.ncols = strtou32_or_err(optarg, "failed to parse number of columns");
+			if (ctl.ncols < COL_DATA + 1)
+				errx(EXIT_FAILURE, "at least %d columns required", COL_DATA + 1);
+			break;
+		case 'w':
+			ctl.width = strtou32_or_err(optarg, "failed to parse width");
+			break;
+		case 'M':
+			ctl.multibyte = 1;
+			break;
+		case 'd':
+			ctl.depth = strtou32_or_err(optarg, "failed to parse depth");
+			if (!ctl.depth)
+				errx(EXIT_FAILURE, "depth must be greater than zero");
+			break;
+		case 'g':
+			ctl.group = strtou32_or_err(optarg, "failed to parse group size");
+			break;
+		case 'f':
+			ctl.filter = optarg;
+			break;
+		case 's':
+			ctl.sort = optarg;
+			break;
+		case 'm':
+			nmodes = string_to_idarray(optarg, modes, ARRAY_SIZE(modes), name_to_mode);
+			if (nmodes <= 0)
+				errx(EXIT_FAILURE, "failed to parse modes: %s", optarg);
+			break;
+		case 'a':
+			ctl.arena = 1;
+			break;
+		case 'S':
+			ctl.streaming = 1;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (ctl.streaming && (ctl.filter || ctl.sort))
+		errx(EXIT_FAILURE, "--streaming cannot be used with --filter or --sort");
+
+	if (!nmodes)
+		nmodes = string_to_idarray(BENCH_DEFAULT_MODES, modes,
+				ARRAY_SIZE(modes), name_to_mode);
+
+	ctl.out = fopen(outfile, "w" UL_CLOEXECSTR);
+	if (!ctl.out)
+		err(EXIT_FAILURE, "cannot open %s", outfile);
+
+	ctl.data = xcalloc(ctl.ncols, sizeof(char *));
+	for (j = COL_DATA; j < ctl.ncols; j++)
+		ctl.data[j] = gen_data(j, ctl.width, ctl.multibyte);
+
+	scols_init_debug(0);
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "results");
+
+	for (i = 0; i < nmodes; i++) {
+		struct bench_result res;
+
+		run_mode(&ctl, modes[i], &res);
+		print_result(&json, &ctl, modes[i], &res);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+
+	for (j = COL_DATA; j < ctl.ncols; j++)
+		free(ctl.data[j]);
+	free(ctl.data);
+	fclose(ctl.out);
+	return EXIT_SUCCESS;
+}
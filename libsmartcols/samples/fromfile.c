@@ -204,11 +204,13 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 		"\n %s [options] <column-data-file> ...\n\n", program_invocation_short_name);
 
+	fputs(" -A, --arena                    use arena allocator\n", out);
 	fputs(" -m, --maxout                   fill all terminal width\n", out);
 	fputs(" -M, --minout                   minimize tailing padding\n", out);
 	fputs(" -c, --column <file>            column definition\n", out);
 	fputs(" -n, --nlines <num>             number of lines\n", out);
 	fputs(" -J, --json                     JSON output format\n", out);
+	fputs(" -B, --cbor                     CBOR output format\n", out);
 	fputs(" -r, --raw                      RAW output format\n", out);
 	fputs(" -E, --export                   use key=\"value\" output format\n", out);
 	fputs(" -C, --colsep <str>             set columns separator\n", out);
@@ -232,6 +234,7 @@ int main(int argc, char *argv[])
 	struct libscols_filter *fltr = NULL;
 
 	static const struct option longopts[] = {
+		{ "arena",  0, NULL, 'A' },
 		{ "maxout", 0, NULL, 'm' },
 		{ "minout", 0, NULL, 'M' },
 		{ "column", 1, NULL, 'c' },
@@ -240,6 +243,7 @@ int main(int argc, char *argv[])
 		{ "tree-parent-column", 1, NULL, 'p' },
 		{ "tree-id-column",	1, NULL, 'i' },
 		{ "json",   0, NULL, 'J' },
+		{ "cbor",   0, NULL, 'B' },
 		{ "raw",    0, NULL, 'r' },
 		{ "export", 0, NULL, 'E' },
 		{ "colsep",  1, NULL, 'C' },
@@ -250,7 +254,7 @@ int main(int argc, char *argv[])
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'E', 'J', 'r' },
+		{ 'B', 'E', 'J', 'r' },
 		{ 'M', 'm' },
 		{ 0 }
 	};
@@ -263,11 +267,14 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:dEi:JMmn:p:Q:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "ABhCc:dEi:JMmn:p:Q:rw:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch(c) {
+		case 'A':
+			scols_table_enable_arena(tb, TRUE);
+			break;
 		case 'c': /* add column from file */
 		{
 			struct libscols_column *cl = parse_column(optarg);
@@ -290,6 +297,10 @@ int main(int argc, char *argv[])
 			scols_table_enable_json(tb, 1);
 			scols_table_set_name(tb, "testtable");
 			break;
+		case 'B':
+			scols_table_enable_cbor(tb, 1);
+			scols_table_set_name(tb, "testtable");
+			break;
 		case 'm':
 			scols_table_enable_maxout(tb, TRUE);
 			break;
@@ -0,0 +1,142 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+#include "libsmartcols.h"
+
+enum { COL_NUM, COL_NAME, COL_DATA };
+
+/* add columns to the @tb */
+static void setup_columns(struct libscols_table *tb)
+{
+	if (!scols_table_new_column(tb, "NUM", 0, SCOLS_FL_RIGHT))
+		goto fail;
+	if (!scols_table_new_column(tb, "NAME", 0, SCOLS_FL_TRUNC))
+		goto fail;
+	if (!scols_table_new_column(tb, "DATA", 0, 0))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void add_line(struct libscols_table *tb, size_t i)
+{
+	char *p;
+	struct libscols_line *ln = scols_table_new_line(tb, NULL);
+
+	if (!ln)
+		err(EXIT_FAILURE, "failed to create output line");
+
+	xasprintf(&p, "%zu", i);
+	if (scols_line_refer_data(ln, COL_NUM, p))
+		goto fail;
+
+	/* every 4th name is longer than names in the first lines */
+	xasprintf(&p, i % 4 == 3 ? "long-name-%zu" : "name%zu", i);
+	if (scols_line_refer_data(ln, COL_NAME, p))
+		goto fail;
+
+	xasprintf(&p, "data-%02zu", i * 7);
+	if (scols_line_refer_data(ln, COL_DATA, p))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output line");
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n\n", program_invocation_short_name);
+
+	fputs(" -n, --nlines <num>             number of lines\n", out);
+	fputs(" -c, --calc-lines <num>         number of lines used to calculate widths\n", out);
+	fputs(" -J, --json                     JSON output format\n", out);
+	fputs(" -r, --raw                      RAW output format\n", out);
+	fputs(" -w, --width <num>              hardcode terminal width\n", out);
+	fputs(" -h, --help                     this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	size_t i, nlines = 10;
+	int c;
+
+	static const struct option longopts[] = {
+		{ "nlines",     1, NULL, 'n' },
+		{ "calc-lines", 1, NULL, 'c' },
+		{ "json",       0, NULL, 'J' },
+		{ "raw",        0, NULL, 'r' },
+		{ "width",      1, NULL, 'w' },
+		{ "help",       0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	scols_table_enable_streaming(tb, 1);
+
+	while((c = getopt_long(argc, argv, "c:hJn:rw:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'c':
+			scols_table_set_streaming_lines(tb,
+				strtou32_or_err(optarg, "failed to parse number of lines"));
+			break;
+		case 'J':
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "streaming");
+			break;
+		case 'n':
+			nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 'r':
+			scols_table_enable_raw(tb, 1);
+			break;
+		case 'w':
+			scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+			scols_table_set_termwidth(tb, strtou32_or_err(optarg, "failed to parse terminal width"));
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	setup_columns(tb);
+
+	for (i = 0; i < nlines; i++) {
+		add_line(tb, i);
+
+		/* JSON does not need width calculation, only the last line is kept */
+		if (scols_table_is_json(tb) && scols_table_get_nlines(tb) > 1)
+			errx(EXIT_FAILURE, "lines not streamed");
+	}
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * arena.c - simple memory pool for lines and cell data
+ *
+ * The arena allocates memory in large chunks and does not support free() of
+ * the allocated objects. All the memory is deallocated when the last
+ * reference to the arena is dropped (the table and all lines allocated from
+ * the arena reference it).
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "smartcolsP.h"
+
+#define ARENA_CHUNKSZ	(64 * 1024)
+#define ARENA_ALIGN	sizeof(void *)
+
+struct arena_chunk {
+	struct arena_chunk	*next;
+	size_t			size;		/* size of data[] */
+	size_t			used;		/* already allocated bytes */
+	char			data[];
+};
+
+struct libscols_arena {
+	int			refcount;
+	struct arena_chunk	*chunks;	/* the first chunk is the current one */
+};
+
+struct libscols_arena *scols_new_arena(void)
+{
+	struct libscols_arena *ar = calloc(1, sizeof(*ar));
+
+	if (!ar)
+		return NULL;
+	ar->refcount = 1;
+	DBG(TAB, ul_debugobj(ar, "alloc arena"));
+	return ar;
+}
+
+void scols_ref_arena(struct libscols_arena *ar)
+{
+	if (ar)
+		ar->refcount++;
+}
+
+void scols_unref_arena(struct libscols_arena *ar)
+{
+	if (ar && --ar->refcount <= 0) {
+		DBG(TAB, ul_debugobj(ar, "dealloc arena"));
+		while (ar->chunks) {
+			struct arena_chunk *next = ar->chunks->next;
+
+			free(ar->chunks);
+			ar->chunks = next;
+		}
+		free(ar);
+	}
+}
+
+static struct arena_chunk *new_chunk(size_t size)
+{
+	struct arena_chunk *ch = malloc(sizeof(*ch) + size);
+
+	if (!ch)
+		return NULL;
+	ch->next = NULL;
+	ch->size = size;
+	ch->used = 0;
+	return ch;
+}
+
+static void *arena_alloc(struct libscols_arena *ar, size_t sz, size_t align)
+{
+	struct arena_chunk *ch = ar->chunks;
+	size_t off = 0;
+
+	if (ch)
+		off = (ch->used + align - 1) & ~(align - 1);
+
+	if (!ch || off + sz > ch->size) {
+		/* large objects have their own chunk, keep the current one */
+		if (ch && sz > ARENA_CHUNKSZ / 4) {
+			struct arena_chunk *big = new_chunk(sz);
+
+			if (!big)
+				return NULL;
+			big->used = sz;
+			big->next = ch->next;
+			ch->next = big;
+			return big->data;
+		}
+
+		ch = new_chunk(max(sz, (size_t) ARENA_CHUNKSZ));
+		if (!ch)
+			return NULL;
+		ch->next = ar->chunks;
+		ar->chunks = ch;
+		off = 0;
+	}
+
+	ch->used = off + sz;
+	return ch->data + off;
+}
+
+/* returns zeroed memory aligned for any libsmartcols struct */
+void *scols_arena_alloc(struct libscols_arena *ar, size_t sz)
+{
+	void *p;
+
+	if (!ar || !sz)
+		return NULL;
+
+	p = arena_alloc(ar, sz, ARENA_ALIGN);
+	if (p)
+		memset(p, 0, sz);
+	return p;
+}
+
+char *scols_arena_strdup(struct libscols_arena *ar, const char *str)
+{
+	size_t sz;
+	char *p;
+
+	if (!ar || !str)
+		return NULL;
+
+	sz = strlen(str) + 1;
+	p = arena_alloc(ar, sz, 1);
+	if (p)
+		memcpy(p, str, sz);
+	return p;
+}
@@ -48,6 +48,16 @@ static int count_cell_width(struct libscols_table *tb,
 	char *data;
 
 	ce = scols_line_get_cell(ln, cl->seqnum);
+
+	/* the buffer would contain only the cell data, use the cached width */
+	if (ce && !scols_column_is_tree(cl) && !scols_column_is_wrap(cl)
+	    && !scols_column_is_customwrap(cl)) {
+		len = __scols_cell_get_width(ce, scols_table_is_noencoding(tb));
+		ce->width = len;
+		cl->wstat.width_max = max(len, cl->wstat.width_max);
+		return 0;
+	}
+
 	scols_table_set_cursor(tb, ln, cl, ce);
 
 	rc = __cursor_to_buffer(tb, buf, 1);
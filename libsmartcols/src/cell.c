@@ -25,12 +25,23 @@
 #include <ctype.h>
 
 #include "smartcolsP.h"
+#include "mbsalign.h"
 
 /*
  * The cell has no ref-counting, free() and new() functions. All is
  * handled by libscols_line.
  */
 
+/* the data allocated from arena are released together with the arena */
+static void cell_free_data(struct libscols_cell *ce)
+{
+	if (!ce->is_arena)
+		free(ce->data);
+	ce->data = NULL;
+	ce->is_arena = 0;
+	ce->has_width = 0;
+}
+
 /**
  * scols_reset_cell:
  * @ce: pointer to a struct libscols_cell instance
@@ -45,7 +56,7 @@ int scols_reset_cell(struct libscols_cell *ce)
 		return -EINVAL;
 
 	/*DBG(CELL, ul_debugobj(ce, "reset"));*/
-	free(ce->data);
+	cell_free_data(ce);
 	free(ce->color);
 	memset(ce, 0, sizeof(*ce));
 	return 0;
@@ -67,12 +78,66 @@ int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 	if (!ce)
 		return -EINVAL;
 
+	if (ce->is_arena)
+		cell_free_data(ce);	/* don't free() arena memory */
+	ce->has_width = 0;
 	ce->is_filled = 1;
 	rc = strdup_to_struct_member(ce, data, data);
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	return rc;
 }
 
+/* scols_line_set_data() backend for lines with arena */
+int __scols_cell_set_arena_data(struct libscols_cell *ce,
+				struct libscols_arena *ar, const char *data)
+{
+	char *p = NULL;
+
+	if (!ce || !ar)
+		return -EINVAL;
+	if (data) {
+		p = scols_arena_strdup(ar, data);
+		if (!p)
+			return -ENOMEM;
+	}
+
+	cell_free_data(ce);
+	ce->data = p;
+	ce->is_arena = p ? 1 : 0;
+	ce->is_filled = 1;
+	ce->datasiz = p && *p ? strlen(p) + 1 : 0;
+	return 0;
+}
+
+/*
+ * Returns width of the cell data (as a string). The width is cached in the
+ * cell until the data are modified by the cell API.
+ */
+size_t __scols_cell_get_width(struct libscols_cell *ce, int noencoding)
+{
+	size_t len;
+
+	noencoding = noencoding ? 1 : 0;
+	if (ce->has_width && (ce->is_ascii || ce->width_noenc == noencoding))
+		return ce->datawidth;
+
+	len = ce->data ? strlen(ce->data) : 0;
+	ce->is_ascii = mbs_is_safe_ascii(ce->data, len);
+
+	if (ce->is_ascii)
+		ce->datawidth = len;
+	else {
+		ce->datawidth = noencoding ? mbs_width(ce->data) :
+					     mbs_safe_width(ce->data);
+		if (ce->datawidth == (size_t) -1)	/* ignore broken multibyte strings */
+			ce->datawidth = 0;
+	}
+
+	ce->width_noenc = noencoding;
+	ce->has_width = 1;
+	return ce->datawidth;
+}
+
 /**
  * scols_cell_refer_data:
  * @ce: a pointer to a struct libscols_cell instance
@@ -89,7 +154,7 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	cell_free_data(ce);
 	ce->data = data;
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	ce->is_filled = 1;
@@ -117,7 +182,7 @@ int scols_cell_refer_memory(struct libscols_cell *ce, char *data, size_t datasiz
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	cell_free_data(ce);
 	ce->data = data;
 	ce->datasiz = datasiz;
 	return 0;
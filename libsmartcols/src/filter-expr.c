@@ -11,6 +11,8 @@ struct filter_expr {
 
 	struct filter_node *left;
 	struct filter_node *right;
+
+	int dtype;		/* data type for comparison, see filter_compile_expr() */
 };
 
 struct filter_node *filter_new_expr(
@@ -175,6 +177,46 @@ static int guess_expr_datatype(struct filter_expr *n)
 	return type;
 }
 
+static inline int is_logical_expr(struct filter_expr *n)
+{
+	return n->type == F_EXPR_AND || n->type == F_EXPR_OR
+	       || n->type == F_EXPR_NEG;
+}
+
+static int compile_node(struct libscols_filter *fltr, struct filter_node *n,
+			int dtype)
+{
+	struct filter_param *pr;
+
+	if (!n)
+		return 0;
+	if (n->type == F_NODE_EXPR)
+		return filter_compile_expr(fltr, (struct filter_expr *) n);
+
+	/* convert constants to the comparison type only once rather than
+	 * copy and cast them for each line */
+	pr = (struct filter_param *) n;
+	if (dtype == SCOLS_DATA_NONE || is_filter_holder_node(n)
+	    || n->refcount > 1 || filter_param_get_datatype(pr) == dtype)
+		return 0;
+
+	return filter_param_cast_const(pr, dtype);
+}
+
+/* The holders have to be already typed (see filter_param_reset_holder()). */
+int filter_compile_expr(struct libscols_filter *fltr, struct filter_expr *n)
+{
+	int rc;
+
+	if (!is_logical_expr(n))
+		n->dtype = guess_expr_datatype(n);
+
+	rc = compile_node(fltr, n->left, n->dtype);
+	if (!rc)
+		rc = compile_node(fltr, n->right, n->dtype);
+	return rc;
+}
+
 int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 			struct filter_expr *n, int *status)
 {
@@ -204,7 +246,7 @@ int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 		break;
 	}
 
-	type = guess_expr_datatype(n);
+	type = n->dtype ? : guess_expr_datatype(n);
 
 	/* compare data */
 	rc = cast_node(fltr, ln, type, n->left, &l);
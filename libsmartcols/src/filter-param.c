@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <ctype.h>
 #include <regex.h>
 
 #include "rpmatch.h"
@@ -25,7 +26,8 @@ struct filter_param {
 	regex_t *re;
 
 	unsigned int fetched :1,	/* holder requested */
-		     empty : 1;
+		     empty : 1,
+		     borrowed : 1;	/* val.str refers to cell data */
 };
 
 static int cast_param(int type, struct filter_param *n);
@@ -89,6 +91,24 @@ static int param_set_data(struct filter_param *n, int type, const void *data)
 	return 0;
 }
 
+/* Use cell data without strdup() if possible, the data has be to unmodified
+ * by param_set_data() (no quotes and whitespaces to trim). */
+static int param_refer_string(struct filter_param *n, const char *data)
+{
+	size_t sz = data ? strlen(data) : 0;
+
+	if (sz == 0 || *data == '"' || *data == '\''
+	    || isspace((unsigned char) *data)
+	    || isspace((unsigned char) data[sz - 1]))
+		return param_set_data(n, SCOLS_DATA_STRING, data);
+
+	n->val.str = (char *) data;
+	n->type = SCOLS_DATA_STRING;
+	n->empty = 0;
+	n->borrowed = 1;
+	return 0;
+}
+
 struct filter_node *filter_new_param(
 		struct libscols_filter *fltr,
 		int type,
@@ -172,12 +192,13 @@ static struct filter_param *copy_param(struct filter_param *n)
 
 static void param_reset_data(struct filter_param *n)
 {
-	if (n->type == SCOLS_DATA_STRING)
+	if (n->type == SCOLS_DATA_STRING && !n->borrowed)
 		free(n->val.str);
 
 	memset(&n->val, 0, sizeof(n->val));
 	n->fetched = 0;
 	n->empty = 1;
+	n->borrowed = 0;
 
 	if (n->re) {
 		regfree(n->re);
@@ -311,7 +332,7 @@ static int fetch_holder_data(struct libscols_filter *fltr __attribute__((__unuse
 	} else {
 		DBG(FPARAM, ul_debugobj(n, " using as string"));
 		data = scols_line_get_column_data(ln, n->col);
-		rc = param_set_data(n, SCOLS_DATA_STRING, data);
+		rc = param_refer_string(n, data);
 	}
 
 	/* cast to the wanted type */
@@ -637,7 +658,9 @@ static int string_cast(int type, struct filter_param *n)
 		return -EINVAL;
 	}
 
-	free(str);
+	if (!n->borrowed)
+		free(str);
+	n->borrowed = 0;
 	return 0;
 }
 
@@ -752,6 +775,18 @@ static int cast_param(int type, struct filter_param *n)
 	return rc;
 }
 
+/* in-place cast for params without holder (the type is final) */
+int filter_param_cast_const(struct filter_param *n, int type)
+{
+	if (n->holder)
+		return -EINVAL;
+	if (n->empty) {
+		n->type = type;
+		return 0;
+	}
+	return cast_param(type, n);
+}
+
 int filter_cast_param(struct libscols_filter *fltr,
 		      struct libscols_line *ln,
 		      int type,
@@ -847,6 +882,7 @@ int scols_filter_assign_column(struct libscols_filter *fltr,
 					scols_column_get_name(col)));
 		n->col = col;
 		scols_ref_column(col);
+		fltr->compiled = 0;	/* compile again */
 	}
 
 	return n ? 0 : -EINVAL;
@@ -82,6 +82,7 @@ static void reset_filter(struct libscols_filter *fltr)
 
 	free(fltr->errmsg);
 	fltr->errmsg = NULL;
+	fltr->compiled = 0;
 }
 
 static void remove_counters(struct libscols_filter *fltr)
@@ -263,6 +264,32 @@ int filter_eval_node(struct libscols_filter *fltr, struct libscols_line *ln,
 	return -EINVAL;
 }
 
+/*
+ * Prepares the filter for evaluation. The holders are typed according to
+ * assigned columns and the constants are converted to the types used by the
+ * expressions, so nothing of this is repeated for each line.
+ */
+static int compile_filter(struct libscols_filter *fltr)
+{
+	struct libscols_iter itr;
+	struct filter_param *prm = NULL;
+	int rc = 0;
+
+	DBG(FLTR, ul_debugobj(fltr, "compiling"));
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (filter_next_param(fltr, &itr, &prm) == 0)
+		filter_param_reset_holder(prm);
+
+	if (fltr->root && fltr->root->type == F_NODE_EXPR)
+		rc = filter_compile_expr(fltr, (struct filter_expr *) fltr->root);
+	if (rc == 0)
+		fltr->compiled = 1;
+
+	DBG(FLTR, ul_debugobj(fltr, "compile done [rc=%d]", rc));
+	return rc;
+}
+
 /**
  * scols_line_apply_filter:
  * @ln: apply filter to the line
@@ -285,6 +312,12 @@ int scols_line_apply_filter(struct libscols_line *ln,
 	if (!ln || !fltr)
 		return -EINVAL;
 
+	if (!fltr->compiled) {
+		rc = compile_filter(fltr);
+		if (rc)
+			return rc;
+	}
+
 	/* reset column data and types stored in the filter */
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (filter_next_param(fltr, &itr, &prm) == 0) {
@@ -35,15 +35,26 @@
  * Returns: a pointer to a new struct libscols_line instance.
  */
 struct libscols_line *scols_new_line(void)
+{
+	return __scols_new_line(NULL);
+}
+
+/* allocates the line from @ar if not NULL */
+struct libscols_line *__scols_new_line(struct libscols_arena *ar)
 {
 	struct libscols_line *ln;
 
-	ln = calloc(1, sizeof(*ln));
+	ln = ar ? scols_arena_alloc(ar, sizeof(*ln)) : calloc(1, sizeof(*ln));
 	if (!ln)
 		return NULL;
 
-	DBG(LINE, ul_debugobj(ln, "alloc"));
+	DBG(LINE, ul_debugobj(ln, "alloc%s", ar ? " [arena]" : ""));
 	ln->refcount = 1;
+	if (ar) {
+		ln->arena = ar;
+		ln->is_arena = 1;
+		scols_ref_arena(ar);
+	}
 	INIT_LIST_HEAD(&ln->ln_lines);
 	INIT_LIST_HEAD(&ln->ln_children);
 	INIT_LIST_HEAD(&ln->ln_branch);
@@ -73,6 +84,8 @@ void scols_ref_line(struct libscols_line *ln)
 void scols_unref_line(struct libscols_line *ln)
 {
 	if (ln && --ln->refcount <= 0) {
+		struct libscols_arena *ar = ln->arena;
+
 		DBG(CELL, ul_debugobj(ln, "dealloc"));
 		list_del(&ln->ln_lines);
 		list_del(&ln->ln_children);
@@ -80,7 +93,9 @@ void scols_unref_line(struct libscols_line *ln)
 		scols_unref_group(ln->group);
 		scols_line_free_cells(ln);
 		free(ln->color);
-		free(ln);
+		if (!ln->is_arena)
+			free(ln);
+		scols_unref_arena(ar);
 		return;
 	}
 }
@@ -103,9 +118,11 @@ void scols_line_free_cells(struct libscols_line *ln)
 	for (i = 0; i < ln->ncells; i++)
 		scols_reset_cell(&ln->cells[i]);
 
-	free(ln->cells);
+	if (!ln->cells_arena)
+		free(ln->cells);
 	ln->ncells = 0;
 	ln->cells = NULL;
+	ln->cells_arena = 0;
 }
 
 /**
@@ -136,7 +153,25 @@ int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 
 	DBG(LINE, ul_debugobj(ln, "alloc %zu cells", n));
 
-	ce = reallocarray(ln->cells, n, sizeof(struct libscols_cell));
+	if (ln->arena && !ln->cells) {
+		ce = scols_arena_alloc(ln->arena, n * sizeof(struct libscols_cell));
+		if (!ce)
+			return -ENOMEM;
+		ln->cells = ce;
+		ln->ncells = n;
+		ln->cells_arena = 1;
+		return 0;
+	}
+
+	if (ln->cells_arena) {
+		/* arena memory cannot be resized, move the cells to heap */
+		ce = calloc(n, sizeof(struct libscols_cell));
+		if (!ce)
+			return -errno;
+		memcpy(ce, ln->cells, min(n, ln->ncells) * sizeof(struct libscols_cell));
+		ln->cells_arena = 0;
+	} else
+		ce = reallocarray(ln->cells, n, sizeof(struct libscols_cell));
 	if (!ce)
 		return -errno;
 
@@ -445,6 +480,8 @@ int scols_line_set_data(struct libscols_line *ln, size_t n, const char *data)
 
 	if (!ce)
 		return -EINVAL;
+	if (ln->arena)
+		return __scols_cell_set_arena_data(ce, ln->arena, data);
 	return scols_cell_set_data(ce, data);
 }
 
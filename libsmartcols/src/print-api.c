@@ -114,10 +114,15 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 		DBG(TAB, ul_debugobj(tb, "error -- no columns"));
 		return -EINVAL;
 	}
+	if (tb->streaming && !scols_table_is_tree(tb)
+	    && (tb->stream_started || !list_empty(&tb->tb_lines)))
+		return __scols_finish_stream(tb);
+
 	if (list_empty(&tb->tb_lines)) {
 		DBG(TAB, ul_debugobj(tb, "ignore -- no lines"));
-		if (scols_table_is_json(tb)) {
+		if (is_jsonwrt_format(tb)) {
 			ul_jsonwrt_init(&tb->json, tb->out, 0);
+			ul_jsonwrt_enable_cbor(&tb->json, tb->format == SCOLS_FMT_CBOR);
 			ul_jsonwrt_root_open(&tb->json);
 			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
 			ul_jsonwrt_array_close(&tb->json);
@@ -132,7 +137,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (rc)
 		return rc;
 
-	if (scols_table_is_json(tb)) {
+	if (is_jsonwrt_format(tb)) {
 		ul_jsonwrt_root_open(&tb->json);
 		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
 	}
@@ -149,7 +154,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	else
 		rc = __scols_print_table(tb, &buf);
 
-	if (scols_table_is_json(tb)) {
+	if (is_jsonwrt_format(tb)) {
 		ul_jsonwrt_array_close(&tb->json);
 		ul_jsonwrt_root_close(&tb->json);
 	}
@@ -162,7 +167,8 @@ done:
  * scols_print_table:
  * @tb: table
  *
- * Prints the table to the output stream and terminate by \n.
+ * Prints the table to the output stream and terminate by \n. In streaming mode
+ * (see scols_table_enable_streaming()) prints the rest of the lines only.
  *
  * Returns: 0, a negative value in case of an error.
  */
@@ -171,7 +177,7 @@ int scols_print_table(struct libscols_table *tb)
 	int empty = 0;
 	int rc = do_print_table(tb, &empty);
 
-	if (rc == 0 && !empty && !scols_table_is_json(tb))
+	if (rc == 0 && !empty && !is_jsonwrt_format(tb))
 		fputc('\n', tb->out);
 	return rc;
 }
@@ -543,7 +543,7 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 
 	is_last = is_last_column(cl);
 
-	if (ln && is_last && scols_table_is_json(tb) &&
+	if (ln && is_last && is_jsonwrt_format(tb) &&
 	    scols_table_is_tree(tb) && has_children(ln))
 		/* "children": [] is the real last value */
 		is_last = 0;
@@ -564,6 +564,7 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 		return 0;
 
 	case SCOLS_FMT_JSON:
+	case SCOLS_FMT_CBOR:
 		print_json_data(tb, cl, name, data);
 		return 0;
 
@@ -680,13 +681,13 @@ int __cursor_to_buffer(struct libscols_table *tb,
 	/*
 	 * Group stuff
 	 */
-	if (!scols_table_is_json(tb) && cl->is_groups)
+	if (!is_jsonwrt_format(tb) && cl->is_groups)
 		rc = groups_ascii_art_to_buffer(tb, ln, buf, 0);
 
 	/*
 	 * Tree stuff
 	 */
-	if (!rc && ln->parent && !scols_table_is_json(tb)) {
+	if (!rc && ln->parent && !is_jsonwrt_format(tb)) {
 		rc = tree_ascii_art_to_buffer(tb, ln->parent, buf);
 
 		if (!rc && is_last_child(ln))
@@ -695,7 +696,7 @@ int __cursor_to_buffer(struct libscols_table *tb,
 			rc = ul_buffer_append_string(buf, branch_symbol(tb));
 	}
 
-	if (!rc && (ln->parent || cl->is_groups) && !scols_table_is_json(tb))
+	if (!rc && (ln->parent || cl->is_groups) && !is_jsonwrt_format(tb))
 		ul_buffer_save_pointer(buf, SCOLS_BUFPTR_TREEEND);
 notree:
 	if (!rc && ce) {
@@ -953,7 +954,7 @@ int __scols_print_header(struct libscols_table *tb, struct ul_buffer *buf)
 	if ((tb->header_printed == 1 && tb->header_repeat == 0) ||
 	    scols_table_is_noheadings(tb) ||
 	    scols_table_is_export(tb) ||
-	    scols_table_is_json(tb) ||
+	    is_jsonwrt_format(tb) ||
 	    list_empty(&tb->tb_lines))
 		return 0;
 
@@ -1016,12 +1017,12 @@ int __scols_print_range(struct libscols_table *tb,
 
 		int last = scols_iter_is_last(itr);
 
-		if (scols_table_is_json(tb))
+		if (is_jsonwrt_format(tb))
 			ul_jsonwrt_object_open(&tb->json, NULL);
 
 		rc = print_line(tb, ln, buf);
 
-		if (scols_table_is_json(tb))
+		if (is_jsonwrt_format(tb))
 			ul_jsonwrt_object_close(&tb->json);
 		else if (last == 0 && tb->no_linesep == 0) {
 			fputs(linesep(tb), tb->out);
@@ -1047,6 +1048,109 @@ int __scols_print_table(struct libscols_table *tb, struct ul_buffer *buf)
 	return __scols_print_range(tb, buf, &itr, NULL);
 }
 
+static int start_stream(struct libscols_table *tb)
+{
+	int rc;
+
+	DBG(TAB, ul_debugobj(tb, "starting stream [nlines=%zu]", tb->nlines));
+
+	tb->header_printed = 0;
+	tb->stream_nprinted = 0;
+
+	/* calculates column widths from the already collected lines */
+	rc = __scols_initialize_printing(tb, &tb->stream_buf);
+	if (rc)
+		return rc;
+
+	if (is_jsonwrt_format(tb)) {
+		ul_jsonwrt_root_open(&tb->json);
+		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
+	}
+
+	if (tb->format == SCOLS_FMT_HUMAN)
+		__scols_print_title(tb);
+
+	rc = __scols_print_header(tb, &tb->stream_buf);
+	if (rc) {
+		__scols_cleanup_printing(tb, &tb->stream_buf);
+		return rc;
+	}
+
+	tb->stream_started = 1;
+	return 0;
+}
+
+/*
+ * Streaming mode -- prints and removes all lines from the table. The lines
+ * are collected (for width calculation) until the table contains
+ * tb->stream_nlines lines; this is unnecessary for non-human output formats.
+ * The @final forces printing of the collected lines.
+ */
+int __scols_print_stream(struct libscols_table *tb, int final)
+{
+	int rc = 0;
+
+	if (scols_table_is_tree(tb) || list_empty(&tb->tb_lines))
+		return 0;
+
+	if (!tb->stream_started) {
+		if (!final && tb->format == SCOLS_FMT_HUMAN
+		    && tb->nlines < tb->stream_nlines)
+			return 0;
+		rc = start_stream(tb);
+	}
+
+	while (rc == 0 && !list_empty(&tb->tb_lines)) {
+		struct libscols_line *ln = list_entry(tb->tb_lines.next,
+					struct libscols_line, ln_lines);
+
+		if (!is_jsonwrt_format(tb) && tb->stream_nprinted) {
+			if (tb->no_linesep == 0) {
+				fputs(linesep(tb), tb->out);
+				tb->termlines_used++;
+			}
+			if (want_repeat_header(tb))
+				__scols_print_header(tb, &tb->stream_buf);
+		}
+
+		if (is_jsonwrt_format(tb))
+			ul_jsonwrt_object_open(&tb->json, NULL);
+
+		rc = print_line(tb, ln, &tb->stream_buf);
+
+		if (is_jsonwrt_format(tb))
+			ul_jsonwrt_object_close(&tb->json);
+
+		tb->stream_nprinted++;
+		scols_table_remove_line(tb, ln);
+	}
+
+	return rc;
+}
+
+/*
+ * Prints the rest of the lines and terminates streaming output.
+ */
+int __scols_finish_stream(struct libscols_table *tb)
+{
+	int rc;
+
+	DBG(TAB, ul_debugobj(tb, "finishing stream"));
+
+	rc = __scols_print_stream(tb, 1);
+	if (!tb->stream_started)
+		return rc;
+
+	if (is_jsonwrt_format(tb)) {
+		ul_jsonwrt_array_close(&tb->json);
+		ul_jsonwrt_root_close(&tb->json);
+	}
+
+	__scols_cleanup_printing(tb, &tb->stream_buf);
+	tb->stream_started = 0;
+	return rc;
+}
+
 /* scols_walk_tree() callback to print tree line */
 static int print_tree_line(struct libscols_table *tb,
 			   struct libscols_line *ln,
@@ -1058,7 +1162,7 @@ static int print_tree_line(struct libscols_table *tb,
 
 	DBG(LINE, ul_debugobj(ln, "   printing tree line"));
 
-	if (scols_table_is_json(tb))
+	if (is_jsonwrt_format(tb))
 		ul_jsonwrt_object_open(&tb->json, NULL);
 
 	rc = print_line(tb, ln, buf);
@@ -1066,7 +1170,7 @@ static int print_tree_line(struct libscols_table *tb,
 		return rc;
 
 	if (has_children(ln)) {
-		if (scols_table_is_json(tb))
+		if (is_jsonwrt_format(tb))
 			ul_jsonwrt_array_open(&tb->json, "children");
 		else {
 			/* between parent and child is separator */
@@ -1077,7 +1181,7 @@ static int print_tree_line(struct libscols_table *tb,
 		int last;
 
 		/* terminate all open last children for JSON */
-		if (scols_table_is_json(tb)) {
+		if (is_jsonwrt_format(tb)) {
 			do {
 				last = (is_child(ln) && is_last_child(ln)) ||
 				       (is_tree_root(ln) && is_last_tree_root(tb, ln));
@@ -1187,7 +1291,9 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 		extra_bufsz += tb->ncols;			/* separator between columns */
 		break;
 	case SCOLS_FMT_JSON:
+	case SCOLS_FMT_CBOR:
 		ul_jsonwrt_init(&tb->json, tb->out, 0);
+		ul_jsonwrt_enable_cbor(&tb->json, tb->format == SCOLS_FMT_CBOR);
 		extra_bufsz += tb->nlines * 3;		/* indentation */
 		/* fallthrough */
 	case SCOLS_FMT_EXPORT:
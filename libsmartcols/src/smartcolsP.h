@@ -89,8 +89,13 @@ struct libscols_cell {
 	void    *userdata;
 	int	flags;
 	size_t	width;
+	size_t	datawidth;	/* cached width of the data */
 
-	unsigned int is_filled : 1;
+	unsigned int is_filled : 1,
+		     is_arena  : 1,	/* data allocated from arena */
+		     has_width : 1,	/* datawidth is valid */
+		     width_noenc : 1,	/* datawidth is without encoding */
+		     is_ascii  : 1;	/* printable ASCII only (valid with has_width) */
 };
 
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
@@ -209,18 +214,27 @@ struct libscols_line {
 	struct libscols_line	*parent;
 	struct libscols_group	*parent_group;	/* for group childs */
 	struct libscols_group	*group;		/* for group members */
+
+	struct libscols_arena	*arena;		/* table arena or NULL */
+
+	unsigned int	is_arena	:1,	/* line allocated from arena */
+			cells_arena	:1;	/* cells allocated from arena */
 };
 
 enum {
 	SCOLS_FMT_HUMAN = 0,		/* default, human readable */
 	SCOLS_FMT_RAW,			/* space separated */
 	SCOLS_FMT_EXPORT,		/* COLNAME="data" ... */
-	SCOLS_FMT_JSON			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_JSON,			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_CBOR			/* binary JSON-like, RFC 8949 */
 };
 
 /*
  * The table
  */
+/* default number of lines used to calculate column widths in streaming mode */
+#define SCOLS_STREAM_NLINES	256
+
 struct libscols_table {
 	int	refcount;
 	char	*name;		/* optional table name (for JSON) */
@@ -246,7 +260,8 @@ struct libscols_table {
 	size_t			ngrpchlds_pending;	/* groups with not yet printed children */
 	struct libscols_line	*walk_last_tree_root;	/* last root, used by scols_walk_() */
 
-	struct libscols_column	*dflt_sort_column;	/* default sort column, set by scols_sort_table() */
+	struct libscols_column	**dflt_sort_columns;	/* default sort columns, set by scols_sort_table() */
+	size_t			ndflt_sort_columns;
 
 	struct libscols_symbols	*symbols;
 	struct libscols_cell	title;		/* optional table title (for humans) */
@@ -264,6 +279,12 @@ struct libscols_table {
 	struct libscols_line *cur_line;		/* currently used line */
 	struct libscols_column *cur_column;	/* currently used column */
 
+	size_t	stream_nlines;		/* lines to collect before streaming starts */
+	size_t	stream_nprinted;	/* already streamed lines */
+	struct ul_buffer stream_buf;	/* printing buffer used in streaming mode */
+
+	struct libscols_arena	*arena;	/* memory pool for lines and cells */
+
 	/* flags */
 	unsigned int	ascii		:1,	/* don't use unicode */
 			colors_wanted	:1,	/* enable colors */
@@ -280,7 +301,9 @@ struct libscols_table {
 			no_headings	:1,	/* don't print header */
 			no_encode	:1,	/* don't care about control and non-printable chars */
 			no_linesep	:1,	/* don't print line separator */
-			no_wrap		:1;	/* never wrap lines */
+			no_wrap		:1,	/* never wrap lines */
+			streaming	:1,	/* print lines as they are added */
+			stream_started	:1;	/* streaming output initialized */
 };
 
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
@@ -309,9 +332,28 @@ static inline int scols_iter_is_last(const struct libscols_iter *itr)
 	return itr->p == itr->head;
 }
 
+/*
+ * arena.c
+ */
+struct libscols_arena;
+
+struct libscols_arena *scols_new_arena(void);
+void scols_ref_arena(struct libscols_arena *ar);
+void scols_unref_arena(struct libscols_arena *ar);
+void *scols_arena_alloc(struct libscols_arena *ar, size_t sz);
+char *scols_arena_strdup(struct libscols_arena *ar, const char *str);
+
+/*
+ * cell.c
+ */
+int __scols_cell_set_arena_data(struct libscols_cell *ce,
+				struct libscols_arena *ar, const char *data);
+size_t __scols_cell_get_width(struct libscols_cell *ce, int noencoding);
+
 /*
  * line.c
  */
+struct libscols_line *__scols_new_line(struct libscols_arena *ar);
 int scols_line_next_group_child(struct libscols_line *ln,
                           struct libscols_iter *itr,
                           struct libscols_line **chld);
@@ -385,11 +427,19 @@ int __scols_print_tree(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_table(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_header(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_title(struct libscols_table *tb);
+int __scols_print_stream(struct libscols_table *tb, int final);
+int __scols_finish_stream(struct libscols_table *tb);
 int __scols_print_range(struct libscols_table *tb,
                         struct ul_buffer *buf,
                         struct libscols_iter *itr,
                         struct libscols_line *end);
 
+/* JSON and CBOR formats share the writer (tb->json) */
+static inline int is_jsonwrt_format(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_JSON || tb->format == SCOLS_FMT_CBOR;
+}
+
 static inline int is_tree_root(struct libscols_line *ln)
 {
 	return ln && !ln->parent && !ln->parent_group;
@@ -553,6 +603,8 @@ struct libscols_filter {
 
 	struct list_head params;
 	struct list_head counters;
+
+	unsigned int compiled : 1;	/* holders typed, expressions prepared */
 };
 
 struct filter_node *__filter_new_node(enum filter_ntype type, size_t sz);
@@ -570,6 +622,7 @@ int filter_eval_param(struct libscols_filter *fltr, struct libscols_line *ln,
 void filter_free_param(struct filter_param *n);
 int filter_param_reset_holder(struct filter_param *n);
 int filter_param_get_datatype(struct filter_param *n);
+int filter_param_cast_const(struct filter_param *n, int type);
 
 int filter_next_param(struct libscols_filter *fltr,
                         struct libscols_iter *itr, struct filter_param **prm);
@@ -596,6 +649,7 @@ void filter_free_expr(struct filter_expr *n);
 void filter_dump_expr(struct ul_jsonwrt *json, struct filter_expr *n);
 int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 			struct filter_expr *n, int *status);
+int filter_compile_expr(struct libscols_filter *fltr, struct filter_expr *n);
 
 /* required by parser */
 struct filter_node *filter_new_param(struct libscols_filter *filter,
@@ -76,6 +76,7 @@ struct libscols_table *scols_new_table(void)
 
 	tb->refcount = 1;
 	tb->out = stdout;
+	tb->stream_nlines = SCOLS_STREAM_NLINES;
 
 	get_terminal_dimension(&c, &l);
 	tb->termwidth  = c > 0 ? c : 80;
@@ -131,9 +132,12 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
 		free(tb->grpset);
+		free(tb->dflt_sort_columns);
 		free(tb->linesep);
 		free(tb->colsep);
 		free(tb->name);
+		ul_buffer_free_data(&tb->stream_buf);
+		scols_unref_arena(tb->arena);
 		free(tb);
 		DBG(TAB, ul_debug("<- done"));
 	}
@@ -270,8 +274,20 @@ int scols_table_remove_column(struct libscols_table *tb,
 
 	if (cl->flags & SCOLS_FL_TREE)
 		tb->ntreecols--;
-	if (tb->dflt_sort_column == cl)
-		tb->dflt_sort_column = NULL;
+	if (tb->ndflt_sort_columns) {
+		size_t i;
+
+		/* forget the default sort columns */
+		for (i = 0; i < tb->ndflt_sort_columns; i++) {
+			if (tb->dflt_sort_columns[i] == cl)
+				break;
+		}
+		if (i < tb->ndflt_sort_columns) {
+			free(tb->dflt_sort_columns);
+			tb->dflt_sort_columns = NULL;
+			tb->ndflt_sort_columns = 0;
+		}
+	}
 
 	DBG(TAB, ul_debugobj(tb, "remove column"));
 	list_del_init(&cl->cl_columns);
@@ -707,12 +723,24 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 	if (!list_empty(&ln->ln_lines))
 		return -EINVAL;
 
+	if (tb->arena && !ln->arena) {
+		ln->arena = tb->arena;
+		scols_ref_arena(ln->arena);
+	}
+
 	if (tb->ncols > ln->ncells) {
 		int rc = scols_line_alloc_cells(ln, tb->ncols);
 		if (rc)
 			return rc;
 	}
 
+	/* streaming mode -- all the previously added lines are complete */
+	if (tb->streaming) {
+		int rc = __scols_print_stream(tb, 0);
+		if (rc)
+			return rc;
+	}
+
 	DBG(TAB, ul_debugobj(tb, "add line"));
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
 	ln->seqnum = tb->nlines++;
@@ -816,7 +844,7 @@ struct libscols_line *scols_table_new_line(struct libscols_table *tb,
 	if (!tb)
 		return NULL;
 
-	ln = scols_new_line();
+	ln = __scols_new_line(tb->arena);
 	if (!ln)
 		return NULL;
 
@@ -1079,6 +1107,115 @@ int scols_table_is_nolinesep(const struct libscols_table *tb)
 	return tb->no_linesep;
 }
 
+/**
+ * scols_table_enable_streaming:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable streaming mode. In this mode the table does not keep all
+ * lines in memory. The already added lines are printed and removed from the
+ * table when a new line is added by scols_table_add_line() or
+ * scols_table_new_line(), and the rest of the lines is printed by
+ * scols_print_table().
+ *
+ * The column widths for the human readable output are calculated from the
+ * first lines only (see scols_table_set_streaming_lines()) and from the
+ * column width hints; the data in the next lines may be truncated or wrapped
+ * according to the column flags. JSON, raw and export output formats don't
+ * need any calculation and the lines are printed immediately.
+ *
+ * The application must not keep pointers to the lines (without a reference)
+ * or modify the already added lines (sort, filter, etc.) when a new line is
+ * added. The streaming mode is ignored for trees.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_enable_streaming(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->streaming = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_is_streaming:
+ * @tb: a pointer to a struct libscols_table instance
+ *
+ * Returns: 1 if streaming mode is enabled.
+ *
+ * Since: 2.41
+ */
+int scols_table_is_streaming(const struct libscols_table *tb)
+{
+	return tb->streaming;
+}
+
+/**
+ * scols_table_set_streaming_lines:
+ * @tb: table
+ * @nlines: number of lines
+ *
+ * Sets the number of lines collected in streaming mode before the first line
+ * is printed. The lines are used to calculate the column widths for the human
+ * readable output. The default is 256 lines.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_set_streaming_lines(struct libscols_table *tb, size_t nlines)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming lines: %zu", nlines));
+	tb->stream_nlines = nlines;
+	return 0;
+}
+
+/**
+ * scols_table_enable_arena:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable arena allocation. The lines allocated by
+ * scols_table_new_line(), the cells of the lines added to the table and the
+ * data set by scols_line_set_data() are allocated from a per-table memory
+ * pool rather than by malloc() for each object.
+ *
+ * The memory pool is deallocated at once when the table and all the lines
+ * are deallocated; removing lines from the table (including streaming mode)
+ * does not release the memory. The data referenced by
+ * scols_line_refer_data() are not affected.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_enable_arena(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "arena: %s", enable ? "ENABLE" : "DISABLE"));
+
+	if (enable && !tb->arena) {
+		tb->arena = scols_new_arena();
+		if (!tb->arena)
+			return -ENOMEM;
+	} else if (!enable) {
+		/* lines allocated from the arena keep it referenced */
+		scols_unref_arena(tb->arena);
+		tb->arena = NULL;
+	}
+	return 0;
+}
+
 /**
  * scols_table_enable_colors:
  * @tb: table
@@ -1146,6 +1283,34 @@ int scols_table_enable_json(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_cbor:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable CBOR (RFC 8949) output format. The output uses the same
+ * structure as JSON output (see scols_table_enable_json()), but it's binary
+ * and the numbers and boolean values (see scols_column_set_json_type()) are
+ * encoded natively. The parsable output formats (export, raw, JSON, ...) are
+ * mutually exclusive.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_enable_cbor(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "cbor: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable)
+		tb->format = SCOLS_FMT_CBOR;
+	else if (tb->format == SCOLS_FMT_CBOR)
+		tb->format = 0;
+	return 0;
+}
+
 /**
  * scols_table_enable_export:
  * @tb: table
@@ -1482,6 +1647,19 @@ int scols_table_is_json(const struct libscols_table *tb)
 	return tb->format == SCOLS_FMT_JSON;
 }
 
+/**
+ * scols_table_is_cbor:
+ * @tb: table
+ *
+ * Returns: 1 if CBOR output format is enabled.
+ *
+ * Since: 2.41
+ */
+int scols_table_is_cbor(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_CBOR;
+}
+
 /**
  * scols_table_is_maxout
  * @tb: table
@@ -1566,84 +1744,263 @@ const char *scols_table_get_line_separator(const struct libscols_table *tb)
 {
 	return tb->linesep;
 }
-/* for lines in the struct libscols_line->ln_lines list */
-static int cells_cmp_wrapper_lines(struct list_head *a, struct list_head *b, void *data)
+/*
+ * Sorting -- the lines are sorted in an array by stable merge sort, the list
+ * is rebuilt from the array after sort. The numbers for the first sort column
+ * are parsed only once if the column does not have cmpfunc and the data type is
+ * SCOLS_DATA_U64.
+ */
+struct sort_item {
+	struct libscols_line	*ln;
+	uint64_t		num;	/* pre-parsed data of the first column */
+};
+
+struct sort_keys {
+	struct libscols_column	**cls;
+	size_t			ncls;
+
+	unsigned int		has_nums :1;	/* use sort_item->num for cls[0] */
+};
+
+static int column_is_sortable(const struct libscols_column *cl)
+{
+	return cl->cmpfunc || cl->data_type == SCOLS_DATA_U64;
+}
+
+static uint64_t cell_to_u64(struct libscols_cell *ce)
+{
+	const char *data = scols_cell_get_data(ce);
+	uint64_t num = 0;
+
+	if (data && *data && ul_strtou64(data, &num, 10) != 0)
+		num = 0;
+	return num;
+}
+
+static int cmp_lines_by_column(struct libscols_column *cl,
+			       struct libscols_line *a,
+			       struct libscols_line *b)
 {
-	struct libscols_column *cl = (struct libscols_column *) data;
-	struct libscols_line *ra, *rb;
-	struct libscols_cell *ca, *cb;
+	struct libscols_cell *ca = scols_line_get_cell(a, cl->seqnum);
+	struct libscols_cell *cb = scols_line_get_cell(b, cl->seqnum);
+	uint64_t na, nb;
 
-	assert(a);
-	assert(b);
-	assert(cl);
+	if (cl->cmpfunc)
+		return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
 
-	ra = list_entry(a, struct libscols_line, ln_lines);
-	rb = list_entry(b, struct libscols_line, ln_lines);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
+	na = cell_to_u64(ca);
+	nb = cell_to_u64(cb);
+	return na == nb ? 0 : na < nb ? -1 : 1;
+}
 
-	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
+static int cmp_sort_items(const struct sort_item *a,
+			  const struct sort_item *b,
+			  const struct sort_keys *keys)
+{
+	size_t i = 0;
+	int rc;
+
+	if (keys->has_nums) {
+		if (a->num != b->num)
+			return a->num < b->num ? -1 : 1;
+		i++;
+	}
+
+	for (; i < keys->ncls; i++) {
+		rc = cmp_lines_by_column(keys->cls[i], a->ln, b->ln);
+		if (rc)
+			return rc;
+	}
+	return 0;
 }
 
-/* for lines in the struct libscols_line->ln_children list */
-static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b, void *data)
+/* bottom-up merge sort; the equal items keep the original order */
+static void merge_sort_items(struct sort_item *items, struct sort_item *tmp,
+			     size_t n, const struct sort_keys *keys)
 {
-	struct libscols_column *cl = (struct libscols_column *) data;
-	struct libscols_line *ra, *rb;
-	struct libscols_cell *ca, *cb;
+	struct sort_item *src = items, *dst = tmp, *x;
+	size_t width, i;
 
-	assert(a);
-	assert(b);
-	assert(cl);
+	for (width = 1; width < n; width *= 2) {
+		for (i = 0; i < n; i += 2 * width) {
+			size_t mid = min(i + width, n), hi = min(i + 2 * width, n);
+			size_t a = i, b = mid, o = i;
 
-	ra = list_entry(a, struct libscols_line, ln_children);
-	rb = list_entry(b, struct libscols_line, ln_children);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
+			while (a < mid && b < hi)
+				dst[o++] = cmp_sort_items(&src[b], &src[a], keys) < 0 ?
+						src[b++] : src[a++];
+			while (a < mid)
+				dst[o++] = src[a++];
+			while (b < hi)
+				dst[o++] = src[b++];
+		}
+		x = src, src = dst, dst = x;
+	}
 
-	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
+	if (src != items)
+		memcpy(items, src, n * sizeof(struct sort_item));
 }
 
+/*
+ * Sorts list of lines; the @offset is offset of the list member in struct
+ * libscols_line (ln_lines or ln_children).
+ */
+static int sort_lines_list(struct list_head *head, size_t offset,
+			   struct sort_keys *keys)
+{
+	struct sort_item *items;
+	struct list_head *p;
+	size_t n = 0, i;
+
+	list_for_each(p, head)
+		n++;
+	if (n < 2)
+		return 0;
+
+	items = malloc(2 * n * sizeof(struct sort_item));
+	if (!items)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln = (struct libscols_line *) ((char *) p - offset);
+
+		items[i].ln = ln;
+		items[i].num = keys->has_nums ?
+				cell_to_u64(scols_line_get_cell(ln, keys->cls[0]->seqnum)) : 0;
+		i++;
+	}
+
+	merge_sort_items(items, items + n, n, keys);
 
-static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++)
+		list_add_tail((struct list_head *) ((char *) items[i].ln + offset), head);
+
+	free(items);
+	return 0;
+}
+
+static int sort_line_children(struct libscols_line *ln, struct sort_keys *keys)
 {
 	struct list_head *p;
+	int rc = 0;
 
 	if (!list_empty(&ln->ln_branch)) {
 		list_for_each(p, &ln->ln_branch) {
 			struct libscols_line *chld =
 					list_entry(p, struct libscols_line, ln_children);
-			sort_line_children(chld, cl);
+			rc = sort_line_children(chld, keys);
+			if (rc)
+				return rc;
 		}
 
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
+		rc = sort_lines_list(&ln->ln_branch,
+				offsetof(struct libscols_line, ln_children), keys);
+		if (rc)
+			return rc;
 	}
 
 	if (is_first_group_member(ln)) {
 		list_for_each(p, &ln->group->gr_children) {
 			struct libscols_line *chld =
 					list_entry(p, struct libscols_line, ln_children);
-			sort_line_children(chld, cl);
+			rc = sort_line_children(chld, keys);
+			if (rc)
+				return rc;
 		}
 
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
+		rc = sort_lines_list(&ln->group->gr_children,
+				offsetof(struct libscols_line, ln_children), keys);
 	}
 
-	return 0;
+	return rc;
 }
 
-static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column *cl)
+static int  __scols_sort_tree(struct libscols_table *tb, struct sort_keys *keys)
 {
 	struct libscols_line *ln;
 	struct libscols_iter itr;
+	int rc = 0;
 
-	if (!tb || !cl || !cl->cmpfunc)
+	if (!tb || !keys)
 		return -EINVAL;
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0)
-		sort_line_children(ln, cl);
-	return 0;
+	while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0)
+		rc = sort_line_children(ln, keys);
+	return rc;
+}
+
+static void init_sort_keys(struct sort_keys *keys,
+			   struct libscols_column **cls, size_t ncls)
+{
+	keys->cls = cls;
+	keys->ncls = ncls;
+	keys->has_nums = ncls && !cls[0]->cmpfunc
+			 && cls[0]->data_type == SCOLS_DATA_U64;
+}
+
+/**
+ * scols_sort_table_by_columns:
+ * @tb: table
+ * @cls: array of columns
+ * @ncls: number of columns in @cls
+ *
+ * Orders the table by the first column, the lines with equal data are ordered
+ * by the next column, etc. The lines with equal data in all the columns keep
+ * their original order. If the tree output is enabled then children in the
+ * tree are recursively sorted too.
+ *
+ * The columns are compared by the column cmpfunc (see
+ * scols_column_set_cmpfunc()). The column without cmpfunc is compared as a
+ * number if the column data type is SCOLS_DATA_U64 (see
+ * scols_column_set_data_type()).
+ *
+ * The columns are saved as the default sort columns to the @tb, see
+ * scols_sort_table() and scols_sort_table_by_tree().
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_sort_table_by_columns(struct libscols_table *tb,
+				struct libscols_column **cls, size_t ncls)
+{
+	struct sort_keys keys;
+	size_t i;
+	int rc;
+
+	if (!tb || !cls || !ncls)
+		return -EINVAL;
+	for (i = 0; i < ncls; i++) {
+		if (!cls[i] || cls[i]->table != tb || !column_is_sortable(cls[i]))
+			return -EINVAL;
+	}
+
+	if (cls != tb->dflt_sort_columns) {
+		struct libscols_column **tmp;
+
+		tmp = reallocarray(tb->dflt_sort_columns, ncls, sizeof(*cls));
+		if (!tmp)
+			return -ENOMEM;
+		memcpy(tmp, cls, ncls * sizeof(*cls));
+		tb->dflt_sort_columns = tmp;
+		tb->ndflt_sort_columns = ncls;
+	}
+
+	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column(s), first %zu",
+				ncls, cls[0]->seqnum));
+
+	init_sort_keys(&keys, tb->dflt_sort_columns, ncls);
+
+	rc = sort_lines_list(&tb->tb_lines,
+			offsetof(struct libscols_line, ln_lines), &keys);
+
+	if (!rc && scols_table_is_tree(tb))
+		rc = __scols_sort_tree(tb, &keys);
+
+	return rc;
 }
 
 /**
@@ -1658,6 +2015,8 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
  * scols_sort_table_by_tree().
  *
+ * See also scols_sort_table_by_columns().
+ *
  * Returns: 0, a negative value in case of an error.
  */
 int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
@@ -1665,20 +2024,10 @@ int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 	if (!tb)
 		return -EINVAL;
 	if (!cl)
-		cl = tb->dflt_sort_column;
-	if (!cl || !cl->cmpfunc)
-		return -EINVAL;
-
-	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
+		return scols_sort_table_by_columns(tb, tb->dflt_sort_columns,
+						   tb->ndflt_sort_columns);
 
-	if (scols_table_is_tree(tb))
-		__scols_sort_tree(tb, cl);
-
-	if (cl && cl != tb->dflt_sort_column)
-		tb->dflt_sort_column = cl;
-
-	return 0;
+	return scols_sort_table_by_columns(tb, &cl, 1);
 }
 
 /*
@@ -1729,8 +2078,12 @@ int scols_sort_table_by_tree(struct libscols_table *tb)
 
 	DBG(TAB, ul_debugobj(tb, "sorting table by tree"));
 
-	if (tb->dflt_sort_column)
-		__scols_sort_tree(tb, tb->dflt_sort_column);
+	if (tb->ndflt_sort_columns) {
+		struct sort_keys keys;
+
+		init_sort_keys(&keys, tb->dflt_sort_columns, tb->ndflt_sort_columns);
+		__scols_sort_tree(tb, &keys);
+	}
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (scols_table_next_line(tb, &itr, &ln) == 0)
@@ -238,7 +238,8 @@ static int state_fd_init(const char *clock_file, FILE **fp)
  * Get clock from global sequence clock counter.
  *
  * Return -1 if the clock counter could not be opened/locked (in this case
- * pseudorandom value is returned in @ret_clock_seq), otherwise return 0.
+ * pseudorandom value is returned in @ret_clock_seq and no block of @num
+ * values is reserved, @num is set to 1), otherwise return 0.
  */
 static int get_clock(uint32_t *clock_high, uint32_t *clock_low,
 		     uint16_t *ret_clock_seq, int *num)
@@ -321,7 +322,9 @@ try_again:
 	clock_reg += ((uint64_t) tv.tv_sec)*10000000;
 	clock_reg += (((uint64_t) 0x01B21DD2) << 32) + 0x13814000;
 
-	if (num && (*num > 1)) {
+	if (num && (*num > 1) && state_fd < 0)
+		*num = 1;
+	else if (num && (*num > 1)) {
 		adjustment += *num - 1;
 		last.tv_usec += adjustment / 10;
 		adjustment = adjustment % 10;
@@ -454,6 +457,7 @@ error:
 }
 
 #if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+#include <sys/mman.h>
 
 /*
  * Try using the uuidd daemon to generate the UUID
@@ -488,9 +492,15 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 		memcpy(op_buf+1, num, sizeof(*num));
 		op_len += sizeof(*num);
 		expected += sizeof(*num);
-	}
+	} else if (op == UUIDD_OP_SHM_REFILL)
+		expected = sizeof(int32_t);	/* number of published UUIDs */
 
+#ifdef MSG_NOSIGNAL
+	/* don't kill the application if the daemon is just restarted */
+	ret = send(s, op_buf, op_len, MSG_NOSIGNAL);
+#else
 	ret = write(s, op_buf, op_len);
+#endif
 	if (ret < 1)
 		goto fail;
 
@@ -503,6 +513,14 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 
 	ret = read_all(s, op_buf, reply_len);
 
+	if (op == UUIDD_OP_SHM_REFILL) {
+		int32_t published = 0;
+
+		memcpy(&published, op_buf, sizeof(published));
+		close(s);
+		return ret == expected && published > 0 ? 0 : -1;
+	}
+
 	if (op == UUIDD_OP_BULK_TIME_UUID)
 		memcpy(op_buf+16, num, sizeof(int));
 
@@ -516,6 +534,157 @@ fail:
 	return -1;
 }
 
+/* NULL if not mapped yet, MAP_FAILED if not available */
+static struct uuidd_shm *uuidd_shm;
+
+/* the last time the shared memory did not provide UUID */
+static time_t uuidd_shm_failed;
+
+static struct uuidd_shm *map_uuidd_shm(void)
+{
+	struct uuidd_shm *shm = MAP_FAILED;
+	struct stat st;
+	int fd;
+
+	/* the file is writable for trusted users only */
+	fd = open(UUIDD_SHM_PATH, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(*shm))
+		shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (shm != MAP_FAILED
+	    && __atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != UUIDD_SHM_MAGIC) {
+		munmap(shm, sizeof(*shm));
+		shm = MAP_FAILED;
+	}
+	return shm;
+}
+
+static struct uuidd_shm *get_uuidd_shm(void)
+{
+	struct uuidd_shm *shm = __atomic_load_n(&uuidd_shm, __ATOMIC_ACQUIRE);
+
+	if (!shm) {
+		struct uuidd_shm *old = NULL;
+
+		shm = map_uuidd_shm();
+		if (!__atomic_compare_exchange_n(&uuidd_shm, &old, shm, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			/* mapped by another thread */
+			if (shm != MAP_FAILED)
+				munmap(shm, sizeof(*shm));
+			shm = old;
+		}
+	}
+	return shm == MAP_FAILED ? NULL : shm;
+}
+
+/*
+ * Reads the block of the generation @gen from the shared memory. Returns 0 on
+ * success, or -1 if the slot does not contain the block (not published yet,
+ * being written or already reused for a newer block).
+ */
+static int read_uuidd_shm_slot(struct uuidd_shm *shm, uint64_t gen,
+			       uint32_t *count, uint64_t base[2], time_t *tm)
+{
+	struct uuidd_shm_slot *slot = &shm->slots[gen % UUIDD_SHM_NSLOTS];
+
+	if (__atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE) != gen)
+		return -1;
+
+	*tm = __atomic_load_n(&slot->time, __ATOMIC_RELAXED);
+	*count = __atomic_load_n(&slot->count, __ATOMIC_RELAXED);
+	base[0] = __atomic_load_n(&slot->uuid[0], __ATOMIC_RELAXED);
+	base[1] = __atomic_load_n(&slot->uuid[1], __ATOMIC_RELAXED);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&slot->gen, __ATOMIC_RELAXED) == gen ? 0 : -1;
+}
+
+/*
+ * Try to get time-based UUID from the shared memory published by uuidd. The
+ * per-UUID cost is one atomic increment, the daemon is contacted only to
+ * refill the blocks. The blocks published more than @timeout seconds ago are
+ * skipped.
+ *
+ * Returns 0 on success, non-zero on failure. The shared memory is not used
+ * for @timeout seconds after failure, the process stops using it only if it
+ * cannot be mapped.
+ */
+static int get_uuid_via_shm(uuid_t out, time_t timeout)
+{
+	struct uuidd_shm *shm = get_uuidd_shm();
+	time_t now;
+	int tries;
+
+	if (!shm)
+		return -1;
+
+	now = time(NULL);
+	if (now <= __atomic_load_n(&uuidd_shm_failed, __ATOMIC_RELAXED) + timeout)
+		return -1;
+
+	for (tries = 0; tries < 8; tries++) {
+		uint64_t claim, gen, base[2], tm;
+		uint32_t idx, count;
+		time_t published;
+		struct uuid uu;
+
+		claim = __atomic_fetch_add(&shm->claim, 1, __ATOMIC_RELAXED);
+		gen = claim >> 32;
+		idx = (uint32_t) claim;
+
+		if (read_uuidd_shm_slot(shm, gen, &count, base, &published) != 0)
+			continue;
+
+		if (idx >= count || now > published + timeout) {
+			uint64_t cur;
+
+			/* exhausted or too old, switch to the next block */
+			if (read_uuidd_shm_slot(shm, gen + 1, &count, base,
+						&published) != 0) {
+				if (get_uuid_via_daemon(UUIDD_OP_SHM_REFILL,
+							NULL, NULL) != 0)
+					break;
+				continue;
+			}
+			cur = __atomic_load_n(&shm->claim, __ATOMIC_RELAXED);
+			while ((cur >> 32) == gen) {
+				if (__atomic_compare_exchange_n(&shm->claim, &cur,
+						((gen + 1) << 32) | 1, 0,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+					break;
+			}
+			if ((cur >> 32) != gen)
+				continue;	/* switched by another client */
+			if (now > published + timeout)
+				continue;	/* the next block is old too */
+			idx = 0;
+		} else if (idx == count / 2)
+			/* ask for the next block in advance */
+			get_uuid_via_daemon(UUIDD_OP_SHM_REFILL, NULL, NULL);
+
+		memcpy(out, base, sizeof(uuid_t));
+		uuid_unpack(out, &uu);
+
+		tm = ((uint64_t) (uu.time_hi_and_version & 0x0FFF) << 48)
+			| ((uint64_t) uu.time_mid << 32) | uu.time_low;
+		tm += idx;
+		uu.time_low = (uint32_t) tm;
+		uu.time_mid = (uint16_t) (tm >> 32);
+		uu.time_hi_and_version = ((tm >> 48) & 0x0FFF) | 0x1000;
+
+		uuid_pack(&uu, out);
+		return 0;
+	}
+
+	__atomic_store_n(&uuidd_shm_failed, now, __ATOMIC_RELAXED);
+	return -1;
+}
+
 #else /* !defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H) */
 static int get_uuid_via_daemon(int op __attribute__((__unused__)),
 				uuid_t out __attribute__((__unused__)),
@@ -523,6 +692,12 @@ static int get_uuid_via_daemon(int op __attribute__((__unused__)),
 {
 	return -1;
 }
+
+static int get_uuid_via_shm(uuid_t out __attribute__((__unused__)),
+			    time_t timeout __attribute__((__unused__)))
+{
+	return -1;
+}
 #endif
 
 static int __uuid_generate_time_internal(uuid_t out, int *num, uint32_t cont_offset)
@@ -574,6 +749,41 @@ int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont_offset)
 #define CS_MIN		(1<<6)
 #define CS_MAX		(1<<18)
 #define CS_FACTOR	2
+#define CS_TIMEOUT	1	/* seconds */
+
+#ifdef HAVE_TLS
+static const char *cache_getenv(const char *name)
+{
+#ifdef HAVE_SECURE_GETENV
+	return secure_getenv(name);
+#elif HAVE___SECURE_GETENV
+	return __secure_getenv(name);
+#else
+	if ((getuid() != geteuid()) || (getgid() != getegid()))
+		return NULL;
+	return getenv(name);
+#endif
+}
+
+/*
+ * Returns the number from the environment variable @name, or @dflt if the
+ * variable is not set or is not a number in the range @min..@max.
+ */
+static long cache_param(const char *name, long min, long max, long dflt)
+{
+	const char *str = cache_getenv(name);
+	char *end = NULL;
+	long num;
+
+	if (!str || !*str)
+		return dflt;
+	errno = 0;
+	num = strtol(str, &end, 10);
+	if (errno || !end || *end || num < min || num > max)
+		return dflt;
+	return num;
+}
+#endif
 
 /*
  * Generate time-based UUID and store it to @out
@@ -582,23 +792,51 @@ int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont_offset)
  * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
  * If neither of these is possible (e.g. because of insufficient permissions), it generates
  * the UUID anyway, but returns -1. Otherwise, returns 0.
+ *
+ * If uuidd publishes UUIDs in shared memory (uuidd --shm), the UUID is claimed
+ * from the shared memory. Otherwise the UUIDs are requested in blocks and
+ * served from a thread local cache. The block from the clock state counter is
+ * reserved by one locked update of the state file, the file always contains
+ * the end of the block.
+ *
+ * The maximal block size and the cache lifetime may be changed by the
+ * LIBUUID_CACHE_SIZE and LIBUUID_CACHE_TIMEOUT environment variables.
  */
 static int uuid_generate_time_generic(uuid_t out) {
 #ifdef HAVE_TLS
-	/* thread local cache for uuidd based requests */
+	/* thread local cache for uuidd and clock counter based requests */
 	THREAD_LOCAL int		num = 0;
-	THREAD_LOCAL int		cache_size = CS_MIN;
+	THREAD_LOCAL int		cache_size = 0;
 	THREAD_LOCAL int		last_used = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL pid_t		last_pid = 0;
+	static int			cache_max = 0;
+	static int			cache_min;
+	static time_t			cache_timeout;
 	time_t				now;
 
+	if (!cache_max) {
+		int sz = cache_param("LIBUUID_CACHE_SIZE", 1, CS_MAX, CS_MAX);
+
+		cache_timeout = cache_param("LIBUUID_CACHE_TIMEOUT",
+					    0, 3600, CS_TIMEOUT);
+		cache_min = min(sz, CS_MIN);
+		cache_max = sz;
+	}
+	if (get_uuid_via_shm(out, cache_timeout) == 0)
+		return 0;
+
+	if (!cache_size)
+		cache_size = cache_min;
+
 	if (num > 0) { /* expire cache */
 		now = time(NULL);
-		if (now > last_time+1) {
+		if (now > last_time + cache_timeout) {
 			last_used = cache_size - num;
 			num = 0;
-		}
+		} else if (last_pid != getpid())
+			num = 0;	/* don't share the cache with forked process */
 	}
 	if (num <= 0) { /* fill cache */
 		/*
@@ -606,23 +844,27 @@ static int uuid_generate_time_generic(uuid_t out) {
 		 * Start with a small cache size to cover short running applications
 		 * and adjust the cache size over the runntime.
 		 */
-		if ((last_used == cache_size) && (cache_size < CS_MAX))
-			cache_size *= CS_FACTOR;
-		else if ((last_used < (cache_size / CS_FACTOR)) && (cache_size > CS_MIN))
-			cache_size /= CS_FACTOR;
+		if ((last_used == cache_size) && (cache_size < cache_max))
+			cache_size = min(cache_size * CS_FACTOR, cache_max);
+		else if ((last_used < (cache_size / CS_FACTOR)) && (cache_size > cache_min))
+			cache_size = max(cache_size / CS_FACTOR, cache_min);
 
 		num = cache_size;
 
 		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
-					out, &num) == 0) {
-			last_time = time(NULL);
-			uuid_unpack(out, &uu);
-			num--;
-			return 0;
-		}
-		/* request to daemon failed, reset cache */
+					out, &num) == 0)
+			goto cached;
+
+		/* request to daemon failed, reserve the block by clock counter */
+		num = cache_size;
+		if (__uuid_generate_time(out, &num) == 0)
+			goto cached;
+
+		/* clock counter is not usable, reset cache and return the
+		 * UUID generated without the counter */
 		num = 0;
-		cache_size = CS_MIN;
+		cache_size = cache_min;
+		return -1;
 	}
 	if (num > 0) { /* serve uuid from cache */
 		uu.time_low++;
@@ -638,11 +880,22 @@ static int uuid_generate_time_generic(uuid_t out) {
 		return 0;
 	}
 #else
+	if (get_uuid_via_shm(out, CS_TIMEOUT) == 0)
+		return 0;
 	if (get_uuid_via_daemon(UUIDD_OP_TIME_UUID, out, 0) == 0)
 		return 0;
 #endif
 
 	return __uuid_generate_time(out, NULL);
+
+#ifdef HAVE_TLS
+cached:
+	last_time = time(NULL);
+	last_pid = getpid();
+	uuid_unpack(out, &uu);
+	num--;
+	return 0;
+#endif
 }
 
 /*
@@ -662,30 +915,47 @@ int uuid_generate_time_safe(uuid_t out)
 }
 
 
+/*
+ * Generate @n random-based UUIDs to @out; all the random data are read by
+ * one ul_random_get_bytes() call (usually one getrandom() syscall).
+ */
+static int generate_random_uuids(unsigned char *out, size_t n)
+{
+	size_t i;
+	int r = 0;
+
+	if (ul_random_get_bytes(out, n * sizeof(uuid_t)))
+		r = -1;
+
+	for (i = 0; i < n; i++, out += sizeof(uuid_t)) {
+		/* clock_seq variant and time_hi_and_version version bits */
+		out[8] = (out[8] & 0x3F) | 0x80;
+		out[6] = (out[6] & 0x0F) | 0x40;
+	}
+
+	return r;
+}
+
 int __uuid_generate_random(uuid_t out, int *num)
 {
-	uuid_t	buf;
-	struct uuid uu;
-	int i, n, r = 0;
+	size_t n;
 
-	if (!num || !*num)
+	if (!num || *num <= 0)
 		n = 1;
 	else
 		n = *num;
 
-	for (i = 0; i < n; i++) {
-		if (ul_random_get_bytes(buf, sizeof(buf)))
-			r = -1;
-		uuid_unpack(buf, &uu);
+	return generate_random_uuids(out, n);
+}
 
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
-		out += sizeof(uuid_t);
-	}
+int uuid_generate_random_n(uuid_t out[], size_t n)
+{
+	if (!out || !n)
+		return 0;
+	if (n > SIZE_MAX / sizeof(uuid_t))
+		return -1;
 
-	return r;
+	return generate_random_uuids(out[0], n);
 }
 
 void uuid_generate_random(uuid_t out)
@@ -34,7 +34,6 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "c.h"
@@ -49,50 +48,39 @@ int uuid_parse(const char *in, uuid_t uu)
 	return uuid_parse_range(in, in + len, uu);
 }
 
+static inline int hexval(unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;		/* lower case */
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
 int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu)
 {
-	struct uuid	uuid;
+	uuid_t		buf;
+	const unsigned char *cp = (const unsigned char *) in_start;
 	int		i;
-	const char	*cp;
-	char		buf[3];
 
 	if ((in_end - in_start) != 36)
 		return -1;
-	for (i=0, cp = in_start; i < 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			return -1;
-		}
 
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	errno = 0;
-	uuid.time_low = strtoul(in_start, NULL, 16);
-
-	if (!errno)
-		uuid.time_mid = strtoul(in_start+9, NULL, 16);
-	if (!errno)
-		uuid.time_hi_and_version = strtoul(in_start+14, NULL, 16);
-	if (!errno)
-		uuid.clock_seq = strtoul(in_start+19, NULL, 16);
-	if (errno)
-		return -1;
+	for (i = 0; i < 16; i++) {
+		int hi, lo;
 
-	cp = in_start+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
-
-		errno = 0;
-		uuid.node[i] = strtoul(buf, NULL, 16);
-		if (errno)
+		if (i == 4 || i == 6 || i == 8 || i == 10) {
+			if (*cp++ != '-')
+				return -1;
+		}
+		hi = hexval(*cp++);
+		lo = hexval(*cp++);
+		if (hi < 0 || lo < 0)
 			return -1;
+		buf[i] = (hi << 4) | lo;
 	}
 
-	uuid_pack(&uuid, uu);
+	memcpy(uu, buf, sizeof(buf));
 	return 0;
 }
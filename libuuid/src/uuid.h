@@ -90,6 +90,7 @@ extern void uuid_copy(uuid_t dst, const uuid_t src);
 /* gen_uuid.c */
 extern void uuid_generate(uuid_t out);
 extern void uuid_generate_random(uuid_t out);
+extern int uuid_generate_random_n(uuid_t out[], size_t n);
 extern void uuid_generate_time(uuid_t out);
 extern int uuid_generate_time_safe(uuid_t out);
 
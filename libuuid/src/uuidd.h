@@ -38,6 +38,7 @@
 #define UUIDD_DIR		_PATH_RUNSTATEDIR "/uuidd"
 #define UUIDD_SOCKET_PATH	UUIDD_DIR "/request"
 #define UUIDD_PIDFILE_PATH	UUIDD_DIR "/uuidd.pid"
+#define UUIDD_SHM_PATH		UUIDD_DIR "/shm"
 #define UUIDD_PATH		"/usr/sbin/uuidd"
 
 #define UUIDD_OP_GETPID			0
@@ -46,7 +47,46 @@
 #define UUIDD_OP_RANDOM_UUID		3
 #define UUIDD_OP_BULK_TIME_UUID		4
 #define UUIDD_OP_BULK_RANDOM_UUID	5
-#define UUIDD_MAX_OP			UUIDD_OP_BULK_RANDOM_UUID
+#define UUIDD_OP_SHM_REFILL		6
+#define UUIDD_MAX_OP			UUIDD_OP_SHM_REFILL
+
+/*
+ * Shared memory with time-based UUIDs published by "uuidd --shm".
+ *
+ * The daemon reserves blocks of UUIDs (like UUIDD_OP_BULK_TIME_UUID) and
+ * writes them to the ring of slots. The @claim is <generation of the block>
+ * << 32 | <index of the next UUID in the block>, clients get UUIDs by atomic
+ * increment of @claim. The next block is published in advance; when the
+ * current block is exhausted, a client switches @claim to the next block by
+ * compare-and-swap. UUIDD_OP_SHM_REFILL asks the daemon to publish the next
+ * block (if not published yet).
+ *
+ * The slot @gen is zero while the slot is being written (seqlock). The
+ * claimed but unused UUIDs (e.g. after crash) are never reused.
+ *
+ * The @time is when the block was published. The clients don't use blocks
+ * older than their cache timeout (LIBUUID_CACHE_TIMEOUT), the rest of such
+ * block is skipped like an exhausted block, so the UUIDs are never older
+ * than the UUIDs from the thread local cache.
+ */
+#define UUIDD_SHM_MAGIC		0x75756964	/* "uuid" */
+#define UUIDD_SHM_NSLOTS	4
+#define UUIDD_SHM_BLOCK		(1 << 14)	/* UUIDs in one block */
+
+struct uuidd_shm_slot {
+	uint64_t	gen;		/* generation of the block or 0 */
+	int64_t		time;		/* when published, time(2) */
+	uint64_t	uuid[2];	/* the first UUID of the block */
+	uint32_t	count;		/* number of UUIDs in the block */
+	uint32_t	reserved;
+};
+
+struct uuidd_shm {
+	uint32_t	magic;
+	uint32_t	reserved;
+	uint64_t	claim;
+	struct uuidd_shm_slot slots[UUIDD_SHM_NSLOTS];
+};
 
 extern int __uuid_generate_time(uuid_t out, int *num);
 extern int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont);
@@ -26,6 +26,7 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #include <stdio.h>
@@ -41,6 +42,11 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <libgen.h>
+#include <search.h>
+#include <pthread.h>
+#ifdef HAVE_STDIO_EXT_H
+# include <stdio_ext.h>
+#endif
 
 #include "c.h"
 #include "nls.h"
@@ -53,6 +59,8 @@
 #include "timeutils.h"
 #include "monotonic.h"
 #include "fileutils.h"
+#include "all-io.h"
+#include "pwdutils.h"
 
 #ifdef FUZZ_TARGET
 #include "fuzz.h"
@@ -74,7 +82,14 @@
 # define LAST_TIMESTAMP_LEN 32
 #endif
 
-#define UCHUNKSIZE	16384	/* How much we read at once. */
+/*
+ * Number of records checked around --since/--until range for records
+ * out of order (e.g. after clock change)
+ */
+#define WTMP_SEEK_SLACK	1024
+
+/* max number of threads for multiple files */
+#define LAST_MAX_THREADS	16
 
 struct last_control {
 	unsigned int lastb :1,	  /* Is this command 'lastb' */
@@ -96,13 +111,73 @@ struct last_control {
 	time_t present;		/* who where present at time_t */
 	unsigned int time_fmt;	/* time format */
 	char separator;        /* output separator */
+	int summary;		/* LAST_SUMMARY_* */
+};
+
+enum {
+	LAST_SUMMARY_NONE = 0,
+	LAST_SUMMARY_USER,
+	LAST_SUMMARY_HOST
+};
+
+/* wtmp file mapped (or read) to memory */
+struct wtmp_file {
+	char *data;		/* file content */
+	size_t size;		/* size of @data in bytes */
+	size_t offset;		/* offset of the first complete record */
+	size_t nrecs;		/* number of complete records */
+	unsigned int mapped :1;	/* @data is mmap()ed */
+};
+
+/* state of one processed file */
+struct last_file {
+	const char *filename;
+	FILE *out;		/* output stream */
+	char *buf;		/* output buffer, used for parallel processing */
+	size_t bufsz;
+
+	time_t currentdate;	/* date when we started processing the file */
+	unsigned int recsdone;	/* number of records listed */
+	void *summary;		/* struct last_summary tree for --summary */
+	struct ul_tmcache tmcache;	/* per-file, files are processed in threads */
+	unsigned int done :1;	/* processed (parallel processing) */
+};
+
+/* cached dns_lookup() result */
+struct dns_entry {
+	int32_t addr[4];
+	int rc;
+	char name[256];
+};
+
+/* The last seen (logout or login) record for the tty line */
+struct utline {
+	char line[sizeof_member(struct utmpx, ut_line)];
+	time_t time;
+	unsigned int gen;	/* valid only for the current generation */
+};
+
+#define UTLINE_CHUNKSZ	64
+
+/* struct utline are allocated in chunks, they are never freed one by one */
+struct utline_chunk {
+	struct utline_chunk *next;
+	size_t nused;
+	struct utline items[UTLINE_CHUNKSZ];
 };
 
-/* Double linked list of struct utmp's */
-struct utmplist {
-	struct utmpx ut;
-	struct utmplist *next;
-	struct utmplist *prev;
+/* tty line -> struct utline index */
+struct utline_index {
+	void *tree;
+	struct utline_chunk *chunks;
+	unsigned int gen;	/* incremented on shutdown/reboot */
+};
+
+/* --summary entry */
+struct last_summary {
+	char *name;		/* user or host */
+	unsigned long nsessions;
+	time_t duration;	/* in seconds */
 };
 
 /* Types of listing */
@@ -159,10 +234,8 @@ static struct last_timefmt timefmts[] = {
 	}
 };
 
-/* Global variables */
-static unsigned int recsdone;	/* Number of records listed */
-static time_t lastdate;		/* Last date we've seen */
-static time_t currentdate;	/* date when we started processing the file */
+static void *dns_cache;
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #ifndef FUZZ_TARGET
 /* --time-format=option parser */
@@ -179,92 +252,129 @@ static int which_time_format(const char *s)
 #endif
 
 /*
- *	Read one utmp entry, return in new format.
- *	Automatically reposition file pointer.
+ *	Map the wtmp file to memory, the file is read to the buffer if
+ *	mmap() is not possible (e.g. pipe).
  */
-static int uread(FILE *fp, struct utmpx *u,  int *quit, const char *filename)
+static int wtmp_open(struct wtmp_file *wf, const char *filename)
 {
-	static int utsize;
-	static char buf[UCHUNKSIZE];
-	char tmp[1024];
-	static off_t fpos;
-	static int bpos;
-	off_t o;
-
-	if (quit == NULL && u != NULL) {
-		/*
-		 *	Normal read.
-		 */
-		return fread(u, sizeof(struct utmpx), 1, fp);
+	struct stat st;
+	int fd;
+
+	memset(wf, 0, sizeof(*wf));
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) != 0) {
+		int rc = -errno;
+		close(fd);
+		return rc;
 	}
 
-	if (u == NULL) {
-		/*
-		 *	Initialize and position.
-		 */
-		utsize = sizeof(struct utmpx);
-		fseeko(fp, 0, SEEK_END);
-		fpos = ftello(fp);
-		if (fpos == 0)
-			return 0;
-		o = ((fpos - 1) / UCHUNKSIZE) * UCHUNKSIZE;
-		if (fseeko(fp, o, SEEK_SET) < 0) {
-			warn(_("seek on %s failed"), filename);
-			return 0;
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			wf->data = map;
+			wf->size = st.st_size;
+			wf->mapped = 1;
 		}
-		bpos = (int)(fpos - o);
-		if (fread(buf, bpos, 1, fp) != 1) {
+	}
+	if (!wf->mapped && (!S_ISREG(st.st_mode) || st.st_size > 0)) {
+		ssize_t sz = read_all_alloc(fd, &wf->data);
+
+		if (sz < 0) {
+			close(fd);
 			warn(_("cannot read %s"), filename);
 			return 0;
 		}
-		fpos = o;
-		return 1;
+		wf->size = sz;
 	}
+	close(fd);
 
-	/*
-	 *	Read one struct. From the buffer if possible.
-	 */
-	bpos -= utsize;
-	if (bpos >= 0) {
-		memcpy(u, buf + bpos, sizeof(struct utmpx));
-		return 1;
-	}
+	/* the records are read backwards, an incomplete record is
+	 * possible only at the begin of the file */
+	wf->nrecs = wf->size / sizeof(struct utmpx);
+	wf->offset = wf->size % sizeof(struct utmpx);
+	return 0;
+}
 
-	/*
-	 *	Oops we went "below" the buffer. We should be able to
-	 *	seek back UCHUNKSIZE bytes.
-	 */
-	fpos -= UCHUNKSIZE;
-	if (fpos < 0)
-		return 0;
+static void wtmp_close(struct wtmp_file *wf)
+{
+	if (wf->mapped)
+		munmap(wf->data, wf->size);
+	else
+		free(wf->data);
+	memset(wf, 0, sizeof(*wf));
+}
 
-	/*
-	 *	Copy whatever is left in the buffer.
-	 */
-	memcpy(tmp + (-bpos), buf, utsize + bpos);
-	if (fseeko(fp, fpos, SEEK_SET) < 0) {
-		warn(_("seek on %s failed"), filename);
-		return 0;
-	}
+static void wtmp_get(const struct wtmp_file *wf, size_t idx, struct utmpx *u)
+{
+	/* the records are not aligned in the file */
+	memcpy(u, wf->data + wf->offset + idx * sizeof(struct utmpx),
+	       sizeof(struct utmpx));
+}
 
-	/*
-	 *	Read another UCHUNKSIZE bytes.
-	 */
-	if (fread(buf, UCHUNKSIZE, 1, fp) != 1) {
-		warn(_("cannot read %s"), filename);
-		return 0;
-	}
+static time_t wtmp_get_time(const struct wtmp_file *wf, size_t idx)
+{
+	struct utmpx u;
 
-	/*
-	 *	The end of the UCHUNKSIZE byte buffer should be the first
-	 *	few bytes of the current struct utmp.
-	 */
-	memcpy(tmp, buf + UCHUNKSIZE + bpos, -bpos);
-	bpos += UCHUNKSIZE;
+	wtmp_get(wf, idx, &u);
+	return u.ut_tv.tv_sec;
+}
+
+static int is_in_range(const struct last_control *ctl, time_t t)
+{
+	return !(ctl->since && t < ctl->since) && !(ctl->until && ctl->until < t);
+}
+
+/*
+ * Returns the range of the records [*lo, *hi) with --since and --until
+ * times. The wtmp file is mostly sorted by time, so the boundaries are
+ * found by binary search, and WTMP_SEEK_SLACK records behind the
+ * boundaries are checked for records out of order.
+ */
+static void wtmp_get_range(const struct last_control *ctl,
+			   const struct wtmp_file *wf, size_t *lo, size_t *hi)
+{
+	size_t l, h, i, last;
+
+	*lo = 0;
+	*hi = wf->nrecs;
+
+	if (ctl->until) {
+		/* the first record after until */
+		for (l = 0, h = wf->nrecs; l < h; ) {
+			size_t m = l + (h - l) / 2;
+
+			if (wtmp_get_time(wf, m) <= ctl->until)
+				l = m + 1;
+			else
+				h = m;
+		}
+		for (i = last = l; i < wf->nrecs && i - last < WTMP_SEEK_SLACK; i++) {
+			if (is_in_range(ctl, wtmp_get_time(wf, i)))
+				last = i + 1;
+		}
+		*hi = last;
+	}
 
-	memcpy(u, tmp, sizeof(struct utmpx));
+	if (ctl->since) {
+		/* the first record since */
+		for (l = 0, h = *hi; l < h; ) {
+			size_t m = l + (h - l) / 2;
 
-	return 1;
+			if (wtmp_get_time(wf, m) < ctl->since)
+				l = m + 1;
+			else
+				h = m;
+		}
+		for (i = last = l; i > 0 && last - i < WTMP_SEEK_SLACK; i--) {
+			if (is_in_range(ctl, wtmp_get_time(wf, i - 1)))
+				last = i - 1;
+		}
+		*lo = last;
+	}
 }
 
 #ifndef FUZZ_TARGET
@@ -330,7 +440,53 @@ static int dns_lookup(char *result, int size, int useip, int32_t *a)
 	return getnameinfo(sa, salen, result, size, NULL, 0, flags);
 }
 
-static int time_formatter(int fmt, char *dst, size_t dlen, time_t *when)
+static int cmp_dns_entry(const void *a, const void *b)
+{
+	return memcmp(((const struct dns_entry *) a)->addr,
+		      ((const struct dns_entry *) b)->addr,
+		      sizeof(((struct dns_entry *) 0)->addr));
+}
+
+/*
+ *	The same hosts are usually in many records, the lookup results
+ *	are cached.
+ */
+static int dns_lookup_cached(char *result, int size, int useip, int32_t *a)
+{
+	struct dns_entry key, *e, **node;
+	int rc;
+
+	memcpy(key.addr, a, sizeof(key.addr));
+
+	pthread_mutex_lock(&dns_lock);
+	node = tfind(&key, &dns_cache, cmp_dns_entry);
+	e = node ? *node : NULL;
+	pthread_mutex_unlock(&dns_lock);
+
+	if (!e) {
+		struct dns_entry *x = xcalloc(1, sizeof(*x));
+
+		memcpy(x->addr, a, sizeof(x->addr));
+		x->rc = dns_lookup(x->name, sizeof(x->name), useip, x->addr);
+
+		pthread_mutex_lock(&dns_lock);
+		node = tsearch(x, &dns_cache, cmp_dns_entry);
+		if (!node)
+			err_oom();
+		e = *node;
+		pthread_mutex_unlock(&dns_lock);
+		if (e != x)
+			free(x);	/* added by another thread */
+	}
+
+	rc = e->rc;
+	if (rc == 0)
+		xstrncpy(result, e->name, size);
+	return rc;
+}
+
+static int time_formatter(struct ul_tmcache *tmcache, int fmt,
+			  char *dst, size_t dlen, time_t *when)
 {
 	int ret = 0;
 
@@ -342,7 +498,7 @@ static int time_formatter(int fmt, char *dst, size_t dlen, time_t *when)
 	{
 		struct tm tm;
 
-		localtime_r(when, &tm);
+		ul_tmcache_convert(tmcache, *when, 0, &tm);
 		if (!snprintf(dst, dlen, "%02d:%02d", tm.tm_hour, tm.tm_min))
 			ret = -1;
 		break;
@@ -357,7 +513,7 @@ static int time_formatter(int fmt, char *dst, size_t dlen, time_t *when)
 		break;
 	}
 	case LAST_TIMEFTM_ISO8601:
-		ret = strtime_iso(when, ISO_TIMESTAMP_T, dst, dlen);
+		ret = strtime_iso_cached(tmcache, when, ISO_TIMESTAMP_T, dst, dlen);
 		break;
 	default:
 		abort();
@@ -382,10 +538,96 @@ static void trim_trailing_spaces(char *s)
 	*p = '\0';
 }
 
+/*
+ *	Remote host as displayed in the output
+ */
+static void get_domain(const struct last_control *ctl, struct utmpx *p,
+		       char *domain, size_t sz)
+{
+	int r = -1;
+
+	/*
+	 *	Look up host with DNS if needed.
+	 */
+	if (ctl->usedns || ctl->useip)
+		r = dns_lookup_cached(domain, sz, ctl->useip, (int32_t*)p->ut_addr_v6);
+	if (r < 0)
+		mem2strcpy(domain, p->ut_host, sizeof(p->ut_host), sz);
+}
+
+static int cmp_summary(const void *a, const void *b)
+{
+	return strcmp(((const struct last_summary *) a)->name,
+		      ((const struct last_summary *) b)->name);
+}
+
+static void free_summary(void *data)
+{
+	struct last_summary *x = data;
+
+	free(x->name);
+	free(x);
+}
+
+static void summary_add(void **tree, const char *name,
+			unsigned long nsessions, time_t duration)
+{
+	struct last_summary key = { .name = (char *) name }, *x, **node;
+
+	node = tfind(&key, tree, cmp_summary);
+	if (!node) {
+		x = xcalloc(1, sizeof(*x));
+		x->name = xstrdup(name);
+		node = tsearch(x, tree, cmp_summary);
+		if (!node)
+			err_oom();
+	}
+	(*node)->nsessions += nsessions;
+	(*node)->duration += duration;
+}
+
+/*
+ *	Account the session for --summary
+ */
+static void summary_session(const struct last_control *ctl, struct last_file *lf,
+			    struct utmpx *p, time_t logout_time, int what)
+{
+	char name[256];
+	time_t secs;
+
+	/* system records (-x, reboots) */
+	if (!ctl->lastb && p->ut_type != USER_PROCESS)
+		return;
+
+	switch (what) {
+	case R_NORMAL:
+	case R_CRASH:
+	case R_DOWN:
+		secs = logout_time - p->ut_tv.tv_sec;
+		break;
+	case R_NOW:
+		secs = lf->currentdate - p->ut_tv.tv_sec;
+		break;
+	default:
+		secs = 0;	/* unknown logout time */
+		break;
+	}
+	if (secs < 0)
+		secs = 0;
+
+	if (ctl->summary == LAST_SUMMARY_HOST)
+		get_domain(ctl, p, name, sizeof(name));
+	else
+		mem2strcpy(name, p->ut_user, sizeof(p->ut_user), sizeof(name));
+
+	summary_add(&lf->summary, name, 1, secs);
+}
+
 /*
  *	Show one line of information on screen
  */
-static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_time, int what)
+static int list(const struct last_control *ctl, struct last_file *lf,
+		struct utmpx *p, time_t logout_time, int what)
 {
 	time_t		secs, utmp_time;
 	char		logintime[LAST_TIMESTAMP_LEN];
@@ -395,7 +637,7 @@ static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_t
 	char		utline[sizeof(p->ut_line) + 1];
 	char		domain[256];
 	int		mins, hours, days;
-	int		r, len;
+	int		len;
 	struct last_timefmt *fmt;
 
 	/*
@@ -435,8 +677,13 @@ static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_t
 			return 0;
 	}
 
+	if (ctl->summary) {
+		summary_session(ctl, lf, p, logout_time, what);
+		goto done;
+	}
+
 	/* log-in time */
-	if (time_formatter(fmt->in_fmt, logintime,
+	if (time_formatter(&lf->tmcache, fmt->in_fmt, logintime,
 			   sizeof(logintime), &utmp_time) < 0)
 		errx(EXIT_FAILURE, _("preallocation size exceeded"));
 
@@ -447,11 +694,11 @@ static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_t
 	days  = secs / 86400;
 
 	strcpy(logouttime, "- ");
-	if (time_formatter(fmt->out_fmt, logouttime + 2,
+	if (time_formatter(&lf->tmcache, fmt->out_fmt, logouttime + 2,
 			   sizeof(logouttime) - 2, &logout_time) < 0)
 		errx(EXIT_FAILURE, _("preallocation size exceeded"));
 
-	if (logout_time == currentdate) {
+	if (logout_time == lf->currentdate) {
 		if (ctl->time_fmt > LAST_TIMEFTM_SHORT) {
 			snprintf(logouttime, sizeof(logouttime), "  still running");
 			length[0] = 0;
@@ -509,14 +756,7 @@ static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_t
 			abort();
 	}
 
-	/*
-	 *	Look up host with DNS if needed.
-	 */
-	r = -1;
-	if (ctl->usedns || ctl->useip)
-		r = dns_lookup(domain, sizeof(domain), ctl->useip, (int32_t*)p->ut_addr_v6);
-	if (r < 0)
-		mem2strcpy(domain, p->ut_host, sizeof(p->ut_host), sizeof(domain));
+	get_domain(ctl, p, domain, sizeof(domain));
 
 	if (ctl->showhost) {
 		if (!ctl->altlist) {
@@ -550,13 +790,13 @@ static int list(const struct last_control *ctl, struct utmpx *p, time_t logout_t
 	/*
 	 *	Print out "final" string safely.
 	 */
-	fputs_careful(final, stdout, '*', false, 0);
+	fputs_careful(final, lf->out, '*', false, 0);
 
 	if (len < 0 || (size_t)len >= sizeof(final))
-		putchar('\n');
-
-	recsdone++;
-	if (ctl->maxrecs && ctl->maxrecs <= recsdone)
+		fputc('\n', lf->out);
+done:
+	lf->recsdone++;
+	if (ctl->maxrecs && ctl->maxrecs <= lf->recsdone)
 		return 1;
 
 	return 0;
@@ -584,6 +824,8 @@ static void __attribute__((__noreturn__)) usage(const struct last_control *ctl)
 	fputs(_(" -n, --limit <number> how many lines to show\n"), out);
 	fputs(_(" -R, --nohostname     don't display the hostname field\n"), out);
 	fputs(_(" -s, --since <time>   display the lines since the specified time\n"), out);
+	fputs(_(" -S, --summary[=<what>]  print number of sessions and total time\n"
+		"                         per user or host\n"), out);
 	fputs(_(" -t, --until <time>   display the lines until the specified time\n"), out);
 	fputs(_(" -T, --tab-separated	use tabs as delimiters\n"), out);
 	fputs(_(" -p, --present <time> display who were present at the specified time\n"), out);
@@ -600,20 +842,94 @@ static void __attribute__((__noreturn__)) usage(const struct last_control *ctl)
 }
 #endif
 
+static int cmp_utline(const void *a, const void *b)
+{
+	return strncmp(((const struct utline *) a)->line,
+		       ((const struct utline *) b)->line,
+		       sizeof_member(struct utline, line));
+}
+
+static void free_nothing(void *p __attribute__((__unused__)))
+{
+}
+
+static struct utline *utline_get(struct utline_index *idx, const struct utmpx *ut)
+{
+	struct utline key, **node;
+
+	memcpy(key.line, ut->ut_line, sizeof(key.line));
+
+	node = tfind(&key, &idx->tree, cmp_utline);
+	if (!node || (*node)->gen != idx->gen)
+		return NULL;
+	return *node;
+}
+
+static void utline_set(struct utline_index *idx, const struct utmpx *ut)
+{
+	struct utline_chunk *ch = idx->chunks;
+	struct utline *x, **node;
+
+	if (!ch || ch->nused == UTLINE_CHUNKSZ) {
+		ch = xcalloc(1, sizeof(*ch));
+		ch->next = idx->chunks;
+		idx->chunks = ch;
+	}
+
+	/* use the next free item as the key, it's used only if not in the tree yet */
+	x = &ch->items[ch->nused];
+	memcpy(x->line, ut->ut_line, sizeof(x->line));
+
+	node = tsearch(x, &idx->tree, cmp_utline);
+	if (!node)
+		err_oom();
+	if (*node == x)
+		ch->nused++;
+
+	(*node)->time = ut->ut_tv.tv_sec;
+	(*node)->gen = idx->gen;
+}
+
+/* forget all records */
+static void utline_reset(struct utline_index *idx)
+{
+	idx->gen++;
+}
+
+static void utline_free(struct utline_index *idx)
+{
+	struct utline_chunk *ch, *next;
+
+	if (idx->tree)
+		tdestroy(idx->tree, free_nothing);
+	for (ch = idx->chunks; ch; ch = next) {
+		next = ch->next;
+		free(ch);
+	}
+	memset(idx, 0, sizeof(*idx));
+}
+
 static int is_phantom(const struct last_control *ctl, struct utmpx *ut)
 {
 	struct passwd *pw;
 	char path[sizeof(ut->ut_line) + 16];
 	char user[sizeof(ut->ut_user) + 1];
+	char *pwbuf = NULL;
+	uid_t uid;
 	int ret = 0;
 
 	if (ut->ut_tv.tv_sec < ctl->boot_time.tv_sec)
 		return 1;
 
 	mem2strcpy(user, ut->ut_user, sizeof(ut->ut_user), sizeof(user));
-	pw = getpwnam(user);
-	if (!pw)
+	pw = xgetpwnam(user, &pwbuf);
+	if (!pw) {
+		free(pwbuf);
 		return 1;
+	}
+	uid = pw->pw_uid;
+	free(pwbuf);
+
 	snprintf(path, sizeof(path), "/proc/%u/loginuid", ut->ut_pid);
 	if (access(path, R_OK) == 0) {
 		unsigned int loginuid;
@@ -624,7 +940,7 @@ static int is_phantom(const struct last_control *ctl, struct utmpx *ut)
 		if (fscanf(f, "%u", &loginuid) != 1)
 			ret = 1;
 		fclose(f);
-		if (!ret && pw->pw_uid != loginuid)
+		if (!ret && uid != loginuid)
 			return 1;
 	} else {
 		struct stat st;
@@ -635,21 +951,21 @@ static int is_phantom(const struct last_control *ctl, struct utmpx *ut)
 		snprintf(path, sizeof(path), "/dev/%s", utline);
 		if (stat(path, &st))
 			return 1;
-		if (pw->pw_uid != st.st_uid)
+		if (uid != st.st_uid)
 			return 1;
 	}
 	return ret;
 }
 
 static void process_wtmp_file(const struct last_control *ctl,
-			      const char *filename)
+			      struct last_file *lf)
 {
-	FILE *fp;		/* File pointer of wtmp file */
+	struct wtmp_file wf;	/* wtmp file in memory */
+	const char *filename = lf->filename;
 
 	struct utmpx ut;	/* Current utmp entry */
-	struct utmplist *ulist = NULL;	/* All entries */
-	struct utmplist *p;	/* Pointer into utmplist */
-	struct utmplist *next;	/* Pointer into utmplist */
+	struct utline_index lines = { 0 };	/* Pending records by tty line */
+	struct utline *l;	/* Record for the same tty line */
 
 	time_t lastboot = 0;	/* Last boottime */
 	time_t lastrch = 0;	/* Last run level change */
@@ -661,6 +977,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 	struct stat st;		/* To stat the [uw]tmp file */
 	int quit = 0;		/* Flag */
 	int down = 0;		/* Down flag */
+	size_t idx, lo, hi;	/* Records range */
 
 #ifndef FUZZ_TARGET
 	time(&lastdown);
@@ -668,9 +985,9 @@ static void process_wtmp_file(const struct last_control *ctl,
 	lastdown = 1596001948;
 #endif
 	/*
-	 * Fill in 'lastdate'
+	 * Fill in 'currentdate'
 	 */
-	lastdate = currentdate = lastrch = lastdown;
+	lf->currentdate = lastrch = lastdown;
 
 #ifndef FUZZ_TARGET
 	/*
@@ -681,41 +998,35 @@ static void process_wtmp_file(const struct last_control *ctl,
 #endif
 
 	/*
-	 * Open the utmp file
+	 * Map the utmp file
 	 */
-	if ((fp = fopen(filename, "r")) == NULL)
+	if (wtmp_open(&wf, filename) != 0)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
-	/*
-	 * Optimize the buffer size.
-	 */
-	setvbuf(fp, NULL, _IOFBF, UCHUNKSIZE);
-
 	/*
 	 * Read first structure to capture the time field
 	 */
-	if (uread(fp, &ut, NULL, filename) == 1)
+	if (wf.size >= sizeof(struct utmpx)) {
+		memcpy(&ut, wf.data, sizeof(struct utmpx));
 		begintime = ut.ut_tv.tv_sec;
-	else {
-		if (fstat(fileno(fp), &st) != 0)
+	} else {
+		if (stat(filename, &st) != 0)
 			err(EXIT_FAILURE, _("stat of %s failed"), filename);
 		begintime = st.st_ctime;
 		quit = 1;
 	}
 
 	/*
-	 * Go to end of file minus one structure
-	 * and/or initialize utmp reading code.
+	 * Skip the records out of --since and --until range.
 	 */
-	uread(fp, NULL, NULL, filename);
+	wtmp_get_range(ctl, &wf, &lo, &hi);
 
 	/*
 	 * Read struct after struct backwards from the file.
 	 */
-	while (!quit) {
+	for (idx = hi; !quit && idx > lo; ) {
 
-		if (uread(fp, &ut, &quit, filename) != 1)
-			break;
+		wtmp_get(&wf, --idx, &ut);
 
 		if (ctl->since && ut.ut_tv.tv_sec < ctl->since)
 			continue;
@@ -723,10 +1034,8 @@ static void process_wtmp_file(const struct last_control *ctl,
 		if (ctl->until && ctl->until < ut.ut_tv.tv_sec)
 			continue;
 
-		lastdate = ut.ut_tv.tv_sec;
-
 		if (ctl->lastb) {
-			quit = list(ctl, &ut, ut.ut_tv.tv_sec, R_NORMAL);
+			quit = list(ctl, lf, &ut, ut.ut_tv.tv_sec, R_NORMAL);
 			continue;
 		}
 
@@ -774,7 +1083,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 		case SHUTDOWN_TIME:
 			if (ctl->extended) {
 				strcpy(ut.ut_line, "system down");
-				quit = list(ctl, &ut, lastboot, R_NORMAL);
+				quit = list(ctl, lf, &ut, lastboot, R_NORMAL);
 			}
 			lastdown = lastrch = ut.ut_tv.tv_sec;
 			down = 1;
@@ -785,15 +1094,15 @@ static void process_wtmp_file(const struct last_control *ctl,
 				strcpy(ut.ut_line,
 				ut.ut_type == NEW_TIME ? "new time" :
 					"old time");
-				quit = list(ctl, &ut, lastdown, R_TIMECHANGE);
+				quit = list(ctl, lf, &ut, lastdown, R_TIMECHANGE);
 			}
 			break;
 		case BOOT_TIME:
 			strcpy(ut.ut_line, "system boot");
-			if (lastdown > lastboot && lastdown != currentdate)
-				quit = list(ctl, &ut, lastboot, R_REBOOT_CRASH);
+			if (lastdown > lastboot && lastdown != lf->currentdate)
+				quit = list(ctl, lf, &ut, lastboot, R_REBOOT_CRASH);
 			else
-				quit = list(ctl, &ut, lastdown, R_REBOOT);
+				quit = list(ctl, lf, &ut, lastdown, R_REBOOT);
 			lastboot = ut.ut_tv.tv_sec;
 			down = 1;
 			break;
@@ -801,7 +1110,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 			x = ut.ut_pid & 255;
 			if (ctl->extended) {
 				snprintf(ut.ut_line, sizeof(ut.ut_line), "(to lvl %c)", x);
-				quit = list(ctl, &ut, lastrch, R_NORMAL);
+				quit = list(ctl, lf, &ut, lastrch, R_NORMAL);
 			}
 			if (x == '0' || x == '6') {
 				lastdown = ut.ut_tv.tv_sec;
@@ -813,28 +1122,15 @@ static void process_wtmp_file(const struct last_control *ctl,
 
 		case USER_PROCESS:
 			/*
-			 * This was a login - show the first matching
-			 * logout record and delete all records with
-			 * the same ut_line.
+			 * This was a login - show the matching logout
+			 * record for the same ut_line. The login record
+			 * replaces the logout record in the index.
 			 */
 			c = 0;
-			for (p = ulist; p; p = next) {
-				next = p->next;
-				if (strncmp(p->ut.ut_line, ut.ut_line,
-				    sizeof(ut.ut_line)) == 0) {
-					/* Show it */
-					if (c == 0) {
-						quit = list(ctl, &ut, p->ut.ut_tv.tv_sec, R_NORMAL);
-						c = 1;
-					}
-					if (p->next)
-						p->next->prev = p->prev;
-					if (p->prev)
-						p->prev->next = p->next;
-					else
-						ulist = p->next;
-					free(p);
-				}
+			l = utline_get(&lines, &ut);
+			if (l) {
+				quit = list(ctl, lf, &ut, l->time, R_NORMAL);
+				c = 1;
 			}
 			/*
 			 * Not found? Then crashed, down, still
@@ -848,7 +1144,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 						c = R_PHANTOM;
 				} else
 					c = whydown;
-				quit = list(ctl, &ut, lastboot, c);
+				quit = list(ctl, lf, &ut, lastboot, c);
 			}
 			/* fallthrough */
 
@@ -859,13 +1155,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 			 */
 			if (ut.ut_line[0] == 0)
 				break;
-			p = xmalloc(sizeof(struct utmplist));
-			memcpy(&p->ut, &ut, sizeof(struct utmpx));
-			p->next  = ulist;
-			p->prev  = NULL;
-			if (ulist)
-				ulist->prev = p;
-			ulist = p;
+			utline_set(&lines, &ut);
 			break;
 
 		case EMPTY:
@@ -883,44 +1173,188 @@ static void process_wtmp_file(const struct last_control *ctl,
 
 		/*
 		 * If we saw a shutdown/reboot record we can remove
-		 * the entire current ulist.
+		 * all the pending records.
 		 */
 		if (down) {
 			lastboot = ut.ut_tv.tv_sec;
 			whydown = (ut.ut_type == SHUTDOWN_TIME) ? R_DOWN : R_CRASH;
-			for (p = ulist; p; p = next) {
-				next = p->next;
-				free(p);
-			}
-			ulist = NULL;
+			utline_reset(&lines);
 			down = 0;
 		}
 	}
 
-	if (ctl->time_fmt != LAST_TIMEFTM_NONE) {
+	if (ctl->time_fmt != LAST_TIMEFTM_NONE && !ctl->summary) {
 		struct last_timefmt *fmt;
 		char timestr[LAST_TIMESTAMP_LEN];
 		char *tmp = xstrdup(filename);
 
 		fmt = &timefmts[ctl->time_fmt];
-		if (time_formatter(fmt->in_fmt, timestr,
+		if (time_formatter(&lf->tmcache, fmt->in_fmt, timestr,
 				   sizeof(timestr), &begintime) < 0)
 			errx(EXIT_FAILURE, _("preallocation size exceeded"));
-		printf(_("\n%s begins %s\n"), basename(tmp), timestr);
+		fprintf(lf->out, _("\n%s begins %s\n"), basename(tmp), timestr);
 		free(tmp);
 	}
 
-	fclose(fp);
+	wtmp_close(&wf);
+	utline_free(&lines);
+}
+
+#ifndef FUZZ_TARGET
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t files_cond = PTHREAD_COND_INITIALIZER;
+
+struct last_queue {
+	const struct last_control *ctl;
+	struct last_file *files;
+	size_t nfiles;
+	size_t next;		/* next file to process */
+};
+
+static void *file_worker(void *data)
+{
+	struct last_queue *q = data;
+
+	for (;;) {
+		struct last_file *lf;
+
+		pthread_mutex_lock(&files_lock);
+		lf = q->next < q->nfiles ? &q->files[q->next++] : NULL;
+		pthread_mutex_unlock(&files_lock);
+		if (!lf)
+			break;
+
+		lf->out = open_memstream(&lf->buf, &lf->bufsz);
+		if (!lf->out)
+			err(EXIT_FAILURE, _("cannot allocate output buffer"));
+#ifdef HAVE_STDIO_EXT_H
+		/* the buffer is private for the thread */
+		__fsetlocking(lf->out, FSETLOCKING_BYCALLER);
+#endif
+		process_wtmp_file(q->ctl, lf);
+		if (fclose(lf->out) != 0)
+			err(EXIT_FAILURE, _("cannot allocate output buffer"));
+
+		pthread_mutex_lock(&files_lock);
+		lf->done = 1;
+		pthread_cond_broadcast(&files_cond);
+		pthread_mutex_unlock(&files_lock);
+	}
+	return NULL;
+}
+
+/*
+ * The files are processed in threads to memory buffers, the buffers are
+ * printed in the original order as soon as possible.
+ */
+static void process_wtmp_files(const struct last_control *ctl,
+			       struct last_file *files, size_t nfiles,
+			       size_t nthreads)
+{
+	struct last_queue q = { .ctl = ctl, .files = files, .nfiles = nfiles };
+	pthread_t threads[LAST_MAX_THREADS];
+	size_t i;
+
+	nthreads = min(nthreads, (size_t) LAST_MAX_THREADS);
 
-	for (p = ulist; p; p = next) {
-		next = p->next;
-		free(p);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, file_worker, &q) != 0)
+			break;
 	}
+	nthreads = i;
+	if (!nthreads)
+		file_worker(&q);
+
+	for (i = 0; i < nfiles; i++) {
+		pthread_mutex_lock(&files_lock);
+		while (!files[i].done)
+			pthread_cond_wait(&files_cond, &files_lock);
+		pthread_mutex_unlock(&files_lock);
+
+		fwrite(files[i].buf, 1, files[i].bufsz, stdout);
+		free(files[i].buf);
+		files[i].buf = NULL;
+	}
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+}
+#endif
+
+#ifndef FUZZ_TARGET
+/* twalk() does not allow to pass any private data to the callback */
+static void *summary_total;
+static const struct last_control *summary_ctl;
+
+static void summary_merge(const void *node, VISIT which,
+			  int depth __attribute__((__unused__)))
+{
+	const struct last_summary *x = *(struct last_summary * const *) node;
+
+	if (which == postorder || which == leaf)
+		summary_add(&summary_total, x->name, x->nsessions, x->duration);
 }
 
-#ifdef FUZZ_TARGET
-# include "all-io.h"
+static void summary_print(const void *node, VISIT which,
+			  int depth __attribute__((__unused__)))
+{
+	const struct last_summary *x = *(struct last_summary * const *) node;
+	const struct last_control *ctl = summary_ctl;
+	char duration[LAST_TIMESTAMP_LEN];
+	time_t days = x->duration / 86400;
+	int hours = (x->duration / 3600) % 24;
+	int mins = (x->duration / 60) % 60;
+	size_t len, width;
+
+	if (which != postorder && which != leaf)
+		return;
+
+	if (days)
+		snprintf(duration, sizeof(duration), "%jd+%02d:%02d",
+				(intmax_t) days, hours, mins);
+	else
+		snprintf(duration, sizeof(duration), "%02d:%02d", hours, mins);
+
+	width = ctl->summary == LAST_SUMMARY_HOST ? ctl->domain_len : ctl->name_len;
+	len = strlen(x->name);
+
+	fputs_careful(x->name, stdout, '*', false, 0);
+	if (len < width)
+		printf("%*s", (int) (width - len), "");
+	printf("%c%8lu%c%s\n", ctl->separator, x->nsessions, ctl->separator, duration);
+}
+
+/*
+ *	Print --summary for all files
+ */
+static void print_summary(const struct last_control *ctl,
+			  struct last_file *files, size_t nfiles)
+{
+	size_t i;
+
+	summary_ctl = ctl;
+	for (i = 0; i < nfiles; i++) {
+		if (!files[i].summary)
+			continue;
+		twalk(files[i].summary, summary_merge);
+		tdestroy(files[i].summary, free_summary);
+		files[i].summary = NULL;
+	}
+
+	printf("%-*s%c%8s%c%s\n",
+		ctl->summary == LAST_SUMMARY_HOST ? (int) ctl->domain_len :
+						    (int) ctl->name_len,
+		ctl->summary == LAST_SUMMARY_HOST ? _("HOST") : _("USER"),
+		ctl->separator, _("SESSIONS"), ctl->separator, _("TIME"));
+	if (summary_total) {
+		twalk(summary_total, summary_print);
+		tdestroy(summary_total, free_summary);
+		summary_total = NULL;
+	}
+}
+#endif
 
+#ifdef FUZZ_TARGET
 int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	struct last_control ctl = {
 		.showhost = TRUE,
@@ -933,6 +1367,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 		}
 	};
 	char name[] = "/tmp/test-last-fuzz.XXXXXX";
+	struct last_file lf = { .filename = name, .out = stdout };
 	int fd;
 
 	fd = mkstemp_cloexec(name);
@@ -941,7 +1376,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	if (write_all(fd, data, size) != 0)
 		err(EXIT_FAILURE, "write() failed");
 
-	process_wtmp_file(&ctl, name);
+	process_wtmp_file(&ctl, &lf);
 
 	close(fd);
 	unlink(name);
@@ -958,7 +1393,9 @@ int main(int argc, char **argv)
 		.domain_len = LAST_DOMAIN_LEN
 	};
 	char **files = NULL;
+	struct last_file *lfs;
 	size_t i, nfiles = 0;
+	long ncpus;
 	int c;
 	usec_t p;
 
@@ -981,6 +1418,7 @@ int main(int argc, char **argv)
 	      { "fulltimes",  no_argument,       NULL, 'F' },
 	      { "fullnames",  no_argument,       NULL, 'w' },
 	      { "tab-separated",  no_argument,   NULL, 'T' },
+	      { "summary",    optional_argument, NULL, 'S' },
 	      { "time-format", required_argument, NULL, OPT_TIME_FORMAT },
 	      { NULL, 0, NULL, 0 }
 	};
@@ -1000,7 +1438,7 @@ int main(int argc, char **argv)
 	ctl.lastb = strcmp(program_invocation_short_name, "lastb") == 0 ? 1 : 0;
 	ctl.separator = ' ';
 	while ((c = getopt_long(argc, argv,
-			 "hVf:n:RxadFit:p:s:T0123456789w", long_opts, NULL)) != -1) {
+			 "hVf:n:RxadFit:p:s:S::T0123456789w", long_opts, NULL)) != -1) {
 
 		err_exclusive_options(c, long_opts, excl, excl_st);
 
@@ -1067,6 +1505,14 @@ int main(int argc, char **argv)
 		case 'T':
 			ctl.separator = '\t';
 			break;
+		case 'S':
+			if (!optarg || strcmp(optarg, "user") == 0)
+				ctl.summary = LAST_SUMMARY_USER;
+			else if (strcmp(optarg, "host") == 0)
+				ctl.summary = LAST_SUMMARY_HOST;
+			else
+				errx(EXIT_FAILURE, _("unsupported summary: %s"), optarg);
+			break;
 		default:
 			errtryhelp(EXIT_FAILURE);
 		}
@@ -1080,12 +1526,34 @@ int main(int argc, char **argv)
 		files[nfiles++] = xstrdup(ctl.lastb ? _PATH_BTMP : _PATH_WTMP);
 	}
 
-	for (i = 0; i < nfiles; i++) {
-		get_boot_time(&ctl.boot_time);
-		process_wtmp_file(&ctl, files[i]);
-		free(files[i]);
+	get_boot_time(&ctl.boot_time);
+
+	lfs = xcalloc(nfiles, sizeof(struct last_file));
+	for (i = 0; i < nfiles; i++)
+		lfs[i].filename = files[i];
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* the --limit is shared by all files, process them one by one */
+	if (nfiles > 1 && ncpus > 1 && !ctl.maxrecs)
+		process_wtmp_files(&ctl, lfs, nfiles, min((size_t) ncpus, nfiles));
+	else {
+		for (i = 0; i < nfiles; i++) {
+			lfs[i].out = stdout;
+			lfs[i].recsdone = i ? lfs[i - 1].recsdone : 0;
+			process_wtmp_file(&ctl, &lfs[i]);
+		}
 	}
+
+	if (ctl.summary)
+		print_summary(&ctl, lfs, nfiles);
+
+	for (i = 0; i < nfiles; i++)
+		free(files[i]);
 	free(files);
+	free(lfs);
+	if (dns_cache)
+		tdestroy(dns_cache, free);
 	return EXIT_SUCCESS;
 }
 #endif
@@ -264,6 +264,10 @@ struct lslogins_control {
 	struct utmpx *btmp;
 	size_t btmp_size;
 
+	void *wtmp_index;	/* username -> the last wtmp record */
+	void *btmp_index;	/* username -> the last btmp record */
+	void *nprocs_index;	/* UID -> number of processes */
+
 	int lastlogin_fd;
 
 #ifdef HAVE_LIBLASTLOG2
@@ -332,6 +336,7 @@ static int column_name_to_id(const char *name, size_t namesz)
 }
 
 static struct timeval now;
+static struct ul_tmcache tmcache;
 
 static char *make_time(int mode, time_t time)
 {
@@ -343,7 +348,7 @@ static char *make_time(int mode, time_t time)
 	{
 		char *s;
 		struct tm tm;
-		localtime_r(&time, &tm);
+		ul_tmcache_convert(&tmcache, time, 0, &tm);
 
 		asctime_r(&tm, buf);
 		if (*(s = buf + strlen(buf) - 1) == '\n')
@@ -356,10 +361,12 @@ static char *make_time(int mode, time_t time)
 				buf, sizeof(buf));
 		break;
 	case TIME_ISO:
-		rc = strtime_iso(&time, ISO_TIMESTAMP_T, buf, sizeof(buf));
+		rc = strtime_iso_cached(&tmcache, &time, ISO_TIMESTAMP_T,
+					buf, sizeof(buf));
 		break;
 	case TIME_ISO_SHORT:
-		rc = strtime_iso(&time, ISO_DATE, buf, sizeof(buf));
+		rc = strtime_iso_cached(&tmcache, &time, ISO_DATE,
+					buf, sizeof(buf));
 		break;
 	default:
 		errx(EXIT_FAILURE, _("unsupported time type"));
@@ -432,21 +439,55 @@ again:
 	return res;
 }
 
-static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+static void free_nothing(void *p __attribute__((__unused__)))
 {
-	size_t n = 0;
+}
 
-	if (!username)
+static int cmp_utmpx_user(const void *a, const void *b)
+{
+	return strncmp(((const struct utmpx *) a)->ut_user,
+		       ((const struct utmpx *) b)->ut_user,
+		       sizeof(((struct utmpx *) 0)->ut_user));
+}
+
+/*
+ * Creates username -> the last record index, the later records overwrite the
+ * previous ones in the tree.
+ */
+static void *index_utmpx(struct utmpx *records, size_t nrecords)
+{
+	void *tree = NULL;
+	size_t i;
+
+	for (i = 0; i < nrecords; i++) {
+		struct utmpx **node = tsearch(&records[i], &tree, cmp_utmpx_user);
+
+		if (!node)
+			err_oom();
+		*node = &records[i];
+	}
+	return tree;
+}
+
+static struct utmpx *get_last_utmpx(void *tree, const char *username)
+{
+	struct utmpx key, **node;
+	size_t len;
+
+	if (!username || !tree)
 		return NULL;
 
-	n = ctl->wtmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->wtmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->wtmp + n;
-	} while (n--);
-	return NULL;
+	len = strlen(username);
+	memset(key.ut_user, 0, sizeof(key.ut_user));
+	memcpy(key.ut_user, username, min(len, sizeof(key.ut_user)));
+
+	node = tfind(&key, &tree, cmp_utmpx_user);
+	return node ? *node : NULL;
+}
 
+static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+{
+	return get_last_utmpx(ctl->wtmp_index, username);
 }
 
 static int require_wtmp(void)
@@ -467,21 +508,18 @@ static int require_btmp(void)
 	return 0;
 }
 
-static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
+static int require_nprocs(void)
 {
-	size_t n = 0;
-
-	if (!username)
-		return NULL;
-
-	n = ctl->btmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->btmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->btmp + n;
-	}while (n--);
-	return NULL;
+	size_t i;
+	for (i = 0; i < ncolumns; i++)
+		if (columns[i] == COL_NPROCS)
+			return 1;
+	return 0;
+}
 
+static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
+{
+	return get_last_utmpx(ctl->btmp_index, username);
 }
 
 static int parse_utmpx(const char *path, size_t *nrecords, struct utmpx **records)
@@ -653,23 +691,56 @@ static int get_sgroups(gid_t **list, size_t *len, struct passwd *pwd)
 }
 
 #ifdef __linux__
-static int get_nprocs(const uid_t uid)
+struct uid_nprocs {
+	uid_t	uid;
+	int	nprocs;
+};
+
+static int cmp_nprocs_uid(const void *a, const void *b)
+{
+	uid_t x = ((const struct uid_nprocs *)a)->uid;
+	uid_t z = ((const struct uid_nprocs *)b)->uid;
+	return x > z ? 1 : (x < z ? -1 : 0);
+}
+
+/* counts processes for all UIDs by one /proc scan */
+static void *index_nprocs(void)
 {
 	DIR *dir;
 	struct dirent *d;
-	int nprocs = 0;
+	void *tree = NULL;
 
 	dir = opendir(_PATH_PROC);
 	if (!dir)
-		return 0;
+		return NULL;
 
 	while ((d = xreaddir(dir))) {
-		if (procfs_dirent_match_uid(dir, d, uid))
-			++nprocs;
+		struct uid_nprocs *x, **node;
+		uid_t uid;
+
+		if (procfs_dirent_get_uid(dir, d, &uid) != 0)
+			continue;
+
+		x = xcalloc(1, sizeof(*x));
+		x->uid = uid;
+		node = tsearch(x, &tree, cmp_nprocs_uid);
+		if (!node)
+			err_oom();
+		if (*node != x)
+			free(x);
+		(*node)->nprocs++;
 	}
 
 	closedir(dir);
-	return nprocs;
+	return tree;
+}
+
+static int get_nprocs(struct lslogins_control *ctl, const uid_t uid)
+{
+	struct uid_nprocs key = { .uid = uid }, **node;
+
+	node = tfind(&key, &ctl->nprocs_index, cmp_nprocs_uid);
+	return node ? (*node)->nprocs : 0;
 }
 #endif
 
@@ -1003,7 +1074,7 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 		case COL_NPROCS:
 #ifdef __linux__
 
-			xasprintf(&user->nprocs, "%d", get_nprocs(pwd->pw_uid));
+			xasprintf(&user->nprocs, "%d", get_nprocs(ctl, pwd->pw_uid));
 #endif
 			break;
 		default:
@@ -1103,6 +1174,14 @@ static void free_ctl(struct lslogins_control *ctl)
 	if (!ctl)
 		return;
 
+	if (ctl->wtmp_index)
+		tdestroy(ctl->wtmp_index, free_nothing);
+	if (ctl->btmp_index)
+		tdestroy(ctl->btmp_index, free_nothing);
+#ifdef __linux__
+	if (ctl->nprocs_index)
+		tdestroy(ctl->nprocs_index, free);
+#endif
 	free(ctl->wtmp);
 	free(ctl->btmp);
 
@@ -1801,10 +1880,17 @@ int main(int argc, char *argv[])
 
 	if (require_wtmp()) {
 		parse_utmpx(path_wtmp, &ctl->wtmp_size, &ctl->wtmp);
+		ctl->wtmp_index = index_utmpx(ctl->wtmp, ctl->wtmp_size);
 		ctl->lastlogin_fd = open(path_lastlog, O_RDONLY, 0);
 	}
-	if (require_btmp())
+	if (require_btmp()) {
 		parse_utmpx(path_btmp, &ctl->btmp_size, &ctl->btmp);
+		ctl->btmp_index = index_utmpx(ctl->btmp, ctl->btmp_size);
+	}
+#ifdef __linux__
+	if (require_nprocs())
+		ctl->nprocs_index = index_nprocs();
+#endif
 
 	if (logins || groups)
 		get_ulist(ctl, logins, groups);
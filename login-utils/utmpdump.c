@@ -45,6 +45,26 @@
 #include "xalloc.h"
 #include "closestream.h"
 #include "timeutils.h"
+#include "optutils.h"
+
+#define UTMPDUMP_NRECS		256		/* records read at once */
+#define UTMPDUMP_BUFSZ		(64 * 1024)	/* output buffer size */
+#define UTMPDUMP_LINESZ		2048		/* max size of one output line */
+
+struct dump_control {
+	FILE *out;
+	char *buf;		/* output buffer */
+	size_t len;		/* data in @buf */
+	struct utmpx *recs;	/* input buffer */
+
+	time_t time_sec;	/* the last formatted time */
+	char time_str[40];	/* ISO time for @time_sec */
+	size_t time_hms;	/* offset of the hours in @time_str */
+	size_t time_usec;	/* offset of the microseconds in @time_str */
+
+	unsigned int json :1,	 /* JSON lines output */
+		     time_ok :1; /* @time_str is valid */
+};
 
 static time_t strtotime(const char *s_time)
 {
@@ -95,47 +115,225 @@ static void xcleanse(char *s, int len)
 			*s = '?';
 }
 
-static void print_utline(struct utmpx *ut, FILE *out)
+static void flush_output(struct dump_control *ctl)
+{
+	if (ctl->len) {
+		ignore_result( fwrite(ctl->buf, 1, ctl->len, ctl->out) );
+		ctl->len = 0;
+	}
+}
+
+/* the same as "%-<width>.<maxsz>s" */
+static char *put_str(char *p, const char *s, size_t maxsz, size_t width)
+{
+	size_t n = strnlen(s, maxsz);
+
+	memcpy(p, s, n);
+	p += n;
+	for (; n < width; n++)
+		*p++ = ' ';
+	return p;
+}
+
+/* the same as "%0<width>lld" */
+static char *put_num(char *p, long long num, int width)
+{
+	char tmp[sizeof(num) * 3];
+	unsigned long long x = num < 0 ? -(unsigned long long) num : (unsigned long long) num;
+	int n = 0, i;
+
+	do {
+		tmp[n++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+
+	if (num < 0)
+		*p++ = '-';
+	for (i = n + (num < 0); i < width; i++)
+		*p++ = '0';
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+/* JSON "name":"string", non-printable chars are replaced by '?' */
+static char *put_json_str(char *p, const char *name, const char *s, size_t maxsz)
+{
+	size_t i;
+
+	*p++ = '"';
+	p = stpcpy(p, name);
+	p = stpcpy(p, "\":\"");
+
+	for (i = 0; i < maxsz && s[i]; i++) {
+		unsigned char c = s[i];
+
+		if (c == '"' || c == '\\')
+			*p++ = '\\';
+		*p++ = isprint(c) ? c : '?';
+	}
+	*p++ = '"';
+	return p;
+}
+
+static void put_2digits(char *p, int num)
+{
+	p[0] = '0' + num / 10;
+	p[1] = '0' + num % 10;
+}
+
+/*
+ * Returns ISO time string. The time is in UTC, so the string is cached for
+ * the same day and only the time of the day and the microseconds are
+ * updated.
+ */
+static const char *get_time_string(struct dump_control *ctl, struct utmpx *ut)
 {
-	const char *addr_string;
-	char buffer[INET6_ADDRSTRLEN];
-	char time_string[40];
 	struct timeval tv;
+	int32_t usec = ut->ut_tv.tv_usec < (int32_t) USEC_PER_SEC ? ut->ut_tv.tv_usec : 0;
+	char *p;
+	int i;
+
+	tv.tv_sec = ut->ut_tv.tv_sec;
+	tv.tv_usec = usec;
+
+	if (usec < 0 || tv.tv_sec < 0) {
+		/* broken record, don't use cache */
+		ctl->time_ok = 0;
+		if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, ctl->time_str,
+				   sizeof(ctl->time_str)) != 0)
+			return NULL;
+		return ctl->time_str;
+	}
+
+	if (!ctl->time_ok || ctl->time_sec / 86400 != tv.tv_sec / 86400) {
+		tv.tv_usec = 0;
+		if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, ctl->time_str,
+				   sizeof(ctl->time_str)) != 0)
+			return NULL;
+		p = strchr(ctl->time_str, 'T');
+		if (!p)
+			return NULL;
+		ctl->time_hms = p + 1 - ctl->time_str;
+		p = strchr(p, ',');
+		if (!p)
+			return NULL;
+		ctl->time_usec = p + 1 - ctl->time_str;
+		ctl->time_ok = 1;
+
+	} else if (ctl->time_sec != tv.tv_sec) {
+		/* "HH:MM:SS" */
+		int sec = tv.tv_sec % 86400;
+
+		p = ctl->time_str + ctl->time_hms;
+		put_2digits(p, sec / 3600);
+		put_2digits(p + 3, (sec / 60) % 60);
+		put_2digits(p + 6, sec % 60);
+	}
+	ctl->time_sec = tv.tv_sec;
+
+	/* ",%06d" */
+	p = ctl->time_str + ctl->time_usec;
+	for (i = 5; i >= 0; i--) {
+		p[i] = '0' + usec % 10;
+		usec /= 10;
+	}
+	return ctl->time_str;
+}
+
+static void print_utline(struct dump_control *ctl, struct utmpx *ut)
+{
+	const char *addr_string, *time_string;
+	char buffer[INET6_ADDRSTRLEN];
+	char *p;
 
 	if (ut->ut_addr_v6[1] || ut->ut_addr_v6[2] || ut->ut_addr_v6[3])
 		addr_string = inet_ntop(AF_INET6, &(ut->ut_addr_v6), buffer, sizeof(buffer));
 	else
 		addr_string = inet_ntop(AF_INET, &(ut->ut_addr_v6), buffer, sizeof(buffer));
+	if (!addr_string)
+		addr_string = "";
 
-	tv.tv_sec = ut->ut_tv.tv_sec;
-	tv.tv_usec = ut->ut_tv.tv_usec < (int32_t) USEC_PER_SEC ? ut->ut_tv.tv_usec : 0;
+	time_string = get_time_string(ctl, ut);
+	if (!time_string)
+		return;
 
-	if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, time_string,
-			   sizeof(time_string)) != 0)
+	if (ctl->len + UTMPDUMP_LINESZ > UTMPDUMP_BUFSZ)
+		flush_output(ctl);
+	p = ctl->buf + ctl->len;
+
+	if (ctl->json) {
+		p = stpcpy(p, "{\"type\":");
+		p = put_num(p, ut->ut_type, 0);
+		p = stpcpy(p, ",\"pid\":");
+		p = put_num(p, ut->ut_pid, 0);
+		*p++ = ',';
+		p = put_json_str(p, "id", ut->ut_id, sizeof(ut->ut_id));
+		*p++ = ',';
+		p = put_json_str(p, "user", ut->ut_user, sizeof(ut->ut_user));
+		*p++ = ',';
+		p = put_json_str(p, "line", ut->ut_line, sizeof(ut->ut_line));
+		*p++ = ',';
+		p = put_json_str(p, "host", ut->ut_host, sizeof(ut->ut_host));
+		*p++ = ',';
+		p = put_json_str(p, "addr", addr_string, INET6_ADDRSTRLEN);
+		*p++ = ',';
+		p = put_json_str(p, "time", time_string, sizeof(ctl->time_str));
+		*p++ = '}';
+		*p++ = '\n';
+		ctl->len = p - ctl->buf;
 		return;
+	}
+
 	cleanse(ut->ut_id);
 	cleanse(ut->ut_user);
 	cleanse(ut->ut_line);
 	cleanse(ut->ut_host);
 
-	/*            type pid    id       user     line     host     addr    time */
-	fprintf(out, "[%d] [%05d] [%-4.4s] [%-*.*s] [%-*.*s] [%-*.*s] [%-15s] [%s]\n",
-	       ut->ut_type, ut->ut_pid, ut->ut_id,
-	       8, (int)sizeof(ut->ut_user), ut->ut_user,
-	       12, (int)sizeof(ut->ut_line), ut->ut_line,
-	       20, (int)sizeof(ut->ut_host), ut->ut_host,
-	       addr_string, time_string);
+	/* [type] [pid] [id] [user] [line] [host] [addr] [time] */
+	*p++ = '[';
+	p = put_num(p, ut->ut_type, 0);
+	p = stpcpy(p, "] [");
+	p = put_num(p, ut->ut_pid, 5);
+	p = stpcpy(p, "] [");
+	p = put_str(p, ut->ut_id, 4, 4);
+	p = stpcpy(p, "] [");
+	p = put_str(p, ut->ut_user, sizeof(ut->ut_user), 8);
+	p = stpcpy(p, "] [");
+	p = put_str(p, ut->ut_line, sizeof(ut->ut_line), 12);
+	p = stpcpy(p, "] [");
+	p = put_str(p, ut->ut_host, sizeof(ut->ut_host), 20);
+	p = stpcpy(p, "] [");
+	p = put_str(p, addr_string, INET6_ADDRSTRLEN, 15);
+	p = stpcpy(p, "] [");
+	p = stpcpy(p, time_string);
+	*p++ = ']';
+	*p++ = '\n';
+	ctl->len = p - ctl->buf;
+}
+
+/* dumps all complete records from the current position */
+static void dump_records(struct dump_control *ctl, FILE *in)
+{
+	size_t i, n;
+
+	do {
+		n = fread(ctl->recs, sizeof(struct utmpx), UTMPDUMP_NRECS, in);
+		for (i = 0; i < n; i++)
+			print_utline(ctl, &ctl->recs[i]);
+	} while (n == UTMPDUMP_NRECS);
+
+	flush_output(ctl);
 }
 
 #ifdef HAVE_INOTIFY_INIT
 #define EVENTS		(IN_MODIFY|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT)
 #define NEVENTS		4
 
-static void roll_file(const char *filename, off_t *size, FILE *out)
+static void roll_file(const char *filename, off_t *size, struct dump_control *ctl)
 {
 	FILE *in;
 	struct stat st;
-	struct utmpx ut;
 	off_t pos;
 
 	if (!(in = fopen(filename, "r")))
@@ -147,10 +345,8 @@ static void roll_file(const char *filename, off_t *size, FILE *out)
 	if (st.st_size == *size)
 		goto done;
 
-	if (fseek(in, *size, SEEK_SET) != (off_t) -1) {
-		while (fread(&ut, sizeof(ut), 1, in) == 1)
-			print_utline(&ut, out);
-	}
+	if (fseek(in, *size, SEEK_SET) != (off_t) -1)
+		dump_records(ctl, in);
 
 	pos = ftello(in);
 	/* If we've successfully read something, use the file position, this
@@ -163,7 +359,7 @@ done:
 	fclose(in);
 }
 
-static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
+static int follow_by_inotify(FILE *in, const char *filename, struct dump_control *ctl)
 {
 	char buf[NEVENTS * sizeof(struct inotify_event)];
 	int fd, wd, event;
@@ -199,7 +395,7 @@ static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
 				    (struct inotify_event *) &buf[event];
 
 			if (ev->mask & IN_MODIFY)
-				roll_file(filename, &size, out);
+				roll_file(filename, &size, ctl);
 			else {
 				close(wd);
 				wd = -1;
@@ -214,28 +410,24 @@ static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
 }
 #endif /* HAVE_INOTIFY_INIT */
 
-static FILE *dump(FILE *in, const char *filename, int follow, FILE *out)
+static FILE *dump(FILE *in, const char *filename, int follow, struct dump_control *ctl)
 {
-	struct utmpx ut;
-
 	if (follow)
-		ignore_result( fseek(in, -10 * sizeof(ut), SEEK_END) );
+		ignore_result( fseek(in, -10 * sizeof(struct utmpx), SEEK_END) );
 
-	while (fread(&ut, sizeof(ut), 1, in) == 1)
-		print_utline(&ut, out);
+	dump_records(ctl, in);
 
 	if (!follow)
 		return in;
 
 #ifdef HAVE_INOTIFY_INIT
-	if (follow_by_inotify(in, filename, out) == 0)
+	if (follow_by_inotify(in, filename, ctl) == 0)
 		return NULL;				/* file already closed */
 #endif
 	/* fallback for systems without inotify or with non-free
 	 * inotify instances */
 	for (;;) {
-		while (fread(&ut, sizeof(ut), 1, in) == 1)
-			print_utline(&ut, out);
+		dump_records(ctl, in);
 		sleep(1);
 	}
 
@@ -275,6 +467,8 @@ static void undump(FILE *in, FILE *out)
 {
 	struct utmpx ut;
 	char s_addr[INET6_ADDRSTRLEN + 1], s_time[29] = {}, *linestart, *line;
+	char last_time[29] = {};	/* the last ISO time without subseconds */
+	time_t last_sec = 0;
 
 	linestart = xmalloc(1024 * sizeof(*linestart));
 	s_time[28] = 0;
@@ -300,7 +494,20 @@ static void undump(FILE *in, FILE *out)
 		else
 			inet_pton(AF_INET6, s_addr, &(ut.ut_addr_v6));
 
-		ut.ut_tv.tv_sec = strtotime(s_time);
+		/* strptime() and timegm() are expensive, the records are
+		 * usually from the same second */
+		if (isdigit(s_time[0])) {
+			size_t sz = strcspn(s_time, ",");
+
+			if (!*last_time || strncmp(s_time, last_time, sz) != 0
+			    || last_time[sz] != '\0') {
+				last_sec = strtotime(s_time);
+				memcpy(last_time, s_time, sz);
+				last_time[sz] = '\0';
+			}
+			ut.ut_tv.tv_sec = last_sec;
+		} else
+			ut.ut_tv.tv_sec = strtotime(s_time);
 		ut.ut_tv.tv_usec = strtousec(s_time);
 
 		ignore_result( fwrite(&ut, sizeof(ut), 1, out) );
@@ -322,6 +529,7 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -f, --follow         output appended data as the file grows\n"), out);
+	fputs(_(" -J, --json           use JSON lines output format\n"), out);
 	fputs(_(" -r, --reverse        write back dumped data into utmp file\n"), out);
 	fputs(_(" -o, --output <file>  write to file instead of standard output\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(22));
@@ -334,24 +542,33 @@ int main(int argc, char **argv)
 {
 	int c;
 	FILE *in = NULL, *out = NULL;
-	int reverse = 0, follow = 0;
+	int reverse = 0, follow = 0, json = 0;
 	const char *filename = NULL;
 
 	static const struct option longopts[] = {
 		{ "follow",  no_argument,       NULL, 'f' },
+		{ "json",    no_argument,       NULL, 'J' },
 		{ "reverse", no_argument,       NULL, 'r' },
 		{ "output",  required_argument, NULL, 'o' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'J', 'r' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "fro:hV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "fJro:hV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'r':
 			reverse = 1;
@@ -361,6 +578,10 @@ int main(int argc, char **argv)
 			follow = 1;
 			break;
 
+		case 'J':
+			json = 1;
+			break;
+
 		case 'o':
 			out = fopen(optarg, "w");
 			if (!out)
@@ -400,8 +621,19 @@ int main(int argc, char **argv)
 		fprintf(stderr, _("Utmp undump of %s\n"), filename);
 		undump(in, out);
 	} else {
+		struct dump_control ctl = {
+			.out = out,
+			.json = json ? 1 : 0
+		};
+
+		ctl.buf = xmalloc(UTMPDUMP_BUFSZ);
+		ctl.recs = xmalloc(UTMPDUMP_NRECS * sizeof(struct utmpx));
+
 		fprintf(stderr, _("Utmp dump of %s\n"), filename);
-		in = dump(in, filename, follow, out);
+		in = dump(in, filename, follow, &ctl);
+
+		free(ctl.buf);
+		free(ctl.recs);
 	}
 
 	if (out != stdout && close_stream(out))
@@ -53,7 +53,9 @@ struct blkid_control {
 	uintmax_t offset;
 	uintmax_t size;
 	char *show[128];
+	size_t nresults;	/* number of printed results (for --batch) */
 	unsigned int
+		batch:1,
 		eval:1,
 		gc:1,
 		lookup:1,
@@ -61,7 +63,8 @@ struct blkid_control {
 		lowprobe_superblocks:1,
 		lowprobe_topology:1,
 		no_part_details:1,
-		raw_chars:1;
+		raw_chars:1,
+		stats:1;
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -88,6 +91,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(	" -l, --list-one             look up only first device with token specified by -t\n"), out);
 	fputs(_(	" -L, --label <label>        convert LABEL to device name\n"), out);
 	fputs(_(	" -U, --uuid <uuid>          convert UUID to device name\n"), out);
+	fputs(_(	"     --batch                read devices or NAME=value pairs from stdin\n"), out);
 	fputs(          "\n", out);
 	fputs(_(	"Low-level probing options:\n"), out);
 	fputs(_(	" -p, --probe                low-level superblocks probing (bypass cache)\n"), out);
@@ -98,6 +102,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(	" -u, --usages <list>        filter by \"usage\" (e.g. -u filesystem,raid)\n"), out);
 	fputs(_(	" -n, --match-types <list>   filter by filesystem type (e.g. -n vfat,ext3)\n"), out);
 	fputs(_(	" -D, --no-part-details      don't print info from partition table\n"), out);
+	fputs(_(	"     --stats                print probing statistics to stderr\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(28));
@@ -314,10 +319,12 @@ static int has_item(const struct blkid_control *ctl, const char *item)
 	return 0;
 }
 
-static void print_value(const struct blkid_control *ctl, int num,
+static void print_value(struct blkid_control *ctl, int num,
 			const char *devname, const char *value,
 			const char *name, size_t valsz)
 {
+	ctl->nresults++;
+
 	if (ctl->output & OUTPUT_VALUE_ONLY) {
 		fputs(value, stdout);
 		fputc('\n', stdout);
@@ -344,7 +351,7 @@ static void print_value(const struct blkid_control *ctl, int num,
 	}
 }
 
-static void print_tags(const struct blkid_control *ctl, blkid_dev dev)
+static void print_tags(struct blkid_control *ctl, blkid_dev dev)
 {
 	blkid_tag_iterate	iter;
 	const char		*type, *value, *devname;
@@ -363,6 +370,7 @@ static void print_tags(const struct blkid_control *ctl, blkid_dev dev)
 
 	if (ctl->output & OUTPUT_DEVICE_ONLY) {
 		printf("%s\n", devname);
+		ctl->nresults++;
 		return;
 	}
 
@@ -502,6 +510,24 @@ static int lowprobe_topology(blkid_probe pr)
 	return blkid_do_fullprobe(pr);
 }
 
+static void print_stats(blkid_probe pr, const char *devname)
+{
+	const char *chain, *name;
+	uint64_t usec, nreads, nbytes, nhits, npruned;
+	size_t i = 0;
+
+	while (blkid_probe_get_stats(pr, i++, &chain, &name, &usec, &nreads,
+				     &nbytes, &nhits, &npruned) == 0) {
+		fprintf(stderr, "%s: chain=%s", devname, chain ? chain : "total");
+		if (name)
+			fprintf(stderr, " prober=%s", name);
+		fprintf(stderr, " usec=%ju reads=%ju bytes=%ju cached=%ju pruned=%ju\n",
+				(uintmax_t) usec, (uintmax_t) nreads,
+				(uintmax_t) nbytes, (uintmax_t) nhits,
+				(uintmax_t) npruned);
+	}
+}
+
 static int lowprobe_device(blkid_probe pr, const char *devname,
 			   struct blkid_control *ctl)
 {
@@ -525,10 +551,21 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 		goto done;
 	}
 
-	if (ctl->lowprobe_topology)
+	if (ctl->stats && blkid_probe_enable_stats(pr, 1) != 0)
+		warnx(_("failed to enable probing statistics"));
+
+	if (ctl->lowprobe_topology && ctl->lowprobe_superblocks) {
+		/* read superblocks while topology is gathered from sysfs */
+		blkid_probe_enable_topology(pr, 1);
+		blkid_probe_set_topology_flags(pr, BLKID_TOPOLOGY_PARALLEL);
+		rc = lowprobe_superblocks(pr, ctl);
+	} else if (ctl->lowprobe_topology)
 		rc = lowprobe_topology(pr);
-	if (rc >= 0 && ctl->lowprobe_superblocks)
+	else if (ctl->lowprobe_superblocks)
 		rc = lowprobe_superblocks(pr, ctl);
+
+	if (ctl->stats)
+		print_stats(pr, devname);
 	if (rc < 0)
 		goto done;
 
@@ -541,6 +578,7 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 
 	if (nvals && (ctl->output & OUTPUT_DEVICE_ONLY)) {
 		printf("%s\n", devname);
+		ctl->nresults++;
 		goto done;
 	}
 
@@ -662,6 +700,83 @@ static void free_types_list(char *list[])
 	free(list);
 }
 
+/* returns 1 if @dev is a block device, regular file or UBI volume */
+static int is_supported_device(const char *dev)
+{
+	struct stat sb;
+
+	if (stat(dev, &sb) != 0)
+		return 0;
+	if (S_ISBLK(sb.st_mode) || S_ISREG(sb.st_mode))
+		return 1;
+	if (S_ISCHR(sb.st_mode)) {
+		char buf[PATH_MAX];
+
+		if (!sysfs_chrdev_devno_to_devname(sb.st_rdev, buf, sizeof(buf)))
+			return 0;
+		return strncmp(buf, "ubi", 3) == 0;
+	}
+	return 0;
+}
+
+/*
+ * Reads queries (device names or NAME=value pairs) from stdin and prints the
+ * result for each of them. The same cache and probe are used for all
+ * queries. An empty line is printed if nothing has been found, so the output
+ * of a query is never missing.
+ */
+static int process_batch(struct blkid_control *ctl, blkid_cache *cache,
+			 blkid_probe pr, const char *search_type,
+			 const char *search_value)
+{
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = BLKID_EXIT_NOTFOUND;
+
+	while ((len = getline(&line, &sz, stdin)) >= 0) {
+		char *t = NULL, *v = NULL;
+
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+
+		ctl->nresults = 0;
+
+		if (*line != '/' && blkid_parse_tag_string(line, &t, &v) == 0
+		    && t && v) {
+			char *res = blkid_evaluate_tag(t, v, cache);
+
+			if (res) {
+				printf("%s\n", res);
+				ctl->nresults++;
+			}
+			free(res);
+
+		} else if (*line && is_supported_device(line)) {
+			if (pr)
+				lowprobe_device(pr, line, ctl);
+			else {
+				blkid_dev dev = blkid_get_dev(*cache, line,
+							BLKID_DEV_NORMAL);
+				if (dev && (!search_type ||
+				    blkid_dev_has_tag(dev, search_type, search_value)))
+					print_tags(ctl, dev);
+			}
+		}
+		free(t);
+		free(v);
+
+		if (ctl->nresults)
+			rc = 0;
+		else
+			fputc('\n', stdout);
+		fflush(stdout);
+	}
+
+	free(line);
+	return rc;
+}
+
 int main(int argc, char **argv)
 {
 	struct blkid_control ctl = { .output = OUTPUT_FULL, 0 };
@@ -677,7 +792,12 @@ int main(int argc, char **argv)
 	unsigned int i;
 	int c;
 
+	enum {
+		OPT_STATS = CHAR_MAX + 1,
+		OPT_BATCH
+	};
 	static const struct option longopts[] = {
+		{ "batch",	      no_argument,	 NULL, OPT_BATCH },
 		{ "cache-file",	      required_argument, NULL, 'c' },
 		{ "no-encoding",      no_argument,	 NULL, 'd' },
 		{ "no-part-details",  no_argument,       NULL, 'D' },
@@ -696,6 +816,7 @@ int main(int argc, char **argv)
 		{ "offset",	      required_argument, NULL, 'O' },
 		{ "usages",	      required_argument, NULL, 'u' },
 		{ "match-types",      required_argument, NULL, 'n' },
+		{ "stats",	      no_argument,	 NULL, OPT_STATS },
 		{ "version",	      no_argument,	 NULL, 'V' },
 		{ "help",	      no_argument,       NULL, 'h' },
 		{ NULL, 0, NULL, 0 }
@@ -821,6 +942,12 @@ int main(int argc, char **argv)
 		case 'w':
 			/* ignore - backward compatibility */
 			break;
+		case OPT_STATS:
+			ctl.stats = 1;
+			break;
+		case OPT_BATCH:
+			ctl.batch = 1;
+			break;
 		case 'h':
 			usage();
 			break;
@@ -834,29 +961,16 @@ int main(int argc, char **argv)
 
 	/* The rest of the args are device names */
 	if (optind < argc) {
+		if (ctl.batch)
+			errx(BLKID_EXIT_OTHER, _("devices cannot be specified "
+						 "on the command line with --batch"));
+
 		devices = xcalloc(argc - optind, sizeof(char *));
 		while (optind < argc) {
 			char *dev = argv[optind++];
-			struct stat sb;
-
-			if (stat(dev, &sb) != 0)
-				continue;
-			else if (S_ISBLK(sb.st_mode))
-				;
-			else if (S_ISREG(sb.st_mode))
-				;
-			else if (S_ISCHR(sb.st_mode)) {
-				char buf[PATH_MAX];
-
-				if (!sysfs_chrdev_devno_to_devname(
-						sb.st_rdev, buf, sizeof(buf)))
-					continue;
-				if (strncmp(buf, "ubi", 3) != 0)
-					continue;
-			} else
-				continue;
 
-			devices[numdev++] = dev;
+			if (is_supported_device(dev))
+				devices[numdev++] = dev;
 		}
 
 		if (!numdev) {
@@ -873,6 +987,12 @@ int main(int argc, char **argv)
 		ctl.lookup = 0;
 	}
 
+	if (ctl.batch && (ctl.eval || ctl.lookup || ctl.gc ||
+			  (ctl.output & OUTPUT_PRETTY_LIST)))
+		errx(BLKID_EXIT_OTHER, _("--batch cannot be used with "
+					 "--label, --uuid, --list-one, "
+					 "--garbage-collect or list output"));
+
 	if (!ctl.lowprobe && !ctl.eval && blkid_get_cache(&cache, read) < 0)
 		goto exit;
 
@@ -897,7 +1017,7 @@ int main(int argc, char **argv)
 		 */
 		blkid_probe pr;
 
-		if (!numdev)
+		if (!numdev && !ctl.batch)
 			errx(BLKID_EXIT_OTHER,
 			     _("The low-level probing mode "
 			       "requires a device"));
@@ -930,12 +1050,19 @@ int main(int argc, char **argv)
 				goto exit;
 		}
 
-		for (i = 0; i < numdev; i++) {
+		if (ctl.batch)
+			err = process_batch(&ctl, &cache, pr, NULL, NULL);
+		else for (i = 0; i < numdev; i++) {
 			err = lowprobe_device(pr, devices[i], &ctl);
 			if (err)
 				break;
 		}
 		blkid_free_probe(pr);
+	} else if (ctl.batch) {
+		/*
+		 * Read queries from stdin
+		 */
+		err = process_batch(&ctl, &cache, NULL, search_type, search_value);
 	} else if (ctl.eval) {
 		/*
 		 * Evaluate API
@@ -1000,8 +1127,7 @@ exit:
 	free(search_type);
 	free(search_value);
 	free_types_list(fltr_type);
-	if (!ctl.lowprobe && !ctl.eval)
-		blkid_put_cache(cache);
+	blkid_put_cache(cache);
 	free(devices);
 	return err;
 }
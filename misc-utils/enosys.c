@@ -151,6 +151,158 @@ static struct blocked_number *parse_block(const char *s, int ret, const struct s
 	return blocked;
 }
 
+/* sorted and deduplicated copy of the blocked_number list */
+struct filter_entry {
+	uint64_t number;
+	int ret;		/* errno, or FILTER_IOCTL */
+	size_t seq;		/* position in the list, lower is newer */
+};
+
+#define FILTER_IOCTL		-1
+
+/* max. number of JEQ in the leaves of the search tree */
+#define FILTER_LEAF_MAX		4
+
+struct filter {
+	struct sock_filter insns[BPF_MAXINSNS];
+	size_t len;
+};
+
+static size_t add_instr(struct filter *flt, struct sock_filter instr)
+{
+	if (flt->len == ARRAY_SIZE(flt->insns))
+		errx(EXIT_FAILURE, _("filter too big"));
+	flt->insns[flt->len] = instr;
+	return flt->len++;
+}
+
+#define INSTR(_instruction) add_instr(flt, (struct sock_filter) _instruction)
+
+static int cmp_filter_entries(const void *a, const void *b)
+{
+	const struct filter_entry *x = a, *y = b;
+
+	if (x->number != y->number)
+		return x->number < y->number ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/*
+ * Returns the blocked numbers (masked by @mask) sorted in ascending order. The
+ * list is in reverse command line order, so for duplicates the last option
+ * given on the command line wins, as it did with the linear filter.
+ */
+static struct filter_entry *sort_blocked(struct list_head *list, uint64_t mask,
+					 size_t *nents)
+{
+	struct filter_entry *ents;
+	struct list_head *p;
+	size_t n = 0, i, k;
+
+	list_for_each(p, list)
+		n++;
+	/* one spare entry for ioctl(), see main() */
+	ents = xcalloc(n + 1, sizeof(*ents));
+
+	i = 0;
+	list_for_each(p, list) {
+		struct blocked_number *b = list_entry(p, struct blocked_number, head);
+
+		ents[i].number = (uint64_t) b->number & mask;
+		ents[i].ret = b->ret;
+		ents[i].seq = i;
+		i++;
+	}
+
+	qsort(ents, n, sizeof(*ents), cmp_filter_entries);
+
+	for (i = 0, k = 0; i < n; i++) {
+		if (k && ents[k - 1].number == ents[i].number)
+			continue;
+		ents[k++] = ents[i];
+	}
+	*nents = k;
+	return ents;
+}
+
+/* number of instructions generated by emit_tree() for @n entries */
+static size_t tree_size(size_t n)
+{
+	size_t left;
+
+	if (n <= FILTER_LEAF_MAX)
+		return n * 2 + 1;
+
+	left = tree_size(n / 2);
+	return (left > UINT8_MAX ? 2 : 1) + left + tree_size(n - n / 2);
+}
+
+/*
+ * Binary search over the lower 32 bits of the sorted @ents for the value in
+ * the accumulator. The tree is balanced, the conditional jumps only have an
+ * 8-bit offset, so long skips go through BPF_JA. Not found returns ALLOW,
+ * FILTER_IOCTL entries jump to the instruction @ioctl_pos.
+ */
+static void emit_tree(struct filter *flt, const struct filter_entry *ents,
+		      size_t n, size_t ioctl_pos)
+{
+	size_t i, half, left;
+
+	if (n <= FILTER_LEAF_MAX) {
+		for (i = 0; i < n; i++) {
+			INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t) ents[i].number, 0, 1));
+			if (ents[i].ret == FILTER_IOCTL)
+				INSTR(BPF_JUMP(BPF_JMP | BPF_JA, ioctl_pos - flt->len - 1, 0, 0));
+			else
+				INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ents[i].ret));
+		}
+		INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+		return;
+	}
+
+	half = n / 2;
+	left = tree_size(half);
+
+	if (left > UINT8_MAX) {
+		INSTR(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, (uint32_t) ents[half].number, 0, 1));
+		INSTR(BPF_JUMP(BPF_JMP | BPF_JA, left, 0, 0));
+	} else
+		INSTR(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, (uint32_t) ents[half].number, left, 0));
+
+	emit_tree(flt, ents, half, ioctl_pos);
+	emit_tree(flt, ents + half, n - half, ioctl_pos);
+}
+
+/*
+ * The ioctl numbers are grouped by the upper 32 bits of the request (usually
+ * all zero), every group is a binary search over the lower 32 bits.
+ */
+static void emit_ioctls(struct filter *flt, const struct filter_entry *ents, size_t n)
+{
+	size_t i = 0;
+
+	while (i < n) {
+		uint32_t upper = ents[i].number >> 32;
+		size_t k = i, skip;
+
+		while (k < n && (uint32_t) (ents[k].number >> 32) == upper)
+			k++;
+		skip = 1 + tree_size(k - i);
+
+		INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_arg_upper32(1)));
+		if (skip > UINT8_MAX) {
+			INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, upper, 1, 0));
+			INSTR(BPF_JUMP(BPF_JMP | BPF_JA, skip, 0, 0));
+		} else
+			INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, upper, 0, skip));
+
+		INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_arg_lower32(1)));
+		emit_tree(flt, ents + i, k - i, 0);
+		i = k;
+	}
+	INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+}
+
 int main(int argc, char **argv)
 {
 	int c;
@@ -168,7 +320,6 @@ int main(int argc, char **argv)
 	};
 
 	struct blocked_number *blocked;
-	struct list_head *loop_ctr;
 	struct list_head blocked_syscalls;
 	bool blocking_execve = false;
 	INIT_LIST_HEAD(&blocked_syscalls);
@@ -216,13 +367,28 @@ int main(int argc, char **argv)
 	if (!dump && optind >= argc)
 		errtryhelp(EXIT_FAILURE);
 
-	struct sock_filter filter[BPF_MAXINSNS];
-	struct sock_filter *f = filter;
+	struct filter filter = { .len = 0 }, *flt = &filter;
+	struct filter_entry *sc_ents, *io_ents;
+	size_t n_sc = 0, n_io = 0;
 
-#define INSTR(_instruction)                                        \
-	if (f == &filter[ARRAY_SIZE(filter)])                      \
-		errx(EXIT_FAILURE, _("filter too big")); \
-	*f++ = (struct sock_filter) _instruction
+	sc_ents = sort_blocked(&blocked_syscalls, UINT32_MAX, &n_sc);
+	io_ents = sort_blocked(&blocked_ioctls, UINT64_MAX, &n_io);
+
+	/* ioctl() itself is a part of the search tree, blocking the
+	 * whole syscall takes precedence over the single requests */
+	if (n_io) {
+		for (i = 0; i < n_sc; i++) {
+			if (sc_ents[i].number == __NR_ioctl)
+				break;
+		}
+		if (i == n_sc) {
+			sc_ents[n_sc].number = __NR_ioctl;
+			sc_ents[n_sc].ret = FILTER_IOCTL;
+			n_sc++;
+			qsort(sc_ents, n_sc, sizeof(*sc_ents), cmp_filter_entries);
+		} else
+			n_io = 0;
+	}
 
 	INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_arch));
 	INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SECCOMP_ARCH_NATIVE, 1, 0));
@@ -245,40 +411,23 @@ int main(int argc, char **argv)
 	}
 
 	INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_nr));
+	emit_tree(flt, sc_ents, n_sc, flt->len + tree_size(n_sc));
 
-	list_for_each(loop_ctr, &blocked_syscalls) {
-		blocked = list_entry(loop_ctr, struct blocked_number, head);
-
-		INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, blocked->number, 0, 1));
-		INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | blocked->ret));
-	}
-
-	if (!list_empty(&blocked_ioctls)) {
-		INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_ioctl, 1, 0));
-		INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
-
-		list_for_each(loop_ctr, &blocked_ioctls) {
-			blocked = list_entry(loop_ctr, struct blocked_number, head);
+	if (n_io)
+		emit_ioctls(flt, io_ents, n_io);
 
-			INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_arg_lower32(1)));
-			INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint64_t) blocked->number, 0, 3));
-			INSTR(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_arg_upper32(1)));
-			INSTR(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint64_t) blocked->number >> 32, 0, 1));
-			INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | blocked->ret));
-		}
-	}
-
-	INSTR(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+	free(sc_ents);
+	free(io_ents);
 
 	if (dump) {
-		if (write_all(STDOUT_FILENO, filter, (f - filter) * sizeof(filter[0])))
+		if (write_all(STDOUT_FILENO, filter.insns, filter.len * sizeof(filter.insns[0])))
 			err(EXIT_FAILURE, _("Could not dump seccomp filter"));
 		return EXIT_SUCCESS;
 	}
 
 	struct sock_fprog prog = {
-		.len    = f - filter,
-		.filter = filter,
+		.len    = filter.len,
+		.filter = filter.insns,
 	};
 
 	/* *SET* below will return EINVAL when either the filter is invalid or
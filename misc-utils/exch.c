@@ -13,9 +13,13 @@
  */
 #include "c.h"
 #include "nls.h"
+#include "xalloc.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <search.h>
+#include <string.h>
 
 #ifndef HAVE_RENAMEAT2
 # include <sys/syscall.h>
@@ -40,10 +44,13 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_HEADER, out);
 	fprintf(out, _(" %s [options] oldpath newpath\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] --batch\n"), program_invocation_short_name);
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Atomically exchanges paths between two files.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
+	fputs(_(" -b, --batch                  read pairs of paths from standard input\n"), out);
+	fputs(_(" -z, --zero                   paths are separated by NUL, not newline\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(30));
 
 	fprintf(out, USAGE_MAN_TAIL("exch(1)"));
@@ -51,12 +58,168 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
+/* a parent directory opened by --batch */
+struct exch_dir {
+	char	*path;
+	int	fd;
+	int	errsv;		/* errno if the directory cannot be opened */
+};
+
+static void *dirs_root;
+
+static int cmp_dirs(const void *a, const void *b)
+{
+	return strcmp(((const struct exch_dir *) a)->path,
+		      ((const struct exch_dir *) b)->path);
+}
+
+static void free_dir(void *data)
+{
+	struct exch_dir *dir = data;
+
+	if (dir->fd >= 0)
+		close(dir->fd);
+	free(dir->path);
+	free(dir);
+}
+
+/*
+ * Returns a file descriptor of the directory @path of length @len. Every
+ * directory is opened only once; the descriptors are dropped only when we
+ * run out of them.
+ */
+static int get_dirfd(const char *path, size_t len)
+{
+	struct exch_dir key, *dir, **node;
+
+	if (!len)
+		path = "/", len = 1;
+
+	key.path = xstrndup(path, len);
+	node = tfind(&key, &dirs_root, cmp_dirs);
+	if (node) {
+		free(key.path);
+		errno = (*node)->errsv;
+		return (*node)->fd;
+	}
+
+	dir = xmalloc(sizeof(*dir));
+	dir->path = key.path;
+	dir->fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir->fd < 0 && errno == EMFILE && dirs_root) {
+		tdestroy(dirs_root, free_dir);
+		dirs_root = NULL;
+		dir->fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	dir->errsv = dir->fd < 0 ? errno : 0;
+	if (dir->fd < 0 && errno != ENOENT && errno != ENOTDIR && errno != EACCES) {
+		/* don't remember transient errors */
+		int errsv = dir->errsv;
+
+		free_dir(dir);
+		errno = errsv;
+		return -1;
+	}
+	if (!tsearch(dir, &dirs_root, cmp_dirs))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	errno = dir->errsv;
+	return dir->fd;
+}
+
+static int exchange_at(const char *oldpath, const char *newpath)
+{
+	const char *oldbase = strrchr(oldpath, '/');
+	const char *newbase = strrchr(newpath, '/');
+	int olddir = AT_FDCWD, newdir = AT_FDCWD;
+
+	if (oldbase) {
+		olddir = get_dirfd(oldpath, oldbase - oldpath);
+		if (olddir < 0)
+			return -1;
+		oldbase++;
+	} else
+		oldbase = oldpath;
+
+	if (newbase) {
+		newdir = get_dirfd(newpath, newbase - newpath);
+		if (newdir < 0)
+			return -1;
+		newbase++;
+	} else
+		newbase = newpath;
+
+	/* "dir/" or "dir/." must not be resolved relative to the directory */
+	if (!*oldbase || !*newbase)
+		return renameat2(AT_FDCWD, oldpath, AT_FDCWD, newpath, RENAME_EXCHANGE);
+
+	return renameat2(olddir, oldbase, newdir, newbase, RENAME_EXCHANGE);
+}
+
+/*
+ * Reads pairs of paths from standard input, every path terminated by
+ * @delim, and exchanges them. Every pair is independent of the others;
+ * failures are reported with the number of the pair and do not stop
+ * the processing.
+ */
+static int exchange_batch(int delim)
+{
+	char *buf = NULL, *oldpath = NULL;
+	size_t bufsz = 0, npairs = 0, nfailed = 0;
+	ssize_t len;
+
+	while ((len = getdelim(&buf, &bufsz, delim, stdin)) >= 0) {
+		if (len > 0 && buf[len - 1] == delim)
+			buf[--len] = '\0';
+		if (!oldpath) {
+			oldpath = buf;
+			buf = NULL;
+			bufsz = 0;
+			continue;
+		}
+
+		npairs++;
+		if (!*oldpath || !*buf) {
+			errno = ENOENT;
+			warn(_("pair %zu: failed to exchange \"%s\" and \"%s\""),
+			     npairs, oldpath, buf);
+			nfailed++;
+		} else if (exchange_at(oldpath, buf) != 0) {
+			warn(_("pair %zu: failed to exchange \"%s\" and \"%s\""),
+			     npairs, oldpath, buf);
+			nfailed++;
+		}
+		free(oldpath);
+		oldpath = NULL;
+	}
+	if (ferror(stdin))
+		err(EXIT_FAILURE, _("read failed"));
+	if (oldpath) {
+		warnx(_("\"%s\": missing pair"), oldpath);
+		nfailed++;
+		npairs++;
+		free(oldpath);
+	}
+	free(buf);
+
+	if (dirs_root)
+		tdestroy(dirs_root, free_dir);
+
+	if (nfailed)
+		warnx(P_("%zu of %zu exchange failed", "%zu of %zu exchanges failed", npairs),
+		      nfailed, npairs);
+
+	return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char **argv)
 {
 	int c;
 	int rc;
+	int batch = 0, delim = '\n';
 
 	static const struct option longopts[] = {
+		{ "batch",      no_argument, NULL, 'b' },
+		{ "zero",       no_argument, NULL, 'z' },
 		{ "version",    no_argument, NULL, 'V' },
 		{ "help",	no_argument, NULL, 'h' },
 		{ NULL }
@@ -66,8 +229,14 @@ int main(int argc, char **argv)
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 
-	while ((c = getopt_long(argc, argv, "Vh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bzVh", longopts, NULL)) != -1) {
 		switch (c) {
+		case 'b':
+			batch = 1;
+			break;
+		case 'z':
+			delim = '\0';
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -77,6 +246,14 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (batch) {
+		if (argc > optind) {
+			warnx(_("too many arguments"));
+			errtryhelp(EXIT_FAILURE);
+		}
+		return exchange_batch(delim);
+	}
+
 	if (argc - optind < 2) {
 		warnx(_("too few arguments"));
 		errtryhelp(EXIT_FAILURE);
@@ -23,10 +23,25 @@
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/time.h>
 
 #include "c.h"
 #include "nls.h"
 #include "strutils.h"
+#include "monotonic.h"
+
+/* With --rate, the range is advised by chunks of this size at most */
+#define FADVISE_CHUNKSZ	(8 * 1024 * 1024)
+
+struct fadvise_control {
+	off_t offset;
+	off_t len;
+	int advice;
+
+	uint64_t rate;		/* bytes per second, 0 means unlimited */
+	uint64_t done;		/* bytes advised since start */
+	struct timeval start;
+};
 
 static const struct advice {
 	const char *name;
@@ -46,13 +61,17 @@ static void __attribute__((__noreturn__)) usage(void)
 	size_t i;
 
 	fputs(USAGE_HEADER, out);
-	fprintf(out, _(" %s [options] file\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] file...\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] --files-from|-f list\n"), program_invocation_short_name);
 	fprintf(out, _(" %s [options] --fd|-d file-descriptor\n"), program_invocation_short_name);
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --advice <advice> applying advice to the file (default: \"dontneed\")\n"), out);
+	fputs(_(" -f, --files-from <list>\n"
+		"                       read file names from <list> file (or stdin), one per line\n"), out);
 	fputs(_(" -l, --length <num>    length for range operations, in bytes\n"), out);
 	fputs(_(" -o, --offset <num>    offset for range operations, in bytes\n"), out);
+	fputs(_(" -r, --rate <size>     limit the advised data to <size> per second\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(23));
@@ -68,22 +87,118 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
+/* sleep to keep ctl->done bytes per ctl->rate */
+static void throttle(struct fadvise_control *ctl)
+{
+	struct timeval now, delta;
+	uint64_t elapsed, expected;
+
+	gettime_monotonic(&now);
+	timersub(&now, &ctl->start, &delta);
+
+	elapsed = (uint64_t) delta.tv_sec * 1000000 + delta.tv_usec;
+	expected = ctl->done / ctl->rate * 1000000
+		 + ctl->done % ctl->rate * 1000000 / ctl->rate;
+
+	if (expected > elapsed)
+		xusleep(expected - elapsed);
+}
+
+static int advise_fd(struct fadvise_control *ctl, int fd)
+{
+	off_t off, end;
+
+	if (!ctl->rate)
+		return posix_fadvise(fd, ctl->offset, ctl->len, ctl->advice);
+
+	if (ctl->len)
+		end = ctl->offset + ctl->len;
+	else {
+		end = lseek(fd, 0, SEEK_END);
+		if (end < 0)
+			return errno;
+	}
+
+	for (off = ctl->offset; off < end; ) {
+		off_t sz = min(end - off, (off_t) min(ctl->rate, (uint64_t) FADVISE_CHUNKSZ));
+		int rc = posix_fadvise(fd, off, sz, ctl->advice);
+
+		if (rc)
+			return rc;
+		off += sz;
+		ctl->done += sz;
+		throttle(ctl);
+	}
+	return 0;
+}
+
+static int advise_file(struct fadvise_control *ctl, const char *name)
+{
+	int fd, rc;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		warn(_("cannot open %s"), name);
+		return -1;
+	}
+
+	rc = advise_fd(ctl, fd);
+	if (rc != 0)
+		warnx(_("failed to advise: %s: %s"), name, strerror(rc));
+
+	close(fd);
+	return rc;
+}
+
+static int advise_files_from(struct fadvise_control *ctl, const char *list)
+{
+	FILE *f = stdin;
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = 0;
+
+	if (strcmp(list, "-") != 0) {
+		f = fopen(list, "r" UL_CLOEXECSTR);
+		if (!f) {
+			warn(_("cannot open %s"), list);
+			return -1;
+		}
+	}
+
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+		if (advise_file(ctl, line) != 0)
+			rc = -1;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
+
 int main(int argc, char ** argv)
 {
 	int c;
-	int rc;
-	bool do_close = false;
+	int rc = 0;
 
 	int fd = -1;
-	off_t offset = 0;
-	off_t len = 0;
-	int advice = POSIX_FADV_DONTNEED;
+	const char *list = NULL;
+	struct fadvise_control ctl = {
+		.advice = POSIX_FADV_DONTNEED
+	};
 
 	static const struct option longopts[] = {
 		{ "advice",     required_argument, NULL, 'a' },
 		{ "fd",         required_argument, NULL, 'd' },
+		{ "files-from", required_argument, NULL, 'f' },
 		{ "length",     required_argument, NULL, 'l' },
 		{ "offset",     required_argument, NULL, 'o' },
+		{ "rate",       required_argument, NULL, 'r' },
 		{ "version",    no_argument,       NULL, 'V' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
@@ -93,31 +208,38 @@ int main(int argc, char ** argv)
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 
-	while ((c = getopt_long (argc, argv, "a:d:hl:o:V", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "a:d:f:hl:o:r:V", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'a':
-			advice = -1;
+			ctl.advice = -1;
 			for (size_t i = 0; i < ARRAY_SIZE(advices); i++) {
 				if (strcmp(optarg, advices[i].name) == 0) {
-					advice = advices[i].num;
+					ctl.advice = advices[i].num;
 					break;
 				}
 			}
-			if (advice == -1)
+			if (ctl.advice == -1)
 				errx(EXIT_FAILURE, "invalid advice argument: '%s'", optarg);
 			break;
 		case 'd':
 			fd = strtos32_or_err(optarg,
 					     _("invalid fd argument"));
 			break;
+		case 'f':
+			list = optarg;
+			break;
 		case 'l':
-			len = strtosize_or_err(optarg,
+			ctl.len = strtosize_or_err(optarg,
 					       _("invalid length argument"));
 			break;
 		case 'o':
-			offset = strtosize_or_err(optarg,
+			ctl.offset = strtosize_or_err(optarg,
 						  _("invalid offset argument"));
 			break;
+		case 'r':
+			ctl.rate = strtosize_or_err(optarg,
+						  _("invalid rate argument"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -127,36 +249,34 @@ int main(int argc, char ** argv)
 		}
 	}
 
-	if (optind == argc && fd == -1) {
+	if (optind == argc && fd == -1 && !list) {
 		warnx(_("no file specified"));
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (argc - optind > 0 && fd != -1) {
+	if ((argc - optind > 0 || list) && fd != -1) {
 		warnx(_("specify either file descriptor or file name"));
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (argc - optind > 1) {
-		warnx(_("specify one file descriptor or file name"));
-		errtryhelp(EXIT_FAILURE);
-	}
+	if (ctl.rate)
+		gettime_monotonic(&ctl.start);
+
+	if (fd != -1) {
+		rc = advise_fd(&ctl, fd);
+		if (rc != 0)
+			warnx(_("failed to advise: %s"), strerror(rc));
 
-	if (fd == -1) {
-		fd = open(argv[optind], O_RDONLY);
-		if (fd < 0)
-			err(EXIT_FAILURE, _("cannot open %s"), argv[optind]);
-		do_close = true;
+		return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 
-	rc = posix_fadvise(fd,
-			   offset, len,
-			   advice);
-	if (rc != 0)
-		warnx(_("failed to advise: %s"), strerror(rc));
+	for (; optind < argc; optind++) {
+		if (advise_file(&ctl, argv[optind]) != 0)
+			rc = -1;
+	}
 
-	if (do_close)
-		close(fd);
+	if (list && advise_files_from(&ctl, list) != 0)
+		rc = -1;
 
 	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
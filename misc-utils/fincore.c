@@ -21,10 +21,13 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <string.h>
+#include <ftw.h>
+#include <search.h>
 
 #include "c.h"
 #include "nls.h"
@@ -92,6 +95,7 @@ enum {
 	COL_EVICTED,
 	COL_RECENTLY_EVICTED_PAGES,
 	COL_RECENTLY_EVICTED,
+	COL_FILES,
 };
 
 static const struct colinfo infos[] = {
@@ -107,26 +111,45 @@ static const struct colinfo infos[] = {
 	[COL_EVICTED]                = { "EVICTED",                5, SCOLS_FL_RIGHT, N_("number of evicted bytes")},
 	[COL_RECENTLY_EVICTED_PAGES] = { "RECENTLY_EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of recently evicted pages"), 1},
 	[COL_RECENTLY_EVICTED]       = { "RECENTLY_EVICTED",       5, SCOLS_FL_RIGHT, N_("number of recently evicted bytes")},
+	[COL_FILES]                  = { "FILES",                  1, SCOLS_FL_RIGHT, N_("number of files (for --summary)")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2] = {-1};
 static size_t ncolumns;
 
+enum {
+	SUMMARY_NONE = 0,
+	SUMMARY_TOTAL,		/* one line for all files */
+	SUMMARY_DIR,		/* line per directory */
+	SUMMARY_FS		/* line per filesystem */
+};
+
 struct fincore_control {
 	const size_t pagesize;
 
 	struct libscols_table *tb;		/* output */
 
+	int summary;				/* SUMMARY_* */
+	struct fincore_state *sums;		/* summary lines in order of appearance */
+	struct fincore_state *last_sum;
+	void *sums_tree;			/* summary lines by name or device */
+	int walk_rc;				/* nftw() status, see fincore_walk() */
+
 	unsigned int bytes : 1,
 		     noheadings : 1,
 		     raw : 1,
-		     json : 1;
+		     json : 1,
+		     recursive : 1;
 
 };
 
 struct fincore_state {
-	const char * const name;
+	const char *name;
 	long long unsigned int file_size;
+	long long unsigned int nfiles;		/* for summary */
+	dev_t devno;
+
+	struct fincore_state *next;		/* next summary line */
 
 	struct cachestat cstat;
 	struct {
@@ -182,6 +205,7 @@ static int get_cstat_value(const struct fincore_state *st, int column_id,
 	case COL_WRITEBACK_PAGES:
 	case COL_WRITEBACK:
 		if (!st->cstat_fields.writeback)
+			break;
 		*value = st->cstat.nr_writeback;
 		return 1;
 	case COL_EVICTED_PAGES:
@@ -226,6 +250,10 @@ static int add_output_data(struct fincore_control *ctl,
 		case COL_FILE:
 			rc = scols_line_set_data(ln, i, st->name);
 			break;
+		case COL_FILES:
+			tmp = u64_to_string(ctl->summary ? st->nfiles : 1);
+			rc = scols_line_refer_data(ln, i, tmp);
+			break;
 		case COL_SIZE:
 			if (ctl->bytes)
 				xasprintf(&tmp, "%jd", (intmax_t) st->file_size);
@@ -251,11 +279,11 @@ static int add_output_data(struct fincore_control *ctl,
 
 		if (format_value) {
 			if (get_column_info(i)->pages) {
-				xasprintf(&tmp, "%ju", (uintmax_t) value);
+				tmp = u64_to_string(value);
 			} else {
 				value *= ctl->pagesize;
 				if (ctl->bytes)
-					xasprintf(&tmp, "%ju", (uintmax_t) value);
+					tmp = u64_to_string(value);
 				else
 					tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, value);
 			}
@@ -369,6 +397,7 @@ static int fincore_name(struct fincore_control *ctl,
 		return -errno;
 	}
 	st->file_size = sb.st_size;
+	st->devno = sb.st_dev;
 
 	if (S_ISBLK(sb.st_mode)) {
 		rc = blkdev_get_size(fd, &st->file_size);
@@ -388,6 +417,180 @@ static int fincore_name(struct fincore_control *ctl,
 	return rc;
 }
 
+static int compare_sums_by_name(const void *a, const void *b)
+{
+	return strcmp(((const struct fincore_state *) a)->name,
+		      ((const struct fincore_state *) b)->name);
+}
+
+static int compare_sums_by_devno(const void *a, const void *b)
+{
+	dev_t x = ((const struct fincore_state *) a)->devno,
+	      y = ((const struct fincore_state *) b)->devno;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * Add the file to the summary line. The @dirlen is length of the directory
+ * name in st->name (or 0) and @fsname is the name used for a new filesystem.
+ */
+static void add_summary_data(struct fincore_control *ctl,
+			     struct fincore_state *st,
+			     size_t dirlen, const char *fsname)
+{
+	struct fincore_state key = { .devno = st->devno }, *sum = NULL, **x;
+	char *name = NULL;
+
+	switch (ctl->summary) {
+	case SUMMARY_TOTAL:
+		sum = ctl->sums;
+		break;
+	case SUMMARY_DIR:
+		if (dirlen > 1)
+			dirlen--;	/* trailing slash */
+		name = dirlen ? xstrndup(st->name, dirlen) : xstrdup(".");
+		key.name = name;
+		x = tfind(&key, &ctl->sums_tree, compare_sums_by_name);
+		sum = x ? *x : NULL;
+		break;
+	case SUMMARY_FS:
+		x = tfind(&key, &ctl->sums_tree, compare_sums_by_devno);
+		sum = x ? *x : NULL;
+		if (!sum) {
+			if (fsname)
+				name = xstrdup(fsname);
+			else
+				xasprintf(&name, "%u:%u", major(st->devno), minor(st->devno));
+		}
+		break;
+	}
+
+	if (!sum) {
+		sum = xcalloc(1, sizeof(*sum));
+		sum->name = name ? name : xstrdup(_("total"));
+		sum->devno = st->devno;
+		sum->cstat_fields = st->cstat_fields;
+
+		if (ctl->summary != SUMMARY_TOTAL
+		    && !tsearch(sum, &ctl->sums_tree,
+				ctl->summary == SUMMARY_DIR ?
+					compare_sums_by_name : compare_sums_by_devno))
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+
+		if (ctl->last_sum)
+			ctl->last_sum->next = sum;
+		else
+			ctl->sums = sum;
+		ctl->last_sum = sum;
+	} else
+		free(name);
+
+	sum->nfiles++;
+	sum->file_size += st->file_size;
+	sum->cstat.nr_cache += st->cstat.nr_cache;
+	sum->cstat.nr_dirty += st->cstat.nr_dirty;
+	sum->cstat.nr_writeback += st->cstat.nr_writeback;
+	sum->cstat.nr_evicted += st->cstat.nr_evicted;
+	sum->cstat.nr_recently_evicted += st->cstat.nr_recently_evicted;
+
+	/* the values are available only if available for all files */
+	sum->cstat_fields.dirty &= st->cstat_fields.dirty;
+	sum->cstat_fields.writeback &= st->cstat_fields.writeback;
+	sum->cstat_fields.evicted &= st->cstat_fields.evicted;
+	sum->cstat_fields.recently_evicted &= st->cstat_fields.recently_evicted;
+}
+
+/*
+ * Returns: <0 on error, 0 success, 1 ignore.
+ */
+static int fincore_file(struct fincore_control *ctl, const char *name,
+			size_t dirlen, const char *fsname)
+{
+	struct fincore_state st = {
+		.name = name,
+	};
+	int rc = fincore_name(ctl, &st);
+
+	if (rc == 0) {
+		if (ctl->summary)
+			add_summary_data(ctl, &st, dirlen, fsname);
+		else
+			add_output_data(ctl, &st);
+	}
+	return rc;
+}
+
+static size_t dirname_length(const char *name)
+{
+	const char *p = strrchr(name, '/');
+
+	return p ? (size_t) (p - name) + 1 : 0;
+}
+
+/* nftw() has no way to pass private data */
+static struct fincore_control *walk_ctl;
+static dev_t walk_devno;
+static char *walk_fsname;
+
+static int fincore_walk(const char *fpath, const struct stat *sb,
+			int typeflag, struct FTW *ftwbuf)
+{
+	struct fincore_control *ctl = walk_ctl;
+
+	switch (typeflag) {
+	case FTW_D:
+		/* the first directory of the filesystem names the filesystem */
+		if (ftwbuf->level == 0 || sb->st_dev != walk_devno) {
+			walk_devno = sb->st_dev;
+			free(walk_fsname);
+			walk_fsname = NULL;
+			if (ctl->summary == SUMMARY_FS) {
+				struct fincore_state key = { .devno = sb->st_dev };
+
+				/* nftw() reuses fpath buffer */
+				if (!tfind(&key, &ctl->sums_tree, compare_sums_by_devno))
+					walk_fsname = xstrdup(fpath);
+			}
+		}
+		break;
+	case FTW_DNR:
+		warnx(_("failed to read directory: %s"), fpath);
+		ctl->walk_rc = EXIT_FAILURE;
+		break;
+	case FTW_NS:
+		warnx(_("failed to do stat: %s"), fpath);
+		ctl->walk_rc = EXIT_FAILURE;
+		break;
+	case FTW_F:
+		if (!S_ISREG(sb->st_mode) && !S_ISBLK(sb->st_mode))
+			break;
+		if (fincore_file(ctl, fpath, ftwbuf->base,
+				 sb->st_dev == walk_devno ? walk_fsname : NULL) < 0)
+			ctl->walk_rc = EXIT_FAILURE;
+		break;
+	}
+	return 0;
+}
+
+static void ignore_free(void *data __attribute__((__unused__)))
+{
+}
+
+static void free_summary(struct fincore_control *ctl)
+{
+	struct fincore_state *sum = ctl->sums;
+
+	while (sum) {
+		struct fincore_state *next = sum->next;
+
+		free((char *) sum->name);
+		free(sum);
+		sum = next;
+	}
+	tdestroy(ctl->sums_tree, ignore_free);
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -403,6 +606,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -o, --output <list>   output columns\n"), out);
 	fputs(_("     --output-all      output all columns\n"), out);
 	fputs(_(" -r, --raw             use raw output format\n"), out);
+	fputs(_(" -R, --recursive       recursively check all files in directories\n"), out);
+	fputs(_(" -s, --summary <mode>  print only totals; <mode> is total, dir or fs\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(23));
@@ -440,6 +645,8 @@ int main(int argc, char ** argv)
 		{ "help",	no_argument, NULL, 'h' },
 		{ "json",       no_argument, NULL, 'J' },
 		{ "raw",        no_argument, NULL, 'r' },
+		{ "recursive",  no_argument, NULL, 'R' },
+		{ "summary",    required_argument, NULL, 's' },
 		{ NULL, 0, NULL, 0 },
 	};
 
@@ -448,7 +655,7 @@ int main(int argc, char ** argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long (argc, argv, "bno:JrVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "bno:JrRs:Vh", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'b':
 			ctl.bytes = 1;
@@ -469,6 +676,19 @@ int main(int argc, char ** argv)
 		case 'r':
 			ctl.raw = 1;
 			break;
+		case 'R':
+			ctl.recursive = 1;
+			break;
+		case 's':
+			if (strcmp(optarg, "total") == 0)
+				ctl.summary = SUMMARY_TOTAL;
+			else if (strcmp(optarg, "dir") == 0)
+				ctl.summary = SUMMARY_DIR;
+			else if (strcmp(optarg, "fs") == 0)
+				ctl.summary = SUMMARY_FS;
+			else
+				errx(EXIT_FAILURE, _("unsupported summary mode: %s"), optarg);
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -487,6 +707,8 @@ int main(int argc, char ** argv)
 		columns[ncolumns++] = COL_RES;
 		columns[ncolumns++] = COL_PAGES;
 		columns[ncolumns++] = COL_SIZE;
+		if (ctl.summary)
+			columns[ncolumns++] = COL_FILES;
 		columns[ncolumns++] = COL_FILE;
 	}
 
@@ -520,6 +742,9 @@ int main(int argc, char ** argv)
 			case COL_FILE:
 				scols_column_set_json_type(cl, SCOLS_JSON_STRING);
 				break;
+			case COL_FILES:
+				scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+				break;
 			case COL_SIZE:
 			case COL_RES:
 				if (!ctl.bytes)
@@ -533,13 +758,25 @@ int main(int argc, char ** argv)
 	}
 
 	for(; optind < argc; optind++) {
-		struct fincore_state st = {
-			.name = argv[optind],
-		};
+		const char *name = argv[optind];
+		struct stat sb;
+
+		if (ctl.recursive && stat(name, &sb) == 0 && S_ISDIR(sb.st_mode)) {
+			walk_ctl = &ctl;
+			ctl.walk_rc = EXIT_SUCCESS;
+			if (nftw(name, fincore_walk, 20, FTW_PHYS) != 0) {
+				warn(_("failed to walk directory: %s"), name);
+				rc = EXIT_FAILURE;
+			}
+			if (ctl.walk_rc != EXIT_SUCCESS)
+				rc = ctl.walk_rc;
+			free(walk_fsname);
+			walk_fsname = NULL;
+			continue;
+		}
 
-		switch (fincore_name(&ctl, &st)) {
+		switch (fincore_file(&ctl, name, dirname_length(name), NULL)) {
 		case 0:
-			add_output_data(&ctl, &st);
 			break;
 		case 1:
 			break; /* ignore */
@@ -549,6 +786,14 @@ int main(int argc, char ** argv)
 		}
 	}
 
+	if (ctl.summary) {
+		struct fincore_state *sum;
+
+		for (sum = ctl.sums; sum; sum = sum->next)
+			add_output_data(&ctl, sum);
+		free_summary(&ctl);
+	}
+
 	scols_print_table(ctl.tb);
 	scols_unref_table(ctl.tb);
 
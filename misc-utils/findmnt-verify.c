@@ -19,9 +19,19 @@
 
 #include "findmnt.h"
 
+/* target of a table entry, used to check the order of the entries */
+struct verify_target {
+	char	*target;	/* canonicalized if cache enabled */
+	size_t	pos;		/* position in the table */
+};
+
 struct verify_context {
 	struct libmnt_fs	*fs;
 	struct libmnt_table	*tb;
+	size_t			pos;	/* position of fs in tb */
+
+	struct verify_target	*targets;	/* sorted by target and pos */
+	size_t			ntargets;
 
 	char	**fs_ary;
 	size_t	fs_num;
@@ -84,51 +94,155 @@ static int __attribute__ ((__format__ (__printf__, 2, 3)))
 	return 0;
 }
 
-static int verify_order(struct verify_context *vfy)
+static const char *get_order_target(struct libmnt_fs *fs)
 {
-	struct libmnt_iter *itr = NULL;
-	struct libmnt_fs *next;
-	const char *tgt;
+	const char *tgt = mnt_fs_get_target(fs);
 
-	tgt = mnt_fs_get_target(vfy->fs);
 	if (tgt && !(flags & FL_NOCACHE))
-		tgt  = mnt_resolve_target(tgt, cache);
-	else if (!tgt)
-		return 0;
+		tgt = mnt_resolve_target(tgt, cache);
+	return tgt;
+}
+
+static int cmp_targets(const void *a, const void *b)
+{
+	const struct verify_target *x = a, *y = b;
+	int rc = strcmp(x->target, y->target);
+
+	if (rc)
+		return rc;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+/*
+ * Reads all targets from the table to a sorted array, verify_order() then does
+ * not need to compare each entry with all the other entries.
+ */
+static int read_targets(struct verify_context *vfy)
+{
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	size_t pos = 0;
 
 	itr = mnt_new_iter(MNT_ITER_FORWARD);
 	if (!itr) {
 		warn(_("failed to initialize libmount iterator"));
-		goto done;
+		return -ENOMEM;
 	}
 
-	/* set iterator position to 'fs' */
-	mnt_table_set_iter(vfy->tb, itr, vfy->fs);
+	vfy->targets = xcalloc(mnt_table_get_nents(vfy->tb) + 1,
+			       sizeof(struct verify_target));
 
-	if (mnt_table_next_fs(vfy->tb, itr, &next) != 0)
-		goto done;
-
-	/* scan all next filesystems */
-	while (mnt_table_next_fs(vfy->tb, itr, &next) == 0) {
-		const char *n_tgt;
-		size_t len;
+	while (mnt_table_next_fs(vfy->tb, itr, &fs) == 0) {
+		const char *tgt = get_order_target(fs);
 
-		n_tgt = mnt_fs_get_target(next);
-		if (n_tgt && !(flags & FL_NOCACHE))
-			n_tgt  = mnt_resolve_target(n_tgt, cache);
-		else if (!n_tgt)
-			continue;
-		len = strlen(n_tgt);
+		if (tgt) {
+			struct verify_target *t = &vfy->targets[vfy->ntargets++];
 
-		if (strncmp(n_tgt, tgt, len) == 0) {
-			if (*(tgt + len) == '\0')
-				verify_warn(vfy, _("target specified more than once"));
-			else if (*(tgt + len) == '/')
-				verify_err(vfy, _("wrong order: %s specified before %s"), tgt, n_tgt);
+			t->target = xstrdup(tgt);
+			t->pos = pos;
 		}
+		pos++;
 	}
-done:
 	mnt_free_iter(itr);
+
+	qsort(vfy->targets, vfy->ntargets, sizeof(struct verify_target), cmp_targets);
+	return 0;
+}
+
+static void free_targets(struct verify_context *vfy)
+{
+	size_t i;
+
+	for (i = 0; i < vfy->ntargets; i++)
+		free(vfy->targets[i].target);
+	free(vfy->targets);
+}
+
+/* compares target with the first @len bytes of @str */
+static int cmp_target_prefix(const struct verify_target *t,
+			     const char *str, size_t len, size_t pos)
+{
+	int rc = strncmp(t->target, str, len);
+
+	if (rc == 0 && t->target[len] != '\0')
+		rc = 1;
+	if (rc)
+		return rc;
+	return t->pos < pos ? -1 : t->pos > pos ? 1 : 0;
+}
+
+/*
+ * Adds to @hits all entries behind the current one with target equal to the
+ * first @len bytes of @tgt.
+ */
+static size_t find_later_targets(struct verify_context *vfy,
+				 const char *tgt, size_t len,
+				 struct verify_target ***hits, size_t nhits)
+{
+	size_t lo = 0, hi = vfy->ntargets;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (cmp_target_prefix(&vfy->targets[mid], tgt, len, vfy->pos) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < vfy->ntargets; lo++) {
+		struct verify_target *t = &vfy->targets[lo];
+
+		if (strncmp(t->target, tgt, len) != 0 || t->target[len] != '\0')
+			break;
+		*hits = xreallocarray(*hits, nhits + 1, sizeof(struct verify_target *));
+		(*hits)[nhits++] = t;
+	}
+	return nhits;
+}
+
+static int cmp_hits(const void *a, const void *b)
+{
+	const struct verify_target *x = *((struct verify_target * const *) a),
+				   *y = *((struct verify_target * const *) b);
+
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+/*
+ * The entries behind the current one must not use the same target, nor a
+ * parent of the target.
+ */
+static int verify_order(struct verify_context *vfy)
+{
+	struct verify_target **hits = NULL;
+	size_t i, len, nhits = 0;
+	const char *tgt;
+
+	tgt = get_order_target(vfy->fs);
+	if (!tgt)
+		return 0;
+	len = strlen(tgt);
+
+	nhits = find_later_targets(vfy, tgt, len, &hits, nhits);
+	for (i = 0; i < len; i++) {
+		if (tgt[i] == '/')
+			nhits = find_later_targets(vfy, tgt, i, &hits, nhits);
+	}
+	if (!nhits)
+		return 0;
+
+	/* report in order of the table */
+	qsort(hits, nhits, sizeof(struct verify_target *), cmp_hits);
+
+	for (i = 0; i < nhits; i++) {
+		if (strcmp(hits[i]->target, tgt) == 0)
+			verify_warn(vfy, _("target specified more than once"));
+		else
+			verify_err(vfy, _("wrong order: %s specified before %s"),
+					tgt, hits[i]->target);
+	}
+	free(hits);
 	return 0;
 }
 
@@ -538,6 +652,9 @@ int verify_table(struct libmnt_table *tb)
 		has_read_fs = 1;
 	}
 
+	if (check_order)
+		rc = read_targets(&vfy);
+
 	while (rc == 0 && (vfy.fs = get_next_fs(tb, itr))) {
 		vfy.target_printed = 0;
 		vfy.no_fsck = 0;
@@ -550,6 +667,7 @@ int verify_table(struct libmnt_table *tb)
 		if (flags & FL_FIRSTONLY)
 			break;
 		flags |= FL_NOSWAPMATCH;
+		vfy.pos++;
 	}
 
 #ifdef USE_SYSTEMD
@@ -580,6 +698,7 @@ done:
 
 
 	free_proc_filesystems(&vfy);
+	free_targets(&vfy);
 
 	return rc != 0 ? rc : vfy.nerrors + parse_nerrors;
 }
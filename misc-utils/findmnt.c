@@ -158,6 +158,11 @@ static inline size_t err_columns_index(size_t arysz, size_t idx)
 #define add_column(ary, n, id)	\
 		((ary)[ err_columns_index(ARRAY_SIZE(ary), (n)) ] = (id))
 
+/* sort columns (parsed --sort=<list>), the columns behind nvisible are hidden */
+static int sort_ids[ARRAY_SIZE(infos)];
+static size_t nsorts;
+static size_t nvisible;
+
 /* poll actions (parsed --poll=<list> */
 #define FINDMNT_NACTIONS	4		/* mount, umount, move, remount */
 static int actions[FINDMNT_NACTIONS];
@@ -992,6 +997,7 @@ static struct libmnt_table *parse_tabfiles(char **files,
 		return NULL;
 	}
 	mnt_table_set_parser_errcb(tb, parser_errcb);
+	mnt_table_enable_lazy_parsing(tb, 1);
 
 	do {
 		/* NULL means that libmount will use default paths */
@@ -1005,6 +1011,11 @@ static struct libmnt_table *parse_tabfiles(char **files,
 			rc = mnt_table_parse_mtab(tb, path);
 			break;
 		case TABTYPE_KERNEL:
+			if (!path && (flags & FL_LISTMOUNT)) {
+				rc = mnt_table_fetch_listmount(tb);
+				if (rc != -ENOSYS)
+					break;
+			}
 			if (!path)
 				path = access(_PATH_PROC_MOUNTINFO, R_OK) == 0 ?
 					      _PATH_PROC_MOUNTINFO :
@@ -1364,6 +1375,60 @@ done:
 	return rc;
 }
 
+/* compares human readable sizes and percentages, "-" is zero */
+static uint64_t get_cell_size(struct libscols_cell *ce)
+{
+	const char *data = scols_cell_get_data(ce);
+	uintmax_t num = 0;
+
+	if (!data || !*data || *data == '-')
+		return 0;
+	if (strtosize(data, &num) != 0)
+		num = strtoumax(data, NULL, 10);
+	return num;
+}
+
+static int cmp_size_cells(struct libscols_cell *a,
+			  struct libscols_cell *b,
+			  __attribute__((__unused__)) void *data)
+{
+	uint64_t x = get_cell_size(a), y = get_cell_size(b);
+
+	return x == y ? 0 : x < y ? -1 : 1;
+}
+
+static void set_sort_cmpfunc(struct libscols_column *cl, int id)
+{
+	switch (id) {
+	case COL_SIZE:
+	case COL_AVAIL:
+	case COL_USED:
+		if (!(flags & FL_BYTES)) {
+			scols_column_set_cmpfunc(cl, cmp_size_cells, NULL);
+			break;
+		}
+		/* fallthrough */
+	case COL_ID:
+	case COL_PARENT:
+	case COL_FREQ:
+	case COL_PASSNO:
+	case COL_TID:
+	case COL_INO_TOTAL:
+	case COL_INO_AVAIL:
+	case COL_INO_USED:
+		/* numbers are compared by precomputed keys in libsmartcols */
+		scols_column_set_data_type(cl, SCOLS_DATA_U64);
+		break;
+	case COL_USEPERC:
+	case COL_INO_USEPERC:
+		scols_column_set_cmpfunc(cl, cmp_size_cells, NULL);
+		break;
+	default:
+		scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
+		break;
+	}
+}
+
 static int uniq_fs_target_cmp(
 		struct libmnt_table *tb __attribute__((__unused__)),
 		struct libmnt_fs *a,
@@ -1420,6 +1485,9 @@ static void __attribute__((__noreturn__)) usage(void)
 		"                          (includes user space mount options)\n"), out);
 	fputs(_(" -k, --kernel           search in kernel table of mounted\n"
 		"                          filesystems (default)\n"), out);
+	fputs(_("     --kernel-method <method>\n"
+		"                          method to read kernel table of mounted\n"
+		"                          filesystems, 'mountinfo' (default) or 'listmount'\n"), out);
 	fputc('\n', out);
 	fputs(_(" -p, --poll[=<list>]    monitor changes in table of mounted filesystems\n"), out);
 	fputs(_(" -w, --timeout <num>    upper limit in milliseconds that --poll will block\n"), out);
@@ -1439,6 +1507,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -I, --dfi              imitate the output of df(1) with -i option\n"), out);
 	fputs(_(" -i, --invert           invert the sense of matching\n"), out);
 	fputs(_(" -J, --json             use JSON output format\n"), out);
+	fputs(_("     --cbor             use CBOR (binary JSON) output format\n"), out);
 	fputs(_(" -l, --list             use list format output\n"), out);
 	fputs(_(" -N, --task <tid>       use alternative namespace (/proc/<tid>/mountinfo file)\n"), out);
 	fputs(_(" -n, --noheadings       don't print column headings\n"), out);
@@ -1448,6 +1517,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --pairs            use key=\"value\" output format\n"), out);
 	fputs(_("     --pseudo           print only pseudo-filesystems\n"), out);
 	fputs(_("     --shadowed         print only filesystems over-mounted by another filesystem\n"), out);
+	fputs(_("     --sort <list>      sort output by <column>[,<column>...]\n"), out);
 	fputs(_(" -R, --submounts        print all submounts for the matching filesystems\n"), out);
 	fputs(_(" -r, --raw              use raw output format\n"), out);
 	fputs(_("     --real             print only real filesystems\n"), out);
@@ -1509,11 +1579,12 @@ int main(int argc, char *argv[])
 	int verify = 0, collist = 0;
 	int c, rc = -1, timeout = -1;
 	int ntabfiles = 0, tabtype = 0;
-	char *outarg = NULL;
+	char *outarg = NULL, *sortarg = NULL;
 	size_t i;
-	int force_tree = 0, istree = 0;
+	int force_tree = 0, istree = 0, cbor = 0;
 
 	struct libscols_table *table = NULL;
+	struct libscols_column *sort_cols[ARRAY_SIZE(infos)] = { NULL };
 
 	enum {
 		FINDMNT_OPT_VERBOSE = CHAR_MAX + 1,
@@ -1522,7 +1593,10 @@ int main(int argc, char *argv[])
 		FINDMNT_OPT_PSEUDO,
 		FINDMNT_OPT_REAL,
 		FINDMNT_OPT_VFS_ALL,
-		FINDMNT_OPT_SHADOWED
+		FINDMNT_OPT_SHADOWED,
+		FINDMNT_OPT_SORT,
+		FINDMNT_OPT_CBOR,
+		FINDMNT_OPT_KERNEL_METHOD
 	};
 
 	static const struct option longopts[] = {
@@ -1539,7 +1613,9 @@ int main(int argc, char *argv[])
 		{ "help",	    no_argument,       NULL, 'h'		 },
 		{ "invert",	    no_argument,       NULL, 'i'		 },
 		{ "json",	    no_argument,       NULL, 'J'		 },
+		{ "cbor",	    no_argument,       NULL, FINDMNT_OPT_CBOR	 },
 		{ "kernel",	    no_argument,       NULL, 'k'		 },
+		{ "kernel-method",  required_argument, NULL, FINDMNT_OPT_KERNEL_METHOD },
 		{ "list",	    no_argument,       NULL, 'l'		 },
 		{ "mountpoint",	    required_argument, NULL, 'M'		 },
 		{ "mtab",	    no_argument,       NULL, 'm'		 },
@@ -1570,6 +1646,7 @@ int main(int argc, char *argv[])
 		{ "pseudo",	    no_argument,       NULL, FINDMNT_OPT_PSEUDO	 },
 		{ "vfs-all",	    no_argument,       NULL, FINDMNT_OPT_VFS_ALL },
 		{ "shadowed",       no_argument,       NULL, FINDMNT_OPT_SHADOWED },
+		{ "sort",           required_argument, NULL, FINDMNT_OPT_SORT },
 		{ "list-columns",   no_argument,       NULL, 'H' },
 		{ NULL, 0, NULL, 0 }
 	};
@@ -1577,12 +1654,13 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'C', 'c'},			/* [no]canonicalize */
 		{ 'C', 'e' },			/* nocanonicalize, evaluate */
-		{ 'J', 'P', 'r','x' },		/* json,pairs,raw,verify */
+		{ 'J', 'P', 'r','x', FINDMNT_OPT_CBOR },	/* json,pairs,raw,verify,cbor */
 		{ 'M', 'T' },			/* mountpoint, target */
 		{ 'N','k','m','s' },		/* task,kernel,mtab,fstab */
 		{ 'P','l','r','x' },		/* pairs,list,raw,verify */
 		{ 'p','x' },			/* poll,verify */
 		{ 'm','p','s' },		/* mtab,poll,fstab */
+		{ 'p', FINDMNT_OPT_SORT },	/* poll,sort */
 		{ FINDMNT_OPT_PSEUDO, FINDMNT_OPT_REAL },
 		{ 0 }
 	};
@@ -1690,7 +1768,7 @@ int main(int argc, char *argv[])
 			tabtype = TABTYPE_FSTAB;
 			flags &= ~FL_TREE;
 			break;
-		case 'k':		/* kernel (mountinfo) */
+		case 'k':
 			tabtype = TABTYPE_KERNEL;
 			break;
 		case 't':
@@ -1759,6 +1837,23 @@ int main(int argc, char *argv[])
 		case FINDMNT_OPT_SHADOWED:
 			flags |= FL_SHADOWED;
 			break;
+		case FINDMNT_OPT_SORT:
+			sortarg = optarg;
+			break;
+		case FINDMNT_OPT_KERNEL_METHOD:
+			tabtype = TABTYPE_KERNEL;
+			if (strcmp(optarg, "listmount") == 0)
+				flags |= FL_LISTMOUNT;
+			else if (strcmp(optarg, "mountinfo") == 0)
+				flags &= ~FL_LISTMOUNT;
+			else
+				errx(EXIT_FAILURE, _("unknown kernel interface: %s"), optarg);
+			break;
+		case FINDMNT_OPT_CBOR:
+			/* the same as JSON, but binary */
+			flags |= FL_JSON;
+			cbor = 1;
+			break;
 
 		case 'H':
 			collist = 1;
@@ -1809,6 +1904,27 @@ int main(int argc, char *argv[])
 					 &ncolumns, column_name_to_id) < 0)
 		return EXIT_FAILURE;
 
+	nvisible = ncolumns;
+	if (sortarg) {
+		int n = string_to_idarray(sortarg, sort_ids, ARRAY_SIZE(sort_ids),
+					  column_name_to_id);
+		if (n <= 0)
+			return EXIT_FAILURE;
+		nsorts = n;
+
+		/* the sort columns not between output columns -- add as hidden */
+		for (i = 0; i < nsorts; i++) {
+			size_t x;
+
+			for (x = 0; x < ncolumns; x++) {
+				if (columns[x] == sort_ids[i])
+					break;
+			}
+			if (x == ncolumns)
+				add_column(columns, ncolumns++, sort_ids[i]);
+		}
+	}
+
 	if (!tabtype)
 		tabtype = verify ? TABTYPE_FSTAB : TABTYPE_KERNEL;
 
@@ -1900,6 +2016,8 @@ int main(int argc, char *argv[])
 	scols_table_enable_export(table,     !!(flags & FL_EXPORT));
 	scols_table_enable_shellvar(table,   !!(flags & FL_SHELLVAR));
 	scols_table_enable_json(table,       !!(flags & FL_JSON));
+	if (cbor)
+		scols_table_enable_cbor(table, 1);
 	scols_table_enable_ascii(table,      !!(flags & FL_ASCII));
 	scols_table_enable_noheadings(table, !!(flags & FL_NOHEADINGS));
 
@@ -1910,9 +2028,12 @@ int main(int argc, char *argv[])
 		struct libscols_column *cl;
 		int fl = get_column_flags(i);
 		int id = get_column_id(i);
+		size_t x;
 
 		if (!(flags & FL_TREE))
 			fl &= ~SCOLS_FL_TREE;
+		if (i >= nvisible)
+			fl |= SCOLS_FL_HIDDEN;
 
 		if (!(flags & FL_POLL) && is_tabdiff_column(id)) {
 			warnx(_("%s column is requested, but --poll "
@@ -1933,6 +2054,14 @@ int main(int argc, char *argv[])
 						NULL);
 		if (flags & FL_JSON)
 	                scols_column_set_json_type(cl, get_column_json_type(id, fl, NULL));
+
+		for (x = 0; x < nsorts; x++) {
+			if (sort_ids[x] == id && !sort_cols[x]) {
+				set_sort_cmpfunc(cl, id);
+				sort_cols[x] = cl;
+				break;
+			}
+		}
 	}
 
 	/*
@@ -1967,8 +2096,11 @@ int main(int argc, char *argv[])
 	/*
 	 * Print the output table for non-poll modes
 	 */
-	if (!rc && !(flags & FL_POLL))
+	if (!rc && !(flags & FL_POLL)) {
+		if (nsorts)
+			scols_sort_table_by_columns(table, sort_cols, nsorts);
 		scols_print_table(table);
+	}
 leave:
 	scols_unref_table(table);
 
@@ -25,6 +25,7 @@ enum {
 	FL_DELETED      = (1 << 21),
 	FL_SHELLVAR     = (1 << 22),
 	FL_DF_INODES	= (1 << 23) | FL_DF,
+	FL_LISTMOUNT	= (1 << 24),
 
 	/* basic table settings */
 	FL_ASCII	= (1 << 25),
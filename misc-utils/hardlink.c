@@ -36,6 +36,7 @@
 #include <signal.h>		/* SIG*, sigaction */
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
+#include <pthread.h>		/* pthread_create() */
 #include <sys/ioctl.h>
 
 #if defined(HAVE_LINUX_FIEMAP_H) && defined(HAVE_SYS_VFS_H)
@@ -44,6 +45,9 @@
 # ifdef FICLONE
 #  define USE_REFLINK 1
 # endif
+# ifdef FIDEDUPERANGE
+#  define USE_DEDUPE 1
+# endif
 #endif
 
 #include "nls.h"
@@ -53,6 +57,7 @@
 #include "monotonic.h"
 #include "optutils.h"
 #include "fileeq.h"
+#include "closestream.h"
 
 #ifdef USE_REFLINK
 # include "statfs_magic.h"
@@ -77,34 +82,72 @@ enum {
 static int reflink_mode = REFLINK_NEVER;
 static int reflinks_skip;
 #endif
+#ifdef USE_DEDUPE
+static int dedupe_mode;		/* share extents by FIDEDUPERANGE */
+
+/* The kernel refuses struct file_dedupe_range larger than a page */
+# define DEDUPE_MAXDESTS	((4096 - sizeof(struct file_dedupe_range)) \
+				 / sizeof(struct file_dedupe_range_info))
+/* Bytes per ioctl call, the kernel may silently trim longer requests */
+# define DEDUPE_CHUNKSZ		(16 * 1024 * 1024)
+#endif
 
 static struct ul_fileeq fileeq;
 
+/**
+ * struct hdl_stat - The part of the stat buffer we need about a file
+ *
+ * This is kept for every file, so don't add anything unnecessary.
+ */
+struct hdl_stat {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	nlink_t nlink;
+	struct timespec mtime;
+	struct timespec ctime;
+	mode_t mode;
+	uid_t uid;
+	gid_t gid;
+};
+
+/**
+ * struct hdl_dir - A directory with files
+ * @dirname: The offset of the directory name after the root directory
+ * @len:     The length of the path
+ * @path:    The path of the directory including the trailing slash
+ *
+ * The directory paths are shared by all files in the directory.
+ */
+struct hdl_dir {
+	int dirname;
+	int len;
+	char path[];
+};
+
 /**
  * struct file - Information about a file
- * @st:       The stat buffer associated with the file
+ * @st:       The stat information associated with the file
+ * @data:     The content comparison data, allocated only on comparison
+ * @deduped:  The file already shares extents with another file (--dedupe)
  * @next:     Next file with the same size
- * @basename: The offset off the basename in the filename
- * @path:     The path of the file
+ * @links:    The names of the file
  *
- * This contains all information we need about a file.
+ * This contains all information we need about a file. The @path of the links
+ * is available only when the group of files of the same size is processed
+ * (see link_group()), otherwise use @dir and @name.
  */
 struct file {
-	struct stat st;
-	struct ul_fileeq_data data;
+	struct hdl_stat st;
+	struct ul_fileeq_data *data;
+	unsigned int deduped:1;
 
 	struct file *next;
 	struct link {
 		struct link *next;
-		int basename;
-		int dirname;
-#if __STDC_VERSION__ >= 199901L
-		char path[];
-#elif __GNUC__
-		char path[0];
-#else
-		char path[1];
-#endif
+		struct hdl_dir *dir;
+		char *path;
+		char name[];
 	} *links;
 };
 
@@ -166,6 +209,8 @@ struct hdl_regex {
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
  * @max_size: Maximum size of files to consider, 0 means umlimited. (default = 0 byte)
+ * @jobs: Number of threads used to compare files (default = 1)
+ * @digest_cache: File with digests from the previous runs (default = NULL)
  */
 static struct options {
 	struct hdl_regex *include;
@@ -187,6 +232,8 @@ static struct options {
 	uintmax_t max_size;
 	size_t io_size;
 	size_t cache_size;
+	unsigned int jobs;
+	const char *digest_cache;
 } opts = {
 	/* default setting */
 #ifdef USE_FILEEQ_CRYPTOAPI
@@ -200,7 +247,8 @@ static struct options {
 	.respect_xattrs = FALSE,
 	.keep_oldest = FALSE,
 	.min_size = 1,
-	.cache_size = 10*1024*1024
+	.cache_size = 10*1024*1024,
+	.jobs = 1
 };
 
 /*
@@ -210,7 +258,34 @@ static struct options {
  * are considered equal, see compare_nodes()
  */
 static void *files;
-static void *files_by_ino;
+
+/*
+ * inodes
+ *
+ * A hash table (open addressing) of the files by device and inode number,
+ * used to find more links to the same file. The table is kept at most half
+ * full and it's freed after scanning.
+ */
+static struct file **inodes;
+static size_t inodes_size, inodes_count;
+
+/*
+ * dirs
+ *
+ * The current directory for each level of nftw(), see inserter().
+ */
+static struct hdl_dir **dirs;
+static size_t dirs_size;
+
+/*
+ * arena
+ *
+ * The files, links and directories are never freed, so they are allocated
+ * from large chunks to avoid per-allocation overhead.
+ */
+#define ARENA_CHUNKSZ	(1024 * 1024)
+static char *arena;
+static size_t arena_left;
 
 /*
  * last_signal
@@ -220,6 +295,61 @@ static void *files_by_ino;
  */
 static volatile sig_atomic_t last_signal;
 
+/*
+ * hdl_lock
+ *
+ * Serializes output, statistics and the queue of size groups when the
+ * files are compared by more threads (--jobs).
+ */
+static pthread_mutex_t hdl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * groups
+ *
+ * Heads of the lists of files with the same size, collected for --jobs. The
+ * groups are independent, each thread takes the next unprocessed one.
+ */
+static struct file **groups;
+static size_t ngroups, groups_next;
+
+/**
+ * struct digest_entry - Cached digests of a file (--digest-cache)
+ * @dev: The device of the file
+ * @ino: The inode of the file
+ * @size: The size of the file
+ * @mtime: The modification time of the file
+ * @ctime: The status change time of the file
+ * @readsiz: The I/O size used for the digests
+ * @nblocks: Number of blocks, the intro and digests
+ * @eof: Whether all the file has been digested
+ * @used: Whether the entry matches a file from this run
+ * @intro: The first bytes of the file
+ * @digests: The block digests
+ */
+struct digest_entry {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct timespec ctime;
+	size_t readsiz;
+	size_t nblocks;
+	unsigned int eof:1,
+		     used:1;
+	unsigned char intro[UL_FILEEQ_INTROSIZ];
+	unsigned char *digests;
+};
+
+/*
+ * digests
+ *
+ * A binary tree of #struct digest_entry, managed using tsearch() and
+ * protected by hdl_lock.
+ */
+static void *digests;
+static FILE *digests_out;
+
+#define DIGEST_CACHE_MAGIC	"hardlink-digests 1"
 
 #define is_log_enabled(_level)  (quiet == 0 && (_level) <= (unsigned int)opts.verbosity)
 
@@ -236,10 +366,12 @@ static void jlog(enum log_level level, const char *format, ...)
 	if (!is_log_enabled(level))
 		return;
 
+	pthread_mutex_lock(&hdl_lock);
 	va_start(args, format);
 	vfprintf(stdout, format, args);
 	va_end(args);
 	fputc('\n', stdout);
+	pthread_mutex_unlock(&hdl_lock);
 }
 
 /**
@@ -306,9 +438,9 @@ static int compare_nodes(const void *_a, const void *_b)
 	int diff = 0;
 
 	if (diff == 0)
-		diff = CMP(a->st.st_dev, b->st.st_dev);
+		diff = CMP(a->st.dev, b->st.dev);
 	if (diff == 0)
-		diff = CMP(a->st.st_size, b->st.st_size);
+		diff = CMP(a->st.size, b->st.size);
 
 	return diff;
 }
@@ -316,8 +448,7 @@ static int compare_nodes(const void *_a, const void *_b)
 /* Compare only filenames */
 static inline int filename_strcmp(const struct file *a, const struct file *b)
 {
-	return strcmp(	a->links->path + a->links->basename,
-			b->links->path + b->links->basename);
+	return strcmp(a->links->name, b->links->name);
 }
 
 /**
@@ -329,52 +460,133 @@ static inline int filename_strcmp(const struct file *a, const struct file *b)
  * <dirname> is all betweehn rootdir and filename
  * <filename> is last component (aka basename)
  */
-static inline int dirname_strcmp(const struct file *a, const struct file *b)
+static inline int dir_strcmp(const struct hdl_dir *a, const struct hdl_dir *b)
 {
 	int diff = 0;
-	int asz = a->links->basename - a->links->dirname,
-	    bsz = b->links->basename - b->links->dirname;
+	int asz = a->len - a->dirname,
+	    bsz = b->len - b->dirname;
+
+	if (a == b)
+		return 0;
 
 	diff = CMP(asz, bsz);
 
 	if (diff == 0) {
 		const char *a_start, *b_start;
 
-		a_start = a->links->path + a->links->dirname;
-		b_start = b->links->path + b->links->dirname;
+		a_start = a->path + a->dirname;
+		b_start = b->path + b->dirname;
 
 		diff = strncmp(a_start, b_start, asz);
 	}
 	return diff;
 }
 
+static inline int dirname_strcmp(const struct file *a, const struct file *b)
+{
+	return dir_strcmp(a->links->dir, b->links->dir);
+}
+
 /**
- * compare_nodes_ino - Node comparison function
- * @_a: The first node (a #struct file)
- * @_b: The second node (a #struct file)
+ * is_same_inode - Inode comparison function
+ * @f: The file
+ * @sb: The stat information of the other file
+ * @dir: The directory of the other file
+ * @name: The basename of the other file
  *
- * Compare the two nodes for the binary tree.
+ * Returns: %TRUE if the other file should be added as a link to @f.
  */
-static int compare_nodes_ino(const void *_a, const void *_b)
+static int is_same_inode(const struct file *f, const struct stat *sb,
+			 const struct hdl_dir *dir, const char *name)
 {
-	const struct file *a = _a;
-	const struct file *b = _b;
-	int diff = 0;
-
-	if (diff == 0)
-		diff = CMP(a->st.st_dev, b->st.st_dev);
-	if (diff == 0)
-		diff = CMP(a->st.st_ino, b->st.st_ino);
+	if (f->st.dev != sb->st_dev || f->st.ino != sb->st_ino)
+		return FALSE;
 
 	/* If opts.respect_name is used, we will restrict a struct file to
 	 * contain only links with the same basename to keep the rest simple.
 	 */
-	if (diff == 0 && opts.respect_name)
-		diff = filename_strcmp(a, b);
-	if (diff == 0 && opts.respect_dir)
-		diff = dirname_strcmp(a, b);
+	if (opts.respect_name && strcmp(f->links->name, name) != 0)
+		return FALSE;
+	if (opts.respect_dir && dir_strcmp(f->links->dir, dir) != 0)
+		return FALSE;
 
-	return diff;
+	return TRUE;
+}
+
+static inline size_t inode_hash(dev_t dev, ino_t ino)
+{
+	uint64_t h = ((uint64_t) ino ^ ((uint64_t) dev << 32)) * 0x9E3779B97F4A7C15ULL;
+
+	return (size_t) (h >> 32) & (inodes_size - 1);
+}
+
+/**
+ * lookup_inode - Find the file in the inodes hash table
+ * @sb: The stat information of the file
+ * @dir: The directory of the file
+ * @name: The basename of the file
+ *
+ * Returns: the slot with the file, or an empty slot for the file
+ */
+static struct file **lookup_inode(const struct stat *sb,
+				  const struct hdl_dir *dir, const char *name)
+{
+	size_t i = inode_hash(sb->st_dev, sb->st_ino);
+
+	while (inodes[i] && !is_same_inode(inodes[i], sb, dir, name))
+		i = (i + 1) & (inodes_size - 1);
+	return &inodes[i];
+}
+
+/**
+ * grow_inodes - Resize the inodes hash table if necessary
+ */
+static void grow_inodes(void)
+{
+	struct file **old = inodes;
+	size_t i, oldsz = inodes_size;
+
+	if (inodes && inodes_count * 2 < inodes_size)
+		return;
+
+	inodes_size = oldsz ? oldsz * 2 : 1024;
+	inodes = xcalloc(inodes_size, sizeof(struct file *));
+
+	for (i = 0; i < oldsz; i++) {
+		struct file *f = old[i];
+		size_t x;
+
+		if (!f)
+			continue;
+		x = inode_hash(f->st.dev, f->st.ino);
+		while (inodes[x])
+			x = (x + 1) & (inodes_size - 1);
+		inodes[x] = f;
+	}
+	free(old);
+}
+
+/**
+ * arena_alloc - Allocate zeroed memory for data never freed
+ * @sz: The size
+ */
+static void *arena_alloc(size_t sz)
+{
+	void *p;
+
+	sz = (sz + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+	if (sz > arena_left) {
+		size_t chunk = max(sz, (size_t) ARENA_CHUNKSZ);
+
+		arena = xcalloc(1, chunk);
+		arena_left = chunk;
+	}
+
+	p = arena;
+	arena += sz;
+	arena_left -= sz;
+	return p;
 }
 
 /**
@@ -392,6 +604,11 @@ static void print_stats(void)
 	     opts.dry_run ? _("dry-run") : _("real"));
 	jlog(JLOG_SUMMARY, "%-25s %s", _("Method:"), opts.method);
 	jlog(JLOG_SUMMARY, "%-25s %zu", _("Files:"), stats.files);
+#ifdef USE_DEDUPE
+	if (dedupe_mode)
+		jlog(JLOG_SUMMARY, _("%-25s %zu files"), _("Deduplicated:"), stats.linked);
+	else
+#endif
 	jlog(JLOG_SUMMARY, _("%-25s %zu files"), _("Linked:"), stats.linked);
 
 #ifdef USE_XATTR
@@ -549,7 +766,9 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
 	jlog(JLOG_VERBOSE1, _("Comparing xattrs of %s to %s"), a->links->path,
 	     b->links->path);
 
+	pthread_mutex_lock(&hdl_lock);
 	stats.xattr_comparisons++;
+	pthread_mutex_unlock(&hdl_lock);
 
 	len_a = llistxattr_or_die(a->links->path, NULL, 0);
 	len_b = llistxattr_or_die(b->links->path, NULL, 0);
@@ -639,15 +858,15 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
  */
 static int file_may_link_to(const struct file *a, const struct file *b)
 {
-	return (a->st.st_size != 0 &&
-		a->st.st_size == b->st.st_size &&
+	return (a->st.size != 0 &&
+		a->st.size == b->st.size &&
 		a->links != NULL && b->links != NULL &&
-		a->st.st_dev == b->st.st_dev &&
-		a->st.st_ino != b->st.st_ino &&
-		(!opts.respect_mode || a->st.st_mode == b->st.st_mode) &&
-		(!opts.respect_owner || a->st.st_uid == b->st.st_uid) &&
-		(!opts.respect_owner || a->st.st_gid == b->st.st_gid) &&
-		(!opts.respect_time || a->st.st_mtime == b->st.st_mtime) &&
+		a->st.dev == b->st.dev &&
+		a->st.ino != b->st.ino &&
+		(!opts.respect_mode || a->st.mode == b->st.mode) &&
+		(!opts.respect_owner || a->st.uid == b->st.uid) &&
+		(!opts.respect_owner || a->st.gid == b->st.gid) &&
+		(!opts.respect_time || a->st.mtime.tv_sec == b->st.mtime.tv_sec) &&
 		(!opts.respect_name || filename_strcmp(a, b) == 0) &&
 		(!opts.respect_dir || dirname_strcmp(a, b) == 0) &&
 		(!opts.respect_xattrs || file_xattrs_equal(a, b)));
@@ -665,18 +884,18 @@ static int file_may_link_to(const struct file *a, const struct file *b)
 static int file_compare(const struct file *a, const struct file *b)
 {
 	int res = 0;
-	if (a->st.st_dev == b->st.st_dev && a->st.st_ino == b->st.st_ino)
+	if (a->st.dev == b->st.dev && a->st.ino == b->st.ino)
 		return 0;
 
 	if (res == 0 && opts.maximise)
-		res = CMP(a->st.st_nlink, b->st.st_nlink);
+		res = CMP(a->st.nlink, b->st.nlink);
 	if (res == 0 && opts.minimise)
-		res = CMP(b->st.st_nlink, a->st.st_nlink);
+		res = CMP(b->st.nlink, a->st.nlink);
 	if (res == 0)
-		res = opts.keep_oldest ? CMP(b->st.st_mtime, a->st.st_mtime)
-		    : CMP(a->st.st_mtime, b->st.st_mtime);
+		res = opts.keep_oldest ? CMP(b->st.mtime.tv_sec, a->st.mtime.tv_sec)
+		    : CMP(a->st.mtime.tv_sec, b->st.mtime.tv_sec);
 	if (res == 0)
-		res = CMP(b->st.st_ino, a->st.st_ino);
+		res = CMP(b->st.ino, a->st.ino);
 
 	return res;
 }
@@ -691,9 +910,9 @@ static inline int do_link(struct file *a, struct file *b,
 		dest = open(new_name, O_CREAT|O_WRONLY|O_TRUNC, 0600);
 		if (dest < 0)
 			goto fallback;
-		if (fchmod(dest, b->st.st_mode) != 0)
+		if (fchmod(dest, b->st.mode) != 0)
 			goto fallback;
-		if (fchown(dest, b->st.st_uid, b->st.st_gid) != 0)
+		if (fchown(dest, b->st.uid, b->st.gid) != 0)
 			goto fallback;
 		src = open(a->links->path, O_RDONLY);
 		if (src < 0)
@@ -747,7 +966,7 @@ static int file_link(struct file *a, struct file *b, int reflink)
 	if (is_log_enabled(JLOG_INFO)) {
 		char *ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
 				   SIZE_SUFFIX_SPACE |
-				   SIZE_DECIMAL_2DIGITS, a->st.st_size);
+				   SIZE_DECIMAL_2DIGITS, a->st.size);
 		jlog(JLOG_INFO, _("%s%sLinking %s to %s (-%s)"),
 		     opts.dry_run ? _("[DryRun] ") : "",
 		     reflink ? "Ref" : "",
@@ -776,15 +995,16 @@ static int file_link(struct file *a, struct file *b, int reflink)
 			return FALSE;
 	}
 
-	/* Update statistics */
-	stats.linked++;
-
 	/* Increase the link count of this file, and set stat() of other file */
-	a->st.st_nlink++;
-	b->st.st_nlink--;
+	a->st.nlink++;
+	b->st.nlink--;
 
-	if (b->st.st_nlink == 0)
-		stats.saved += a->st.st_size;
+	/* Update statistics */
+	pthread_mutex_lock(&hdl_lock);
+	stats.linked++;
+	if (b->st.nlink == 0)
+		stats.saved += a->st.size;
+	pthread_mutex_unlock(&hdl_lock);
 
 	/* Move the link from file b to a */
 	{
@@ -802,18 +1022,153 @@ static int file_link(struct file *a, struct file *b, int reflink)
 	return TRUE;
 }
 
-static int has_fpath(struct file *node, const char *path)
+#ifdef USE_DEDUPE
+/**
+ * file_dedupe - Share extents of the files with master
+ * @a: The master file
+ * @bs: The files with the same content as @a
+ * @n: Number of the files, at most DEDUPE_MAXDESTS
+ *
+ * Unlike file_link(), the files are not replaced, only their data blocks are
+ * shared with @a by FIDEDUPERANGE. The kernel compares the data itself and
+ * refuses to deduplicate different content.
+ */
+static void file_dedupe(struct file *a, struct file **bs, size_t n)
+{
+	struct file_dedupe_range *range = NULL;
+	struct file *active[DEDUPE_MAXDESTS];
+	int fds[DEDUPE_MAXDESTS];
+	off_t off = 0;
+	size_t i, nactive = 0;
+	int src;
+
+	assert(n <= DEDUPE_MAXDESTS);
+
+	for (i = 0; i < n; i++) {
+		jlog(JLOG_INFO, _("%sDeduplicating %s to %s"),
+		     opts.dry_run ? _("[DryRun] ") : "",
+		     a->links->path, bs[i]->links->path);
+	}
+
+	if (opts.dry_run) {
+		nactive = n;
+		memcpy(active, bs, n * sizeof(struct file *));
+		goto done;
+	}
+
+	src = open(a->links->path, O_RDONLY);
+	if (src < 0) {
+		warn(_("cannot open %s"), a->links->path);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		fds[nactive] = open(bs[i]->links->path, O_RDONLY);
+		if (fds[nactive] < 0) {
+			warn(_("cannot open %s"), bs[i]->links->path);
+			continue;
+		}
+		active[nactive++] = bs[i];
+	}
+
+	range = xcalloc(1, sizeof(*range) + n * sizeof(struct file_dedupe_range_info));
+
+	while (nactive && off < a->st.size) {
+		size_t x;
+
+		range->src_offset = off;
+		range->src_length = min((off_t) DEDUPE_CHUNKSZ, a->st.size - off);
+		range->dest_count = nactive;
+
+		for (i = 0; i < nactive; i++) {
+			memset(&range->info[i], 0, sizeof(range->info[i]));
+			range->info[i].dest_fd = fds[i];
+			range->info[i].dest_offset = off;
+		}
+
+		if (ioctl(src, FIDEDUPERANGE, range) != 0) {
+			warn(_("cannot deduplicate %s"), a->links->path);
+			break;
+		}
+
+		/* drop files which cannot be deduplicated */
+		for (i = 0, x = 0; i < nactive; i++) {
+			struct file_dedupe_range_info *info = &range->info[i];
+
+			if (info->status < 0) {
+				errno = -info->status;
+				warn(_("cannot deduplicate %s to %s"),
+					a->links->path, active[i]->links->path);
+			} else if (info->status == FILE_DEDUPE_RANGE_DIFFERS
+				   || info->bytes_deduped != range->src_length) {
+				jlog(JLOG_VERBOSE1, _("Skipped (content changed) %s"),
+					active[i]->links->path);
+			} else {
+				fds[x] = fds[i];
+				active[x++] = active[i];
+				continue;
+			}
+			close(fds[i]);
+		}
+		nactive = x;
+		off += range->src_length;
+	}
+
+	for (i = 0; i < nactive; i++)
+		close(fds[i]);
+	close(src);
+	free(range);
+done:
+	pthread_mutex_lock(&hdl_lock);
+	for (i = 0; i < nactive; i++) {
+		stats.linked++;
+		stats.saved += a->st.size;
+	}
+	pthread_mutex_unlock(&hdl_lock);
+
+	for (i = 0; i < nactive; i++)
+		active[i]->deduped = 1;
+}
+#endif /* USE_DEDUPE */
+
+static int has_fpath(struct file *node, const struct hdl_dir *dir, const char *name)
 {
 	struct link *l;
 
 	for (l = node->links; l; l = l->next) {
-		if (strcmp(l->path, path) == 0)
+		if (l->dir != dir && (l->dir->len != dir->len
+				      || memcmp(l->dir->path, dir->path, dir->len) != 0))
+			continue;
+		if (strcmp(l->name, name) == 0)
 			return 1;
 	}
 
 	return 0;
 }
 
+/**
+ * get_dir - Get the directory of the file being visited
+ * @fpath: The path of the file being visited
+ * @ftwbuf: Contains current level of nesting and offset of basename
+ *
+ * The directory is allocated on the first file from the directory. The
+ * nftw() calls inserter() for a directory before its content, so
+ * the directory at the next level is reset there.
+ */
+static struct hdl_dir *get_dir(const char *fpath, const struct FTW *ftwbuf)
+{
+	struct hdl_dir *dir = dirs[ftwbuf->level];
+
+	if (!dir) {
+		dir = arena_alloc(sizeof(struct hdl_dir) + ftwbuf->base + 1);
+		dir->dirname = rootbasesz;
+		dir->len = ftwbuf->base;
+		memcpy(dir->path, fpath, ftwbuf->base);
+		dir->path[ftwbuf->base] = '\0';
+		dirs[ftwbuf->level] = dir;
+	}
+	return dir;
+}
 
 /**
  * inserter - Callback function for nftw()
@@ -828,9 +1183,10 @@ static int has_fpath(struct file *node, const char *path)
 static int inserter(const char *fpath, const struct stat *sb,
 		    int typeflag, struct FTW *ftwbuf)
 {
-	struct file *fil;
-	struct file **node;
-	size_t pathlen;
+	struct file *fil, **slot, **node;
+	struct hdl_dir *dir;
+	struct link *link;
+	const char *name = fpath + ftwbuf->base;
 	int included;
 	int excluded;
 
@@ -838,6 +1194,15 @@ static int inserter(const char *fpath, const struct stat *sb,
 		return 1;
 	if (typeflag == FTW_DNR || typeflag == FTW_NS)
 		warn(_("cannot read %s"), fpath);
+	if (typeflag == FTW_D) {
+		if ((size_t) ftwbuf->level + 1 >= dirs_size) {
+			dirs = xreallocarray(dirs, dirs_size + 32, sizeof(struct hdl_dir *));
+			memset(dirs + dirs_size, 0, 32 * sizeof(struct hdl_dir *));
+			dirs_size += 32;
+		}
+		dirs[ftwbuf->level + 1] = NULL;
+		return 0;
+	}
 	if (typeflag != FTW_F || !S_ISREG(sb->st_mode))
 		return 0;
 
@@ -866,62 +1231,67 @@ static int inserter(const char *fpath, const struct stat *sb,
 		return 0;
 	}
 
-	pathlen = strlen(fpath) + 1;
+	dir = get_dir(fpath, ftwbuf);
+
+	grow_inodes();
+	slot = lookup_inode(sb, dir, name);
 
-	fil = xcalloc(1, sizeof(*fil));
-	fil->links = xcalloc(1, sizeof(struct link) + pathlen);
+	if (*slot) {
+		/* Already known inode, add link to inode information */
+		if (has_fpath(*slot, dir, name)) {
+			jlog(JLOG_VERBOSE1,
+				_("Skipped %s (specified more than once)"), fpath);
+			return 0;
+		}
+		link = arena_alloc(sizeof(struct link) + strlen(name) + 1);
+		link->dir = dir;
+		strcpy(link->name, name);
 
-	fil->st = *sb;
-	fil->links->basename = ftwbuf->base;
-	fil->links->dirname = rootbasesz;
-	fil->links->next = NULL;
+		link->next = (*slot)->links;
+		(*slot)->links = link;
+		return 0;
+	}
 
-	memcpy(fil->links->path, fpath, pathlen);
+	/* New inode, insert into by-size table */
+	fil = arena_alloc(sizeof(*fil));
+	fil->links = link = arena_alloc(sizeof(struct link) + strlen(name) + 1);
+	link->dir = dir;
+	strcpy(link->name, name);
 
-	node = tsearch(fil, &files_by_ino, compare_nodes_ino);
+	fil->st.dev = sb->st_dev;
+	fil->st.ino = sb->st_ino;
+	fil->st.size = sb->st_size;
+	fil->st.nlink = sb->st_nlink;
+	fil->st.mtime = sb->st_mtim;
+	fil->st.ctime = sb->st_ctim;
+	fil->st.mode = sb->st_mode;
+	fil->st.uid = sb->st_uid;
+	fil->st.gid = sb->st_gid;
+
+	*slot = fil;
+	inodes_count++;
+
+	node = tsearch(fil, &files, compare_nodes);
 
 	if (node == NULL)
 		goto fail;
 
 	if (*node != fil) {
-		/* Already known inode, add link to inode information */
-		assert((*node)->st.st_dev == sb->st_dev);
-		assert((*node)->st.st_ino == sb->st_ino);
+		struct file *l;
 
-		if (has_fpath(*node, fpath)) {
-			jlog(JLOG_VERBOSE1,
-				_("Skipped %s (specified more than once)"), fpath);
-			free(fil->links);
+		if (file_compare(fil, *node) >= 0) {
+			fil->next = *node;
+			*node = fil;
 		} else {
-			fil->links->next = (*node)->links;
-			(*node)->links = fil->links;
-		}
+			for (l = *node; l != NULL; l = l->next) {
+				if (l->next != NULL
+				    && file_compare(fil, l->next) < 0)
+					continue;
 
-		free(fil);
-	} else {
-		/* New inode, insert into by-size table */
-		node = tsearch(fil, &files, compare_nodes);
+				fil->next = l->next;
+				l->next = fil;
 
-		if (node == NULL)
-			goto fail;
-
-		if (*node != fil) {
-			struct file *l;
-
-			if (file_compare(fil, *node) >= 0) {
-				fil->next = *node;
-				*node = fil;
-			} else {
-				for (l = *node; l != NULL; l = l->next) {
-					if (l->next != NULL
-					    && file_compare(fil, l->next) < 0)
-						continue;
-
-					fil->next = l->next;
-					l->next = fil;
-
-					break;
-				}
+				break;
 			}
 		}
 	}
@@ -938,12 +1308,14 @@ static int is_reflink_compatible(dev_t devno, const char *filename)
 {
 	static dev_t last_dev = 0;
 	static int last_status = 0;
+	int status = 0;
 
+	pthread_mutex_lock(&hdl_lock);
 	if (last_dev != devno) {
 		struct statfs vfs;
 
 		if (statfs(filename, &vfs) != 0)
-			return 0;
+			goto done;
 
 		last_dev = devno;
 		switch (vfs.f_type) {
@@ -956,8 +1328,10 @@ static int is_reflink_compatible(dev_t devno, const char *filename)
 				break;
 		}
 	}
-
-	return last_status;
+	status = last_status;
+done:
+	pthread_mutex_unlock(&hdl_lock);
+	return status;
 }
 
 static int is_reflink(struct file *xa, struct file *xb)
@@ -1035,64 +1409,421 @@ static inline size_t count_nodes(struct file *x)
 	return ct;
 }
 
-/**
- * visitor - Callback for twalk()
- * @nodep: Pointer to a pointer to a #struct file
- * @which: At which point this visit is (preorder, postorder, endorder)
- * @depth: The depth of the node in the tree
+static int compare_digest_entries(const void *_a, const void *_b)
+{
+	const struct digest_entry *a = _a, *b = _b;
+
+	if (a->ino != b->ino)
+		return CMP(a->ino, b->ino);
+	return CMP(a->dev, b->dev);
+}
+
+static void free_digest_entry(void *_e)
+{
+	struct digest_entry *e = _e;
+
+	free(e->digests);
+	free(e);
+}
+
+static inline int timespec_equal(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+static int digest_entry_match(const struct digest_entry *e, const struct hdl_stat *st)
+{
+	return e->size == st->size
+		&& timespec_equal(&e->mtime, &st->mtime)
+		&& timespec_equal(&e->ctime, &st->ctime);
+}
+
+static int parse_hex(const char *str, unsigned char *buf, size_t bufsz)
+{
+	size_t i;
+
+	for (i = 0; i < bufsz; i++) {
+		int hi, lo;
+
+		if (!isxdigit(str[0]) || !isxdigit(str[1]))
+			return -1;
+		hi = isdigit(str[0]) ? str[0] - '0' : tolower(str[0]) - 'a' + 10;
+		lo = isdigit(str[1]) ? str[1] - '0' : tolower(str[1]) - 'a' + 10;
+		buf[i] = (hi << 4) | lo;
+		str += 2;
+	}
+	return 0;
+}
+
+static void fputs_hex(const unsigned char *buf, size_t bufsz, FILE *f)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t i;
+
+	for (i = 0; i < bufsz; i++) {
+		fputc(hex[buf[i] >> 4], f);
+		fputc(hex[buf[i] & 0x0f], f);
+	}
+}
+
+/*
+ * Parse one line of the cache file:
  *
- * Visit the nodes in the binary tree. For each node, call hardlinker()
- * on each #struct file in the linked list of #struct file instances located
- * at that node.
+ *  <dev> <ino> <size> <mtime> <ctime> <readsiz> <nblocks> <eof> <intro> <digests>
+ *
+ * where times are <sec>.<nsec>, intro and digests are in hex, and digests is
+ * "-" if there is only the intro.
  */
-static void visitor(const void *nodep, const VISIT which, const int depth)
+static struct digest_entry *parse_digest_entry(const char *line, size_t digsiz)
 {
-	struct file *master = *(struct file **)nodep;
-	struct file *begin = master;
-	struct file *other;
+	struct digest_entry *e = xcalloc(1, sizeof(*e));
+	uintmax_t dev, ino;
+	intmax_t size, msec, csec;
+	long mnsec, cnsec;
+	int eof, n = 0;
+	size_t sz;
+
+	if (sscanf(line, "%ju %ju %jd %jd.%ld %jd.%ld %zu %zu %d %n",
+		   &dev, &ino, &size, &msec, &mnsec, &csec, &cnsec,
+		   &e->readsiz, &e->nblocks, &eof, &n) != 10 || !n
+	    || e->nblocks == 0 || !e->readsiz)
+		goto fail;
 
-	(void)depth;
+	e->dev = dev;
+	e->ino = ino;
+	e->size = size;
+	e->mtime.tv_sec = msec;
+	e->mtime.tv_nsec = mnsec;
+	e->ctime.tv_sec = csec;
+	e->ctime.tv_nsec = cnsec;
+	e->eof = eof ? 1 : 0;
+
+	line += n;
+	if (parse_hex(line, e->intro, sizeof(e->intro)) != 0)
+		goto fail;
+	line += sizeof(e->intro) * 2;
+	if (*line++ != ' ')
+		goto fail;
 
-	if (which != leaf && which != endorder)
+	if (e->nblocks > 1) {
+		if (e->size < 0
+		    || e->nblocks - 1 > ((uintmax_t) e->size + e->readsiz) / e->readsiz)
+			goto fail;
+		sz = (e->nblocks - 1) * digsiz;
+		if (strlen(line) < sz * 2)
+			goto fail;
+		e->digests = xmalloc(sz);
+		if (parse_hex(line, e->digests, sz) != 0)
+			goto fail;
+	}
+	return e;
+fail:
+	free_digest_entry(e);
+	return NULL;
+}
+
+/**
+ * load_digest_cache - Read digests from the previous runs
+ * @digsiz: The size of one digest
+ */
+static void load_digest_cache(size_t digsiz)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t sz = 0, ln = 0;
+	ssize_t len;
+
+	f = fopen(opts.digest_cache, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), opts.digest_cache);
 		return;
+	}
 
-	for (; master != NULL; master = master->next) {
-		size_t nnodes, memsiz;
-		int may_reflink = 0;
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		struct digest_entry *e, **x;
 
-		if (handle_interrupt())
-			exit(EXIT_FAILURE);
-		if (master->links == NULL)
+		if (len && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		ln++;
+
+		/* the first line is magic, the second is method; the cache is
+		 * useless for another method */
+		if (ln == 1 && strcmp(line, DIGEST_CACHE_MAGIC) != 0)
+			break;
+		if (ln == 2 && strcmp(line, opts.method) != 0)
+			break;
+		if (ln <= 2)
 			continue;
 
-		/* calculate per file max memory use */
-		nnodes = count_nodes(master);
-		if (!nnodes)
+		e = parse_digest_entry(line, digsiz);
+		if (!e) {
+			jlog(JLOG_VERBOSE1, _("%s: ignore malformed line %zu"),
+					opts.digest_cache, ln);
 			continue;
+		}
+		x = tsearch(e, &digests, compare_digest_entries);
+		if (!x)
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
+		if (*x != e)
+			free_digest_entry(e);
+	}
+
+	free(line);
+	fclose(f);
+}
+
+static void save_digest_entry(const void *nodep, const VISIT which, const int depth)
+{
+	const struct digest_entry *e = *(struct digest_entry **)nodep;
+
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+	if (!e->used)
+		return;
+
+	fprintf(digests_out, "%ju %ju %jd %jd.%09ld %jd.%09ld %zu %zu %d ",
+			(uintmax_t) e->dev, (uintmax_t) e->ino, (intmax_t) e->size,
+			(intmax_t) e->mtime.tv_sec, e->mtime.tv_nsec,
+			(intmax_t) e->ctime.tv_sec, e->ctime.tv_nsec,
+			e->readsiz, e->nblocks, e->eof ? 1 : 0);
+	fputs_hex(e->intro, sizeof(e->intro), digests_out);
+	fputc(' ', digests_out);
+	if (e->nblocks > 1)
+		fputs_hex(e->digests, (e->nblocks - 1) * ul_fileeq_get_digsiz(&fileeq), digests_out);
+	else
+		fputc('-', digests_out);
+	fputc('\n', digests_out);
+}
+
+/**
+ * save_digest_cache - Write digests of the files from this run
+ *
+ * The cache is replaced atomically, the entries for the files which have not
+ * been seen are dropped.
+ */
+static void save_digest_cache(void)
+{
+	char *tmp;
+	int fd;
+
+	xasprintf(&tmp, "%s.XXXXXX", opts.digest_cache);
+
+	fd = mkstemp(tmp);
+	if (fd < 0 || !(digests_out = fdopen(fd, "w"))) {
+		warn(_("cannot create %s"), tmp);
+		if (fd >= 0)
+			close(fd);
+		goto done;
+	}
+
+	fputs(DIGEST_CACHE_MAGIC "\n", digests_out);
+	fprintf(digests_out, "%s\n", opts.method);
+	twalk(digests, save_digest_entry);
+
+	if (close_stream(digests_out) != 0) {
+		warn(_("write failed: %s"), tmp);
+		unlink(tmp);
+	} else if (rename(tmp, opts.digest_cache) != 0) {
+		warn(_("cannot rename %s to %s"), tmp, opts.digest_cache);
+		unlink(tmp);
+	}
+	digests_out = NULL;
+done:
+	free(tmp);
+}
+
+/**
+ * associate_file - Prepare file for content comparison
+ * @eq: The comparison context
+ * @f: The file
+ *
+ * Use digests from the cache if the file has not been modified since the
+ * previous run.
+ */
+static void associate_file(struct ul_fileeq *eq, struct file *f)
+{
+	struct digest_entry key = { .dev = f->st.dev, .ino = f->st.ino }, **x, *e;
+
+	f->data = xmalloc(sizeof(*f->data));
+	ul_fileeq_data_set_file(f->data, f->links->path);
+
+	if (!opts.digest_cache)
+		return;
+
+	pthread_mutex_lock(&hdl_lock);
+	x = tfind(&key, &digests, compare_digest_entries);
+	e = x ? *x : NULL;
+
+	if (e && digest_entry_match(e, &f->st) && e->readsiz == eq->readsiz
+	    && ul_fileeq_data_set_cached(eq, f->data, e->intro, e->digests,
+					 e->nblocks, e->eof) == 0)
+		e->used = 1;
+	pthread_mutex_unlock(&hdl_lock);
+}
+
+/**
+ * release_file - Free file content comparison data
+ * @eq: The comparison context
+ * @f: The file
+ *
+ * Update the digests in the cache. Does nothing if the file has not been
+ * associated.
+ */
+static void release_file(struct ul_fileeq *eq, struct file *f)
+{
+	struct digest_entry key = { .dev = f->st.dev, .ino = f->st.ino }, **x, *e;
+	unsigned char *data = NULL;
+	size_t nblocks;
+	bool eof = false;
+
+	if (!f->data)
+		return;
+
+	/* ignore files replaced by links */
+	if (!opts.digest_cache || (!f->links && !opts.dry_run))
+		goto done;
+
+	nblocks = ul_fileeq_data_get_cached(eq, f->data, &data, &eof);
+	if (!nblocks)
+		goto done;
+
+	pthread_mutex_lock(&hdl_lock);
+	x = tsearch(&key, &digests, compare_digest_entries);
+	if (!x)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	if (*x == &key)
+		*x = e = xcalloc(1, sizeof(*e));
+	else
+		e = *x;
+
+	if (!e->used || e->nblocks < nblocks || e->readsiz != eq->readsiz) {
+		size_t sz = (nblocks - 1) * ul_fileeq_get_digsiz(eq);
+
+		e->dev = f->st.dev;
+		e->ino = f->st.ino;
+		e->size = f->st.size;
+		e->mtime = f->st.mtime;
+		e->ctime = f->st.ctime;
+		e->readsiz = eq->readsiz;
+		e->nblocks = nblocks;
+		e->eof = eof ? 1 : 0;
+		e->used = 1;
+		memcpy(e->intro, f->data->intro, sizeof(e->intro));
+
+		free(e->digests);
+		e->digests = NULL;
+		if (sz) {
+			e->digests = xmalloc(sz);
+			memcpy(e->digests, data, sz);
+		}
+	}
+	pthread_mutex_unlock(&hdl_lock);
+done:
+	ul_fileeq_data_deinit(f->data);
+	free(f->data);
+	f->data = NULL;
+}
+
+/**
+ * get_paths - Allocate paths for all the links of the files
+ * @begin: The first #struct file in the list of files with the same size
+ */
+static void get_paths(struct file *begin)
+{
+	struct file *f;
+	struct link *l;
+
+	for (f = begin; f != NULL; f = f->next) {
+		for (l = f->links; l; l = l->next)
+			xasprintf(&l->path, "%s%s", l->dir->path, l->name);
+	}
+}
+
+/**
+ * put_paths - Free paths allocated by get_paths()
+ * @begin: The first #struct file in the list of files with the same size
+ *
+ * Note that file_link() moves links between the files of the list.
+ */
+static void put_paths(struct file *begin)
+{
+	struct file *f;
+	struct link *l;
 
-		/* per-file cache size */
-		memsiz = opts.cache_size / nnodes;
-		/*                                filesiz,      readsiz,      memsiz */
-		ul_fileeq_set_size(&fileeq, master->st.st_size, opts.io_size, memsiz);
+	for (f = begin; f != NULL; f = f->next) {
+		for (l = f->links; l; l = l->next) {
+			free(l->path);
+			l->path = NULL;
+		}
+	}
+}
+
+/**
+ * link_group - Link identical files of the same size
+ * @eq: The comparison context
+ * @begin: The first #struct file in the list of files with the same size
+ *
+ * Returns: -1 on SIGINT or SIGTERM, 0 otherwise.
+ */
+static int link_group(struct ul_fileeq *eq, struct file *begin)
+{
+	struct file *master = begin;
+	struct file *other;
+	size_t nnodes, memsiz;
+	int rc = 0;
+
+	/* calculate per file max memory use; the same sizes for all the group,
+	 * the cached digests are not compatible with another I/O size */
+	nnodes = count_nodes(begin);
+	memsiz = opts.cache_size / opts.jobs / nnodes;
+	/*                           filesiz,      readsiz,      memsiz */
+	ul_fileeq_set_size(eq, begin->st.size, opts.io_size, memsiz);
+
+	get_paths(begin);
+
+	for (; master != NULL; master = master->next) {
+		int may_reflink = 0;
+#ifdef USE_DEDUPE
+		struct file *batch[DEDUPE_MAXDESTS];
+		size_t nbatch = 0;
+#endif
+		if (handle_interrupt()) {
+			rc = -1;
+			break;
+		}
+		if (master->links == NULL || master->deduped)
+			continue;
 
 #ifdef USE_REFLINK
 		if (reflink_mode || reflinks_skip) {
 			may_reflink =
 				reflink_mode == REFLINK_ALWAYS ? 1 :
-				is_reflink_compatible(master->st.st_dev,
+				is_reflink_compatible(master->st.dev,
 							    master->links->path);
 		}
+#endif
+#ifdef USE_DEDUPE
+		if (dedupe_mode && !may_reflink) {
+			jlog(JLOG_VERBOSE1,
+			     _("Skipped (deduplication not supported) %s"), master->links->path);
+			continue;
+		}
 #endif
 		for (other = master->next; other != NULL; other = other->next) {
-			int eq;
+			int same;
 
-			if (handle_interrupt())
-				exit(EXIT_FAILURE);
+			if (handle_interrupt()) {
+				rc = -1;
+				break;
+			}
 
 			assert(other != other->next);
-			assert(other->st.st_size == master->st.st_size);
+			assert(other->st.size == master->st.size);
 
-			if (!other->links)
+			if (!other->links || other->deduped)
 				continue;
 
 			/* check file attributes, etc. */
@@ -1105,46 +1836,173 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 			if (may_reflink && reflinks_skip && is_reflink(master, other)) {
 				jlog(JLOG_VERBOSE2,
 				     _("Skipped (already reflink) %s"), other->links->path);
+				pthread_mutex_lock(&hdl_lock);
 				stats.ignored_reflinks++;
+				pthread_mutex_unlock(&hdl_lock);
 				continue;
 			}
 #endif
 			/* initialize content comparison */
-			if (!ul_fileeq_data_associated(&master->data))
-				ul_fileeq_data_set_file(&master->data, master->links->path);
-			if (!ul_fileeq_data_associated(&other->data))
-				ul_fileeq_data_set_file(&other->data, other->links->path);
+			if (!master->data)
+				associate_file(eq, master);
+			if (!other->data)
+				associate_file(eq, other);
 
 			/* compare files */
-			eq = ul_fileeq(&fileeq, &master->data, &other->data);
+			same = ul_fileeq(eq, master->data, other->data);
 
 			/* reduce number of open files, keep only master open */
-			ul_fileeq_data_close_file(&other->data);
+			ul_fileeq_data_close_file(other->data);
 
+			pthread_mutex_lock(&hdl_lock);
 			stats.comparisons++;
+			pthread_mutex_unlock(&hdl_lock);
 
-			if (!eq) {
+			if (!same) {
 				jlog(JLOG_VERBOSE2,
 				     _("Skipped (content mismatch) %s"), other->links->path);
 				continue;
 			}
 
+#ifdef USE_DEDUPE
+			if (dedupe_mode) {
+				batch[nbatch++] = other;
+				if (nbatch == DEDUPE_MAXDESTS) {
+					file_dedupe(master, batch, nbatch);
+					nbatch = 0;
+				}
+				continue;
+			}
+#endif
 			/* link files */
 			if (!file_link(master, other, may_reflink) && errno == EMLINK) {
-				ul_fileeq_data_deinit(&master->data);
+				release_file(eq, master);
 				master = other;
 			}
 		}
+#ifdef USE_DEDUPE
+		if (nbatch)
+			file_dedupe(master, batch, nbatch);
+#endif
 
 		/* don't keep master data in memory */
-		ul_fileeq_data_deinit(&master->data);
+		release_file(eq, master);
+		if (rc)
+			break;
 	}
 
 	/* final cleanup */
-	for (other = begin; other != NULL; other = other->next) {
-		if (ul_fileeq_data_associated(&other->data))
-			ul_fileeq_data_deinit(&other->data);
+	for (other = begin; other != NULL; other = other->next)
+		release_file(eq, other);
+
+	put_paths(begin);
+	return rc;
+}
+
+/**
+ * visitor - Callback for twalk()
+ * @nodep: Pointer to a pointer to a #struct file
+ * @which: At which point this visit is (preorder, postorder, endorder)
+ * @depth: The depth of the node in the tree
+ *
+ * Visit the nodes in the binary tree. For each node, call link_group()
+ * on the linked list of #struct file instances located at that node, or
+ * queue the list for the threads if --jobs is used.
+ */
+static void visitor(const void *nodep, const VISIT which, const int depth)
+{
+	struct file *begin = *(struct file **)nodep;
+
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	if (opts.jobs > 1) {
+		/* a single file has nothing to be linked to */
+		if (!begin->next)
+			return;
+		if (ngroups % 256 == 0)
+			groups = xreallocarray(groups, ngroups + 256, sizeof(struct file *));
+		groups[ngroups++] = begin;
+		return;
 	}
+
+	if (link_group(&fileeq, begin) != 0)
+		exit(EXIT_FAILURE);
+}
+
+/**
+ * link_worker - Thread function for --jobs
+ * @data: Unused
+ *
+ * Process the queued groups of files until the queue is empty. Every thread
+ * uses its own comparison context (buffers, crypto sockets).
+ *
+ * Returns: NULL
+ */
+static void *link_worker(void *data __attribute__((__unused__)))
+{
+	struct ul_fileeq eq;
+
+	if (ul_fileeq_init(&eq, opts.method) != 0) {
+		warn(_("failed to initialize files comparior"));
+		return NULL;
+	}
+
+	for (;;) {
+		struct file *begin = NULL;
+
+		pthread_mutex_lock(&hdl_lock);
+		if (groups_next < ngroups)
+			begin = groups[groups_next++];
+		pthread_mutex_unlock(&hdl_lock);
+
+		if (!begin || link_group(&eq, begin) != 0)
+			break;
+	}
+
+	ul_fileeq_deinit(&eq);
+	return NULL;
+}
+
+/**
+ * run_jobs - Compare and link the queued groups by opts.jobs threads
+ */
+static void run_jobs(void)
+{
+	pthread_t *threads;
+	size_t i, n = 0;
+
+	if (!ngroups)
+		return;
+
+	threads = xcalloc(opts.jobs, sizeof(pthread_t));
+
+	for (i = 0; i < opts.jobs && i < ngroups; i++) {
+		int rc = pthread_create(&threads[n], NULL, link_worker, NULL);
+
+		if (rc != 0) {
+			errno = rc;
+			warn(_("failed to create thread"));
+			break;
+		}
+		n++;
+	}
+
+	/* fallback, all in this thread */
+	if (!n)
+		link_worker(NULL);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(groups);
+	groups = NULL;
+
+	if (last_signal == SIGINT || last_signal == SIGTERM)
+		exit(EXIT_FAILURE);
 }
 
 /**
@@ -1165,9 +2023,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --content              compare only file contents, same as -pot\n"), out);
 	fputs(_(" -b, --io-size <size>       I/O buffer size for file reading\n"
 	        "                              (speedup, using more RAM)\n"), out);
+	fputs(_("     --digest-cache <file>  keep checksums between runs in the file\n"), out);
 	fputs(_(" -d, --respect-dir          directory names have to be identical\n"), out);
 	fputs(_(" -f, --respect-name         filenames have to be identical\n"), out);
 	fputs(_(" -i, --include <regex>      regular expression to include files/dirs\n"), out);
+	fputs(_(" -j, --jobs <num>           compare files by <num> threads\n"), out);
 	fputs(_(" -m, --maximize             maximize the hardlink count, remove the file with\n"
 	        "                              lowest hardlink count\n"), out);
 	fputs(_(" -M, --minimize             reverse the meaning of -m\n"), out);
@@ -1191,6 +2051,9 @@ static void __attribute__((__noreturn__)) usage(void)
 #ifdef USE_REFLINK
 	fputs(_("     --reflink[=<when>]     create clone/CoW copies (auto, always, never)\n"), out);
 	fputs(_("     --skip-reflinks        skip already cloned files (enabled on --reflink)\n"), out);
+#endif
+#ifdef USE_DEDUPE
+	fputs(_("     --dedupe               share data blocks rather than link files\n"), out);
 #endif
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(28));
@@ -1208,9 +2071,11 @@ static int parse_options(int argc, char *argv[])
 {
 	enum {
 		OPT_REFLINK = CHAR_MAX + 1,
-		OPT_SKIP_RELINKS
+		OPT_SKIP_RELINKS,
+		OPT_DIGEST_CACHE,
+		OPT_DEDUPE
 	};
-	static const char optstr[] = "VhvndfpotXcmMOx:y:i:r:S:s:b:q";
+	static const char optstr[] = "VhvndfpotXcmMOx:y:i:j:r:S:s:b:q";
 	static const struct option long_options[] = {
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -1227,21 +2092,29 @@ static int parse_options(int argc, char *argv[])
 		{"keep-oldest", no_argument, NULL, 'O'},
 		{"exclude", required_argument, NULL, 'x'},
 		{"include", required_argument, NULL, 'i'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"method", required_argument, NULL, 'y' },
 		{"minimum-size", required_argument, NULL, 's'},
 		{"maximum-size", required_argument, NULL, 'S'},
 #ifdef USE_REFLINK
 		{"reflink", optional_argument, NULL, OPT_REFLINK },
 		{"skip-reflinks", no_argument, NULL, OPT_SKIP_RELINKS },
+#endif
+#ifdef USE_DEDUPE
+		{"dedupe", no_argument, NULL, OPT_DEDUPE },
 #endif
 		{"io-size", required_argument, NULL, 'b'},
 		{"content", no_argument, NULL, 'c'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"cache-size", required_argument, NULL, 'r'},
+		{"digest-cache", required_argument, NULL, OPT_DIGEST_CACHE},
 		{NULL, 0, NULL, 0}
 	};
 	static const ul_excl_t excl[] = {
 		{'q', 'v'},
+#ifdef USE_DEDUPE
+		{OPT_REFLINK, OPT_DEDUPE},
+#endif
 		{0}
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -1300,6 +2173,11 @@ static int parse_options(int argc, char *argv[])
 		case 'i':
 			register_regex(&opts.include, optarg);
 			break;
+		case 'j':
+			opts.jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!opts.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
 		case 's':
 			opts.min_size = strtosize_or_err(optarg, _("failed to parse minimum size"));
 			break;
@@ -1312,6 +2190,9 @@ static int parse_options(int argc, char *argv[])
 		case 'b':
 			opts.io_size = strtosize_or_err(optarg, _("failed to parse I/O size"));
 			break;
+		case OPT_DIGEST_CACHE:
+			opts.digest_cache = optarg;
+			break;
 #ifdef USE_REFLINK
 		case OPT_REFLINK:
 			reflink_mode = REFLINK_AUTO;
@@ -1331,6 +2212,12 @@ static int parse_options(int argc, char *argv[])
 		case OPT_SKIP_RELINKS:
 			reflinks_skip = 1;
 			break;
+#endif
+#ifdef USE_DEDUPE
+		case OPT_DEDUPE:
+			dedupe_mode = 1;
+			reflinks_skip = 1;
+			break;
 #endif
 		case 'h':
 			usage();
@@ -1340,6 +2227,9 @@ static int parse_options(int argc, char *argv[])
 #ifdef USE_REFLINK
 				"reflink",
 #endif
+#ifdef USE_DEDUPE
+				"dedupe",
+#endif
 #ifdef USE_FILEEQ_CRYPTOAPI
 				"cryptoapi",
 #endif
@@ -1423,6 +2313,16 @@ int main(int argc, char *argv[])
 	if (rc < 0)
 		err(EXIT_FAILURE, _("failed to initialize files comparior"));
 
+	if (opts.digest_cache) {
+		size_t digsiz = ul_fileeq_get_digsiz(&fileeq);
+
+		if (!digsiz) {
+			warnx(_("the digest cache is not supported for the %s method"), opts.method);
+			opts.digest_cache = NULL;
+		} else
+			load_digest_cache(digsiz);
+	}
+
 	/* defautl I/O size */
 	if (!opts.io_size) {
 		if (strcmp(opts.method, "memcmp") == 0)
@@ -1443,13 +2343,29 @@ int main(int argc, char *argv[])
 		}
 		if (opts.respect_dir)
 			rootbasesz = strlen(path);
+		if (!dirs) {
+			dirs_size = 32;
+			dirs = xcalloc(dirs_size, sizeof(struct hdl_dir *));
+		}
+		dirs[0] = NULL;
 		if (nftw(path, inserter, 20, FTW_PHYS) == -1)
 			warn(_("cannot process %s"), path);
 		free(path);
 		rootbasesz = 0;
 	}
 
+	/* not needed for comparison */
+	free(inodes);
+	free(dirs);
+
 	twalk(files, visitor);
+	if (opts.jobs > 1)
+		run_jobs();
+
+	if (opts.digest_cache) {
+		save_digest_cache();
+		tdestroy(digests, free_digest_entry);
+	}
 
 	ul_fileeq_deinit(&fileeq);
 	return 0;
@@ -45,6 +45,8 @@
  */
 
 #include <ctype.h>		/* for isdigit() */
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,6 +64,7 @@
 #include "ttyutils.h"
 #include "xalloc.h"
 #include "fileutils.h"
+#include "all-io.h"
 
 /* partial success, otherwise we return regular EXIT_{SUCCESS,FAILURE} */
 #define KILL_EXIT_SOMEOK	64
@@ -81,10 +84,21 @@ struct timeouts {
 };
 #endif
 
+/* processes matching a name from the command line */
+struct kill_name {
+	const char *name;
+	pid_t *pids;
+	size_t npids;
+};
+
 struct kill_control {
 	char *arg;
 	pid_t pid;
 	int numsig;
+
+	const char **cgroups;	/* --cgroup paths */
+	size_t ncgroups;
+
 #ifdef HAVE_SIGQUEUE
 	union sigval sigdata;
 #endif
@@ -210,6 +224,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --timeout <milliseconds> <follow-up signal>\n"
 		"                        wait up to timeout and send follow-up signal\n"), out);
 #endif
+	fputs(_(" -c, --cgroup <path>    signal all processes in the cgroup and its descendants\n"), out);
 	fputs(_(" -p, --pid              print pids without signaling them\n"), out);
 	fputs(_(" -l, --list[=<signal>]  list signal names, or convert a signal number to a name\n"), out);
 	fputs(_(" -L, --table            list signal names and numbers\n"), out);
@@ -304,6 +319,15 @@ static char **parse_arguments(int argc, char **argv, struct kill_control *ctl)
 			print_all_signals(stdout, 1);
 			exit(EXIT_SUCCESS);
 		}
+		if (!strcmp(arg, "-c") || !strcmp(arg, "--cgroup")) {
+			if (argc < 2)
+				errx(EXIT_FAILURE, _("option '%s' requires an argument"), arg);
+			argc--, argv++;
+			ctl->cgroups = xreallocarray(ctl->cgroups, ctl->ncgroups + 1,
+						     sizeof(char *));
+			ctl->cgroups[ctl->ncgroups++] = *argv;
+			continue;
+		}
 		if (!strcmp(arg, "-r") || !strcmp(arg, "--require-handler")) {
 			ctl->require_handler = 1;
 			continue;
@@ -380,7 +404,7 @@ static char **parse_arguments(int argc, char **argv, struct kill_control *ctl)
 		if (ctl->do_pid)
 			errx(EXIT_FAILURE, _("%s and %s are mutually exclusive"), "--pid", "--signal");
 	}
-	if (!*argv)
+	if (!*argv && !ctl->ncgroups)
 		errx(EXIT_FAILURE, _("not enough arguments"));
 	return argv;
 }
@@ -480,10 +504,217 @@ static int check_signal_handler(const struct kill_control *ctl)
 	return has_hnd;
 }
 
+static int is_pid_arg(const char *arg, pid_t *pid)
+{
+	char *ep = NULL;
+
+	errno = 0;
+	*pid = strtol(arg, &ep, 10);
+	return errno == 0 && ep && *ep == '\0' && arg < ep;
+}
+
+static int signal_pid(struct kill_control *ctl, pid_t pid)
+{
+	ctl->pid = pid;
+	if (check_signal_handler(ctl) <= 0)
+		return -1;
+	return kill_verbose(ctl) != 0 ? 1 : 0;
+}
+
+static int cmp_kill_names(const void *a, const void *b)
+{
+	const struct kill_name *const *x = a, *const *y = b;
+
+	return strcmp((*x)->name, (*y)->name);
+}
+
+/*
+ * Resolve all names from the command line in one pass over /proc; the
+ * names are kept sorted, so the cost does not grow with their number.
+ */
+static void lookup_names(const struct kill_control *ctl,
+			 struct kill_name *names, size_t nnames)
+{
+	struct kill_name **idx;
+	struct dirent *d;
+	DIR *dir;
+	uid_t uid = !ctl->check_all ? getuid() : 0;
+	size_t i;
+
+	if (!nnames || !(dir = opendir(_PATH_PROC)))
+		return;
+
+	idx = xmalloc(nnames * sizeof(*idx));
+	for (i = 0; i < nnames; i++)
+		idx[i] = &names[i];
+	qsort(idx, nnames, sizeof(*idx), cmp_kill_names);
+
+	while ((d = xreaddir(dir))) {
+		struct kill_name key, *pkey = &key, **hit;
+		char buf[33];
+		pid_t pid;
+
+		if (!ctl->check_all &&
+		    !procfs_dirent_match_uid(dir, d, uid))
+			continue;
+		if (procfs_dirent_get_name(dir, d, buf, sizeof(buf)) != 0)
+			continue;
+		key.name = buf;
+		hit = bsearch(&pkey, idx, nnames, sizeof(*idx), cmp_kill_names);
+		if (!hit)
+			continue;
+		if (procfs_dirent_get_pid(d, &pid) != 0)
+			continue;
+
+		/* the same name may be given more than once */
+		while (hit > idx && strcmp(hit[-1]->name, buf) == 0)
+			hit--;
+		for ( ; hit < idx + nnames && strcmp((*hit)->name, buf) == 0; hit++) {
+			struct kill_name *kn = *hit;
+
+			if (kn->npids % 64 == 0)
+				kn->pids = xreallocarray(kn->pids, kn->npids + 64,
+							 sizeof(pid_t));
+			kn->pids[kn->npids++] = pid;
+		}
+	}
+
+	closedir(dir);
+	free(idx);
+}
+
+/*
+ * The cgroup is either a directory in the cgroup2 filesystem, or a path
+ * relative to its mount point as shown in /proc/<pid>/cgroup.
+ */
+static int open_cgroup(const char *path)
+{
+	char buf[PATH_MAX];
+	int fd;
+
+	if (*path == '/') {
+		fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd >= 0 && faccessat(fd, "cgroup.procs", F_OK, 0) == 0)
+			return fd;
+		if (fd >= 0)
+			close(fd);
+	}
+	snprintf(buf, sizeof(buf), _PATH_SYS_CGROUP "/%s", path);
+	return open(buf, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/* signal processes from cgroup.procs of the cgroup and all its children */
+static void kill_cgroup_procs(struct kill_control *ctl, int dir,
+			      int *ct, int *nerrs)
+{
+	struct dirent *d;
+	DIR *sub;
+	FILE *f;
+	int fd;
+
+	f = fopen_at(dir, "cgroup.procs", O_RDONLY | O_CLOEXEC, "r");
+	if (f) {
+		pid_t self = getpid();
+		char buf[64];
+
+		while (fgets(buf, sizeof(buf), f)) {
+			int32_t pid;
+
+			rtrim_whitespace((unsigned char *) buf);
+			if (ul_strtos32(buf, &pid, 10) != 0 || pid <= 0)
+				continue;
+			/* do not kill ourselves before the list is complete */
+			if (pid == self)
+				continue;
+			switch (signal_pid(ctl, pid)) {
+			case 1:
+				(*nerrs)++;
+				/* fallthrough */
+			case 0:
+				(*ct)++;
+				break;
+			}
+		}
+		fclose(f);
+	}
+
+	if ((fd = dup(dir)) < 0 || !(sub = fdopendir(fd))) {
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	while ((d = xreaddir(sub))) {
+		int child;
+
+		if (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)
+			continue;
+		child = openat(dir, d->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (child < 0)
+			continue;
+		kill_cgroup_procs(ctl, child, ct, nerrs);
+		close(child);
+	}
+	closedir(sub);
+}
+
+static void kill_cgroup(struct kill_control *ctl, const char *path,
+			int *ct, int *nerrs)
+{
+	int dir, n = *ct;
+
+	ctl->arg = (char *) path;
+	dir = open_cgroup(path);
+	if (dir < 0) {
+		warn(_("cannot open cgroup %s"), path);
+		(*nerrs)++, (*ct)++;
+		return;
+	}
+
+	/*
+	 * SIGKILL with no extra requirements is sent by the kernel to the
+	 * whole cgroup subtree at once (since Linux 5.14).
+	 */
+	if (ctl->numsig == SIGKILL && !ctl->do_pid && !ctl->require_handler
+#ifdef HAVE_SIGQUEUE
+	    && !ctl->use_sigval
+#endif
+#ifdef UL_HAVE_PIDFD
+	    && !ctl->timeout
+#endif
+	    ) {
+		int fd = openat(dir, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+
+		if (fd >= 0) {
+			if (ctl->verbose)
+				printf(_("sending signal %d to cgroup %s\n"),
+				       ctl->numsig, path);
+			if (write_all(fd, "1", 1) != 0) {
+				warn(_("sending signal to %s failed"), path);
+				(*nerrs)++;
+			}
+			(*ct)++;
+			close(fd);
+			close(dir);
+			return;
+		}
+	}
+
+	kill_cgroup_procs(ctl, dir, ct, nerrs);
+	close(dir);
+
+	if (n == *ct) {
+		warnx(_("no process found in cgroup %s"), path);
+		(*nerrs)++, (*ct)++;
+	}
+}
+
 int main(int argc, char **argv)
 {
 	struct kill_control ctl = { .numsig = SIGTERM };
-	int nerrs = 0, ct = 0;
+	struct kill_name *names = NULL;
+	size_t i, n, nnames = 0;
+	int nerrs = 0, ct = 0, rc;
+	pid_t pid;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -495,52 +726,53 @@ int main(int argc, char **argv)
 #endif
 	argv = parse_arguments(argc, argv, &ctl);
 
-	/* The rest of the arguments should be process ids and names. */
-	for ( ; (ctl.arg = *argv) != NULL; argv++) {
-		char *ep = NULL;
+	/* Resolve all names at once, the rest are process ids. */
+	for (i = 0; argv[i]; i++) {
+		if (!is_pid_arg(argv[i], &pid))
+			nnames++;
+	}
+	if (nnames) {
+		names = xcalloc(nnames, sizeof(*names));
+		for (i = 0, n = 0; argv[i]; i++) {
+			if (!is_pid_arg(argv[i], &pid))
+				names[n++].name = argv[i];
+		}
+		lookup_names(&ctl, names, nnames);
+	}
 
-		errno = 0;
-		ctl.pid = strtol(ctl.arg, &ep, 10);
-		if (errno == 0 && ep && *ep == '\0' && ctl.arg < ep) {
-			if (check_signal_handler(&ctl) <= 0)
+	for (i = 0; i < ctl.ncgroups; i++)
+		kill_cgroup(&ctl, ctl.cgroups[i], &ct, &nerrs);
+
+	for (n = 0; (ctl.arg = *argv) != NULL; argv++) {
+		if (is_pid_arg(ctl.arg, &pid)) {
+			rc = signal_pid(&ctl, pid);
+			if (rc < 0)
 				continue;
-			if (kill_verbose(&ctl) != 0)
+			if (rc > 0)
 				nerrs++;
 			ct++;
 		} else {
+			struct kill_name *kn = &names[n++];
 			int found = 0;
-			struct dirent *d;
-			DIR *dir = opendir(_PATH_PROC);
-			uid_t uid = !ctl.check_all ? getuid() : 0;
-
-			if (!dir)
-				continue;
 
-			while ((d = xreaddir(dir))) {
-				if (!ctl.check_all &&
-				    !procfs_dirent_match_uid(dir, d, uid))
+			for (i = 0; i < kn->npids; i++) {
+				rc = signal_pid(&ctl, kn->pids[i]);
+				if (rc < 0)
 					continue;
-				if (ctl.arg &&
-				    !procfs_dirent_match_name(dir, d, ctl.arg))
-					continue;
-				if (procfs_dirent_get_pid(d, &ctl.pid) != 0)
-					continue;
-				if (check_signal_handler(&ctl) <= 0)
-					continue;
-
-				if (kill_verbose(&ctl) != 0)
+				if (rc > 0)
 					nerrs++;
 				ct++;
 				found = 1;
 			}
-
-			closedir(dir);
 			if (!found) {
 				nerrs++, ct++;
 				warnx(_("cannot find process \"%s\""), ctl.arg);
 			}
+			free(kn->pids);
 		}
 	}
+	free(names);
+	free(ctl.cgroups);
 
 #ifdef UL_HAVE_PIDFD
 	while (!list_empty(&ctl.follow_ups)) {
@@ -292,6 +292,23 @@ int main(int argc, char **argv)
 		goto done;
 	}
 
+	if (bflg || tflg) {
+		/* print entries in the time range, filtered by the database */
+		int64_t from = INT64_MIN, to = INT64_MAX;
+		time_t now = time(NULL);
+
+		if (bflg)
+			to = (int64_t) now - b_days;
+		if (tflg)
+			from = (int64_t) now - t_days;
+
+		if (ll2_read_range(db_context, from, to, print_entry, &error) != 0) {
+			warnx(_("Couldn't read entries for all users"));
+			goto err;
+		}
+		goto done;
+	}
+
 	/* print all information */
 	if (ll2_read_all(db_context, print_entry, &error) != 0) {
 		warnx(_("Couldn't read entries for all users"));
@@ -52,6 +52,7 @@
 #include <getopt.h>
 #include <pwd.h>
 #include <signal.h>
+#include <poll.h>
 #include <sys/uio.h>
 
 #include "all-io.h"
@@ -64,6 +65,7 @@
 #include "strv.h"
 #include "list.h"
 #include "pwdutils.h"
+#include "monotonic.h"
 
 #define	SYSLOG_NAMES
 #include <syslog.h>
@@ -101,7 +103,24 @@ enum {
 	OPT_ID,
 	OPT_STRUCTURED_DATA_ID,
 	OPT_STRUCTURED_DATA_PARAM,
-	OPT_OCTET_COUNT
+	OPT_OCTET_COUNT,
+	OPT_BATCH
+};
+
+#define LOGGER_BATCH_SIZE	(64 * 1024)	/* max. bytes in one batch */
+#define LOGGER_BATCH_MSGS	64		/* max. messages in one batch */
+
+/* messages read from stdin and not sent yet (--batch) */
+struct logger_batch {
+	char		*buf;
+	size_t		size;			/* used bytes in buf */
+	size_t		ends[LOGGER_BATCH_MSGS];	/* end of each message in buf */
+	size_t		nmsgs;
+	struct timeval	start;			/* when the first message was added */
+
+	char		inbuf[BUFSIZ];		/* stdin buffer */
+	size_t		inpos;
+	size_t		inlen;
 };
 
 /* rfc5424 structured data */
@@ -117,6 +136,8 @@ struct logger_ctl {
 	int pri;
 	pid_t pid;			/* zero when unwanted */
 	char *hdr;			/* the syslog header (based on protocol) */
+	time_t hdr_time;		/* when the header has been generated */
+	int hdr_pri;			/* priority used in the header */
 	char const *tag;
 	char *login;
 	char *msgid;
@@ -127,6 +148,8 @@ struct logger_ctl {
 	size_t max_message_size;
 	struct list_head user_sds;	/* user defined rfc5424 structured data */
 	struct list_head reserved_sds;	/* standard rfc5424 structured data */
+	struct logger_batch *batch;	/* stdin messages to send (--batch) */
+	unsigned int batch_delay;	/* max. delay of batched messages in msec */
 
 	void (*syslogfp)(struct logger_ctl *ctl);
 
@@ -139,7 +162,8 @@ struct logger_ctl {
 			rfc5424_tq:1,		/* include time quality markup */
 			rfc5424_host:1,		/* include hostname */
 			skip_empty_lines:1,	/* do not send empty lines when processing files */
-			octet_count:1;		/* use RFC6587 octet counting */
+			octet_count:1,		/* use RFC6587 octet counting */
+			batch_mode:1;		/* send stdin messages in batches */
 };
 
 #define is_connected(_ctl)	((_ctl)->fd >= 0)
@@ -435,6 +459,229 @@ static char const *rfc3164_current_time(void)
 #define iovec_memcmp(ary, idx, str, len)		\
 		memcmp((ary)[(idx) - 1].iov_base, str, len)
 
+#ifdef SCM_CREDENTIALS
+union logger_cmsg {
+	struct cmsghdr cmh;
+	char   control[CMSG_SPACE(sizeof(struct ucred))];
+};
+
+/* syslog/journald may follow local socket credentials rather
+ * than in the message PID. If we use --id as root than we can
+ * force kernel to accept another valid PID than the real logger(1)
+ * PID.
+ */
+static void set_credentials(const struct logger_ctl *ctl,
+			    struct msghdr *message, union logger_cmsg *cbuf)
+{
+	struct cmsghdr *cmhp;
+	struct ucred *cred;
+
+	if (!(ctl->pid && !ctl->server && ctl->pid != getpid()
+	      && geteuid() == 0 && kill(ctl->pid, 0) == 0))
+		return;
+
+	memset(cbuf, 0, sizeof(*cbuf));
+	message->msg_control = cbuf->control;
+	message->msg_controllen = CMSG_SPACE(sizeof(struct ucred));
+
+	cmhp = CMSG_FIRSTHDR(message);
+	cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+	cmhp->cmsg_level = SOL_SOCKET;
+	cmhp->cmsg_type = SCM_CREDENTIALS;
+	cred = (struct ucred *) CMSG_DATA(cmhp);
+
+	cred->pid = ctl->pid;
+}
+#endif
+
+/* Note that logger(1) maybe executed for long time (as pipe
+ * reader) and connection endpoint (syslogd) may be restarted.
+ *
+ * The libc syslog() function reconnects on failed send().
+ * Let's do the same to be robust.    [kzak -- Oct 2017]
+ *
+ * MSG_NOSIGNAL is POSIX.1-2008 compatible, but it for example
+ * not supported by apple-darwin15.6.0.
+ */
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+static void send_message(struct logger_ctl *ctl, struct iovec *iov, size_t iovlen)
+{
+	struct msghdr message = { 0 };
+#ifdef SCM_CREDENTIALS
+	union logger_cmsg cbuf;
+#endif
+	message.msg_iov = iov;
+	message.msg_iovlen = iovlen;
+
+#ifdef SCM_CREDENTIALS
+	set_credentials(ctl, &message, &cbuf);
+#endif
+	if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0) {
+		logger_reopen(ctl);
+		if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0)
+			warn(_("send message failed"));
+	}
+}
+
+/* sends all batched messages to the stream socket by as few calls as possible */
+static int batch_send_stream(struct logger_ctl *ctl)
+{
+	struct logger_batch *bt = ctl->batch;
+	size_t done = 0, msg = 0;
+	int retried = 0;
+
+	while (done < bt->size) {
+		struct iovec iov = {
+			.iov_base = bt->buf + done,
+			.iov_len = bt->size - done
+		};
+		struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1 };
+		ssize_t rc;
+#ifdef SCM_CREDENTIALS
+		union logger_cmsg cbuf;
+
+		set_credentials(ctl, &message, &cbuf);
+#endif
+		rc = sendmsg(ctl->fd, &message, MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (retried)
+				return -errno;
+			/* send the partially sent message again to the new connection */
+			retried = 1;
+			logger_reopen(ctl);
+			done = msg ? bt->ends[msg - 1] : 0;
+			continue;
+		}
+		done += rc;
+		while (msg < bt->nmsgs && bt->ends[msg] <= done)
+			msg++;
+	}
+	return 0;
+}
+
+/* sends all batched messages to the datagram socket, one datagram per message */
+static int batch_send_dgram(struct logger_ctl *ctl)
+{
+	struct logger_batch *bt = ctl->batch;
+	struct iovec iov[LOGGER_BATCH_MSGS];
+	size_t i, done = 0;
+	int retried = 0;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[LOGGER_BATCH_MSGS];
+# ifdef SCM_CREDENTIALS
+	union logger_cmsg cbuf[LOGGER_BATCH_MSGS];
+# endif
+
+	memset(msgs, 0, sizeof(msgs));
+#endif
+	for (i = 0; i < bt->nmsgs; i++) {
+		size_t start = i ? bt->ends[i - 1] : 0;
+
+		iov[i].iov_base = bt->buf + start;
+		iov[i].iov_len = bt->ends[i] - start;
+#ifdef HAVE_SENDMMSG
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+# ifdef SCM_CREDENTIALS
+		set_credentials(ctl, &msgs[i].msg_hdr, &cbuf[i]);
+# endif
+#endif
+	}
+
+	while (done < bt->nmsgs) {
+		int rc;
+#ifdef HAVE_SENDMMSG
+		rc = sendmmsg(ctl->fd, msgs + done, bt->nmsgs - done, MSG_NOSIGNAL);
+#else
+		struct msghdr message = { .msg_iov = &iov[done], .msg_iovlen = 1 };
+# ifdef SCM_CREDENTIALS
+		union logger_cmsg cbuf;
+
+		set_credentials(ctl, &message, &cbuf);
+# endif
+		rc = sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0 ? -1 : 1;
+#endif
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (retried)
+				return -errno;
+			retried = 1;
+			logger_reopen(ctl);
+			continue;
+		}
+		done += rc;
+	}
+	return 0;
+}
+
+static void batch_flush(struct logger_ctl *ctl)
+{
+	struct logger_batch *bt = ctl->batch;
+	int rc;
+
+	if (!bt || !bt->nmsgs)
+		return;
+
+	if (!is_connected(ctl))
+		logger_reopen(ctl);
+	if (!is_connected(ctl))
+		rc = -ENOTCONN;
+	else if (ctl->socket_type == TYPE_TCP)
+		rc = batch_send_stream(ctl);
+	else
+		rc = batch_send_dgram(ctl);
+	if (rc) {
+		errno = -rc;
+		warn(_("send message failed"));
+	}
+
+	bt->size = 0;
+	bt->nmsgs = 0;
+}
+
+/* returns milliseconds since the first message has been added to the batch */
+static unsigned int batch_age(struct logger_ctl *ctl)
+{
+	struct timeval now, age;
+
+	gettime_monotonic(&now);
+	timersub(&now, &ctl->batch->start, &age);
+	return age.tv_sec * 1000 + age.tv_usec / 1000;
+}
+
+static void batch_add(struct logger_ctl *ctl, struct iovec *iov, size_t iovlen)
+{
+	struct logger_batch *bt = ctl->batch;
+	size_t i, len = 0;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+
+	if (bt->nmsgs == LOGGER_BATCH_MSGS || bt->size + len > LOGGER_BATCH_SIZE)
+		batch_flush(ctl);
+	if (len > LOGGER_BATCH_SIZE) {
+		send_message(ctl, iov, iovlen);
+		return;
+	}
+	if (!bt->nmsgs)
+		gettime_monotonic(&bt->start);
+
+	for (i = 0; i < iovlen; i++) {
+		memcpy(bt->buf + bt->size, iov[i].iov_base, iov[i].iov_len);
+		bt->size += iov[i].iov_len;
+	}
+	bt->ends[bt->nmsgs++] = bt->size;
+
+	if (ctl->batch_delay && batch_age(ctl) >= ctl->batch_delay)
+		batch_flush(ctl);
+}
+
 /* writes generated buffer to desired destination. For TCP syslog,
  * we use RFC6587 octet-stuffing (unless octet-counting is selected).
  * This is not great, but doing full blown RFC5425 (TLS) looks like
@@ -464,61 +711,14 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	iovec_add_string(iov, iovlen, msg, 0);
 
 	if (!ctl->noact && is_connected(ctl)) {
-		struct msghdr message = { 0 };
-#ifdef SCM_CREDENTIALS
-		struct cmsghdr *cmhp;
-		struct ucred *cred;
-		union {
-			struct cmsghdr cmh;
-			char   control[CMSG_SPACE(sizeof(struct ucred))];
-		} cbuf = { .control = { 0 } };
-#endif
-
 		/* 4) add extra \n to make sure message is terminated */
 		if ((ctl->socket_type == TYPE_TCP) && !ctl->octet_count)
 			iovec_add_string(iov, iovlen, "\n", 1);
 
-		message.msg_iov = iov;
-		message.msg_iovlen = iovlen;
-
-#ifdef SCM_CREDENTIALS
-		/* syslog/journald may follow local socket credentials rather
-		 * than in the message PID. If we use --id as root than we can
-		 * force kernel to accept another valid PID than the real logger(1)
-		 * PID.
-		 */
-		if (ctl->pid && !ctl->server && ctl->pid != getpid()
-		    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
-
-			message.msg_control = cbuf.control;
-			message.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
-
-			cmhp = CMSG_FIRSTHDR(&message);
-			cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
-			cmhp->cmsg_level = SOL_SOCKET;
-			cmhp->cmsg_type = SCM_CREDENTIALS;
-			cred = (struct ucred *) CMSG_DATA(cmhp);
-
-			cred->pid = ctl->pid;
-		}
-#endif
-		/* Note that logger(1) maybe executed for long time (as pipe
-		 * reader) and connection endpoint (syslogd) may be restarted.
-		 *
-		 * The libc syslog() function reconnects on failed send().
-		 * Let's do the same to be robust.    [kzak -- Oct 2017]
-		 *
-		 * MSG_NOSIGNAL is POSIX.1-2008 compatible, but it for example
-		 * not supported by apple-darwin15.6.0.
-		 */
-#ifndef MSG_NOSIGNAL
-# define MSG_NOSIGNAL 0
-#endif
-		if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0) {
-			logger_reopen(ctl);
-			if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0)
-				warn(_("send message failed"));
-		}
+		if (ctl->batch)
+			batch_add(ctl, iov, iovlen);
+		else
+			send_message(ctl, iov, iovlen);
 	}
 
 	if (ctl->stderr_printout) {
@@ -915,9 +1115,20 @@ static void syslog_local_header(struct logger_ctl *const ctl)
 
 static void generate_syslog_header(struct logger_ctl *const ctl)
 {
+	struct timeval tv;
+
+	/* The header is the same for all messages with the same priority
+	 * within one second, except RFC5424 time stamps with microseconds. */
+	logger_gettimeofday(&tv, NULL);
+	if (ctl->hdr && ctl->hdr_pri == ctl->pri && ctl->hdr_time == tv.tv_sec
+	    && !(ctl->syslogfp == syslog_rfc5424_header && ctl->rfc5424_time))
+		return;
+
 	free(ctl->hdr);
 	ctl->hdr = NULL;
 	ctl->syslogfp(ctl);
+	ctl->hdr_pri = ctl->pri;
+	ctl->hdr_time = tv.tv_sec;
 }
 
 /* just open, nothing else */
@@ -990,6 +1201,48 @@ static void logger_command_line(struct logger_ctl *ctl, char **argv)
 	free(buf);
 }
 
+/*
+ * Reads stdin by read(2) in batch mode to know when no input is ready. The
+ * batched messages are sent when there is no input for --batch milliseconds
+ * after the first of them.
+ */
+static int logger_getchar(struct logger_ctl *ctl)
+{
+	struct logger_batch *bt = ctl->batch;
+
+	if (!bt)
+		return getchar();
+
+	while (bt->inpos == bt->inlen) {
+		ssize_t rc;
+
+		if (bt->nmsgs) {
+			struct pollfd fds = { .fd = fileno(stdin), .events = POLLIN };
+			unsigned int age = batch_age(ctl);
+			int timeout = age < ctl->batch_delay ? ctl->batch_delay - age : 0;
+
+			if (poll(&fds, 1, timeout) == 0)
+				batch_flush(ctl);
+		}
+
+		rc = read(fileno(stdin), bt->inbuf, sizeof(bt->inbuf));
+		if (rc < 0 && errno == EAGAIN) {
+			struct pollfd fds = { .fd = fileno(stdin), .events = POLLIN };
+
+			ignore_result( poll(&fds, 1, -1) );
+			continue;
+		}
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			return EOF;
+		bt->inpos = 0;
+		bt->inlen = rc;
+	}
+
+	return (unsigned char) bt->inbuf[bt->inpos++];
+}
+
 static void logger_stdin(struct logger_ctl *ctl)
 {
 	/* note: we re-generate the syslog header for each log message to
@@ -1001,13 +1254,18 @@ static void logger_stdin(struct logger_ctl *ctl)
 	int c;
 	size_t i;
 
-	c = getchar();
+	if (ctl->batch_mode && !ctl->noact) {
+		ctl->batch = xcalloc(1, sizeof(struct logger_batch));
+		ctl->batch->buf = xmalloc(LOGGER_BATCH_SIZE);
+	}
+
+	c = logger_getchar(ctl);
 	while (c != EOF) {
 		i = 0;
 		if (ctl->prio_prefix && c == '<') {
 			pri = 0;
 			buf[i++] = c;
-			while (isdigit(c = getchar()) && pri <= 191) {
+			while (isdigit(c = logger_getchar(ctl)) && pri <= 191) {
 				buf[i++] = c;
 				pri = pri * 10 + c - '0';
 			}
@@ -1023,12 +1281,12 @@ static void logger_stdin(struct logger_ctl *ctl)
 				ctl->pri = default_priority;
 
 			if (c != EOF && c != '\n')
-				c = getchar();
+				c = logger_getchar(ctl);
 		}
 
 		while (c != EOF && c != '\n' && i < ctl->max_message_size) {
 			buf[i++] = c;
-			c = getchar();
+			c = logger_getchar(ctl);
 		}
 		buf[i] = '\0';
 
@@ -1038,10 +1296,17 @@ static void logger_stdin(struct logger_ctl *ctl)
 		}
 
 		if (c == '\n')	/* discard line terminator */
-			c = getchar();
+			c = logger_getchar(ctl);
 	}
 
 	free(buf);
+
+	if (ctl->batch) {
+		batch_flush(ctl);
+		free(ctl->batch->buf);
+		free(ctl->batch);
+		ctl->batch = NULL;
+	}
 }
 
 static void logger_close(const struct logger_ctl *ctl)
@@ -1069,6 +1334,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --no-act             do everything except the write the log\n"), out);
 	fputs(_(" -p, --priority <prio>    mark given message with this priority\n"), out);
 	fputs(_("     --octet-count        use rfc6587 octet counting\n"), out);
+	fputs(_("     --batch[=<msec>]     send lines from stdin in batches, delayed up to <msec>\n"), out);
 	fputs(_("     --prio-prefix        look for a prefix on every line read from stdin\n"), out);
 	fputs(_(" -s, --stderr             output message to standard error as well\n"), out);
 	fputs(_(" -S, --size <size>        maximum size for a single message\n"), out);
@@ -1146,6 +1412,7 @@ int main(int argc, char **argv)
 		{ "version",	   no_argument,	      0, 'V'		   },
 		{ "help",	   no_argument,	      0, 'h'		   },
 		{ "octet-count",   no_argument,	      0, OPT_OCTET_COUNT   },
+		{ "batch",	   optional_argument, 0, OPT_BATCH	   },
 		{ "prio-prefix",   no_argument,	      0, OPT_PRIO_PREFIX   },
 		{ "rfc3164",	   no_argument,	      0, OPT_RFC3164	   },
 		{ "rfc5424",	   optional_argument, 0, OPT_RFC5424	   },
@@ -1223,6 +1490,15 @@ int main(int argc, char **argv)
 		case OPT_OCTET_COUNT:
 			ctl.octet_count = 1;
 			break;
+		case OPT_BATCH:
+			ctl.batch_mode = 1;
+			if (optarg) {
+				if (*optarg == '=')
+					optarg++;
+				ctl.batch_delay = strtou32_or_err(optarg,
+						_("failed to parse batch delay"));
+			}
+			break;
 		case OPT_PRIO_PREFIX:
 			ctl.prio_prefix = 1;
 			break;
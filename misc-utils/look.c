@@ -77,6 +77,7 @@ static char *binary_search (char *, char *);
 static int compare (char *, char *);
 static char *linear_search (char *, char *);
 static int look (char *, char *);
+static int look_strings_from (const char *, int, char *, char *);
 static void print_from (char *, char *);
 static void __attribute__((__noreturn__)) usage(void);
 
@@ -86,11 +87,13 @@ main(int argc, char *argv[])
 	struct stat sb;
 	int ch, fd, termchar;
 	char *back, *file, *front, *p;
+	const char *strings_from = NULL;
 
 	static const struct option longopts[] = {
 		{"alternative", no_argument, NULL, 'a'},
 		{"alphanum", no_argument, NULL, 'd'},
 		{"ignore-case", no_argument, NULL, 'f'},
+		{"strings-from", required_argument, NULL, 's'},
 		{"terminate", required_argument, NULL, 't'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -110,7 +113,7 @@ main(int argc, char *argv[])
 	termchar = '\0';
 	string = NULL;		/* just for gcc */
 
-	while ((ch = getopt_long(argc, argv, "adft:Vh", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "adfs:t:Vh", longopts, NULL)) != -1)
 		switch(ch) {
 		case 'a':
 			file = _PATH_WORDS_ALT;
@@ -121,6 +124,9 @@ main(int argc, char *argv[])
 		case 'f':
 			fflag = 1;
 			break;
+		case 's':
+			strings_from = optarg;
+			break;
 		case 't':
 			termchar = *optarg;
 			break;
@@ -134,7 +140,18 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	switch (argc) {
+	if (strings_from) {
+		/* the strings are read from file, the only argument is the sorted file */
+		if (argc > 1) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+		if (argc == 1)
+			file = *argv;
+		else
+			dflag = fflag = 1;
+
+	} else switch (argc) {
 	case 2:				/* Don't set -df for user. */
 		string = *argv++;
 		file = *argv;
@@ -148,7 +165,7 @@ main(int argc, char *argv[])
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (termchar != '\0' && (p = strchr(string, termchar)) != NULL)
+	if (!strings_from && termchar != '\0' && (p = strchr(string, termchar)) != NULL)
 		*++p = '\0';
 
 	if ((fd = open(file, O_RDONLY, 0)) < 0 || fstat(fd, &sb))
@@ -163,9 +180,47 @@ main(int argc, char *argv[])
 #endif
 			err(EXIT_FAILURE, "%s", file);
 	back = front + sb.st_size;
+
+	if (strings_from)
+		return look_strings_from(strings_from, termchar, front, back);
 	return look(front, back);
 }
 
+/*
+ * Looks up all strings from the file (one per line), the sorted file is
+ * mapped only once. Returns 0 if at least one line was found.
+ */
+static int
+look_strings_from(const char *filename, int termchar, char *front, char *back)
+{
+	FILE *f;
+	char *line = NULL, *p;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = 1;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else if (!(f = fopen(filename, "r")))
+		err(EXIT_FAILURE, "%s", filename);
+
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		if (termchar != '\0' && (p = strchr(line, termchar)) != NULL)
+			*++p = '\0';
+
+		string = line;
+		if (look(front, back) == 0)
+			rc = 0;
+	}
+
+	if (f != stdin)
+		fclose(f);
+	free(line);
+	return rc;
+}
+
 static int
 look(char *front, char *back)
 {
@@ -291,19 +346,13 @@ linear_search(char *front, char *back)
 static void
 print_from(char *front, char *back)
 {
-	int eol;
-
 	while (front < back && compare(front, back) == EQUAL) {
-		if (compare(front, back) == EQUAL) {
-			eol = 0;
-			while (front < back && !eol) {
-				if (putchar(*front) == EOF)
-					err(EXIT_FAILURE, "stdout");
-				if (*front++ == '\n')
-					eol = 1;
-			}
-		} else
-			SKIP_PAST_NEWLINE(front, back);
+		char *eol = memchr(front, '\n', back - front);
+		size_t len = eol ? (size_t) (eol - front) + 1 : (size_t) (back - front);
+
+		if (fwrite(front, 1, len, stdout) != len)
+			err(EXIT_FAILURE, "stdout");
+		front += len;
 	}
 }
 
@@ -328,6 +377,20 @@ compare(char *s2, char *s2end) {
 	int i;
 	char *p;
 
+	/* nothing is ignored, compare the line in place */
+	if (!dflag && !fflag) {
+		size_t len = min((size_t) (s2end - s2), (size_t) stringlen);
+
+		p = memchr(s2, '\n', len);
+		if (p)
+			len = p - s2;
+		i = memcmp(s2, string, len);
+		if (i == 0 && len < (size_t) stringlen)
+			i = -1;		/* line is shorter than string */
+
+		return ((i > 0) ? LESS : (i < 0) ? GREATER : EQUAL);
+	}
+
 	/* copy, ignoring things that should be ignored */
 	p = comparbuf;
 	i = stringlen;
@@ -355,6 +418,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	FILE *out = stdout;
 	fputs(USAGE_HEADER, out);
 	fprintf(out, _(" %s [options] <string> [<file>...]\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] --strings-from <file> [<file>]\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Display lines beginning with a specified string.\n"), out);
@@ -363,6 +427,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --alternative        use the alternative dictionary\n"), out);
 	fputs(_(" -d, --alphanum           compare only blanks and alphanumeric characters\n"), out);
 	fputs(_(" -f, --ignore-case        ignore case differences when comparing\n"), out);
+	fputs(_(" -s, --strings-from <file> read the strings from <file> (or stdin for '-')\n"), out);
 	fputs(_(" -t, --terminate <char>   define the string-termination character\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -3,7 +3,8 @@
  * two basic lists:
  *
  * 1) devtree->devices -- This is simple list without any hierarchy. We use
- * reference counting here.
+ * reference counting here. The devices are also indexed by name in
+ * devtree->devices_by_name to make lookups cheap on systems with many disks.
  *
  * 2) devtree->roots -- The root nodes of the trees. The code does not use
  * reference counting here due to complexity and it's unnecessary.
@@ -16,6 +17,9 @@
  *
  * Copyright (C) 2018 Karel Zak <kzak@redhat.com>
  */
+#include <search.h>
+
+#include "nls.h"
 #include "lsblk.h"
 #include "sysfs.h"
 #include "pathnames.h"
@@ -282,23 +286,10 @@ void lsblk_unref_devtree(struct lsblk_devtree *tr)
 	}
 }
 
-static int has_root(struct lsblk_devtree *tr, struct lsblk_device *dev)
-{
-	struct lsblk_iter itr;
-	struct lsblk_device *x = NULL;
-
-	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
-
-	while (lsblk_devtree_next_root(tr, &itr, &x) == 0) {
-		if (x == dev)
-			return 1;
-	}
-	return 0;
-}
-
 int lsblk_devtree_add_root(struct lsblk_devtree *tr, struct lsblk_device *dev)
 {
-	if (has_root(tr, dev))
+	/* the device is never in more trees, ls_roots is empty if not root */
+	if (!list_empty(&dev->ls_roots))
 		return 0;
 
 	if (!lsblk_devtree_has_device(tr, dev))
@@ -339,12 +330,21 @@ int lsblk_devtree_next_root(struct lsblk_devtree *tr,
 	return rc;
 }
 
+static int cmp_device_names(const void *a, const void *b)
+{
+	return strcmp(((const struct lsblk_device *) a)->name,
+		      ((const struct lsblk_device *) b)->name);
+}
+
 int lsblk_devtree_add_device(struct lsblk_devtree *tr, struct lsblk_device *dev)
 {
 	lsblk_ref_device(dev);
 
         DBG(TREE, ul_debugobj(tr, "add device 0x%p [%s]", dev, dev->name));
         list_add_tail(&dev->ls_devices, &tr->devices);
+
+	if (!tsearch(dev, &tr->devices_by_name, cmp_device_names))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 	return 0;
 }
 
@@ -368,32 +368,21 @@ int lsblk_devtree_next_device(struct lsblk_devtree *tr,
 
 int lsblk_devtree_has_device(struct lsblk_devtree *tr, struct lsblk_device *dev)
 {
-	struct lsblk_device *x = NULL;
-	struct lsblk_iter itr;
-
-	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	struct lsblk_device **x;
 
-	while (lsblk_devtree_next_device(tr, &itr, &x) == 0) {
-		if (x == dev)
-			return 1;
-	}
+	if (list_empty(&dev->ls_devices))
+		return 0;
 
-	return 0;
+	x = tfind(dev, &tr->devices_by_name, cmp_device_names);
+	return x && *x == dev;
 }
 
 struct lsblk_device *lsblk_devtree_get_device(struct lsblk_devtree *tr, const char *name)
 {
-	struct lsblk_device *dev = NULL;
-	struct lsblk_iter itr;
-
-	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
-
-	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
-		if (strcmp(name, dev->name) == 0)
-			return dev;
-	}
+	struct lsblk_device key = { .name = (char *) name }, **dev;
 
-	return NULL;
+	dev = tfind(&key, &tr->devices_by_name, cmp_device_names);
+	return dev ? *dev : NULL;
 }
 
 int lsblk_devtree_remove_device(struct lsblk_devtree *tr, struct lsblk_device *dev)
@@ -403,6 +392,7 @@ int lsblk_devtree_remove_device(struct lsblk_devtree *tr, struct lsblk_device *d
 	if (!lsblk_devtree_has_device(tr, dev))
 		return 1;
 
+	tdelete(dev, &tr->devices_by_name, cmp_device_names);
 	list_del_init(&dev->ls_roots);
 	list_del_init(&dev->ls_devices);
 	lsblk_unref_device(dev);
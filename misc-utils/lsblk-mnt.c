@@ -7,6 +7,165 @@
 
 static struct libmnt_table *mtab, *swaps;
 static struct libmnt_cache *mntcache;
+static struct libmnt_monitor *mntmon;
+
+/*
+ * The mount table may be huge (e.g. container hosts with many bind and
+ * overlay mounts), so we don't scan it for each device. The filesystems
+ * are indexed by devno and by source path; @pos is position in the table
+ * to keep the original (mount) order.
+ */
+struct mnt_idxent {
+	dev_t			devno;
+	const char		*path;
+	struct libmnt_fs	*fs;
+	size_t			pos;
+	unsigned int		canonical : 1;	/* path is canonicalized source */
+};
+
+struct mnt_index {
+	struct mnt_idxent	*bydev;
+	size_t			nbydev;
+	struct mnt_idxent	*bypath;
+	size_t			nbypath;
+};
+
+static struct mnt_index mtab_idx, swaps_idx;
+
+static int cmp_idxent_devno(const void *a, const void *b)
+{
+	const struct mnt_idxent *x = a, *y = b;
+
+	if (x->devno != y->devno)
+		return x->devno < y->devno ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static int cmp_idxent_path(const void *a, const void *b)
+{
+	const struct mnt_idxent *x = a, *y = b;
+	int rc = strcmp(x->path, y->path);
+
+	if (rc)
+		return rc;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static void index_add_path(struct mnt_index *idx, struct libmnt_fs *fs,
+			   size_t pos, const char *path, int canonical)
+{
+	struct mnt_idxent *e;
+
+	idx->bypath = xreallocarray(idx->bypath, idx->nbypath + 1, sizeof(*e));
+	e = &idx->bypath[idx->nbypath++];
+	e->devno = 0;
+	e->path = path;
+	e->fs = fs;
+	e->pos = pos;
+	e->canonical = canonical;
+}
+
+static void index_table(struct libmnt_table *tb, struct mnt_index *idx)
+{
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	size_t pos = 0;
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to initialize libmount iterator"));
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		dev_t devno = mnt_fs_get_devno(fs);
+		const char *src = mnt_fs_get_srcpath(fs);
+
+		if (devno) {
+			struct mnt_idxent *e;
+
+			idx->bydev = xreallocarray(idx->bydev, idx->nbydev + 1, sizeof(*e));
+			e = &idx->bydev[idx->nbydev++];
+			e->devno = devno;
+			e->path = NULL;
+			e->fs = fs;
+			e->pos = pos;
+			e->canonical = 0;
+		}
+		if (src) {
+			index_add_path(idx, fs, pos, src, 0);
+
+			/* the canonical path is owned by mntcache */
+			if (*src == '/') {
+				const char *cn = mnt_resolve_path(src, mntcache);
+
+				if (cn && strcmp(cn, src) != 0)
+					index_add_path(idx, fs, pos, cn, 1);
+			}
+		}
+		pos++;
+	}
+	mnt_free_iter(itr);
+
+	if (idx->nbydev)
+		qsort(idx->bydev, idx->nbydev, sizeof(struct mnt_idxent), cmp_idxent_devno);
+	if (idx->nbypath)
+		qsort(idx->bypath, idx->nbypath, sizeof(struct mnt_idxent), cmp_idxent_path);
+}
+
+static void free_index(struct mnt_index *idx)
+{
+	free(idx->bydev);
+	free(idx->bypath);
+	memset(idx, 0, sizeof(*idx));
+}
+
+/* returns the first entry in sorted @ents equal to @key (ignoring pos) */
+static struct mnt_idxent *index_lower_bound(struct mnt_idxent *ents, size_t n,
+				struct mnt_idxent *key,
+				int (*cmp)(const void *, const void *))
+{
+	size_t lo = 0, hi = n;
+
+	key->pos = 0;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (cmp(&ents[mid], key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < n ? &ents[lo] : NULL;
+}
+
+/* returns the last mounted filesystem with the source @path */
+static struct libmnt_fs *index_find_path(struct mnt_index *idx, const char *path,
+					 int canonical)
+{
+	struct mnt_idxent key = { .path = path }, *e, *last = NULL;
+
+	if (!path)
+		return NULL;
+	e = index_lower_bound(idx->bypath, idx->nbypath, &key, cmp_idxent_path);
+	for (; e && e < idx->bypath + idx->nbypath && strcmp(e->path, path) == 0; e++) {
+		if (canonical || !e->canonical)
+			last = e;
+	}
+	return last ? last->fs : NULL;
+}
+
+static struct libmnt_fs *index_find_srcpath(struct mnt_index *idx, const char *path)
+{
+	struct libmnt_fs *fs;
+
+	fs = index_find_path(idx, path, 1);
+	if (!fs) {
+		const char *cn = mnt_resolve_path(path, mntcache);
+
+		if (cn && strcmp(cn, path) != 0)
+			fs = index_find_path(idx, cn, 1);
+	}
+	return fs;
+}
 
 static int table_parser_errcb(struct libmnt_table *tb __attribute__((__unused__)),
 			const char *filename, int line)
@@ -37,9 +196,10 @@ static struct libmnt_fs *get_active_swap(const char *filename)
 			snprintf(buf, sizeof(buf), "%s" _PATH_PROC_SWAPS, lsblk->sysroot);
 			mnt_table_parse_swaps(swaps, buf);
 		}
+		index_table(swaps, &swaps_idx);
 	}
 
-	return mnt_table_find_srcpath(swaps, filename, MNT_ITER_BACKWARD);
+	return index_find_srcpath(&swaps_idx, filename);
 }
 
 void lsblk_device_free_filesystems(struct lsblk_device *dev)
@@ -53,6 +213,7 @@ void lsblk_device_free_filesystems(struct lsblk_device *dev)
 	dev->nfss = 0;
 	dev->is_mounted = 0;
 	dev->is_swap = 0;
+	dev->fss_requested = 0;
 }
 
 static void add_filesystem(struct lsblk_device *dev, struct libmnt_fs *fs)
@@ -66,16 +227,25 @@ static void add_filesystem(struct lsblk_device *dev, struct libmnt_fs *fs)
 	dev->is_mounted = 1;
 }
 
+static int cmp_idxent_pos_backward(const void *a, const void *b)
+{
+	const struct mnt_idxent *x = *(struct mnt_idxent * const *) a,
+				*y = *(struct mnt_idxent * const *) b;
+
+	return x->pos < y->pos ? 1 : x->pos > y->pos ? -1 : 0;
+}
+
 struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev, size_t *n)
 {
 	struct libmnt_fs *fs;
-	struct libmnt_iter *itr = NULL;
-	dev_t devno;
+	struct mnt_idxent key, *e, **found = NULL;
+	size_t nfound = 0, i;
 
 	assert(dev);
 	assert(dev->filename);
 
-	if (dev->is_mounted)
+	/* already scanned, unmounted devices included */
+	if (dev->fss_requested)
 		goto done;
 
 	lsblk_device_free_filesystems(dev);	/* reset */
@@ -97,35 +267,51 @@ struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev, size_t
 			snprintf(buf, sizeof(buf), "%s" _PATH_PROC_MOUNTINFO, lsblk->sysroot);
 			mnt_table_parse_mtab(mtab, buf);
 		}
+		index_table(mtab, &mtab_idx);
 	}
 
-	devno = makedev(dev->maj, dev->min);
-
 	/* All mounpoint where is used devno or device name
 	 */
-	itr = mnt_new_iter(MNT_ITER_BACKWARD);
-	while (mnt_table_next_fs(mtab, itr, &fs) == 0) {
-		if (mnt_fs_get_devno(fs) != devno &&
-		    !mnt_fs_streq_srcpath(fs, dev->filename))
+	key.devno = makedev(dev->maj, dev->min);
+	e = index_lower_bound(mtab_idx.bydev, mtab_idx.nbydev, &key, cmp_idxent_devno);
+	for (; e && e < mtab_idx.bydev + mtab_idx.nbydev && e->devno == key.devno; e++) {
+		found = xreallocarray(found, nfound + 1, sizeof(*found));
+		found[nfound++] = e;
+	}
+
+	key.path = dev->filename;
+	e = index_lower_bound(mtab_idx.bypath, mtab_idx.nbypath, &key, cmp_idxent_path);
+	for (; e && e < mtab_idx.bypath + mtab_idx.nbypath && strcmp(e->path, key.path) == 0; e++) {
+		if (e->canonical)
 			continue;
-		add_filesystem(dev, fs);
+		found = xreallocarray(found, nfound + 1, sizeof(*found));
+		found[nfound++] = e;
 	}
 
-	/* Try mnt_table_find_srcpath() which also canonicalizes patches, etc.
+	/* the last mounted first, the same as MNT_ITER_BACKWARD */
+	if (nfound > 1)
+		qsort(found, nfound, sizeof(*found), cmp_idxent_pos_backward);
+	for (i = 0; i < nfound; i++) {
+		if (i && found[i]->pos == found[i - 1]->pos)
+			continue;	/* matches by devno as well as by path */
+		add_filesystem(dev, found[i]->fs);
+	}
+	free(found);
+
+	/* Try also canonicalized paths
 	 */
 	if (!dev->nfss) {
 		fs = get_active_swap(dev->filename);
 		if (!fs) {
-			fs = mnt_table_find_srcpath(mtab, dev->filename, MNT_ITER_BACKWARD);
+			fs = index_find_srcpath(&mtab_idx, dev->filename);
 			if (fs)
 				dev->is_swap = 1;
 		}
 		if (fs)
 			add_filesystem(dev, fs);
 	}
-
+	dev->fss_requested = 1;
 done:
-	mnt_free_iter(itr);
 	if (n)
 		*n = dev->nfss;
 	return dev->fss;
@@ -172,9 +358,56 @@ void lsblk_mnt_init(void)
 	mnt_init_debug(0);
 }
 
-void lsblk_mnt_deinit(void)
+/* forget parsed tables, they will be parsed again on the next lookup */
+static void reset_tables(void)
 {
+	free_index(&mtab_idx);
+	free_index(&swaps_idx);
 	mnt_unref_table(mtab);
 	mnt_unref_table(swaps);
+	mtab = swaps = NULL;
+}
+
+/*
+ * Returns file descriptor to poll() for changes in mount table or -1.
+ */
+int lsblk_mnt_monitor_get_fd(void)
+{
+	if (!mntmon) {
+		mntmon = mnt_new_monitor();
+		if (!mntmon)
+			return -1;
+		if (mnt_monitor_enable_kernel(mntmon, 1) != 0) {
+			mnt_unref_monitor(mntmon);
+			mntmon = NULL;
+			return -1;
+		}
+	}
+	return mnt_monitor_get_fd(mntmon);
+}
+
+/*
+ * Drains the monitor. Returns 1 if the mount table has been changed; in this
+ * case the already parsed mount table is dropped.
+ */
+int lsblk_mnt_monitor_read(void)
+{
+	int changed = 0;
+
+	if (!mntmon)
+		return 0;
+	while (mnt_monitor_next_change(mntmon, NULL, NULL) == 0)
+		changed = 1;
+	if (changed)
+		reset_tables();
+	return changed;
+}
+
+void lsblk_mnt_deinit(void)
+{
+	reset_tables();
 	mnt_unref_cache(mntcache);
+	mnt_unref_monitor(mntmon);
+	mntcache = NULL;
+	mntmon = NULL;
 }
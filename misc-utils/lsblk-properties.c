@@ -11,11 +11,13 @@
 #include "path.h"
 #include "nls.h"
 #include "strutils.h"
+#include "pathnames.h"
 
 #include "lsblk.h"
 
 #ifdef HAVE_LIBUDEV
 static struct udev *udev;
+static struct udev_monitor *udevmon;
 #endif
 
 void lsblk_device_free_properties(struct lsblk_devprop *p)
@@ -47,120 +49,215 @@ void lsblk_device_free_properties(struct lsblk_devprop *p)
 	free(p);
 }
 
-#ifndef HAVE_LIBUDEV
-static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *dev
-				__attribute__((__unused__)))
-{
-	return NULL;
-}
-#else
-
-#define LSBLK_UDEV_BYID_PREFIX "/dev/disk/by-id/"
+#define LSBLK_UDEV_BYID_PREFIX "disk/by-id/"
 #define LSBLK_UDEV_BYID_PREFIXSZ (sizeof(LSBLK_UDEV_BYID_PREFIX) - 1)
 
-static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *ld)
+typedef const char *(udev_getter_t)(void *data, const char *name);
+
+/* fill properties from udev environment, @get returns value of the variable */
+static void fill_udev_properties(struct lsblk_devprop *prop,
+				 udev_getter_t *get, void *udata)
 {
-	struct udev_device *dev;
-	struct udev_list_entry *le;
 	const char *data;
-	struct lsblk_devprop *prop;
-	size_t len;
 
-	if (ld->udev_requested)
-		return ld->properties;
-
-	if (!udev)
-		udev = udev_new();	/* global handler */
-	if (!udev)
-		goto done;
-
-	dev = udev_device_new_from_subsystem_sysname(udev, "block", ld->name);
-	if (!dev)
-		goto done;
-
-	DBG(DEV, ul_debugobj(ld, "%s: found udev properties", ld->name));
-
-	if (ld->properties)
-		lsblk_device_free_properties(ld->properties);
-	prop = ld->properties = xcalloc(1, sizeof(*ld->properties));
-
-	if ((data = udev_device_get_property_value(dev, "ID_FS_LABEL_ENC"))) {
+	if ((data = get(udata, "ID_FS_LABEL_ENC"))) {
 		prop->label = xstrdup(data);
 		unhexmangle_string(prop->label);
 	}
-	if ((data = udev_device_get_property_value(dev, "ID_FS_UUID_ENC"))) {
+	if ((data = get(udata, "ID_FS_UUID_ENC"))) {
 		prop->uuid = xstrdup(data);
 		unhexmangle_string(prop->uuid);
 	}
-	if ((data = udev_device_get_property_value(dev, "ID_PART_TABLE_UUID")))
+	if ((data = get(udata, "ID_PART_TABLE_UUID")))
 		prop->ptuuid = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_TABLE_TYPE")))
+	if ((data = get(udata, "ID_PART_TABLE_TYPE")))
 		prop->pttype = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_NAME"))) {
+	if ((data = get(udata, "ID_PART_ENTRY_NAME"))) {
 		prop->partlabel = xstrdup(data);
 		unhexmangle_string(prop->partlabel);
 	}
-	if ((data = udev_device_get_property_value(dev, "ID_FS_TYPE")))
+	if ((data = get(udata, "ID_FS_TYPE")))
 		prop->fstype = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_FS_VERSION")))
+	if ((data = get(udata, "ID_FS_VERSION")))
 		prop->fsversion = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_TYPE")))
+	if ((data = get(udata, "ID_PART_ENTRY_TYPE")))
 		prop->parttype = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_UUID")))
+	if ((data = get(udata, "ID_PART_ENTRY_UUID")))
 		prop->partuuid = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_NUMBER")))
+	if ((data = get(udata, "ID_PART_ENTRY_NUMBER")))
 		prop->partn = xstrdup(data);
-	if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_FLAGS")))
+	if ((data = get(udata, "ID_PART_ENTRY_FLAGS")))
 		prop->partflags = xstrdup(data);
 
-	data = udev_device_get_property_value(dev, "ID_WWN_WITH_EXTENSION");
+	data = get(udata, "ID_WWN_WITH_EXTENSION");
 	if (!data)
-		data = udev_device_get_property_value(dev, "ID_WWN");
+		data = get(udata, "ID_WWN");
 	if (data)
 		prop->wwn = xstrdup(data);
 
-	data = udev_device_get_property_value(dev, "SCSI_IDENT_SERIAL");	/* sg3_utils do not use I_D prefix */
+	data = get(udata, "SCSI_IDENT_SERIAL");	/* sg3_utils do not use I_D prefix */
 	if (!data)
-		data = udev_device_get_property_value(dev, "ID_SCSI_SERIAL");
+		data = get(udata, "ID_SCSI_SERIAL");
 	if(!data)
-		data = udev_device_get_property_value(dev, "ID_SERIAL_SHORT");
+		data = get(udata, "ID_SERIAL_SHORT");
 	if(!data)
-		data = udev_device_get_property_value(dev, "ID_SERIAL");
+		data = get(udata, "ID_SERIAL");
 	if (data) {
 		prop->serial = xstrdup(data);
 		normalize_whitespace((unsigned char *) prop->serial);
 	}
 
-	if ((data = udev_device_get_property_value(dev, "ID_REVISION")))
+	if ((data = get(udata, "ID_REVISION")))
 		prop->revision = xstrdup(data);
 
-	if ((data = udev_device_get_property_value(dev, "ID_MODEL_ENC"))) {
+	if ((data = get(udata, "ID_MODEL_ENC"))) {
 		prop->model = xstrdup(data);
 		unhexmangle_string(prop->model);
 		normalize_whitespace((unsigned char *) prop->model);
-	} else if ((data = udev_device_get_property_value(dev, "ID_MODEL"))) {
+	} else if ((data = get(udata, "ID_MODEL"))) {
 		prop->model = xstrdup(data);
 		normalize_whitespace((unsigned char *) prop->model);
 	}
+}
 
-	/* select the shortest udev by-id symlink */
-	len = 0;
-	udev_list_entry_foreach(le, udev_device_get_devlinks_list_entry(dev)) {
-		const char *name = udev_list_entry_get_name(le);
-		size_t sz;
+/* select the shortest udev by-id symlink, @name is relative to /dev */
+static void add_udev_idlink(struct lsblk_devprop *prop, const char *name)
+{
+	size_t sz;
 
-		if (!name || !startswith(name,  LSBLK_UDEV_BYID_PREFIX))
-			continue;
-		name += LSBLK_UDEV_BYID_PREFIXSZ;
-		if (!*name)
+	if (!name || !startswith(name, LSBLK_UDEV_BYID_PREFIX))
+		return;
+	name += LSBLK_UDEV_BYID_PREFIXSZ;
+	if (!*name)
+		return;
+	sz = strlen(name);
+	if (!prop->idlink || sz < strlen(prop->idlink)) {
+		free(prop->idlink);
+		prop->idlink = xstrdup(name);
+	}
+}
+
+/*
+ * Read the udev database record of the device directly. This is
+ * significantly cheaper than libudev which has to resolve the device
+ * in sysfs first. The record is a list of "<type>:<data>" lines, we use
+ * "E:<name>=<value>" (environment) and "S:<link>" (symlinks) only.
+ */
+struct udevdb_record {
+	char	**env;
+	size_t	nenv;
+};
+
+static const char *udevdb_get_value(void *data, const char *name)
+{
+	struct udevdb_record *rec = (struct udevdb_record *) data;
+	size_t i, len = strlen(name);
+
+	for (i = 0; i < rec->nenv; i++) {
+		if (strncmp(rec->env[i], name, len) == 0 && rec->env[i][len] == '=')
+			return rec->env[i] + len + 1;
+	}
+	return NULL;
+}
+
+static struct lsblk_devprop *get_properties_by_udevdb(struct lsblk_device *ld)
+{
+	struct udevdb_record rec = { .env = NULL };
+	struct lsblk_devprop *prop;
+	char path[PATH_MAX], *line = NULL;
+	size_t sz = 0, i;
+	ssize_t len;
+	FILE *f;
+
+	if (ld->udev_requested)
+		return ld->properties;
+
+	snprintf(path, sizeof(path), _PATH_UDEV_DATA "/b%d:%d", ld->maj, ld->min);
+	f = fopen(path, "r" UL_CLOEXECSTR);
+	if (!f)
+		return NULL;
+
+	DBG(DEV, ul_debugobj(ld, "%s: found udev db record", ld->name));
+
+	if (ld->properties)
+		lsblk_device_free_properties(ld->properties);
+	prop = ld->properties = xcalloc(1, sizeof(*ld->properties));
+
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len < 3 || line[1] != ':')
 			continue;
-		sz = strlen(name);
-		if (!len || sz < len) {
-			len = sz;
-			free(prop->idlink);
-			prop->idlink = xstrdup(name);
+		switch (line[0]) {
+		case 'E':
+			rec.env = xreallocarray(rec.env, rec.nenv + 1, sizeof(char *));
+			rec.env[rec.nenv++] = xstrdup(line + 2);
+			break;
+		case 'S':
+			add_udev_idlink(prop, line + 2);
+			break;
 		}
 	}
+	free(line);
+	fclose(f);
+
+	fill_udev_properties(prop, udevdb_get_value, &rec);
+
+	for (i = 0; i < rec.nenv; i++)
+		free(rec.env[i]);
+	free(rec.env);
+
+	ld->udev_requested = 1;
+
+	DBG(DEV, ul_debugobj(ld, " from udev db"));
+	return ld->properties;
+}
+
+#ifndef HAVE_LIBUDEV
+static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *dev
+				__attribute__((__unused__)))
+{
+	return NULL;
+}
+#else
+
+static const char *udev_get_value(void *data, const char *name)
+{
+	return udev_device_get_property_value((struct udev_device *) data, name);
+}
+
+static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *ld)
+{
+	struct udev_device *dev;
+	struct udev_list_entry *le;
+	struct lsblk_devprop *prop;
+
+	if (ld->udev_requested)
+		return ld->properties;
+
+	if (!udev)
+		udev = udev_new();	/* global handler */
+	if (!udev)
+		goto done;
+
+	dev = udev_device_new_from_subsystem_sysname(udev, "block", ld->name);
+	if (!dev)
+		goto done;
+
+	DBG(DEV, ul_debugobj(ld, "%s: found udev properties", ld->name));
+
+	if (ld->properties)
+		lsblk_device_free_properties(ld->properties);
+	prop = ld->properties = xcalloc(1, sizeof(*ld->properties));
+
+	fill_udev_properties(prop, udev_get_value, dev);
+
+	udev_list_entry_foreach(le, udev_device_get_devlinks_list_entry(dev)) {
+		const char *name = udev_list_entry_get_name(le);
+
+		if (name && startswith(name, "/dev/"))
+			add_udev_idlink(prop, name + 5);
+	}
 
 	udev_device_unref(dev);
 done:
@@ -352,7 +449,9 @@ struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev)
 	if (lsblk->sysroot)
 		return get_properties_by_file(dev);
 
-	p = get_properties_by_udev(dev);
+	p = get_properties_by_udevdb(dev);
+	if (!p)
+		p = get_properties_by_udev(dev);
 	if (!p)
 		p = get_properties_by_blkid(dev);
 	return p;
@@ -361,10 +460,67 @@ struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev)
 void lsblk_properties_deinit(void)
 {
 #ifdef HAVE_LIBUDEV
+	udev_monitor_unref(udevmon);
 	udev_unref(udev);
 #endif
 }
 
+#ifdef HAVE_LIBUDEV
+/*
+ * Returns file descriptor to poll() for block devices events or -1.
+ */
+int lsblk_udev_monitor_get_fd(void)
+{
+	if (!udevmon) {
+		if (!udev)
+			udev = udev_new();	/* global handler */
+		if (!udev)
+			return -1;
+
+		udevmon = udev_monitor_new_from_netlink(udev, "udev");
+		if (!udevmon)
+			return -1;
+		if (udev_monitor_filter_add_match_subsystem_devtype(udevmon, "block", NULL) != 0
+		    || udev_monitor_enable_receiving(udevmon) != 0) {
+			udev_monitor_unref(udevmon);
+			udevmon = NULL;
+			return -1;
+		}
+	}
+	return udev_monitor_get_fd(udevmon);
+}
+
+/*
+ * Drains the monitor. Returns 1 if any block device has been changed.
+ */
+int lsblk_udev_monitor_read(void)
+{
+	struct udev_device *dev;
+	int changed = 0;
+
+	if (!udevmon)
+		return 0;
+	while ((dev = udev_monitor_receive_device(udevmon))) {
+		DBG(DEV, ul_debug("udev event: %s %s",
+				udev_device_get_action(dev),
+				udev_device_get_sysname(dev)));
+		udev_device_unref(dev);
+		changed = 1;
+	}
+	return changed;
+}
+#else
+int lsblk_udev_monitor_get_fd(void)
+{
+	return -1;
+}
+
+int lsblk_udev_monitor_read(void)
+{
+	return 0;
+}
+#endif /* HAVE_LIBUDEV */
+
 
 
 /*
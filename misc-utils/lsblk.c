@@ -36,6 +36,7 @@
 #include <grp.h>
 #include <ctype.h>
 #include <assert.h>
+#include <poll.h>
 
 #include <blkid.h>
 
@@ -148,7 +149,8 @@ enum {
 	LSBLK_EXPORT =		(1 << 3),
 	LSBLK_TREE =		(1 << 4),
 	LSBLK_JSON =		(1 << 5),
-	LSBLK_SHELLVAR =	(1 << 6)
+	LSBLK_SHELLVAR =	(1 << 6),
+	LSBLK_CBOR =		(1 << 7)
 };
 
 /* Types used for qsort() and JSON */
@@ -270,6 +272,17 @@ static inline void add_column(int id)
 	columns[ ncolumns++ ] =  id;
 }
 
+/* Converts column ID (COL_*) to index in lsblk->sort_ids[] */
+static int sort_id_to_number(int id)
+{
+	size_t i;
+
+	for (i = 0; i < lsblk->nsorts; i++)
+		if (lsblk->sort_ids[i] == id)
+			return i;
+	return -1;
+}
+
 static inline void add_uniq_column(int id)
 {
 	if (column_id_to_number(id) < 0)
@@ -411,7 +424,7 @@ static int is_readonly_device(struct lsblk_device *dev)
 {
 	int fd, ro = 0;
 
-	if (ul_path_scanf(dev->sysfs, "ro", "%d", &ro) == 1)
+	if (ul_path_read_s32(dev->sysfs, &ro, "ro") == 0)
 		return ro;
 
 	/* fallback if "ro" attribute does not exist */
@@ -596,7 +609,8 @@ static char *get_subsystems(struct lsblk_device *dev)
 
 #define is_parsable(_l)	(scols_table_is_raw((_l)->table) || \
 			 scols_table_is_export((_l)->table) || \
-			 scols_table_is_json((_l)->table))
+			 scols_table_is_json((_l)->table) || \
+			 scols_table_is_cbor((_l)->table))
 
 static char *mk_name(const char *name)
 {
@@ -664,7 +678,8 @@ static void unref_line_rawdata(struct libscols_line *ln, struct libscols_table *
 		struct libscols_cell *ce;
 		void *data;
 
-		if (cl != lsblk->sort_col && !scols_column_has_data_func(cl))
+		if (sort_id_to_number(get_column_id(i)) < 0
+		    && !scols_column_has_data_func(cl))
 			continue;
 
 		ce = scols_line_get_column_cell(ln, cl);
@@ -726,7 +741,7 @@ static char *get_vfs_attribute(struct lsblk_device *dev, int id)
 	if (!vfs_attr)
 		sizestr = xstrdup("0");
 	else if (lsblk->bytes)
-		xasprintf(&sizestr, "%ju", vfs_attr);
+		sizestr = u64_to_string(vfs_attr);
 	else
 		sizestr = size_to_human_string(SIZE_SUFFIX_1LETTER, vfs_attr);
 
@@ -891,12 +906,12 @@ static char *device_get_data(
 			*rawdata = makedev(dev->maj, dev->min);
 		break;
 	case COL_MAJ:
-		xasprintf(&str, "%u", dev->maj);
+		str = u64_to_string(dev->maj);
 		if (rawdata)
 			*rawdata = dev->maj;
 		break;
 	case COL_MIN:
-		xasprintf(&str, "%u", dev->min);
+		str = u64_to_string(dev->min);
 		if (rawdata)
 			*rawdata = dev->min;
 		break;
@@ -1084,7 +1099,7 @@ static char *device_get_data(
 		break;
 	case COL_SIZE:
 		if (lsblk->bytes)
-			xasprintf(&str, "%ju", dev->size);
+			str = u64_to_string(dev->size);
 		else
 			str = size_to_human_string(SIZE_SUFFIX_1LETTER, dev->size);
 		if (rawdata)
@@ -1201,7 +1216,7 @@ static char *device_get_data(
 		if (ul_path_read_u64(dev->sysfs, &x, "queue/chunk_sectors") == 0) {
 			x <<= 9;
 			if (lsblk->bytes)
-				xasprintf(&str, "%ju", x);
+				str = u64_to_string(x);
 			else
 				str = size_to_human_string(SIZE_SUFFIX_1LETTER, x);
 			if (rawdata)
@@ -1261,7 +1276,7 @@ static void device_fill_scols_cell(struct lsblk_device *dev,
 	size_t datasiz = 0;
 	int rc, id = get_column_id(colnum);
 
-	if (lsblk->sort_id == id || scols_column_has_data_func(cl)) {
+	if (sort_id_to_number(id) >= 0 || scols_column_has_data_func(cl)) {
 		uint64_t rawdata = (uint64_t) -1;
 
 		data = device_get_data(dev, parent, id, &rawdata, &datasiz);
@@ -1329,6 +1344,7 @@ static void device_to_scols(
 	ln = scols_table_new_line(tab, link_group ? NULL : parent_line);
 	if (!ln)
 		err(EXIT_FAILURE, _("failed to allocate output line"));
+	scols_line_set_userdata(ln, dev);
 
 	dev->is_printed = 1;
 
@@ -1494,6 +1510,8 @@ static int initialize_device(struct lsblk_device *dev,
 		DBG(DEV, ul_debugobj(dev, "%s: failed to initialize sysfs handler", dev->name));
 		return -1;
 	}
+	/* sysfs attributes are read more than once, don't read them again */
+	ul_path_enable_cache(dev->sysfs, 1);
 
 	dev->maj = major(devno);
 	dev->min = minor(devno);
@@ -2110,6 +2128,47 @@ static void devtree_set_dedupkeys(struct lsblk_devtree *tr, int id)
 		device_set_dedupkey(dev, NULL, id);
 }
 
+/*
+ * Reads all devices or devices specified by @argv into the tree
+ */
+static int process_devices(struct lsblk_devtree *tr, int argc, char **argv)
+{
+	int cnt = 0, cnt_err = 0, i;
+
+	if (!argc) {
+		int rc = lsblk->inverse ?
+			process_all_devices_inverse(tr) :
+			process_all_devices(tr);
+
+		return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (process_one_device(tr, argv[i]) != 0)
+			cnt_err++;
+		cnt++;
+	}
+	return cnt == 0		? EXIT_FAILURE :	/* nothing */
+	       cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
+	       cnt_err		? LSBLK_EXIT_SOMEOK :	/* some ok */
+				  EXIT_SUCCESS;		/* all success */
+}
+
+static void devtree_to_table(struct lsblk_devtree *tr)
+{
+	if (lsblk->dedup_id > -1) {
+		devtree_set_dedupkeys(tr, lsblk->dedup_id);
+		lsblk_devtree_deduplicate_devices(tr);
+	}
+
+	devtree_to_scols(tr, lsblk->table);
+
+	if (lsblk->nsorts)
+		scols_sort_table_by_columns(lsblk->table, lsblk->sort_cols, lsblk->nsorts);
+	if (lsblk->force_tree_order)
+		scols_sort_table_by_tree(lsblk->table);
+}
+
 static struct libscols_filter *new_filter(const char *query)
 {
 	struct libscols_filter *f;
@@ -2310,6 +2369,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -E, --dedup <column> de-duplicate output by <column>\n"), out);
 	fputs(_(" -I, --include <list> show only devices with specified major numbers\n"), out);
 	fputs(_(" -J, --json           use JSON output format\n"), out);
+	fputs(_("     --cbor           use CBOR (binary JSON) output format\n"), out);
 	fputs(_(" -M, --merge          group parents of sub-trees (usable for RAIDs, Multi-path)\n"), out);
 	fputs(_(" -O, --output-all     output all columns\n"), out);
 	fputs(_(" -P, --pairs          use key=\"value\" output format\n"), out);
@@ -2336,10 +2396,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --inverse        inverse dependencies\n"), out);
 	fputs(_(" -t, --topology       output info about topology\n"), out);
 	fputs(_(" -w, --width <num>    specifies output width as number of characters\n"), out);
-	fputs(_(" -x, --sort <column>  sort output by <column>\n"), out);
+	fputs(_(" -x, --sort <list>    sort output by <column>[,<column>...]\n"), out);
 	fputs(_(" -y, --shell          use column names to be usable as shell variable identifiers\n"), out);
 	fputs(_(" -z, --zoned          print zone related information\n"), out);
 	fputs(_("     --sysroot <dir>  use specified directory as system root\n"), out);
+	fputs(_("     --watch          print changes of the devices until interrupted\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" -H, --list-columns   list the available columns\n"), out);
@@ -2378,6 +2439,275 @@ static void __attribute__((__noreturn__)) list_colunms(void)
 	exit(EXIT_SUCCESS);
 }
 
+/*
+ * --watch
+ *
+ * The devices are read again after udev or mount table events. Only the
+ * lines that have been added, removed or changed since the last state are
+ * printed to the separate table with ACTION column.
+ */
+#define LSBLK_WATCH_SETTLE_MS	100	/* wait for more events */
+
+struct watch_rec {
+	char			*key;	/* [<parent>/]<name> */
+	struct libscols_line	*ln;	/* line for watch->out */
+	unsigned int		seen : 1;
+};
+
+struct lsblk_watch {
+	struct libscols_table	*out;	/* changes */
+	size_t			*cols;	/* output columns, numbers in lsblk->table */
+	size_t			ncols;
+
+	struct watch_rec	*recs;	/* the last state, sorted by key */
+	size_t			nrecs;
+};
+
+static int cmp_watch_recs(const void *a, const void *b)
+{
+	return strcmp(((const struct watch_rec *) a)->key,
+		      ((const struct watch_rec *) b)->key);
+}
+
+static void free_watch_recs(struct watch_rec *recs, size_t nrecs)
+{
+	size_t i;
+
+	for (i = 0; i < nrecs; i++) {
+		free(recs[i].key);
+		scols_unref_line(recs[i].ln);
+	}
+	free(recs);
+}
+
+static void init_watch(struct lsblk_watch *wa)
+{
+	struct libscols_table *tb;
+	size_t i;
+
+	tb = wa->out = scols_new_table();
+	if (!tb)
+		errx(EXIT_FAILURE, _("failed to allocate output table"));
+
+	scols_table_enable_raw(tb, !!(lsblk->flags & LSBLK_RAW));
+	scols_table_enable_export(tb, !!(lsblk->flags & LSBLK_EXPORT));
+	scols_table_enable_shellvar(tb, !!(lsblk->flags & LSBLK_SHELLVAR));
+	scols_table_enable_ascii(tb, !!(lsblk->flags & LSBLK_ASCII));
+	scols_table_enable_json(tb, !!(lsblk->flags & LSBLK_JSON));
+	if (lsblk->flags & LSBLK_CBOR)
+		scols_table_enable_cbor(tb, 1);
+	scols_table_enable_noheadings(tb, !!(lsblk->flags & LSBLK_NOHEADINGS));
+	if (lsblk->flags & (LSBLK_JSON | LSBLK_CBOR))
+		scols_table_set_name(tb, "blockdevices");
+
+	if (!scols_table_new_column(tb, "ACTION", 7, 0))
+		err(EXIT_FAILURE, _("failed to allocate output column"));
+
+	wa->cols = xcalloc(ncolumns, sizeof(size_t));
+
+	for (i = 0; i < ncolumns; i++) {
+		const struct colinfo *ci = get_column_info(i);
+		struct libscols_column *cl = scols_table_get_column(lsblk->table, i);
+		int fl = ci->flags;
+
+		if (scols_column_is_hidden(cl))
+			continue;
+		cl = scols_table_new_column(tb, ci->name, ci->whint, fl);
+		if (!cl)
+			err(EXIT_FAILURE, _("failed to allocate output column"));
+		if (fl & SCOLS_FL_WRAP)
+			scols_column_set_wrapfunc(cl, NULL, scols_wrapzero_nextchunk, NULL);
+		set_column_type(ci, cl, fl);
+
+		wa->cols[wa->ncols++] = i;
+	}
+}
+
+/* reads the current state from lsblk->table */
+static struct watch_rec *read_watch_recs(struct lsblk_watch *wa, size_t *nrecs)
+{
+	struct libscols_iter *itr;
+	struct libscols_line *src;
+	struct watch_rec *recs;
+	size_t n = 0;
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
+
+	recs = xcalloc(scols_table_get_nlines(lsblk->table) + 1, sizeof(*recs));
+
+	while (scols_table_next_line(lsblk->table, itr, &src) == 0) {
+		struct lsblk_device *dev = scols_line_get_userdata(src);
+		struct libscols_line *parent = scols_line_get_parent(src);
+		struct libscols_line *ln;
+		size_t i;
+
+		if (!dev)
+			continue;
+		if (parent && scols_line_get_userdata(parent))
+			xasprintf(&recs[n].key, "%s/%s",
+				((struct lsblk_device *) scols_line_get_userdata(parent))->name,
+				dev->name);
+		else
+			recs[n].key = xstrdup(dev->name);
+
+		ln = recs[n].ln = scols_new_line();
+		if (!ln || scols_line_alloc_cells(ln, wa->ncols + 1) != 0)
+			err(EXIT_FAILURE, _("failed to allocate output line"));
+
+		for (i = 0; i < wa->ncols; i++) {
+			struct libscols_cell *ce = scols_line_get_cell(ln, i + 1);
+
+			if (scols_cell_copy_content(ce, scols_line_get_cell(src, wa->cols[i])))
+				err(EXIT_FAILURE, _("failed to add output data"));
+			scols_cell_set_userdata(ce, NULL);
+		}
+		n++;
+	}
+
+	scols_free_iter(itr);
+	*nrecs = n;
+	return recs;
+}
+
+static int watch_recs_differ(struct lsblk_watch *wa,
+			     struct watch_rec *a, struct watch_rec *b)
+{
+	size_t i;
+
+	for (i = 1; i <= wa->ncols; i++) {
+		struct libscols_cell *x = scols_line_get_cell(a->ln, i),
+				     *y = scols_line_get_cell(b->ln, i);
+		const char *xd = scols_cell_get_data(x),
+			   *yd = scols_cell_get_data(y);
+		size_t sz = scols_cell_get_datasiz(x);
+
+		if (!xd || !yd) {
+			if (xd != yd)
+				return 1;
+			continue;
+		}
+		if (sz != scols_cell_get_datasiz(y) || memcmp(xd, yd, sz) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void watch_add_change(struct lsblk_watch *wa, struct watch_rec *rec,
+			     const char *action)
+{
+	if (scols_line_set_data(rec->ln, 0, action)
+	    || scols_table_add_line(wa->out, rec->ln))
+		err(EXIT_FAILURE, _("failed to add output data"));
+}
+
+/* compare the current lsblk->table with the last state, print changes */
+static void watch_print_changes(struct lsblk_watch *wa)
+{
+	struct watch_rec *recs;
+	size_t nrecs, i;
+
+	recs = read_watch_recs(wa, &nrecs);
+
+	for (i = 0; i < nrecs; i++) {
+		struct watch_rec *old = NULL;
+
+		if (wa->nrecs)
+			old = bsearch(&recs[i], wa->recs, wa->nrecs,
+				      sizeof(struct watch_rec), cmp_watch_recs);
+		if (!old)
+			watch_add_change(wa, &recs[i], "add");
+		else {
+			old->seen = 1;
+			if (watch_recs_differ(wa, old, &recs[i]))
+				watch_add_change(wa, &recs[i], "change");
+		}
+	}
+	for (i = 0; i < wa->nrecs; i++) {
+		if (!wa->recs[i].seen)
+			watch_add_change(wa, &wa->recs[i], "remove");
+	}
+
+	if (scols_table_get_nlines(wa->out)) {
+		scols_print_table(wa->out);
+		fflush(stdout);
+		scols_table_remove_lines(wa->out);
+	}
+
+	free_watch_recs(wa->recs, wa->nrecs);
+
+	qsort(recs, nrecs, sizeof(struct watch_rec), cmp_watch_recs);
+	wa->recs = recs;
+	wa->nrecs = nrecs;
+}
+
+static int watch_devices(struct lsblk_devtree **tr, int argc, char **argv)
+{
+	struct lsblk_watch wa = { .out = NULL };
+	struct pollfd fds[2];
+	nfds_t nfds = 0;
+	int fd, rc = 0;
+
+	if ((fd = lsblk_udev_monitor_get_fd()) >= 0) {
+		fds[nfds].fd = fd;
+		fds[nfds++].events = POLLIN;
+	}
+	if ((fd = lsblk_mnt_monitor_get_fd()) >= 0) {
+		fds[nfds].fd = fd;
+		fds[nfds++].events = POLLIN;
+	}
+	if (!nfds) {
+		warnx(_("cannot monitor block devices and mount table"));
+		return -1;
+	}
+
+	init_watch(&wa);
+	wa.recs = read_watch_recs(&wa, &wa.nrecs);
+	qsort(wa.recs, wa.nrecs, sizeof(struct watch_rec), cmp_watch_recs);
+
+	while (1) {
+		int changed = 0;
+
+		if (poll(fds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("poll() failed"));
+			rc = -1;
+			break;
+		}
+
+		/* devices are often changed by a burst of events */
+		do {
+			changed |= lsblk_udev_monitor_read();
+			changed |= lsblk_mnt_monitor_read();
+		} while (poll(fds, nfds, LSBLK_WATCH_SETTLE_MS) > 0);
+
+		if (!changed)
+			continue;
+
+		DBG(TREE, ul_debug("watch: re-reading devices"));
+
+		if (lsblk->rawdata)
+			unref_table_rawdata(lsblk->table);
+		scols_table_remove_lines(lsblk->table);
+		lsblk_unref_devtree(*tr);
+
+		*tr = lsblk_new_devtree();
+		if (!*tr)
+			err(EXIT_FAILURE, _("failed to allocate device tree"));
+		process_devices(*tr, argc, argv);
+		devtree_to_table(*tr);
+
+		watch_print_changes(&wa);
+	}
+
+	free_watch_recs(wa.recs, wa.nrecs);
+	free(wa.cols);
+	scols_unref_table(wa.out);
+	return rc;
+}
+
 static void check_sysdevblock(void)
 {
 	if (access(_PATH_SYS_DEVBLOCK, R_OK) != 0)
@@ -2388,7 +2718,6 @@ static void check_sysdevblock(void)
 int main(int argc, char *argv[])
 {
 	struct lsblk _ls = {
-		.sort_id = -1,
 		.dedup_id = -1,
 		.flags = LSBLK_TREE,
 		.tree_id = COL_NAME
@@ -2398,13 +2727,15 @@ int main(int argc, char *argv[])
 	char *outarg = NULL;
 	size_t i;
 	unsigned int width = 0;
-	int force_tree = 0, has_tree_col = 0;
+	int force_tree = 0, has_tree_col = 0, watch = 0;
 
 	enum {
 		OPT_SYSROOT = CHAR_MAX + 1,
 		OPT_COUNTER_FILTER,
 		OPT_COUNTER,
 		OPT_HIGHLIGHT,
+		OPT_CBOR,
+		OPT_WATCH,
 	};
 
 	static const struct option longopts[] = {
@@ -2417,6 +2748,7 @@ int main(int argc, char *argv[])
 		{ "zoned",      no_argument,       NULL, 'z' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "json",       no_argument,       NULL, 'J' },
+		{ "cbor",       no_argument,       NULL, OPT_CBOR },
 		{ "output",     required_argument, NULL, 'o' },
 		{ "output-all", no_argument,       NULL, 'O' },
 		{ "filter",     required_argument, NULL, 'Q' },
@@ -2442,6 +2774,7 @@ int main(int argc, char *argv[])
 		{ "shell",      no_argument,       NULL, 'y' },
 		{ "tree",       optional_argument, NULL, 'T' },
 		{ "version",    no_argument,       NULL, 'V' },
+		{ "watch",	no_argument,       NULL, OPT_WATCH },
 		{ "width",	required_argument, NULL, 'w' },
 		{ "ct-filter",  required_argument, NULL, OPT_COUNTER_FILTER },
 		{ "ct",         required_argument, NULL, OPT_COUNTER },
@@ -2452,13 +2785,14 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'D','O' },
 		{ 'I','e' },
-		{ 'J', 'P', 'r' },
+		{ 'J', 'P', 'r', OPT_CBOR },
 		{ 'O','S' },
 		{ 'O','f' },
 		{ 'O','m' },
 		{ 'O','o' },
 		{ 'O','t' },
 		{ 'P','T', 'l','r' },
+		{ OPT_SYSROOT, OPT_WATCH },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -2643,12 +2977,21 @@ int main(int argc, char *argv[])
 			width = strtou32_or_err(optarg, _("invalid output width number argument"));
 			break;
 		case 'x':
+		{
+			int ids[ARRAY_SIZE(infos)], n;
+
 			lsblk->flags &= ~LSBLK_TREE; /* disable the default */
-			lsblk->sort_id = column_name_to_id(optarg, strlen(optarg));
-			if (lsblk->sort_id >= 0)
-				break;
-			errtryhelp(EXIT_FAILURE);
+			n = string_to_idarray(optarg, ids, ARRAY_SIZE(ids),
+					      column_name_to_id);
+			if (n <= 0)
+				errtryhelp(EXIT_FAILURE);
+
+			free(lsblk->sort_ids);
+			lsblk->sort_ids = xcalloc(n, sizeof(int));
+			memcpy(lsblk->sort_ids, ids, n * sizeof(int));
+			lsblk->nsorts = n;
 			break;
+		}
 
 		case OPT_COUNTER_FILTER:
 			new_counter_filter(optarg);
@@ -2659,6 +3002,12 @@ int main(int argc, char *argv[])
 		case OPT_HIGHLIGHT:
 			lsblk->hlighter = new_filter(optarg);
 			break;
+		case OPT_CBOR:
+			lsblk->flags |= LSBLK_CBOR;
+			break;
+		case OPT_WATCH:
+			watch = 1;
+			break;
 
 		case 'H':
 			collist = 1;
@@ -2697,20 +3046,27 @@ int main(int argc, char *argv[])
 	if (lsblk->all_devices == 0 && nexcludes == 0 && nincludes == 0)
 		excludes[nexcludes++] = 1;	/* default: ignore RAM disks */
 
-	if (lsblk->sort_id < 0)
+	if (!lsblk->nsorts) {
 		/* Since Linux 4.8 we have sort devices by default, because
 		 * /sys is no more sorted */
-		lsblk->sort_id = COL_MAJMIN;
+		lsblk->sort_ids = xcalloc(1, sizeof(int));
+		lsblk->sort_ids[0] = COL_MAJMIN;
+		lsblk->nsorts = 1;
+	}
+	lsblk->sort_cols = xcalloc(lsblk->nsorts, sizeof(struct libscols_column *));
+	lsblk->sort_hidden = xcalloc(lsblk->nsorts, sizeof(char));
 
 	/* For --{inverse,raw,pairs} --list we still follow parent->child relation */
 	if (!(lsblk->flags & LSBLK_TREE)
 	    && (lsblk->inverse || lsblk->flags & LSBLK_EXPORT || lsblk->flags & LSBLK_RAW))
 		lsblk->force_tree_order = 1;
 
-	if (lsblk->sort_id >= 0 && column_id_to_number(lsblk->sort_id) < 0) {
+	for (i = 0; i < lsblk->nsorts; i++) {
+		if (column_id_to_number(lsblk->sort_ids[i]) >= 0)
+			continue;
 		/* the sort column is not between output columns -- add as hidden */
-		add_column(lsblk->sort_id);
-		lsblk->sort_hidden = 1;
+		add_column(lsblk->sort_ids[i]);
+		lsblk->sort_hidden[i] = 1;
 	}
 
 	if (lsblk->dedup_id >= 0 && column_id_to_number(lsblk->dedup_id) < 0) {
@@ -2732,9 +3088,11 @@ int main(int argc, char *argv[])
 	scols_table_enable_shellvar(lsblk->table, !!(lsblk->flags & LSBLK_SHELLVAR));
 	scols_table_enable_ascii(lsblk->table, !!(lsblk->flags & LSBLK_ASCII));
 	scols_table_enable_json(lsblk->table, !!(lsblk->flags & LSBLK_JSON));
+	if (lsblk->flags & LSBLK_CBOR)
+		scols_table_enable_cbor(lsblk->table, 1);
 	scols_table_enable_noheadings(lsblk->table, !!(lsblk->flags & LSBLK_NOHEADINGS));
 
-	if (lsblk->flags & LSBLK_JSON)
+	if (lsblk->flags & (LSBLK_JSON | LSBLK_CBOR))
 		scols_table_set_name(lsblk->table, "blockdevices");
 	if (width) {
 		scols_table_set_termwidth(lsblk->table, width);
@@ -2745,6 +3103,7 @@ int main(int argc, char *argv[])
 		const struct colinfo *ci = get_column_info(i);
 		struct libscols_column *cl;
 		int id = get_column_id(i), fl = ci->flags;
+		int sortn = sort_id_to_number(id);
 
 		if ((lsblk->flags & LSBLK_TREE)
 		    && has_tree_col == 0
@@ -2754,13 +3113,13 @@ int main(int argc, char *argv[])
 			has_tree_col = 1;
 		}
 
-		if (lsblk->sort_hidden && lsblk->sort_id == id)
+		if (sortn >= 0 && lsblk->sort_hidden[sortn])
 			fl |= SCOLS_FL_HIDDEN;
 		if (lsblk->dedup_hidden && lsblk->dedup_id == id)
 			fl |= SCOLS_FL_HIDDEN;
 
 		if (force_tree
-		    && lsblk->flags & LSBLK_JSON
+		    && lsblk->flags & (LSBLK_JSON | LSBLK_CBOR)
 		    && has_tree_col == 0
 		    && i + 1 == ncolumns)
 			/* The "--tree --json" specified, but no column with
@@ -2773,8 +3132,8 @@ int main(int argc, char *argv[])
 			warn(_("failed to allocate output column"));
 			goto leave;
 		}
-		if (!lsblk->sort_col && lsblk->sort_id == id) {
-			lsblk->sort_col = cl;
+		if (sortn >= 0 && !lsblk->sort_cols[sortn]) {
+			lsblk->sort_cols[sortn] = cl;
 			lsblk->rawdata = 1;
 			scols_column_set_cmpfunc(cl,
 				ci->type == COLTYPE_NUM     ? cmp_u64_cells :
@@ -2804,42 +3163,19 @@ int main(int argc, char *argv[])
 	if (!tr)
 		err(EXIT_FAILURE, _("failed to allocate device tree"));
 
-	if (optind == argc) {
-		int rc = lsblk->inverse ?
-			process_all_devices_inverse(tr) :
-			process_all_devices(tr);
-
-		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
-	} else {
-		int cnt = 0, cnt_err = 0;
-
-		while (optind < argc) {
-			if (process_one_device(tr, argv[optind++]) != 0)
-				cnt_err++;
-			cnt++;
-		}
-		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
-			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
-			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
-					  EXIT_SUCCESS;		/* all success */
-	}
-
-	if (lsblk->dedup_id > -1) {
-		devtree_set_dedupkeys(tr, lsblk->dedup_id);
-		lsblk_devtree_deduplicate_devices(tr);
-	}
-
-	devtree_to_scols(tr, lsblk->table);
-
-	if (lsblk->sort_col)
-		scols_sort_table(lsblk->table, lsblk->sort_col);
-	if (lsblk->force_tree_order)
-		scols_sort_table_by_tree(lsblk->table);
+	status = process_devices(tr, argc - optind, argv + optind);
+	devtree_to_table(tr);
 
 	scols_print_table(lsblk->table);
 
 	if (lsblk->ncts)
 		print_counters();
+
+	if (watch) {
+		fflush(stdout);
+		if (watch_devices(&tr, argc - optind, argv + optind) != 0)
+			status = EXIT_FAILURE;
+	}
 leave:
 	if (lsblk->rawdata)
 		unref_table_rawdata(lsblk->table);
@@ -2852,6 +3188,10 @@ leave:
 		scols_unref_filter(lsblk->ct_filters[i]);
 	free(lsblk->ct_filters);
 
+	free(lsblk->sort_ids);
+	free(lsblk->sort_cols);
+	free(lsblk->sort_hidden);
+
 	lsblk_mnt_deinit();
 	lsblk_properties_deinit();
 	lsblk_unref_devtree(tr);
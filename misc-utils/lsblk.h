@@ -34,9 +34,11 @@ UL_DEBUG_DECLARE_MASK(lsblk);
 
 struct lsblk {
 	struct libscols_table *table;	/* output table */
-	struct libscols_column *sort_col;/* sort output by this column */
+	struct libscols_column **sort_cols;/* sort output by these columns */
 
-	int sort_id;			/* id of the sort column */
+	int *sort_ids;			/* ids of the sort columns */
+	char *sort_hidden;		/* sort column not between output columns */
+	size_t nsorts;			/* number of sort columns */
 	int tree_id;			/* od of column used for tree */
 
 	int dedup_id;
@@ -60,7 +62,6 @@ struct lsblk {
 	unsigned int nvme:1;		/* print NVMe device only */
 	unsigned int virtio:1;		/* print virtio device only */
 	unsigned int paths:1;		/* print devnames with "/dev" prefix */
-	unsigned int sort_hidden:1;	/* sort column not between output columns */
 	unsigned int rawdata : 1;	/* has rawdata in cell userdata */
 	unsigned int dedup_hidden :1;	/* deduplication column not between output columns */
 	unsigned int force_tree_order:1;/* sort lines by parent->tree relation */
@@ -149,6 +150,7 @@ struct lsblk_device {
 	unsigned int	is_mounted : 1,
 			is_swap : 1,
 			is_printed : 1,
+			fss_requested : 1,
 			udev_requested : 1,
 			blkid_requested : 1,
 			file_requested : 1;
@@ -183,6 +185,8 @@ struct lsblk_devtree {
 	struct list_head	devices;	/* all devices */
 	struct list_head	pktcdvd_map;	/* devnomap->ls_devnomap */
 
+	void			*devices_by_name;	/* tsearch() tree, keyed by device name */
+
 	unsigned int	is_inverse : 1,		/* inverse tree */
 			pktcdvd_read : 1;
 };
@@ -221,6 +225,8 @@ struct lsblk_iter {
 /* lsblk-mnt.c */
 extern void lsblk_mnt_init(void);
 extern void lsblk_mnt_deinit(void);
+extern int lsblk_mnt_monitor_get_fd(void);
+extern int lsblk_mnt_monitor_read(void);
 
 extern void lsblk_device_free_filesystems(struct lsblk_device *dev);
 extern const char *lsblk_device_get_mountpoint(struct lsblk_device *dev);
@@ -230,6 +236,8 @@ extern struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev,
 extern void lsblk_device_free_properties(struct lsblk_devprop *p);
 extern struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev);
 extern void lsblk_properties_deinit(void);
+extern int lsblk_udev_monitor_get_fd(void);
+extern int lsblk_udev_monitor_read(void);
 
 extern const char *lsblk_parttype_code_to_string(const char *code, const char *pttype);
 
@@ -24,7 +24,9 @@
 #include <inttypes.h>
 #include <getopt.h>
 #include <glob.h>
+#include <sched.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 
 #include <libsmartcols.h>
 
@@ -76,6 +78,14 @@
 #define CLOCK_TAI			11
 #endif
 
+#ifndef FD_TO_CLOCKID
+#define FD_TO_CLOCKID(fd)		((~(clockid_t) (fd) << 3) | 3)
+#endif
+
+#define BENCH_DEFAULT_SAMPLES		10000
+#define BENCH_RTC_SAMPLES		100	/* RTC reads may take milliseconds */
+#define BENCH_SKEW_ROUNDS		16
+
 enum CLOCK_TYPE {
 	CT_SYS,
 	CT_PTP,
@@ -133,6 +143,11 @@ enum {
 	COL_RESOL_RAW,
 	COL_REL_TIME,
 	COL_NS_OFFSET,
+	COL_LAT_MIN,
+	COL_LAT_P50,
+	COL_LAT_P99,
+	COL_LAT_SYSCALL,
+	COL_CPU_SKEW,
 };
 
 /* column names */
@@ -156,8 +171,26 @@ static const struct colinfo infos[] = {
 	[COL_RESOL_RAW]  = { "RESOL_RAW",  1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("resolution") },
 	[COL_REL_TIME]   = { "REL_TIME",   1, SCOLS_FL_RIGHT, SCOLS_JSON_STRING, N_("human readable relative time") },
 	[COL_NS_OFFSET]  = { "NS_OFFSET",  1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("namespace offset") },
+	[COL_LAT_MIN]    = { "LAT_MIN",    1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("minimal read latency in ns") },
+	[COL_LAT_P50]    = { "LAT_P50",    1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("median read latency in ns") },
+	[COL_LAT_P99]    = { "LAT_P99",    1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("99th percentile of read latency in ns") },
+	[COL_LAT_SYSCALL] = { "LAT_SYSCALL", 1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("median read latency without vDSO in ns") },
+	[COL_CPU_SKEW]   = { "CPU_SKEW",   1, SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER, N_("largest backward step between CPUs in ns") },
+};
+
+/* read latency, see --bench */
+struct clock_bench {
+	uint64_t min, p50, p99;		/* in nanoseconds */
+	uint64_t syscall_p50;
+	uint64_t skew;
+
+	bool	has_lat,
+		has_syscall,
+		has_skew;
 };
 
+static size_t bench_samples;		/* zero if no bench column is used */
+
 static int column_name_to_id(const char *name, size_t namesz)
 {
 	size_t i;
@@ -191,6 +224,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" --no-discover-dynamic      do not try to discover dynamic clocks\n"), out);
 	fputs(_(" -d, --dynamic-clock <path> also display specified dynamic clock\n"), out);
 	fputs(_(" -c, --cpu-clock <pid>      also display CPU clock of specified process\n"), out);
+	fputs(_("     --bench[=<samples>]    measure the read latency of the clocks\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(29));
@@ -280,9 +314,152 @@ static int64_t get_namespace_offset(const char *name)
 	return ret;
 }
 
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+typedef int (*bench_read_fn)(clockid_t id, int fd);
+
+static int bench_read_clock(clockid_t id, int fd __attribute__((__unused__)))
+{
+	struct timespec ts;
+
+	return clock_gettime(id, &ts);
+}
+
+static int bench_read_syscall(clockid_t id, int fd __attribute__((__unused__)))
+{
+	struct timespec ts;
+
+	return syscall(SYS_clock_gettime, id, &ts);
+}
+
+static int bench_read_rtc(clockid_t id __attribute__((__unused__)), int fd)
+{
+	struct rtc_time rtc_time;
+
+	return ioctl(fd, RTC_RD_TIME, &rtc_time);
+}
+
+/*
+ * Time @nsamples reads one by one. The cost of the CLOCK_MONOTONIC_RAW reads
+ * around every sample is measured first and subtracted.
+ */
+static int bench_reads(bench_read_fn fn, clockid_t id, int fd, size_t nsamples,
+		       uint64_t *min, uint64_t *p50, uint64_t *p99)
+{
+	uint64_t *s, overhead, t;
+	size_t i;
+	int rc = 0;
+
+	s = xmalloc(nsamples * sizeof(*s));
+
+	for (i = 0; i < nsamples; i++) {
+		t = bench_now();
+		s[i] = bench_now() - t;
+	}
+	qsort(s, nsamples, sizeof(*s), cmp_u64);
+	overhead = s[nsamples / 2];
+
+	/* warm up caches */
+	for (i = 0; i < 16 && i < nsamples; i++) {
+		if (fn(id, fd) != 0) {
+			rc = -errno;
+			goto done;
+		}
+	}
+
+	for (i = 0; i < nsamples; i++) {
+		t = bench_now();
+		fn(id, fd);
+		t = bench_now() - t;
+		s[i] = t > overhead ? t - overhead : 0;
+	}
+	qsort(s, nsamples, sizeof(*s), cmp_u64);
+
+	*min = s[0];
+	*p50 = s[nsamples / 2];
+	if (p99)
+		*p99 = s[(nsamples * 99) / 100];
+done:
+	free(s);
+	return rc;
+}
+
+/*
+ * Migrate over all allowed CPUs and read the clock on each of them. The
+ * largest step back in time between two CPUs is reported; it is the lower
+ * bound of the clock skew between the CPUs.
+ */
+static int bench_skew(clockid_t id, uint64_t *skew)
+{
+	cpu_set_t orig, set;
+	uint64_t prev = 0, worst = 0;
+	int cpu, prev_cpu = -1, round, rc;
+
+	if (sched_getaffinity(0, sizeof(orig), &orig) != 0)
+		return -errno;
+	if (CPU_COUNT(&orig) < 2)
+		return -EINVAL;
+
+	for (round = 0; round < BENCH_SKEW_ROUNDS; round++) {
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			struct timespec ts;
+			uint64_t now;
+
+			if (!CPU_ISSET(cpu, &orig))
+				continue;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			if (sched_setaffinity(0, sizeof(set), &set) != 0)
+				continue;
+			if (clock_gettime(id, &ts) != 0)
+				goto done;
+
+			now = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+			if (prev_cpu >= 0 && prev_cpu != cpu && now < prev)
+				worst = max(worst, prev - now);
+			prev = now;
+			prev_cpu = cpu;
+		}
+	}
+done:
+	rc = prev_cpu >= 0 ? 0 : -EINVAL;
+	if (sched_setaffinity(0, sizeof(orig), &orig) != 0)
+		err(EXIT_FAILURE, _("failed to restore CPU affinity"));
+	*skew = worst;
+	return rc;
+}
+
+static void bench_posix_clock(clockid_t id, bool is_sys, struct clock_bench *bench)
+{
+	uint64_t syscall_min;
+
+	if (bench_reads(bench_read_clock, id, -1, bench_samples,
+			&bench->min, &bench->p50, &bench->p99) == 0)
+		bench->has_lat = true;
+	if (bench_reads(bench_read_syscall, id, -1, bench_samples,
+			&syscall_min, &bench->syscall_p50, NULL) == 0)
+		bench->has_syscall = true;
+	if (is_sys && bench_skew(id, &bench->skew) == 0)
+		bench->has_skew = true;
+}
+
 static void add_clock_line(struct libscols_table *tb, const int *columns,
 			   size_t ncolumns, const struct clockinfo *clockinfo,
-			   const struct timespec *now, const struct timespec *resolution)
+			   const struct timespec *now, const struct timespec *resolution,
+			   const struct clock_bench *bench)
 {
 	char buf[FORMAT_TIMESTAMP_MAX];
 	struct libscols_line *ln;
@@ -352,6 +529,26 @@ static void add_clock_line(struct libscols_table *tb, const int *columns,
 					scols_line_asprintf(ln, i, "%"PRId64,
 							    get_namespace_offset(clockinfo->ns_offset_name));
 				break;
+			case COL_LAT_MIN:
+				if (bench && bench->has_lat)
+					scols_line_asprintf(ln, i, "%"PRIu64, bench->min);
+				break;
+			case COL_LAT_P50:
+				if (bench && bench->has_lat)
+					scols_line_asprintf(ln, i, "%"PRIu64, bench->p50);
+				break;
+			case COL_LAT_P99:
+				if (bench && bench->has_lat)
+					scols_line_asprintf(ln, i, "%"PRIu64, bench->p99);
+				break;
+			case COL_LAT_SYSCALL:
+				if (bench && bench->has_syscall)
+					scols_line_asprintf(ln, i, "%"PRIu64, bench->syscall_p50);
+				break;
+			case COL_CPU_SKEW:
+				if (bench && bench->has_skew)
+					scols_line_asprintf(ln, i, "%"PRIu64, bench->skew);
+				break;
 		}
 	}
 }
@@ -360,6 +557,7 @@ static void add_posix_clock_line(struct libscols_table *tb, const int *columns,
 			         size_t ncolumns, const struct clockinfo *clockinfo)
 {
 	struct timespec resolution, now;
+	struct clock_bench bench = { 0 };
 	int rc;
 
 	rc = clock_gettime(clockinfo->id, &now);
@@ -370,7 +568,10 @@ static void add_posix_clock_line(struct libscols_table *tb, const int *columns,
 	if (rc)
 		resolution.tv_nsec = -1;
 
-	add_clock_line(tb, columns, ncolumns, clockinfo, &now, &resolution);
+	if (bench_samples && now.tv_nsec != -1)
+		bench_posix_clock(clockinfo->id, clockinfo->type == CT_SYS, &bench);
+
+	add_clock_line(tb, columns, ncolumns, clockinfo, &now, &resolution, &bench);
 }
 
 struct path_clock {
@@ -392,6 +593,7 @@ static void add_dynamic_clock_from_path(struct libscols_table *tb,
 
 	struct clockinfo clockinfo = {
 		.type = CT_PTP,
+		.id = FD_TO_CLOCKID(fd),
 		.no_id = true,
 		.id_name = path,
 		.name = path,
@@ -428,6 +630,7 @@ static void add_rtc_clock_from_path(struct libscols_table *tb,
 	struct rtc_time rtc_time;
 	struct tm tm = { 0 };
 	struct timespec now = { 0 }, resolution = { .tv_nsec = -1 };
+	struct clock_bench bench = { 0 };
 
 	fd = open(path, O_RDONLY);
 	if (fd == -1) {
@@ -453,13 +656,18 @@ static void add_rtc_clock_from_path(struct libscols_table *tb,
 
 	now.tv_sec = mktime(&tm);
 
+	if (bench_samples &&
+	    bench_reads(bench_read_rtc, 0, fd, min(bench_samples, (size_t) BENCH_RTC_SAMPLES),
+			&bench.min, &bench.p50, &bench.p99) == 0)
+		bench.has_lat = true;
+
 	struct clockinfo clockinfo = {
 		.type = CT_RTC,
 		.no_id = true,
 		.id_name = path,
 		.name = path,
 	};
-	add_clock_line(tb, columns, ncolumns, &clockinfo, &now, &resolution);
+	add_clock_line(tb, columns, ncolumns, &clockinfo, &now, &resolution, &bench);
 
 	close(fd);
 }
@@ -522,7 +730,8 @@ int main(int argc, char **argv)
 	struct libscols_column *col;
 
 	bool noheadings = false, raw = false, json = false,
-	     disc_dynamic = true, disc_rtc = true;
+	     disc_dynamic = true, disc_rtc = true, bench = false;
+	size_t nsamples = BENCH_DEFAULT_SAMPLES;
 	const char *outarg = NULL;
 	int columns[ARRAY_SIZE(infos) * 2];
 	size_t ncolumns = 0;
@@ -538,6 +747,7 @@ int main(int argc, char **argv)
 		OPT_OUTPUT_ALL = CHAR_MAX + 1,
 		OPT_NO_DISC_DYN,
 		OPT_NO_DISC_RTC,
+		OPT_BENCH,
 	};
 	static const struct option longopts[] = {
 		{ "noheadings",          no_argument,       NULL, 'n' },
@@ -553,6 +763,7 @@ int main(int argc, char **argv)
 		{ "cpu-clock",           required_argument, NULL, 'c' },
 		{ "no-discover-rtc",     no_argument,       NULL, OPT_NO_DISC_RTC },
 		{ "rtc",                 required_argument, NULL, 'x' },
+		{ "bench",               optional_argument, NULL, OPT_BENCH },
 		{ 0 }
 	};
 
@@ -609,6 +820,13 @@ int main(int argc, char **argv)
 		case OPT_NO_DISC_RTC:
 			disc_rtc = false;
 			break;
+		case OPT_BENCH:
+			bench = true;
+			if (optarg)
+				nsamples = strtosize_or_err(optarg, _("failed to parse number of samples"));
+			if (!nsamples)
+				errx(EXIT_FAILURE, _("number of samples has to be greater than zero"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -636,12 +854,24 @@ int main(int argc, char **argv)
 		columns[ncolumns++] = COL_TIME;
 		columns[ncolumns++] = COL_RESOL;
 		columns[ncolumns++] = COL_ISO_TIME;
+		if (bench) {
+			columns[ncolumns++] = COL_LAT_MIN;
+			columns[ncolumns++] = COL_LAT_P50;
+			columns[ncolumns++] = COL_LAT_P99;
+			columns[ncolumns++] = COL_LAT_SYSCALL;
+			columns[ncolumns++] = COL_CPU_SKEW;
+		}
 	}
 
 	if (outarg && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
 					    &ncolumns, column_name_to_id) < 0)
 		return EXIT_FAILURE;
 
+	for (i = 0; i < ncolumns; i++) {
+		if (columns[i] >= COL_LAT_MIN)
+			bench_samples = nsamples;
+	}
+
 	scols_init_debug(0);
 
 	tb = scols_new_table();
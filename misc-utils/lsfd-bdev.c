@@ -48,8 +48,7 @@ static bool bdev_fill_column(struct proc *proc __attribute__((__unused__)),
 		if (devdrv)
 			str = xstrdup(devdrv);
 		else
-			xasprintf(&str, "%u",
-				  major(file->stat.st_rdev));
+			str = u64_to_string(major(file->stat.st_rdev));
 		break;
 	case COL_DEVTYPE:
 		if (scols_line_set_data(ln, column_index,
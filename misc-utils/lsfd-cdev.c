@@ -94,8 +94,7 @@ static bool cdev_fill_column(struct proc *proc __attribute__((__unused__)),
 		if (cdev->devdrv)
 			str = xstrdup(cdev->devdrv);
 		else
-			xasprintf(&str, "%u",
-				  major(file->stat.st_rdev));
+			str = u64_to_string(major(file->stat.st_rdev));
 		break;
 	default:
 		while (ops) {
@@ -345,8 +344,7 @@ static bool cdev_misc_fill_column(struct proc *proc  __attribute__((__unused__))
 		if (miscdev)
 			*str = xstrdup(miscdev);
 		else
-			xasprintf(str, "%u",
-				  minor(file->stat.st_rdev));
+			*str = u64_to_string(minor(file->stat.st_rdev));
 		return true;
 	case COL_SOURCE:
 		miscdev = get_miscdev(minor(file->stat.st_rdev));
@@ -183,8 +183,7 @@ static bool abst_fill_column(struct proc *proc,
 		break;
 	}
 	case COL_POS:
-		xasprintf(&str, "%" PRIu64,
-			  (does_file_has_fdinfo_alike(file))? file->pos: 0);
+		str = u64_to_string(does_file_has_fdinfo_alike(file) ? file->pos : 0);
 		break;
 	case COL_FLAGS: {
 		struct ul_buffer buf = UL_INIT_BUFFER;
@@ -204,7 +203,7 @@ static bool abst_fill_column(struct proc *proc,
 	case COL_MAPLEN:
 		if (!is_mapped_file(file))
 			return true;
-		xasprintf(&str, "%ju", (uintmax_t)get_map_length(file));
+		str = u64_to_string(get_map_length(file));
 		break;
 	default:
 		return false;
@@ -434,7 +433,7 @@ static bool file_fill_column(struct proc *proc __attribute__((__unused__)),
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_INODE:
-		xasprintf(&str, "%llu", (unsigned long long)file->stat.st_ino);
+		str = u64_to_string(file->stat.st_ino);
 		break;
 	case COL_SOURCE:
 		decode_source(buf, sizeof(buf), major(file->stat.st_dev), minor(file->stat.st_dev),
@@ -464,7 +463,7 @@ static bool file_fill_column(struct proc *proc __attribute__((__unused__)),
 		xasprintf(&str, "%jd", (intmax_t)file->stat.st_size);
 		break;
 	case COL_NLINK:
-		xasprintf(&str, "%ju", (uintmax_t)file->stat.st_nlink);
+		str = u64_to_string(file->stat.st_nlink);
 		break;
 	case COL_DELETED:
 		xasprintf(&str, "%d", file->stat.st_nlink == 0);
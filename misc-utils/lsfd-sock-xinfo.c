@@ -83,7 +83,9 @@ static int netns_compare(const void *a, const void *b)
 	const struct netns *netns_a = a;
 	const struct netns *netns_b = b;
 
-	return netns_a->inode - netns_b->inode;
+	if (netns_a->inode == netns_b->inode)
+		return 0;
+	return netns_a->inode < netns_b->inode ? -1 : 1;
 }
 
 static void netns_free(void *netns)
@@ -279,13 +281,20 @@ void finalize_sock_xinfos(void)
 {
 	if (self_netns_fd != -1)
 		close(self_netns_fd);
+	self_netns_fd = -1;
 	tdestroy(netns_tree, netns_free);
 	tdestroy(xinfo_tree, free_sock_xinfo);
+	netns_tree = xinfo_tree = NULL;
 }
 
 static int xinfo_compare(const void *a, const void *b)
 {
-	return ((struct sock_xinfo *)a)->inode - ((struct sock_xinfo *)b)->inode;
+	ino_t ia = ((struct sock_xinfo *)a)->inode;
+	ino_t ib = ((struct sock_xinfo *)b)->inode;
+
+	if (ia == ib)
+		return 0;
+	return ia < ib ? -1 : 1;
 }
 
 static void add_sock_info(struct sock_xinfo *xinfo)
@@ -91,8 +91,7 @@ static bool sock_fill_column(struct proc *proc __attribute__((__unused__)),
 		return false;
 	case COL_SOCK_NETNS:
 		if (sock->xinfo) {
-			xasprintf(&str, "%llu",
-				  (unsigned long long)sock->xinfo->netns_inode);
+			str = u64_to_string(sock->xinfo->netns_inode);
 			break;
 		}
 		return false;
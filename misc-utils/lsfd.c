@@ -32,6 +32,7 @@
 #include <ctype.h>
 #include <search.h>
 #include <poll.h>
+#include <pthread.h>
 #include <sys/select.h>
 
 #include <sys/uio.h>
@@ -120,9 +121,11 @@ static struct list_head blkdrvs;
  * IPC table
  */
 
-#define IPC_TABLE_SIZE 997
+#define IPC_TABLE_MINSZ 997
 struct ipc_table {
-	struct list_head tables[IPC_TABLE_SIZE];
+	struct list_head *tables;
+	size_t size;		/* number of slots */
+	size_t nipcs;		/* number of ipcs in the table */
 };
 
 static struct ipc_table ipc_table;
@@ -529,12 +532,35 @@ struct lsfd_control {
 			show_main : 1,		/* print main table */
 			show_summary : 1,	/* print summary/counters */
 			sockets_only : 1,	/* display only SOCKETS */
-			show_xmode : 1;		/* XMODE column is enabled. */
+			show_xmode : 1,		/* XMODE column is enabled. */
+			proc_filter : 1;	/* filter uses process columns only */
 
 	struct libscols_filter *filter;		/* filter */
 	struct libscols_filter **ct_filters;	/* counters (NULL terminated array) */
+
+	struct libscols_column **sort_cols;	/* sort output by these columns */
+	size_t nsorts;				/* number of sort columns */
+
+	unsigned int jobs;			/* number of threads reading /proc */
+	unsigned int watch_interval;		/* --watch, seconds between scans */
+};
+
+/* per-thread state of collect_processes() */
+struct lsfd_worker {
+	struct lsfd_control *ctl;
+	struct procfs_walker *walker;		/* /proc/<pid> and read buffer */
+	struct list_head *procs;		/* processes read for the current PID */
+	void *map_stat_tree;			/* for tsearch/tfind */
 };
 
+/*
+ * Protects the tables shared by the workers while the processes are read:
+ * the nodevs, the mount namespaces, the socket xinfos and the filter. The
+ * file contents (the ipc table, the name managers, ...) are initialized later
+ * by one thread, see add_procs().
+ */
+static pthread_mutex_t collect_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void *proc_tree;			/* for tsearch/tfind */
 
 static int proc_tree_compare(const void *a, const void *b)
@@ -649,6 +675,7 @@ static void add_mnt_ns(ino_t id)
 static const struct file_class *stat2class(struct stat *sb)
 {
 	dev_t dev;
+	bool mqueue;
 
 	assert(sb);
 
@@ -672,7 +699,10 @@ static const struct file_class *stat2class(struct stat *sb)
 		if (is_nsfs_dev(dev))
 			return &nsfs_file_class;
 
-		if (is_mqueue_dev(dev))
+		pthread_mutex_lock(&collect_lock);
+		mqueue = is_mqueue_dev(dev);
+		pthread_mutex_unlock(&collect_lock);
+		if (mqueue)
 			return &mqueue_file_class;
 
 		return &file_class;
@@ -718,6 +748,7 @@ static struct file *new_readlink_error_file(struct proc *proc, int error_no, int
 
 	file->error.syscall = "readlink";
 	file->error.number = error_no;
+	file->is_error = 1;
 	file->association = association;
 	file->name = NULL;
 
@@ -738,6 +769,7 @@ static struct file *new_stat_error_file(struct proc *proc, const char *name, int
 
 	file->error.syscall = "stat";
 	file->error.number = error_no;
+	file->is_error = 1;
 	file->association = association;
 	file->name = xstrdup(name);
 
@@ -775,6 +807,7 @@ static void free_file(struct file *file)
 			class->free_content(file);
 		class = class->super;
 	}
+	free(file->fdinfo);
 	free(file);
 }
 
@@ -803,11 +836,12 @@ static void free_proc(struct proc *proc)
 	free(proc);
 }
 
-static void read_fdinfo(struct file *file, FILE *fdinfo)
+static void read_fdinfo(struct file *file, char *fdinfo)
 {
-	char buf[1024];
+	char *buf, *save = NULL;
 
-	while (fgets(buf, sizeof(buf), fdinfo)) {
+	for (buf = strtok_r(fdinfo, "\n", &save); buf;
+	     buf = strtok_r(NULL, "\n", &save)) {
 		const struct file_class *class;
 		char *val = strchr(buf, ':');
 
@@ -828,12 +862,17 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 	}
 }
 
-static struct file *collect_file_symlink(struct path_cxt *pc,
+/*
+ * The file content is initialized and the fdinfo is parsed later, see
+ * init_proc_files().
+ */
+static struct file *collect_file_symlink(struct lsfd_worker *wk,
 					 struct proc *proc,
 					 const char *name,
 					 int assoc,
 					 bool sockets_only)
 {
+	struct path_cxt *pc = wk->walker->pc;
 	char sym[PATH_MAX] = { '\0' };
 	struct stat sb;
 	struct file *f, *prev;
@@ -864,31 +903,32 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 		f = new_file(proc, class, &sb, sym, assoc);
 	}
 
-	file_init_content(f);
-
 	if (f->is_error)
 		return f;
 
 	if (is_association(f, NS_MNT))
 		proc->ns_mnt = f->stat.st_ino;
-	else if (is_association(f, NS_NET))
+	else if (is_association(f, NS_NET)) {
+		pthread_mutex_lock(&collect_lock);
 		load_sock_xinfo(pc, name, f->stat.st_ino);
+		pthread_mutex_unlock(&collect_lock);
 
-	else if (assoc >= 0) {
+	} else if (assoc >= 0) {
 		/* file-descriptor based association */
-		FILE *fdinfo;
+		char fdinfo[sizeof("fdinfo/") + sizeof(stringify_value(INT_MAX))];
 
 		if (ul_path_stat(pc, &sb, AT_SYMLINK_NOFOLLOW, name) == 0)
 			f->mode = sb.st_mode;
 
-		if (is_nsfs_dev(f->stat.st_dev))
+		if (is_nsfs_dev(f->stat.st_dev)) {
+			pthread_mutex_lock(&collect_lock);
 			load_sock_xinfo(pc, name, f->stat.st_ino);
-
-		fdinfo = ul_path_fopenf(pc, "r", "fdinfo/%d", assoc);
-		if (fdinfo) {
-			read_fdinfo(f, fdinfo);
-			fclose(fdinfo);
+			pthread_mutex_unlock(&collect_lock);
 		}
+
+		snprintf(fdinfo, sizeof(fdinfo), "fdinfo/%d", assoc);
+		if (procfs_walker_read(wk->walker, fdinfo) > 0)
+			f->fdinfo = xstrdup(wk->walker->buf);
 	}
 
 	return f;
@@ -896,9 +936,10 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 
 /* read symlinks from /proc/#/fd
  */
-static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
+static void collect_fd_files(struct lsfd_worker *wk, struct proc *proc,
 			     bool sockets_only)
 {
+	struct path_cxt *pc = wk->walker->pc;
 	DIR *sub = NULL;
 	struct dirent *d = NULL;
 	char path[sizeof("fd/") + sizeof(stringify_value(UINT64_MAX))];
@@ -910,12 +951,68 @@ static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
 			continue;
 
 		snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) num);
-		collect_file_symlink(pc, proc, path, num, sockets_only);
+		collect_file_symlink(wk, proc, path, num, sockets_only);
+	}
+}
+
+/*
+ * The same files (libc, ld.so, ...) are mapped by almost all processes. The
+ * result of stat() is cached by device and inode number from the maps line
+ * and by the path. Every worker has its own cache.
+ */
+struct map_stat {
+	dev_t		devno;
+	ino_t		ino;
+	char		*path;
+	struct stat	sb;
+};
+
+static int map_stat_compare(const void *a, const void *b)
+{
+	const struct map_stat *x = a, *y = b;
+
+	if (x->devno != y->devno)
+		return x->devno < y->devno ? -1 : 1;
+	if (x->ino != y->ino)
+		return x->ino < y->ino ? -1 : 1;
+	return strcmp(x->path, y->path);
+}
+
+static void free_map_stat(void *data)
+{
+	struct map_stat *ms = data;
+
+	free(ms->path);
+	free(ms);
+}
+
+static int stat_mapped_file(struct lsfd_worker *wk, char *path,
+			    dev_t devno, ino_t ino, struct stat *sb)
+{
+	struct map_stat key = { .devno = devno, .ino = ino, .path = path };
+	struct map_stat **node = tfind(&key, &wk->map_stat_tree, map_stat_compare);
+	struct map_stat *ms;
+
+	if (node) {
+		*sb = (*node)->sb;
+		return 0;
 	}
+	if (stat(path, sb) < 0)
+		return -1;
+
+	ms = xmalloc(sizeof(*ms));
+	ms->devno = devno;
+	ms->ino = ino;
+	ms->path = xstrdup(path);
+	ms->sb = *sb;
+	if (tsearch(ms, &wk->map_stat_tree, map_stat_compare) == NULL)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return 0;
 }
 
-static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
+static void parse_maps_line(struct lsfd_worker *wk, char *buf, struct proc *proc)
 {
+	struct path_cxt *pc = wk->walker->pc;
 	uint64_t start, end, offset, ino;
 	unsigned long major, minor;
 	enum association assoc = ASSOC_MEM;
@@ -955,7 +1052,7 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 		f = copy_file(prev, -assoc);
 	else if ((path = strchr(buf, '/'))) {
 		rtrim_whitespace((unsigned char *) path);
-		if (stat(path, &sb) < 0)
+		if (stat_mapped_file(wk, path, devno, ino, &sb) < 0)
 			/* If a file is mapped but deleted from the file system,
 			 * "stat by the file name" may not work. In that case,
 			 */
@@ -986,26 +1083,24 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 	f->map_start = start;
 	f->map_end = end;
 	f->pos = offset;
-
-	file_init_content(f);
 }
 
-static void collect_mem_files(struct path_cxt *pc, struct proc *proc)
+static void collect_mem_files(struct lsfd_worker *wk, struct proc *proc)
 {
-	FILE *fp;
-	char buf[BUFSIZ];
+	char *line, *next;
 
-	fp = ul_path_fopen(pc, "r", "maps");
-	if (!fp)
+	if (procfs_walker_read(wk->walker, "maps") <= 0)
 		return;
 
-	while (fgets(buf, sizeof(buf), fp))
-		parse_maps_line(pc, buf, proc);
-
-	fclose(fp);
+	for (line = wk->walker->buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		parse_maps_line(wk, line, proc);
+	}
 }
 
-static void collect_outofbox_files(struct path_cxt *pc,
+static void collect_outofbox_files(struct lsfd_worker *wk,
 				   struct proc *proc,
 				   enum association assocs[],
 				   const char *names[],
@@ -1015,22 +1110,22 @@ static void collect_outofbox_files(struct path_cxt *pc,
 	size_t i;
 
 	for (i = 0; i < count; i++)
-		collect_file_symlink(pc, proc, names[assocs[i]], assocs[i] * -1,
+		collect_file_symlink(wk, proc, names[assocs[i]], assocs[i] * -1,
 				     sockets_only);
 }
 
-static void collect_execve_file(struct path_cxt *pc, struct proc *proc,
+static void collect_execve_file(struct lsfd_worker *wk, struct proc *proc,
 				bool sockets_only)
 {
 	enum association assocs[] = { ASSOC_EXE };
 	const char *names[] = {
 		[ASSOC_EXE]  = "exe",
 	};
-	collect_outofbox_files(pc, proc, assocs, names, ARRAY_SIZE(assocs),
+	collect_outofbox_files(wk, proc, assocs, names, ARRAY_SIZE(assocs),
 			       sockets_only);
 }
 
-static void collect_fs_files(struct path_cxt *pc, struct proc *proc,
+static void collect_fs_files(struct lsfd_worker *wk, struct proc *proc,
 			     bool sockets_only)
 {
 	enum association assocs[] = { ASSOC_CWD, ASSOC_ROOT };
@@ -1038,11 +1133,11 @@ static void collect_fs_files(struct path_cxt *pc, struct proc *proc,
 		[ASSOC_CWD]  = "cwd",
 		[ASSOC_ROOT] = "root",
 	};
-	collect_outofbox_files(pc, proc, assocs, names, ARRAY_SIZE(assocs),
+	collect_outofbox_files(wk, proc, assocs, names, ARRAY_SIZE(assocs),
 			       sockets_only);
 }
 
-static void collect_namespace_files(struct path_cxt *pc, struct proc *proc)
+static void collect_namespace_files(struct lsfd_worker *wk, struct proc *proc)
 {
 	enum association assocs[] = {
 		ASSOC_NS_CGROUP,
@@ -1068,7 +1163,7 @@ static void collect_namespace_files(struct path_cxt *pc, struct proc *proc)
 		[ASSOC_NS_USER]   = "ns/user",
 		[ASSOC_NS_UTS]    = "ns/uts",
 	};
-	collect_outofbox_files(pc, proc, assocs, names, ARRAY_SIZE(assocs),
+	collect_outofbox_files(wk, proc, assocs, names, ARRAY_SIZE(assocs),
 			       /* Namespace information is alwasys needed. */
 			       false);
 }
@@ -1114,6 +1209,8 @@ static void finalize_nodevs(void)
 		list_free(&nodev_table.tables[i], struct nodev, nodevs, free_nodev);
 
 	free(mnt_namespaces);
+	mnt_namespaces = NULL;
+	nspaces = 0;
 }
 
 const char *get_nodev_filesystem(unsigned long minor)
@@ -1156,10 +1253,20 @@ static void add_nodevs(FILE *mnt)
 	}
 }
 
+static struct list_head *new_ipc_slots(size_t size)
+{
+	struct list_head *tables = xcalloc(size, sizeof(struct list_head));
+
+	for (size_t i = 0; i < size; i++)
+		INIT_LIST_HEAD(tables + i);
+	return tables;
+}
+
 static void initialize_ipc_table(void)
 {
-	for (int i = 0; i < IPC_TABLE_SIZE; i++)
-		INIT_LIST_HEAD(ipc_table.tables + i);
+	ipc_table.size = IPC_TABLE_MINSZ;
+	ipc_table.tables = new_ipc_slots(ipc_table.size);
+	ipc_table.nipcs = 0;
 }
 
 static void free_ipc(struct ipc *ipc)
@@ -1171,8 +1278,32 @@ static void free_ipc(struct ipc *ipc)
 
 static void finalize_ipc_table(void)
 {
-	for (int i = 0; i < IPC_TABLE_SIZE; i++)
+	for (size_t i = 0; i < ipc_table.size; i++)
 		list_free(&ipc_table.tables[i], struct ipc, ipcs, free_ipc);
+	free(ipc_table.tables);
+	ipc_table.tables = NULL;
+	ipc_table.size = 0;
+}
+
+/* rehash to keep the lists short, a host may have many thousands of sockets */
+static void grow_ipc_table(void)
+{
+	size_t size = ipc_table.size * 2 + 1;
+	struct list_head *tables = new_ipc_slots(size);
+
+	for (size_t i = 0; i < ipc_table.size; i++) {
+		struct list_head *e, *next;
+
+		list_for_each_safe(e, next, &ipc_table.tables[i]) {
+			struct ipc *ipc = list_entry(e, struct ipc, ipcs);
+
+			list_del(&ipc->ipcs);
+			list_add_tail(&ipc->ipcs, &tables[ipc->hash % size]);
+		}
+	}
+	free(ipc_table.tables);
+	ipc_table.tables = tables;
+	ipc_table.size = size;
 }
 
 struct ipc *new_ipc(const struct ipc_class *class)
@@ -1186,7 +1317,7 @@ struct ipc *new_ipc(const struct ipc_class *class)
 
 struct ipc *get_ipc(struct file *file)
 {
-	int slot;
+	size_t slot;
 	struct list_head *e;
 	const struct ipc_class *ipc_class;
 
@@ -1197,7 +1328,7 @@ struct ipc *get_ipc(struct file *file)
 	if (!ipc_class)
 		return NULL;
 
-	slot = ipc_class->get_hash(file) % IPC_TABLE_SIZE;
+	slot = ipc_class->get_hash(file) % ipc_table.size;
 	list_for_each (e, &ipc_table.tables[slot]) {
 		struct ipc *ipc = list_entry(e, struct ipc, ipcs);
 		if (ipc->class != ipc_class)
@@ -1210,8 +1341,12 @@ struct ipc *get_ipc(struct file *file)
 
 void add_ipc(struct ipc *ipc, unsigned int hash)
 {
-	int slot = hash % IPC_TABLE_SIZE;
-	list_add(&ipc->ipcs, &ipc_table.tables[slot]);
+	if (ipc_table.nipcs >= ipc_table.size * 2)
+		grow_ipc_table();
+
+	ipc->hash = hash;
+	list_add(&ipc->ipcs, &ipc_table.tables[hash % ipc_table.size]);
+	ipc_table.nipcs++;
 }
 
 void init_endpoint(struct ipc_endpoint *endpoint)
@@ -1255,6 +1390,57 @@ static int filter_filler_cb(
 	return 0;
 }
 
+/*
+ * Returns true if the filter refers to process columns only. Such a filter
+ * returns the same result for all files of the process.
+ */
+static bool is_proc_filter(struct libscols_filter *fltr)
+{
+	struct libscols_iter *itr;
+	const char *name = NULL;
+	bool res = true;
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
+
+	while (res && scols_filter_next_holder(fltr, itr, &name, 0) == 0) {
+		switch (column_name_to_id(name, strlen(name))) {
+		case COL_PID:
+		case COL_COMMAND:
+		case COL_UID:
+		case COL_USER:
+		case COL_KTHREAD:
+			break;
+		default:
+			res = false;
+			break;
+		}
+	}
+
+	scols_free_iter(itr);
+	return res;
+}
+
+static bool match_proc_filter(struct lsfd_control *ctl, struct proc *proc)
+{
+	struct file dummy = { .class = &abst_class, .proc = proc };
+	struct filler_data fid = { .proc = proc, .file = &dummy };
+	struct libscols_line *ln;
+	int status = 0;
+
+	ln = scols_table_new_line(ctl->tb, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	scols_filter_set_filler_cb(ctl->filter, filter_filler_cb, (void *) &fid);
+	if (scols_line_apply_filter(ln, ctl->filter, &status))
+		err(EXIT_FAILURE, _("failed to apply filter"));
+
+	scols_table_remove_line(ctl->tb, ln);
+	return status != 0;
+}
+
 static void convert_file(struct proc *proc,
 		     struct file *file,
 		     struct libscols_line *ln)
@@ -1281,15 +1467,17 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 			struct file *file = list_entry(f, struct file, files);
 			struct libscols_line *ln = scols_table_new_line(ctl->tb, NULL);
 			struct libscols_filter **ct_fltr = NULL;
+			struct filler_data fid = {
+				.proc = proc,
+				.file = file
+			};
 
 			if (!ln)
 				err(EXIT_FAILURE, _("failed to allocate output line"));
+			scols_line_set_userdata(ln, file);
+
 			if (ctl->filter) {
 				int status = 0;
-				struct filler_data fid = {
-					.proc = proc,
-					.file = file
-				};
 
 				scols_filter_set_filler_cb(ctl->filter,
 						filter_filler_cb, (void *) &fid);
@@ -1301,6 +1489,18 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 				}
 			}
 
+			if (!ctl->show_main) {
+				/* summary only -- fill only cells used by
+				 * counters, the line is never printed */
+				for (ct_fltr = ctl->ct_filters; ct_fltr && *ct_fltr; ct_fltr++) {
+					scols_filter_set_filler_cb(*ct_fltr,
+						filter_filler_cb, (void *) &fid);
+					scols_line_apply_filter(ln, *ct_fltr, NULL);
+				}
+				scols_table_remove_line(ctl->tb, ln);
+				continue;
+			}
+
 			convert_file(proc, file, ln);
 
 			if (!ctl->ct_filters)
@@ -1312,7 +1512,7 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 	}
 }
 
-static void delete(struct list_head *procs, struct lsfd_control *ctl)
+static void delete_procs(struct list_head *procs)
 {
 	struct list_head *p;
 
@@ -1321,9 +1521,15 @@ static void delete(struct list_head *procs, struct lsfd_control *ctl)
 		tdelete(proc, &proc_tree, proc_tree_compare);
 	}
 	list_free(procs, struct proc, procs, free_proc);
+}
+
+static void delete(struct list_head *procs, struct lsfd_control *ctl)
+{
+	delete_procs(procs);
 
 	scols_unref_table(ctl->tb);
 	scols_unref_filter(ctl->filter);
+	free(ctl->sort_cols);
 
 	if (ctl->ct_filters) {
 		struct libscols_filter **ct_fltr;
@@ -1335,6 +1541,8 @@ static void delete(struct list_head *procs, struct lsfd_control *ctl)
 
 static void emit(struct lsfd_control *ctl)
 {
+	if (ctl->nsorts)
+		scols_sort_table_by_columns(ctl->tb, ctl->sort_cols, ctl->nsorts);
 	scols_print_table(ctl->tb);
 }
 
@@ -1520,27 +1728,24 @@ unsigned long add_name(struct name_manager *nm, const char *name)
 	if (e)
 		return e->id;
 
-	e = xmalloc(sizeof(struct identry));
-	e->name = xstrdup(name);
-	e->id = nm->next_id++;
-	e->next = nm->cache->ent;
-	nm->cache->ent = e;
+	e = add_id_entry(nm->cache, nm->next_id++, name);
+	if (!e)
+		err(EXIT_FAILURE, _("failed to allocate an idcache entry"));
 
 	return e->id;
 }
 
-static void walk_threads(struct lsfd_control *ctl, struct path_cxt *pc,
+static void walk_threads(struct lsfd_worker *wk,
 			 pid_t pid, struct proc *proc,
-			 void (*cb)(struct lsfd_control *, struct path_cxt *,
-				    pid_t, struct proc *))
+			 void (*cb)(struct lsfd_worker *, pid_t, struct proc *))
 {
 	DIR *sub = NULL;
 	pid_t tid = 0;
 
-	while (procfs_process_next_tid(pc, &sub, &tid) == 0) {
+	while (procfs_process_next_tid(wk->walker->pc, &sub, &tid) == 0) {
 		if (tid == pid)
 			continue;
-		(*cb)(ctl, pc, tid, proc);
+		(*cb)(wk, tid, proc);
 	}
 }
 
@@ -1640,14 +1845,13 @@ static void mark_select_fds_as_multiplexed(char *buf,
 	}
 }
 
-static void parse_proc_syscall(struct lsfd_control *ctl __attribute__((__unused__)),
-			       struct path_cxt *pc, pid_t pid, struct proc *proc)
+static void parse_proc_syscall(struct lsfd_worker *wk, pid_t pid, struct proc *proc)
 {
 	char buf[BUFSIZ];
 	char *ptr = NULL;
 	long scn;
 
-	if (procfs_process_get_syscall(pc, buf, sizeof(buf)) <= 0)
+	if (procfs_process_get_syscall(wk->walker->pc, buf, sizeof(buf)) <= 0)
 		return;
 
 	errno  = 0;
@@ -1692,11 +1896,54 @@ static void parse_proc_syscall(struct lsfd_control *ctl __attribute__((__unused_
 	}
 }
 
-static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
-			 pid_t pid, struct proc *leader)
+static void init_proc_files(struct proc *proc)
+{
+	struct list_head *f;
+
+	list_for_each (f, &proc->files) {
+		struct file *file = list_entry(f, struct file, files);
+
+		file_init_content(file);
+		if (file->fdinfo) {
+			read_fdinfo(file, file->fdinfo);
+			free(file->fdinfo);
+			file->fdinfo = NULL;
+		}
+	}
+}
+
+/*
+ * Initializes the files of the processes read by a worker and moves the
+ * processes to the output list. This is not thread-safe; the processes are
+ * added in the order of /proc, as if they were read by one thread.
+ */
+static void add_procs(struct lsfd_control *ctl, struct list_head *procs)
+{
+	struct list_head *p, *pnext;
+
+	list_for_each_safe (p, pnext, procs) {
+		struct proc *proc = list_entry(p, struct proc, procs);
+
+		init_proc_files(proc);
+
+		list_del(&proc->procs);
+		list_add_tail(&proc->procs, &ctl->procs);
+		if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
+	}
+}
+
+/*
+ * Reads the process and its threads to the list of the worker. The lists are
+ * added to the output by add_procs().
+ */
+static void read_process(struct lsfd_worker *wk, pid_t pid, struct proc *leader)
 {
+	struct lsfd_control *ctl = wk->ctl;
+	struct path_cxt *pc = wk->walker->pc;
 	char buf[BUFSIZ];
 	struct proc *proc;
+	bool match;
 
 	if (procfs_process_init_path(pc, pid) != 0)
 		return;
@@ -1729,12 +1976,31 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 		goto out;
 	}
 
-	collect_execve_file(pc, proc, ctl->sockets_only);
+	/* Don't collect files which will be filtered out anyway. The process
+	 * is still added, pidfd files of other processes refer to it.
+	 */
+	if (ctl->proc_filter) {
+		pthread_mutex_lock(&collect_lock);
+		match = match_proc_filter(ctl, proc);
+		pthread_mutex_unlock(&collect_lock);
+		if (!match) {
+			list_add_tail(&proc->procs, wk->procs);
+			goto out;
+		}
+	}
+
+	collect_execve_file(wk, proc, ctl->sockets_only);
 
 	if (proc->pid == proc->leader->pid
 	    || kcmp(proc->leader->pid, proc->pid, KCMP_FS, 0, 0) != 0)
-		collect_fs_files(pc, proc, ctl->sockets_only);
+		collect_fs_files(wk, proc, ctl->sockets_only);
+
+	/* sets proc->ns_mnt, must be called before reading mountinfo */
+	collect_namespace_files(wk, proc);
 
+	/* The nodevs are used by stat2class() in all workers, keep the lock
+	 * until the whole mountinfo is read. */
+	pthread_mutex_lock(&collect_lock);
 	if (proc->ns_mnt == 0 || !has_mnt_ns(proc->ns_mnt)) {
 		FILE *mnt = ul_path_fopen(pc, "r", "mountinfo");
 		if (mnt) {
@@ -1744,8 +2010,7 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 			fclose(mnt);
 		}
 	}
-
-	collect_namespace_files(pc, proc);
+	pthread_mutex_unlock(&collect_lock);
 
 	/* If kcmp is not available,
 	 * there is no way to know whether threads share resources.
@@ -1755,26 +2020,24 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	if ((!ctl->sockets_only)
 	    && (proc->pid == proc->leader->pid
 		|| kcmp(proc->leader->pid, proc->pid, KCMP_VM, 0, 0) != 0))
-		collect_mem_files(pc, proc);
+		collect_mem_files(wk, proc);
 
 	if (proc->pid == proc->leader->pid
 	    || kcmp(proc->leader->pid, proc->pid, KCMP_FILES, 0, 0) != 0)
-		collect_fd_files(pc, proc, ctl->sockets_only);
+		collect_fd_files(wk, proc, ctl->sockets_only);
 
-	list_add_tail(&proc->procs, &ctl->procs);
-	if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
-		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	list_add_tail(&proc->procs, wk->procs);
 
 	if (ctl->show_xmode)
-		parse_proc_syscall(ctl, pc, pid, proc);
+		parse_proc_syscall(wk, pid, proc);
 
 	/* The tasks collecting overwrites @pc by /proc/<task-pid>/. Keep it as
 	 * the last path based operation in read_process()
 	 */
 	if (ctl->threads && leader == NULL)
-		walk_threads(ctl, pc, pid, proc, read_process);
+		walk_threads(wk, pid, proc, read_process);
 	else if (ctl->show_xmode)
-		walk_threads(ctl, pc, pid, proc, parse_proc_syscall);
+		walk_threads(wk, pid, proc, parse_proc_syscall);
 
  out:
 	/* Let's be careful with number of open files */
@@ -1832,16 +2095,38 @@ static bool member_pids(const pid_t pid, const pid_t pids[], const int count)
 	return bsearch(&pid, pids, count, sizeof(pid_t), pidcmp)? true: false;
 }
 
+struct collect_data {
+	struct lsfd_control *ctl;
+	struct lsfd_worker *workers;
+	struct list_head *results;	/* processes read for every PID */
+};
+
+static int collect_process_cb(struct procfs_walker *w)
+{
+	struct collect_data *cd = w->data;
+	struct lsfd_worker *wk = &cd->workers[w->worker];
+
+	wk->walker = w;
+	wk->procs = &cd->results[w->idx];
+	read_process(wk, w->pid, NULL);
+
+	/* with one thread, initialize the files at once, as they are read */
+	if (cd->ctl->jobs <= 1)
+		add_procs(cd->ctl, wk->procs);
+	return 0;
+}
+
 static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
 {
-	DIR *dir;
+	struct collect_data cd = { .ctl = ctl };
+	pid_t *procs = NULL;
+	size_t n_procs = 0, sz = 0, i;
 	struct dirent *d;
-	struct path_cxt *pc = NULL;
-
-	pc = ul_new_path(NULL);
-	if (!pc)
-		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
+	DIR *dir;
+	int rc;
 
+	/* Only the processes listed in /proc are read, a thread ID specified
+	 * by --pid is not a process. */
 	dir = opendir(_PATH_PROC);
 	if (!dir)
 		err(EXIT_FAILURE, _("failed to open /proc"));
@@ -1851,12 +2136,43 @@ static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int
 
 		if (procfs_dirent_get_pid(d, &pid) != 0)
 			continue;
-		if (n_pids == 0 || member_pids(pid, pids, n_pids))
-			read_process(ctl, pc, pid, 0);
+		if (n_pids && !member_pids(pid, pids, n_pids))
+			continue;
+		if (n_procs == sz) {
+			sz = sz ? sz * 2 : 256;
+			procs = xreallocarray(procs, sz, sizeof(pid_t));
+		}
+		procs[n_procs++] = pid;
 	}
-
 	closedir(dir);
-	ul_unref_path(pc);
+
+	if (!n_procs)
+		goto done;
+
+	cd.workers = xcalloc(ctl->jobs, sizeof(struct lsfd_worker));
+	for (i = 0; i < ctl->jobs; i++)
+		cd.workers[i].ctl = ctl;
+	cd.results = xcalloc(n_procs, sizeof(struct list_head));
+	for (i = 0; i < n_procs; i++)
+		INIT_LIST_HEAD(&cd.results[i]);
+
+	rc = procfs_walk_processes(NULL, procs, n_procs, ctl->jobs,
+				   collect_process_cb, &cd);
+	if (rc)
+		errx(EXIT_FAILURE, _("failed to read /proc: %s"), strerror(-rc));
+
+	/* the workers read the processes in any order, keep the order of /proc */
+	if (ctl->jobs > 1) {
+		for (i = 0; i < n_procs; i++)
+			add_procs(ctl, &cd.results[i]);
+	}
+
+	for (i = 0; i < ctl->jobs; i++)
+		tdestroy(cd.workers[i].map_stat_tree, free_map_stat);
+	free(cd.workers);
+	free(cd.results);
+done:
+	free(procs);
 }
 
 static void __attribute__((__noreturn__)) list_colunms(const char *table_name,
@@ -1897,6 +2213,7 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -l, --threads                list in threads level\n"), out);
+	fputs(_(" -j, --jobs <num>             read processes by <num> threads\n"), out);
 	fputs(_(" -J, --json                   use JSON output format\n"), out);
 	fputs(_(" -n, --noheadings             don't print headings\n"), out);
 	fputs(_(" -o, --output <list>          output columns (see --list-columns)\n"), out);
@@ -1905,10 +2222,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid  <pid(s)>          collect information only specified processes\n"), out);
 	fputs(_(" -i[4|6], --inet[=4|=6]       list only IPv4 and/or IPv6 sockets\n"), out);
 	fputs(_(" -Q, --filter <expr>          apply display filter\n"), out);
+	fputs(_("     --sort <list>            sort output by <column>[,<column>...]\n"), out);
 	fputs(_("     --debug-filter           dump the internal data structure of filter and exit\n"), out);
 	fputs(_(" -C, --counter <name>:<expr>  define custom counter for --summary output\n"), out);
 	fputs(_("     --dump-counters          dump counter definitions\n"), out);
 	fputs(_("     --summary[=<when>]       print summary information (only, append, or never)\n"), out);
+	fputs(_("     --watch[=<seconds>]      print changes of the files until interrupted\n"), out);
 	fputs(_("     --_drop-privilege        (testing purpose) do setuid(1) just after starting\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -1947,6 +2266,37 @@ static void append_filter_expr(char **a, const char *b, bool and)
 	free(tmp);
 }
 
+static void init_sort_columns(struct lsfd_control *ctl, const char *list)
+{
+	int ids[ARRAY_SIZE(infos)];
+	int n, i;
+
+	n = string_to_idarray(list, ids, ARRAY_SIZE(ids), column_name_to_id);
+	if (n <= 0)
+		errtryhelp(EXIT_FAILURE);
+
+	ctl->sort_cols = xcalloc(n, sizeof(struct libscols_column *));
+	ctl->nsorts = n;
+
+	for (i = 0; i < n; i++) {
+		const struct colinfo *col = &infos[ids[i]];
+		struct libscols_column *cl;
+
+		cl = scols_table_get_column_by_name(ctl->tb, col->name);
+		if (!cl)
+			/* the sort column is not between output columns */
+			cl = add_column_by_id(ctl, ids[i], SCOLS_FL_HIDDEN);
+
+		/* numbers are compared by precomputed keys in libsmartcols */
+		if (col->json_type == SCOLS_JSON_NUMBER)
+			scols_column_set_data_type(cl, SCOLS_DATA_U64);
+		else
+			scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
+
+		ctl->sort_cols[i] = cl;
+	}
+}
+
 static struct libscols_filter *new_filter(const char *expr, bool debug, struct lsfd_control *ctl)
 {
 	struct libscols_filter *f;
@@ -2209,6 +2559,237 @@ static void set_multiplexed_flags(struct list_head *procs)
 	}
 }
 
+/*
+ * --watch
+ *
+ * All processes are read again after every interval. Only the files that
+ * have been opened, closed or changed since the last scan are printed to
+ * the separate table with ACTION column.
+ */
+struct watch_rec {
+	pid_t			pid;
+	int			association;	/* fd or -ASSOC_* */
+	uint64_t		map_start;	/* mapped files only */
+	struct libscols_line	*ln;		/* line for watch->out */
+	unsigned int		seen : 1;
+};
+
+struct lsfd_watch {
+	struct libscols_table	*out;		/* changes */
+	struct watch_rec	*recs;		/* the last scan, sorted by key */
+	size_t			nrecs;
+};
+
+static int cmp_watch_recs(const void *a, const void *b)
+{
+	const struct watch_rec *ra = a, *rb = b;
+
+	if (ra->pid != rb->pid)
+		return ra->pid < rb->pid ? -1 : 1;
+	if (ra->association != rb->association)
+		return ra->association < rb->association ? -1 : 1;
+	if (ra->map_start != rb->map_start)
+		return ra->map_start < rb->map_start ? -1 : 1;
+	return 0;
+}
+
+static void free_watch_recs(struct watch_rec *recs, size_t nrecs)
+{
+	size_t i;
+
+	for (i = 0; i < nrecs; i++)
+		scols_unref_line(recs[i].ln);
+	free(recs);
+}
+
+static void init_watch(struct lsfd_watch *wa, struct lsfd_control *ctl)
+{
+	struct libscols_table *tb;
+	size_t i;
+
+	tb = wa->out = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, _("failed to allocate output table"));
+
+	scols_table_enable_noheadings(tb, ctl->noheadings);
+	scols_table_enable_raw(tb, ctl->raw);
+	scols_table_enable_json(tb, ctl->json);
+	if (ctl->json)
+		scols_table_set_name(tb, "lsfd");
+
+	if (!scols_table_new_column(tb, "ACTION", 6, 0))
+		err(EXIT_FAILURE, _("failed to allocate output column"));
+
+	/* the same columns as ctl->tb, including the hidden columns
+	 * for the filter and sort */
+	for (i = 0; i < ncolumns; i++) {
+		struct libscols_column *cl = scols_table_get_column(ctl->tb, i);
+
+		cl = add_column(tb, get_column_info(i),
+				scols_column_is_hidden(cl) ? SCOLS_FL_HIDDEN : 0);
+		if (!cl)
+			err(EXIT_FAILURE, _("failed to allocate output column"));
+		if (ctl->notrunc)
+			scols_column_set_flags(cl,
+				scols_column_get_flags(cl) & ~SCOLS_FL_TRUNC);
+	}
+}
+
+/* reads the current scan from ctl->tb */
+static struct watch_rec *read_watch_recs(struct lsfd_control *ctl, size_t *nrecs)
+{
+	struct libscols_iter *itr;
+	struct libscols_line *src;
+	struct watch_rec *recs;
+	size_t n = 0;
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
+
+	recs = xcalloc(scols_table_get_nlines(ctl->tb) + 1, sizeof(*recs));
+
+	while (scols_table_next_line(ctl->tb, itr, &src) == 0) {
+		struct file *file = scols_line_get_userdata(src);
+		struct libscols_line *ln;
+		size_t i;
+
+		if (!file)
+			continue;
+		recs[n].pid = file->proc->pid;
+		recs[n].association = file->association;
+		if (is_association(file, MEM) || is_association(file, SHM))
+			recs[n].map_start = file->map_start;
+
+		ln = recs[n].ln = scols_new_line();
+		if (!ln || scols_line_alloc_cells(ln, ncolumns + 1) != 0)
+			err(EXIT_FAILURE, _("failed to allocate output line"));
+
+		for (i = 0; i < ncolumns; i++) {
+			if (scols_cell_copy_content(scols_line_get_cell(ln, i + 1),
+						    scols_line_get_cell(src, i)))
+				err(EXIT_FAILURE, _("failed to add output data"));
+		}
+		n++;
+	}
+
+	scols_free_iter(itr);
+	*nrecs = n;
+	return recs;
+}
+
+static int watch_recs_differ(struct watch_rec *a, struct watch_rec *b)
+{
+	size_t i;
+
+	for (i = 1; i <= ncolumns; i++) {
+		struct libscols_cell *x = scols_line_get_cell(a->ln, i),
+				     *y = scols_line_get_cell(b->ln, i);
+		const char *xd = scols_cell_get_data(x),
+			   *yd = scols_cell_get_data(y);
+		size_t sz = scols_cell_get_datasiz(x);
+
+		if (!xd || !yd) {
+			if (xd != yd)
+				return 1;
+			continue;
+		}
+		if (sz != scols_cell_get_datasiz(y) || memcmp(xd, yd, sz) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void watch_add_change(struct lsfd_watch *wa, struct watch_rec *rec,
+			     const char *action)
+{
+	if (scols_line_set_data(rec->ln, 0, action)
+	    || scols_table_add_line(wa->out, rec->ln))
+		err(EXIT_FAILURE, _("failed to add output data"));
+}
+
+/* compare the current ctl->tb with the last scan, print changes */
+static void watch_print_changes(struct lsfd_watch *wa, struct lsfd_control *ctl)
+{
+	struct watch_rec *recs;
+	size_t nrecs, i;
+
+	recs = read_watch_recs(ctl, &nrecs);
+
+	for (i = 0; i < nrecs; i++) {
+		struct watch_rec *old = NULL;
+
+		if (wa->nrecs)
+			old = bsearch(&recs[i], wa->recs, wa->nrecs,
+				      sizeof(struct watch_rec), cmp_watch_recs);
+		if (!old)
+			watch_add_change(wa, &recs[i], "add");
+		else {
+			old->seen = 1;
+			if (watch_recs_differ(old, &recs[i]))
+				watch_add_change(wa, &recs[i], "change");
+		}
+	}
+	for (i = 0; i < wa->nrecs; i++) {
+		if (!wa->recs[i].seen)
+			watch_add_change(wa, &wa->recs[i], "remove");
+	}
+
+	if (scols_table_get_nlines(wa->out)) {
+		scols_print_table(wa->out);
+		fflush(stdout);
+		scols_table_remove_lines(wa->out);
+	}
+
+	free_watch_recs(wa->recs, wa->nrecs);
+
+	qsort(recs, nrecs, sizeof(struct watch_rec), cmp_watch_recs);
+	wa->recs = recs;
+	wa->nrecs = nrecs;
+}
+
+static void collect(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+{
+	collect_processes(ctl, pids, n_pids);
+
+	attach_xinfos(&ctl->procs);
+	if (ctl->show_xmode)
+		set_multiplexed_flags(&ctl->procs);
+
+	convert(&ctl->procs, ctl);
+}
+
+static void __attribute__((__noreturn__)) watch_files(struct lsfd_control *ctl,
+						      const pid_t pids[], int n_pids)
+{
+	struct lsfd_watch wa = { .out = NULL };
+
+	init_watch(&wa, ctl);
+	wa.recs = read_watch_recs(ctl, &wa.nrecs);
+	qsort(wa.recs, wa.nrecs, sizeof(struct watch_rec), cmp_watch_recs);
+	fflush(stdout);
+
+	while (1) {
+		sleep(ctl->watch_interval);
+
+		/* the sockets, IPC endpoints and mount namespaces are read
+		 * again; the other class data (devices, users) are kept */
+		scols_table_remove_lines(ctl->tb);
+		delete_procs(&ctl->procs);
+
+		finalize_class(&sock_class);
+		finalize_ipc_table();
+		finalize_nodevs();
+
+		initialize_nodevs();
+		initialize_ipc_table();
+		initialize_class(&sock_class);
+
+		collect(ctl, pids, n_pids);
+		watch_print_changes(&wa, ctl);
+	}
+}
+
 /* Filter expressions for implementing -i option.
  *
  * To list up the protocol names, use the following command line
@@ -2238,6 +2819,7 @@ int main(int argc, char *argv[])
 	size_t i;
 	char *outarg = NULL;
 	char  *filter_expr = NULL;
+	char *sortarg = NULL;
 	bool debug_filter = false;
 	bool dump_counters = false;
 	pid_t *pids = NULL;
@@ -2245,7 +2827,8 @@ int main(int argc, char *argv[])
 	struct list_head counter_specs;
 
 	struct lsfd_control ctl = {
-		.show_main = 1
+		.show_main = 1,
+		.jobs = 1
 	};
 
 	INIT_LIST_HEAD(&counter_specs);
@@ -2255,6 +2838,8 @@ int main(int argc, char *argv[])
 		OPT_SUMMARY,
 		OPT_DUMP_COUNTERS,
 		OPT_DROP_PRIVILEGE,
+		OPT_SORT,
+		OPT_WATCH,
 	};
 	static const struct option longopts[] = {
 		{ "noheadings", no_argument, NULL, 'n' },
@@ -2264,15 +2849,18 @@ int main(int argc, char *argv[])
 		{ "json",       no_argument, NULL, 'J' },
 		{ "raw",        no_argument, NULL, 'r' },
 		{ "threads",    no_argument, NULL, 'l' },
+		{ "jobs",       required_argument, NULL, 'j' },
 		{ "notruncate", no_argument, NULL, 'u' },
 		{ "pid",        required_argument, NULL, 'p' },
 		{ "inet",       optional_argument, NULL, 'i' },
 		{ "filter",     required_argument, NULL, 'Q' },
+		{ "sort",       required_argument, NULL, OPT_SORT },
 		{ "debug-filter",no_argument, NULL, OPT_DEBUG_FILTER },
 		{ "summary",    optional_argument, NULL,  OPT_SUMMARY },
 		{ "counter",    required_argument, NULL, 'C' },
 		{ "dump-counters",no_argument, NULL, OPT_DUMP_COUNTERS },
 		{ "list-columns",no_argument, NULL, 'H' },
+		{ "watch",      optional_argument, NULL, OPT_WATCH },
 		{ "_drop-privilege",no_argument,NULL,OPT_DROP_PRIVILEGE },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -2282,7 +2870,7 @@ int main(int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sH", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "no:JrVhlj:uQ:p:i::C:sH", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'n':
 			ctl.noheadings = 1;
@@ -2299,6 +2887,11 @@ int main(int argc, char *argv[])
 		case 'l':
 			ctl.threads = 1;
 			break;
+		case 'j':
+			ctl.jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!ctl.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
 		case 'u':
 			ctl.notrunc = 1;
 			break;
@@ -2331,6 +2924,9 @@ int main(int argc, char *argv[])
 			list_add_tail(&c->specs, &counter_specs);
 			break;
 		}
+		case OPT_SORT:
+			sortarg = optarg;
+			break;
 		case OPT_DEBUG_FILTER:
 			debug_filter = true;
 			break;
@@ -2350,6 +2946,12 @@ int main(int argc, char *argv[])
 		case OPT_DUMP_COUNTERS:
 			dump_counters = true;
 			break;
+		case OPT_WATCH:
+			ctl.watch_interval = optarg ?
+				strtou32_or_err(optarg, _("failed to parse watch interval")) : 1;
+			if (!ctl.watch_interval)
+				errx(EXIT_FAILURE, _("watch interval must be greater than zero"));
+			break;
 		case OPT_DROP_PRIVILEGE:
 			if (setuid(1) == -1)
 				err(EXIT_FAILURE, _("failed to drop privilege"));
@@ -2372,6 +2974,9 @@ int main(int argc, char *argv[])
 	if (argv[optind])
 		errtryhelp(EXIT_FAILURE);
 
+	if (ctl.watch_interval && ctl.show_summary)
+		errx(EXIT_FAILURE, _("--watch cannot be used with --summary"));
+
 #define INITIALIZE_COLUMNS(COLUMN_SPEC)				\
 	for (i = 0; i < ARRAY_SIZE(COLUMN_SPEC); i++)	\
 		columns[ncolumns++] = COLUMN_SPEC[i]
@@ -2400,6 +3005,16 @@ int main(int argc, char *argv[])
 	scols_table_enable_json(ctl.tb, ctl.json);
 	if (ctl.json)
 		scols_table_set_name(ctl.tb, "lsfd");
+	/* the raw and JSON lines don't depend on other lines (unless sorted);
+	 * --watch compares the printed lines with the next scan, and the
+	 * arena would grow with every scan */
+	if (!ctl.watch_interval) {
+		if ((ctl.raw || ctl.json) && !sortarg)
+			scols_table_enable_streaming(ctl.tb, 1);
+		else if (ctl.show_main)
+			/* --summary=only removes all lines */
+			scols_table_enable_arena(ctl.tb, 1);
+	}
 
 	/* create output columns */
 	for (i = 0; i < ncolumns; i++) {
@@ -2416,6 +3031,9 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (sortarg)
+		init_sort_columns(&ctl, sortarg);
+
 	/* make filter */
 	if (filter_expr) {
 		ctl.filter = new_filter(filter_expr, debug_filter, &ctl);
@@ -2447,6 +3065,13 @@ int main(int argc, char *argv[])
 	if (scols_table_get_column_by_name(ctl.tb, "XMODE"))
 		ctl.show_xmode = 1;
 
+	/* ENDPOINTS refers to files of other processes, and threads share
+	 * files with the leader; all files are necessary in these cases */
+	if (ctl.filter && !ctl.threads
+	    && !scols_table_get_column_by_name(ctl.tb, "ENDPOINTS")
+	    && is_proc_filter(ctl.filter))
+		ctl.proc_filter = 1;
+
 	/* collect data
 	 *
 	 * The call initialize_ipc_table() must come before
@@ -2457,20 +3082,16 @@ int main(int argc, char *argv[])
 	initialize_classes();
 	initialize_devdrvs();
 
-	collect_processes(&ctl, pids, n_pids);
-	free(pids);
-
-	attach_xinfos(&ctl.procs);
-	if (ctl.show_xmode)
-		set_multiplexed_flags(&ctl.procs);
-
-
-	convert(&ctl.procs, &ctl);
+	collect(&ctl, pids, n_pids);
 
 	/* print */
 	if (ctl.show_main)
 		emit(&ctl);
 
+	if (ctl.watch_interval)
+		watch_files(&ctl, pids, n_pids);	/* never returns */
+	free(pids);
+
 	if (ctl.show_summary && ctl.ct_filters)
 		emit_summary(&ctl);
 
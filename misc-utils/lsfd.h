@@ -191,6 +191,8 @@ struct file {
 	unsigned int sys_flags;
 	unsigned int mnt_id;
 
+	char *fdinfo;		/* not parsed yet */
+
 	uint8_t locked_read:1,
 		locked_write:1,
 		multiplexed:1,
@@ -229,6 +231,7 @@ struct ipc {
 	const struct ipc_class *class;
 	struct list_head endpoints;
 	struct list_head ipcs;
+	unsigned int hash;
 };
 
 struct ipc_endpoint {
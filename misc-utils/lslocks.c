@@ -212,42 +212,75 @@ static char *get_fallback_filename(dev_t dev)
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Per-process index of open file descriptors, sorted by inode. The
+ * /proc/<pid>/fd directory is scanned only once per process no matter
+ * how many locks the process holds.
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+struct fd_inode {
+	ino_t		inode;
+	size_t		pos;	/* readdir() order */
+	off_t		size;
+	int		fd;
+};
+
+struct pid_fds {
+	pid_t		pid;
+	int		readable;
+
+	struct fd_inode	*fds;
+	size_t		nfds;
+
+	/* the first descriptor we failed to stat() */
+	int		failed_fd;
+	size_t		failed_pos;
+};
+
+static void *pid_fds_root;		/* tree of struct pid_fds */
+
+static int pid_fds_compare(const void *a, const void *b)
+{
+	const struct pid_fds *x = a, *y = b;
+
+	return x->pid < y->pid ? -1 : x->pid > y->pid ? 1 : 0;
+}
+
+static int fd_inode_compare(const void *a, const void *b)
+{
+	const struct fd_inode *x = a, *y = b;
+
+	if (x->inode != y->inode)
+		return x->inode < y->inode ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static void rem_pid_fds(void *node)
+{
+	struct pid_fds *pf = node;
+
+	free(pf->fds);
+	free(pf);
+}
+
+static void read_pid_fds(struct pid_fds *pf)
 {
-	struct stat sb;
+	char path[PATH_MAX];
 	struct dirent *dp;
 	DIR *dirp;
-	size_t len;
+	size_t pos = 0, alloc = 0;
 	int fd;
-	char path[PATH_MAX], sym[PATH_MAX], *ret = NULL;
 
-	*size = 0;
-	memset(path, 0, sizeof(path));
-	memset(sym, 0, sizeof(sym));
-
-	if (lock_pid < 0)
-		/* pid could be -1 for OFD locks */
-		return NULL;
-
-	/*
-	 * We know the pid so we don't have to
-	 * iterate the *entire* filesystem searching
-	 * for the damn file.
-	 */
-	snprintf(path, sizeof(path), "/proc/%d/fd/", lock_pid);
+	snprintf(path, sizeof(path), "/proc/%d/fd/", pf->pid);
 	if (!(dirp = opendir(path)))
-		return NULL;
-
-	if ((len = strlen(path)) >= (sizeof(path) - 2))
+		return;
+	if ((fd = dirfd(dirp)) < 0)
 		goto out;
 
-	if ((fd = dirfd(dirp)) < 0 )
-		goto out;
+	pf->readable = 1;
 
 	while ((dp = readdir(dirp))) {
+		struct stat sb;
+		int num;
+
 		if (!strcmp(dp->d_name, ".") ||
 		    !strcmp(dp->d_name, ".."))
 			continue;
@@ -255,25 +288,117 @@ static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
 		errno = 0;
 
 		/* care only for numerical descriptors */
-		if (!strtol(dp->d_name, (char **) NULL, 10) || errno)
+		if (!(num = strtol(dp->d_name, (char **) NULL, 10)) || errno)
 			continue;
 
-		if (!fstatat(fd, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstatat(fd, dp->d_name, &sb, 0) != 0) {
+			if (pf->failed_fd < 0) {
+				pf->failed_fd = num;
+				pf->failed_pos = pos;
+			}
+			pos++;
 			continue;
+		}
 
-		if ((len = readlinkat(fd, dp->d_name, sym, sizeof(sym) - 1)) < 1)
-			goto out;
-
-		*size = sb.st_size;
-		sym[len] = '\0';
-
-		ret = xstrdup(sym);
-		break;
+		if (pf->nfds == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			pf->fds = xreallocarray(pf->fds, alloc, sizeof(struct fd_inode));
+		}
+		pf->fds[pf->nfds].inode = sb.st_ino;
+		pf->fds[pf->nfds].pos = pos++;
+		pf->fds[pf->nfds].size = sb.st_size;
+		pf->fds[pf->nfds].fd = num;
+		pf->nfds++;
 	}
+
+	if (pf->nfds > 1)
+		qsort(pf->fds, pf->nfds, sizeof(struct fd_inode), fd_inode_compare);
 out:
 	closedir(dirp);
-	return ret;
+}
+
+static struct pid_fds *get_pid_fds(pid_t pid)
+{
+	struct pid_fds key = { .pid = pid }, *pf;
+	struct pid_fds **node = tfind(&key, &pid_fds_root, pid_fds_compare);
+
+	if (node)
+		return *node;
+
+	pf = xcalloc(1, sizeof(*pf));
+	pf->pid = pid;
+	pf->failed_fd = -1;
+	read_pid_fds(pf);
+
+	if (tsearch(pf, &pid_fds_root, pid_fds_compare) == NULL)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return pf;
+}
+
+/* the first descriptor (in readdir() order) with the inode */
+static struct fd_inode *find_fd_inode(struct pid_fds *pf, ino_t inode)
+{
+	size_t lo = 0, hi = pf->nfds;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (pf->fds[mid].inode < inode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < pf->nfds && pf->fds[lo].inode == inode)
+		return &pf->fds[lo];
+	return NULL;
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+{
+	struct pid_fds *pf;
+	struct fd_inode *fi;
+	char path[PATH_MAX], sym[PATH_MAX];
+	ssize_t len;
+	off_t sz = 0;
+	int fd;
+
+	*size = 0;
+
+	if (lock_pid < 0)
+		/* pid could be -1 for OFD locks */
+		return NULL;
+
+	/*
+	 * We know the pid so we don't have to
+	 * iterate the *entire* filesystem searching
+	 * for the damn file.
+	 */
+	pf = get_pid_fds(lock_pid);
+	if (!pf->readable)
+		return NULL;
+
+	/* descriptors we cannot stat() are accepted as well */
+	fi = find_fd_inode(pf, inode);
+	if (fi && (pf->failed_fd < 0 || fi->pos < pf->failed_pos)) {
+		fd = fi->fd;
+		sz = fi->size;
+	} else if (pf->failed_fd >= 0)
+		fd = pf->failed_fd;
+	else
+		return NULL;
+
+	snprintf(path, sizeof(path), "/proc/%d/fd/%d", lock_pid, fd);
+	if ((len = readlink(path, sym, sizeof(sym) - 1)) < 1)
+		return NULL;
+
+	*size = sz;
+	sym[len] = '\0';
+
+	return xstrdup(sym);
 }
 
 /*
@@ -975,6 +1100,7 @@ int main(int argc, char *argv[])
 		rc = show_locks(&proc_locks, target_pid, &pid_locks);
 
 	tdestroy(pid_locks, rem_tnode);
+	tdestroy(pid_fds_root, rem_pid_fds);
 	rem_locks(&proc_locks);
 
 	mnt_unref_table(tab);
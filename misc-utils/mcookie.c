@@ -36,44 +36,98 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 enum {
-	BUFFERSIZE = 4096,
+	DEFAULT_SIZE = 4096,		/* read from files without --max-size */
+	BUFFERSIZE = 128 * 1024,	/* read chunk with --max-size */
 	RAND_BYTES = 128
 };
 
+/* --bench statistics of one source */
+struct mcookie_bench {
+	uint64_t bytes;
+	uint64_t read_ns;
+	uint64_t hash_ns;
+};
+
 struct mcookie_control {
 	struct	UL_MD5Context ctx;
 	char	**files;
 	size_t	nfiles;
 	uint64_t maxsz;
+	unsigned char *buf;
 
-	unsigned int verbose:1;
+	unsigned int verbose:1,
+		     bench:1;
 };
 
+static uint64_t bench_now(const struct mcookie_control *ctl)
+{
+	struct timespec ts;
+
+	if (!ctl->bench || clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, const struct mcookie_bench *b)
+{
+	double rd = b->read_ns ? b->bytes * 1e9 / b->read_ns / (1024 * 1024) : 0;
+	double hs = b->hash_ns ? b->bytes * 1e9 / b->hash_ns / (1024 * 1024) : 0;
+
+	fprintf(stderr, _("%s: %ju bytes, read %.1f MiB/s, hash %.1f MiB/s\n"),
+		name, (uintmax_t) b->bytes, rd, hs);
+}
+
 /* The basic function to hash a file */
-static uint64_t hash_file(struct mcookie_control *ctl, int fd)
+static uint64_t hash_file(struct mcookie_control *ctl, int fd,
+			  struct mcookie_bench *b)
 {
-	unsigned char buf[BUFFERSIZE];
+	unsigned char *buf = ctl->buf;
 	uint64_t wanted, count;
-
-	wanted = ctl->maxsz ? ctl->maxsz : sizeof(buf);
+	struct stat st;
+
+	wanted = ctl->maxsz ? ctl->maxsz : DEFAULT_SIZE;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		/* don't ask for more than the file has */
+		off_t pos = lseek(fd, 0, SEEK_CUR);
+
+		if (pos >= 0 && st.st_size >= pos
+		    && (uint64_t) (st.st_size - pos) < wanted)
+			wanted = st.st_size - pos;
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+		if (wanted > BUFFERSIZE)
+			ignore_result( posix_fadvise(fd, pos < 0 ? 0 : pos, wanted,
+						     POSIX_FADV_SEQUENTIAL) );
+#endif
+	}
 
 	for (count = 0; count < wanted; ) {
-		size_t rdsz = sizeof(buf);
+		size_t rdsz = BUFFERSIZE;
+		uint64_t t0, t1;
 		ssize_t r;
 
 		if (wanted - count < rdsz)
 			rdsz = wanted - count;
 
+		t0 = bench_now(ctl);
 		r = read_all(fd, (char *) buf, rdsz);
 		if (r <= 0)
 			break;
+		t1 = bench_now(ctl);
 		ul_MD5Update(&ctl->ctx, buf, r);
 		count += r;
+
+		b->read_ns += t1 - t0;
+		b->hash_ns += bench_now(ctl) - t1;
 	}
+	b->bytes = count;
+
 	/* Separate files with a null byte */
 	buf[0] = '\0';
 	ul_MD5Update(&ctl->ctx, buf, 1);
@@ -93,6 +147,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -f, --file <file>     use file as a cookie seed\n"), out);
 	fputs(_(" -m, --max-size <num>  limit how much is read from seed files\n"), out);
 	fputs(_(" -v, --verbose         explain what is being done\n"), out);
+	fputs(_("     --bench           report the throughput of every source\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(23));
@@ -111,6 +166,7 @@ static void randomness_from_files(struct mcookie_control *ctl)
 
 	for (i = 0; i < ctl->nfiles; i++) {
 		const char *fname = ctl->files[i];
+		struct mcookie_bench b = { .bytes = 0 };
 		size_t count;
 		int fd;
 
@@ -122,12 +178,14 @@ static void randomness_from_files(struct mcookie_control *ctl)
 		if (fd < 0) {
 			warn(_("cannot open %s"), fname);
 		} else {
-			count = hash_file(ctl, fd);
+			count = hash_file(ctl, fd, &b);
 			if (ctl->verbose)
 				fprintf(stderr,
 					P_("Got %zu byte from %s\n",
 					   "Got %zu bytes from %s\n", count),
 					count, fname);
+			if (ctl->bench)
+				bench_report(fname, &b);
 
 			if (fd != STDIN_FILENO && close(fd))
 				err(EXIT_FAILURE, _("closing %s failed"), fname);
@@ -141,12 +199,18 @@ int main(int argc, char **argv)
 	size_t i;
 	unsigned char digest[UL_MD5LENGTH];
 	unsigned char buf[RAND_BYTES];
+	struct mcookie_bench b = { .bytes = RAND_BYTES };
+	uint64_t t0, t1;
 	int c;
 
+	enum {
+		OPT_BENCH = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{"file", required_argument, NULL, 'f'},
 		{"max-size", required_argument, NULL, 'm'},
 		{"verbose", no_argument, NULL, 'v'},
+		{"bench", no_argument, NULL, OPT_BENCH},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{NULL, 0, NULL, 0}
@@ -171,6 +235,9 @@ int main(int argc, char **argv)
 			ctl.maxsz = strtosize_or_err(optarg,
 						     _("failed to parse length"));
 			break;
+		case OPT_BENCH:
+			ctl.bench = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -185,15 +252,25 @@ int main(int argc, char **argv)
 		warnx(_("--max-size ignored when used without --file"));
 
 	ul_MD5Init(&ctl.ctx);
-	randomness_from_files(&ctl);
+	if (ctl.nfiles) {
+		ctl.buf = xmalloc(BUFFERSIZE);
+		randomness_from_files(&ctl);
+		free(ctl.buf);
+	}
 	free(ctl.files);
 
+	t0 = bench_now(&ctl);
 	ul_random_get_bytes(&buf, RAND_BYTES);
+	t1 = bench_now(&ctl);
 	ul_MD5Update(&ctl.ctx, buf, RAND_BYTES);
+	b.read_ns = t1 - t0;
+	b.hash_ns = bench_now(&ctl) - t1;
 	if (ctl.verbose)
 		fprintf(stderr, P_("Got %d byte from %s\n",
 				   "Got %d bytes from %s\n", RAND_BYTES),
 				RAND_BYTES, random_tell_source());
+	if (ctl.bench)
+		bench_report(random_tell_source(), &b);
 
 	ul_MD5Final(digest, &ctl.ctx);
 	for (i = 0; i < UL_MD5LENGTH; i++)
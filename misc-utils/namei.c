@@ -30,6 +30,7 @@
 #include <sys/param.h>
 #include <pwd.h>
 #include <grp.h>
+#include <search.h>
 
 #ifdef HAVE_LIBSELINUX
 # include <selinux/selinux.h>
@@ -70,9 +71,26 @@ struct namei {
 #endif
 };
 
+/*
+ * Cached lstat() and readlink() results of directories and symlinks. Paths
+ * sharing a prefix (e.g. many files in the same tree) are resolved on the
+ * filesystem only once.
+ */
+struct namei_cache {
+	char		*path;		/* key */
+	struct stat	st;
+	char		*sym;		/* symlink content */
+	size_t		symsz;
+#ifdef HAVE_LIBSELINUX
+	int		context_len;
+	char		*context;
+#endif
+};
+
 static int flags;
 static struct idcache *gcache;	/* groupnames */
 static struct idcache *ucache;	/* usernames */
+static void *ncache;		/* tree of struct namei_cache */
 
 static void
 free_namei(struct namei *nm)
@@ -89,16 +107,31 @@ free_namei(struct namei *nm)
 	}
 }
 
+static int
+namei_cache_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct namei_cache *) a)->path,
+		      ((const struct namei_cache *) b)->path);
+}
+
 static void
-readlink_to_namei(struct namei *nm, const char *path)
+free_namei_cache(void *data)
+{
+	struct namei_cache *nc = data;
+
+#ifdef HAVE_LIBSELINUX
+	free(nc->context);
+#endif
+	free(nc->sym);
+	free(nc->path);
+	free(nc);
+}
+
+static void
+symlink_to_namei(struct namei *nm, const char *path, const char *sym, ssize_t sz)
 {
-	char sym[PATH_MAX];
-	ssize_t sz;
 	int isrel = 0;
 
-	sz = readlink(path, sym, sizeof(sym));
-	if (sz < 1)
-		err(EXIT_FAILURE, _("failed to read symlink: %s"), path);
 	if (*sym != '/') {
 		char *p = strrchr(path, '/');
 
@@ -125,6 +158,69 @@ readlink_to_namei(struct namei *nm, const char *path)
 	nm->abslink[sz] = '\0';
 }
 
+/* fill @nm from the cache; returns 0 on cache miss */
+static int
+cached_namei(struct namei *nm, const char *path)
+{
+	struct namei_cache key = { .path = (char *) path }, **x;
+	struct namei_cache *nc;
+
+	x = tfind(&key, &ncache, namei_cache_cmp);
+	if (!x)
+		return 0;
+
+	nc = *x;
+	nm->st = nc->st;
+	if (nc->sym)
+		symlink_to_namei(nm, path, nc->sym, nc->symsz);
+#ifdef HAVE_LIBSELINUX
+	nm->context_len = nc->context_len;
+	nm->context = nc->context ? xstrdup(nc->context) : NULL;
+#endif
+	return 1;
+}
+
+static void
+lookup_namei(struct namei *nm, const char *path)
+{
+	struct namei_cache *nc;
+	char sym[PATH_MAX];
+	ssize_t sz = 0;
+
+#ifdef HAVE_LIBSELINUX
+	/* Don't use is_selinux_enabled() here. We need info about a context
+	 * also on systems where SELinux is (temporary) disabled */
+	nm->context_len = lgetfilecon(path, &nm->context);
+#endif
+	if (lstat(path, &nm->st) != 0) {
+		nm->noent = errno;
+		return;
+	}
+
+	if (S_ISLNK(nm->st.st_mode)) {
+		sz = readlink(path, sym, sizeof(sym));
+		if (sz < 1)
+			err(EXIT_FAILURE, _("failed to read symlink: %s"), path);
+		symlink_to_namei(nm, path, sym, sz);
+	} else if (!S_ISDIR(nm->st.st_mode))
+		return;		/* only directories and symlinks are shared */
+
+	nc = xcalloc(1, sizeof(*nc));
+	nc->path = xstrdup(path);
+	nc->st = nm->st;
+	if (sz) {
+		nc->sym = xmalloc(sz);
+		memcpy(nc->sym, sym, sz);
+		nc->symsz = sz;
+	}
+#ifdef HAVE_LIBSELINUX
+	nc->context_len = nm->context_len;
+	nc->context = nm->context ? xstrdup(nm->context) : NULL;
+#endif
+	if (!tsearch(nc, &ncache, namei_cache_cmp))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+}
+
 static struct stat *
 dotdot_stat(const char *dirname, struct stat *st)
 {
@@ -162,18 +258,11 @@ new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 	nm->level = lev;
 	nm->name = xstrdup(fname);
 
-#ifdef HAVE_LIBSELINUX
-	/* Don't use is_selinux_enabled() here. We need info about a context
-	 * also on systems where SELinux is (temporary) disabled */
-	nm->context_len = lgetfilecon(path, &nm->context);
-#endif
-	if (lstat(path, &nm->st) != 0) {
-		nm->noent = errno;
+	if (!cached_namei(nm, path))
+		lookup_namei(nm, path);
+	if (nm->noent)
 		return nm;
-	}
 
-	if (S_ISLNK(nm->st.st_mode))
-		readlink_to_namei(nm, path);
 	if (flags & NAMEI_OWNERS) {
 		add_uid(ucache, nm->st.st_uid);
 		add_gid(gcache, nm->st.st_gid);
@@ -346,6 +435,64 @@ print_namei(struct namei *nm, char *path)
 	return 0;
 }
 
+static int
+namei_path(char *path)
+{
+	struct namei *nm = NULL;
+	struct stat st;
+	int rc = 0;
+
+	if (stat(path, &st) != 0)
+		rc = -1;
+
+	nm = add_namei(NULL, path, 0, NULL);
+	if (nm) {
+		int sml = 0;
+		if (!(flags & NAMEI_NOLINKS))
+			sml = follow_symlinks(nm);
+		if (print_namei(nm, path))
+			rc = -1;
+		else if (sml == -1) {
+			rc = -1;
+			warnx(_("%s: exceeded limit of symlinks"), path);
+		}
+		free_namei(nm);
+	}
+	return rc;
+}
+
+static int
+namei_files_from(const char *list)
+{
+	FILE *f = stdin;
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = 0;
+
+	if (strcmp(list, "-") != 0) {
+		f = fopen(list, "r" UL_CLOEXECSTR);
+		if (!f) {
+			warn(_("cannot open %s"), list);
+			return -1;
+		}
+	}
+
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+		if (namei_path(line) != 0)
+			rc = -1;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	const char *p = program_invocation_short_name;
@@ -357,6 +504,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 	      _(" %s [options] <pathname>...\n"), p);
+	fprintf(out,
+	      _(" %s [options] --files-from <list>\n"), p);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Follow a pathname until a terminal point is found.\n"), out);
@@ -368,7 +517,9 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -o, --owners        show owner and group name of each file\n"
 		" -l, --long          use a long listing format (-m -o -v) \n"
 		" -n, --nosymlinks    don't follow symlinks\n"
-		" -v, --vertical      vertical align of modes and owners\n"), out);
+		" -v, --vertical      vertical align of modes and owners\n"
+		" -f, --files-from <list>\n"
+		"                     read pathnames from <list> file (or stdin), one per line\n"), out);
 #ifdef HAVE_LIBSELINUX
 	fputs(_( " -Z, --context       print any security context of each file \n"), out);
 #endif
@@ -389,6 +540,7 @@ static const struct option longopts[] =
 	{ "long",        no_argument, NULL, 'l' },
 	{ "nolinks",	 no_argument, NULL, 'n' },
 	{ "vertical",    no_argument, NULL, 'v' },
+	{ "files-from",	 required_argument, NULL, 'f' },
 #ifdef HAVE_LIBSELINUX
 	{ "context",	 no_argument, NULL, 'Z' },
 #endif
@@ -400,11 +552,12 @@ main(int argc, char **argv)
 {
 	int c;
 	int rc = EXIT_SUCCESS;
+	const char *list = NULL;
 	static const char *shortopts =
 #ifdef HAVE_LIBSELINUX
 		"Z"
 #endif
-		"hVlmnovx";
+		"f:hVlmnovx";
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -413,6 +566,9 @@ main(int argc, char **argv)
 
 	while ((c = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1) {
 		switch(c) {
+		case 'f':
+			list = optarg;
+			break;
 		case 'l':
 			flags |= (NAMEI_OWNERS | NAMEI_MODES | NAMEI_VERTICAL);
 			break;
@@ -445,7 +601,7 @@ main(int argc, char **argv)
 		}
 	}
 
-	if (optind == argc) {
+	if (optind == argc && !list) {
 		warnx(_("pathname argument is missing"));
 		errtryhelp(EXIT_FAILURE);
 	}
@@ -457,32 +613,15 @@ main(int argc, char **argv)
 	if (!gcache)
 		err(EXIT_FAILURE, _("failed to allocate GID cache"));
 
-	for(; optind < argc; optind++) {
-		char *path = argv[optind];
-		struct namei *nm = NULL;
-		struct stat st;
+	if (list && namei_files_from(list) != 0)
+		rc = EXIT_FAILURE;
 
-		if (stat(path, &st) != 0)
+	for(; optind < argc; optind++) {
+		if (namei_path(argv[optind]) != 0)
 			rc = EXIT_FAILURE;
-
-		nm = add_namei(NULL, path, 0, NULL);
-		if (nm) {
-			int sml = 0;
-			if (!(flags & NAMEI_NOLINKS))
-				sml = follow_symlinks(nm);
-			if (print_namei(nm, path)) {
-				rc = EXIT_FAILURE;
-				continue;
-			}
-			free_namei(nm);
-			if (sml == -1) {
-				rc = EXIT_FAILURE;
-				warnx(_("%s: exceeded limit of symlinks"), path);
-				continue;
-			}
-		}
 	}
 
+	tdestroy(ncache, free_namei_cache);
 	free_idcache(ucache);
 	free_idcache(gcache);
 
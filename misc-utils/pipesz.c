@@ -19,7 +19,9 @@
  */
 
 #include <getopt.h>
+#include <search.h>		/* tsearch */
 #include <sys/ioctl.h>		/* FIONREAD */
+#include <sys/stat.h>
 #include <fcntl.h>		/* F_GETPIPE_SZ F_SETPIPE_SZ */
 
 #include "c.h"
@@ -29,11 +31,16 @@
 #include "optutils.h"		/* err_exclusive_options */
 #include "path.h"		/* ul_path_read_s32 */
 #include "pathnames.h"		/* _PATH_PROC_PIPE_MAX_SIZE */
+#include "procfs.h"		/* procfs_dirent_get_pid */
 #include "strutils.h"		/* strtos32_or_err strtosize_or_err */
+#include "fileutils.h"		/* xreaddir */
+#include "xalloc.h"
 
+static char opt_all = 0;	/* --all */
 static char opt_check = 0;	/* --check */
 static char opt_get = 0;	/* --get */
 static char opt_quiet = 0;	/* --quiet */
+static int opt_min_fill = -1;	/* --min-fill <percent> */
 static int opt_size = -1;	/* --set <size> */
 static char opt_verbose = 0;	/* --verbose */
 
@@ -64,6 +71,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, stdout);
 	fprintf(stdout, _(" %s [options] [--set <size>] [--] [command]\n"), program_invocation_short_name);
 	fprintf(stdout, _(" %s [options] --get\n"), program_invocation_short_name);
+	fprintf(stdout, _(" %s [options] [--get|--set <size>] --all\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, stdout);
 	/* TRANSLATORS: 'command' refers to a program argument */
@@ -83,6 +91,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_(" -i, --stdin        act on standard input"), stdout);
 	fputsln(_(" -o, --stdout       act on standard output"), stdout);
 	fputsln(_(" -e, --stderr       act on standard error"), stdout);
+	fputsln(_(" -a, --all          act on all pipes of all processes"), stdout);
+	fputsln(_(" -m, --min-fill <percent>\n"
+		  "                    with --all, act only on pipes filled at least to <percent>"), stdout);
 
 	fputs(USAGE_SEPARATOR, stdout);
 	fputsln(_(" -c, --check        do not continue after an error"), stdout);
@@ -101,21 +112,26 @@ static void __attribute__((__noreturn__)) usage(void)
  * performs F_GETPIPE_SZ and FIONREAD
  * outputs a table row
  */
-static void do_get(int fd, const char *name)
+static int get_pipe(int fd, const char *name, int *sz, int *used)
 {
-	int sz, used;
-
-	sz = fcntl(fd, F_GETPIPE_SZ);
-	if (sz < 0) {
+	*sz = fcntl(fd, F_GETPIPE_SZ);
+	if (*sz < 0) {
 		/* TRANSLATORS: '%s' refers to a file */
 		check(_("cannot get pipe buffer size of %s"), name);
-		return;
+		return -1;
 	}
 
-	if (ioctl(fd, FIONREAD, &used))
-		used = 0;
+	if (ioctl(fd, FIONREAD, used))
+		*used = 0;
+	return 0;
+}
 
-	printf("%s\t%d\t%d\n", name, sz, used);
+static void do_get(int fd, const char *name)
+{
+	int sz, used;
+
+	if (get_pipe(fd, name, &sz, &used) == 0)
+		printf("%s\t%d\t%d\n", name, sz, used);
 }
 
 /*
@@ -171,6 +187,155 @@ static void do_file(const char *path)
 	close(fd);
 }
 
+/* a pipe found by --all */
+struct pipe_id {
+	dev_t dev;
+	ino_t ino;
+};
+
+/* pipes of one size, for the --all --get --verbose summary */
+struct pipe_stat {
+	int size;
+	size_t count;
+	size_t full;
+};
+
+static int cmp_pipe_ids(const void *a, const void *b)
+{
+	const struct pipe_id *x = a, *y = b;
+
+	if (x->dev != y->dev)
+		return x->dev < y->dev ? -1 : 1;
+	return x->ino < y->ino ? -1 : x->ino > y->ino ? 1 : 0;
+}
+
+static void add_pipe_stat(struct pipe_stat **stats, size_t *nstats, int sz, int used)
+{
+	size_t i;
+
+	for (i = 0; i < *nstats; i++) {
+		if ((*stats)[i].size == sz)
+			break;
+	}
+	if (i == *nstats) {
+		*stats = xreallocarray(*stats, *nstats + 1, sizeof(struct pipe_stat));
+		(*stats)[i].size = sz;
+		(*stats)[i].count = 0;
+		(*stats)[i].full = 0;
+		(*nstats)++;
+	}
+	(*stats)[i].count++;
+	if (used >= sz)
+		(*stats)[i].full++;
+}
+
+static int cmp_pipe_stats(const void *a, const void *b)
+{
+	const struct pipe_stat *x = a, *y = b;
+
+	return x->size < y->size ? -1 : x->size > y->size;
+}
+
+/*
+ * does the requested operation on every pipe found in /proc/<pid>/fd,
+ * every pipe only once even if it is shared by more processes
+ */
+static void do_all(void)
+{
+	struct pipe_stat *stats = NULL;
+	size_t nstats = 0, i;
+	void *seen = NULL;
+	struct dirent *d;
+	DIR *proc;
+
+	proc = opendir(_PATH_PROC);
+	if (!proc)
+		err(EXIT_FAILURE, _("cannot open %s"), _PATH_PROC);
+
+	while ((d = xreaddir(proc))) {
+		struct dirent *e;
+		char buf[sizeof("/fd") + sizeof(stringify_value(INT_MAX))];
+		pid_t pid;
+		DIR *fds;
+		int dfd;
+
+		if (procfs_dirent_get_pid(d, &pid) != 0)
+			continue;
+
+		snprintf(buf, sizeof(buf), "%d/fd", (int) pid);
+		dfd = openat(dirfd(proc), buf, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dfd < 0)
+			continue;		/* not permitted or gone */
+		fds = fdopendir(dfd);
+		if (!fds) {
+			close(dfd);
+			continue;
+		}
+
+		while ((e = xreaddir(fds))) {
+			struct pipe_id *id;
+			struct stat st;
+			char name[PATH_MAX];
+			int fd, sz, used;
+
+			if (fstatat(dfd, e->d_name, &st, 0) != 0 || !S_ISFIFO(st.st_mode))
+				continue;
+
+			id = xmalloc(sizeof(*id));
+			id->dev = st.st_dev;
+			id->ino = st.st_ino;
+			if (*(struct pipe_id **) tsearch(id, &seen, cmp_pipe_ids) != id) {
+				free(id);
+				continue;	/* already seen */
+			}
+
+			snprintf(name, sizeof(name), _PATH_PROC "/%d/fd/%s", (int) pid, e->d_name);
+
+			/* don't block on a FIFO without writers */
+			fd = openat(dfd, e->d_name, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			if (fd < 0) {
+				/* TRANSLATORS: '%s' refers to a file */
+				check(_("cannot open %s"), name);
+				continue;
+			}
+
+			if (opt_get || opt_min_fill >= 0) {
+				if (get_pipe(fd, name, &sz, &used) != 0)
+					goto next;
+				if (opt_min_fill >= 0 &&
+				    (int64_t) used * 100 < (int64_t) opt_min_fill * sz)
+					goto next;
+			}
+
+			if (opt_get) {
+				printf("%s\t%d\t%d\n", name, sz, used);
+				add_pipe_stat(&stats, &nstats, sz, used);
+			} else
+				do_set(fd, name);
+		next:
+			close(fd);
+		}
+		closedir(fds);
+	}
+	closedir(proc);
+	tdestroy(seen, free);
+
+	if (opt_get && opt_verbose && nstats) {
+		qsort(stats, nstats, sizeof(struct pipe_stat), cmp_pipe_stats);
+
+		printf("\n%s\t%s\t%s\n",
+/* TRANSLATORS: a column that contains buffer sizes in bytes */
+			_("size"),
+/* TRANSLATORS: a column that contains a number of pipes */
+			_("pipes"),
+/* TRANSLATORS: a column that contains a number of pipes with no free space */
+			_("full"));
+		for (i = 0; i < nstats; i++)
+			printf("%d\t%zu\t%zu\n", stats[i].size, stats[i].count, stats[i].full);
+	}
+	free(stats);
+}
+
 /*
  * if necessary, determines a default buffer size and places it in opt_size
  * returns FALSE if this could not be done
@@ -197,13 +362,15 @@ static char set_size_default(void)
 
 int main(int argc, char **argv)
 {
-	static const char shortopts[] = "+cef:ghin:oqs:vV";
+	static const char shortopts[] = "+acef:ghim:n:oqs:vV";
 	static const struct option longopts[] = {
+		{ "all",       no_argument,       NULL, 'a' },
 		{ "check",     no_argument,       NULL, 'c' },
 		{ "fd",        required_argument, NULL, 'n' },
 		{ "file",      required_argument, NULL, 'f' },
 		{ "get",       no_argument,       NULL, 'g' },
 		{ "help",      no_argument,       NULL, 'h' },
+		{ "min-fill",  required_argument, NULL, 'm' },
 		{ "quiet",     no_argument,       NULL, 'q' },
 		{ "set",       required_argument, NULL, 's' },
 		{ "stdin",     no_argument,       NULL, 'i' },
@@ -244,6 +411,9 @@ int main(int argc, char **argv)
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch (c) {
+		case 'a':
+			opt_all = TRUE;
+			break;
 		case 'c':
 			opt_check = TRUE;
 			break;
@@ -259,6 +429,11 @@ int main(int argc, char **argv)
 		case 'i':
 			++n_opt_pipe;
 			break;
+		case 'm':
+			opt_min_fill = strtou32_or_err(optarg, _("invalid percent argument"));
+			if (opt_min_fill > 100)
+				errx(EXIT_FAILURE, _("invalid percent argument"));
+			break;
 		case 'n':
 			(void) strtos32_or_err(optarg, _("invalid fd argument"));
 			++n_opt_pipe;
@@ -283,6 +458,14 @@ int main(int argc, char **argv)
 	}
 
 	/* check arguments */
+	if (opt_all) {
+		if (n_opt_pipe)
+			errx(EXIT_FAILURE, _("--all cannot be combined with --file or --fd"));
+		if (argv[optind])
+			errx(EXIT_FAILURE, _("cannot specify a command with --all"));
+	} else if (opt_min_fill >= 0)
+		errx(EXIT_FAILURE, _("--min-fill requires --all"));
+
 	if (opt_get) {
 		if (argv[optind])
 			errx(EXIT_FAILURE, _("cannot specify a command with --get"));
@@ -298,6 +481,11 @@ int main(int argc, char **argv)
 				_("unread")
 			);
 
+		if (opt_all) {
+			do_all();
+			return EXIT_SUCCESS;
+		}
+
 		/* special behavior for --get */
 		if (!n_opt_pipe) {
 			do_fd(STDIN_FILENO);
@@ -310,6 +498,11 @@ int main(int argc, char **argv)
 		if (!opt_quiet && n_opt_size > 1)
 			warnx(_("using last specified size"));
 
+		if (opt_all) {
+			do_all();
+			return EXIT_SUCCESS;
+		}
+
 		/* special behavior for --set */
 		if (!n_opt_pipe) {
 			do_fd(STDOUT_FILENO);
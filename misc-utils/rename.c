@@ -34,6 +34,10 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifndef HAVE_RENAMEAT2
+# include <sys/syscall.h>
+#endif
+
 #include "nls.h"
 #include "xalloc.h"
 #include "c.h"
@@ -45,6 +49,18 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #define RENAME_EXIT_NOTHING	4
 #define RENAME_EXIT_UNEXPLAINED	64
 
+#ifndef RENAME_NOREPLACE
+# define RENAME_NOREPLACE (1 << 0)
+#endif
+
+#if !defined(HAVE_RENAMEAT2) && defined(SYS_renameat2)
+static inline int renameat2(int olddirfd, const char *oldpath,
+			    int newdirfd, const char *newpath, unsigned int flags)
+{
+	return syscall (SYS_renameat2, olddirfd, oldpath, newdirfd, newpath, flags);
+}
+#endif
+
 static int tty_cbreak = 0;
 static int all = 0;
 static int last = 0;
@@ -246,6 +262,151 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
 	return ret;
 }
 
+/* the directory of the previous file from --files0-from */
+struct rename_dir {
+	char	*path;
+	int	fd;
+};
+
+static int get_dirfd(struct rename_dir *dir, const char *path, size_t len)
+{
+	if (dir->path && strlen(dir->path) == len && !strncmp(dir->path, path, len))
+		return dir->fd;
+
+	if (dir->fd >= 0)
+		close(dir->fd);
+	free(dir->path);
+
+	dir->path = xstrndup(path, len);
+	dir->fd = open(len ? dir->path : "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	return dir->fd;
+}
+
+static int rename_noreplace(int fd, const char *oldname, const char *newname)
+{
+#if defined(HAVE_RENAMEAT2) || defined(SYS_renameat2)
+	if (renameat2(fd, oldname, fd, newname, RENAME_NOREPLACE) == 0)
+		return 0;
+	/* not supported by the kernel or the filesystem */
+	if (errno != ENOSYS && errno != EINVAL)
+		return -1;
+#endif
+	if (faccessat(fd, newname, F_OK, AT_SYMLINK_NOFOLLOW) == 0) {
+		errno = EEXIST;
+		return -1;
+	}
+	return renameat(fd, oldname, fd, newname);
+}
+
+/*
+ * Rename a file relative to its directory. The directory is opened only when
+ * it differs from the directory of the previous file, so lists of files
+ * grouped by directory (as generated by find(1)) do not need to resolve the
+ * whole path for every file. Returns the same as do_file().
+ */
+static int do_file_at(char *from, char *to, char *s, struct rename_dir *dir,
+		      int verbose, int noact, int nooverwrite, int interactive)
+{
+	char *base, *newbase = NULL, *newname = NULL;
+	struct stat sb;
+	int fd, rc, ret = 1;
+
+	base = strrchr(s, '/');
+	if (!base) {
+		fd = AT_FDCWD;
+		base = s;
+	} else {
+		fd = get_dirfd(dir, s, base - s);
+		if (fd < 0) {
+			warn(_("%s: not accessible"), s);
+			return 2;
+		}
+		base++;
+	}
+
+	if (fstatat(fd, base, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+		warn(_("%s: not accessible"), s);
+		return 2;
+	}
+	if (string_replace(from, to, base, &newbase) != 0)
+		return 0;
+
+	xasprintf(&newname, "%.*s%s", (int) (base - s), s, newbase);
+
+	if (interactive && faccessat(fd, newbase, F_OK, AT_SYMLINK_NOFOLLOW) == 0
+	    && (noact || ask(newname) != 0)) {
+		if (verbose)
+			printf(_("Skipping existing file: `%s'\n"), newname);
+		ret = 0;
+	} else if (nooverwrite && noact) {
+		if (faccessat(fd, newbase, F_OK, AT_SYMLINK_NOFOLLOW) == 0) {
+			if (verbose)
+				printf(_("Skipping existing file: `%s'\n"), newname);
+			ret = 0;
+		}
+	} else if (!noact) {
+		if (nooverwrite)
+			rc = rename_noreplace(fd, base, newbase);
+		else
+			rc = renameat(fd, base, fd, newbase);
+
+		if (rc != 0 && nooverwrite && errno == EEXIST) {
+			if (verbose)
+				printf(_("Skipping existing file: `%s'\n"), newname);
+			ret = 0;
+		} else if (rc != 0) {
+			warn(_("%s: rename to %s failed"), s, newname);
+			ret = 2;
+		}
+	}
+	if (verbose && (noact || ret == 1))
+		printf("`%s' -> `%s'\n", s, newname);
+	free(newbase);
+	free(newname);
+	return ret;
+}
+
+static int do_files0_from(char *from, char *to, const char *filename,
+			  int (*do_rename)(char *, char *, char *, int, int, int, int),
+			  int verbose, int noact, int nooverwrite, int interactive)
+{
+	struct rename_dir dir = { .fd = -1 };
+	FILE *f = stdin;
+	char *buf = NULL;
+	size_t bufsz = 0;
+	ssize_t len;
+	int ret = 0;
+
+	if (strcmp(filename, "-") != 0) {
+		f = fopen(filename, "r" UL_CLOEXECSTR);
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), filename);
+	}
+
+	while ((len = getdelim(&buf, &bufsz, '\0', f)) > 0) {
+		if (len == 1 && *buf == '\0')
+			continue;
+		/* with a path in the pattern the final component is not enough */
+		if (do_rename != do_file || strchr(from, '/') || strchr(to, '/')
+		    || buf[len - (buf[len - 1] == '\0' ? 2 : 1)] == '/')
+			ret |= do_rename(from, to, buf, verbose, noact,
+					 nooverwrite, interactive);
+		else
+			ret |= do_file_at(from, to, buf, &dir, verbose, noact,
+					  nooverwrite, interactive);
+	}
+	if (ferror(f))
+		err(EXIT_FAILURE, _("read failed: %s"), filename);
+
+	if (dir.fd >= 0)
+		close(dir.fd);
+	free(dir.path);
+	free(buf);
+	if (f != stdin)
+		fclose(f);
+	return ret;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -253,6 +414,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %s [options] <expression> <replacement> <file>...\n"),
 		program_invocation_short_name);
+	fprintf(out,
+	      _(" %s [options] --files0-from <file> <expression> <replacement>\n"),
+		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Rename files.\n"), out);
@@ -265,6 +429,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --last          replace only the last occurrence\n"), out);
 	fputs(_(" -o, --no-overwrite  don't overwrite existing files\n"), out);
 	fputs(_(" -i, --interactive   prompt before overwrite\n"), out);
+	fputs(_("     --files0-from <file>\n"
+		"                     read NUL-terminated file names from <file>\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
 	fprintf(out, USAGE_MAN_TAIL("rename(1)"));
@@ -273,12 +439,15 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char **argv)
 {
-	char *from, *to;
+	char *from, *to, *files0_from = NULL;
 	int i, c, ret = 0, verbose = 0, noact = 0, nooverwrite = 0, interactive = 0;
 	struct termios tio;
 	int (*do_rename)(char *from, char *to, char *s, int verbose, int noact,
 	                 int nooverwrite, int interactive) = do_file;
 
+	enum {
+		OPT_FILES0_FROM = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{"verbose", no_argument, NULL, 'v'},
 		{"version", no_argument, NULL, 'V'},
@@ -289,6 +458,7 @@ int main(int argc, char **argv)
 		{"no-overwrite", no_argument, NULL, 'o'},
 		{"interactive", no_argument, NULL, 'i'},
 		{"symlink", no_argument, NULL, 's'},
+		{"files0-from", required_argument, NULL, OPT_FILES0_FROM},
 		{NULL, 0, NULL, 0}
 	};
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
@@ -327,6 +497,9 @@ int main(int argc, char **argv)
 		case 's':
 			do_rename = do_symlink;
 			break;
+		case OPT_FILES0_FROM:
+			files0_from = optarg;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -340,10 +513,14 @@ int main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
-	if (argc < 3) {
+	if (argc < (files0_from ? 2 : 3)) {
 		warnx(_("not enough arguments"));
 		errtryhelp(EXIT_FAILURE);
 	}
+	if (files0_from && argc > 2)
+		errx(EXIT_FAILURE, _("file operands cannot be combined with --files0-from"));
+	if (files0_from && interactive && !strcmp(files0_from, "-"))
+		errx(EXIT_FAILURE, _("--interactive cannot read answers from standard input with --files0-from -"));
 
 	from = argv[0];
 	to = argv[1];
@@ -359,8 +536,13 @@ int main(int argc, char **argv)
 			tty_cbreak = 1;
 	}
 
-	for (i = 2; i < argc; i++)
-		ret |= do_rename(from, to, argv[i], verbose, noact, nooverwrite, interactive);
+	if (files0_from)
+		ret = do_files0_from(from, to, files0_from, do_rename,
+				     verbose, noact, nooverwrite, interactive);
+	else {
+		for (i = 2; i < argc; i++)
+			ret |= do_rename(from, to, argv[i], verbose, noact, nooverwrite, interactive);
+	}
 
 	switch (ret) {
 	case 0:
@@ -23,6 +23,13 @@
  * | reply length (4 bytes) | uuid reply (16 bytes) | number (4 bytes) time bulk |
  *   or
  * | reply length (4 bytes) | pid or maxop number string length in ascii (up to 7 bytes) |
+ *
+ * The server keeps the connection open after the reply, so the client may
+ * send more requests (also pipelined) before it closes the connection.
+ *
+ * With --shm the time-based UUIDs are also published in shared memory, see
+ * struct uuidd_shm. The clients ask for more UUIDs by UUIDD_OP_SHM_REFILL,
+ * the reply is the number of the published UUIDs (4 bytes, 0 on error).
  */
 
 #include <stdio.h>
@@ -40,7 +47,8 @@
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 
 #include "uuid.h"
 #include "uuidd.h"
@@ -51,6 +59,7 @@
 #include "optutils.h"
 #include "monotonic.h"
 #include "timer.h"
+#include "xalloc.h"
 
 #ifdef HAVE_LIBSYSTEMD
 # include <systemd/sd-daemon.h>
@@ -73,11 +82,28 @@ struct uuidd_cxt_t {
 	const char	*cleanup_socket;
 	uint32_t	timeout;
 	uint32_t	cont_clock_offset;
+	struct uuidd_shm *shm;		/* shared memory for clients */
 
 	unsigned int	debug: 1,
 			quiet: 1,
 			no_fork: 1,
-			no_sock: 1;
+			no_sock: 1,
+			use_shm: 1;
+};
+
+#define UUIDD_MAX_CONNS		512	/* maximal number of connected clients */
+#define UUIDD_CONN_TIMEOUT	5	/* seconds, idle clients are disconnected */
+
+/* client connection */
+struct uuidd_conn {
+	char		in[sizeof(uuidd_prot_op_t) + sizeof(uuidd_prot_num_t)];
+	size_t		in_len;		/* already read request bytes */
+	char		out[sizeof(int32_t) + UUIDD_PROT_BUFSZ];
+	size_t		out_len;	/* reply size */
+	size_t		out_done;	/* already written reply bytes */
+	uint32_t	events;		/* epoll events */
+	time_t		last_used;	/* last activity, monotonic seconds */
+	uint64_t	lru;		/* last activity, serial number */
 };
 
 struct uuidd_options_t {
@@ -110,6 +136,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -S, --socket-activation do not create listening socket\n"), out);
 	fputs(_(" -C, --cont-clock[=<NUM>[hd]]\n"), out);
 	fputs(_("                         activate continuous clock handling\n"), out);
+	fputs(_("     --shm               publish time-based UUIDs in shared memory\n"), out);
 	fputs(_(" -d, --debug             run in debugging mode\n"), out);
 	fputs(_(" -q, --quiet             turn on quiet mode\n"), out);
 	fputs(USAGE_SEPARATOR, out);
@@ -341,28 +368,387 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		errx(EXIT_FAILURE, _("timed out"));
 }
 
-static void server_loop(const char *socket_path, const char *pidfile_path,
-			struct uuidd_cxt_t *uuidd_cxt)
+/*
+ * Reserves a new block of time-based UUIDs and writes it to the shared memory
+ * slot for the generation @gen. Returns number of the UUIDs or 0 on error.
+ */
+static int shm_publish(const struct uuidd_cxt_t *uuidd_cxt, uint64_t gen)
+{
+	struct uuidd_shm_slot *slot = &uuidd_cxt->shm->slots[gen % UUIDD_SHM_NSLOTS];
+	uint64_t base[2];
+	uuid_t uu;
+	int num = UUIDD_SHM_BLOCK;
+
+	if (__uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset) < 0) {
+		/* don't publish UUIDs without guaranteed uniqueness */
+		if (!uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		return 0;
+	}
+	memcpy(base, uu, sizeof(base));
+
+	/* invalidate the slot for readers, see read_uuidd_shm_slot() in libuuid */
+	__atomic_store_n(&slot->gen, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&slot->time, (int64_t) time(NULL), __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->uuid[0], base[0], __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->uuid[1], base[1], __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->count, (uint32_t) num, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&slot->gen, gen, __ATOMIC_RELEASE);
+
+	if (uuidd_cxt->debug) {
+		char str[UUID_STR_LEN];
+
+		uuid_unparse(uu, str);
+		fprintf(stderr, _("Published time UUID %s and %d following "
+				  "[generation %"PRIu64"]\n"), str, num - 1, gen);
+	}
+	return num;
+}
+
+/*
+ * Publishes the block following the block used by clients, if not published
+ * yet. Returns number of the available UUIDs in the next block.
+ */
+static int shm_refill(const struct uuidd_cxt_t *uuidd_cxt)
+{
+	struct uuidd_shm *shm = uuidd_cxt->shm;
+	struct uuidd_shm_slot *slot;
+	uint64_t gen;
+
+	if (!shm)
+		return 0;
+
+	gen = (__atomic_load_n(&shm->claim, __ATOMIC_ACQUIRE) >> 32) + 1;
+	slot = &shm->slots[gen % UUIDD_SHM_NSLOTS];
+
+	if (__atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE) == gen)
+		return __atomic_load_n(&slot->count, __ATOMIC_RELAXED);
+
+	return shm_publish(uuidd_cxt, gen);
+}
+
+/*
+ * Creates (or reuses after restart) the shared memory file, publishes the
+ * first block and the next one in advance. The file is readable and writable
+ * for the daemon user and group only; anyone who can write to the file can
+ * break uniqueness of UUIDs for the other users.
+ */
+static void shm_init(struct uuidd_cxt_t *uuidd_cxt, const char *path)
+{
+	struct uuidd_shm *shm;
+	uint64_t gen = 1;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+	if (fd < 0 || fchmod(fd, 0660) != 0)
+		err(EXIT_FAILURE, _("cannot open %s"), path);
+	if (ftruncate(fd, sizeof(*shm)) != 0)
+		err(EXIT_FAILURE, _("could not truncate file: %s"), path);
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED)
+		err(EXIT_FAILURE, _("cannot mmap %s"), path);
+	close(fd);
+
+	/* Continue after the blocks from the previous instance. The clients
+	 * may still claim UUIDs from the current block, so the slots are not
+	 * reset; the new generations are bumped above all generations used by
+	 * the previous instance and the old blocks are replaced one by one. */
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) == UUIDD_SHM_MAGIC)
+		gen = (__atomic_load_n(&shm->claim, __ATOMIC_ACQUIRE) >> 32)
+			+ UUIDD_SHM_NSLOTS;
+	else
+		memset(shm, 0, sizeof(*shm));	/* not used by clients yet */
+
+	uuidd_cxt->shm = shm;
+	if (!shm_publish(uuidd_cxt, gen))
+		errx(EXIT_FAILURE, _("cannot publish UUIDs in shared memory"));
+
+	__atomic_store_n(&shm->claim, gen << 32, __ATOMIC_RELEASE);
+	__atomic_store_n(&shm->magic, UUIDD_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	shm_publish(uuidd_cxt, gen + 1);
+}
+
+/*
+ * Generates reply for the request @op to @reply_buf.
+ *
+ * Returns reply length or -1 for invalid operation.
+ */
+static int32_t process_request(const struct uuidd_cxt_t *uuidd_cxt,
+			       uuidd_prot_op_t op, uuidd_prot_num_t num,
+			       char *reply_buf, size_t bufsz)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
 	int32_t			reply_len = 0;
 	uuid_t			uu;
-	char			reply_buf[UUIDD_PROT_BUFSZ], *cp;
-	uuidd_prot_op_t 	op;
-	char			str[UUID_STR_LEN];
-	int			i, ns, len;
-	uuidd_prot_num_t	num;		/* intentionally uninitialized */
+	char			str[UUID_STR_LEN], *cp;
+	int			i, ret;
+
+	switch (op) {
+	case UUIDD_OP_GETPID:
+		snprintf(reply_buf, bufsz, "%d", getpid());
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		snprintf(reply_buf, bufsz, "%d", UUIDD_MAX_OP);
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		memcpy(reply_buf + reply_len, &num, sizeof(num));
+		reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		if ((bufsz - sizeof(num)) < (size_t) (sizeof(uu) * num))
+			num = (bufsz - sizeof(num)) / sizeof(uu);
+		__uuid_generate_random((unsigned char *) reply_buf +
+				      sizeof(num), &num);
+		reply_len = sizeof(num) + (sizeof(uu) * num);
+		memcpy(reply_buf, &num, sizeof(num));
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			cp = reply_buf + sizeof(num);
+			for (i = 0; i < num; i++) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+				cp += sizeof(uu);
+			}
+		}
+		break;
+	case UUIDD_OP_SHM_REFILL:
+		num = shm_refill(uuidd_cxt);
+		memcpy(reply_buf, &num, sizeof(num));
+		reply_len = sizeof(num);
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), op);
+		return -1;
+	}
+
+	return reply_len;
+}
+
+static size_t request_size(uuidd_prot_op_t op)
+{
+	if ((op == UUIDD_OP_BULK_TIME_UUID) ||
+	    (op == UUIDD_OP_BULK_RANDOM_UUID))
+		return sizeof(op) + sizeof(uuidd_prot_num_t);
+	return sizeof(op);
+}
+
+/*
+ * Reads the next request from the client. Returns 1 if the whole request is
+ * available, 0 if more data are necessary, -1 on EOF or error.
+ */
+static int conn_read_request(struct uuidd_conn *c, int fd)
+{
+	do {
+		size_t need = c->in_len ? request_size(c->in[0]) : sizeof(uuidd_prot_op_t);
+		ssize_t len;
+
+		if (c->in_len == need)
+			return 1;
+
+		len = read(fd, c->in + c->in_len, need - c->in_len);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return 0;
+			warn(_("read failed"));
+			return -1;
+		}
+		if (len == 0) {
+			if (c->in_len)
+				warnx(_("error reading from client, len = %zu"),
+						c->in_len);
+			return -1;
+		}
+		c->in_len += len;
+	} while (1);
+}
+
+/*
+ * Writes the rest of the reply to the client. Returns 0 on success, 1 if
+ * the socket is not ready, -1 on error.
+ */
+static int conn_write_reply(struct uuidd_conn *c, int fd)
+{
+	while (c->out_done < c->out_len) {
+		ssize_t len = write(fd, c->out + c->out_done,
+				    c->out_len - c->out_done);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN ? 1 : -1;
+		}
+		c->out_done += len;
+	}
+	c->out_len = c->out_done = 0;
+	return 0;
+}
+
+/*
+ * Serves all the requests available on the connection. Returns 0 if the
+ * connection has to be kept, -1 if the connection has to be closed.
+ */
+static int conn_handle(const struct uuidd_cxt_t *uuidd_cxt,
+		       struct uuidd_conn *c, int fd, int efd)
+{
+	struct epoll_event ev = { .events = 0 };
+	uint32_t events = EPOLLIN;
+
+	while (1) {
+		uuidd_prot_op_t op;
+		uuidd_prot_num_t num = 0;
+		int32_t reply_len;
+		int rc;
+
+		if (c->out_len) {
+			rc = conn_write_reply(c, fd);
+			if (rc < 0)
+				return -1;
+			if (rc == 1) {
+				/* don't read more requests before the reply is sent */
+				events = EPOLLOUT;
+				break;
+			}
+		}
+
+		rc = conn_read_request(c, fd);
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+			break;
+
+		op = c->in[0];
+		if (c->in_len > sizeof(op)) {
+			memcpy(&num, c->in + sizeof(op), sizeof(num));
+			if (uuidd_cxt->debug)
+				fprintf(stderr, _("operation %d, incoming num = %d\n"),
+					op, num);
+		} else if (uuidd_cxt->debug)
+			fprintf(stderr, _("operation %d\n"), op);
+		c->in_len = 0;
+
+		reply_len = process_request(uuidd_cxt, op, num,
+				c->out + sizeof(reply_len), UUIDD_PROT_BUFSZ);
+		if (reply_len < 0)
+			return -1;
+		memcpy(c->out, &reply_len, sizeof(reply_len));
+		c->out_len = sizeof(reply_len) + reply_len;
+	}
+
+	if (events != c->events) {
+		ev.events = events;
+		ev.data.fd = fd;
+		if (epoll_ctl(efd, EPOLL_CTL_MOD, fd, &ev) < 0)
+			return -1;
+		c->events = events;
+	}
+	return 0;
+}
+
+static time_t monotonic_sec(void)
+{
+	struct timeval tv;
+
+	if (gettime_monotonic(&tv) != 0)
+		return 0;
+	return tv.tv_sec;
+}
+
+static void conn_close(struct uuidd_conn **conns, size_t *nclients, int fd)
+{
+	/* epoll removes closed descriptor automatically */
+	free(conns[fd]);
+	conns[fd] = NULL;
+	close(fd);
+	(*nclients)--;
+}
+
+/*
+ * Closes the connections idle for UUIDD_CONN_TIMEOUT seconds. If nothing is
+ * closed and @force is true, closes the least recently used connection.
+ * Returns number of the closed connections.
+ */
+static size_t conn_expire(struct uuidd_conn **conns, size_t nconns,
+			  size_t *nclients, time_t now, int force)
+{
+	size_t fd, n = 0;
+	int oldest = -1;
+
+	for (fd = 0; fd < nconns; fd++) {
+		struct uuidd_conn *c = conns[fd];
+
+		if (!c)
+			continue;
+		if (now - c->last_used >= UUIDD_CONN_TIMEOUT) {
+			conn_close(conns, nclients, fd);
+			n++;
+		} else if (oldest < 0 || c->lru < conns[oldest]->lru)
+			oldest = fd;
+	}
+	if (!n && force && oldest >= 0) {
+		conn_close(conns, nclients, oldest);
+		n++;
+	}
+	return n;
+}
+
+static void server_loop(const char *socket_path, const char *pidfile_path,
+			struct uuidd_cxt_t *uuidd_cxt)
+{
+	char			reply_buf[UUIDD_PROT_BUFSZ];
 	int			s = 0;
 	int			fd_pidfile = -1;
 	int			ret;
-	struct pollfd		pfd[2];
+	struct epoll_event	ev, events[64];
+	struct uuidd_conn	**conns = NULL;
+	size_t			nconns = 0, nclients = 0;
+	uint64_t		lru = 0;
+	time_t			now, last_activity;
 	sigset_t		sigmask;
-	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
+	int			sigfd, efd;
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -426,6 +812,9 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	}
 #endif
 
+	if (uuidd_cxt->use_shm)
+		shm_init(uuidd_cxt, UUIDD_SHM_PATH);
+
 	sigemptyset(&sigmask);
 	sigaddset(&sigmask, SIGHUP);
 	sigaddset(&sigmask, SIGINT);
@@ -438,132 +827,120 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	/* clients are served in parallel, don't wait on any of them */
+	if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, _("cannot set non-blocking mode"));
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0)
+		err(EXIT_FAILURE, _("cannot create epoll"));
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = sigfd;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, sigfd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add signal file descriptor to epoll"));
+	ev.data.fd = s;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, s, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add socket to epoll"));
+
+	last_activity = monotonic_sec();
 
 	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
-				uuidd_cxt->timeout ?
-					(int) uuidd_cxt->timeout * 1000 : -1);
-		if (ret < 0) {
-			if (errno == EAGAIN)
+		int i, n, wait = -1;
+
+		if (uuidd_cxt->timeout)
+			wait = (int) uuidd_cxt->timeout * 1000;
+		/* wake up to disconnect idle clients */
+		if (nclients && (wait < 0 || wait > UUIDD_CONN_TIMEOUT * 1000))
+			wait = UUIDD_CONN_TIMEOUT * 1000;
+
+		n = epoll_wait(efd, events, ARRAY_SIZE(events), wait);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
 				continue;
-			warn(_("poll failed"));
+			warn(_("epoll failed"));
 			all_done(uuidd_cxt, EXIT_FAILURE);
 		}
-		if (ret == 0) {		/* true when poll() times out */
+		now = monotonic_sec();
+		if (n == 0 && uuidd_cxt->timeout
+		    && now - last_activity >= (time_t) uuidd_cxt->timeout) {
 			if (uuidd_cxt->debug)
 				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
 			all_done(uuidd_cxt, EXIT_SUCCESS);
 		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
-			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, sizeof(op));
-		if (len != sizeof(op)) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != sizeof(num))
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
+		if (n > 0)
+			last_activity = now;
 
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
+		for (i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+			struct uuidd_conn *c;
+
+			if (fd == sigfd) {
+				handle_signal(uuidd_cxt, sigfd);
+				continue;
 			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if ((sizeof(reply_buf) - sizeof(num)) < (size_t) (sizeof(uu) * num))
-				num = (sizeof(reply_buf) - sizeof(num)) / sizeof(uu);
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			reply_len = sizeof(num) + (sizeof(uu) * num);
-			memcpy(reply_buf, &num, sizeof(num));
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				cp = reply_buf + sizeof(num);
-				for (i = 0; i < num; i++) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-					cp += sizeof(uu);
+
+			if (fd == s) {
+				int ns;
+
+				/* accept all pending connections */
+				while (1) {
+					ns = accept4(s, NULL, NULL,
+						     SOCK_NONBLOCK | SOCK_CLOEXEC);
+					if (ns < 0) {
+						if (errno == EINTR || errno == ECONNABORTED)
+							continue;
+						/* out of file descriptors, make room
+						 * for the next connection */
+						if ((errno == EMFILE || errno == ENFILE)
+						    && conn_expire(conns, nconns,
+								   &nclients, now, 1))
+							continue;
+						if (errno == EAGAIN || errno == EMFILE
+						    || errno == ENFILE)
+							break;
+						err(EXIT_FAILURE, "accept");
+					}
+					if (nclients >= UUIDD_MAX_CONNS)
+						conn_expire(conns, nconns, &nclients, now, 1);
+
+					if ((size_t) ns >= nconns) {
+						size_t sz = max((size_t) ns + 1, nconns * 2);
+
+						conns = xreallocarray(conns, sz, sizeof(*conns));
+						memset(conns + nconns, 0,
+							(sz - nconns) * sizeof(*conns));
+						nconns = sz;
+					}
+					c = conns[ns] = xcalloc(1, sizeof(*c));
+					c->events = EPOLLIN;
+					c->last_used = now;
+					c->lru = ++lru;
+					nclients++;
+
+					ev.events = EPOLLIN;
+					ev.data.fd = ns;
+					if (epoll_ctl(efd, EPOLL_CTL_ADD, ns, &ev) < 0
+					    || conn_handle(uuidd_cxt, c, ns, efd) < 0)
+						conn_close(conns, &nclients, ns);
 				}
+				continue;
 			}
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
+
+			c = (size_t) fd < nconns ? conns[fd] : NULL;
+			if (!c)
+				continue;
+			c->last_used = now;
+			c->lru = ++lru;
+			if (((events[i].events & (EPOLLERR | EPOLLHUP))
+			     && !(events[i].events & EPOLLIN))
+			    || conn_handle(uuidd_cxt, c, fd, efd) < 0)
+				conn_close(conns, &nclients, fd);
 		}
-		write_all(ns, (char *) &reply_len, sizeof(num));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
+
+		if (nclients)
+			conn_expire(conns, nconns, &nclients, now, 0);
 	}
 }
 
@@ -596,6 +973,9 @@ static uint32_t parse_cont_clock(char *arg)
 static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 			  struct uuidd_options_t *uuidd_opts)
 {
+	enum {
+		OPT_SHM = CHAR_MAX + 1
+	};
 	const struct option longopts[] = {
 		{"pid", required_argument, NULL, 'p'},
 		{"socket", required_argument, NULL, 's'},
@@ -608,6 +988,7 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
 		{"cont-clock", optional_argument, NULL, 'C'},
+		{"shm", no_argument, NULL, OPT_SHM},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"version", no_argument, NULL, 'V'},
@@ -678,6 +1059,9 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 			uuidd_cxt->timeout = strtou32_or_err(optarg,
 						_("failed to parse --timeout"));
 			break;
+		case OPT_SHM:
+			uuidd_cxt->use_shm = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
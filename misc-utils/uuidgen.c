@@ -40,6 +40,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -C, --count <num>     generate more uuids in loop\n"), out);
 	fputs(_(" -s, --sha1            generate sha1 hash\n"), out);
 	fputs(_(" -x, --hex             interpret name as hex string\n"), out);
+	fputs(_(" -b, --binary          write raw 16-byte uuids instead of strings\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
 	fprintf(out, USAGE_MAN_TAIL("uuidgen(1)"));
@@ -87,10 +88,11 @@ main (int argc, char *argv[])
 {
 	int    c;
 	int    do_type = 0, is_hex = 0;
-	char   str[UUID_STR_LEN];
+	int    binary = 0;
 	char   *namespace = NULL, *name = NULL;
-	size_t namelen = 0;
-	uuid_t ns, uu;
+	size_t namelen = 0, n, j;
+	uuid_t ns, batch[1024];
+	char   buf[ARRAY_SIZE(batch) * UUID_STR_LEN];
 	unsigned int count = 1, i;
 
 	static const struct option longopts[] = {
@@ -104,6 +106,7 @@ main (int argc, char *argv[])
 		{"count", required_argument, NULL, 'C'},
 		{"sha1", no_argument, NULL, 's'},
 		{"hex", no_argument, NULL, 'x'},
+		{"binary", no_argument, NULL, 'b'},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -121,7 +124,7 @@ main (int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "C:rtVhn:N:msx", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bC:rtVhn:N:msx", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -150,6 +153,9 @@ main (int argc, char *argv[])
 		case 'x':
 			is_hex = 1;
 			break;
+		case 'b':
+			binary = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -186,44 +192,63 @@ main (int argc, char *argv[])
 			name = unhex(name, &namelen);
 	}
 
-	for (i = 0; i < count; i++) {
+	if (namespace) {
+		if (namespace[0] == '@' && namespace[1] != '\0') {
+			const uuid_t *uuidptr;
+
+			uuidptr = uuid_get_template(&namespace[1]);
+			if (uuidptr == NULL) {
+				warnx(_("unknown namespace alias: '%s'"), namespace);
+				errtryhelp(EXIT_FAILURE);
+			}
+			memcpy(ns, *uuidptr, sizeof(ns));
+		} else {
+			if (uuid_parse(namespace, ns) != 0) {
+				warnx(_("invalid uuid for namespace: '%s'"), namespace);
+				errtryhelp(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/* generate and write the UUIDs in batches, not one by one */
+	for (i = 0; i < count; i += n) {
+		n = min((size_t) (count - i), ARRAY_SIZE(batch));
+
 		switch (do_type) {
 		case UUID_TYPE_DCE_TIME:
-			uuid_generate_time(uu);
+			for (j = 0; j < n; j++)
+				uuid_generate_time(batch[j]);
 			break;
 		case UUID_TYPE_DCE_RANDOM:
-			uuid_generate_random(uu);
+			/* read random data for more UUIDs at once */
+			uuid_generate_random_n(batch, n);
 			break;
 		case UUID_TYPE_DCE_MD5:
+			for (j = 0; j < n; j++)
+				uuid_generate_md5(batch[j], ns, name, namelen);
+			break;
 		case UUID_TYPE_DCE_SHA1:
-			if (namespace[0] == '@' && namespace[1] != '\0') {
-				const uuid_t *uuidptr;
-
-				uuidptr = uuid_get_template(&namespace[1]);
-				if (uuidptr == NULL) {
-					warnx(_("unknown namespace alias: '%s'"), namespace);
-					errtryhelp(EXIT_FAILURE);
-				}
-				memcpy(ns, *uuidptr, sizeof(ns));
-			} else {
-				if (uuid_parse(namespace, ns) != 0) {
-					warnx(_("invalid uuid for namespace: '%s'"), namespace);
-					errtryhelp(EXIT_FAILURE);
-				}
-			}
-			if (do_type == UUID_TYPE_DCE_MD5)
-				uuid_generate_md5(uu, ns, name, namelen);
-			else
-				uuid_generate_sha1(uu, ns, name, namelen);
+			for (j = 0; j < n; j++)
+				uuid_generate_sha1(batch[j], ns, name, namelen);
 			break;
 		default:
-			uuid_generate(uu);
+			for (j = 0; j < n; j++)
+				uuid_generate(batch[j]);
 			break;
 		}
 
-		uuid_unparse(uu, str);
+		if (binary) {
+			fwrite(batch, sizeof(uuid_t), n, stdout);
+			continue;
+		}
+
+		for (j = 0; j < n; j++) {
+			char *str = buf + j * UUID_STR_LEN;
 
-		printf("%s\n", str);
+			uuid_unparse(batch[j], str);
+			str[UUID_STR_LEN - 1] = '\n';
+		}
+		fwrite(buf, UUID_STR_LEN, n, stdout);
 	}
 
 	if (is_hex)
@@ -90,6 +90,12 @@ enum {
 	ALL_DIRS = BIN_DIR | MAN_DIR | SRC_DIR
 };
 
+/* directory entry */
+struct wh_dirent {
+	char	*name;
+	size_t	pos;		/* readdir() order */
+};
+
 /* directories */
 struct wh_dirlist {
 	int	type;
@@ -97,6 +103,12 @@ struct wh_dirlist {
 	ino_t	st_ino;
 	char	*path;
 
+	/* the directory content, read on the first lookup */
+	struct wh_dirent *ents;		/* in readdir() order */
+	struct wh_dirent **sorted;	/* sorted by name */
+	size_t	nents;
+	unsigned int loaded : 1;
+
 	struct wh_dirlist *next;
 };
 
@@ -370,6 +382,16 @@ static void construct_dirlist(struct wh_dirlist **ls,
 	}
 }
 
+static void free_dirents(struct wh_dirlist *ls)
+{
+	size_t i;
+
+	for (i = 0; i < ls->nents; i++)
+		free(ls->ents[i].name);
+	free(ls->ents);
+	free(ls->sorted);
+}
+
 static void free_dirlist(struct wh_dirlist **ls0, int type)
 {
 	struct wh_dirlist *prev = NULL, *next, *ls = *ls0;
@@ -382,6 +404,7 @@ static void free_dirlist(struct wh_dirlist **ls0, int type)
 		if (ls->type & type) {
 			next = ls->next;
 			DBG(LIST, ul_debugobj(*ls0, " free: %s", ls->path));
+			free_dirents(ls);
 			free(ls->path);
 			free(ls);
 			ls = next;
@@ -439,34 +462,139 @@ static int filename_equal(const char *cp, const char *dp, int type)
 	return 0;
 }
 
-static void findin(const char *dir, const char *pattern, int *count,
-		   char **wait, int type)
+static int cmp_dirents(const void *a, const void *b)
+{
+	const struct wh_dirent *const *x = a, *const *y = b;
+
+	return strcmp((*x)->name, (*y)->name);
+}
+
+static int cmp_dirents_pos(const void *a, const void *b)
+{
+	const struct wh_dirent *const *x = a, *const *y = b;
+
+	return (*x)->pos < (*y)->pos ? -1 : (*x)->pos > (*y)->pos ? 1 : 0;
+}
+
+/*
+ * Every directory is read only once per whereis(1) call, no matter how many
+ * patterns are searched in it.
+ */
+static void load_dirents(struct wh_dirlist *ls)
 {
 	DIR *dirp;
 	struct dirent *dp;
+	size_t alloc = 0, i;
+
+	ls->loaded = 1;
 
-	dirp = opendir(dir);
+	dirp = opendir(ls->path);
 	if (dirp == NULL)
 		return;
 
-	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, dir));
+	DBG(SEARCH, ul_debug("reading '%s'", ls->path));
 
 	while ((dp = readdir(dirp)) != NULL) {
-		if (!filename_equal(pattern, dp->d_name, type))
+		if (ls->nents == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			ls->ents = xreallocarray(ls->ents, alloc, sizeof(struct wh_dirent));
+		}
+		ls->ents[ls->nents].name = xstrdup(dp->d_name);
+		ls->ents[ls->nents].pos = ls->nents;
+		ls->nents++;
+	}
+	closedir(dirp);
+
+	if (!ls->nents)
+		return;
+
+	ls->sorted = xmalloc(ls->nents * sizeof(struct wh_dirent *));
+	for (i = 0; i < ls->nents; i++)
+		ls->sorted[i] = &ls->ents[i];
+	qsort(ls->sorted, ls->nents, sizeof(struct wh_dirent *), cmp_dirents);
+}
+
+/*
+ * Add entries which begin with @prefix to @res. A file name matches the
+ * pattern only if it starts with it (see filename_equal()), so only this
+ * range of the sorted directory has to be compared.
+ */
+static size_t find_prefixed(struct wh_dirlist *ls, const char *prefix,
+			    struct wh_dirent **res, size_t nres)
+{
+	size_t lo = 0, hi = ls->nents, len = strlen(prefix);
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(ls->sorted[mid]->name, prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < ls->nents; lo++) {
+		if (strncmp(ls->sorted[lo]->name, prefix, len) != 0)
+			break;
+		res[nres++] = ls->sorted[lo];
+	}
+	return nres;
+}
+
+static void findin(struct wh_dirlist *ls, const char *pattern, int *count,
+		   char **wait)
+{
+	struct wh_dirent **res;
+	size_t nres = 0, i;
+	char *sprefix = NULL;
+
+	if (!ls->loaded)
+		load_dirents(ls);
+	if (!ls->nents)
+		return;
+
+	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, ls->path));
+
+	/* the "s." prefixed range may overlap with the first one */
+	res = xmalloc(2 * ls->nents * sizeof(struct wh_dirent *));
+
+#ifdef HAVE_FNMATCH
+	if (use_glob) {
+		for (i = 0; i < ls->nents; i++)
+			res[nres++] = &ls->ents[i];
+	} else
+#endif
+	{
+		nres = find_prefixed(ls, pattern, res, nres);
+		if (ls->type & SRC_DIR) {
+			xasprintf(&sprefix, "s.%s", pattern);
+			nres = find_prefixed(ls, sprefix, res, nres);
+			free(sprefix);
+		}
+		/* keep the readdir() order of the output */
+		if (nres > 1)
+			qsort(res, nres, sizeof(struct wh_dirent *), cmp_dirents_pos);
+	}
+
+	for (i = 0; i < nres; i++) {
+		const char *name = res[i]->name;
+
+		if (i && res[i] == res[i - 1])
+			continue;
+		if (!filename_equal(pattern, name, ls->type))
 			continue;
 
 		if (uflag && *count == 0)
-			xasprintf(wait, "%s/%s", dir, dp->d_name);
+			xasprintf(wait, "%s/%s", ls->path, name);
 
 		else if (uflag && *count == 1 && *wait) {
-			printf("%s: %s %s/%s", pattern, *wait, dir,  dp->d_name);
+			printf("%s: %s %s/%s", pattern, *wait, ls->path, name);
 			free(*wait);
 			*wait = NULL;
 		} else
-			printf(" %s/%s", dir, dp->d_name);
+			printf(" %s/%s", ls->path, name);
 		++(*count);
 	}
-	closedir(dirp);
+	free(res);
 }
 
 static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
@@ -492,7 +620,7 @@ static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
 
 	for (; ls; ls = ls->next) {
 		if ((ls->type & want) && ls->path)
-			findin(ls->path, patbuf, &count, &wait, ls->type);
+			findin(ls, patbuf, &count, &wait);
 	}
 
 	free(wait);
@@ -20,6 +20,7 @@
  */
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -71,6 +72,7 @@ struct wipe_control {
 	struct wipe_desc *offsets;		/* -o <offset> -o <offset> ... */
 
 	size_t		ndevs;			/* number of devices to probe */
+	unsigned int	jobs;			/* max. number of devices wiped in parallel */
 
 	char		**reread;		/* devices to BLKRRPART */
 	size_t		nrereads;		/* size of reread */
@@ -85,6 +87,9 @@ struct wipe_control {
 };
 
 
+/* exit status of a --jobs child which postponed re-read of a partition table */
+#define WIPE_EXIT_REREAD	2
+
 /* column IDs */
 enum {
 	COL_UUID = 0,
@@ -446,11 +451,14 @@ static void free_wipe(struct wipe_desc *wp)
 static void do_wipe_real(struct wipe_control *ctl, blkid_probe pr,
 			struct wipe_desc *w)
 {
-	size_t i;
-
 	if (blkid_do_wipe(pr, ctl->noact) != 0)
 		err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
 		     ctl->devname, w->type, (intmax_t)w->offset);
+}
+
+static void print_wiped(struct wipe_control *ctl, struct wipe_desc *w)
+{
+	size_t i;
 
 	if (ctl->quiet)
 		return;
@@ -519,7 +527,7 @@ static int do_wipe(struct wipe_control *ctl)
 	int mode = O_RDWR, reread = 0, need_force = 0;
 	blkid_probe pr;
 	char *backup = NULL;
-	struct wipe_desc *w;
+	struct wipe_desc *w, *wiped = NULL, **wiped_last = &wiped;
 
 	if (!ctl->force)
 		mode |= O_EXCL;
@@ -534,6 +542,10 @@ static int do_wipe(struct wipe_control *ctl)
 		return -1;
 	}
 
+	/* probe only once, write all at the end */
+	if (!ctl->noact)
+		blkid_probe_set_wipe_flags(pr, BLKID_WIPE_BATCH | BLKID_WIPE_ZEROOUT);
+
 	if (ctl->backup) {
 		char *tmp = xstrdup(ctl->devname);
 
@@ -542,7 +554,6 @@ static int do_wipe(struct wipe_control *ctl)
 	}
 
 	while (blkid_do_probe(pr) == 0) {
-		int wiped = 0;
 		size_t len = 0;
 		loff_t offset = 0;
 		struct wipe_desc *wp;
@@ -565,9 +576,13 @@ static int do_wipe(struct wipe_control *ctl)
 		do_wipe_real(ctl, pr, wp);
 		if (wp->is_parttable)
 			reread = 1;
-		wiped = 1;
+
+		/* the messages are printed when the areas are really written */
+		*wiped_last = wp;
+		wiped_last = &wp->next;
+		continue;
 	done:
-		if (!wiped && len) {
+		if (len) {
 			/* if the offset has not been wiped (probably because
 			 * filtered out by -t or -o) we need to hide it for
 			 * libblkid to try another magic string for the same
@@ -590,10 +605,17 @@ static int do_wipe(struct wipe_control *ctl)
 	if (need_force)
 		warnx(_("Use the --force option to force erase."));
 
+	if (blkid_probe_flush_wipes(pr) != 0)
+		err(EXIT_FAILURE, _("%s: failed to erase signatures"), ctl->devname);
+
 	if (fsync(blkid_probe_get_fd(pr)) != 0)
 		err(EXIT_FAILURE, _("%s: cannot flush modified buffers"),
 				ctl->devname);
 
+	for (w = wiped; w; w = w->next)
+		print_wiped(ctl, w);
+	free_wipe(wiped);
+
 #ifdef BLKRRPART
 	if (reread && (mode & O_EXCL)) {
 		if (ctl->ndevs > 1) {
@@ -620,6 +642,74 @@ static int do_wipe(struct wipe_control *ctl)
 	return 0;
 }
 
+/*
+ * Wipes the devices in child processes, at most ctl->jobs at the same time.
+ * The children postpone re-read of partition tables (ctl->ndevs > 1) and
+ * report it by exit status, the caller calls BLKRRPART for all of them when
+ * all devices are wiped.
+ */
+static int wipe_devices_parallel(struct wipe_control *ctl, char **devs)
+{
+	pid_t *pids = xcalloc(ctl->ndevs, sizeof(pid_t));
+	char *reread = xcalloc(ctl->ndevs, sizeof(char));
+	size_t i, running = 0;
+	int rc = 0;
+
+	ctl->reread = xcalloc(ctl->ndevs, sizeof(char *));
+
+	/* don't duplicate buffered output in the children */
+	fflush(stdout);
+
+	for (i = 0; i < ctl->ndevs || running; ) {
+		int status;
+		pid_t pid;
+		size_t x;
+
+		if (i < ctl->ndevs && running < ctl->jobs) {
+			pid = fork();
+			if (pid < 0)
+				err(EXIT_FAILURE, _("fork failed"));
+			if (pid == 0) {
+				ctl->devname = devs[i];
+				if (do_wipe(ctl) != 0)
+					exit(EXIT_FAILURE);
+				exit(ctl->nrereads ? WIPE_EXIT_REREAD : EXIT_SUCCESS);
+			}
+			pids[i++] = pid;
+			running++;
+			continue;
+		}
+
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("waitpid failed"));
+		}
+		for (x = 0; x < i; x++) {
+			if (pids[x] == pid)
+				break;
+		}
+		if (x == i)
+			continue;
+		running--;
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == WIPE_EXIT_REREAD)
+			reread[x] = 1;
+		else if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			rc = -1;
+	}
+
+	/* keep the command line order */
+	for (i = 0; i < ctl->ndevs; i++) {
+		if (reread[i])
+			ctl->reread[ctl->nrereads++] = devs[i];
+	}
+
+	free(reread);
+	free(pids);
+	return rc;
+}
 
 static void __attribute__((__noreturn__))
 usage(void)
@@ -638,6 +728,7 @@ usage(void)
 	fputsln(_(" -f, --force          force erasure"), stdout);
 	fputsln(_(" -i, --noheadings     don't print headings"), stdout);
 	fputsln(_(" -J, --json           use JSON output format"), stdout);
+	fputsln(_(" -j, --jobs <num>     wipe up to <num> devices in parallel"), stdout);
 	fputsln(_(" -n, --no-act         do everything except the actual write() call"), stdout);
 	fputsln(_(" -o, --offset <num>   offset to erase, in bytes"), stdout);
 	fputsln(_(" -O, --output <list>  COLUMNS to display (see below)"), stdout);
@@ -665,7 +756,7 @@ int
 main(int argc, char **argv)
 {
 	struct wipe_control ctl = { .devname = NULL };
-	int c;
+	int c, rc = EXIT_SUCCESS;
 	size_t i;
 	char *outarg = NULL;
 	enum {
@@ -676,6 +767,7 @@ main(int argc, char **argv)
 	    { "backup",    optional_argument, NULL, 'b' },
 	    { "force",     no_argument,       NULL, 'f' },
 	    { "help",      no_argument,       NULL, 'h' },
+	    { "jobs",      required_argument, NULL, 'j' },
 	    { "lock",      optional_argument, NULL, OPT_LOCK },
 	    { "no-act",    no_argument,       NULL, 'n' },
 	    { "offset",    required_argument, NULL, 'o' },
@@ -700,7 +792,7 @@ main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "ab::fhiJnO:o:pqt:V", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "ab::fhiJj:nO:o:pqt:V", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -724,6 +816,11 @@ main(int argc, char **argv)
 		case 'J':
 			ctl.json = 1;
 			break;
+		case 'j':
+			ctl.jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!ctl.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
 		case 'i':
 			ctl.no_headings = 1;
 			break;
@@ -815,10 +912,15 @@ main(int argc, char **argv)
 		 */
 		ctl.ndevs = argc - optind;
 
-		while (optind < argc) {
-			ctl.devname = argv[optind++];
-			do_wipe(&ctl);
-			ctl.ndevs--;
+		if (ctl.jobs > 1 && ctl.ndevs > 1) {
+			if (wipe_devices_parallel(&ctl, argv + optind) != 0)
+				rc = EXIT_FAILURE;
+		} else {
+			while (optind < argc) {
+				ctl.devname = argv[optind++];
+				do_wipe(&ctl);
+				ctl.ndevs--;
+			}
 		}
 
 #ifdef BLKRRPART
@@ -837,5 +939,5 @@ main(int argc, char **argv)
 		free(ctl.reread);
 #endif
 	}
-	return EXIT_SUCCESS;
+	return rc;
 }
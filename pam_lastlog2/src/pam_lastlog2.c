@@ -121,6 +121,39 @@ _pam_parse_args (pam_handle_t *pamh,
 	return ctrl;
 }
 
+static void
+cleanup_context (pam_handle_t *pamh __attribute__((__unused__)),
+		 void *data, int error_status __attribute__((__unused__)))
+{
+	ll2_unref_context (data);
+}
+
+/* The context is kept in the PAM handle (one for each database), so the
+   database connection is shared by all calls until pam_end(). */
+static struct ll2_context *
+get_context (pam_handle_t *pamh)
+{
+	struct ll2_context *context = NULL;
+	const void *data = NULL;
+	char *name;
+
+	if (asprintf (&name, "pam_lastlog2:%s", lastlog2_path) < 0)
+		return NULL;
+
+	if (pam_get_data (pamh, name, &data) == PAM_SUCCESS && data)
+		context = (struct ll2_context *) data;
+	else {
+		context = ll2_new_context (lastlog2_path);
+		if (context && pam_set_data (pamh, name, context,
+					     cleanup_context) != PAM_SUCCESS) {
+			ll2_unref_context (context);
+			context = NULL;
+		}
+	}
+	free (name);
+	return context;
+}
+
 static int
 write_login_data (pam_handle_t *pamh, int ctrl, const char *user)
 {
@@ -188,7 +221,7 @@ write_login_data (pam_handle_t *pamh, int ctrl, const char *user)
 	if (time (&ll_time) < 0)
 		return PAM_SYSTEM_ERR;
 
-	struct ll2_context *context = ll2_new_context(lastlog2_path);
+	struct ll2_context *context = get_context (pamh);
 	if (ll2_write_entry (context, user, ll_time, tty, rhost,
 			     pam_service, &error) != 0) {
 		if (error) {
@@ -196,10 +229,8 @@ write_login_data (pam_handle_t *pamh, int ctrl, const char *user)
 			free (error);
 		} else
 			pam_syslog (pamh, LOG_ERR, "Unknown error writing to database %s", lastlog2_path);
-		ll2_unref_context(context);
 		return PAM_SYSTEM_ERR;
 	}
-	ll2_unref_context(context);
 
 	return PAM_SUCCESS;
 }
@@ -219,13 +250,12 @@ show_lastlogin (pam_handle_t *pamh, int ctrl, const char *user)
 	if (ctrl & LASTLOG2_QUIET)
 		return retval;
 
-	struct ll2_context *context = ll2_new_context(lastlog2_path);
+	struct ll2_context *context = get_context (pamh);
 	if (ll2_read_entry (context, user, &ll_time, &tty, &rhost,
 			    &service, &error) != 0) {
 		if (errno == ENOENT)
 		{
 			/* DB file not found --> it is OK */
-			ll2_unref_context(context);
 			free(error);
 			return PAM_SUCCESS;
 		}
@@ -234,10 +264,8 @@ show_lastlogin (pam_handle_t *pamh, int ctrl, const char *user)
 			free (error);
 		} else
 			pam_syslog (pamh, LOG_ERR, "Unknown error reading database %s", lastlog2_path);
-		ll2_unref_context(context);
 		return PAM_SYSTEM_ERR;
 	}
-	ll2_unref_context(context);
 
 	if (ll_time) {
 		struct tm *tm, tm_buf;
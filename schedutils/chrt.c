@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <errno.h>
+#include <regex.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -34,8 +35,12 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "procfs.h"
+#include "optutils.h"
 #include "sched_attr.h"
 
+#ifndef PF_KTHREAD
+# define PF_KTHREAD	0x00200000
+#endif
 
 /* control struct */
 struct chrt_ctl {
@@ -47,12 +52,27 @@ struct chrt_ctl {
 	uint64_t deadline;
 	uint64_t period;
 
+	const char *cgroup;			/* --cgroup selector */
+	regex_t comm;				/* --comm selector */
+
 	unsigned int all_tasks : 1,		/* all threads of the PID */
 		     reset_on_fork : 1,		/* SCHED_RESET_ON_FORK or SCHED_FLAG_RESET_ON_FORK */
 		     altered : 1,		/* sched_set**() used */
+		     has_comm : 1,		/* --comm selector */
+		     kthreads : 1,		/* --kthreads selector */
 		     verbose : 1;		/* verbose output */
 };
 
+/* scheduling attributes as read from kernel */
+struct chrt_attr {
+	int policy;
+	int priority;
+	int reset_on_fork;
+	uint64_t runtime;
+	uint64_t deadline;
+	uint64_t period;
+};
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -65,6 +85,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Get policy:\n"
 	" chrt [options] -p <pid>\n"), out);
+	fputs(USAGE_SEPARATOR, out);
+	fputs(_("Set or get policy of more tasks:\n"
+	" chrt [options] --comm <regex>|--kthreads|--cgroup <path> [<priority>]\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Policy options:\n"), out);
@@ -87,6 +110,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
 	fputs(_(" -m, --max            show min and max valid priorities\n"), out);
 	fputs(_(" -p, --pid            operate on existing given pid\n"), out);
+	fputs(_("     --comm <regex>   operate on all tasks with matching name\n"), out);
+	fputs(_("     --kthreads       operate on all kernel threads\n"), out);
+	fputs(_("     --cgroup <path>  operate on all tasks in the cgroup\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -127,17 +153,10 @@ static const char *get_policy_name(int policy)
 	return _("unknown");
 }
 
-static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
+/* returns 0 on success, or -1 and errno */
+static int get_sched_pid_attr(pid_t pid, struct chrt_attr *at)
 {
-	int policy = -1, reset_on_fork = 0, prio = 0;
-#ifdef SCHED_DEADLINE
-	uint64_t deadline = 0, runtime = 0, period = 0;
-#endif
-
-	/* don't display "pid 0" as that is confusing */
-	if (!pid)
-		pid = getpid();
-
+	memset(at, 0, sizeof(*at));
 	errno = 0;
 
 	/*
@@ -150,39 +169,51 @@ static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
 		if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
 			if (errno == ENOSYS)
 				goto fallback;
-			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
+			return -1;
 		}
 
-		policy = sa.sched_policy;
-		prio = sa.sched_priority;
-		reset_on_fork = sa.sched_flags & SCHED_FLAG_RESET_ON_FORK;
-		deadline = sa.sched_deadline;
-		runtime = sa.sched_runtime;
-		period = sa.sched_period;
+		at->policy = sa.sched_policy;
+		at->priority = sa.sched_priority;
+		at->reset_on_fork = sa.sched_flags & SCHED_FLAG_RESET_ON_FORK;
+		at->deadline = sa.sched_deadline;
+		at->runtime = sa.sched_runtime;
+		at->period = sa.sched_period;
+		return 0;
 	}
 
 	/*
 	 * Old way
 	 */
 fallback:
-	if (errno == ENOSYS)
 #endif
 	{
 		struct sched_param sp;
 
-		policy = sched_getscheduler(pid);
-		if (policy == -1)
-			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
-
+		at->policy = sched_getscheduler(pid);
+		if (at->policy == -1)
+			return -1;
 		if (sched_getparam(pid, &sp) != 0)
-			err(EXIT_FAILURE, _("failed to get pid %d's attributes"), pid);
-		else
-			prio = sp.sched_priority;
+			return -1;
+		at->priority = sp.sched_priority;
 # ifdef SCHED_RESET_ON_FORK
-		if (policy & SCHED_RESET_ON_FORK)
-			reset_on_fork = 1;
+		if (at->policy & SCHED_RESET_ON_FORK) {
+			at->reset_on_fork = 1;
+			at->policy &= ~SCHED_RESET_ON_FORK;
+		}
 # endif
 	}
+	return 0;
+}
+
+static void print_sched_pid_attr(struct chrt_ctl *ctl, pid_t pid,
+				 const struct chrt_attr *at)
+{
+	int policy = at->policy, reset_on_fork = at->reset_on_fork,
+	    prio = at->priority;
+#ifdef SCHED_DEADLINE
+	uint64_t deadline = at->deadline, runtime = at->runtime,
+		 period = at->period;
+#endif
 
 	if (ctl->altered)
 		printf(_("pid %d's new scheduling policy: %s"), pid, get_policy_name(policy));
@@ -210,6 +241,20 @@ fallback:
 #endif
 }
 
+static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
+{
+	struct chrt_attr at;
+
+	/* don't display "pid 0" as that is confusing */
+	if (!pid)
+		pid = getpid();
+
+	if (get_sched_pid_attr(pid, &at) != 0)
+		err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
+
+	print_sched_pid_attr(ctl, pid, &at);
+}
+
 
 static void show_sched_info(struct chrt_ctl *ctl)
 {
@@ -344,10 +389,106 @@ static void set_sched(struct chrt_ctl *ctl)
 	ctl->altered = 1;
 }
 
+static int filter_task(pid_t tid __attribute__((__unused__)),
+		       const char *comm, unsigned int flags, void *data)
+{
+	struct chrt_ctl *ctl = data;
+
+	if (ctl->kthreads && !(flags & PF_KTHREAD))
+		return 0;
+	if (ctl->has_comm && regexec(&ctl->comm, comm, 0, NULL, 0) != 0)
+		return 0;
+	return 1;
+}
+
+/* compares the wanted and the current attributes after sched_set*() */
+static int verify_sched_attr(struct chrt_ctl *ctl, const struct chrt_attr *at)
+{
+	if (at->policy != ctl->policy || at->priority != ctl->priority
+	    || !at->reset_on_fork != !ctl->reset_on_fork)
+		return -1;
+#ifdef SCHED_DEADLINE
+	if (ctl->policy == SCHED_DEADLINE
+	    && (at->runtime != ctl->runtime || at->deadline != ctl->deadline
+		|| at->period != ctl->period))
+		return -1;
+#endif
+	return 0;
+}
+
+/*
+ * Shows or sets the attributes for all tasks selected by --comm, --kthreads
+ * or --cgroup. The tasks are resolved once (one pass over /proc, or one read
+ * of cgroup.threads), and the new attributes are verified. The tasks which
+ * exited in the meantime are ignored.
+ */
+static int sched_tasks(struct chrt_ctl *ctl, int set)
+{
+	pid_t *tasks = NULL;
+	size_t i, ntasks = 0, nchanged = 0, nfailed = 0;
+	int rc;
+
+	if (ctl->cgroup) {
+		rc = ul_cgroup_get_tasks(ctl->cgroup, 1, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("failed to read tasks of %s"), ctl->cgroup);
+		}
+	} else {
+		rc = procfs_get_tasks(filter_task, ctl, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
+		}
+	}
+
+	ctl->altered = set;
+	for (i = 0; i < ntasks; i++) {
+		struct chrt_attr at;
+		pid_t tid = tasks[i];
+
+		if (set && set_sched_one(ctl, tid) == -1) {
+			if (errno == ESRCH)
+				continue;
+			warn(_("failed to set tid %d's policy"), tid);
+			nfailed++;
+			continue;
+		}
+		if (get_sched_pid_attr(tid, &at) != 0) {
+			if (errno == ESRCH)
+				continue;
+			warn(_("failed to get pid %d's policy"), tid);
+			nfailed++;
+			continue;
+		}
+		if (set && verify_sched_attr(ctl, &at) != 0) {
+			warnx(_("tid %d's policy does not match after change"), tid);
+			nfailed++;
+		} else if (set)
+			nchanged++;
+
+		if (!set || ctl->verbose)
+			print_sched_pid_attr(ctl, tid, &at);
+	}
+
+	if (set && ctl->verbose)
+		printf(P_("%zu task selected, %zu changed, %zu failed\n",
+			  "%zu tasks selected, %zu changed, %zu failed\n", ntasks),
+			ntasks, nchanged, nfailed);
+	free(tasks);
+	return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char **argv)
 {
 	struct chrt_ctl _ctl = { .pid = -1, .policy = SCHED_RR }, *ctl = &_ctl;
-	int c;
+	int c, bulk = 0;
+
+	enum {
+		OPT_COMM = CHAR_MAX + 1,
+		OPT_KTHREADS,
+		OPT_CGROUP
+	};
 
 	static const struct option longopts[] = {
 		{ "all-tasks",  no_argument, NULL, 'a' },
@@ -366,8 +507,23 @@ int main(int argc, char **argv)
 		{ "reset-on-fork",  no_argument,       NULL, 'R' },
 		{ "verbose",	no_argument, NULL, 'v' },
 		{ "version",	no_argument, NULL, 'V' },
+		{ "comm",	required_argument, NULL, OPT_COMM },
+		{ "kthreads",	no_argument,       NULL, OPT_KTHREADS },
+		{ "cgroup",	required_argument, NULL, OPT_CGROUP },
 		{ NULL,		no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', OPT_CGROUP },
+		{ 'a', OPT_COMM },
+		{ 'a', OPT_KTHREADS },
+		{ 'p', OPT_CGROUP },
+		{ 'p', OPT_COMM },
+		{ 'p', OPT_KTHREADS },
+		{ OPT_COMM, OPT_CGROUP },
+		{ OPT_KTHREADS, OPT_CGROUP },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -376,6 +532,8 @@ int main(int argc, char **argv)
 
 	while((c = getopt_long(argc, argv, "+abdD:fiphmoP:T:rRvV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -427,6 +585,26 @@ int main(int argc, char **argv)
 		case 'D':
 			ctl->deadline = strtou64_or_err(optarg, _("invalid deadline argument"));
 			break;
+		case OPT_COMM:
+			c = regcomp(&ctl->comm, optarg, REG_EXTENDED | REG_NOSUB);
+			if (c) {
+				char buf[BUFSIZ];
+
+				regerror(c, &ctl->comm, buf, sizeof(buf));
+				errx(EXIT_FAILURE, _("invalid regular expression: %s: %s"),
+				     optarg, buf);
+			}
+			ctl->has_comm = 1;
+			bulk = 1;
+			break;
+		case OPT_KTHREADS:
+			ctl->kthreads = 1;
+			bulk = 1;
+			break;
+		case OPT_CGROUP:
+			ctl->cgroup = optarg;
+			bulk = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -437,11 +615,16 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (((ctl->pid > -1) && argc - optind < 1) ||
-	    ((ctl->pid == -1) && argc - optind < 2)) {
+	if (bulk && argc - optind > 1)
+		errx(EXIT_FAILURE, _("options --comm, --kthreads and --cgroup cannot be used with a command"));
+	if (bulk && argc == optind)
+		return sched_tasks(ctl, 0);
+
+	if ((!bulk && (ctl->pid > -1) && argc - optind < 1) ||
+	    (!bulk && (ctl->pid == -1) && argc - optind < 2)) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
-}
+	}
 
 	if ((ctl->pid > -1) && (ctl->verbose || argc - optind == 1)) {
 		show_sched_info(ctl);
@@ -478,6 +661,9 @@ int main(int argc, char **argv)
 		errx(EXIT_FAILURE,
 		     _("unsupported priority value for the policy: %d: see --max for valid range"),
 		     ctl->priority);
+	if (bulk)
+		return sched_tasks(ctl, 1);
+
 	set_sched(ctl);
 
 	if (ctl->verbose)
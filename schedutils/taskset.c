@@ -26,34 +26,44 @@
 #include <sched.h>
 #include <stddef.h>
 #include <string.h>
+#include <signal.h>
 
 #include "cpuset.h"
 #include "nls.h"
 #include "strutils.h"
 #include "xalloc.h"
 #include "procfs.h"
+#include "path.h"
 #include "c.h"
 #include "closestream.h"
+#include "optutils.h"
 
 #ifndef PF_NO_SETAFFINITY
 # define PF_NO_SETAFFINITY 0x04000000
 #endif
 
+#define _PATH_SYS_SYSTEM	"/sys/devices/system"
+
 struct taskset {
 	pid_t		pid;		/* task PID */
 	cpu_set_t	*set;		/* task CPU mask */
 	size_t		setsize;
 	char		*buf;		/* buffer for conversion from mask to string */
 	size_t		buflen;
+	cpu_set_t	*wanted;	/* new mask & online CPUs (bulk mode) */
 	unsigned int	use_list:1,	/* use list rather than masks */
-			get_only:1;	/* print the mask, but not modify */
+			get_only:1,	/* print the mask, but not modify */
+			dry_run:1;	/* print tasks to be modified */
 };
 
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	fprintf(out,
-		_("Usage: %s [options] [mask | cpu-list] [pid|cmd [args...]]\n\n"),
+		_("Usage: %s [options] [mask | cpu-list] [pid|cmd [args...]]\n"),
+		program_invocation_short_name);
+	fprintf(out,
+		_("       %s [options] --cgroup <path>|--tree <pid> [mask | cpu-list]\n\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -65,6 +75,10 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -a, --all-tasks         operate on all the tasks (threads) for a given pid\n"
 		" -p, --pid               operate on existing given pid\n"
 		" -c, --cpu-list          display and specify cpus in list format\n"
+		" -N, --numa-nodes        specify a list of NUMA nodes rather than cpus\n"
+		"     --cgroup <path>     operate on all the tasks in the cgroup\n"
+		"     --tree <pid>        operate on all the tasks of pid and its descendants\n"
+		" -n, --dry-run           print the tasks to be modified, but do nothing\n"
 		));
 	fprintf(out, USAGE_HELP_OPTIONS(25));
 
@@ -117,6 +131,27 @@ static void __attribute__((__noreturn__)) err_affinity(pid_t pid, int set)
 }
 
 
+static int set_affinity(pid_t pid, size_t setsize, cpu_set_t *set)
+{
+	if (sched_setaffinity(pid, setsize, set) < 0) {
+		uintmax_t flags = 0;
+		struct path_cxt *pc = NULL;
+		int errsv = errno;
+
+		if (errno != EPERM && errno != ESRCH
+		    && (pc = ul_new_procfs_path(pid, NULL))
+		    && procfs_process_get_stat_nth(pc, 9, &flags) == 0
+		    && (flags & PF_NO_SETAFFINITY)) {
+			warnx(_("affinity cannot be set due to PF_NO_SETAFFINITY flag set"));
+			errsv = EINVAL;
+		}
+		ul_unref_path(pc);
+		errno = errsv;
+		return -1;
+	}
+	return 0;
+}
+
 static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 {
 	/* read the current mask */
@@ -126,26 +161,12 @@ static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 		print_affinity(ts, FALSE);
 	}
 
-	if (ts->get_only)
+	if (ts->get_only || ts->dry_run)
 		return;
 
 	/* set new mask */
-	if (sched_setaffinity(ts->pid, setsize, set) < 0) {
-		uintmax_t flags = 0;
-		struct path_cxt *pc;
-		int errsv = errno;
-
-		if (errno != EPERM
-		    && (pc = ul_new_procfs_path(ts->pid, NULL))
-		    && procfs_process_get_stat_nth(pc, 9, &flags) == 0
-		    && (flags & PF_NO_SETAFFINITY)) {
-			warnx(_("affinity cannot be set due to PF_NO_SETAFFINITY flag set"));
-			errno = EINVAL;
-		} else
-			errno = errsv;
-
+	if (set_affinity(ts->pid, setsize, set) < 0)
 		err_affinity(ts->pid, 1);
-	}
 
 	/* re-read the current mask */
 	if (ts->pid) {
@@ -155,23 +176,159 @@ static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 	}
 }
 
+/*
+ * Sets the affinity of the task @tid in --cgroup or --tree mode. The tasks
+ * that already have the wanted mask are not modified (and not printed),
+ * and the tasks that exited in the meantime are ignored.
+ *
+ * Returns: 0 on success, 1 on error.
+ */
+static int do_taskset_bulk(struct taskset *ts, pid_t tid,
+			   size_t setsize, cpu_set_t *set)
+{
+	ts->pid = tid;
+
+	if (sched_getaffinity(tid, ts->setsize, ts->set) < 0) {
+		if (errno == ESRCH)
+			return 0;
+		warn(_("failed to get pid %d's affinity"), tid);
+		return 1;
+	}
+	if (!ts->get_only && CPU_EQUAL_S(ts->setsize, ts->set, ts->wanted))
+		return 0;
+
+	print_affinity(ts, FALSE);
+	if (ts->get_only || ts->dry_run)
+		return 0;
+
+	if (set_affinity(tid, setsize, set) < 0) {
+		if (errno == ESRCH)
+			return 0;
+		warn(_("failed to set pid %d's affinity"), tid);
+		return 1;
+	}
+	if (sched_getaffinity(tid, ts->setsize, ts->set) == 0)
+		print_affinity(ts, TRUE);
+	return 0;
+}
+
+/*
+ * Calls do_taskset_bulk() for all threads in the cgroup (one read of
+ * cgroup.threads), or for all threads of the process tree (one pass over
+ * /proc for the processes, then /proc/<pid>/task for each process).
+ */
+static int taskset_tasks(struct taskset *ts, const char *cgroup, pid_t tree,
+			 size_t setsize, cpu_set_t *set)
+{
+	pid_t *tasks = NULL;
+	size_t i, ntasks = 0;
+	int rc, errs = 0;
+
+	if (cgroup) {
+		rc = ul_cgroup_get_tasks(cgroup, 1, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("failed to read tasks of %s"), cgroup);
+		}
+	} else {
+		if (kill(tree, 0) != 0 && errno == ESRCH)
+			errx(EXIT_FAILURE, _("process %d not found"), tree);
+		rc = procfs_get_descendants(tree, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("failed to read descendants of %d"), tree);
+		}
+	}
+
+	for (i = 0; i < ntasks; i++) {
+		struct path_cxt *pc;
+		DIR *sub = NULL;
+		pid_t tid;
+
+		if (cgroup) {
+			errs |= do_taskset_bulk(ts, tasks[i], setsize, set);
+			continue;
+		}
+		pc = ul_new_procfs_path(tasks[i], NULL);
+		while (pc && procfs_process_next_tid(pc, &sub, &tid) == 0)
+			errs |= do_taskset_bulk(ts, tid, setsize, set);
+		ul_unref_path(pc);
+	}
+
+	free(tasks);
+	return errs;
+}
+
+/*
+ * Converts the list of NUMA nodes to the mask of their CPUs.
+ */
+static int nodelist_parse(const char *str, cpu_set_t *set, size_t setsize,
+			  int ncpus)
+{
+	struct path_cxt *pc;
+	cpu_set_t *nodes;
+	size_t nodes_size, nbits, i;
+	int rc = 0;
+
+	nodes = cpuset_alloc(max(ncpus, 1024), &nodes_size, &nbits);
+	if (!nodes)
+		err(EXIT_FAILURE, _("cpuset_alloc failed"));
+	if (cpulist_parse(str, nodes, nodes_size, 1)) {
+		cpuset_free(nodes);
+		return -EINVAL;
+	}
+	pc = ul_new_path(_PATH_SYS_SYSTEM "/node");
+	if (!pc)
+		err(EXIT_FAILURE, _("failed to initialize sysfs handler"));
+
+	CPU_ZERO_S(setsize, set);
+	for (i = 0; rc == 0 && i < nbits; i++) {
+		cpu_set_t *cpus = NULL;
+
+		if (!CPU_ISSET_S(i, nodes_size, nodes))
+			continue;
+		rc = ul_path_readf_cpulist(pc, &cpus, ncpus, "node%zu/cpulist", i);
+		if (rc == 0)
+			CPU_OR_S(setsize, set, set, cpus);
+		cpuset_free(cpus);
+	}
+	ul_unref_path(pc);
+	cpuset_free(nodes);
+	return rc;
+}
+
 int main(int argc, char **argv)
 {
 	cpu_set_t *new_set;
-	pid_t pid = 0;
-	int c, all_tasks = 0;
-	int ncpus;
+	pid_t pid = 0, tree = 0;
+	const char *cgroup = NULL;
+	int c, all_tasks = 0, numa_nodes = 0;
+	int ncpus, rc = EXIT_SUCCESS;
 	size_t new_setsize, nbits;
 	struct taskset ts;
 
+	enum {
+		CGROUP_OPTION = CHAR_MAX + 1,
+		TREE_OPTION
+	};
 	static const struct option longopts[] = {
 		{ "all-tasks",	0, NULL, 'a' },
 		{ "pid",	0, NULL, 'p' },
 		{ "cpu-list",	0, NULL, 'c' },
+		{ "numa-nodes",	0, NULL, 'N' },
+		{ "cgroup",	1, NULL, CGROUP_OPTION },
+		{ "tree",	1, NULL, TREE_OPTION },
+		{ "dry-run",	0, NULL, 'n' },
 		{ "help",	0, NULL, 'h' },
 		{ "version",	0, NULL, 'V' },
 		{ NULL,		0, NULL,  0  }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', CGROUP_OPTION, TREE_OPTION },
+		{ 'p', CGROUP_OPTION, TREE_OPTION },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -180,7 +337,10 @@ int main(int argc, char **argv)
 
 	memset(&ts, 0, sizeof(ts));
 
-	while ((c = getopt_long(argc, argv, "+apchV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "+apcNnhV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			all_tasks = 1;
@@ -192,6 +352,20 @@ int main(int argc, char **argv)
 		case 'c':
 			ts.use_list = 1;
 			break;
+		case 'N':
+			numa_nodes = 1;
+			break;
+		case 'n':
+			ts.dry_run = 1;
+			break;
+		case CGROUP_OPTION:
+			cgroup = optarg;
+			break;
+		case TREE_OPTION:
+			tree = strtos32_or_err(optarg, _("invalid PID argument"));
+			if (tree <= 0)
+				errx(EXIT_FAILURE, _("invalid PID argument"));
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -202,7 +376,10 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if ((!pid && argc - optind < 2)
+	if ((cgroup || tree) && argc - optind > 1)
+		errx(EXIT_FAILURE, _("options --cgroup and --tree cannot be used with a command"));
+
+	if ((!pid && !cgroup && !tree && argc - optind < 2)
 	    || (pid && (argc - optind < 1 || argc - optind > 2))) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
@@ -234,10 +411,14 @@ int main(int argc, char **argv)
 	if (!new_set)
 		err(EXIT_FAILURE, _("cpuset_alloc failed"));
 
-	if (argc - optind == 1)
+	if ((pid && argc - optind == 1) || ((cgroup || tree) && argc == optind))
 		ts.get_only = 1;
 
-	else if (ts.use_list) {
+	else if (numa_nodes) {
+		if (nodelist_parse(argv[optind], new_set, new_setsize, ncpus))
+			errx(EXIT_FAILURE, _("failed to parse NUMA node list: %s"),
+			     argv[optind]);
+	} else if (ts.use_list) {
 		if (cpulist_parse(argv[optind], new_set, new_setsize, 0))
 			errx(EXIT_FAILURE, _("failed to parse CPU list: %s"),
 			     argv[optind]);
@@ -246,7 +427,26 @@ int main(int argc, char **argv)
 		     argv[optind]);
 	}
 
-	if (all_tasks && pid) {
+	if (cgroup || tree) {
+		struct path_cxt *pc = ul_new_path(_PATH_SYS_SYSTEM "/cpu");
+		cpu_set_t *online = NULL;
+
+		/* the kernel reports only the online CPUs in the mask */
+		ts.wanted = cpuset_alloc(ncpus, NULL, NULL);
+		if (!ts.wanted)
+			err(EXIT_FAILURE, _("cpuset_alloc failed"));
+		if (pc && !ts.get_only
+		    && ul_path_readf_cpulist(pc, &online, ncpus, "online") == 0)
+			CPU_AND_S(new_setsize, ts.wanted, new_set, online);
+		else
+			memcpy(ts.wanted, new_set, new_setsize);
+		cpuset_free(online);
+		ul_unref_path(pc);
+
+		if (taskset_tasks(&ts, cgroup, tree, new_setsize, new_set))
+			rc = EXIT_FAILURE;
+		cpuset_free(ts.wanted);
+	} else if (all_tasks && pid) {
 		DIR *sub = NULL;
 		struct path_cxt *pc = ul_new_procfs_path(pid, NULL);
 
@@ -263,11 +463,11 @@ int main(int argc, char **argv)
 	cpuset_free(ts.set);
 	cpuset_free(new_set);
 
-	if (!pid) {
+	if (!pid && !cgroup && !tree) {
 		argv += optind + 1;
 		execvp(argv[0], argv);
 		errexec(argv[0]);
 	}
 
-	return EXIT_SUCCESS;
+	return rc;
 }
@@ -20,11 +20,13 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <regex.h>
 #include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "closestream.h"
+#include "optutils.h"
 #include "path.h"
 #include "pathnames.h"
 #include "procfs.h"
@@ -33,16 +35,25 @@
 
 #define NOT_SET		0xdeadbeef
 
+#ifndef PF_KTHREAD
+# define PF_KTHREAD	0x00200000
+#endif
+
 struct uclampset {
 	unsigned int util_min;
 	unsigned int util_max;
 
 	pid_t pid;
+	const char *cgroup;			/* --cgroup selector */
+	regex_t comm;				/* --comm selector */
+
 	unsigned int	all_tasks:1,		/* all threads of the PID */
 			system:1,
 			util_min_set:1,		/* indicates -m option was passed */
 			util_max_set:1,		/* indicates -M option was passed */
 			reset_on_fork:1,
+			has_comm:1,		/* --comm selector */
+			kthreads:1,		/* --kthreads selector */
 			verbose:1;
 	char *cmd;
 };
@@ -54,7 +65,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 		_(" %1$s [options]\n"
-		  " %1$s [options] --pid <pid> | --system | <command> <arg>...\n"),
+		  " %1$s [options] --pid <pid> | --system | <command> <arg>...\n"
+		  " %1$s [options] --comm <regex> | --kthreads | --cgroup <path>\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -66,6 +78,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
 	fputs(_(" -p, --pid <pid>      operate on existing given pid\n"), out);
 	fputs(_(" -s, --system         operate on system\n"), out);
+	fputs(_("     --comm <regex>   operate on all tasks with matching name\n"), out);
+	fputs(_("     --kthreads       operate on all kernel threads\n"), out);
+	fputs(_("     --cgroup <path>  operate on all tasks in the cgroup\n"), out);
 	fputs(_(" -R, --reset-on-fork  set reset-on-fork flag\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
 
@@ -79,30 +94,36 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
-static void show_uclamp_pid_info(pid_t pid, char *cmd)
+static void print_uclamp_pid_attr(pid_t pid, char *cmd, const struct sched_attr *sa)
 {
-	struct sched_attr sa;
 	char *comm;
 
-	/* don't display "pid 0" as that is confusing */
-	if (!pid)
-		pid = getpid();
-
-	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
-		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
-
 	if (cmd)
 		comm = cmd;
 	else
 		comm = pid_get_cmdname(pid);
 
 	printf(_("%s (%d) util_clamp: min: %d max: %d\n"),
-	       comm ? : "unknown", pid, sa.sched_util_min, sa.sched_util_max);
+	       comm ? : "unknown", pid, sa->sched_util_min, sa->sched_util_max);
 
 	if (!cmd)
 		free(comm);
 }
 
+static void show_uclamp_pid_info(pid_t pid, char *cmd)
+{
+	struct sched_attr sa;
+
+	/* don't display "pid 0" as that is confusing */
+	if (!pid)
+		pid = getpid();
+
+	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
+		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
+
+	print_uclamp_pid_attr(pid, cmd, &sa);
+}
+
 static unsigned int read_uclamp_sysfs(char *filename)
 {
 	unsigned int val;
@@ -194,6 +215,84 @@ static void set_uclamp_pid(struct uclampset *ctl)
 	}
 }
 
+static int filter_task(pid_t tid __attribute__((__unused__)),
+		       const char *comm, unsigned int flags, void *data)
+{
+	struct uclampset *ctl = data;
+
+	if (ctl->kthreads && !(flags & PF_KTHREAD))
+		return 0;
+	if (ctl->has_comm && regexec(&ctl->comm, comm, 0, NULL, 0) != 0)
+		return 0;
+	return 1;
+}
+
+/*
+ * Shows or sets the uclamp values for all tasks selected by --comm,
+ * --kthreads or --cgroup. The tasks are resolved once (one pass over /proc,
+ * or one read of cgroup.threads), and the new values are verified. The
+ * tasks which exited in the meantime are ignored.
+ */
+static int uclamp_tasks(struct uclampset *ctl, int set)
+{
+	pid_t *tasks = NULL;
+	size_t i, ntasks = 0, nchanged = 0, nfailed = 0;
+	int rc;
+
+	if (ctl->cgroup) {
+		rc = ul_cgroup_get_tasks(ctl->cgroup, 1, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("failed to read tasks of %s"), ctl->cgroup);
+		}
+	} else {
+		rc = procfs_get_tasks(filter_task, ctl, &tasks, &ntasks);
+		if (rc) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
+		}
+	}
+
+	for (i = 0; i < ntasks; i++) {
+		struct sched_attr sa;
+		pid_t tid = tasks[i];
+
+		if (set && set_uclamp_one(ctl, tid) == -1) {
+			if (errno == ESRCH)
+				continue;
+			warn(_("failed to set tid %d's uclamp values"), tid);
+			nfailed++;
+			continue;
+		}
+		if (sched_getattr(tid, &sa, sizeof(sa), 0) != 0) {
+			if (errno == ESRCH)
+				continue;
+			warn(_("failed to get pid %d's uclamp values"), tid);
+			nfailed++;
+			continue;
+		}
+		/* -1 resets the value to the default, nothing to compare */
+		if (set && ((ctl->util_min_set && (int) ctl->util_min >= 0
+			     && sa.sched_util_min != ctl->util_min)
+			    || (ctl->util_max_set && (int) ctl->util_max >= 0
+			     && sa.sched_util_max != ctl->util_max))) {
+			warnx(_("tid %d's uclamp values do not match after change"), tid);
+			nfailed++;
+		} else if (set)
+			nchanged++;
+
+		if (!set || ctl->verbose)
+			print_uclamp_pid_attr(tid, NULL, &sa);
+	}
+
+	if (set && ctl->verbose)
+		printf(P_("%zu task selected, %zu changed, %zu failed\n",
+			  "%zu tasks selected, %zu changed, %zu failed\n", ntasks),
+			ntasks, nchanged, nfailed);
+	free(tasks);
+	return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static void set_uclamp_system(struct uclampset *ctl)
 {
 	if (!ctl->util_min_set)
@@ -220,8 +319,13 @@ int main(int argc, char **argv)
 		.cmd = NULL
 	};
 	struct uclampset *ctl = &_ctl;
-	int c;
+	int c, bulk = 0;
 
+	enum {
+		OPT_COMM = CHAR_MAX + 1,
+		OPT_KTHREADS,
+		OPT_CGROUP
+	};
 	static const struct option longopts[] = {
 		{ "all-tasks",		no_argument, NULL, 'a' },
 		{ "pid",		required_argument, NULL, 'p' },
@@ -230,8 +334,23 @@ int main(int argc, char **argv)
 		{ "help",		no_argument, NULL, 'h' },
 		{ "verbose",		no_argument, NULL, 'v' },
 		{ "version",		no_argument, NULL, 'V' },
+		{ "comm",		required_argument, NULL, OPT_COMM },
+		{ "kthreads",		no_argument, NULL, OPT_KTHREADS },
+		{ "cgroup",		required_argument, NULL, OPT_CGROUP },
 		{ NULL,			no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', OPT_CGROUP },
+		{ 'a', OPT_COMM },
+		{ 'a', OPT_KTHREADS },
+		{ 'p', 's', OPT_CGROUP },
+		{ 'p', 's', OPT_COMM },
+		{ 'p', 's', OPT_KTHREADS },
+		{ OPT_COMM, OPT_CGROUP },
+		{ OPT_KTHREADS, OPT_CGROUP },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -240,6 +359,8 @@ int main(int argc, char **argv)
 
 	while((c = getopt_long(argc, argv, "+asRp:hm:M:vV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -265,6 +386,26 @@ int main(int argc, char **argv)
 			ctl->util_max = strtos32_or_err(optarg, _("invalid util_max argument"));
 			ctl->util_max_set = 1;
 			break;
+		case OPT_COMM:
+			c = regcomp(&ctl->comm, optarg, REG_EXTENDED | REG_NOSUB);
+			if (c) {
+				char buf[BUFSIZ];
+
+				regerror(c, &ctl->comm, buf, sizeof(buf));
+				errx(EXIT_FAILURE, _("invalid regular expression: %s: %s"),
+				     optarg, buf);
+			}
+			ctl->has_comm = 1;
+			bulk = 1;
+			break;
+		case OPT_KTHREADS:
+			ctl->kthreads = 1;
+			bulk = 1;
+			break;
+		case OPT_CGROUP:
+			ctl->cgroup = optarg;
+			bulk = 1;
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 			/* fallthrough */
@@ -280,6 +421,12 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (bulk) {
+		if (argc > optind)
+			errx(EXIT_FAILURE, _("options --comm, --kthreads and --cgroup cannot be used with a command"));
+		return uclamp_tasks(ctl, ctl->util_min_set || ctl->util_max_set);
+	}
+
 	/* all_tasks implies --pid */
 	if (ctl->all_tasks && ctl->pid == -1) {
 		errno = EINVAL;
@@ -32,6 +32,7 @@
 #include <limits.h>
 #include <getopt.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -48,6 +49,8 @@
 #include "closestream.h"
 #include "monotonic.h"
 #include "exitcodes.h"
+#include "sysfs.h"
+#include "xalloc.h"
 
 #ifndef BLKDISCARD
 # define BLKDISCARD	_IO(0x12,119)
@@ -67,8 +70,53 @@ enum {
 	ACT_SECURE
 };
 
+/* the default step with --queue-depth if the device limit is unknown */
+#define DISCARD_DEFAULT_STEP	(1ULL << 30)
+
 static int quiet;
 
+/*
+ * The range is split to steps and the steps are issued by queue-depth
+ * threads, every thread takes the next step when its ioctl returns.
+ */
+struct discard_queue {
+	int fd;
+	int act;
+	uint64_t next;		/* offset of the next step */
+	uint64_t end;
+	uint64_t step;
+	uint64_t nreqs;		/* number of issued ioctls */
+	int errsv;		/* errno of the first failed ioctl */
+
+	pthread_mutex_t lock;
+};
+
+static const char *act_to_ioctlname(int act)
+{
+	switch (act) {
+	case ACT_ZEROOUT:
+		return "BLKZEROOUT";
+	case ACT_SECURE:
+		return "BLKSECDISCARD";
+	case ACT_DISCARD:
+	default:
+		return "BLKDISCARD";
+	}
+}
+
+static int do_discard(int fd, int act, uint64_t range[2])
+{
+	switch (act) {
+	case ACT_ZEROOUT:
+		return ioctl(fd, BLKZEROOUT, range);
+	case ACT_SECURE:
+		return ioctl(fd, BLKSECDISCARD, range);
+	case ACT_DISCARD:
+	default:
+		return ioctl(fd, BLKDISCARD, range);
+	}
+}
+
 static void print_stats(int act, char *path, uint64_t stats[])
 {
 	switch (act) {
@@ -103,6 +151,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --secure        perform secure discard\n"), out);
 	fputs(_(" -v, --verbose       print aligned length and offset\n"), out);
 	fputs(_(" -z, --zeroout       zero-fill rather than discard\n"), out);
+	fputs(_(" -Q, --queue-depth <num>\n"
+		"                     number of steps in flight at once\n"), out);
+	fputs(_("     --stats         print throughput when finished\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
@@ -162,14 +213,115 @@ static void __attribute__((__noreturn__)) err_on_ioctl(
 	err(exno, _("%s: %s ioctl failed"), ioctlname, path);
 }
 
+/*
+ * Returns the largest request the device accepts for @act, aligned to the
+ * discard granularity (returned in @granularity), or 0 if unknown. The queue
+ * attributes are provided for whole disks only.
+ */
+static uint64_t get_max_step(dev_t devno, int act, int secsize, uint64_t *granularity)
+{
+	struct path_cxt *pc, *disk_pc = NULL;
+	uint64_t max = 0, gran = 0;
+	dev_t disk = 0;
+
+	*granularity = secsize;
+	pc = ul_new_sysfs_path(devno, NULL, NULL);
+	if (!pc)
+		return 0;
+	if (sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0
+	    && disk && disk != devno) {
+		disk_pc = ul_new_sysfs_path(disk, NULL, NULL);
+		if (disk_pc)
+			sysfs_blkdev_set_parent(pc, disk_pc);
+	}
+
+	if (act == ACT_ZEROOUT)
+		ul_path_read_u64(pc, &max, "queue/write_zeroes_max_bytes");
+	else {
+		ul_path_read_u64(pc, &max, "queue/discard_max_bytes");
+		ul_path_read_u64(pc, &gran, "queue/discard_granularity");
+	}
+	ul_unref_path(pc);
+	ul_unref_path(disk_pc);
+
+	if (gran < (uint64_t) secsize)
+		gran = secsize;
+	if (max >= gran)
+		max -= max % gran;
+	*granularity = gran;
+	return max;
+}
+
+static void *discard_worker(void *data)
+{
+	struct discard_queue *q = data;
+
+	for (;;) {
+		uint64_t range[2];
+
+		pthread_mutex_lock(&q->lock);
+		if (q->errsv || q->next >= q->end) {
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		/* the steps are aligned to the step size, except the first one */
+		range[0] = q->next;
+		range[1] = q->step - (q->next % q->step);
+		if (range[1] > q->end - q->next)
+			range[1] = q->end - q->next;
+		q->next += range[1];
+		q->nreqs++;
+		pthread_mutex_unlock(&q->lock);
+
+		if (do_discard(q->fd, q->act, range) != 0) {
+			pthread_mutex_lock(&q->lock);
+			if (!q->errsv)
+				q->errsv = errno ? errno : EIO;
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* Returns 0 on success or errno of the first failed request. */
+static int discard_queued(struct discard_queue *q, unsigned int depth)
+{
+	pthread_t *threads = xcalloc(depth, sizeof(pthread_t));
+	unsigned int i, n;
+
+	pthread_mutex_init(&q->lock, NULL);
+
+	for (n = 0; n < depth; n++) {
+		if (pthread_create(&threads[n], NULL, discard_worker, q) != 0) {
+			warn(_("failed to create thread"));
+			break;
+		}
+	}
+	/* fallback, all in this thread */
+	if (n == 0)
+		discard_worker(q);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&q->lock);
+	free(threads);
+	return q->errsv;
+}
+
 int main(int argc, char **argv)
 {
 	char *path;
-	int c, fd, verbose = 0, secsize, force = 0;
-	uint64_t end, blksize, step, range[2], stats[2];
+	int c, fd, verbose = 0, secsize, force = 0, show_stats = 0;
+	uint64_t end, blksize, step, range[2], stats[2], nreqs = 0, start_offset;
+	unsigned int depth = 1;
 	struct stat sb;
-	struct timeval now = { 0 }, last = { 0 };
+	struct timeval now = { 0 }, last = { 0 }, start;
 	int act = ACT_DISCARD;
+	enum {
+		OPT_STATS = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 	    { "force",     no_argument,       NULL, 'f' },
@@ -182,6 +334,8 @@ int main(int argc, char **argv)
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "version",   no_argument,       NULL, 'V' },
 	    { "zeroout",   no_argument,       NULL, 'z' },
+	    { "queue-depth", required_argument, NULL, 'Q' },
+	    { "stats",     no_argument,       NULL, OPT_STATS },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -194,7 +348,7 @@ int main(int argc, char **argv)
 	range[1] = ULLONG_MAX;
 	step = 0;
 
-	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:qz", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:qQ:z", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'f':
 			force = 1;
@@ -223,6 +377,15 @@ int main(int argc, char **argv)
 		case 'z':
 			act = ACT_ZEROOUT;
 			break;
+		case 'Q':
+			depth = strtou32_or_err(optarg,
+					_("failed to parse queue depth"));
+			if (!depth)
+				errx(EXIT_FAILURE, _("queue depth must be greater than zero"));
+			break;
+		case OPT_STATS:
+			show_stats = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -269,6 +432,23 @@ int main(int argc, char **argv)
 	if (end < range[0] || end > blksize)
 		end = blksize;
 
+	/*
+	 * More requests in flight need more steps; split the range between the
+	 * threads, but not to steps the device would split again.
+	 */
+	if (depth > 1 && !step) {
+		uint64_t gran, max = get_max_step(sb.st_rdev, act, secsize, &gran);
+
+		step = (end - range[0] + depth - 1) / depth;
+		step = (step + gran - 1) / gran * gran;
+		if (max && step > max)
+			step = max;
+		if (!max && step > DISCARD_DEFAULT_STEP)
+			step = DISCARD_DEFAULT_STEP;
+		if (verbose)
+			printf(_("%s: using %" PRIu64 " bytes steps\n"), path, step);
+	}
+
 	range[1] = (step > 0) ? step : end - range[0];
 
 	/* check length alignment to the sector size */
@@ -302,31 +482,36 @@ int main(int argc, char **argv)
 	}
 #endif /* HAVE_LIBBLKID */
 
-	stats[0] = range[0], stats[1] = 0;
+	stats[0] = start_offset = range[0], stats[1] = 0;
 	gettime_monotonic(&last);
+	start = last;
+
+	if (depth > 1) {
+		struct discard_queue q = {
+			.fd = fd,
+			.act = act,
+			.next = range[0],
+			.end = end,
+			.step = range[1]
+		};
+
+		errno = discard_queued(&q, depth);
+		if (errno)
+			err_on_ioctl(act_to_ioctlname(act), path);
+		stats[1] = end - range[0];
+		nreqs = q.nreqs;
+	}
 
-	for (/* nothing */; range[0] < end; range[0] += range[1]) {
+	for (/* nothing */; depth == 1 && range[0] < end; range[0] += range[1]) {
 		if (range[0] + range[1] > end)
 			range[1] = end - range[0];
 
 		errno = 0;
-
-		switch (act) {
-		case ACT_ZEROOUT:
-			if (ioctl(fd, BLKZEROOUT, &range))
-				err_on_ioctl("BLKZEROOUT", path);
-			break;
-		case ACT_SECURE:
-			if (ioctl(fd, BLKSECDISCARD, &range))
-				err_on_ioctl("BLKSECDISCARD", path);
-			break;
-		case ACT_DISCARD:
-			if (ioctl(fd, BLKDISCARD, &range))
-				err_on_ioctl("BLKDISCARD", path);
-			break;
-		}
+		if (do_discard(fd, act, range))
+			err_on_ioctl(act_to_ioctlname(act), path);
 
 		stats[1] += range[1];
+		nreqs++;
 
 		/* reporting progress at most once per second */
 		if (verbose && step) {
@@ -343,6 +528,22 @@ int main(int argc, char **argv)
 	if (verbose && stats[1])
 		print_stats(act, path, stats);
 
+	if (show_stats) {
+		uint64_t bytes = end - start_offset;
+		double secs;
+		char *sz, *rate;
+
+		gettime_monotonic(&now);
+		secs = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0;
+		sz = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, bytes);
+		rate = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
+				secs > 0 ? (uint64_t) (bytes / secs) : bytes);
+		printf(_("%s: %s in %.3f s (%s/s), %" PRIu64 " requests, queue depth %u\n"),
+				path, sz, secs, rate, nreqs, depth);
+		free(sz);
+		free(rate);
+	}
+
 	close(fd);
 	return EXIT_SUCCESS;
 }
@@ -25,7 +25,10 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <linux/pr.h>
 
 #include "nls.h"
@@ -33,6 +36,8 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "xalloc.h"
+#include "sysfs.h"
+#include "monotonic.h"
 
 struct type_string {
 	int type;
@@ -151,66 +156,218 @@ PARSE(pr_type)
 PARSE(pr_command)
 PARSE(pr_flag)
 
-static int do_pr(char *path, uint64_t key, uint64_t oldkey, int op, int type, int flag)
+static const char *pr_command_to_str(int command)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(pr_command); i++) {
+		if (pr_command[i].type == command)
+			return pr_command[i].str;
+	}
+	return "unknown";
+}
+
+struct pr_op {
+	int command;
+	int type;
+	int flag;
+	uint64_t key;
+	uint64_t oldkey;
+};
+
+/*
+ * All paths to the same logical unit (the same WWID) are in one LUN. The paths
+ * run the operations in parallel, but the next operation starts only when the
+ * previous one is done on all the paths of the LUN.
+ */
+struct pr_lun {
+	char *id;			/* WWID or whole-disk maj:min */
+	size_t npaths;
+	int failed;			/* stop the rest of the operations */
+
+	pthread_mutex_t lock;
+	pthread_barrier_t barrier;
+};
+
+struct pr_result {
+	int ret;			/* ioctl() return code */
+	int errsv;			/* errno if ret < 0 */
+	uint64_t usec;			/* latency */
+	unsigned int done : 1;
+};
+
+struct pr_path {
+	const char *name;
+	int fd;
+	struct pr_lun *lun;
+	struct pr_result *results;	/* per operation */
+	const struct pr_op *ops;
+	size_t nops;
+
+	unsigned int primary : 1;	/* the first path of the LUN */
+};
+
+static int do_pr(int fd, const struct pr_op *op)
 {
 	struct pr_registration pr_reg;
 	struct pr_reservation pr_res;
 	struct pr_preempt pr_prt;
 	struct pr_clear pr_clr;
-	int fd, ret;
+	int ret;
 
-	fd = open(path, O_RDWR);
-	if (fd < 0)
-		err(EXIT_FAILURE, _("cannot open %s"), path);
-
-	switch (op) {
+	switch (op->command) {
 	case IOC_PR_REGISTER:
-		pr_reg.old_key = oldkey;
-		pr_reg.new_key = key;
-		pr_reg.flags = flag;
-		ret = ioctl(fd, op, &pr_reg);
+		pr_reg.old_key = op->oldkey;
+		pr_reg.new_key = op->key;
+		pr_reg.flags = op->flag;
+		ret = ioctl(fd, op->command, &pr_reg);
 		break;
 	case IOC_PR_RESERVE:
 	case IOC_PR_RELEASE:
-		pr_res.key = key;
-		pr_res.type = type;
-		pr_res.flags = flag;
-		ret = ioctl(fd, op, &pr_res);
+		pr_res.key = op->key;
+		pr_res.type = op->type;
+		pr_res.flags = op->flag;
+		ret = ioctl(fd, op->command, &pr_res);
 		break;
 	case IOC_PR_PREEMPT:
 	case IOC_PR_PREEMPT_ABORT:
-		pr_prt.old_key = oldkey;
-		pr_prt.new_key = key;
-		pr_prt.type = type;
-		pr_prt.flags = flag;
-		ret = ioctl(fd, op, &pr_prt);
+		pr_prt.old_key = op->oldkey;
+		pr_prt.new_key = op->key;
+		pr_prt.type = op->type;
+		pr_prt.flags = op->flag;
+		ret = ioctl(fd, op->command, &pr_prt);
 		break;
 	case IOC_PR_CLEAR:
-		pr_clr.key = key;
-		pr_clr.flags = flag;
-		ret = ioctl(fd, op, &pr_clr);
+		pr_clr.key = op->key;
+		pr_clr.flags = op->flag;
+		ret = ioctl(fd, op->command, &pr_clr);
 		break;
 	default:
 		errno = EINVAL;
-		err(EXIT_FAILURE, _("unknown command"));
+		ret = -1;
+		break;
 	}
 
-	close(fd);
-	if (ret < 0)
-		err(EXIT_FAILURE, _("pr ioctl failed"));
-	if (ret > 0)
-		errx(EXIT_FAILURE, _("error code 0x%x, for more detailed information see specification of device model."), ret);
-
 	return ret;
 }
 
+/*
+ * The registration is per I_T nexus, so it is done on every path. The other
+ * commands operate on the reservation of the logical unit and they are sent by
+ * the first path only.
+ */
+static void *run_path(void *data)
+{
+	struct pr_path *path = data;
+	struct pr_lun *lun = path->lun;
+	size_t i;
+
+	for (i = 0; i < path->nops; i++) {
+		const struct pr_op *op = &path->ops[i];
+		struct pr_result *res = &path->results[i];
+
+		if (path->primary || op->command == IOC_PR_REGISTER) {
+			struct timeval start, end;
+
+			gettime_monotonic(&start);
+			res->ret = do_pr(path->fd, op);
+			res->errsv = errno;
+			gettime_monotonic(&end);
+
+			res->usec = (end.tv_sec - start.tv_sec) * 1000000ULL
+				    + end.tv_usec - start.tv_usec;
+			res->done = 1;
+
+			if (res->ret != 0) {
+				pthread_mutex_lock(&lun->lock);
+				lun->failed = 1;
+				pthread_mutex_unlock(&lun->lock);
+			}
+		}
+
+		if (lun->npaths > 1)
+			pthread_barrier_wait(&lun->barrier);
+		if (lun->failed)
+			break;
+	}
+	return NULL;
+}
+
+static char *get_lun_id(int fd, const char *name)
+{
+	struct path_cxt *pc;
+	struct stat st;
+	dev_t disk = 0;
+	char *id = NULL;
+
+	if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode))
+		return xstrdup(name);
+
+	if (sysfs_devno_to_wholedisk(st.st_rdev, NULL, 0, &disk) != 0 || !disk)
+		disk = st.st_rdev;
+
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (pc && ul_path_read_string(pc, &id, "wwid") <= 0)
+		ul_path_read_string(pc, &id, "device/wwid");
+	ul_unref_path(pc);
+
+	if (!id)
+		xasprintf(&id, "%u:%u", major(disk), minor(disk));
+	return id;
+}
+
+static struct pr_lun *get_lun(struct pr_lun *luns, size_t *nluns, char *id)
+{
+	size_t i;
+
+	for (i = 0; i < *nluns; i++) {
+		if (strcmp(luns[i].id, id) == 0) {
+			free(id);
+			return &luns[i];
+		}
+	}
+	luns[*nluns].id = id;
+	return &luns[(*nluns)++];
+}
+
+static int report_results(struct pr_path *paths, size_t npaths,
+			  const struct pr_op *ops, size_t nops, int verbose)
+{
+	size_t i, k;
+	int rc = EXIT_SUCCESS;
+
+	for (i = 0; i < npaths; i++) {
+		for (k = 0; k < nops; k++) {
+			const struct pr_result *res = &paths[i].results[k];
+			const char *cmd = pr_command_to_str(ops[k].command);
+
+			if (!res->done)
+				continue;
+			if (res->ret < 0) {
+				errno = res->errsv;
+				warn(_("%s: %s failed"), paths[i].name, cmd);
+				rc = EXIT_FAILURE;
+			} else if (res->ret > 0) {
+				warnx(_("%s: %s failed: error code 0x%x"),
+					paths[i].name, cmd, res->ret);
+				rc = EXIT_FAILURE;
+			} else if (verbose)
+				printf(_("%s: %s: done in %ju.%03ju ms\n"),
+					paths[i].name, cmd,
+					(uintmax_t) res->usec / 1000,
+					(uintmax_t) res->usec % 1000);
+		}
+	}
+	return rc;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
-	      _(" %s [options] <device>\n"), program_invocation_short_name);
+	      _(" %s [options] <device>...\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Persistent reservations on a device.\n"), out);
@@ -221,6 +378,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -K, --oldkey <num>       old key to operate\n"), out);
 	fputs(_(" -f, --flag <flag>        command flag\n"), out);
 	fputs(_(" -t, --type <type>        command type\n"), out);
+	fputs(_(" -v, --verbose            print results and latencies\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(26));
@@ -242,10 +400,12 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char **argv)
 {
-	int c;
-	char *path;
-	uint64_t key = 0, oldkey = 0;
-	int command = -1, type = -1, flag = 0;
+	int c, verbose = 0, rc;
+	struct pr_op *ops, *op;
+	struct pr_path *paths;
+	struct pr_lun *luns;
+	pthread_t *threads;
+	size_t nops = 1, npaths, nluns = 0, i;
 
 	static const struct option longopts[] = {
 	    { "help",            no_argument,       NULL, 'h' },
@@ -255,6 +415,7 @@ int main(int argc, char **argv)
 	    { "oldkey",          required_argument, NULL, 'K' },
 	    { "flag",            required_argument, NULL, 'f' },
 	    { "type",            required_argument, NULL, 't' },
+	    { "verbose",         no_argument,       NULL, 'v' },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -263,32 +424,45 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
+	/* every --command after the first one starts a new operation, the
+	 * other options apply to the last operation */
+	ops = xcalloc(argc, sizeof(*ops));
+	op = &ops[0];
+	op->command = op->type = -1;
+
 	errno = EINVAL;
-	while ((c = getopt_long(argc, argv, "hVc:k:K:f:t:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hVc:k:K:f:t:v", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'k':
-			key = strtosize_or_err(optarg,
+			op->key = strtosize_or_err(optarg,
 					_("failed to parse key"));
 			break;
 		case 'K':
-			oldkey = strtosize_or_err(optarg,
+			op->oldkey = strtosize_or_err(optarg,
 					_("failed to parse old key"));
 			break;
 		case 'c':
-			command = parse_pr_command(optarg);
-			if (command < 0)
+			if (op->command >= 0) {
+				op = &ops[nops++];
+				op->command = op->type = -1;
+			}
+			op->command = parse_pr_command(optarg);
+			if (op->command < 0)
 				err(EXIT_FAILURE, _("unknown command"));
 			break;
 		case 't':
-			type = parse_pr_type(optarg);
-			if (type < 0)
+			op->type = parse_pr_type(optarg);
+			if (op->type < 0)
 				err(EXIT_FAILURE, _("unknown type"));
 			break;
 		case 'f':
-			flag = parse_pr_flag(optarg);
-			if (flag < 0)
+			op->flag = parse_pr_flag(optarg);
+			if (op->flag < 0)
 				err(EXIT_FAILURE, _("unknown flag"));
 			break;
+		case 'v':
+			verbose = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -302,13 +476,78 @@ int main(int argc, char **argv)
 	if (optind == argc)
 		errx(EXIT_FAILURE, _("no device specified"));
 
-	path = argv[optind++];
-	if (optind != argc) {
-		warnx(_("unexpected number of arguments"));
-		errtryhelp(EXIT_FAILURE);
+	for (i = 0; i < nops; i++) {
+		if (ops[i].command < 0) {
+			errno = EINVAL;
+			err(EXIT_FAILURE, _("unknown command"));
+		}
+	}
+
+	/* open all the devices before the first command */
+	npaths = argc - optind;
+	paths = xcalloc(npaths, sizeof(*paths));
+	luns = xcalloc(npaths, sizeof(*luns));
+
+	for (i = 0; i < npaths; i++) {
+		struct pr_path *path = &paths[i];
+
+		path->name = argv[optind + i];
+		path->fd = open(path->name, O_RDWR);
+		if (path->fd < 0)
+			err(EXIT_FAILURE, _("cannot open %s"), path->name);
+
+		path->lun = get_lun(luns, &nluns, get_lun_id(path->fd, path->name));
+		path->primary = path->lun->npaths++ == 0;
+		path->ops = ops;
+		path->nops = nops;
+		path->results = xcalloc(nops, sizeof(struct pr_result));
+	}
+
+	if (npaths == 1 && nops == 1) {
+		run_path(&paths[0]);
+		close(paths[0].fd);
+
+		/* keep the original messages for the simple case */
+		if (paths[0].results[0].ret < 0) {
+			errno = paths[0].results[0].errsv;
+			err(EXIT_FAILURE, _("pr ioctl failed"));
+		}
+		if (paths[0].results[0].ret > 0)
+			errx(EXIT_FAILURE, _("error code 0x%x, for more detailed information see specification of device model."),
+					paths[0].results[0].ret);
+		return report_results(paths, npaths, ops, nops, verbose);
 	}
 
-	do_pr(path, key, oldkey, command, type, flag);
+	for (i = 0; i < nluns; i++) {
+		pthread_mutex_init(&luns[i].lock, NULL);
+		pthread_barrier_init(&luns[i].barrier, NULL, luns[i].npaths);
+	}
 
-	return EXIT_SUCCESS;
+	/* all the paths of a LUN have to run at the same time because of the
+	 * barrier, so the threads are not limited */
+	threads = xcalloc(npaths, sizeof(pthread_t));
+	for (i = 0; i < npaths; i++) {
+		if (pthread_create(&threads[i], NULL, run_path, &paths[i]) != 0)
+			err(EXIT_FAILURE, _("failed to create thread"));
+	}
+	for (i = 0; i < npaths; i++) {
+		pthread_join(threads[i], NULL);
+		close(paths[i].fd);
+	}
+
+	rc = report_results(paths, npaths, ops, nops, verbose);
+
+	for (i = 0; i < nluns; i++) {
+		pthread_barrier_destroy(&luns[i].barrier);
+		pthread_mutex_destroy(&luns[i].lock);
+		free(luns[i].id);
+	}
+	for (i = 0; i < npaths; i++)
+		free(paths[i].results);
+	free(threads);
+	free(paths);
+	free(luns);
+	free(ops);
+
+	return rc;
 }
@@ -29,6 +29,7 @@
 #include <limits.h>
 #include <getopt.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -81,8 +82,10 @@ struct blkzone_control {
 	uint64_t offset;
 	uint64_t length;
 	uint32_t count;
+	unsigned int jobs;	/* --jobs, number of threads for zone actions */
 
 	unsigned int force : 1;
+	unsigned int summary : 1;
 	unsigned int verbose : 1;
 };
 
@@ -206,6 +209,7 @@ done:
  * blkzone report
  */
 #define DEF_REPORT_LEN		(1U << 12) /* 4k zones per report (256k kzalloc) */
+#define MAX_REPORT_LEN		(1U << 17) /* 128k zones per report (8M) */
 
 static const char *type_text[] = {
 	"RESERVED",
@@ -226,13 +230,95 @@ static const char *condition_str[] = {
 	"of"  /* Offline */
 };
 
+static const char *condition_desc[] = {
+	N_("not write pointer"),
+	N_("empty"),
+	N_("implicitly opened"),
+	N_("explicitly opened"),
+	N_("closed"),
+	NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	N_("read only"),
+	N_("full"),
+	N_("offline")
+};
+
+/* write pointer fill: empty, 1-10%, ..., 91-99%, full */
+#define FILL_BUCKETS	12
+
+struct zone_summary {
+	uint64_t nzones;
+	uint64_t conds[ARRAY_SIZE(condition_str)];
+	uint64_t types[ARRAY_SIZE(type_text)];
+	uint64_t fill[FILL_BUCKETS];
+};
+
+static void summary_add_zone(struct zone_summary *sum, const struct blk_zone *z,
+			     uint64_t cap)
+{
+	sum->nzones++;
+	sum->conds[z->cond & (ARRAY_SIZE(condition_str) - 1)]++;
+	if (z->type < ARRAY_SIZE(type_text))
+		sum->types[z->type]++;
+
+	/* conventional zones have no write pointer */
+	if (z->type != BLK_ZONE_TYPE_CONVENTIONAL && cap) {
+		uint64_t used = z->wp - z->start;
+		size_t idx;
+
+		if (used == 0)
+			idx = 0;
+		else if (used >= cap)
+			idx = FILL_BUCKETS - 1;
+		else
+			idx = 1 + min((size_t) ((used * 10 - 1) / cap), (size_t) 9);
+		sum->fill[idx]++;
+	}
+}
+
+static void print_summary(struct zone_summary *sum)
+{
+	size_t i;
+
+	printf(_("Zones: %" PRIu64 "\n"), sum->nzones);
+
+	fputs(_("Types:\n"), stdout);
+	for (i = 0; i < ARRAY_SIZE(type_text); i++) {
+		if (sum->types[i])
+			printf("  %-20s %12" PRIu64 "\n", type_text[i], sum->types[i]);
+	}
+
+	fputs(_("Conditions:\n"), stdout);
+	for (i = 0; i < ARRAY_SIZE(condition_str); i++) {
+		if (!sum->conds[i])
+			continue;
+		printf("  %s %-17s %12" PRIu64 "\n", condition_str[i],
+			condition_desc[i] ? _(condition_desc[i]) : "",
+			sum->conds[i]);
+	}
+
+	fputs(_("Write pointer fill:\n"), stdout);
+	for (i = 0; i < FILL_BUCKETS; i++) {
+		char range[16];
+
+		if (i == 0)
+			snprintf(range, sizeof(range), "0%%");
+		else if (i == FILL_BUCKETS - 1)
+			snprintf(range, sizeof(range), "100%%");
+		else
+			snprintf(range, sizeof(range), "%zu-%zu%%",
+				(i - 1) * 10 + 1, i == FILL_BUCKETS - 2 ? 99 : i * 10);
+		printf("  %-20s %12" PRIu64 "\n", range, sum->fill[i]);
+	}
+}
+
 static int blkzone_report(struct blkzone_control *ctl)
 {
 	bool only_capacity_sum = !strcmp(ctl->command->name, "capacity");
 	uint64_t capacity_sum = 0;
+	struct zone_summary sum = { 0 };
 	struct blk_zone_report *zi;
 	unsigned long zonesize;
-	uint32_t i, nr_zones;
+	uint32_t i, nr_zones, report_len;
 	int fd;
 
 	fd = init_device(ctl, O_RDONLY);
@@ -252,12 +338,14 @@ static int blkzone_report(struct blkzone_control *ctl)
 	else
 		nr_zones = 1 + (ctl->total_sectors - ctl->offset) / zonesize;
 
+	/* get all the zones by as few ioctls as possible */
+	report_len = max(min(nr_zones, MAX_REPORT_LEN), DEF_REPORT_LEN);
 	zi = xmalloc(sizeof(struct blk_zone_report) +
-		     (DEF_REPORT_LEN * sizeof(struct blk_zone)));
+		     ((size_t) report_len * sizeof(struct blk_zone)));
 
 	while (nr_zones && ctl->offset < ctl->total_sectors) {
 
-		zi->nr_zones = min(nr_zones, DEF_REPORT_LEN);
+		zi->nr_zones = min(nr_zones, report_len);
 		zi->sector = ctl->offset;
 
 		if (ioctl(fd, BLKREPORTZONE, zi) == -1)
@@ -291,6 +379,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 			if (only_capacity_sum) {
 				capacity_sum += cap;
+			} else if (ctl->summary) {
+				summary_add_zone(&sum, &entry, cap);
 			} else if (has_zone_capacity(zi)) {
 				printf(_("  start: 0x%09"PRIx64", len 0x%06"PRIx64
 					", cap 0x%06"PRIx64", wptr 0x%06"PRIx64
@@ -317,6 +407,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 	if (only_capacity_sum)
 		printf(_("0x%09"PRIx64"\n"), capacity_sum);
+	else if (ctl->summary)
+		print_summary(&sum);
 
 	free(zi);
 	close(fd);
@@ -324,6 +416,87 @@ static int blkzone_report(struct blkzone_control *ctl)
 	return 0;
 }
 
+/*
+ * The range is split to steps of whole zones and the steps are issued by
+ * ctl->jobs threads, every thread takes the next step when its ioctl returns.
+ */
+struct zone_queue {
+	int fd;
+	unsigned long ioctl_cmd;
+	uint64_t next;		/* sector of the next step */
+	uint64_t end;
+	uint64_t step;		/* in sectors */
+	int errsv;		/* errno of the first failed ioctl */
+
+	pthread_mutex_t lock;
+};
+
+static void *zone_worker(void *data)
+{
+	struct zone_queue *q = data;
+
+	for (;;) {
+		struct blk_zone_range za;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->errsv || q->next >= q->end) {
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		za.sector = q->next;
+		za.nr_sectors = min(q->step, q->end - q->next);
+		q->next += za.nr_sectors;
+		pthread_mutex_unlock(&q->lock);
+
+		if (ioctl(q->fd, q->ioctl_cmd, &za) == -1) {
+			pthread_mutex_lock(&q->lock);
+			if (!q->errsv)
+				q->errsv = errno ? errno : EIO;
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* Returns 0 on success, or -1 and errno of the first failed request. */
+static int zone_action_parallel(struct blkzone_control *ctl, int fd,
+				struct blk_zone_range *za, unsigned long zonesize)
+{
+	struct zone_queue q = {
+		.fd = fd,
+		.ioctl_cmd = ctl->command->ioctl_cmd,
+		.next = za->sector,
+		.end = za->sector + za->nr_sectors
+	};
+	uint64_t nzones = (za->nr_sectors + zonesize - 1) / zonesize;
+	pthread_t *threads = xcalloc(ctl->jobs, sizeof(pthread_t));
+	unsigned int i, n;
+
+	/* a few steps for every thread, so that a slow range does not hold the rest */
+	q.step = max((nzones + ctl->jobs * 4 - 1) / (ctl->jobs * 4), (uint64_t) 1) * zonesize;
+	pthread_mutex_init(&q.lock, NULL);
+
+	for (n = 0; n < ctl->jobs; n++) {
+		if (pthread_create(&threads[n], NULL, zone_worker, &q) != 0) {
+			warn(_("failed to create thread"));
+			break;
+		}
+	}
+	/* fallback, all in this thread */
+	if (n == 0)
+		zone_worker(&q);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&q.lock);
+	free(threads);
+
+	errno = q.errsv;
+	return q.errsv ? -1 : 0;
+}
+
 /*
  * blkzone reset, open, close, and finish.
  */
@@ -332,7 +505,7 @@ static int blkzone_action(struct blkzone_control *ctl)
 	struct blk_zone_range za = { .sector = 0 };
 	unsigned long zonesize;
 	uint64_t zlen;
-	int fd;
+	int fd, rc;
 
 	zonesize = blkdev_chunk_sectors(ctl->devname);
 	if (!zonesize)
@@ -367,7 +540,18 @@ static int blkzone_action(struct blkzone_control *ctl)
 	za.sector = ctl->offset;
 	za.nr_sectors = zlen;
 
-	if (ioctl(fd, ctl->command->ioctl_cmd, &za) == -1)
+	/*
+	 * The kernel resets all the device by one command, that's faster
+	 * than any number of threads.
+	 */
+	if (ctl->jobs > 1 &&
+	    !(ctl->command->ioctl_cmd == BLKRESETZONE &&
+	      za.sector == 0 && za.nr_sectors == ctl->total_sectors))
+		rc = zone_action_parallel(ctl, fd, &za, zonesize);
+	else
+		rc = ioctl(fd, ctl->command->ioctl_cmd, &za);
+
+	if (rc == -1)
 		err(EXIT_FAILURE, _("%s: %s ioctl failed"),
 		    ctl->devname, ctl->command->ioctl_name);
 	else if (ctl->verbose)
@@ -400,6 +584,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --length <sectors> maximum sectors to act (in 512-byte sectors)\n"), out);
 	fputs(_(" -c, --count <number>   maximum number of zones\n"), out);
 	fputs(_(" -f, --force            enforce on block devices used by the system\n"), out);
+	fputs(_(" -j, --jobs <number>    act on ranges of zones by more threads\n"), out);
+	fputs(_(" -s, --summary          report counts of zones rather than every zone\n"), out);
 	fputs(_(" -v, --verbose          display more details\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(24));
@@ -415,7 +601,8 @@ int main(int argc, char **argv)
 {
 	int c;
 	struct blkzone_control ctl = {
-		.devname = NULL
+		.devname = NULL,
+		.jobs = 1
 	};
 
 	static const struct option longopts[] = {
@@ -424,6 +611,8 @@ int main(int argc, char **argv)
 	    { "length",  required_argument, NULL, 'l' }, /* max of sectors to operate on */
 	    { "offset",  required_argument, NULL, 'o' }, /* starting LBA */
 	    { "force",   no_argument,       NULL, 'f' },
+	    { "jobs",    required_argument, NULL, 'j' },
+	    { "summary", no_argument,       NULL, 's' },
 	    { "verbose", no_argument,       NULL, 'v' },
 	    { "version", no_argument,       NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
@@ -448,7 +637,7 @@ int main(int argc, char **argv)
 		argc--;
 	}
 
-	while ((c = getopt_long(argc, argv, "hc:l:o:fvV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hc:j:l:o:fsvV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -468,6 +657,15 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.force = 1;
 			break;
+		case 'j':
+			ctl.jobs = strtou32_or_err(optarg,
+					_("failed to parse number of jobs"));
+			if (!ctl.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
+		case 's':
+			ctl.summary = 1;
+			break;
 		case 'v':
 			ctl.verbose = 1;
 			break;
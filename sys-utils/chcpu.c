@@ -32,6 +32,8 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <inttypes.h>
 
 #include "cpuset.h"
 #include "nls.h"
@@ -42,6 +44,7 @@
 #include "path.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 #define EXCL_ERROR "--{configure,deconfigure,disable,dispatch,enable}"
 
@@ -52,6 +55,7 @@
 
 static cpu_set_t *onlinecpus;
 static int maxcpus;
+static int verbose;
 
 #define is_cpu_online(cpu) (CPU_ISSET_S((cpu), CPU_ALLOC_SIZE(maxcpus), onlinecpus))
 #define num_online_cpus()  (CPU_COUNT_S(CPU_ALLOC_SIZE(maxcpus), onlinecpus))
@@ -64,8 +68,64 @@ enum {
 	CMD_CPU_RESCAN,
 	CMD_CPU_DISPATCH_HORIZONTAL,
 	CMD_CPU_DISPATCH_VERTICAL,
+	CMD_CPU_SMT,
 };
 
+/* returns microseconds elapsed since @start */
+static uint64_t elapsed_usec(const struct timeval *start)
+{
+	struct timeval now, diff;
+
+	gettime_monotonic(&now);
+	timersub(&now, start, &diff);
+	return (uint64_t) diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+/* returns name of the CPU hotplug @state from hotplug/states */
+static char *hotplug_state_name(struct path_cxt *sys, int state)
+{
+	char buf[BUFSIZ], *name = NULL;
+	FILE *f;
+
+	f = ul_path_fopen(sys, "r" UL_CLOEXECSTR, "hotplug/states");
+	if (!f)
+		return NULL;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		char *end = NULL;
+		long n;
+
+		errno = 0;
+		n = strtol(buf, &end, 10);
+		if (errno || end == buf || *end != ':' || n != state)
+			continue;
+		end = (char *) skip_space(end + 1);
+		rtrim_whitespace((unsigned char *) end);
+		name = xstrdup(end);
+		break;
+	}
+	fclose(f);
+	return name;
+}
+
+/*
+ * Reports the hotplug state of the CPU after failed online/offline, the
+ * kernel rolls back to the last state which the CPU successfully reached.
+ */
+static void hotplug_state_report(struct path_cxt *sys, int cpu)
+{
+	char *name;
+	int state;
+
+	if (ul_path_readf_s32(sys, &state, "cpu%d/hotplug/state", cpu) != 0)
+		return;
+
+	name = hotplug_state_name(sys, state);
+	warnx(_("CPU %u is in hotplug state %d (%s)"), cpu, state,
+			name ? name : _("unknown"));
+	free(name);
+}
+
 /* returns:   0 = success
  *          < 0 = failure
  *          > 0 = partial success
@@ -75,7 +135,9 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 	int cpu;
 	int online, rc;
 	int configured = -1;
-	int fails = 0;
+	int fails = 0, changed = 0;
+	uint64_t usec, total = 0;
+	struct timeval start;
 
 	for (cpu = 0; cpu < maxcpus; cpu++) {
 		if (!CPU_ISSET_S(cpu, setsize, cpu_set))
@@ -103,33 +165,57 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 		if (ul_path_accessf(sys, F_OK, "cpu%d/configure", cpu) == 0)
 			ul_path_readf_s32(sys, &configured, "cpu%d/configure", cpu);
 		if (enable) {
+			gettime_monotonic(&start);
 			rc = ul_path_writef_string(sys, "1", "cpu%d/online", cpu);
+			usec = elapsed_usec(&start);
+			total += usec;
+
 			if (rc != 0 && configured == 0) {
 				warn(_("CPU %u enable failed (CPU is deconfigured)"), cpu);
 				fails++;
 			} else if (rc != 0) {
 				warn(_("CPU %u enable failed"), cpu);
+				hotplug_state_report(sys, cpu);
 				fails++;
-			} else
-				printf(_("CPU %u enabled\n"), cpu);
+			} else {
+				if (verbose)
+					printf(_("CPU %u enabled in %.3f ms\n"), cpu, usec / 1000.0);
+				else
+					printf(_("CPU %u enabled\n"), cpu);
+				changed++;
+			}
 		} else {
 			if (onlinecpus && num_online_cpus() == 1) {
 				warnx(_("CPU %u disable failed (last enabled CPU)"), cpu);
 				fails++;
 				continue;
 			}
+			gettime_monotonic(&start);
 			rc = ul_path_writef_string(sys, "0", "cpu%d/online", cpu);
+			usec = elapsed_usec(&start);
+			total += usec;
+
 			if (rc != 0) {
 				warn(_("CPU %u disable failed"), cpu);
+				hotplug_state_report(sys, cpu);
 				fails++;
 			} else {
-				printf(_("CPU %u disabled\n"), cpu);
+				if (verbose)
+					printf(_("CPU %u disabled in %.3f ms\n"), cpu, usec / 1000.0);
+				else
+					printf(_("CPU %u disabled\n"), cpu);
+				changed++;
 				if (onlinecpus)
 					CPU_CLR_S(cpu, setsize, onlinecpus);
 			}
 		}
 	}
 
+	if (verbose)
+		printf(P_("%d CPU changed, %d failed, hotplug took %.3f ms\n",
+			  "%d CPUs changed, %d failed, hotplug took %.3f ms\n", changed),
+			changed, fails, total / 1000.0);
+
 	return fails == 0 ? 0 : fails == maxcpus ? -1 : 1;
 }
 
@@ -145,6 +231,30 @@ static int cpu_rescan(struct path_cxt *sys)
 	return 0;
 }
 
+/*
+ * The kernel changes all the SMT siblings in one request, which is faster
+ * than offline/online of the sibling CPUs one by one.
+ */
+static int cpu_set_smt(struct path_cxt *sys, int enable)
+{
+	struct timeval start;
+	uint64_t usec;
+
+	if (ul_path_access(sys, F_OK, "smt/control") != 0)
+		errx(EXIT_FAILURE, _("This system does not support SMT control"));
+
+	gettime_monotonic(&start);
+	if (ul_path_write_string(sys, enable ? "on" : "off", "smt/control") != 0)
+		err(EXIT_FAILURE, enable ? _("Failed to enable SMT") :
+					   _("Failed to disable SMT"));
+	usec = elapsed_usec(&start);
+
+	printf(enable ? _("SMT enabled\n") : _("SMT disabled\n"));
+	if (verbose)
+		printf(_("SMT control took %.3f ms\n"), usec / 1000.0);
+	return 0;
+}
+
 static int cpu_set_dispatch(struct path_cxt *sys, int mode)
 {
 	if (ul_path_access(sys, F_OK, "dispatching") != 0)
@@ -252,6 +362,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -g, --deconfigure <cpu-list>  deconfigure cpus\n"
 		" -p, --dispatch <mode>         set dispatching mode\n"
 		" -r, --rescan                  trigger rescan of cpus\n"
+		"     --smt <on|off>            enable or disable all SMT siblings\n"
+		" -v, --verbose                 report time spent in CPU hotplug\n"
 		), stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(31));
 
@@ -264,9 +376,12 @@ int main(int argc, char *argv[])
 	struct path_cxt *sys = NULL;	/* _PATH_SYS_CPU handler */
 	cpu_set_t *cpu_set = NULL;
 	size_t setsize;
-	int cmd = -1;
+	int cmd = -1, smt = 0;
 	int c, rc;
 
+	enum {
+		OPT_SMT = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{ "configure",	required_argument, NULL, 'c' },
 		{ "deconfigure",required_argument, NULL, 'g' },
@@ -275,12 +390,14 @@ int main(int argc, char *argv[])
 		{ "enable",	required_argument, NULL, 'e' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "rescan",	no_argument,       NULL, 'r' },
+		{ "smt",	required_argument, NULL, OPT_SMT },
+		{ "verbose",	no_argument,       NULL, 'v' },
 		{ "version",	no_argument,       NULL, 'V' },
 		{ NULL,		0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'c','d','e','g','p' },
+		{ 'c','d','e','g','p', OPT_SMT },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -308,7 +425,7 @@ int main(int argc, char *argv[])
 
 	setsize = CPU_ALLOC_SIZE(maxcpus);
 
-	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rvV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -341,6 +458,18 @@ int main(int argc, char *argv[])
 		case 'r':
 			cmd = CMD_CPU_RESCAN;
 			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case OPT_SMT:
+			cmd = CMD_CPU_SMT;
+			if (strcmp(optarg, "on") == 0)
+				smt = 1;
+			else if (strcmp(optarg, "off") == 0)
+				smt = 0;
+			else
+				errx(EXIT_FAILURE, _("unsupported argument: %s"), optarg);
+			break;
 
 		case 'h':
 			usage();
@@ -378,6 +507,9 @@ int main(int argc, char *argv[])
 	case CMD_CPU_DISPATCH_VERTICAL:
 		rc = cpu_set_dispatch(sys, 1);
 		break;
+	case CMD_CPU_SMT:
+		rc = cpu_set_smt(sys, smt);
+		break;
 	default:
 		rc = -EINVAL;
 		break;
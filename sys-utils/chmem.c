@@ -23,6 +23,8 @@
 #include <getopt.h>
 #include <assert.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "c.h"
 #include "nls.h"
@@ -38,6 +40,18 @@
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
 
+/* zone selection for online without --zone */
+enum {
+	POLICY_MOVABLE = 0,	/* Movable if valid (default) */
+	POLICY_KERNEL,		/* never Movable, if possible */
+	POLICY_RATIO		/* given percentage of blocks per node Movable */
+};
+
+struct chmem_node_stat {
+	uint64_t	total;		/* blocks selected for online */
+	uint64_t	movable;	/* ... from that online_movable */
+};
+
 struct chmem_desc {
 	struct path_cxt	*sysmem;	/* _PATH_SYS_MEMORY handler */
 	struct dirent	**dirs;
@@ -46,12 +60,48 @@ struct chmem_desc {
 	uint64_t	start;
 	uint64_t	end;
 	uint64_t	size;
+
+	size_t		jobs;		/* number of parallel writers */
+	int		policy;		/* POLICY_* */
+	unsigned int	movable_pct;	/* POLICY_RATIO percentage */
+	struct chmem_node_stat *nodes;	/* per-node counters, indexed by node + 1 */
+	size_t		nnodes;
+
+	/* progress, protected by the queue lock */
+	uint64_t	nwanted;	/* number of blocks to change */
+	uint64_t	nchanged;
+	uint64_t	nfailed;
+	struct timespec	started;
+	struct timespec	reported;
+
 	unsigned int	use_blocks : 1;
 	unsigned int	is_size	   : 1;
 	unsigned int	verbose	   : 1;
+	unsigned int	progress   : 1;
 	unsigned int	have_zones : 1;
 };
 
+/* memory block selected to be changed */
+struct chmem_block {
+	const char	*name;		/* memory<N> */
+	uint64_t	index;
+	int		node;		/* NUMA node or -1 */
+	size_t		rank;		/* order within the node */
+	const char	*onoff;		/* written to the state file */
+};
+
+/* blocks shared by the writers */
+struct chmem_queue {
+	struct chmem_desc	*desc;
+	struct chmem_block	*blocks;
+	size_t			nblocks;
+	size_t			next;		/* next block to write */
+	size_t			nok;		/* successfully changed */
+	int			enable;
+	int			warn_errors;	/* warn() on failed write */
+	pthread_mutex_t		lock;
+};
+
 enum {
 	CMD_MEMORY_ENABLE = 0,
 	CMD_MEMORY_DISABLE,
@@ -101,15 +151,265 @@ static void idxtostr(struct chmem_desc *desc, uint64_t idx, char *buf, size_t bu
 		 idx, start, end);
 }
 
+static double timespec_secs(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+/* the caller has to hold the queue lock */
+static void chmem_report_progress(struct chmem_desc *desc, int enable, int last)
+{
+	struct timespec now;
+	double secs;
+
+	if (!desc->progress)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!last && timespec_secs(&now, &desc->reported) < 1.0)
+		return;
+	desc->reported = now;
+
+	secs = timespec_secs(&now, &desc->started);
+	fprintf(stderr, "\r%s: %"PRIu64"/%"PRIu64" blocks, %"PRIu64" failed, %.1f blocks/s",
+			enable ? _("online") : _("offline"),
+			desc->nchanged, desc->nwanted, desc->nfailed,
+			secs > 0 ? desc->nchanged / secs : 0.0);
+	if (last) {
+		char *sizestr = size_to_human_string(SIZE_SUFFIX_1LETTER,
+					desc->nchanged * desc->block_size);
+
+		fprintf(stderr, _(" (%s in %.2f seconds)\n"), sizestr, secs);
+		free(sizestr);
+	}
+	fflush(stderr);
+}
+
+/* returns NUMA node of the block or -1 */
+static int chmem_block_node(struct chmem_desc *desc, const char *name)
+{
+	struct dirent *de;
+	DIR *dir;
+	int node = -1;
+
+	dir = ul_path_opendir(desc->sysmem, name);
+	if (!dir)
+		return -1;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp("node", de->d_name, 4) != 0
+		    || !isdigit_string(de->d_name + 4))
+			continue;
+		node = strtol(de->d_name + 4, NULL, 10);
+		break;
+	}
+	closedir(dir);
+	return node;
+}
+
+static struct chmem_node_stat *chmem_node_stat(struct chmem_desc *desc, int node)
+{
+	size_t idx = node + 1;		/* node -1 is unknown */
+
+	if (idx >= desc->nnodes) {
+		desc->nodes = xreallocarray(desc->nodes, idx + 1, sizeof(*desc->nodes));
+		memset(&desc->nodes[desc->nnodes], 0,
+			(idx + 1 - desc->nnodes) * sizeof(*desc->nodes));
+		desc->nnodes = idx + 1;
+	}
+	return &desc->nodes[idx];
+}
+
+static int zones_have_kernel(const char *zones)
+{
+	return strcasestr(zones, zone_names[ZONE_NORMAL])
+		|| strcasestr(zones, zone_names[ZONE_DMA])
+		|| strcasestr(zones, zone_names[ZONE_HIGHMEM]);
+}
+
+/* state for online without --zone, @zones is content of valid_zones */
+static const char *policy_online_type(struct chmem_desc *desc,
+				      const char *zones, int node)
+{
+	int movable = strcasestr(zones, zone_names[ZONE_MOVABLE]) != NULL;
+	struct chmem_node_stat *st;
+
+	switch (desc->policy) {
+	case POLICY_KERNEL:
+		if (zones_have_kernel(zones))
+			return "online_kernel";
+		break;
+	case POLICY_RATIO:
+		st = chmem_node_stat(desc, node);
+		st->total++;
+		if (movable && st->movable * 100 < st->total * desc->movable_pct) {
+			st->movable++;
+			return "online_movable";
+		}
+		if (zones_have_kernel(zones))
+			return "online_kernel";
+		break;
+	case POLICY_MOVABLE:
+	default:
+		if (movable)
+			return "online_movable";
+		break;
+	}
+	return "online";
+}
+
+static void chmem_write_queue(struct chmem_queue *q, struct path_cxt *sysmem)
+{
+	struct chmem_desc *desc = q->desc;
+
+	for (;;) {
+		struct chmem_block *blk = NULL;
+		char str[BUFSIZ];
+		int rc, errsv;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->next < q->nblocks)
+			blk = &q->blocks[q->next++];
+		pthread_mutex_unlock(&q->lock);
+		if (!blk)
+			break;
+
+		rc = ul_path_writef_string(sysmem, blk->onoff, "%s/state", blk->name);
+		errsv = errno;
+		idxtostr(desc, blk->index, str, sizeof(str));
+
+		pthread_mutex_lock(&q->lock);
+		if (rc == 0) {
+			q->nok++;
+			desc->nchanged++;
+			if (desc->verbose)
+				fprintf(stdout, q->enable ? _("%s enabled\n") :
+							    _("%s disabled\n"), str);
+		} else {
+			desc->nfailed++;
+			errno = errsv;
+			if (q->warn_errors)
+				warn(q->enable ? _("%s enable failed") :
+						 _("%s disable failed"), str);
+			else if (desc->verbose)
+				fprintf(stdout, q->enable ? _("%s enable failed\n") :
+							    _("%s disable failed\n"), str);
+		}
+		chmem_report_progress(desc, q->enable, 0);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
+static void *chmem_worker(void *data)
+{
+	struct chmem_queue *q = data;
+	struct path_cxt *sysmem;
+
+	/* path_cxt is not thread-safe */
+	sysmem = ul_new_path(_PATH_SYS_MEMORY);
+	if (!sysmem)
+		return NULL;
+	chmem_write_queue(q, sysmem);
+	ul_unref_path(sysmem);
+	return NULL;
+}
+
+static int cmp_block_rank(const void *a0, const void *b0)
+{
+	const struct chmem_block
+		*a = (const struct chmem_block *) a0,
+		*b = (const struct chmem_block *) b0;
+
+	if (a->rank != b->rank)
+		return a->rank < b->rank ? -1 : 1;
+	if (a->node != b->node)
+		return a->node < b->node ? -1 : 1;
+	return a->index < b->index ? -1 : a->index > b->index;
+}
+
+/*
+ * Writes the new state of the @blocks, in @desc->jobs threads. The blocks
+ * from different NUMA nodes are interleaved, so the parallel writers
+ * do not compete for the same node. Returns number of changed blocks.
+ */
+static size_t chmem_write_blocks(struct chmem_desc *desc, struct chmem_block *blocks,
+				 size_t nblocks, int enable, int warn_errors)
+{
+	struct chmem_queue q = {
+		.desc = desc,
+		.blocks = blocks,
+		.nblocks = nblocks,
+		.enable = enable,
+		.warn_errors = warn_errors
+	};
+	pthread_t *threads = NULL;
+	size_t i, nthreads = 0;
+
+	if (desc->jobs > 1 && nblocks > 1) {
+		size_t *ranks, nranks = 0;
+
+		for (i = 0; i < nblocks; i++)
+			nranks = max(nranks, (size_t) (blocks[i].node + 2));
+		ranks = xcalloc(nranks, sizeof(size_t));
+		for (i = 0; i < nblocks; i++)
+			blocks[i].rank = ranks[blocks[i].node + 1]++;
+		free(ranks);
+		qsort(blocks, nblocks, sizeof(*blocks), cmp_block_rank);
+
+		nthreads = min(desc->jobs, nblocks) - 1;
+		threads = xcalloc(nthreads, sizeof(pthread_t));
+	}
+
+	pthread_mutex_init(&q.lock, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, chmem_worker, &q) != 0)
+			break;
+	}
+	nthreads = i;
+
+	/* this thread is one of the writers, or the only one */
+	chmem_write_queue(&q, desc->sysmem);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&q.lock);
+	free(threads);
+	return q.nok;
+}
+
+static struct chmem_block *chmem_new_blocks(size_t nblocks)
+{
+	return xcalloc(max(nblocks, (size_t) 1), sizeof(struct chmem_block));
+}
+
+static void chmem_add_block(struct chmem_block *blk, const char *name,
+			    uint64_t index, int node, const char *onoff)
+{
+	blk->name = name;
+	blk->index = index;
+	blk->node = node;
+	blk->onoff = onoff;
+}
+
+/* the node is used to interleave parallel writers and for POLICY_RATIO */
+static inline int chmem_need_nodes(struct chmem_desc *desc)
+{
+	return desc->jobs > 1 || desc->policy == POLICY_RATIO;
+}
+
 static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 {
-	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
+	char *name, *onoff, *state, line[BUFSIZ];
+	struct chmem_block *blocks;
 	uint64_t size, index;
+	size_t nblocks;
 	const char *zn;
-	int i, rc;
+	int i;
 
 	size = desc->size;
-	onoff = enable ? "online" : "offline";
+	onoff = state = enable ? "online" : "offline";
 	i = enable ? 0 : desc->ndirs - 1;
 
 	if (enable && zone_id >= 0) {
@@ -119,47 +419,48 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 			onoff = "online_kernel";
 	}
 
-	for (; i >= 0 && i < desc->ndirs && size; i += enable ? 1 : -1) {
-		name = desc->dirs[i]->d_name;
-		index = strtou64_or_err(name + 6, _("Failed to parse index"));
-
-		if (ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/state", name) > 0
-		    && strncmp(onoff, line, 6) == 0)
-			continue;
-
-		if (desc->have_zones) {
-			ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/valid_zones", name);
-			if (zone_id >= 0) {
-				zn = zone_names[zone_id];
-				if (enable && !strcasestr(line, zn))
-					continue;
-				if (!enable && strncasecmp(line, zn, strlen(zn)) != 0)
-					continue;
-			} else if (enable) {
-				/* By default, use zone Movable for online, if valid */
-				if (strcasestr(line, zone_names[ZONE_MOVABLE]))
-					onoff = "online_movable";
-				else
-					onoff = "online";
+	desc->nwanted = size;
+	blocks = chmem_new_blocks(min(size, (uint64_t) desc->ndirs));
+
+	/* select @size blocks, write them and repeat for the failed ones */
+	while (size) {
+		nblocks = 0;
+
+		for (; i >= 0 && i < desc->ndirs && nblocks < size; i += enable ? 1 : -1) {
+			const char *type = onoff;
+			int node = -1;
+
+			name = desc->dirs[i]->d_name;
+			index = strtou64_or_err(name + 6, _("Failed to parse index"));
+
+			if (ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/state", name) > 0
+			    && strncmp(state, line, 6) == 0)
+				continue;
+
+			if (chmem_need_nodes(desc))
+				node = chmem_block_node(desc, name);
+
+			if (desc->have_zones) {
+				ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/valid_zones", name);
+				if (zone_id >= 0) {
+					zn = zone_names[zone_id];
+					if (enable && !strcasestr(line, zn))
+						continue;
+					if (!enable && strncasecmp(line, zn, strlen(zn)) != 0)
+						continue;
+				} else if (enable)
+					type = policy_online_type(desc, line, node);
 			}
-		}
 
-		idxtostr(desc, index, str, sizeof(str));
-		rc = ul_path_writef_string(desc->sysmem, onoff, "%s/state", name);
-		if (rc != 0 && desc->verbose) {
-			if (enable)
-				fprintf(stdout, _("%s enable failed\n"), str);
-			else
-				fprintf(stdout, _("%s disable failed\n"), str);
-		} else if (rc == 0 && desc->verbose) {
-			if (enable)
-				fprintf(stdout, _("%s enabled\n"), str);
-			else
-				fprintf(stdout, _("%s disabled\n"), str);
+			chmem_add_block(&blocks[nblocks++], name, index, node, type);
 		}
-		if (rc == 0)
-			size--;
+		if (!nblocks)
+			break;
+		size -= chmem_write_blocks(desc, blocks, nblocks, enable, 0);
 	}
+	free(blocks);
+	chmem_report_progress(desc, enable, 1);
+
 	if (size) {
 		uint64_t bytes;
 		char *sizestr;
@@ -177,13 +478,15 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 
 static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 {
-	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
+	char *name, *onoff, *state, line[BUFSIZ], str[BUFSIZ];
+	struct chmem_block *blocks;
 	uint64_t index, todo;
+	size_t nblocks = 0;
 	const char *zn;
-	int i, rc;
+	int i;
 
 	todo = desc->end - desc->start + 1;
-	onoff = enable ? "online" : "offline";
+	onoff = state = enable ? "online" : "offline";
 
 	if (enable && zone_id >= 0) {
 		if (zone_id == ZONE_MOVABLE)
@@ -192,7 +495,12 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			onoff = "online_kernel";
 	}
 
+	blocks = chmem_new_blocks(min(todo, (uint64_t) desc->ndirs));
+
 	for (i = 0; i < desc->ndirs; i++) {
+		const char *type = onoff;
+		int node = -1;
+
 		name = desc->dirs[i]->d_name;
 		index = strtou64_or_err(name + 6, _("Failed to parse index"));
 		if (index < desc->start)
@@ -201,7 +509,7 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			break;
 		idxtostr(desc, index, str, sizeof(str));
 		if (ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/state", name) > 0
-		    && strncmp(onoff, line, 6) == 0) {
+		    && strncmp(state, line, 6) == 0) {
 			if (desc->verbose && enable)
 				fprintf(stdout, _("%s already enabled\n"), str);
 			else if (desc->verbose && !enable)
@@ -210,6 +518,9 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			continue;
 		}
 
+		if (chmem_need_nodes(desc))
+			node = chmem_block_node(desc, name);
+
 		if (desc->have_zones) {
 			ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/valid_zones", name);
 			if (zone_id >= 0) {
@@ -222,30 +533,18 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 					warnx(_("%s disable failed: Zone mismatch"), str);
 					continue;
 				}
-			} else if (enable) {
-				/* By default, use zone Movable for online, if valid */
-				if (strcasestr(line, zone_names[ZONE_MOVABLE]))
-					onoff = "online_movable";
-				else
-					onoff = "online";
-			}
+			} else if (enable)
+				type = policy_online_type(desc, line, node);
 		}
 
-		rc = ul_path_writef_string(desc->sysmem, onoff, "%s/state", name);
-		if (rc != 0) {
-			if (enable)
-				warn(_("%s enable failed"), str);
-			else
-				warn(_("%s disable failed"), str);
-		} else if (desc->verbose) {
-			if (enable)
-				fprintf(stdout, _("%s enabled\n"), str);
-			else
-				fprintf(stdout, _("%s disabled\n"), str);
-		}
-		if (rc == 0)
-			todo--;
+		chmem_add_block(&blocks[nblocks++], name, index, node, type);
 	}
+
+	desc->nwanted = nblocks;
+	todo -= chmem_write_blocks(desc, blocks, nblocks, enable, 1);
+	free(blocks);
+	chmem_report_progress(desc, enable, 1);
+
 	return todo == 0 ? 0 : todo == desc->end - desc->start + 1 ? -1 : 1;
 }
 
@@ -347,9 +646,18 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -d, --disable      disable memory\n"), out);
 	fputs(_(" -b, --blocks       use memory blocks\n"), out);
 	fputs(_(" -z, --zone <name>  select memory zone (see below)\n"), out);
+	fputs(_(" -j, --jobs <num>   number of parallel writers\n"), out);
+	fputs(_(" -p, --policy <policy>\n"
+		"                    zone for online without --zone (see below)\n"), out);
+	fputs(_("     --progress     print progress and rate to stderr\n"), out);
 	fputs(_(" -v, --verbose      verbose output\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(20));
 
+	fputs(_("\nSupported policies:\n"), out);
+	fputs(_(" movable            zone Movable, if valid (default)\n"), out);
+	fputs(_(" kernel             kernel zone, if valid\n"), out);
+	fputs(_(" movable=<percent>  <percent> of the blocks per node Movable, rest kernel\n"), out);
+
 	fputs(_("\nSupported zones:\n"), out);
 	for (i = 0; i < ARRAY_SIZE(zone_names); i++)
 		fprintf(out, " %s\n", zone_names[i]);
@@ -365,12 +673,18 @@ int main(int argc, char **argv)
 	int cmd = CMD_NONE, zone_id = -1;
 	char *zone = NULL;
 	int c, rc;
+	enum {
+		OPT_PROGRESS = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{"block",	no_argument,		NULL, 'b'},
 		{"disable",	no_argument,		NULL, 'd'},
 		{"enable",	no_argument,		NULL, 'e'},
 		{"help",	no_argument,		NULL, 'h'},
+		{"jobs",	required_argument,	NULL, 'j'},
+		{"policy",	required_argument,	NULL, 'p'},
+		{"progress",	no_argument,		NULL, OPT_PROGRESS},
 		{"verbose",	no_argument,		NULL, 'v'},
 		{"version",	no_argument,		NULL, 'V'},
 		{"zone",	required_argument,	NULL, 'z'},
@@ -379,6 +693,7 @@ int main(int argc, char **argv)
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'd','e' },
+		{ 'p','z' },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -394,8 +709,9 @@ int main(int argc, char **argv)
 		err(EXIT_FAILURE, _("failed to initialize %s handler"), _PATH_SYS_MEMORY);
 
 	read_info(desc);
+	desc->jobs = 1;
 
-	while ((c = getopt_long(argc, argv, "bdehvVz:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bdehj:p:vVz:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -415,6 +731,28 @@ int main(int argc, char **argv)
 		case 'z':
 			zone = xstrdup(optarg);
 			break;
+		case 'j':
+			desc->jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!desc->jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
+		case 'p':
+			if (strcmp(optarg, "movable") == 0)
+				desc->policy = POLICY_MOVABLE;
+			else if (strcmp(optarg, "kernel") == 0)
+				desc->policy = POLICY_KERNEL;
+			else if (strncmp(optarg, "movable=", 8) == 0) {
+				desc->policy = POLICY_RATIO;
+				desc->movable_pct = strtou32_or_err(optarg + 8,
+						_("failed to parse movable percentage"));
+				if (desc->movable_pct > 100)
+					errx(EXIT_FAILURE, _("movable percentage out of range: %s"), optarg);
+			} else
+				errx(EXIT_FAILURE, _("unsupported policy: %s"), optarg);
+			break;
+		case OPT_PROGRESS:
+			desc->progress = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -447,12 +785,16 @@ int main(int argc, char **argv)
 		}
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &desc->started);
+	desc->reported = desc->started;
+
 	if (desc->is_size)
 		rc = chmem_size(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
 	else
 		rc = chmem_range(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
 
 	ul_unref_path(desc->sysmem);
+	free(desc->nodes);
 
 	return rc == 0 ? EXIT_SUCCESS :
 		rc < 0 ? EXIT_FAILURE : CHMEM_EXIT_SOMEOK;
@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "c.h"
 #include "colors.h"
@@ -199,6 +200,9 @@ struct dmesg_control {
 
 	struct timeval	lasttime;	/* last printed timestamp */
 	struct tm	lasttm;		/* last localtime */
+	struct ul_tmcache tmcache;	/* cached localtime */
+	time_t		ctcache_sec;	/* second of ctcache */
+	char		ctcache[128];	/* record_ctime() of ctcache_sec */
 	struct timeval	boot_time;	/* system boot time */
 	usec_t		suspended_time;	/* time spent in suspended state */
 
@@ -220,6 +224,10 @@ struct dmesg_control {
 	usec_t		since;		/* filter records by time */
 	usec_t		until;		/* filter records by time */
 
+	const char	*cursor_file;	/* --cursor <file> */
+	uint64_t	cursor_seq;	/* last sequence number from the file */
+	uint64_t	last_seq;	/* last sequence number read */
+
 	/*
 	 * For the --file option we mmap whole file. The unnecessary (already
 	 * printed) pages are always unmapped. The result is that we have in
@@ -243,8 +251,11 @@ struct dmesg_control {
 			pager:1,	/* pipe output into a pager */
 			color:1,	/* colorize messages */
 			json:1,		/* JSON output */
-			force_prefix:1;	/* force timestamp and decode prefix
+			force_prefix:1,	/* force timestamp and decode prefix
 					   on each line */
+			ctcache_ok:1,	/* ctcache is valid */
+			cursor_ok:1,	/* cursor_seq is valid */
+			last_seq_ok:1;	/* last_seq is valid */
 	int		indent;		/* due to timestamps if newline */
 	size_t          caller_id_size;   /* PRINTK_CALLERID max field size */
 };
@@ -255,6 +266,7 @@ struct dmesg_record {
 
 	int		level;
 	int		facility;
+	uint64_t	seq;		/* kmsg sequence number */
 	struct timeval  tv;
 	char		caller_id[PID_CHARS_MAX];
 
@@ -267,11 +279,15 @@ struct dmesg_record {
 		(_r)->mesg_size = 0; \
 		(_r)->facility = -1; \
 		(_r)->level = -1; \
+		(_r)->seq = 0; \
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
 		(_r)->caller_id[0] = 0; \
 	} while (0)
 
+/* stdout buffer size in the follow mode */
+#define KMSG_OUTBUF_SIZE	(64 * 1024)
+
 static int process_kmsg(struct dmesg_control *ctl);
 static int process_kmsg_file(struct dmesg_control *ctl, char **buf);
 
@@ -355,6 +371,7 @@ static void __attribute__((__noreturn__)) usage(void)
 		"Suspending/resume will make ctime and iso timestamps inaccurate.\n"), out);
 	fputs(_("     --since <time>          display the lines since the specified time\n"), out);
 	fputs(_("     --until <time>          display the lines until the specified time\n"), out);
+	fputs(_("     --cursor <file>         print only messages newer than recorded in the file\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(29));
@@ -1022,20 +1039,31 @@ static void raw_print(struct dmesg_control *ctl, const char *buf, size_t size)
 		putchar('\n');
 }
 
+/*
+ * Many records share the same second or day, so the last localtime() and
+ * ctime results are cached.
+ */
 static struct tm *record_localtime(struct dmesg_control *ctl,
 				   struct dmesg_record *rec,
 				   struct tm *tm)
 {
 	time_t t = record_time(ctl, rec) / USEC_PER_SEC;
-	return localtime_r(&t, tm);
+
+	return ul_tmcache_convert(&ctl->tmcache, t, 0, tm);
 }
 
 static char *record_ctime(struct dmesg_control *ctl,
 			  struct dmesg_record *rec,
 			  char *buf, size_t bufsiz)
 {
+	time_t t = record_time(ctl, rec) / USEC_PER_SEC;
 	struct tm tm;
 
+	if (ctl->ctcache_ok && ctl->ctcache_sec == t) {
+		xstrncpy(buf, ctl->ctcache, bufsiz);
+		return buf;
+	}
+
 	record_localtime(ctl, rec, &tm);
 
 	/* TRANSLATORS: dmesg uses strftime() fo generate date-time string
@@ -1044,6 +1072,10 @@ static char *record_ctime(struct dmesg_control *ctl,
 	   proper month/day order here */
 	if (strftime(buf, bufsiz, _("%a %b %e %H:%M:%S %Y"), &tm) == 0)
 		*buf = '\0';
+
+	xstrncpy(ctl->ctcache, buf, sizeof(ctl->ctcache));
+	ctl->ctcache_sec = t;
+	ctl->ctcache_ok = 1;
 	return buf;
 }
 
@@ -1065,7 +1097,8 @@ static char *iso_8601_time(struct dmesg_control *ctl, struct dmesg_record *rec,
 		timeval_to_usec(&rec->tv)
 	);
 
-	if (strtimeval_iso(&tv,	ISO_TIMESTAMP_COMMA_T, buf, bufsz) != 0)
+	if (strtimeval_iso_cached(&ctl->tmcache, &tv, ISO_TIMESTAMP_COMMA_T,
+				  buf, bufsz) != 0)
 		return NULL;
 
 	return buf;
@@ -1144,6 +1177,8 @@ static void print_record(struct dmesg_control *ctl,
 			ul_jsonwrt_array_open(&ctl->jfmt, "dmesg");
 		}
 		ul_jsonwrt_object_open(&ctl->jfmt, NULL);
+		if (ctl->cursor_file)
+			ul_jsonwrt_value_u64(&ctl->jfmt, "seq", rec->seq);
 	}
 
 	/*
@@ -1379,12 +1414,14 @@ static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 
 static int init_kmsg(struct dmesg_control *ctl)
 {
-	int mode = O_RDONLY;
+	/*
+	 * Always non-blocking; in the follow mode process_kmsg() drains
+	 * all the available records and waits by poll() after that.
+	 */
+	int mode = O_RDONLY | O_NONBLOCK;
 
-	if (!ctl->follow)
-		mode |= O_NONBLOCK;
-	else
-		setlinebuf(stdout);
+	if (ctl->follow)
+		setvbuf(stdout, NULL, _IOFBF, KMSG_OUTBUF_SIZE);
 
 	ctl->kmsg = open("/dev/kmsg", mode);
 	if (ctl->kmsg < 0)
@@ -1406,7 +1443,9 @@ static int init_kmsg(struct dmesg_control *ctl)
 	 * process_kmsg().
 	 */
 	ctl->kmsg_first_read = read_kmsg_one(ctl);
-	if (ctl->kmsg_first_read < 0) {
+	if (ctl->kmsg_first_read < 0 && ctl->follow && errno == EAGAIN)
+		ctl->kmsg_first_read = 0;	/* nothing to read yet */
+	else if (ctl->kmsg_first_read < 0) {
 		close(ctl->kmsg);
 		ctl->kmsg = -1;
 		return -1;
@@ -1454,6 +1493,15 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		goto mesg;
 
 	/* B) sequence number */
+	if (ctl->cursor_file) {
+		rec->seq = strtoumax(p, NULL, 10);
+
+		/* already printed by the previous run */
+		if (ctl->cursor_ok && rec->seq <= ctl->cursor_seq)
+			return 1;
+		ctl->last_seq = rec->seq;
+		ctl->last_seq_ok = 1;
+	}
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
@@ -1505,6 +1553,75 @@ mesg:
 	return 0;
 }
 
+/*
+ * The cursor file contains the boot ID and the sequence number of the last
+ * /dev/kmsg record read. The records up to this number are skipped, unless
+ * the system has been rebooted since.
+ */
+static int read_boot_id(char *buf, size_t bufsz)
+{
+	FILE *f = fopen(_PATH_PROC_BOOT_ID, "r" UL_CLOEXECSTR);
+	int rc = -1;
+
+	if (f) {
+		if (fgets(buf, bufsz, f)) {
+			rtrim_whitespace((unsigned char *) buf);
+			rc = 0;
+		}
+		fclose(f);
+	}
+	if (rc)
+		xstrncpy(buf, "-", bufsz);
+	return rc;
+}
+
+static void load_cursor(struct dmesg_control *ctl)
+{
+	char boot_id[64], id[64];
+	uintmax_t seq;
+	FILE *f;
+
+	f = fopen(ctl->cursor_file, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			err(EXIT_FAILURE, _("cannot open %s"), ctl->cursor_file);
+		return;
+	}
+	read_boot_id(boot_id, sizeof(boot_id));
+
+	if (fscanf(f, "%63s %ju", id, &seq) == 2 && strcmp(id, boot_id) == 0) {
+		ctl->cursor_seq = seq;
+		ctl->cursor_ok = 1;
+	}
+	fclose(f);
+}
+
+static void save_cursor(struct dmesg_control *ctl)
+{
+	char boot_id[64], *tmp;
+	FILE *f;
+
+	if (!ctl->last_seq_ok)
+		return;
+
+	read_boot_id(boot_id, sizeof(boot_id));
+	xasprintf(&tmp, "%s.tmp", ctl->cursor_file);
+
+	/* replace the file atomically, a reader never sees it truncated */
+	f = fopen(tmp, "w" UL_CLOEXECSTR);
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), tmp);
+	fprintf(f, "%s %ju\n", boot_id, (uintmax_t) ctl->last_seq);
+	if (close_stream(f) != 0)
+		err(EXIT_FAILURE, _("write failed: %s"), tmp);
+	if (rename(tmp, ctl->cursor_file) != 0)
+		err(EXIT_FAILURE, _("cannot rename %s to %s"), tmp, ctl->cursor_file);
+	free(tmp);
+
+	ctl->cursor_seq = ctl->last_seq;
+	ctl->cursor_ok = 1;
+}
+
 /*
  * Note that each read() call for /dev/kmsg returns always one record. It means
  * that we don't have to read whole message buffer before the records parsing.
@@ -1512,6 +1629,11 @@ mesg:
  * So this function does not compose one huge buffer (like read_syslog_buffer())
  * and print_buffer() is unnecessary. All is done in this function.
  *
+ * In the follow mode the records are read until /dev/kmsg is drained and the
+ * output is fully buffered meanwhile; it's flushed only before we wait for
+ * the next records. This way a burst of messages is written by a few large
+ * write() calls rather than by one call for each line.
+ *
  * Returns 0 on success, -1 on error.
  */
 static int process_kmsg(struct dmesg_control *ctl)
@@ -1532,15 +1654,29 @@ static int process_kmsg(struct dmesg_control *ctl)
 	 */
 	sz = ctl->kmsg_first_read;
 
-	while (sz > 0) {
-		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+	do {
+		struct pollfd fds = { .fd = ctl->kmsg, .events = POLLIN };
 
-		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
-			print_record(ctl, &rec);
+		while (sz > 0) {
+			*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+
+			if (parse_kmsg_record(ctl, &rec,
+					      ctl->kmsg_buf, (size_t) sz) == 0)
+				print_record(ctl, &rec);
+
+			sz = read_kmsg_one(ctl);
+		}
+		if (!ctl->follow || (sz < 0 && errno != EAGAIN))
+			break;
 
+		/* drained, write the output and wait for more records */
+		fflush(stdout);
+		if (ctl->cursor_file)
+			save_cursor(ctl);
+		if (poll(&fds, 1, -1) < 0 && errno != EINTR)
+			break;
 		sz = read_kmsg_one(ctl);
-	}
+	} while (1);
 
 	return 0;
 }
@@ -1644,13 +1780,15 @@ int main(int argc, char *argv[])
 		OPT_TIME_FORMAT = CHAR_MAX + 1,
 		OPT_NOESC,
 		OPT_SINCE,
-		OPT_UNTIL
+		OPT_UNTIL,
+		OPT_CURSOR
 	};
 
 	static const struct option longopts[] = {
 		{ "buffer-size",   required_argument, NULL, 's' },
 		{ "clear",         no_argument,	      NULL, 'C' },
 		{ "color",         optional_argument, NULL, 'L' },
+		{ "cursor",        required_argument, NULL, OPT_CURSOR },
 		{ "console-level", required_argument, NULL, 'n' },
 		{ "console-off",   no_argument,       NULL, 'D' },
 		{ "console-on",    no_argument,       NULL, 'E' },
@@ -1832,6 +1970,9 @@ int main(int argc, char *argv[])
 				errx(EXIT_FAILURE, _("invalid time value \"%s\""), optarg);
 			break;
 		}
+		case OPT_CURSOR:
+			ctl.cursor_file = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1913,6 +2054,11 @@ int main(int argc, char *argv[])
 
 		if (ctl.force_prefix && ctl.method != DMESG_METHOD_KMSG)
 			errx(EXIT_FAILURE, _("only kmsg supports multi-line messages"));
+		if (ctl.cursor_file) {
+			if (ctl.method != DMESG_METHOD_KMSG)
+				errx(EXIT_FAILURE, _("only kmsg supports --cursor"));
+			load_cursor(&ctl);
+		}
 		if (ctl.pager)
 			pager_redirect();
 		n = process_buffer(&ctl, &buf);
@@ -1926,6 +2072,10 @@ int main(int argc, char *argv[])
 			ul_jsonwrt_array_close(&ctl.jfmt);
 			ul_jsonwrt_root_close(&ctl.jfmt);
 		}
+		if (ctl.cursor_file && n >= 0) {
+			fflush(stdout);
+			save_cursor(&ctl);
+		}
 		if (n < 0)
 			err(EXIT_FAILURE, _("read kernel buffer failed"));
 		else if (ctl.action == SYSLOG_ACTION_READ_CLEAR)
@@ -33,6 +33,7 @@
 #include <getopt.h>
 #include <limits.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifndef HAVE_FALLOCATE
 # include <sys/syscall.h>
@@ -90,6 +91,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --collapse-range remove a range from the file\n"), out);
 	fputs(_(" -d, --dig-holes      detect zeroes and replace with holes\n"), out);
 	fputs(_(" -i, --insert-range   insert a hole at range, shifting existing data\n"), out);
+	fputs(_(" -j, --jobs <num>     number of threads for --dig-holes\n"), out);
 	fputs(_(" -l, --length <num>   length for range operations, in bytes\n"), out);
 	fputs(_(" -n, --keep-size      maintain the apparent size of the file\n"), out);
 	fputs(_(" -o, --offset <num>   offset for range operations, in bytes\n"), out);
@@ -151,135 +153,200 @@ static void xposix_fallocate(int fd, off_t offset, off_t length)
 }
 #endif
 
-/* The real buffer size has to be bufsize + sizeof(uintptr_t) */
-static int is_nul(void *buf, size_t bufsize)
+/*
+ * Returns true if the buffer contains only zeroes. The first bytes are
+ * checked directly and the rest is compared against itself shifted by
+ * 16 bytes; memcmp() is vectorized by libc.
+ */
+static int is_nul(const void *buf, size_t bufsize)
 {
-	typedef uintptr_t word;
-	void const *vp;
-	char const *cbuf = buf, *cp;
-	word const *wp = buf;
+	const unsigned char *p = buf;
+	size_t i, n = min(bufsize, (size_t) 16);
 
-	/* set sentinel */
-	memset((char *) buf + bufsize, '\1', sizeof(word));
-
-	/* Find first nonzero *word*, or the word with the sentinel.  */
-	while (*wp++ == 0)
-		continue;
+	for (i = 0; i < n; i++) {
+		if (p[i])
+			return 0;
+	}
+	return bufsize <= 16 || memcmp(p, p + 16, bufsize - 16) == 0;
+}
 
-	/* Find the first nonzero *byte*, or the sentinel.  */
-	vp = wp - 1;
-	cp = vp;
+/* size of the file range processed by one thread at a time */
+#define DIG_CHUNKSZ	(32 * 1024 * 1024)
+/* read buffer size */
+#define DIG_BUFSZ	(1024 * 1024)
 
-	while (*cp++ == 0)
-		continue;
+struct dig_queue {
+	int		fd;
+	off_t		off;		/* next offset to process */
+	off_t		end;		/* end of the range, or 0 for EOF */
+	off_t		data_end;	/* end of the current data area */
+	off_t		size;		/* file size */
+	size_t		blksz;		/* filesystem I/O block size */
+	uintmax_t	ct;		/* number of converted bytes */
+	int		done;
 
-	return cbuf + bufsize < cp;
-}
+	pthread_mutex_t	lock;
+};
 
-static void dig_holes(int fd, off_t file_off, off_t len)
+/*
+ * Returns the next chunk of the data area (holes are skipped by
+ * SEEK_DATA and SEEK_HOLE). Returns 0 if there is nothing more to do.
+ */
+static int dig_next_chunk(struct dig_queue *q, off_t *off, off_t *len)
 {
-	off_t file_end = len ? file_off + len : 0;
-	off_t hole_start = 0, hole_sz = 0;
-	uintmax_t ct = 0;
-	size_t  bufsz;
-	char *buf;
-	struct stat st;
-#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-	off_t cache_start = file_off;
-	/*
-	 * We don't want to call POSIX_FADV_DONTNEED to discard cached
-	 * data in PAGE_SIZE steps. IMHO it's overkill (too many syscalls).
-	 *
-	 * Let's assume that 1MiB (on system with 4K page size) is just
-	 * a good compromise.
-	 *					    -- kzak Feb-2014
-	 */
-	const size_t cachesz = getpagesize() * 256;
-#endif
+	int rc = 0;
 
-	if (fstat(fd, &st) != 0)
-		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+	pthread_mutex_lock(&q->lock);
+	while (!q->done && q->off >= q->data_end) {
+		off_t o, e;
 
-	bufsz = st.st_blksize;
+		if (q->end && q->off >= q->end) {
+			q->done = 1;
+			break;
+		}
+		o = lseek(q->fd, q->off, SEEK_DATA);
+		if (o < 0 || (q->end && o >= q->end)) {
+			q->done = 1;
+			break;
+		}
+		e = lseek(q->fd, o, SEEK_HOLE);
+		if (e < 0) {
+			q->done = 1;
+			break;
+		}
+		if (q->end && e > q->end)
+			e = q->end;
 
-	if (lseek(fd, file_off, SEEK_SET) < 0)
-		err(EXIT_FAILURE, _("seek on %s failed"), filename);
+		q->off = o;
+		q->data_end = e;
+	}
+	if (!q->done) {
+		*off = q->off;
+		*len = min(q->data_end - q->off, (off_t) DIG_CHUNKSZ);
+		q->off += *len;
+		rc = 1;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return rc;
+}
 
-	/* buffer + extra space for is_nul() sentinel */
-	buf = xmalloc(bufsz + sizeof(uintptr_t));
-	while (file_end == 0 || file_off < file_end) {
-		/*
-		 * Detect data area (skip holes)
-		 */
-		off_t end, off;
+static void dig_punch(struct dig_queue *q, off_t start, off_t len)
+{
+	off_t alloc_sz = len;
 
-		off = lseek(fd, file_off, SEEK_DATA);
-		if ((off == -1 && errno == ENXIO) ||
-		    (file_end && off >= file_end))
-			break;
+	/* the last block is partial, meet block boundary */
+	if (start + len >= q->size)
+		alloc_sz += q->blksz;
 
-		end = lseek(fd, off, SEEK_HOLE);
-		if (file_end && end > file_end)
-			end = file_end;
+	xfallocate(q->fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
+		   start, alloc_sz);
 
-		if (off < 0 || end < 0)
-			break;
+	pthread_mutex_lock(&q->lock);
+	q->ct += len;
+	pthread_mutex_unlock(&q->lock);
+}
 
-#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-		(void) posix_fadvise(fd, off, end, POSIX_FADV_SEQUENTIAL);
-#endif
-		/*
-		 * Dig holes in the area
-		 */
-		while (off < end) {
-			ssize_t rsz = pread(fd, buf, bufsz, off);
-			if (rsz < 0 && errno)
+static void *dig_worker(void *data)
+{
+	struct dig_queue *q = data;
+	off_t hole_start = 0, hole_sz = 0, off, len;
+	size_t bufsz = max(q->blksz, (size_t) DIG_BUFSZ / q->blksz * q->blksz);
+	char *buf = xmalloc(bufsz);
+
+	while (dig_next_chunk(q, &off, &len)) {
+		off_t cur = off, end = off + len;
+
+		/* adjacent zero ranges are punched at once */
+		if (hole_sz && hole_start + hole_sz != off) {
+			dig_punch(q, hole_start, hole_sz);
+			hole_sz = 0;
+		}
+
+		while (cur < end) {
+			ssize_t rsz = pread(q->fd, buf, min((off_t) bufsz, end - cur), cur);
+			ssize_t i;
+
+			if (rsz < 0)
 				err(EXIT_FAILURE, _("%s: read failed"), filename);
-			if (end && rsz > 0 && off > end - rsz)
-				rsz = end - off;
-			if (rsz <= 0)
+			if (rsz == 0)
 				break;
 
-			if (is_nul(buf, rsz)) {
-				if (!hole_sz)				/* new hole detected */
-					hole_start = off;
-				hole_sz += rsz;
-			 } else if (hole_sz) {
-				xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					   hole_start, hole_sz);
-				ct += hole_sz;
-				hole_sz = hole_start = 0;
+			for (i = 0; i < rsz; i += q->blksz) {
+				size_t sz = min((size_t) (rsz - i), q->blksz);
+
+				if (is_nul(buf + i, sz)) {
+					if (!hole_sz)		/* new hole detected */
+						hole_start = cur + i;
+					hole_sz += sz;
+				} else if (hole_sz) {
+					dig_punch(q, hole_start, hole_sz);
+					hole_sz = 0;
+				}
 			}
-
+			cur += rsz;
+		}
 #if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
-			/* discard cached data */
-			if (off - cache_start > (off_t) cachesz) {
-				size_t clen = off - cache_start;
-
-				clen = (clen / cachesz) * cachesz;
-				(void) posix_fadvise(fd, cache_start, clen, POSIX_FADV_DONTNEED);
-				cache_start = cache_start + clen;
-			}
+		/* discard cached data */
+		(void) posix_fadvise(q->fd, off, cur - off, POSIX_FADV_DONTNEED);
 #endif
-			off += rsz;
-		}
-		if (hole_sz) {
-			off_t alloc_sz = hole_sz;
-			if (off >= end)
-				alloc_sz += st.st_blksize;		/* meet block boundary */
-			xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					hole_start, alloc_sz);
-			ct += hole_sz;
-		}
-		file_off = off;
 	}
+	if (hole_sz)
+		dig_punch(q, hole_start, hole_sz);
 
 	free(buf);
+	return NULL;
+}
+
+/*
+ * Replaces zeroed blocks in the range with holes. The data areas of the
+ * file are split into chunks processed by @jobs threads (the main thread
+ * is one of them).
+ */
+static void dig_holes(int fd, off_t file_off, off_t len, size_t jobs)
+{
+	struct dig_queue q = {
+		.fd = fd,
+		.off = file_off,
+		.end = len ? file_off + len : 0,
+		.data_end = file_off
+	};
+	pthread_t *threads = NULL;
+	size_t i, nthreads = 0;
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+
+	q.size = st.st_size;
+	q.blksz = st.st_blksize > 0 ? (size_t) st.st_blksize : 4096;
+
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+	(void) posix_fadvise(fd, file_off, len, POSIX_FADV_SEQUENTIAL);
+#endif
+	pthread_mutex_init(&q.lock, NULL);
+
+	if (jobs > 1) {
+		nthreads = jobs - 1;
+		threads = xcalloc(nthreads, sizeof(pthread_t));
+	}
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, dig_worker, &q) != 0)
+			break;
+	}
+	nthreads = i;
+
+	dig_worker(&q);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&q.lock);
+	free(threads);
 
 	if (verbose) {
-		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, ct);
+		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, q.ct);
 		fprintf(stdout, _("%s: %s (%ju bytes) converted to sparse holes.\n"),
-				filename, str, ct);
+				filename, str, q.ct);
 		free(str);
 	}
 }
@@ -295,6 +362,7 @@ int main(int argc, char **argv)
 #endif
 	loff_t	length = -2LL;
 	loff_t	offset = 0;
+	size_t	jobs = 0;
 
 	static const struct option longopts[] = {
 	    { "help",           no_argument,       NULL, 'h' },
@@ -304,6 +372,7 @@ int main(int argc, char **argv)
 	    { "collapse-range", no_argument,       NULL, 'c' },
 	    { "dig-holes",      no_argument,       NULL, 'd' },
 	    { "insert-range",   no_argument,       NULL, 'i' },
+	    { "jobs",           required_argument, NULL, 'j' },
 	    { "zero-range",     no_argument,       NULL, 'z' },
 	    { "offset",         required_argument, NULL, 'o' },
 	    { "length",         required_argument, NULL, 'l' },
@@ -325,7 +394,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "hvVncpdizxl:o:", longopts, NULL))
+	while ((c = getopt_long(argc, argv, "hvVncpdizxj:l:o:", longopts, NULL))
 			!= -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
@@ -340,6 +409,11 @@ int main(int argc, char **argv)
 		case 'i':
 			mode |= FALLOC_FL_INSERT_RANGE;
 			break;
+		case 'j':
+			jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
 		case 'l':
 			length = cvtnum(optarg);
 			break;
@@ -398,6 +472,8 @@ int main(int argc, char **argv)
 	}
 	if (offset < 0)
 		errx(EXIT_FAILURE, _("invalid offset value specified"));
+	if (jobs && !dig)
+		errx(EXIT_FAILURE, _("option --jobs requires --dig-holes"));
 
 	/* O_CREAT makes sense only for the default fallocate(2) behavior
 	 * when mode is no specified and new space is allocated */
@@ -407,7 +483,7 @@ int main(int argc, char **argv)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
 	if (dig)
-		dig_holes(fd, offset, length);
+		dig_holes(fd, offset, length, jobs ? jobs : 1);
 	else {
 #ifdef HAVE_POSIX_FALLOCATE
 		if (posix)
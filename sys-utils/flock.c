@@ -68,6 +68,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(  " -o, --close              close file descriptor before running command\n"), stdout);
 	fputs(_(  " -c, --command <command>  run a single command string through the shell\n"), stdout);
 	fputs(_(  " -F, --no-fork            execute command without forking\n"), stdout);
+	fputs(_(  "     --fcntl              use fcntl(F_OFD_SETLK) rather than flock()\n"), stdout);
+	fputs(_(  "     --queue <file>       wait in a FIFO queue kept in <file>\n"), stdout);
+	fputs(_(  "     --stats              print lock wait and hold times\n"), stdout);
 	fputs(_(  "     --verbose            increase verbosity\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(26));
@@ -87,6 +90,119 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		timeout_expired = 1;
 }
 
+/*
+ * Locks the whole file by flock(2) or by an open file description lock.
+ * The fcntl() errors for a conflicting lock are returned as EWOULDBLOCK.
+ */
+static int do_lock(int use_fcntl, int fd, int op, int block)
+{
+#ifdef F_OFD_SETLK
+	if (use_fcntl) {
+		struct flock fl = {
+			.l_type = op == LOCK_EX ? F_WRLCK :
+				  op == LOCK_SH ? F_RDLCK : F_UNLCK,
+			.l_whence = SEEK_SET
+		};
+		int rc = fcntl(fd, block ? F_OFD_SETLK : F_OFD_SETLKW, &fl);
+
+		if (rc != 0 && (errno == EAGAIN || errno == EACCES))
+			errno = EWOULDBLOCK;
+		return rc;
+	}
+#endif
+	return flock(fd, op | block);
+}
+
+#ifdef F_OFD_SETLK
+/*
+ * FIFO queue of the waiters. The queue file contains a ticket counter
+ * protected by a lock on its first byte. Every waiter holds a lock on the
+ * byte of its ticket and waits for the byte of its predecessor, so only
+ * the first waiter in the queue waits for the lock itself and the lock is
+ * handed over in order of arrival.
+ */
+#define QUEUE_SLOT(t)	((off_t) sizeof(uint64_t) + (off_t) (t))
+
+static int queue_lock(int fd, short type, off_t start, int cmd)
+{
+	struct flock fl = {
+		.l_type = type,
+		.l_whence = SEEK_SET,
+		.l_start = start,
+		.l_len = 1
+	};
+	return fcntl(fd, cmd, &fl);
+}
+
+/* takes the next ticket, returns 0 or -1 with errno set */
+static int queue_enter(int qfd, uint64_t *ticket)
+{
+	uint64_t t = 0, next;
+	int rc;
+
+	if (queue_lock(qfd, F_WRLCK, 0, F_OFD_SETLKW) != 0)
+		return -1;
+
+	if (pread(qfd, &t, sizeof(t), 0) != sizeof(t))
+		t = 0;
+	next = t + 1;
+
+	rc = queue_lock(qfd, F_WRLCK, QUEUE_SLOT(t), F_OFD_SETLK);
+	if (rc == 0 && pwrite(qfd, &next, sizeof(next), 0) != sizeof(next))
+		rc = -1;
+
+	queue_lock(qfd, F_UNLCK, 0, F_OFD_SETLK);
+	if (rc != 0)
+		return -1;
+
+	*ticket = t;
+	return 0;
+}
+
+/*
+ * Returns 0 when all the earlier waiters have left the queue, or -1 with
+ * errno set (EINTR on signal).
+ */
+static int queue_wait(int qfd, uint64_t ticket)
+{
+	if (ticket == 0)
+		return 0;
+
+	/* the predecessor holds its byte until it drops the lock */
+	if (queue_lock(qfd, F_RDLCK, QUEUE_SLOT(ticket - 1), F_OFD_SETLKW) != 0)
+		return -1;
+	queue_lock(qfd, F_UNLCK, QUEUE_SLOT(ticket - 1), F_OFD_SETLK);
+	return 0;
+}
+
+/* lets the next waiter go */
+static void queue_leave(int qfd, uint64_t ticket)
+{
+	queue_lock(qfd, F_UNLCK, QUEUE_SLOT(ticket), F_OFD_SETLK);
+}
+#endif /* F_OFD_SETLK */
+
+static void print_stats(const char *filename, int fd,
+			const struct timeval *wait, const struct timeval *hold)
+{
+	char name[sizeof(stringify_value(INT_MAX))];
+
+	if (!filename) {
+		snprintf(name, sizeof(name), "%d", fd);
+		filename = name;
+	}
+	if (hold)
+		fprintf(stderr, _("%s: %s: waited %"PRId64".%06"PRId64" seconds, "
+				  "held %"PRId64".%06"PRId64" seconds\n"),
+			program_invocation_short_name, filename,
+			(int64_t) wait->tv_sec, (int64_t) wait->tv_usec,
+			(int64_t) hold->tv_sec, (int64_t) hold->tv_usec);
+	else
+		fprintf(stderr, _("%s: %s: waited %"PRId64".%06"PRId64" seconds\n"),
+			program_invocation_short_name, filename,
+			(int64_t) wait->tv_sec, (int64_t) wait->tv_usec);
+}
+
 static int open_file(const char *filename, int *flags)
 {
 
@@ -138,7 +254,12 @@ int main(int argc, char *argv[])
 	int no_fork = 0;
 	int status;
 	int verbose = 0;
-	struct timeval time_start = { 0 }, time_done = { 0 };
+	int use_fcntl = 0;
+	int stats = 0;
+	const char *queue_file = NULL;
+	int qfd = -1;
+	uint64_t ticket = 0;
+	struct timeval time_start = { 0 }, time_done = { 0 }, delta = { 0 };
 	/*
 	 * The default exit code for lock conflict or timeout
 	 * is specified in man flock.1
@@ -147,7 +268,10 @@ int main(int argc, char *argv[])
 	char **cmd_argv = NULL, *sh_c_argv[4];
 	const char *filename = NULL;
 	enum {
-		OPT_VERBOSE = CHAR_MAX + 1
+		OPT_VERBOSE = CHAR_MAX + 1,
+		OPT_FCNTL,
+		OPT_QUEUE,
+		OPT_STATS
 	};
 	static const struct option long_options[] = {
 		{"shared", no_argument, NULL, 's'},
@@ -161,6 +285,9 @@ int main(int argc, char *argv[])
 		{"close", no_argument, NULL, 'o'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"verbose", no_argument, NULL, OPT_VERBOSE},
+		{"fcntl", no_argument, NULL, OPT_FCNTL},
+		{"queue", required_argument, NULL, OPT_QUEUE},
+		{"stats", no_argument, NULL, OPT_STATS},
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'V'},
 		{NULL, 0, NULL, 0}
@@ -218,6 +345,20 @@ int main(int argc, char *argv[])
 		case OPT_VERBOSE:
 			verbose = 1;
 			break;
+		case OPT_FCNTL:
+		case OPT_QUEUE:
+#ifdef F_OFD_SETLK
+			if (opt == OPT_FCNTL)
+				use_fcntl = 1;
+			else
+				queue_file = optarg;
+			break;
+#else
+			errx(EX_UNAVAILABLE, _("open file description locks are not supported"));
+#endif
+		case OPT_STATS:
+			stats = 1;
+			break;
 
 		case 'V':
 			print_version(EX_OK);
@@ -252,6 +393,9 @@ int main(int argc, char *argv[])
 		}
 
 		filename = argv[optind];
+		/* fcntl() write lock requires a writable file */
+		if (use_fcntl && type == LOCK_EX && access(filename, W_OK) == 0)
+			open_flags = O_RDWR;
 		fd = open_file(filename, &open_flags);
 
 	} else if (optind < argc) {
@@ -276,9 +420,38 @@ int main(int argc, char *argv[])
 				err(EX_OSERR, _("cannot set up timer"));
 	}
 
-	if (verbose)
+	if (verbose || stats)
 		gettime_monotonic(&time_start);
-	while (flock(fd, type | block)) {
+
+#ifdef F_OFD_SETLK
+	/* the queue is pointless for a lock request which does not wait */
+	if (queue_file && !block && type != LOCK_UN) {
+		int qflags = O_RDWR, rc;
+
+		qfd = open_file(queue_file, &qflags);
+		if (!(qflags & O_RDWR))
+			errx(EX_NOPERM, _("%s: queue file has to be writable"), queue_file);
+
+		do {
+			rc = queue_enter(qfd, &ticket);
+		} while (rc != 0 && errno == EINTR && !timeout_expired);
+
+		while (rc == 0 && (rc = queue_wait(qfd, ticket)) != 0 &&
+		       errno == EINTR && !timeout_expired)
+			;
+		if (rc != 0) {
+			if (errno == EINTR) {
+				/* -w option set and failed to get in turn */
+				if (verbose)
+					warnx(_("timeout while waiting to get lock"));
+				exit(conflict_exit_code);
+			}
+			err(errno == ENOLCK ? EX_OSERR : EX_DATAERR,
+			    _("%s: queue failed"), queue_file);
+		}
+	}
+#endif
+	while (do_lock(use_fcntl, fd, type, block)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* -n option set and failed to lock. */
@@ -326,11 +499,16 @@ int main(int argc, char *argv[])
 
 	if (have_timeout)
 		cancel_timer(&timer);
-	if (verbose) {
-		struct timeval delta = { 0 };
-
+	if (verbose || stats) {
 		gettime_monotonic(&time_done);
 		timersub(&time_done, &time_start, &delta);
+	}
+#ifdef F_OFD_SETLK
+	/* shared lock holders do not block the next waiter */
+	if (qfd >= 0 && type == LOCK_SH)
+		queue_leave(qfd, ticket);
+#endif
+	if (verbose) {
 		printf(_("%s: getting lock took %"PRId64".%06"PRId64" seconds\n"),
 		       program_invocation_short_name,
 		       (int64_t) delta.tv_sec,
@@ -354,6 +532,8 @@ int main(int argc, char *argv[])
 			else if (f == 0) {
 				if (do_close)
 					close(fd);
+				if (qfd >= 0)
+					close(qfd);
 				run_program(cmd_argv);
 
 			/* parent */
@@ -374,12 +554,26 @@ int main(int argc, char *argv[])
 				else
 					/* WTF? */
 					status = EX_OSERR;
+
+				if (stats) {
+					struct timeval now, hold;
+
+					gettime_monotonic(&now);
+					timersub(&now, &time_done, &hold);
+					print_stats(filename, fd, &delta, &hold);
+					stats = 0;
+				}
 			}
 
-		} else
+		} else {
 			/* no-fork execution */
+			if (stats)
+				print_stats(filename, fd, &delta, NULL);
 			run_program(cmd_argv);
+		}
 	}
 
+	if (stats)
+		print_stats(filename, fd, &delta, NULL);
 	return status;
 }
@@ -15,10 +15,14 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 #include <linux/fs.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <getopt.h>
 
 #include "c.h"
@@ -26,6 +30,9 @@
 #include "nls.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "strutils.h"
+#include "timeutils.h"
+#include "xalloc.h"
 
 enum fs_operation {
 	NOOP,
@@ -33,43 +40,206 @@ enum fs_operation {
 	UNFREEZE
 };
 
+struct fsfreeze_target {
+	const char	*path;
+	int		fd;
+	dev_t		dev;
+	unsigned int	frozen : 1;
+};
+
+struct fsfreeze_control {
+	struct fsfreeze_target	*targets;
+	size_t			ntargets;
+
+	struct timespec		timeout;	/* --timeout */
+	unsigned int		hold : 1,	/* wait for timeout or signal */
+				verbose : 1;
+};
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
-	      _(" %s [options] <mountpoint>\n"), program_invocation_short_name);
+	      _(" %s [options] <mountpoint>...\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Suspend access to a filesystem.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
-	fputs(_(" -f, --freeze      freeze the filesystem\n"), out);
-	fputs(_(" -u, --unfreeze    unfreeze the filesystem\n"), out);
+	fputs(_(" -f, --freeze          freeze the filesystem\n"), out);
+	fputs(_(" -u, --unfreeze        unfreeze the filesystem\n"), out);
+	fputs(_(" -t, --timeout <time>  keep frozen, unfreeze after <time> seconds or on signal\n"), out);
+	fputs(_(" -v, --verbose         report the freeze window\n"), out);
 	fputs(USAGE_SEPARATOR, out);
-	fprintf(out, USAGE_HELP_OPTIONS(19));
+	fprintf(out, USAGE_HELP_OPTIONS(23));
 	fprintf(out, USAGE_MAN_TAIL("fsfreeze(8)"));
 
 	exit(EXIT_SUCCESS);
 }
 
+static double elapsed_ms(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000.0
+		+ (b->tv_nsec - a->tv_nsec) / (double) NSEC_PER_MSEC;
+}
+
+static int open_target(struct fsfreeze_control *ctl, size_t idx)
+{
+	struct fsfreeze_target *tg = &ctl->targets[idx];
+	struct stat sb;
+	size_t i;
+
+	tg->fd = open(tg->path, O_RDONLY | O_CLOEXEC);
+	if (tg->fd < 0) {
+		warn(_("cannot open %s"), tg->path);
+		return -1;
+	}
+	if (fstat(tg->fd, &sb) == -1) {
+		warn(_("stat of %s failed"), tg->path);
+		return -1;
+	}
+	if (!S_ISDIR(sb.st_mode)) {
+		warnx(_("%s: is not a directory"), tg->path);
+		return -1;
+	}
+	tg->dev = sb.st_dev;
+
+	/* the second FIFREEZE on the same filesystem would fail */
+	for (i = 0; i < idx; i++) {
+		if (ctl->targets[i].dev == tg->dev) {
+			warnx(_("%s and %s are on the same filesystem"),
+					ctl->targets[i].path, tg->path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Flush all the filesystems in parallel before the freeze; FIFREEZE has to
+ * sync the filesystem too, but then it's fast and the first filesystem is
+ * not frozen for the time needed to flush the others.
+ */
+static void sync_targets(struct fsfreeze_control *ctl)
+{
+	size_t i, n = 0;
+
+	if (ctl->ntargets == 1) {
+		syncfs(ctl->targets[0].fd);
+		return;
+	}
+
+	for (i = 0; i < ctl->ntargets; i++) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			syncfs(ctl->targets[i].fd);
+			_exit(EXIT_SUCCESS);
+		}
+		if (pid < 0)
+			syncfs(ctl->targets[i].fd);
+		else
+			n++;
+	}
+
+	while (n > 0 && (wait(NULL) > 0 || errno == EINTR))
+		n--;
+}
+
+static int thaw_targets(struct fsfreeze_control *ctl)
+{
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < ctl->ntargets; i++) {
+		struct fsfreeze_target *tg = &ctl->targets[i];
+
+		if (!tg->frozen)
+			continue;
+		if (ioctl(tg->fd, FITHAW, 0)) {
+			warn(_("%s: unfreeze failed"), tg->path);
+			rc = -1;
+		} else
+			tg->frozen = 0;
+	}
+	return rc;
+}
+
+static int freeze_targets(struct fsfreeze_control *ctl)
+{
+	struct timespec start, frozen, end;
+	sigset_t sigs, oldsigs;
+	size_t i;
+	int rc = 0;
+
+	sync_targets(ctl);
+
+	/* don't leave the filesystems frozen if interrupted */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	sigaddset(&sigs, SIGHUP);
+	sigprocmask(SIG_BLOCK, &sigs, &oldsigs);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < ctl->ntargets; i++) {
+		struct fsfreeze_target *tg = &ctl->targets[i];
+
+		if (ioctl(tg->fd, FIFREEZE, 0)) {
+			warn(_("%s: freeze failed"), tg->path);
+			rc = -1;
+			break;
+		}
+		tg->frozen = 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &frozen);
+
+	if (rc) {
+		thaw_targets(ctl);
+		goto done;
+	}
+
+	if (ctl->verbose)
+		printf(_("froze %zu filesystem(s) in %.3f ms\n"),
+				ctl->ntargets, elapsed_ms(&start, &frozen));
+
+	if (!ctl->hold)
+		goto done;
+
+	if (sigtimedwait(&sigs, NULL, &ctl->timeout) < 0 && errno != EAGAIN)
+		warn(_("waiting for signal failed"));
+
+	rc = thaw_targets(ctl);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (ctl->verbose)
+		printf(_("thawed after %.3f ms\n"), elapsed_ms(&start, &end));
+done:
+	sigprocmask(SIG_SETMASK, &oldsigs, NULL);
+	return rc;
+}
+
 int main(int argc, char **argv)
 {
-	int fd = -1, c;
+	struct fsfreeze_control ctl = { .targets = NULL };
+	int c;
 	int action = NOOP, rc = EXIT_FAILURE;
-	char *path;
-	struct stat sb;
+	size_t i;
 
 	static const struct option longopts[] = {
-	    { "help",      no_argument, NULL, 'h' },
-	    { "freeze",    no_argument, NULL, 'f' },
-	    { "unfreeze",  no_argument, NULL, 'u' },
-	    { "version",   no_argument, NULL, 'V' },
+	    { "help",      no_argument,       NULL, 'h' },
+	    { "freeze",    no_argument,       NULL, 'f' },
+	    { "unfreeze",  no_argument,       NULL, 'u' },
+	    { "timeout",   required_argument, NULL, 't' },
+	    { "verbose",   no_argument,       NULL, 'v' },
+	    { "version",   no_argument,       NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'f','u' },			/* freeze, unfreeze */
+		{ 't','u' },			/* timeout, unfreeze */
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -79,7 +249,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "hfuV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hft:uvV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -90,6 +260,14 @@ int main(int argc, char **argv)
 		case 'u':
 			action = UNFREEZE;
 			break;
+		case 't':
+			strtotimespec_or_err(optarg, &ctl.timeout,
+					_("failed to parse timeout"));
+			ctl.hold = 1;
+			break;
+		case 'v':
+			ctl.verbose = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -104,39 +282,30 @@ int main(int argc, char **argv)
 		errx(EXIT_FAILURE, _("neither --freeze or --unfreeze specified"));
 	if (optind == argc)
 		errx(EXIT_FAILURE, _("no filename specified"));
-	path = argv[optind++];
-
-	if (optind != argc) {
-		warnx(_("unexpected number of arguments"));
-		errtryhelp(EXIT_FAILURE);
-	}
 
-	fd = open(path, O_RDONLY);
-	if (fd < 0)
-		err(EXIT_FAILURE, _("cannot open %s"), path);
+	ctl.ntargets = argc - optind;
+	ctl.targets = xcalloc(ctl.ntargets, sizeof(struct fsfreeze_target));
 
-	if (fstat(fd, &sb) == -1) {
-		warn(_("stat of %s failed"), path);
-		goto done;
+	for (i = 0; i < ctl.ntargets; i++) {
+		ctl.targets[i].path = argv[optind + i];
+		ctl.targets[i].fd = -1;
 	}
-
-	if (!S_ISDIR(sb.st_mode)) {
-		warnx(_("%s: is not a directory"), path);
-		goto done;
+	for (i = 0; i < ctl.ntargets; i++) {
+		if (open_target(&ctl, i) != 0)
+			goto done;
 	}
 
 	switch (action) {
 	case FREEZE:
-		if (ioctl(fd, FIFREEZE, 0)) {
-			warn(_("%s: freeze failed"), path);
+		if (freeze_targets(&ctl) != 0)
 			goto done;
-		}
 		break;
 	case UNFREEZE:
-		if (ioctl(fd, FITHAW, 0)) {
-			warn(_("%s: unfreeze failed"), path);
+		/* thaw all, even if some of them fail */
+		for (i = 0; i < ctl.ntargets; i++)
+			ctl.targets[i].frozen = 1;
+		if (thaw_targets(&ctl) != 0)
 			goto done;
-		}
 		break;
 	default:
 		abort();
@@ -144,6 +313,10 @@ int main(int argc, char **argv)
 
 	rc = EXIT_SUCCESS;
 done:
-	close(fd);
+	for (i = 0; i < ctl.ntargets; i++) {
+		if (ctl.targets[i].fd >= 0)
+			close(ctl.targets[i].fd);
+	}
+	free(ctl.targets);
 	return rc;
 }
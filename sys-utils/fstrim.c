@@ -32,10 +32,12 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <getopt.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/vfs.h>
+#include <sys/wait.h>
 #include <linux/fs.h>
 
 #include "nls.h"
@@ -47,6 +49,7 @@
 #include "sysfs.h"
 #include "optutils.h"
 #include "statfs_magic.h"
+#include "timeutils.h"
 
 #include <libmount.h>
 
@@ -63,6 +66,12 @@ struct fstrim_range {
 struct fstrim_control {
 	struct fstrim_range range;
 	char *type_pattern;
+	size_t jobs;		/* --jobs, max number of disks trimmed at once */
+
+	uint64_t chunk_size;	/* --chunk-size, 0 = one FITRIM for the range */
+	uint64_t rate;		/* --rate, max trimmed bytes per second */
+	unsigned int max_latency;	/* --max-latency, ms */
+	const char *resume_dir;	/* --resume */
 
 	unsigned int verbose : 1,
 		     quiet_unsupp : 1,
@@ -86,11 +95,214 @@ static int is_directory(const char *path, int silent)
 	return 1;
 }
 
+/*
+ * The chunked mode state file is <resume-dir>/<mountpoint with '/' replaced
+ * by '-'> and contains the next offset to trim.
+ */
+static char *get_resume_path(struct fstrim_control *ctl, const char *rpath)
+{
+	char *name, *p, *res;
+
+	name = xstrdup(*(rpath + 1) ? rpath + 1 : rpath);
+	for (p = name; *p; p++) {
+		if (*p == '/')
+			*p = '-';
+	}
+	xasprintf(&res, "%s/%s", ctl->resume_dir, name);
+	free(name);
+	return res;
+}
+
+static uint64_t load_resume_offset(const char *file)
+{
+	uintmax_t offset = 0;
+	FILE *f = fopen(file, "r" UL_CLOEXECSTR);
+
+	if (!f)
+		return 0;
+	if (fscanf(f, "%ju", &offset) != 1)
+		offset = 0;
+	fclose(f);
+	return offset;
+}
+
+static void save_resume_offset(const char *file, uint64_t offset)
+{
+	char *tmp;
+	FILE *f;
+
+	xasprintf(&tmp, "%s.tmp", file);
+
+	/* replace the file atomically, an interrupted run never leaves it truncated */
+	f = fopen(tmp, "w" UL_CLOEXECSTR);
+	if (!f) {
+		warn(_("cannot open %s"), tmp);
+		goto done;
+	}
+	fprintf(f, "%ju\n", (uintmax_t) offset);
+	if (close_stream(f) != 0)
+		warn(_("write failed: %s"), tmp);
+	else if (rename(tmp, file) != 0)
+		warn(_("cannot rename %s to %s"), tmp, file);
+done:
+	free(tmp);
+}
+
+/* number of completed I/Os and the time spent on them, without discards */
+struct fstrim_iostat {
+	uint64_t ios;
+	uint64_t ticks;		/* ms */
+};
+
+static int read_iostat(struct path_cxt *pc, struct fstrim_iostat *st)
+{
+	uint64_t rd_ios, rd_merges, rd_sectors, rd_ticks;
+	uint64_t wr_ios, wr_merges, wr_sectors, wr_ticks;
+
+	if (!pc || ul_path_scanf(pc, "stat",
+			"%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+			" %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+			&rd_ios, &rd_merges, &rd_sectors, &rd_ticks,
+			&wr_ios, &wr_merges, &wr_sectors, &wr_ticks) != 8)
+		return -1;
+
+	st->ios = rd_ios + wr_ios;
+	st->ticks = rd_ticks + wr_ticks;
+	return 0;
+}
+
+#define FSTRIM_DEFAULT_CHUNK	(1ULL << 30)		/* 1 GiB */
+#define FSTRIM_MIN_PAUSE	(10 * 1000)		/* usec */
+#define FSTRIM_MAX_PAUSE	(10 * 1000 * 1000)	/* usec */
+
+/*
+ * Walks the range by FITRIM calls of ctl->chunk_size bytes. After every chunk
+ * we sleep to keep the throughput below --rate and, if --max-latency is set,
+ * the pause is doubled while the average latency of the other (read and
+ * write) I/O on the device is above the limit and halved when it's below.
+ *
+ * Returns 0 and the number of trimmed bytes in range->len, or -1 and errno.
+ */
+static int fstrim_chunks(struct fstrim_control *ctl, int fd, const char *path,
+			 const char *rpath, struct fstrim_range *range)
+{
+	struct path_cxt *pc = NULL;
+	struct fstrim_iostat io_last = { 0 };
+	struct statfs vfs;
+	struct stat st;
+	struct timespec ts;
+	usec_t start, last_report;
+	uint64_t offset, end, trimmed = 0;
+	usec_t pause = 0;
+	char *resume = NULL;
+	int rc = 0, errsv;
+
+	if (fstatfs(fd, &vfs) != 0)
+		return -1;
+	end = (uint64_t) vfs.f_blocks * vfs.f_bsize;
+	if (range->len < end && range->start < end - range->len)
+		end = range->start + range->len;
+
+	offset = range->start;
+	if (ctl->resume_dir) {
+		resume = get_resume_path(ctl, rpath);
+		offset = max(offset, load_resume_offset(resume));
+		if (ctl->verbose && offset > range->start && offset < end)
+			printf(_("%s: resuming at offset %ju\n"), path, (uintmax_t) offset);
+	}
+
+	if (ctl->max_latency && fstat(fd, &st) == 0) {
+		pc = ul_new_sysfs_path(st.st_dev, NULL, NULL);
+		if (read_iostat(pc, &io_last) != 0) {
+			if (ctl->verbose)
+				warnx(_("%s: no I/O statistics, the latency limit is ignored"), path);
+			ul_unref_path(pc);
+			pc = NULL;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = last_report = timespec_to_usec(&ts);
+
+	while (offset < end) {
+		struct fstrim_range chunk = {
+			.start = offset,
+			.len = min(ctl->chunk_size, end - offset),
+			.minlen = range->minlen
+		};
+		struct fstrim_iostat io;
+		usec_t now, elapsed, wait = 0;
+
+		if (ioctl(fd, FITRIM, &chunk) != 0) {
+			rc = -1;
+			break;
+		}
+		offset += min(ctl->chunk_size, end - offset);
+		trimmed += chunk.len;
+
+		if (resume)
+			save_resume_offset(resume, offset);
+		if (offset >= end)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		now = timespec_to_usec(&ts);
+		elapsed = now - start;
+
+		/* bandwidth limit */
+		if (ctl->rate) {
+			usec_t target = (usec_t) ((long double) trimmed / ctl->rate * USEC_PER_SEC);
+
+			if (target > elapsed)
+				wait = target - elapsed;
+		}
+
+		/* adaptive backoff */
+		if (pc && read_iostat(pc, &io) == 0) {
+			uint64_t ios = io.ios - io_last.ios;
+
+			if (ios && (io.ticks - io_last.ticks) / ios > ctl->max_latency)
+				pause = pause ? min(pause * 2, (usec_t) FSTRIM_MAX_PAUSE)
+					      : FSTRIM_MIN_PAUSE;
+			else
+				pause = pause / 2 < FSTRIM_MIN_PAUSE ? 0 : pause / 2;
+			io_last = io;
+		}
+
+		if (ctl->verbose && now - last_report >= 10 * USEC_PER_SEC) {
+			printf(_("%s: %.0f%% done\n"), path,
+				(double) (offset - range->start) * 100.0 / (end - range->start));
+			fflush(stdout);
+			last_report = now;
+		}
+
+		wait = max(wait, pause);
+		while (wait) {
+			/* xusleep() takes useconds_t, keep it below a second */
+			usec_t n = min(wait, (usec_t) USEC_PER_SEC - 1);
+
+			xusleep(n);
+			wait -= n;
+		}
+	}
+
+	errsv = errno;
+	if (resume && rc == 0 && unlink(resume) != 0 && errno != ENOENT)
+		warn(_("cannot remove %s"), resume);
+	free(resume);
+	ul_unref_path(pc);
+
+	range->len = trimmed;
+	errno = errsv;
+	return rc;
+}
+
 /* returns: 0 = success, 1 = unsupported, < 0 = error */
 static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const char *devname)
 {
 	int fd = -1, rc;
 	struct fstrim_range range;
+	struct timespec start;
 	char *rpath = realpath(path, NULL);
 
 	if (!rpath) {
@@ -117,8 +329,13 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 		goto done;
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	errno = 0;
-	if (ioctl(fd, FITRIM, &range)) {
+	if (ctl->chunk_size)
+		rc = fstrim_chunks(ctl, fd, path, rpath, &range);
+	else
+		rc = ioctl(fd, FITRIM, &range);
+	if (rc) {
 		switch (errno) {
 		case EBADF:
 		case ENOTTY:
@@ -135,19 +352,31 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 	}
 
 	if (ctl->verbose) {
+		struct timespec end;
+		double secs;
 		char *str = size_to_human_string(
 				SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
 				(uint64_t) range.len);
+		char *rate;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		secs = (end.tv_sec - start.tv_sec)
+		       + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+		rate = size_to_human_string(
+				SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
+				secs > 0 ? (uint64_t) (range.len / secs) : range.len);
+
 		if (devname)
 			/* TRANSLATORS: The standard value here is a very large number. */
-			printf(_("%s: %s (%" PRIu64 " bytes) trimmed on %s\n"),
-				path, str, (uint64_t) range.len, devname);
+			printf(_("%s: %s (%" PRIu64 " bytes) trimmed on %s in %.3f s (%s/s)\n"),
+				path, str, (uint64_t) range.len, devname, secs, rate);
 		else
 			/* TRANSLATORS: The standard value here is a very large number. */
-			printf(_("%s: %s (%" PRIu64 " bytes) trimmed\n"),
-				path, str, (uint64_t) range.len);
+			printf(_("%s: %s (%" PRIu64 " bytes) trimmed in %.3f s (%s/s)\n"),
+				path, str, (uint64_t) range.len, secs, rate);
 
 		free(str);
+		free(rate);
 	}
 
 	rc = 0;
@@ -158,13 +387,15 @@ done:
 	return rc;
 }
 
-static int has_discard(const char *devname, struct path_cxt **wholedisk)
+static int has_discard(const char *devname, struct path_cxt **wholedisk,
+		       dev_t *diskno)
 {
 	struct path_cxt *pc = NULL;
 	uint64_t dg = 0;
 	dev_t disk = 0, dev;
 	int rc = -1, rdonly = 0;
 
+	*diskno = 0;
 	dev = sysfs_devname_to_devno(devname);
 	if (!dev)
 		goto fail;
@@ -182,6 +413,7 @@ static int has_discard(const char *devname, struct path_cxt **wholedisk)
 	rc = sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk);
 	if (rc != 0 || !disk)
 		goto fail;
+	*diskno = disk;
 
 	if (dev != disk) {
 		/* Partition, try reuse whole-disk context if valid for the
@@ -269,6 +501,146 @@ static int uniq_fs_source_cmp(
 	return !mnt_fs_streq_srcpath(a, mnt_fs_get_srcpath(b));
 }
 
+/* returns: 0 = success or unsupported, < 0 = error */
+static int fstrim_fs(struct fstrim_control *ctl, struct libmnt_fs *fs)
+{
+	const char *src = mnt_fs_get_srcpath(fs),
+		   *tgt = mnt_fs_get_target(fs);
+	int rc;
+
+	/*
+	 * We're able to detect that the device supports discard, but
+	 * things also depend on filesystem or device mapping, for
+	 * example LUKS (by default) does not support FSTRIM.
+	 *
+	 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
+	 * from discard ioctl.
+	 */
+	rc = fstrim_filesystem(ctl, tgt, src);
+	if (rc == 1 && !ctl->quiet_unsupp)
+		warnx(_("%s: the discard operation is not supported"), tgt);
+
+	return rc < 0 ? rc : 0;
+}
+
+struct fstrim_disk {
+	dev_t devno;			/* whole-disk, 0 if unknown */
+	pid_t pid;			/* child which trims the disk */
+
+	struct libmnt_fs **fss;		/* filesystems on the disk */
+	size_t nfss;
+};
+
+/*
+ * Trims the disks in child processes, at most ctl->jobs at once. The
+ * filesystems on the same disk are trimmed one by one, because concurrent
+ * discards on the same device only compete for the same queue.
+ *
+ * The child returns 0 if all its filesystems have been trimmed, 2 if all
+ * failed and 1 otherwise. That's good enough for the fstrim --all return
+ * code. Returns number of failed filesystems and sets @cnt to number of all
+ * filesystems.
+ */
+static int fstrim_parallel(struct fstrim_control *ctl, struct libmnt_table *tab,
+			   struct libmnt_iter *itr, int *cnt)
+{
+	struct fstrim_disk *disks = NULL;
+	struct libmnt_fs *fs;
+	size_t ndisks = 0, next = 0, running = 0, i;
+	int cnt_err = 0;
+
+	/* group the filesystems by disk */
+	while (mnt_table_next_fs(tab, itr, &fs) == 0) {
+		dev_t *devno = mnt_fs_get_userdata(fs);
+		struct fstrim_disk *d = NULL;
+
+		for (i = 0; i < ndisks; i++) {
+			if (disks[i].devno == (devno ? *devno : 0)) {
+				d = &disks[i];
+				break;
+			}
+		}
+		if (!d) {
+			disks = xreallocarray(disks, ndisks + 1, sizeof(*disks));
+			d = &disks[ndisks++];
+			memset(d, 0, sizeof(*d));
+			d->devno = devno ? *devno : 0;
+		}
+		d->fss = xreallocarray(d->fss, d->nfss + 1, sizeof(*d->fss));
+		d->fss[d->nfss++] = fs;
+		(*cnt)++;
+	}
+
+	/* don't duplicate buffered output in children */
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < ndisks || running) {
+		struct fstrim_disk *d = NULL;
+		int status;
+		pid_t pid;
+
+		if (next < ndisks && running < ctl->jobs) {
+			d = &disks[next++];
+
+			pid = fork();
+			if (pid < 0) {
+				warn(_("fork failed"));
+				cnt_err += d->nfss;
+				continue;
+			}
+			if (pid == 0) {
+				size_t nerrs = 0;
+
+				for (i = 0; i < d->nfss; i++) {
+					if (fstrim_fs(ctl, d->fss[i]) < 0)
+						nerrs++;
+					fflush(stdout);
+				}
+				exit(nerrs == 0 ? 0 : nerrs == d->nfss ? 2 : 1);
+			}
+			d->pid = pid;
+			running++;
+			continue;
+		}
+
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("waitpid failed"));
+			break;
+		}
+		for (i = 0; i < ndisks; i++) {
+			if (disks[i].pid == pid) {
+				d = &disks[i];
+				break;
+			}
+		}
+		if (!d)
+			continue;
+		running--;
+		d->pid = 0;
+
+		if (WIFEXITED(status)) {
+			if (WEXITSTATUS(status) == 2)
+				cnt_err += d->nfss;
+			else if (WEXITSTATUS(status))
+				cnt_err++;
+		} else {
+			if (WIFSIGNALED(status))
+				warnx(_("%s: trim terminated by signal %d"),
+					mnt_fs_get_target(d->fss[0]), WTERMSIG(status));
+			cnt_err += d->nfss;
+		}
+	}
+
+	for (i = 0; i < ndisks; i++)
+		free(disks[i].fss);
+	free(disks);
+	return cnt_err;
+}
+
 /*
  * -1 = tab empty
  *  0 = all success
@@ -282,7 +654,8 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	struct libmnt_table *tab;
 	struct libmnt_cache *cache = NULL;
 	struct path_cxt *wholedisk = NULL;
-	int cnt = 0, cnt_err = 0;
+	dev_t *disks;
+	int cnt = 0, cnt_err = 0, ndisks = 0;
 	int fstab = 0;
 
 	tab = mnt_new_table_from_file(filename);
@@ -328,6 +701,9 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	if (!itr)
 		err(MNT_EX_FAIL, _("failed to initialize libmount iterator"));
 
+	/* whole-disk devno for every filesystem, see fstrim_parallel() */
+	disks = xcalloc(mnt_table_get_nents(tab), sizeof(*disks));
+
 	/* Remove useless entries and canonicalize the table */
 	while (mnt_table_next_fs(tab, itr, &fs) == 0) {
 		const char *src = mnt_fs_get_srcpath(fs),
@@ -369,10 +745,11 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 		}
 
 		if (!is_directory(tgt, 1) ||
-		    !has_discard(src, &wholedisk)) {
+		    !has_discard(src, &wholedisk, &disks[ndisks])) {
 			mnt_table_remove_fs(tab, fs);
 			continue;
 		}
+		mnt_fs_set_userdata(fs, &disks[ndisks++]);
 	}
 
 	/* de-duplicate by source */
@@ -381,32 +758,21 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	mnt_reset_iter(itr, MNT_ITER_BACKWARD);
 
 	/* Do FITRIM */
-	while (mnt_table_next_fs(tab, itr, &fs) == 0) {
-		const char *src = mnt_fs_get_srcpath(fs),
-			   *tgt = mnt_fs_get_target(fs);
-		int rc;
-
-		cnt++;
-
-		/*
-		 * We're able to detect that the device supports discard, but
-		 * things also depend on filesystem or device mapping, for
-		 * example LUKS (by default) does not support FSTRIM.
-		 *
-		 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
-		 * from discard ioctl.
-		 */
-		rc = fstrim_filesystem(ctl, tgt, src);
-		if (rc < 0)
-		       cnt_err++;
-		else if (rc == 1 && !ctl->quiet_unsupp)
-			warnx(_("%s: the discard operation is not supported"), tgt);
+	if (ctl->jobs > 1)
+		cnt_err = fstrim_parallel(ctl, tab, itr, &cnt);
+	else {
+		while (mnt_table_next_fs(tab, itr, &fs) == 0) {
+			cnt++;
+			if (fstrim_fs(ctl, fs) < 0)
+				cnt_err++;
+		}
 	}
 	mnt_free_iter(itr);
 
 	ul_unref_path(wholedisk);
 	mnt_unref_table(tab);
 	mnt_unref_cache(cache);
+	free(disks);
 
 	if (cnt && cnt == cnt_err)
 		return MNT_EX_FAIL;		/* all failed */
@@ -467,6 +833,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -v, --verbose            print number of discarded bytes\n"), out);
 	fputs(_("     --quiet-unsupported  suppress error messages if trim unsupported\n"), out);
 	fputs(_(" -n, --dry-run            does everything, but trim\n"), out);
+	fputs(_(" -j, --jobs <num>         trim up to <num> disks in parallel with --all\n"), out);
+	fputs(_("     --chunk-size <num>   trim the range by chunks of <num> bytes\n"), out);
+	fputs(_("     --rate <num>         trim at most <num> bytes per second\n"), out);
+	fputs(_("     --max-latency <ms>   back off while the device I/O latency is higher\n"), out);
+	fputs(_("     --resume <dir>       save the progress to <dir>, continue from it\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
@@ -484,10 +855,15 @@ int main(int argc, char **argv)
 	char *tabs = NULL;
 	int c, rc, all = 0;
 	struct fstrim_control ctl = {
-			.range = { .len = ULLONG_MAX }
+			.range = { .len = ULLONG_MAX },
+			.jobs = 1
 	};
 	enum {
-		OPT_QUIET_UNSUPP = CHAR_MAX + 1
+		OPT_QUIET_UNSUPP = CHAR_MAX + 1,
+		OPT_CHUNK_SIZE,
+		OPT_RATE,
+		OPT_MAX_LATENCY,
+		OPT_RESUME
 	};
 
 	static const struct option longopts[] = {
@@ -503,6 +879,11 @@ int main(int argc, char **argv)
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "quiet-unsupported", no_argument,       NULL, OPT_QUIET_UNSUPP },
 	    { "dry-run",   no_argument,       NULL, 'n' },
+	    { "jobs",      required_argument, NULL, 'j' },
+	    { "chunk-size", required_argument, NULL, OPT_CHUNK_SIZE },
+	    { "rate",      required_argument, NULL, OPT_RATE },
+	    { "max-latency", required_argument, NULL, OPT_MAX_LATENCY },
+	    { "resume",    required_argument, NULL, OPT_RESUME },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -517,7 +898,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "AahI:l:m:no:t:Vv", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "AahI:j:l:m:no:t:Vv", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -537,6 +918,11 @@ int main(int argc, char **argv)
 		case 'n':
 			ctl.dryrun = 1;
 			break;
+		case 'j':
+			ctl.jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			if (!ctl.jobs)
+				errx(EXIT_FAILURE, _("number of jobs must be greater than zero"));
+			break;
 		case 'l':
 			ctl.range.len = strtosize_or_err(optarg,
 					_("failed to parse length"));
@@ -558,6 +944,23 @@ int main(int argc, char **argv)
 		case OPT_QUIET_UNSUPP:
 			ctl.quiet_unsupp = 1;
 			break;
+		case OPT_CHUNK_SIZE:
+			ctl.chunk_size = strtosize_or_err(optarg,
+					_("failed to parse chunk size"));
+			if (!ctl.chunk_size)
+				errx(EXIT_FAILURE, _("chunk size must be greater than zero"));
+			break;
+		case OPT_RATE:
+			ctl.rate = strtosize_or_err(optarg,
+					_("failed to parse rate"));
+			break;
+		case OPT_MAX_LATENCY:
+			ctl.max_latency = strtou32_or_err(optarg,
+					_("failed to parse latency"));
+			break;
+		case OPT_RESUME:
+			ctl.resume_dir = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -578,6 +981,12 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	/* the limits are applied between chunks */
+	if (!ctl.chunk_size && (ctl.rate || ctl.max_latency || ctl.resume_dir))
+		ctl.chunk_size = FSTRIM_DEFAULT_CHUNK;
+	if (ctl.resume_dir && !is_directory(ctl.resume_dir, 0))
+		return EXIT_FAILURE;
+
 	if (all)
 		return fstrim_all(&ctl, tabs);	/* MNT_EX_* codes */
 
@@ -590,6 +590,12 @@ set_hardware_clock_exact(const struct hwclock_control *ctl,
 				     (int64_t)nowsystime.tv_sec, (int64_t)nowsystime.tv_usec,
 				     (int64_t)targetsystime.tv_sec,
 				     (int64_t)targetsystime.tv_usec, deltavstarget));
+			/*
+			 * Sleep for the most of the remaining time rather
+			 * than burn CPU, spin for the last millisecond only.
+			 */
+			if (deltavstarget < -0.002)
+				xusleep((useconds_t) ((-deltavstarget - 0.001) * 1E6));
 			continue;  /* not there yet - keep spinning */
 		} else if (deltavstarget <= target_time_tolerance_secs) {
 			/* Close enough to the target time; done waiting. */
@@ -1008,6 +1014,92 @@ static void determine_clock_access_method(const struct hwclock_control *ctl)
 }
 
 /* Do all the normal work of hwclock - read, set clock, etc. */
+struct bench_stat {
+	double min, max, sum, sumsq;
+};
+
+static void bench_stat_add(struct bench_stat *st, unsigned int n, double x)
+{
+	if (!n || x < st->min)
+		st->min = x;
+	if (!n || x > st->max)
+		st->max = x;
+	st->sum += x;
+	st->sumsq += x * x;
+}
+
+static void bench_stat_print(const char *name, const struct bench_stat *st,
+			     unsigned int n)
+{
+	double avg = st->sum / n;
+
+	printf(_("%-16s min %.6f, avg %.6f, max %.6f, stddev %.6f seconds\n"),
+	       name, st->min, avg, st->max,
+	       sqrt(fmax(0, st->sumsq / n - avg * avg)));
+}
+
+/*
+ * Measures the time spent waiting for the RTC clock tick and reading the
+ * RTC, and the offset between the RTC and the system time right at the
+ * tick. The drift is estimated from the first and the last offset. The
+ * RTC is never written.
+ */
+static int bench_hardware_clock(const struct hwclock_control *ctl)
+{
+	struct hwclock_control bctl = *ctl;
+	struct bench_stat wait = { 0 }, rd = { 0 }, off = { 0 };
+	struct timeval first = { 0 }, last = { 0 };
+	double first_off = 0, last_off = 0;
+	unsigned int n;
+
+	bctl.verbose = 0;	/* don't print details about every read */
+
+	for (n = 0; n < ctl->bench_count; n++) {
+		struct timeval begin, tick, done;
+		time_t hwtime;
+		int valid = 0;
+		double x;
+
+		gettimeofday(&begin, NULL);
+		if (ur->synchronize_to_clock_tick(&bctl))
+			return EXIT_FAILURE;
+		gettimeofday(&tick, NULL);
+		if (read_hardware_clock(&bctl, &valid, &hwtime) || !valid) {
+			warnx(_("RTC read returned an invalid value."));
+			return EXIT_FAILURE;
+		}
+		gettimeofday(&done, NULL);
+
+		/* RTC has been exactly hwtime at the tick */
+		x = (double) hwtime - (tick.tv_sec + tick.tv_usec / 1E6);
+
+		if (ctl->verbose)
+			printf(_("tick wait %.6f, read %.6f, RTC - system %+.6f seconds\n"),
+			       time_diff(tick, begin), time_diff(done, tick), x);
+
+		bench_stat_add(&wait, n, time_diff(tick, begin));
+		bench_stat_add(&rd, n, time_diff(done, tick));
+		bench_stat_add(&off, n, x);
+
+		if (!n) {
+			first = tick;
+			first_off = x;
+		}
+		last = tick;
+		last_off = x;
+	}
+
+	printf(_("%-16s %u\n"), _("Samples:"), n);
+	bench_stat_print(_("Tick wait:"), &wait, n);
+	bench_stat_print(_("RTC read:"), &rd, n);
+	bench_stat_print(_("RTC - system:"), &off, n);
+
+	if (n > 1 && time_diff(last, first) > 0)
+		printf(_("%-16s %+.3f seconds/day\n"), _("Drift:"),
+		       (last_off - first_off) / time_diff(last, first) * 86400);
+	return EXIT_SUCCESS;
+}
+
 static int
 manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 		 const struct timeval startup_time, struct adjtime *adjtime)
@@ -1062,6 +1154,9 @@ manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 	if (ur->get_permissions())
 		return EXIT_FAILURE;
 
+	if (ctl->bench)
+		return bench_hardware_clock(ctl);
+
 	/*
 	 * Read and drift correct RTC time; except for RTC set functions
 	 * without the --update-drift option because: 1) it's not needed;
@@ -1240,6 +1335,7 @@ usage(void)
 	puts(_("     --vl-clear                  clear voltage low information"));
 #endif
 	puts(_("     --predict                   predict the drifted RTC time according to --date"));
+	puts(_("     --bench <count>             measure RTC tick wait, read latency and drift"));
 	fputs(USAGE_OPTIONS, stdout);
 	puts(_(" -u, --utc                       the RTC timescale is UTC"));
 	puts(_(" -l, --localtime                 the RTC timescale is Local"));
@@ -1300,6 +1396,7 @@ int main(int argc, char **argv)
 	/* Long only options. */
 	enum {
 		OPT_ADJFILE = CHAR_MAX + 1,
+		OPT_BENCH,
 		OPT_DATE,
 		OPT_DELAY,
 		OPT_DIRECTISA,
@@ -1356,12 +1453,13 @@ int main(int argc, char **argv)
 		{ "predict",      no_argument,       NULL, OPT_PREDICT    },
 		{ "get",          no_argument,       NULL, OPT_GET        },
 		{ "update-drift", no_argument,       NULL, OPT_UPDATE     },
+		{ "bench",        required_argument, NULL, OPT_BENCH      },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'a','r','s','w',
-		  OPT_GET, OPT_GETEPOCH, OPT_PREDICT,
+		  OPT_BENCH, OPT_GET, OPT_GETEPOCH, OPT_PREDICT,
 		  OPT_SET, OPT_SETEPOCH, OPT_SYSTZ },
 		{ 'l', 'u' },
 		{ OPT_ADJFILE, OPT_NOADJFILE },
@@ -1510,6 +1608,13 @@ int main(int argc, char **argv)
 		case OPT_UPDATE:
 			ctl.update = 1;		/* --update-drift */
 			break;
+		case OPT_BENCH:
+			ctl.bench_count = strtou32_or_err(optarg, _("invalid --bench argument"));
+			if (!ctl.bench_count)
+				errx(EXIT_FAILURE, _("invalid --bench argument"));
+			ctl.bench = 1;		/* --bench */
+			ctl.show = 0;
+			break;
 #ifdef __linux__
 		case 'f':
 			ctl.rtc_dev_name = optarg;	/* --rtc */
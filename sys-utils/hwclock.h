@@ -40,6 +40,7 @@ struct hwclock_control {
 #endif
 	char *param_get_option;
 	char *param_set_option;
+	unsigned int bench_count;	/* --bench <count> */
 	unsigned int
 		hwaudit_on:1,
 		adjust:1,
@@ -63,6 +64,7 @@ struct hwclock_control {
 		universal:1,	/* will store hw_clock_is_utc() return value */
 		vl_read:1,
 		vl_clear:1,
+		bench:1,
 		verbose:1;
 };
 
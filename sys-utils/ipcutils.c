@@ -110,6 +110,84 @@ int ipc_shm_get_limits(struct ipc_limits *lim)
 	return 0;
 }
 
+/*
+ * Counts the objects in /proc/sysvipc/{shm,msg,sem} and sums the fourth
+ * column (segment size, bytes in queue, number of semaphores) without
+ * storing the objects.
+ */
+static int proc_get_usage(const char *path, struct ipc_usage *use)
+{
+	char buf[BUFSIZ];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return 1;
+
+	if (fgets(buf, sizeof(buf), f) == NULL) {	/* header */
+		fclose(f);
+		return 1;
+	}
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		uint64_t num;
+
+		if (sscanf(buf, "%*d %*d %*o %"SCNu64, &num) != 1)
+			continue;
+		use->ids++;
+		use->total += num;
+	}
+	fclose(f);
+	return 0;
+}
+
+/*
+ * The *_INFO commands return the usage for the current IPC namespace
+ * without walking the objects; /proc is a fallback.
+ */
+int ipc_msg_get_usage(struct ipc_usage *use)
+{
+	struct msginfo msginfo;
+
+	memset(use, 0, sizeof(*use));
+
+	if (msgctl(0, MSG_INFO, (struct msqid_ds *) &msginfo) >= 0) {
+		use->ids = msginfo.msgpool;	/* used queues */
+		use->total = msginfo.msgtql;	/* bytes in all queues */
+		return 0;
+	}
+	return proc_get_usage(_PATH_PROC_SYSV_MSG, use);
+}
+
+int ipc_sem_get_usage(struct ipc_usage *use)
+{
+	struct seminfo seminfo;
+	union semun arg = { .array = (ushort *) &seminfo };
+
+	memset(use, 0, sizeof(*use));
+
+	if (semctl(0, 0, SEM_INFO, arg) >= 0) {
+		use->ids = seminfo.semusz;	/* used sets */
+		use->total = seminfo.semaem;	/* used semaphores */
+		return 0;
+	}
+	return proc_get_usage(_PATH_PROC_SYSV_SEM, use);
+}
+
+int ipc_shm_get_usage(struct ipc_usage *use)
+{
+	struct shm_info shm_info;
+
+	memset(use, 0, sizeof(*use));
+
+	if (shmctl(0, SHM_INFO, (struct shmid_ds *) &shm_info) >= 0) {
+		use->ids = shm_info.used_ids;
+		use->total = (uint64_t) shm_info.shm_tot * getpagesize();
+		return 0;
+	}
+	return proc_get_usage(_PATH_PROC_SYSV_SHM, use);
+}
+
 int ipc_shm_get_info(int id, struct shm_data **shmds)
 {
 	FILE *f;
@@ -229,6 +307,8 @@ void ipc_shm_free_info(struct shm_data *shmds)
 
 static void get_sem_elements(struct sem_data *p)
 {
+	unsigned short *vals;
+	union semun arg;
 	size_t i;
 
 	if (!p || !p->sem_nsems || p->sem_nsems > SIZE_MAX || p->sem_perm.id < 0)
@@ -236,13 +316,18 @@ static void get_sem_elements(struct sem_data *p)
 
 	p->elements = xcalloc(p->sem_nsems, sizeof(struct sem_elem));
 
+	/* all values by one call */
+	vals = xcalloc(p->sem_nsems, sizeof(unsigned short));
+	arg.array = vals;
+	if (semctl(p->sem_perm.id, 0, GETALL, arg) < 0)
+		err(EXIT_FAILURE, _("%s failed"), "semctl(GETALL)");
+
+	arg.val = 0;
+
 	for (i = 0; i < p->sem_nsems; i++) {
 		struct sem_elem *e = &p->elements[i];
-		union semun arg = { .val = 0 };
 
-		e->semval = semctl(p->sem_perm.id, i, GETVAL, arg);
-		if (e->semval < 0)
-			err(EXIT_FAILURE, _("%s failed"), "semctl(GETVAL)");
+		e->semval = vals[i];
 
 		e->ncount = semctl(p->sem_perm.id, i, GETNCNT, arg);
 		if (e->ncount < 0)
@@ -256,6 +341,7 @@ static void get_sem_elements(struct sem_data *p)
 		if (e->pid < 0)
 			err(EXIT_FAILURE, _("%s failed"), "semctl(GETPID)");
 	}
+	free(vals);
 }
 
 int ipc_sem_get_info(int id, struct sem_data **semds)
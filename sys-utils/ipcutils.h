@@ -119,6 +119,16 @@ extern int ipc_msg_get_limits(struct ipc_limits *lim);
 extern int ipc_sem_get_limits(struct ipc_limits *lim);
 extern int ipc_shm_get_limits(struct ipc_limits *lim);
 
+/* global usage, read without per-object data */
+struct ipc_usage {
+	uint64_t	ids;		/* used identifiers */
+	uint64_t	total;		/* semaphores, or bytes for shm and msg */
+};
+
+extern int ipc_msg_get_usage(struct ipc_usage *use);
+extern int ipc_sem_get_usage(struct ipc_usage *use);
+extern int ipc_shm_get_usage(struct ipc_usage *use);
+
 struct ipc_stat {
 	int		id;
 	key_t		key;
@@ -13,6 +13,7 @@
  */
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <locale.h>
 #include <stdbool.h>
@@ -25,8 +26,10 @@
 #include <libsmartcols.h>
 
 #include "c.h"
+#include "cctype.h"
 #include "nls.h"
 #include "pathnames.h"
+#include "path.h"
 #include "strutils.h"
 #include "xalloc.h"
 
@@ -47,6 +50,9 @@ static const struct colinfo infos[] = {
 	[COL_TOTAL] = {"TOTAL", 0.10, SCOLS_FL_RIGHT, N_("total count"), SCOLS_JSON_NUMBER},
 	[COL_DELTA] = {"DELTA", 0.10, SCOLS_FL_RIGHT, N_("delta count"), SCOLS_JSON_NUMBER},
 	[COL_NAME]  = {"NAME",  0.70, SCOLS_FL_TRUNC, N_("name"),        SCOLS_JSON_STRING},
+	[COL_AFFINITY]  = {"AFFINITY",  0.10, SCOLS_FL_RIGHT, N_("CPUs the interrupt may be routed to"), SCOLS_JSON_STRING},
+	[COL_EFFECTIVE] = {"EFFECTIVE", 0.10, SCOLS_FL_RIGHT, N_("CPUs the interrupt is routed to"),     SCOLS_JSON_STRING},
+	[COL_NODE]      = {"NODE",      0.05, SCOLS_FL_RIGHT, N_("NUMA node of the device"),            SCOLS_JSON_NUMBER},
 };
 
 /* make softirq friendly to end-user */
@@ -117,7 +123,7 @@ void irq_print_columns(FILE *f, int nodelta)
 	for (i = 0; i < ARRAY_SIZE(infos); i++) {
 		if (nodelta && i == COL_DELTA)
 			continue;
-		fprintf(f, "  %-5s  %s\n", infos[i].name, _(infos[i].help));
+		fprintf(f, "  %-9s  %s\n", infos[i].name, _(infos[i].help));
 	}
 }
 
@@ -168,6 +174,29 @@ static struct libscols_line *new_scols_line(struct libscols_table *table)
 	return line;
 }
 
+/*
+ * Returns content of /proc/irq/<irq>/<attr> (e.g. "smp_affinity_list") or NULL
+ * if the interrupt has no such attribute; softirqs and per-CPU vectors like
+ * "NMI" or "LOC" are not in /proc/irq/.
+ */
+char *irq_get_attribute(const struct irq_info *info, const char *attr)
+{
+	char path[PATH_MAX], buf[BUFSIZ];
+	const char *p;
+
+	for (p = info->irq; *p; p++) {
+		if (!c_isdigit(*p))
+			return NULL;
+	}
+	if (p == info->irq)
+		return NULL;
+
+	snprintf(path, sizeof(path), _PATH_PROC_IRQ "/%s/%s", info->irq, attr);
+	if (ul_path_read_buffer(NULL, buf, sizeof(buf), path) <= 0)
+		return NULL;
+	return xstrdup(buf);
+}
+
 static void add_scols_line(struct irq_output *out,
 			   struct irq_info *info,
 			   struct libscols_table *table)
@@ -191,6 +220,15 @@ static void add_scols_line(struct irq_output *out,
 		case COL_NAME:
 			xasprintf(&str, "%s", info->name);
 			break;
+		case COL_AFFINITY:
+			str = irq_get_attribute(info, "smp_affinity_list");
+			break;
+		case COL_EFFECTIVE:
+			str = irq_get_attribute(info, "effective_affinity_list");
+			break;
+		case COL_NODE:
+			str = irq_get_attribute(info, "node");
+			break;
 		default:
 			break;
 		}
@@ -231,15 +269,83 @@ static bool cpu_in_list(int cpu, size_t setsize, cpu_set_t *cpuset)
 }
 
 /*
- * irqinfo - parse the system's interrupts
+ * The /proc files are kept open and re-read by pread() into the same buffer
+ * on every refresh; irqtop reads them once per second.
  */
-static struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpuset)
+struct irq_file {
+	const char *path;
+	int fd;
+	char *buf;
+	size_t bufsz;
+};
+
+static struct irq_file irq_files[] = {
+	{ .path = _PATH_PROC_INTERRUPTS, .fd = -1 },
+	{ .path = _PATH_PROC_SOFTIRQS, .fd = -1 }
+};
+
+/* returns NUL-terminated content of the file or NULL on error */
+static char *read_irq_file(struct irq_file *f)
 {
-	FILE *irqfile;
-	char *line = NULL, *tmp;
 	size_t len = 0;
+	ssize_t rc;
+
+	if (f->fd < 0) {
+		f->fd = open(f->path, O_RDONLY | O_CLOEXEC);
+		if (f->fd < 0) {
+			warn(_("cannot open %s"), f->path);
+			return NULL;
+		}
+	}
+	if (!f->buf) {
+		f->bufsz = 16 * 1024;
+		f->buf = xmalloc(f->bufsz);
+	}
+
+	do {
+		if (f->bufsz - len < 2) {
+			f->bufsz *= 2;
+			f->buf = xrealloc(f->buf, f->bufsz);
+		}
+		rc = pread(f->fd, f->buf + len, f->bufsz - len - 1, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("cannot read %s"), f->path);
+			return NULL;
+		}
+		len += rc;
+	} while (rc > 0);
+
+	f->buf[len] = '\0';
+	return f->buf;
+}
+
+/* returns the next line and terminates it, @str is moved to the next one */
+static char *next_line(char **str)
+{
+	char *line = *str, *end;
+
+	if (!line || !*line)
+		return NULL;
+	end = strchr(line, '\n');
+	if (end) {
+		*end = '\0';
+		*str = end + 1;
+	} else
+		*str = NULL;
+	return line;
+}
+
+/*
+ * irqinfo - parse the system's interrupts
+ */
+struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpuset)
+{
+	char *data, *line, *tmp;
 	struct irq_stat *stat;
 	struct irq_info *curr;
+	size_t index;
 
 	/* NAME + ':' + 11 bytes/cpu + IRQ_NAME_LEN */
 	stat = xcalloc(1, sizeof(*stat));
@@ -247,19 +353,15 @@ static struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpus
 	stat->irq_info = xmalloc(sizeof(*stat->irq_info) * IRQ_INFO_LEN);
 	stat->nr_irq_info = IRQ_INFO_LEN;
 
-	if (softirq)
-		irqfile = fopen(_PATH_PROC_SOFTIRQS, "r");
-	else
-		irqfile = fopen(_PATH_PROC_INTERRUPTS, "r");
-	if (!irqfile) {
-		warn(_("cannot open %s"), _PATH_PROC_INTERRUPTS);
+	data = read_irq_file(&irq_files[softirq ? 1 : 0]);
+	if (!data)
 		goto free_stat;
-	}
 
 	/* read header firstly */
-	if (getline(&line, &len, irqfile) < 0) {
-		warn(_("cannot read %s"), _PATH_PROC_INTERRUPTS);
-		goto close_file;
+	line = next_line(&data);
+	if (!line) {
+		warnx(_("cannot read %s"), irq_files[softirq ? 1 : 0].path);
+		goto free_stat;
 	}
 
 	tmp = line;
@@ -269,18 +371,19 @@ static struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpus
 	}
 
 	stat->cpus =  xcalloc(stat->nr_active_cpu, sizeof(struct irq_cpu));
+	stat->cpu_counts = xreallocarray(NULL, stat->nr_irq_info * stat->nr_active_cpu,
+					 sizeof(*stat->cpu_counts));
 
 	/* parse each line of _PATH_PROC_INTERRUPTS */
-	while (getline(&line, &len, irqfile) >= 0) {
-		unsigned long count;
-		size_t index;
-		int length;
+	while ((line = next_line(&data))) {
+		unsigned long *counts;
 
 		tmp = strchr(line, ':');
 		if (!tmp)
 			continue;
 
-		length = strlen(line);
+		counts = stat->cpu_counts + stat->nr_irq * stat->nr_active_cpu;
+		memset(counts, 0, stat->nr_active_cpu * sizeof(*counts));
 
 		curr = stat->irq_info + stat->nr_irq++;
 		memset(curr, 0, sizeof(*curr));
@@ -289,52 +392,59 @@ static struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpus
 		ltrim_whitespace((unsigned char *)curr->irq);
 
 		tmp += 1;
-		for (index = 0; (index < stat->nr_active_cpu) && (tmp - line < length); index++) {
+		for (index = 0; index < stat->nr_active_cpu; index++) {
 			struct irq_cpu *cpu = &stat->cpus[index];
+			unsigned long count = 0;
 
-			if (sscanf(tmp, " %10lu", &count) != 1)
-				continue;
+			/* the counters are space separated decimal numbers */
+			while (*tmp == ' ' || *tmp == '\t')
+				tmp++;
+			if (!c_isdigit(*tmp))
+				break;
+			while (c_isdigit(*tmp))
+				count = count * 10 + (*tmp++ - '0');
+
+			counts[index] = count;
 			if (cpu_in_list(index, setsize, cpuset)) {
 				curr->total += count;
 				cpu->total += count;
 				stat->total_irq += count;
 			}
-
-			tmp += 11;
 		}
 
 		/* softirq always has no desc, add additional desc for softirq */
 		if (softirq)
 			get_softirq_desc(curr);
 		else {
-			if (tmp - line < length) {
-				/* strip all space before desc */
-				while (isspace(*tmp))
-					tmp++;
-				tmp = remove_repeated_spaces(tmp);
-				rtrim_whitespace((unsigned char *)tmp);
-				curr->name = xstrdup(tmp);
-			} else /* no irq name string, we have to set '\0' here */
-				curr->name = xstrdup("");
+			/* strip all space before desc */
+			while (isspace(*tmp))
+				tmp++;
+			tmp = remove_repeated_spaces(tmp);
+			rtrim_whitespace((unsigned char *)tmp);
+			curr->name = xstrdup(tmp);
 		}
 
 		if (stat->nr_irq == stat->nr_irq_info) {
 			stat->nr_irq_info *= 2;
 			stat->irq_info = xreallocarray(stat->irq_info, stat->nr_irq_info,
 						       sizeof(*stat->irq_info));
+			stat->cpu_counts = xreallocarray(stat->cpu_counts,
+						stat->nr_irq_info * stat->nr_active_cpu,
+						sizeof(*stat->cpu_counts));
 		}
 	}
-	fclose(irqfile);
-	free(line);
+
+	/* the matrix may have been moved by realloc, set the rows now */
+	for (index = 0; index < stat->nr_irq; index++)
+		stat->irq_info[index].cpu_count =
+			stat->cpu_counts + index * stat->nr_active_cpu;
 	return stat;
 
- close_file:
-	fclose(irqfile);
  free_stat:
 	free(stat->irq_info);
 	free(stat->cpus);
+	free(stat->cpu_counts);
 	free(stat);
-	free(line);
 	return NULL;
 }
 
@@ -352,6 +462,7 @@ void free_irqstat(struct irq_stat *stat)
 
 	free(stat->irq_info);
 	free(stat->cpus);
+	free(stat->cpu_counts);
 	free(stat);
 }
 
@@ -526,6 +637,121 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	return NULL;
 }
 
+/*
+ * Per-CPU x IRQ matrix. The cells are counts since boot, or rates per second
+ * since @prev when it is specified.
+ */
+struct libscols_table *get_scols_matrix_table(struct irq_output *out,
+					struct irq_stat *prev,
+					struct irq_stat *curr,
+					double interval,
+					size_t setsize,
+					cpu_set_t *cpuset)
+{
+	struct libscols_table *table;
+	struct libscols_column *cl;
+	struct irq_info *result;
+	unsigned long *deltas = NULL;
+	char colname[sizeof("cpu") + sizeof(stringify_value(LONG_MAX))];
+	size_t ncpus = curr->nr_active_cpu;
+	size_t i, j, size;
+
+	size = sizeof(*curr->irq_info) * curr->nr_irq;
+	result = xmalloc(size);
+	memcpy(result, curr->irq_info, size);
+
+	if (prev) {
+		/* the rows are re-pointed to the deltas, so they survive sorting */
+		deltas = xcalloc(curr->nr_irq * ncpus, sizeof(*deltas));
+
+		for (i = 0; i < curr->nr_irq; i++) {
+			struct irq_info *cur = &result[i];
+			struct irq_info *pre = i < prev->nr_irq ? &prev->irq_info[i] : NULL;
+			unsigned long *row = deltas + i * ncpus;
+
+			if (pre && prev->nr_active_cpu == ncpus
+			    && strcmp(pre->irq, cur->irq) == 0) {
+				cur->delta = cur->total - pre->total;
+				for (j = 0; j < ncpus; j++)
+					row[j] = cur->cpu_count[j] - pre->cpu_count[j];
+			}
+			cur->cpu_count = row;
+		}
+	}
+	sort_result(out, result, curr->nr_irq);
+
+	table = scols_new_table();
+	if (!table) {
+		warn(_("failed to initialize output table"));
+		goto done;
+	}
+	scols_table_enable_json(table, out->json);
+	scols_table_enable_noheadings(table, out->no_headings);
+	scols_table_enable_export(table, out->pairs);
+
+	if (out->json)
+		scols_table_set_name(table, "interrupts");
+
+	cl = scols_table_new_column(table, "IRQ", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto err;
+	if (out->json)
+		scols_column_set_json_type(cl, SCOLS_JSON_STRING);
+
+	for (i = 0; i < ncpus; i++) {
+		if (!cpu_in_list(i, setsize, cpuset))
+			continue;
+		snprintf(colname, sizeof(colname), "cpu%zu", i);
+		cl = scols_table_new_column(table, colname, 0, SCOLS_FL_RIGHT);
+		if (!cl)
+			goto err;
+		if (out->json)
+			scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+	}
+
+	cl = scols_table_new_column(table, "NAME", 0, SCOLS_FL_TRUNC);
+	if (!cl)
+		goto err;
+	if (out->json)
+		scols_column_set_json_type(cl, SCOLS_JSON_STRING);
+
+	for (i = 0; i < curr->nr_irq; i++) {
+		struct irq_info *info = &result[i];
+		struct libscols_line *ln = new_scols_line(table);
+		size_t n = 0;
+
+		if (!ln || scols_line_set_data(ln, n++, info->irq) != 0)
+			goto err;
+
+		for (j = 0; j < ncpus; j++) {
+			char *str;
+
+			if (!cpu_in_list(j, setsize, cpuset))
+				continue;
+			if (!prev)
+				xasprintf(&str, "%lu", info->cpu_count[j]);
+			else if (interval > 0)
+				xasprintf(&str, "%0.1f", info->cpu_count[j] / interval);
+			else
+				xasprintf(&str, "%lu", info->cpu_count[j]);
+
+			if (scols_line_refer_data(ln, n++, str) != 0)
+				err_oom();
+		}
+		if (scols_line_set_data(ln, n, info->name) != 0)
+			goto err;
+	}
+	goto done;
+ err:
+	warnx(_("failed to initialize output column"));
+	scols_unref_table(table);
+	table = NULL;
+ done:
+	free(result);
+	free(deltas);
+	return table;
+}
+
 struct libscols_table *get_scols_table(struct irq_output *out,
 					      struct irq_stat *prev,
 					      struct irq_stat **xstat,
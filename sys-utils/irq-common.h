@@ -22,6 +22,9 @@ enum {
 	COL_TOTAL,
 	COL_DELTA,
 	COL_NAME,
+	COL_AFFINITY,
+	COL_EFFECTIVE,
+	COL_NODE,
 
 	__COL_COUNT
 };
@@ -31,6 +34,7 @@ struct irq_info {
 	char *name;			/* descriptive name of this irq */
 	unsigned long total;		/* total count since system start up */
 	unsigned long delta;		/* delta count since previous update */
+	unsigned long *cpu_count;	/* per-CPU counts, nr_active_cpu items */
 };
 
 struct irq_cpu {
@@ -43,6 +47,7 @@ struct irq_stat {
 	unsigned long nr_irq_info;	/* number of irq info */
 	struct irq_info *irq_info;	/* array of irq_info */
 	struct irq_cpu *cpus;		 /* array of irq_cpu */
+	unsigned long *cpu_counts;	/* nr_irq x nr_active_cpu matrix */
 	size_t nr_active_cpu;		/* number of active cpu */
 	unsigned long total_irq;	/* total irqs */
 	unsigned long delta_irq;	/* delta irqs */
@@ -65,8 +70,11 @@ struct irq_output {
 };
 
 int irq_column_name_to_id(char const *const name, size_t const namesz);
+struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpuset);
 void free_irqstat(struct irq_stat *stat);
 
+char *irq_get_attribute(const struct irq_info *info, const char *attr);
+
 void irq_print_columns(FILE *f, int nodelta);
 
 void set_sort_func_by_name(struct irq_output *out, const char *name);
@@ -85,4 +93,11 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
                                         size_t setsize,
                                         cpu_set_t *cpuset);
 
+struct libscols_table *get_scols_matrix_table(struct irq_output *out,
+					struct irq_stat *prev,
+					struct irq_stat *curr,
+					double interval,
+					size_t setsize,
+					cpu_set_t *cpuset);
+
 #endif /* UTIL_LINUX_H_IRQ_COMMON */
@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <inttypes.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include <libsmartcols.h>
 
@@ -45,6 +46,7 @@ enum {
 	A_SET_CAPACITY,		/* set device capacity */
 	A_SET_DIRECT_IO,	/* set accessing backing file by direct io */
 	A_SET_BLOCKSIZE,	/* set logical block size of the loop device */
+	A_BATCH,		/* setup devices for many files */
 };
 
 enum {
@@ -463,7 +465,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fprintf(out,
 	      _(" %1$s [options] [<loopdev>]\n"
-		" %1$s [options] -f | <loopdev> <file>\n"),
+		" %1$s [options] -f | <loopdev> <file>\n"
+		" %1$s [options] --batch [<file>...]\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -472,6 +475,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	/* commands */
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --all                     list all used devices\n"), out);
+	fputs(_("     --batch [<file>...]       set up devices for many files at once\n"), out);
 	fputs(_(" -d, --detach <loopdev>...     detach one or more devices\n"), out);
 	fputs(_(" -D, --detach-all              detach all used devices\n"), out);
 	fputs(_(" -f, --find                    find first unused device\n"), out);
@@ -675,6 +679,192 @@ static int create_loop(struct loopdev_cxt *lc,
 	return rc;
 }
 
+/*
+ * losetup --batch
+ */
+struct batch_item {
+	const char	*file;
+	char		*device;	/* result */
+	int		nr;		/* pre-allocated device or -1 */
+	int		errsv;		/* errno on failure */
+};
+
+struct batch_queue {
+	pthread_mutex_t		lock;
+	struct batch_item	*items;
+	size_t			nitems;
+	size_t			next;
+
+	/* the same setup for all devices */
+	int		lo_flags;
+	int		flags;
+	const char	*refname;
+	uint64_t	offset;
+	uint64_t	sizelimit;
+	uint64_t	blocksize;	/* 0 = backing device sector size */
+	unsigned int	auto_dio : 1;	/* direct I/O not requested by user */
+};
+
+static int batch_setup_item(struct batch_queue *q, struct batch_item *it)
+{
+	struct loopdev_cxt lc;
+	uint64_t blocksize = q->blocksize;
+	int lo_flags = q->lo_flags;
+	int rc, ntries = 0, nr = it->nr;
+
+	if (loopcxt_init(&lc, 0)) {
+		it->errsv = ENOMEM;
+		return -ENOMEM;
+	}
+
+	if (!blocksize)
+		blocksize = loopdev_get_backing_blocksize(it->file);
+
+	do {
+		rc = nr >= 0 ? loopcxt_set_reserved_device(&lc, nr) :
+			       loopcxt_find_unused(&lc);
+		if (rc) {
+			errno = rc < 0 ? -rc : ENOENT;
+			break;
+		}
+		if (q->flags & LOOPDEV_FL_OFFSET)
+			loopcxt_set_offset(&lc, q->offset);
+		if (q->flags & LOOPDEV_FL_SIZELIMIT)
+			loopcxt_set_sizelimit(&lc, q->sizelimit);
+		if (lo_flags)
+			loopcxt_set_flags(&lc, lo_flags);
+		if (blocksize > 0)
+			loopcxt_set_blocksize(&lc, blocksize);
+		if (q->refname && (rc = loopcxt_set_refname(&lc, q->refname)))
+			break;
+		if ((rc = loopcxt_set_backing_file(&lc, it->file)))
+			break;
+
+		errno = 0;
+		rc = loopcxt_setup_device(&lc);
+		if (rc == 0) {
+			it->device = loopcxt_strdup_device(&lc);
+			break;
+		}
+		if (errno == EINVAL && q->auto_dio && (lo_flags & LO_FLAGS_DIRECT_IO)) {
+			/* backing file does not support O_DIRECT (e.g. tmpfs) */
+			lo_flags &= ~LO_FLAGS_DIRECT_IO;
+			continue;
+		}
+		if (errno != EBUSY && errno != EAGAIN)
+			break;
+
+		/* the device has been used by someone else, try any other */
+		if (nr >= 0)
+			nr = -1;
+		else
+			xusleep(200000);
+	} while (ntries++ < 64);
+
+	if (rc)
+		it->errsv = errno ? errno : EINVAL;
+	loopcxt_deinit(&lc);
+	return rc;
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch_queue *q = data;
+
+	for (;;) {
+		struct batch_item *it = NULL;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->next < q->nitems)
+			it = &q->items[q->next++];
+		pthread_mutex_unlock(&q->lock);
+
+		if (!it)
+			break;
+		batch_setup_item(q, it);
+	}
+	return NULL;
+}
+
+static char **batch_read_files(size_t *count)
+{
+	char **files = NULL, *line = NULL;
+	size_t n = 0, sz = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &sz, stdin)) >= 0) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len || *line == '#')
+			continue;
+		files = xreallocarray(files, n + 1, sizeof(char *));
+		files[n++] = xstrdup(line);
+	}
+	free(line);
+	*count = n;
+	return files;
+}
+
+/*
+ * Sets up loop devices for all @files. The devices are pre-allocated by
+ * LOOP_CTL_ADD and configured in parallel threads. Returns number of
+ * failed files.
+ */
+static size_t batch_create_loops(struct loopdev_cxt *lc, struct batch_queue *q,
+				 char **files, size_t nfiles)
+{
+	pthread_t *threads;
+	size_t i, nthreads, nfailed = 0;
+	int *nums, nres;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	q->items = xcalloc(nfiles, sizeof(struct batch_item));
+	q->nitems = nfiles;
+
+	nums = xcalloc(nfiles, sizeof(int));
+	nres = loopcxt_reserve_unused(lc, nums, nfiles);
+	for (i = 0; i < nfiles; i++) {
+		q->items[i].file = files[i];
+		q->items[i].nr = nres > 0 && i < (size_t) nres ? nums[i] : -1;
+	}
+	free(nums);
+
+	nthreads = min((size_t) (ncpus > 0 ? ncpus : 1), nfiles);
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	pthread_mutex_init(&q->lock, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		errno = pthread_create(&threads[i], NULL, batch_worker, q);
+		if (errno) {
+			warn(_("failed to create thread"));
+			break;
+		}
+	}
+	nthreads = i;
+	if (!nthreads)
+		batch_worker(q);	/* no thread, do it in this thread */
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&q->lock);
+	free(threads);
+
+	for (i = 0; i < nfiles; i++) {
+		struct batch_item *it = &q->items[i];
+
+		if (it->device) {
+			printf("%s: %s\n", it->device, it->file);
+			free(it->device);
+		} else {
+			errno = it->errsv;
+			warn(_("%s: failed to set up loop device"), it->file);
+			nfailed++;
+		}
+	}
+	free(q->items);
+	return nfailed;
+}
+
 int main(int argc, char **argv)
 {
 	struct loopdev_cxt lc;
@@ -692,10 +882,12 @@ int main(int argc, char **argv)
 		OPT_RAW,
 		OPT_REF,
 		OPT_DIO,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_BATCH
 	};
 	static const struct option longopts[] = {
 		{ "all",          no_argument,       NULL, 'a'           },
+		{ "batch",        no_argument,       NULL, OPT_BATCH     },
 		{ "set-capacity", required_argument, NULL, 'c'           },
 		{ "detach",       required_argument, NULL, 'd'           },
 		{ "detach-all",   no_argument,       NULL, 'D'           },
@@ -723,10 +915,11 @@ int main(int argc, char **argv)
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
-		{ 'D','a','c','d','f','j' },
-		{ 'D','c','d','f','l' },
-		{ 'D','c','d','f','O' },
+		{ 'D','a','c','d','f','j',OPT_BATCH },
+		{ 'D','c','d','f','l',OPT_BATCH },
+		{ 'D','c','d','f','O',OPT_BATCH },
 		{ 'J',OPT_RAW },
+		{ 'L',OPT_BATCH },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -748,6 +941,9 @@ int main(int argc, char **argv)
 		case 'a':
 			act = A_SHOW;
 			break;
+		case OPT_BATCH:
+			act = A_BATCH;
+			break;
 		case 'b':
 			set_blocksize = 1;
 			blocksize = strtosize_or_err(optarg, _("failed to parse logical block size"));
@@ -918,14 +1114,14 @@ int main(int argc, char **argv)
 		file = argv[optind++];
 	}
 
-	if (act != A_CREATE &&
+	if (act != A_CREATE && act != A_BATCH &&
 	    (sizelimit || lo_flags || showdev))
 		errx(EXIT_FAILURE,
 			_("the options %s are allowed during loop device setup only"),
 			"--{sizelimit,partscan,read-only,show}");
 
 	if ((flags & LOOPDEV_FL_OFFSET) &&
-	    act != A_CREATE && (act != A_SHOW || !file))
+	    act != A_CREATE && act != A_BATCH && (act != A_SHOW || !file))
 		errx(EXIT_FAILURE, _("the option --offset is not allowed in this context"));
 
 	if (outarg && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
@@ -942,6 +1138,41 @@ int main(int argc, char **argv)
 			warn_size(file, sizelimit, offset, flags);
 		}
 		break;
+	case A_BATCH:
+	{
+		struct batch_queue q = {
+			.lo_flags = lo_flags,
+			.flags = flags,
+			.refname = refname,
+			.offset = offset,
+			.sizelimit = sizelimit,
+			.blocksize = blocksize
+		};
+		char **files;
+		size_t nfiles, i;
+
+		/* direct I/O is used by default, unless --direct-io=off */
+		if (!set_dio) {
+			q.lo_flags |= LO_FLAGS_DIRECT_IO;
+			q.auto_dio = 1;
+		}
+		if (optind < argc) {
+			nfiles = argc - optind;
+			files = xcalloc(nfiles, sizeof(char *));
+			for (i = 0; i < nfiles; i++)
+				files[i] = xstrdup(argv[optind + i]);
+		} else
+			files = batch_read_files(&nfiles);
+		if (!nfiles)
+			errx(EXIT_FAILURE, _("no file specified"));
+
+		res = batch_create_loops(&lc, &q, files, nfiles) ? 1 : 0;
+
+		for (i = 0; i < nfiles; i++)
+			free(files[i]);
+		free(files);
+		break;
+	}
 	case A_DELETE:
 		res = delete_loop(&lc);
 		while (optind < argc) {
@@ -0,0 +1,376 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Periodic sampling of CPU frequency and idle states (lscpu --interval).
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <libsmartcols.h>
+
+#include "lscpu.h"
+#include "timeutils.h"
+
+/* x86 model specific registers, readable by /dev/cpu/<N>/msr (root only) */
+#define MSR_IA32_TSC		0x10
+#define MSR_IA32_MPERF		0xe7
+#define MSR_IA32_APERF		0xe8
+
+/* maximal number of cpuidle states per CPU */
+#define MONITOR_MAX_CSTATES	16
+
+struct monitor_sample {
+	uint64_t	tsc;
+	uint64_t	mperf;		/* ticks at base frequency in C0 */
+	uint64_t	aperf;		/* ticks at actual frequency in C0 */
+	uint64_t	cstate_time[MONITOR_MAX_CSTATES];	/* usec */
+	float		cur_freq;	/* MHz from cpufreq, or 0 */
+
+	unsigned int	has_msr : 1;
+};
+
+struct monitor_cpu {
+	struct lscpu_cpu	*cpu;
+	int			node;		/* index to cxt->nodemaps or -1 */
+	int			socket;		/* index or physical ID, -1 if unknown */
+	int			core;
+
+	int			msr_fd;
+	size_t			ncstates;
+	char			*cstate_names[MONITOR_MAX_CSTATES];
+
+	struct monitor_sample	prev;
+	unsigned int		has_prev : 1;
+};
+
+enum {
+	COL_MON_CPU,
+	COL_MON_CORE,
+	COL_MON_SOCKET,
+	COL_MON_NODE,
+	COL_MON_MHZ,
+	COL_MON_EFFMHZ,
+	COL_MON_BUSY,
+	COL_MON_IDLE,
+	COL_MON_CSTATES
+};
+
+static const struct {
+	const char	*name;
+	int		flags;
+	int		json_type;
+} monitor_columns[] = {
+	[COL_MON_CPU]     = { "CPU",     SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_CORE]    = { "CORE",    SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_SOCKET]  = { "SOCKET",  SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_NODE]    = { "NODE",    SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_MHZ]     = { "MHZ",     SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_EFFMHZ]  = { "EFFMHZ",  SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_BUSY]    = { "BUSY%",   SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_IDLE]    = { "IDLE%",   SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER },
+	[COL_MON_CSTATES] = { "CSTATES", 0,              SCOLS_JSON_STRING }
+};
+
+static int monitor_get_id(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu,
+			  int physid, cpu_set_t **maps, size_t nmaps)
+{
+	size_t i;
+
+	if (cxt->show_physical)
+		return physid;
+	if (maps && cpuset_ary_isset(cpu->logical_id, maps, nmaps,
+				     cxt->setsize, &i) == 0)
+		return (int) i;
+	return -1;
+}
+
+static int monitor_read_msr(int fd, off_t reg, uint64_t *val)
+{
+	return pread(fd, val, sizeof(*val), reg) == sizeof(*val) ? 0 : -1;
+}
+
+static void monitor_init_cpu(struct lscpu_cxt *cxt, struct monitor_cpu *mc,
+			     struct lscpu_cpu *cpu)
+{
+	struct lscpu_cputype *ct = cpu->type;
+	int num = cpu->logical_id;
+	size_t i;
+
+	mc->cpu = cpu;
+	mc->msr_fd = -1;
+	mc->node = -1;
+
+	if (cpuset_ary_isset(num, cxt->nodemaps, cxt->nnodes,
+			     cxt->setsize, &i) == 0)
+		mc->node = cxt->idx2nodenum[i];
+
+	mc->core = monitor_get_id(cxt, cpu, cpu->coreid,
+			ct ? ct->coremaps : NULL, ct ? ct->ncores : 0);
+	mc->socket = monitor_get_id(cxt, cpu, cpu->socketid,
+			ct ? ct->socketmaps : NULL, ct ? ct->nsockets : 0);
+
+	for (i = 0; i < MONITOR_MAX_CSTATES; i++) {
+		char *name = NULL;
+
+		if (ul_path_readf_string(cxt->syscpu, &name,
+				"cpu%d/cpuidle/state%zu/name", num, i) <= 0)
+			break;
+		mc->cstate_names[i] = name;
+	}
+	mc->ncstates = i;
+
+	/* APERF/MPERF are not available for --sysroot */
+	if (!cxt->noalive) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "/dev/cpu/%d/msr", num);
+		mc->msr_fd = open(path, O_RDONLY | O_CLOEXEC);
+	}
+
+	DBG(CPU, ul_debugobj(cpu, "#%d monitor: %zu cstates, msr %s",
+				num, mc->ncstates, mc->msr_fd >= 0 ? "yes" : "no"));
+}
+
+static void monitor_read_sample(struct lscpu_cxt *cxt, struct monitor_cpu *mc,
+				struct monitor_sample *sm)
+{
+	int num = mc->cpu->logical_id;
+	uint64_t khz;
+	size_t i;
+
+	memset(sm, 0, sizeof(*sm));
+
+	if (ul_path_readf_u64(cxt->syscpu, &khz,
+			"cpu%d/cpufreq/scaling_cur_freq", num) == 0)
+		sm->cur_freq = khz / 1000.0;
+
+	for (i = 0; i < mc->ncstates; i++)
+		ul_path_readf_u64(cxt->syscpu, &sm->cstate_time[i],
+				"cpu%d/cpuidle/state%zu/time", num, i);
+
+	if (mc->msr_fd >= 0
+	    && monitor_read_msr(mc->msr_fd, MSR_IA32_TSC, &sm->tsc) == 0
+	    && monitor_read_msr(mc->msr_fd, MSR_IA32_MPERF, &sm->mperf) == 0
+	    && monitor_read_msr(mc->msr_fd, MSR_IA32_APERF, &sm->aperf) == 0)
+		sm->has_msr = 1;
+}
+
+static void monitor_sprintf(struct libscols_line *ln, int col, const char *fmt, ...)
+{
+	va_list ap;
+	char *str;
+
+	va_start(ap, fmt);
+	xvasprintf(&str, fmt, ap);
+	va_end(ap);
+
+	if (scols_line_refer_data(ln, col, str))
+		err(EXIT_FAILURE, _("failed to add output data"));
+}
+
+/* missing data are "-" in readable output and null in JSON */
+static void monitor_set_none(struct libscols_table *tb,
+			     struct libscols_line *ln, int col)
+{
+	if (!scols_table_is_json(tb))
+		scols_line_set_data(ln, col, "-");
+}
+
+static void monitor_set_id(struct libscols_table *tb,
+			   struct libscols_line *ln, int col, int id)
+{
+	if (id >= 0)
+		monitor_sprintf(ln, col, "%d", id);
+	else
+		monitor_set_none(tb, ln, col);
+}
+
+static void monitor_add_line(struct libscols_table *tb, struct monitor_cpu *mc,
+			     struct monitor_sample *sm, double secs)
+{
+	struct monitor_sample *prev = &mc->prev;
+	struct libscols_line *ln;
+	size_t i;
+
+	ln = scols_table_new_line(tb, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	monitor_sprintf(ln, COL_MON_CPU, "%d", mc->cpu->logical_id);
+	monitor_set_id(tb, ln, COL_MON_CORE, mc->core);
+	monitor_set_id(tb, ln, COL_MON_SOCKET, mc->socket);
+	monitor_set_id(tb, ln, COL_MON_NODE, mc->node);
+
+	if (sm->cur_freq > 0)
+		monitor_sprintf(ln, COL_MON_MHZ, "%.0f", sm->cur_freq);
+	else
+		monitor_set_none(tb, ln, COL_MON_MHZ);
+
+	/* the first sample has no deltas */
+	if (!mc->has_prev || secs <= 0) {
+		for (i = COL_MON_EFFMHZ; i < ARRAY_SIZE(monitor_columns); i++)
+			monitor_set_none(tb, ln, i);
+		return;
+	}
+
+	if (sm->has_msr && prev->has_msr
+	    && sm->tsc > prev->tsc && sm->mperf > prev->mperf) {
+		double tsc = sm->tsc - prev->tsc,
+		       mperf = sm->mperf - prev->mperf,
+		       aperf = sm->aperf - prev->aperf;
+
+		/* average frequency while not idle, TSC ticks at base
+		 * frequency */
+		monitor_sprintf(ln, COL_MON_EFFMHZ, "%.0f",
+				aperf / mperf * tsc / secs / 1000000.0);
+		monitor_sprintf(ln, COL_MON_BUSY, "%.1f",
+				min(mperf / tsc, 1.0) * 100.0);
+	} else {
+		monitor_set_none(tb, ln, COL_MON_EFFMHZ);
+		monitor_set_none(tb, ln, COL_MON_BUSY);
+	}
+
+	if (mc->ncstates) {
+		char buf[BUFSIZ], *p = buf;
+		size_t sz = sizeof(buf);
+		double idle = 0;
+
+		*buf = '\0';
+		for (i = 0; i < mc->ncstates; i++) {
+			double usec = sm->cstate_time[i] - prev->cstate_time[i];
+			double pct = min(usec / (secs * 1000000.0), 1.0) * 100.0;
+			int x;
+
+			/* POLL is a busy loop, not a C-state */
+			if (strcmp(mc->cstate_names[i], "POLL") != 0)
+				idle += pct;
+
+			x = snprintf(p, sz, "%s%s:%.1f",
+					p == buf ? "" : " ",
+					mc->cstate_names[i], pct);
+			if (x < 0 || (size_t) x >= sz)
+				break;
+			p += x;
+			sz -= x;
+		}
+		monitor_sprintf(ln, COL_MON_IDLE, "%.1f", min(idle, 100.0));
+		scols_line_set_data(ln, COL_MON_CSTATES, buf);
+	} else {
+		monitor_set_none(tb, ln, COL_MON_IDLE);
+		monitor_set_none(tb, ln, COL_MON_CSTATES);
+	}
+}
+
+/* sort by NUMA node, socket, core and CPU to keep siblings together */
+static int cmp_monitor_cpu(const void *a0, const void *b0)
+{
+	const struct monitor_cpu
+		*a = (const struct monitor_cpu *) a0,
+		*b = (const struct monitor_cpu *) b0;
+
+	if (a->node != b->node)
+		return a->node < b->node ? -1 : 1;
+	if (a->socket != b->socket)
+		return a->socket < b->socket ? -1 : 1;
+	if (a->core != b->core)
+		return a->core < b->core ? -1 : 1;
+	return a->cpu->logical_id - b->cpu->logical_id;
+}
+
+/*
+ * Prints per-CPU frequency, effective frequency (x86 APERF/MPERF) and
+ * cpuidle states residency every @interval until interrupted.
+ */
+void lscpu_monitor(struct lscpu_cxt *cxt, const struct timespec *interval)
+{
+	struct monitor_cpu *mons;
+	struct timespec next, last;
+	size_t i, nmons = 0;
+
+	mons = xcalloc(cxt->npossibles, sizeof(struct monitor_cpu));
+
+	for (i = 0; i < cxt->npossibles; i++) {
+		struct lscpu_cpu *cpu = cxt->cpus[i];
+
+		if (!cpu || !cpu->type)
+			continue;
+		if (cxt->online) {
+			if (!cxt->show_offline && !is_cpu_online(cxt, cpu))
+				continue;
+			if (!cxt->show_online && is_cpu_online(cxt, cpu))
+				continue;
+		}
+		if (cxt->present && !is_cpu_present(cxt, cpu))
+			continue;
+		monitor_init_cpu(cxt, &mons[nmons++], cpu);
+	}
+	if (!nmons)
+		errx(EXIT_FAILURE, _("no CPU to monitor"));
+
+	qsort(mons, nmons, sizeof(struct monitor_cpu), cmp_monitor_cpu);
+
+	scols_init_debug(0);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	last = next;
+
+	for (;;) {
+		struct libscols_table *tb;
+		struct timespec now;
+		double secs;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		secs = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+		last = now;
+
+		tb = scols_new_table();
+		if (!tb)
+			err(EXIT_FAILURE, _("failed to allocate output table"));
+		if (cxt->json) {
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "cpus");
+		}
+
+		for (i = 0; i < ARRAY_SIZE(monitor_columns); i++) {
+			struct libscols_column *cl;
+
+			cl = scols_table_new_column(tb, monitor_columns[i].name,
+					0, monitor_columns[i].flags);
+			if (!cl)
+				err(EXIT_FAILURE, _("failed to allocate output column"));
+			if (cxt->json)
+				scols_column_set_json_type(cl, monitor_columns[i].json_type);
+		}
+
+		for (i = 0; i < nmons; i++) {
+			struct monitor_cpu *mc = &mons[i];
+			struct monitor_sample sm;
+
+			monitor_read_sample(cxt, mc, &sm);
+			monitor_add_line(tb, mc, &sm, secs);
+			mc->prev = sm;
+			mc->has_prev = 1;
+		}
+
+		scols_print_table(tb);
+		scols_unref_table(tb);
+		fputc('\n', stdout);
+		fflush(stdout);
+
+		/* fixed interval, the time spent on the output is not added */
+		next.tv_sec += interval->tv_sec;
+		next.tv_nsec += interval->tv_nsec;
+		if (next.tv_nsec >= (long) NSEC_PER_SEC) {
+			next.tv_sec++;
+			next.tv_nsec -= NSEC_PER_SEC;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+	}
+}
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Copy of /sys and /proc files used by lscpu, the result is usable by
+ * "lscpu --sysroot <dir>" (see also tests/ts/lscpu/mk-input.sh).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "lscpu.h"
+#include "fileutils.h"
+
+/* max size of the copied file, the sysfs attributes are small */
+#define SNAPSHOT_MAX_FILESZ	(1024 * 1024)
+
+/* files and directories read by lscpu, relative to the system root */
+static const char *const snapshot_paths[] = {
+	"proc/cpuinfo",
+	"proc/sysinfo",
+	"proc/bus/pci/devices",
+	"proc/sys/kernel/osrelease",
+	"proc/self/status",
+	"proc/xen/capabilities",
+	"proc/iSeries",
+	"proc/vz",
+	"proc/bc",
+	"proc/device-tree/compatible",
+	"proc/device-tree/ibm,partition-name",
+	"proc/device-tree/hmc-managed?",
+	"proc/device-tree/chosen/qemu,graphic-width",
+	"sys/hypervisor/properties/features",
+	"sys/kernel/cpu_byteorder",
+	"sys/devices/system/cpu",
+	"sys/devices/system/node",
+};
+
+static int snapshot_copy(const char *src, const char *dst, int depth);
+
+static int snapshot_copy_file(const char *src, const char *dst)
+{
+	char *buf = xmalloc(SNAPSHOT_MAX_FILESZ);
+	ssize_t sz;
+	int fd, rc = 0;
+
+	fd = open(src, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		/* write-only sysfs attributes, etc. */
+		free(buf);
+		return 0;
+	}
+	sz = read_all(fd, buf, SNAPSHOT_MAX_FILESZ);
+	close(fd);
+
+	if (sz >= 0) {
+		fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0 || write_all(fd, buf, sz) != 0)
+			rc = -errno;
+		if (fd >= 0 && close(fd) != 0 && !rc)
+			rc = -errno;
+	}
+	free(buf);
+	return rc;
+}
+
+static int snapshot_copy_dir(const char *src, const char *dst, int depth)
+{
+	struct dirent *d;
+	DIR *dir;
+	int rc = 0;
+
+	if (mkdir(dst, 0755) != 0 && errno != EEXIST)
+		return -errno;
+
+	dir = opendir(src);
+	if (!dir)
+		return 0;
+
+	while (rc == 0 && (d = readdir(dir))) {
+		char *s, *t;
+
+		if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+			continue;
+
+		xasprintf(&s, "%s/%s", src, d->d_name);
+		xasprintf(&t, "%s/%s", dst, d->d_name);
+		rc = snapshot_copy(s, t, depth + 1);
+		free(s);
+		free(t);
+	}
+	closedir(dir);
+	return rc;
+}
+
+static int snapshot_copy(const char *src, const char *dst, int depth)
+{
+	struct stat st;
+
+	if (lstat(src, &st) != 0)
+		return 0;		/* not available on this system */
+
+	if (S_ISLNK(st.st_mode)) {
+		char target[PATH_MAX];
+		ssize_t len = readlink(src, target, sizeof(target) - 1);
+
+		if (len < 0)
+			return 0;
+		target[len] = '\0';
+		if (symlink(target, dst) != 0 && errno != EEXIST)
+			return -errno;
+		return 0;
+	}
+
+	/* sysfs does not contain loops without symlinks, this is just
+	 * a safeguard */
+	if (S_ISDIR(st.st_mode))
+		return depth < 16 ? snapshot_copy_dir(src, dst, depth) : 0;
+
+	if (S_ISREG(st.st_mode))
+		return snapshot_copy_file(src, dst);
+
+	return 0;
+}
+
+/*
+ * Copies the files from the current system (or from --sysroot) to @dir.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int lscpu_write_snapshot(struct lscpu_cxt *cxt, const char *dir)
+{
+	size_t i;
+	int rc = 0;
+
+	DBG(MISC, ul_debugobj(cxt, "writing snapshot to %s", dir));
+
+	if (ul_mkdir_p(dir, 0755) != 0)
+		return -errno;
+
+	for (i = 0; rc == 0 && i < ARRAY_SIZE(snapshot_paths); i++) {
+		const char *path = snapshot_paths[i];
+		char *src, *dst, *p;
+		struct stat st;
+
+		xasprintf(&src, "%s/%s", cxt->prefix ? cxt->prefix : "", path);
+		if (lstat(src, &st) != 0) {
+			/* don't create empty parent directories, the
+			 * directories are also checked by lscpu */
+			free(src);
+			continue;
+		}
+		xasprintf(&dst, "%s/%s", dir, path);
+
+		p = strrchr(dst, '/');
+		*p = '\0';
+		rc = ul_mkdir_p(dst, 0755) == 0 ? 0 : -errno;
+		*p = '/';
+
+		if (rc == 0)
+			rc = snapshot_copy(src, dst, 0);
+
+		DBG(MISC, ul_debugobj(cxt, " %s [rc=%d]", path, rc));
+		free(src);
+		free(dst);
+	}
+
+	return rc;
+}
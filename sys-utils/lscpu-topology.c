@@ -17,9 +17,14 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "lscpu.h"
 
+/* CPUs per thread for parallel reading of per-CPU attributes */
+#define LSCPU_CPUS_PER_THREAD	32
+#define LSCPU_MAX_THREADS	16
+
 /* add @set to the @ary, unnecessary set is deallocated. */
 static int add_cpuset_to_array(cpu_set_t **ary, size_t *items, cpu_set_t *set, size_t setsize)
 {
@@ -279,6 +284,25 @@ static struct lscpu_cache *get_cache(struct lscpu_cxt *cxt,
 	return NULL;
 }
 
+/*
+ * Returns cache described by cpu<N>/cache/index<@idx>, if the cache has been
+ * already read for another CPU which shares the cache with @cpu.
+ */
+static struct lscpu_cache *get_shared_cache(struct lscpu_cxt *cxt,
+				struct lscpu_cpu *cpu, size_t idx)
+{
+	size_t i;
+
+	for (i = 0; i < cxt->ncaches; i++) {
+		struct lscpu_cache *ca = &cxt->caches[i];
+
+		if (ca->sysfs_index == (int) idx && ca->name && ca->sharedmap &&
+		    CPU_ISSET_S(cpu->logical_id, cxt->setsize, ca->sharedmap))
+			return ca;
+	}
+	return NULL;
+}
+
 static struct lscpu_cache *add_cache(struct lscpu_cxt *cxt,
 				const char *type, int level, int id)
 {
@@ -294,6 +318,7 @@ static struct lscpu_cache *add_cache(struct lscpu_cxt *cxt,
 	ca->id = id;
 	ca->level = level;
 	ca->type = xstrdup(type);
+	ca->sysfs_index = -1;
 
 	DBG(GATHER, ul_debugobj(cxt, "add cache %s%d::%d", type, level, id));
 	return ca;
@@ -405,6 +430,10 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 		struct lscpu_cache *ca;
 		int id, level;
 
+		/* the same cache has been already read for a sibling CPU */
+		if (get_shared_cache(cxt, cpu, i))
+			continue;
+
 		if (ul_path_readf_s32(sys, &id, "cpu%d/cache/index%zu/id", num, i) != 0)
 			id = -1;
 		if (ul_path_readf_s32(sys, &level, "cpu%d/cache/index%zu/level", num, i) != 0)
@@ -417,8 +446,10 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 			id = mk_cache_id(cxt, cpu, buf, level);
 
 		ca = get_cache(cxt, buf, level, id);
-		if (!ca)
+		if (!ca) {
 			ca = add_cache(cxt, buf, level, id);
+			ca->sysfs_index = i;
+		}
 
 		if (!ca->name) {
 			int type = 0;
@@ -468,9 +499,8 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
-static int read_ids(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_ids(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/topology", num) != 0)
@@ -490,9 +520,8 @@ static int read_ids(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
-static int read_polarization(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_polarization(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	char mode[64];
 
@@ -514,14 +543,11 @@ static int read_polarization(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	else
 		cpu->polarization = POLAR_UNKNOWN;
 
-	if (cpu->type)
-		cpu->type->has_polarization = 1;
-	return 0;
+	return 1;
 }
 
-static int read_address(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_address(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/address", num) != 0)
@@ -530,14 +556,11 @@ static int read_address(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	DBG(CPU, ul_debugobj(cpu, "#%d reading address", num));
 
 	ul_path_readf_s32(sys, &cpu->address, "cpu%d/address", num);
-	if (cpu->type)
-		cpu->type->has_addresses = 1;
-	return 0;
+	return 1;
 }
 
-static int read_configure(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_configure(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/configure", num) != 0)
@@ -546,14 +569,11 @@ static int read_configure(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	DBG(CPU, ul_debugobj(cpu, "#%d reading configure", num));
 
 	ul_path_readf_s32(sys, &cpu->configured, "cpu%d/configure", num);
-	if (cpu->type)
-		cpu->type->has_configured = 1;
-	return 0;
+	return 1;
 }
 
-static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_mhz(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	int mhz;
 
@@ -574,10 +594,7 @@ static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	if (ul_path_readf_s32(sys, &mhz, "cpu%d/cpufreq/scaling_cur_freq", num) == 0)
 		cpu->mhz_cur_freq = (float) mhz / 1000;
 
-	if (cpu->type && (cpu->mhz_min_freq || cpu->mhz_max_freq))
-		cpu->type->has_freq = 1;
-
-	return 0;
+	return cpu->mhz_min_freq || cpu->mhz_max_freq ? 1 : 0;
 }
 
 float lsblk_cputype_get_maxmhz(struct lscpu_cxt *cxt, struct lscpu_cputype *ct)
@@ -632,6 +649,116 @@ float lsblk_cputype_get_scalmhz(struct lscpu_cxt *cxt, struct lscpu_cputype *ct)
 	return fcur / fmax * 100;
 }
 
+/*
+ * Shared by threads reading per-CPU attributes; @next is the next
+ * cxt->cpus[] item to read, the lock also protects the cputype has_* flags.
+ */
+struct topology_reader {
+	struct lscpu_cxt	*cxt;
+	pthread_mutex_t		lock;
+	size_t			next;	/* next CPU to read */
+};
+
+static void read_cpu_attributes(struct topology_reader *rd,
+				struct path_cxt *sys, struct lscpu_cpu *cpu)
+{
+	int polar, addr, conf, freq;
+
+	DBG(CPU, ul_debugobj(cpu, "#%d reading topology", cpu->logical_id));
+
+	read_ids(sys, cpu);
+	polar = read_polarization(sys, cpu);
+	addr = read_address(sys, cpu);
+	conf = read_configure(sys, cpu);
+	freq = read_mhz(sys, cpu);
+
+	/* the flags are bit-fields shared by all CPUs of the type */
+	pthread_mutex_lock(&rd->lock);
+	if (polar)
+		cpu->type->has_polarization = 1;
+	if (addr)
+		cpu->type->has_addresses = 1;
+	if (conf)
+		cpu->type->has_configured = 1;
+	if (freq)
+		cpu->type->has_freq = 1;
+	pthread_mutex_unlock(&rd->lock);
+}
+
+static void read_cpus_from_queue(struct topology_reader *rd, struct path_cxt *sys)
+{
+	struct lscpu_cxt *cxt = rd->cxt;
+
+	for (;;) {
+		struct lscpu_cpu *cpu = NULL;
+
+		pthread_mutex_lock(&rd->lock);
+		while (!cpu && rd->next < cxt->npossibles) {
+			cpu = cxt->cpus[rd->next++];
+			if (cpu && !cpu->type)
+				cpu = NULL;
+		}
+		pthread_mutex_unlock(&rd->lock);
+
+		if (!cpu)
+			break;
+		read_cpu_attributes(rd, sys, cpu);
+	}
+}
+
+static void *topology_worker(void *data)
+{
+	struct topology_reader *rd = data;
+	struct path_cxt *sys;
+
+	/* path_cxt is not thread-safe, use private one */
+	sys = ul_new_path(_PATH_SYS_CPU);
+	if (!sys)
+		return NULL;
+	if (rd->cxt->prefix)
+		ul_path_set_prefix(sys, rd->cxt->prefix);
+
+	/* open the directory now, the first relative access shares the
+	 * path buffer with the absolute directory path */
+	if (ul_path_get_dirfd(sys) < 0) {
+		ul_unref_path(sys);
+		return NULL;
+	}
+	read_cpus_from_queue(rd, sys);
+
+	ul_unref_path(sys);
+	return NULL;
+}
+
+/*
+ * Reads per-CPU attributes, on large systems in more threads.
+ */
+static void read_cpus_attributes(struct lscpu_cxt *cxt)
+{
+	struct topology_reader rd = { .cxt = cxt };
+	size_t i, nthreads = cxt->npossibles / LSCPU_CPUS_PER_THREAD;
+	pthread_t threads[LSCPU_MAX_THREADS];
+
+	pthread_mutex_init(&rd.lock, NULL);
+
+	nthreads = min(nthreads, (size_t) LSCPU_MAX_THREADS);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, topology_worker, &rd) != 0)
+			break;
+	}
+	nthreads = i;
+
+	DBG(GATHER, ul_debugobj(cxt, "reading CPUs attributes in %zu threads", nthreads));
+
+	/* the rest (or everything on small systems) in this thread */
+	read_cpus_from_queue(&rd, cxt->syscpu);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&rd.lock);
+}
+
 int lscpu_read_topology(struct lscpu_cxt *cxt)
 {
 	size_t i;
@@ -641,25 +768,17 @@ int lscpu_read_topology(struct lscpu_cxt *cxt)
 	for (i = 0; i < cxt->ncputypes; i++)
 		rc += cputype_read_topology(cxt, cxt->cputypes[i]);
 
+	if (rc == 0)
+		read_cpus_attributes(cxt);
+
+	/* caches are shared between CPUs, always read in one thread */
 	for (i = 0; rc == 0 && i < cxt->npossibles; i++) {
 		struct lscpu_cpu *cpu = cxt->cpus[i];
 
 		if (!cpu || !cpu->type)
 			continue;
 
-		DBG(CPU, ul_debugobj(cpu, "#%d reading topology", cpu->logical_id));
-
-		rc = read_ids(cxt, cpu);
-		if (!rc)
-			rc = read_polarization(cxt, cpu);
-		if (!rc)
-			rc = read_address(cxt, cpu);
-		if (!rc)
-			rc = read_configure(cxt, cpu);
-		if (!rc)
-			rc = read_mhz(cxt, cpu);
-		if (!rc)
-			rc = read_caches(cxt, cpu);
+		rc = read_caches(cxt, cpu);
 	}
 
 	lscpu_sort_caches(cxt->caches, cxt->ncaches);
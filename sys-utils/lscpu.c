@@ -33,6 +33,7 @@
 #include "optutils.h"
 #include "c_strtod.h"
 #include "sysfs.h"
+#include "timeutils.h"
 
 #include "lscpu.h"
 
@@ -1183,12 +1184,14 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --offline           print offline CPUs only\n"), out);
 	fputs(_(" -J, --json              use JSON for default or extended format\n"), out);
 	fputs(_(" -e, --extended[=<list>] print out an extended readable format\n"), out);
+	fputs(_(" -i, --interval <secs>   print frequency and idle states every <secs>\n"), out);
 	fputs(_(" -p, --parse[=<list>]    print out a parsable format\n"), out);
 	fputs(_(" -s, --sysroot <dir>     use specified directory as system root\n"), out);
 	fputs(_(" -x, --hex               print hexadecimal masks rather than lists of CPUs\n"), out);
 	fputs(_(" -y, --physical          print physical instead of logical IDs\n"), out);
 	fputs(_("     --hierarchic[=when] use subsections in summary (auto, never, always)\n"), out);
 	fputs(_("     --output-all        print all available columns for -e, -p or -C\n"), out);
+	fputs(_("     --snapshot <dir>    copy the system files to <dir> for use with --sysroot\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(25));
 
@@ -1211,11 +1214,13 @@ int main(int argc, char *argv[])
 	int c, all = 0;
 	int columns[ARRAY_SIZE(coldescs_cpu)];
 	int cpu_modifier_specified = 0;
-	char *outarg = NULL;
+	char *outarg = NULL, *snapshot = NULL;
+	struct timespec interval = { 0 };
 	size_t i, ncolumns = 0;
 	enum {
 		OPT_OUTPUT_ALL = CHAR_MAX + 1,
 		OPT_HIERARCHIC,
+		OPT_SNAPSHOT,
 	};
 	static const struct option longopts[] = {
 		{ "all",        no_argument,       NULL, 'a' },
@@ -1225,6 +1230,7 @@ int main(int argc, char *argv[])
 		{ "offline",    no_argument,       NULL, 'c' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "extended",	optional_argument, NULL, 'e' },
+		{ "interval",	required_argument, NULL, 'i' },
 		{ "json",       no_argument,       NULL, 'J' },
 		{ "parse",	optional_argument, NULL, 'p' },
 		{ "sysroot",	required_argument, NULL, 's' },
@@ -1233,11 +1239,12 @@ int main(int argc, char *argv[])
 		{ "version",	no_argument,	   NULL, 'V' },
 		{ "output-all",	no_argument,	   NULL, OPT_OUTPUT_ALL },
 		{ "hierarchic", optional_argument, NULL, OPT_HIERARCHIC },
+		{ "snapshot",	required_argument, NULL, OPT_SNAPSHOT },
 		{ NULL,		0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
-		{ 'C','e','p' },
+		{ 'C','e','i','p' },
 		{ 'a','b','c' },
 		{ 0 }
 	};
@@ -1250,7 +1257,7 @@ int main(int argc, char *argv[])
 
 	cxt = lscpu_new_context();
 
-	while ((c = getopt_long(argc, argv, "aBbC::ce::hJp::s:xyV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "aBbC::ce::hi:Jp::s:xyV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -1278,6 +1285,16 @@ int main(int argc, char *argv[])
 			}
 			cxt->mode = LSCPU_OUTPUT_CACHES;
 			break;
+		case 'i':
+		{
+			struct timeval tv;
+
+			strtotimeval_or_err(optarg, &tv, _("failed to parse interval"));
+			if (!timerisset(&tv))
+				errx(EXIT_FAILURE, _("interval must be greater than zero"));
+			TIMEVAL_TO_TIMESPEC(&tv, &interval);
+			break;
+		}
 		case 'J':
 			cxt->json = 1;
 			break;
@@ -1316,6 +1333,9 @@ int main(int argc, char *argv[])
 			} else
 				hierarchic = 1;
 			break;
+		case OPT_SNAPSHOT:
+			snapshot = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1334,7 +1354,8 @@ int main(int argc, char *argv[])
 			columns[ncolumns++] = i;
 	}
 
-	if (cpu_modifier_specified && cxt->mode == LSCPU_OUTPUT_SUMMARY) {
+	if (cpu_modifier_specified && cxt->mode == LSCPU_OUTPUT_SUMMARY
+	    && !interval.tv_sec && !interval.tv_nsec) {
 		fprintf(stderr,
 			_("%s: options --all, --online and --offline may only "
 			  "be used with options --extended or --parse.\n"),
@@ -1358,6 +1379,13 @@ int main(int argc, char *argv[])
 
 	lscpu_context_init_paths(cxt);
 
+	if (snapshot) {
+		if (lscpu_write_snapshot(cxt, snapshot) != 0)
+			err(EXIT_FAILURE, _("failed to write snapshot to %s"), snapshot);
+		lscpu_free_context(cxt);
+		return EXIT_SUCCESS;
+	}
+
 	lscpu_read_cpulists(cxt);
 	lscpu_read_cpuinfo(cxt);
 	cxt->arch = lscpu_read_architecture(cxt);
@@ -1371,6 +1399,9 @@ int main(int argc, char *argv[])
 
 	cxt->virt = lscpu_read_virtualization(cxt);
 
+	if (interval.tv_sec || interval.tv_nsec)
+		lscpu_monitor(cxt, &interval);
+
 	if (hierarchic == -1)
 		hierarchic = isatty(STDOUT_FILENO);	/* default */
 
@@ -54,6 +54,7 @@ struct lscpu_cache {
 	char		*write_policy;
 
 	int		level;
+	int		sysfs_index;	/* cpu<N>/cache/index<sysfs_index> or -1 */
 	uint64_t	size;
 
 	unsigned int	ways_of_associativity;
@@ -313,6 +314,11 @@ struct lscpu_cpu *lscpu_cpus_loopup_by_type(struct lscpu_cxt *cxt, struct lscpu_
 
 void lscpu_decode_arm(struct lscpu_cxt *cxt);
 
+int lscpu_write_snapshot(struct lscpu_cxt *cxt, const char *dir);
+
+void lscpu_monitor(struct lscpu_cxt *cxt, const struct timespec *interval)
+			__attribute__((__noreturn__));
+
 int lookup(char *line, char *pattern, char **value);
 
 void *get_mem_chunk(size_t base, size_t len, const char *devmem);
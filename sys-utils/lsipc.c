@@ -39,6 +39,7 @@
 #include "xalloc.h"
 #include "procfs.h"
 #include "ipcutils.h"
+#include "idcache.h"
 #include "timeutils.h"
 
 /*
@@ -127,6 +128,8 @@ enum {
 
 struct lsipc_control {
 	int outmode;
+	struct idcache *uids;			/* user names */
+	struct idcache *gids;			/* group names */
 	unsigned int noheadings : 1,		/* don't print header line */
 		     notrunc : 1,		/* don't truncate columns */
 		     shellvar : 1,              /* use shell compatible colum names */
@@ -247,20 +250,29 @@ static const struct lsipc_coldesc *get_column_desc(int num)
 	return &coldescs[ get_column_id(num) ];
 }
 
-static char *get_username(struct passwd **pw, uid_t id)
+/* returns NULL if the name is unknown, the result is cached */
+static char *get_username(struct lsipc_control *ctl, uid_t id)
 {
-	if (!*pw || (*pw)->pw_uid != id)
-		*pw = getpwuid(id);
+	struct identry *ent = get_id(ctl->uids, id);
 
-	return *pw ? xstrdup((*pw)->pw_name) : NULL;
+	if (!ent) {
+		struct passwd *pw = getpwuid(id);
+
+		ent = add_id_entry(ctl->uids, id, pw ? pw->pw_name : NULL);
+	}
+	return ent && ent->name ? xstrdup(ent->name) : NULL;
 }
 
-static char *get_groupname(struct group **gr, gid_t id)
+static char *get_groupname(struct lsipc_control *ctl, gid_t id)
 {
-	if (!*gr || (*gr)->gr_gid != id)
-		*gr = getgrgid(id);
+	struct identry *ent = get_id(ctl->gids, id);
+
+	if (!ent) {
+		struct group *gr = getgrgid(id);
 
-	return *gr ? xstrdup((*gr)->gr_name) : NULL;
+		ent = add_id_entry(ctl->gids, id, gr ? gr->gr_name : NULL);
+	}
+	return ent && ent->name ? xstrdup(ent->name) : NULL;
 }
 
 static int parse_time_mode(const char *s)
@@ -499,7 +511,7 @@ static void global_set_data(struct lsipc_control *ctl, struct libscols_table *tb
 		case COL_USED:
 			if (usage) {
 				if (!byte_unit || ctl->bytes)
-					xasprintf(&arg, "%ju", used);
+					arg = u64_to_string(used);
 				else
 					arg = size_to_human_string(SIZE_SUFFIX_1LETTER, used);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -515,7 +527,7 @@ static void global_set_data(struct lsipc_control *ctl, struct libscols_table *tb
 			break;
 		case COL_LIMIT:
 			if (!byte_unit || ctl->bytes)
-				xasprintf(&arg, "%ju", limit);
+				arg = u64_to_string(limit);
 			else
 				arg = size_to_human_string(SIZE_SUFFIX_1LETTER, limit);
 			rc = scols_line_refer_data(ln, n, arg);
@@ -547,8 +559,6 @@ static void setup_sem_elements_columns(struct libscols_table *tb)
 static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL, *cpw = NULL;
-	struct group *gr = NULL, *cgr = NULL;
 	struct sem_data *semds, *semdsp;
 	char *arg = NULL;
 
@@ -578,9 +588,9 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, semdsp->sem_perm.uid);
+				arg = get_username(ctl, semdsp->sem_perm.uid);
 				if (!arg)
-					xasprintf(&arg, "%u", semdsp->sem_perm.uid);
+					arg = u64_to_string(semdsp->sem_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_PERMS:
@@ -593,38 +603,38 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUID:
-				xasprintf(&arg, "%u", semdsp->sem_perm.cuid);
+				arg = u64_to_string(semdsp->sem_perm.cuid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&cpw, semdsp->sem_perm.cuid);
+				arg = get_username(ctl, semdsp->sem_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGID:
-				xasprintf(&arg, "%u", semdsp->sem_perm.cgid);
+				arg = u64_to_string(semdsp->sem_perm.cgid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&cgr, semdsp->sem_perm.cgid);
+				arg = get_groupname(ctl, semdsp->sem_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_UID:
-				xasprintf(&arg, "%u", semdsp->sem_perm.uid);
+				arg = u64_to_string(semdsp->sem_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, semdsp->sem_perm.uid);
+				arg = get_username(ctl, semdsp->sem_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GID:
-				xasprintf(&arg, "%u", semdsp->sem_perm.gid);
+				arg = u64_to_string(semdsp->sem_perm.gid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, semdsp->sem_perm.gid);
+				arg = get_groupname(ctl, semdsp->sem_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -636,7 +646,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				}
 				break;
 			case COL_NSEMS:
-				xasprintf(&arg, "%ju", semdsp->sem_nsems);
+				arg = u64_to_string(semdsp->sem_nsems);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OTIME:
@@ -669,7 +679,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 					err(EXIT_FAILURE, _("failed to allocate output line"));
 
 				/* SEMNUM */
-				xasprintf(&arg, "%zu", i);
+				arg = u64_to_string(i);
 				rc = scols_line_refer_data(sln, 0, arg);
 				if (rc)
 					break;
@@ -717,22 +727,14 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 
 static void do_sem_global(struct lsipc_control *ctl, struct libscols_table *tb)
 {
-	struct sem_data *semds, *semdsp;
+	struct ipc_usage use;
 	struct ipc_limits lim;
-	int nsems = 0, nsets = 0;
 
 	ipc_sem_get_limits(&lim);
+	ipc_sem_get_usage(&use);
 
-	if (ipc_sem_get_info(-1, &semds) > 0) {
-		for (semdsp = semds; semdsp->next != NULL; semdsp = semdsp->next) {
-			++nsets;
-			nsems += semds->sem_nsems;
-		}
-		ipc_sem_free_info(semds);
-	}
-
-	global_set_data(ctl, tb, "SEMMNI", _("Number of semaphore identifiers"), nsets, lim.semmni, 1, 0);
-	global_set_data(ctl, tb, "SEMMNS", _("Total number of semaphores"), nsems, lim.semmns, 1, 0);
+	global_set_data(ctl, tb, "SEMMNI", _("Number of semaphore identifiers"), use.ids, lim.semmni, 1, 0);
+	global_set_data(ctl, tb, "SEMMNS", _("Total number of semaphores"), use.total, lim.semmns, 1, 0);
 	global_set_data(ctl, tb, "SEMMSL", _("Max semaphores per semaphore set."), 0, lim.semmsl, 0, 0);
 	global_set_data(ctl, tb, "SEMOPM", _("Max number of operations per semop(2)"), 0, lim.semopm, 0, 0);
 	global_set_data(ctl, tb, "SEMVMX", _("Semaphore max value"), 0, lim.semvmx, 0, 0);
@@ -741,8 +743,6 @@ static void do_sem_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct msg_data *msgds, *msgdsp;
 	char *arg = NULL;
 
@@ -760,14 +760,6 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 		if (!ln)
 			err(EXIT_FAILURE, _("failed to allocate output line"));
 
-		/* no need to call getpwuid() for the same user */
-		if (!(pw && pw->pw_uid == msgdsp->msg_perm.uid))
-			pw = getpwuid(msgdsp->msg_perm.uid);
-
-		/* no need to call getgrgid() for the same user */
-		if (!(gr && gr->gr_gid == msgdsp->msg_perm.gid))
-			gr = getgrgid(msgdsp->msg_perm.gid);
-
 		for (n = 0; n < ncolumns; n++) {
 			int rc = 0;
 
@@ -781,9 +773,9 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, msgdsp->msg_perm.uid);
+				arg = get_username(ctl, msgdsp->msg_perm.uid);
 				if (!arg)
-					xasprintf(&arg, "%u", msgdsp->msg_perm.uid);
+					arg = u64_to_string(msgdsp->msg_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_PERMS:
@@ -796,38 +788,38 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				}
 				break;
 			case COL_CUID:
-				xasprintf(&arg, "%u", msgdsp->msg_perm.cuid);
+				arg = u64_to_string(msgdsp->msg_perm.cuid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, msgdsp->msg_perm.cuid);
+				arg = get_username(ctl, msgdsp->msg_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGID:
-				xasprintf(&arg, "%u", msgdsp->msg_perm.cuid);
+				arg = u64_to_string(msgdsp->msg_perm.cuid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, msgdsp->msg_perm.cgid);
+				arg = get_groupname(ctl, msgdsp->msg_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_UID:
-				xasprintf(&arg, "%u", msgdsp->msg_perm.uid);
+				arg = u64_to_string(msgdsp->msg_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, msgdsp->msg_perm.uid);
+				arg = get_username(ctl, msgdsp->msg_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GID:
-				xasprintf(&arg, "%u", msgdsp->msg_perm.gid);
+				arg = u64_to_string(msgdsp->msg_perm.gid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr,msgdsp->msg_perm.gid);
+				arg = get_groupname(ctl, msgdsp->msg_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -839,13 +831,13 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				break;
 			case COL_USEDBYTES:
 				if (ctl->bytes)
-					xasprintf(&arg, "%ju", msgdsp->q_cbytes);
+					arg = u64_to_string(msgdsp->q_cbytes);
 				else
 					arg = size_to_human_string(SIZE_SUFFIX_1LETTER, msgdsp->q_cbytes);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_MSGS:
-				xasprintf(&arg, "%ju", msgdsp->q_qnum);
+				arg = u64_to_string(msgdsp->q_qnum);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_SEND:
@@ -861,11 +853,11 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 							  (time_t)msgdsp->q_rtime));
 				break;
 			case COL_LSPID:
-				xasprintf(&arg, "%u", msgdsp->q_lspid);
+				arg = u64_to_string(msgdsp->q_lspid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_LRPID:
-				xasprintf(&arg, "%u", msgdsp->q_lrpid);
+				arg = u64_to_string(msgdsp->q_lrpid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			}
@@ -882,20 +874,13 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 
 static void do_msg_global(struct lsipc_control *ctl, struct libscols_table *tb)
 {
-	struct msg_data *msgds, *msgdsp;
+	struct ipc_usage use;
 	struct ipc_limits lim;
-	int msgqs = 0;
 
 	ipc_msg_get_limits(&lim);
+	ipc_msg_get_usage(&use);
 
-	/* count number of used queues */
-	if (ipc_msg_get_info(-1, &msgds) > 0) {
-		for (msgdsp = msgds; msgdsp->next != NULL; msgdsp = msgdsp->next)
-			++msgqs;
-		ipc_msg_free_info(msgds);
-	}
-
-	global_set_data(ctl, tb, "MSGMNI", _("Number of message queues"), msgqs, lim.msgmni, 1, 0);
+	global_set_data(ctl, tb, "MSGMNI", _("Number of message queues"), use.ids, lim.msgmni, 1, 0);
 	global_set_data(ctl, tb, "MSGMAX", _("Max size of message (bytes)"),	0, lim.msgmax, 0, 1);
 	global_set_data(ctl, tb, "MSGMNB", _("Default max size of queue (bytes)"), 0, lim.msgmnb, 0, 1);
 }
@@ -904,8 +889,6 @@ static void do_msg_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct shm_data *shmds, *shmdsp;
 	char *arg = NULL;
 
@@ -937,9 +920,9 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, shmdsp->shm_perm.uid);
+				arg = get_username(ctl, shmdsp->shm_perm.uid);
 				if (!arg)
-					xasprintf(&arg, "%u", shmdsp->shm_perm.uid);
+					arg = u64_to_string(shmdsp->shm_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_PERMS:
@@ -952,38 +935,38 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUID:
-				xasprintf(&arg, "%u", shmdsp->shm_perm.cuid);
+				arg = u64_to_string(shmdsp->shm_perm.cuid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, shmdsp->shm_perm.cuid);
+				arg = get_username(ctl, shmdsp->shm_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGID:
-				xasprintf(&arg, "%u", shmdsp->shm_perm.cuid);
+				arg = u64_to_string(shmdsp->shm_perm.cuid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, shmdsp->shm_perm.cgid);
+				arg = get_groupname(ctl, shmdsp->shm_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_UID:
-				xasprintf(&arg, "%u", shmdsp->shm_perm.uid);
+				arg = u64_to_string(shmdsp->shm_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, shmdsp->shm_perm.uid);
+				arg = get_username(ctl, shmdsp->shm_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GID:
-				xasprintf(&arg, "%u", shmdsp->shm_perm.gid);
+				arg = u64_to_string(shmdsp->shm_perm.gid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, shmdsp->shm_perm.gid);
+				arg = get_groupname(ctl, shmdsp->shm_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -995,13 +978,13 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				break;
 			case COL_SIZE:
 				if (ctl->bytes)
-					xasprintf(&arg, "%ju", shmdsp->shm_segsz);
+					arg = u64_to_string(shmdsp->shm_segsz);
 				else
 					arg = size_to_human_string(SIZE_SUFFIX_1LETTER, shmdsp->shm_segsz);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_NATTCH:
-				xasprintf(&arg, "%ju", shmdsp->shm_nattch);
+				arg = u64_to_string(shmdsp->shm_nattch);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_STATUS: {
@@ -1056,11 +1039,11 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 							  (time_t)shmdsp->shm_dtim));
 				break;
 			case COL_CPID:
-				xasprintf(&arg, "%u", shmdsp->shm_cprid);
+				arg = u64_to_string(shmdsp->shm_cprid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_LPID:
-				xasprintf(&arg, "%u", shmdsp->shm_lprid);
+				arg = u64_to_string(shmdsp->shm_lprid);
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_COMMAND:
@@ -1080,22 +1063,14 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 
 static void do_shm_global(struct lsipc_control *ctl, struct libscols_table *tb)
 {
-	struct shm_data *shmds, *shmdsp;
-	uint64_t nsegs = 0, sum_segsz = 0;
+	struct ipc_usage use;
 	struct ipc_limits lim;
 
 	ipc_shm_get_limits(&lim);
+	ipc_shm_get_usage(&use);
 
-	if (ipc_shm_get_info(-1, &shmds) > 0) {
-		for (shmdsp = shmds; shmdsp->next != NULL; shmdsp = shmdsp->next) {
-			++nsegs;
-			sum_segsz += shmdsp->shm_segsz;
-		}
-		ipc_shm_free_info(shmds);
-	}
-
-	global_set_data(ctl, tb, "SHMMNI", _("Shared memory segments"), nsegs, lim.shmmni, 1, 0);
-	global_set_data(ctl, tb, "SHMALL", _("Shared memory pages"), sum_segsz / getpagesize(), lim.shmall, 1, 0);
+	global_set_data(ctl, tb, "SHMMNI", _("Shared memory segments"), use.ids, lim.shmmni, 1, 0);
+	global_set_data(ctl, tb, "SHMALL", _("Shared memory pages"), use.total / getpagesize(), lim.shmall, 1, 0);
 	global_set_data(ctl, tb, "SHMMAX", _("Max size of shared memory segment (bytes)"), 0, lim.shmmax, 0, 1);
 	global_set_data(ctl, tb, "SHMMIN", _("Min size of shared memory segment (bytes)"), 0, lim.shmmin, 0, 1);
 }
@@ -1325,6 +1300,11 @@ int main(int argc, char *argv[])
 	if (!tb)
 		return EXIT_FAILURE;
 
+	ctl->uids = new_idcache();
+	ctl->gids = new_idcache();
+	if (!ctl->uids || !ctl->gids)
+		err_oom();
+
 	if (global)
 		scols_table_set_name(tb, "ipclimits");
 
@@ -1350,6 +1330,8 @@ int main(int argc, char *argv[])
 	print_table(ctl, tb);
 
 	scols_unref_table(tb);
+	free_idcache(ctl->uids);
+	free_idcache(ctl->gids);
 	free(ctl);
 
 	return EXIT_SUCCESS;
@@ -19,7 +19,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <libsmartcols.h>
@@ -27,15 +29,33 @@
 #include "closestream.h"
 #include "optutils.h"
 #include "strutils.h"
+#include "timeutils.h"
 #include "xalloc.h"
 
 #include "irq-common.h"
 
-static int print_irq_data(struct irq_output *out, int softirq)
+struct lsirq_control {
+	struct irq_output out;
+	struct timespec interval;	/* --interval */
+
+	unsigned int
+		matrix:1,		/* per-CPU x IRQ matrix */
+		softirq:1;		/* /proc/softirqs */
+};
+
+static int print_irq_data(struct lsirq_control *ctl)
 {
 	struct libscols_table *table;
 
-	table = get_scols_table(out, NULL, NULL, softirq, 0, NULL);
+	if (ctl->matrix) {
+		struct irq_stat *stat = get_irqinfo(ctl->softirq, 0, NULL);
+
+		if (!stat)
+			return -1;
+		table = get_scols_matrix_table(&ctl->out, NULL, stat, 0, 0, NULL);
+		free_irqstat(stat);
+	} else
+		table = get_scols_table(&ctl->out, NULL, NULL, ctl->softirq, 0, NULL);
 	if (!table)
 		return -1;
 
@@ -44,6 +64,152 @@ static int print_irq_data(struct irq_output *out, int softirq)
 	return 0;
 }
 
+static void json_puts(const char *str, FILE *out)
+{
+	const unsigned char *p;
+
+	fputc('"', out);
+	for (p = (const unsigned char *) str; p && *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(out, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(out, "\\u%04x", *p);
+		else
+			fputc(*p, out);
+	}
+	fputc('"', out);
+}
+
+static void json_put_attribute(const char *name, const struct irq_info *info,
+			       const char *attr, int number, FILE *out)
+{
+	char *str = irq_get_attribute(info, attr);
+
+	fprintf(out, ",\"%s\":", name);
+	if (!str)
+		fputs("null", out);
+	else if (number)
+		fputs(str, out);
+	else
+		json_puts(str, out);
+	free(str);
+}
+
+/*
+ * One JSON object per interrupt and line, the rates are per second since the
+ * previous sample.
+ */
+static void print_irq_json_lines(struct irq_stat *prev, struct irq_stat *curr,
+				 double elapsed, const struct timespec *now)
+{
+	size_t i, j;
+
+	for (i = 0; i < curr->nr_irq; i++) {
+		struct irq_info *cur = &curr->irq_info[i];
+		struct irq_info *pre = i < prev->nr_irq ? &prev->irq_info[i] : NULL;
+
+		if (pre && (prev->nr_active_cpu != curr->nr_active_cpu
+			    || strcmp(pre->irq, cur->irq) != 0))
+			pre = NULL;
+
+		printf("{\"time\":%jd.%06ld,\"irq\":", (intmax_t) now->tv_sec,
+				now->tv_nsec / 1000);
+		json_puts(cur->irq, stdout);
+		fputs(",\"name\":", stdout);
+		json_puts(cur->name, stdout);
+		printf(",\"total\":%lu,\"rate\":%0.1f,\"cpus\":[", cur->total,
+				pre ? (cur->total - pre->total) / elapsed : 0.0);
+
+		for (j = 0; j < curr->nr_active_cpu; j++)
+			printf("%s%0.1f", j ? "," : "",
+				pre ? (cur->cpu_count[j] - pre->cpu_count[j]) / elapsed : 0.0);
+		fputc(']', stdout);
+
+		json_put_attribute("affinity", cur, "smp_affinity_list", 0, stdout);
+		json_put_attribute("effective", cur, "effective_affinity_list", 0, stdout);
+		json_put_attribute("node", cur, "node", 1, stdout);
+		fputs("}\n", stdout);
+	}
+}
+
+/*
+ * Sample the counters every --interval; the timer is not re-armed after the
+ * output, so the samples do not drift.
+ */
+static int print_irq_rates(struct lsirq_control *ctl)
+{
+	struct itimerspec timer = { .it_interval = ctl->interval,
+				    .it_value = ctl->interval };
+	struct irq_stat *prev;
+	struct timespec last;
+	int tfd, rc = 0;
+
+	if ((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0)
+		err(EXIT_FAILURE, _("cannot not create timerfd"));
+	if (timerfd_settime(tfd, 0, &timer, NULL) != 0)
+		err(EXIT_FAILURE, _("cannot set timerfd"));
+
+	prev = get_irqinfo(ctl->softirq, 0, NULL);
+	if (!prev)
+		return -1;
+	clock_gettime(CLOCK_MONOTONIC, &last);
+
+	while (rc == 0) {
+		struct libscols_table *table = NULL;
+		struct irq_stat *curr = NULL;
+		struct timespec now, wall;
+		uint64_t expired;
+		double elapsed;
+
+		if (read(tfd, &expired, sizeof(expired)) != sizeof(expired)) {
+			if (errno == EINTR)
+				continue;
+			warn(_("cannot read timerfd"));
+			rc = -1;
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - last.tv_sec)
+			  + (now.tv_nsec - last.tv_nsec) / 1000000000.0;
+		last = now;
+
+		if (ctl->out.json) {
+			curr = get_irqinfo(ctl->softirq, 0, NULL);
+			if (curr) {
+				clock_gettime(CLOCK_REALTIME, &wall);
+				print_irq_json_lines(prev, curr, elapsed, &wall);
+			}
+		} else if (ctl->matrix) {
+			curr = get_irqinfo(ctl->softirq, 0, NULL);
+			if (curr)
+				table = get_scols_matrix_table(&ctl->out, prev, curr,
+							       elapsed, 0, NULL);
+		} else
+			table = get_scols_table(&ctl->out, prev, &curr,
+						ctl->softirq, 0, NULL);
+
+		if (!curr) {
+			rc = -1;
+			break;
+		}
+		if (table) {
+			scols_print_table(table);
+			scols_unref_table(table);
+			fputc('\n', stdout);
+		}
+		if (fflush(stdout) != 0)
+			rc = -1;
+
+		free_irqstat(prev);
+		prev = curr;
+	}
+
+	free_irqstat(prev);
+	close(tfd);
+	return rc;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	fputs(USAGE_HEADER, stdout);
@@ -53,17 +219,19 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_("Utility to display kernel interrupt information."), stdout);
 
 	fputs(USAGE_OPTIONS, stdout);
-	fputs(_(" -J, --json           use JSON output format\n"), stdout);
-	fputs(_(" -P, --pairs          use key=\"value\" output format\n"), stdout);
-	fputs(_(" -n, --noheadings     don't print headings\n"), stdout);
-	fputs(_(" -o, --output <list>  define which output columns to use\n"), stdout);
-	fputs(_(" -s, --sort <column>  specify sort column\n"), stdout);
-	fputs(_(" -S, --softirq        show softirqs instead of interrupts\n"), stdout);
+	fputs(_(" -J, --json              use JSON output format\n"), stdout);
+	fputs(_(" -P, --pairs             use key=\"value\" output format\n"), stdout);
+	fputs(_(" -n, --noheadings        don't print headings\n"), stdout);
+	fputs(_(" -o, --output <list>     define which output columns to use\n"), stdout);
+	fputs(_(" -s, --sort <column>     specify sort column\n"), stdout);
+	fputs(_(" -S, --softirq           show softirqs instead of interrupts\n"), stdout);
+	fputs(_(" -m, --matrix            show per-CPU counters of every interrupt\n"), stdout);
+	fputs(_(" -i, --interval <secs>   print the rates every <secs> seconds\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
-	fprintf(stdout, USAGE_HELP_OPTIONS(22));
+	fprintf(stdout, USAGE_HELP_OPTIONS(25));
 
 	fputs(USAGE_COLUMNS, stdout);
-	irq_print_columns(stdout, 1);
+	irq_print_columns(stdout, 0);
 
 	fprintf(stdout, USAGE_MAN_TAIL("lsirq(1)"));
 	exit(EXIT_SUCCESS);
@@ -71,9 +239,10 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char **argv)
 {
-	struct irq_output out = {
-		.ncolumns = 0
+	struct lsirq_control ctl = {
+		.out.ncolumns = 0
 	};
+	struct irq_output *out = &ctl.out;
 	static const struct option longopts[] = {
 		{"sort", required_argument, NULL, 's'},
 		{"noheadings", no_argument, NULL, 'n'},
@@ -81,6 +250,8 @@ int main(int argc, char **argv)
 		{"softirq", no_argument, NULL, 'S'},
 		{"json", no_argument, NULL, 'J'},
 		{"pairs", no_argument, NULL, 'P'},
+		{"matrix", no_argument, NULL, 'm'},
+		{"interval", required_argument, NULL, 'i'},
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'V'},
 		{NULL, 0, NULL, 0}
@@ -92,31 +263,46 @@ int main(int argc, char **argv)
 		{0}
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
-	int softirq = 0;
+	int interval = 0;
 
 	setlocale(LC_ALL, "");
 
-	while ((c = getopt_long(argc, argv, "no:s:ShJPV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "i:mno:s:ShJPV", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch (c) {
 		case 'J':
-			out.json = 1;
+			out->json = 1;
 			break;
 		case 'P':
-			out.pairs = 1;
+			out->pairs = 1;
 			break;
 		case 'n':
-			out.no_headings = 1;
+			out->no_headings = 1;
+			break;
+		case 'm':
+			ctl.matrix = 1;
+			break;
+		case 'i':
+			{
+				struct timeval delay;
+
+				strtotimeval_or_err(optarg, &delay,
+						    _("failed to parse interval argument"));
+				if (!timerisset(&delay))
+					errx(EXIT_FAILURE, _("interval must be greater than zero"));
+				TIMEVAL_TO_TIMESPEC(&delay, &ctl.interval);
+				interval = 1;
+			}
 			break;
 		case 'o':
 			outarg = optarg;
 			break;
 		case 's':
-			set_sort_func_by_name(&out, optarg);
+			set_sort_func_by_name(out, optarg);
 			break;
 		case 'S':
-			softirq = 1;
+			ctl.softirq = 1;
 			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -128,18 +314,21 @@ int main(int argc, char **argv)
 	}
 
 	/* default */
-	if (!out.ncolumns) {
-		out.columns[out.ncolumns++] = COL_IRQ;
-		out.columns[out.ncolumns++] = COL_TOTAL;
-		out.columns[out.ncolumns++] = COL_NAME;
+	if (!out->ncolumns) {
+		out->columns[out->ncolumns++] = COL_IRQ;
+		out->columns[out->ncolumns++] = interval ? COL_DELTA : COL_TOTAL;
+		out->columns[out->ncolumns++] = COL_NAME;
 	}
 
 	/* add -o [+]<list> to putput */
-	if (outarg && string_add_to_idarray(outarg, out.columns,
-				ARRAY_SIZE(out.columns),
-				&out.ncolumns,
+	if (outarg && string_add_to_idarray(outarg, out->columns,
+				ARRAY_SIZE(out->columns),
+				&out->ncolumns,
 				irq_column_name_to_id) < 0)
 		exit(EXIT_FAILURE);
 
-	return print_irq_data(&out, softirq) == 0 ?  EXIT_SUCCESS : EXIT_FAILURE;
+	if (interval)
+		return print_irq_rates(&ctl) == 0 ?  EXIT_SUCCESS : EXIT_FAILURE;
+
+	return print_irq_data(&ctl) == 0 ?  EXIT_SUCCESS : EXIT_FAILURE;
 }
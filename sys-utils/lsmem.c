@@ -28,6 +28,7 @@
 #include <libsmartcols.h>
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
+#define _PATH_SYS_NODE			"/sys/devices/system/node"
 
 #define MEMORY_STATE_ONLINE		0
 #define MEMORY_STATE_OFFLINE		1
@@ -66,6 +67,9 @@ struct lsmem {
 	uint64_t		mem_online;
 	uint64_t		mem_offline;
 
+	int			*nodemap;	/* memory block index to node */
+	size_t			nnodemap;
+
 	struct libscols_table	*table;
 	unsigned int		have_nodes : 1,
 				raw : 1,
@@ -81,6 +85,9 @@ struct lsmem {
 				split_by_state : 1,
 				split_by_removable : 1,
 				split_by_zones : 1,
+				want_node : 1,		/* attributes to read */
+				want_zones : 1,
+				want_removable : 1,
 				have_zones : 1;
 };
 
@@ -242,7 +249,7 @@ static void add_scols_line(struct lsmem *lsmem, struct memory_block *blk)
 		}
 		case COL_SIZE:
 			if (lsmem->bytes)
-				xasprintf(&str, "%"PRId64, (uint64_t) blk->count * lsmem->block_size);
+				str = u64_to_string((uint64_t) blk->count * lsmem->block_size);
 			else
 				str = size_to_human_string(SIZE_SUFFIX_1LETTER,
 						(uint64_t) blk->count * lsmem->block_size);
@@ -260,7 +267,7 @@ static void add_scols_line(struct lsmem *lsmem, struct memory_block *blk)
 			break;
 		case COL_BLOCK:
 			if (blk->count == 1)
-				xasprintf(&str, "%"PRId64, blk->index);
+				str = u64_to_string(blk->index);
 			else
 				xasprintf(&str, "%"PRId64"-%"PRId64,
 					 blk->index, blk->index + blk->count - 1);
@@ -325,12 +332,15 @@ static void print_summary(struct lsmem *lsmem)
 	}
 }
 
-static int memory_block_get_node(struct lsmem *lsmem, char *name)
+static int memory_block_get_node(struct lsmem *lsmem, char *name, uint64_t index)
 {
 	struct dirent *de;
 	DIR *dir;
 	int node;
 
+	if (index < lsmem->nnodemap && lsmem->nodemap[index] >= 0)
+		return lsmem->nodemap[index];
+
 	dir = ul_path_opendir(lsmem->sysmem, name);
 	if (!dir)
 		err(EXIT_FAILURE, _("Failed to open %s"), name);
@@ -367,7 +377,8 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 	if (errno)
 		rc = -errno;
 
-	if (ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
+	if (lsmem->want_removable
+	    && ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
 		blk->removable = x == 1;
 
 	if (ul_path_readf_string(lsmem->sysmem, &line, "%s/state", name) > 0 && line) {
@@ -380,11 +391,11 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 		free(line);
 	}
 
-	if (lsmem->have_nodes)
-		blk->node = memory_block_get_node(lsmem, name);
+	if (lsmem->have_nodes && lsmem->want_node)
+		blk->node = memory_block_get_node(lsmem, name, blk->index);
 
 	blk->nr_zones = 0;
-	if (lsmem->have_zones
+	if (lsmem->have_zones && lsmem->want_zones
 	    && ul_path_readf_string(lsmem->sysmem, &line, "%s/valid_zones", name) > 0
 	    && line) {
 
@@ -440,6 +451,7 @@ static void free_info(struct lsmem *lsmem)
 	if (!lsmem)
 		return;
 	free(lsmem->blocks);
+	free(lsmem->nodemap);
 	for (i = 0; i < lsmem->ndirs; i++)
 		free(lsmem->dirs[i]);
 	free(lsmem->dirs);
@@ -482,6 +494,64 @@ static int memory_block_filter(const struct dirent *de)
 	return isdigit_string(de->d_name + 6);
 }
 
+/*
+ * Reads node<N>/memory<M> links from the node directories; that's one
+ * directory per node rather than one per memory block.
+ */
+static void read_node_map(struct lsmem *lsmem)
+{
+	struct path_cxt *pc;
+	struct dirent *de;
+	DIR *dir;
+
+	pc = ul_new_path(_PATH_SYS_NODE);
+	if (!pc)
+		return;
+	if (ul_path_set_prefix(pc, ul_path_get_prefix(lsmem->sysmem)) != 0)
+		goto done;
+
+	dir = ul_path_opendir(pc, NULL);
+	if (!dir)
+		goto done;
+
+	while ((de = readdir(dir)) != NULL) {
+		struct dirent *me;
+		DIR *nodedir;
+		int node;
+
+		if (strncmp("node", de->d_name, 4) != 0
+		    || !isdigit_string(de->d_name + 4))
+			continue;
+		node = strtol(de->d_name + 4, NULL, 10);
+
+		nodedir = ul_path_opendir(pc, de->d_name);
+		if (!nodedir)
+			continue;
+
+		while ((me = readdir(nodedir)) != NULL) {
+			uint64_t idx;
+
+			if (strncmp("memory", me->d_name, 6) != 0
+			    || !isdigit_string(me->d_name + 6))
+				continue;
+			idx = strtoumax(me->d_name + 6, NULL, 10);
+			if (idx >= lsmem->nnodemap) {
+				size_t n = max(idx + 1, (uint64_t) lsmem->nnodemap * 2);
+
+				lsmem->nodemap = xreallocarray(lsmem->nodemap, n, sizeof(int));
+				memset(&lsmem->nodemap[lsmem->nnodemap], 0xff,
+					(n - lsmem->nnodemap) * sizeof(int));	/* -1 */
+				lsmem->nnodemap = n;
+			}
+			lsmem->nodemap[idx] = node;
+		}
+		closedir(nodedir);
+	}
+	closedir(dir);
+done:
+	ul_unref_path(pc);
+}
+
 static void read_basic_info(struct lsmem *lsmem)
 {
 	char dir[PATH_MAX];
@@ -495,8 +565,10 @@ static void read_basic_info(struct lsmem *lsmem)
 	if (lsmem->ndirs <= 0)
 		err(EXIT_FAILURE, _("Failed to read %s"), dir);
 
-	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name) != -1)
+	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name, UINT64_MAX) != -1)
 		lsmem->have_nodes = 1;
+	if (lsmem->have_nodes && lsmem->want_node)
+		read_node_map(lsmem);
 
 	/* The valid_zones sysmem attribute was introduced with kernel 3.18 */
 	if (ul_path_access(lsmem->sysmem, F_OK, "memory0/valid_zones") == 0)
@@ -743,6 +815,24 @@ int main(int argc, char **argv)
 		/* follow output columns */
 		set_split_policy(lsmem, columns, ncolumns);
 
+	/* read only the attributes used for the output or for the split */
+	lsmem->want_node = lsmem->split_by_node;
+	lsmem->want_zones = lsmem->split_by_zones;
+	lsmem->want_removable = lsmem->split_by_removable;
+	for (i = 0; i < ncolumns; i++) {
+		switch (get_column_id(i)) {
+		case COL_NODE:
+			lsmem->want_node = 1;
+			break;
+		case COL_ZONES:
+			lsmem->want_zones = 1;
+			break;
+		case COL_REMOVABLE:
+			lsmem->want_removable = 1;
+			break;
+		}
+	}
+
 	/*
 	 * Read data and print output
 	 */
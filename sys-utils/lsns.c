@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <dirent.h>
+#include <search.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -203,6 +204,9 @@ struct lsns {
 	struct list_head processes;
 	struct list_head namespaces;
 
+	void	*proc_tree;	/* processes indexed by PID */
+	void	*ns_tree;	/* namespaces indexed by inode */
+
 	pid_t	fltr_pid;	/* filter out by PID */
 	ino_t	fltr_ns;	/* filter out by namespace */
 	int	fltr_types[ARRAY_SIZE(ns_names)];
@@ -227,6 +231,7 @@ struct netnsid_cache {
 };
 
 static struct list_head netnsids_cache;
+static void *netnsids_tree;	/* netnsids_cache indexed by inode */
 
 static int netlink_fd = -1;
 
@@ -366,19 +371,25 @@ error:
 	return rc;
 }
 
+static void ignore_free(void *data __attribute__((__unused__)))
+{
+}
+
 #ifdef HAVE_LINUX_NET_NAMESPACE_H
+static int cmp_netnsid_caches(const void *a, const void *b)
+{
+	return cmp_numbers(((const struct netnsid_cache *) a)->ino,
+			   ((const struct netnsid_cache *) b)->ino);
+}
+
 static int netnsid_cache_find(ino_t netino, int *netnsid)
 {
-	struct list_head *p;
+	struct netnsid_cache key = { .ino = netino }, **e;
 
-	list_for_each(p, &netnsids_cache) {
-		struct netnsid_cache *e = list_entry(p,
-						     struct netnsid_cache,
-						     netnsids);
-		if (e->ino == netino) {
-			*netnsid = e->id;
-			return 1;
-		}
+	e = tfind(&key, &netnsids_tree, cmp_netnsid_caches);
+	if (e) {
+		*netnsid = (*e)->id;
+		return 1;
 	}
 
 	return 0;
@@ -393,6 +404,8 @@ static void netnsid_cache_add(ino_t netino, int netnsid)
 	e->id  = netnsid;
 	INIT_LIST_HEAD(&e->netnsids);
 	list_add(&e->netnsids, &netnsids_cache);
+	if (!tsearch(e, &netnsids_tree, cmp_netnsid_caches))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 }
 
 static int get_netnsid_via_netlink_send_request(int target_fd)
@@ -498,6 +511,20 @@ static int get_netnsid(int dir __attribute__((__unused__)),
 }
 #endif /* HAVE_LINUX_NET_NAMESPACE_H */
 
+static int cmp_processes(const void *a, const void *b)
+{
+	return cmp_numbers(((const struct lsns_process *) a)->pid,
+			   ((const struct lsns_process *) b)->pid);
+}
+
+static struct lsns_process *get_process(struct lsns *ls, pid_t pid)
+{
+	struct lsns_process key = { .pid = pid }, **proc;
+
+	proc = tfind(&key, &ls->proc_tree, cmp_processes);
+	return proc ? *proc : NULL;
+}
+
 static int read_process(struct lsns *ls, pid_t pid)
 {
 	struct lsns_process *p = NULL;
@@ -556,6 +583,8 @@ static int read_process(struct lsns *ls, pid_t pid)
 
 	DBG(PROC, ul_debugobj(p, "new pid=%d", p->pid));
 	list_add_tail(&p->processes, &ls->processes);
+	if (!tsearch(p, &ls->proc_tree, cmp_processes))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 done:
 	if (f)
 		fclose(f);
@@ -596,30 +625,26 @@ static int read_processes(struct lsns *ls)
 	return rc;
 }
 
-static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
+static int cmp_namespace_ids(const void *a, const void *b)
 {
-	struct list_head *p;
+	return cmp_numbers(((const struct lsns_namespace *) a)->id,
+			   ((const struct lsns_namespace *) b)->id);
+}
 
-	list_for_each(p, &ls->namespaces) {
-		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
+static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
+{
+	struct lsns_namespace key = { .id = ino }, **ns;
 
-		if (ns->id == ino)
-			return ns;
-	}
-	return NULL;
+	ns = tfind(&key, &ls->ns_tree, cmp_namespace_ids);
+	return ns ? *ns : NULL;
 }
 
-static int namespace_has_process(struct lsns_namespace *ns, pid_t pid)
+static int namespace_has_process(struct lsns *ls, struct lsns_namespace *ns, pid_t pid)
 {
-	struct list_head *p;
+	struct lsns_process *proc = get_process(ls, pid);
 
-	list_for_each(p, &ns->processes) {
-		struct lsns_process *proc = list_entry(p, struct lsns_process, ns_siblings[ns->type]);
-
-		if (proc->pid == pid)
-			return 1;
-	}
-	return 0;
+	/* read_namespaces() adds every process to all its namespaces */
+	return proc && proc->ns_ids[ns->type] == ns->id;
 }
 
 static struct lsns_namespace *add_namespace(struct lsns *ls, int type, ino_t ino,
@@ -641,25 +666,16 @@ static struct lsns_namespace *add_namespace(struct lsns *ls, int type, ino_t ino
 	ns->related_id[RELA_OWNER] = owner_ino;
 
 	list_add_tail(&ns->namespaces, &ls->namespaces);
+	if (!tsearch(ns, &ls->ns_tree, cmp_namespace_ids))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 	return ns;
 }
 
-static int add_process_to_namespace(struct lsns *ls, struct lsns_namespace *ns, struct lsns_process *proc)
+static int add_process_to_namespace(struct lsns_namespace *ns, struct lsns_process *proc)
 {
-	struct list_head *p;
-
 	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
 		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
 
-	list_for_each(p, &ls->processes) {
-		struct lsns_process *xproc = list_entry(p, struct lsns_process, processes);
-
-		if (xproc->pid == proc->ppid)		/* my parent */
-			proc->parent = xproc;
-		else if (xproc->ppid == proc->pid)	/* my child */
-			xproc->parent = proc;
-	}
-
 	list_add_tail(&proc->ns_siblings[ns->type], &ns->processes);
 	ns->nprocs++;
 
@@ -817,24 +833,17 @@ static void read_related_namespaces(struct lsns *ls)
 
 	list_for_each(p, &ls->namespaces) {
 		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-		struct list_head *pp;
-		list_for_each(pp, &ls->namespaces) {
-			struct lsns_namespace *pns = list_entry(pp, struct lsns_namespace, namespaces);
-			if (ns->type == LSNS_ID_USER
-			    || ns->type == LSNS_ID_PID) {
-				if (ns->related_id[RELA_PARENT] == pns->id)
-					ns->related_ns[RELA_PARENT] = pns;
-				if (ns->related_id[RELA_OWNER] == pns->id)
-					ns->related_ns[RELA_OWNER] = pns;
-				if (ns->related_ns[RELA_PARENT] && ns->related_ns[RELA_OWNER])
-					break;
-			} else {
-				if (ns->related_id[RELA_OWNER] == pns->id) {
-					ns->related_ns[RELA_OWNER] = pns;
-					break;
-				}
-			}
+		struct lsns_namespace *pns;
+
+		if (ns->type == LSNS_ID_USER
+		    || ns->type == LSNS_ID_PID) {
+			pns = get_namespace(ls, ns->related_id[RELA_PARENT]);
+			if (pns)
+				ns->related_ns[RELA_PARENT] = pns;
 		}
+		pns = get_namespace(ls, ns->related_id[RELA_OWNER]);
+		if (pns)
+			ns->related_ns[RELA_OWNER] = pns;
 
 		/* lsns scans /proc/[0-9]+ for finding namespaces.
 		 * So if a namespace has no process, lsns cannot
@@ -913,6 +922,8 @@ static int read_namespaces(struct lsns *ls)
 		struct lsns_namespace *ns;
 		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
 
+		proc->parent = get_process(ls, proc->ppid);
+
 		for (i = 0; i < ARRAY_SIZE(proc->ns_ids); i++) {
 			if (proc->ns_ids[i] == 0)
 				continue;
@@ -922,7 +933,7 @@ static int read_namespaces(struct lsns *ls)
 				if (!ns)
 					return -ENOMEM;
 			}
-			add_process_to_namespace(ls, ns, proc);
+			add_process_to_namespace(ns, proc);
 		}
 	}
 
@@ -1192,7 +1203,7 @@ static int show_namespaces(struct lsns *ls)
 	list_for_each(p, &ls->namespaces) {
 		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
 
-		if (ls->fltr_pid != 0 && !namespace_has_process(ns, ls->fltr_pid))
+		if (ls->fltr_pid != 0 && !namespace_has_process(ls, ns, ls->fltr_pid))
 			continue;
 		if (ls->persist && ns->nprocs != 0)
 			continue;
@@ -1262,6 +1273,9 @@ static void free_lsns_namespace(struct lsns_namespace *lsns_n)
 
 static void free_all(struct lsns *ls)
 {
+	tdestroy(ls->proc_tree, ignore_free);
+	tdestroy(ls->ns_tree, ignore_free);
+	tdestroy(netnsids_tree, ignore_free);
 	list_free(&ls->processes, struct lsns_process, processes, free_lsns_process);
 	list_free(&netnsids_cache, struct netnsid_cache, netnsids, free_netnsid_caches);
 	list_free(&ls->namespaces, struct lsns_namespace, namespaces, free_lsns_namespace);
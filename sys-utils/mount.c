@@ -490,6 +490,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --no-canonicalize   don't canonicalize paths\n"), out);
 	fputs(_(" -f, --fake              dry run; skip the mount(2) syscall\n"), out);
 	fputs(_(" -F, --fork              fork off for each device (use with -a)\n"), out);
+	fputs(_("     --fork-max <max>    limit number of concurrent mounts (implies --fork)\n"), out);
 	fputs(_(" -T, --fstab <path>      alternative file to /etc/fstab\n"), out);
 	fputs(_(" -i, --internal-only     don't call the mount.<type> helpers\n"), out);
 	fputs(_(" -l, --show-labels       show also filesystem labels\n"), out);
@@ -637,7 +638,8 @@ int main(int argc, char **argv)
 		MOUNT_OPT_OPTMODE,
 		MOUNT_OPT_OPTSRC,
 		MOUNT_OPT_OPTSRC_FORCE,
-		MOUNT_OPT_ONLYONCE
+		MOUNT_OPT_ONLYONCE,
+		MOUNT_OPT_FORK_MAX
 	};
 
 	static const struct option longopts[] = {
@@ -645,6 +647,7 @@ int main(int argc, char **argv)
 		{ "fake",             no_argument,       NULL, 'f'                   },
 		{ "fstab",            required_argument, NULL, 'T'                   },
 		{ "fork",             no_argument,       NULL, 'F'                   },
+		{ "fork-max",         required_argument, NULL, MOUNT_OPT_FORK_MAX    },
 		{ "help",             no_argument,       NULL, 'h'                   },
 		{ "no-mtab",          no_argument,       NULL, 'n'                   },
 		{ "read-only",        no_argument,       NULL, 'r'                   },
@@ -904,6 +907,11 @@ int main(int argc, char **argv)
 		case MOUNT_OPT_ONLYONCE:
 			mnt_context_enable_onlyonce(cxt, 1);
 			break;
+		case MOUNT_OPT_FORK_MAX:
+			mnt_context_enable_fork(cxt, TRUE);
+			mnt_context_set_max_children(cxt,
+				strtou32_or_err(optarg, _("failed to parse fork limit")));
+			break;
 		case 'h':
 			mnt_free_context(cxt);
 			usage();
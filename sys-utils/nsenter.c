@@ -23,6 +23,7 @@
 #include <grp.h>
 #include <sys/stat.h>
 #include <sys/statfs.h>
+#include <paths.h>
 
 #include <sys/ioctl.h>
 #ifdef HAVE_LINUX_NSFS_H
@@ -49,6 +50,7 @@
 #include "caputils.h"
 #include "statfs_magic.h"
 #include "pathnames.h"
+#include "pidfd-utils.h"
 
 static struct namespace_file {
 	int nstype;
@@ -107,6 +109,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -e, --env              inherit environment variables from target process\n"), out);
 	fputs(_(" -F, --no-fork          do not fork before exec'ing <program>\n"), out);
 	fputs(_(" -c, --join-cgroup      join the cgroup of the target process\n"), out);
+	fputs(_(" -B, --batch <file>     run commands from <file> in the namespaces\n"), out);
 #ifdef HAVE_LIBSELINUX
 	fputs(_(" -Z, --follow-context   set SELinux context according to --target PID\n"), out);
 #endif
@@ -277,6 +280,67 @@ static int is_usable_namespace(pid_t target, const struct namespace_file *nsfile
 	return true; /* All pass */
 }
 
+/*
+ * Enters all @namespaces of the target process by one setns(2) call. The
+ * kernel does it atomically (since Linux 5.8), so nothing is changed on
+ * failure and the caller can fall back to the /proc/<pid>/ns files.
+ */
+static int enter_by_pidfd(int pidfd, int namespaces)
+{
+#ifdef UL_HAVE_PIDFD
+	if (pidfd >= 0 && setns(pidfd, namespaces) == 0)
+		return 0;
+#endif
+	return -1;
+}
+
+/*
+ * Runs the commands from @f, one per line, by the shell. Empty lines and
+ * lines starting with '#' are ignored. Returns the exit status of the last
+ * failed command, or EXIT_SUCCESS.
+ */
+static int run_batch(FILE *f)
+{
+	const char *shell = getenv("SHELL");
+	char *line = NULL;
+	size_t sz = 0;
+	int rc = EXIT_SUCCESS;
+
+	if (!shell || !*shell)
+		shell = _PATH_BSHELL;
+
+	/* Clear any inherited settings */
+	signal(SIGCHLD, SIG_DFL);
+
+	while (getline(&line, &sz, f) != -1) {
+		char *cmd = (char *) skip_space(line);
+		pid_t child;
+		int status;
+
+		rtrim_whitespace((unsigned char *) cmd);
+		if (!*cmd || *cmd == '#')
+			continue;
+
+		fflush(stdout);
+		child = fork();
+		if (child < 0)
+			err(EXIT_FAILURE, _("fork failed"));
+		if (child == 0) {
+			execl(shell, shell, "-c", cmd, (char *) NULL);
+			errexec(shell);
+		}
+		if (waitpid(child, &status, 0) != child)
+			err(EXIT_FAILURE, _("waitpid failed"));
+
+		if (WIFEXITED(status) && WEXITSTATUS(status))
+			rc = WEXITSTATUS(status);
+		else if (WIFSIGNALED(status))
+			rc = WTERMSIG(status) + 128;
+	}
+	free(line);
+	return rc;
+}
+
 static void continue_as_child(void)
 {
 	pid_t child;
@@ -341,6 +405,7 @@ int main(int argc, char *argv[])
 		{ "env", no_argument, NULL, 'e' },
 		{ "no-fork", no_argument, NULL, 'F' },
 		{ "join-cgroup", no_argument, NULL, 'c'},
+		{ "batch", required_argument, NULL, 'B' },
 		{ "preserve-credentials", no_argument, NULL, OPT_PRESERVE_CRED },
 		{ "keep-caps", no_argument, NULL, OPT_KEEPCAPS },
 		{ "user-parent", no_argument, NULL, OPT_USER_PARENT},
@@ -357,6 +422,8 @@ int main(int argc, char *argv[])
 
 	struct namespace_file *nsfile;
 	int c, pass, namespaces = 0, setgroups_nerrs = 0, preserve_cred = 0;
+	int pidfd = -1;
+	FILE *batch = NULL;
 	bool do_rd = false, do_wd = false, do_uid = false, force_uid = false,
 	     do_gid = false, force_gid = false, do_env = false, do_all = false,
 	     do_join_cgroup = false, do_user_parent = false;
@@ -376,7 +443,7 @@ int main(int argc, char *argv[])
 	close_stdout_atexit();
 
 	while ((c =
-		getopt_long(argc, argv, "+ahVt:m::u::i::n::p::C::U::T::S:G:r::w::W::ecFZ",
+		getopt_long(argc, argv, "+ahVt:m::u::i::n::p::C::U::T::S:G:r::w::W::ecB:FZ",
 			    longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
@@ -457,6 +524,14 @@ int main(int argc, char *argv[])
 		case 'c':
 			do_join_cgroup = true;
 			break;
+		case 'B':
+			if (batch && batch != stdin)
+				fclose(batch);
+			batch = strcmp(optarg, "-") == 0 ? stdin :
+				fopen(optarg, "r" UL_CLOEXECSTR);
+			if (!batch)
+				err(EXIT_FAILURE, _("cannot open %s"), optarg);
+			break;
 		case 'r':
 			if (optarg)
 				open_target_fd(&root_fd, "root", optarg);
@@ -527,12 +602,31 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (batch && optind < argc)
+		errx(EXIT_FAILURE, _("--batch and <program> are mutually exclusive"));
+
+#ifdef UL_HAVE_PIDFD
+	/*
+	 * All namespaces from the target process are entered by pidfd, the
+	 * namespace files are opened only if it is not supported.
+	 */
+	if (namespace_target_pid && namespaces && !do_user_parent) {
+		for (nsfile = namespace_files; nsfile->nstype; nsfile++) {
+			if (nsfile->fd >= 0)
+				break;
+		}
+		if (!nsfile->nstype)
+			pidfd = pidfd_open(namespace_target_pid, 0);
+	}
+#endif
 	/*
 	 * Open remaining namespace and directory descriptors.
 	 */
-	for (nsfile = namespace_files; nsfile->nstype; nsfile++)
-		if (nsfile->nstype & namespaces)
-			open_namespace_fd(nsfile->nstype, NULL);
+	if (pidfd < 0) {
+		for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+			if (nsfile->nstype & namespaces)
+				open_namespace_fd(nsfile->nstype, NULL);
+	}
 	if (do_rd)
 		open_target_fd(&root_fd, "root", NULL);
 	if (do_wd)
@@ -573,6 +667,20 @@ int main(int argc, char *argv[])
 			setgroups_nerrs++;
 	}
 
+	if (pidfd >= 0) {
+		if (enter_by_pidfd(pidfd, namespaces) == 0) {
+			if ((namespaces & CLONE_NEWPID) && do_fork == -1)
+				do_fork = 1;
+		} else {
+			/* old kernel, use the namespace files */
+			for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+				if (nsfile->nstype & namespaces)
+					open_namespace_fd(nsfile->nstype, NULL);
+		}
+		close(pidfd);
+		pidfd = -1;
+	}
+
 	/*
 	 * Now that we know which namespaces we want to enter, enter
 	 * them.  Do this in two passes, not entering the user
@@ -687,6 +795,9 @@ int main(int argc, char *argv[])
 	if (keepcaps && (namespaces & CLONE_NEWUSER))
 		cap_permitted_to_ambient();
 
+	if (batch)
+		return run_batch(batch);
+
 	if (optind < argc) {
 		execvp(argv[optind], argv + optind);
 		errexec(argv[optind]);
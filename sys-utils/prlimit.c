@@ -11,6 +11,7 @@
  * prlimit - get/set process resource limits.
  */
 #include <errno.h>
+#include <signal.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,6 +30,7 @@
 #include "strutils.h"
 #include "list.h"
 #include "closestream.h"
+#include "procfs.h"
 
 #ifndef RLIMIT_RTTIME
 # define RLIMIT_RTTIME 15
@@ -134,6 +136,7 @@ static int ncolumns;
 
 static pid_t pid; /* calling process (default) */
 static int verbose;
+static int skip_unchanged;
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <sys/syscall.h>
@@ -158,6 +161,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fprintf(out,
 		_(" %s [options] [--<resource>=<limit>] [-p PID]\n"), program_invocation_short_name);
+	fprintf(out,
+		_(" %s [options] --<resource>=<limit> --cgroup <path>|--tree <pid>\n"), program_invocation_short_name);
 	fprintf(out,
 		_(" %s [options] [--<resource>=<limit>] COMMAND\n"), program_invocation_short_name);
 
@@ -166,6 +171,9 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -p, --pid <pid>        process id\n"
+		"     --cgroup <path>    all processes in the cgroup\n"
+		"     --tree <pid>       process and all its descendants\n"
+		"     --skip-unchanged   don't set limits which are already in place\n"
 		" -o, --output <list>    define which output columns to use\n"
 		"     --noheadings       don't print headings\n"
 		"     --raw              use the raw output format\n"
@@ -343,6 +351,25 @@ static void get_unknown_hardsoft(struct prlimit *lim)
 		lim->rlim.rlim_max = old.rlim_max;
 }
 
+static void print_new_limit(struct prlimit *lim, pid_t who, struct rlimit *new)
+{
+	printf(_("New %s limit for pid %d: "), lim->desc->name, who);
+	if (new->rlim_cur == RLIM_INFINITY)
+		printf("<%s", _("unlimited"));
+	else
+		printf("<%ju", (uintmax_t)new->rlim_cur);
+
+	if (new->rlim_max == RLIM_INFINITY)
+		printf(":%s>\n", _("unlimited"));
+	else
+		printf(":%ju>\n", (uintmax_t)new->rlim_max);
+}
+
+static inline int is_same_limit(const struct rlimit *a, const struct rlimit *b)
+{
+	return a->rlim_cur == b->rlim_cur && a->rlim_max == b->rlim_max;
+}
+
 static void do_prlimit(struct list_head *lims)
 {
 	struct list_head *p, *pnext;
@@ -361,22 +388,21 @@ static void do_prlimit(struct list_head *lims)
 				errx(EXIT_FAILURE, _("the soft limit %s cannot exceed the hard limit"),
 						lim->desc->name);
 			new = &lim->rlim;
+
+			if (skip_unchanged) {
+				struct rlimit cur;
+
+				if (prlimit(pid, lim->desc->resource, NULL, &cur) == 0 &&
+				    is_same_limit(&cur, new)) {
+					rem_prlim(lim);
+					continue;
+				}
+			}
 		} else
 			old = &lim->rlim;
 
-		if (verbose && new) {
-			printf(_("New %s limit for pid %d: "), lim->desc->name,
-				pid ? pid : getpid());
-			if (new->rlim_cur == RLIM_INFINITY)
-				printf("<%s", _("unlimited"));
-			else
-				printf("<%ju", (uintmax_t)new->rlim_cur);
-
-			if (new->rlim_max == RLIM_INFINITY)
-				printf(":%s>\n", _("unlimited"));
-			else
-				printf(":%ju>\n", (uintmax_t)new->rlim_max);
-		}
+		if (verbose && new)
+			print_new_limit(lim, pid ? pid : getpid(), new);
 
 		if (prlimit(pid, lim->desc->resource, new, old) == -1)
 			err(EXIT_FAILURE, lim->modify ?
@@ -389,6 +415,60 @@ static void do_prlimit(struct list_head *lims)
 	}
 }
 
+/*
+ * Sets the limits for all @tasks; one prlimit(2) call reads the current
+ * limit and, if it differs, the second one sets the new limit. Exited tasks
+ * are ignored. Returns number of failed tasks.
+ */
+static size_t do_prlimit_tasks(struct list_head *lims, pid_t *tasks, size_t ntasks)
+{
+	struct list_head *p;
+	size_t i, nerrs = 0;
+
+	for (i = 0; i < ntasks; i++) {
+		list_for_each(p, lims) {
+			struct prlimit *lim = list_entry(p, struct prlimit, lims);
+			struct rlimit old, new = lim->rlim;
+			int resource = lim->desc->resource;
+
+			if (prlimit(tasks[i], resource, NULL, &old) == -1) {
+				if (errno == ESRCH)
+					break;
+				warn(_("failed to get the %s resource limit for pid %d"),
+						lim->desc->name, tasks[i]);
+				nerrs++;
+				break;
+			}
+			if (!(lim->modify & PRLIMIT_SOFT))
+				new.rlim_cur = old.rlim_cur;
+			if (!(lim->modify & PRLIMIT_HARD))
+				new.rlim_max = old.rlim_max;
+
+			if (new.rlim_cur > new.rlim_max &&
+			    (new.rlim_cur != RLIM_INFINITY || new.rlim_max != RLIM_INFINITY)) {
+				warnx(_("the soft limit %s cannot exceed the hard limit for pid %d"),
+						lim->desc->name, tasks[i]);
+				nerrs++;
+				break;
+			}
+			if (skip_unchanged && is_same_limit(&old, &new))
+				continue;
+			if (verbose)
+				print_new_limit(lim, tasks[i], &new);
+
+			if (prlimit(tasks[i], resource, &new, NULL) == -1) {
+				if (errno == ESRCH)
+					break;
+				warn(_("failed to set the %s resource limit for pid %d"),
+						lim->desc->name, tasks[i]);
+				nerrs++;
+				break;
+			}
+		}
+	}
+	return nerrs;
+}
+
 static int get_range(char *str, rlim_t *soft, rlim_t *hard, int *found)
 {
 	char *end = NULL;
@@ -491,12 +571,17 @@ static int add_prlim(char *ops, struct list_head *lims, size_t id)
 int main(int argc, char **argv)
 {
 	int opt;
-	struct list_head lims;
+	struct list_head lims, *p;
+	const char *cgroup = NULL;
+	pid_t tree = 0;
 
 	enum {
 		VERBOSE_OPTION = CHAR_MAX + 1,
 		RAW_OPTION,
-		NOHEADINGS_OPTION
+		NOHEADINGS_OPTION,
+		CGROUP_OPTION,
+		TREE_OPTION,
+		SKIP_UNCHANGED_OPTION
 	};
 
 	static const struct option longopts[] = {
@@ -523,6 +608,9 @@ int main(int argc, char **argv)
 		{ "noheadings", no_argument, NULL, NOHEADINGS_OPTION },
 		{ "raw",        no_argument, NULL, RAW_OPTION },
 		{ "verbose",    no_argument, NULL, VERBOSE_OPTION },
+		{ "cgroup",     required_argument, NULL, CGROUP_OPTION },
+		{ "tree",       required_argument, NULL, TREE_OPTION },
+		{ "skip-unchanged", no_argument, NULL, SKIP_UNCHANGED_OPTION },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -613,6 +701,17 @@ int main(int argc, char **argv)
 		case RAW_OPTION:
 			raw = 1;
 			break;
+		case CGROUP_OPTION:
+			cgroup = optarg;
+			break;
+		case TREE_OPTION:
+			tree = strtos32_or_err(optarg, _("invalid PID argument"));
+			if (tree <= 0)
+				errx(EXIT_FAILURE, _("invalid PID argument"));
+			break;
+		case SKIP_UNCHANGED_OPTION:
+			skip_unchanged = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -624,6 +723,42 @@ int main(int argc, char **argv)
 	}
 	if (argc > optind && pid)
 		errx(EXIT_FAILURE, _("options --pid and COMMAND are mutually exclusive"));
+	if (cgroup || tree) {
+		pid_t *tasks = NULL;
+		size_t ntasks = 0;
+		int rc;
+
+		if (!!pid + !!cgroup + !!tree > 1 || argc > optind)
+			errx(EXIT_FAILURE, _("options --pid, --cgroup, --tree and COMMAND are mutually exclusive"));
+		if (list_empty(&lims))
+			errx(EXIT_FAILURE, _("options --cgroup and --tree require a new limit"));
+		list_for_each(p, &lims) {
+			struct prlimit *lim = list_entry(p, struct prlimit, lims);
+
+			if (!lim->modify)
+				errx(EXIT_FAILURE, _("options --cgroup and --tree require a new limit"));
+		}
+
+		if (cgroup) {
+			rc = ul_cgroup_get_tasks(cgroup, 0, &tasks, &ntasks);
+			if (rc) {
+				errno = -rc;
+				err(EXIT_FAILURE, _("failed to read tasks of %s"), cgroup);
+			}
+		} else {
+			if (kill(tree, 0) != 0 && errno == ESRCH)
+				errx(EXIT_FAILURE, _("process %d not found"), tree);
+			rc = procfs_get_descendants(tree, &tasks, &ntasks);
+			if (rc) {
+				errno = -rc;
+				err(EXIT_FAILURE, _("failed to read descendants of %d"), tree);
+			}
+		}
+
+		rc = do_prlimit_tasks(&lims, tasks, ntasks) ? EXIT_FAILURE : EXIT_SUCCESS;
+		free(tasks);
+		return rc;
+	}
 	if (!ncolumns) {
 		/* default columns */
 		columns[ncolumns++] = COL_RES;
@@ -49,6 +49,9 @@
 #include "nls.h"
 #include "xalloc.h"
 #include "closestream.h"
+#include "all-io.h"
+#include "jsonwrt.h"
+#include "optutils.h"
 
 #define S_LEN 128
 
@@ -88,6 +91,56 @@ static char *boot_uname_r_str(void)
 	return s;
 }
 
+/* reads the whole profiling buffer, returns its size in @len */
+static unsigned int *read_profile(const char *file, size_t *len)
+{
+	unsigned int *buf;
+	ssize_t rc;
+	int fd;
+
+	/* Use an fd for the profiling buffer, to skip stdio overhead */
+	if (((fd = open(file, O_RDONLY)) < 0)
+	    || ((int)(*len = lseek(fd, 0, SEEK_END)) < 0)
+	    || (lseek(fd, 0, SEEK_SET) < 0))
+		err(EXIT_FAILURE, "%s", file);
+	if (!*len)
+		errx(EXIT_FAILURE, "%s: %s", file, _("input file is empty"));
+
+	buf = xmalloc(*len);
+
+	rc = read_all(fd, (char *) buf, *len);
+	if (rc < 0 || (size_t) rc != *len)
+		err(EXIT_FAILURE, "%s", file);
+	close(fd);
+	return buf;
+}
+
+/* saves the raw profiling buffer, the file is usable by --profile and --delta */
+static void write_snapshot(const char *file, const unsigned int *buf, size_t len)
+{
+	int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), file);
+	if (write_all(fd, buf, len) != 0 || close(fd) != 0)
+		err(EXIT_FAILURE, _("write failed: %s"), file);
+}
+
+static void swap_profile(unsigned int *buf, size_t entries)
+{
+	unsigned int *p;
+	size_t i;
+
+	for (p = buf; p < buf + entries; p++)
+		for (i = 0; i < sizeof(*buf) / 2; i++) {
+			unsigned char *b = (unsigned char *)p;
+			unsigned char tmp;
+			tmp = b[i];
+			b[i] = b[sizeof(*buf) - i - 1];
+			b[sizeof(*buf) - i - 1] = tmp;
+		}
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -112,6 +165,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --counters            print individual counters within functions\n"), out);
 	fputs(_(" -r, --reset               reset all the counters (root only)\n"), out);
 	fputs(_(" -n, --no-auto             disable byte order auto-detection\n"), out);
+	fputs(_(" -S, --snapshot <file>     save the profiling buffer to <file>\n"), out);
+	fputs(_(" -D, --delta <file>        print only ticks since the <file> snapshot\n"), out);
+	fputs(_(" -J, --json                use JSON output format\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(27));
 	fprintf(out, USAGE_MAN_TAIL("readprofile(8)"));
@@ -121,8 +177,9 @@ static void __attribute__((__noreturn__)) usage(void)
 int main(int argc, char **argv)
 {
 	FILE *map;
-	int proFd, has_mult = 0, multiplier = 0;
-	char *mapFile, *proFile;
+	int has_mult = 0, multiplier = 0;
+	char *mapFile, *proFile, *snapFile = NULL, *deltaFile = NULL;
+	unsigned int *prev = NULL;
 	size_t len = 0, indx = 1;
 	unsigned long long add0 = 0;
 	unsigned int step;
@@ -131,9 +188,9 @@ int main(int argc, char **argv)
 	char fn_name[S_LEN], next_name[S_LEN];	/* current and next name */
 	char mode[8];
 	int c;
-	ssize_t rc;
 	int optAll = 0, optInfo = 0, optReset = 0, optVerbose = 0, optNative = 0;
-	int optBins = 0, optSub = 0;
+	int optBins = 0, optSub = 0, optJSON = 0;
+	struct ul_jsonwrt json;
 	char mapline[S_LEN];
 	int maplineno = 1;
 	int popenMap;		/* flag to tell if popen() has been used */
@@ -151,10 +208,19 @@ int main(int argc, char **argv)
 		{"counters", no_argument, NULL, 's'},
 		{"reset", no_argument, NULL, 'r'},
 		{"no-auto", no_argument, NULL, 'n'},
+		{"snapshot", required_argument, NULL, 'S'},
+		{"delta", required_argument, NULL, 'D'},
+		{"json", no_argument, NULL, 'J'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{NULL, 0, NULL, 0}
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'J', 'b' },
+		{ 'J', 's' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 #define next (current^1)
 
@@ -166,7 +232,10 @@ int main(int argc, char **argv)
 	proFile = defaultpro;
 	mapFile = defaultmap;
 
-	while ((c = getopt_long(argc, argv, "m:p:M:ivabsrnVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "m:p:M:ivabsrnS:D:JVh", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'm':
 			mapFile = optarg;
@@ -199,6 +268,15 @@ int main(int argc, char **argv)
 		case 'v':
 			optVerbose++;
 			break;
+		case 'S':
+			snapFile = optarg;
+			break;
+		case 'D':
+			deltaFile = optarg;
+			break;
+		case 'J':
+			optJSON = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -233,26 +311,24 @@ int main(int argc, char **argv)
 		exit(EXIT_SUCCESS);
 	}
 
-	/* Use an fd for the profiling buffer, to skip stdio overhead */
-	if (((proFd = open(proFile, O_RDONLY)) < 0)
-	    || ((int)(len = lseek(proFd, 0, SEEK_END)) < 0)
-	    || (lseek(proFd, 0, SEEK_SET) < 0))
-		err(EXIT_FAILURE, "%s", proFile);
-	if (!len)
-		errx(EXIT_FAILURE, "%s: %s", proFile, _("input file is empty"));
+	buf = read_profile(proFile, &len);
 
-	buf = xmalloc(len);
+	/* read the previous snapshot before it's overwritten by --snapshot */
+	if (deltaFile) {
+		size_t prevlen;
 
-	rc = read(proFd, buf, len);
-	if (rc < 0 || (size_t) rc != len)
-		err(EXIT_FAILURE, "%s", proFile);
-	close(proFd);
+		prev = read_profile(deltaFile, &prevlen);
+		if (prevlen != len || prev[0] != buf[0])
+			errx(EXIT_FAILURE, _("%s: snapshot does not match %s"),
+			     deltaFile, proFile);
+	}
+	if (snapFile)
+		write_snapshot(snapFile, buf, len);
 
 	if (!optNative) {
 		int entries = len / sizeof(*buf);
 		int big = 0, small = 0;
 		unsigned *p;
-		size_t i;
 
 		for (p = buf + 1; p < buf + entries; p++) {
 			if (*p & ~0U << ((unsigned) sizeof(*buf) * 4U))
@@ -263,17 +339,22 @@ int main(int argc, char **argv)
 		if (big > small) {
 			warnx(_("Assuming reversed byte order. "
 				"Use -n to force native byte order."));
-			for (p = buf; p < buf + entries; p++)
-				for (i = 0; i < sizeof(*buf) / 2; i++) {
-					unsigned char *b = (unsigned char *)p;
-					unsigned char tmp;
-					tmp = b[i];
-					b[i] = b[sizeof(*buf) - i - 1];
-					b[sizeof(*buf) - i - 1] = tmp;
-				}
+			swap_profile(buf, entries);
+			if (prev)
+				swap_profile(prev, entries);
 		}
 	}
 
+	/* the counters are reset by --reset, then use the current value */
+	if (prev) {
+		size_t i;
+
+		for (i = 1; i < len / sizeof(*buf); i++)
+			if (buf[i] >= prev[i])
+				buf[i] -= prev[i];
+		free(prev);
+	}
+
 	step = buf[0];
 	if (optInfo) {
 		printf(_("Sampling_step: %u\n"), step);
@@ -305,6 +386,12 @@ int main(int argc, char **argv)
 	if (!add0)
 		errx(EXIT_FAILURE, _("can't find \"_stext\" in %s"), mapFile);
 
+	if (optJSON) {
+		ul_jsonwrt_init(&json, stdout, 0);
+		ul_jsonwrt_root_open(&json);
+		ul_jsonwrt_array_open(&json, "readprofile");
+	}
+
 	/*
 	 * Main loop.
 	 */
@@ -356,7 +443,17 @@ int main(int argc, char **argv)
 				printf("  total\t\t\t\t%u\n", this);
 		} else if ((this || optAll) &&
 			   (fn_len = next_add - fn_add) != 0) {
-			if (optVerbose)
+			if (optJSON) {
+				char addr[sizeof(fn_add) * 2 + 1];
+
+				snprintf(addr, sizeof(addr), "%016llx", fn_add);
+				ul_jsonwrt_object_open(&json, NULL);
+				ul_jsonwrt_value_s(&json, "address", addr);
+				ul_jsonwrt_value_s(&json, "function", fn_name);
+				ul_jsonwrt_value_u64(&json, "ticks", this);
+				ul_jsonwrt_value_double(&json, "load", this / (double)fn_len);
+				ul_jsonwrt_object_close(&json);
+			} else if (optVerbose)
 				printf("%016llx %-40s %6u %8.4f\n", fn_add,
 				       fn_name, this, this / (double)fn_len);
 			else
@@ -385,12 +482,21 @@ int main(int argc, char **argv)
 			break;
 	}
 
-	/* clock ticks, out of kernel text - probably modules */
-	printf("%6u %s\n", buf[len / sizeof(*buf) - 1], "*unknown*");
-
 	if (fn_add > add0)
 		rep = total / (double)(fn_add - add0);
 
+	if (optJSON) {
+		ul_jsonwrt_array_close(&json);
+		ul_jsonwrt_value_u64(&json, "unknown", buf[len / sizeof(*buf) - 1]);
+		ul_jsonwrt_value_u64(&json, "total", total);
+		ul_jsonwrt_value_double(&json, "load", rep);
+		ul_jsonwrt_root_close(&json);
+		goto done;
+	}
+
+	/* clock ticks, out of kernel text - probably modules */
+	printf("%6u %s\n", buf[len / sizeof(*buf) - 1], "*unknown*");
+
 	/* trailer */
 	if (optVerbose)
 		printf("%016x %-40s %6u %8.4f\n",
@@ -398,7 +504,7 @@ int main(int argc, char **argv)
 	else
 		printf("%6u %-40s %8.4f\n",
 		       total, _("total"), rep);
-
+done:
 	popenMap ? pclose(map) : fclose(map);
 	exit(EXIT_SUCCESS);
 }
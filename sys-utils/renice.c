@@ -46,16 +46,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "procfs.h"
+
+/* the task lists, the arguments are not passed to setpriority() */
+#define RENICE_CGROUP	(PRIO_USER + 1)
+#define RENICE_TREE	(PRIO_USER + 2)
 
 static const char *idtype[] = {
 	[PRIO_PROCESS]	= N_("process ID"),
 	[PRIO_PGRP]	= N_("process group ID"),
 	[PRIO_USER]	= N_("user ID"),
+	[RENICE_CGROUP]	= N_("cgroup"),
+	[RENICE_TREE]	= N_("process tree"),
 };
 
+/* donice() flags */
+#define RENICE_FL_UNCHANGED	(1 << 1)	/* skip tasks with the same priority */
+#define RENICE_FL_BULK		(1 << 2)	/* ignore exited tasks */
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -63,7 +75,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %1$s [-n|--priority|--relative] <priority> [-p|--pid] <pid>...\n"
 		" %1$s [-n|--priority|--relative] <priority>  -g|--pgrp <pgid>...\n"
-		" %1$s [-n|--priority|--relative] <priority>  -u|--user <user>...\n"),
+		" %1$s [-n|--priority|--relative] <priority>  -u|--user <user>...\n"
+		" %1$s [-n|--priority|--relative] <priority>  --cgroup <path>...\n"
+		" %1$s [-n|--priority|--relative] <priority>  --tree <pid>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -79,46 +93,99 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid              interpret arguments as process ID (default)\n"), out);
 	fputs(_(" -g, --pgrp             interpret arguments as process group ID\n"), out);
 	fputs(_(" -u, --user             interpret arguments as username or user ID\n"), out);
+	fputs(_("     --cgroup           interpret arguments as cgroup paths\n"), out);
+	fputs(_("     --tree             interpret arguments as process ID, including\n"
+		"                          all its descendants\n"), out);
+	fputs(_("     --skip-unchanged   don't touch tasks with the requested priority\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(24));
 	fprintf(out, USAGE_MAN_TAIL("renice(1)"));
 	exit(EXIT_SUCCESS);
 }
 
-static int getprio(const int which, const int who, int *prio)
+static int getprio(const int which, const int who, int *prio, int flags)
 {
 	errno = 0;
 	*prio = getpriority(which, who);
 	if (*prio == -1 && errno) {
-		warn(_("failed to get priority for %d (%s)"), who, idtype[which]);
+		if (!(flags & RENICE_FL_BULK) || errno != ESRCH)
+			warn(_("failed to get priority for %d (%s)"), who, idtype[which]);
 		return -errno;
 	}
 	return 0;
 }
 
-static int donice(const int which, const int who, const int prio, const int relative)
+static int donice(const int which, const int who, const int prio,
+		  const int relative, const int flags)
 {
 	int oldprio, newprio;
 
-	if (getprio(which, who, &oldprio) != 0)
-		return 1;
+	if (getprio(which, who, &oldprio, flags) != 0)
+		return flags & RENICE_FL_BULK && errno == ESRCH ? 0 : 1;
 
 	newprio = prio; // if not relative, set absolute priority
 
 	if (relative)
 		newprio = oldprio + prio;
 
+	/* the kernel silently limits the value */
+	if ((flags & RENICE_FL_UNCHANGED) &&
+	    oldprio == max(min(newprio, PRIO_MAX - 1), PRIO_MIN))
+		return 0;
+
 	if (setpriority(which, who, newprio) < 0) {
+		if (flags & RENICE_FL_BULK && errno == ESRCH)
+			return 0;
 		warn(_("failed to set priority for %d (%s)"), who, idtype[which]);
 		return 1;
 	}
-	if (getprio(which, who, &newprio) != 0)
-		return 1;
+	if (getprio(which, who, &newprio, flags) != 0)
+		return flags & RENICE_FL_BULK && errno == ESRCH ? 0 : 1;
 	printf(_("%d (%s) old priority %d, new priority %d\n"),
 	       who, idtype[which], oldprio, newprio);
 	return 0;
 }
 
+/*
+ * Renices all threads in the cgroup, or all processes in the tree. The
+ * tasks are read once, and exited tasks are ignored.
+ */
+static int donice_tasks(const int which, const char *arg, const int prio,
+			const int relative, const int flags)
+{
+	pid_t *tasks = NULL;
+	size_t i, ntasks = 0;
+	int rc, errs = 0;
+
+	if (which == RENICE_CGROUP)
+		rc = ul_cgroup_get_tasks(arg, 1, &tasks, &ntasks);
+	else {
+		char *endptr = NULL;
+		long pid = strtol(arg, &endptr, 10);
+
+		if (pid <= 0 || *endptr) {
+			warnx(_("bad %s value: %s"), idtype[PRIO_PROCESS], arg);
+			return 1;
+		}
+		if (kill(pid, 0) != 0 && errno == ESRCH) {
+			warnx(_("process %ld not found"), pid);
+			return 1;
+		}
+		rc = procfs_get_descendants(pid, &tasks, &ntasks);
+	}
+	if (rc) {
+		errno = -rc;
+		warn(_("failed to read tasks of %s"), arg);
+		return 1;
+	}
+
+	for (i = 0; i < ntasks; i++)
+		errs |= donice(PRIO_PROCESS, tasks[i], prio, relative,
+			       flags | RENICE_FL_BULK);
+	free(tasks);
+	return errs;
+}
+
 /*
  * Change the priority (the nice value) of processes
  * or groups of processes which are already running.
@@ -127,7 +194,7 @@ int main(int argc, char **argv)
 {
 	int which = PRIO_PROCESS;
 	int who = 0, prio, errs = 0;
-	int relative = 0;
+	int relative = 0, flags = 0;
 	char *endptr = NULL;
 
 	setlocale(LC_ALL, "");
@@ -199,6 +266,22 @@ int main(int argc, char **argv)
 			which = PRIO_PROCESS;
 			continue;
 		}
+		if (strcmp(*argv, "--cgroup") == 0) {
+			which = RENICE_CGROUP;
+			continue;
+		}
+		if (strcmp(*argv, "--tree") == 0) {
+			which = RENICE_TREE;
+			continue;
+		}
+		if (strcmp(*argv, "--skip-unchanged") == 0) {
+			flags |= RENICE_FL_UNCHANGED;
+			continue;
+		}
+		if (which == RENICE_CGROUP || which == RENICE_TREE) {
+			errs |= donice_tasks(which, *argv, prio, relative, flags);
+			continue;
+		}
 		if (which == PRIO_USER) {
 			struct passwd *pwd = getpwnam(*argv);
 
@@ -221,7 +304,7 @@ int main(int argc, char **argv)
 				continue;
 			}
 		}
-		errs |= donice(which, who, prio, relative);
+		errs |= donice(which, who, prio, relative, flags);
 	}
 	return errs != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -24,6 +24,7 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include <libsmartcols.h>
 
@@ -36,6 +37,7 @@
 #include "strutils.h"
 #include "optutils.h"
 #include "closestream.h"
+#include "monotonic.h"
 
 #include "swapheader.h"
 #include "swapprober.h"
@@ -83,11 +85,22 @@
 # define UUID_STR_LEN	37
 #endif
 
+/* max number of threads to read the headers for --all */
+#define SWAPON_MAX_THREADS	16
+
 enum {
 	SIG_SWAPSPACE = 1,
 	SIG_SWSUSPEND
 };
 
+/* swap_probe() failures */
+enum {
+	PROBE_ERR_OPEN = 1,
+	PROBE_ERR_STAT,
+	PROBE_ERR_SIZE,
+	PROBE_ERR_HEADER
+};
+
 /* column names */
 struct colinfo {
         const char * const	name; /* header */
@@ -129,6 +142,32 @@ struct swap_device {
 	const char *label;		/* swap label */
 	const char *uuid;		/* unique identifier */
 	unsigned int pagesize;
+
+	/* read by swap_probe() */
+	struct stat st;
+	unsigned long long devsize;
+	char *hdr;			/* swap header */
+	int sig;			/* SIG_* */
+	int probe_err;			/* PROBE_ERR_* */
+	int probe_errno;
+	usec_t probe_time;		/* microseconds */
+
+	unsigned int probed:1;
+};
+
+/* --all entry */
+struct swap_entry {
+	struct swap_device dev;
+	struct swap_prop prop;
+	size_t order;			/* position in fstab */
+};
+
+/* --all headers reading queue */
+struct swap_queue {
+	struct swap_entry *ents;
+	size_t nents;
+	size_t next;
+	pthread_mutex_t lock;
 };
 
 /* control struct */
@@ -521,59 +560,107 @@ static void swap_get_info(struct swap_device *dev, const char *hdr)
 	}
 }
 
+/*
+ * Reads everything necessary for swapon_checks() from the device. It does not
+ * print anything and does not modify the device, so it's possible to call it
+ * for more devices in parallel.
+ */
+static void swap_probe(struct swap_device *dev)
+{
+	struct timeval start, end;
+	int fd;
+
+	assert(dev);
+	assert(dev->path);
+
+	gettime_monotonic(&start);
+	dev->probed = 1;
+
+	fd = open(dev->path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		dev->probe_err = PROBE_ERR_OPEN;
+		dev->probe_errno = errno;
+		goto done;
+	}
+	if (fstat(fd, &dev->st) < 0) {
+		dev->probe_err = PROBE_ERR_STAT;
+		dev->probe_errno = errno;
+		goto done;
+	}
+
+	if (S_ISREG(dev->st.st_mode))
+		dev->devsize = dev->st.st_size;
+	else if (S_ISBLK(dev->st.st_mode) && blkdev_get_size(fd, &dev->devsize)) {
+		dev->probe_err = PROBE_ERR_SIZE;
+		goto done;
+	}
+
+	dev->hdr = swap_get_header(fd, &dev->sig, &dev->pagesize);
+	if (!dev->hdr)
+		dev->probe_err = PROBE_ERR_HEADER;
+done:
+	if (fd != -1)
+		close(fd);
+	gettime_monotonic(&end);
+	dev->probe_time = (end.tv_sec - start.tv_sec) * USEC_PER_SEC
+			  + end.tv_usec - start.tv_usec;
+}
+
 static int swapon_checks(const struct swapon_ctl *ctl, struct swap_device *dev)
 {
-	struct stat st;
-	int fd, sig;
-	char *hdr = NULL;
-	unsigned long long devsize = 0;
+	struct stat *st;
+	int sig;
+	char *hdr;
+	unsigned long long devsize;
 	int permMask;
 
 	assert(ctl);
 	assert(dev);
 	assert(dev->path);
 
-	fd = open(dev->path, O_RDONLY);
-	if (fd == -1) {
+	if (!dev->probed)
+		swap_probe(dev);
+
+	switch (dev->probe_err) {
+	case PROBE_ERR_OPEN:
+		errno = dev->probe_errno;
 		warn(_("cannot open %s"), dev->path);
 		goto err;
-	}
-
-	if (fstat(fd, &st) < 0) {
+	case PROBE_ERR_STAT:
+		errno = dev->probe_errno;
 		warn(_("stat of %s failed"), dev->path);
 		goto err;
 	}
+	st = &dev->st;
 
-	permMask = S_ISBLK(st.st_mode) ? 07007 : 07077;
-	if ((st.st_mode & permMask) != 0)
+	permMask = S_ISBLK(st->st_mode) ? 07007 : 07077;
+	if ((st->st_mode & permMask) != 0)
 		warnx(_("%s: insecure permissions %04o, %04o suggested."),
-				dev->path, st.st_mode & 07777,
+				dev->path, st->st_mode & 07777,
 				~permMask & 0666);
 
-	if (S_ISREG(st.st_mode) && st.st_uid != 0)
+	if (S_ISREG(st->st_mode) && st->st_uid != 0)
 		warnx(_("%s: insecure file owner %d, 0 (root) suggested."),
-				dev->path, st.st_uid);
+				dev->path, st->st_uid);
 
 	/* test for holes by LBT */
-	if (S_ISREG(st.st_mode)) {
-		if (st.st_blocks * 512L < st.st_size) {
-			warnx(_("%s: skipping - it appears to have holes."),
-				dev->path);
-			goto err;
-		}
-		devsize = st.st_size;
+	if (S_ISREG(st->st_mode) && st->st_blocks * 512L < st->st_size) {
+		warnx(_("%s: skipping - it appears to have holes."),
+			dev->path);
+		goto err;
 	}
 
-	if (S_ISBLK(st.st_mode) && blkdev_get_size(fd, &devsize)) {
+	if (dev->probe_err == PROBE_ERR_SIZE) {
 		warnx(_("%s: get size failed"), dev->path);
 		goto err;
 	}
-
-	hdr = swap_get_header(fd, &sig, &dev->pagesize);
-	if (!hdr) {
+	if (dev->probe_err == PROBE_ERR_HEADER) {
 		warnx(_("%s: read swap header failed"), dev->path);
 		goto err;
 	}
+	hdr = dev->hdr;
+	sig = dev->sig;
+	devsize = dev->devsize;
 
 	if (ctl->verbose)
 		warnx(_("%s: found signature [pagesize=%d, signature=%s]"),
@@ -624,39 +711,31 @@ static int swapon_checks(const struct swapon_ctl *ctl, struct swap_device *dev)
 			goto err;
 	}
 
-	free(hdr);
-	close(fd);
+	free(dev->hdr);
+	dev->hdr = NULL;
 	return 0;
 err:
-	if (fd != -1)
-		close(fd);
-	free(hdr);
+	free(dev->hdr);
+	dev->hdr = NULL;
 	return -1;
 }
 
-static int do_swapon(const struct swapon_ctl *ctl,
-		     const struct swap_prop *prop,
-		     const char *spec,
-		     int canonic)
+static int swapon_device(const struct swapon_ctl *ctl,
+			 const struct swap_prop *prop,
+			 struct swap_device *dev)
 {
-	struct swap_device dev = { .path = NULL };
+	struct timeval start, end;
 	int status;
 	int flags = 0;
 	int priority;
 
 	assert(ctl);
 	assert(prop);
-
-	if (!canonic) {
-		dev.path = mnt_resolve_spec(spec, mntcache);
-		if (!dev.path)
-			return cannot_find(spec);
-	} else
-		dev.path = spec;
+	assert(dev);
 
 	priority = prop->priority;
 
-	if (swapon_checks(ctl, &dev))
+	if (swapon_checks(ctl, dev))
 		return -1;
 
 #ifdef SWAP_FLAG_PREFER
@@ -687,15 +766,40 @@ static int do_swapon(const struct swapon_ctl *ctl,
 	}
 
 	if (ctl->verbose)
-		printf(_("swapon %s\n"), dev.path);
+		printf(_("swapon %s\n"), dev->path);
 
-	status = swapon(dev.path, flags);
+	gettime_monotonic(&start);
+	status = swapon(dev->path, flags);
 	if (status < 0)
-		warn(_("%s: swapon failed"), dev.path);
-
+		warn(_("%s: swapon failed"), dev->path);
+
+	else if (ctl->verbose) {
+		gettime_monotonic(&end);
+		warnx(_("%s: header read in %.3f ms, swapon in %.3f ms"),
+			dev->path, dev->probe_time / 1000.0,
+			((end.tv_sec - start.tv_sec) * USEC_PER_SEC
+			 + end.tv_usec - start.tv_usec) / 1000.0);
+	}
 	return status;
 }
 
+static int do_swapon(const struct swapon_ctl *ctl,
+		     const struct swap_prop *prop,
+		     const char *spec,
+		     int canonic)
+{
+	struct swap_device dev = { .path = NULL };
+
+	if (!canonic) {
+		dev.path = mnt_resolve_spec(spec, mntcache);
+		if (!dev.path)
+			return cannot_find(spec);
+	} else
+		dev.path = spec;
+
+	return swapon_device(ctl, prop, &dev);
+}
+
 static int swapon_by_label(struct swapon_ctl *ctl, const char *label)
 {
 	char *device = mnt_resolve_tag("LABEL", label, mntcache);
@@ -748,11 +852,76 @@ static int parse_options(struct swap_prop *props, const char *options)
 }
 
 
+static void *probe_worker(void *data)
+{
+	struct swap_queue *q = data;
+
+	for (;;) {
+		struct swap_entry *ent = NULL;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->next < q->nents)
+			ent = &q->ents[q->next++];
+		pthread_mutex_unlock(&q->lock);
+
+		if (!ent)
+			break;
+		swap_probe(&ent->dev);
+	}
+	return NULL;
+}
+
+/*
+ * Reads the swap headers. It's mostly waiting for I/O (e.g. spinning disks
+ * or network block devices), so the devices are read by more threads in
+ * parallel; the main thread works too.
+ */
+static void probe_devices(struct swap_entry *ents, size_t nents)
+{
+	struct swap_queue q = {
+		.ents = ents,
+		.nents = nents
+	};
+	pthread_t threads[SWAPON_MAX_THREADS];
+	size_t i, nthreads = min(nents, (size_t) SWAPON_MAX_THREADS);
+
+	pthread_mutex_init(&q.lock, NULL);
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, probe_worker, &q) != 0) {
+			nthreads = i;	/* the rest is done by us */
+			break;
+		}
+	}
+	probe_worker(&q);
+
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&q.lock);
+}
+
+/*
+ * Higher priority first. The areas without priority get the priority from
+ * kernel in order of swapon(), so keep them in fstab order at the end.
+ */
+static int cmp_entries_priority(const void *a, const void *b)
+{
+	const struct swap_entry *x = a, *y = b;
+
+	if (x->prop.priority != y->prop.priority) {
+		if (x->prop.priority < 0 || y->prop.priority < 0)
+			return x->prop.priority < 0 ? 1 : -1;
+		return x->prop.priority > y->prop.priority ? -1 : 1;
+	}
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
 static int swapon_all(struct swapon_ctl *ctl, const char *filename)
 {
 	struct libmnt_table *tb = get_fstab(filename);
 	struct libmnt_iter *itr;
 	struct libmnt_fs *fs;
+	struct swap_entry *ents = NULL;
+	size_t i, nents = 0;
 	int status = 0;
 
 	if (!tb)
@@ -802,11 +971,36 @@ static int swapon_all(struct swapon_ctl *ctl, const char *filename)
 			continue;
 		}
 
-		/* swapon */
-		status |= do_swapon(ctl, &prop, device, TRUE);
-	}
+		for (i = 0; i < nents; i++) {
+			if (strcmp(ents[i].dev.path, device) == 0)
+				break;
+		}
+		if (i < nents) {
+			if (ctl->verbose)
+				warnx(_("%s: already active -- ignored"), device);
+			continue;
+		}
 
+		ents = xreallocarray(ents, nents + 1, sizeof(*ents));
+		memset(&ents[nents], 0, sizeof(*ents));
+		ents[nents].dev.path = device;
+		ents[nents].prop = prop;
+		ents[nents].order = nents;
+		nents++;
+	}
 	mnt_free_iter(itr);
+
+	if (!nents)
+		return status;
+
+	probe_devices(ents, nents);
+	qsort(ents, nents, sizeof(*ents), cmp_entries_priority);
+
+	/* swapon */
+	for (i = 0; i < nents; i++)
+		status |= swapon_device(ctl, &ents[i].prop, &ents[i].dev);
+
+	free(ents);
 	return status;
 }
 
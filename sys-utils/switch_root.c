@@ -34,6 +34,7 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <getopt.h>
+#include <sys/wait.h>
 
 #include "c.h"
 #include "nls.h"
@@ -122,6 +123,68 @@ done:
 	return rc;
 }
 
+/*
+ * Remove the subdirectories of the old root (usually /usr, /lib/firmware,
+ * ...) in parallel by child processes, limited by the number of CPUs. The
+ * rest is removed by recursiveRemove() later.
+ */
+static void parallelRemove(int fd)
+{
+	long nworkers = sysconf(_SC_NPROCESSORS_ONLN), running = 0;
+	struct stat rb;
+	DIR *dir;
+	int dfd;
+
+	if (nworkers <= 1)
+		return;
+
+	dfd = openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0)
+		return;
+	if (fstat(dfd, &rb) || !(dir = fdopendir(dfd))) {
+		close(dfd);
+		return;
+	}
+
+	while (1) {
+		struct dirent *d = readdir(dir);
+		struct stat sb;
+		int cfd;
+
+		if (!d)
+			break;
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+			continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)
+			continue;
+#endif
+		if (fstatat(dfd, d->d_name, &sb, AT_SYMLINK_NOFOLLOW)
+		    || !S_ISDIR(sb.st_mode) || sb.st_dev != rb.st_dev)
+			continue;
+
+		if (running == nworkers && wait(NULL) > 0)
+			running--;
+
+		switch (fork()) {
+		case 0: /* worker */
+			cfd = openat(dfd, d->d_name, O_RDONLY);
+			if (cfd >= 0)
+				recursiveRemove(cfd);
+			_exit(EXIT_SUCCESS);
+		case -1:
+			break;	/* recursiveRemove() will do it */
+		default:
+			running++;
+			break;
+		}
+	}
+	closedir(dir);
+
+	while (running > 0 && wait(NULL) > 0)
+		running--;
+}
+
 static int switchroot(const char *newroot)
 {
 	/*  Don't try to unmount the old "/", there's no way to do it. */
@@ -197,9 +260,10 @@ static int switchroot(const char *newroot)
 
 		if (fstatfs(cfd, &stfs) == 0 &&
 		    (F_TYPE_EQUAL(stfs.f_type, STATFS_RAMFS_MAGIC) ||
-		     F_TYPE_EQUAL(stfs.f_type, STATFS_TMPFS_MAGIC)))
+		     F_TYPE_EQUAL(stfs.f_type, STATFS_TMPFS_MAGIC))) {
+			parallelRemove(cfd);
 			recursiveRemove(cfd);
-		else {
+		} else {
 			warn(_("old root filesystem is not an initramfs"));
 			close(cfd);
 		}
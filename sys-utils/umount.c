@@ -342,12 +342,62 @@ done:
 	return rc;
 }
 
+static int umount_tree_cb(struct libmnt_context *cxt,
+			  struct libmnt_fs *fs __attribute__((__unused__)),
+			  int mntrc, void *data)
+{
+	int *rc = (int *) data;
+
+	*rc = mk_exit_code(cxt, mntrc);
+
+	if (*rc == MNT_EX_SUCCESS && mnt_context_is_verbose(cxt))
+		success_message(cxt);
+
+	return *rc != MNT_EX_SUCCESS;
+}
+
+/*
+ * Unmounts @target and all its submounts by one libmount call, the mount
+ * table is read only once. Returns 1 if @target is not mounted.
+ */
+static int umount_tree(struct libmnt_context *cxt, const char *target)
+{
+	int rc, xrc = MNT_EX_SUCCESS;
+
+	if (mnt_context_set_target(cxt, target))
+		err(MNT_EX_SYSERR, _("failed to set umount target"));
+
+	rc = mnt_context_umount_recursive(cxt, umount_tree_cb, &xrc);
+	mnt_reset_context(cxt);
+
+	if (rc < 0) {
+		errno = -rc;
+		warn(_("%s: recursive umount failed"), target);
+		return MNT_EX_SOFTWARE;
+	}
+	return rc == 1 ? 1 : xrc;
+}
+
 static int umount_recursive(struct libmnt_context *cxt, const char *spec)
 {
 	struct libmnt_table *tb;
 	struct libmnt_fs *fs;
 	int rc;
 
+	/* non-root users need to check permissions and drop suid for
+	 * each umount, see umount_one() */
+	if (!mnt_context_is_restricted(cxt)) {
+		rc = umount_tree(cxt, spec);
+		if (rc == 1) {
+			rc = MNT_EX_USAGE;
+			if (!quiet)
+				warnx(access(spec, F_OK) == 0 ?
+					_("%s: not mounted") :
+					_("%s: not found"), spec);
+		}
+		return rc;
+	}
+
 	tb = new_mountinfo(cxt);
 	if (!tb)
 		return MNT_EX_SOFTWARE;
@@ -420,7 +470,11 @@ static int umount_alltargets(struct libmnt_context *cxt, const char *spec, int r
 		if (mnt_fs_get_devno(fs) != devno)
 			continue;
 		mnt_context_disable_swapmatch(cxt, 1);
-		if (rec)
+		if (rec && !mnt_context_is_restricted(cxt)) {
+			rc = umount_tree(cxt, mnt_fs_get_target(fs));
+			if (rc == 1)
+				rc = MNT_EX_SUCCESS;	/* already unmounted */
+		} else if (rec)
 			rc = umount_do_recurse(cxt, tb, fs);
 		else
 			rc = umount_one_if_mounted(cxt, mnt_fs_get_target(fs));
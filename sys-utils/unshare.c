@@ -725,6 +725,61 @@ static pid_t map_ids_from_child(int *fd, uid_t mapuser,
 	exit(EXIT_SUCCESS);
 }
 
+#ifdef UL_HAVE_CLONE3
+/**
+ * clone_and_map_ids() - Create the child in new namespaces and set its maps
+ * @flags: The CLONE_NEW* flags, including CLONE_NEWUSER
+ * @mapuser: The user to map the current user to (or -1)
+ * @usermap: The range of UIDs to map (or %NULL)
+ * @mapgroup: The group to map the current group to (or -1)
+ * @groupmap: The range of GIDs to map (or %NULL)
+ *
+ * This is an alternative to map_ids_from_child(), unshare() and fork() for
+ * --fork as root. The parent stays in the original namespaces and writes the
+ * uid/gid map of the child itself, so no helper process is necessary. The
+ * child waits on a pipe until the maps are ready.
+ *
+ * Return: The pid of the child in the parent, 0 in the child.
+ */
+static pid_t clone_and_map_ids(int flags, uid_t mapuser,
+			       struct map_range *usermap, gid_t mapgroup,
+			       struct map_range *groupmap)
+{
+	char ch = PIPE_SYNC_BYTE;
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) < 0)
+		err(EXIT_FAILURE, _("pipe failed"));
+
+	pid = ul_clone3_fork(flags);
+	if (pid < 0)
+		err(EXIT_FAILURE, _("clone failed"));
+
+	if (!pid) {
+		close(fds[1]);
+		if (read_all(fds[0], &ch, 1) != 1 || ch != PIPE_SYNC_BYTE)
+			errx(EXIT_FAILURE, _("failed to set up the ID maps"));
+		close(fds[0]);
+		return 0;
+	}
+	close(fds[0]);
+
+	if (usermap) {
+		add_single_map_range(&usermap, geteuid(), mapuser);
+		map_ids_internal("uid_map", pid, usermap);
+	}
+	if (groupmap) {
+		add_single_map_range(&groupmap, getegid(), mapgroup);
+		map_ids_internal("gid_map", pid, groupmap);
+	}
+
+	write_all(fds[1], &ch, 1);
+	close(fds[1]);
+	return pid;
+}
+#endif
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -832,7 +887,7 @@ int main(int argc, char *argv[])
 
 	int setgrpcmd = SETGROUPS_NONE;
 	int unshare_flags = 0;
-	int c, forkit = 0;
+	int c, forkit = 0, clone_child = 0;
 	uid_t mapuser = -1;
 	gid_t mapgroup = -1;
 	struct map_range *usermap = NULL;
@@ -1018,15 +1073,24 @@ int main(int argc, char *argv[])
 	if (npersists && (unshare_flags & CLONE_NEWNS))
 		pid_bind = bind_ns_files_from_child(&fd_bind);
 
-	if (usermap || groupmap)
+#ifdef UL_HAVE_CLONE3
+	/* The parent only waits for the child with --fork, so it does not
+	 * have to be in the new namespaces. As root, create the child in the
+	 * namespaces and write its ID maps directly from the parent. */
+	if (forkit && (usermap || groupmap) && real_euid == 0 && !npersists &&
+	    !(unshare_flags & CLONE_NEWTIME) && ul_have_clone3())
+		clone_child = 1;
+#endif
+
+	if ((usermap || groupmap) && !clone_child)
 		pid_idmap = map_ids_from_child(&fd_idmap, mapuser, usermap,
 					       mapgroup, groupmap);
 
-	if (-1 == unshare(unshare_flags))
+	if (!clone_child && -1 == unshare(unshare_flags))
 		err(EXIT_FAILURE, _("unshare failed"));
 
 	/* Tell child we've called unshare() */
-	if (usermap || groupmap)
+	if ((usermap || groupmap) && !clone_child)
 		sync_with_child(pid_idmap, fd_idmap);
 
 	if (force_boottime)
@@ -1051,7 +1115,13 @@ int main(int argc, char *argv[])
 #endif
 		/* force child forking before mountspace binding so
 		 * pid_for_children is populated */
-		pid = fork();
+#ifdef UL_HAVE_CLONE3
+		if (clone_child)
+			pid = clone_and_map_ids(unshare_flags, mapuser, usermap,
+						mapgroup, groupmap);
+		else
+#endif
+			pid = fork();
 
 		switch(pid) {
 		case -1:
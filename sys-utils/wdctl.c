@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <libsmartcols.h>
 
@@ -138,12 +139,17 @@ struct wd_device {
 };
 
 struct wd_control {
+	/* monitor */
+	struct timespec	interval;			/* --monitor */
+	uint64_t	count;				/* --count */
+
 	/* set */
 	int		timeout;			/* --settimeout */
 	int		pretimeout;			/* --setpretimeout */
 	const char      *governor;			/* --setpregovernor */
 	unsigned int	set_timeout : 1,
-			set_pretimeout : 1;
+			set_pretimeout : 1,
+			monitor : 1;
 
 	/* output */
 	unsigned int	show_oneline : 1,
@@ -244,7 +250,9 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -r, --raw              use raw output format for flags table\n"
 		" -T, --notimeouts       don't print watchdog timeouts\n"
 		" -s, --settimeout <sec> set watchdog timeout\n"
-		" -x, --flags-only       print only flags table (same as -I -T)\n"), out);
+		" -x, --flags-only       print only flags table (same as -I -T)\n"
+		" -m, --monitor <sec>    sample timeleft and status every <sec> seconds\n"
+		" -c, --count <num>      stop monitoring after <num> samples\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(24));
@@ -738,6 +746,245 @@ static void print_device(struct wd_control *ctl, struct wd_device *wd, uint32_t
 		show_flags(ctl, wd, wanted);
 }
 
+/*
+ * Monitor mode -- the attributes are sampled from sysfs only; the device
+ * itself is never opened, because an open watchdog has to be pinged.
+ */
+struct wd_monitor {
+	const char	*devpath;
+	struct path_cxt	*sysfs;
+
+	int		fd_timeleft;
+	int		fd_pretimeout;
+	int		fd_status;
+
+	int		timeleft_min;
+	int		timeleft_max;
+	uint64_t	nsamples;
+};
+
+static volatile sig_atomic_t monitor_stop;
+
+static void monitor_sig_handler(int sig __attribute__((__unused__)))
+{
+	monitor_stop = 1;
+}
+
+static int monitor_open_attr(struct path_cxt *sys, const char *name)
+{
+	return ul_path_open(sys, O_RDONLY | O_CLOEXEC, name);
+}
+
+/* re-reads the attribute by the already open @fd, returns <0 on error */
+static int monitor_read_attr(int fd, char *buf, size_t bufsz, int *res)
+{
+	ssize_t sz;
+	char *end = NULL;
+	long x;
+
+	if (fd < 0)
+		return -EINVAL;
+
+	sz = pread(fd, buf, bufsz - 1, 0);
+	if (sz <= 0)
+		return -errno;
+	buf[sz] = '\0';
+
+	errno = 0;
+	x = strtol(buf, &end, 0);
+	if (errno || end == buf)
+		return -EINVAL;
+	*res = (int) x;
+	return 0;
+}
+
+static double timespec_to_ms(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000.0 + ts->tv_nsec / 1000000.0;
+}
+
+static uint64_t timespec_to_us(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+/* integer square root, the statistic does not need libm */
+static uint64_t isqrt64(uint64_t x)
+{
+	uint64_t res = 0, bit = (uint64_t) 1 << 62;
+
+	while (bit > x)
+		bit >>= 2;
+	while (bit) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		} else
+			res >>= 1;
+		bit >>= 2;
+	}
+	return res;
+}
+
+#define US_TO_MS_ARGS(_us)	(uintmax_t) ((_us) / 1000), (uintmax_t) ((_us) % 1000)
+
+static void monitor_sample(struct wd_control *ctl, struct wd_monitor *mon,
+			   double elapsed, double latency)
+{
+	char buf[64];
+	int timeleft = -1, pretimeout = -1, status = 0;
+	int has_timeleft;
+
+	has_timeleft = monitor_read_attr(mon->fd_timeleft, buf, sizeof(buf), &timeleft) == 0;
+	monitor_read_attr(mon->fd_pretimeout, buf, sizeof(buf), &pretimeout);
+	monitor_read_attr(mon->fd_status, buf, sizeof(buf), &status);
+
+	if (has_timeleft) {
+		if (!mon->nsamples || timeleft < mon->timeleft_min)
+			mon->timeleft_min = timeleft;
+		if (!mon->nsamples || timeleft > mon->timeleft_max)
+			mon->timeleft_max = timeleft;
+		mon->nsamples++;
+	}
+
+	if (ctl->show_oneline)
+		printf("%s: TIME=\"%.3f\" TIMELEFT=\"%d\" PRETIMEOUT=\"%d\" STATUS=\"0x%x\" LATENCY=\"%.3f\"\n",
+			mon->devpath, elapsed / 1000.0, timeleft, pretimeout,
+			status, latency);
+	else
+		printf("%-16s %10.3f %8d %10d %#10x %10.3f\n",
+			mon->devpath, elapsed / 1000.0, timeleft, pretimeout,
+			status, latency);
+}
+
+/*
+ * Samples all the devices every ctl->interval. The wake-up latency (the
+ * difference between the scheduled and the real time of the sample) is
+ * reported as the jitter of the monitor, the minimal timeleft is the
+ * real watchdog margin.
+ */
+static int monitor_watchdogs(struct wd_control *ctl, struct wd_monitor *mons, size_t nmons)
+{
+	struct timespec start, next, now;
+	struct sigaction sa = { .sa_handler = monitor_sig_handler };
+	/* latency statistic in microseconds */
+	uint64_t lat, lat_min = 0, lat_max = 0, lat_sum = 0, lat_sq = 0;
+	uint64_t n = 0, lat_avg, lat_var;
+	size_t i;
+
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (!ctl->hide_headings && !ctl->show_oneline)
+		printf("%-16s %10s %8s %10s %10s %10s\n",
+			_("DEVICE"), _("TIME"), _("TIMELEFT"), _("PRETIMEOUT"),
+			_("STATUS"), _("LATENCY-MS"));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next = start;
+
+	while (!monitor_stop) {
+		struct timespec diff;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		diff.tv_sec = now.tv_sec - next.tv_sec;
+		diff.tv_nsec = now.tv_nsec - next.tv_nsec;
+		if (diff.tv_nsec < 0) {
+			diff.tv_sec--;
+			diff.tv_nsec += 1000000000;
+		}
+		lat = diff.tv_sec < 0 ? 0 : timespec_to_us(&diff);
+
+		if (!n || lat < lat_min)
+			lat_min = lat;
+		if (!n || lat > lat_max)
+			lat_max = lat;
+		lat_sum += lat;
+		lat_sq += lat * lat;
+
+		diff.tv_sec = now.tv_sec - start.tv_sec;
+		diff.tv_nsec = now.tv_nsec - start.tv_nsec;
+		if (diff.tv_nsec < 0) {
+			diff.tv_sec--;
+			diff.tv_nsec += 1000000000;
+		}
+		for (i = 0; i < nmons; i++)
+			monitor_sample(ctl, &mons[i], timespec_to_ms(&diff), lat / 1000.0);
+		fflush(stdout);
+
+		if (ctl->count && ++n >= ctl->count)
+			break;
+		if (!ctl->count)
+			n++;
+
+		next.tv_sec += ctl->interval.tv_sec;
+		next.tv_nsec += ctl->interval.tv_nsec;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		while (!monitor_stop &&
+		       clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+	}
+
+	if (!n)
+		return 0;
+
+	fputc('\n', stdout);
+	printf(P_("%-14s %ju sample\n", "%-14s %ju samples\n", n),
+		_("Samples:"), (uintmax_t) n);
+
+	lat_avg = lat_sum / n;
+	lat_var = lat_sq / n > lat_avg * lat_avg ? lat_sq / n - lat_avg * lat_avg : 0;
+
+	printf(_("%-14s min %ju.%03ju ms, avg %ju.%03ju ms, max %ju.%03ju ms, stddev %ju.%03ju ms\n"),
+		_("Latency:"), US_TO_MS_ARGS(lat_min), US_TO_MS_ARGS(lat_avg),
+		US_TO_MS_ARGS(lat_max), US_TO_MS_ARGS(isqrt64(lat_var)));
+
+	for (i = 0; i < nmons; i++) {
+		if (!mons[i].nsamples)
+			continue;
+		printf(_("%-14s min %d, max %d seconds (%s)\n"),
+			_("Timeleft:"), mons[i].timeleft_min,
+			mons[i].timeleft_max, mons[i].devpath);
+	}
+	return 0;
+}
+
+static int monitor_init(struct wd_monitor *mon, const char *devpath)
+{
+	struct wd_device wd = { .devpath = devpath };
+
+	memset(mon, 0, sizeof(*mon));
+	mon->devpath = devpath;
+	mon->sysfs = get_sysfs(&wd);
+	if (!mon->sysfs) {
+		warnx(_("%s: monitoring requires watchdog information in /sys"), devpath);
+		return -1;
+	}
+
+	mon->fd_timeleft = monitor_open_attr(mon->sysfs, "timeleft");
+	mon->fd_pretimeout = monitor_open_attr(mon->sysfs, "pretimeout");
+	mon->fd_status = monitor_open_attr(mon->sysfs, "status");
+
+	if (mon->fd_timeleft < 0)
+		warnx(_("%s: timeleft is not supported"), devpath);
+	return 0;
+}
+
+static void monitor_deinit(struct wd_monitor *mon)
+{
+	if (mon->fd_timeleft >= 0)
+		close(mon->fd_timeleft);
+	if (mon->fd_pretimeout >= 0)
+		close(mon->fd_pretimeout);
+	if (mon->fd_status >= 0)
+		close(mon->fd_status);
+	ul_unref_path(mon->sysfs);
+}
+
 int main(int argc, char *argv[])
 {
 	struct wd_device wd;
@@ -747,9 +994,11 @@ int main(int argc, char *argv[])
 	const char *dflt_device = NULL;
 
 	static const struct option long_opts[] = {
+		{ "count",      required_argument, NULL, 'c' },
 		{ "flags",      required_argument, NULL, 'f' },
 		{ "flags-only", no_argument,       NULL, 'x' },
 		{ "help",	no_argument,       NULL, 'h' },
+		{ "monitor",    required_argument, NULL, 'm' },
 		{ "noflags",    no_argument,       NULL, 'F' },
 		{ "noheadings", no_argument,       NULL, 'n' },
 		{ "noident",	no_argument,       NULL, 'I' },
@@ -766,6 +1015,9 @@ int main(int argc, char *argv[])
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'F','f' },			/* noflags,flags*/
+		{ 'g','m' },			/* setpregovernor,monitor */
+		{ 'm','p' },			/* monitor,setpretimeout */
+		{ 'm','s' },			/* monitor,settimeout */
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -776,7 +1028,7 @@ int main(int argc, char *argv[])
 	close_stdout_atexit();
 
 	while ((c = getopt_long(argc, argv,
-				"d:f:g:hFnITp:o:s:OrVx", long_opts, NULL)) != -1) {
+				"c:d:f:g:hFm:nITp:o:s:OrVx", long_opts, NULL)) != -1) {
 
 		err_exclusive_options(c, long_opts, excl, excl_st);
 
@@ -825,6 +1077,16 @@ int main(int argc, char *argv[])
 			ctl.hide_ident = 1;
 			ctl.hide_timeouts = 1;
 			break;
+		case 'm':
+			strtotimespec_or_err(optarg, &ctl.interval,
+					_("invalid monitor interval argument"));
+			if (!ctl.interval.tv_sec && !ctl.interval.tv_nsec)
+				errx(EXIT_FAILURE, _("invalid monitor interval argument"));
+			ctl.monitor = 1;
+			break;
+		case 'c':
+			ctl.count = strtou64_or_err(optarg, _("invalid count argument"));
+			break;
 
 		case 'h':
 			usage();
@@ -850,6 +1112,22 @@ int main(int argc, char *argv[])
 			err(EXIT_FAILURE, _("No default device is available."));
 	}
 
+	if (ctl.monitor) {
+		size_t i, nmons = dflt_device ? 1 : (size_t) (argc - optind);
+		struct wd_monitor *mons = xcalloc(nmons, sizeof(*mons));
+
+		for (i = 0; i < nmons; i++) {
+			if (monitor_init(&mons[i], dflt_device ? : argv[optind + i]) != 0)
+				return EXIT_FAILURE;
+		}
+		res = monitor_watchdogs(&ctl, mons, nmons) == 0 ?
+				EXIT_SUCCESS : EXIT_FAILURE;
+		for (i = 0; i < nmons; i++)
+			monitor_deinit(&mons[i]);
+		free(mons);
+		return res;
+	}
+
 	do {
 		int rc;
 
@@ -25,6 +25,8 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <libsmartcols.h>
 
@@ -39,6 +41,7 @@
 #include "strv.h"
 #include "path.h"
 #include "pathnames.h"
+#include "timeutils.h"
 
 /*#define CONFIG_ZRAM_DEBUG*/
 
@@ -532,6 +535,335 @@ print_table:
 	scols_unref_table(tb);
 }
 
+/*
+ * Monitor mode (--interval), the columns are not the same as for the status
+ * output; the most interesting numbers are rates between two samples.
+ */
+enum {
+	/* mm_stat fields after MM_NUM_MIGRATED, Linux >= 4.19 */
+	MM_HUGE_PAGES = MM_NUM_MIGRATED + 1,
+	__MM_NFIELDS
+};
+
+enum {
+	IO_FAILED_READS = 0,
+	IO_FAILED_WRITES,
+	IO_INVALID_IO,
+	IO_NOTIFY_FREE,
+	__IO_NFIELDS
+};
+
+enum {
+	BD_COUNT = 0,
+	BD_READS,
+	BD_WRITES,
+	__BD_NFIELDS
+};
+
+struct zram_sample {
+	uint64_t mm[__MM_NFIELDS];
+	uint64_t io[__IO_NFIELDS];
+	uint64_t bd[__BD_NFIELDS];
+	size_t nmm, nio, nbd;		/* number of fields provided by kernel */
+};
+
+/* --policy thresholds, zero means disabled */
+struct zram_policy {
+	double compact_ratio;		/* compact if total/compressed is above */
+	unsigned int idle_secs;		/* mark all pages idle every N seconds */
+	uint64_t writeback_size;	/* write back if total is above */
+};
+
+struct zram_monitor {
+	struct zram *zram;
+	struct zram_sample prev;
+	time_t last_idle;		/* monotonic seconds of the last idle marking */
+	double prev_ratio;
+	unsigned int has_prev : 1;
+};
+
+static size_t read_stat_fields(struct path_cxt *sysfs, const char *attr,
+			       uint64_t *nums, size_t max)
+{
+	char *str = NULL, *p, *end;
+	size_t n = 0;
+
+	if (ul_path_read_string(sysfs, &str, attr) <= 0 || !str)
+		return 0;
+
+	for (p = str; n < max; p = end) {
+		errno = 0;
+		nums[n] = strtoull(p, &end, 10);
+		if (end == p || errno)
+			break;
+		n++;
+	}
+	free(str);
+	return n;
+}
+
+static int zram_read_sample(struct zram *z, struct zram_sample *sm)
+{
+	struct path_cxt *sysfs = zram_get_sysfs(z);
+
+	memset(sm, 0, sizeof(*sm));
+	if (!sysfs)
+		return -ENODEV;
+
+	sm->nmm = read_stat_fields(sysfs, "mm_stat", sm->mm, __MM_NFIELDS);
+	sm->nio = read_stat_fields(sysfs, "io_stat", sm->io, __IO_NFIELDS);
+	sm->nbd = read_stat_fields(sysfs, "bd_stat", sm->bd, __BD_NFIELDS);
+
+	return sm->nmm > MM_NUM_MIGRATED ? 0 : -EINVAL;
+}
+
+static char *monitor_size(uint64_t num)
+{
+	char *str;
+
+	if (!inbytes)
+		return size_to_human_string(SIZE_SUFFIX_1LETTER, num);
+	str = u64_to_string(num);
+	return str;
+}
+
+static char *monitor_rate(const uint64_t *curnums, const uint64_t *prevnums,
+			  size_t ncur, size_t idx, double secs)
+{
+	char *str;
+
+	if (idx >= ncur || !prevnums || secs <= 0)
+		return NULL;
+	xasprintf(&str, "%.1f", (double) (curnums[idx] - prevnums[idx]) / secs);
+	return str;
+}
+
+static void monitor_add_line(struct libscols_table *tb, struct zram_monitor *mon,
+			     const struct zram_sample *sm, double secs)
+{
+	const struct zram_sample *prev = mon->has_prev ? &mon->prev : NULL;
+	struct libscols_line *ln;
+	uint64_t orig = sm->mm[MM_ORIG_DATA_SIZE], compr = sm->mm[MM_COMPR_DATA_SIZE];
+	double ratio = compr ? (double) orig / compr : 0;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	char *data[12] = { NULL };
+	size_t i;
+
+	ln = scols_table_new_line(tb, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	data[0] = xstrdup(mon->zram->devname);
+	xasprintf(&data[1], "%.2f", ratio);
+	if (mon->has_prev)
+		xasprintf(&data[2], "%+.2f", ratio - mon->prev_ratio);
+	data[3] = monitor_size(orig);
+	data[4] = monitor_size(compr);
+	data[5] = monitor_size(sm->mm[MM_MEM_USED_TOTAL]);
+	data[6] = u64_to_string(sm->mm[MM_ZERO_PAGES]);
+	if (sm->nmm > MM_HUGE_PAGES && orig && pagesize > 0)
+		xasprintf(&data[7], "%.1f%%", (double) sm->mm[MM_HUGE_PAGES] * 100.0
+					      / ((double) orig / pagesize));
+	if (prev) {
+		data[8] = monitor_rate(sm->mm, prev->mm, sm->nmm, MM_NUM_MIGRATED, secs);
+		data[9] = monitor_rate(sm->io, prev->io, sm->nio, IO_FAILED_READS, secs);
+		data[10] = monitor_rate(sm->io, prev->io, sm->nio, IO_FAILED_WRITES, secs);
+		data[11] = monitor_rate(sm->bd, prev->bd, sm->nbd, BD_WRITES, secs);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(data); i++) {
+		if (data[i] && scols_line_refer_data(ln, i, data[i]))
+			err(EXIT_FAILURE, _("failed to add output data"));
+	}
+
+	mon->prev_ratio = ratio;
+}
+
+/* returns 1 if the device has a backing device for writeback */
+static int zram_has_backing_dev(struct zram *z)
+{
+	char *str = NULL;
+	int rc;
+
+	if (ul_path_read_string(zram_get_sysfs(z), &str, "backing_dev") <= 0 || !str)
+		return 0;
+	rc = strcmp(str, "none") != 0;
+	free(str);
+	return rc;
+}
+
+static void monitor_apply_policy(struct zram_monitor *mon, const struct zram_policy *pol,
+				 const struct zram_sample *sm, time_t now)
+{
+	struct zram *z = mon->zram;
+	uint64_t total = sm->mm[MM_MEM_USED_TOTAL], compr = sm->mm[MM_COMPR_DATA_SIZE];
+
+	if (pol->compact_ratio > 0 && compr
+	    && (double) total / compr > pol->compact_ratio) {
+		printf(_("%s: compact, memory used %.2f times the compressed size\n"),
+			z->devname, (double) total / compr);
+		if (zram_set_u64parm(z, "compact", 1))
+			warn(_("%s: failed to compact"), z->devname);
+	}
+
+	/*
+	 * Write back the pages which have not been accessed since the last
+	 * idle marking, or the incompressible (huge) pages if the pages are
+	 * not marked.
+	 */
+	if (pol->writeback_size && total > pol->writeback_size
+	    && zram_has_backing_dev(z)) {
+		const char *type = pol->idle_secs ? "idle" : "huge";
+
+		printf(_("%s: writeback of %s pages, memory used %ju bytes\n"),
+			z->devname, type, (uintmax_t) total);
+		if (zram_set_strparm(z, "writeback", type))
+			warn(_("%s: failed to write back"), z->devname);
+	}
+
+	if (pol->idle_secs && now - mon->last_idle >= (time_t) pol->idle_secs) {
+		if (zram_set_strparm(z, "idle", "all"))
+			warn(_("%s: failed to mark pages idle"), z->devname);
+		mon->last_idle = now;
+	}
+}
+
+static struct zram_monitor *monitor_devices(char **devs, size_t ndevs, size_t *nmons)
+{
+	struct zram_monitor *mons = NULL;
+	size_t n = 0;
+
+	if (ndevs) {
+		size_t i;
+
+		mons = xcalloc(ndevs, sizeof(*mons));
+		for (i = 0; i < ndevs; i++) {
+			mons[n].zram = new_zram(devs[i]);
+			if (!zram_exist(mons[n].zram))
+				err(EXIT_FAILURE, "%s", mons[n].zram->devname);
+			n++;
+		}
+	} else {
+		struct dirent *d;
+		DIR *dir = opendir(_PATH_DEV);
+
+		if (!dir)
+			err(EXIT_FAILURE, _("cannot open %s"), _PATH_DEV);
+		while ((d = readdir(dir))) {
+			struct zram *z;
+			int num;
+
+			if (sscanf(d->d_name, "zram%d", &num) != 1)
+				continue;
+			z = new_zram(NULL);
+			zram_set_devname(z, NULL, num);
+			if (!zram_exist(z) || !zram_used(z)) {
+				free_zram(z);
+				continue;
+			}
+			mons = xreallocarray(mons, n + 1, sizeof(*mons));
+			memset(&mons[n], 0, sizeof(*mons));
+			mons[n++].zram = z;
+		}
+		closedir(dir);
+	}
+	*nmons = n;
+	return mons;
+}
+
+static void __attribute__((__noreturn__))
+monitor(char **devs, size_t ndevs, struct timespec *interval,
+	const struct zram_policy *pol)
+{
+	static const char *const names[] = {
+		"NAME", "RATIO", "TREND", "DATA", "COMPR", "TOTAL", "SAME-PAGES",
+		"HUGE", "COMPACTED/s", "FAIL-RD/s", "FAIL-WR/s", "WRITEBACK/s"
+	};
+	struct zram_monitor *mons;
+	struct timespec next, last;
+	size_t nmons, i;
+
+	mons = monitor_devices(devs, ndevs, &nmons);
+	if (!nmons)
+		errx(EXIT_FAILURE, _("no used zram device found"));
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	last = next;
+
+	for (;;) {
+		struct libscols_table *tb;
+		struct timespec now;
+		double secs;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		secs = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+		last = now;
+
+		tb = scols_new_table();
+		if (!tb)
+			err(EXIT_FAILURE, _("failed to allocate output table"));
+		scols_table_enable_raw(tb, raw);
+		scols_table_enable_noheadings(tb, no_headings);
+
+		for (i = 0; i < ARRAY_SIZE(names); i++) {
+			if (!scols_table_new_column(tb, names[i], 0,
+					i == 0 ? 0 : SCOLS_FL_RIGHT))
+				err(EXIT_FAILURE, _("failed to initialize output column"));
+		}
+
+		for (i = 0; i < nmons; i++) {
+			struct zram_monitor *mon = &mons[i];
+			struct zram_sample sm;
+
+			if (zram_read_sample(mon->zram, &sm) != 0)
+				continue;
+			monitor_add_line(tb, mon, &sm, secs);
+			if (pol)
+				monitor_apply_policy(mon, pol, &sm, now.tv_sec);
+			mon->prev = sm;
+			mon->has_prev = 1;
+		}
+
+		scols_print_table(tb);
+		scols_unref_table(tb);
+		fputc('\n', stdout);
+		fflush(stdout);
+
+		/* fixed interval, the time spent on the output is not added */
+		next.tv_sec += interval->tv_sec;
+		next.tv_nsec += interval->tv_nsec;
+		if (next.tv_nsec >= (long) NSEC_PER_SEC) {
+			next.tv_sec++;
+			next.tv_nsec -= (long) NSEC_PER_SEC;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+	}
+}
+
+static void parse_policy(struct zram_policy *pol, const char *list)
+{
+	char *str = xstrdup(list), *tok, *save = NULL;
+
+	for (tok = strtok_r(str, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		char *val = strchr(tok, '=');
+
+		if (!val)
+			errx(EXIT_FAILURE, _("missing value in policy: %s"), tok);
+		*val++ = '\0';
+
+		if (strcmp(tok, "compact") == 0)
+			pol->compact_ratio = strtod_or_err(val, _("failed to parse compact ratio"));
+		else if (strcmp(tok, "idle") == 0)
+			pol->idle_secs = strtou32_or_err(val, _("failed to parse idle time"));
+		else if (strcmp(tok, "writeback") == 0)
+			pol->writeback_size = strtosize_or_err(val, _("failed to parse writeback size"));
+		else
+			errx(EXIT_FAILURE, _("unknown policy: %s"), tok);
+	}
+	free(str);
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -550,9 +882,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --algorithm <alg>     compression algorithm to use\n"), out);
 	fputs(_(" -b, --bytes               print sizes in bytes rather than in human readable format\n"), out);
 	fputs(_(" -f, --find                find a free device\n"), out);
+	fputs(_(" -i, --interval <secs>     monitor used devices in the given interval\n"), out);
 	fputs(_(" -n, --noheadings          don't print headings\n"), out);
 	fputs(_(" -o, --output <list>       columns to use for status output\n"), out);
 	fputs(_("     --output-all          output all columns\n"), out);
+	fputs(_("     --policy <list>       compact, mark idle or write back in --interval mode\n"), out);
 	fputs(_("     --raw                 use raw status output format\n"), out);
 	fputs(_(" -r, --reset               reset all specified devices\n"), out);
 	fputs(_(" -s, --size <size>         device size\n"), out);
@@ -582,7 +916,8 @@ enum {
 	A_STATUS,
 	A_CREATE,
 	A_FINDONLY,
-	A_RESET
+	A_RESET,
+	A_MONITOR
 };
 
 int main(int argc, char **argv)
@@ -591,10 +926,14 @@ int main(int argc, char **argv)
 	char *algorithm = NULL;
 	int rc = 0, c, find = 0, act = A_NONE;
 	struct zram *zram = NULL;
+	struct timespec interval = { 0 };
+	struct zram_policy policy = { 0 };
+	int has_policy = 0;
 
 	enum {
 		OPT_RAW = CHAR_MAX + 1,
-		OPT_LIST_TYPES
+		OPT_LIST_TYPES,
+		OPT_POLICY
 	};
 
 	static const struct option longopts[] = {
@@ -602,9 +941,11 @@ int main(int argc, char **argv)
 		{ "bytes",     no_argument, NULL, 'b' },
 		{ "find",      no_argument, NULL, 'f' },
 		{ "help",      no_argument, NULL, 'h' },
+		{ "interval",  required_argument, NULL, 'i' },
 		{ "output",    required_argument, NULL, 'o' },
 		{ "output-all",no_argument, NULL, OPT_LIST_TYPES },
 		{ "noheadings",no_argument, NULL, 'n' },
+		{ "policy",    required_argument, NULL, OPT_POLICY },
 		{ "reset",     no_argument, NULL, 'r' },
 		{ "raw",       no_argument, NULL, OPT_RAW },
 		{ "size",      required_argument, NULL, 's' },
@@ -614,8 +955,8 @@ int main(int argc, char **argv)
 	};
 
 	static const ul_excl_t excl[] = {
-		{ 'f', 'o', 'r' },
-		{ 'o', 'r', 's' },
+		{ 'f', 'i', 'o', 'r' },
+		{ 'i', 'o', 'r', 's' },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -625,7 +966,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "a:bfho:nrs:t:V", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "a:bfhi:o:nrs:t:V", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -639,6 +980,21 @@ int main(int argc, char **argv)
 		case 'f':
 			find = 1;
 			break;
+		case 'i':
+		{
+			struct timeval tv;
+
+			strtotimeval_or_err(optarg, &tv, _("failed to parse interval"));
+			if (!timerisset(&tv))
+				errx(EXIT_FAILURE, _("interval must be greater than zero"));
+			TIMEVAL_TO_TIMESPEC(&tv, &interval);
+			act = A_MONITOR;
+			break;
+		}
+		case OPT_POLICY:
+			parse_policy(&policy, optarg);
+			has_policy = 1;
+			break;
 		case 'o':
 			ncolumns = string_to_idarray(optarg,
 						     columns, ARRAY_SIZE(columns),
@@ -682,10 +1038,14 @@ int main(int argc, char **argv)
 	if (act == A_NONE)
 		act = find ? A_FINDONLY : A_STATUS;
 
-	if (act != A_RESET && optind + 1 < argc)
+	if (has_policy && act != A_MONITOR)
+		errx(EXIT_FAILURE, _("option --policy requires --interval"));
+
+	if (act != A_RESET && act != A_MONITOR && optind + 1 < argc)
 		errx(EXIT_FAILURE, _("only one <device> at a time is allowed"));
 
-	if ((act == A_STATUS || act == A_FINDONLY) && (algorithm || nstreams))
+	if ((act == A_STATUS || act == A_FINDONLY || act == A_MONITOR)
+	    && (algorithm || nstreams))
 		errx(EXIT_FAILURE, _("options --algorithm and --streams "
 				     "must be combined with --size"));
 
@@ -712,6 +1072,10 @@ int main(int argc, char **argv)
 		status(zram);
 		free_zram(zram);
 		break;
+	case A_MONITOR:
+		monitor(argv + optind, argc - optind, &interval,
+			has_policy ? &policy : NULL);
+		break;
 	case A_RESET:
 		if (optind == argc)
 			errx(EXIT_FAILURE, _("no device specified"));
@@ -8,6 +8,7 @@
 #include <math.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #include "c.h"
 #include "xalloc.h"
@@ -39,6 +40,7 @@ struct replay_log {
 	const char	*streams;	/* 'I'nput, 'O'utput or both */
 	const char	*filename;
 	FILE		*fp;
+	off_t		start;		/* offset of the data (after header line) */
 
 	unsigned int	noseek : 1;	/* do not seek in this log */
 };
@@ -54,10 +56,34 @@ struct replay_step {
 	struct replay_log *data;
 };
 
+/*
+ * The index is a list of checkpoints in the timing file. Every checkpoint
+ * describes the session time before the step at @timing_off, and amount of
+ * the input and output data logged before the step. It's possible to
+ * store the index to a file to avoid the timing file scan next time.
+ */
+#define REPLAY_INDEX_MAGIC	"SCRIPTREPLAY_INDEX"
+#define REPLAY_INDEX_VERSION	1
+
+/* create a checkpoint after every second of the session or after the
+ * number of steps */
+#define REPLAY_INDEX_STEPS	1024
+
+struct replay_checkpoint {
+	struct timeval	time;		/* session time */
+	off_t		timing_off;	/* offset in timing file */
+	int		timing_line;
+	uint64_t	in_bytes;	/* stdin data before the step */
+	uint64_t	out_bytes;	/* stdout data before the step */
+};
+
 struct replay_setup {
 	struct replay_log	*logs;
 	size_t			nlogs;
 
+	struct replay_checkpoint *index;	/* checkpoints (sorted by time) */
+	size_t			nindex;
+
 	struct replay_step	step;	/* current step */
 
 	FILE			*timing_fp;
@@ -71,6 +97,8 @@ struct replay_setup {
 
 	char			default_type;	/* type for REPLAY_TIMING_SIMPLE */
 	int			crmode;
+
+	unsigned int		nodelay : 1;	/* ignore delay of the next step */
 };
 
 void replay_init_debug(void)
@@ -111,6 +139,7 @@ void replay_free_setup(struct replay_setup *stp)
 		return;
 
 	free(stp->logs);
+	free(stp->index);
 	free(stp->step.name);
 	free(stp->step.value);
 	free(stp);
@@ -250,9 +279,11 @@ int replay_associate_log(struct replay_setup *stp,
 	f = fopen(filename, "r");
 	rc = f == NULL ? -errno : ignore_line(f);
 
-	if (rc == 0)
-		replay_new_log(stp, streams, filename, f);
-	else if (f)
+	if (rc == 0) {
+		struct replay_log *log = replay_new_log(stp, streams, filename, f);
+
+		log->start = ftello(f);
+	} else if (f)
 		fclose(f);
 
 	DBG(LOG, ul_debug("associate log file '%s', streams '%s' [rc=%d]", filename, streams, rc));
@@ -359,6 +390,46 @@ static int read_multistream_step(struct replay_step *step, FILE *f, char type)
 	return rc;
 }
 
+/* reads the next entry from the timing file to stp->step
+ *
+ * returns: 0 = success, <0 = error, 1 = done (EOF)
+ */
+static int read_timing_step(struct replay_setup *stp)
+{
+	struct replay_step *step = &stp->step;
+	int rc = 1;
+
+	if (feof(stp->timing_fp))
+		return 1;
+
+	DBG(TIMING, ul_debug("reading next step"));
+
+	replay_reset_step(step);
+	stp->timing_line++;
+
+	switch (stp->timing_format) {
+	case REPLAY_TIMING_SIMPLE:
+		/* old format is the same as new format, but without <type> prefix */
+		rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
+		if (rc == 0)
+			step->type = stp->default_type;
+		break;
+	case REPLAY_TIMING_MULTI:
+		rc = fscanf(stp->timing_fp, "%c ", &step->type);
+		if (rc != 1)
+			rc = -EINVAL;
+		else
+			rc = read_multistream_step(step,
+					stp->timing_fp,
+					step->type);
+		break;
+	}
+
+	if (rc < 0 && feof(stp->timing_fp))
+		rc = 1;
+	return rc;
+}
+
 static struct replay_log *replay_get_stream_log(struct replay_setup *stp, char stream)
 {
 	size_t i;
@@ -403,38 +474,9 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 	do {
 		struct replay_log *log = NULL;
 
-		rc = 1;	/* done */
-		if (feof(stp->timing_fp))
-			break;
-
-		DBG(TIMING, ul_debug("reading next step"));
-
-		replay_reset_step(step);
-		stp->timing_line++;
-
-		switch (stp->timing_format) {
-		case REPLAY_TIMING_SIMPLE:
-			/* old format is the same as new format, but without <type> prefix */
-			rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
-			if (rc == 0)
-				step->type = stp->default_type;
-			break;
-		case REPLAY_TIMING_MULTI:
-			rc = fscanf(stp->timing_fp, "%c ", &step->type);
-			if (rc != 1)
-				rc = -EINVAL;
-			else
-				rc = read_multistream_step(step,
-						stp->timing_fp,
-						step->type);
-			break;
-		}
-
-		if (rc) {
-			if (rc < 0 && feof(stp->timing_fp))
-				rc = 1;
+		rc = read_timing_step(stp);
+		if (rc)
 			break;		/* error or EOF */
-		}
 
 		DBG(TIMING, ul_debug(" step entry is '%c'", step->type));
 
@@ -464,6 +506,11 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 done:
 	if (timerisset(&ignored_delay))
 		timerinc(&step->delay, &ignored_delay);
+	if (stp->nodelay) {
+		/* the first step after replay_seek() */
+		timerclear(&step->delay);
+		stp->nodelay = 0;
+	}
 
 	DBG(TIMING, ul_debug("reading next step done [rc=%d delay=%"PRId64".%06"PRId64
 			     "(ignored=%"PRId64".%06"PRId64") size=%zu]",
@@ -493,6 +540,295 @@ done:
 	return rc;
 }
 
+static void index_add_checkpoint(struct replay_setup *stp, struct replay_checkpoint *cp)
+{
+	if (stp->nindex % 1024 == 0)
+		stp->index = xreallocarray(stp->index, stp->nindex + 1024,
+					   sizeof(struct replay_checkpoint));
+	stp->index[stp->nindex++] = *cp;
+}
+
+/* the simple format does not contain stream types, all data belong to the
+ * one log (see seek_to_checkpoint()) */
+static void checkpoint_add_step(struct replay_setup *stp,
+				struct replay_checkpoint *cp,
+				struct replay_step *step)
+{
+	if (stp->timing_format == REPLAY_TIMING_SIMPLE)
+		cp->out_bytes += step->size;
+	else if (step->type == 'I')
+		cp->in_bytes += step->size;
+	else if (step->type == 'O')
+		cp->out_bytes += step->size;
+}
+
+/* the index is valid for the timing file of the same size and mtime */
+static int index_read_file(struct replay_setup *stp, const char *filename,
+			   struct stat *st)
+{
+	struct replay_checkpoint cp = { .timing_line = 0 };
+	int64_t size = 0, mtime = 0, sec, usec, off;
+	int version = 0, rc = 0;
+	FILE *f;
+
+	f = fopen(filename, "r");
+	if (!f)
+		return -errno;
+
+	if (fscanf(f, REPLAY_INDEX_MAGIC " %d %"SCNd64" %"SCNd64"\n",
+			&version, &size, &mtime) != 3
+	    || version != REPLAY_INDEX_VERSION
+	    || size != (int64_t) st->st_size
+	    || mtime != (int64_t) st->st_mtime) {
+		DBG(TIMING, ul_debug("index %s: unsupported or out of date", filename));
+		fclose(f);
+		return 1;
+	}
+
+	while (fscanf(f, "%"SCNd64".%06"SCNd64" %"SCNd64" %d %"SCNu64" %"SCNu64"\n",
+			&sec, &usec, &off, &cp.timing_line,
+			&cp.in_bytes, &cp.out_bytes) == 6) {
+		cp.time.tv_sec = (time_t) sec;
+		cp.time.tv_usec = (suseconds_t) usec;
+		cp.timing_off = (off_t) off;
+		index_add_checkpoint(stp, &cp);
+	}
+
+	if (ferror(f) || !feof(f) || !stp->nindex) {
+		DBG(TIMING, ul_debug("index %s: parse error", filename));
+		free(stp->index);
+		stp->index = NULL;
+		stp->nindex = 0;
+		rc = 1;
+	}
+	fclose(f);
+	return rc;
+}
+
+static int index_write_file(struct replay_setup *stp, const char *filename,
+			    struct stat *st)
+{
+	size_t i;
+	FILE *f;
+
+	f = fopen(filename, "w" UL_CLOEXECSTR);
+	if (!f)
+		return -errno;
+
+	fprintf(f, REPLAY_INDEX_MAGIC " %d %"PRId64" %"PRId64"\n",
+			REPLAY_INDEX_VERSION,
+			(int64_t) st->st_size, (int64_t) st->st_mtime);
+
+	for (i = 0; i < stp->nindex; i++) {
+		struct replay_checkpoint *cp = &stp->index[i];
+
+		fprintf(f, "%"PRId64".%06"PRId64" %"PRId64" %d %"PRIu64" %"PRIu64"\n",
+				(int64_t) cp->time.tv_sec, (int64_t) cp->time.tv_usec,
+				(int64_t) cp->timing_off, cp->timing_line,
+				cp->in_bytes, cp->out_bytes);
+	}
+
+	return close_stream(f) != 0 ? -errno : 0;
+}
+
+/* scans the timing file from the current position */
+static int index_scan_timing(struct replay_setup *stp)
+{
+	struct replay_checkpoint cp = { .timing_line = 0 };
+	struct replay_step *step = &stp->step;
+	struct timeval next = { .tv_sec = 0 };
+	size_t nsteps = 0;
+	int rc;
+
+	cp.timing_off = ftello(stp->timing_fp);
+	cp.timing_line = stp->timing_line;
+
+	do {
+		if (nsteps == 0 || !timercmp(&cp.time, &next, <)
+		    || nsteps % REPLAY_INDEX_STEPS == 0) {
+			index_add_checkpoint(stp, &cp);
+			next.tv_sec = cp.time.tv_sec + 1;
+			next.tv_usec = 0;
+		}
+
+		rc = read_timing_step(stp);
+		if (rc)
+			break;
+		nsteps++;
+
+		timerinc(&cp.time, &step->delay);
+		checkpoint_add_step(stp, &cp, step);
+
+		cp.timing_off = ftello(stp->timing_fp);
+		cp.timing_line = stp->timing_line;
+	} while (1);
+
+	DBG(TIMING, ul_debug("index: %zu steps, %zu checkpoints [rc=%d]",
+				nsteps, stp->nindex, rc));
+	return rc < 0 ? rc : 0;
+}
+
+/*
+ * Reads the index from @filename or scans the timing file and creates the
+ * index. If @filename is not NULL and the file does not contain valid index,
+ * then the new index is written to the file.
+ *
+ * It's necessary to call this function before the first
+ * replay_get_next_step().
+ *
+ * Returns: 0 on success, <0 on error, 1 if the index is ready, but cannot
+ * be written to the @filename.
+ */
+int replay_use_index(struct replay_setup *stp, const char *filename)
+{
+	struct stat st;
+	off_t start;
+	int start_line, rc;
+
+	assert(stp);
+	assert(stp->timing_fp);
+
+	if (fstat(fileno(stp->timing_fp), &st) != 0)
+		return -errno;
+
+	if (filename && index_read_file(stp, filename, &st) == 0) {
+		DBG(TIMING, ul_debug("index %s: %zu checkpoints", filename, stp->nindex));
+		return 0;
+	}
+
+	start = ftello(stp->timing_fp);
+	start_line = stp->timing_line;
+
+	rc = index_scan_timing(stp);
+	if (rc)
+		return rc;
+
+	/* go back */
+	if (fseeko(stp->timing_fp, start, SEEK_SET) != 0)
+		return -errno;
+	stp->timing_line = start_line;
+
+	if (filename && index_write_file(stp, filename, &st) != 0) {
+		DBG(TIMING, ul_debug("index %s: write failed", filename));
+		return 1;
+	}
+	return 0;
+}
+
+/* moves all data logs to the position described by @cp */
+static int seek_to_checkpoint(struct replay_setup *stp, struct replay_checkpoint *cp)
+{
+	size_t i;
+
+	if (fseeko(stp->timing_fp, cp->timing_off, SEEK_SET) != 0)
+		return -errno;
+	stp->timing_line = cp->timing_line;
+
+	for (i = 0; i < stp->nlogs; i++) {
+		struct replay_log *log = &stp->logs[i];
+		uint64_t off = 0;
+
+		if (log->noseek)
+			continue;
+		if (stp->timing_format == REPLAY_TIMING_SIMPLE)
+			off = cp->in_bytes + cp->out_bytes;
+		else {
+			if (strchr(log->streams, 'I'))
+				off += cp->in_bytes;
+			if (strchr(log->streams, 'O'))
+				off += cp->out_bytes;
+		}
+
+		DBG(LOG, ul_debug(" %s: seek to %"PRIu64, log->filename, off));
+		if (fseeko(log->fp, log->start + (off_t) off, SEEK_SET) != 0)
+			return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Moves the replay to the first step at session time @tv or later. All data
+ * before the step are skipped. The index (see replay_use_index()) is used to
+ * skip to the nearest checkpoint, the timing file is read from the
+ * beginning otherwise.
+ *
+ * Returns: 0 on success, <0 on error, 1 if @tv is after the end of the session.
+ */
+int replay_seek(struct replay_setup *stp, const struct timeval *tv)
+{
+	struct replay_checkpoint cp = { .timing_line = 0 };
+	struct replay_step *step = &stp->step;
+	int rc;
+
+	assert(stp);
+	assert(stp->timing_fp);
+
+	if (stp->nindex) {
+		/* binary search for the last checkpoint before @tv */
+		size_t lo = 0, hi = stp->nindex;
+
+		while (hi - lo > 1) {
+			size_t mid = lo + (hi - lo) / 2;
+
+			if (timercmp(&stp->index[mid].time, tv, >))
+				hi = mid;
+			else
+				lo = mid;
+		}
+		cp = stp->index[lo];
+
+		DBG(TIMING, ul_debug("seek: use checkpoint %zu [line=%d]", lo, cp.timing_line));
+		rc = seek_to_checkpoint(stp, &cp);
+		if (rc)
+			return rc;
+	}
+
+	/* read steps up to @tv */
+	do {
+		struct replay_log *log;
+		off_t off = ftello(stp->timing_fp);
+		int line = stp->timing_line;
+		struct timeval t;
+
+		rc = read_timing_step(stp);
+		if (rc)
+			break;
+
+		timeradd(&cp.time, &step->delay, &t);
+		if (!timercmp(&t, tv, <)) {
+			/* unread the step */
+			if (fseeko(stp->timing_fp, off, SEEK_SET) != 0)
+				return -errno;
+			stp->timing_line = line;
+			break;
+		}
+		cp.time = t;
+
+		log = replay_get_stream_log(stp, step->type);
+		if (log && !stp->nindex) {
+			rc = replay_seek_log(log, step->size);
+			if (rc)
+				break;
+		}
+		checkpoint_add_step(stp, &cp, step);
+	} while (1);
+
+	if (rc == 0 && stp->nindex) {
+		/* set position in data logs */
+		cp.timing_off = ftello(stp->timing_fp);
+		cp.timing_line = stp->timing_line;
+		rc = seek_to_checkpoint(stp, &cp);
+	}
+
+	replay_reset_step(step);
+	stp->nodelay = 1;
+
+	DBG(TIMING, ul_debug("seek to %"PRId64".%06"PRId64" done [line=%d, rc=%d]",
+			(int64_t) tv->tv_sec, (int64_t) tv->tv_usec,
+			stp->timing_line, rc));
+	return rc;
+}
+
 /* return: 0 = success, <0 = error, 1 = done (EOF) */
 int replay_emit_step_data(struct replay_setup *stp, struct replay_step *step, int fd)
 {
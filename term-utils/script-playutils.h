@@ -47,4 +47,7 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 
 int replay_emit_step_data(struct replay_setup *stp, struct replay_step *step, int fd);
 
+int replay_use_index(struct replay_setup *stp, const char *filename);
+int replay_seek(struct replay_setup *stp, const struct timeval *tv);
+
 #endif /* UTIL_LINUX_SCRIPT_PLAYUTILS_H */
@@ -54,6 +54,7 @@
 #include <sys/signalfd.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "closestream.h"
 #include "nls.h"
@@ -103,12 +104,48 @@ enum {
 	SCRIPT_FMT_TIMING_MULTI,	/* (advanced) multiple streams in format "<type> <delta> <offset|etc> */
 };
 
+/*
+ * The logs are written by a writer thread, so slow log files do not block
+ * the terminal. The data are copied to chunks, the full chunks are queued
+ * for the writer. If the queue is too large then the main thread waits.
+ */
+#define SCRIPT_CHUNK_SIZE	(256 * 1024)
+#define SCRIPT_QUEUE_MAXSZ	(16 * 1024 * 1024)
+
+struct script_log;
+
+struct script_chunk {
+	struct script_chunk *next;
+	struct script_log *log;		/* where to write */
+	size_t len;			/* used part of @data */
+	char data[SCRIPT_CHUNK_SIZE];
+};
+
+struct script_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;		/* queue status changed */
+
+	struct script_chunk *head;	/* queued chunks */
+	struct script_chunk *tail;
+	struct script_chunk *unused;	/* written chunks for reuse */
+	size_t queued;			/* size of the queued data */
+
+	int err;			/* errno of the first failed write */
+	const char *errname;		/* the failed log filename */
+
+	unsigned int active : 1,	/* thread is running */
+		     stop : 1,		/* thread should stop */
+		     busy : 1;		/* thread is writing */
+};
+
 struct script_log {
 	FILE	*fp;			/* file pointer (handler) */
 	int	format;			/* SCRIPT_FMT_* */
 	char	*filename;		/* on command line specified name */
 	struct timeval oldtime;		/* previous entry log time (SCRIPT_FMT_TIMING_* only) */
 	struct timeval starttime;
+	struct script_chunk *chunk;	/* not yet queued data for the writer */
 
 	unsigned int	initialized : 1;
 };
@@ -136,6 +173,8 @@ struct script_control {
 	int ttycols;
 	int ttylines;
 
+	struct script_writer writer;	/* log writer thread */
+
 	struct ul_pty *pty;	/* pseudo-terminal */
 	pid_t child;		/* child pid */
 	int childstatus;	/* child process exit value */
@@ -448,6 +487,218 @@ static int logging_start(struct script_control *ctl)
 	return 0;
 }
 
+static void *writer_thread(void *data)
+{
+	struct script_writer *wr = (struct script_writer *) data;
+
+	pthread_mutex_lock(&wr->lock);
+	for (;;) {
+		struct script_chunk *ch;
+		int rc = 0;
+
+		while (!wr->head && !wr->stop)
+			pthread_cond_wait(&wr->cond, &wr->lock);
+		if (!wr->head)
+			break;
+
+		ch = wr->head;
+		wr->head = ch->next;
+		if (!wr->head)
+			wr->tail = NULL;
+		wr->busy = 1;
+
+		/* write without lock, the chunk is owned by the writer now */
+		pthread_mutex_unlock(&wr->lock);
+		if (!wr->err)
+			rc = write_all(fileno(ch->log->fp), ch->data, ch->len);
+		pthread_mutex_lock(&wr->lock);
+
+		if (rc && !wr->err) {
+			wr->err = errno ? errno : EIO;
+			wr->errname = ch->log->filename;
+		}
+		wr->busy = 0;
+		wr->queued -= ch->len;
+		ch->next = wr->unused;
+		wr->unused = ch;
+		pthread_cond_broadcast(&wr->cond);
+	}
+	pthread_mutex_unlock(&wr->lock);
+	return NULL;
+}
+
+/* start the writer thread, the logs are written directly on error */
+static void writer_start(struct script_control *ctl)
+{
+	struct script_writer *wr = &ctl->writer;
+	size_t i;
+
+	/* --flush requires synchronous writes */
+	if (ctl->flush)
+		return;
+
+	/* the writer uses file descriptors */
+	for (i = 0; i < ctl->out.nlogs; i++)
+		fflush(ctl->out.logs[i]->fp);
+	for (i = 0; i < ctl->in.nlogs; i++)
+		fflush(ctl->in.logs[i]->fp);
+
+	pthread_mutex_init(&wr->lock, NULL);
+	pthread_cond_init(&wr->cond, NULL);
+
+	if (pthread_create(&wr->thread, NULL, writer_thread, wr) != 0) {
+		DBG(IO, ul_debug("cannot create writer thread, use direct writes"));
+		pthread_cond_destroy(&wr->cond);
+		pthread_mutex_destroy(&wr->lock);
+		return;
+	}
+	DBG(IO, ul_debug("writer thread started"));
+	wr->active = 1;
+}
+
+/* add chunk to the writer queue, wait if the queue is too large */
+static void writer_queue(struct script_writer *wr, struct script_chunk *ch)
+{
+	pthread_mutex_lock(&wr->lock);
+	while (wr->queued >= SCRIPT_QUEUE_MAXSZ && !wr->err)
+		pthread_cond_wait(&wr->cond, &wr->lock);
+
+	ch->next = NULL;
+	if (wr->tail)
+		wr->tail->next = ch;
+	else
+		wr->head = ch;
+	wr->tail = ch;
+	wr->queued += ch->len;
+
+	pthread_cond_broadcast(&wr->cond);
+	pthread_mutex_unlock(&wr->lock);
+}
+
+static struct script_chunk *writer_get_chunk(struct script_writer *wr)
+{
+	struct script_chunk *ch;
+
+	pthread_mutex_lock(&wr->lock);
+	ch = wr->unused;
+	if (ch)
+		wr->unused = ch->next;
+	pthread_mutex_unlock(&wr->lock);
+
+	if (!ch)
+		ch = xmalloc(sizeof(*ch));
+	ch->next = NULL;
+	ch->len = 0;
+	return ch;
+}
+
+/* queue the not yet queued data and wait until all is written */
+static int writer_flush(struct script_control *ctl)
+{
+	struct script_writer *wr = &ctl->writer;
+	size_t i;
+	int rc;
+
+	if (!wr->active)
+		return 0;
+
+	for (i = 0; i < ctl->out.nlogs + ctl->in.nlogs; i++) {
+		struct script_log *log = i < ctl->out.nlogs ?
+				ctl->out.logs[i] : ctl->in.logs[i - ctl->out.nlogs];
+
+		if (log && log->chunk) {
+			writer_queue(wr, log->chunk);
+			log->chunk = NULL;
+		}
+	}
+
+	pthread_mutex_lock(&wr->lock);
+	while ((wr->head || wr->busy) && !wr->err)
+		pthread_cond_wait(&wr->cond, &wr->lock);
+	rc = -wr->err;
+	pthread_mutex_unlock(&wr->lock);
+
+	return rc;
+}
+
+static void writer_stop(struct script_control *ctl)
+{
+	struct script_writer *wr = &ctl->writer;
+	struct script_chunk *ch;
+
+	if (!wr->active)
+		return;
+
+	writer_flush(ctl);
+
+	pthread_mutex_lock(&wr->lock);
+	wr->stop = 1;
+	pthread_cond_broadcast(&wr->cond);
+	pthread_mutex_unlock(&wr->lock);
+	pthread_join(wr->thread, NULL);
+
+	DBG(IO, ul_debug("writer thread stopped"));
+
+	/* the data are not written on error */
+	while ((ch = wr->head)) {
+		wr->head = ch->next;
+		free(ch);
+	}
+	while ((ch = wr->unused)) {
+		wr->unused = ch->next;
+		free(ch);
+	}
+	pthread_cond_destroy(&wr->cond);
+	pthread_mutex_destroy(&wr->lock);
+
+	if (wr->err) {
+		errno = wr->err;
+		warn(_("cannot write %s"), wr->errname);
+	}
+	memset(wr, 0, sizeof(*wr));
+}
+
+/* write data to the log directly or by the writer thread */
+static int log_append(struct script_control *ctl, struct script_log *log,
+		      const char *data, size_t bytes)
+{
+	struct script_writer *wr = &ctl->writer;
+
+	if (!wr->active) {
+		if (fwrite_all(data, 1, bytes, log->fp)) {
+			warn(_("cannot write %s"), log->filename);
+			return -errno;
+		}
+		if (ctl->flush)
+			fflush(log->fp);
+		return 0;
+	}
+
+	if (wr->err)
+		return -wr->err;	/* reported by writer_stop() */
+
+	while (bytes) {
+		struct script_chunk *ch = log->chunk;
+		size_t sz;
+
+		if (!ch) {
+			ch = log->chunk = writer_get_chunk(wr);
+			ch->log = log;
+		}
+		sz = min(bytes, sizeof(ch->data) - ch->len);
+		memcpy(ch->data + ch->len, data, sz);
+		ch->len += sz;
+		data += sz;
+		bytes -= sz;
+
+		if (ch->len == sizeof(ch->data)) {
+			writer_queue(wr, ch);
+			log->chunk = NULL;
+		}
+	}
+	return 0;
+}
+
 static ssize_t log_write(struct script_control *ctl,
 		      struct script_stream *stream,
 		      struct script_log *log,
@@ -456,6 +707,7 @@ static ssize_t log_write(struct script_control *ctl,
 	int rc;
 	ssize_t ssz = 0;
 	struct timeval now, delta;
+	char buf[128];
 
 	if (!log->fp)
 		return 0;
@@ -465,11 +717,9 @@ static ssize_t log_write(struct script_control *ctl,
 	switch (log->format) {
 	case SCRIPT_FMT_RAW:
 		DBG(IO, ul_debug("  log raw data"));
-		rc = fwrite_all(obuf, 1, bytes, log->fp);
-		if (rc) {
-			warn(_("cannot write %s"), log->filename);
+		rc = log_append(ctl, log, obuf, bytes);
+		if (rc)
 			return rc;
-		}
 		ssz = bytes;
 		break;
 
@@ -478,10 +728,13 @@ static ssize_t log_write(struct script_control *ctl,
 
 		gettime_monotonic(&now);
 		timersub(&now, &log->oldtime, &delta);
-		ssz = fprintf(log->fp, "%"PRId64".%06"PRId64" %zd\n",
+		ssz = snprintf(buf, sizeof(buf), "%"PRId64".%06"PRId64" %zd\n",
 			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
 		if (ssz < 0)
 			return -errno;
+		rc = log_append(ctl, log, buf, ssz);
+		if (rc)
+			return rc;
 
 		log->oldtime = now;
 		break;
@@ -491,11 +744,14 @@ static ssize_t log_write(struct script_control *ctl,
 
 		gettime_monotonic(&now);
 		timersub(&now, &log->oldtime, &delta);
-		ssz = fprintf(log->fp, "%c %"PRId64".%06"PRId64" %zd\n",
+		ssz = snprintf(buf, sizeof(buf), "%c %"PRId64".%06"PRId64" %zd\n",
 			stream->ident,
 			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
 		if (ssz < 0)
 			return -errno;
+		rc = log_append(ctl, log, buf, ssz);
+		if (rc)
+			return rc;
 
 		log->oldtime = now;
 		break;
@@ -503,8 +759,6 @@ static ssize_t log_write(struct script_control *ctl,
 		break;
 	}
 
-	if (ctl->flush)
-		fflush(log->fp);
 	return ssz;
 }
 
@@ -532,9 +786,10 @@ static ssize_t __attribute__ ((__format__ (__printf__, 3, 4)))
 {
 	struct script_log *log;
 	struct timeval now, delta;
-	char msg[BUFSIZ] = {0};
+	char msg[BUFSIZ] = {0}, buf[BUFSIZ + 128];
 	va_list ap;
 	ssize_t sz;
+	int rc;
 
 	assert(ctl);
 
@@ -558,13 +813,20 @@ static ssize_t __attribute__ ((__format__ (__printf__, 3, 4)))
 	}
 
 	if (*msg)
-		sz = fprintf(log->fp, "S %"PRId64".%06"PRId64" SIG%s %s\n",
+		sz = snprintf(buf, sizeof(buf), "S %"PRId64".%06"PRId64" SIG%s %s\n",
 			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec,
 			signum_to_signame(signum), msg);
 	else
-		sz = fprintf(log->fp, "S %"PRId64".%06"PRId64" SIG%s\n",
+		sz = snprintf(buf, sizeof(buf), "S %"PRId64".%06"PRId64" SIG%s\n",
 			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec,
 			signum_to_signame(signum));
+	if (sz < 0)
+		return -errno;
+	if ((size_t) sz >= sizeof(buf))
+		sz = sizeof(buf) - 1;
+	rc = log_append(ctl, log, buf, sz);
+	if (rc)
+		return rc;
 
 	log->oldtime = now;
 	return sz;
@@ -573,9 +835,10 @@ static ssize_t __attribute__ ((__format__ (__printf__, 3, 4)))
 static ssize_t log_info(struct script_control *ctl, const char *name, const char *msgfmt, ...)
 {
 	struct script_log *log;
-	char msg[BUFSIZ] = {0};
+	char msg[BUFSIZ] = {0}, buf[BUFSIZ + 128];
 	va_list ap;
 	ssize_t sz;
+	int rc;
 
 	assert(ctl);
 
@@ -596,11 +859,16 @@ static ssize_t log_info(struct script_control *ctl, const char *name, const char
 	}
 
 	if (*msg)
-		sz = fprintf(log->fp, "H %f %s %s\n", 0.0, name, msg);
+		sz = snprintf(buf, sizeof(buf), "H %f %s %s\n", 0.0, name, msg);
 	else
-		sz = fprintf(log->fp, "H %f %s\n", 0.0, name);
+		sz = snprintf(buf, sizeof(buf), "H %f %s\n", 0.0, name);
+	if (sz < 0)
+		return -errno;
+	if ((size_t) sz >= sizeof(buf))
+		sz = sizeof(buf) - 1;
+	rc = log_append(ctl, log, buf, sz);
 
-	return sz;
+	return rc ? rc : sz;
 }
 
 
@@ -611,6 +879,9 @@ static void logging_done(struct script_control *ctl, const char *msg)
 
 	DBG(MISC, ul_debug("stop logging"));
 
+	/* write all queued data, the logs are closed by stdio */
+	writer_stop(ctl);
+
 	if (WIFSIGNALED(ctl->childstatus))
 		status = WTERMSIG(ctl->childstatus) + 0x80;
 	else
@@ -727,6 +998,9 @@ static int callback_flush_logs(void *data)
 	struct script_control *ctl = (struct script_control *) data;
 	size_t i;
 
+	if (ctl->writer.active)
+		return writer_flush(ctl);
+
 	for (i = 0; i < ctl->out.nlogs; i++) {
 		int rc = log_flush(ctl, ctl->out.logs[i]);
 		if (rc)
@@ -1040,6 +1314,8 @@ int main(int argc, char **argv)
 			log_info(&ctl, "INPUT_LOG", "%s", infile);
 	}
 
+	writer_start(&ctl);
+
         /* this is the main loop */
 	rc = ul_pty_proxy_master(ctl.pty);
 
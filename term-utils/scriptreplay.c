@@ -64,6 +64,8 @@ usage(void)
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("     --summary           display overview about recorded session and exit\n"), out);
+	fputs(_("     --start <time>      skip the first <time> seconds of the session\n"), out);
+	fputs(_("     --index[=<file>]    use (and create) index of the timing file\n"), out);
 	fputs(_(" -d, --divisor <num>     speed up or slow down execution with time divisor\n"), out);
 	fputs(_(" -m, --maxdelay <num>    wait at most this many seconds between updates\n"), out);
 	fputs(_(" -x, --stream <name>     stream type (out, in, signal or info)\n"), out);
@@ -143,7 +145,7 @@ int
 main(int argc, char *argv[])
 {
 	static const struct timeval mindelay = { .tv_sec = 0, .tv_usec = 100 };
-	struct timeval maxdelay;
+	struct timeval maxdelay, start;
 
 	int isterm;
 	struct termios saved;
@@ -155,11 +157,14 @@ main(int argc, char *argv[])
 	           *log_in = NULL,
 		   *log_io = NULL,
 		   *log_tm = NULL;
+	char *index = NULL;
 	double divi = 1;
 	int diviopt = FALSE, idx;
-	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0;
+	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0, use_index = 0;
 	enum {
-		OPT_SUMMARY = CHAR_MAX + 1
+		OPT_SUMMARY = CHAR_MAX + 1,
+		OPT_START,
+		OPT_INDEX
 	};
 
 	static const struct option longopts[] = {
@@ -174,6 +179,8 @@ main(int argc, char *argv[])
 		{ "maxdelay",	required_argument,	0, 'm' },
 		{ "stream",     required_argument,	0, 'x' },
 		{ "summary",    no_argument,            0, OPT_SUMMARY },
+		{ "start",      required_argument,      0, OPT_START },
+		{ "index",      optional_argument,      0, OPT_INDEX },
 		{ "version",	no_argument,		0, 'V' },
 		{ "help",	no_argument,		0, 'h' },
 		{ NULL,		0, 0, 0 }
@@ -196,6 +203,7 @@ main(int argc, char *argv[])
 
 	replay_init_debug();
 	timerclear(&maxdelay);
+	timerclear(&start);
 
 	while ((ch = getopt_long(argc, argv, "B:c:I:O:T:t:s:d:m:x:Vh", longopts, NULL)) != -1) {
 
@@ -248,6 +256,14 @@ main(int argc, char *argv[])
 		case OPT_SUMMARY:
 			summary = 1;
 			break;
+		case OPT_START:
+			strtotimeval_or_err(optarg, &start, _("failed to parse start time argument"));
+			break;
+		case OPT_INDEX:
+			use_index = 1;
+			if (optarg)
+				index = xstrdup(optarg);
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -302,6 +318,26 @@ main(int argc, char *argv[])
 			*streams && streams[1] == '\0' ? *streams : 'O');
 	replay_set_crmode(setup, crmode);
 
+	if (use_index) {
+		if (!index)
+			xasprintf(&index, "%s.index", log_tm);
+		rc = replay_use_index(setup, index);
+		if (rc < 0)
+			err(EXIT_FAILURE, _("%s: line %d: timing file error"),
+					replay_get_timing_file(setup),
+					replay_get_timing_line(setup));
+		if (rc > 0)
+			warn(_("cannot write %s"), index);
+	}
+
+	if (timerisset(&start) && !summary) {
+		rc = replay_seek(setup, &start);
+		if (rc < 0)
+			err(EXIT_FAILURE, _("%s: line %d: timing file error"),
+					replay_get_timing_file(setup),
+					replay_get_timing_line(setup));
+	}
+
 	if (divi != 1)
 		replay_set_delay_div(setup, divi);
 	if (timerisset(&maxdelay))
@@ -335,6 +371,7 @@ main(int argc, char *argv[])
 				replay_get_timing_line(setup));
 	printf("\n");
 	replay_free_setup(setup);
+	free(index);
 
 	exit(EXIT_SUCCESS);
 }
@@ -43,6 +43,8 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <dirent.h>
@@ -54,12 +56,16 @@
 #include <stdlib.h>
 
 #include "nls.h"
+#include "xalloc.h"
 #include "closestream.h"
 #include "pathnames.h"
 #include "ttymsg.h"
 
 #define ERR_BUFLEN	(MAXNAMLEN + 1024)
 
+/* max number of blocked ttys served by one child process (see ttymsg_all()) */
+#define TTYMSG_MAX_BLOCKED	256
+
 /*
  * Display the contents of a uio structure on a terminal.  Used by wall(1),
  * syslogd(8), and talkd(8).  Forks and finishes in child if write would block,
@@ -190,3 +196,207 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 		_exit(EXIT_SUCCESS);
 	return NULL;
 }
+
+struct ttymsg_tty {
+	int	fd;
+	size_t	done;		/* already written bytes */
+	char	*device;
+};
+
+/* writev() the message from @skip offset */
+static ssize_t writev_from(int fd, const struct iovec *iov, size_t iovcnt, size_t skip)
+{
+	struct iovec localiov[6];
+	size_t i, n = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (skip >= iov[i].iov_len) {
+			skip -= iov[i].iov_len;
+			continue;
+		}
+		localiov[n].iov_base = (char *) iov[i].iov_base + skip;
+		localiov[n].iov_len = iov[i].iov_len - skip;
+		skip = 0;
+		n++;
+	}
+	return writev(fd, localiov, n);
+}
+
+/*
+ * Returns: 1 if the message has been written (or the line went away),
+ *	    0 if the write would block, -1 on error.
+ */
+static int ttymsg_write(struct ttymsg_tty *tty, const struct iovec *iov,
+			size_t iovcnt, size_t total)
+{
+	while (tty->done < total) {
+		ssize_t ret = writev_from(tty->fd, iov, iovcnt, tty->done);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			/*
+			 * We get ENODEV on a slip line if we're running as root,
+			 * and EIO if the line just went away.
+			 */
+			if (errno == ENODEV || errno == EIO)
+				return 1;
+			return -1;
+		}
+		tty->done += ret;
+	}
+	return 1;
+}
+
+static void ttymsg_close(struct ttymsg_tty *tty)
+{
+	if (tty->fd >= 0)
+		close(tty->fd);
+	tty->fd = -1;
+	free(tty->device);
+	tty->device = NULL;
+}
+
+/*
+ * Finishes writes to the blocked ttys in a child process, the parent
+ * returns immediately. The child waits at most @tmout seconds for all the
+ * ttys; the slow ttys are dropped.
+ */
+static void ttymsg_serve_blocked(struct ttymsg_tty *ttys, size_t nttys,
+				 const struct iovec *iov, size_t iovcnt,
+				 size_t total, int tmout)
+{
+	struct pollfd *pfd;
+	sigset_t sigmask;
+	time_t deadline;
+	size_t i, active = nttys;
+	pid_t cpid;
+
+	cpid = fork();
+	if (cpid != 0) {
+		/* parent or error */
+		if (cpid < 0)
+			warn(_("fork failed"));
+		for (i = 0; i < nttys; i++) {
+			close(ttys[i].fd);
+			ttys[i].fd = -1;
+			free(ttys[i].device);
+			ttys[i].device = NULL;
+		}
+		return;
+	}
+
+	signal(SIGALRM, SIG_DFL);
+	signal(SIGTERM, SIG_DFL); /* XXX */
+	sigemptyset(&sigmask);
+	sigprocmask(SIG_SETMASK, &sigmask, NULL);
+
+	pfd = calloc(nttys, sizeof(*pfd));
+	if (!pfd)
+		_exit(EXIT_FAILURE);
+	for (i = 0; i < nttys; i++) {
+		pfd[i].fd = ttys[i].fd;
+		pfd[i].events = POLLOUT;
+	}
+
+	deadline = time(NULL) + tmout;
+
+	while (active) {
+		time_t now = time(NULL);
+		int rc;
+
+		if (now >= deadline)
+			break;		/* drop slow ttys */
+
+		rc = poll(pfd, nttys, (deadline - now) * 1000);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			break;
+
+		for (i = 0; i < nttys; i++) {
+			if (pfd[i].fd < 0 || !pfd[i].revents)
+				continue;
+
+			rc = -1;
+			if (pfd[i].revents & POLLOUT)
+				rc = ttymsg_write(&ttys[i], iov, iovcnt, total);
+			if (rc == 0)
+				continue;
+			if (rc < 0 && (pfd[i].revents & POLLOUT))
+				warnx("%s: %m", ttys[i].device);
+
+			ttymsg_close(&ttys[i]);
+			pfd[i].fd = -1;
+			active--;
+		}
+	}
+
+	_exit(active ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/*
+ * Display the contents of a uio structure on all @lines. This is the same
+ * as ttymsg() for each line, but the message is written to all ready
+ * terminals first, and the blocked terminals are served by one child process
+ * (per TTYMSG_MAX_BLOCKED terminals) rather than by a child per terminal.
+ * Errors are reported by warnx().
+ */
+void ttymsg_all(struct iovec *iov, size_t iovcnt, char **lines, size_t nlines, int tmout)
+{
+	struct ttymsg_tty *blocked;
+	size_t i, nblocked = 0, total = 0;
+
+	if (iovcnt > 6) {
+		warnx(_("internal error: too many iov's"));
+		return;
+	}
+	for (i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+
+	blocked = xcalloc(TTYMSG_MAX_BLOCKED, sizeof(*blocked));
+
+	for (i = 0; i < nlines; i++) {
+		struct ttymsg_tty tty = { .fd = -1 };
+		int rc;
+
+		if (asprintf(&tty.device, "%s%s", _PATH_DEV, lines[i]) < 0
+		    || strlen(tty.device) >= MAXNAMLEN) {
+			warnx(_("excessively long line arg"));
+			free(tty.device);
+			continue;
+		}
+
+		/*
+		 * open will fail on slip lines or exclusive-use lines
+		 * if not running as root; not an error.
+		 */
+		tty.fd = open(tty.device, O_WRONLY|O_NONBLOCK, 0);
+		if (tty.fd < 0) {
+			if (!(errno == EBUSY || errno == EACCES || errno == ENOENT))
+				warnx("%s: %m", tty.device);
+			free(tty.device);
+			continue;
+		}
+
+		rc = ttymsg_write(&tty, iov, iovcnt, total);
+		if (rc == 0) {
+			blocked[nblocked++] = tty;
+			if (nblocked == TTYMSG_MAX_BLOCKED) {
+				ttymsg_serve_blocked(blocked, nblocked,
+						iov, iovcnt, total, tmout);
+				nblocked = 0;
+			}
+			continue;
+		}
+		if (rc < 0)
+			warnx("%s: %m", tty.device);
+		ttymsg_close(&tty);
+	}
+
+	if (nblocked)
+		ttymsg_serve_blocked(blocked, nblocked, iov, iovcnt, total, tmout);
+	free(blocked);
+}
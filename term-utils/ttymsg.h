@@ -2,5 +2,6 @@
 #define UTIL_LINUX_TERM_TTYMSG_H
 
 char *ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout);
+void ttymsg_all(struct iovec *iov, size_t iovcnt, char **lines, size_t nlines, int tmout);
 
 #endif /* UTIL_LINUX_TERM_TTYMSG_H */
@@ -60,6 +60,7 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include <grp.h>
+#include <search.h>
 
 #if defined(USE_SYSTEMD) && HAVE_DECL_SD_SESSION_GET_USERNAME == 1
 # include <systemd/sd-login.h>
@@ -110,6 +111,7 @@ static void __attribute__((__noreturn__)) usage(void)
 struct group_workspace {
 	gid_t	requested_group;
 	int	ngroups;
+	void	*members;	/* tree of struct group_member */
 
 /* getgrouplist() on OSX takes int* not gid_t* */
 #ifdef __APPLE__
@@ -119,6 +121,26 @@ struct group_workspace {
 #endif
 };
 
+/* cached result of the group membership check */
+struct group_member {
+	char	*login;
+	int	is_member;
+};
+
+static int cmp_group_member(const void *a, const void *b)
+{
+	return strcmp(((const struct group_member *) a)->login,
+		      ((const struct group_member *) b)->login);
+}
+
+static void free_group_member(void *data)
+{
+	struct group_member *m = data;
+
+	free(m->login);
+	free(m);
+}
+
 static gid_t get_group_gid(const char *group)
 {
 	struct group *gr;
@@ -141,6 +163,7 @@ static struct group_workspace *init_group_workspace(const char *group)
 	buf->requested_group = get_group_gid(group);
 	buf->ngroups = sysconf(_SC_NGROUPS_MAX) + 1;  /* room for the primary gid */
 	buf->groups = xcalloc(buf->ngroups, sizeof(*buf->groups));
+	buf->members = NULL;
 
 	return buf;
 }
@@ -150,11 +173,12 @@ static void free_group_workspace(struct group_workspace *buf)
 	if (!buf)
 		return;
 
+	tdestroy(buf->members, free_group_member);
 	free(buf->groups);
 	free(buf);
 }
 
-static int is_gr_member(const char *login, const struct group_workspace *buf)
+static int check_gr_member(const char *login, const struct group_workspace *buf)
 {
 	struct passwd *pw;
 	int ngroups = buf->ngroups;
@@ -183,13 +207,46 @@ static int is_gr_member(const char *login, const struct group_workspace *buf)
 	return 0;
 }
 
+/* users usually have more sessions, the result is checked once per user */
+static int is_gr_member(const char *login, struct group_workspace *buf)
+{
+	struct group_member key = { .login = (char *) login }, *m, **x;
+
+	x = tfind(&key, &buf->members, cmp_group_member);
+	if (x)
+		return (*x)->is_member;
+
+	m = xmalloc(sizeof(*m));
+	m->login = xstrdup(login);
+	m->is_member = check_gr_member(login, buf);
+	tsearch(m, &buf->members, cmp_group_member);
+
+	return m->is_member;
+}
+
+/* terminals to write the message */
+struct wall_ttys {
+	char	**lines;
+	size_t	nlines;
+};
+
+static void add_tty(struct wall_ttys *ttys, const char *line)
+{
+	if (ttys->nlines % 64 == 0)
+		ttys->lines = xreallocarray(ttys->lines, ttys->nlines + 64,
+					    sizeof(char *));
+	ttys->lines[ttys->nlines++] = xstrdup(line);
+}
+
 int main(int argc, char **argv)
 {
 	int ch;
 	struct iovec iov;
 	struct utmpx *utmpptr;
-	char *p;
+	struct wall_ttys ttys = { .nlines = 0 };
+	size_t n;
 	char line[sizeof(utmpptr->ut_line) + 1];
+	char user[sizeof(utmpptr->ut_user) + 1];
 	int print_banner = TRUE;
 	struct group_workspace *group_buf = NULL;
 	char *mbuf, *fname = NULL;
@@ -271,9 +328,7 @@ int main(int argc, char **argv)
 
 			if (!(group_buf && !is_gr_member(name, group_buf))) {
 				if (sd_session_get_tty(sessions_list[i], &tty) >= 0) {
-					if ((p = ttymsg(&iov, 1, tty, timeout)) != NULL)
-						warnx("%s", p);
-
+					add_tty(&ttys, tty);
 					free(tty);
 				}
 			}
@@ -299,16 +354,23 @@ int main(int argc, char **argv)
 			if (!*utmpptr->ut_line || *utmpptr->ut_line == ':')
 				continue;
 
-			if (group_buf && !is_gr_member(utmpptr->ut_user, group_buf))
-				continue;
+			if (group_buf) {
+				mem2strcpy(user, utmpptr->ut_user, sizeof(utmpptr->ut_user), sizeof(user));
+				if (!is_gr_member(user, group_buf))
+					continue;
+			}
 
 			mem2strcpy(line, utmpptr->ut_line, sizeof(utmpptr->ut_line), sizeof(line));
-			if ((p = ttymsg(&iov, 1, line, timeout)) != NULL)
-				warnx("%s", p);
+			add_tty(&ttys, line);
 		}
 		endutxent();
 	}
 
+	ttymsg_all(&iov, 1, ttys.lines, ttys.nlines, timeout);
+
+	for (n = 0; n < ttys.nlines; n++)
+		free(ttys.lines[n]);
+	free(ttys.lines);
 	free(mbuf);
 	free_group_workspace(group_buf);
 	exit(EXIT_SUCCESS);
@@ -0,0 +1,521 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * test_blkid_bench - measure libblkid probing over a set of images
+ *
+ * Usage: test_blkid_bench [options] <image|directory> ...
+ *
+ * The images compressed by xz(1) (e.g. tests/ts/blkid/images-fs/) are
+ * decompressed only once before the measurement. Every image is probed
+ * repeatedly with every selected configuration and the results are
+ * printed in JSON. For each probing the time, the number of read
+ * syscalls and bytes (from /proc/self/io) and the number of allocations
+ * are accounted. The probe is created and deallocated within the
+ * measured interval, so the numbers cover the whole blkid(8)-like
+ * probing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <blkid.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "monotonic.h"
+#include "jsonwrt.h"
+
+#define BENCH_DEFAULT_ITERATIONS	100
+
+enum {
+	BENCH_SAFEPROBE,
+	BENCH_FULLPROBE
+};
+
+struct bench_conf {
+	const char	*name;
+	const char	*desc;
+	int		method;		/* BENCH_{SAFE,FULL}PROBE */
+	int		superblocks;	/* enable superblocks chain */
+	int		sbflags;	/* blkid_probe_set_superblocks_flags() */
+	int		usage;		/* BLKID_FLTR_ONLYIN filter, 0 = none */
+	int		partitions;	/* enable partitions chain */
+	int		ptflags;	/* blkid_probe_set_partitions_flags() */
+};
+
+static const struct bench_conf bench_confs[] = {
+	{ "safeprobe", "superblocks with default flags (blkid -p)",
+		BENCH_SAFEPROBE, 1, BLKID_SUBLKS_DEFAULT, 0, 0, 0 },
+	{ "safeprobe-all", "superblocks and partitions",
+		BENCH_SAFEPROBE, 1, BLKID_SUBLKS_DEFAULT, 0, 1, 0 },
+	{ "safeprobe-magic", "superblocks with all attributes and magic offsets",
+		BENCH_SAFEPROBE, 1, BLKID_SUBLKS_DEFAULT | BLKID_SUBLKS_LABELRAW |
+		BLKID_SUBLKS_UUIDRAW | BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION |
+		BLKID_SUBLKS_MAGIC | BLKID_SUBLKS_FSINFO, 0, 0, 0 },
+	{ "safeprobe-fs", "superblocks filtered to filesystems only",
+		BENCH_SAFEPROBE, 1, BLKID_SUBLKS_DEFAULT, BLKID_USAGE_FILESYSTEM, 0, 0 },
+	{ "safeprobe-pt", "partitions only, with entry details",
+		BENCH_SAFEPROBE, 0, 0, 0, 1, BLKID_PARTS_ENTRY_DETAILS },
+	{ "fullprobe", "superblocks and partitions, all matching signatures",
+		BENCH_FULLPROBE, 1, BLKID_SUBLKS_DEFAULT | BLKID_SUBLKS_MAGIC, 0,
+		1, BLKID_PARTS_MAGIC }
+};
+
+struct bench_image {
+	char	*name;		/* file name without .xz suffix */
+	int	fd;		/* uncompressed image */
+};
+
+struct bench_result {
+	int		rc;		/* return code of the last probing */
+	char		*type;		/* detected TYPE or PTTYPE */
+	uint64_t	*ns;		/* per-iteration time */
+	uint64_t	reads;		/* read syscalls, sum of all iterations */
+	uint64_t	read_bytes;
+	uint64_t	allocs;		/* allocations, sum of all iterations */
+	uint64_t	alloc_bytes;
+	unsigned int	have_io : 1,
+			have_allocs : 1;
+};
+
+/*
+ * Allocations counter. The glibc allocator is wrapped, other libcs are
+ * not supported and the counters are reported as null.
+ */
+#ifdef __GLIBC__
+# define HAVE_ALLOC_COUNTER 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static int alloc_counting;
+static uint64_t alloc_count, alloc_bytes;
+
+static inline void account_alloc(size_t size)
+{
+	if (alloc_counting) {
+		alloc_count++;
+		alloc_bytes += size;
+	}
+}
+
+void *malloc(size_t size)
+{
+	account_alloc(size);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	account_alloc(nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	account_alloc(size);
+	return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	account_alloc(size);
+	p = __libc_memalign(alignment, size);
+	if (!p)
+		return ENOMEM;
+	*memptr = p;
+	return 0;
+}
+#endif /* __GLIBC__ */
+
+/*
+ * I/O counters from /proc/self/io. The file is read by pread(), and the
+ * read itself is subtracted from the next snapshot.
+ */
+struct io_snapshot {
+	uint64_t	syscr;
+	uint64_t	rchar;
+	size_t		len;		/* bytes read from /proc/self/io */
+};
+
+static int io_fd = -1;
+
+static int io_read_snapshot(struct io_snapshot *io)
+{
+	char buf[BUFSIZ], *p;
+	ssize_t sz;
+
+	if (io_fd < 0)
+		return -EINVAL;
+
+	sz = pread(io_fd, buf, sizeof(buf) - 1, 0);
+	if (sz <= 0)
+		return -errno;
+	buf[sz] = '\0';
+
+	p = strstr(buf, "rchar:");
+	if (!p)
+		return -EINVAL;
+	io->rchar = strtoull(p + 6, NULL, 10);
+
+	p = strstr(buf, "syscr:");
+	if (!p)
+		return -EINVAL;
+	io->syscr = strtoull(p + 6, NULL, 10);
+	io->len = sz;
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int decompress_image(const char *path)
+{
+	char tmpl[PATH_MAX];
+	const char *tmpdir = getenv("TMPDIR");
+	pid_t pid;
+	int fd, status;
+
+	snprintf(tmpl, sizeof(tmpl), "%s/blkid-bench-XXXXXX",
+			tmpdir && *tmpdir ? tmpdir : "/tmp");
+	fd = mkstemp(tmpl);
+	if (fd < 0)
+		err(EXIT_FAILURE, "cannot create temporary file");
+
+	/* the file is removed when closed */
+	unlink(tmpl);
+
+	pid = fork();
+	if (pid < 0)
+		err(EXIT_FAILURE, "fork failed");
+	if (pid == 0) {
+		if (dup2(fd, STDOUT_FILENO) < 0)
+			_exit(EXIT_FAILURE);
+		execlp("xz", "xz", "-dc", "--", path, (char *) NULL);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		err(EXIT_FAILURE, "waitpid failed");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		errx(EXIT_FAILURE, "%s: cannot decompress", path);
+
+	lseek(fd, 0, SEEK_SET);
+	return fd;
+}
+
+static void add_image(struct bench_image **imgs, size_t *nimgs, const char *path)
+{
+	struct bench_image *img;
+	const char *base = strrchr(path, '/');
+	size_t len;
+
+	*imgs = xreallocarray(*imgs, *nimgs + 1, sizeof(struct bench_image));
+	img = &(*imgs)[(*nimgs)++];
+
+	base = base ? base + 1 : path;
+	len = strlen(base);
+
+	if (endswith(base, ".xz")) {
+		img->name = xstrndup(base, len - 3);
+		img->fd = decompress_image(path);
+	} else {
+		img->name = xstrdup(base);
+		img->fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (img->fd < 0)
+			err(EXIT_FAILURE, "cannot open %s", path);
+	}
+}
+
+static void add_path(struct bench_image **imgs, size_t *nimgs, const char *path)
+{
+	struct dirent **list = NULL;
+	struct stat st;
+	int i, n;
+
+	if (stat(path, &st) != 0)
+		err(EXIT_FAILURE, "stat of %s failed", path);
+	if (!S_ISDIR(st.st_mode)) {
+		add_image(imgs, nimgs, path);
+		return;
+	}
+
+	n = scandir(path, &list, NULL, alphasort);
+	if (n < 0)
+		err(EXIT_FAILURE, "cannot read directory %s", path);
+
+	for (i = 0; i < n; i++) {
+		char *p;
+
+		xasprintf(&p, "%s/%s", path, list[i]->d_name);
+		if (stat(p, &st) == 0 && S_ISREG(st.st_mode))
+			add_image(imgs, nimgs, p);
+		free(p);
+		free(list[i]);
+	}
+	free(list);
+}
+
+static int probe_once(int fd, const struct bench_conf *conf, char **type)
+{
+	blkid_probe pr;
+	const char *data = NULL;
+	int rc;
+
+	pr = blkid_new_probe();
+	if (!pr)
+		return -ENOMEM;
+
+	rc = blkid_probe_set_device(pr, fd, 0, 0);
+	if (rc != 0)
+		goto done;
+
+	blkid_probe_enable_superblocks(pr, conf->superblocks);
+	if (conf->superblocks) {
+		blkid_probe_set_superblocks_flags(pr, conf->sbflags);
+		if (conf->usage)
+			blkid_probe_filter_superblocks_usage(pr,
+					BLKID_FLTR_ONLYIN, conf->usage);
+	}
+	blkid_probe_enable_partitions(pr, conf->partitions);
+	if (conf->partitions)
+		blkid_probe_set_partitions_flags(pr, conf->ptflags);
+
+	if (conf->method == BENCH_FULLPROBE)
+		rc = blkid_do_fullprobe(pr);
+	else
+		rc = blkid_do_safeprobe(pr);
+
+	if (type && rc == 0
+	    && blkid_probe_lookup_value(pr, "TYPE", &data, NULL) != 0)
+		blkid_probe_lookup_value(pr, "PTTYPE", &data, NULL);
+	if (type && data)
+		*type = xstrdup(data);
+done:
+	blkid_free_probe(pr);
+	return rc;
+}
+
+static void run_bench(int fd, const struct bench_conf *conf,
+		      size_t iterations, struct bench_result *res)
+{
+	size_t i;
+
+	memset(res, 0, sizeof(*res));
+	res->ns = xcalloc(iterations, sizeof(uint64_t));
+	res->have_io = io_fd >= 0;
+#ifdef HAVE_ALLOC_COUNTER
+	res->have_allocs = 1;
+#endif
+	/* warm up the page cache and the library, and get the result */
+	probe_once(fd, conf, &res->type);
+
+	for (i = 0; i < iterations; i++) {
+		struct io_snapshot io0 = { 0 }, io1 = { 0 };
+		uint64_t t0, t1;
+
+		if (res->have_io && io_read_snapshot(&io0) != 0)
+			res->have_io = 0;
+#ifdef HAVE_ALLOC_COUNTER
+		alloc_count = alloc_bytes = 0;
+		alloc_counting = 1;
+#endif
+		t0 = gettime_monotonic_nsec();
+		res->rc = probe_once(fd, conf, NULL);
+		t1 = gettime_monotonic_nsec();
+#ifdef HAVE_ALLOC_COUNTER
+		alloc_counting = 0;
+		res->allocs += alloc_count;
+		res->alloc_bytes += alloc_bytes;
+#endif
+		if (res->have_io && io_read_snapshot(&io1) != 0)
+			res->have_io = 0;
+		if (res->have_io) {
+			/* don't account the read of io0 */
+			res->reads += io1.syscr - io0.syscr - 1;
+			res->read_bytes += io1.rchar - io0.rchar - io0.len;
+		}
+		res->ns[i] = t1 - t0;
+	}
+}
+
+static void print_result(struct ul_jsonwrt *json, const char *image,
+			 const struct bench_conf *conf, size_t iterations,
+			 struct bench_result *res)
+{
+	uint64_t sum = 0;
+	size_t i;
+	char rc[16];
+
+	for (i = 0; i < iterations; i++)
+		sum += res->ns[i];
+	qsort(res->ns, iterations, sizeof(uint64_t), cmp_u64);
+
+	ul_jsonwrt_object_open(json, NULL);
+	ul_jsonwrt_value_s(json, "image", image);
+	ul_jsonwrt_value_s(json, "config", conf->name);
+	ul_jsonwrt_value_u64(json, "iterations", iterations);
+	snprintf(rc, sizeof(rc), "%d", res->rc);
+	ul_jsonwrt_value_raw(json, "rc", rc);
+	if (res->type)
+		ul_jsonwrt_value_s(json, "type", res->type);
+	else
+		ul_jsonwrt_value_null(json, "type");
+
+	ul_jsonwrt_value_u64(json, "min_ns", res->ns[0]);
+	ul_jsonwrt_value_u64(json, "median_ns", res->ns[iterations / 2]);
+	ul_jsonwrt_value_u64(json, "mean_ns", sum / iterations);
+	ul_jsonwrt_value_u64(json, "max_ns", res->ns[iterations - 1]);
+
+	/* per-probe averages */
+	if (res->have_io) {
+		ul_jsonwrt_value_double(json, "reads", (double) res->reads / iterations);
+		ul_jsonwrt_value_double(json, "read_bytes", (double) res->read_bytes / iterations);
+	} else {
+		ul_jsonwrt_value_null(json, "reads");
+		ul_jsonwrt_value_null(json, "read_bytes");
+	}
+	if (res->have_allocs) {
+		ul_jsonwrt_value_double(json, "allocs", (double) res->allocs / iterations);
+		ul_jsonwrt_value_double(json, "alloc_bytes", (double) res->alloc_bytes / iterations);
+	} else {
+		ul_jsonwrt_value_null(json, "allocs");
+		ul_jsonwrt_value_null(json, "alloc_bytes");
+	}
+	ul_jsonwrt_object_close(json);
+
+	free(res->ns);
+	free(res->type);
+}
+
+static int name_to_conf(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_confs); i++) {
+		const char *cn = bench_confs[i].name;
+
+		if (strlen(cn) == namesz && strncmp(name, cn, namesz) == 0)
+			return i;
+	}
+	warnx("unknown configuration: %s", name);
+	return -1;
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	size_t i;
+
+	fprintf(out, "Usage: %s [options] <image|directory> ...\n",
+			program_invocation_short_name);
+	fputs("\nOptions:\n", out);
+	fputs(" -n, --iterations <num>   number of probings per image and configuration\n", out);
+	fputs(" -c, --config <list>      comma-separated list of configurations\n", out);
+	fputs(" -h, --help               display this help\n", out);
+
+	fputs("\nConfigurations:\n", out);
+	for (i = 0; i < ARRAY_SIZE(bench_confs); i++)
+		fprintf(out, " %-17s %s\n", bench_confs[i].name, bench_confs[i].desc);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_image *imgs = NULL;
+	struct ul_jsonwrt json;
+	size_t nimgs = 0, iterations = BENCH_DEFAULT_ITERATIONS, i;
+	int confs[ARRAY_SIZE(bench_confs)];
+	int nconfs = 0, c, j;
+
+	static const struct option longopts[] = {
+		{ "iterations", required_argument, NULL, 'n' },
+		{ "config",     required_argument, NULL, 'c' },
+		{ "help",       no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((c = getopt_long(argc, argv, "n:c:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			iterations = strtou32_or_err(optarg, "invalid iterations argument");
+			if (!iterations)
+				errx(EXIT_FAILURE, "iterations must be greater than zero");
+			break;
+		case 'c':
+			nconfs = string_to_idarray(optarg, confs,
+					ARRAY_SIZE(confs), name_to_conf);
+			if (nconfs <= 0)
+				errx(EXIT_FAILURE, "invalid configuration list: %s", optarg);
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (optind == argc) {
+		warnx("no image specified");
+		errtryhelp(EXIT_FAILURE);
+	}
+
+	if (!nconfs) {
+		for (j = 0; j < (int) ARRAY_SIZE(bench_confs); j++)
+			confs[nconfs++] = j;
+	}
+
+	for (; optind < argc; optind++)
+		add_path(&imgs, &nimgs, argv[optind]);
+
+	io_fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+	blkid_init_debug(0);
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "results");
+
+	for (i = 0; i < nimgs; i++) {
+		for (j = 0; j < nconfs; j++) {
+			const struct bench_conf *conf = &bench_confs[confs[j]];
+			struct bench_result res;
+
+			run_bench(imgs[i].fd, conf, iterations, &res);
+			print_result(&json, imgs[i].name, conf, iterations, &res);
+		}
+		close(imgs[i].fd);
+		free(imgs[i].name);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+
+	free(imgs);
+	if (io_fd >= 0)
+		close(io_fd);
+	return EXIT_SUCCESS;
+}
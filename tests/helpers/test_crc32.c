@@ -0,0 +1,122 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * test_crc32 - checks and benchmarks CRC32 implementations
+ *
+ * Usage:
+ *	test_crc32		  print CRC32 of stdin
+ *	test_crc32 --check	  compare accelerated and generic implementation
+ *	test_crc32 --bench <size> [<loops>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+#include "c.h"
+#include "crc32.h"
+
+typedef uint32_t (*crc32_fn)(uint32_t, const unsigned char *, size_t);
+
+static int do_stdin(void)
+{
+	unsigned char buf[BUFSIZ];
+	uint32_t crc = ~0U;
+	size_t ret;
+
+	while ((ret = fread(buf, 1, sizeof(buf), stdin)) > 0)
+		crc = ul_crc32(crc, buf, ret);
+
+	if (ferror(stdin))
+		err(EXIT_FAILURE, "read failed");
+
+	printf("%08x\n", crc ^ ~0U);
+	return EXIT_SUCCESS;
+}
+
+static int do_check(void)
+{
+	unsigned char buf[4096 + 16];
+	size_t off, len, i;
+
+	srandom(1);
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = random();
+
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len <= 4096; len++) {
+			uint32_t seed = len & 1 ? ~0U : (uint32_t) len;
+			uint32_t a = ul_crc32(seed, buf + off, len);
+			uint32_t b = ul_crc32_generic(seed, buf + off, len);
+
+			if (a != b) {
+				printf("mismatch [off=%zu, len=%zu]: %08x != %08x\n",
+						off, len, a, b);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	printf("ok\n");
+	return EXIT_SUCCESS;
+}
+
+static double bench(crc32_fn fn, const unsigned char *buf, size_t size, size_t loops)
+{
+	struct timespec a, b;
+	uint32_t crc = ~0U;
+	double sec;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (i = 0; i < loops; i++)
+		crc = fn(crc, buf, size);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+
+	sec = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+
+	/* don't let the compiler to optimize out the calls */
+	if (crc == 0x12345678)
+		fputc('\n', stderr);
+
+	return sec > 0 ? ((double) size * loops) / (1024 * 1024) / sec : 0;
+}
+
+static int do_bench(size_t size, size_t loops)
+{
+	unsigned char *buf;
+	size_t i;
+
+	buf = malloc(size);
+	if (!buf)
+		err(EXIT_FAILURE, "cannot allocate %zu bytes", size);
+	for (i = 0; i < size; i++)
+		buf[i] = i;
+
+	printf("size=%zu loops=%zu\n", size, loops);
+	printf("  generic: %10.1f MiB/s\n", bench(ul_crc32_generic, buf, size, loops));
+	printf("  ul_crc32: %9.1f MiB/s\n", bench(ul_crc32, buf, size, loops));
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc == 1)
+		return do_stdin();
+	if (argc == 2 && strcmp(argv[1], "--check") == 0)
+		return do_check();
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench") == 0) {
+		size_t size = strtoul(argv[2], NULL, 10);
+		size_t loops = argc == 4 ? strtoul(argv[3], NULL, 10) : 1000;
+
+		if (!size || !loops)
+			errx(EXIT_FAILURE, "invalid size or loops");
+		return do_bench(size, loops);
+	}
+
+	fprintf(stderr, "usage: %s [--check | --bench <size> [<loops>]]\n",
+			program_invocation_short_name);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,702 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * test_mount_bench - measure libmount scaling with huge mount tables
+ *
+ * Usage: test_mount_bench [options]
+ *
+ * For every requested size the program generates a synthetic mountinfo
+ * (a tree of mountpoints), its modified copy, fstab and utab, and then
+ * measures the libmount operations over the files. The results are
+ * printed in JSON, one record for each size and test, so the scaling
+ * curves are easy to plot and compare.
+ *
+ * An operation is not measured for bigger sizes if it has been slower
+ * than --limit for a smaller size.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <libmount.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "monotonic.h"
+#include "jsonwrt.h"
+#include "closestream.h"
+
+#define BENCH_DEFAULT_SIZES	"1000,10000,100000"
+#define BENCH_DEFAULT_LOOKUPS	10000
+#define BENCH_DEFAULT_LIMIT	10		/* seconds */
+
+/* mountinfo tree fanout, 16 children for every mountpoint */
+#define BENCH_FANOUT		16
+/* the first mount ID, the root parent ID is not in the table */
+#define BENCH_FIRST_ID		20
+
+struct bench_ctx {
+	size_t		nents;		/* number of generated entries */
+	size_t		nlookups;	/* number of find/resolve operations */
+	char		**targets;	/* generated mountpoints */
+
+	char		*dir;		/* directory with the generated files */
+	char		*mountinfo;
+	char		*mountinfo_new;	/* modified mountinfo for diff */
+	char		*fstab;
+	char		*utab;
+
+	const char	*findmnt;	/* path to findmnt(8) or NULL */
+};
+
+struct bench_test {
+	const char	*name;
+	const char	*desc;
+
+	/* returns 0 on success, the time is in @ns for @nops operations */
+	int		(*run)(struct bench_ctx *, const struct bench_test *,
+			       uint64_t *ns, size_t *nops);
+	const char	*arg;		/* test specific argument */
+
+	unsigned int	need_findmnt : 1;
+};
+
+/*
+ * Generator
+ */
+static void gen_targets(struct bench_ctx *ctx)
+{
+	size_t k;
+
+	ctx->targets = xcalloc(ctx->nents, sizeof(char *));
+	ctx->targets[0] = xstrdup("/");
+
+	for (k = 1; k < ctx->nents; k++) {
+		size_t p = (k - 1) / BENCH_FANOUT;
+
+		xasprintf(&ctx->targets[k], "%s/m%zu",
+				p == 0 ? "" : ctx->targets[p], k);
+	}
+}
+
+static void gen_mountinfo_entry(FILE *f, struct bench_ctx *ctx, size_t k,
+				const char *vfsopts)
+{
+	int id = k + BENCH_FIRST_ID;
+	int parent = k == 0 ? 1 : (int) ((k - 1) / BENCH_FANOUT) + BENCH_FIRST_ID;
+	const char *tgt = ctx->targets[k];
+
+	switch (k % 4) {
+	case 0:
+		fprintf(f, "%d %d 253:%zu / %s %s shared:%zu - ext4 /dev/disk%zu rw\n",
+				id, parent, k, tgt, vfsopts, k, k);
+		break;
+	case 1:
+		fprintf(f, "%d %d 0:%zu / %s %s,nosuid,nodev shared:%zu - tmpfs tmpfs rw,size=1024k,mode=755\n",
+				id, parent, k + 30, tgt, vfsopts, k);
+		break;
+	case 2:
+		fprintf(f, "%d %d 0:%zu / %s %s - overlay overlay rw,lowerdir=/l%zu,upperdir=/u%zu,workdir=/w%zu\n",
+				id, parent, k + 30, tgt, vfsopts, k, k, k);
+		break;
+	case 3:
+		fprintf(f, "%d %d 0:%zu / %s %s master:%zu - nfs4 srv:/export/%zu rw,vers=4.2,addr=192.0.2.1\n",
+				id, parent, k + 30, tgt, vfsopts, k, k);
+		break;
+	}
+}
+
+static FILE *gen_open(const char *path)
+{
+	FILE *f = fopen(path, "w" UL_CLOEXECSTR);
+
+	if (!f)
+		err(EXIT_FAILURE, "cannot create %s", path);
+	return f;
+}
+
+static void gen_close(FILE *f, const char *path)
+{
+	if (close_stream(f) != 0)
+		err(EXIT_FAILURE, "write failed: %s", path);
+}
+
+static void gen_files(struct bench_ctx *ctx)
+{
+	FILE *f;
+	size_t k;
+	char *p;
+
+	gen_targets(ctx);
+
+	/* mountinfo */
+	f = gen_open(ctx->mountinfo);
+	for (k = 0; k < ctx->nents; k++)
+		gen_mountinfo_entry(f, ctx, k, "rw,relatime");
+	gen_close(f, ctx->mountinfo);
+
+	/* mountinfo with 1% removed, 1% remounted and 1% new entries */
+	f = gen_open(ctx->mountinfo_new);
+	for (k = 0; k < ctx->nents; k++) {
+		if (k % 100 == 50)
+			continue;
+		gen_mountinfo_entry(f, ctx, k, k % 100 == 51 ?
+					"ro,relatime" : "rw,relatime");
+	}
+	for (k = 0; k < ctx->nents / 100; k++)
+		fprintf(f, "%zu %d 0:%zu / /new%zu rw - tmpfs tmpfs rw\n",
+				ctx->nents + k + BENCH_FIRST_ID, BENCH_FIRST_ID,
+				ctx->nents + k + 30, k);
+	gen_close(f, ctx->mountinfo_new);
+
+	/* fstab, the sources are regular files to be resolvable */
+	xasprintf(&p, "%s/dev", ctx->dir);
+	if (mkdir(p, 0755) != 0 && errno != EEXIST)
+		err(EXIT_FAILURE, "cannot create %s", p);
+	free(p);
+
+	f = gen_open(ctx->fstab);
+	fputs("# generated by test_mount_bench\n", f);
+	for (k = 0; k < ctx->nents; k++) {
+		int fd;
+
+		xasprintf(&p, "%s/dev/disk%zu", ctx->dir, k);
+		fd = open(p, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0)
+			err(EXIT_FAILURE, "cannot create %s", p);
+		close(fd);
+
+		fprintf(f, "%s %s ext4 defaults,noauto 0 2\n", p, ctx->targets[k]);
+		free(p);
+	}
+	gen_close(f, ctx->fstab);
+
+	/* utab, userspace options for 10% of the entries */
+	f = gen_open(ctx->utab);
+	for (k = 0; k < ctx->nents; k += 10)
+		fprintf(f, "ID=%zu SRC=/dev/disk%zu TARGET=%s ROOT=/ ATTRS=x-bench=%zu\n",
+				k + BENCH_FIRST_ID, k, ctx->targets[k], k);
+	gen_close(f, ctx->utab);
+}
+
+static void remove_files(struct bench_ctx *ctx)
+{
+	size_t k;
+	char *p;
+
+	for (k = 0; k < ctx->nents; k++) {
+		xasprintf(&p, "%s/dev/disk%zu", ctx->dir, k);
+		unlink(p);
+		free(p);
+	}
+	xasprintf(&p, "%s/dev", ctx->dir);
+	rmdir(p);
+	free(p);
+
+	unlink(ctx->mountinfo);
+	unlink(ctx->mountinfo_new);
+	unlink(ctx->fstab);
+	unlink(ctx->utab);
+	rmdir(ctx->dir);
+}
+
+static void init_ctx(struct bench_ctx *ctx, const char *topdir, size_t nents)
+{
+	ctx->nents = nents;
+
+	xasprintf(&ctx->dir, "%s/%zu", topdir, nents);
+	if (mkdir(ctx->dir, 0755) != 0 && errno != EEXIST)
+		err(EXIT_FAILURE, "cannot create %s", ctx->dir);
+
+	xasprintf(&ctx->mountinfo, "%s/mountinfo", ctx->dir);
+	xasprintf(&ctx->mountinfo_new, "%s/mountinfo.new", ctx->dir);
+	xasprintf(&ctx->fstab, "%s/fstab", ctx->dir);
+	xasprintf(&ctx->utab, "%s/utab", ctx->dir);
+}
+
+static void deinit_ctx(struct bench_ctx *ctx)
+{
+	size_t k;
+
+	for (k = 0; ctx->targets && k < ctx->nents; k++)
+		free(ctx->targets[k]);
+	free(ctx->targets);
+	free(ctx->dir);
+	free(ctx->mountinfo);
+	free(ctx->mountinfo_new);
+	free(ctx->fstab);
+	free(ctx->utab);
+
+	ctx->targets = NULL;
+	ctx->dir = ctx->mountinfo = ctx->mountinfo_new = NULL;
+	ctx->fstab = ctx->utab = NULL;
+}
+
+/*
+ * Tests
+ */
+static struct libmnt_table *parse_table(const char *path, int fstab)
+{
+	struct libmnt_table *tb = mnt_new_table();
+	int rc;
+
+	if (!tb)
+		err(EXIT_FAILURE, "cannot allocate table");
+	rc = fstab ? mnt_table_parse_fstab(tb, path) : mnt_table_parse_file(tb, path);
+	if (rc)
+		errx(EXIT_FAILURE, "%s: cannot parse [rc=%d]", path, rc);
+	return tb;
+}
+
+static int check_nents(struct libmnt_table *tb, size_t nents)
+{
+	if ((size_t) mnt_table_get_nents(tb) != nents) {
+		warnx("unexpected number of entries: %d (expected %zu)",
+				mnt_table_get_nents(tb), nents);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int test_parse(struct bench_ctx *ctx, const struct bench_test *ts,
+		      uint64_t *ns, size_t *nops)
+{
+	struct libmnt_table *tb = mnt_new_table();
+	uint64_t t0;
+	int rc;
+
+	if (!tb)
+		return -ENOMEM;
+
+	t0 = gettime_monotonic_nsec();
+	if (strcmp(ts->arg, "fstab") == 0)
+		rc = mnt_table_parse_fstab(tb, ctx->fstab);
+	else if (strcmp(ts->arg, "mtab") == 0)
+		/* mountinfo merged with utab ($LIBMOUNT_UTAB) */
+		rc = mnt_table_parse_mtab(tb, ctx->mountinfo);
+	else
+		rc = mnt_table_parse_file(tb, ctx->mountinfo);
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nents;
+
+	if (!rc)
+		rc = check_nents(tb, ctx->nents);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_find_target(struct bench_ctx *ctx,
+			    const struct bench_test *ts __attribute__((__unused__)),
+			    uint64_t *ns, size_t *nops)
+{
+	struct libmnt_table *tb = parse_table(ctx->mountinfo, 0);
+	uint64_t t0;
+	size_t i;
+	int rc = 0;
+
+	srandom(ctx->nents);
+
+	t0 = gettime_monotonic_nsec();
+	for (i = 0; i < ctx->nlookups; i++) {
+		const char *tgt = ctx->targets[random() % ctx->nents];
+
+		if (!mnt_table_find_target(tb, tgt, MNT_ITER_BACKWARD)) {
+			warnx("%s: not found", tgt);
+			rc = -ENOENT;
+			break;
+		}
+	}
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nlookups;
+
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static size_t walk_tree(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *chld;
+	size_t n = 1;
+
+	if (!itr)
+		err(EXIT_FAILURE, "cannot allocate iterator");
+
+	while (mnt_table_next_child_fs(tb, itr, fs, &chld) == 0)
+		n += walk_tree(tb, chld);
+
+	mnt_free_iter(itr);
+	return n;
+}
+
+static int test_tree(struct bench_ctx *ctx,
+		     const struct bench_test *ts __attribute__((__unused__)),
+		     uint64_t *ns, size_t *nops)
+{
+	struct libmnt_table *tb = parse_table(ctx->mountinfo, 0);
+	struct libmnt_fs *root;
+	uint64_t t0;
+	size_t n = 0;
+	int rc;
+
+	t0 = gettime_monotonic_nsec();
+	rc = mnt_table_get_root_fs(tb, &root);
+	if (!rc)
+		n = walk_tree(tb, root);
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nents;
+
+	if (!rc && n != ctx->nents) {
+		warnx("tree contains %zu entries (expected %zu)", n, ctx->nents);
+		rc = -EINVAL;
+	}
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_diff(struct bench_ctx *ctx,
+		     const struct bench_test *ts __attribute__((__unused__)),
+		     uint64_t *ns, size_t *nops)
+{
+	struct libmnt_table *old = parse_table(ctx->mountinfo, 0),
+			    *new = parse_table(ctx->mountinfo_new, 0);
+	struct libmnt_tabdiff *df = mnt_new_tabdiff();
+	uint64_t t0;
+	int rc;
+
+	if (!df)
+		err(EXIT_FAILURE, "cannot allocate tabdiff");
+
+	t0 = gettime_monotonic_nsec();
+	rc = mnt_diff_tables(df, old, new);
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nents;
+
+	if (rc >= 0) {
+		/* removed + remounted + new */
+		size_t expected = (ctx->nents + 49) / 100 + (ctx->nents + 48) / 100
+				  + ctx->nents / 100;
+
+		if ((size_t) rc != expected) {
+			warnx("%d changes detected (expected %zu)", rc, expected);
+			rc = -EINVAL;
+		} else
+			rc = 0;
+	}
+	mnt_free_tabdiff(df);
+	mnt_unref_table(old);
+	mnt_unref_table(new);
+	return rc;
+}
+
+static int resolve_all(struct libmnt_table *tb, struct libmnt_cache *cache)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *fs;
+	int rc = 0;
+
+	if (!itr)
+		err(EXIT_FAILURE, "cannot allocate iterator");
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		const char *spec = mnt_fs_get_source(fs);
+
+		if (!mnt_resolve_spec(spec, cache)) {
+			warnx("%s: cannot resolve", spec);
+			rc = -ENOENT;
+			break;
+		}
+	}
+	mnt_free_iter(itr);
+	return rc;
+}
+
+static int test_resolve(struct bench_ctx *ctx, const struct bench_test *ts,
+			uint64_t *ns, size_t *nops)
+{
+	struct libmnt_table *tb = parse_table(ctx->fstab, 1);
+	struct libmnt_cache *cache = mnt_new_cache();
+	uint64_t t0;
+	int rc = 0;
+
+	if (!cache)
+		err(EXIT_FAILURE, "cannot allocate cache");
+
+	/* fill the cache, then all lookups are cache hits */
+	if (strcmp(ts->arg, "cached") == 0)
+		rc = resolve_all(tb, cache);
+
+	t0 = gettime_monotonic_nsec();
+	if (!rc)
+		rc = resolve_all(tb, cache);
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nents;
+
+	mnt_unref_cache(cache);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_findmnt(struct bench_ctx *ctx, const struct bench_test *ts,
+			uint64_t *ns, size_t *nops)
+{
+	uint64_t t0;
+	pid_t pid;
+	int status;
+
+	t0 = gettime_monotonic_nsec();
+	pid = fork();
+	if (pid < 0)
+		err(EXIT_FAILURE, "fork failed");
+	if (pid == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+			_exit(EXIT_FAILURE);
+		execl(ctx->findmnt, "findmnt", "--mtab",
+			"--tab-file", ctx->mountinfo,
+			"--output", "TARGET,SOURCE,FSTYPE,OPTIONS",
+			ts->arg, (char *) NULL);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		err(EXIT_FAILURE, "waitpid failed");
+	*ns = gettime_monotonic_nsec() - t0;
+	*nops = ctx->nents;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		warnx("%s failed", ctx->findmnt);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static const struct bench_test bench_tests[] = {
+	{ "parse-mountinfo", "mnt_table_parse_file() of mountinfo",
+		test_parse, "mountinfo" },
+	{ "parse-mtab", "mnt_table_parse_mtab(), mountinfo merged with utab",
+		test_parse, "mtab" },
+	{ "parse-fstab", "mnt_table_parse_fstab()",
+		test_parse, "fstab" },
+	{ "find-target", "mnt_table_find_target() of random mountpoints",
+		test_find_target },
+	{ "tree", "mount tree walk by mnt_table_next_child_fs()",
+		test_tree },
+	{ "diff", "mnt_diff_tables() with 3% of changes",
+		test_diff },
+	{ "resolve", "mnt_resolve_spec() of fstab sources, empty cache",
+		test_resolve, "empty" },
+	{ "resolve-cached", "mnt_resolve_spec() of fstab sources, filled cache",
+		test_resolve, "cached" },
+	{ "findmnt-tree", "findmnt(8) tree output",
+		test_findmnt, "--notruncate", .need_findmnt = 1 },
+	{ "findmnt-list", "findmnt(8) list output",
+		test_findmnt, "--list", .need_findmnt = 1 },
+};
+
+static void print_result(struct ul_jsonwrt *json, size_t nents,
+			 const struct bench_test *ts, int skipped,
+			 uint64_t ns, size_t nops)
+{
+	ul_jsonwrt_object_open(json, NULL);
+	ul_jsonwrt_value_u64(json, "entries", nents);
+	ul_jsonwrt_value_s(json, "test", ts->name);
+	ul_jsonwrt_value_boolean(json, "skipped", skipped);
+	if (skipped) {
+		ul_jsonwrt_value_null(json, "ops");
+		ul_jsonwrt_value_null(json, "ns");
+		ul_jsonwrt_value_null(json, "ns_per_op");
+	} else {
+		ul_jsonwrt_value_u64(json, "ops", nops);
+		ul_jsonwrt_value_u64(json, "ns", ns);
+		ul_jsonwrt_value_double(json, "ns_per_op", nops ? (double) ns / nops : 0);
+	}
+	ul_jsonwrt_object_close(json);
+}
+
+static int name_to_test(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_tests); i++) {
+		const char *tn = bench_tests[i].name;
+
+		if (strlen(tn) == namesz && strncmp(name, tn, namesz) == 0)
+			return i;
+	}
+	warnx("unknown test: %s", name);
+	return -1;
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	size_t i;
+
+	fprintf(out, "Usage: %s [options]\n", program_invocation_short_name);
+	fputs("\nOptions:\n", out);
+	fputs(" -s, --sizes <list>       comma-separated numbers of mount entries\n"
+	      "                            (default " BENCH_DEFAULT_SIZES ")\n", out);
+	fputs(" -t, --tests <list>       comma-separated list of tests\n", out);
+	fputs(" -n, --lookups <num>      number of find-target lookups\n", out);
+	fputs(" -l, --limit <sec>        don't repeat slower tests for bigger sizes\n", out);
+	fputs(" -F, --findmnt <path>     measure also findmnt(8) output\n", out);
+	fputs(" -d, --dir <path>         keep the generated files in the directory\n", out);
+	fputs(" -g, --generate-only      generate the files and exit (requires --dir)\n", out);
+	fputs(" -h, --help               display this help\n", out);
+
+	fputs("\nTests:\n", out);
+	for (i = 0; i < ARRAY_SIZE(bench_tests); i++)
+		fprintf(out, " %-17s %s\n", bench_tests[i].name, bench_tests[i].desc);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_ctx ctx = { .nlookups = BENCH_DEFAULT_LOOKUPS };
+	struct ul_jsonwrt json;
+	const char *sizes = BENCH_DEFAULT_SIZES, *dir = NULL;
+	char *topdir = NULL, *str, *tk, *save = NULL;
+	uint64_t limit = BENCH_DEFAULT_LIMIT * 1000000000ULL;
+	int tests[ARRAY_SIZE(bench_tests)], slow[ARRAY_SIZE(bench_tests)] = { 0 };
+	int ntests = 0, generate_only = 0, c, i;
+
+	static const struct option longopts[] = {
+		{ "sizes",         required_argument, NULL, 's' },
+		{ "tests",         required_argument, NULL, 't' },
+		{ "lookups",       required_argument, NULL, 'n' },
+		{ "limit",         required_argument, NULL, 'l' },
+		{ "findmnt",       required_argument, NULL, 'F' },
+		{ "dir",           required_argument, NULL, 'd' },
+		{ "generate-only", no_argument,       NULL, 'g' },
+		{ "help",          no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((c = getopt_long(argc, argv, "s:t:n:l:F:d:gh", longopts, NULL)) != -1) {
+		switch (c) {
+		case 's':
+			sizes = optarg;
+			break;
+		case 't':
+			ntests = string_to_idarray(optarg, tests,
+					ARRAY_SIZE(tests), name_to_test);
+			if (ntests <= 0)
+				errx(EXIT_FAILURE, "invalid tests list: %s", optarg);
+			break;
+		case 'n':
+			ctx.nlookups = strtou32_or_err(optarg, "invalid lookups argument");
+			break;
+		case 'l':
+			limit = strtou32_or_err(optarg, "invalid limit argument")
+					* 1000000000ULL;
+			break;
+		case 'F':
+			ctx.findmnt = optarg;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'g':
+			generate_only = 1;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (generate_only && !dir)
+		errx(EXIT_FAILURE, "--generate-only requires --dir");
+
+	if (!ntests) {
+		for (i = 0; i < (int) ARRAY_SIZE(bench_tests); i++) {
+			if (!bench_tests[i].need_findmnt || ctx.findmnt)
+				tests[ntests++] = i;
+		}
+	}
+
+	if (dir) {
+		if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+			err(EXIT_FAILURE, "cannot create %s", dir);
+		topdir = xstrdup(dir);
+	} else {
+		const char *tmpdir = getenv("TMPDIR");
+
+		xasprintf(&topdir, "%s/mount-bench-XXXXXX",
+				tmpdir && *tmpdir ? tmpdir : "/tmp");
+		if (!mkdtemp(topdir))
+			err(EXIT_FAILURE, "cannot create temporary directory");
+	}
+
+	mnt_init_debug(0);
+
+	if (!generate_only) {
+		ul_jsonwrt_init(&json, stdout, 0);
+		ul_jsonwrt_root_open(&json);
+		ul_jsonwrt_array_open(&json, "results");
+	}
+
+	str = xstrdup(sizes);
+	for (tk = strtok_r(str, ",", &save); tk; tk = strtok_r(NULL, ",", &save)) {
+		size_t nents = strtou32_or_err(tk, "invalid size");
+
+		if (!nents)
+			errx(EXIT_FAILURE, "size must be greater than zero");
+
+		init_ctx(&ctx, topdir, nents);
+		gen_files(&ctx);
+		setenv("LIBMOUNT_UTAB", ctx.utab, 1);
+
+		for (i = 0; !generate_only && i < ntests; i++) {
+			const struct bench_test *ts = &bench_tests[tests[i]];
+			uint64_t ns = 0;
+			size_t nops = 0;
+
+			if (ts->need_findmnt && !ctx.findmnt)
+				errx(EXIT_FAILURE, "%s: requires --findmnt", ts->name);
+
+			if (!slow[i]) {
+				if (ts->run(&ctx, ts, &ns, &nops) != 0)
+					errx(EXIT_FAILURE, "%s: test failed for %zu entries",
+							ts->name, nents);
+				if (ns > limit)
+					slow[i] = 1;
+				print_result(&json, nents, ts, 0, ns, nops);
+			} else
+				print_result(&json, nents, ts, 1, 0, 0);
+		}
+
+		if (!dir)
+			remove_files(&ctx);
+		deinit_ctx(&ctx);
+	}
+	free(str);
+
+	if (!generate_only) {
+		ul_jsonwrt_array_close(&json);
+		ul_jsonwrt_root_close(&json);
+	}
+
+	if (!dir)
+		rmdir(topdir);
+	free(topdir);
+	return EXIT_SUCCESS;
+}
@@ -90,6 +90,9 @@
 /* number of lines to allocate */
 #define	NALLOC			64
 
+/* size of the input and output buffers */
+#define	IOBUFSZ			(64 * 1024)
+
 #if HAS_FEATURE_ADDRESS_SANITIZER || defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
 # define COL_DEALLOCATE_ON_EXIT
 #endif
@@ -135,6 +138,12 @@ struct col_ctl {
 	size_t max_bufd_lines;		/* max # lines to keep in memory */
 	struct col_line *line_freelist;
 	size_t nblank_lines;		/* # blanks after last flushed line */
+
+	char *ibuf;			/* input buffer */
+	size_t ibuf_pos;		/* next unread byte in ibuf */
+	size_t ibuf_len;		/* bytes in ibuf */
+	char *obuf;			/* output buffer */
+	size_t obuf_len;		/* bytes in obuf */
 #ifdef COL_DEALLOCATE_ON_EXIT
 	struct col_alloc *alloc_root;	/* first of line allocations */
 	struct col_alloc *alloc_head;	/* latest line allocation */
@@ -144,7 +153,8 @@ struct col_ctl {
 		compress_spaces:1,	/* if doing space -> tab conversion */
 		fine:1,			/* if `fine' resolution (half lines) */
 		no_backspaces:1,	/* if not to output any backspaces */
-		pass_unknown_seqs:1;	/* whether to pass unknown control sequences */
+		pass_unknown_seqs:1,	/* whether to pass unknown control sequences */
+		input_eof:1;		/* no more data in stdin */
 };
 
 struct col_lines {
@@ -189,10 +199,110 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
-static inline void col_putchar(wchar_t ch)
+/*
+ * The input is read by read(2) to a large buffer and decoded here rather
+ * than by getwchar(), the wide-character stdio is very slow. Returns WEOF
+ * and sets errno to EILSEQ for invalid multibyte sequences; the byte is
+ * not consumed, use col_getchar() to read it.
+ */
+static int fill_input(struct col_ctl *ctl)
+{
+	ssize_t rc;
+
+	if (ctl->input_eof)
+		return 0;
+	if (ctl->ibuf_pos) {
+		ctl->ibuf_len -= ctl->ibuf_pos;
+		memmove(ctl->ibuf, ctl->ibuf + ctl->ibuf_pos, ctl->ibuf_len);
+		ctl->ibuf_pos = 0;
+	}
+	do {
+		rc = read(STDIN_FILENO, ctl->ibuf + ctl->ibuf_len,
+			  IOBUFSZ - ctl->ibuf_len);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc <= 0) {
+		ctl->input_eof = 1;
+		return 0;
+	}
+	ctl->ibuf_len += rc;
+	return 1;
+}
+
+static wint_t col_getwchar(struct col_ctl *ctl)
+{
+	do {
+		const char *p = ctl->ibuf + ctl->ibuf_pos;
+		size_t len = ctl->ibuf_len - ctl->ibuf_pos;
+#ifdef HAVE_WIDECHAR
+		mbstate_t st;
+		wchar_t wc;
+		size_t n;
+
+		if (!len)
+			continue;
+		if (!(*p & 0x80)) {
+			ctl->ibuf_pos++;
+			return *p;
+		}
+		memset(&st, 0, sizeof(st));
+		n = mbrtowc(&wc, p, len, &st);
+		if (n == (size_t) -1) {
+			errno = EILSEQ;
+			return WEOF;
+		}
+		if (n == (size_t) -2)
+			continue;	/* incomplete, read more */
+		ctl->ibuf_pos += n;
+		return wc;
+#else
+		if (len) {
+			ctl->ibuf_pos++;
+			return (unsigned char) *p;
+		}
+#endif
+	} while (fill_input(ctl));
+
+	/* EOF, or incomplete sequence at the end of the input */
+	errno = 0;
+	return WEOF;
+}
+
+static int col_getchar(struct col_ctl *ctl)
 {
-	if (putwchar(ch) == WEOF)
+	if (ctl->ibuf_pos == ctl->ibuf_len && !fill_input(ctl))
+		return EOF;
+	return (unsigned char) ctl->ibuf[ctl->ibuf_pos++];
+}
+
+static void flush_output(struct col_ctl *ctl)
+{
+	if (ctl->obuf_len && fwrite(ctl->obuf, 1, ctl->obuf_len, stdout) != ctl->obuf_len)
 		err(EXIT_FAILURE, _("write failed"));
+	ctl->obuf_len = 0;
+}
+
+static inline void col_putchar(struct col_ctl *ctl, wchar_t ch)
+{
+	if (IOBUFSZ - ctl->obuf_len < MB_LEN_MAX)
+		flush_output(ctl);
+
+	if (!(ch & ~0x7f))
+		ctl->obuf[ctl->obuf_len++] = ch;
+	else {
+#ifdef HAVE_WIDECHAR
+		mbstate_t st;
+		size_t n;
+
+		memset(&st, 0, sizeof(st));
+		n = wcrtomb(ctl->obuf + ctl->obuf_len, ch, &st);
+		if (n == (size_t) -1)
+			err(EXIT_FAILURE, _("write failed"));
+		ctl->obuf_len += n;
+#else
+		ctl->obuf[ctl->obuf_len++] = ch;
+#endif
+	}
 }
 
 /*
@@ -213,13 +323,13 @@ static void flush_blanks(struct col_ctl *ctl)
 	}
 	nb /= 2;
 	for (i = nb; --i >= 0;)
-		col_putchar(NL);
+		col_putchar(ctl, NL);
 
 	if (half) {
-		col_putchar(ESC);
-		col_putchar('9');
+		col_putchar(ctl, ESC);
+		col_putchar(ctl, '9');
 		if (!nb)
-			col_putchar(CR);
+			col_putchar(ctl, CR);
 	}
 	ctl->nblank_lines = 0;
 }
@@ -297,11 +407,11 @@ static void flush_line(struct col_ctl *ctl, struct col_line *l)
 				if (0 < ntabs) {
 					nspace = this_col & 7;
 					while (0 <= --ntabs)
-						col_putchar(TAB);
+						col_putchar(ctl, TAB);
 				}
 			}
 			while (0 <= --nspace)
-				col_putchar(SPACE);
+				col_putchar(ctl, SPACE);
 			last_col = this_col;
 		}
 
@@ -310,10 +420,10 @@ static void flush_line(struct col_ctl *ctl, struct col_line *l)
 			if (c->c_set != ctl->last_set) {
 				switch (c->c_set) {
 				case CS_NORMAL:
-					col_putchar(SI);
+					col_putchar(ctl, SI);
 					break;
 				case CS_ALTERNATE:
-					col_putchar(SO);
+					col_putchar(ctl, SO);
 					break;
 				default:
 					abort();
@@ -322,14 +432,14 @@ static void flush_line(struct col_ctl *ctl, struct col_line *l)
 			}
 
 			/* output a character */
-			col_putchar(c->c_char);
+			col_putchar(ctl, c->c_char);
 
 			/* rubout control chars from output */
 			if (c + 1 < endc) {
 				int i;
 
 				for (i = 0; i < c->c_width; i++)
-					col_putchar(BS);
+					col_putchar(ctl, BS);
 			}
 
 			if (endc <= ++c)
@@ -342,10 +452,11 @@ static void flush_line(struct col_ctl *ctl, struct col_line *l)
 static struct col_line *alloc_line(struct col_ctl *ctl)
 {
 	struct col_line *l;
-	size_t i;
+	struct col_char *line;
+	size_t i, lsize;
 
 	if (!ctl->line_freelist) {
-		l = xmalloc(sizeof(struct col_line) * NALLOC);
+		l = xcalloc(NALLOC, sizeof(struct col_line));
 #ifdef COL_DEALLOCATE_ON_EXIT
 		if (ctl->alloc_root == NULL) {
 			ctl->alloc_root = xcalloc(1, sizeof(struct col_alloc));
@@ -365,7 +476,12 @@ static struct col_line *alloc_line(struct col_ctl *ctl)
 	l = ctl->line_freelist;
 	ctl->line_freelist = l->l_next;
 
+	/* keep the characters buffer of the previously used line */
+	line = l->l_line;
+	lsize = l->l_lsize;
 	memset(l, 0, sizeof(struct col_line));
+	l->l_line = line;
+	l->l_lsize = lsize;
 	return l;
 }
 
@@ -382,12 +498,11 @@ static void flush_lines(struct col_ctl *ctl, ssize_t nflush)
 	while (0 <= --nflush) {
 		l = ctl->lines;
 		ctl->lines = l->l_next;
-		if (l->l_line) {
+		if (l->l_line_len) {
 			flush_blanks(ctl);
 			flush_line(ctl, l);
 		}
 		ctl->nblank_lines++;
-		free(l->l_line);
 		free_line(ctl, l);
 	}
 	if (ctl->lines)
@@ -409,7 +524,7 @@ static int handle_not_graphic(struct col_ctl *ctl, struct col_lines *lns)
 		lns->cur_col = 0;
 		return 1;
 	case ESC:
-		switch (getwchar()) {	/* just ignore EOF */
+		switch (col_getwchar(ctl)) {	/* just ignore EOF */
 		case RLF:
 			lns->cur_line -= 2;
 			break;
@@ -592,7 +707,11 @@ static void free_line_allocations(struct col_alloc *root)
 	struct col_alloc *next;
 
 	while (root) {
+		size_t i;
+
 		next = root->next;
+		for (i = 0; i < NALLOC; i++)
+			free(root->l[i].l_line);
 		free(root->l);
 		free(root);
 		root = next;
@@ -602,8 +721,10 @@ static void free_line_allocations(struct col_alloc *root)
 
 static void process_char(struct col_ctl *ctl, struct col_lines *lns)
 {
+                int ascii = ' ' < lns->ch && lns->ch < 0x7f;
+
                 /* Deal printable characters */
-                if (!iswgraph(lns->ch) && handle_not_graphic(ctl, lns))
+                if (!ascii && !iswgraph(lns->ch) && handle_not_graphic(ctl, lns))
                         return;
 
                 /* Must stuff ch in a line - are we at the right one? */
@@ -628,7 +749,7 @@ static void process_char(struct col_ctl *ctl, struct col_lines *lns)
                         lns->c->c_column = lns->cur_col;
                 else
                         lns->c->c_column = 0;
-                lns->c->c_width = wcwidth(lns->ch);
+                lns->c->c_width = ascii ? 1 : wcwidth(lns->ch);
 
                 /*
                  * If things are put in out of order, they will need sorting
@@ -664,10 +785,12 @@ int main(int argc, char **argv)
 
 	parse_options(&ctl, argc, argv);
 
-	while (feof(stdin) == 0) {
-		errno = 0;
+	ctl.ibuf = xmalloc(IOBUFSZ);
+	ctl.obuf = xmalloc(IOBUFSZ);
+
+	for (;;) {
 		/* Get character */
-		lns.ch = getwchar();
+		lns.ch = col_getwchar(&ctl);
 
 		if (lns.ch == WEOF) {
 			if (errno == EILSEQ) {
@@ -676,7 +799,7 @@ int main(int argc, char **argv)
 				char buf[5];
 				size_t len, i;
 
-				c = getchar();
+				c = col_getchar(&ctl);
 				if (c == EOF)
 					break;
 				sprintf(buf, "\\x%02x", (unsigned char) c);
@@ -697,8 +820,11 @@ int main(int argc, char **argv)
 	for (; ctl.l->l_next; ctl.l = ctl.l->l_next)
 		lns.this_line++;
 	if (lns.max_line == 0 && lns.cur_col == 0) {
+		flush_output(&ctl);
 #ifdef COL_DEALLOCATE_ON_EXIT
 		free_line_allocations(ctl.alloc_root);
+		free(ctl.ibuf);
+		free(ctl.obuf);
 #endif
 		return EXIT_SUCCESS;	/* no lines, so just exit */
 	}
@@ -706,7 +832,7 @@ int main(int argc, char **argv)
 
 	/* make sure we leave things in a sane state */
 	if (ctl.last_set != CS_NORMAL)
-		col_putchar(SI);
+		col_putchar(&ctl, SI);
 
 	/* flush out the last few blank lines */
 	ctl.nblank_lines = lns.max_line - lns.this_line;
@@ -716,8 +842,11 @@ int main(int argc, char **argv)
 		/* missing a \n on the last line? */
 		ctl.nblank_lines = 2;
 	flush_blanks(&ctl);
+	flush_output(&ctl);
 #ifdef COL_DEALLOCATE_ON_EXIT
 	free_line_allocations(ctl.alloc_root);
+	free(ctl.ibuf);
+	free(ctl.obuf);
 #endif
 	return ret;
 }
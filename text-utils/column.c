@@ -58,6 +58,9 @@
 
 #define TABCHAR_CELLS         8
 
+/* default number of lines used to calculate column widths for --table-stream */
+#define STREAM_NLINES_DEFAULT	1000
+
 enum {
 	COLUMN_MODE_FILLCOLS = 0,
 	COLUMN_MODE_FILLROWS,
@@ -88,8 +91,12 @@ struct column_control {
 	const char *tree_parent;
 
 	wchar_t *input_separator;
+	char *input_separator_ascii;	/* the same, NULL if not ASCII */
 	const char *output_separator;
 
+	size_t	stream_nlines;	/* --table-stream lines for widths calculation */
+	struct libscols_column **stream_cols;	/* columns in input order */
+
 	wchar_t	**ents;		/* input entries */
 	size_t	nents;		/* number of entries */
 	size_t	maxlength;	/* longest input record (line) */
@@ -101,7 +108,9 @@ struct column_control {
 		     hide_unnamed :1,
 		     maxout : 1,
 		     keep_empty_lines :1,	/* --keep-empty-lines */
-		     tab_noheadings :1;
+		     tab_noheadings :1,
+		     stream :1,			/* --table-stream */
+		     tab_modified :1;		/* modify_table() already called */
 };
 
 typedef enum {
@@ -277,6 +286,57 @@ static wchar_t *local_wcstok(struct column_control const *const ctl, wchar_t *p,
 	return result;
 }
 
+#ifdef HAVE_WIDECHAR
+/* The same as local_wcstok(), used for ASCII input */
+static char *local_strtok(struct column_control const *const ctl, char *p,
+			  char **state)
+{
+	char *result = NULL;
+
+	if (ctl->greedy)
+		return strtok_r(p, ctl->input_separator_ascii, state);
+	if (!p) {
+		if (!*state)
+			return NULL;
+		p = *state;
+	}
+	result = p;
+	p = strpbrk(result, ctl->input_separator_ascii);
+	if (!p)
+		*state = NULL;
+	else {
+		*p = '\0';
+		*state = p + 1;
+	}
+	return result;
+}
+
+static int is_ascii(const char *str)
+{
+	for (; *str; str++) {
+		if ((unsigned char) *str >= 0x80)
+			return 0;
+	}
+	return 1;
+}
+
+static char *wcs_to_ascii(const wchar_t *wcs)
+{
+	size_t i, len = wcslen(wcs);
+	char *str = xmalloc(len + 1);
+
+	for (i = 0; i < len; i++) {
+		if ((unsigned long) wcs[i] >= 0x80) {
+			free(str);
+			return NULL;
+		}
+		str[i] = (char) wcs[i];
+	}
+	str[len] = '\0';
+	return str;
+}
+#endif /* HAVE_WIDECHAR */
+
 static char **split_or_error(const char *str, const char *errmsg)
 {
 	char **res = strv_split(str, ",");
@@ -332,6 +392,10 @@ static void init_table(struct column_control *ctl)
 		scols_table_enable_noheadings(ctl->tab, !!ctl->tab_noheadings);
 	}
 
+	if (ctl->stream) {
+		scols_table_enable_streaming(ctl->tab, 1);
+		scols_table_set_streaming_lines(ctl->tab, ctl->stream_nlines);
+	}
 }
 
 static struct libscols_column *get_last_visible_column(struct column_control *ctl, int n)
@@ -591,6 +655,66 @@ static void modify_table(struct column_control *ctl)
 	/* This must be the last step! */
 	if (ctl->tab_order)
 		reorder_table(ctl);
+
+	ctl->tab_modified = 1;
+}
+
+/*
+ * Streaming mode -- the table is modified before libsmartcols starts to
+ * print lines. It happens when the next line is added and the table already
+ * contains --table-stream lines (or any line for JSON). The number of the
+ * columns cannot be changed after that, the rest of the line is used for the
+ * last column.
+ */
+static void prepare_table_stream(struct column_control *ctl)
+{
+	size_t nlines, ncols, i;
+
+	if (!ctl->stream || ctl->tab_modified)
+		return;
+
+	nlines = scols_table_get_nlines(ctl->tab);
+	if (!nlines || (!ctl->json && nlines < ctl->stream_nlines))
+		return;
+
+	/* --table-order moves the columns, but the input is still in the
+	 * original order */
+	ncols = scols_table_get_ncols(ctl->tab);
+	if (!ncols)
+		return;
+	ctl->stream_cols = xcalloc(ncols, sizeof(struct libscols_column *));
+	for (i = 0; i < ncols; i++)
+		ctl->stream_cols[i] = scols_table_get_column(ctl->tab, i);
+
+	modify_table(ctl);
+	if (!ctl->maxncols || ctl->maxncols > ncols)
+		ctl->maxncols = ncols;
+}
+
+static void add_cell_to_table(struct column_control *ctl,
+			      struct libscols_line **ln, size_t n, char *data)
+{
+	if (scols_table_get_ncols(ctl->tab) < n + 1) {
+		if (scols_table_is_json(ctl->tab) && !ctl->hide_unnamed)
+			errx(EXIT_FAILURE, _("line %zu: for JSON the name of the "
+				"column %zu is required"),
+				scols_table_get_nlines(ctl->tab) + 1,
+				n + 1);
+		scols_table_new_column(ctl->tab, NULL, 0,
+				ctl->hide_unnamed ? SCOLS_FL_HIDDEN : 0);
+	}
+	if (!*ln) {
+		*ln = scols_table_new_line(ctl->tab, NULL);
+		if (!*ln)
+			err(EXIT_FAILURE, _("failed to allocate output line"));
+	}
+
+	if (!data)
+		err(EXIT_FAILURE, _("failed to allocate output data"));
+	if (ctl->stream_cols ?
+	    scols_line_refer_column_data(*ln, ctl->stream_cols[n], data) :
+	    scols_line_refer_data(*ln, n, data))
+		err(EXIT_FAILURE, _("failed to add output data"));
 }
 
 
@@ -603,6 +727,7 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 
 	if (!ctl->tab)
 		init_table(ctl);
+	prepare_table_stream(ctl);
 
 	if (ctl->maxncols) {
 		all = wcsdup(wcs0);
@@ -611,7 +736,6 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 	}
 
 	do {
-		char *data;
 		wchar_t *wcdata = local_wcstok(ctl, wcs, &sv);
 
 		if (!wcdata)
@@ -623,28 +747,47 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 			wcdata = all + skip;
 		}
 
-		if (scols_table_get_ncols(ctl->tab) < n + 1) {
-			if (scols_table_is_json(ctl->tab) && !ctl->hide_unnamed)
-				errx(EXIT_FAILURE, _("line %zu: for JSON the name of the "
-					"column %zu is required"),
-					scols_table_get_nlines(ctl->tab) + 1,
-					n + 1);
-			scols_table_new_column(ctl->tab, NULL, 0,
-					ctl->hide_unnamed ? SCOLS_FL_HIDDEN : 0);
-		}
-		if (!ln) {
-			ln = scols_table_new_line(ctl->tab, NULL);
-			if (!ln)
-				err(EXIT_FAILURE, _("failed to allocate output line"));
-		}
+		add_cell_to_table(ctl, &ln, n, wcs_to_mbs(wcdata));
+		n++;
+		wcs = NULL;
+		if (ctl->maxncols && n == ctl->maxncols)
+			break;
+	} while (1);
+
+	free(all);
+	return 0;
+}
+
+#ifdef HAVE_WIDECHAR
+/* The same as add_line_to_table(), but without the wide-char conversion */
+static int add_ascii_line_to_table(struct column_control *ctl, char *str0)
+{
+	char *sv = NULL, *str = str0, *all = NULL;
+	size_t n = 0;
+	struct libscols_line *ln = NULL;
+
+	if (!ctl->tab)
+		init_table(ctl);
+	prepare_table_stream(ctl);
+
+	if (ctl->maxncols)
+		all = xstrdup(str0);
+
+	do {
+		char *data = local_strtok(ctl, str, &sv);
 
-		data = wcs_to_mbs(wcdata);
 		if (!data)
-			err(EXIT_FAILURE, _("failed to allocate output data"));
-		if (scols_line_refer_data(ln, n, data))
-			err(EXIT_FAILURE, _("failed to add output data"));
+			break;
+
+		if (ctl->maxncols && n + 1 == ctl->maxncols) {
+			/* Use rest of the string as column data */
+			size_t skip = data - str0;
+			data = all + skip;
+		}
+
+		add_cell_to_table(ctl, &ln, n, xstrdup(data));
 		n++;
-		wcs = NULL;
+		str = NULL;
 		if (ctl->maxncols && n == ctl->maxncols)
 			break;
 	} while (1);
@@ -652,11 +795,13 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 	free(all);
 	return 0;
 }
+#endif /* HAVE_WIDECHAR */
 
 static int add_emptyline_to_table(struct column_control *ctl)
 {
 	if (!ctl->tab)
 		init_table(ctl);
+	prepare_table_stream(ctl);
 
 	if (!scols_table_new_line(ctl->tab, NULL))
 		err(EXIT_FAILURE, _("failed to allocate output line"));
@@ -712,6 +857,13 @@ static int read_input(struct column_control *ctl, FILE *fp)
 			continue;
 		}
 
+#ifdef HAVE_WIDECHAR
+		if (ctl->mode == COLUMN_MODE_TABLE && ctl->input_separator_ascii
+		    && is_ascii(buf)) {
+			rc = add_ascii_line_to_table(ctl, buf);
+			continue;
+		}
+#endif
 		wcs = mbs_to_wcs(buf);
 		if (!wcs) {
 			/*
@@ -845,6 +997,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -R, --table-right <columns>      right align text in these columns\n"), out);
 	fputs(_(" -T, --table-truncate <columns>   truncate text in the columns when necessary\n"), out);
 	fputs(_(" -W, --table-wrap <columns>       wrap text in the columns when necessary\n"), out);
+	fputs(_(" -S, --table-stream[=<lines>]     print the table continuously, widths from the first lines\n"), out);
 	fputs(_(" -L, --keep-empty-lines           don't ignore empty lines\n"), out);
 	fputs(_(" -J, --json                       use JSON output format for table\n"), out);
 
@@ -899,6 +1052,7 @@ int main(int argc, char **argv)
 		{ "table-noheadings",    no_argument,       NULL, 'd' },
 		{ "table-order",         required_argument, NULL, 'O' },
 		{ "table-right",         required_argument, NULL, 'R' },
+		{ "table-stream",        optional_argument, NULL, 'S' },
 		{ "table-truncate",      required_argument, NULL, 'T' },
 		{ "table-wrap",          required_argument, NULL, 'W' },
 		{ "table-empty-lines",   no_argument,       NULL, 'L' }, /* deprecated */
@@ -912,6 +1066,8 @@ int main(int argc, char **argv)
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'C','N' },
 		{ 'J','x' },
+		{ 'S','r' },
+		{ 'S','x' },
 		{ 't','x' },
 		{ 0 }
 	};
@@ -925,7 +1081,7 @@ int main(int argc, char **argv)
 	ctl.output_separator = "  ";
 	ctl.input_separator = mbs_to_wcs("\t ");
 
-	while ((c = getopt_long(argc, argv, "C:c:dE:eH:hi:Jl:LN:n:mO:o:p:R:r:s:T:tVW:x", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "C:c:dE:eH:hi:Jl:LN:n:mO:o:p:R:r:S::s:T:tVW:x", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -992,6 +1148,16 @@ int main(int argc, char **argv)
 		case 'r':
 			ctl.tree = optarg;
 			break;
+		case 'S':
+			ctl.stream = 1;
+			ctl.mode = COLUMN_MODE_TABLE;
+			ctl.stream_nlines = STREAM_NLINES_DEFAULT;
+			if (optarg) {
+				ctl.stream_nlines = strtou32_or_err(optarg, _("invalid --table-stream argument"));
+				if (!ctl.stream_nlines)
+					errx(EXIT_FAILURE, _("invalid --table-stream argument"));
+			}
+			break;
 		case 's':
 			free(ctl.input_separator);
 			ctl.input_separator = mbs_to_wcs(optarg);
@@ -1042,6 +1208,11 @@ int main(int argc, char **argv)
 	if (!ctl.tab_colnames && !ctl.tab_columns && ctl.json)
 		errx(EXIT_FAILURE, _("option --table-columns or --table-column required for --json"));
 
+#ifdef HAVE_WIDECHAR
+	/* ASCII input lines are split without conversion to wide chars */
+	ctl.input_separator_ascii = wcs_to_ascii(ctl.input_separator);
+#endif
+
 	if (!*argv)
 		eval += read_input(&ctl, stdin);
 	else
@@ -1066,11 +1237,13 @@ int main(int argc, char **argv)
 
 	switch (ctl.mode) {
 	case COLUMN_MODE_TABLE:
-		if (ctl.tab && scols_table_get_nlines(ctl.tab)) {
-			modify_table(&ctl);
+		if (ctl.tab && (scols_table_get_nlines(ctl.tab) || ctl.tab_modified)) {
+			if (!ctl.tab_modified)
+				modify_table(&ctl);
 			eval = scols_print_table(ctl.tab);
 
 			scols_unref_table(ctl.tab);
+			free(ctl.stream_cols);
 			if (ctl.tab_colnames)
 				strv_free(ctl.tab_colnames);
 			if (ctl.tab_columns)
@@ -1089,6 +1262,7 @@ int main(int argc, char **argv)
 	}
 
 	free(ctl.input_separator);
+	free(ctl.input_separator_ascii);
 
 	return eval == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -48,6 +48,12 @@
 
 static void doskip(const char *, int, struct hexdump *);
 static u_char *get(struct hexdump *);
+static void flush_output(void);
+
+/* input stream buffer size */
+#define HEXDUMP_INBUFSZ		(256 * 1024)
+/* output buffer size used by the fast path */
+#define HEXDUMP_OUTBUFSZ	(64 * 1024)
 
 enum _vflag vflag = FIRST;
 
@@ -237,6 +243,288 @@ static void bpad(struct hexdump_pr *pr)
 		;
 }
 
+/*
+ * Fast path -- the common conversions (text, %_a, %_p, %c and %[ouxX]
+ * with width, precision and '0' or '-' flags) are precompiled and
+ * formatted to the output buffer without printf(). Everything else (and
+ * colors and the last partial block) is printed by print().
+ */
+static char *outbuf;
+static size_t outsz;
+
+static unsigned char printable[256];
+
+static void flush_output(void)
+{
+	if (outsz) {
+		fwrite(outbuf, 1, outsz, stdout);
+		outsz = 0;
+	}
+}
+
+/* Returns 1 if the print unit is usable for the fast path. */
+static int compile_pr(struct hexdump_pr *pr)
+{
+	const char *p;
+	char *end;
+
+	if (pr->colorlist)
+		return 0;
+
+	switch (pr->flags) {
+	case F_TEXT:
+		pr->txtsz = pr->maxsz = strlen(pr->fmt);
+		return 1;
+	case F_UINT:
+		if (pr->bcnt != 1 && pr->bcnt != 2 && pr->bcnt != 4 && pr->bcnt != 8)
+			return 0;
+		break;
+	case F_ADDRESS:
+	case F_CHAR:
+	case F_P:
+		break;
+	default:
+		return 0;
+	}
+
+	p = strchr(pr->fmt, '%');
+	if (!p)
+		return 0;
+	pr->txtsz = p - pr->fmt;
+	pr->width = pr->prec = -1;
+
+	for (p++; *p == '0' || *p == '-'; p++) {
+		if (*p == '0')
+			pr->zeropad = 1;
+		else
+			pr->leftadj = 1;
+	}
+	if (isdigit(*p)) {
+		pr->width = strtol(p, &end, 10);
+		p = end;
+	}
+	if (*p == '.') {
+		pr->prec = strtol(p + 1, &end, 10);
+		p = end;
+	}
+	if (pr->width > 256 || pr->prec > 256)
+		return 0;
+
+	if (pr->flags == F_CHAR || pr->flags == F_P) {
+		if (strcmp(p, "c") != 0 || pr->zeropad || pr->prec >= 0)
+			return 0;
+		pr->maxsz = pr->txtsz + max(pr->width, 1);
+		return 1;
+	}
+
+	if (strncmp(p, "ll", 2) != 0 || p[2] == '\0' || p[3] != '\0')
+		return 0;
+	switch (p[2]) {
+	case 'o':
+		pr->base = 8;
+		break;
+	case 'u':
+		pr->base = 10;
+		break;
+	case 'X':
+		pr->upper = 1;
+		/* fallthrough */
+	case 'x':
+		pr->base = 16;
+		break;
+	case 'd':
+		/* the address is never negative */
+		if (pr->flags == F_ADDRESS) {
+			pr->base = 10;
+			break;
+		}
+		/* fallthrough */
+	default:
+		return 0;
+	}
+	if (pr->leftadj)
+		pr->zeropad = 0;
+
+	/* 22 is the number of octal digits of UINT64_MAX */
+	pr->maxsz = pr->txtsz + max(pr->width, 0) + max(pr->prec, 0) + 22;
+	return 1;
+}
+
+static void compile_fs(struct hexdump *hex)
+{
+	struct list_head *p, *q, *r;
+	size_t i;
+
+	list_for_each(p, &hex->fshead) {
+		struct hexdump_fs *fs = list_entry(p, struct hexdump_fs, fslist);
+
+		fs->fast = 1;
+		list_for_each(q, &fs->fulist) {
+			struct hexdump_fu *fu = list_entry(q, struct hexdump_fu, fulist);
+
+			if (fu->flags & F_IGNORE)
+				break;
+			list_for_each(r, &fu->prlist) {
+				struct hexdump_pr *pr = list_entry(r, struct hexdump_pr, prlist);
+
+				if (!compile_pr(pr))
+					fs->fast = 0;
+			}
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(printable); i++)
+		printable[i] = isprint(i) ? i : '.';
+
+	outbuf = xmalloc(HEXDUMP_OUTBUFSZ);
+}
+
+static char *put_padding(char *o, int c, size_t n)
+{
+	memset(o, c, n);
+	return o + n;
+}
+
+static char *put_uint(char *o, struct hexdump_pr *pr, unsigned long long val)
+{
+	static const char lower[] = "0123456789abcdef",
+			  upper[] = "0123456789ABCDEF";
+	const char *digits = pr->upper ? upper : lower;
+	char tmp[24], *t = tmp + sizeof(tmp);
+	size_t n, zeros = 0, pad = 0;
+
+	/* printf("%.0x", 0) prints nothing */
+	if (val || pr->prec != 0) {
+		switch (pr->base) {
+		case 16:
+			do {
+				*--t = digits[val & 0xf];
+				val >>= 4;
+			} while (val);
+			break;
+		case 8:
+			do {
+				*--t = digits[val & 0x7];
+				val >>= 3;
+			} while (val);
+			break;
+		default:
+			do {
+				*--t = digits[val % 10];
+				val /= 10;
+			} while (val);
+			break;
+		}
+	}
+	n = tmp + sizeof(tmp) - t;
+
+	if (pr->prec > 0 && (size_t) pr->prec > n)
+		zeros = pr->prec - n;
+	if (pr->width > 0 && (size_t) pr->width > n + zeros)
+		pad = pr->width - n - zeros;
+
+	if (pad && !pr->leftadj) {
+		if (pr->zeropad && pr->prec < 0)
+			zeros += pad;
+		else
+			o = put_padding(o, ' ', pad);
+		pad = 0;
+	}
+	o = put_padding(o, '0', zeros);
+	memcpy(o, t, n);
+	o += n;
+	return put_padding(o, ' ', pad);
+}
+
+static char *put_char(char *o, struct hexdump_pr *pr, int c)
+{
+	size_t pad = pr->width > 1 ? pr->width - 1 : 0;
+
+	if (!pr->leftadj)
+		o = put_padding(o, ' ', pad);
+	*o++ = c;
+	if (pr->leftadj)
+		o = put_padding(o, ' ', pad);
+	return o;
+}
+
+static void display_fast(struct hexdump_fs *fs, unsigned char *bp)
+{
+	struct list_head *q, *r;
+	off_t addr = address;
+
+	list_for_each(q, &fs->fulist) {
+		struct hexdump_fu *fu = list_entry(q, struct hexdump_fu, fulist);
+		int cnt;
+
+		if (fu->flags & F_IGNORE)
+			break;
+
+		for (cnt = fu->reps; cnt; cnt--) {
+			list_for_each(r, &fu->prlist) {
+				struct hexdump_pr *pr = list_entry(r, struct hexdump_pr, prlist);
+				char *o;
+
+				if (HEXDUMP_OUTBUFSZ - outsz < pr->maxsz)
+					flush_output();
+				o = outbuf + outsz;
+
+				if (pr->flags == F_TEXT) {
+					size_t sz = cnt == 1 && pr->nospace ?
+						(size_t) (pr->nospace - pr->fmt) : pr->txtsz;
+					memcpy(o, pr->fmt, sz);
+					outsz += sz;
+					goto next;
+				}
+
+				memcpy(o, pr->fmt, pr->txtsz);
+				o += pr->txtsz;
+
+				switch (pr->flags) {
+				case F_ADDRESS:
+					o = put_uint(o, pr, addr);
+					break;
+				case F_CHAR:
+					o = put_char(o, pr, *bp);
+					break;
+				case F_P:
+					o = put_char(o, pr, printable[*bp]);
+					break;
+				case F_UINT:
+				    {
+					uint16_t sval;
+					uint32_t ival;
+					uint64_t Lval;
+
+					switch (pr->bcnt) {
+					case 1:
+						o = put_uint(o, pr, *bp);
+						break;
+					case 2:
+						memcpy(&sval, bp, sizeof(sval));
+						o = put_uint(o, pr, sval);
+						break;
+					case 4:
+						memcpy(&ival, bp, sizeof(ival));
+						o = put_uint(o, pr, ival);
+						break;
+					case 8:
+						memcpy(&Lval, bp, sizeof(Lval));
+						o = put_uint(o, pr, Lval);
+						break;
+					}
+					break;
+				    }
+				}
+				outsz = o - outbuf;
+next:
+				addr += pr->bcnt;
+				bp += pr->bcnt;
+			}
+		}
+	}
+}
+
 void display(struct hexdump *hex)
 {
 	register struct list_head *fs;
@@ -249,12 +537,21 @@ void display(struct hexdump *hex)
 	unsigned char savech = 0, *savebp;
 	struct list_head *p, *q, *r;
 
+	compile_fs(hex);
+
 	while ((bp = get(hex)) != NULL) {
 		fs = &hex->fshead; savebp = bp; saveaddress = address;
 
 		list_for_each(p, fs) {
 			fss = list_entry(p, struct hexdump_fs, fslist);
 
+			/* eaddress is set for the last (padded) block only */
+			if (fss->fast && !eaddress) {
+				display_fast(fss, bp);
+				continue;
+			}
+			flush_output();
+
 			list_for_each(q, &fss->fulist) {
 				fu = list_entry(q, struct hexdump_fu, fulist);
 
@@ -289,6 +586,10 @@ void display(struct hexdump *hex)
 			address = saveaddress;
 		}
 	}
+	flush_output();
+	free(outbuf);
+	outbuf = NULL;
+
 	if (endfu) {
 		/*
 		 * if eaddress not set, error or file size was multiple of
@@ -353,8 +654,10 @@ get(struct hexdump *hex)
 				goto retnul;
 			if (!need && vflag != ALL &&
 			    !memcmp(curp, savp, nread)) {
-				if (vflag != DUP)
+				if (vflag != DUP) {
+					flush_output();
 					printf("*\n");
+				}
 				goto retnul;
 			}
 			if (need > 0)
@@ -384,8 +687,10 @@ get(struct hexdump *hex)
 					vflag = WAIT;
 				return(curp);
 			}
-			if (vflag == WAIT)
+			if (vflag == WAIT) {
+				flush_output();
 				printf("*\n");
+			}
 			vflag = DUP;
 			address += hex->blocksize;
 			need = hex->blocksize;
@@ -423,6 +728,9 @@ int next(char **argv, struct hexdump *hex)
 				return(0);
 			statok = 0;
 		}
+		/* fileno() is -1 if all the file arguments failed */
+		if (fileno(stdin) >= 0)
+			setvbuf(stdin, NULL, _IOFBF, HEXDUMP_INBUFSZ);
 		if (hex->skip)
 			doskip(statok ? *_argv : "stdin", statok, hex);
 		if (*_argv)
@@ -67,6 +67,16 @@ struct hexdump_pr {
 	struct list_head *colorlist;	/* color settings */
 	char *fmt;			/* printf format */
 	char *nospace;			/* no whitespace version */
+
+	/* precompiled conversion, see compile_pr() */
+	size_t txtsz;			/* text before the conversion */
+	size_t maxsz;			/* max output size */
+	int width;			/* field width or -1 */
+	int prec;			/* precision or -1 */
+	unsigned int base :5,		/* 8, 10 or 16 */
+		     upper :1,		/* upper case hex digits */
+		     zeropad :1,	/* '0' flag */
+		     leftadj :1;	/* '-' flag */
 };
 
 struct hexdump_fu {
@@ -84,6 +94,7 @@ struct hexdump_fs {			/* format strings */
 	struct list_head fslist;		/* linked list of format strings */
 	struct list_head fulist;		/* linked list of format units */
 	int bcnt;
+	unsigned int fast :1;		/* all print units precompiled */
 };
 
 struct hexdump {
@@ -106,6 +106,8 @@
 #define INIT_BUF	80
 #define COMMAND_BUF	200
 #define REGERR_BUF	NUM_COLUMNS
+#define LINE_INDEX_STEP	256	/* lines between line_index entries */
+#define LINE_INDEX_BUF	(1024 * 1024)	/* read buffer for line_index scan */
 
 #define TERM_AUTO_RIGHT_MARGIN    "am"
 #define TERM_BACKSPACE            "cub1"
@@ -161,6 +163,10 @@ struct more_control {
 	FILE *current_file;		/* currently open input file */
 	off_t file_position;		/* file position */
 	off_t file_size;		/* file size */
+	off_t *line_index;		/* offsets of every LINE_INDEX_STEP line */
+	size_t line_index_sz;		/* number of line_index entries */
+	off_t line_index_end;		/* line_index scanned up to this offset */
+	long line_index_lines;		/* lines before line_index_end */
 	int argv_position;		/* argv[] position */
 	int lines_per_screen;		/* screen size in lines */
 	int d_scroll_len;		/* number of lines scrolled by 'd' */
@@ -377,20 +383,84 @@ static void more_fseek(struct more_control *ctl, off_t pos)
 	fseeko(ctl->current_file, pos, SEEK_SET);
 }
 
+/* The position is counted rather than asked by ftello(), which would be
+ * a syscall for every character. */
 static int more_getc(struct more_control *ctl)
 {
 	int ret = getc(ctl->current_file);
-	ctl->file_position = ftello(ctl->current_file);
+
+	if (ret != EOF)
+		ctl->file_position++;
 	return ret;
 }
 
 static int more_ungetc(struct more_control *ctl, int c)
 {
 	int ret = ungetc(c, ctl->current_file);
-	ctl->file_position = ftello(ctl->current_file);
+
+	if (ret != EOF)
+		ctl->file_position--;
 	return ret;
 }
 
+static void free_line_index(struct more_control *ctl)
+{
+	free(ctl->line_index);
+	ctl->line_index = NULL;
+	ctl->line_index_sz = 0;
+	ctl->line_index_end = 0;
+	ctl->line_index_lines = 0;
+}
+
+/*
+ * Returns offset of the line LINE_INDEX_STEP * @idx, or the last indexed line
+ * before it when the file is shorter. The index is extended on demand by
+ * pread(), so the stream position is not affected. Returns the entry
+ * number in @idx, or -1 if the index is not usable.
+ */
+static off_t line_index_get(struct more_control *ctl, size_t *idx)
+{
+	const int fd = fileno(ctl->current_file);
+	char *buf = NULL;
+
+	if (ctl->no_tty_in || ctl->file_size <= 0)
+		return -1;
+	if (!ctl->line_index) {
+		ctl->line_index = xmalloc(1024 * sizeof(off_t));
+		ctl->line_index[0] = 0;
+		ctl->line_index_sz = 1;
+	}
+
+	while (ctl->line_index_sz <= *idx) {
+		ssize_t bytes;
+		char *p, *end;
+
+		if (!buf)
+			buf = xmalloc(LINE_INDEX_BUF);
+
+		bytes = pread(fd, buf, LINE_INDEX_BUF, ctl->line_index_end);
+		if (bytes <= 0)
+			break;
+
+		end = buf + bytes;
+		for (p = buf; p < end && (p = memchr(p, '\n', end - p)); p++) {
+			if (++ctl->line_index_lines % LINE_INDEX_STEP)
+				continue;
+			if (ctl->line_index_sz % 1024 == 0)
+				ctl->line_index = xreallocarray(ctl->line_index,
+						ctl->line_index_sz + 1024, sizeof(off_t));
+			ctl->line_index[ctl->line_index_sz++] =
+					ctl->line_index_end + (p - buf) + 1;
+		}
+		ctl->line_index_end += bytes;
+	}
+	free(buf);
+
+	if (*idx >= ctl->line_index_sz)
+		*idx = ctl->line_index_sz - 1;
+	return ctl->line_index[*idx];
+}
+
 static void print_separator(const int c, int n)
 {
 	while (n--)
@@ -451,6 +521,7 @@ static void checkf(struct more_control *ctl, char *fs)
 	ctl->current_line = 0;
 	ctl->file_position = 0;
 	ctl->file_size = 0;
+	free_line_index(ctl);
 	fflush(NULL);
 
 	ctl->current_file = fopen(fs, "r");
@@ -784,6 +855,7 @@ static void __attribute__((__noreturn__)) more_exit(struct more_control *ctl)
 	free(ctl->shell_line);
 	free(ctl->line_buf);
 	free(ctl->go_home);
+	free_line_index(ctl);
 	if (ctl->current_file)
 		fclose(ctl->current_file);
 	del_curterm(cur_term);
@@ -1440,6 +1512,68 @@ static int more_poll(struct more_control *ctl, int timeout)
 	return has_data;
 }
 
+/*
+ * Skips lines which cannot match @re (compiled with REG_NEWLINE) by one
+ * regexec() on a large block of the file rather than line by line. Two lines
+ * before the first possible match are kept for search(), which needs them
+ * for context. Lines longer than line_buf and NUL bytes are left to
+ * search() as it splits such lines.
+ *
+ * Returns: number of skipped lines.
+ */
+static int search_skip(struct more_control *ctl, regex_t *re)
+{
+	char *buf, *end, *p, *stop;
+	ssize_t bytes;
+	regmatch_t match;
+	size_t nlines = 0, skip;
+	off_t *starts;
+
+	if (ctl->no_tty_in || ctl->file_size <= 0)
+		return 0;
+
+	buf = xmalloc(LINE_INDEX_BUF + 1);
+	bytes = pread(fileno(ctl->current_file), buf, LINE_INDEX_BUF, ctl->file_position);
+	if (bytes <= 0) {
+		free(buf);
+		return 0;
+	}
+
+	/* complete lines only */
+	end = memchr(buf, '\0', bytes);
+	if (!end)
+		end = buf + bytes;
+	while (end > buf && end[-1] != '\n')
+		end--;
+	*end = '\0';
+
+	/* the first possible match */
+	stop = end;
+	if (end > buf && regexec(re, buf, 1, &match, 0) == 0)
+		stop = buf + match.rm_so;
+
+	/* line starts (relative to @buf) before @stop */
+	starts = xmalloc(((stop - buf) / 2 + 2) * sizeof(off_t));
+	starts[nlines] = 0;
+	for (p = buf; p < stop; ) {
+		char *nl = memchr(p, '\n', end - p);
+
+		if (!nl || nl >= stop || nl - p >= (ptrdiff_t) ctl->line_sz - 1)
+			break;		/* match or too long line */
+		p = nl + 1;
+		starts[++nlines] = p - buf;
+	}
+
+	skip = nlines > 2 ? nlines - 2 : 0;
+	if (skip) {
+		more_fseek(ctl, ctl->file_position + starts[skip]);
+		ctl->current_line += skip;
+	}
+	free(starts);
+	free(buf);
+	return skip;
+}
+
 /* Search for nth occurrence of regular expression contained in buf in
  * the file */
 static void search(struct more_control *ctl, char buf[], int n)
@@ -1449,8 +1583,8 @@ static void search(struct more_control *ctl, char buf[], int n)
 	off_t line2 = startline;
 	off_t line3;
 	int lncount;
-	int saveln, rc;
-	regex_t re;
+	int saveln, rc, slow = 0;
+	regex_t re, re_block;
 
 	if (buf != ctl->previous_search) {
 		free(ctl->previous_search);
@@ -1469,7 +1603,15 @@ static void search(struct more_control *ctl, char buf[], int n)
 		more_error(ctl, s);
 		return;
 	}
+	if (regcomp(&re_block, buf, REG_NEWLINE) != 0)
+		slow = -1;		/* never use search_skip() */
 	while (!feof(ctl->current_file)) {
+		if (slow == 0) {
+			/* read the lines before possible match line by line */
+			lncount += search_skip(ctl, &re_block);
+			slow = 3;
+		} else if (slow > 0)
+			slow--;
 		line3 = line2;
 		line2 = line1;
 		line1 = ctl->file_position;
@@ -1512,6 +1654,8 @@ static void search(struct more_control *ctl, char buf[], int n)
 	sigaddset(&ctl->sigset, SIGINT);
 	sigprocmask(SIG_BLOCK, &ctl->sigset, NULL);
 	regfree(&re);
+	if (slow >= 0)
+		regfree(&re_block);
 	if (feof(ctl->current_file)) {
 		if (!ctl->no_tty_in) {
 			ctl->current_line = saveln;
@@ -1608,6 +1752,9 @@ static void execute_editor(struct more_control *ctl, char *cmdbuf, size_t buflen
 
 static int skip_backwards(struct more_control *ctl, int nlines)
 {
+	size_t idx;
+	off_t pos;
+
 	if (nlines == 0)
 		nlines++;
 	erase_to_col(ctl, 0);
@@ -1616,8 +1763,17 @@ static int skip_backwards(struct more_control *ctl, int nlines)
 	ctl->next_jump = ctl->current_line - (ctl->lines_per_screen * (nlines + 1)) - 1;
 	if (ctl->next_jump < 0)
 		ctl->next_jump = 0;
-	more_fseek(ctl, 0);
-	ctl->current_line = 0;
+
+	/* start from the nearest indexed line rather than from the beginning */
+	idx = ctl->next_jump / LINE_INDEX_STEP;
+	pos = line_index_get(ctl, &idx);
+	if (pos < 0) {
+		pos = 0;
+		idx = 0;
+	}
+	more_fseek(ctl, pos);
+	ctl->current_line = idx * LINE_INDEX_STEP;
+	ctl->next_jump -= ctl->current_line;
 	skip_lines(ctl);
 	return ctl->lines_per_screen;
 }
@@ -1983,6 +2139,7 @@ static void display_file(struct more_control *ctl, int left)
 	fflush(NULL);
 	fclose(ctl->current_file);
 	ctl->current_file = NULL;
+	free_line_index(ctl);
 	ctl->screen_start.line_num = ctl->screen_start.row_num = 0;
 	ctl->context.line_num = ctl->context.row_num = 0L;
 }
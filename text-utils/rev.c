@@ -64,6 +64,21 @@
 #include "c.h"
 #include "closestream.h"
 
+/* block size for the byte-oriented modes */
+#define REV_BLOCKSZ	(256 * 1024)
+
+enum {
+	REV_MODE_WIDE,		/* generic multibyte locale, fgetwc() and fputwc() */
+	REV_MODE_BYTES,		/* single-byte locale */
+	REV_MODE_UTF8		/* UTF-8 locale, without libc conversions */
+};
+
+struct rev_buffer {
+	char	*in;		/* input data */
+	char	*out;		/* reversed lines, the same offsets as in @in */
+	size_t	size;		/* allocated size of both buffers */
+};
+
 static void sig_handler(int signo __attribute__ ((__unused__)))
 {
 	_exit(EXIT_SUCCESS);
@@ -116,14 +131,161 @@ static void write_line(wchar_t *str, size_t n, FILE *stream)
 		fputwc(str[i], stream);
 }
 
+static int rev_wide(FILE *fp, wchar_t sep, wchar_t **buf, size_t *bufsiz,
+		    uintmax_t *line)
+{
+	size_t len;
+
+	while (!feof(fp)) {
+		len = read_line(sep, *buf, *bufsiz, fp);
+		if (len == 0)
+			continue;
+
+		/* This is my hack from setpwnam.c -janl */
+		while (len == *bufsiz && !feof(fp)) {
+			/* Extend input buffer if it failed getting the whole line */
+			/* So now we double the buffer size */
+			*bufsiz *= 2;
+
+			*buf = xreallocarray(*buf, *bufsiz, sizeof(wchar_t));
+
+			/* And fill the rest of the buffer */
+			len += read_line(sep, &(*buf)[len], *bufsiz/2, fp);
+		}
+		reverse_str(*buf, (*buf)[len - 1] == sep ? len - 1 : len);
+		write_line(*buf, len, stdout);
+		(*line)++;
+	}
+	return ferror(fp) ? -1 : 0;
+}
+
+static void reverse_bytes(char *dst, const char *src, size_t n)
+{
+	size_t i;
+
+	/* simple enough to be vectorized by compiler */
+	for (i = 0; i < n; i++)
+		dst[i] = src[n - 1 - i];
+}
+
+static int is_ascii(const char *str, size_t n)
+{
+	unsigned char x = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		x |= str[i];
+	return x < 0x80;
+}
+
+/*
+ * Returns the length of the UTF-8 sequence, invalid bytes are handled as
+ * single characters (the same as in a single-byte locale).
+ */
+static size_t utf8_charlen(const unsigned char *s, size_t n)
+{
+	size_t len, i;
+
+	if (*s < 0xC2 || *s > 0xF4)
+		return 1;
+	len = *s < 0xE0 ? 2 : *s < 0xF0 ? 3 : 4;
+	if (len > n)
+		return 1;
+
+	/* overlong forms, surrogates and code points above U+10FFFF */
+	if ((*s == 0xE0 && s[1] < 0xA0) || (*s == 0xED && s[1] > 0x9F) ||
+	    (*s == 0xF0 && s[1] < 0x90) || (*s == 0xF4 && s[1] > 0x8F))
+		return 1;
+
+	for (i = 1; i < len; i++) {
+		if ((s[i] & 0xC0) != 0x80)
+			return 1;
+	}
+	return len;
+}
+
+static void reverse_line(char *dst, const char *src, size_t n, int utf8)
+{
+	size_t i, len;
+
+	if (!utf8 || is_ascii(src, n)) {
+		reverse_bytes(dst, src, n);
+		return;
+	}
+
+	/* copy the characters from the begin of @src to the end of @dst */
+	for (i = 0; i < n; i += len) {
+		len = utf8_charlen((const unsigned char *) src + i, n - i);
+		memcpy(dst + n - i - len, src + i, len);
+	}
+}
+
+/*
+ * Byte-oriented mode -- reads large blocks and reverses all complete lines
+ * in the block, the incomplete line is moved to the begin of the buffer.
+ */
+static int rev_bytes(int fd, char sep, int utf8, struct rev_buffer *buf,
+		     uintmax_t *line)
+{
+	size_t len = 0, done;
+	int eof = 0;
+
+	while (!eof) {
+		ssize_t n;
+		char *p;
+
+		if (len == buf->size) {
+			/* the line is longer than the buffer */
+			buf->size *= 2;
+			buf->in = xrealloc(buf->in, buf->size);
+			buf->out = xrealloc(buf->out, buf->size);
+		}
+
+		n = read(fd, buf->in + len, buf->size - len);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			eof = 1;
+		len += n;
+
+		done = 0;
+		while (done < len &&
+		       (p = memchr(buf->in + done, sep, len - done))) {
+			size_t sz = p - (buf->in + done);
+
+			reverse_line(buf->out + done, buf->in + done, sz, utf8);
+			buf->out[done + sz] = sep;
+			done += sz + 1;
+			(*line)++;
+		}
+		if (eof && done < len) {
+			/* the last line without separator */
+			reverse_line(buf->out + done, buf->in + done, len - done, utf8);
+			done = len;
+			(*line)++;
+		}
+
+		if (done) {
+			fwrite(buf->out, 1, done, stdout);
+			len -= done;
+			memmove(buf->in, buf->in + done, len);
+		}
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	char const *filename = "stdin";
-	wchar_t *buf;
+	wchar_t *buf = NULL;
 	wchar_t sep = L'\n';
-	size_t len, bufsiz = BUFSIZ;
+	size_t bufsiz = BUFSIZ;
+	struct rev_buffer rbuf = { .size = REV_BLOCKSZ };
 	FILE *fp = stdin;
-	int ch, rval = EXIT_SUCCESS;
+	int ch, rc, mode, rval = EXIT_SUCCESS;
 	uintmax_t line;
 
 	static const struct option longopts[] = {
@@ -157,7 +319,24 @@ int main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	buf = xreallocarray(NULL, bufsiz, sizeof(wchar_t));
+	/* the wide chars are necessary only for non-UTF-8 multibyte locales */
+#ifdef HAVE_WIDECHAR
+	if (MB_CUR_MAX == 1)
+		mode = REV_MODE_BYTES;
+	else if (strcmp(nl_langinfo(CODESET), "UTF-8") == 0)
+		mode = REV_MODE_UTF8;
+	else
+		mode = REV_MODE_WIDE;
+#else
+	mode = REV_MODE_BYTES;
+#endif
+
+	if (mode == REV_MODE_WIDE)
+		buf = xreallocarray(NULL, bufsiz, sizeof(wchar_t));
+	else {
+		rbuf.in = xmalloc(rbuf.size);
+		rbuf.out = xmalloc(rbuf.size);
+	}
 
 	do {
 		if (*argv) {
@@ -171,27 +350,12 @@ int main(int argc, char *argv[])
 		}
 
 		line = 0;
-		while (!feof(fp)) {
-			len = read_line(sep, buf, bufsiz, fp);
-			if (len == 0)
-				continue;
-
-			/* This is my hack from setpwnam.c -janl */
-			while (len == bufsiz && !feof(fp)) {
-				/* Extend input buffer if it failed getting the whole line */
-				/* So now we double the buffer size */
-				bufsiz *= 2;
-
-				buf = xreallocarray(buf, bufsiz, sizeof(wchar_t));
-
-				/* And fill the rest of the buffer */
-				len += read_line(sep, &buf[len], bufsiz/2, fp);
-			}
-			reverse_str(buf, buf[len - 1] == sep ? len - 1 : len);
-			write_line(buf, len, stdout);
-			line++;
-		}
-		if (ferror(fp)) {
+		if (mode == REV_MODE_WIDE)
+			rc = rev_wide(fp, sep, &buf, &bufsiz, &line);
+		else
+			rc = rev_bytes(fileno(fp), (char) sep,
+				       mode == REV_MODE_UTF8, &rbuf, &line);
+		if (rc) {
 			warn("%s: %ju", filename, line);
 			rval = EXIT_FAILURE;
 		}
@@ -200,5 +364,7 @@ int main(int argc, char *argv[])
 	} while(*argv);
 
 	free(buf);
+	free(rbuf.in);
+	free(rbuf.out);
 	return rval;
 }
@@ -47,6 +47,7 @@
 #include <limits.h>		/* for INT_MAX */
 #include <signal.h>		/* for signal() */
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 
 #if defined(HAVE_NCURSESW_TERM_H)
@@ -70,6 +71,9 @@
 #define	HREV	'8'
 #define	FREV	'7'
 
+/* size of the input buffer */
+#define	IBUFSZ	(64 * 1024)
+
 enum {
 	NORMAL_CHARSET	    = 0,	/* Must be zero, see initbuf() */
 	ALTERNATIVE_CHARSET = 1 << 0,	/* Reverse */
@@ -109,10 +113,18 @@ struct ul_ctl {
 	int current_mode;
 	size_t buflen;
 	struct ul_char *buf;
+
+	int ifd;		/* input file descriptor */
+	char *ibuf;		/* input buffer */
+	size_t ibuf_pos;	/* next unread byte in ibuf */
+	size_t ibuf_len;	/* bytes in ibuf */
+	size_t last_len;	/* size of the last read character */
+
 	unsigned int
 		indicated_opt:1,
 		must_use_uc:1,
-		must_overstrike:1;
+		must_overstrike:1,
+		input_eof:1;
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -137,7 +149,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 static void need_column(struct ul_ctl *ctl, size_t new_max)
 {
-	ctl->max_column = new_max;
+	if (ctl->max_column < new_max)
+		ctl->max_column = new_max;
 
 	while (new_max >= ctl->buflen) {
 		ctl->buflen *= 2;
@@ -226,11 +239,113 @@ static void sig_handler(int signo __attribute__((__unused__)))
 	_exit(EXIT_SUCCESS);
 }
 
+/*
+ * The input is read by read(2) and decoded here rather than by getwc(), the
+ * wide-character stdio is very slow. The output is flushed only before
+ * waiting for more input, so interactive use still works line by line.
+ */
+static int fill_input(struct ul_ctl *ctl)
+{
+	ssize_t rc;
+
+	if (ctl->input_eof)
+		return 0;
+	if (ctl->ibuf_pos) {
+		ctl->ibuf_len -= ctl->ibuf_pos;
+		memmove(ctl->ibuf, ctl->ibuf + ctl->ibuf_pos, ctl->ibuf_len);
+		ctl->ibuf_pos = 0;
+	}
+	fflush(stdout);
+	do {
+		rc = read(ctl->ifd, ctl->ibuf + ctl->ibuf_len, IBUFSZ - ctl->ibuf_len);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc <= 0) {
+		ctl->input_eof = 1;
+		return 0;
+	}
+	ctl->ibuf_len += rc;
+	return 1;
+}
+
+/* returns WEOF also for invalid and incomplete multibyte sequences */
+static wint_t ul_getwc(struct ul_ctl *ctl)
+{
+	ctl->last_len = 0;
+	do {
+		const char *p = ctl->ibuf + ctl->ibuf_pos;
+		size_t len = ctl->ibuf_len - ctl->ibuf_pos;
+#ifdef HAVE_WIDECHAR
+		mbstate_t st;
+		wchar_t wc;
+		size_t n;
+
+		if (!len)
+			continue;
+		if (!(*p & 0x80)) {
+			ctl->ibuf_pos++;
+			ctl->last_len = 1;
+			return *p;
+		}
+		memset(&st, 0, sizeof(st));
+		n = mbrtowc(&wc, p, len, &st);
+		if (n == (size_t) -1)
+			return WEOF;
+		if (n == (size_t) -2)
+			continue;	/* incomplete, read more */
+		ctl->ibuf_pos += n;
+		ctl->last_len = n;
+		return wc;
+#else
+		if (len) {
+			ctl->ibuf_pos++;
+			ctl->last_len = 1;
+			return (unsigned char) *p;
+		}
+#endif
+	} while (fill_input(ctl));
+
+	return WEOF;
+}
+
+static void ul_ungetwc(struct ul_ctl *ctl)
+{
+	ctl->ibuf_pos -= ctl->last_len;
+	ctl->last_len = 0;
+}
+
+static void ul_putwc(wchar_t c)
+{
+	int rc;
+
+	if (!(c & ~0x7f))
+		rc = putchar(c);
+	else {
+#ifdef HAVE_WIDECHAR
+		char mb[MB_LEN_MAX];
+		mbstate_t st;
+		size_t n;
+
+		memset(&st, 0, sizeof(st));
+		n = wcrtomb(mb, c, &st);
+		rc = n == (size_t) -1 || fwrite(mb, 1, n, stdout) != n ? EOF : 0;
+#else
+		rc = putchar((unsigned char) c);
+#endif
+	}
+	if (rc == EOF)
+		err(EXIT_FAILURE, _("write failed"));
+}
+
+static void ul_putws(const wchar_t *s)
+{
+	for (; *s; s++)
+		ul_putwc(*s);
+}
+
 static int ul_putwchar(int c)
 {
-	if (putwchar(c) == WEOF)
-		return EOF;
-	return c;
+	return putchar(c);
 }
 
 static void print_line(char *line)
@@ -314,8 +429,8 @@ static void indicate_attribute(struct ul_ctl *ctl)
 	for (*p = ' '; *p == ' '; p--)
 		*p = 0;
 
-	fputws(buf, stdout);
-	putwchar('\n');
+	ul_putws(buf);
+	ul_putwc('\n');
 	free(buf);
 }
 
@@ -324,7 +439,7 @@ static void output_char(struct ul_ctl *ctl, struct term_caps const *const tcs,
 {
 	int i;
 
-	putwchar(c);
+	ul_putwc(c);
 	if (ctl->must_use_uc && (ctl->current_mode & UNDERLINE)) {
 		for (i = 0; i < width; i++)
 			print_line(tcs->curs_left);
@@ -363,18 +478,18 @@ static void overstrike(struct ul_ctl *ctl)
 		}
 	}
 
-	putwchar('\r');
+	ul_putwc('\r');
 	for (*p = ' '; *p == ' '; p--)
 		*p = 0;
-	fputws(buf, stdout);
+	ul_putws(buf);
 
 	if (had_bold) {
-		putwchar('\r');
+		ul_putwc('\r');
 		for (p = buf; *p; p++)
-			putwchar(*p == '_' ? ' ' : *p);
-		putwchar('\r');
+			ul_putwc(*p == '_' ? ' ' : *p);
+		ul_putwc('\r');
 		for (p = buf; *p; p++)
-			putwchar(*p == '_' ? ' ' : *p);
+			ul_putwc(*p == '_' ? ' ' : *p);
 	}
 	free(buf);
 }
@@ -406,10 +521,9 @@ static void flush_line(struct ul_ctl *ctl, struct term_caps const *const tcs)
 		ul_setmode(ctl, tcs, NORMAL_CHARSET);
 	if (ctl->must_overstrike && had_mode)
 		overstrike(ctl);
-	putwchar('\n');
+	ul_putwc('\n');
 	if (ctl->indicated_opt && had_mode)
 		indicate_attribute(ctl);
-	fflush(stdout);
 	if (ctl->up_line)
 		ctl->up_line--;
 	init_buffer(ctl);
@@ -435,11 +549,11 @@ static void reverse(struct ul_ctl *ctl, struct term_caps const *const tcs)
 	ctl->up_line++;
 }
 
-static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *f)
+static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs)
 {
 	wint_t c;
 
-	switch (c = getwc(f)) {
+	switch (c = ul_getwc(ctl)) {
 	case HREV:
 		if (0 < ctl->half_position) {
 			ctl->mode &= ~SUBSCRIPT;
@@ -469,17 +583,69 @@ static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs,
 		return 0;
 	default:
 		/* unknown escape */
-		ungetwc(c, f);
+		ul_ungetwc(ctl);
 		return 1;
 	}
 }
 
-static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *f)
+/*
+ * Writes a line of plain ASCII text without any overstriking or escape
+ * sequences directly to the output.
+ *
+ * Returns: 1 if the line has been written, 0 if it has to be processed
+ * by filter().
+ */
+static int filter_plain_line(struct ul_ctl *ctl)
+{
+	const char *p = ctl->ibuf + ctl->ibuf_pos;
+	const char *end = ctl->ibuf + ctl->ibuf_len;
+	const char *nl;
+	size_t column = 0;
+
+	if (ctl->max_column || ctl->column || ctl->mode || ctl->up_line
+	    || ctl->current_mode != NORMAL_CHARSET)
+		return 0;
+
+	nl = memchr(p, '\n', end - p);
+	if (!nl)
+		return 0;
+
+	for (end = p; end < nl; end++) {
+		if (*end != '\t' && (*end < ' ' || 0x7f <= *end))
+			return 0;
+	}
+
+	for (; p < nl; p++) {
+		if (*p != '\t') {
+			column++;
+			putchar(*p);
+			continue;
+		}
+		do {
+			putchar(' ');
+		} while (++column & 07);
+	}
+	if (putchar('\n') == EOF)
+		err(EXIT_FAILURE, _("write failed"));
+
+	ctl->ibuf_pos = nl + 1 - ctl->ibuf;
+	return 1;
+}
+
+static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, int fd)
 {
 	wint_t c;
 	int i, width;
 
-	while ((c = getwc(f)) != WEOF) {
+	ctl->ifd = fd;
+	ctl->ibuf_pos = ctl->ibuf_len = 0;
+	ctl->input_eof = 0;
+
+	for (;;) {
+		if (filter_plain_line(ctl))
+			continue;
+		if ((c = ul_getwc(ctl)) == WEOF)
+			break;
 		switch (c) {
 		case '\b':
 			set_column(ctl, ctl->column && 0 < ctl->column ? ctl->column - 1 : 0);
@@ -497,8 +663,8 @@ static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *
 			ctl->mode &= ~ALTERNATIVE_CHARSET;
 			continue;
 		case ESC:
-			if (handle_escape(ctl, tcs, f)) {
-				c = getwc(f);
+			if (handle_escape(ctl, tcs)) {
+				c = ul_getwc(ctl);
 				errx(EXIT_FAILURE,
 				     _("unknown escape sequence in input: %o, %o"), ESC, c);
 			}
@@ -524,7 +690,7 @@ static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *
 			continue;
 		case '\f':
 			flush_line(ctl, tcs);
-			putwchar('\f');
+			ul_putwc('\f');
 			continue;
 		default:
 			if (!iswprint(c))
@@ -568,7 +734,6 @@ int main(int argc, char **argv)
 	char *termtype;
 	struct term_caps tcs = { 0 };
 	struct ul_ctl ctl = { .current_mode = NORMAL_CHARSET };
-	FILE *f;
 
 	static const struct option longopts[] = {
 		{ "terminal",	required_argument,	NULL, 't' },
@@ -627,19 +792,22 @@ int main(int argc, char **argv)
 
 	init_term_caps(&ctl, &tcs);
 	init_buffer(&ctl);
+	ctl.ibuf = xmalloc(IBUFSZ);
 
 	if (optind == argc)
-		filter(&ctl, &tcs, stdin);
+		filter(&ctl, &tcs, STDIN_FILENO);
 	else {
 		for (; optind < argc; optind++) {
-			f = fopen(argv[optind], "r");
-			if (!f)
+			int fd = open(argv[optind], O_RDONLY);
+
+			if (fd < 0)
 				err(EXIT_FAILURE, _("cannot open %s"), argv[optind]);
-			filter(&ctl, &tcs, f);
-			fclose(f);
+			filter(&ctl, &tcs, fd);
+			close(fd);
 		}
 	}
 
+	free(ctl.ibuf);
 	free(ctl.buf);
 	del_curterm(cur_term);
 	return EXIT_SUCCESS;